@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Types.h"
+
+#include <QAbstractListModel>
+#include <QColor>
+#include <QList>
+#include <QTimer>
+
+#include <vector>
+
+namespace FlashSpartan {
+
+/**
+ * Fixed-capacity ring of activity log lines for the sidebar log, oldest row first.
+ *
+ * append() only queues the entry; queued entries reach the view together once per frame
+ * (kFlushIntervalMs), as one removal of the lines that fell off the ring and one insertion,
+ * so a burst of hash, ISO or HID messages costs a single layout. Entries are numbered as
+ * they enter the ring and sit at number % capacity; with a filter set the rows are the
+ * numbers of the matching entries.
+ */
+class ActivityLogModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    static constexpr int kDefaultCapacity = 5000;
+    static constexpr int kMinCapacity = 100;
+    static constexpr int kFlushIntervalMs = 16;
+
+    explicit ActivityLogModel(int capacity = kDefaultCapacity, QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    /** Queues @p entry; it shows with the next flush. */
+    void append(LogEntry entry);
+    /** Moves the queued entries into the ring and tells the view; the timer calls this. */
+    void flush();
+
+    int capacity() const { return m_capacity; }
+    /** Resizes the ring, keeping the newest lines; resets the view. */
+    void setCapacity(int capacity);
+    /** Lines in the ring, filtered or not; queued ones are not counted. */
+    int heldCount() const { return int(m_end - m_first); }
+    int pendingCount() const { return int(m_pending.size()); }
+
+    /** Case-insensitive match against message, level, category and device; empty shows all. */
+    void setFilterText(const QString& text);
+    QString filterText() const { return m_filterText; }
+
+    const LogEntry& entry(int row) const { return at(sequenceAt(row)); }
+    void setForeground(const QColor& color) { m_foreground = color; }
+
+signals:
+    /** A flush inserted @p appended rows at the bottom. */
+    void flushed(int appended);
+
+private:
+    bool isFiltered() const { return !m_filterText.isEmpty(); }
+    bool accepts(const LogEntry& entry) const;
+    quint64 sequenceAt(int row) const { return isFiltered() ? m_visible.at(row) : m_first + quint64(row); }
+    const LogEntry& at(quint64 sequence) const { return m_ring[sequence % quint64(m_capacity)]; }
+    void rebuildVisible();
+
+    int m_capacity;
+    std::vector<LogEntry> m_ring;  // grows to m_capacity, then wraps
+    quint64 m_first = 0;           // oldest held sequence number
+    quint64 m_end = 0;             // one past the newest
+    QList<LogEntry> m_pending;
+    QTimer m_flushTimer;
+    QString m_filterText;
+    QList<quint64> m_visible;  // matching sequence numbers, ascending
+    QColor m_foreground;
+};
+
+} // namespace FlashSpartan
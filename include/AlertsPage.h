@@ -1,12 +1,14 @@
 #pragma once
 
+#include "RecordTableModel.h"
 #include "UiEventTypes.h"
+#include "VerifyRollup.h"
 
 #include <QWidget>
 
 class QComboBox;
 class QLineEdit;
-class QTableWidget;
+class QTableView;
 class QLabel;
 
 namespace FlashSpartan {
@@ -17,8 +19,13 @@ class AlertsPage : public QWidget {
 public:
     explicit AlertsPage(QWidget* parent = nullptr);
 
+    /** Replaces every alert; @p alerts newest first. */
     void setAlerts(const QList<UiEventEntry>& alerts);
+    /** Adds alerts that just happened at the top, keeping the filter and scroll position. */
+    void addAlerts(const QList<UiEventEntry>& newestFirst);
     void setSummary(int total, int securityCount);
+    /** Failed verifications today and over the last 7 days, from the history rollup. */
+    void setVerifyFailures(const VerifyRollup::Counts& today, const VerifyRollup::Counts& week);
 
     QString filterKind() const;
     QString searchText() const;
@@ -29,20 +36,22 @@ signals:
 
 private slots:
     void onFilterChanged();
-    void onDetailsClicked();
+    void onRowClicked(const QModelIndex& index);
+    void onRowsReplaced();
 
 private:
     void setupUi();
+    void applyFilter();
     void applyTableLayout();
-    int rowIndexForButton(QObject* sender) const;
 
     QLabel* m_totalLabel = nullptr;
     QLabel* m_securityLabel = nullptr;
+    QLabel* m_failuresLabel = nullptr;
     QComboBox* m_filterCombo = nullptr;
     QLineEdit* m_searchEdit = nullptr;
-    QTableWidget* m_table = nullptr;
-    QList<UiEventEntry> m_rows;
-    QList<UiEventEntry> m_visibleRows;
+    QTableView* m_table = nullptr;
+    RecordTableModel<UiEventEntry>* m_model = nullptr;
+    int m_securityCount = 0;
 };
 
 } // namespace FlashSpartan
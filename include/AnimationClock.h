@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QTimer>
+
+#include <functional>
+
+namespace FlashSpartan {
+
+/**
+ * Shared frame clock for looping widget animations such as the device-card pulse.
+ *
+ * Clients subscribe while they are animating and on screen; one timer then calls every
+ * client in a single pass with the same elapsed time, so their phases stay in step. The
+ * timer only runs while there is a subscriber and the window is not suspended (hidden,
+ * minimized or in the tray), so an idle or hidden window wakes the event loop for nothing.
+ */
+class AnimationClock : public QObject {
+    Q_OBJECT
+
+public:
+    using Tick = std::function<void(qint64 elapsedMs)>;
+
+    static constexpr double kDefaultFrameRate = 60.0;
+    /** Pulses are slow; more frames than this only repaint drop shadows more often. */
+    static constexpr double kMaxFrameRate = 30.0;
+
+    static AnimationClock& instance();
+
+    explicit AnimationClock(QObject* parent = nullptr);
+
+    /** Calls @p tick on every frame until unsubscribe() or until @p client is destroyed. */
+    void subscribe(QObject* client, Tick tick);
+    void unsubscribe(QObject* client);
+    bool isSubscribed(QObject* client) const { return m_clients.contains(client); }
+
+    /** Display refresh rate; the clock runs at this rate up to kMaxFrameRate. */
+    void setFrameRate(double hz);
+    /** Stops ticking while nothing can be seen, whatever is subscribed. */
+    void setSuspended(bool suspended);
+
+    int interval() const { return m_timer.interval(); }
+    bool isRunning() const { return m_timer.isActive(); }
+    qint64 elapsed() const { return m_clock.elapsed(); }
+
+    /** Calls every subscriber now, as a frame does. */
+    void tick();
+
+private:
+    void updateTimer();
+
+    QHash<QObject*, Tick> m_clients;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    bool m_suspended = false;
+};
+
+} // namespace FlashSpartan
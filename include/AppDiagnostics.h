@@ -1,5 +1,6 @@
 #pragma once
 
+#include "CaptureRetention.h"
 #include "UsbHostTier.h"
 #include "WinUsbEnumerator.h"
 
@@ -7,18 +8,41 @@
 
 namespace FlashSpartan {
 
-/** File paths and diagnostic exports (logs, USB inventory snapshots). */
+/** File paths and diagnostic exports (logs, USB inventory snapshots, BadUSB captures). */
 class AppDiagnostics {
 public:
     static QString logsDir();
     static QString qtLogPath();
     static QString hostUsbInventoryPath();
+    /** Where BadUSB usbmon / USBPcap captures are written and kept by CaptureRetention. */
+    static QString badUsbCapturesDir();
+    static CaptureRetention::Usage badUsbCaptureUsage();
 
     /** Append one JSON line per host node (all tiers) for support / triage. */
     static void appendHostUsbInventorySnapshot(const QList<UsbHostDeviceInfo>& devices,
                                              const QString& trigger = {});
 
     static void installQtMessageHandler();
+
+    /** Default file for the live PerfMetrics in Prometheus text format, under logsDir(). */
+    static QString metricsPath();
+
+    /**
+     * Rewrites @p path (metricsPath() when empty) with PerfMetrics::toPrometheusText() every
+     * @p intervalMs and when the application quits, for the node_exporter textfile collector.
+     */
+    static void startMetricsExport(const QString& path = {}, int intervalMs = 15000);
+
+    /** The FlightRecorder ring, under logsDir(). */
+    static QString flightRecorderPath();
+    /** Starts the FlightRecorder and samples PerfMetrics into it every kFlightRecorderSampleMs. */
+    static void startFlightRecorder();
+    static constexpr int kFlightRecorderSampleMs = 60000;
+    /**
+     * Writes the flight recording to @p outPath as a Chrome trace: this process's ring when
+     * it is recording, otherwise what the last run (crashed or not) left in the file.
+     */
+    static bool dumpFlightRecorder(const QString& outPath, QString* error = nullptr);
 };
 
 } // namespace FlashSpartan
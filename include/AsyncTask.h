@@ -0,0 +1,149 @@
+#pragma once
+
+#include <QFuture>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QPromise>
+
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace FlashSpartan {
+
+template <typename T = void>
+class AsyncTask;
+
+namespace detail {
+
+template <typename T>
+struct AsyncPromiseBase {
+    QPromise<T> promise;
+
+    AsyncPromiseBase() { promise.start(); }
+
+    AsyncTask<T> get_return_object();
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void unhandled_exception()
+    {
+        promise.setException(std::current_exception());
+        promise.finish();
+    }
+};
+
+template <typename T>
+struct AsyncPromise : AsyncPromiseBase<T> {
+    void return_value(T value)
+    {
+        this->promise.addResult(std::move(value));
+        this->promise.finish();
+    }
+};
+
+template <>
+struct AsyncPromise<void> : AsyncPromiseBase<void> {
+    void return_void() { promise.finish(); }
+};
+
+} // namespace detail
+
+/**
+ * Coroutine that runs as soon as it is called and hands its result to a QFuture.
+ *
+ * A verification flow is written as a sequence of stages: the blocking ones (a mount walk,
+ * the hash) are queued in IoScheduler and awaited with resumeOn(), and the code between
+ * them runs on the caller's thread, usually the GUI thread. No thread is held between
+ * stages, so many flows can wait on the scheduler's few threads at once. Nothing has to
+ * keep the AsyncTask alive; await future() from another flow, or drop it.
+ */
+template <typename T>
+class AsyncTask {
+public:
+    using promise_type = detail::AsyncPromise<T>;
+
+    /** Finishes with the coroutine; cancelled when it was dropped before finishing. */
+    QFuture<T> future() const { return m_future; }
+
+private:
+    friend struct detail::AsyncPromiseBase<T>;
+
+    explicit AsyncTask(QFuture<T> future)
+        : m_future(std::move(future))
+    {
+    }
+
+    QFuture<T> m_future;
+};
+
+template <typename T>
+AsyncTask<T> detail::AsyncPromiseBase<T>::get_return_object()
+{
+    return AsyncTask<T>(promise.future());
+}
+
+/**
+ * Awaits @p future and resumes on @p context's thread from its event loop. Must be awaited
+ * on that thread. The result is nullopt (false for QFuture<void>) when the future was
+ * cancelled, e.g. work the scheduler dropped; an exception stored in it is rethrown. If
+ * @p context is destroyed first, the coroutine is destroyed without resuming.
+ */
+template <typename U>
+class FutureAwaiter {
+public:
+    using Result = std::conditional_t<std::is_void_v<U>, bool, std::optional<U>>;
+
+    FutureAwaiter(QObject* context, QFuture<U> future)
+        : m_context(context)
+        , m_future(std::move(future))
+    {
+    }
+
+    bool await_ready() const { return m_future.isFinished(); }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        auto* watcher = new QFutureWatcher<U>(m_context);
+        auto resumed = std::make_shared<bool>(false);
+        QObject::connect(watcher, &QFutureWatcherBase::finished, watcher, [watcher, handle, resumed]() {
+            *resumed = true;
+            watcher->deleteLater();
+            handle.resume();
+        });
+        QObject::connect(watcher, &QObject::destroyed, [handle, resumed]() {
+            if (!*resumed) {
+                handle.destroy();
+            }
+        });
+        watcher->setFuture(m_future);
+    }
+
+    Result await_resume()
+    {
+        if constexpr (std::is_void_v<U>) {
+            m_future.waitForFinished();
+            return !m_future.isCanceled();
+        } else {
+            if (m_future.resultCount() == 0) {
+                m_future.waitForFinished();
+                return std::nullopt;
+            }
+            return m_future.result();
+        }
+    }
+
+private:
+    QObject* m_context;
+    QFuture<U> m_future;
+};
+
+template <typename U>
+FutureAwaiter<U> resumeOn(QObject* context, QFuture<U> future)
+{
+    return FutureAwaiter<U>(context, std::move(future));
+}
+
+} // namespace FlashSpartan
@@ -4,17 +4,19 @@
 
 namespace FlashSpartan {
 
-/** Append-only JSON-lines audit log for verification events. */
+/** Append-only JSON-lines audit log for verification events, written through AuditWriter. */
 class AuditLog {
 public:
     static QString logPath();
 
     static void appendIsoVerify(const IsoVerifyResult& result);
     static void appendBadUsbEvent(const BadUsbAnomalyResult& result);
+    /** The anomaly again, with its decoded capture in capture_summary. */
+    static void appendBadUsbCaptureSummary(const BadUsbAnomalyResult& result);
     static void appendEvent(const QString& event, const QString& detail = {});
 
 private:
-    static void appendLine(const QString& jsonLine);
+    static void appendLine(const QByteArray& jsonLine, const QString& device = {});
 };
 
 } // namespace FlashSpartan
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+
+namespace FlashSpartan {
+
+/**
+ * Layout of an audit log written by AuditWriter, and the queries it makes cheap.
+ *
+ * The file at `path` is the open segment; once it reaches kSegmentBytes it is renamed to
+ * `path.1`, `path.2`, ... (higher is newer). Each segment has a sidecar `<segment>.idx`:
+ * a small header, then one fixed-size entry (time, byte offset, device hash) per line in
+ * time order, so a range is found by binary search and read with seeks. Every line also
+ * carries "prev", the SHA-256 of the line before it (across segments), so an edited or
+ * removed line breaks the chain at that point.
+ */
+class AuditLogIndex {
+public:
+    static constexpr qint64 kSegmentBytes = 4 * 1024 * 1024;
+    static constexpr quint32 kMagic = 0x49415346;  // "FSAI"
+    static constexpr quint32 kVersion = 1;
+    static constexpr int kHeaderBytes = 8;
+    static constexpr int kEntryBytes = 24;
+
+    struct Entry {
+        /** Milliseconds since the epoch, never lower than the entry before. */
+        qint64 msecs = 0;
+        quint64 offset = 0;
+        /** deviceHash() of the line's device, 0 when it has none. */
+        quint64 device = 0;
+    };
+
+    struct Query {
+        QDateTime from;  // invalid = from the start
+        QDateTime to;    // invalid = up to now
+        /** Empty = every line. Lines written before the index existed carry no device. */
+        QString device;
+        /** 0 = no limit. */
+        int limit = 0;
+    };
+
+    /** Lines matching @p query, newest first. */
+    static QList<QByteArray> query(const QString& path, const Query& query);
+    /**
+     * Lines matching @p query, oldest first, one segment in memory at a time: the range and
+     * device are matched on the sidecar entries, so skipped lines are never read. @p visit
+     * gets each line and the fraction of the log's bytes behind it, and returns false to
+     * stop; forEach() then returns false too.
+     */
+    static bool forEach(const QString& path, const Query& query,
+                        const std::function<bool(const QByteArray& line, double done)>& visit);
+    /** Follows the "prev" links from the oldest segment on; false, with where, if one breaks. */
+    static bool verifyChain(const QString& path, QString* error = nullptr);
+
+    /** Segment files of @p path, oldest first; @p path itself is last when it exists. */
+    static QStringList segments(const QString& path);
+    static QString indexPath(const QString& segment);
+    static quint64 deviceHash(const QString& device);
+    /** Hex SHA-256 of @p line without its newline: the next line's "prev". */
+    static QByteArray lineHash(const QByteArray& line);
+
+    /**
+     * Entries for every line of @p segment: its sidecar, plus lines scanned past what the
+     * sidecar covers (or all of them when it is missing or damaged). @p indexed is set to
+     * how many came from a usable sidecar; @p lastLine to the segment's last line.
+     */
+    static QList<Entry> load(QFile& segment, int* indexed = nullptr, QByteArray* lastLine = nullptr);
+    static QByteArray encodeHeader();
+    static QByteArray encodeEntry(const Entry& entry);
+};
+
+} // namespace FlashSpartan
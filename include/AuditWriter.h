@@ -0,0 +1,94 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace FlashSpartan {
+
+/**
+ * Builds one compact JSON object for an audit line without going through QJsonObject;
+ * keys are written in the order they are added.
+ */
+class AuditLine {
+public:
+    AuditLine& add(const char* key, const QString& value);
+    AuditLine& add(const char* key, bool value);
+    AuditLine& add(const char* key, int value);
+    /** Adds the current UTC time as "ts". */
+    AuditLine& addTimestamp();
+
+    QByteArray take();
+
+private:
+    void addKey(const char* key);
+
+    QByteArray m_json;
+};
+
+/**
+ * Append-only writer for a JSON-lines audit file. append() never blocks on I/O: lines go
+ * onto a lock-free stack and one flusher thread per file writes them in order through a
+ * long-lived handle, and fsyncs at most kSyncIntervalMs after a write. Lines still queued
+ * at exit are written and synced when the writer is destroyed; flush() makes everything
+ * appended so far durable now.
+ *
+ * The flusher also chains each line to the one before, keeps the sidecar index and rolls
+ * segments (AuditLogIndex). One process writes a given log.
+ */
+class AuditWriter {
+public:
+    static constexpr int kSyncIntervalMs = 1000;
+
+    /** The writer for @p path, started on first use and kept until exit. */
+    static AuditWriter& forPath(const QString& path, QFile::Permissions permissions = {});
+    /** flush() on every writer: before a reader opens the files, and at shutdown. */
+    static void flushAll();
+
+    ~AuditWriter();
+
+    AuditWriter(const AuditWriter&) = delete;
+    AuditWriter& operator=(const AuditWriter&) = delete;
+
+    /**
+     * Queues @p line, a JSON object; "prev" and the newline are added. @p device is what
+     * AuditLogIndex::Query::device finds it by. Safe from any thread.
+     */
+    void append(QByteArray line, const QString& device = {});
+    /** Waits until every line appended before the call is written and synced. */
+    void flush();
+
+private:
+    struct Node;
+
+    AuditWriter(QString path, QFile::Permissions permissions);
+
+    void push(Node* node);
+    void run();
+    /** Writes what is queued; returns the flush requests it took, oldest first. */
+    Node* drain(bool* wrote);
+    bool openFile();
+    bool syncFiles();
+    /** Renames the full segment and its index to the next number; the next line reopens. */
+    void rollSegment();
+
+    const QString m_path;
+    const QFile::Permissions m_permissions;
+    QFile m_file;  // flusher thread only, as are the next four
+    QFile m_index;
+    qint64 m_size = 0;
+    qint64 m_lastMsecs = 0;
+    QByteArray m_lastHash;
+    std::atomic<Node*> m_head{nullptr};
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    bool m_stop = false;  // guarded by m_wakeMutex
+    std::thread m_thread;
+};
+
+} // namespace FlashSpartan
@@ -1,17 +1,37 @@
 #pragma once
 
+#include "BadUsbRuleSet.h"
+#include "HidConnectCounter.h"
+#include "HidKeystrokeAnalyzer.h"
 #include "Types.h"
 
 #include <optional>
 
 namespace FlashSpartan::BadUsbAnalyzer {
 
+/**
+ * The anomaly for the rule of @p rules that wins for this connect, if any. @p connects has
+ * the current connect recorded already.
+ */
+BadUsbAnomalyResult analyzeConnect(const HidDeviceInfo& device,
+                                   const std::optional<BadUsbBaselineEntry>& baseline,
+                                   const QStringList& relatedStorageNodes,
+                                   const HidConnectCounter& connects,
+                                   qint64 nowSecs,
+                                   const BadUsbRuleSet& rules);
+
+/** Built-in rules only, with @p recentConnectCount connects in the last ten seconds. */
 BadUsbAnomalyResult analyzeConnect(const HidDeviceInfo& device,
                                    const std::optional<BadUsbBaselineEntry>& baseline,
                                    const QStringList& relatedStorageNodes,
                                    int recentConnectCount,
                                    const AppSettings& settings);
 
+/** The anomaly for a HidKeystrokeAnalyzer finding on @p device. */
+BadUsbAnomalyResult analyzeKeystrokeRate(const HidDeviceInfo& device,
+                                         const HidKeystrokeAnalyzer::Finding& finding,
+                                         const std::optional<BadUsbBaselineEntry>& baseline);
+
 QString severityLabel(BadUsbSeverity severity);
 
 } // namespace FlashSpartan::BadUsbAnalyzer
@@ -5,18 +5,41 @@
 #include <QObject>
 #include <QHash>
 #include <QMutex>
+
+#include <memory>
 #include <optional>
 
+class QFile;
+
 namespace FlashSpartan {
 
+/**
+ * @brief Known HID devices, as a JSON checkpoint plus an append-only journal.
+ *
+ * `badusb-baseline.json` holds the full baseline and a generation number. Each edit
+ * appends one checksummed record to `badusb-baseline.json.wal`, which names the
+ * generation it extends, so a trust click costs a small append and sync instead of
+ * rewriting thousands of entries. The journal is folded into a new checkpoint after
+ * kCheckpointEntries records, when it passes kCheckpointBytes, and on load when it has
+ * entries; replay stops at the first torn record, so a crash loses at most the edit in
+ * progress.
+ *
+ * Readers (getDevice() on every HID connect) look entries up in an immutable snapshot;
+ * the lock covers only copying its pointer, never an edit's I/O.
+ */
 class BadUsbBaselineStore : public QObject {
     Q_OBJECT
 
 public:
+    static constexpr int kCheckpointEntries = 256;
+    static constexpr qint64 kCheckpointBytes = 4 * 1024 * 1024;
+
     explicit BadUsbBaselineStore(QObject* parent = nullptr);
+    ~BadUsbBaselineStore() override;
 
     bool initialize(const QString& path = QString());
     QString baselinePath() const;
+    QString journalPath() const;
 
     QList<BadUsbBaselineEntry> allDevices() const;
     bool hasDevice(const QString& stableId) const;
@@ -25,18 +48,38 @@ public:
     bool upsertBaseline(const HidDeviceInfo& info, bool trusted = true, const QString& notes = {});
     bool setTrusted(const QString& stableId, bool trusted);
     bool removeDevice(const QString& stableId);
-    bool save() const;
+    /** Writes a full checkpoint and starts an empty journal. */
+    bool save();
     bool load();
 
+    /** Records in the journal since the last checkpoint. */
+    int journalEntries() const;
+
 signals:
     void baselineChanged();
 
 private:
+    using Snapshot = QHash<QString, BadUsbBaselineEntry>;
+
     QString defaultPath() const;
+    std::shared_ptr<const Snapshot> snapshot() const;
+    void publish(std::shared_ptr<const Snapshot> next);
+
+    // m_mutex held:
+    bool writeCheckpoint(const Snapshot& devices);
+    bool resetJournal();
+    bool appendJournal(const QByteArray& payload);
+    /** Logs @p payload, or checkpoints @p next when the journal is full or cannot be written. */
+    bool commit(const Snapshot& next, const QByteArray& payload);
 
-    mutable QMutex m_mutex;
+    mutable QMutex m_mutex;  // serializes edits; guards the path and the journal
     QString m_path;
-    QHash<QString, BadUsbBaselineEntry> m_devices;
+    quint64 m_generation = 0;
+    std::unique_ptr<QFile> m_journal;
+    int m_journalEntries = 0;
+
+    mutable QMutex m_snapshotMutex;  // guards only the m_snapshot pointer
+    std::shared_ptr<const Snapshot> m_snapshot;
 };
 
 } // namespace FlashSpartan
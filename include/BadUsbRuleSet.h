@@ -0,0 +1,130 @@
+#pragma once
+
+#include "Types.h"
+
+#include <QHash>
+#include <QJsonDocument>
+#include <QList>
+#include <QRegularExpression>
+#include <QStringList>
+
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace FlashSpartan {
+
+/** One declarative BadUSB rule; every condition that is set has to hold. */
+struct BadUsbRuleDefinition {
+    enum class Baseline {
+        Any,
+        Unknown,    // no baseline entry
+        Known,      // any baseline entry
+        Untrusted,  // no entry, or one not marked trusted
+        Trusted,
+    };
+
+    QString id;
+    BadUsbSeverity severity = BadUsbSeverity::Warning;
+    QString summary;
+    QString detail;
+    QString source;  // rule file; empty for built-in rules
+    bool allow = false;  // a match suppresses every other rule
+
+    QStringList vidPids;  // "vvvv:pppp" or "vvvv:*"; any of them
+    QStringList capabilities;  // all of them
+    QStringList fingerprints;  // HidDescriptorFingerprint hex; any of them
+    QString manufacturerPattern;
+    QString productPattern;
+    QString serialPattern;
+    QString interfacePattern;  // against each HidInterfaceInfo::signature()
+    Baseline baseline = Baseline::Any;
+    bool relatedStorage = false;
+    bool interfaceDrift = false;  // baseline descriptors or interface set differ
+    int connectsAtLeast = 0;  // connects of this device within connectsWithinSeconds
+    int connectsWithinSeconds = 0;
+
+    bool hasConditions() const;
+};
+
+/**
+ * @brief BadUSB rules compiled into a flat predicate table.
+ *
+ * Conditions shared by several rules become one predicate; VID/PID sets are folded into
+ * a single hash keyed by the device's VID/PID, so hundreds of signatures cost one lookup.
+ * match() evaluates every predicate once into a bit vector, then tests each rule's mask.
+ * The most severe matching rule wins, earlier rules break ties; a matching allow rule
+ * (a fleet's known-good descriptor fingerprints, say) suppresses them all. Immutable once
+ * compiled, so it can be shared across threads.
+ *
+ * Rule files (JSON, `{"rules": [...]}`) go in dropInDirectories(); the format is in README.md.
+ */
+class BadUsbRuleSet {
+public:
+    /** Skips rules that fail to compile (bad pattern, no conditions), with a line in @p errors. */
+    static BadUsbRuleSet compile(const QList<BadUsbRuleDefinition>& rules, QStringList* errors = nullptr);
+
+    static QList<BadUsbRuleDefinition> parse(const QJsonDocument& document, const QString& source,
+                                             QStringList* errors = nullptr);
+    /** The rules Settings → BadUSB switches on and off, in their historic order. */
+    static QList<BadUsbRuleDefinition> builtinRules(const AppSettings& settings);
+    static QStringList dropInDirectories();
+    /** Every *.json in dropInDirectories(), by file name. */
+    static QList<BadUsbRuleDefinition> loadDropIns(QStringList* errors = nullptr);
+
+    /**
+     * The winning rule for a connect of @p device, or nullptr when none matches or an allow
+     * rule does. @p connectsWithin returns how
+     * often this device connected in the last N seconds, the current connect included
+     * (HidConnectCounter::count()); it is asked once per distinct window.
+     */
+    const BadUsbRuleDefinition* match(const HidDeviceInfo& device,
+                                      const std::optional<BadUsbBaselineEntry>& baseline,
+                                      const QStringList& relatedStorageNodes,
+                                      const std::function<int(int windowSeconds)>& connectsWithin) const;
+
+    int ruleCount() const { return int(m_rules.size()); }
+    int predicateCount() const { return int(m_predicates.size()); }
+    /** Longest window passed to connectsWithin. */
+    int maxWindowSeconds() const { return m_maxWindowSeconds; }
+
+private:
+    enum class PredicateKind {
+        Capability, VidPid, Fingerprint, Pattern, Baseline, RelatedStorage, InterfaceDrift, Connects
+    };
+    enum class Field { Manufacturer, Product, Serial, Interface };
+
+    struct Predicate {
+        PredicateKind kind = PredicateKind::Capability;
+        int arg = 0;  // pattern index, baseline state, connect count
+        int arg2 = 0;  // connect window
+    };
+
+    struct Pattern {
+        Field field = Field::Product;
+        QRegularExpression regex;
+    };
+
+    struct CompiledRule {
+        int severity = 0;
+        bool allow = false;
+        std::vector<std::pair<int, quint64>> required;  // word index, bits
+    };
+
+    int intern(const QString& key, const Predicate& predicate);
+
+    QList<BadUsbRuleDefinition> m_rules;
+    std::vector<CompiledRule> m_compiled;
+    std::vector<Predicate> m_predicates;
+    std::vector<Pattern> m_patterns;
+    QHash<QString, int> m_predicateIndex;  // condition key -> predicate
+    QHash<QString, int> m_capabilityPredicates;
+    QHash<quint32, std::vector<int>> m_vidPidPredicates;  // vid << 16 | pid
+    QHash<quint16, std::vector<int>> m_vendorPredicates;  // "vvvv:*"
+    QHash<QByteArray, std::vector<int>> m_fingerprintPredicates;
+    bool m_hasAllowRules = false;
+    int m_maxWindowSeconds = 0;
+};
+
+} // namespace FlashSpartan
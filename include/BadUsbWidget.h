@@ -26,6 +26,8 @@ public:
     void removeDevice(const QString& stableId);
     void addAnomaly(const BadUsbAnomalyResult& anomaly);
     void setCaptureStatus(const QString& message);
+    /** Adds the decoded capture of @p anomaly under its alert; @p text is the tooltip. */
+    void addCaptureSummary(const BadUsbAnomalyResult& anomaly, const QString& headline, const QString& text);
 
     /** Windows: USBPcap install state for the packet-capture panel. */
     void setPacketCaptureState(bool usbPcapInstalled, bool installPending, const QString& statusMessage);
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <openssl/evp.h>
+
+namespace FlashSpartan::RawDeviceHash {
+
+/**
+ * BLAKE3 (libblake3) exposed as an EVP_MD, 32-byte default output. libblake3 spreads
+ * each update across its SIMD lanes; use ScanMode::ParallelChunked to add cores.
+ * Returns nullptr when built without libblake3.
+ */
+const EVP_MD* blake3Digest();
+
+} // namespace FlashSpartan::RawDeviceHash
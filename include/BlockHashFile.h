@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <optional>
+
+namespace FlashSpartan {
+
+/**
+ * Per-block baseline digests ("FSBH"), kept out of line from the policy store like
+ * WatchManifestFile. Sticks cloned from one golden image have identical block lists, so
+ * their records all name the same file and the store carries each list once.
+ *
+ * Little-endian: magic, version, digest width in bytes, block size, block count, then the
+ * raw digests back to back. Files are named after the SHA-256 of their contents, which the
+ * signed device record stores.
+ */
+class BlockHashFile {
+public:
+    static constexpr quint32 kMagic = 0x48425346;  // 'FSBH' little-endian
+    static constexpr quint16 kVersion = 1;
+
+    struct Blocks {
+        QStringList hashes;
+        uint64_t blockSize = 0;
+    };
+
+    /** Empty when the digests are not all hex of one width. */
+    static QByteArray encode(const QStringList& blockHashes, uint64_t blockSize);
+    static std::optional<Blocks> decode(const QByteArray& data);
+    /** Whether @p data starts like a block hash file (replication carries both kinds). */
+    static bool isEncoded(const QByteArray& data);
+
+    static QString pathFor(const QString& directory, const QString& sha256Hex);
+    /** Writes the list into @p directory and returns its SHA-256 hex, or empty on failure. */
+    static QString save(const QString& directory, const QStringList& blockHashes, uint64_t blockSize,
+                        QString* error = nullptr);
+    /** Writes a file received from a replication peer if its SHA-256 is @p sha256Hex and it parses. */
+    static bool saveEncoded(const QString& directory, const QByteArray& data, const QString& sha256Hex,
+                            QString* error = nullptr);
+
+    /**
+     * The list stored as @p sha256Hex; nullopt when missing, altered or malformed. Decoded
+     * lists are cached by digest, so every record of one golden image shares one copy.
+     */
+    static std::optional<Blocks> load(const QString& directory, const QString& sha256Hex);
+    /** Drops the decoded lists (tests, and after pruning files). */
+    static void clearCache();
+};
+
+} // namespace FlashSpartan
@@ -19,8 +19,10 @@ class BlockedDriveStore {
 public:
     static BlockedDriveStore& instance();
 
+    /** Pulls block changes since the last call; after the first, policyd pushes them too. */
     void refreshFromGateway();
 
+    /** Two hash lookups; this runs on every connect, before anything is mounted. */
     bool isBlocked(const QString& driveKey, const QString& uniqueId = {}) const;
 
     void block(const QString& driveKey, const QString& uniqueId, const QString& label = {});
@@ -29,11 +31,22 @@ public:
     QList<BlockedDriveEntry> entries() const;
     QSet<QString> blockedDriveKeys() const;
     QSet<QString> blockedUniqueIds() const;
+    /** Moves each time the block list is replaced; compare it to tell a cached isBlocked() is current. */
+    quint64 listGeneration() const { return m_listGeneration; }
 
 private:
     BlockedDriveStore() = default;
 
+    /** Replaces the cached list and rebuilds the key sets isBlocked() looks in. */
+    void setEntries(const QList<BlockedDriveEntry>& entries);
+
     QList<BlockedDriveEntry> m_entries;
+    QSet<QString> m_driveKeys;
+    QSet<QString> m_uniqueIds;
+    const void* m_gateway = nullptr;  // the gateway m_entries and the cursor belong to
+    quint64 m_epoch = 0;
+    quint64 m_generation = 0;
+    quint64 m_listGeneration = 0;
 };
 
 } // namespace FlashSpartan
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Types.h"
+
+#include <QString>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace FlashSpartan {
+
+/**
+ * Read-only check for counterfeit capacity. Fake sticks report a size far larger than their
+ * flash and either drop the high address bits, so the start of the device reappears at
+ * every multiple of the real size, or fail every read past the real end. The probe reads
+ * the start of the device, a window at each power of two below the claimed size and a
+ * sparse grid of single sectors across it, with several reads in flight; a 256 GB claim
+ * costs about 60 MB of reads.
+ *
+ * It never writes to the device. Aliasing only shows when the start of the device holds
+ * data (a partition table, a filesystem); on a blank stick the verdict is Inconclusive
+ * rather than a guess.
+ */
+namespace CapacityProbe {
+
+inline constexpr uint64_t kSectorBytes = 4096;
+/** Head window, and the window read at each power-of-two offset. */
+inline constexpr uint64_t kWindowBytes = 4ULL * 1024 * 1024;
+/** Smallest real size looked for. */
+inline constexpr uint64_t kMinPeriodBytes = 16ULL * 1024 * 1024;
+/** Single-sector reads spread evenly over the claimed size, for an unreadable tail. */
+inline constexpr int kGridReads = 64;
+/**
+ * Distinct head sectors that must reappear at one consistent offset to call it aliasing;
+ * at least half of the head's distinct sectors must, too.
+ */
+inline constexpr int kMinAliasSectors = 2;
+inline constexpr int kMaxReaders = 16;
+
+/**
+ * Reads exactly @p length bytes at @p offset into @p buffer; false on a read error.
+ * Offsets, lengths and the buffer are kSectorBytes aligned, so O_DIRECT reads are legal.
+ * Called from several threads at once.
+ */
+using ReadAt = std::function<bool(uint64_t offset, char* buffer, size_t length)>;
+
+/** Offsets of the power-of-two windows for a device of @p claimedBytes, ascending. */
+std::vector<uint64_t> periodOffsets(uint64_t claimedBytes);
+
+/** Offsets of the grid reads, ascending and sector aligned; the last is the final sector. */
+std::vector<uint64_t> gridOffsets(uint64_t claimedBytes);
+
+/** Probes a device of @p claimedBytes through @p readAt with up to @p readers reads in flight. */
+CapacityCheck run(uint64_t claimedBytes, const ReadAt& readAt, int readers = kMaxReaders);
+
+/** Opens @p deviceNode directly (O_DIRECT on Linux) and probes it; Inconclusive when it cannot be opened. */
+CapacityCheck probeDevice(const QString& deviceNode);
+
+/** One line for logs and alerts: the verdict, the claimed size and what the probe found. */
+QString describe(const CapacityCheck& check);
+
+} // namespace CapacityProbe
+
+} // namespace FlashSpartan
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+
+namespace FlashSpartan {
+
+/**
+ * @brief Keeps the BadUSB capture directory bounded.
+ *
+ * archive() runs once per finished capture, on a worker thread. A capture whose
+ * UsbCaptureSummary::contentDigest matches one already kept is deleted, and the kept one
+ * counts the recurrence. Otherwise it is compressed in place: zstd (`.zst`) when built with
+ * libzstd, else gzip (`.gz`) with zlib, else left as is. enforce() then drops captures
+ * older than the age limit and, oldest first, whatever exceeds the quota. Files written in
+ * the last kActiveGraceSeconds are never removed, because the capture that is still running
+ * lives in the same directory.
+ *
+ * Digests and recurrence counts are kept in `retention.json` in the directory. All calls
+ * for a directory are serialized, so they are safe from any thread.
+ */
+class CaptureRetention {
+public:
+    static constexpr int kActiveGraceSeconds = 120;
+
+    struct Policy {
+        qint64 quotaBytes = 512LL * 1024 * 1024;  // 0: no quota
+        int maxAgeDays = 30;  // 0: keep forever
+        bool compress = true;
+        bool deduplicate = true;
+    };
+
+    struct ArchiveResult {
+        QString path;  // where the capture is now; empty when it was folded into duplicateOf
+        QString duplicateOf;  // earlier capture with the same content
+        bool compressed = false;
+        int removed = 0;  // captures dropped by enforce()
+        QString error;
+    };
+
+    struct Usage {
+        int captures = 0;
+        qint64 bytes = 0;
+        int compressed = 0;
+        int recurrences = 0;  // duplicate captures folded into kept ones
+        QDateTime oldestUtc;
+
+        /** "12 captures, 34.5 MiB (10 compressed, 3 repeats folded)". */
+        QString text() const;
+    };
+
+    static ArchiveResult archive(const QString& directory, const QString& capturePath,
+                                 const QByteArray& contentDigest, const Policy& policy,
+                                 const QDateTime& nowUtc = QDateTime::currentDateTimeUtc());
+    /** Applies the age limit and quota; returns how many captures were removed. */
+    static int enforce(const QString& directory, const Policy& policy,
+                       const QDateTime& nowUtc = QDateTime::currentDateTimeUtc());
+    static Usage usage(const QString& directory);
+
+    /** ".zst", ".gz", or empty when this build cannot compress. */
+    static QString compressedSuffix();
+    /** Writes @p path + compressedSuffix() and removes @p path; keeps its modification time. */
+    static bool compressFile(const QString& path, QString* compressedPath, QString* error = nullptr);
+};
+
+} // namespace FlashSpartan
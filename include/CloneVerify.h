@@ -0,0 +1,56 @@
+#pragma once
+
+#include "RawDeviceHash.h"
+#include "Types.h"
+
+#include <QString>
+
+#include <atomic>
+#include <cstdint>
+
+namespace FlashSpartan::CloneVerify {
+
+/**
+ * Duplicator check: one master against many clones written from it. The master (an image
+ * file or a device) is read once into kDefaultChunkBytes block digests; every clone is then
+ * a chunked full read of the master's length with those digests as its baseline, so a bad
+ * clone ends at its first differing block instead of reading to the end.
+ */
+
+/** Block digests of the master image file or device; @p lengthOut receives its size. */
+HashResult hashMaster(const QString& path, RawDeviceHash::Algorithm algorithm,
+                      std::atomic<bool>* cancelled, std::atomic<uint64_t>* bytesProcessed,
+                      uint64_t* lengthOut);
+
+/** Reads the first @p masterLength bytes of @p deviceNode against @p master's blocks. */
+HashResult hashClone(const QString& deviceNode, const HashResult& master, uint64_t masterLength,
+                     RawDeviceHash::Algorithm algorithm, std::atomic<bool>* cancelled,
+                     std::atomic<uint64_t>* bytesProcessed);
+
+enum class Verdict { Match, Mismatch, Error };
+
+struct CloneVerdict {
+    Verdict verdict = Verdict::Error;
+    /** Mismatch: first block that differs from the master; -1 otherwise. */
+    qint64 firstBadBlock = -1;
+};
+
+/** Compares a finished hashClone() with the master it was read against. */
+CloneVerdict judgeClone(const HashResult& master, const HashResult& clone);
+
+QString verdictName(Verdict verdict);
+
+/**
+ * USB host controller ("usb3", as HashWorker keys it) and controller-local root port of
+ * a block device, from its /sys/class/block path; both empty when it is not behind USB.
+ */
+struct UsbPlacement {
+    QString controller;
+    QString rootPort;
+};
+
+UsbPlacement usbPlacement(const QString& deviceNode);
+/** usbPlacement() for an already resolved sysfs device path. */
+UsbPlacement usbPlacementFromSysPath(const QString& sysPath);
+
+} // namespace FlashSpartan::CloneVerify
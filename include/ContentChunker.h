@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace FlashSpartan {
+
+/**
+ * @brief Content-defined chunk boundaries (FastCDC-style gear hash, normalized chunking).
+ *
+ * Boundaries depend only on the bytes around them, so an insertion or edit moves only the
+ * chunks it touches and the rest keep their digests. Streaming: feed the file in any
+ * buffer sizes and the boundaries come out the same. The gear table and masks are part of
+ * the stored manifest format; changing them changes every chunk list.
+ */
+class ContentChunker {
+public:
+    struct Params {
+        size_t minSize = 256 * 1024;
+        size_t avgSize = 1024 * 1024;  // must be a power of two
+        size_t maxSize = 4 * 1024 * 1024;
+    };
+
+    ContentChunker();
+    explicit ContentChunker(const Params& params);
+
+    /**
+     * How many of the @p len bytes at @p data belong to the current chunk. @p boundary is
+     * set when the chunk ends after them; the next call starts a new chunk.
+     */
+    size_t scan(const unsigned char* data, size_t len, bool* boundary);
+
+    /** Forget the current chunk, e.g. between files. */
+    void reset();
+
+    const Params& params() const { return m_params; }
+
+private:
+    Params m_params;
+    uint64_t m_maskSmall = 0;  // before avgSize: harder to cut
+    uint64_t m_maskLarge = 0;  // after avgSize: easier to cut
+    uint64_t m_hash = 0;
+    size_t m_chunkLength = 0;
+};
+
+} // namespace FlashSpartan
@@ -5,7 +5,10 @@
 #include <QHash>
 #include <QReadWriteLock>
 #include <QString>
+#include <QStringList>
 #include <QDateTime>
+#include <QFuture>
+#include <QTimer>
 #include <memory>
 #include <optional>
 
@@ -13,6 +16,11 @@
 
 namespace FlashSpartan {
 
+namespace Policy {
+class PolicyGateway;
+struct PolicyDelta;
+} // namespace Policy
+
 /**
  * @brief DatabaseManager - Thread-safe persistent storage for device records
  * 
@@ -36,6 +44,26 @@ public:
         qint64 fileSizeBytes = 0;
     };
 
+    /**
+     * @brief What list views show about a record
+     *
+     * Leaves out the watch manifest and the block digests, which can dwarf the rest of
+     * the record; load those with watchManifest() and blockHashesFor().
+     */
+    struct DeviceSummary {
+        QString uniqueId;
+        QString notes;
+        DeviceInfo lastKnownInfo;
+        int trustLevel = 0;
+        bool autoMount = false;
+        bool hasHash = false;
+        QDateTime lastSeen;
+        QDateTime lastHashed;
+        VerificationProfile verificationProfile = VerificationProfile::WatchManifest;
+
+        static DeviceSummary of(const DeviceRecord& record);
+    };
+
     explicit DatabaseManager(QObject* parent = nullptr);
     ~DatabaseManager() override;
 
@@ -72,7 +100,24 @@ public:
 
     bool hasDevice(const DeviceInfo& device) const;
     QString canonicalUniqueId(const DeviceInfo& device) const;
+    /**
+     * Moves whenever records change other than by updateLastSeen(), so whoever caches what
+     * it derives from them can compare one number instead of following every signal.
+     */
+    quint64 recordGeneration() const;
+    /**
+     * Stores @p manifest with its file list out of line (see WatchManifestFile); the record
+     * keeps groups and roots plus the file's digest. A manifest that already only carries
+     * that digest is stored as it is.
+     */
     bool updateWatchManifest(const QString& uniqueId, const WatchManifest& manifest);
+    /**
+     * @p record's watch manifest with its file list loaded; nullopt when the out-of-line
+     * file is missing or does not match the digest in the record.
+     */
+    std::optional<WatchManifest> watchManifestFor(const DeviceRecord& record) const;
+    /** Directory holding the out-of-line watch manifest and block digest files. */
+    static QString watchManifestDirectory();
     bool setVerificationProfile(const QString& uniqueId, VerificationProfile profile);
 
     /**
@@ -89,6 +134,23 @@ public:
      */
     QList<DeviceRecord> getAllDevices() const;
 
+    /**
+     * @brief Get a summary of every device record
+     */
+    QList<DeviceSummary> getDeviceSummaries() const;
+
+    /**
+     * @brief Load a device's watch manifest, file list included
+     * @return nullopt when the device is unknown or its manifest file is missing or stale
+     */
+    std::optional<WatchManifest> watchManifest(const QString& uniqueId) const;
+
+    /**
+     * @p record's per-block digests, loaded from the shared out-of-line file when the record
+     * only carries its digest; empty when there are none or the file is missing or altered.
+     */
+    static QStringList blockHashesFor(const DeviceRecord& record, uint64_t* blockSize = nullptr);
+
     /**
      * @brief Get devices matching a filter
      * @param filter Lambda that returns true for matching devices
@@ -153,6 +215,78 @@ public:
                     const QString& hashScope = QString(),
                     const QString& hashScanMode = QString());
 
+    /**
+     * @brief Store the non-cryptographic pre-screen digest next to the baseline
+     *
+     * updateHash() clears it whenever the baseline hash changes, so a stored
+     * pre-screen always describes the same content as the current baseline.
+     * @param uniqueId Device identifier
+     * @param hash XXH3-128 digest of the baseline target
+     * @param algorithm Pre-screen algorithm name
+     * @return true if updated
+     */
+    bool updatePrescreenHash(const QString& uniqueId, const QString& hash,
+                             const QString& algorithm = "XXH3-128");
+
+    /**
+     * @brief Store the per-block digests the baseline hash was folded from
+     *
+     * Like the pre-screen, they are cleared by updateHash() when the baseline changes. The
+     * list is stored out of line by content (BlockHashFile), so identical sticks share it.
+     * @param uniqueId Device identifier
+     * @param blockHashes Block digests in device order
+     * @param blockSize Bytes per block
+     * @return true if updated
+     */
+    bool updateBlockHashes(const QString& uniqueId, const QStringList& blockHashes,
+                           uint64_t blockSize);
+
+    /**
+     * @brief Remember the probed best read buffer for a device
+     * @param uniqueId Device identifier
+     * @param bufferSizeKB Winning buffer size from RawDeviceHash::autoTuneBufferSize
+     * @return true if updated
+     */
+    bool updateTunedBufferSize(const QString& uniqueId, int bufferSizeKB);
+
+    /**
+     * @brief Probed buffer size of the most recently seen record with this vendor/model
+     * @return Buffer size in KB, or 0 when no drive of that model has been probed
+     */
+    int tunedBufferSizeForModel(const QString& vendor, const QString& model) const;
+
+    /**
+     * @brief Store a device's rolling read-speed profile
+     * @param uniqueId Device identifier
+     * @param profile Profile from ReadHealth::advance()
+     * @return true if updated
+     */
+    bool updateReadProfile(const QString& uniqueId, const ReadProfile& profile);
+
+    /**
+     * @brief Store the outcome of a counterfeit-capacity probe
+     * @param uniqueId Device identifier
+     * @param check Result of CapacityProbe::probeDevice()
+     * @return true if updated
+     */
+    bool updateCapacityCheck(const QString& uniqueId, const CapacityCheck& check);
+
+    /**
+     * @brief Store or clear the seal taken when the device was ejected after a passing verify
+     * @param uniqueId Device identifier
+     * @param seal Result of EjectSealProbe::captureDevice(), or an empty seal to clear it
+     * @return true if updated
+     */
+    bool updateEjectSeal(const QString& uniqueId, const EjectSeal& seal);
+
+    /**
+     * @brief Store the partition table and file system fingerprint taken with the baseline
+     * @param uniqueId Device identifier
+     * @param fingerprint Result of LayoutProbe::captureDevice()
+     * @return true if updated
+     */
+    bool updateLayoutFingerprint(const QString& uniqueId, const LayoutFingerprint& fingerprint);
+
     /**
      * @brief Get the stored hash for a device
      * @param uniqueId Device identifier
@@ -190,9 +324,24 @@ public:
     /**
      * @brief Update last seen timestamp for a device
      * @param uniqueId Device identifier
+     *
+     * Last-seen times are bookkeeping, not policy: the new time is visible right away but
+     * only reaches the signed store with the next flushVolatileFields(), which runs
+     * kVolatileFlushMs after the first pending update and on destruction.
      */
     bool updateLastSeen(const QString& uniqueId);
 
+    /**
+     * @brief Write pending last-seen times to the policy store in one commit
+     * @return false when the commit failed; the times stay pending for the next flush
+     */
+    bool flushVolatileFields();
+
+    /**
+     * @brief Number of records with a last-seen time not yet in the policy store
+     */
+    int pendingVolatileCount() const;
+
     // ========================================================================
     // Persistence Operations
     // ========================================================================
@@ -269,11 +418,28 @@ public:
      */
     QStringList validateIntegrity() const;
 
+    /**
+     * @brief validateIntegrity() as a background job
+     *
+     * Runs on a snapshot taken under a brief read lock; records are checked in parallel
+     * (baseline and pre-screen digest format, watch manifest root recomputed from the
+     * group roots).
+     */
+    QFuture<QStringList> validateIntegrityAsync() const;
+
     /**
      * @brief Compact the database (remove redundant data)
      */
     void compact();
 
+    /**
+     * @brief compact() as a background job
+     *
+     * Finds redundant records on a snapshot, then removes them in one policy commit and
+     * resyncs. Resolves to the number of records removed.
+     */
+    QFuture<int> compactAsync();
+
 signals:
     /**
      * @brief Emitted when a device is added
@@ -337,9 +503,27 @@ private:
      */
     void markModified();
 
+    /** Ids a pushed delta added, changed or removed. */
+    struct PolicyChanges {
+        QStringList added;
+        QStringList updated;
+        QStringList removed;
+    };
+
     void syncFromPolicyGateway();
+    /** Merges @p delta into m_devices (write lock held); @p changes, when set, gets what differed. */
+    void applyPolicyDelta(const Policy::PolicyDelta& delta, PolicyChanges* changes);
+    void onPolicyChanged(const Policy::PolicyDelta& delta);
     bool persistDevice(const DeviceRecord& record, const QString& reason);
     bool persistRecordById(const QString& uniqueId, const QString& reason);
+    /** Starts the volatile flush timer unless it is running; any thread. */
+    void scheduleVolatileFlush();
+    /** @p stored with its out-of-line file list loaded (see watchManifestFor()). */
+    static std::optional<WatchManifest> loadWatchManifest(const WatchManifest& stored);
+    void migrateInlineWatchManifests();
+    void migrateInlineBlockHashes();
+    /** Removes watch manifest and block digest files no record refers to. */
+    void pruneOutOfLineFiles();
     QString policyActor() const;
 
     // Database file path
@@ -347,6 +531,15 @@ private:
 
     // Device records (uniqueId -> record)
     QHash<QString, DeviceRecord> m_devices;
+    // Policy store state m_devices mirrors (PolicyGateway::changesSince)
+    quint64 m_policyEpoch = 0;
+    quint64 m_policyGeneration = 0;
+    quint64 m_recordGeneration = 0;  // recordGeneration()
+    Policy::PolicyGateway* m_changeFeedGateway = nullptr;
+    QFuture<int> m_compaction;
+    // Last-seen times not yet committed (stored id -> time); kept over policy syncs
+    QHash<QString, QDateTime> m_pendingLastSeen;
+    QTimer m_volatileFlushTimer;
 
     // Thread safety
     mutable QReadWriteLock m_lock;
@@ -360,6 +553,7 @@ private:
 
     // Configuration
     static constexpr int MAX_BACKUP_COUNT = 5;
+    static constexpr int kVolatileFlushMs = 5 * 60 * 1000;
     static constexpr const char* DB_VERSION = "1.0";
 };
 
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "DigestAlgorithm.h"
+
+#include <QString>
+
+namespace FlashSpartan {
+
+/**
+ * SHA-256 (or any DigestAlgorithm) of the decompressed payload of a compressed image (`.img.xz`, `.img.zst`, `.img.gz`,
+ * or the image inside a `.zip`), decoded in-process. Decoding runs on its own thread and feeds
+ * the digest through a buffer ring, so neither waits on the other; no temp files or external
+ * processes. Formats are a table of ImageDecoders openers; each is compiled in when its
+ * library (liblzma, libzstd, zlib) is found.
+ */
+class DecompressedImageHash {
+public:
+    /** Recognised compressed suffix whose decoder is built in. */
+    static bool canDecode(const QString& fileName);
+
+    /** Lowercase hex digest, or empty with @p errorOut set. */
+    static QString sha256(const QString& path, QString* errorOut = nullptr);
+
+    /** Every digest in @p algorithms over one decode; false with @p errorOut set. */
+    static bool digests(const QString& path, DigestAlgorithms algorithms, DigestValues* out,
+                        QString* errorOut = nullptr);
+};
+
+} // namespace FlashSpartan
@@ -15,6 +15,8 @@
 
 namespace FlashSpartan {
 
+class StatusDot;
+
 /**
  * @brief DeviceCard - Futuristic card widget displaying USB device information
  * 
@@ -96,6 +98,11 @@ public:
     void setHashEta(double etaSeconds);
     void setHashBytes(quint64 processed, quint64 total);
 
+    /**
+     * @brief Show a running hash as paused or running; the pause button toggles to match
+     */
+    void setHashPaused(bool paused);
+
     /**
      * @brief Set display mode
      */
@@ -162,6 +169,7 @@ signals:
      */
     void rehashRequested(const QString& deviceNode);
     void cancelHashRequested(const QString& deviceNode);
+    void pauseHashRequested(const QString& deviceNode, bool pause);
 
     /**
      * @brief Emitted when user accepts a new fingerprint after modification
@@ -192,6 +200,8 @@ protected:
     void mouseDoubleClickEvent(QMouseEvent* event) override;
     void paintEvent(QPaintEvent* event) override;
     void resizeEvent(QResizeEvent* event) override;
+    void showEvent(QShowEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
 
 private slots:
     void onMountClicked();
@@ -200,9 +210,18 @@ private slots:
     void onRehashClicked();
     void onAcceptClicked();
     void onWatchListClicked();
-    void updatePulse();
 
 private:
+    /**
+     * @brief Advance the pulse to @p elapsedMs on the shared AnimationClock
+     */
+    void updatePulse(qint64 elapsedMs);
+
+    /**
+     * @brief Follow the shared clock only while pulsing and shown
+     */
+    void updatePulseSubscription();
+
     /**
      * @brief Initialize the UI components
      */
@@ -247,7 +266,7 @@ private:
     // UI Components - Header
     QLabel* m_iconLabel = nullptr;
     QLabel* m_nameLabel = nullptr;
-    QLabel* m_statusIndicator = nullptr;
+    StatusDot* m_statusIndicator = nullptr;
     QLabel* m_statusLabel = nullptr;
 
     // UI Components - Info
@@ -266,7 +285,9 @@ private:
     QLabel* m_progressLabel = nullptr;
     QLabel* m_speedLabel = nullptr;
     QLabel* m_etaLabel = nullptr;
+    QPushButton* m_pauseHashBtn = nullptr;
     QPushButton* m_cancelHashBtn = nullptr;
+    bool m_hashPaused = false;
 
     // UI Components - Actions
     QWidget* m_actionsWidget = nullptr;
@@ -288,19 +309,18 @@ private:
     QGraphicsDropShadowEffect* m_glowEffect = nullptr;
     QPropertyAnimation* m_glowAnimation = nullptr;
     QPropertyAnimation* m_hoverAnimation = nullptr;
-    QTimer* m_pulseTimer = nullptr;
 
     // Animation state
     qreal m_glowIntensity = 0.0;
     qreal m_hoverProgress = 0.0;
-    int m_pulsePhase = 0;
+    bool m_pulsing = false;
 
     // Configuration
     static constexpr int CARD_PADDING = 16;
     static constexpr int ICON_SIZE = 48;
     static constexpr int STATUS_INDICATOR_SIZE = 12;
     static constexpr int ANIMATION_DURATION = 200;
-    static constexpr int PULSE_INTERVAL = 50;
+    static constexpr int PULSE_PERIOD_MS = 5000;
 };
 
 } // namespace FlashSpartan
\ No newline at end of file
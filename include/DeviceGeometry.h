@@ -0,0 +1,99 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace FlashSpartan {
+
+/** What a block device reports about itself; 0 / false = unknown. */
+struct DeviceGeometry {
+    uint64_t sizeBytes = 0;
+    int logicalSectorBytes = 0;
+    int physicalSectorBytes = 0;
+    int optimalIoKB = 0;   // most USB bridges report 0
+    int maxSectorsKB = 0;  // largest single request the driver issues
+    bool rotational = false;
+    /** Link speed of the USB device the disk hangs off, in Mbit/s; 0 when not USB. */
+    int usbSpeedMbps = 0;
+
+    bool isEmpty() const { return sizeBytes == 0; }
+};
+
+/**
+ * Geometry and open read-only descriptors of block devices, shared by every worker in the
+ * process. Geometry is probed once per device (ioctl and sysfs, at connect) and kept until
+ * the device goes away; descriptors are reference counted, so jobs on one device share a
+ * single open and the last handle released closes it.
+ *
+ * Entries are keyed by node and checked against the node's device number on every lookup,
+ * so a node reused by the next stick is probed again rather than answered from the old one.
+ */
+class DeviceGeometryCache {
+public:
+    /** How devices are opened and probed; tests pass their own. */
+    struct Backend {
+        std::function<int(const QString& deviceNode)> open;
+        std::function<void(int fd)> close;
+        std::function<DeviceGeometry(int fd, const QString& deviceNode)> probe;
+        /** Device number behind the node, 0 when it is gone. */
+        std::function<quint64(const QString& deviceNode)> identity;
+    };
+
+    /** Shares one open descriptor of a device; copies share it too. */
+    class Handle {
+    public:
+        Handle() = default;
+
+        bool isOpen() const { return m_open != nullptr; }
+        int fd() const;
+
+    private:
+        friend class DeviceGeometryCache;
+        struct Open;
+        explicit Handle(std::shared_ptr<const Open> open) : m_open(std::move(open)) {}
+
+        std::shared_ptr<const Open> m_open;
+    };
+
+    /** RawDeviceHash::openDevice() and friends, with sysfs on Linux. */
+    static Backend systemBackend();
+    static DeviceGeometryCache& instance();
+
+    explicit DeviceGeometryCache(Backend backend = systemBackend());
+
+    /** Cached geometry of @p deviceNode, probed first if needed; empty when it cannot be opened. */
+    DeviceGeometry geometry(const QString& deviceNode);
+    /** Opens @p deviceNode, or shares the descriptor already open; !isOpen() on failure. */
+    Handle acquire(const QString& deviceNode);
+    /** Drops the geometry of a removed device; open handles keep their descriptor. */
+    void forget(const QString& deviceNode);
+
+    bool contains(const QString& deviceNode) const;
+
+    /**
+     * Geometry from sysfs: @p blockDir is the device's /sys/class/block entry, resolved. A
+     * partition's queue attributes are its disk's, one level up, and the USB link speed is
+     * that of the nearest ancestor with an idVendor. Size and sectors come from ioctl.
+     */
+    static void readSysfs(const QString& blockDir, DeviceGeometry* geometry);
+
+private:
+    struct Entry {
+        quint64 identity = 0;
+        DeviceGeometry geometry;
+        std::weak_ptr<const Handle::Open> open;
+    };
+
+    Handle acquireLocked(const QString& deviceNode, quint64 identity);
+
+    Backend m_backend;
+    mutable QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+};
+
+} // namespace FlashSpartan
@@ -1,11 +1,14 @@
 #pragma once
 
+#include "RecordTableModel.h"
 #include "UiEventTypes.h"
+#include "VerifyRollup.h"
 
 #include <QWidget>
 
 class QComboBox;
-class QTableWidget;
+class QLabel;
+class QTableView;
 
 namespace FlashSpartan {
 
@@ -19,7 +22,12 @@ public:
     void setSelectedDevice(const QString& deviceNode);
     QString selectedDeviceNode() const;
 
+    /** Verification counts and last result of the selected device, from the history rollup. */
+    void setDeviceSummary(const VerifyRollup::DeviceSummary& summary);
+    /** Newest first. */
     void setEvents(const QList<UiEventEntry>& events);
+    /** Adds an event at the top when it belongs to the selected device. */
+    void addEvent(const UiEventEntry& event);
 
 signals:
     void deviceSelectionChanged(const QString& deviceNode);
@@ -27,15 +35,16 @@ signals:
 
 private slots:
     void onDeviceComboChanged(int index);
-    void onEventDetailsClicked();
+    void onEventClicked(const QModelIndex& index);
 
 private:
     void setupUi();
     void applyTableLayout();
 
     QComboBox* m_deviceCombo = nullptr;
-    QTableWidget* m_eventsTable = nullptr;
-    QList<UiEventEntry> m_eventRows;
+    QLabel* m_summaryLabel = nullptr;
+    QTableView* m_eventsTable = nullptr;
+    RecordTableModel<UiEventEntry>* m_eventsModel = nullptr;
 };
 
 } // namespace FlashSpartan
@@ -4,23 +4,26 @@
 #include <QMutex>
 #include <QHash>
 #include <QSet>
+#include <QStringList>
 #include <memory>
 #include <atomic>
 
 #include "Types.h"
 
 struct udev;
-struct udev_monitor;
 struct udev_device;
 
 namespace FlashSpartan {
 
+struct UdevRecord;
+
 /**
  * @brief DeviceMonitor - Monitors USB block devices via libudev
  * 
- * Runs in a dedicated thread and emits signals when USB storage devices
- * are connected or disconnected. Uses poll() for efficient event waiting
- * without busy-looping.
+ * Emits signals when USB storage devices are connected or disconnected.
+ * On Linux, events come from the shared UdevReactor thread (one netlink
+ * socket and epoll loop for every monitor); on Windows it polls in its own
+ * thread.
  * 
  * Thread-safe: All public methods can be called from any thread.
  */
@@ -58,6 +61,15 @@ public:
      */
     QList<DeviceInfo> connectedDevices() const;
 
+    /** deviceNode -> the partition as last read; each published set is immutable. */
+    using DeviceSet = QHash<QString, DeviceHandle>;
+
+    /**
+     * @brief The current device set, without locking
+     * Readers keep the snapshot they got; rescans and udev bursts publish a new one.
+     */
+    std::shared_ptr<const DeviceSet> devices() const;
+
     /**
      * @brief Get device info by device node
      * @param deviceNode e.g., "/dev/sdb1"
@@ -70,12 +82,20 @@ public:
      */
     void rescan();
 
+    /**
+     * @brief Handle a recorded block event (UdevEventTrace) as if udev had delivered it
+     * Runs on the caller's thread, whose event loop must run for the debounced flush; the
+     * debounce window shrinks by @p speed like the replay's clock. Linux only; the monitor
+     * need not be started.
+     */
+    void replayEvent(const UdevRecord& event, double speed = 1.0);
+
 signals:
     /**
      * @brief Emitted when a USB partition is connected
      * Note: This is emitted for each partition, not each physical device.
      */
-    void deviceConnected(const FlashSpartan::DeviceInfo& device);
+    void deviceConnected(const FlashSpartan::DeviceHandle& device);
 
     /**
      * @brief Emitted when a USB partition is disconnected
@@ -85,7 +105,7 @@ signals:
     /**
      * @brief Emitted when device properties change (e.g., mount status)
      */
-    void deviceChanged(const FlashSpartan::DeviceInfo& device);
+    void deviceChanged(const FlashSpartan::DeviceHandle& device);
 
     /**
      * @brief Emitted when a monitoring error occurs
@@ -118,50 +138,66 @@ private:
     void scanExistingDevices();
 
     /**
-     * @brief Process a udev event
+     * @brief Queue a udev event; events for one node within DEBOUNCE_MS are coalesced
      */
     void processUdevEvent(struct udev_device* dev);
 
     /**
-     * @brief Extract device information from udev_device
+     * @brief Add @p dev (live or replayed) to the pending burst and schedule its flush
      */
-    DeviceInfo extractDeviceInfo(struct udev_device* dev);
+    template <typename Device>
+    void queueEvent(Device dev, std::shared_ptr<const UdevRecord> replayed, double speed);
 
     /**
-     * @brief Check if a udev_device is a USB storage partition
+     * @brief Re-read each node of the collected burst once and emit the results together
      */
-    bool isUsbStoragePartition(struct udev_device* dev);
+    void flushPendingEvents();
 
     /**
-     * @brief Get the parent USB device
+     * @brief Extract device information from a udev_device or a replayed UdevRecord
      */
-    struct udev_device* getUsbParent(struct udev_device* dev);
+    template <typename Device>
+    DeviceInfo extractDeviceInfo(Device dev);
 
     /**
-     * @brief Get a udev property safely
+     * @brief Check if a udev_device or a replayed UdevRecord is a USB storage partition
      */
-    QString getProperty(struct udev_device* dev, const char* key);
+    template <typename Device>
+    bool isUsbStoragePartition(Device dev);
 
     /**
-     * @brief Get a udev sysattr safely
+     * @brief Make @p next the current device set; caller holds m_devicesMutex
      */
-    QString getSysAttr(struct udev_device* dev, const char* key);
+    void publish(std::shared_ptr<const DeviceSet> next);
 
-    // Udev handles
+    // Udev handles (Linux): the reactor's context and our subscription to it
     struct udev* m_udev = nullptr;
-    struct udev_monitor* m_monitor = nullptr;
+    int m_subscription = -1;
 
     // Thread control
     std::atomic<bool> m_running{false};
     std::atomic<bool> m_rescanRequested{false};
-    int m_wakeupPipe[2] = {-1, -1};  // For thread-safe wakeup
-
-    // Device tracking
-    mutable QMutex m_devicesMutex;
-    QHash<QString, DeviceInfo> m_devices;  // deviceNode -> DeviceInfo
+    void* m_wakeEvent = nullptr;  // Windows: volume notifications, rescan(), stop
+
+    // Device tracking: readers std::atomic_load the set, writers also hold the mutex
+    QMutex m_devicesMutex;
+    std::shared_ptr<const DeviceSet> m_devices;
+
+    // Event burst being collected (reactor thread only)
+    struct PendingEvent {
+        QByteArray sysPath;
+        bool removed = false;  // the last action seen was "remove"
+        qint64 firstEventNs = 0;  // PerfMetrics::nowNs() of the first event of the burst
+        std::shared_ptr<const UdevRecord> replayed;  // replay: the device as recorded, not re-read
+    };
+    QStringList m_pendingOrder;  // nodes in first-seen order
+    QHash<QString, PendingEvent> m_pendingEvents;
+    bool m_flushScheduled = false;
 
     // Configuration
     static constexpr int POLL_TIMEOUT_MS = 500;
+    static constexpr int IDLE_SCAN_INTERVAL_MS = 5000;  // Windows: labels, readiness
+    static constexpr int DEBOUNCE_MS = 150;
 };
 
 } // namespace FlashSpartan
\ No newline at end of file
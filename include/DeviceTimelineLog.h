@@ -3,31 +3,73 @@
 #include "UiEventTypes.h"
 
 #include <QDateTime>
+#include <QFile>
+#include <QFuture>
+#include <QHash>
 #include <QList>
+#include <QMutex>
 #include <QString>
 
 namespace FlashSpartan {
 
-/** Persistent per-device timeline (connect, verify, etc.). */
+/**
+ * Persistent per-device timeline (connect, verify, etc.), kept as append-only JSON-lines
+ * segments in device-timeline/. An append writes one line to the open segment, which is
+ * closed after kSegmentEntries entries or kSegmentDays days. Retention drops whole oldest
+ * segments once kMaxTotalEntries would still be kept without them, and runs of small
+ * closed segments are merged on a worker thread, which also zstd-compresses closed segments
+ * (.jsonl.zst) in builds that have it. Lookups go through a per-device index.
+ */
 class DeviceTimelineLog {
 public:
+    static constexpr int kMaxTotalEntries = 10000;
+    static constexpr int kSegmentEntries = 1000;
+    static constexpr int kSegmentDays = 7;
+
     static DeviceTimelineLog& instance();
+    ~DeviceTimelineLog();
 
-    void load();
+    /** Reads the segments (migrating device-timeline.json once); @p dir is for tests. */
+    void load(const QString& dir = {});
+    /** Flushes the open segment; append() has already written the entry. */
     void save();
 
     void append(const UiEventEntry& entry);
 
+    /** Newest first; an empty @p deviceNode means every device. */
     QList<UiEventEntry> entriesForDevice(const QString& deviceNode, int retentionDays,
                                         int maxEntries) const;
 
+    /** Most recently seen first. */
     QStringList knownDeviceNodes() const;
 
+    /** Waits for a running segment merge (tests, shutdown). */
+    void waitForCompaction();
+
 private:
+    struct Segment {
+        QString path;
+        qint64 startMs = 0;
+        int count = 0;
+    };
+
     DeviceTimelineLog() = default;
 
-    QList<UiEventEntry> m_entries;
-    static constexpr int kMaxTotalEntries = 10000;
+    void index(UiEventEntry entry);
+    bool openSegment(qint64 startMs);
+    void dropOldSegments();
+    void startCompaction();
+
+    QString m_dir;
+    QList<UiEventEntry> m_entries;  // oldest first
+    /** Sequence number of m_entries.first(); the index holds sequence numbers. */
+    qint64 m_firstSeq = 0;
+    QHash<QString, QList<qint64>> m_byDevice;  // oldest first
+    QFile m_open;
+    /** Guards m_segments against the merge job; the last segment is the open one. */
+    QMutex m_segmentsMutex;
+    QList<Segment> m_segments;
+    QFuture<void> m_compaction;
 };
 
 } // namespace FlashSpartan
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QFlags>
+#include <QString>
+
+namespace FlashSpartan {
+
+/** Digests publishers list for images (SHA256SUMS, SHA512SUMS, b2sums). */
+enum class DigestAlgorithm : unsigned {
+    Sha256 = 0x1,
+    Sha512 = 0x2,
+    Blake2b512 = 0x4,
+};
+Q_DECLARE_FLAGS(DigestAlgorithms, DigestAlgorithm)
+Q_DECLARE_OPERATORS_FOR_FLAGS(DigestAlgorithms)
+
+inline QString digestAlgorithmName(DigestAlgorithm algorithm)
+{
+    switch (algorithm) {
+    case DigestAlgorithm::Sha256: return QStringLiteral("SHA-256");
+    case DigestAlgorithm::Sha512: return QStringLiteral("SHA-512");
+    case DigestAlgorithm::Blake2b512: return QStringLiteral("BLAKE2b-512");
+    }
+    return QStringLiteral("SHA-256");
+}
+
+/** Lowercase hex digests of one stream; empty for algorithms that were not computed. */
+struct DigestValues {
+    QString sha256;
+    QString sha512;
+    QString blake2b512;
+
+    QString value(DigestAlgorithm algorithm) const
+    {
+        switch (algorithm) {
+        case DigestAlgorithm::Sha256: return sha256;
+        case DigestAlgorithm::Sha512: return sha512;
+        case DigestAlgorithm::Blake2b512: return blake2b512;
+        }
+        return {};
+    }
+
+    QString& slot(DigestAlgorithm algorithm)
+    {
+        switch (algorithm) {
+        case DigestAlgorithm::Sha512: return sha512;
+        case DigestAlgorithm::Blake2b512: return blake2b512;
+        case DigestAlgorithm::Sha256: break;
+        }
+        return sha256;
+    }
+};
+
+} // namespace FlashSpartan
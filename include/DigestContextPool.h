@@ -0,0 +1,58 @@
+#pragma once
+
+#include <openssl/evp.h>
+
+#include <cstddef>
+
+namespace FlashSpartan::DigestContextPool {
+
+/**
+ * SHA-256 / SHA-512 / BLAKE2b-512 fetched once per process (EVP_MD_fetch on OpenSSL 3, the
+ * built-in EVP_*() otherwise), so EVP_DigestInit_ex skips the per-call implicit provider fetch.
+ */
+const EVP_MD* sha256();
+const EVP_MD* sha512();
+const EVP_MD* blake2b512();
+
+/**
+ * An EVP_MD_CTX borrowed from this thread's pool for the lifetime of the object. Contexts
+ * are kept between uses instead of EVP_MD_CTX_new/free per digest; call EVP_DigestInit_ex
+ * before each message as usual. Must be destroyed on the thread that created it.
+ */
+class Context {
+public:
+    Context();
+    ~Context();
+
+    Context(const Context&) = delete;
+    Context& operator=(const Context&) = delete;
+
+    EVP_MD_CTX* get() const { return m_ctx; }
+    explicit operator bool() const { return m_ctx != nullptr; }
+
+private:
+    EVP_MD_CTX* m_ctx = nullptr;
+};
+
+/** One-shot digest of @p size bytes with a pooled context; @p out needs EVP_MAX_MD_SIZE. */
+bool digest(const EVP_MD* md, const void* data, std::size_t size, unsigned char* out,
+            unsigned int* outLen);
+
+struct Message {
+    const void* data = nullptr;
+    std::size_t size = 0;
+};
+
+/** Batches below this many messages per extra thread are hashed on the calling thread. */
+inline constexpr std::size_t kMinMessagesPerThread = 4096;
+inline constexpr unsigned kMaxBatchThreads = 8;
+
+/**
+ * Digests @p count independent messages with @p md; digest i is written to
+ * @p out + i * EVP_MD_size(md). OpenSSL has no public multi-buffer digest, so large
+ * batches are split into contiguous slices across up to kMaxBatchThreads threads, each
+ * hashing its slice back to back with one pooled context.
+ */
+bool digestBatch(const EVP_MD* md, const Message* messages, std::size_t count, unsigned char* out);
+
+} // namespace FlashSpartan::DigestContextPool
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "LayoutProbe.h"
+#include "Types.h"
+
+#include <QString>
+#include <cstdint>
+#include <vector>
+
+namespace FlashSpartan {
+
+/**
+ * Seal taken when FlashSpartan ejects a stick it just verified, and checked when the stick
+ * comes back. A seal is the partition table digest, the file system's own change markers
+ * (FAT and exFAT dirty flags and serials; ext mount count, last write time and lifetime
+ * write counter) and a digest of sparse windows across the volume; taking one reads about
+ * 1 MB.
+ *
+ * A match is evidence, not proof: a tool that rewrites data and then restores every marker
+ * passes it. That is why a match only gives a provisional pass and the full verify still
+ * runs, just later.
+ */
+namespace EjectSealProbe {
+
+inline constexpr uint64_t kSectorBytes = LayoutProbe::kSectorBytes;
+inline constexpr int kSamples = 16;
+inline constexpr uint64_t kSampleBytes = 64 * 1024;
+/** How long after a seal match the deferred full verify starts. */
+inline constexpr int kDeferredVerifyDelayMs = 10000;
+
+using ReadAt = LayoutProbe::ReadAt;
+
+/** Offsets of the sampled windows for a volume of @p volumeBytes, ascending and sector aligned. */
+std::vector<uint64_t> sampleOffsets(uint64_t volumeBytes);
+
+/**
+ * Seals a volume of @p volumeBytes read through @p volume; @p disk reads the whole disk it
+ * lives on, as for LayoutProbe::capture(). Empty (isEmpty()) when a read fails.
+ */
+EjectSeal capture(const ReadAt& volume, uint64_t volumeBytes, const ReadAt& disk);
+
+/** Opens both nodes directly and seals @p volumeNode; empty when either cannot be read, and on Windows. */
+EjectSeal captureDevice(const QString& volumeNode, const QString& diskNode);
+
+/** The layout part of @p seal. */
+LayoutFingerprint layoutOf(const EjectSeal& seal);
+
+/** Why @p now does not match @p sealed, for the log; empty when it does. Baselines are the caller's. */
+QString mismatch(const EjectSeal& sealed, const EjectSeal& now);
+
+} // namespace EjectSealProbe
+
+} // namespace FlashSpartan
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QString>
+
+#include <cstdint>
+#include <limits>
+
+namespace FlashSpartan {
+
+/**
+ * Where files sit on their volume, so many files on a slow stick can be read in disk order:
+ * a cheap flash controller serves one near-sequential stream far faster than reads hopping
+ * between files in path order. Only the read order uses this; hashes and Merkle leaves keep
+ * their path order.
+ */
+namespace FileExtents {
+
+inline constexpr uint64_t kUnknownOffset = std::numeric_limits<uint64_t>::max();
+
+/**
+ * Byte offset of the first extent of @p path on its volume (FIEMAP on Linux,
+ * FSCTL_GET_RETRIEVAL_POINTERS on Windows); kUnknownOffset for an empty or inline file,
+ * a file system that cannot say, and other platforms. Offsets only compare within one
+ * volume.
+ */
+uint64_t physicalOffset(const QString& path);
+
+/**
+ * True when reads on the device behind @p mountPoint pay for seeks enough that disk order
+ * is worth it: on Linux a USB link of 480 Mbit/s or slower, or a rotational disk; on
+ * Windows a device that reports a seek penalty. False when unknown.
+ */
+bool seekSensitive(const QString& mountPoint);
+
+} // namespace FileExtents
+
+} // namespace FlashSpartan
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QString>
+
+namespace FlashSpartan {
+
+/**
+ * Read-ahead hints for hashing many files one after another. While one file is hashed
+ * the kernel can already be fetching the next one, so a run of small files on a stick
+ * costs one device latency instead of one per file. The hints never change what is
+ * read; they are Linux only and do nothing elsewhere.
+ */
+namespace FileReadAhead {
+
+/** How much of the next file prefetch() asks for by default: a micro-batch's worth. */
+inline constexpr qint64 kPrefetchBytes = 8 * 1024 * 1024;
+
+/** Hints that @p fd is read front to back, so the kernel widens its read-ahead window (Linux). */
+void sequential(int fd);
+
+/**
+ * Opens @p path and asks for its first @p bytes to be read into the page cache in the
+ * background (POSIX_FADV_WILLNEED on Linux), then closes it again.
+ * Returns whether the hint was given; false for a file that cannot be opened and on
+ * other platforms.
+ */
+bool prefetch(const QString& path, qint64 bytes = kPrefetchBytes);
+
+} // namespace FileReadAhead
+
+} // namespace FlashSpartan
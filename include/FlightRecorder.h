@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+namespace FlashSpartan {
+
+/**
+ * Always-on record of the recent past, for "verification was slow yesterday".
+ *
+ * A fixed ring of kSlots slots in a file mapped shared, so what was written is on disk even
+ * when the process crashes, and the next run appends to the same ring. It keeps PerfTrace
+ * spans of kMinSpanNs or longer (installed as PerfTrace's sink, so --trace is not needed),
+ * PerfMetrics counters and gauges that changed since the last sample, warnings from the
+ * log and other notable events. Writers claim a slot with one atomic add on the mapped
+ * header and publish it by writing its sequence number last; slots caught mid-write are
+ * skipped when read.
+ */
+class FlightRecorder {
+public:
+    static constexpr quint32 kMagic = 0x52465346;  // 'FSFR' little-endian
+    static constexpr quint16 kVersion = 1;
+    static constexpr int kSlotBytes = 128;
+    /** 4 MiB; days of history at the rate slow spans and samples arrive. */
+    static constexpr int kSlots = 32767;
+    /** Shorter spans are per-buffer detail; --trace is for those. */
+    static constexpr qint64 kMinSpanNs = 20'000'000;
+    static constexpr int kLabelBytes = 86;
+
+    enum class Kind : quint8 { Span = 1, Counter = 2, Event = 3, SessionStart = 4 };
+
+    struct Entry {
+        quint64 sequence = 0;
+        Kind kind = Kind::Event;
+        /** Start of a span, or when the rest happened: microseconds since the epoch. */
+        qint64 wallUs = 0;
+        qint64 durationNs = 0;
+        qint64 value = -1;
+        /** A counter or gauge's value at the sample. */
+        double sample = 0.0;
+        quint32 pid = 0;
+        quint32 thread = 0;
+        /** "category/name" of a span, the series of a sample, "category: text" of an event. */
+        QString label;
+    };
+
+    /** Maps the ring at @p path, creating or resetting it when it is not one, and installs the sink. */
+    static bool start(const QString& path, QString* error = nullptr);
+    /** Uninstalls the sink and unmaps the ring; no thread may be recording. Tests. */
+    static void stop();
+    static bool isRunning();
+
+    /** PerfTrace's sink: keeps spans of kMinSpanNs or longer. */
+    static void span(const char* category, const char* name, qint64 beginNs, qint64 endNs, qint64 value);
+    static void event(const char* category, const QString& text, qint64 value = -1);
+    /** Records every PerfMetrics counter and gauge whose value changed since the last call. */
+    static void sampleCounters();
+
+    /** The running ring, oldest first. */
+    static QList<Entry> snapshot();
+    /** A ring file, e.g. one a crashed run left; oldest first. */
+    static QList<Entry> read(const QString& path, QString* error = nullptr);
+    /** Chrome trace-event JSON (chrome://tracing, Perfetto), timestamps in wall-clock µs. */
+    static QByteArray toTraceJson(const QList<Entry>& entries);
+};
+
+} // namespace FlashSpartan
@@ -3,10 +3,16 @@
 #include "Types.h"
 
 #include <optional>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
 #include <QList>
+#include <QMutex>
 #include <QString>
 #include <QStringList>
 
+#include <memory>
+
 namespace FlashSpartan {
 
 struct HashCheckpoint {
@@ -17,29 +23,99 @@ struct HashCheckpoint {
     uint64_t blockSize = 0;
     QStringList blockHashes;
     uint64_t bytesCompleted = 0;
+    /**
+     * RawDeviceHash::storageIdentity() of the device: the checkpoint follows it to another
+     * node after a replug, as long as the partition layout fingerprint is unchanged. Empty
+     * when the device has no stable identity; the checkpoint is then kept by node.
+     */
+    QString storageId;
+    QString layoutFingerprint;
 
     bool isValid() const { return !deviceNode.isEmpty() && blockSize > 0; }
+    /** What the checkpoint is stored under: storageId, else deviceNode. */
+    QString key() const { return storageId.isEmpty() ? deviceNode : storageId; }
+};
+
+/**
+ * Append-only checkpoint file for one (device, algorithm, scan mode): a small header, then
+ * the raw digest bytes of each finished block in order. Progress only ever appends; a torn
+ * last record after a crash is ignored on read. bytesCompleted is derived from the block
+ * count, which is how chunked reads advance.
+ */
+class HashCheckpointLog {
+public:
+    /** fdatasync at most this often while appending. */
+    static constexpr int kSyncIntervalMs = 1000;
+
+    ~HashCheckpointLog();
+
+    /** The checkpoint in @p path, or std::nullopt when missing or not a checkpoint log. */
+    static std::optional<HashCheckpoint> read(const QString& path);
+    /** Atomically replaces @p path with exactly @p cp (compaction). */
+    static bool write(const QString& path, const HashCheckpoint& cp);
+
+    /**
+     * Appends the digests of @p cp not yet in the log. When @p cp does not extend what is
+     * already written (another device size, a resume that dropped blocks) the log is
+     * rewritten first.
+     */
+    bool update(const QString& path, const HashCheckpoint& cp);
+    /** Syncs and closes the file; the next update() reopens it. */
+    void close();
+
+private:
+    bool reopen(const QString& path, const HashCheckpoint& cp);
+    void sync();
+
+    std::unique_ptr<QFile> m_file;
+    HashCheckpoint m_header;  // blockHashes unused; m_blocks counts what is on disk
+    int m_blocks = 0;
+    QElapsedTimer m_lastSync;
 };
 
 class HashCheckpointStore {
 public:
     static HashCheckpointStore& instance();
 
+    /** Reads the per-checkpoint logs; migrates a legacy hash-checkpoints.json once. */
     void load();
-    void save();
 
+    /**
+     * The checkpoint to resume @p deviceNode from. With a @p storageId it is found wherever
+     * the device was plugged in before, provided @p layoutFingerprint matches too; a
+     * checkpoint of another device that used the same node is not returned. The result
+     * carries @p deviceNode.
+     */
     std::optional<HashCheckpoint> checkpointFor(const QString& deviceNode,
                                                 const QString& algorithm,
-                                                const QString& scanMode) const;
+                                                const QString& scanMode,
+                                                const QString& storageId = {},
+                                                const QString& layoutFingerprint = {}) const;
+
+    /**
+     * Progress from a running hash: appends the new block digests to the checkpoint's log.
+     * Called from hashing threads; cheap enough to call at every checkpoint.
+     */
+    void record(const HashCheckpoint& cp);
 
+    /** Compacts the log to exactly @p cp (e.g. on cancel) and makes it the resume point. */
     void upsert(const HashCheckpoint& cp);
-    void remove(const QString& deviceNode, const QString& algorithm, const QString& scanMode);
+    /** Removes the checkpoint stored under @p key (HashCheckpoint::key()). */
+    void remove(const QString& key, const QString& algorithm, const QString& scanMode);
+    /** Removes @p cp, and the node-keyed checkpoint it may have been resumed from. */
+    void remove(const HashCheckpoint& cp);
     void clearAll();
 
+    /** Directory holding one .log file per checkpoint. */
+    static QString logDirectory();
+    static QString logPathFor(const QString& key, const QString& algorithm, const QString& scanMode);
+
 private:
     HashCheckpointStore() = default;
 
+    mutable QMutex m_mutex;
     QList<HashCheckpoint> m_checkpoints;
+    QHash<QString, std::shared_ptr<HashCheckpointLog>> m_openLogs;  // by log path
 };
 
 } // namespace FlashSpartan
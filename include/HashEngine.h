@@ -0,0 +1,367 @@
+#pragma once
+
+#include "Blake3Digest.h"
+#include "HashPipeline.h"
+#include "HexEncoding.h"
+#include "IoBufferPool.h"
+#include "PerfMetrics.h"
+#include "PerfTrace.h"
+#include "RawDeviceHash.h"
+#include "Xxh3Digest.h"
+
+#include <openssl/evp.h>
+
+#include <QElapsedTimer>
+#include <QString>
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#ifdef HAS_XXHASH
+#include <xxhash.h>
+#endif
+#ifdef HAS_BLAKE3
+#include <blake3.h>
+#endif
+
+namespace FlashSpartan::RawDeviceHash::Engine {
+
+/**
+ * The sequential full-read engine behind every platform's plain, pipelined, mmap, io_uring
+ * and overlapped hashes. hashSequential() is templated on a digest policy and an I/O source,
+ * so the per-buffer loop is compiled once per pair with both inlined; hash() picks the
+ * policy. The checks around it (cancel, pause, the dataRead tap, progress, trace spans,
+ * short reads, result fields) are written once here instead of in every loop.
+ *
+ * A digest policy is constructible from an Algorithm and has isValid(), update(data, length)
+ * and finish(QString* hex). A source has
+ *     template <class Consume> bool run(uint64_t deviceSize, JobMeter&, Consume&&, QString* error)
+ * which hands [0, deviceSize) to consume(data, length) in offset order and stops when it
+ * returns false, and describe(HashResult&, JobMeter&, uint64_t elapsedMs), which fills
+ * HashResult::performance and whatever else the source measured.
+ */
+
+inline const EVP_MD* mdFor(Algorithm algo)
+{
+    switch (algo) {
+        case Algorithm::SHA512: return EVP_sha512();
+        case Algorithm::BLAKE2b: return EVP_blake2b512();
+        case Algorithm::BLAKE3: return blake3Digest();
+        case Algorithm::XXH3_128: return xxh3_128Digest();
+        case Algorithm::SHA256: break;
+    }
+    return EVP_sha256();
+}
+
+inline bool cancelled(const Options& options)
+{
+    waitWhilePaused(options);
+    return options.cancelled && options.cancelled->load();
+}
+
+inline void reportProgress(const Options& options, uint64_t value)
+{
+    if (options.bytesProcessed) {
+        options.bytesProcessed->store(value);
+    }
+}
+
+inline bool finalizeCtx(EVP_MD_CTX* mdctx, QString& outHex)
+{
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int hashLen = 0;
+    if (EVP_DigestFinal_ex(mdctx, hash, &hashLen) != 1) {
+        return false;
+    }
+    outHex = HexEncoding::toString(hash, hashLen);
+    return true;
+}
+
+/** Any algorithm through EVP, including the EVP wrappers of XXH3 and BLAKE3. */
+class EvpDigest {
+public:
+    explicit EvpDigest(Algorithm algo)
+        : m_ctx(EVP_MD_CTX_new())
+    {
+        if (m_ctx && EVP_DigestInit_ex(m_ctx, mdFor(algo), nullptr) != 1) {
+            EVP_MD_CTX_free(m_ctx);
+            m_ctx = nullptr;
+        }
+    }
+    ~EvpDigest() { EVP_MD_CTX_free(m_ctx); }
+
+    EvpDigest(const EvpDigest&) = delete;
+    EvpDigest& operator=(const EvpDigest&) = delete;
+
+    bool isValid() const { return m_ctx != nullptr; }
+    bool update(const char* data, size_t length) { return EVP_DigestUpdate(m_ctx, data, length) == 1; }
+    bool finish(QString* hex) { return finalizeCtx(m_ctx, *hex); }
+
+private:
+    EVP_MD_CTX* m_ctx = nullptr;
+};
+
+#ifdef HAS_XXHASH
+/** XXH3-128 called directly; same canonical output as xxh3_128Digest(). */
+class Xxh3NativeDigest {
+public:
+    explicit Xxh3NativeDigest(Algorithm)
+        : m_state(XXH3_createState())
+    {
+        if (m_state && XXH3_128bits_reset(m_state) != XXH_OK) {
+            XXH3_freeState(m_state);
+            m_state = nullptr;
+        }
+    }
+    ~Xxh3NativeDigest() { XXH3_freeState(m_state); }
+
+    Xxh3NativeDigest(const Xxh3NativeDigest&) = delete;
+    Xxh3NativeDigest& operator=(const Xxh3NativeDigest&) = delete;
+
+    bool isValid() const { return m_state != nullptr; }
+    bool update(const char* data, size_t length) { return XXH3_128bits_update(m_state, data, length) == XXH_OK; }
+    bool finish(QString* hex)
+    {
+        XXH128_canonical_t canonical;
+        XXH128_canonicalFromHash(&canonical, XXH3_128bits_digest(m_state));
+        *hex = HexEncoding::toString(canonical.digest, sizeof(canonical.digest));
+        return true;
+    }
+
+private:
+    XXH3_state_t* m_state = nullptr;
+};
+#endif
+
+#ifdef HAS_BLAKE3
+/** BLAKE3 called directly; same 32-byte output as blake3Digest(). */
+class Blake3NativeDigest {
+public:
+    explicit Blake3NativeDigest(Algorithm) { blake3_hasher_init(&m_hasher); }
+
+    bool isValid() const { return true; }
+    bool update(const char* data, size_t length)
+    {
+        blake3_hasher_update(&m_hasher, data, length);
+        return true;
+    }
+    bool finish(QString* hex)
+    {
+        uint8_t out[BLAKE3_OUT_LEN];
+        blake3_hasher_finalize(&m_hasher, out, BLAKE3_OUT_LEN);
+        *hex = HexEncoding::toString(out, BLAKE3_OUT_LEN);
+        return true;
+    }
+
+private:
+    blake3_hasher m_hasher;
+};
+#endif
+
+/**
+ * Calls @p fn with std::type_identity<Policy>{} for the fastest policy that computes
+ * @p algo, so callers instantiate their loop once per policy.
+ */
+template <class Fn>
+decltype(auto) withDigest(Algorithm algo, Fn&& fn)
+{
+#ifdef HAS_XXHASH
+    if (algo == Algorithm::XXH3_128) {
+        return std::forward<Fn>(fn)(std::type_identity<Xxh3NativeDigest>{});
+    }
+#endif
+#ifdef HAS_BLAKE3
+    if (algo == Algorithm::BLAKE3) {
+        return std::forward<Fn>(fn)(std::type_identity<Blake3NativeDigest>{});
+    }
+#endif
+    Q_UNUSED(algo);
+    return std::forward<Fn>(fn)(std::type_identity<EvpDigest>{});
+}
+
+/**
+ * Reads, in the caller's thread, through a ReadAt callable
+ *     int64_t(char* buffer, size_t length, uint64_t offset, JobMeter&, QString* error)
+ * returning the bytes read, 0 at end of data or -1 with @p error set.
+ */
+template <class ReadAt>
+class ReadSource {
+public:
+    ReadSource(ReadAt readAt, size_t bufferSize)
+        : m_readAt(std::move(readAt))
+        , m_bufferSize(bufferSize)
+    {
+    }
+
+    template <class Consume>
+    bool run(uint64_t deviceSize, JobMeter& meter, Consume&& consume, QString* error)
+    {
+        const IoBufferPool::Buffer pooled(m_bufferSize);
+        char* buffer = pooled.data();
+        if (!buffer) {
+            *error = QStringLiteral("Failed to allocate buffer");
+            return false;
+        }
+        uint64_t offset = 0;
+        while (offset < deviceSize) {
+            const size_t want = static_cast<size_t>(qMin<uint64_t>(m_bufferSize, deviceSize - offset));
+            int64_t n = 0;
+            {
+                FLASHSPARTAN_TRACE_SPAN_VALUE("raw", "pread", want);
+                const JobMeter::Timed readTime = meter.reading();
+                n = m_readAt(buffer, want, offset, meter, error);
+            }
+            if (n < 0) {
+                return false;
+            }
+            if (n == 0) {
+                return true;
+            }
+            if (!consume(static_cast<const char*>(buffer), static_cast<size_t>(n))) {
+                return false;
+            }
+            offset += static_cast<uint64_t>(n);
+        }
+        return true;
+    }
+
+    void describe(HashResult& result, JobMeter& meter, uint64_t /*elapsedMs*/) const
+    {
+        meter.fill(result.performance, QStringLiteral("read"), static_cast<int>(m_bufferSize / 1024), 1);
+    }
+
+private:
+    ReadAt m_readAt;
+    size_t m_bufferSize;
+};
+
+/** ReadSource's reads on a thread of their own, overlapping the digest (runPipelined()). */
+template <class ReadAt>
+class PipelinedSource {
+public:
+    PipelinedSource(ReadAt readAt, size_t bufferSize, int depth)
+        : m_readAt(std::move(readAt))
+        , m_bufferSize(bufferSize)
+        , m_depth(depth)
+    {
+    }
+
+    template <class Consume>
+    bool run(uint64_t deviceSize, JobMeter& meter, Consume&& consume, QString* error)
+    {
+        uint64_t readOffset = 0;
+        return runPipelined(
+            m_depth, m_bufferSize,
+            [&](char* buffer, size_t capacity, QString* readError) -> int64_t {
+                if (readOffset >= deviceSize) {
+                    return 0;
+                }
+                const size_t want = static_cast<size_t>(qMin<uint64_t>(capacity, deviceSize - readOffset));
+                FLASHSPARTAN_TRACE_SPAN_VALUE("raw", "pread", want);
+                const PerfMetrics::ScopedTimer readTimer(PerfMetrics::readLatency());
+                const JobMeter::Timed readTime = meter.reading();
+                const int64_t n = m_readAt(buffer, want, readOffset, meter, readError);
+                if (n > 0) {
+                    readOffset += static_cast<uint64_t>(n);
+                }
+                return n;
+            },
+            [&](const char* data, size_t length) { return consume(data, length); }, &m_stats, error);
+    }
+
+    void describe(HashResult& result, JobMeter& meter, uint64_t /*elapsedMs*/) const
+    {
+        result.readStallMs = m_stats.readerStallMs;
+        result.hashStallMs = m_stats.hasherStallMs;
+        meter.fill(result.performance, QStringLiteral("pipelined"), static_cast<int>(m_bufferSize / 1024), m_depth);
+    }
+
+private:
+    ReadAt m_readAt;
+    size_t m_bufferSize;
+    int m_depth;
+    PipelineStats m_stats;
+};
+
+/**
+ * Hashes [0, @p deviceSize) from @p source with @p Digest. Stops with "Cancelled" on cancel,
+ * and fails when the source ends before @p deviceSize.
+ */
+template <class Digest, class Source>
+HashResult hashSequential(Source& source, const Options& options, uint64_t deviceSize)
+{
+    HashResult result;
+    result.deviceNode = options.deviceNode;
+    result.algorithm = algorithmName(options.algorithm);
+    if (deviceSize == 0) {
+        result.errorMessage = QStringLiteral("Device size is 0");
+        return result;
+    }
+
+    Digest digest(options.algorithm);
+    if (!digest.isValid()) {
+        result.errorMessage = QStringLiteral("Failed to initialize hash algorithm");
+        return result;
+    }
+
+    JobMeter meter;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    uint64_t hashed = 0;
+    bool hashFailed = false;
+    QString sourceError;
+    const bool ok = source.run(
+        deviceSize, meter,
+        [&](const char* data, size_t length) {
+            if (cancelled(options)) {
+                return false;
+            }
+            if (options.dataRead) {
+                options.dataRead(hashed, data, length);
+            }
+            FLASHSPARTAN_TRACE_SPAN_VALUE("raw", "digest", length);
+            const JobMeter::Timed hashTime = meter.hashing();
+            if (!digest.update(data, length)) {
+                hashFailed = true;
+                return false;
+            }
+            hashed += length;
+            reportProgress(options, hashed);
+            return true;
+        },
+        &sourceError);
+    source.describe(result, meter, static_cast<uint64_t>(elapsed.elapsed()));
+
+    if (options.cancelled && options.cancelled->load()) {
+        result.errorMessage = QStringLiteral("Cancelled");
+        return result;
+    }
+    if (!ok) {
+        result.errorMessage = hashFailed ? QStringLiteral("Failed to update hash") : sourceError;
+        return result;
+    }
+    if (hashed < deviceSize) {
+        result.errorMessage = QStringLiteral("Unexpected EOF at byte %1").arg(hashed);
+        return result;
+    }
+    if (!digest.finish(&result.hash)) {
+        result.errorMessage = QStringLiteral("Failed to finalize hash");
+        return result;
+    }
+    result.bytesProcessed = hashed;
+    result.success = true;
+    return result;
+}
+
+/** hashSequential() with the digest policy for options.algorithm. */
+template <class Source>
+HashResult hash(Source& source, const Options& options, uint64_t deviceSize)
+{
+    return withDigest(options.algorithm, [&](auto policy) {
+        return hashSequential<typename decltype(policy)::type>(source, options, deviceSize);
+    });
+}
+
+} // namespace FlashSpartan::RawDeviceHash::Engine
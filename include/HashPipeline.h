@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QString>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace FlashSpartan::RawDeviceHash {
+
+/** Time each stage of runPipelined() spent blocked on the other. */
+struct PipelineStats {
+    uint64_t readerStallMs = 0;  // reader waited for a free buffer (hashing is the bottleneck)
+    uint64_t hasherStallMs = 0;  // hasher waited for data (the device is the bottleneck)
+};
+
+/**
+ * Fill up to @p capacity bytes into @p buffer. Return bytes read, 0 at end of data,
+ * or -1 with @p error set.
+ */
+using PipelineReadFn = std::function<int64_t(char* buffer, size_t capacity, QString* error)>;
+
+/** Consume one filled buffer in read order. Return false to stop (error or cancel). */
+using PipelineConsumeFn = std::function<bool(const char* data, size_t length)>;
+
+/**
+ * Producer/consumer ring of @p depth page-aligned buffers: @p read runs on a dedicated
+ * thread while @p consume runs on the calling thread, so device reads overlap digest
+ * updates. Buffers are handed to @p consume strictly in read order.
+ *
+ * Returns false if allocation or @p read failed (@p error set) or @p consume stopped early.
+ */
+bool runPipelined(int depth, size_t bufferSize, const PipelineReadFn& read,
+                  const PipelineConsumeFn& consume, PipelineStats* stats, QString* error);
+
+} // namespace FlashSpartan::RawDeviceHash
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+#include <cstdint>
+
+namespace FlashSpartan {
+
+/**
+ * Decides which queued hash job HashWorker starts next.
+ *
+ * Jobs are grouped by USB host controller (bus). Each controller gets its own concurrency
+ * limit, learned from the aggregate throughput it delivers: a known controller starts at
+ * one job, tries one more while that raises throughput by kGrowGain and backs off (and
+ * stops probing) when it does not. Jobs without topology (Windows, non-USB) share the
+ * global limit only. Among startable jobs the smallest estimated read goes first, so
+ * quick checks are not stuck behind full reads; jobs waiting kStarvationMs jump the order.
+ * A batch whose total time matters more than each job's (IsoVerifier's image scans) sets
+ * LongestFirst instead, so the longest job does not start last.
+ */
+class HashScheduler {
+public:
+    enum class Order { ShortestFirst, LongestFirst };
+
+    struct Pending {
+        QString controller;  // empty = unknown topology
+        QString rootPort;    // controller-local root port; jobs behind one hub share it
+        uint64_t estimatedBytes = 0;
+        qint64 waitedMs = 0;
+    };
+
+    struct Running {
+        QString controller;
+        QString rootPort;
+    };
+
+    static constexpr qint64 kStarvationMs = 5 * 60 * 1000;
+    /** Throughput samples (progress ticks) at one concurrency before the limit moves. */
+    static constexpr int kMinSamples = 20;
+    static constexpr double kGrowGain = 1.15;
+
+    void setGlobalLimit(int limit);
+    int globalLimit() const { return m_globalLimit; }
+
+    void setOrder(Order order) { m_order = order; }
+
+    /**
+     * Holds @p controller at @p limit jobs for good: no probing for more, as on a stick
+     * where a second concurrent read only adds seeks.
+     */
+    void pinLimit(const QString& controller, int limit);
+
+    /** Current limit for @p controller; the global limit when the controller is unknown. */
+    int controllerLimit(const QString& controller) const;
+
+    /** Index into @p pending of the job to start next, or -1 when nothing may start. */
+    int pickNext(const QList<Pending>& pending, const QList<Running>& running) const;
+
+    /**
+     * One progress-tick sample: @p controller moved @p mbps in aggregate with exactly
+     * @p concurrency of its jobs running throughout. Returns true when the limit changed.
+     */
+    bool recordThroughput(const QString& controller, int concurrency, double mbps);
+
+private:
+    struct ControllerStats {
+        int limit = 1;
+        /** Highest limit allowed after a probe did not pay off; 0 = not found yet. */
+        int ceiling = 0;
+        QMap<int, double> mbps;  // EWMA per concurrency
+        QMap<int, int> samples;
+    };
+
+    int m_globalLimit = 2;
+    Order m_order = Order::ShortestFirst;
+    QHash<QString, ControllerStats> m_controllers;
+};
+
+} // namespace FlashSpartan
@@ -14,13 +14,18 @@
 
 #include "Types.h"
 #include "HashCheckpoint.h"
+#include "HashScheduler.h"
+#include "PerfMetrics.h"
+#include "ProgressHub.h"
 
 namespace FlashSpartan {
 
+class SharedReadPass;
+
 /**
  * @brief HashWorker - High-performance asynchronous partition hashing
  * 
- * Uses QtConcurrent for true parallel execution without blocking the GUI.
+ * Started hashes run on IoScheduler's I/O pool, one reader per disk, without blocking the GUI.
  * Supports multiple hash algorithms, progress reporting, and cancellation.
  * Optimized for large partition hashing with memory-mapped I/O when available.
  */
@@ -35,7 +40,8 @@ public:
         SHA256,
         SHA512,
         BLAKE2b,
-        XXH3_128  // Extremely fast, non-cryptographic
+        XXH3_128,  // Extremely fast, non-cryptographic
+        BLAKE3     // Cryptographic, SIMD; full reads hash blocks on every core
     };
     Q_ENUM(Algorithm)
 
@@ -46,12 +52,29 @@ public:
         QString deviceNode;
         Algorithm algorithm = Algorithm::SHA256;
         int bufferSizeKB = 1024;      // Read buffer size in KB
+        bool autoTuneBuffer = false;   // Probe buffer sizes first; winner in HashResult (Linux)
+        bool probeCapacity = false;    // Counterfeit-capacity probe first; outcome in HashResult
         bool useMemoryMapping = true;  // Use mmap when possible
+        bool useIoUring = false;       // Queued O_DIRECT reads (Linux); falls back to mmap/read
+        int ioQueueDepth = 4;          // Reads kept in flight with useIoUring
+        int pipelineDepth = 3;         // Reader/hasher ring; unused here: full reads are checkpointed
+        bool skipZeroRegions = false;  // Zero blocks use a cached digest; holes are not read
+        bool reuseHelperSession = false;  // Elevated hashes share one pkexec helper (Linux)
         bool rawDevice = true;         // Hash raw device vs mounted files
         HashScope scope = HashScope::Partition;
         HashScanMode scanMode = HashScanMode::Full;
         bool resumeFromCheckpoint = false;
+        QStringList expectedBlockHashes;   // Baseline block digests to compare full reads with
+        bool stopAtFirstMismatch = false;  // End the read at the first differing block
+        int quickSamples = 15;             // QuickSample layout (RawDeviceHash::QuickSampleLayout)
+        int quickSampleKB = 1024;
+        bool quickSampleMetadata = false;
         QString canonicalStorageId;
+        QString usbBus;          // DeviceInfo::usbBus; groups jobs per host controller
+        QString usbPortPath;     // DeviceInfo::usbPortPath, e.g. "2-1.4"
+        uint64_t sizeHintBytes = 0;  // DeviceInfo::sizeBytes, when the device cannot be opened yet
+        std::shared_ptr<SharedReadPass> sharedRead;  // Full reads publish every buffer here
+        bool partitionHashes = false;  // WholeDisk full reads: table area and each partition too
         void* userData = nullptr;
     };
 
@@ -81,6 +104,18 @@ public:
      */
     void cancelAll();
 
+    /**
+     * @brief Pause or resume a running hash job
+     *
+     * A paused job stops at its next read buffer, keeps its device handle and digest
+     * state, and still counts against the concurrency limits. Preemption frees those
+     * slots instead. Queued jobs cannot be paused.
+     * @return true if the job is running and its state changed
+     */
+    bool setHashPaused(const QString& jobId, bool paused);
+
+    bool isPaused(const QString& jobId) const;
+
     /**
      * @brief Check if a specific job is running
      */
@@ -101,8 +136,18 @@ public:
      */
     double progress(const QString& jobId) const;
 
+    /**
+     * @brief Progress of every running job, read from its counters
+     *
+     * ProgressHub polls this once per frame; bytesTotal is 0 while a job's size is unknown.
+     */
+    QList<ProgressSample> progressSnapshot() const;
+
     /**
      * @brief Set maximum concurrent hash operations
+     *
+     * An upper bound: HashScheduler learns a per-USB-controller limit below it and picks
+     * the smallest queued job first.
      */
     void setMaxConcurrent(int max);
 
@@ -122,17 +167,6 @@ signals:
      */
     void hashStarted(const QString& jobId, const QString& deviceNode);
 
-    /**
-     * @brief Emitted periodically during hashing
-     * @param jobId Job identifier
-     * @param progress 0.0 to 1.0
-     * @param bytesProcessed Bytes hashed so far
-     * @param speedMBps Current speed in MB/s
-     */
-    void hashProgress(const QString& jobId, double progress,
-                      quint64 bytesProcessed, double speedMBps, double etaSeconds,
-                      quint64 totalBytes);
-
     /**
      * @brief Emitted when hashing completes successfully
      */
@@ -148,6 +182,16 @@ signals:
      */
     void hashCancelled(const QString& jobId);
 
+    void hashPaused(const QString& jobId, bool paused);
+
+    /**
+     * @brief Emitted when a full read gave up its slot to a quick check
+     *
+     * The job's checkpoint is saved and it is queued again under the same id. It resumes
+     * from that checkpoint, and hashStarted() follows when it runs again.
+     */
+    void hashPreempted(const QString& jobId);
+
 private:
     /**
      * @brief Internal job tracking structure
@@ -158,9 +202,31 @@ private:
         QFuture<HashResult> future;
         std::unique_ptr<QFutureWatcher<HashResult>> watcher;
         std::atomic<bool> cancelled{false};
+        std::atomic<bool> dispatched{false};  // IoScheduler started it; its read is under way
+        std::atomic<bool> paused{false};
+        // Stopping to make room for a quick check, to be queued again; guarded by m_jobsMutex.
+        bool preempted = false;
+        // cancelHash()/cancelAll() asked for the stop, which is never undone; guarded by m_jobsMutex.
+        bool userCancelled = false;
+        int preemptions = 0;
         std::atomic<uint64_t> bytesProcessed{0};
         std::atomic<uint64_t> totalBytes{0};
         QElapsedTimer timer;
+        // Scheduler throughput sampling; guarded by m_jobsMutex.
+        uint64_t sampledBytes = 0;
+        bool sampled = false;
+        // Bytes already added to hashedBytes; guarded by m_jobsMutex.
+        PerfMetrics::Counter* hashedBytes = nullptr;
+        uint64_t countedBytes = 0;
+        // Slowest one-second window so far; guarded by m_jobsMutex.
+        qint64 windowStartMs = -1;
+        uint64_t windowStartBytes = 0;
+        double minMBps = 0.0;
+    };
+
+    struct PendingJob {
+        std::shared_ptr<JobState> state;
+        QElapsedTimer queued;
     };
 
     /**
@@ -194,15 +260,35 @@ private:
     void onJobFinished(const QString& jobId);
 
     /**
-     * @brief Progress update timer callback
+     * @brief Throughput timer callback: feeds HashScheduler and starts queued jobs
      */
-    void updateProgress();
+    void sampleThroughput();
 
     /**
      * @brief Start queued jobs when capacity is available
      */
     void processPendingQueue();
 
+    /** Stops one resumable full read so queued quick check @p pendingIndex can start; locked. */
+    bool preemptForLocked(int pendingIndex, const QList<HashScheduler::Pending>& pending);
+
+    /**
+     * @brief Feed per-controller throughput to m_scheduler (m_jobsMutex held)
+     * @return true when a controller limit changed
+     */
+    bool sampleControllerThroughput();
+
+    /**
+     * @brief Queue depths and hashed bytes since the last call to PerfMetrics (m_jobsMutex held)
+     * @param finished A job just removed from m_jobs, whose last bytes still count
+     */
+    void publishMetrics(JobState* finished = nullptr);
+
+    /**
+     * @brief Close each job's throughput window once a second has passed (m_jobsMutex held)
+     */
+    void sampleJobWindows();
+
     /**
      * @brief Run a hash job (must hold no locks that block on pool)
      */
@@ -212,19 +298,25 @@ private:
     // Active jobs
     mutable QMutex m_jobsMutex;
     QHash<QString, std::shared_ptr<JobState>> m_jobs;
-    QQueue<QPair<QString, HashJob>> m_pendingQueue;
+    QList<PendingJob> m_pendingQueue;
+    HashScheduler m_scheduler;
+    QHash<QString, int> m_lastTickJobs;  // jobs per controller at the previous progress tick
+    QElapsedTimer m_lastTick;
 
     // Job ID counter
     mutable std::atomic<uint64_t> m_jobCounter{0};
 
-    // Progress update timer
-    QTimer* m_progressTimer = nullptr;
+    // Scheduler throughput timer; progress itself is polled by ProgressHub
+    QTimer* m_throughputTimer = nullptr;
 
     // Configuration
     int m_maxConcurrent = 2;
 
-    // Progress update interval in ms
-    static constexpr int PROGRESS_UPDATE_INTERVAL_MS = 100;
+    // Throughput sampling interval in ms
+    static constexpr int THROUGHPUT_SAMPLE_INTERVAL_MS = 100;
+
+    // A full read gives way to quick checks this many times, then runs to the end
+    static constexpr int MAX_PREEMPTIONS = 3;
 };
 
 } // namespace FlashSpartan
\ No newline at end of file
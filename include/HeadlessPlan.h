@@ -0,0 +1,40 @@
+#pragma once
+
+#include "Types.h"
+
+#include <QString>
+
+namespace FlashSpartan {
+
+/**
+ * What flashspartan --headless (MonitorService) does on its own when a drive connects or
+ * changes. Only the decisions live here; the database lookups, jobs and events stay with
+ * the service, so the rules can be checked without a device or a database.
+ */
+namespace HeadlessPlan {
+
+enum class Verify {
+    None,           // blocked, new, or auto-verify on connect is off
+    WatchManifest,  // the record's watch manifest, on the mount or read raw
+    FullHash,       // a raw read against the record's baseline hash
+    Skip,           // known, but nothing can be checked unattended (see ConnectPlan::skipReason)
+};
+
+struct ConnectPlan {
+    QString verdict;  // blocked, new or known
+    Verify verify = Verify::None;
+    QString skipReason;
+    /** Offer the drive's mount to the ISO scan; the scan still applies its own settings. */
+    bool scanIsos = false;
+};
+
+/** For a drive that just connected; @p record is null when the database does not know it. */
+ConnectPlan onConnect(const DeviceInfo& device, bool blocked, const DeviceRecord* record,
+                      bool autoHashOnConnect);
+
+/** Whether a drive that went from @p before to @p after, with @p verdict so far, gets an ISO scan now. */
+bool scanIsosOnChange(const DeviceInfo& before, const DeviceInfo& after, const QString& verdict);
+
+} // namespace HeadlessPlan
+
+} // namespace FlashSpartan
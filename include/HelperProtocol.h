@@ -0,0 +1,104 @@
+#pragma once
+
+#include "HashCheckpoint.h"
+#include "RawDeviceHash.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+namespace FlashSpartan::HelperProtocol {
+
+/**
+ * Framed stream spoken by `flashspartan-read-helper hash --stream`.
+ *
+ * Frame: u8 type, u32 payload length, payload. Integers are little-endian and payloads
+ * are QDataStream-encoded. The host writes Job and Cancel frames to the helper's stdin;
+ * the helper answers on stdout with Hello, then Progress/Block frames and one Result.
+ * Instead of a Job the host may send OpenDevice; the DeviceFd answer carries a read-only
+ * descriptor as SCM_RIGHTS ancillary data (stdin/stdout must be a Unix socket).
+ */
+inline constexpr quint32 kMagic = 0x31485346; // 'FSH1' little-endian
+inline constexpr quint16 kVersion = 6;
+inline constexpr int kHeaderBytes = 5;
+inline constexpr quint32 kMaxPayloadBytes = 16 * 1024 * 1024;
+
+enum class FrameType : quint8 {
+    Hello = 1,     // helper -> host: magic, version
+    Job = 2,       // host -> helper: what to hash
+    Cancel = 3,    // host -> helper: stop the running job (closing stdin does the same)
+    Progress = 4,  // helper -> host: bytes processed, device size
+    Block = 5,     // helper -> host: one finished block digest (chunked reads)
+    Result = 6,    // helper -> host: final HashResult, ends the job
+    OpenDevice = 7, // host -> helper: validate and open a device node for the host
+    DeviceFd = 8,  // helper -> host: error message, or empty with the fd attached
+};
+
+struct Frame {
+    FrameType type = FrameType::Hello;
+    QByteArray payload;
+};
+
+/** A Job frame: the Options fields that cross the pipe, plus resume state. */
+struct JobRequest {
+    RawDeviceHash::Options options;
+    QStringList expectedBlockHashes;
+    /** Chunked full read with checkpoints, as the in-process HashWorker path runs it. */
+    bool useCheckpoint = false;
+    HashCheckpoint checkpoint;
+};
+
+struct ProgressUpdate {
+    uint64_t bytesProcessed = 0;
+    uint64_t totalBytes = 0;
+};
+
+struct BlockDigest {
+    uint64_t index = 0;
+    QString hex;
+};
+
+/** The Result frame: the hash plus, for checkpointed jobs, where the read got to. */
+struct JobResult {
+    HashResult result;
+    bool hasCheckpoint = false;
+    HashCheckpoint checkpoint;
+};
+
+QByteArray encodeFrame(FrameType type, const QByteArray& payload = {});
+
+/**
+ * Removes one complete frame from the front of @p buffer. Returns false while the frame
+ * is still incomplete, or with @p error set when the header is malformed.
+ */
+bool takeFrame(QByteArray& buffer, Frame* out, QString* error = nullptr);
+
+QByteArray encodeHello();
+bool decodeHello(const QByteArray& payload, quint16* versionOut = nullptr);
+
+QByteArray encodeJob(const JobRequest& job);
+/**
+ * Checks the framing only. The helper opens the decoded device node with
+ * RawDeviceHash::openHelperDevice() before any read, whatever lengthLimit or scan mode
+ * the job asks for.
+ */
+bool decodeJob(const QByteArray& payload, JobRequest* out);
+
+QByteArray encodeProgress(const ProgressUpdate& progress);
+bool decodeProgress(const QByteArray& payload, ProgressUpdate* out);
+
+/** Digests travel as raw bytes, not hex. */
+QByteArray encodeBlock(const BlockDigest& block);
+bool decodeBlock(const QByteArray& payload, BlockDigest* out);
+
+QByteArray encodeResult(const JobResult& result);
+bool decodeResult(const QByteArray& payload, JobResult* out);
+
+QByteArray encodeOpenDevice(const QString& deviceNode);
+bool decodeOpenDevice(const QByteArray& payload, QString* deviceNode);
+
+/** An empty @p errorMessage means the descriptor travels with the frame. */
+QByteArray encodeDeviceFd(const QString& errorMessage);
+bool decodeDeviceFd(const QByteArray& payload, QString* errorMessage);
+
+} // namespace FlashSpartan::HelperProtocol
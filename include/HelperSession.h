@@ -0,0 +1,128 @@
+#pragma once
+
+#include "HelperProtocol.h"
+
+#include <QElapsedTimer>
+#include <QSet>
+#include <QString>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <sys/types.h>
+
+namespace FlashSpartan {
+
+/**
+ * One `pkexec flashspartan-read-helper hash --stream` process (Linux).
+ *
+ * A one-shot session runs a single job and exits. A reusable session (`--session`) stays
+ * authenticated for further jobs until its device count or lifetime is used up, or it sits
+ * idle; the helper enforces the same limits, so a session never outlives them even if the
+ * app misbehaves. Not thread-safe: one job at a time, from the thread that owns it.
+ */
+class HelperSession {
+public:
+    struct Limits {
+        /** Distinct device nodes one process may open; 1 = one-shot. */
+        int maxDevices = 1;
+        /** Seconds after launch the helper stops accepting jobs; 0 = one-shot. */
+        int maxSeconds = 0;
+    };
+
+    /** Limits for reusable sessions; the helper clamps them to its own ceilings. */
+    static constexpr int kReusableMaxDevices = 16;
+    static constexpr int kReusableMaxSeconds = 600;
+    /** The app drops an idle session before the helper's own idle exit (120 s). */
+    static constexpr int kHostIdleSeconds = 90;
+
+    ~HelperSession();
+    HelperSession(const HelperSession&) = delete;
+    HelperSession& operator=(const HelperSession&) = delete;
+
+    /** Starts pkexec; authentication happens while the first job is pending. */
+    static std::unique_ptr<HelperSession> launch(const QString& helperPath, const Limits& limits,
+                                                 QString* error);
+
+    /**
+     * A session over @p socket, already connected to a helper's job loop that is not a child
+     * of ours (a helper run in-process or by a test). Takes ownership of @p socket.
+     */
+    static std::unique_ptr<HelperSession> adopt(int socket, const Limits& limits);
+
+    /**
+     * Sends one job and pumps frames until its Result. Progress, total size and block
+     * digests are forwarded through @p options; a set Options::cancelled sends Cancel.
+     * std::nullopt with @p error when the helper exits or misbehaves.
+     */
+    std::optional<HelperProtocol::JobResult> run(const RawDeviceHash::Options& options,
+                                                 QString* error);
+
+    /**
+     * Asks the helper to validate and open @p deviceNode and pass the read-only (O_DIRECT
+     * when possible) fd back over SCM_RIGHTS, so the in-process engine can hash it.
+     * Returns the fd, or -1 with @p error set to the helper's refusal or exit status.
+     */
+    int openDevice(const QString& deviceNode, const std::atomic<bool>* cancelled, QString* error);
+
+    /** The helper process is still connected (an open refusal leaves it waiting for a job). */
+    bool connected() const { return m_socket >= 0; }
+
+    /**
+     * Reaps the helper if it has exited since the last call, keeping its exit status.
+     * Returns true once it is gone; accepts() turns false from then on.
+     */
+    bool reapIfExited();
+    /** True while the helper has not been seen to exit and a job for @p deviceNode fits the limits. */
+    bool accepts(const QString& deviceNode) const;
+    /** The helper sent at least one frame for the last job (it was not dead on arrival). */
+    bool answered() const { return m_answered; }
+
+    /** An idle reusable session that accepts @p deviceNode, or nullptr. */
+    static std::unique_ptr<HelperSession> takeIdle(const QString& deviceNode);
+    /** Parks a reusable session for the next elevated hash; closes it if one is parked. */
+    static void keepIdle(std::unique_ptr<HelperSession> session);
+    /** Closes the parked session and cached descriptors, e.g. when the setting is turned off. */
+    static void closeIdle();
+
+    /**
+     * Descriptors from openDevice() kept for repeated hashes, bounded like a reusable
+     * session. cachedDeviceFd() returns a rewound dup, or -1 when none is cached or the node
+     * no longer names the same block device.
+     */
+    static void cacheDeviceFd(const QString& deviceNode, int fd);
+    static int cachedDeviceFd(const QString& deviceNode);
+    /** Drops the cached descriptor of a removed device. */
+    static void forgetDevice(const QString& deviceNode);
+
+private:
+    HelperSession() = default;
+
+    /** One poll round: flushes the outbox, collects stderr, frames and passed fds. */
+    bool pump(int timeoutMs);
+    void handleHello(const HelperProtocol::Frame& frame, QString* protocolError);
+    QString exitMessage();
+    bool flushOutbox();
+    void drainStderr();
+    void shutdown();
+    int reap(int timeoutMs);
+
+    pid_t m_pid = -1;
+    int m_socket = -1;
+    int m_stderr = -1;
+    Limits m_limits;
+    QElapsedTimer m_started;
+    QElapsedTimer m_idle;
+    QSet<QString> m_devices;
+    QByteArray m_inbox;
+    QByteArray m_outbox;
+    QByteArray m_stderrText;
+    std::deque<int> m_passedFds;
+    bool m_helloSeen = false;
+    bool m_answered = false;
+    bool m_exited = false;
+    int m_exitCode = -1;
+};
+
+} // namespace FlashSpartan
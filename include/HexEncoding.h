@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+#include <array>
+#include <cstddef>
+
+namespace FlashSpartan::HexEncoding {
+
+namespace detail {
+
+constexpr std::array<char, 512> makeHexPairs()
+{
+    constexpr char digits[] = "0123456789abcdef";
+    std::array<char, 512> pairs{};
+    for (int b = 0; b < 256; ++b) {
+        pairs[2 * b] = digits[b >> 4];
+        pairs[2 * b + 1] = digits[b & 0xF];
+    }
+    return pairs;
+}
+
+/** Two lowercase hex characters per byte value. */
+inline constexpr std::array<char, 512> kHexPairs = makeHexPairs();
+
+} // namespace detail
+
+/** Longest digest any hash path produces (EVP_MAX_MD_SIZE), in hex characters. */
+inline constexpr std::size_t kMaxDigestHexChars = 128;
+
+/**
+ * Writes exactly 2 * @p len lowercase hex characters to @p out (no terminator) and
+ * returns one past the last one. Same output as QByteArray::toHex().
+ */
+inline char* encode(const unsigned char* data, std::size_t len, char* out) noexcept
+{
+    for (std::size_t i = 0; i < len; ++i) {
+        const char* pair = &detail::kHexPairs[2 * data[i]];
+        *out++ = pair[0];
+        *out++ = pair[1];
+    }
+    return out;
+}
+
+/** Lowercase hex of @p len bytes as a QString, allocated once at its final size. */
+inline QString toString(const unsigned char* data, std::size_t len)
+{
+    QString hex(static_cast<qsizetype>(2 * len), Qt::Uninitialized);
+    QChar* out = hex.data();
+    for (std::size_t i = 0; i < len; ++i) {
+        const char* pair = &detail::kHexPairs[2 * data[i]];
+        *out++ = QLatin1Char(pair[0]);
+        *out++ = QLatin1Char(pair[1]);
+    }
+    return hex;
+}
+
+inline QString toString(const QByteArray& data)
+{
+    return toString(reinterpret_cast<const unsigned char*>(data.constData()),
+                    static_cast<std::size_t>(data.size()));
+}
+
+} // namespace FlashSpartan::HexEncoding
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+
+#include <vector>
+
+namespace FlashSpartan {
+
+/**
+ * @brief Per-device connect counts over sliding windows, in one-second buckets.
+ *
+ * Each device has a power-of-two ring of buckets that stores how many connects were
+ * recorded before that second began. count() subtracts two of those running totals, so a
+ * window of any length up to maxWindowSeconds() costs O(1), no matter how many connects a
+ * flooding device produced. record() is amortised O(1): it only fills the buckets that
+ * seconds without a connect skipped. Devices idle for longer than the window are dropped
+ * once many are tracked, so rotating serials cannot grow it without bound.
+ *
+ * Not thread-safe. The HID path calls it on the GUI thread only, so it needs neither locks
+ * nor atomics.
+ */
+class HidConnectCounter {
+public:
+    static constexpr int kMaxWindowSeconds = 3600;
+    static constexpr int kPruneAboveDevices = 1024;
+
+    explicit HidConnectCounter(int maxWindowSeconds = 10);
+
+    /** Longest window count() answers exactly; changing it forgets all counts. */
+    void setMaxWindowSeconds(int seconds);
+    int maxWindowSeconds() const { return m_maxWindowSeconds; }
+
+    void record(const QString& stableId, qint64 nowSecs);
+
+    /**
+     * Connects of @p stableId stamped within @p windowSeconds of @p nowSecs, i.e. in the
+     * seconds [nowSecs - windowSeconds, nowSecs]; windows past maxWindowSeconds() are clamped.
+     */
+    int count(const QString& stableId, int windowSeconds, qint64 nowSecs) const;
+
+    int deviceCount() const { return int(m_devices.size()); }
+    void clear() { m_devices.clear(); }
+
+private:
+    struct Device {
+        std::vector<quint32> before;  // running total when the slot's second began
+        qint64 lastSecond = 0;  // newest second with a filled slot
+        quint32 total = 0;
+    };
+
+    size_t slot(qint64 second) const { return size_t(second) & m_mask; }
+    void prune(qint64 nowSecs);
+
+    QHash<QString, Device> m_devices;
+    int m_maxWindowSeconds = 0;
+    size_t m_mask = 0;
+};
+
+} // namespace FlashSpartan
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QString>
+
+namespace FlashSpartan::HidDescriptorFingerprint {
+
+/** SHA-256 output size; every non-empty fingerprint has exactly this many bytes. */
+inline constexpr int kSize = 32;
+
+/**
+ * Fingerprint of a USB device's descriptors: the device and configuration descriptors
+ * (sysfs `descriptors`) plus the HID report descriptor of each interface, keyed by the
+ * interface's `config.interface` name so the hash does not depend on the port. Descriptors
+ * are walked by bLength and a truncated tail is dropped, so the same firmware always hashes
+ * the same. Empty when @p usbDescriptors holds no complete descriptor.
+ *
+ * The fingerprint is what the firmware claims about itself: a device that copies another's
+ * descriptors byte for byte gets its fingerprint too.
+ */
+QByteArray compute(const QByteArray& usbDescriptors,
+                   const QList<QPair<QString, QByteArray>>& reportDescriptors);
+
+/** Reads the descriptors under the sysfs usb_device at @p usbDevicePath; empty off Linux. */
+QByteArray fromSysfs(const QString& usbDevicePath);
+
+/** Lowercase hex, as stored in baselines and rule files. */
+inline QString toHex(const QByteArray& fingerprint)
+{
+    return QString::fromLatin1(fingerprint.toHex());
+}
+
+/** Parses toHex() output; empty for anything that is not kSize bytes of hex. */
+QByteArray fromHex(const QString& text);
+
+} // namespace FlashSpartan::HidDescriptorFingerprint
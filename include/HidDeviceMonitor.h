@@ -9,11 +9,12 @@
 #include <optional>
 
 struct udev;
-struct udev_monitor;
 struct udev_device;
 
 namespace FlashSpartan {
 
+struct UdevRecord;
+
 class HidDeviceMonitor : public QThread {
     Q_OBJECT
 
@@ -29,6 +30,12 @@ public:
     QList<HidDeviceInfo> connectedDevices() const;
     std::optional<HidDeviceInfo> getDevice(const QString& stableId) const;
 
+    /**
+     * Handles a recorded input event (UdevEventTrace) as if udev had delivered it, on the
+     * caller's thread. Linux only; the monitor need not be started.
+     */
+    void replayEvent(const UdevRecord& event);
+
 signals:
     void hidConnected(const FlashSpartan::HidDeviceInfo& device);
     void hidDisconnected(const QString& stableId);
@@ -44,23 +51,31 @@ private:
     void cleanupUdev();
     void scanExistingDevices();
     void processUdevEvent(struct udev_device* dev);
-    bool isUsbHidInput(struct udev_device* dev) const;
-    HidDeviceInfo extractDeviceInfo(struct udev_device* dev) const;
-    struct udev_device* getUsbDeviceParent(struct udev_device* dev) const;
-    struct udev_device* getUsbInterfaceParent(struct udev_device* dev) const;
-    QString getProperty(struct udev_device* dev, const char* key) const;
-    QString getSysAttr(struct udev_device* dev, const char* key) const;
-
-    struct udev* m_udev = nullptr;
-    struct udev_monitor* m_monitor = nullptr;
+    // Device is a live udev_device* or a replayed const UdevRecord* (UdevText overloads)
+    template <typename Device>
+    void handleEvent(Device dev);
+    template <typename Device>
+    bool isUsbHidInput(Device dev) const;
+    template <typename Device>
+    HidDeviceInfo extractDeviceInfo(Device dev) const;
+#ifdef Q_OS_WIN
+    bool interfaceArrived(const QString& devicePath);
+    bool tracksInterface(const QString& devicePath) const;
+
+    void* m_wakeEvent = nullptr;  // auto-reset event: notifications, rescan(), stop
+#endif
+
+    struct udev* m_udev = nullptr;  // UdevReactor's context (Linux)
+    int m_subscription = -1;
     std::atomic<bool> m_running{false};
     std::atomic<bool> m_rescanRequested{false};
-    int m_wakeupPipe[2] = {-1, -1};
 
     mutable QMutex m_devicesMutex;
     QHash<QString, HidDeviceInfo> m_devices;
 
-    static constexpr int POLL_TIMEOUT_MS = 500;
+    static constexpr int POLL_TIMEOUT_MS = 500;  // Windows, without device notifications
+    static constexpr int ARRIVAL_RETRY_MS = 250;
+    static constexpr int ARRIVAL_RETRIES = 8;
 };
 
 } // namespace FlashSpartan
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QHash>
+#include <QMetaType>
+#include <QString>
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+namespace FlashSpartan {
+
+struct UsbmonPacket;
+
+/**
+ * Streaming keystroke-rate check over usbmon events. Decodes HID boot-keyboard reports
+ * (8-byte interrupt-IN completions) per bus/device address, counts key-downs, keeps an
+ * inter-key-interval histogram and reports a Finding the moment the last kWindowKeys
+ * key-downs arrived faster than kMaxHumanKeysPerSecond; an idle gap of kRearmIdleUs re-arms
+ * it. Everything else is rejected on the first few header bytes, so feeding every event of
+ * every bus stays cheap. Not thread-safe: one instance per usbmon reader thread.
+ */
+class HidKeystrokeAnalyzer {
+public:
+    static constexpr int kWindowKeys = 16;
+    static constexpr int kMaxHumanKeysPerSecond = 40;
+    static constexpr qint64 kRearmIdleUs = 5 * 1000000;
+    /** Interval bucket i holds intervals below 2^(i+1) ms; the last one everything slower. */
+    static constexpr int kHistogramBuckets = 10;
+
+    struct Finding {
+        quint16 bus = 0;
+        quint8 device = 0;
+        qint64 timestampUs = 0;
+        int keys = 0;  // key-downs in the window
+        qint64 spanUs = 0;  // time they took
+        double keysPerSecond = 0.0;
+        std::array<quint32, kHistogramBuckets> histogram{};
+
+        /** "<2 ms: 14, <4 ms: 1, ..." without empty buckets. */
+        QString histogramText() const;
+    };
+
+    std::optional<Finding> feed(const UsbmonPacket& packet);
+
+    /** Boot-keyboard report in @p report (8 bytes)? Modifier-only and rollover reports count. */
+    static bool isBootKeyboardReport(const char* report, size_t length);
+
+private:
+    struct DeviceState {
+        std::array<quint8, 6> keys{};
+        std::array<qint64, kWindowKeys> downs{};  // ring of the latest key-down times
+        int downCount = 0;
+        qint64 lastDownUs = 0;
+        std::array<quint32, kHistogramBuckets> histogram{};
+        bool alerted = false;
+    };
+
+    static int bucketFor(qint64 intervalUs);
+
+    QHash<quint32, DeviceState> m_devices;  // bus << 8 | device address
+};
+
+} // namespace FlashSpartan
+
+Q_DECLARE_METATYPE(FlashSpartan::HidKeystrokeAnalyzer::Finding)
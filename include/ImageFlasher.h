@@ -0,0 +1,76 @@
+#pragma once
+
+#include "RawDeviceHash.h"
+#include "Types.h"
+
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+#include <cstdint>
+
+namespace FlashSpartan {
+
+/**
+ * Write-then-verify flashing of an image to a whole disk, one pass per direction. The image
+ * is read once: IsoVerifier checks it against the catalog, a sidecar or a trusted hash while
+ * each buffer is also written to the disk with O_DIRECT and cut into kDefaultChunkBytes block
+ * digests. The disk is then read back with the raw device engine and compared block by block
+ * with what was written (CloneVerify), stopping at the first block that differs. Linux only.
+ */
+class ImageFlasher {
+public:
+    struct Options {
+        QString imagePath;
+        /** Whole disk, not a partition; opened exclusively, so nothing on it may be mounted. */
+        QString deviceNode;
+        /** Block digests compared after the write. */
+        RawDeviceHash::Algorithm algorithm = RawDeviceHash::Algorithm::SHA256;
+        /** Count an image with no published or trusted hash to check as good. */
+        bool allowUnverifiedImage = false;
+        /**
+         * Write to a disk that is neither removable nor attached over USB. The disk the root
+         * filesystem is on is refused regardless.
+         */
+        bool allowFixedDisk = false;
+        std::atomic<bool>* cancelled = nullptr;
+        std::atomic<uint64_t>* bytesWritten = nullptr;
+        std::atomic<uint64_t>* bytesVerified = nullptr;
+    };
+
+    struct Result {
+        QString imagePath;
+        QString deviceNode;
+        uint64_t imageBytes = 0;
+        /** IsoVerifier's verdict on the image, from the same read that fed the write. */
+        IsoVerifyResult image;
+        /** Digests of what was written. */
+        QStringList blockHashes;
+        QString blockHash;
+        /** The read back; stoppedAtBlock marks a block that differs. */
+        HashResult readBack;
+        qint64 firstBadBlock = -1;
+        uint64_t writeMs = 0;
+        uint64_t verifyMs = 0;
+        /** Written, read back identical, and the image passed (or allowUnverifiedImage). */
+        bool success = false;
+        QString errorMessage;
+
+        bool imageVerified() const { return image.passed() && image.hashChecked && image.hasExpectedHash(); }
+    };
+
+    static Result flash(const Options& options);
+
+    /**
+     * Why flash() will not write @p imageBytes of options.imagePath to @p target, or empty:
+     * a compressed or empty image, a partition, the system disk, a fixed disk without
+     * allowFixedDisk, or a disk smaller than the image. flash() asks before it opens the disk.
+     */
+    static QString targetRefusal(const Options& options, uint64_t imageBytes,
+                                 const RawDeviceHash::DeviceAttachment& target);
+
+    /** Image names flash() refuses because they would be written still compressed. */
+    static bool isCompressedImage(const QString& path);
+};
+
+} // namespace FlashSpartan
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QString>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace FlashSpartan {
+namespace ImageDecoders {
+
+/**
+ * Decompressed payload of one compressed image, pulled in order by DecompressedImageHash.
+ * read() is called from a single (pipeline) thread; a decoder may use more threads inside.
+ */
+class StreamDecoder {
+public:
+    virtual ~StreamDecoder() = default;
+
+    /** Fill up to @p capacity bytes. Return bytes written, 0 at end of payload, -1 with @p error set. */
+    virtual int64_t read(char* buffer, size_t capacity, QString* error) = 0;
+};
+
+// One per format; each returns nullptr with @p error set when the file cannot be opened or
+// the build lacks the library (check the matching *Available() first).
+
+bool xzAvailable();
+std::unique_ptr<StreamDecoder> openXz(const QString& path, QString* error);
+
+bool zstdAvailable();
+std::unique_ptr<StreamDecoder> openZstd(const QString& path, QString* error);
+
+bool gzipAvailable();
+std::unique_ptr<StreamDecoder> openGzip(const QString& path, QString* error);
+
+/** The largest `.img` / `.iso` member of a zip archive (stored or deflated, zip64 aware). */
+bool zipAvailable();
+std::unique_ptr<StreamDecoder> openZipMember(const QString& path, QString* error);
+
+} // namespace ImageDecoders
+} // namespace FlashSpartan
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QString>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace FlashSpartan::IoBufferPool {
+
+/**
+ * Process-wide pool of aligned read buffers shared by the hash engines, the read pipeline,
+ * manifest and ISO file hashing. A buffer is borrowed for the lifetime of a Buffer object and
+ * goes back to the pool instead of being freed, so per-file and per-job hashing stops
+ * allocating and faulting in fresh megabytes each time. Large buffers can be backed by huge
+ * pages to cut TLB misses on long sequential reads. Thread-safe; a Buffer may be returned
+ * from any thread.
+ */
+
+/** Every buffer is aligned for O_DIRECT. */
+inline constexpr std::size_t kAlignment = 4096;
+/** Requests are rounded up to a power of two from here, so nearby sizes share buffers. */
+inline constexpr std::size_t kMinBufferBytes = 64 * 1024;
+/** Returned buffers beyond this many idle bytes are freed instead of kept. */
+inline constexpr std::size_t kMaxIdleBytes = 256 * 1024 * 1024;
+/** Buffers of at least this size may use huge pages (the x86-64 and arm64 default). */
+inline constexpr std::size_t kHugePageBytes = 2 * 1024 * 1024;
+
+enum class HugePages {
+    Off,
+    /** madvise(MADV_HUGEPAGE) on 2 MiB aligned memory; the kernel backs it when it can. */
+    Transparent,
+    /** MAP_HUGETLB from the reserved pool (vm.nr_hugepages); Transparent when it is empty. */
+    Explicit,
+};
+
+/** Applies to buffers allocated from now on; idle ones are kept. Linux only, Off elsewhere. */
+void setHugePages(HugePages mode);
+HugePages hugePages();
+/** "off", "transparent" or "explicit" (hashing/hugePages); anything else is Off. */
+HugePages hugePagesFromName(const QString& name);
+QString hugePagesName(HugePages mode);
+
+class Buffer {
+public:
+    Buffer() = default;
+    /** Borrows a buffer of at least @p bytes; data() is null when allocation failed. */
+    explicit Buffer(std::size_t bytes);
+    ~Buffer();
+
+    Buffer(Buffer&& other) noexcept;
+    Buffer& operator=(Buffer&& other) noexcept;
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    char* data() const { return m_data; }
+    /** The size asked for; the buffer itself may be larger. */
+    std::size_t size() const { return m_size; }
+    explicit operator bool() const { return m_data != nullptr; }
+
+private:
+    void release();
+
+    char* m_data = nullptr;
+    std::size_t m_size = 0;
+    std::size_t m_capacity = 0;
+    bool m_mapped = false;
+    bool m_huge = false;
+};
+
+struct Stats {
+    uint64_t allocations = 0;
+    uint64_t reuses = 0;
+    uint64_t idleBytes = 0;
+    /** Bytes of live and idle buffers allocated with huge pages requested. */
+    uint64_t hugePageBytes = 0;
+};
+
+Stats stats();
+/** Frees every idle buffer, e.g. after a batch or when memory is short. */
+void trim();
+
+} // namespace FlashSpartan::IoBufferPool
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <atomic>
+
+namespace FlashSpartan {
+
+/**
+ * The background I/O class. Full hashes, manifest baselines and reports, and mount-triggered
+ * ISO verification read in it (IoScheduler enters it for their tasks); reads the user is
+ * waiting for keep the normal class and full speed.
+ *
+ * A background thread reads at idle priority: on Linux ioprio_set(IOPRIO_CLASS_IDLE), which
+ * BFQ honours by serving the thread only while the disk is otherwise quiet, and which threads
+ * it starts inherit; on Windows THREAD_MODE_BACKGROUND_BEGIN, which lowers the thread's I/O
+ * and memory priority for that thread only. Schedulers without classes (mq-deadline, none)
+ * ignore the hint, so background readers also share an optional bandwidth cap, and all of
+ * them wait while held (on battery, when the user asks for that).
+ */
+class IoPriority {
+public:
+    enum class Class { Normal, Background };
+
+    /** Puts the calling thread in @p ioClass until destroyed; nests. */
+    class Scope {
+    public:
+        explicit Scope(Class ioClass);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        Class m_previous;
+        bool m_applied = false;
+        int m_savedPrio = 0;  // Linux ioprio_get() value to restore
+    };
+
+    /** Burst a background reader may take after idling, before the cap slows it. */
+    static constexpr qint64 kBurstNs = 250'000'000;
+
+    static Class current();
+
+    /** Shared by every background reader; 0 = uncapped. */
+    static void setBandwidthLimit(qint64 bytesPerSecond);
+    static qint64 bandwidthLimit();
+
+    static void setHeld(bool held);
+    static bool isHeld();
+
+    /**
+     * Charges @p bytes a background read just moved and sleeps while held or as long as the
+     * cap requires. Returns early once @p cancelled is set. Callers skip it for normal reads.
+     */
+    static void pace(qint64 bytes, const std::atomic<bool>* cancelled = nullptr);
+
+    /**
+     * The token bucket behind pace(): charges @p bytes at @p bytesPerSecond against
+     * @p nextFreeNs and returns how long the reader should sleep, in ns.
+     */
+    static qint64 reserveNs(qint64& nextFreeNs, qint64 nowNs, qint64 bytes, qint64 bytesPerSecond);
+
+    /** True when the machine is known to run on battery; false when it cannot tell. */
+    static bool onBatteryPower();
+};
+
+} // namespace FlashSpartan
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QPromise>
+#include <QString>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <type_traits>
+
+namespace FlashSpartan {
+
+/**
+ * Runs the device reads of HashWorker, ManifestWorker and IsoVerifierWorker from one queue,
+ * so the three cannot read the same stick at once or crowd each other out.
+ *
+ * Every task names a lane: the whole disk it reads (wholeDiskNode()), or none for work not
+ * tied to one device. A lane runs one task at a time, except that an Interactive task may
+ * join a lane busy with Background work only, so a verify the user waits for does not sit
+ * behind an hour-long full hash. I/O tasks share ioLimit() threads overall; past that they
+ * wait here instead of adding readers. CPU tasks run on a separate pool of one thread per
+ * core. A waiting task starts by priority, then arrival; one waiting kStarvationMs starts
+ * ahead of priority.
+ *
+ * Background tasks, and tasks marked backgroundIo, run in IoPriority's background class:
+ * idle disk priority, the shared bandwidth cap and the on-battery hold.
+ *
+ * HashWorker still picks which of its own queued hashes starts next per host controller
+ * (HashScheduler), then hands the hash to this queue.
+ */
+class IoScheduler {
+public:
+    enum class Priority { Interactive, Normal, Background };
+    enum class Pool { Io, Cpu };
+
+    struct Task {
+        QString lane;  // empty = not tied to one device
+        Priority priority = Priority::Normal;
+        Pool pool = Pool::Io;
+        /** Read in IoPriority's background class though queued at @c priority. */
+        bool backgroundIo = false;
+    };
+
+    struct Waiting {
+        Task task;
+        qint64 waitedMs = 0;
+    };
+
+    struct LaneLoad {
+        int running = 0;
+        int background = 0;  // of running
+    };
+
+    struct Load {
+        QHash<QString, LaneLoad> lanes;
+        int ioRunning = 0;
+        int cpuRunning = 0;
+    };
+
+    static constexpr int kDefaultIoLimit = 4;
+    static constexpr qint64 kStarvationMs = 5 * 60 * 1000;
+
+    IoScheduler();
+    ~IoScheduler();
+
+    IoScheduler(const IoScheduler&) = delete;
+    IoScheduler& operator=(const IoScheduler&) = delete;
+
+    static IoScheduler& instance();
+
+    /** The disk a partition node belongs to ("/dev/sdb" for "/dev/sdb1"); @p deviceNode otherwise. */
+    static QString wholeDiskNode(const QString& deviceNode);
+
+    /** Index into @p waiting of the task to start next under @p load, or -1. */
+    static int pickNext(const QList<Waiting>& waiting, const Load& load, int ioLimit, int cpuLimit);
+
+    void setIoLimit(int limit);
+    int ioLimit() const;
+
+    /** Tasks waiting for a lane or a thread. */
+    int queuedCount() const;
+
+    /** Blocks until nothing is queued or running; false when @p timeoutMs ran out first. */
+    bool waitForIdle(int timeoutMs = -1);
+
+    /**
+     * Queues @p fn and returns its future. Queued work that never starts (the scheduler is
+     * destroyed first) finishes as cancelled.
+     */
+    template <typename Fn>
+    QFuture<std::invoke_result_t<std::decay_t<Fn>>> run(const Task& task, Fn&& fn)
+    {
+        using Result = std::invoke_result_t<std::decay_t<Fn>>;
+        auto promise = std::make_shared<QPromise<Result>>();
+        QFuture<Result> future = promise->future();
+        promise->start();
+        enqueue(task, [promise, fn = std::forward<Fn>(fn)]() mutable {
+            try {
+                if constexpr (std::is_void_v<Result>) {
+                    fn();
+                } else {
+                    promise->addResult(fn());
+                }
+            } catch (...) {
+                promise->setException(std::current_exception());
+            }
+            promise->finish();
+        });
+        return future;
+    }
+
+private:
+    struct Queued {
+        Task task;
+        std::function<void()> body;
+        QElapsedTimer waited;
+    };
+
+    void enqueue(const Task& task, std::function<void()> body);
+    void dispatchLocked();
+    void finished(const Task& task);
+
+    QThreadPool m_ioPool;
+    QThreadPool m_cpuPool;
+    mutable QMutex m_mutex;
+    QWaitCondition m_idle;
+    QList<Queued> m_queue;
+    Load m_load;
+    int m_ioLimit = kDefaultIoLimit;
+};
+
+} // namespace FlashSpartan
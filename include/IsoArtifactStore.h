@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+
+#include <optional>
+
+namespace FlashSpartan {
+
+/**
+ * On-disk store for downloaded publisher checksum files and detached signatures.
+ * Blobs are content-addressed (named by their SHA-256 and re-checked on read); an index maps
+ * each source URL to its current blob and expiry. Repeat scans of a release and offline
+ * kiosks read from here instead of the network; gpg verifies the blob file directly.
+ */
+class IsoArtifactStore {
+public:
+    static constexpr int kMaxEntries = 512;
+    /** Pinned releases never change their SUMS; they are only re-fetched this rarely. */
+    static constexpr qint64 kPinnedReleaseMaxAgeSecs = 30LL * 24 * 3600;
+    /** Upper bound for "current"/"latest" trees, whatever the server's cache headers say. */
+    static constexpr qint64 kRollingReleaseMaxAgeSecs = 24LL * 3600;
+
+    struct Artifact {
+        QString url;
+        QString sha256;
+        /** Blob file; stable for as long as the entry exists. */
+        QString path;
+        QByteArray data;
+        QDateTime fetchedAt;
+        QDateTime expiresAt;
+
+        bool isFresh(const QDateTime& now = QDateTime::currentDateTimeUtc()) const
+        {
+            return expiresAt.isValid() && now < expiresAt;
+        }
+    };
+
+    /** Entry for @p url, fresh or expired; nullopt when missing or the blob fails its hash. */
+    static std::optional<Artifact> lookup(const QString& url);
+
+    /** Stores @p data for @p url; nullopt when the store cannot be written. */
+    static std::optional<Artifact> put(const QString& url, const QByteArray& data,
+                                       const QDateTime& expiresAt);
+
+    /**
+     * Expiry for an artifact fetched at @p now. Rolling releases follow the server's freshness
+     * (@p serverExpires, from Cache-Control / Expires) capped at kRollingReleaseMaxAgeSecs;
+     * pinned releases get kPinnedReleaseMaxAgeSecs.
+     */
+    static QDateTime expiryFor(bool rollingRelease, const QDateTime& serverExpires,
+                               const QDateTime& now = QDateTime::currentDateTimeUtc());
+
+    static void clear();
+
+    /** Store directory; empty restores the default under the user cache directory. */
+    static void setStorageDir(const QString& dir);
+    static QString storageDir();
+};
+
+} // namespace FlashSpartan
@@ -23,6 +23,13 @@ struct IsoPublisherMatch {
     /** Filename matched but hash must come from a sidecar or catalog update (e.g. Windows). */
     bool hintOnly = false;
     QString referenceUrl;
+    /** Artifacts live under a "current"/"latest" tree and change between releases. */
+    bool rollingRelease = false;
+    /** Image length in bytes; lets a dd-written stick be hashed over exactly that prefix. */
+    quint64 imageSizeBytes = 0;
+    /** SHA-256 of the first and last IsoPrescreen::kEdgeBytes of the image; empty when not listed. */
+    QString headSha256;
+    QString tailSha256;
 };
 
 /**
@@ -34,7 +41,7 @@ public:
 
     static QStringList knownPublisherIds();
 
-    /** True for .iso, .img.xz, .img, .zip (case-insensitive). */
+    /** True for .iso, .img.xz, .img.zst, .img.gz, .img, .zip (case-insensitive). */
     static bool isVerifiableImageFileName(const QString& fileName);
 };
 
@@ -2,6 +2,8 @@
 
 #include "IsoCatalog.h"
 
+#include <QHash>
+#include <QList>
 #include <QString>
 
 namespace FlashSpartan {
@@ -41,5 +43,49 @@ IsoPublisherMatch makeArmbian(const QString& fileName);
 IsoPublisherMatch makeNixos(const QString& fileName, const QString& channel, const QString& variant);
 IsoPublisherMatch makeEndeavourOs(const QString& fileName, const QString& dateVersion);
 
+/**
+ * Narrows a list of case-insensitive filename patterns to the few that can match a name, so
+ * matching costs the same for ten patterns or ten thousand. Exact patterns ("^name$", as
+ * user-trusted entries are written) sit in a hash; the rest are keyed by the literal text
+ * their matches must start with. Patterns with no such prefix are always candidates.
+ */
+class FileNamePatternIndex {
+public:
+    void clear();
+    void add(int id, const QString& pattern);
+
+    /** Ids of patterns that may match @p fileName, ascending, so the first match still wins. */
+    QList<int> candidates(const QString& fileName) const;
+
+    /**
+     * Literal text every match of @p pattern starts with (empty when it is not anchored or
+     * has a top-level alternation). @p exact is set when nothing follows it but "$".
+     */
+    static QString literalPrefix(const QString& pattern, bool* exact);
+
+private:
+    QHash<QString, QList<int>> m_exact;
+    QHash<QString, QList<int>> m_byPrefix;
+    QList<int> m_prefixLengths;  // distinct, ascending
+    QList<int> m_unindexed;
+};
+
+/**
+ * Merges @p manifestJson into a scratch catalog the way a load merges one source (remote
+ * manifest, drop-in or TOFU file), indexes it and looks @p fileName up. The publisher id
+ * of the first match, or empty. Leaves the loaded catalog alone; tests/fuzz drives it.
+ */
+QString lookupInManifest(const QByteArray& manifestJson, const QString& fileName, bool userTofu = false);
+
+/**
+ * Applies a catalog delta to the remote manifest @p manifestJson, as refreshRemoteIfStale()
+ * does before patching the loaded catalog. Entries are keyed by publisher_id and
+ * file_pattern: "removals" drop, then "upserts" replace in place or append. Fails with
+ * @p error set unless the delta's from_version is the manifest's catalog_version and every
+ * upsert parses. The delta's signature is the caller's to check.
+ */
+bool applyCatalogDelta(const QByteArray& manifestJson, const QByteArray& deltaJson, QByteArray* patchedOut,
+                       QString* error = nullptr);
+
 } // namespace IsoCatalogInternal
 } // namespace FlashSpartan
@@ -2,25 +2,73 @@
 
 #include "IsoCatalog.h"
 
+#include <QFuture>
+#include <QObject>
+
 #include <optional>
 
 namespace FlashSpartan {
 
+/** Announces catalog refreshes started with IsoCatalogManifest::refreshInBackground(). */
+class IsoCatalogNotifier : public QObject {
+    Q_OBJECT
+
+public:
+    static IsoCatalogNotifier& instance();
+
+signals:
+    /** Emitted from the refresh thread; @p ok as refreshRemoteIfStale() returned it. */
+    void refreshFinished(bool ok);
+
+private:
+    IsoCatalogNotifier();
+};
+
 /**
  * @brief Embedded and remotely updatable SHA-256 catalog (Windows and extensions).
+ *
+ * Every load builds a complete catalog and then swaps it in, so lookups never wait for a
+ * reload or refresh; one that starts mid-refresh uses the previous catalog.
  */
 class IsoCatalogManifest {
 public:
     static std::optional<IsoPublisherMatch> lookup(const QString& fileName);
 
+    /**
+     * First entry whose `volume_label` pattern matches the label of a dd-written stick and
+     * that records both `sha256` and `image_size`, so the device prefix can be checked.
+     */
+    static std::optional<IsoPublisherMatch> lookupDdImage(const QString& volumeLabel);
+
     static void ensureLoaded();
     static void reload();
 
-    /** Fetch remote_url into cache. When force=true, ignore cache age. */
+    /**
+     * Fetch remote_url into cache. When force=true, ignore cache age. Blocks the caller.
+     * With a LAN mirror set (IsoHttpClient::setMirror) the mirror's copy is used only when
+     * its detached signature (remote_url + ".asc") verifies against the bundled catalog key.
+     *
+     * When the cached manifest has a catalog_version and delta_url_template, the signed delta
+     * from that version is fetched instead and applied to the loaded catalog in place; the
+     * whole document is downloaded only when no delta applies.
+     */
     static bool refreshRemoteIfStale(int maxAgeSeconds = 7 * 24 * 3600, bool force = false);
 
+    /**
+     * refreshRemoteIfStale() on a worker thread; joins a refresh already running. Finishes
+     * at once (true) when the cache is fresh. IsoCatalogNotifier::refreshFinished follows
+     * every refresh it actually starts.
+     */
+    static QFuture<bool> refreshInBackground(int maxAgeSeconds = 7 * 24 * 3600, bool force = false);
+
     static int entryCount();
 
+    /**
+     * True for the catalog's remote_url, its delta URLs (delta_url_template with a version)
+     * and their ".asc" signatures; what IsoMirrorServer may fetch besides publisher files.
+     */
+    static bool isCatalogUrl(const QString& url);
+
     /** Save user-trusted hash for exact filename (TOFU). */
     static bool trustUserHash(const QString& fileName, const QString& sha256Hex);
 
@@ -28,6 +76,12 @@ public:
     static bool lastEmbeddedSha256Ok();
     static bool lastEmbeddedGpgOk();
 
+    /**
+     * True when the last load came from the cached snapshot (same source bytes as a load
+     * whose embedded checks passed) instead of parsing and verifying the JSON again.
+     */
+    static bool lastLoadFromSnapshot();
+
     /** Human-readable detail for tooltips and banners. */
     static QString integrityStatusText();
 };
@@ -1,17 +1,89 @@
 #pragma once
 
+#include "DigestAlgorithm.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
 #include <QString>
 
+#include <memory>
+
 namespace FlashSpartan {
 
 /**
- * @brief Parses publisher and sidecar SHA-256 checksum list content.
+ * @brief Parses publisher and sidecar checksum list content.
  */
 class IsoChecksum {
 public:
+    /** A listed digest and the algorithm it was made with. */
+    struct Digest {
+        DigestAlgorithm algorithm = DigestAlgorithm::Sha256;
+        QString hex;
+
+        bool isEmpty() const { return hex.isEmpty(); }
+    };
+
     /** Find hash for isoBaseName in SUMS-style content, or a single 64-hex line. */
     static QString parseSha256Content(const QString& content, const QString& isoBaseName,
                                       QString* errorOut = nullptr);
+
+    /**
+     * Like parseSha256Content for SHA-256, SHA-512 and BLAKE2b-512 lists. The algorithm is the
+     * BSD tag (`SHA512 (name) = …`, `BLAKE2b (name) = …`) or else the digest length; a bare
+     * 128-hex digest counts as BLAKE2b-512 when @p sourceName (file name or URL) names a
+     * b2sums list, SHA-512 otherwise.
+     */
+    static Digest parseDigestContent(const QString& content, const QString& isoBaseName,
+                                     const QString& sourceName, QString* errorOut = nullptr);
+
+    /** Algorithms a checksum list called @p sourceName is expected to hold; SHA-256 when unsure. */
+    static DigestAlgorithms algorithmsForSource(const QString& sourceName);
+};
+
+/**
+ * @brief Every entry of one checksum list, parsed in a single pass over the raw bytes.
+ *
+ * GNU (`hex  name`), BSD (`SHA512 (name) = hex`) and mixed-algorithm files are all read the
+ * way IsoChecksum::parseDigestContent reads them, but each image lookup afterwards is a hash
+ * lookup instead of another scan, which matters for mirror lists with thousands of entries.
+ */
+class ChecksumList {
+public:
+    static constexpr DigestAlgorithms kAllAlgorithms =
+        DigestAlgorithm::Sha256 | DigestAlgorithm::Sha512 | DigestAlgorithm::Blake2b512;
+
+    static ChecksumList parse(const QByteArray& content, const QString& sourceName);
+
+    /**
+     * parse(), reusing the result for the same @p sourceName and bytes: a SUMS file shared by
+     * every image on a stick is parsed once however many images it lists.
+     */
+    static std::shared_ptr<const ChecksumList> cached(const QByteArray& content, const QString& sourceName);
+
+    /**
+     * Digest for @p isoBaseName among @p accepted algorithms: a BSD-tagged entry for exactly
+     * that name first, then the first GNU entry naming it (`*name`, `./name`, `dir/name`), then
+     * a file that is one bare digest. An empty name takes the first GNU entry.
+     */
+    IsoChecksum::Digest find(const QString& isoBaseName, DigestAlgorithms accepted = kAllAlgorithms,
+                             QString* errorOut = nullptr) const;
+
+    qsizetype size() const { return m_entries.size(); }
+
+private:
+    struct Entry {
+        QString name;
+        IsoChecksum::Digest digest;
+        bool tagged = false;
+    };
+
+    void addLine(QByteArrayView line, const QString& sourceName);
+    void addEntry(const QString& name, QByteArrayView hex, DigestAlgorithm algorithm, bool tagged);
+
+    QList<Entry> m_entries;                   // file order
+    QHash<QString, QList<int>> m_byBaseName;  // last path component -> m_entries indexes
+    IsoChecksum::Digest m_bare;
 };
 
 } // namespace FlashSpartan
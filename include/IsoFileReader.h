@@ -0,0 +1,33 @@
+#pragma once
+
+#include "IsoVerifyOptions.h"
+
+#include <QString>
+
+#include <cstddef>
+#include <functional>
+
+namespace FlashSpartan {
+
+/**
+ * Streams an image file to a consumer for hashing, each mode with a reader thread
+ * (RawDeviceHash::runPipelined) so the next read is in flight while the consumer hashes
+ * the last one. PageCache reads 1 MiB at a time through QFile into two buffers. On Linux,
+ * DropBehind and Direct read 8 MiB aligned buffers: DropBehind hints
+ * POSIX_FADV_SEQUENTIAL and drops what it has read with POSIX_FADV_DONTNEED; Direct opens
+ * with O_DIRECT and falls back to DropBehind on filesystems that refuse it. Elsewhere
+ * every mode reads through the page cache.
+ */
+class IsoFileReader {
+public:
+    using ConsumeFn = std::function<bool(const char* data, std::size_t length)>;
+
+    /**
+     * Feeds the file from @p startOffset to its end through @p consume, in order, on the
+     * calling thread. An offset that is not block aligned turns Direct into DropBehind.
+     */
+    static bool readAll(const QString& path, IsoReadCache mode, const ConsumeFn& consume,
+                        QString* errorOut, qint64 startOffset = 0);
+};
+
+} // namespace FlashSpartan
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "IsoVerifyCache.h"
+
+#include <QByteArray>
+#include <QString>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+namespace FlashSpartan {
+
+/**
+ * Resume points for the SHA-256 of large image files. While a file is hashed its running
+ * digest state is saved every kCheckpointBytes, and once more when the read stops (cancel,
+ * unplug, read error); the next verify of the same unchanged file continues from there
+ * instead of from byte 0. A finished hash removes its resume point.
+ *
+ * A resume point is found by the file's volume identity and path below the volume root,
+ * and only used while its size, mtime and ctime are unchanged. The inode is left out:
+ * vfat and exFAT number inodes per mount, and a replug is the case this is for. The
+ * bytes before the offset are not read again, so a resume trusts the file the way
+ * IsoVerifyCache does and is only used when the hash cache is.
+ */
+class IsoHashResume {
+public:
+    /** Smaller files are hashed from the start every time. */
+    static constexpr qint64 kMinFileBytes = 512LL * 1024 * 1024;
+    /** How much is hashed between saves while the read goes on. */
+    static constexpr qint64 kCheckpointBytes = 256LL * 1024 * 1024;
+    /** Resume points not touched for this long are dropped on the next save. */
+    static constexpr int kMaxAgeDays = 30;
+
+    /**
+     * SHA-256 whose running state can be saved and restored. OpenSSL 3 has no way to
+     * export an EVP_MD_CTX, so this uses the legacy SHA256_CTX, which is plain data; a
+     * state only restores into the OpenSSL build that saved it.
+     */
+    class Sha256 {
+    public:
+        Sha256();
+        ~Sha256();
+
+        Sha256(const Sha256&) = delete;
+        Sha256& operator=(const Sha256&) = delete;
+
+        bool update(const void* data, std::size_t size);
+        /** Lowercase hex digest; the state is spent afterwards. */
+        QString finish();
+
+        QByteArray saveState() const;
+        /** False, leaving the state as it was, when @p state is not from this build. */
+        bool restoreState(const QByteArray& state);
+
+    private:
+        struct Context;
+        std::unique_ptr<Context> m_ctx;
+    };
+
+    struct Checkpoint {
+        qint64 offset = 0;
+        QByteArray state;
+    };
+
+    /** The resume point for @p key; std::nullopt when there is none or the file changed. */
+    static std::optional<Checkpoint> load(const IsoVerifyCache::FileKey& key);
+    /** Atomically replaces the resume point for @p key. */
+    static bool save(const IsoVerifyCache::FileKey& key, const Checkpoint& checkpoint);
+    static void remove(const IsoVerifyCache::FileKey& key);
+
+    /** Directory holding one file per resume point; empty restores the default under the user cache directory. */
+    static void setStorageDirectory(const QString& dir);
+    static QString storageDirectory();
+};
+
+} // namespace FlashSpartan
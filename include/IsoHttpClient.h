@@ -1,20 +1,58 @@
 #pragma once
 
 #include <QByteArray>
+#include <QDateTime>
+#include <QFuture>
 #include <QString>
 #include <functional>
 
 namespace FlashSpartan {
 
-/** HTTP fetch for ISO verification (replaceable in tests). */
+/**
+ * HTTP fetch for ISO verification (replaceable in tests).
+ *
+ * Requests go through one QNetworkAccessManager on a dedicated network thread, so
+ * connections to a publisher host stay alive between files and HTTP/2 is used where the
+ * server offers it. Concurrent fetches of the same URL share one request. Responses are
+ * kept in an HTTP disk cache and revalidated with If-None-Match / If-Modified-Since.
+ */
 class IsoHttpClient {
 public:
     using Handler = std::function<QByteArray(const QString& url, QString* errorOut, int timeoutMs)>;
 
+    struct Response {
+        QByteArray data;
+        /** Empty on success. */
+        QString error;
+        int httpStatus = 0;
+        /** Served from the disk cache (fresh, or after a 304). */
+        bool fromCache = false;
+        /** Freshness the server declared (Cache-Control max-age, else Expires); invalid if none. */
+        QDateTime expires;
+
+        bool ok() const { return error.isEmpty(); }
+    };
+
+    /** Starts the download (or joins one already running for @p url). */
+    static QFuture<Response> fetch(const QString& url, int timeoutMs = 90000);
+
+    /** fetch() and wait; blocks the calling thread, not the network thread. */
     static QByteArray get(const QString& url, QString* errorOut = nullptr, int timeoutMs = 90000);
     static void setHandler(Handler handler);
     static void reset();
 
+    /**
+     * LAN mirror (IsoMirrorServer) at @p baseUrl, e.g. "http://kiosk-01:8470"; empty turns
+     * it off. Callers route through it only what they verify themselves (signed checksums,
+     * signatures, the signed remote catalog) and fall back to the origin when it fails.
+     */
+    static void setMirror(const QString& baseUrl);
+    /**
+     * Where the mirror serves @p url, fetched for the image @p imageFileName (which lets the
+     * mirror check that the catalog names that URL); empty when no mirror is set.
+     */
+    static QString mirrorUrlFor(const QString& url, const QString& imageFileName = {});
+
 private:
     static Handler& handlerRef();
 };
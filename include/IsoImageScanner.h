@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+#include <functional>
+
+namespace FlashSpartan {
+
+/**
+ * Finds verifiable images under a directory (IsoCatalog::isVerifiableImageFileName) with
+ * several threads listing directories at once. Reserved multiboot trees
+ * (IsoScanRules::isReservedMultibootDirectory) and hidden entries are pruned before they
+ * are opened, and on POSIX only directories are stat()ed: a file is judged by its name.
+ * On Windows each directory is one DirectoryListing call, with no per-entry lookups.
+ * Each directory is walked once, so symlink loops end on their own.
+ */
+class IsoImageScanner {
+public:
+    static constexpr int kDefaultMaxDepth = 64;
+    static constexpr int kMaxThreads = 8;
+
+    struct Limits {
+        int maxDepth = kDefaultMaxDepth;
+        /** Stop listing after this long; 0 = no limit. */
+        qint64 timeBudgetMs = 0;
+        /** 0 = idealThreadCount() capped at kMaxThreads. */
+        int threads = 0;
+        std::atomic<bool>* cancelled = nullptr;
+    };
+
+    struct Result {
+        QStringList paths;  // sorted
+        int directories = 0;
+        /** The depth or time budget, or cancellation, left part of the tree unlisted. */
+        bool truncated = false;
+    };
+
+    /**
+     * Walks @p root. @p found, when set, is called from walker threads with each image as
+     * soon as its directory has been listed, so hashing can start before the walk ends.
+     */
+    static Result scan(const QString& root, const Limits& limits = {},
+                       const std::function<void(const QString& path)>& found = {});
+};
+
+} // namespace FlashSpartan
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QHash>
+#include <QHostAddress>
+#include <QString>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <functional>
+
+namespace FlashSpartan {
+
+/**
+ * LAN mirror for sites behind one slow link (flashspartan-verify --serve-mirror). Answers
+ * GET /fetch?url=<publisher URL>[&image=<file name>] from the IsoArtifactStore and
+ * downloads on a miss or an expired entry, so a hundred kiosks cost one download per
+ * checksum file; when the origin is unreachable an expired copy is still served.
+ *
+ * It fetches only what the Allow predicate accepts (the catalog's URL for that image, or
+ * the remote catalog and its signature), so it is not an open proxy. Clients do not trust
+ * it either: they route through it only artifacts they verify themselves (see
+ * IsoHttpClient::setMirror).
+ */
+class IsoMirrorServer {
+public:
+    static constexpr quint16 kDefaultPort = 8470;
+    static constexpr int kMaxRequestBytes = 8192;
+    /** A connection that has not sent its request by then is dropped. */
+    static constexpr int kRequestTimeoutMs = 10000;
+
+    /** Whether the mirror may fetch @p url for the image named @p imageFileName (may be empty). */
+    using Allow = std::function<bool(const QString& url, const QString& imageFileName)>;
+
+    explicit IsoMirrorServer(Allow allow);
+    ~IsoMirrorServer();
+
+    IsoMirrorServer(const IsoMirrorServer&) = delete;
+    IsoMirrorServer& operator=(const IsoMirrorServer&) = delete;
+
+    bool listen(const QHostAddress& address, quint16 port, QString* error = nullptr);
+    quint16 serverPort() const { return m_server.serverPort(); }
+
+private:
+    void onNewConnection();
+    void readRequest(QTcpSocket* socket);
+    void serve(QTcpSocket* socket, const QString& url);
+    /** Writes one response and closes; a valid @p expires becomes Cache-Control max-age. */
+    static void respond(QTcpSocket* socket, int status, const QByteArray& body, const QDateTime& expires = {});
+
+    Allow m_allow;
+    QTcpServer m_server;
+    QHash<QTcpSocket*, QByteArray> m_requests;
+};
+
+} // namespace FlashSpartan
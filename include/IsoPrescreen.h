@@ -0,0 +1,51 @@
+#pragma once
+
+#include "IsoCatalog.h"
+
+#include <QString>
+#include <cstdint>
+
+namespace FlashSpartan {
+
+/**
+ * Millisecond check of an image file against what its catalog entry lists: the exact size
+ * (`image_size`) and SHA-256 digests of the first and last kEdgeBytes (`head_sha256`,
+ * `tail_sha256`). A truncated download or a different build of the same file name fails
+ * here before the full hash starts.
+ *
+ * Passing proves nothing on its own: the middle of the file is unread, so a verify still
+ * needs the full hash to pass.
+ */
+namespace IsoPrescreen {
+
+inline constexpr qint64 kEdgeBytes = 1024 * 1024;
+
+struct EdgeDigests {
+    QString headSha256;
+    QString tailSha256;
+
+    bool isEmpty() const { return headSha256.isEmpty(); }
+};
+
+/**
+ * SHA-256 of the first and last kEdgeBytes of @p path; both cover the whole file when it is
+ * shorter. Empty when the file cannot be read. This is what the catalog lists.
+ */
+EdgeDigests edgeDigests(const QString& path, QString* errorOut = nullptr);
+
+/**
+ * False for compressed images (.img.xz, .img.zst, .img.gz, .zip): the catalog's size and
+ * digests describe the decoded image, not the file on disk.
+ */
+bool appliesTo(const QString& fileName);
+
+/**
+ * Why @p path cannot be the image @p match lists, for the report; empty when it could be,
+ * when the entry lists nothing to check, or when the file cannot be read (the full hash
+ * then reports that).
+ */
+QString mismatch(const QString& path, const IsoPublisherMatch& match);
+
+} // namespace IsoPrescreen
+
+} // namespace FlashSpartan
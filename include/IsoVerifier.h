@@ -19,6 +19,8 @@ public:
         QStringList isoPaths;
         QString layoutNote;
         bool looksLikeDdIsoStick = false;
+        /** The walk hit IsoImageScanner's time or depth budget; isoPaths may be incomplete. */
+        bool scanTruncated = false;
     };
 
     static MountScanResult scanMountPoint(const QString& mountPoint);
@@ -39,11 +41,38 @@ public:
                                               const QString& deviceNode = {});
 
     static QList<IsoVerifyResult> verifyDirectory(const QString& directory);
+    /** verifyDirectory() over an explicit list of image paths, e.g. a CI batch. */
+    static QList<IsoVerifyResult> verifyFiles(const QStringList& paths);
 
     static QList<IsoVerifyResult> verifyMountPoint(const QString& mountPoint,
                                                    const QString& deviceNode = {});
 
-    static IsoVerifyOptions& verifyOptions();
+    /**
+     * Verifies started on this thread while it lives use @p options instead of
+     * verifyOptions(), which is what lets concurrent runs each have their own cancel flag
+     * and progress callback. The verifier carries it to its own worker threads; @p options
+     * must outlive the run. A run started without one keeps the options published when it
+     * started, whatever setVerifyOptions() does meanwhile.
+     */
+    class OptionsScope {
+    public:
+        explicit OptionsScope(const IsoVerifyOptions& options);
+        ~OptionsScope();
+
+        OptionsScope(const OptionsScope&) = delete;
+        OptionsScope& operator=(const OptionsScope&) = delete;
+
+    private:
+        const IsoVerifyOptions* m_previous;
+    };
+
+    /**
+     * Defaults for runs without an OptionsScope, and the template each scoped run copies.
+     * A copy of the published options: change it and install it with an OptionsScope, or
+     * publish it with setVerifyOptions().
+     */
+    static IsoVerifyOptions verifyOptions();
+    /** Publishes @p options for runs started from now on; running ones are not affected. */
     static void setVerifyOptions(const IsoVerifyOptions& options);
 
     static bool mountScanHasFailures(const QList<IsoVerifyResult>& results);
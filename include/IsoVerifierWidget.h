@@ -97,6 +97,8 @@ private:
     QTextEdit* m_reportView = nullptr;
     QList<IsoVerifyResult> m_lastResults;
     QString m_lastDeviceNode;
+    /** "Update catalog" was clicked; its refresh result goes to the summary label. */
+    bool m_catalogUpdateRequested = false;
 };
 
 } // namespace FlashSpartan
@@ -1,41 +1,91 @@
 #pragma once
 
+#include "AsyncTask.h"
+#include "IoScheduler.h"
 #include "Types.h"
+#include "IsoVerifyOptions.h"
+#include "ProgressHub.h"
 
 #include <QObject>
 #include <QString>
 #include <QFuture>
+#include <QHash>
+#include <QMutex>
 
 #include <atomic>
+#include <functional>
+#include <memory>
 
 namespace FlashSpartan {
 
 /**
- * @brief Runs ISO verification on a background thread (mount-triggered or manual).
+ * @brief Runs ISO verification on background threads (mount-triggered or manual).
+ *
+ * Every run is a job of its own, with its own cancel flag, progress counters and
+ * ProgressHub sample (Kind::IsoVerify, by job id). Jobs queue in IoScheduler, so sticks on
+ * different disks verify in parallel while two runs on one disk take turns. A second request
+ * for a mount or folder already queued or running returns the existing job.
+ *
+ * A job is a coroutine (runJob): the verification itself is one IoScheduler stage, and the
+ * job resumes on the worker's thread to record and report the results, so no thread waits
+ * on a queued run.
  */
 class IsoVerifierWorker : public QObject {
     Q_OBJECT
 
 public:
     explicit IsoVerifierWorker(QObject* parent = nullptr);
+    ~IsoVerifierWorker() override;
 
-    void verifyMountPoint(const QString& mountPoint, const QString& deviceNode);
-    void verifyDirectory(const QString& directory, const QString& deviceNode = {});
+    /** @return the job id */
+    QString verifyMountPoint(const QString& mountPoint, const QString& deviceNode);
+    QString verifyDirectory(const QString& directory, const QString& deviceNode = {});
 
+    /** Cancels every job. */
     void cancel();
+    /** @return false when @p jobId is not queued or running */
+    bool cancelJob(const QString& jobId);
+
+    bool hasActiveJobs() const;
+    bool ownsJob(const QString& jobId) const;
+    /** Id of the most recently started job, for callers that follow one run at a time. */
+    QString jobId() const;
+    /** Per job: images started of those found, and the latest file name. */
+    QList<ProgressSample> progressSnapshot() const;
 
 signals:
-    void verificationStarted(const QString& mountPoint, const QString& deviceNode);
-    void verificationProgress(const QString& message);
-    void verificationFileProgress(int current, int total, const QString& fileName);
+    void verificationStarted(const QString& mountPoint, const QString& deviceNode, const QString& jobId);
+    void verificationProgress(const QString& message, const QString& jobId);
     void verificationFinished(const QString& mountPoint, const QString& deviceNode,
-                              const QList<IsoVerifyResult>& results);
-    void verificationFailed(const QString& mountPoint, const QString& error);
+                              const QList<IsoVerifyResult>& results, const QString& jobId);
+    void verificationFailed(const QString& mountPoint, const QString& error, const QString& jobId);
 
 private:
-    bool m_cancelled = false;
-    std::atomic<bool> m_cancelledFlag{false};
-    QFuture<void> m_activeJob;
+    struct Job {
+        QString id;
+        QString target;  // mount point or directory
+        QString deviceNode;
+        IsoVerifyOptions options;  // verifyOptions() with this job's cancel flag and progress
+        std::atomic<bool> cancelled{false};
+        std::atomic<int> filesStarted{0};
+        std::atomic<int> filesTotal{0};
+        mutable QMutex fileMutex;
+        QString currentFile;  // guarded by fileMutex
+        QFuture<QList<IsoVerifyResult>> future;
+    };
+
+    /** A new job for @p target, or nullptr with @p existingId set when one is already active. */
+    std::shared_ptr<Job> beginJob(const QString& target, const QString& deviceNode, QString* existingId);
+    /**
+     * Queues @p verify as @p task, then drops the job and emits its results on the worker's
+     * thread; results are dropped once cancelled.
+     */
+    AsyncTask<> runJob(std::shared_ptr<Job> job, IoScheduler::Task task,
+                       std::function<QList<IsoVerifyResult>()> verify);
+
+    mutable QMutex m_jobsMutex;
+    QHash<QString, std::shared_ptr<Job>> m_jobs;  // by id; guarded by m_jobsMutex
+    QString m_latestJobId;                        // guarded by m_jobsMutex
 };
 
 } // namespace FlashSpartan
@@ -2,15 +2,65 @@
 
 #include <QString>
 
+#include <cstdint>
+
 namespace FlashSpartan {
 
-/** Session-persistent SHA-256 cache keyed by path, size, and mtime. */
+/**
+ * SHA-256 cache for verified images, kept on disk across sessions and shared with the CLI.
+ * Entries are keyed by the volume's stable identity (filesystem UUID, or the volume GUID on
+ * Windows) and the path below its root, so a stick keeps its entries wherever it is mounted;
+ * size, mtime, inode and ctime must all still match for a hit. The file is read on first use
+ * and bounded to kMaxEntries, least recently used first out.
+ *
+ * In memory the entries are split over kShardCount shards, each behind its own read-write
+ * lock, so parallel verify workers and the widget only meet when they touch the same shard.
+ */
 class IsoVerifyCache {
 public:
-    static QString lookup(const QString& filePath, qint64 size, qint64 mtimeMs);
-    static void store(const QString& filePath, qint64 size, qint64 mtimeMs, const QString& sha256Hex);
+    static constexpr int kMaxEntries = 4096;
+    static constexpr int kShardCount = 16;
+
+    /** Counters since start (or the last clear()). */
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t stores = 0;
+        uint64_t evictions = 0;
+        int entries = 0;
+    };
+
+    /** What the cache knows a file by; from one stat. */
+    struct FileKey {
+        QString volumeId;
+        QString relativePath;
+        qint64 size = -1;
+        qint64 mtimeMs = 0;
+        quint64 inode = 0;
+        qint64 ctimeMs = 0;
+
+        bool isValid() const { return !volumeId.isEmpty() && size >= 0; }
+        bool operator==(const FileKey& o) const
+        {
+            return volumeId == o.volumeId && relativePath == o.relativePath && size == o.size
+                   && mtimeMs == o.mtimeMs && inode == o.inode && ctimeMs == o.ctimeMs;
+        }
+    };
 
+    /** Key for @p filePath now; invalid when the file cannot be stat'ed. */
+    static FileKey keyFor(const QString& filePath);
+
+    static QString lookup(const FileKey& key);
+    static void store(const FileKey& key, const QString& sha256Hex);
+
+    static Stats stats();
+
+    /** Drops every entry, in memory and on disk, and resets the counters. */
     static void clear();
+
+    /** Cache file location; empty restores the default under the user cache directory. */
+    static void setStoragePath(const QString& path);
+    static QString storagePath();
 };
 
 } // namespace FlashSpartan
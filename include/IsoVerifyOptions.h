@@ -1,20 +1,75 @@
 #pragma once
 
 #include <atomic>
+#include <cstddef>
 #include <functional>
 
 #include <QString>
 
 namespace FlashSpartan {
 
+struct IsoVerifyResult;
+
+/** How image hashing treats the page cache (`iso/readCache`). */
+enum class IsoReadCache {
+    PageCache,   // plain buffered reads; a re-read of the same image is served from RAM
+    DropBehind,  // POSIX_FADV_SEQUENTIAL, pages dropped behind the cursor (Linux)
+    Direct,      // O_DIRECT into aligned buffers, drop-behind where unsupported (Linux)
+};
+
+inline IsoReadCache isoReadCacheFromString(const QString& value)
+{
+    if (value == QStringLiteral("drop-behind")) {
+        return IsoReadCache::DropBehind;
+    }
+    if (value == QStringLiteral("direct")) {
+        return IsoReadCache::Direct;
+    }
+    return IsoReadCache::PageCache;
+}
+
 struct IsoVerifyOptions {
     bool useHashCache = true;
     int maxParallel = 2;
-    /** Hash decompressed stream for .img.xz (requires xz in PATH). */
+    /**
+     * Images verified at once, exactly (flashspartan-verify --jobs). 0 leaves it to the
+     * scheduler, which learns the drive's throughput up to a ceiling maxParallel may raise.
+     */
+    int parallelLimit = 0;
+    /**
+     * Hash the decompressed payload of .img.xz / .img.zst / .img.gz / .zip (see
+     * DecompressedImageHash; .img.xz falls back to xz in PATH when built without liblzma).
+     */
     bool verifyDecompressed = false;
     bool preferOfflineSidecars = false;
+    /** Keep multi-gigabyte images from evicting the desktop's working set; see IsoFileReader. */
+    IsoReadCache readCache = IsoReadCache::PageCache;
+    /**
+     * A dd-written stick whose volume label the catalog knows is checked by hashing the raw
+     * disk prefix of the image's length; may ask for elevated access to the device.
+     */
+    bool verifyDdImages = false;
+    /**
+     * LAN mirror for publisher checksums and signatures (`iso/mirrorUrl`, e.g.
+     * "http://kiosk-01:8470"; see IsoMirrorServer). Only signed artifacts go through it.
+     */
+    QString mirrorUrl;
     std::atomic<bool>* cancelled = nullptr;
+    /**
+     * Plain image files: every buffer of the verify's one read of the image, in order, on
+     * its hash thread (ImageFlasher writes them to a stick). Returning false fails the read.
+     * The hash cache is not consulted while it is set, so the image is always read.
+     */
+    std::function<bool(const char* data, size_t length)> imageDataRead;
     std::function<void(int current, int total, const QString& fileName)> progress;
+    /** Each image's result as it finishes, on its worker thread; calls never overlap. */
+    std::function<void(const IsoVerifyResult& result)> resultReady;
+    /**
+     * Profiling: each stage of an image as it ends ("image", "hash", "checksums",
+     * "signature_download", "key_import", "signature_verify", "hash_wait"), on the thread
+     * that ran it. Times are steady_clock nanoseconds.
+     */
+    std::function<void(const QString& isoPath, const char* stage, qint64 beginNs, qint64 endNs)> stageTimed;
 };
 
 } // namespace FlashSpartan
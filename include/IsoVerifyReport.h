@@ -2,6 +2,7 @@
 
 #include "Types.h"
 
+#include <QJsonObject>
 #include <QList>
 #include <QString>
 
@@ -21,6 +22,8 @@ public:
     static QString buildHtml(const QList<IsoVerifyResult>& results);
     /** Compact JSON for scripting (`--json`). */
     static QString buildJson(const QList<IsoVerifyResult>& results);
+    /** One entry of buildJson()'s "results" array. */
+    static QJsonObject resultToJson(const IsoVerifyResult& result);
     static QString summaryLine(const QList<IsoVerifyResult>& results);
 };
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "IsoVerifyOptions.h"
+#include "Types.h"
 
 #include <QString>
 
@@ -11,6 +12,14 @@ class IsoVerifySettingsLoader {
 public:
     static IsoVerifyOptions load(const QString& configFilePath = {});
     static void applyToVerifier(const QString& configFilePath = {});
+
+    /** The verify options @p settings describe; reads no file. */
+    static IsoVerifyOptions fromSettings(const AppSettings& settings);
+    /**
+     * Keeps IsoVerifier::verifyOptions() in step with SettingsSnapshot: applies the current
+     * snapshot now and every one published later. Call once, from the GUI.
+     */
+    static void followSnapshot();
 };
 
 } // namespace FlashSpartan
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Types.h"
+
+#include <QByteArray>
+#include <QString>
+#include <cstdint>
+#include <functional>
+
+namespace FlashSpartan {
+
+/**
+ * Connect-time identity check from the first sectors of a stick: the partition table area
+ * of the disk and the boot sector or superblock of the volume. Compared with the
+ * fingerprint taken with the baseline, it catches a repartitioned, reformatted or
+ * re-imaged stick in a few milliseconds, long before a manifest or raw hash would.
+ *
+ * Only fields that mounting and ordinary writes leave alone go into the fingerprint;
+ * mount counts, dirty flags and write counters are parsed too, for EjectSealProbe, which
+ * does want to see them move.
+ */
+namespace LayoutProbe {
+
+inline constexpr uint64_t kSectorBytes = 4096;
+/** MBR and the primary GPT header and entries (LBA 0-33), rounded up to whole sectors. */
+inline constexpr uint64_t kTableBytes = 20480;
+/** Start of the volume: FAT and exFAT boot sectors, the ext superblock at 1024. */
+inline constexpr uint64_t kHeadBytes = 64 * 1024;
+
+/**
+ * Reads exactly @p length bytes at @p offset into @p buffer; false on a read error.
+ * Offsets, lengths and the buffer are kSectorBytes aligned, so O_DIRECT reads are legal.
+ */
+using ReadAt = std::function<bool(uint64_t offset, char* buffer, size_t length)>;
+
+/** What the boot sector or superblock at the start of a volume says. */
+struct VolumeHead {
+    QString fsType;        // "fat", "exfat", "ext"; empty when not recognised
+    QString volumeSerial;  // FAT/exFAT serial number, ext UUID
+    bool volumeDirty = false;
+    uint64_t writeCounter = 0;  // ext: s_kbytes_written
+    uint32_t mountCount = 0;    // ext: s_mnt_count
+    qint64 lastWriteTime = 0;   // ext: s_wtime
+};
+
+VolumeHead parseVolumeHead(const QByteArray& head);
+
+/**
+ * Fingerprints a volume of @p volumeBytes read through @p volume; @p disk reads the whole
+ * disk it lives on. When @p disk is empty the volume is the whole disk and one read covers
+ * both. @p head, when given, receives the parsed boot sector or superblock. Empty
+ * (isEmpty()) when a read fails.
+ */
+LayoutFingerprint capture(const ReadAt& volume, uint64_t volumeBytes, const ReadAt& disk,
+                          VolumeHead* head = nullptr);
+
+#ifndef Q_OS_WIN
+/** Positioned reads on an open descriptor, retried on EINTR. */
+ReadAt descriptorReader(int fd);
+#endif
+
+/** Opens both nodes directly and fingerprints @p volumeNode; empty when either cannot be read, and on Windows. */
+LayoutFingerprint captureDevice(const QString& volumeNode, const QString& diskNode);
+
+/** Why @p now differs from @p baseline, for the log; empty when it does not. */
+QString mismatch(const LayoutFingerprint& baseline, const LayoutFingerprint& now);
+
+} // namespace LayoutProbe
+
+} // namespace FlashSpartan
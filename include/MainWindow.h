@@ -10,26 +10,36 @@
 #include <QStackedWidget>
 #include <QSplitter>
 #include <QListWidget>
+#include <QListView>
 #include <QTimer>
 #include <QTabBar>
 #include <QPushButton>
 #include <QCloseEvent>
 #include <QSettings>
+#include <QFutureWatcher>
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <QHash>
 #include <QSet>
 
+#include "AsyncTask.h"
 #include "Types.h"
+#include "ActivityLogModel.h"
 #include "DeviceMonitor.h"
 #include "HashWorker.h"
 #include "DatabaseManager.h"
 #include "MountManager.h"
+#include "PolicyDecisionCache.h"
 #include "DeviceCard.h"
 #include "TrayIcon.h"
 #include "SettingsDialog.h"
+#include "StagedVerdict.h"
 #include "StyleManager.h"
 #include "VerifyHistory.h"
 #include "ManifestWorker.h"
+#include "ProgressHub.h"
+#include "WatchJournal.h"
 #include "IsoVerifierWidget.h"
 #include "BadUsbWidget.h"
 #include "WatchListsPanel.h"
@@ -44,6 +54,8 @@
 #include "AboutPage.h"
 #include "UiEventTypes.h"
 #include "BadUsbBaselineStore.h"
+#include "BadUsbRuleSet.h"
+#include "HidConnectCounter.h"
 #include "HidDeviceMonitor.h"
 #include "UsbHostMonitor.h"
 #include "UsbmonCapture.h"
@@ -97,6 +109,7 @@ protected:
     void closeEvent(QCloseEvent* event) override;
     void showEvent(QShowEvent* event) override;
     void hideEvent(QHideEvent* event) override;
+    void changeEvent(QEvent* event) override;
 #ifdef Q_OS_WIN
     bool nativeEvent(const QByteArray& eventType, void* message, qintptr* result) override;
 #endif
@@ -110,9 +123,8 @@ private slots:
 
     // Hash events
     void onHashStarted(const QString& jobId, const QString& deviceNode);
-    void onHashProgress(const QString& jobId, double progress,
-                        quint64 bytesProcessed, double speedMBps,
-                        double etaSeconds, quint64 totalBytes);
+    /** Batched hash and manifest progress from ProgressHub. */
+    void onProgressPublished(const QList<FlashSpartan::ProgressSample>& samples);
     void onHashCompleted(const QString& jobId, const HashResult& result);
     void onHashFailed(const QString& jobId, const QString& error);
     void onHashCancelled(const QString& jobId);
@@ -121,6 +133,7 @@ private slots:
     void onMountCompleted(const MountManager::MountResult& result);
     void onUnmountCompleted(const MountManager::UnmountResult& result);
     void onPowerOffCompleted(const QString& deviceNode, bool success, const QString& error);
+    void onBulkEjectCompleted(const MountManager::BulkEjectResult& result);
 
     // Database events
     void onDatabaseLoaded(int deviceCount);
@@ -130,6 +143,7 @@ private slots:
     void onMountRequested(const QString& deviceNode);
     void onUnmountRequested(const QString& deviceNode);
     void onEjectRequested(const QString& deviceNode);
+    void onEjectAllRequested(const QStringList& deviceNodes);
     void onRehashRequested(const QString& deviceNode);
     void onOpenMountPointRequested(const QString& mountPoint);
     void onDeviceCardClicked(const QString& deviceNode);
@@ -148,6 +162,8 @@ private slots:
     void onManifestCompleted(const QString& jobId, const ManifestVerifyResult& result);
     void onManifestBaselineBuilt(const QString& jobId, const QString& deviceId, const WatchManifest& manifest);
     void onManifestFailed(const QString& jobId, const QString& error);
+    void onManifestReportReady(const QString& jobId, const ManifestVerifyResult& result);
+    void onManifestCancelled(const QString& jobId);
     void onWatchListRequested(const QString& deviceNode);
     void onIsoLogMessage(const QString& message);
     void onHidConnected(const HidDeviceInfo& device);
@@ -186,6 +202,23 @@ private:
      */
     QWidget* createDeviceListArea();
 
+    /**
+     * @brief Build @p page in its stack slot on first use
+     */
+    void ensurePage(AppPage page);
+    DeviceHistoryPage* createDeviceHistoryPage();
+    AllowBlockListPage* createAllowBlockListPage();
+    AlertsPage* createAlertsPage();
+    ReportsPage* createReportsPage();
+    SettingsPage* createSettingsPage();
+    AboutPage* createAboutPage();
+
+    /**
+     * @brief Load verify history and the device timeline on a worker thread
+     */
+    void startHistoryLoad();
+    void onHistoryLoaded();
+
     /**
      * @brief Create the status bar
      */
@@ -236,6 +269,13 @@ private:
      */
     void updateDeviceCard(const DeviceInfo& device);
 
+    /**
+     * @brief Filter the device cards by the search box text, touching only
+     *        cards whose visibility changes
+     */
+    void applyDeviceSearch();
+    void applyDeviceSearch(DeviceCard* card);
+
     /**
      * @brief Handle new device (prompt user if unknown)
      */
@@ -253,19 +293,56 @@ private:
      * @brief Handle known device (verify hash)
      */
     void handleKnownDevice(const DeviceInfo& device, const DeviceRecord& record);
+    /** Last stage @p record's verification profile runs (what makes an Allow conclusive). */
+    VerifyStage finalVerifyStage(const std::optional<DeviceRecord>& record) const;
+    /** Records a finished stage for @p deviceNode and logs the verdict when it changes. */
+    void recordVerifyStage(const QString& deviceNode, VerifyStage stage, StageOutcome outcome,
+                           const QString& detail);
+    /** Seals the sealable devices among @p deviceNodes off the UI thread, then runs @p eject. */
+    void sealBeforeEject(const QStringList& deviceNodes, std::function<void()> eject);
+    /**
+     * Reads @p device's state against the seal in @p record: a match passes it provisionally
+     * and defers the full verify, anything else starts it now.
+     */
+    void checkEjectSeal(const DeviceInfo& device, const DeviceRecord& record);
+    /** Compares @p device's partition table and file system with the fingerprint in @p record. */
+    void checkLayout(const DeviceInfo& device, const DeviceRecord& record);
+    /** Fingerprints @p deviceNode off the UI thread and stores it with @p storageId's baseline. */
+    void captureLayoutBaseline(const QString& deviceNode, const QString& storageId);
+    /** Probes @p deviceNode's size and queue limits into DeviceGeometryCache off the UI thread. */
+    void primeDeviceGeometry(const QString& deviceNode);
+    /**
+     * Prefetches the watched files of mounted @p device at idle priority (ManifestPrefetch)
+     * when its manifest verify has not started; once per connection.
+     */
+    void maybeStartSpeculativePrefetch(const DeviceInfo& device);
+    /** Stops @p deviceNode's prefetch: its verify is starting, or it is gone. */
+    void stopSpeculativePrefetch(const QString& deviceNode);
 
     /**
      * @brief Start hashing a device
      */
     void startHashing(const QString& deviceNode, bool skipUnmount = false);
     void promptAndStartHash(const QString& deviceNode, bool allowDialog = true);
+    enum class HashJobPurpose {
+        Verify,         // baseline algorithm; may be swapped for a Prescreen when enabled
+        Prescreen,      // XXH3-128 against the stored pre-screen; a mismatch escalates to Confirm
+        Confirm,        // baseline algorithm after a pre-screen mismatch; never pre-screened
+        SeedPrescreen,  // XXH3-128 recorded after the baseline digest matched or was stored
+    };
     void startHashJob(const QString& uiDeviceNode, const QString& hashDeviceNode,
-                      HashScope scope, HashScanMode mode, bool resume);
+                      HashScope scope, HashScanMode mode, bool resume,
+                      HashJobPurpose purpose = HashJobPurpose::Verify);
+    bool shouldPrescreen(const DeviceRecord& record, HashScanMode mode, bool resume) const;
     QString resolveHashDeviceNode(const DeviceInfo& device, HashScope scope) const;
     QString hashStorageIdFor(const DeviceInfo& device, HashScope scope) const;
+    /** Logs a whole-disk read's partition digests against each partition's own baseline. */
+    void reportRegionHashes(const DeviceInfo& disk, const HashResult& result);
     int partitionCountFor(const DeviceInfo& device) const;
 
     void hashAllPartitionsOnParent(const DeviceInfo& device);
+    /** autoHashOnConnect, unless a headless service already verifies drives on connect. */
+    bool autoHashOnConnect() const;
 
     QString canonicalDeviceId(const DeviceInfo& device);
 
@@ -297,6 +374,8 @@ private:
     void refreshAllowBlockListPage();
     void refreshAlertsPage();
     void refreshReportsPage();
+    /** Counters from the verify history rollup: sidebar badge and page summaries. */
+    void refreshRollupViews();
     void refreshAboutPage();
     QList<UiEventEntry> collectAlertEntries() const;
     void appendUiEvent(const UiEventEntry& entry);
@@ -308,8 +387,10 @@ private:
     void applySettingsPage(const AppSettings& settings);
     void applyLiveSettings(const AppSettings& settings);
     void refreshShellStyles();
-    bool isRecordCountedAsAllowed(const DeviceRecord& record) const;
+    bool isRecordCountedAsAllowed(const DatabaseManager::DeviceSummary& record) const;
     bool isDriveBlocked(const DeviceInfo& device) const;
+    /** @p device's allow/block, auto-mount and profile decisions, from m_policyDecisions when still current. */
+    PolicyDecision policyDecision(const DeviceInfo& device);
     void blockDriveForDevice(const DeviceInfo& device, const QString& label = {});
     void unblockDriveForDevice(const DeviceInfo& device);
     void allowDriveForDevice(const DeviceInfo& device);
@@ -330,7 +411,10 @@ private:
 
     void startDeviceVerification(const QString& deviceNode);
     void startManifestVerification(const QString& deviceNode);
+    bool startUnmountedManifestVerification(const QString& deviceNode);
     void openWatchListDialog(const QString& deviceNode);
+    void stopWatchJournal(const QString& deviceNode);
+    void cancelManifestJobs(const QString& deviceNode);
     void applyAppModule();
     void syncModeTabFromSettings();
     void onModeTabChanged(int index);
@@ -340,13 +424,20 @@ private:
 
     void mountDespiteModification(const DeviceInfo& device);
 
-    void applyIsoVerifyOptions();
+    /** Pushes the background bandwidth cap and battery hold settings to IoPriority, and the memory budget. */
+    void applyBackgroundIo();
+    void updateBackgroundIoHold();
     void warnIfCatalogIntegrityFailed();
-    void maybeTriggerIsoVerifyForMountedDevice(const DeviceInfo& device);
+    /** Walks the mount for images off the GUI thread, then queues the ISO verify if it has any. */
+    AsyncTask<> maybeTriggerIsoVerifyForMountedDevice(DeviceInfo device);
     void clearIsoVerifyDedupForDevice(const DeviceInfo& device);
     void handleIsoVerificationReport(const QString& deviceNode, const QList<IsoVerifyResult>& results);
     QStringList relatedStorageNodesForHid(const HidDeviceInfo& device) const;
     void processBadUsbDevice(const HidDeviceInfo& device);
+    void reportBadUsbAnomaly(const HidDeviceInfo& device, const BadUsbAnomalyResult& anomaly);
+    /** Decodes @p path on the thread pool, then audits and shows it with @p anomaly. */
+    void archiveBadUsbCapture(const QString& path, BadUsbAnomalyResult anomaly);
+    void onKeystrokeRateExceeded(const HidKeystrokeAnalyzer::Finding& finding);
     void configureBadUsbMonitoring();
 
     bool showModifiedDeviceAlert(const DeviceInfo& device, const QString& expected,
@@ -368,6 +459,13 @@ private:
     WatchListsPanel* m_watchListsPanel = nullptr;
     QStackedWidget* m_appModeStack = nullptr;
     QHash<QString, QString> m_manifestJobDevices;
+    std::unique_ptr<WatchJournal> m_watchJournal;
+    QHash<QString, QString> m_journaledMounts;  // device node -> mount point
+    QHash<QString, QString> m_manifestJournalJobs;  // verify job id -> mount point
+    QSet<QString> m_unmountedManifestJobs;  // verify job ids reading the unmounted device
+    /** Hybrid: a pass startHashJob() hands to the full hash of that device node. */
+    QHash<QString, std::shared_ptr<SharedReadPass>> m_sharedReadPasses;
+    QSet<QString> m_sharedReadHybrids;  // device nodes whose full hash shares the manifest's read
     QHash<QString, ManifestVerifyResult> m_lastManifestResults;
     bool m_pendingHybridFullHash = false;
 
@@ -398,6 +496,13 @@ private:
     QWidget* m_isoVerifierPage = nullptr;
     QWidget* m_badUsbMonitorPage = nullptr;
     SettingsPage* m_settingsPage = nullptr;
+
+    // History stores load off the GUI thread; appends wait in the pending lists until then
+    QFutureWatcher<void>* m_historyLoad = nullptr;
+    bool m_historyLoaded = false;
+    QList<VerifyHistoryEntry> m_pendingVerifyHistory;
+    QList<UiEventEntry> m_pendingTimeline;
+    qint64 m_initialScanBeginUs = -1;  // StartupTrace time of startMonitoring(); -1 once reported
     QWidget* m_hiddenDeviceHost = nullptr;
     QVBoxLayout* m_hiddenDeviceLayout = nullptr;
 
@@ -409,6 +514,8 @@ private:
     QLabel* m_titleLabel = nullptr;
     QTabBar* m_modeTabBar = nullptr;
     QLineEdit* m_searchEdit = nullptr;
+    /** Restarts on every keystroke; the cards are filtered once typing pauses. */
+    QTimer* m_searchTimer = nullptr;
     QPushButton* m_refreshBtn = nullptr;
     QPushButton* m_settingsBtn = nullptr;
 
@@ -420,7 +527,9 @@ private:
     QListWidget* m_historyList = nullptr;
     QString m_historyFilterDevice;
     QLabel* m_historyFilterLabel = nullptr;
-    QListWidget* m_logList = nullptr;
+    QLineEdit* m_logFilterEdit = nullptr;
+    QListView* m_logView = nullptr;
+    ActivityLogModel* m_logModel = nullptr;
 
     // UI - Device list
     QScrollArea* m_deviceScrollArea = nullptr;
@@ -436,11 +545,15 @@ private:
 
     // Device tracking
     QHash<QString, DeviceCard*> m_deviceCards;  // deviceNode -> card
+    QHash<QString, QString> m_deviceSearchText;  // deviceNode -> lowercase searchable fields
+    QString m_appliedSearch;  // lowercase query the cards are currently filtered by
     struct HashJobContext {
         QString uiDeviceNode;
+        QString hashDeviceNode;
         QString storageId;
         HashScope scope = HashScope::Partition;
         HashScanMode scanMode = HashScanMode::Full;
+        HashJobPurpose purpose = HashJobPurpose::Verify;
     };
     QHash<QString, HashJobContext> m_hashJobContext;
     QHash<QString, VerificationStatus> m_preHashStatus;
@@ -458,16 +571,28 @@ private:
         HashScope scope = HashScope::Partition;
         HashScanMode mode = HashScanMode::Full;
         bool resume = false;
+        HashJobPurpose purpose = HashJobPurpose::Verify;
     };
     QHash<QString, PendingHashLaunch> m_pendingHashLaunch;
     QHash<QString, PendingHashAction> m_pendingHashActions;
     QHash<QString, QString> m_lastVerificationHashes;
+    /** Devices whose last verify stopped at the first changed block; the next read is full. */
+    QSet<QString> m_stoppedEarlyVerifies;
+    QHash<QString, StagedVerdict> m_stagedVerdicts;  // deviceNode -> verdict since connect
+    PolicyDecisionCache m_policyDecisions;  // canonical device id -> decision (policyDecision())
+    /** Passed their final stage unmounted and not mounted since: what an eject may seal. */
+    QSet<QString> m_sealableDevices;
+    /** Cancel flags of this connection's speculative prefetch, by device node. */
+    QHash<QString, std::shared_ptr<std::atomic<bool>>> m_speculativePrefetches;
+    /** Cancel flag of the report export under way, null when there is none. */
+    std::shared_ptr<std::atomic<bool>> m_reportExportCancel;
     QSet<QString> m_drivePromptInProgress;
     QTimer* m_liveSettingsTimer = nullptr;
     AppSettings m_pendingLiveSettings;
     QSet<QString> m_unmountBeforeHash;
     QSet<QString> m_isoVerifyTriggeredMounts;
-    QHash<QString, QList<QDateTime>> m_hidConnectHistory;
+    HidConnectCounter m_hidConnects;  // stableId -> connects per second, for rate rules
+    BadUsbRuleSet m_badUsbRules;  // built-in rules per settings, then badusb-rules.d
 
     QList<UiEventEntry> m_uiEvents;
     QHash<QString, QDateTime> m_deviceConnectedAt;
@@ -477,10 +602,12 @@ private:
 
     // State
     bool m_isClosing = false;
+    bool m_headlessServiceRunning = false;  // found at startup: it verifies and scans drives
     int m_activeHashCount = 0;
 
     // Timers
     QTimer* m_statusUpdateTimer = nullptr;
+    QTimer* m_powerTimer = nullptr;  // polls AC/battery while pauseBackgroundOnBattery is on
     QTimer* m_usbMonitorRefreshTimer = nullptr;
 #ifdef Q_OS_WIN
     QTimer* m_winDeviceRescanTimer = nullptr;
@@ -489,6 +616,7 @@ private:
     // Constants
     static constexpr int SIDEBAR_WIDTH = 280;
     static constexpr int STATUS_UPDATE_INTERVAL_MS = 1000;
+    static constexpr int POWER_POLL_INTERVAL_MS = 30000;
 };
 
 } // namespace FlashSpartan
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Types.h"
+
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+
+namespace FlashSpartan {
+
+/**
+ * Warms the page cache with a stick's watched files while nothing else reads it: the
+ * stick is mounted but its verify has not started, because the eject seal deferred it or
+ * the user starts verifies by hand. Only FileReadAhead hints are issued, so nothing is
+ * hashed and there is nothing to keep or throw away; a verify that follows reads what
+ * arrived from memory, and one that never comes costs only the reads.
+ */
+namespace ManifestPrefetch {
+
+/** Most bytes hinted per connect, so a large watch list cannot flush the whole cache. */
+inline constexpr qint64 kBudgetBytes = 256LL * 1024 * 1024;
+
+struct Result {
+    int files = 0;
+    qint64 bytes = 0;
+    bool cancelled = false;
+};
+
+/**
+ * Relative paths of the files @p manifest recorded, smallest first, as many as fit in
+ * @p budgetBytes together. Small files go first because per-file latency, not bandwidth,
+ * is what a cold stick makes a verify wait for. A file in several groups is listed once.
+ */
+QStringList plan(const WatchManifest& manifest, qint64 budgetBytes = kBudgetBytes);
+
+/** Hints every file of plan() under @p mountPoint; stops early once @p cancelled is set. */
+Result run(const QString& mountPoint, const WatchManifest& manifest, qint64 budgetBytes = kBudgetBytes,
+           const std::atomic<bool>* cancelled = nullptr);
+
+} // namespace ManifestPrefetch
+
+} // namespace FlashSpartan
@@ -2,16 +2,37 @@
 
 #include "Types.h"
 
+#include <QSet>
 #include <QString>
 #include <QStringList>
 
+#include <atomic>
+
 namespace FlashSpartan {
 
+class RawFsReader;
+
 /**
  * @brief Build and verify Merkle-backed watch manifests on mounted volumes.
  */
 class ManifestService {
 public:
+  /** WatchGroup::chunkThresholdBytes used when chunking is switched on. */
+  static constexpr uint64_t kDefaultChunkThresholdBytes = 64ULL * 1024 * 1024;
+
+  /**
+   * Shared between a running build or verify and its owner. Setting cancelled (any thread)
+   * stops the operation within one read buffer with errorMessage "Cancelled". Totals grow as
+   * each group is listed; files found unchanged by metadata or the journal are not counted.
+   */
+  struct Progress {
+    std::atomic<bool> cancelled{false};
+    std::atomic<uint64_t> filesDone{0};
+    std::atomic<uint64_t> filesTotal{0};
+    std::atomic<uint64_t> bytesDone{0};
+    std::atomic<uint64_t> bytesTotal{0};
+  };
+
   struct BuildResult {
     bool success = false;
     QString errorMessage;
@@ -26,22 +47,104 @@ public:
     QStringList changedPaths;
     QStringList missingPaths;
     QStringList addedPaths;
+    /** Changed byte ranges of chunked files, "path: start-end" (inclusive). */
+    QStringList changedRanges;
     QString errorMessage;
+    /** False when ManifestVerifyPolicy::failFast stopped at a difference before the end. */
+    bool complete = true;
     uint64_t filesChecked = 0;
+    uint64_t filesHashed = 0;
     uint64_t durationMs = 0;
   };
 
+  struct MountResult {
+    QString mountPoint;
+    VerifyResult result;
+  };
+
+  struct BatchVerifyResult {
+    /** One per mount point, in the order given. */
+    QVector<MountResult> mounts;
+    int matched = 0;
+    int mismatched = 0;
+    int failed = 0;
+    /**
+     * "group: path" entries that differ on every mismatched mount (two or more): more likely
+     * a stale baseline than tampering with one stick.
+     */
+    QStringList sharedDifferences;
+    uint64_t durationMs = 0;
+  };
+
+  /**
+   * Hash order tier for verify, 0 first: launchable files (executables, scripts, .lnk,
+   * autorun.inf) modified after @p baselineBuiltAt or within the last week, other
+   * launchable files, other recently modified files, then the rest. Only the order in which
+   * files are read depends on it, so with failFast the likely targets are checked first.
+   */
+  static int hashPriority(const QString& relativePath, const QDateTime& modifiedUtc,
+                          const QDateTime& baselineBuiltAt, const QDateTime& now);
+
   static QString hashFileContents(const QString& absolutePath, QString* errorOut = nullptr);
 
-  static BuildResult buildGroup(const QString& mountPoint, const WatchGroup& spec);
+  /** A new baseline: the root is in MerkleTree::latestShape() whatever @p spec had before. */
+  static BuildResult buildGroup(const QString& mountPoint, const WatchGroup& spec,
+                                Progress* progress = nullptr);
+
+  /**
+   * Re-lists the group's watch paths and compares against @p baseline. Without
+   * ManifestVerifyPolicy::metadataFirst every file is re-hashed (buildGroup).
+   *
+   * @p touchedPaths, from a usable WatchJournal snapshot, replaces the metadata check: only
+   * touched files (or files under a touched directory) are re-hashed, and a group nothing
+   * touched is not even listed. Paths are relative to the canonical mount point.
+   *
+   * With ManifestVerifyPolicy::failFast an added or missing path ends the verify before any
+   * hashing, and the first content hash that differs from the baseline stops the remaining
+   * hashing; the result is then a mismatch with complete == false and no computed root.
+   */
+  static VerifyResult verifyGroup(const QString& mountPoint, const WatchGroup& baseline,
+                                  const ManifestVerifyPolicy& policy = {},
+                                  const QSet<QString>* touchedPaths = nullptr,
+                                  Progress* progress = nullptr);
+
+  static VerifyResult verifyManifest(const QString& mountPoint, const WatchManifest& manifest,
+                                     const ManifestVerifyPolicy& policy = {},
+                                     const QSet<QString>* touchedPaths = nullptr,
+                                     Progress* progress = nullptr);
 
-  static VerifyResult verifyGroup(const QString& mountPoint, const WatchGroup& baseline);
+  /**
+   * verifyManifest() of every mount against one @p manifest at once. The baseline is indexed
+   * once for all mounts; each mount gets its own listing and reader thread, and the hash
+   * thread budget is split between them. No change journal: each mount is a separate device.
+   * @p progress, when given, is shared: its counters sum over mounts and a cancel stops all.
+   */
+  static BatchVerifyResult verifyManifestBatch(const QStringList& mountPoints, const WatchManifest& manifest,
+                                               const ManifestVerifyPolicy& policy = {},
+                                               Progress* progress = nullptr);
 
-  static VerifyResult verifyManifest(const QString& mountPoint, const WatchManifest& manifest);
+  /**
+   * verifyManifest() against an unmounted volume, read through @p volume instead of a mount.
+   * Watch paths are taken relative to the volume root; an absolute watch path or a symbolic
+   * link under one fails the verify, as only a mount can resolve them. metadataFirst applies
+   * on ext only, where the recorded stat fields are the ones a mount would report.
+   */
+  static VerifyResult verifyManifestOnVolume(RawFsReader& volume, const WatchManifest& manifest,
+                                             const ManifestVerifyPolicy& policy = {},
+                                             Progress* progress = nullptr);
 
+  /**
+   * Root over the group roots: binary (Merkle v1) for version "1.0" manifests, 4-ary v2 for
+   * "2.0"; empty for any other version.
+   */
   static QString manifestRootHex(const WatchManifest& manifest);
 
-  static WatchManifest rebuildManifestRoots(const QString& mountPoint, const WatchManifest& spec);
+  /**
+   * Groups that fail to build are left out; after a cancel the result is incomplete. Every
+   * group and the manifest root are rebuilt in the latest Merkle format (version "2.0").
+   */
+  static WatchManifest rebuildManifestRoots(const QString& mountPoint, const WatchManifest& spec,
+                                            Progress* progress = nullptr);
 };
 
 } // namespace FlashSpartan
@@ -1,20 +1,26 @@
 #pragma once
 
+#include "ManifestService.h"
+#include "ProgressHub.h"
 #include "Types.h"
 
 #include <QObject>
 #include <QString>
 #include <QMutex>
 #include <QHash>
+#include <QSet>
 #include <memory>
+#include <optional>
 
 namespace FlashSpartan {
 
+class SharedReadPass;
+
 class ManifestWorker : public QObject {
     Q_OBJECT
 
 public:
-    enum class JobKind { Verify, BuildBaseline };
+    enum class JobKind { Verify, BuildBaseline, BatchVerify };
 
     struct Job {
         QString jobId;
@@ -22,30 +28,81 @@ public:
         QString mountPoint;
         QString deviceId;
         JobKind kind = JobKind::Verify;
+        /** BatchVerify: every device and its mount point, index for index. */
+        QStringList deviceNodes;
+        QStringList mountPoints;
         WatchManifest manifest;
+        ManifestVerifyPolicy policy;
+        /** From a usable WatchJournal snapshot; only these paths are re-hashed. */
+        std::optional<QSet<QString>> touchedPaths;
+        /** Unmounted verify: file data from a concurrent full hash (SharedReadPass). */
+        std::shared_ptr<SharedReadPass> sharedRead;
     };
 
     explicit ManifestWorker(QObject* parent = nullptr);
 
+    /**
+     * With ManifestVerifyPolicy::failFast, manifestCompleted() arrives as soon as one file
+     * differs. If failFastReport is also set, the full diff then runs and is delivered by
+     * manifestReportReady() under the same job id; cancelJob() drops it.
+     */
     QString startVerify(const QString& deviceNode, const QString& mountPoint,
-                        const QString& deviceId, const WatchManifest& manifest);
+                        const QString& deviceId, const WatchManifest& manifest,
+                        const ManifestVerifyPolicy& policy = {},
+                        std::optional<QSet<QString>> touchedPaths = std::nullopt);
+
+    /**
+     * startVerify() on the unmounted @p deviceNode, read directly through RawFsReader
+     * (Linux; needs a direct open or a cached helper descriptor, never prompts). Fails when
+     * the volume cannot be read that way (unsupported file system, journal to replay,
+     * symbolic links under a watch path), and the caller mounts and verifies as before.
+     * With @p sharedRead, file data comes from a full hash reading the same device.
+     */
+    QString startVerifyUnmounted(const QString& deviceNode, const QString& deviceId,
+                                 const WatchManifest& manifest, const ManifestVerifyPolicy& policy = {},
+                                 std::shared_ptr<SharedReadPass> sharedRead = nullptr);
 
     QString startBuildBaseline(const QString& deviceNode, const QString& mountPoint,
                                const QString& deviceId, const WatchManifest& spec);
 
+    /**
+     * Flags the job's cancel token (its worker stops within one read buffer) and forgets
+     * it; manifestCancelled() follows and no result is delivered.
+     */
+    /**
+     * Verifies every mount in @p mountPoints against @p manifest as one job (see
+     * ManifestService::verifyManifestBatch()). manifestStarted() fires once per device;
+     * the outcome arrives as one manifestBatchCompleted().
+     */
+    QString startBatchVerify(const QStringList& deviceNodes, const QStringList& mountPoints,
+                             const WatchManifest& manifest, const ManifestVerifyPolicy& policy = {});
+
     bool cancelJob(const QString& jobId);
     void cancelAll();
 
+    /**
+     * Bytes and files handed to hashing so far for every job; totals grow as groups are
+     * listed and stay 0 until the first one is. ProgressHub polls this once per frame.
+     */
+    QList<ProgressSample> progressSnapshot() const;
+
 signals:
     void manifestStarted(const QString& jobId, const QString& deviceNode);
     void manifestCompleted(const QString& jobId, const ManifestVerifyResult& result);
+    /** Full diff after a fail-fast mismatch (see startVerify()). */
+    void manifestReportReady(const QString& jobId, const ManifestVerifyResult& result);
     void manifestBaselineBuilt(const QString& jobId, const QString& deviceId, const WatchManifest& manifest);
     void manifestFailed(const QString& jobId, const QString& error);
+    void manifestBatchCompleted(const QString& jobId, const ManifestBatchVerifyResult& result);
+    void manifestCancelled(const QString& jobId);
 
 private:
     struct JobState;
+    QString launchVerify(const Job& job);
+    void insertJob(const QString& jobId, const std::shared_ptr<JobState>& state);
+
     QHash<QString, std::shared_ptr<JobState>> m_jobs;
-    QMutex m_mutex;
+    mutable QMutex m_mutex;
 };
 
 } // namespace FlashSpartan
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include <functional>
+
+class QSocketNotifier;
+
+namespace FlashSpartan {
+
+/**
+ * One place that knows what the process's caches hold and can make them give memory back.
+ *
+ * Caches register a usage probe and a shrink function. The budget shrinks them when the
+ * resident set passes the configured limit (checked every kCheckIntervalMs, reclaiming
+ * down to kHeadroom of it) and when the OS reports memory pressure: a PSI trigger on the
+ * cgroup's memory.pressure, else /proc/pressure/memory, on Linux; the low-memory resource
+ * notification on Windows. Consumers give back in Keep order, Low first.
+ *
+ * Lives on the GUI thread; probes and shrink functions are called there and must be
+ * thread-safe against their own users.
+ */
+class MemoryBudget : public QObject {
+    Q_OBJECT
+
+public:
+    enum class Pressure { None, Moderate, Critical };
+    Q_ENUM(Pressure)
+
+    /** How much a consumer's memory is worth keeping; cheap to rebuild is Low. */
+    enum class Keep { Low, Normal, High };
+
+    struct Consumer {
+        QString name;
+        Keep keep = Keep::Normal;
+        /** Bytes held now; cheap. */
+        std::function<qint64()> usage;
+        /** Give back down to at most @p targetBytes; 0 drops whatever can be dropped. */
+        std::function<void(qint64 targetBytes)> shrink;
+    };
+
+    struct Usage {
+        QString name;
+        qint64 bytes = 0;
+    };
+
+    static constexpr int kCheckIntervalMs = 10000;
+    static constexpr double kHeadroom = 0.9;
+    /** A second pressure event within this long escalates Moderate to Critical. */
+    static constexpr int kEscalateMs = 10000;
+
+    static MemoryBudget& instance();
+
+    explicit MemoryBudget(QObject* parent = nullptr);
+    ~MemoryBudget() override;
+
+    /** @return an id for remove() */
+    int add(Consumer consumer);
+    /** The consumer is not called again once this returns. */
+    void remove(int id);
+
+    /** Resident set to stay under in bytes; 0 = no limit (pressure is still answered). */
+    void setLimit(qint64 bytes);
+    qint64 limit() const { return m_limit; }
+
+    QList<Usage> usage() const;
+    qint64 totalUsage() const;
+    Pressure pressure() const { return m_pressure; }
+
+    /** Shrinks consumers, Keep::Low first, until @p bytes are given back; @return bytes reclaimed */
+    qint64 reclaim(qint64 bytes);
+    /**
+     * Moderate empties Keep::Low consumers and halves Normal ones; Critical empties both and
+     * halves High ones.
+     */
+    void relieve(Pressure pressure);
+
+    /** Reclaims whatever the resident set is over the limit; run every kCheckIntervalMs once started. */
+    void check();
+    /** Starts the periodic check and subscribes to the OS pressure notification. */
+    void start();
+
+    /** Resident set of this process in bytes; 0 where it cannot be read. */
+    static qint64 residentBytes();
+    /** Replaces residentBytes() in check(), for tests. */
+    void setResidentProbe(std::function<qint64()> probe);
+
+signals:
+    void pressureChanged(FlashSpartan::MemoryBudget::Pressure pressure);
+    /** @p reason: "limit" or "pressure". */
+    void reclaimed(qint64 bytes, const QString& reason);
+
+private:
+    /** Consumers in the order they give memory back. */
+    QList<Consumer> ordered() const;
+    void onPressureSignal();
+    void setPressure(Pressure pressure);
+    static void releaseFreeHeap();
+
+    QMap<int, Consumer> m_consumers;
+    int m_nextId = 1;
+    qint64 m_limit = 0;
+    Pressure m_pressure = Pressure::None;
+    qint64 m_lastSignalMs = 0;
+    std::function<qint64()> m_residentProbe;
+    QTimer m_timer;
+    bool m_started = false;
+#ifdef Q_OS_LINUX
+    int m_psiFd = -1;
+    QString m_psiPath;  // polled by check() when no trigger could be set
+    QSocketNotifier* m_psiNotifier = nullptr;
+#endif
+#ifdef Q_OS_WIN
+    void* m_lowMemory = nullptr;  // HANDLE
+    QObject* m_lowMemoryNotifier = nullptr;  // QWinEventNotifier
+#endif
+};
+
+} // namespace FlashSpartan
@@ -7,33 +7,108 @@
 
 namespace FlashSpartan {
 
+/** Node hashing of a Merkle tree; stored with each root. */
+enum class MerkleFormat {
+    /** Binary; a node hashes the hex of its two children, an odd last node pairs with itself. */
+    V1 = 1,
+    /**
+     * k-ary; a leaf is SHA-256(0x00, path, 0x00, hash hex), a node SHA-256(0x01, raw child
+     * digests). A lone last child moves up unhashed.
+     */
+    V2 = 2,
+};
+
+/** Node hashing and fan-out of a Merkle tree; V1 is always binary. */
+struct MerkleShape {
+    MerkleFormat format = MerkleFormat::V1;
+    int fanOut = 2;
+
+    bool isValid() const;
+    friend bool operator==(const MerkleShape&, const MerkleShape&) = default;
+};
+
 /**
- * @brief Binary Merkle tree over sorted leaf digests (hex SHA-256).
+ * @brief Merkle tree over sorted leaf digests (hex SHA-256).
+ *
+ * A built tree keeps every level, so changing the contents of k existing leaves costs
+ * O(k log n) hashes (updateLeaves) and any leaf can produce an inclusion proof. Adding or
+ * removing a path shifts every later node; rebuild for those. rootHex(leaves, shape) only
+ * needs the root and keeps one partial node per level instead.
+ *
+ * Roots are stored with their Shape, so a baseline built in an older format still verifies
+ * in that format; new baselines use latestShape().
  */
 class MerkleTree {
 public:
+    using Format = MerkleFormat;
+    using Shape = MerkleShape;
+
+    static constexpr int kMaxFanOut = 16;
+    /** Four 32-byte children fill three SHA-256 blocks: about half the compressions of V1. */
+    static constexpr int kDefaultFanOut = 4;
+
+    /** What new baselines are built with. */
+    static Shape latestShape() { return {Format::V2, kDefaultFanOut}; }
+
     struct Leaf {
         QString relativePath;
         QString contentHashHex;
         QByteArray digest;
     };
 
-    static QByteArray leafDigest(const QString& relativePath, const QString& contentHashHex);
+    /**
+     * Other children of the node's parent at one level of an inclusion proof, leaf level
+     * first: raw digests before and after it. Both are empty where a lone child moved up.
+     */
+    struct ProofStep {
+        QByteArray before;
+        QByteArray after;
+    };
+
+    static QByteArray leafDigest(const QString& relativePath, const QString& contentHashHex,
+                                 Format format = Format::V1);
+    /** V1 interior node. */
     static QByteArray combine(const QByteArray& left, const QByteArray& right);
+    /** V2 interior node over the concatenated raw digests of its children. */
+    static QByteArray combineChildren(const QByteArray& children);
     static QString toHex(const QByteArray& data);
 
-    static MerkleTree build(const QVector<Leaf>& leaves);
-    static QString rootHex(const QVector<Leaf>& leaves);
+    /** Empty (no root) when @p shape is not valid. */
+    static MerkleTree build(const QVector<Leaf>& leaves, Shape shape = {});
+    static QString rootHex(const QVector<Leaf>& leaves, Shape shape = {});
 
     QString rootHex() const { return m_rootHex; }
+    Shape shape() const { return m_shape; }
     bool isEmpty() const { return m_leaves.isEmpty(); }
     int leafCount() const { return m_leaves.size(); }
+    const QVector<Leaf>& leaves() const { return m_leaves; }
+
+    /** Index of @p relativePath among the sorted leaves, or -1. */
+    qsizetype indexOf(const QString& relativePath) const;
+
+    /**
+     * Replaces the content hashes of existing leaves (matched by relativePath) and rehashes
+     * only their ancestors. Returns false, without changing anything, if a path is not in
+     * the tree; rebuild in that case.
+     */
+    bool updateLeaves(const QVector<Leaf>& changed);
+
+    /** Empty when @p relativePath is not a leaf; a single-leaf tree needs no steps. */
+    QVector<ProofStep> inclusionProof(const QString& relativePath) const;
+    static bool verifyInclusion(const QString& relativePath, const QString& contentHashHex,
+                                const QVector<ProofStep>& proof, const QString& rootHex,
+                                Shape shape = {});
 
 private:
-    explicit MerkleTree(QVector<Leaf> leaves, QString rootHex);
+    MerkleTree(QVector<Leaf> leaves, QVector<QByteArray> levels, QString rootHex, Shape shape);
+
+    /** Digest of node @p parent over the @p count nodes of @p children, per m_shape. */
+    QByteArray parentDigest(const QByteArray& children, size_t count, size_t parent) const;
 
     QVector<Leaf> m_leaves;
+    QVector<QByteArray> m_levels;  // [0] = concatenated leaf digests, last = root
     QString m_rootHex;
+    Shape m_shape;
 };
 
 } // namespace FlashSpartan
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QLocalServer>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QString>
+
+#include <memory>
+#include <optional>
+
+#include "PerfMetrics.h"
+#include "Types.h"
+
+class QLocalSocket;
+class QSocketNotifier;
+
+namespace FlashSpartan {
+
+class BadUsbBaselineStore;
+class DatabaseManager;
+class DeviceMonitor;
+class HashWorker;
+class HidDeviceMonitor;
+class IsoVerifierWorker;
+class ManifestWorker;
+
+/**
+ * Monitoring without the Widgets UI (flashspartan --headless).
+ *
+ * Owns the device and HID monitors, the hash, manifest and ISO workers and the trust
+ * database, and runs the unattended part of what MainWindow does on a connect: the
+ * identity verdict, an automatic verify of known drives by their profile, and an ISO scan
+ * of new mounts. It never mounts, unmounts or prompts; a full-partition verify of a
+ * mounted drive is reported as skipped. Verdicts go to the audit log.
+ *
+ * Clients attach on socketPath() and read JSON lines: one "snapshot" with every device
+ * and the last verdict for each, then one "event" per change. Anything they send is
+ * ignored; trust and block edits stay with flashspartan-policyd.
+ *
+ * The windowed app does not attach here as a client yet. When it finds the service
+ * listening at startup (isListening()) it leaves automatic verification and ISO scans to
+ * it, so the two never read the same drive twice.
+ *
+ * For a device that arrived by udev event, the event reaching each connect milestone
+ * (card, mount, manifest, hash or ISO verdict) carries "latency_ms" with the time since
+ * that first event, and the same is observed in PerfMetrics::connectLatency().
+ */
+class MonitorService : public QObject {
+    Q_OBJECT
+
+public:
+    explicit MonitorService(QObject* parent = nullptr);
+    ~MonitorService() override;
+
+    MonitorService(const MonitorService&) = delete;
+    MonitorService& operator=(const MonitorService&) = delete;
+
+    static QString socketPath();
+    /** Whether a headless service answers on socketPath(). */
+    static bool isListening();
+
+    /** Opens the database and the status socket and starts both monitors. */
+    bool start(QString* error = nullptr);
+    void stop();
+
+    QJsonObject snapshot() const;
+
+signals:
+    void eventPublished(const QJsonObject& event);
+
+private:
+    struct DeviceState {
+        DeviceInfo info;
+        QString verdict;   // blocked, new, known, verifying, verified, modified, skipped, error
+        QString detail;
+        qint64 udevEventNs = 0;  // of the connect; 0 when found by a scan
+        quint8 stagesReached = 0;  // PerfMetrics::ConnectStage bits
+    };
+
+    void onDeviceConnected(const DeviceInfo& device);
+    void onDeviceDisconnected(const QString& deviceNode);
+    void onDeviceChanged(const DeviceInfo& device);
+    void onHidConnected(const HidDeviceInfo& device);
+    void onHidDisconnected(const QString& stableId);
+    void onNewConnection();
+
+    /** Starts the verify HeadlessPlan::onConnect() picked for a known drive. */
+    void verifyWatchManifest(const DeviceInfo& device, const DeviceRecord& record);
+    void startFullHash(const DeviceInfo& device, const DeviceRecord& record);
+    void maybeScanIsos(const DeviceInfo& device);
+    void setVerdict(const QString& deviceNode, const QString& verdict, const QString& detail = {},
+                    std::optional<PerfMetrics::ConnectStage> stage = std::nullopt);
+    static void noteLatency(DeviceState& state, PerfMetrics::ConnectStage stage, QJsonObject& payload);
+    bool isDriveBlocked(const DeviceInfo& device) const;
+
+    void publish(const QString& kind, QJsonObject payload);
+    static QJsonObject deviceJson(const DeviceState& state);
+
+    std::unique_ptr<DatabaseManager> m_database;
+    std::unique_ptr<DeviceMonitor> m_deviceMonitor;
+    std::unique_ptr<HidDeviceMonitor> m_hidMonitor;
+    std::unique_ptr<HashWorker> m_hashWorker;
+    std::unique_ptr<ManifestWorker> m_manifestWorker;
+    std::unique_ptr<IsoVerifierWorker> m_isoWorker;
+    std::unique_ptr<BadUsbBaselineStore> m_badUsbBaselineStore;
+
+    QHash<QString, DeviceState> m_devices;      // by device node
+    QHash<QString, QJsonObject> m_hidDevices;   // by stable id
+    QHash<QString, QString> m_jobDevices;       // hash, manifest or ISO job id -> device node
+    QSet<QString> m_isoScannedMounts;
+
+    int m_mountWatchFd = -1;  // Linux: mounts show up without a udev event
+    QSocketNotifier* m_mountWatch = nullptr;
+
+    QLocalServer m_server;
+    QList<QPointer<QLocalSocket>> m_clients;
+    bool m_running = false;
+};
+
+} // namespace FlashSpartan
@@ -8,19 +8,26 @@
 #include <memory>
 
 #ifndef Q_OS_WIN
-#include <QDBusInterface>
+#include <QDBusMessage>
 #include <QDBusPendingCallWatcher>
 #include <QVariantMap>
 #endif
 
 #include "Types.h"
+#include "UDisksObjectCache.h"
+
+class QSocketNotifier;
 
 namespace FlashSpartan {
 
 /**
  * @brief MountManager - device mount status and mount operations.
  *
- * Linux: UDisks2 via system D-Bus. Windows: read-only status from QStorageInfo.
+ * Linux: UDisks2 via system D-Bus; mount status comes from the shared MountTable and is
+ * refreshed whenever /proc/self/mountinfo reports a change. Block, file system and drive
+ * lookups are answered from a UDisksObjectCache loaded with one GetManagedObjects call and
+ * kept current from ObjectManager and PropertiesChanged signals, so only mount, unmount and
+ * power-off go over the bus (asynchronously). Windows: read-only status from QStorageInfo.
  */
 class MountManager : public QObject {
     Q_OBJECT
@@ -54,6 +61,21 @@ public:
         bool lazy = false;
     };
 
+    /** Outcome of one device of an ejectAll() batch. */
+    struct EjectResult {
+        QString deviceNode;
+        bool success = false;
+        QString errorMessage;
+    };
+
+    /** Outcome of an ejectAll() batch: one entry per requested device, in request order. */
+    struct BulkEjectResult {
+        QList<EjectResult> devices;
+
+        int succeeded() const;
+        bool success() const { return succeeded() == devices.size(); }
+    };
+
     explicit MountManager(QObject* parent = nullptr);
     ~MountManager() override;
 
@@ -71,6 +93,15 @@ public:
 
     void powerOff(const QString& deviceNode);
 
+    /**
+     * Ejects @p deviceNodes as one batch: all unmounts are issued at once, and once every one
+     * has finished the affected drives are powered off in parallel (one PowerOff per drive, so
+     * partitions of the same stick share it). A drive with a volume that failed to unmount is
+     * left powered. Each unmount still reports unmountCompleted(); the batch ends with a single
+     * bulkEjectCompleted() instead of per-device powerOffCompleted().
+     */
+    void ejectAll(const QStringList& deviceNodes, const UnmountOptions& options = UnmountOptions{});
+
     QString getMountPoint(const QString& deviceNode) const;
 
     bool hasPendingOperations() const;
@@ -87,6 +118,7 @@ signals:
     void mountCompleted(const FlashSpartan::MountManager::MountResult& result);
     void unmountCompleted(const FlashSpartan::MountManager::UnmountResult& result);
     void powerOffCompleted(const QString& deviceNode, bool success, const QString& error);
+    void bulkEjectCompleted(const FlashSpartan::MountManager::BulkEjectResult& result);
     void mountStatusChanged(const QString& deviceNode, bool mounted, const QString& mountPoint);
     void error(const QString& deviceNode, const QString& message);
 
@@ -95,25 +127,50 @@ private slots:
     void onMountFinished(QDBusPendingCallWatcher* watcher);
     void onUnmountFinished(QDBusPendingCallWatcher* watcher);
     void onPowerOffFinished(QDBusPendingCallWatcher* watcher);
+    void onManagedObjectsFinished(QDBusPendingCallWatcher* watcher);
+    void onInterfacesAdded(const QDBusMessage& message);
+    void onInterfacesRemoved(const QDBusMessage& message);
+    void onPropertiesChanged(const QDBusMessage& message);
+    void onUdisksOwnerChanged(const QString& service, const QString& oldOwner, const QString& newOwner);
 
 private:
+    /** The cached block object of @p deviceNode; the path UDisks2 derives from the name if not cached. */
     QString getBlockObjectPath(const QString& deviceNode) const;
-    QString getDriveObjectPath(const QString& blockObjectPath) const;
 
-    std::unique_ptr<QDBusInterface> createBlockInterface(const QString& deviceNode) const;
-    std::unique_ptr<QDBusInterface> createFilesystemInterface(const QString& deviceNode) const;
-    std::unique_ptr<QDBusInterface> createDriveInterface(const QString& driveObjectPath) const;
+    void applyManagedObjects(const QDBusMessage& reply);
+    /** Calls @p method(@p options) on @p objectPath without introspecting it first. */
+    QDBusPendingCall callAsync(const QString& objectPath, const char* interface, const char* method,
+                               const QVariantMap& options) const;
 
     QVariantMap mountOptionsToVariant(const MountOptions& options) const;
     QVariantMap unmountOptionsToVariant(const UnmountOptions& options) const;
 
     QString extractErrorMessage(const QDBusError& error) const;
 
-    std::unique_ptr<QDBusInterface> m_udisksInterface;
+    /** Reads an Unmount reply and forgets the mount point on success. */
+    UnmountResult unmountResult(const QString& deviceNode, QDBusPendingCallWatcher* watcher);
+
+    struct EjectBatch {
+        BulkEjectResult result;
+        QHash<QString, QList<int>> entriesByDrive;  // drive object path -> indices into result.devices
+        int pending = 0;
+    };
+
+    void onEjectUnmountFinished(quint64 batchId, int index, QDBusPendingCallWatcher* watcher);
+    void onEjectPowerOffFinished(quint64 batchId, const QString& drivePath, QDBusPendingCallWatcher* watcher);
+    /** Issues the batch's PowerOff calls; finishes the batch when there are none. */
+    void powerOffEjectBatch(quint64 batchId);
+
+    UDisksObjectCache m_udisks;
+
+    int m_mountWatchFd = -1;
+    QSocketNotifier* m_mountWatch = nullptr;
 
     QHash<QDBusPendingCallWatcher*, QString> m_pendingMounts;
     QHash<QDBusPendingCallWatcher*, QString> m_pendingUnmounts;
     QHash<QDBusPendingCallWatcher*, QString> m_pendingPowerOffs;
+    QHash<quint64, EjectBatch> m_ejectBatches;
+    quint64 m_nextEjectBatch = 1;
 
     static constexpr const char* UDISKS2_SERVICE = "org.freedesktop.UDisks2";
     static constexpr const char* UDISKS2_PATH = "/org/freedesktop/UDisks2";
@@ -122,6 +179,8 @@ private:
     static constexpr const char* UDISKS2_FS_IFACE = "org.freedesktop.UDisks2.Filesystem";
     static constexpr const char* UDISKS2_DRIVE_IFACE = "org.freedesktop.UDisks2.Drive";
     static constexpr const char* DBUS_PROPERTIES_IFACE = "org.freedesktop.DBus.Properties";
+    static constexpr const char* DBUS_OBJECT_MANAGER_IFACE = "org.freedesktop.DBus.ObjectManager";
+    static constexpr int MANAGED_OBJECTS_TIMEOUT_MS = 5000;
 #else
 private:
 #endif
@@ -133,3 +192,4 @@ private:
 
 Q_DECLARE_METATYPE(FlashSpartan::MountManager::MountResult)
 Q_DECLARE_METATYPE(FlashSpartan::MountManager::UnmountResult)
+Q_DECLARE_METATYPE(FlashSpartan::MountManager::BulkEjectResult)
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include <memory>
+
+namespace FlashSpartan {
+
+/** One line of /proc/self/mountinfo. */
+struct MountEntry {
+    QString source;      // e.g. /dev/sdb1
+    QString mountPoint;  // unescaped
+    QString fsType;
+    quint32 major = 0;
+    quint32 minor = 0;
+};
+
+/**
+ * Process-wide cache of the Linux mount table. The table is parsed once and kept until the
+ * kernel flags /proc/self/mountinfo with POLLPRI (a mount or unmount happened), so looking
+ * up every partition of a new stick costs one parse. Thread-safe; snapshots are immutable.
+ */
+class MountTable {
+public:
+    struct Snapshot {
+        QList<MountEntry> entries;  // mountinfo order
+        QHash<QString, qsizetype> bySource;  // first mount of each source
+        QHash<quint64, qsizetype> byDevNum;  // (major << 32) | minor, first mount
+
+        /**
+         * The first mount of @p deviceNode, by major:minor when given (which also finds
+         * /dev/mapper and by-uuid sources), else by name; nullptr when it is not mounted.
+         */
+        const MountEntry* find(const QString& deviceNode, quint32 major = 0, quint32 minor = 0) const;
+    };
+
+    /** The current table, re-read only when the kernel reported a change since the last read. */
+    static std::shared_ptr<const Snapshot> current();
+
+    /** Parses mountinfo text; exposed for tests. */
+    static std::shared_ptr<const Snapshot> parse(const QByteArray& mountinfo);
+
+    /**
+     * A new descriptor on /proc/self/mountinfo for a POLLPRI watch (QSocketNotifier::Exception);
+     * the caller owns it. -1 on failure.
+     */
+    static int openChangeFd();
+};
+
+} // namespace FlashSpartan
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "DigestAlgorithm.h"
+#include "DigestContextPool.h"
+
+#include <cstddef>
+#include <optional>
+
+namespace FlashSpartan {
+
+/**
+ * Every requested digest over one pass of a stream: each update() chunk goes to all the
+ * contexts while it is still in cache, so checking a SHA512SUMS or b2sums entry costs CPU
+ * but not another read of a multi-gigabyte image. Contexts are borrowed from this thread's
+ * DigestContextPool, so create, feed and destroy it on one thread.
+ */
+class MultiDigest {
+public:
+    explicit MultiDigest(DigestAlgorithms algorithms);
+
+    MultiDigest(const MultiDigest&) = delete;
+    MultiDigest& operator=(const MultiDigest&) = delete;
+
+    /** False when a context could not be set up; update() and finish() then fail. */
+    bool isValid() const { return m_valid; }
+
+    bool update(const void* data, std::size_t size);
+
+    /** Writes each requested digest into @p out; false when OpenSSL fails. */
+    bool finish(DigestValues* out);
+
+private:
+    static constexpr int kAlgorithmCount = 3;
+
+    struct Slot {
+        DigestAlgorithm algorithm = DigestAlgorithm::Sha256;
+        std::optional<DigestContextPool::Context> context;
+    };
+
+    Slot m_slots[kAlgorithmCount];
+    int m_count = 0;
+    bool m_valid = true;
+};
+
+} // namespace FlashSpartan
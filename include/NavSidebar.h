@@ -2,6 +2,7 @@
 
 #include "AppNavigation.h"
 
+#include <QHash>
 #include <QWidget>
 #include <QList>
 
@@ -18,6 +19,8 @@ public:
 
     void setCurrentPage(AppPage page);
     AppPage currentPage() const { return m_current; }
+    /** Count shown after @p page's label; 0 hides it. */
+    void setBadge(AppPage page, int count);
 
 signals:
     void pageSelected(AppPage page);
@@ -25,10 +28,12 @@ signals:
 private:
     void rebuildButtons();
     void onButtonClicked();
+    QString buttonText(AppPage page) const;
 
     QList<QPushButton*> m_buttons;
     QVBoxLayout* m_layout = nullptr;
     AppPage m_current = AppPage::UsbMonitor;
+    QHash<int, int> m_badges;  // AppPage -> count
 };
 
 } // namespace FlashSpartan
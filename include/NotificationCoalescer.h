@@ -0,0 +1,82 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMetaType>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+namespace FlashSpartan {
+
+/** One desktop notification as TrayIcon would show it. */
+struct TrayNotice {
+    enum class Category {
+        General,
+        DeviceConnected,
+        DeviceRemoved,
+        Verification,
+        HashCompleted,
+        IsoVerify,
+        ReadAnomaly,
+        Security,  // tampering, BadUSB, counterfeit capacity: never held back
+    };
+    enum class Level { Information, Warning, Critical };
+
+    Category category = Category::General;
+    QString title;
+    QString message;
+    Level level = Level::Information;
+    int durationMs = 3000;
+    /** Counted as a failure in a summary (failed verify, unknown device, ISO mismatch). */
+    bool failed = false;
+};
+
+/**
+ * Rate limiter in front of the tray's showMessage(). Notices are held for kWindowMs to catch
+ * the rest of a burst, and at most one notification goes out per kMinIntervalMs; a held
+ * batch of several notices is delivered as one, with a line per category ("7 devices
+ * verified, 1 failed"). Security notices go out at once and do not use up the interval;
+ * only an identical one repeated within kSecurityRepeatMs is dropped.
+ */
+class NotificationCoalescer : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr int kWindowMs = 1500;
+    static constexpr int kMinIntervalMs = 5000;
+    static constexpr int kSecurityRepeatMs = 30000;
+
+    explicit NotificationCoalescer(QObject* parent = nullptr);
+
+    void post(const TrayNotice& notice);
+    /** Delivers whatever is held now, ignoring the interval. */
+    void flush();
+    /** Drops held notices, e.g. when notifications are switched off. */
+    void clear();
+    int pendingCount() const { return static_cast<int>(m_pending.size()); }
+
+    /** Shorter intervals for tests. */
+    void setIntervals(int windowMs, int minIntervalMs, int securityRepeatMs = kSecurityRepeatMs);
+
+    /** One summary line for @p count notices of @p category, @p failed of them failures. */
+    static QString summaryLine(TrayNotice::Category category, int count, int failed);
+
+signals:
+    void deliver(const FlashSpartan::TrayNotice& notice);
+
+private:
+    QList<TrayNotice> m_pending;
+    QHash<QString, qint64> m_securityShownAt;  // title + message -> clock ms
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    qint64 m_lastDeliveredMs = -1;
+    int m_windowMs = kWindowMs;
+    int m_minIntervalMs = kMinIntervalMs;
+    int m_securityRepeatMs = kSecurityRepeatMs;
+};
+
+} // namespace FlashSpartan
+
+Q_DECLARE_METATYPE(FlashSpartan::TrayNotice)
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+#include <functional>
+
+namespace FlashSpartan {
+
+/**
+ * In-process check of OpenPGP (RFC 4880) v4 detached signatures with OpenSSL, so verifying a
+ * stick full of images does not launch gpg per file. Handles RSA and Ed25519 keys, SHA-2
+ * digests, binary and text signatures, armored or binary input. A subkey signs only once its
+ * binding signature from the primary verifies. Expiry and revocation are not evaluated:
+ * callers pin the primary fingerprint. Whatever it cannot decide (unknown key, other
+ * algorithms) is reported as such so the caller can fall back to gpg.
+ */
+class OpenPgpVerifier {
+public:
+    enum class Status { Good, Bad, NoPublicKey, Unsupported, Malformed };
+
+    struct Result {
+        Status status = Status::Malformed;
+        /** Issuer key ID, 16 hex digits; the subkey when a subkey signed. */
+        QString keyId;
+        /** Primary key fingerprint, 40 hex digits, no spaces. */
+        QString fingerprint;
+        QString detail;
+
+        bool good() const { return status == Status::Good; }
+    };
+
+    /** Parsed public keys; cheap to copy (implicitly shared). */
+    class KeyRing {
+    public:
+        /** Adds every usable v4 key in @p data (armored or binary); returns primaries added. */
+        int addKeys(const QByteArray& data);
+        /** Key ID (8 or 16 hex digits, optional 0x) or fingerprint of a primary or subkey. */
+        bool contains(const QString& keyIdOrFingerprint) const;
+        bool isEmpty() const { return m_keys.isEmpty(); }
+
+    private:
+        friend class OpenPgpVerifier;
+
+        struct SigningKey {
+            int algorithm = 0;
+            /** RSA: n and e. Ed25519: the 32-byte point in first. */
+            QByteArray first;
+            QByteArray second;
+            QByteArray fingerprint;
+            QByteArray primaryFingerprint;
+        };
+
+        QList<const SigningKey*> candidates(const QByteArray& issuerFingerprint, quint64 issuerKeyId) const;
+
+        QList<SigningKey> m_keys;
+        QMultiHash<quint64, qsizetype> m_byKeyId;
+    };
+
+    static Result verifyDetached(const KeyRing& keys, const QByteArray& signature, const QByteArray& data);
+    /** Streams @p dataPath, so a signature over a whole image does not load it into memory. */
+    static Result verifyDetachedFile(const KeyRing& keys, const QString& signaturePath,
+                                     const QString& dataPath);
+
+    static QString statusText(Status status);
+
+private:
+    static Result verifyStream(const KeyRing& keys, const QByteArray& signature,
+                               const std::function<qint64(char* buffer, qint64 maxBytes)>& read);
+};
+
+} // namespace FlashSpartan
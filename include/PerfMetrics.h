@@ -0,0 +1,395 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QSaveFile>
+#include <QString>
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace FlashSpartan {
+
+/**
+ * Live counters, gauges and latency histograms of the running process.
+ *
+ * Metrics are registered by name and label set on first use and live until exit; updating
+ * one is a relaxed atomic add, and only registration takes a lock, so call sites keep a
+ * reference (a function-local static or a member) rather than looking a series up again.
+ * Histograms use fixed power-of-two buckets from 1 µs to ~34 s, enough for percentiles in
+ * the diagnostics panel without storing samples. toPrometheusText() is the Prometheus text
+ * exposition format, for the node_exporter textfile collector.
+ *
+ * The accessors at the end name the application's own metrics, so each is spelled once.
+ */
+class PerfMetrics {
+public:
+    enum class Kind { Counter, Gauge, Histogram };
+
+    class Counter {
+    public:
+        void add(uint64_t n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> m_value{0};
+    };
+
+    class Gauge {
+    public:
+        void set(int64_t v) { m_value.store(v, std::memory_order_relaxed); }
+        void add(int64_t n) { m_value.fetch_add(n, std::memory_order_relaxed); }
+        int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> m_value{0};
+    };
+
+    class Histogram {
+    public:
+        /** Finite buckets; bucket i holds samples up to 2^i µs, the last one is +Inf. */
+        static constexpr int kBuckets = 26;
+
+        void observeNs(qint64 ns)
+        {
+            const uint64_t us = ns > 0 ? static_cast<uint64_t>(ns + 999) / 1000 : 0;
+            const int bucket = us <= 1 ? 0 : std::min<int>(kBuckets, std::bit_width(us - 1));
+            m_buckets[static_cast<size_t>(bucket)].fetch_add(1, std::memory_order_relaxed);
+            m_sumNs.fetch_add(static_cast<uint64_t>(std::max<qint64>(0, ns)), std::memory_order_relaxed);
+        }
+
+        static double upperBoundSeconds(int bucket)
+        {
+            return bucket >= kBuckets ? std::numeric_limits<double>::infinity()
+                                      : std::ldexp(1e-6, bucket);
+        }
+
+        /** Samples in each bucket (not cumulative); the last entry is the overflow. */
+        std::array<uint64_t, kBuckets + 1> buckets() const
+        {
+            std::array<uint64_t, kBuckets + 1> out{};
+            for (size_t i = 0; i < out.size(); ++i) {
+                out[i] = m_buckets[i].load(std::memory_order_relaxed);
+            }
+            return out;
+        }
+
+        uint64_t count() const
+        {
+            uint64_t n = 0;
+            for (const auto& b : m_buckets) {
+                n += b.load(std::memory_order_relaxed);
+            }
+            return n;
+        }
+
+        double sumSeconds() const { return static_cast<double>(m_sumNs.load(std::memory_order_relaxed)) / 1e9; }
+
+        /**
+         * Upper bound of the bucket holding quantile @p q (0..1), in seconds; at most a factor
+         * of two above the true value. 0 without samples, infinity past the last bucket.
+         */
+        double quantileSeconds(double q) const
+        {
+            const auto counts = buckets();
+            uint64_t total = 0;
+            for (uint64_t c : counts) {
+                total += c;
+            }
+            if (total == 0) {
+                return 0.0;
+            }
+            const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(total))));
+            uint64_t seen = 0;
+            for (int i = 0; i <= kBuckets; ++i) {
+                seen += counts[static_cast<size_t>(i)];
+                if (seen >= rank) {
+                    return upperBoundSeconds(i);
+                }
+            }
+            return upperBoundSeconds(kBuckets);
+        }
+
+    private:
+        std::array<std::atomic<uint64_t>, kBuckets + 1> m_buckets{};
+        std::atomic<uint64_t> m_sumNs{0};
+    };
+
+    /** Observes the time from construction to destruction into a histogram. */
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Histogram& histogram) : m_histogram(histogram), m_beginNs(nowNs()) {}
+        ~ScopedTimer() { m_histogram.observeNs(nowNs() - m_beginNs); }
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Histogram& m_histogram;
+        qint64 m_beginNs;
+    };
+
+    /** One registered series, copied for display. */
+    struct Series {
+        QString name;
+        QString help;
+        QString labels;  // Prometheus label list without braces, e.g. cache="http",result="hit"
+        Kind kind = Kind::Counter;
+        double value = 0.0;  // counters and gauges
+        uint64_t count = 0;  // histograms
+        double sumSeconds = 0.0;
+        double p50 = 0.0;
+        double p90 = 0.0;
+        double p99 = 0.0;
+    };
+
+    /** steady_clock nanoseconds, as PerfTrace::nowNs(). */
+    static qint64 nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /**
+     * The series @p name{@p labels}, registered on first use. @p help is kept from the first
+     * registration of the name. A name registered as another kind is a programming error.
+     */
+    static Counter& counter(const char* name, const char* help, const QString& labels = {})
+    {
+        return *slot(name, help, labels, Kind::Counter).counter;
+    }
+    static Gauge& gauge(const char* name, const char* help, const QString& labels = {})
+    {
+        return *slot(name, help, labels, Kind::Gauge).gauge;
+    }
+    static Histogram& histogram(const char* name, const char* help, const QString& labels = {})
+    {
+        return *slot(name, help, labels, Kind::Histogram).histogram;
+    }
+
+    /** Every series, sorted by name and labels. */
+    static QList<Series> snapshot()
+    {
+        QList<Series> out;
+        std::lock_guard lock(registryMutex());
+        for (const auto& [key, entry] : registry()) {
+            Series s;
+            s.name = QString::fromStdString(key.first);
+            s.labels = QString::fromStdString(key.second);
+            s.help = entry.help;
+            s.kind = entry.kind;
+            if (entry.counter) {
+                s.value = static_cast<double>(entry.counter->value());
+            } else if (entry.gauge) {
+                s.value = static_cast<double>(entry.gauge->value());
+            } else {
+                s.count = entry.histogram->count();
+                s.sumSeconds = entry.histogram->sumSeconds();
+                s.p50 = entry.histogram->quantileSeconds(0.50);
+                s.p90 = entry.histogram->quantileSeconds(0.90);
+                s.p99 = entry.histogram->quantileSeconds(0.99);
+            }
+            out.append(s);
+        }
+        return out;
+    }
+
+    /** Prometheus text exposition format (version 0.0.4). */
+    static QByteArray toPrometheusText()
+    {
+        QByteArray out;
+        std::lock_guard lock(registryMutex());
+        std::string family;
+        for (const auto& [key, entry] : registry()) {
+            const QByteArray name = QByteArray::fromStdString(key.first);
+            const QByteArray labels = QByteArray::fromStdString(key.second);
+            if (key.first != family) {
+                family = key.first;
+                out += "# HELP " + name + ' ' + entry.help.toUtf8() + '\n';
+                out += "# TYPE " + name + ' ' + kindName(entry.kind) + '\n';
+            }
+            if (entry.counter) {
+                out += name + braced(labels) + ' ' + QByteArray::number(entry.counter->value()) + '\n';
+            } else if (entry.gauge) {
+                out += name + braced(labels) + ' ' + QByteArray::number(entry.gauge->value()) + '\n';
+            } else {
+                const auto counts = entry.histogram->buckets();
+                uint64_t cumulative = 0;
+                for (int i = 0; i <= Histogram::kBuckets; ++i) {
+                    cumulative += counts[static_cast<size_t>(i)];
+                    const QByteArray le = i == Histogram::kBuckets
+                                              ? QByteArray("+Inf")
+                                              : QByteArray::number(Histogram::upperBoundSeconds(i), 'g', 6);
+                    const QByteArray bucketLabels =
+                        (labels.isEmpty() ? QByteArray() : labels + ',') + "le=\"" + le + '"';
+                    out += name + "_bucket" + braced(bucketLabels) + ' ' + QByteArray::number(cumulative) + '\n';
+                }
+                out += name + "_sum" + braced(labels) + ' '
+                       + QByteArray::number(entry.histogram->sumSeconds(), 'g', 9) + '\n';
+                out += name + "_count" + braced(labels) + ' ' + QByteArray::number(cumulative) + '\n';
+            }
+        }
+        return out;
+    }
+
+    static bool writeTo(const QString& path)
+    {
+        const QByteArray text = toPrometheusText();
+        QSaveFile file(path);
+        return file.open(QIODevice::WriteOnly) && file.write(text) == text.size() && file.commit();
+    }
+
+    // --- The application's metrics ---------------------------------------------------------
+
+    enum class Cache { IsoHash, Catalog, Http, VolumeMap };
+
+    /** Milestones of a connect in the headless service, timed from its first udev event. */
+    enum class ConnectStage { Card, Mount, ManifestVerdict, HashVerdict, IsoVerdict };
+    static constexpr int kConnectStages = 5;
+
+    static const char* connectStageName(ConnectStage stage)
+    {
+        const char* names[] = {"card", "mount", "manifest_verdict", "hash_verdict", "iso_verdict"};
+        return names[static_cast<size_t>(stage)];
+    }
+
+    /** Bytes read and hashed by HashWorker jobs, per HashWorker::algorithmName(). */
+    static Counter& hashedBytes(const QString& algorithm)
+    {
+        return counter("flashspartan_hashed_bytes_total", "Bytes hashed by device and partition jobs.",
+                       QStringLiteral("algorithm=\"%1\"").arg(algorithm));
+    }
+
+    /** One device read (pread) of the raw hash readers. */
+    static Histogram& readLatency()
+    {
+        static Histogram& h = histogram("flashspartan_read_latency_seconds",
+                                        "Latency of one device read while hashing.");
+        return h;
+    }
+
+    static Counter& cacheLookup(Cache cache, bool hit)
+    {
+        static const std::array<std::array<Counter*, 2>, 4> table = [] {
+            std::array<std::array<Counter*, 2>, 4> t{};
+            const char* names[] = {"iso_hash", "catalog", "http", "volume_map"};
+            for (size_t c = 0; c < t.size(); ++c) {
+                for (size_t h = 0; h < 2; ++h) {
+                    t[c][h] = &counter("flashspartan_cache_lookups_total",
+                                       "Lookups of the ISO hash cache, publisher catalog, HTTP cache and Windows volume map.",
+                                       QStringLiteral("cache=\"%1\",result=\"%2\"")
+                                           .arg(QLatin1String(names[c]),
+                                                h ? QStringLiteral("hit") : QStringLiteral("miss")));
+                }
+            }
+            return t;
+        }();
+        return *table[static_cast<size_t>(cache)][hit ? 1 : 0];
+    }
+
+    /** PolicyStoreEngine::commit(), lock wait to durable. */
+    static Histogram& policyCommitLatency()
+    {
+        static Histogram& h = histogram("flashspartan_policy_commit_latency_seconds",
+                                        "Latency of one policy store commit.");
+        return h;
+    }
+
+    /** From the first udev event of a device to its card in the main window. */
+    static Histogram& udevToCardLatency()
+    {
+        static Histogram& h = histogram("flashspartan_udev_to_card_latency_seconds",
+                                        "Time from a udev add event to the device card.");
+        return h;
+    }
+
+    static Histogram& connectLatency(ConnectStage stage)
+    {
+        static const std::array<Histogram*, kConnectStages> table = [] {
+            std::array<Histogram*, kConnectStages> t{};
+            for (size_t i = 0; i < t.size(); ++i) {
+                t[i] = &histogram("flashspartan_connect_latency_seconds",
+                                  "Time from a storage device's udev add event to each connect milestone.",
+                                  QStringLiteral("stage=\"%1\"")
+                                      .arg(QLatin1String(connectStageName(static_cast<ConnectStage>(i)))));
+            }
+            return t;
+        }();
+        return *table[static_cast<size_t>(stage)];
+    }
+
+    static Gauge& hashQueueDepth(bool running)
+    {
+        static Gauge& pending = gauge("flashspartan_hash_jobs", "HashWorker jobs by state.",
+                                      QStringLiteral("state=\"pending\""));
+        static Gauge& active = gauge("flashspartan_hash_jobs", "HashWorker jobs by state.",
+                                     QStringLiteral("state=\"running\""));
+        return running ? active : pending;
+    }
+
+private:
+    struct Entry {
+        QString help;
+        Kind kind = Kind::Counter;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+    };
+    using Registry = std::map<std::pair<std::string, std::string>, Entry>;
+
+    static Registry& registry()
+    {
+        static Registry r;
+        return r;
+    }
+    static std::mutex& registryMutex()
+    {
+        static std::mutex m;
+        return m;
+    }
+
+    static Entry& slot(const char* name, const char* help, const QString& labels, Kind kind)
+    {
+        std::lock_guard lock(registryMutex());
+        Entry& entry = registry()[{std::string(name), labels.toStdString()}];
+        if (!entry.counter && !entry.gauge && !entry.histogram) {
+            entry.help = QString::fromUtf8(help);
+            entry.kind = kind;
+            switch (kind) {
+            case Kind::Counter: entry.counter = std::make_unique<Counter>(); break;
+            case Kind::Gauge: entry.gauge = std::make_unique<Gauge>(); break;
+            case Kind::Histogram: entry.histogram = std::make_unique<Histogram>(); break;
+            }
+        }
+        Q_ASSERT(entry.kind == kind);
+        return entry;
+    }
+
+    static QByteArray kindName(Kind kind)
+    {
+        switch (kind) {
+        case Kind::Gauge: return "gauge";
+        case Kind::Histogram: return "histogram";
+        case Kind::Counter: break;
+        }
+        return "counter";
+    }
+
+    static QByteArray braced(const QByteArray& labels)
+    {
+        return labels.isEmpty() ? QByteArray() : '{' + labels + '}';
+    }
+};
+
+} // namespace FlashSpartan
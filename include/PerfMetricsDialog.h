@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QDialog>
+
+class QTimer;
+class QTableWidget;
+
+namespace FlashSpartan {
+
+/**
+ * Live view of PerfMetrics, refreshed every second; copies or saves the Prometheus text, and
+ * saves the flight recording.
+ */
+class PerfMetricsDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    explicit PerfMetricsDialog(QWidget* parent = nullptr);
+
+private:
+    void refresh();
+    void saveAs();
+    void saveFlightRecording();
+
+    QTableWidget* m_table = nullptr;
+    QTimer* m_refreshTimer = nullptr;
+};
+
+} // namespace FlashSpartan
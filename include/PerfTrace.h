@@ -0,0 +1,235 @@
+#pragma once
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QString>
+#include <QThread>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace FlashSpartan {
+
+/**
+ * Hot-path spans for the hash, manifest, ISO, policy and udev paths.
+ *
+ * Each thread appends to its own fixed ring of kRingEvents events. There are no locks: the
+ * owning thread is the only writer, and a new ring is pushed onto a lock-free list on first
+ * use. When a ring is full, the oldest events are overwritten. toJson() exports every ring
+ * as complete ("X") events of the Chrome trace-event format, which chrome://tracing and
+ * Perfetto open; StartupTrace covers start-up the same way.
+ *
+ * The FLASHSPARTAN_TRACE_* macros compile to nothing unless FLASHSPARTAN_TRACING is
+ * defined (the CMake option of that name). When compiled in, a span costs one relaxed
+ * load until setEnabled(true) (--trace) or a sink is installed (FlightRecorder).
+ */
+class PerfTrace {
+public:
+    static constexpr size_t kRingEvents = 4096;
+
+    struct Event {
+        const char* category = nullptr;  // static strings only: nothing is copied
+        const char* name = nullptr;
+        qint64 beginNs = 0;
+        qint64 durationNs = 0;
+        qint64 value = -1;  // shown as args.value (bytes, count) when not negative
+    };
+
+    class Span {
+    public:
+        Span(const char* category, const char* name, qint64 value = -1)
+            : m_category(category), m_name(name), m_value(value), m_beginNs(active() ? nowNs() : -1)
+        {
+        }
+        ~Span()
+        {
+            if (m_beginNs >= 0) {
+                record(m_category, m_name, m_beginNs, nowNs(), m_value);
+            }
+        }
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+    private:
+        const char* m_category;
+        const char* m_name;
+        qint64 m_value;
+        qint64 m_beginNs;
+    };
+
+    static bool enabled() { return s_enabled.load(std::memory_order_relaxed); }
+    static void setEnabled(bool on) { s_enabled.store(on, std::memory_order_relaxed); }
+
+    /** Sees every span, tracing on or not; it must not record spans itself. */
+    using Sink = void (*)(const char* category, const char* name, qint64 beginNs, qint64 endNs, qint64 value);
+    static void setSink(Sink sink) { s_sink.store(sink, std::memory_order_release); }
+    /** Spans are timed: tracing is on or a sink is installed. */
+    static bool active() { return enabled() || s_sink.load(std::memory_order_relaxed); }
+
+    /** steady_clock nanoseconds, the time base of every event. */
+    static qint64 nowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    /** Records a span measured by the caller; only the sink sees it while tracing is off. */
+    static void record(const char* category, const char* name, qint64 beginNs, qint64 endNs, qint64 value = -1)
+    {
+        if (const Sink sink = s_sink.load(std::memory_order_acquire)) {
+            sink(category, name, beginNs, endNs, value);
+        }
+        if (!enabled()) {
+            return;
+        }
+        Ring& ring = threadRing();
+        const uint64_t head = ring.head.load(std::memory_order_relaxed);
+        ring.events[head % kRingEvents] = {category, name, beginNs, std::max<qint64>(0, endNs - beginNs), value};
+        ring.head.store(head + 1, std::memory_order_release);
+    }
+
+    /**
+     * The recorded events of every thread. Safe while other threads still record; events
+     * they overwrite during the copy are left out rather than returned torn.
+     */
+    static QByteArray toJson()
+    {
+        QJsonArray trace;
+        const qint64 pid = QCoreApplication::applicationPid();
+        qint64 origin = -1;
+        struct Copied {
+            int thread;
+            QString threadName;
+            std::vector<Event> events;
+        };
+        std::vector<Copied> rings;
+        for (Ring* ring = s_rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+            const uint64_t before = ring->head.load(std::memory_order_acquire);
+            const uint64_t first = before > kRingEvents ? before - kRingEvents : 0;
+            std::vector<Event> copy;
+            copy.reserve(static_cast<size_t>(before - first));
+            for (uint64_t i = first; i < before; ++i) {
+                copy.push_back(ring->events[i % kRingEvents]);
+            }
+            const uint64_t after = ring->head.load(std::memory_order_acquire);
+            const uint64_t keepFrom = after >= kRingEvents ? after - kRingEvents + 1 : 0;
+            if (keepFrom > first) {
+                copy.erase(copy.begin(), copy.begin() + static_cast<qsizetype>(std::min(keepFrom, before) - first));
+            }
+            for (const Event& e : copy) {
+                origin = origin < 0 ? e.beginNs : std::min(origin, e.beginNs);
+            }
+            rings.push_back({ring->thread, ring->threadName, std::move(copy)});
+        }
+        for (const Copied& ring : rings) {
+            QJsonObject meta;
+            meta[QStringLiteral("name")] = QStringLiteral("thread_name");
+            meta[QStringLiteral("ph")] = QStringLiteral("M");
+            meta[QStringLiteral("pid")] = pid;
+            meta[QStringLiteral("tid")] = ring.thread;
+            meta[QStringLiteral("args")] = QJsonObject{{QStringLiteral("name"), ring.threadName}};
+            trace.append(meta);
+            for (const Event& e : ring.events) {
+                QJsonObject obj;
+                obj[QStringLiteral("name")] = QLatin1String(e.name);
+                obj[QStringLiteral("cat")] = QLatin1String(e.category);
+                obj[QStringLiteral("ph")] = QStringLiteral("X");
+                obj[QStringLiteral("ts")] = static_cast<double>(e.beginNs - origin) / 1000.0;
+                obj[QStringLiteral("dur")] = static_cast<double>(e.durationNs) / 1000.0;
+                obj[QStringLiteral("pid")] = pid;
+                obj[QStringLiteral("tid")] = ring.thread;
+                if (e.value >= 0) {
+                    obj[QStringLiteral("args")] = QJsonObject{{QStringLiteral("value"), static_cast<double>(e.value)}};
+                }
+                trace.append(obj);
+            }
+        }
+        QJsonObject root;
+        root[QStringLiteral("traceEvents")] = trace;
+        root[QStringLiteral("displayTimeUnit")] = QStringLiteral("ms");
+        return QJsonDocument(root).toJson(QJsonDocument::Compact);
+    }
+
+    static bool writeTo(const QString& path)
+    {
+        const QByteArray json = toJson();
+        QSaveFile file(path);
+        return file.open(QIODevice::WriteOnly) && file.write(json) == json.size() && file.commit();
+    }
+
+    /** Forgets every recorded event; the rings stay allocated. Tests only. */
+    static void clear()
+    {
+        for (Ring* ring = s_rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+            ring->head.store(0, std::memory_order_release);
+        }
+    }
+
+private:
+    struct Ring {
+        std::atomic<uint64_t> head{0};
+        Event events[kRingEvents];
+        int thread = 0;
+        QString threadName;
+        Ring* next = nullptr;
+    };
+
+    /** Rings outlive their threads (pool threads come back); a few hundred KiB each. */
+    static Ring& threadRing()
+    {
+        thread_local Ring* ring = nullptr;
+        if (!ring) {
+            auto owned = std::make_unique<Ring>();
+            owned->thread = s_nextThread.fetch_add(1, std::memory_order_relaxed);
+            if (QThread* current = QThread::currentThread()) {
+                owned->threadName = current->objectName();
+            }
+            if (owned->threadName.isEmpty()) {
+                owned->threadName = QStringLiteral("thread %1").arg(owned->thread);
+            }
+            ring = owned.release();
+            ring->next = s_rings.load(std::memory_order_relaxed);
+            while (!s_rings.compare_exchange_weak(ring->next, ring, std::memory_order_release,
+                                                  std::memory_order_relaxed)) {
+            }
+        }
+        return *ring;
+    }
+
+    static inline std::atomic<bool> s_enabled{false};
+    static inline std::atomic<Sink> s_sink{nullptr};
+    static inline std::atomic<Ring*> s_rings{nullptr};
+    static inline std::atomic<int> s_nextThread{1};
+};
+
+} // namespace FlashSpartan
+
+#define FLASHSPARTAN_TRACE_CONCAT_(a, b) a##b
+#define FLASHSPARTAN_TRACE_CONCAT(a, b) FLASHSPARTAN_TRACE_CONCAT_(a, b)
+
+#ifdef FLASHSPARTAN_TRACING
+/** A span from here to the end of the scope; @p category and @p name must be string literals. */
+#define FLASHSPARTAN_TRACE_SPAN(category, name) \
+    const ::FlashSpartan::PerfTrace::Span FLASHSPARTAN_TRACE_CONCAT(fsTraceSpan_, __LINE__)(category, name)
+/** As FLASHSPARTAN_TRACE_SPAN, with a value (bytes, a count) shown in the trace viewer. */
+#define FLASHSPARTAN_TRACE_SPAN_VALUE(category, name, value)                                   \
+    const ::FlashSpartan::PerfTrace::Span FLASHSPARTAN_TRACE_CONCAT(fsTraceSpan_, __LINE__)(  \
+        category, name, static_cast<qint64>(value))
+/** A span timed by the caller, in PerfTrace::nowNs() nanoseconds. */
+#define FLASHSPARTAN_TRACE_RECORD(category, name, beginNs, endNs) \
+    ::FlashSpartan::PerfTrace::record(category, name, beginNs, endNs)
+#else
+#define FLASHSPARTAN_TRACE_SPAN(category, name) static_cast<void>(0)
+#define FLASHSPARTAN_TRACE_SPAN_VALUE(category, name, value) static_cast<void>(0)
+#define FLASHSPARTAN_TRACE_RECORD(category, name, beginNs, endNs) static_cast<void>(0)
+#endif
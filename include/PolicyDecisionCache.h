@@ -0,0 +1,58 @@
+#pragma once
+
+#include "StagedVerdict.h"
+#include "Types.h"
+
+#include <QHash>
+#include <QString>
+
+#include <optional>
+
+namespace FlashSpartan {
+
+/** What the connect path and the device lists decide about one device from the stores and settings. */
+struct PolicyDecision {
+    QString driveKey;            // drive-key blocks only hold for the drive this was decided on
+    bool known = false;          // has a whitelist record
+    bool blocked = false;        // BlockedDriveStore, by drive key or id
+    bool countedAllowed = false; // allowed under AppSettings::allowedCountMode and not blocked
+    bool autoMount = false;      // mountIfVerified() mounts it once verified
+    int trustLevel = 0;
+    VerificationProfile profile = VerificationProfile::WatchManifest;
+    VerifyStage finalStage = VerifyStage::FullContent;
+};
+
+/**
+ * Policy decisions by canonical device id. Every entry was derived from one state of the
+ * record store, the block list and the settings; when any of them has moved on, the
+ * whole cache is dropped on the next lookup rather than tracked per device, since a
+ * settings change or a resync can touch every decision at once.
+ */
+class PolicyDecisionCache {
+public:
+    /** Generations of what the decisions were derived from. */
+    struct Sources {
+        quint64 records = 0;   // DatabaseManager::recordGeneration()
+        quint64 blocks = 0;    // BlockedDriveStore::listGeneration()
+        quint64 settings = 0;  // SettingsSnapshot::version()
+
+        bool operator==(const Sources& other) const = default;
+    };
+
+    /**
+     * The decision for @p deviceId on @p driveKey if one was cached against @p sources;
+     * drops everything first when @p sources differ from the last lookup's.
+     */
+    std::optional<PolicyDecision> find(const QString& deviceId, const QString& driveKey, const Sources& sources);
+    /** Caches @p decision, derived under the sources of the last find(). */
+    void insert(const QString& deviceId, const PolicyDecision& decision);
+    void clear();
+
+    int size() const { return static_cast<int>(m_decisions.size()); }
+
+private:
+    Sources m_sources;
+    QHash<QString, PolicyDecision> m_decisions;
+};
+
+} // namespace FlashSpartan
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMetaType>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include <functional>
+
+namespace FlashSpartan {
+
+/** One job's progress as read from its worker's counters. */
+struct ProgressSample {
+    enum class Kind { Hash, Manifest, IsoVerify };
+
+    Kind kind = Kind::Hash;
+    QString jobId;
+    double fraction = 0.0;  // 0.0 to 1.0
+    quint64 bytesDone = 0;
+    quint64 bytesTotal = 0;
+    double speedMBps = 0.0;
+    double etaSeconds = 0.0;
+    quint64 itemsDone = 0;   // files, for manifest and ISO jobs
+    quint64 itemsTotal = 0;
+    QString detail;          // current file name, when there is one
+};
+
+/**
+ * Single delivery point for job progress on the GUI thread.
+ *
+ * Workers register a source that reads their atomic counters; while any job runs the hub
+ * polls every source once per display frame (once a second while the window is hidden or
+ * in the tray) and publishes the samples that changed visibly in one published() signal.
+ * A sample counts as changed when the bar moves by a step, the file changes, or the labels
+ * are kLabelRefreshMs old. Receivers that could not show a sample (its card is off-screen)
+ * hand it back with republish() and get it again on the next tick.
+ */
+class ProgressHub : public QObject {
+    Q_OBJECT
+
+public:
+    using Source = std::function<QList<ProgressSample>()>;
+
+    static constexpr double kDefaultFrameRate = 60.0;
+    static constexpr int kBackgroundIntervalMs = 1000;
+    static constexpr int kLabelRefreshMs = 250;
+    static constexpr double kFractionStep = 0.001;
+
+    static ProgressHub& instance();
+
+    explicit ProgressHub(QObject* parent = nullptr);
+
+    /** Polls @p source on every tick until @p owner is destroyed. */
+    void addSource(QObject* owner, Source source);
+    /** Starts ticking after a job started; ticking stops by itself when every source is idle. */
+    void wake();
+
+    /** Display refresh rate the foreground interval follows. */
+    void setFrameRate(double hz);
+    /** Slows ticking to kBackgroundIntervalMs while nothing is on screen. */
+    void setBackground(bool background);
+    int interval() const { return m_timer.interval(); }
+
+    /** Publishes @p sample again on the next tick even if it has not changed. */
+    void republish(const ProgressSample& sample);
+
+    /** Polls every source now, as a tick does. */
+    void tick();
+
+signals:
+    void published(const QList<FlashSpartan::ProgressSample>& samples);
+
+private:
+    struct Published {
+        double fraction = -1.0;
+        QString detail;
+        qint64 atMs = 0;
+    };
+
+    static QString keyOf(const ProgressSample& sample);
+    void updateInterval();
+
+    QHash<QObject*, Source> m_sources;
+    QHash<QString, Published> m_published;
+    QTimer m_timer;
+    QElapsedTimer m_clock;
+    double m_frameRate = kDefaultFrameRate;
+    bool m_background = false;
+};
+
+} // namespace FlashSpartan
+
+Q_DECLARE_METATYPE(FlashSpartan::ProgressSample)
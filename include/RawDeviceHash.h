@@ -3,8 +3,14 @@
 #include "Types.h"
 
 #include <QString>
+#include <QStringList>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
 
 namespace FlashSpartan { struct HashCheckpoint; }
 
@@ -14,19 +20,199 @@ enum class Algorithm {
     SHA256,
     SHA512,
     BLAKE2b,
+    /** libblake3; pair with ScanMode::ParallelChunked to use every core. */
+    BLAKE3,
+    /** Non-cryptographic pre-screen (libxxhash); never a trust decision on its own. */
+    XXH3_128,
 };
 
 inline constexpr int kMinBufferSizeKB = 64;
 inline constexpr int kDefaultBufferSizeKB = 1024;
 inline constexpr int kMaxBufferSizeKB = 16 * 1024;
 
+/** Read engine for full sequential hashes on Linux (QuickSample / chunked resume keep their own
+ *  loops). Windows always tries queued unbuffered overlapped reads first (WinOverlappedReader). */
+enum class IoEngine {
+    Default,  // mmap when useMemoryMapping, otherwise read()
+    IoUring,  // N queued O_DIRECT reads in flight while hashing; falls back to Default
+};
+
+/** Buffers in the hashReadLoop reader/hasher ring; < 2 keeps the serial read-then-hash loop. */
+inline constexpr int kDefaultPipelineDepth = 3;
+inline constexpr int kMaxPipelineDepth = 16;
+
+inline constexpr int kMaxHashThreads = 8;
+
+inline constexpr int kMinIoQueueDepth = 2;
+inline constexpr int kDefaultIoQueueDepth = 4;
+inline constexpr int kMaxIoQueueDepth = 32;
+
 QString algorithmName(Algorithm algo);
 Algorithm algorithmFromName(const QString& name);
+/** False for XXH3_128: a match only means "probably unchanged", not "not tampered with". */
+bool algorithmIsCryptographic(Algorithm algo);
+/** False when the digest backing @p algo was not compiled in (libblake3 / libxxhash). */
+bool algorithmAvailable(Algorithm algo);
 int normalizedBufferSizeKB(int requestedKB);
 
+QString ioEngineName(IoEngine engine);
+IoEngine ioEngineFromName(const QString& name);
+int normalizedIoQueueDepth(int requested);
+
+/** True when built with liburing and the running kernel accepts io_uring_setup(). */
+bool ioUringAvailable();
+
+/** Block-layer transfer limits from /sys/class/block/<dev>/queue; 0 = unknown (or not Linux). */
+struct QueueLimits {
+    int maxSectorsKB = 0;  // largest single request the driver issues
+    int optimalIoKB = 0;   // optimal_io_size; most USB bridges report 0
+};
+QueueLimits queueLimits(const QString& deviceNode);
+
+/**
+ * A byte range a chunked full read also hashes on its own (Options::regions): the same
+ * 64 MiB block tree, counted from the range's start, that a Full hash of just the range
+ * builds.
+ */
+struct Region {
+    QString name;
+    uint64_t offset = 0;
+    uint64_t length = 0;
+};
+
+/**
+ * The regions of a whole-disk read, from /sys/class/block: "table" for everything before
+ * the first partition (MBR or GPT and the gap behind it), then each partition under its
+ * device node, so its digest equals a Full hash of that partition. Empty for a partition,
+ * a disk without partitions, or off Linux.
+ */
+std::vector<Region> partitionRegions(const QString& diskNode);
+
+/**
+ * Who a device is, independent of the node it got this time, for checkpoints that survive a
+ * replug. storageId is the disk's serial-bearing /dev/disk/by-id name, plus "#part<n>" for
+ * a partition; layoutFingerprint digests the disk size and every partition's start and size
+ * from /sys/class/block, so a repartitioned disk does not match. Empty when the disk has no
+ * by-id name, or off Linux.
+ */
+struct StorageIdentity {
+    QString storageId;
+    QString layoutFingerprint;
+
+    bool isValid() const { return !storageId.isEmpty(); }
+};
+
+StorageIdentity storageIdentity(const QString& deviceNode);
+
+/**
+ * Where a block device sits, from /sys/class/block. The elevated helper and the image
+ * writer only touch removable or USB-attached disks, and never the disk under "/".
+ */
+struct DeviceAttachment {
+    bool known = false;        // found in sysfs
+    QString disk;              // whole-disk name, e.g. "sdb"
+    bool isPartition = false;
+    bool removable = false;    // the disk's "removable" attribute
+    bool usb = false;          // the disk sits below a USB host controller
+    bool backsRoot = false;    // the root filesystem lives on it, directly or through dm/md
+    uint64_t sizeBytes = 0;    // of the entry itself (partition or disk), from "size"
+};
+
+DeviceAttachment deviceAttachment(const QString& deviceNode);
+
+/**
+ * deviceAttachment() of @p sysEntry, a /sys/class/block/<name> link or directory, with
+ * @p rootDisks the whole-disk names under "/". Exposed for tests, which pass a stand-in tree.
+ */
+DeviceAttachment deviceAttachmentAt(const QString& sysEntry, const QStringList& rootDisks);
+
+/** Whole-disk names the root filesystem is on, through dm/md slaves; empty off Linux. */
+QStringList rootDisks();
+
+/**
+ * Why @p attachment must not be read by the elevated helper or written by the image writer,
+ * or empty when it may: a disk holding "/" always, one that is neither removable nor on
+ * USB unless @p allowFixed.
+ */
+QString externalDiskRefusal(const DeviceAttachment& attachment, bool allowFixed = false);
+
+/**
+ * The elevated helper's only way to open a device (OpenDevice and Job frames, the one-shot
+ * command line): openDevice(), then externalDiskRefusal() of the disk the descriptor refers
+ * to, looked up by its st_rdev in /sys/dev/block. Judging the open descriptor rather than the
+ * path means a link swapped after validation cannot redirect the read. Returns the fd, or -1
+ * with @p refusal set. Off Linux, where the helper has no such path, just openDevice().
+ */
+int openHelperDevice(const QString& deviceNode, QString* refusal);
+
+/**
+ * openHelperDevice() with @p sysDevBlock standing in for /sys/dev/block and @p rootDisks the
+ * whole-disk names under "/". Exposed for tests.
+ */
+int openHelperDeviceAt(const QString& deviceNode, const QString& sysDevBlock, const QStringList& rootDisks,
+                       QString* refusal);
+
+/** Buffer sizes autoTuneBufferSize() tries: powers of two plus multiples of @p limits, ascending. */
+std::vector<int> bufferTuneCandidatesKB(const QueueLimits& limits);
+
+inline constexpr uint64_t kDefaultTuneProbeBytes = 256ULL * 1024 * 1024;
+
+struct BufferTuning {
+    int bufferSizeKB = 0;  // 0 = probe not possible; keep the configured size
+    double bestMBps = 0.0;
+    QueueLimits limits;
+};
+
+/**
+ * Read the first @p probeBytes of @p fd in equal slices, one per candidate buffer size,
+ * and return the fastest (a larger size must win by 5% to displace a smaller one).
+ * Uses pread(), so the file offset is untouched. Linux only; Windows returns {}.
+ */
+BufferTuning autoTuneBufferSize(int fd, const QString& deviceNode,
+                                uint64_t probeBytes = kDefaultTuneProbeBytes);
+/** As above, with limits and size the caller already has (DeviceGeometryCache). */
+BufferTuning autoTuneBufferSize(int fd, const QueueLimits& limits, uint64_t deviceBytes,
+                                uint64_t probeBytes = kDefaultTuneProbeBytes);
+
+inline constexpr int kDefaultReadTimeoutMs = 5000;
+inline constexpr int kMinReadTimeoutMs = 100;
+
+inline constexpr int kDefaultQuickSamples = 15;
+inline constexpr int kMinQuickSamples = 2;
+inline constexpr int kMaxQuickSamples = 256;
+inline constexpr int kDefaultQuickSampleKB = 1024;
+inline constexpr int kMinQuickSampleKB = 4;
+inline constexpr int kMaxQuickSampleKB = 16 * 1024;
+
+/**
+ * Where ScanMode::QuickSample reads: head, tail and evenly spaced samples in between,
+ * optionally plus the offsets where partition tables and common filesystems keep their
+ * superblocks and backups. The defaults are the original fixed layout, so quick baselines
+ * recorded before the layout became configurable still match.
+ */
+struct QuickSampleLayout {
+    int samples = kDefaultQuickSamples;
+    int sampleKB = kDefaultQuickSampleKB;
+    bool metadataHotSpots = false;
+
+    bool isDefault() const
+    {
+        return samples == kDefaultQuickSamples && sampleKB == kDefaultQuickSampleKB
+               && !metadataHotSpots;
+    }
+};
+
+QuickSampleLayout normalizedQuickSampleLayout(QuickSampleLayout layout);
+/** Suffix after "-QUICK" in HashResult::algorithm: empty for the default layout, else "-32x256K[-META]". */
+QString quickSampleLabelSuffix(const QuickSampleLayout& layout);
+/** The layout a stored "SHA256-QUICK-32x256K" label was hashed with; the default otherwise. */
+QuickSampleLayout quickSampleLayoutFromLabel(const QString& algorithmLabel);
+
 enum class ScanMode {
     Full,
     QuickSample,
+    /** Same 64 MiB block tree as chunked Full, blocks hashed on hashThreads workers. */
+    ParallelChunked,
 };
 
 struct Options {
@@ -34,16 +220,166 @@ struct Options {
     Algorithm algorithm = Algorithm::SHA256;
     int bufferSizeKB = kDefaultBufferSizeKB;
     bool useMemoryMapping = true;
+    IoEngine ioEngine = IoEngine::Default;
+    int ioQueueDepth = kDefaultIoQueueDepth;
+    /**
+     * Reader/hasher ring depth for the plain read loop (runPipelined()). Checkpointed,
+     * resumed, region and chunked reads take hashAdvanced()'s block loop instead and ignore it.
+     */
+    int pipelineDepth = kDefaultPipelineDepth;
+    /** ParallelChunked workers; 0 = hardware concurrency capped at kMaxHashThreads. */
+    int hashThreads = 0;
     std::atomic<bool>* cancelled = nullptr;
+    /** While set, the engines hold their position at the next buffer; cancelled still ends them. */
+    std::atomic<bool>* paused = nullptr;
     std::atomic<uint64_t>* bytesProcessed = nullptr;
+    /**
+     * Share of bytesProcessed already charged to the background bandwidth cap. hashDevice()
+     * sets it when called from a background-class thread (IoPriority); skipped zero regions
+     * count like reads.
+     */
+    std::atomic<uint64_t>* pacedBytes = nullptr;
+    /** Filled in by paths that learn the size late (the elevated helper); may stay 0. */
+    std::atomic<uint64_t>* totalBytes = nullptr;
     ScanMode scanMode = ScanMode::Full;
+    /** QuickSample only; samples are fetched with overlapping preads or one io_uring batch. */
+    QuickSampleLayout quickSample;
     uint64_t resumeFromBytes = 0;
+    /**
+     * Hash only the first lengthLimit bytes, e.g. the span a dd-written image occupies;
+     * 0 = the whole device. A device shorter than the limit fails instead of hashing less.
+     */
+    uint64_t lengthLimit = 0;
     FlashSpartan::HashCheckpoint* checkpointOut = nullptr;
     int checkpointEveryBlocks = 4;
+    /** Called on the hashing thread each time checkpointOut is updated, e.g. to persist it. */
+    std::function<void(const FlashSpartan::HashCheckpoint&)> checkpointed;
+    /**
+     * Chunked full reads: all-zero blocks take a cached zero digest and SEEK_HOLE holes are
+     * not read. The result is identical to hashing every byte. Linux only.
+     */
+    bool skipZeroRegions = false;
+    /** Baseline block digests (kDefaultChunkBytes blocks) a chunked full read is compared to. */
+    const QStringList* expectedBlockHashes = nullptr;
+    /** With expectedBlockHashes: end the read at the first differing block (HashResult::stoppedAtBlock). */
+    bool stopAtFirstMismatch = false;
+    /** Chunked full reads: called once per finished block, from worker threads in ParallelChunked. */
+    std::function<void(uint64_t block, const QString& hex)> blockHashed;
+    /**
+     * Full reads on Linux: each buffer as read, before it is hashed, so a second reader can
+     * share the pass (SharedReadPass). Sequential in offset order except in ParallelChunked.
+     * Skipped zero regions are not passed on, and the elevated helper keeps its data.
+     */
+    std::function<void(uint64_t offset, const char* data, size_t length)> dataRead;
+    /**
+     * Chunked full reads (Linux): also hash each range on its own, into
+     * HashResult::regionHashes, from the same read. ParallelChunked reads its blocks in order
+     * when regions are set; ranges starting before a resume point are left out.
+     */
+    std::vector<Region> regions;
+    /**
+     * Sequential full reads (Linux): a read that fails is retried in smaller pieces, one that
+     * takes longer than readTimeoutMs is given up, and what stays unreadable is hashed as
+     * zeros and listed in HashResult::unreadableRanges instead of failing the hash. Takes
+     * precedence over the scan mode, checkpoints and the other engines.
+     */
+    bool tolerateReadErrors = false;
+    int readTimeoutMs = kDefaultReadTimeoutMs;
+    /**
+     * Elevated hashes (Linux): keep the pkexec helper running for later jobs, within
+     * HelperSession's device and time limits, instead of authenticating every time.
+     */
+    bool reuseHelperSession = false;
 };
 
 static constexpr uint64_t kDefaultChunkBytes = 64ULL * 1024 * 1024;
 
+/**
+ * Time blocked in reads, time in digest updates and read retries of one hash, added from
+ * any of its threads. The read loops copy it into HashResult::performance.
+ */
+class JobMeter {
+public:
+    /** Adds the time from construction to destruction to one of the meter's totals. */
+    class Timed {
+    public:
+        explicit Timed(std::atomic<uint64_t>& total)
+            : m_total(total), m_begin(std::chrono::steady_clock::now())
+        {
+        }
+        ~Timed()
+        {
+            const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - m_begin);
+            m_total.fetch_add(static_cast<uint64_t>(ns.count()), std::memory_order_relaxed);
+        }
+        Timed(const Timed&) = delete;
+        Timed& operator=(const Timed&) = delete;
+
+    private:
+        std::atomic<uint64_t>& m_total;
+        std::chrono::steady_clock::time_point m_begin;
+    };
+
+    Timed reading() { return Timed(m_readNs); }
+    Timed hashing() { return Timed(m_hashNs); }
+    void retried() { m_retries.fetch_add(1, std::memory_order_relaxed); }
+
+    static uint64_t nowNs()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                         std::chrono::steady_clock::now().time_since_epoch())
+                                         .count());
+    }
+
+    /** Chunked engines: @p block took @p ns from its first read to its digest. */
+    void blockTimed(uint64_t block, uint64_t ns)
+    {
+        std::lock_guard<std::mutex> lock(m_blocksMutex);
+        m_blockUs.push_back(static_cast<uint32_t>(std::min<uint64_t>(ns / 1000, UINT32_MAX)));
+        if (m_slowestBlock < 0 || ns / 1000 > m_slowestUs) {
+            m_slowestBlock = static_cast<qint64>(block);
+            m_slowestUs = ns / 1000;
+        }
+    }
+
+    /** For single-threaded loops that only time the digest: the rest of @p elapsedMs was reads. */
+    void readsTookTheRest(uint64_t elapsedMs)
+    {
+        const uint64_t hashMs = m_hashNs.load(std::memory_order_relaxed) / 1000000;
+        m_readNs.store((elapsedMs > hashMs ? elapsedMs - hashMs : 0) * 1000000, std::memory_order_relaxed);
+    }
+
+    void fill(HashPerformance& perf, const QString& engine, int bufferSizeKB, int queueDepth) const
+    {
+        perf.engine = engine;
+        perf.bufferSizeKB = bufferSizeKB;
+        perf.queueDepth = queueDepth;
+        perf.ioWaitMs = m_readNs.load(std::memory_order_relaxed) / 1000000;
+        perf.cpuMs = m_hashNs.load(std::memory_order_relaxed) / 1000000;
+        perf.readRetries = m_retries.load(std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(m_blocksMutex);
+        if (!m_blockUs.empty()) {
+            std::vector<uint32_t> sorted = m_blockUs;
+            std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+            perf.blockMsMedian = sorted[sorted.size() / 2] / 1000;
+            perf.blockMsMax = m_slowestUs / 1000;
+            perf.slowestBlock = m_slowestBlock;
+            perf.timedBlocks = static_cast<int>(m_blockUs.size());
+        }
+    }
+
+private:
+    std::atomic<uint64_t> m_readNs{0};
+    std::atomic<uint64_t> m_hashNs{0};
+    std::atomic<int> m_retries{0};
+    mutable std::mutex m_blocksMutex;
+    std::vector<uint32_t> m_blockUs;
+    uint64_t m_slowestUs = 0;
+    qint64 m_slowestBlock = -1;
+};
+
 
 /** Open block device read-only (direct open only). Returns fd or -1. */
 int openDevice(const QString& deviceNode);
@@ -59,4 +395,21 @@ HashResult hashOpenFd(int fd, const Options& options);
 /** Open (or use polkit helper) and hash. */
 HashResult hashDevice(const Options& options, const QString& pkexecHelperPath = QString());
 
+/**
+ * Blocks while Options::paused is set and Options::cancelled is not. Every engine calls it
+ * where it checks for cancellation, once per buffer, so a paused hash keeps its device
+ * open and its digest state and continues where it stopped. With Options::pacedBytes set it
+ * also charges the progress since the last call to IoPriority::pace().
+ */
+void waitWhilePaused(const Options& options);
+
+/**
+ * Ends a parked elevated helper session and closes descriptors it passed
+ * (Options::reuseHelperSession); no-op on Windows.
+ */
+void closeHelperSession();
+
+/** Closes a cached helper-passed descriptor when @p deviceNode goes away; no-op on Windows. */
+void forgetDeviceAccess(const QString& deviceNode);
+
 } // namespace FlashSpartan::RawDeviceHash
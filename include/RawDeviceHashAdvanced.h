@@ -3,13 +3,89 @@
 #include "HashCheckpoint.h"
 #include "RawDeviceHash.h"
 
+#include <cstdint>
+#include <functional>
+#include <memory>
+
 namespace FlashSpartan::RawDeviceHash {
 
 QString scanModeTag(ScanMode mode);
 
 QString combineBlockHashes(const QStringList& blockHex, Algorithm algo);
 
+/**
+ * Cuts bytes fed in offset order into kDefaultChunkBytes blocks and digests each, giving the
+ * blockHashes and combined hash a chunked full read of the same bytes would. For data that
+ * is not on a device yet, e.g. an image as it is written (ImageFlasher). Linux only.
+ */
+class BlockStreamHasher {
+public:
+    explicit BlockStreamHasher(Algorithm algo);
+    ~BlockStreamHasher();
+
+    BlockStreamHasher(const BlockStreamHasher&) = delete;
+    BlockStreamHasher& operator=(const BlockStreamHasher&) = delete;
+
+    bool update(const char* data, size_t length);
+    /** Ends the last, possibly short, block; false when a digest failed. */
+    bool finish();
+
+    const QStringList& blockHashes() const { return m_blockHashes; }
+    /** combineBlockHashes() of blockHashes(), after finish(). */
+    const QString& hash() const { return m_hash; }
+    uint64_t bytes() const { return m_bytes; }
+
+private:
+    struct State;
+    std::unique_ptr<State> m_state;
+    Algorithm m_algorithm;
+    QStringList m_blockHashes;
+    QString m_hash;
+    uint64_t m_bytes = 0;
+    uint64_t m_inBlock = 0;
+    bool m_failed = false;
+};
+
+/** Reads up to @p length bytes at @p offset like pread(): the count, or -1 with errno set. */
+using ReadAtFn = std::function<int64_t(char* data, size_t length, uint64_t offset)>;
+
+/** Sizes a failed read is retried in, each piece of the one before (the last is the floor). */
+inline constexpr size_t kTolerantRetryBytes[] = {64 * 1024, 4 * 1024};
+/** Reads given up on (still stuck in the kernel) before the device counts as unresponsive. */
+inline constexpr int kMaxAbandonedReads = 4;
+
+/**
+ * Options::tolerateReadErrors over @p readAt, which hashOpenFd() points at the device. Each
+ * read runs on an I/O thread and is waited for at most readTimeoutMs; a read that does not
+ * come back is left to finish on its own and its range given up, since a read blocked in
+ * the kernel cannot be cancelled. Linux only.
+ */
+HashResult hashTolerant(const ReadAtFn& readAt, const Options& options, uint64_t deviceSize);
+
+/**
+ * Start offsets of the QuickSample reads in hash order: head, tail (when the device is
+ * larger than one sample), the evenly spaced ones, then metadata hot spots that fit.
+ * Each read covers min(sampleKB KiB, deviceSize - offset) bytes.
+ */
+std::vector<uint64_t> quickSampleOffsets(const QuickSampleLayout& layout, uint64_t deviceSize);
+
 /** Quick sample or resumable chunked full read. */
 HashResult hashAdvanced(int fd, const Options& options, uint64_t deviceSize);
 
+struct ByteRange {
+    uint64_t offset = 0;
+    uint64_t length = 0;
+};
+
+/**
+ * Byte ranges whose block digests differ, adjacent blocks merged. Only the blocks present
+ * in @p current are compared; ones missing from @p baseline count as changed. A non-zero
+ * @p deviceSize clips the last range.
+ */
+std::vector<ByteRange> changedBlockRanges(const QStringList& baseline, const QStringList& current,
+                                          uint64_t blockSize, uint64_t deviceSize = 0);
+
+/** "64–128 MiB, 1024–1088 MiB (+2 more)" for logs and history entries. */
+QString describeByteRanges(const std::vector<ByteRange>& ranges, int maxShown = 4);
+
 } // namespace FlashSpartan::RawDeviceHash
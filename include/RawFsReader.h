@@ -0,0 +1,114 @@
+#pragma once
+
+#include <QDateTime>
+#include <QString>
+#include <QVector>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace FlashSpartan {
+
+/**
+ * Read-only view of an unmounted FAT12/16/32, exFAT or ext2/3/4 volume, parsed straight from
+ * the block device, so a watch manifest can be verified before (or instead of) a mount.
+ * Covers what a verify needs: directory listings, the stat fields the file system records and
+ * sequential file contents. Nothing is written and no journal is replayed: an ext3/4 volume
+ * whose journal needs recovery is refused, since its mounted view would differ. Everything
+ * read from the device is bounds-checked; a corrupt volume fails with an error, never a crash.
+ * Not thread-safe: one reader per thread.
+ */
+class RawFsReader {
+public:
+    enum class Type { Fat, ExFat, Ext };
+
+    /** Fills @p data with the @p length bytes at @p offset of the volume, or fails with @p error. */
+    using ReadAt = std::function<bool(uint64_t offset, char* data, size_t length, QString* error)>;
+    using ConsumeFn = std::function<bool(const char* data, size_t length)>;
+
+    struct Entry {
+        QString name;  // as listed; empty for the root
+        bool isDirectory = false;
+        bool isRegular = false;
+        bool isSymlink = false;
+        uint64_t size = 0;
+        QDateTime modifiedUtc;
+        /** Invalid where the file system records no change time (FAT, exFAT). */
+        QDateTime changedUtc;
+        /** Inode number on ext; 0 where a mount would invent one (FAT, exFAT). */
+        uint64_t inode = 0;
+
+        // Where the data lives; only the reader that listed the entry interprets these.
+        uint64_t location = 0;     // first cluster, or inode number
+        uint64_t validLength = 0;  // exFAT: bytes past this read as zeros
+        bool contiguous = false;   // exFAT: clusters follow each other, no FAT chain
+    };
+
+    virtual ~RawFsReader() = default;
+
+    RawFsReader(const RawFsReader&) = delete;
+    RawFsReader& operator=(const RawFsReader&) = delete;
+
+    /** Probes the volume's boot sector and superblock; nullptr with @p error when unsupported. */
+    static std::unique_ptr<RawFsReader> open(ReadAt read, uint64_t volumeSize, QString* error);
+
+#ifndef Q_OS_WIN
+    /**
+     * A ReadAt over @p fd (not owned) through a 4 KiB-aligned bounce buffer, so descriptors
+     * opened with O_DIRECT (RawDeviceHash::openDevice(), the helper's fd) work unchanged.
+     */
+    static ReadAt descriptorReader(int fd);
+#endif
+
+    virtual Type type() const = 0;
+    static QString typeName(Type type);
+
+    /** Names match case-insensitively on FAT and exFAT, as the kernel looks them up. */
+    bool caseSensitive() const { return type() == Type::Ext; }
+
+    const Entry& root() const { return m_root; }
+
+    /**
+     * The entry at "/"-separated @p relativePath ("" is the root). False with @p error empty
+     * when nothing is there; false with @p error set when the volume cannot be read or a
+     * symbolic link is on the way (only a mount resolves those).
+     */
+    bool lookup(const QString& relativePath, Entry* out, QString* error);
+
+    /** Entries of directory @p dir, without "." and "..". */
+    virtual bool list(const Entry& dir, QVector<Entry>* out, QString* error) = 0;
+
+    /**
+     * Contents of regular file @p file in order, at most kReadChunkBytes per @p consume call.
+     * When @p consume returns false, false is returned with @p error untouched.
+     */
+    virtual bool read(const Entry& file, const ConsumeFn& consume, QString* error) = 0;
+
+    /**
+     * Reads the data of files (read()) through @p read instead of the reader given to open();
+     * directories, allocation tables and inodes still come from that one. Lets a verify take
+     * file data from a SharedReadPass. An empty @p read restores the default.
+     */
+    void setContentReader(ReadAt read) { m_contentRead = std::move(read); }
+
+    static constexpr size_t kReadChunkBytes = 1024 * 1024;
+
+protected:
+    RawFsReader(ReadAt read, uint64_t volumeSize);
+
+    /** m_read with the range checked against the volume size. */
+    bool readAt(uint64_t offset, char* data, size_t length, QString* error) const;
+    /** readAt() for file data, through the content reader when one is set. */
+    bool readContentAt(uint64_t offset, char* data, size_t length, QString* error) const;
+
+    Entry m_root;
+
+private:
+    ReadAt m_read;
+    ReadAt m_contentRead;
+    uint64_t m_volumeSize = 0;
+};
+
+} // namespace FlashSpartan
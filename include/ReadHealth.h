@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Types.h"
+
+#include <QList>
+#include <QString>
+
+namespace FlashSpartan {
+
+enum class ReadAnomaly {
+    SpeedCollapse,      // far slower than this device's recent reads
+    InJobSlowdown,      // one stretch of the read far slower than the rest
+    BlockLatencySpike,  // one chunk took many times the median chunk
+};
+
+QString readAnomalyName(ReadAnomaly anomaly);
+
+struct ReadFinding {
+    ReadAnomaly kind = ReadAnomaly::SpeedCollapse;
+    QString detail;
+};
+
+/**
+ * Read-health checks on the timings every full-read hash already records, so they cost
+ * no extra I/O. Counterfeit-capacity and failing flash tends to show up as a stick that
+ * suddenly reads at a fraction of its usual speed, or as a few chunks that take seconds
+ * while the rest take milliseconds (the controller retrying, remapping or stalling).
+ * Findings are hints for the operator, never a verification failure.
+ */
+namespace ReadHealth {
+
+/** Reads shorter than this say little about sustained speed and are ignored. */
+inline constexpr uint64_t kMinDurationMs = 5000;
+/** Earlier reads in the profile before SpeedCollapse is judged. */
+inline constexpr int kMinProfileReads = 3;
+/** SpeedCollapse: the average is below this fraction of the profile median. */
+inline constexpr double kCollapseFraction = 0.5;
+/** InJobSlowdown: the slowest one-second window is below this fraction of the average. */
+inline constexpr double kSlowdownFraction = 0.2;
+/** BlockLatencySpike: the slowest chunk took this many times the median, and at least kSpikeMinMs. */
+inline constexpr double kSpikeRatio = 8.0;
+inline constexpr uint64_t kSpikeMinMs = 1000;
+inline constexpr int kMinTimedBlocks = 4;
+
+/** Whether @p result ran long enough, over the whole device, to be judged. */
+bool isAssessable(const HashResult& result);
+
+/** Median of the profile's window, or 0 when it is empty. */
+double baselineMBps(const ReadProfile& profile);
+
+/** Findings for @p result against @p profile (the profile before this read). */
+QList<ReadFinding> assess(const ReadProfile& profile, const HashResult& result);
+
+/** @p profile with @p result and its @p findings added; a new engine restarts the window. */
+ReadProfile advance(ReadProfile profile, const HashResult& result, const QList<ReadFinding>& findings);
+
+} // namespace ReadHealth
+
+} // namespace FlashSpartan
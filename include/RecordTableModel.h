@@ -0,0 +1,230 @@
+#pragma once
+
+#include <QAbstractTableModel>
+#include <QFutureWatcher>
+#include <QList>
+#include <QStringList>
+#include <QtConcurrent>
+
+#include <functional>
+
+namespace FlashSpartan {
+
+/**
+ * Fetch window and visible rows of a RecordTableModel, independent of the record type.
+ *
+ * Visible rows are indexes into the records, which are held oldest first so that new events
+ * append without shifting any index; row 0 is the newest match. Views are handed
+ * kFetchBatch rows at a time through canFetchMore()/fetchMore(), and once every held record
+ * is shown the subclass may pull older ones from its store.
+ */
+class RecordTableModelBase : public QAbstractTableModel {
+    Q_OBJECT
+
+public:
+    static constexpr int kFetchBatch = 256;
+    /** Filters over more records than this run on the thread pool. */
+    static constexpr int kAsyncFilterRecords = 4096;
+
+    explicit RecordTableModelBase(const QStringList& headers, QObject* parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+
+    /** Held records passing the filter, whether the view fetched them yet or not. */
+    int matchCount() const { return int(m_visible.size()); }
+    bool isFiltering() const { return m_filtering; }
+
+signals:
+    /** The visible rows were replaced: new records or a filter finished. */
+    void rowsReplaced();
+
+protected:
+    int recordIndex(int row) const { return m_visible.at(m_visible.size() - 1 - row); }
+    /** Replaces the visible rows (record indexes, ascending) and resets the fetch window. */
+    void resetVisible(QList<int> visible);
+    /** Adds matches among newly appended records (indexes above every visible one) at the top. */
+    void insertNewest(const QList<int>& indexes);
+    /**
+     * Prepends matches among @p count records put in front of the held ones: every visible
+     * index moves up by @p count, and the new rows come after the fetched ones.
+     */
+    void insertOldest(const QList<int>& indexes, int count);
+
+    virtual bool canFetchOlder() const { return false; }
+    virtual void fetchOlder(int count) { Q_UNUSED(count) }
+
+    bool m_filtering = false;
+
+private:
+    QStringList m_headers;
+    QList<int> m_visible;
+    int m_fetched = 0;
+};
+
+/**
+ * Read-only table over log records (alerts, audit lines, verification history) for the
+ * pages that show them; @p cell renders a column. setFilter() narrows the rows with a
+ * predicate, run on a snapshot on the thread pool when there are many records, and a filter
+ * set later supersedes one still running. Records that arrive meanwhile are matched when it
+ * lands.
+ */
+template <typename Record>
+class RecordTableModel : public RecordTableModelBase {
+public:
+    using CellFn = std::function<QVariant(const Record& record, int column, int role)>;
+    using Predicate = std::function<bool(const Record& record)>;
+    /**
+     * Up to @p count records older than all of @p held (oldest first), newest first; fewer
+     * once the store runs out.
+     */
+    using OlderFn = std::function<QList<Record>(const QList<Record>& held, int count)>;
+
+    RecordTableModel(const QStringList& headers, CellFn cell, QObject* parent = nullptr)
+        : RecordTableModelBase(headers, parent), m_cell(std::move(cell))
+    {
+    }
+
+    /** Replaces every record; @p newestFirst as the stores return them. */
+    void setRecords(const QList<Record>& newestFirst)
+    {
+        QList<Record> records;
+        records.reserve(newestFirst.size());
+        for (auto it = newestFirst.crbegin(); it != newestFirst.crend(); ++it) {
+            records.append(*it);
+        }
+        m_records = std::move(records);
+        m_olderExhausted = !m_older;
+        refilter();
+    }
+
+    /** Adds records newer than every held one, newest first, without resetting the view. */
+    void prependRecords(const QList<Record>& newestFirst)
+    {
+        const int first = int(m_records.size());
+        for (auto it = newestFirst.crbegin(); it != newestFirst.crend(); ++it) {
+            m_records.append(*it);
+        }
+        if (m_filtering) {
+            return;  // matched when the running filter lands
+        }
+        QList<int> matches;
+        for (int i = first; i < m_records.size(); ++i) {
+            if (accepts(m_records.at(i))) {
+                matches.append(i);
+            }
+        }
+        insertNewest(matches);
+    }
+
+    void setOlderSource(OlderFn older)
+    {
+        m_older = std::move(older);
+        m_olderExhausted = !m_older;
+    }
+
+    void setFilter(Predicate predicate)
+    {
+        m_predicate = std::move(predicate);
+        refilter();
+    }
+
+    const Record& record(int row) const { return m_records.at(recordIndex(row)); }
+    int recordCount() const { return int(m_records.size()); }
+
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override
+    {
+        if (!index.isValid() || index.row() >= rowCount()) {
+            return {};
+        }
+        return m_cell(record(index.row()), index.column(), role);
+    }
+
+protected:
+    bool canFetchOlder() const override { return m_older && !m_olderExhausted && !m_filtering; }
+
+    void fetchOlder(int count) override
+    {
+        const QList<Record> older = m_older(m_records, count);
+        if (older.size() < count) {
+            m_olderExhausted = true;
+        }
+        if (older.isEmpty()) {
+            return;
+        }
+        QList<Record> records;
+        records.reserve(older.size() + m_records.size());
+        for (auto it = older.crbegin(); it != older.crend(); ++it) {
+            records.append(*it);
+        }
+        records.append(m_records);
+        m_records = std::move(records);
+        QList<int> matches;
+        for (int i = 0; i < older.size(); ++i) {
+            if (accepts(m_records.at(i))) {
+                matches.append(i);
+            }
+        }
+        insertOldest(matches, int(older.size()));
+    }
+
+private:
+    bool accepts(const Record& record) const { return !m_predicate || m_predicate(record); }
+
+    void refilter()
+    {
+        const quint64 generation = ++m_generation;
+        if (!m_predicate || m_records.size() <= kAsyncFilterRecords) {
+            m_filtering = false;
+            QList<int> visible;
+            for (int i = 0; i < m_records.size(); ++i) {
+                if (accepts(m_records.at(i))) {
+                    visible.append(i);
+                }
+            }
+            resetVisible(std::move(visible));
+            return;
+        }
+
+        m_filtering = true;
+        resetVisible({});
+        const QList<Record> snapshot = m_records;  // implicitly shared, no copy
+        auto* watcher = new QFutureWatcher<QList<int>>(this);
+        QObject::connect(watcher, &QFutureWatcherBase::finished, this,
+                         [this, watcher, generation, matched = int(snapshot.size())]() {
+                             watcher->deleteLater();
+                             if (generation != m_generation) {
+                                 return;
+                             }
+                             QList<int> visible = watcher->result();
+                             for (int i = matched; i < m_records.size(); ++i) {
+                                 if (accepts(m_records.at(i))) {
+                                     visible.append(i);
+                                 }
+                             }
+                             m_filtering = false;
+                             resetVisible(std::move(visible));
+                         });
+        watcher->setFuture(QtConcurrent::run([snapshot, predicate = m_predicate]() {
+            QList<int> visible;
+            for (int i = 0; i < snapshot.size(); ++i) {
+                if (!predicate || predicate(snapshot.at(i))) {
+                    visible.append(i);
+                }
+            }
+            return visible;
+        }));
+    }
+
+    CellFn m_cell;
+    Predicate m_predicate;
+    OlderFn m_older;
+    bool m_olderExhausted = true;
+    QList<Record> m_records;  // oldest first
+    quint64 m_generation = 0;
+};
+
+} // namespace FlashSpartan
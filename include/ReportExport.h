@@ -0,0 +1,91 @@
+#pragma once
+
+#include "VerifyHistory.h"
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QString>
+
+#include <atomic>
+#include <functional>
+#include <optional>
+
+namespace FlashSpartan {
+
+/** One audit log line as the Reports page lists it. */
+struct AuditLogRow {
+    QDateTime time;
+    QString category;
+    QString event;
+    QString detail;
+    QString source;
+};
+
+/**
+ * Writes verification history or an audit log to a file without holding either in memory:
+ * the ring is read record by record (VerifyHistory::scan) and the log segment by segment
+ * (AuditLogIndex::forEach), and each row goes straight to the output. Meant to run off the
+ * UI thread; rows come out oldest first.
+ */
+class ReportExport {
+public:
+    enum class Format {
+        Csv,
+        Ndjson,  // one JSON object per line, as stored
+        Html,
+    };
+
+    enum class Source {
+        Verification,
+        Audit,
+        PolicyAudit,
+    };
+
+    /** Empty fields match everything. */
+    struct Filter {
+        QDateTime from;
+        QDateTime to;
+        /** Exact device node; answered from the audit index without reading other lines. */
+        QString device;
+        /** Verification status (pass, fail, ...), case-insensitive. */
+        QString status;
+        /** Case-insensitive substring of the device, summary and detail columns. */
+        QString text;
+    };
+
+    struct Request {
+        Source source = Source::Verification;
+        /** The verify-history ring or the audit log's open segment. */
+        QString sourcePath;
+        QString outputPath;
+        Format format = Format::Csv;
+        Filter filter;
+    };
+
+    struct Result {
+        bool success = false;
+        bool cancelled = false;
+        qint64 rows = 0;
+        QString errorMessage;
+    };
+
+    /** Rows written so far and the share of the source read, 0..1; called every few hundred rows. */
+    using ProgressFn = std::function<void(qint64 rows, double done)>;
+
+    /** By extension: .ndjson / .jsonl, .html / .htm, anything else CSV. */
+    static Format formatForPath(const QString& path);
+
+    /** The output is written to a temporary file and only replaces outputPath when complete. */
+    static Result run(const Request& request, const ProgressFn& progress = {},
+                      const std::atomic<bool>* cancelled = nullptr);
+
+    /**
+     * @p line of the audit log at @p path as a row; @p policyFormat for the policy audit's
+     * fields. nullopt when the line is not a JSON object.
+     */
+    static std::optional<AuditLogRow> auditRow(const QByteArray& line, const QString& path, bool policyFormat);
+    /** "Hash", "Watch" or "ISO". */
+    static QString kindLabel(VerifyHistoryKind kind);
+};
+
+} // namespace FlashSpartan
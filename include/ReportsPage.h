@@ -1,62 +1,86 @@
 #pragma once
 
+#include "RecordTableModel.h"
+#include "ReportExport.h"
 #include "VerifyHistory.h"
+#include "VerifyRollup.h"
 
 #include <QWidget>
 
 class QComboBox;
 class QLineEdit;
+class QProgressBar;
 class QPushButton;
 class QTabWidget;
-class QTableWidget;
+class QTableView;
 class QLabel;
 
 namespace FlashSpartan {
 
-struct AuditLogRow {
-    QDateTime time;
-    QString category;
-    QString event;
-    QString detail;
-    QString source;
-};
-
 class ReportsPage : public QWidget {
     Q_OBJECT
 
 public:
     explicit ReportsPage(QWidget* parent = nullptr);
 
+    using VerifyModel = RecordTableModel<VerifyHistoryEntry>;
+    using AuditModel = RecordTableModel<AuditLogRow>;
+
+    /** Newest first. Scrolling past them pulls older ones from the sources set below. */
     void setVerificationRows(const QList<VerifyHistoryEntry>& entries);
     void setAuditRows(const QList<AuditLogRow>& rows);
     void setPolicyAuditRows(const QList<AuditLogRow>& rows);
+    /** Adds an entry just recorded at the top without reloading the table. */
+    void addVerificationRow(const VerifyHistoryEntry& entry);
+    void setOlderSources(VerifyModel::OlderFn verify, AuditModel::OlderFn audit, AuditModel::OlderFn policyAudit);
     void setLogPaths(const QString& auditPath, const QString& policyAuditPath);
+    /** Pass/fail counts above the tables, from the history rollup. */
+    void setVerificationSummary(const VerifyRollup::Counts& last30Days, const VerifyRollup::Counts& allTime);
+
+    /** Progress of the export started by exportRequested(); @p done is 0..1. */
+    void setExportProgress(qint64 rows, double done);
+    void setExportFinished(const ReportExport::Result& result, const QString& outputPath);
 
 signals:
     void refreshRequested();
     void openAuditLogRequested();
     void openPolicyAuditRequested();
+    /** The current tab, with its filters and the chosen range, to be written in the background. */
+    void exportRequested(const ReportExport::Request& request);
+    void exportCancelRequested();
 
 private slots:
     void onRefreshClicked();
     void onOpenAuditClicked();
     void onOpenPolicyAuditClicked();
     void onVerifyFilterChanged();
+    void onExportClicked();
 
 private:
     void setupUi();
+    QTableView* createTable(QAbstractItemModel* model);
     void applyVerifyTableLayout();
-    void applyAuditTableLayout(QTableWidget* table);
+    void applyAuditTableLayout(QTableView* table);
 
     QLabel* m_auditPathLabel = nullptr;
     QLabel* m_policyPathLabel = nullptr;
+    QLabel* m_summaryLabel = nullptr;
+    QString m_auditPath;
+    QString m_policyAuditPath;
+    QComboBox* m_exportRange = nullptr;
+    QPushButton* m_exportButton = nullptr;
+    QPushButton* m_exportCancel = nullptr;
+    QProgressBar* m_exportProgress = nullptr;
+    QLabel* m_exportStatus = nullptr;
     QTabWidget* m_tabs = nullptr;
     QLineEdit* m_verifySearch = nullptr;
     QComboBox* m_verifyStatusFilter = nullptr;
-    QTableWidget* m_verifyTable = nullptr;
-    QTableWidget* m_auditTable = nullptr;
-    QTableWidget* m_policyTable = nullptr;
-    QList<VerifyHistoryEntry> m_verifyRows;
+    QTableView* m_verifyTable = nullptr;
+    QTableView* m_auditTable = nullptr;
+    QTableView* m_policyTable = nullptr;
+    VerifyModel* m_verifyModel = nullptr;
+    AuditModel* m_auditModel = nullptr;
+    AuditModel* m_policyModel = nullptr;
 };
 
 } // namespace FlashSpartan
@@ -172,6 +172,7 @@ private:
     QCheckBox* m_showNotificationsCheck = nullptr;
     QCheckBox* m_autoStartCheck = nullptr;
     QSpinBox* m_recentEventsLimitSpin = nullptr;
+    QSpinBox* m_activityLogLinesSpin = nullptr;
     QSpinBox* m_deviceHistoryRetentionSpin = nullptr;
     QSpinBox* m_deviceHistoryMaxEntriesSpin = nullptr;
     QComboBox* m_allowedCountModeCombo = nullptr;
@@ -179,12 +180,22 @@ private:
     // Security tab
     QCheckBox* m_autoHashOnConnectCheck = nullptr;
     QCheckBox* m_autoHashOnEjectCheck = nullptr;
+    QCheckBox* m_ejectSealCheck = nullptr;
+    QCheckBox* m_speculativePrefetchCheck = nullptr;
     QCheckBox* m_confirmNewDeviceCheck = nullptr;
     QCheckBox* m_confirmModifiedCheck = nullptr;
     QCheckBox* m_blockModifiedCheck = nullptr;
     QComboBox* m_defaultTrustCombo = nullptr;
     QComboBox* m_appModuleCombo = nullptr;
     QComboBox* m_defaultProfileCombo = nullptr;
+    QCheckBox* m_watchMetadataFirstCheck = nullptr;
+    QSpinBox* m_watchSampleSpin = nullptr;
+    QCheckBox* m_hybridMetadataFirstCheck = nullptr;
+    QSpinBox* m_hybridSampleSpin = nullptr;
+    QCheckBox* m_watchJournalCheck = nullptr;
+    QCheckBox* m_watchFailFastCheck = nullptr;
+    QCheckBox* m_watchFailFastReportCheck = nullptr;
+    QCheckBox* m_watchChunkCheck = nullptr;
     QLineEdit* m_isoDirEdit = nullptr;
     QCheckBox* m_isoAutoVerifyCheck = nullptr;
     QCheckBox* m_isoAutoVerifyOnUsbMountCheck = nullptr;
@@ -193,17 +204,26 @@ private:
     QCheckBox* m_blockMountOnIsoFailCheck = nullptr;
     QCheckBox* m_isoVerifyDecompressedCheck = nullptr;
     QCheckBox* m_isoPreferOfflineCheck = nullptr;
+    QComboBox* m_isoReadCacheCombo = nullptr;
+    QCheckBox* m_isoVerifyDdImagesCheck = nullptr;
     QSpinBox* m_isoParallelSpin = nullptr;
     QCheckBox* m_badUsbEnabledCheck = nullptr;
     QCheckBox* m_badUsbAlertNewKeyboardCheck = nullptr;
     QCheckBox* m_badUsbAlertCompositeCheck = nullptr;
     QCheckBox* m_badUsbAlertInterfaceDriftCheck = nullptr;
     QCheckBox* m_badUsbAlertRapidReconnectCheck = nullptr;
+    QCheckBox* m_badUsbAlertKeystrokeRateCheck = nullptr;
     QCheckBox* m_badUsbAutoBaselineCheck = nullptr;
     QCheckBox* m_badUsbConfirmCheck = nullptr;
     QCheckBox* m_badUsbUsbmonCheck = nullptr;
     QCheckBox* m_badUsbUsbmonOnAnomalyCheck = nullptr;
     QLineEdit* m_badUsbUsbmonCommandEdit = nullptr;
+    QSpinBox* m_badUsbUsbmonPreTriggerSpin = nullptr;
+    QCheckBox* m_badUsbUsbmonSuspectOnlyCheck = nullptr;
+    QCheckBox* m_badUsbUsbmonSummarizeCheck = nullptr;
+    QSpinBox* m_badUsbCaptureQuotaSpin = nullptr;
+    QSpinBox* m_badUsbCaptureMaxAgeSpin = nullptr;
+    QCheckBox* m_badUsbCaptureCompressCheck = nullptr;
 
     // Hashing tab
     QComboBox* m_hashAlgorithmCombo = nullptr;
@@ -211,9 +231,24 @@ private:
     QComboBox* m_defaultHashScanModeCombo = nullptr;
     QCheckBox* m_hashResumeCheckpointsCheck = nullptr;
     QCheckBox* m_promptHashOptionsCheck = nullptr;
+    QCheckBox* m_hashPrescreenCheck = nullptr;
+    QCheckBox* m_stopAtFirstChangeCheck = nullptr;
+    QSpinBox* m_quickSamplesSpin = nullptr;
+    QSpinBox* m_quickSampleKBSpin = nullptr;
+    QCheckBox* m_quickSampleMetadataCheck = nullptr;
     QSpinBox* m_bufferSizeSpin = nullptr;
+    QCheckBox* m_bufferAutoTuneCheck = nullptr;
+    QCheckBox* m_capacityProbeCheck = nullptr;
+    QCheckBox* m_skipZeroRegionsCheck = nullptr;
+    QCheckBox* m_helperSessionCheck = nullptr;
     QCheckBox* m_useMemoryMappingCheck = nullptr;
+    QComboBox* m_ioEngineCombo = nullptr;
+    QSpinBox* m_ioQueueDepthSpin = nullptr;
+    QComboBox* m_hugePagesCombo = nullptr;
     QSpinBox* m_maxConcurrentSpin = nullptr;
+    QSpinBox* m_backgroundLimitSpin = nullptr;
+    QCheckBox* m_pauseOnBatteryCheck = nullptr;
+    QSpinBox* m_memoryBudgetSpin = nullptr;
     QLabel* m_bufferSizeLabel = nullptr;
 
     // Appearance tab
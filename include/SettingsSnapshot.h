@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Types.h"
+
+#include <functional>
+#include <memory>
+
+namespace FlashSpartan {
+
+/**
+ * The application's settings as one immutable AppSettings, published whole by the GUI
+ * thread after it loads or applies them. Readers on any thread take the current snapshot
+ * with one atomic load and keep it for as long as they need consistent values: nothing
+ * they hold is ever changed, and no QSettings file or lock is touched on the way.
+ */
+namespace SettingsSnapshot {
+
+using Ptr = std::shared_ptr<const AppSettings>;
+using Listener = std::function<void(const Ptr& settings)>;
+
+/** The last published settings; defaults before the first publish(). Never null. */
+Ptr current();
+
+/** Counts publish() calls; a reader caching what it derived compares this instead of the settings. */
+quint64 version();
+
+/** Replaces the snapshot with @p settings, then calls every listener with it on this thread. */
+void publish(const AppSettings& settings);
+
+/** Calls @p listener on each later publish(); returns an id for removeListener(). */
+int addListener(Listener listener);
+void removeListener(int id);
+
+} // namespace SettingsSnapshot
+
+} // namespace FlashSpartan
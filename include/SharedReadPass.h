@@ -0,0 +1,81 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+
+namespace FlashSpartan {
+
+/**
+ * One read of a device shared by two consumers: a full hash publishes every buffer it reads
+ * (RawDeviceHash::Options::dataRead), and an unmounted manifest verify takes file data from
+ * it (RawFsReader::setContentReader()) instead of reading the same sectors a second time.
+ * Hybrid verification uses it to reach both verdicts in about the time of one full read.
+ *
+ * The pass keeps a window of the bytes published last. A read the hash has not reached yet
+ * waits for it; one that has left the window, or that the hash will not deliver (it ended,
+ * published nothing for kStallMs, or resumed past it), is read from the device directly. When the
+ * window is full a publish waits up to kHoldMs for the reader to move past the oldest data,
+ * so a reader that keeps up loses nothing and a slow one cannot stall the hash for long.
+ * Thread-safe: any number of publishers (ParallelChunked workers), one reader.
+ */
+class SharedReadPass {
+public:
+    using DirectRead = std::function<bool(uint64_t offset, char* data, size_t length, QString* error)>;
+
+    static constexpr uint64_t kDefaultWindowBytes = 256ULL * 1024 * 1024;
+    static constexpr int kStallMs = 2000;
+    static constexpr int kHoldMs = 1000;
+
+    explicit SharedReadPass(uint64_t windowBytes = kDefaultWindowBytes);
+
+    SharedReadPass(const SharedReadPass&) = delete;
+    SharedReadPass& operator=(const SharedReadPass&) = delete;
+
+    /** The hash read @p length bytes at @p offset; kept until the window moves past them. */
+    void publish(uint64_t offset, const char* data, size_t length);
+    /** The hash ended, however it ended: waiting and later reads go to the device. */
+    void finish();
+    /** The reader is done: publishing keeps nothing from now on. */
+    void detach();
+
+    /**
+     * Fills @p data from the pass when it has or will have those bytes, otherwise through
+     * @p direct. Only @p direct fails, with @p error. Stops waiting once @p cancelled is set.
+     */
+    bool read(uint64_t offset, char* data, size_t length, const DirectRead& direct, QString* error,
+              const std::atomic<bool>* cancelled = nullptr);
+
+    /** Bytes read() took from the pass, and bytes it had to read itself. */
+    uint64_t sharedBytes() const;
+    uint64_t directBytes() const;
+
+private:
+    bool copyLocked(uint64_t offset, char* data, size_t length) const;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_published;
+    QWaitCondition m_consumed;
+    std::map<uint64_t, QByteArray> m_segments;  // by device offset
+    uint64_t m_windowBytes = 0;
+    uint64_t m_heldBytes = 0;
+    uint64_t m_floor = 0;        // nothing below this will be published (any more)
+    uint64_t m_readerAt = 0;     // end of the reader's latest request
+    uint64_t m_holdGaveUpAt = UINT64_MAX;  // m_readerAt when a publish last stopped waiting
+    bool m_started = false;
+    bool m_finished = false;
+    bool m_detached = false;
+    QElapsedTimer m_sincePublish;
+    uint64_t m_shared = 0;
+    uint64_t m_direct = 0;
+};
+
+} // namespace FlashSpartan
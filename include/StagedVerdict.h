@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QString>
+
+#include <optional>
+
+namespace FlashSpartan {
+
+/** Verification stages from plug-in to decision, cheapest first. */
+enum class VerifyStage {
+    Identity,     // whitelist and blocked-drive lookup
+    Layout,       // partition table and file system identity from the first sectors
+    QuickSample,  // sampled raw-device digest
+    Metadata,     // watch-manifest check on the mounted file system
+    FullContent,  // every byte (baseline algorithm or XXH3 pre-screen)
+};
+
+enum class StageOutcome {
+    Pass,
+    Fail,
+    Inconclusive,  // ran, but proves nothing either way (new device, fresh baseline, ...)
+};
+
+enum class ProvisionalVerdict {
+    Pending,
+    Allow,
+    Block,
+};
+
+QString verifyStageName(VerifyStage stage);
+QString stageOutcomeName(StageOutcome outcome);
+QString provisionalVerdictName(ProvisionalVerdict verdict);
+
+/**
+ * Running verdict for one connected device. Each stage that finishes is recorded and the
+ * verdict is published after it, so policy can act as soon as it is conclusive:
+ *  - a Fail at any stage blocks, conclusively (a blocked drive or any mismatch);
+ *  - a Pass at or beyond the device's final stage allows, conclusively;
+ *  - a Pass before that is a provisional Allow: later stages still run.
+ * Nothing overturns a Block.
+ */
+class StagedVerdict {
+public:
+    struct StageResult {
+        VerifyStage stage = VerifyStage::Identity;
+        StageOutcome outcome = StageOutcome::Inconclusive;
+        QString detail;
+        qint64 elapsedMs = 0;  // since the device connected
+    };
+
+    /** @p finalStage is the last stage the device's verification profile runs. */
+    explicit StagedVerdict(VerifyStage finalStage = VerifyStage::FullContent);
+
+    VerifyStage finalStage() const { return m_finalStage; }
+    void setFinalStage(VerifyStage stage) { m_finalStage = stage; }
+
+    /** Returns true when the verdict or its conclusiveness changed. */
+    bool record(VerifyStage stage, StageOutcome outcome, const QString& detail = {});
+
+    ProvisionalVerdict verdict() const { return m_verdict; }
+    bool isConclusive() const { return m_decidedAt.has_value(); }
+    /** The stage that made the verdict conclusive. */
+    std::optional<VerifyStage> decidedAt() const { return m_decidedAt; }
+    const QList<StageResult>& stages() const { return m_stages; }
+
+    /** "Allow (provisional, after quick sample)", "Block at identity", ... */
+    QString describe() const;
+
+private:
+    VerifyStage m_finalStage;
+    ProvisionalVerdict m_verdict = ProvisionalVerdict::Pending;
+    std::optional<VerifyStage> m_decidedAt;
+    QList<StageResult> m_stages;
+    QElapsedTimer m_timer;
+};
+
+} // namespace FlashSpartan
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+namespace FlashSpartan {
+
+/**
+ * Start-up phase timings.
+ *
+ * A Phase logs its duration when it ends and is kept as a complete ("X") event of the
+ * Chrome trace-event format, which chrome://tracing and Perfetto open. Times are
+ * microseconds since start() (the top of main()); phases may run and end on any thread.
+ * With an output path set (--startup-trace), finish() writes the file once the window is
+ * up, and phases that end later (the udev scan) rewrite it.
+ */
+class StartupTrace {
+public:
+    struct Event {
+        QString name;
+        qint64 beginUs = 0;
+        qint64 durationUs = 0;
+        int thread = 0;   // 1 is the thread that called start()
+    };
+
+    class Phase {
+    public:
+        explicit Phase(QString name);
+        ~Phase();
+
+        Phase(const Phase&) = delete;
+        Phase& operator=(const Phase&) = delete;
+
+        /** Ends the phase before the scope does; later calls do nothing. */
+        void end();
+
+    private:
+        QString m_name;
+        qint64 m_beginUs = 0;
+        bool m_ended = false;
+    };
+
+    static void start();
+    static qint64 nowUs();
+
+    /** Records a phase measured by the caller, e.g. one that begins and ends in different slots. */
+    static void record(const QString& name, qint64 beginUs, qint64 endUs);
+
+    static void setOutputPath(const QString& path);
+    /** Logs the time to here and writes the trace file, when there is one. */
+    static void finish();
+
+    static QList<Event> events();
+    static QByteArray toJson();
+    static void reset();
+
+private:
+    StartupTrace() = delete;
+};
+
+} // namespace FlashSpartan
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QFile>
+#include <QList>
+#include <QString>
+
+#include <memory>
+#include <optional>
+
+namespace FlashSpartan {
+
+/**
+ * zstd for what the app keeps at rest: device records in the policy store, compressed one
+ * by one against a dictionary trained on the store's own records, and closed device
+ * timeline segments, compressed whole and read back as a stream of lines.
+ *
+ * Compiled to stubs unless HAS_ZSTD is defined: nothing is compressed then, and
+ * compressed data fails to decode with an error that says so.
+ */
+namespace StoreCompression {
+
+constexpr int kLevel = 6;
+/** Training needs enough samples to find what they share; fewer records go without. */
+constexpr int kMinDictionarySamples = 64;
+constexpr int kDictionaryBytes = 16 * 1024;
+/** Samples beyond this are strided over; training time grows with the sample size. */
+constexpr qsizetype kMaxTrainingBytes = 2 * 1024 * 1024;
+
+bool available();
+
+/** A dictionary for compressing @p samples one by one; empty when there are too few. */
+QByteArray trainDictionary(const QList<QByteArray>& samples);
+
+/** Compresses small blobs against one dictionary. Not thread-safe. */
+class Encoder {
+public:
+    /** An empty @p dictionary compresses each blob on its own. */
+    explicit Encoder(const QByteArray& dictionary = {}, int level = kLevel);
+    ~Encoder();
+    Encoder(const Encoder&) = delete;
+    Encoder& operator=(const Encoder&) = delete;
+
+    /** One zstd frame; empty when it would not be smaller than @p raw (or no zstd). */
+    QByteArray compress(QByteArrayView raw);
+
+private:
+    struct State;
+    std::unique_ptr<State> d;
+};
+
+/**
+ * Decompresses blobs written by Encoder. A copy shares the digested dictionary and has its
+ * own context, so each thread takes one.
+ */
+class Decoder {
+public:
+    explicit Decoder(const QByteArray& dictionary = {});
+    Decoder(const Decoder& other);
+    ~Decoder();
+    Decoder& operator=(const Decoder&) = delete;
+
+    /** False when the dictionary was rejected or the build has no zstd. */
+    bool isValid() const;
+    /** nullopt with @p error set unless @p stored inflates to exactly @p rawLength bytes. */
+    std::optional<QByteArray> decompress(QByteArrayView stored, qsizetype rawLength,
+                                         QString* error = nullptr);
+
+private:
+    struct State;
+    std::unique_ptr<State> d;
+};
+
+/** A whole file's worth of @p raw as one frame; empty without zstd. */
+QByteArray compressFile(QByteArrayView raw, int level = kLevel);
+
+/** Lines of a compressed file, inflated a buffer at a time instead of all at once. */
+class LineReader {
+public:
+    explicit LineReader(const QString& path);
+    ~LineReader();
+    LineReader(const LineReader&) = delete;
+    LineReader& operator=(const LineReader&) = delete;
+
+    bool open(QString* error = nullptr);
+    /** The next line with its '\n'; a last line without one is returned as it is. False at the end. */
+    bool readLine(QByteArray* line);
+    /** Set when the data was corrupt or truncated; lines read before it are good. */
+    QString errorString() const { return m_error; }
+
+private:
+    bool fill();
+
+    QFile m_file;
+    struct State;
+    std::unique_ptr<State> d;
+    QByteArray m_pending;
+    qsizetype m_pendingPos = 0;
+    bool m_eof = false;
+    QString m_error;
+};
+
+} // namespace StoreCompression
+
+} // namespace FlashSpartan
@@ -8,6 +8,7 @@
 #include <QPalette>
 #include <QPropertyAnimation>
 #include <QWidget>
+#include <functional>
 #include <memory>
 
 namespace FlashSpartan {
@@ -17,6 +18,12 @@ namespace FlashSpartan {
  * 
  * Provides a futuristic, cyberpunk-inspired dark theme with neon accents.
  * Supports dynamic theme switching and consistent styling across all widgets.
+ *
+ * Every *StyleSheet() string is built once per theme and cached, so switching back to a
+ * theme or styling many widgets reuses the same strings. Widgets created in bulk (device
+ * cards) should not set their own stylesheet: the application stylesheet carries their
+ * rules, selected by object name and the dynamic properties set through setTextRole(),
+ * setButtonVariant() and setStatusBadge(), so each widget costs a polish, not a parse.
  */
 class StyleManager : public QObject {
     Q_OBJECT
@@ -78,6 +85,10 @@ public:
         GlowSecondary,
         ShadowColor
     };
+    Q_ENUM(ColorRole)
+
+    /** QPushButton looks selected by the application stylesheet. */
+    enum class ButtonVariant { Default, Primary, Danger };
 
     /**
      * @brief Font roles
@@ -260,6 +271,25 @@ public:
     QString statusIndicatorStyleSheet(ColorRole statusColor) const;
     QString statusBadgeStyleSheet(ColorRole background, ColorRole foreground) const;
 
+    // ========================================================================
+    // Application-stylesheet Roles
+    // ========================================================================
+
+    /**
+     * @brief Colors a QLabel's text through the application stylesheet
+     * @param role TextPrimary, TextSecondary, TextMuted or AccentPrimary
+     */
+    static void setTextRole(QWidget* label, ColorRole role);
+
+    /** Primary and danger buttons without a per-button stylesheet. */
+    static void setButtonVariant(QWidget* button, ButtonVariant variant);
+
+    /**
+     * @brief Styles a QLabel named "StatusBadge" as a pill in @p background
+     * @param background Surface (muted text) or Verified, Modified, Unknown, Hashing, Error
+     */
+    static void setStatusBadge(QWidget* label, ColorRole background);
+
     // ========================================================================
     // Animation Helpers
     // ========================================================================
@@ -341,16 +371,34 @@ private:
      */
     void loadTheme(Theme theme);
 
+    /** Fonts for m_baseFontSize. */
+    void loadFonts();
+
     /**
      * @brief Generate stylesheet from current colors
      */
     void generateStyleSheet();
 
+    enum class Sheet {
+        Application, MainWindow, DeviceCard, Button, PrimaryButton, DangerButton, ListWidget,
+        ProgressBar, InputField, Label, ScrollArea, CompactTableButton, DataTable, Tooltip,
+        Dialog, Menu, TabWidget, TabBar, MessageBox, StatusIndicator, StatusBadge
+    };
+    static int sheetKey(Sheet sheet, ColorRole a = ColorRole::Background, ColorRole b = ColorRole::Background)
+    {
+        return int(sheet) | (int(a) << 8) | (int(b) << 16);
+    }
+    /** The current theme's sheet for @p key, built by @p build on first use. */
+    QString cachedSheet(int key, const std::function<QString()>& build) const;
+    /** Sets a dynamic property and re-polishes @p widget when the value changed. */
+    static void setStyleProperty(QWidget* widget, const char* name, const QString& value);
+
     // Current state
     Theme m_currentTheme = Theme::CyberDark;
     QHash<ColorRole, QColor> m_colors;
     QHash<FontRole, QFont> m_fonts;
     QString m_cachedStyleSheet;
+    mutable QHash<int, QHash<int, QString>> m_sheetCache;  // by Theme; cleared when the font size changes
 
     // Configuration
     int m_baseFontSize = 10;
@@ -6,6 +6,7 @@
 #include <QTimer>
 #include <memory>
 
+#include "NotificationCoalescer.h"
 #include "Types.h"
 
 namespace FlashSpartan {
@@ -16,7 +17,7 @@ namespace FlashSpartan {
  * Provides:
  * - Status icon with dynamic updates
  * - Context menu for quick actions
- * - Desktop notifications
+ * - Desktop notifications, coalesced and rate limited by NotificationCoalescer
  * - Minimize to tray functionality
  */
 class TrayIcon : public QObject {
@@ -83,7 +84,7 @@ public:
     void setHashingActive(bool active);
 
     /**
-     * @brief Show a notification
+     * @brief Show a notification; held and merged with others like any non-security notice
      * @param title Notification title
      * @param message Notification body
      * @param icon Icon type
@@ -119,11 +120,13 @@ public:
 
     void notifyIsoVerifySummary(const QString& deviceName, int passed, int total, int needsSidecar);
     void notifyBadUsbAnomaly(const BadUsbAnomalyResult& anomaly);
+    void notifyReadAnomaly(const QString& deviceName, const QString& detail);
+    void notifyCounterfeitCapacity(const QString& deviceName, const QString& detail);
 
     /**
      * @brief Enable or disable notifications
      */
-    void setNotificationsEnabled(bool enabled) { m_notificationsEnabled = enabled; }
+    void setNotificationsEnabled(bool enabled);
     bool notificationsEnabled() const { return m_notificationsEnabled; }
 
 signals:
@@ -165,6 +168,11 @@ signals:
      */
     void deviceEjectRequested(const QString& deviceNode);
 
+    /**
+     * @brief Emitted when user requests to eject every listed device at once
+     */
+    void ejectAllRequested(const QStringList& deviceNodes);
+
 public slots:
     /**
      * @brief Update the list of connected devices in the menu
@@ -180,8 +188,12 @@ private slots:
     void onActivated(QSystemTrayIcon::ActivationReason reason);
     void onMessageClicked();
     void updateHashingAnimation();
+    void deliverNotice(const FlashSpartan::TrayNotice& notice);
 
 private:
+    void post(TrayNotice::Category category, const QString& title, const QString& message,
+              QSystemTrayIcon::MessageIcon icon, int duration = 3000, bool failed = false);
+
     /**
      * @brief Create the tray icon
      */
@@ -223,6 +235,7 @@ private:
     int m_whitelistedDevices = 0;
     bool m_hashingActive = false;
     bool m_notificationsEnabled = true;
+    NotificationCoalescer m_notifications;
 
     // Animation
     QTimer* m_animationTimer = nullptr;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "WatchFileList.h"
+
 #include <QString>
 #include <QStringList>
 #include <QDateTime>
@@ -9,6 +11,7 @@
 #include <QMetaType>
 #include <QCryptographicHash>
 #include <cstdint>
+#include <memory>
 
 namespace FlashSpartan {
 
@@ -24,6 +27,11 @@ struct DeviceInfo {
     uint64_t sizeBytes = 0;
     bool isRemovable = true;
     bool isMounted = false;
+    /** USB topology (Linux udev): host controller bus number and port path such as "2-1.4". */
+    QString usbBus;
+    QString usbPortPath;
+    /** PerfMetrics::nowNs() of the udev event that reported the device; 0 when enumerated. */
+    qint64 udevEventNs = 0;
 
     QString displayName() const {
         if (!label.isEmpty()) {
@@ -77,6 +85,8 @@ struct DeviceInfo {
     }
 };
 
+/** One partition as DeviceMonitor last read it; immutable, so threads and signals share it. */
+using DeviceHandle = std::shared_ptr<const DeviceInfo>;
 
 enum class HashScope {
     Partition,
@@ -87,8 +97,15 @@ enum class HashScanMode {
     Full,
     QuickSample,
     WatchManifestOnly,
+    /** Full read, 64 MiB blocks hashed on several cores; same digest and checkpoints as Full. */
+    ParallelFull,
 };
 
+/** Modes that read every byte and share the "full" checkpoint / block tree. */
+inline bool hashScanModeReadsAll(HashScanMode m) {
+    return m == HashScanMode::Full || m == HashScanMode::ParallelFull;
+}
+
 inline QString hashScopeToString(HashScope s) {
     return s == HashScope::WholeDisk ? QStringLiteral("whole_disk") : QStringLiteral("partition");
 }
@@ -102,6 +119,7 @@ inline QString hashScanModeToString(HashScanMode m) {
     switch (m) {
         case HashScanMode::QuickSample: return QStringLiteral("quick");
         case HashScanMode::WatchManifestOnly: return QStringLiteral("watch");
+        case HashScanMode::ParallelFull: return QStringLiteral("parallel");
         case HashScanMode::Full:
         default: return QStringLiteral("full");
     }
@@ -110,6 +128,7 @@ inline QString hashScanModeToString(HashScanMode m) {
 inline HashScanMode hashScanModeFromString(const QString& s) {
     if (s == QLatin1String("quick")) return HashScanMode::QuickSample;
     if (s == QLatin1String("watch")) return HashScanMode::WatchManifestOnly;
+    if (s == QLatin1String("parallel")) return HashScanMode::ParallelFull;
     return HashScanMode::Full;
 }
 
@@ -134,11 +153,19 @@ inline VerificationProfile verificationProfileFromString(const QString& s) {
     return VerificationProfile::WatchManifest;
 }
 
-struct WatchFileEntry {
-    QString relativePath;
-    QString contentHash;
-    uint64_t sizeBytes = 0;
-    QDateTime modifiedUtc;
+/**
+ * How a watch-manifest verify picks the files it re-hashes. With @ref metadataFirst, files
+ * whose size, mtime, ctime and inode match the baseline keep their recorded hash; only
+ * changed, new and legacy (no recorded metadata) entries, plus a random @ref samplePercent
+ * of the rest, are read.
+ */
+struct ManifestVerifyPolicy {
+    bool metadataFirst = false;
+    int samplePercent = 5;
+    /** Stop hashing at the first differing file; the result then only answers match or not. */
+    bool failFast = false;
+    /** After a fail-fast mismatch, ManifestWorker runs the full diff for the report. */
+    bool failFastReport = true;
 };
 
 struct WatchGroup {
@@ -146,8 +173,13 @@ struct WatchGroup {
     QString name;
     QStringList watchPaths;
     QString merkleRoot;
-    QList<WatchFileEntry> files;
+    /** MerkleFormat and fan-out merkleRoot was built with; groups from before v2 read as 1 and 2. */
+    int merkleFormat = 1;
+    int merkleFanOut = 2;
+    WatchFileList files;
     QDateTime builtAt;
+    /** Files this large also get a chunk list; 0 = no chunking. */
+    uint64_t chunkThresholdBytes = 0;
 };
 
 struct WatchManifest {
@@ -155,6 +187,8 @@ struct WatchManifest {
     QList<WatchGroup> groups;
     QString manifestRoot;
     QDateTime updatedAt;
+    /** SHA-256 of the out-of-line file list (WatchManifestFile); groups then carry no files. */
+    QString filesSha256;
 
     bool hasBaseline() const {
         for (const WatchGroup& g : groups) {
@@ -172,7 +206,14 @@ struct WatchManifest {
             go["id"] = g.id;
             go["name"] = g.name;
             go["merkle_root"] = g.merkleRoot;
+            if (g.merkleFormat != 1) {
+                go["merkle_format"] = g.merkleFormat;
+                go["merkle_fan_out"] = g.merkleFanOut;
+            }
             go["built_at"] = g.builtAt.toString(Qt::ISODate);
+            if (g.chunkThresholdBytes > 0) {
+                go["chunk_threshold"] = static_cast<double>(g.chunkThresholdBytes);
+            }
             QJsonArray paths;
             for (const QString& p : g.watchPaths) paths.append(p);
             go["watch_paths"] = paths;
@@ -181,6 +222,23 @@ struct WatchManifest {
                 QJsonObject fo;
                 fo["path"] = f.relativePath;
                 fo["hash"] = f.contentHash;
+                if (f.hasMetadata()) {
+                    fo["size"] = static_cast<double>(f.sizeBytes);
+                    fo["mtime"] = f.modifiedUtc.toString(Qt::ISODateWithMs);
+                    fo["ctime"] = f.changedUtc.toString(Qt::ISODateWithMs);
+                    fo["inode"] = QString::number(f.inode);
+                }
+                if (!f.chunks.isEmpty()) {
+                    QJsonArray chunks;
+                    for (const WatchChunk& c : f.chunks) {
+                        QJsonObject co;
+                        co["offset"] = static_cast<double>(c.offset);
+                        co["length"] = static_cast<double>(c.length);
+                        co["hash"] = c.hash;
+                        chunks.append(co);
+                    }
+                    fo["chunks"] = chunks;
+                }
                 files.append(fo);
             }
             go["files"] = files;
@@ -189,6 +247,9 @@ struct WatchManifest {
         obj["groups"] = ga;
         obj["manifest_root"] = manifestRoot;
         obj["updated_at"] = updatedAt.toString(Qt::ISODate);
+        if (!filesSha256.isEmpty()) {
+            obj["files_sha256"] = filesSha256;
+        }
         return obj;
     }
 
@@ -197,13 +258,17 @@ struct WatchManifest {
         m.version = obj["version"].toString(QStringLiteral("1.0"));
         m.manifestRoot = obj["manifest_root"].toString();
         m.updatedAt = QDateTime::fromString(obj["updated_at"].toString(), Qt::ISODate);
+        m.filesSha256 = obj["files_sha256"].toString();
         for (const QJsonValue& gv : obj["groups"].toArray()) {
             QJsonObject go = gv.toObject();
             WatchGroup g;
             g.id = go["id"].toString();
             g.name = go["name"].toString();
             g.merkleRoot = go["merkle_root"].toString();
+            g.merkleFormat = go["merkle_format"].toInt(1);
+            g.merkleFanOut = go["merkle_fan_out"].toInt(2);
             g.builtAt = QDateTime::fromString(go["built_at"].toString(), Qt::ISODate);
+            g.chunkThresholdBytes = static_cast<uint64_t>(go["chunk_threshold"].toDouble());
             for (const QJsonValue& pv : go["watch_paths"].toArray()) {
                 g.watchPaths.append(pv.toString());
             }
@@ -212,6 +277,18 @@ struct WatchManifest {
                 WatchFileEntry f;
                 f.relativePath = fo["path"].toString();
                 f.contentHash = fo["hash"].toString();
+                f.sizeBytes = static_cast<uint64_t>(fo["size"].toDouble());
+                f.modifiedUtc = QDateTime::fromString(fo["mtime"].toString(), Qt::ISODateWithMs);
+                f.changedUtc = QDateTime::fromString(fo["ctime"].toString(), Qt::ISODateWithMs);
+                f.inode = fo["inode"].toString().toULongLong();
+                for (const QJsonValue& cv : fo["chunks"].toArray()) {
+                    const QJsonObject co = cv.toObject();
+                    WatchChunk c;
+                    c.offset = static_cast<uint64_t>(co["offset"].toDouble());
+                    c.length = static_cast<uint32_t>(co["length"].toDouble());
+                    c.hash = co["hash"].toString();
+                    f.chunks.append(c);
+                }
                 g.files.append(f);
             }
             m.groups.append(g);
@@ -229,8 +306,26 @@ struct ManifestVerifyResult {
     QStringList changedPaths;
     QStringList missingPaths;
     QStringList addedPaths;
+    /** Changed byte ranges of chunked files, "path: start-end" (inclusive). */
+    QStringList changedRanges;
     QString errorMessage;
+    /** False when fail-fast stopped early; the path lists then only hold what was seen. */
+    bool complete = true;
     uint64_t filesChecked = 0;
+    /** Files whose contents were read; the rest matched on metadata alone. */
+    uint64_t filesHashed = 0;
+    uint64_t durationMs = 0;
+};
+
+/** Several mounts verified against one watch manifest (ManifestWorker::startBatchVerify). */
+struct ManifestBatchVerifyResult {
+    /** One per device, in the order given; deviceNode is set on each. */
+    QVector<ManifestVerifyResult> results;
+    int matched = 0;
+    int mismatched = 0;
+    int failed = 0;
+    /** Differences every mismatched mount shares (two or more mismatches); see ManifestService. */
+    QStringList sharedDifferences;
     uint64_t durationMs = 0;
 };
 
@@ -273,6 +368,7 @@ struct HidDeviceInfo {
     QString usbPath;
     QString usbBus;
     QString usbPort;
+    QString usbDevNum;  // device address on usbBus, as usbmon reports it
     QString vendorId;
     QString productId;
     QString serial;
@@ -281,6 +377,7 @@ struct HidDeviceInfo {
     QString driver;
     QStringList capabilities;
     QList<HidInterfaceInfo> interfaces;
+    QByteArray descriptorFingerprint;  // HidDescriptorFingerprint; empty when not readable
     QDateTime seenAtUtc;
 
     QString displayName() const {
@@ -328,6 +425,7 @@ struct HidDeviceInfo {
         obj["usb_path"] = usbPath;
         obj["usb_bus"] = usbBus;
         obj["usb_port"] = usbPort;
+        obj["usb_devnum"] = usbDevNum;
         obj["vendor_id"] = vendorId;
         obj["product_id"] = productId;
         obj["serial"] = serial;
@@ -340,6 +438,9 @@ struct HidDeviceInfo {
         QJsonArray ifaces;
         for (const HidInterfaceInfo& iface : interfaces) ifaces.append(iface.toJson());
         obj["interfaces"] = ifaces;
+        if (!descriptorFingerprint.isEmpty()) {
+            obj["descriptor_fingerprint"] = QString::fromLatin1(descriptorFingerprint.toHex());
+        }
         obj["seen_at"] = seenAtUtc.toString(Qt::ISODate);
         return obj;
     }
@@ -351,6 +452,7 @@ struct HidDeviceInfo {
         info.usbPath = obj["usb_path"].toString();
         info.usbBus = obj["usb_bus"].toString();
         info.usbPort = obj["usb_port"].toString();
+        info.usbDevNum = obj["usb_devnum"].toString();
         info.vendorId = obj["vendor_id"].toString();
         info.productId = obj["product_id"].toString();
         info.serial = obj["serial"].toString();
@@ -365,6 +467,10 @@ struct HidDeviceInfo {
         for (const QJsonValue& val : obj["interfaces"].toArray()) {
             info.interfaces.append(HidInterfaceInfo::fromJson(val.toObject()));
         }
+        const QByteArray fingerprint = QByteArray::fromHex(obj["descriptor_fingerprint"].toString().toLatin1());
+        if (fingerprint.size() == 32) {  // SHA-256
+            info.descriptorFingerprint = fingerprint;
+        }
         info.seenAtUtc = QDateTime::fromString(obj["seen_at"].toString(), Qt::ISODate);
         return info;
     }
@@ -415,6 +521,7 @@ struct BadUsbAnomalyResult {
     HidDeviceInfo device;
     QStringList relatedStorageNodes;
     QDateTime detectedAtUtc;
+    QJsonObject captureSummary;  // UsbCaptureSummary::toJson() once the capture is decoded
 
     QJsonObject toJson() const {
         QJsonObject obj;
@@ -428,6 +535,9 @@ struct BadUsbAnomalyResult {
         for (const QString& node : relatedStorageNodes) storage.append(node);
         obj["related_storage_nodes"] = storage;
         obj["detected_at"] = detectedAtUtc.toString(Qt::ISODate);
+        if (!captureSummary.isEmpty()) {
+            obj["capture_summary"] = captureSummary;
+        }
         return obj;
     }
 };
@@ -497,6 +607,10 @@ struct IsoVerifyResult {
     IsoVerifySource source = IsoVerifySource::Unknown;
     QString computedSha256;
     QString expectedSha256;
+    /** Set instead of expectedSha256 when the source lists only SHA-512 or BLAKE2b-512. */
+    QString expectedDigestAlgorithm;
+    QString expectedDigest;
+    QString computedDigest;
     bool hashChecked = false;
     bool hashMatches = false;
     bool pgpChecked = false;
@@ -511,21 +625,233 @@ struct IsoVerifyResult {
     QString signatureUrl;
     QString keyserverUsed;
     bool remoteFetched = false;
+    /** Publisher checksums (and signature) came from the local artifact store, not the network. */
+    bool artifactsFromStore = false;
     QString layoutNote;
+    /** Why the file failed the catalog's size and edge-digest check (IsoPrescreen); no full hash was run. */
+    QString prescreenMismatch;
     QString reportSummary;
     bool success = false;
     QString errorMessage;
     uint64_t durationMs = 0;
 
+    bool hasExpectedHash() const { return !expectedSha256.isEmpty() || !expectedDigest.isEmpty(); }
+
     bool passed() const {
         if (!success) return false;
-        if (hashChecked && !expectedSha256.isEmpty() && !hashMatches) return false;
+        if (!prescreenMismatch.isEmpty()) return false;
+        if (hashChecked && hasExpectedHash() && !hashMatches) return false;
         if (pgpChecked && !pgpValid) return false;
         if (pgpChecked && !fingerprintTrusted) return false;
         return true;
     }
 };
 
+/**
+ * Rolling read-speed profile of one device, from its full-read hash jobs (see ReadHealth).
+ * A change of engine or elevation starts a new window, since speeds are only comparable
+ * within one configuration.
+ */
+struct ReadProfile {
+    static constexpr int kWindow = 8;
+
+    QString engine;
+    bool elevated = false;
+    QList<double> recentMBps;  // average speed of the last kWindow reads, oldest first
+    double worstBlockRatio = 0.0;  // slowest block against the median block since the window started
+    int anomalies = 0;             // findings since the profile started
+    QDateTime lastAnomaly;
+
+    bool isEmpty() const { return recentMBps.isEmpty(); }
+
+    QJsonObject toJson() const {
+        QJsonObject obj;
+        obj["engine"] = engine;
+        if (elevated) {
+            obj["elevated"] = true;
+        }
+        QJsonArray speeds;
+        for (double mbps : recentMBps) {
+            speeds.append(mbps);
+        }
+        obj["recent_mbps"] = speeds;
+        obj["worst_block_ratio"] = worstBlockRatio;
+        obj["anomalies"] = anomalies;
+        if (lastAnomaly.isValid()) {
+            obj["last_anomaly"] = lastAnomaly.toString(Qt::ISODate);
+        }
+        return obj;
+    }
+
+    static ReadProfile fromJson(const QJsonObject& obj) {
+        ReadProfile p;
+        p.engine = obj["engine"].toString();
+        p.elevated = obj["elevated"].toBool();
+        for (const QJsonValue& v : obj["recent_mbps"].toArray()) {
+            p.recentMBps.append(v.toDouble());
+        }
+        p.worstBlockRatio = obj["worst_block_ratio"].toDouble();
+        p.anomalies = obj["anomalies"].toInt();
+        p.lastAnomaly = QDateTime::fromString(obj["last_anomaly"].toString(), Qt::ISODate);
+        return p;
+    }
+};
+
+/**
+ * Outcome of a read-only capacity probe (CapacityProbe.h). realBytes is what the probe could
+ * confirm: the claimed size when nothing was wrong, else the wrap-around period or the first
+ * unreadable offset.
+ */
+struct CapacityCheck {
+    enum class Verdict { NoAliasing, Aliased, UnreadableBeyond, Inconclusive };
+
+    Verdict verdict = Verdict::Inconclusive;
+    uint64_t claimedBytes = 0;
+    uint64_t realBytes = 0;
+    uint64_t bytesRead = 0;
+    uint64_t durationMs = 0;
+    QString detail;
+    QDateTime probedAt;
+
+    bool isEmpty() const { return !probedAt.isValid(); }
+    bool isCounterfeit() const {
+        return verdict == Verdict::Aliased || verdict == Verdict::UnreadableBeyond;
+    }
+
+    static QString verdictName(Verdict v) {
+        switch (v) {
+            case Verdict::NoAliasing: return QStringLiteral("no_aliasing");
+            case Verdict::Aliased: return QStringLiteral("aliased");
+            case Verdict::UnreadableBeyond: return QStringLiteral("unreadable_beyond");
+            case Verdict::Inconclusive: return QStringLiteral("inconclusive");
+        }
+        return QStringLiteral("inconclusive");
+    }
+
+    static Verdict verdictFromName(const QString& name) {
+        if (name == QLatin1String("no_aliasing")) return Verdict::NoAliasing;
+        if (name == QLatin1String("aliased")) return Verdict::Aliased;
+        if (name == QLatin1String("unreadable_beyond")) return Verdict::UnreadableBeyond;
+        return Verdict::Inconclusive;
+    }
+
+    QJsonObject toJson() const {
+        QJsonObject obj;
+        obj["verdict"] = verdictName(verdict);
+        obj["claimed_bytes"] = static_cast<qint64>(claimedBytes);
+        obj["real_bytes"] = static_cast<qint64>(realBytes);
+        obj["bytes_read"] = static_cast<qint64>(bytesRead);
+        obj["duration_ms"] = static_cast<qint64>(durationMs);
+        obj["detail"] = detail;
+        obj["probed_at"] = probedAt.toString(Qt::ISODate);
+        return obj;
+    }
+
+    static CapacityCheck fromJson(const QJsonObject& obj) {
+        CapacityCheck c;
+        c.verdict = verdictFromName(obj["verdict"].toString());
+        c.claimedBytes = static_cast<uint64_t>(obj["claimed_bytes"].toInteger());
+        c.realBytes = static_cast<uint64_t>(obj["real_bytes"].toInteger());
+        c.bytesRead = static_cast<uint64_t>(obj["bytes_read"].toInteger());
+        c.durationMs = static_cast<uint64_t>(obj["duration_ms"].toInteger());
+        c.detail = obj["detail"].toString();
+        c.probedAt = QDateTime::fromString(obj["probed_at"].toString(), Qt::ISODate);
+        return c;
+    }
+};
+
+/**
+ * What a volume looks like from its first sectors (LayoutProbe.h): the partition table area
+ * and the file system's type, serial and size. Stable across mounts and writes; it changes
+ * when a stick is repartitioned, reformatted or re-imaged.
+ */
+struct LayoutFingerprint {
+    QString partitionTableSha256;
+    QString fsType;        // "fat", "exfat", "ext"; empty when not recognised
+    QString volumeSerial;  // FAT/exFAT serial number, ext UUID
+    uint64_t volumeBytes = 0;
+    QDateTime takenAt;
+
+    bool isEmpty() const { return !takenAt.isValid(); }
+
+    QJsonObject toJson() const {
+        QJsonObject obj;
+        obj["partition_table_sha256"] = partitionTableSha256;
+        obj["fs_type"] = fsType;
+        obj["volume_serial"] = volumeSerial;
+        obj["volume_bytes"] = static_cast<qint64>(volumeBytes);
+        obj["taken_at"] = takenAt.toString(Qt::ISODate);
+        return obj;
+    }
+
+    static LayoutFingerprint fromJson(const QJsonObject& obj) {
+        LayoutFingerprint f;
+        f.partitionTableSha256 = obj["partition_table_sha256"].toString();
+        f.fsType = obj["fs_type"].toString();
+        f.volumeSerial = obj["volume_serial"].toString();
+        f.volumeBytes = static_cast<uint64_t>(obj["volume_bytes"].toInteger());
+        f.takenAt = QDateTime::fromString(obj["taken_at"].toString(), Qt::ISODate);
+        return f;
+    }
+};
+
+/**
+ * State of a stick when FlashSpartan ejected it right after a passing verify (EjectSealProbe.h):
+ * the partition table, the file system's own change markers and a sampled digest. A
+ * reconnect that reads the same seal passes provisionally and is verified in full later.
+ */
+struct EjectSeal {
+    /** Baseline the verify before the eject matched; the seal is void once either changes. */
+    QString baselineHash;
+    QString manifestRoot;
+    QString partitionTableSha256;
+    QString fsType;        // "fat", "exfat", "ext"; empty when not recognised
+    QString volumeSerial;  // FAT/exFAT serial number, ext UUID
+    bool volumeDirty = false;
+    uint64_t writeCounter = 0;  // ext: s_kbytes_written
+    uint32_t mountCount = 0;    // ext: s_mnt_count
+    qint64 lastWriteTime = 0;   // ext: s_wtime
+    QString sampleSha256;
+    uint64_t volumeBytes = 0;
+    QDateTime sealedAt;
+
+    bool isEmpty() const { return !sealedAt.isValid(); }
+
+    QJsonObject toJson() const {
+        QJsonObject obj;
+        obj["baseline_hash"] = baselineHash;
+        obj["manifest_root"] = manifestRoot;
+        obj["partition_table_sha256"] = partitionTableSha256;
+        obj["fs_type"] = fsType;
+        obj["volume_serial"] = volumeSerial;
+        obj["volume_dirty"] = volumeDirty;
+        obj["write_counter"] = static_cast<qint64>(writeCounter);
+        obj["mount_count"] = static_cast<qint64>(mountCount);
+        obj["last_write_time"] = lastWriteTime;
+        obj["sample_sha256"] = sampleSha256;
+        obj["volume_bytes"] = static_cast<qint64>(volumeBytes);
+        obj["sealed_at"] = sealedAt.toString(Qt::ISODate);
+        return obj;
+    }
+
+    static EjectSeal fromJson(const QJsonObject& obj) {
+        EjectSeal s;
+        s.baselineHash = obj["baseline_hash"].toString();
+        s.manifestRoot = obj["manifest_root"].toString();
+        s.partitionTableSha256 = obj["partition_table_sha256"].toString();
+        s.fsType = obj["fs_type"].toString();
+        s.volumeSerial = obj["volume_serial"].toString();
+        s.volumeDirty = obj["volume_dirty"].toBool();
+        s.writeCounter = static_cast<uint64_t>(obj["write_counter"].toInteger());
+        s.mountCount = static_cast<uint32_t>(obj["mount_count"].toInteger());
+        s.lastWriteTime = obj["last_write_time"].toInteger();
+        s.sampleSha256 = obj["sample_sha256"].toString();
+        s.volumeBytes = static_cast<uint64_t>(obj["volume_bytes"].toInteger());
+        s.sealedAt = QDateTime::fromString(obj["sealed_at"].toString(), Qt::ISODate);
+        return s;
+    }
+};
+
 struct DeviceRecord {
     QString uniqueId;
     QString hash;
@@ -543,6 +869,37 @@ struct DeviceRecord {
     VerificationProfile verificationProfile = VerificationProfile::WatchManifest;
     WatchManifest watchManifest;
     QString lastManifestRoot;
+    /** Non-cryptographic XXH3-128 digest of the same target as @ref hash; cleared with it. */
+    QString prescreenHash;
+    QString prescreenAlgorithm;
+    /** Probed best read buffer; shared with other records of the same vendor/model. */
+    int tunedBufferSizeKB = 0;
+    /** Per-block digests behind @ref hash (chunked full reads only); cleared with it. */
+    QStringList blockHashes;
+    uint64_t blockSize = 0;
+    /**
+     * SHA-256 of the out-of-line block list (BlockHashFile); @ref blockHashes is then empty.
+     * Records of sticks cloned from one image share the file.
+     */
+    QString blockHashesSha256;
+    ReadProfile readProfile;
+    /** Last capacity probe of this device; empty until one ran. */
+    CapacityCheck capacityCheck;
+    /** Set by a clean eject after a passing verify; consumed by the next connect. */
+    EjectSeal ejectSeal;
+    /** Layout when the baseline was taken; checked on connect before anything mounts. */
+    LayoutFingerprint layoutFingerprint;
+    /**
+     * When trust level, auto-mount, notes or the verification profile last changed; stamped
+     * by the policy store, and what fleet replication orders those decisions by.
+     */
+    QDateTime policyChangedAt;
+
+    /** Whether the fields policyChangedAt covers are equal. */
+    bool samePolicyAs(const DeviceRecord& other) const {
+        return trustLevel == other.trustLevel && autoMount == other.autoMount
+               && notes == other.notes && verificationProfile == other.verificationProfile;
+    }
 
     QJsonObject toJson() const {
         QJsonObject obj;
@@ -562,6 +919,31 @@ struct DeviceRecord {
         obj["verification_profile"] = verificationProfileToString(verificationProfile);
         obj["watch_manifest"] = watchManifest.toJson();
         obj["last_manifest_root"] = lastManifestRoot;
+        obj["prescreen_hash"] = prescreenHash;
+        obj["prescreen_algorithm"] = prescreenAlgorithm;
+        obj["tuned_buffer_size_kb"] = tunedBufferSizeKB;
+        if (!blockHashesSha256.isEmpty()) {
+            obj["block_hashes_sha256"] = blockHashesSha256;
+            obj["block_size"] = static_cast<qint64>(blockSize);
+        } else if (!blockHashes.isEmpty()) {
+            obj["block_hashes"] = QJsonArray::fromStringList(blockHashes);
+            obj["block_size"] = static_cast<qint64>(blockSize);
+        }
+        if (!readProfile.isEmpty()) {
+            obj["read_profile"] = readProfile.toJson();
+        }
+        if (!capacityCheck.isEmpty()) {
+            obj["capacity_check"] = capacityCheck.toJson();
+        }
+        if (!ejectSeal.isEmpty()) {
+            obj["eject_seal"] = ejectSeal.toJson();
+        }
+        if (!layoutFingerprint.isEmpty()) {
+            obj["layout_fingerprint"] = layoutFingerprint.toJson();
+        }
+        if (policyChangedAt.isValid()) {
+            obj["policy_changed_at"] = policyChangedAt.toString(Qt::ISODateWithMs);
+        }
         return obj;
     }
 
@@ -584,10 +966,138 @@ struct DeviceRecord {
             obj["verification_profile"].toString());
         record.watchManifest = WatchManifest::fromJson(obj["watch_manifest"].toObject());
         record.lastManifestRoot = obj["last_manifest_root"].toString();
+        record.prescreenHash = obj["prescreen_hash"].toString();
+        record.prescreenAlgorithm = obj["prescreen_algorithm"].toString();
+        record.tunedBufferSizeKB = obj["tuned_buffer_size_kb"].toInt();
+        for (const QJsonValue& v : obj["block_hashes"].toArray()) {
+            record.blockHashes.append(v.toString());
+        }
+        record.blockSize = static_cast<uint64_t>(obj["block_size"].toInteger());
+        record.blockHashesSha256 = obj["block_hashes_sha256"].toString();
+        record.readProfile = ReadProfile::fromJson(obj["read_profile"].toObject());
+        record.capacityCheck = CapacityCheck::fromJson(obj["capacity_check"].toObject());
+        record.ejectSeal = EjectSeal::fromJson(obj["eject_seal"].toObject());
+        record.layoutFingerprint = LayoutFingerprint::fromJson(obj["layout_fingerprint"].toObject());
+        record.policyChangedAt =
+            QDateTime::fromString(obj["policy_changed_at"].toString(), Qt::ISODateWithMs);
         return record;
     }
 };
 
+/**
+ * How one hash job ran, kept with its history entry so that slowing sticks and misconfigured
+ * hosts show up over time. ioWaitMs and cpuMs are summed over every reader and hasher
+ * thread, so with parallel reads they can exceed the job's duration; paths that cannot tell
+ * the two apart (mmap faults happen inside the digest) leave ioWaitMs at 0.
+ */
+struct HashPerformance {
+    QString engine;        // read, pipelined, mmap, io_uring, overlapped, chunked, parallel, quick_sample
+    bool elevated = false;  // read through the polkit / UAC helper
+    int bufferSizeKB = 0;
+    int queueDepth = 0;     // reads in flight, pipeline buffers or parallel readers; 1 = one at a time
+    double avgMBps = 0.0;
+    double minMBps = 0.0;   // slowest one-second window; 0 for jobs shorter than that
+    uint64_t ioWaitMs = 0;  // blocked in read calls
+    uint64_t cpuMs = 0;     // in digest updates
+    int readRetries = 0;    // reads issued again after EINTR or a short read
+    // Chunked engines only: read and digest time per block; slowestBlock is -1 otherwise
+    uint64_t blockMsMedian = 0;
+    uint64_t blockMsMax = 0;
+    qint64 slowestBlock = -1;
+    int timedBlocks = 0;
+
+    bool isEmpty() const { return engine.isEmpty(); }
+
+    QJsonObject toJson() const {
+        QJsonObject obj;
+        obj["engine"] = engine;
+        if (elevated) {
+            obj["elevated"] = true;
+        }
+        obj["buffer_kb"] = bufferSizeKB;
+        obj["queue_depth"] = queueDepth;
+        obj["avg_mbps"] = avgMBps;
+        obj["min_mbps"] = minMBps;
+        obj["io_wait_ms"] = static_cast<qint64>(ioWaitMs);
+        obj["cpu_ms"] = static_cast<qint64>(cpuMs);
+        obj["read_retries"] = readRetries;
+        if (slowestBlock >= 0) {
+            obj["block_ms_median"] = static_cast<qint64>(blockMsMedian);
+            obj["block_ms_max"] = static_cast<qint64>(blockMsMax);
+            obj["slowest_block"] = slowestBlock;
+            obj["timed_blocks"] = timedBlocks;
+        }
+        return obj;
+    }
+
+    static HashPerformance fromJson(const QJsonObject& obj) {
+        HashPerformance p;
+        p.engine = obj["engine"].toString();
+        p.elevated = obj["elevated"].toBool();
+        p.bufferSizeKB = obj["buffer_kb"].toInt();
+        p.queueDepth = obj["queue_depth"].toInt();
+        p.avgMBps = obj["avg_mbps"].toDouble();
+        p.minMBps = obj["min_mbps"].toDouble();
+        p.ioWaitMs = static_cast<uint64_t>(obj["io_wait_ms"].toInteger());
+        p.cpuMs = static_cast<uint64_t>(obj["cpu_ms"].toInteger());
+        p.readRetries = obj["read_retries"].toInt();
+        p.blockMsMedian = static_cast<uint64_t>(obj["block_ms_median"].toInteger());
+        p.blockMsMax = static_cast<uint64_t>(obj["block_ms_max"].toInteger());
+        p.slowestBlock = obj["slowest_block"].toInteger(-1);
+        p.timedBlocks = obj["timed_blocks"].toInt();
+        return p;
+    }
+
+    /** One line for tooltips, e.g. "io_uring, 1024 KB ×8 · 38.2 MB/s avg, 12.0 min · I/O 61 %". */
+    QString summary() const {
+        if (isEmpty()) {
+            return {};
+        }
+        QString line = engine + (elevated ? QStringLiteral(" (elevated)") : QString());
+        if (bufferSizeKB > 0) {
+            line += QStringLiteral(", %1 KB").arg(bufferSizeKB);
+        }
+        if (queueDepth > 1) {
+            line += QStringLiteral(" ×%1").arg(queueDepth);
+        }
+        line += QStringLiteral(" · %1 MB/s avg").arg(avgMBps, 0, 'f', 1);
+        if (minMBps > 0.0) {
+            line += QStringLiteral(", %1 min").arg(minMBps, 0, 'f', 1);
+        }
+        if (ioWaitMs + cpuMs > 0) {
+            line += QStringLiteral(" · I/O %1 %")
+                        .arg(qRound(100.0 * static_cast<double>(ioWaitMs) / static_cast<double>(ioWaitMs + cpuMs)));
+        }
+        if (readRetries > 0) {
+            line += readRetries == 1 ? QStringLiteral(" · 1 read retry")
+                                     : QStringLiteral(" · %1 read retries").arg(readRetries);
+        }
+        if (slowestBlock >= 0) {
+            line += QStringLiteral(" · blocks %1 ms median, %2 ms max (#%3)")
+                        .arg(blockMsMedian)
+                        .arg(blockMsMax)
+                        .arg(slowestBlock);
+        }
+        return line;
+    }
+};
+
+/** Whole-disk reads: the partition table area or one partition, hashed from the same read. */
+struct RegionHash {
+    QString name;  // "table", or the partition's device node
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    QString hash;
+};
+
+/** Bad-sector-tolerant reads: a range that could not be read, hashed as zeros. */
+struct UnreadableRange {
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    /** The read did not finish within the timeout, as opposed to failing with an error. */
+    bool timedOut = false;
+};
+
 struct HashResult {
     QString deviceNode;
     QString hash;
@@ -599,6 +1109,34 @@ struct HashResult {
     QString hashScopeLabel;
     QString scanModeLabel;
     bool resumedFromCheckpoint = false;
+    /**
+     * The resume checkpoint's first or last block no longer read the same, so it was
+     * dropped and the hash started from the beginning.
+     */
+    bool checkpointRejected = false;
+    /** Pipelined read loop only: reader blocked on hasher / hasher blocked on reader. */
+    uint64_t readStallMs = 0;
+    uint64_t hashStallMs = 0;
+    /** Buffer size picked by a probe run before this hash; 0 when no probe ran. */
+    int tunedBufferSizeKB = 0;
+    /** Chunked full reads: per-block digests folded into @ref hash. */
+    QStringList blockHashes;
+    uint64_t blockSize = 0;
+    /**
+     * Stop-at-first-change verify: index of the block that differed from the baseline.
+     * The read ended there, so @ref hash is empty and blockHashes end at that block.
+     */
+    qint64 stoppedAtBlock = -1;
+    HashPerformance performance;
+    /** Capacity probe run before this hash; empty when none ran. */
+    CapacityCheck capacityCheck;
+    /** Options::regions of a completed chunked full read, in the order given. */
+    QList<RegionHash> regionHashes;
+    /**
+     * Options::tolerateReadErrors: ranges hashed as zeros because they could not be read, in
+     * offset order. Non-empty means @ref hash is not a digest of what the device holds.
+     */
+    QList<UnreadableRange> unreadableRanges;
 
     double speedMBps() const {
         if (durationMs == 0) return 0.0;
@@ -637,6 +1175,10 @@ struct AppSettings {
     bool showNotifications = true;
     bool autoHashOnConnect = false;
     bool autoHashOnEject = true;
+    /** Seal verified sticks on eject; a matching seal makes the next connect's verify deferred. */
+    bool ejectSeal = true;
+    /** Prefetch a mounted stick's watched files while its verify has not started. */
+    bool speculativePrefetch = true;
     bool requireConfirmationForNew = true;
     bool requireConfirmationForModified = true;
     bool blockModifiedDevices = false;
@@ -645,8 +1187,27 @@ struct AppSettings {
     QString hashScope;
     QString hashScanMode;
     int hashBufferSizeKB = 1024;
+    /** Probe buffer sizes once per drive model and reuse the winner instead of hashBufferSizeKB. */
+    bool hashBufferAutoTune = false;
+    /** Probe new devices for counterfeit capacity (aliased or unreadable high addresses) before hashing. */
+    bool hashCapacityProbe = false;
+    /** Full reads short-cut all-zero blocks and filesystem holes; the digest is unchanged. */
+    bool hashSkipZeroRegions = false;
+    /** Keep one authenticated pkexec helper for several elevated hashes (Linux). */
+    bool hashHelperSession = false;
     bool useMemoryMapping = true;
+    /** "default" (mmap/read) or "io_uring" (Linux, falls back when unavailable). */
+    QString hashIoEngine = QStringLiteral("default");
+    int hashIoQueueDepth = 4;
+    /** Huge pages for large read buffers: "off", "transparent" or "explicit" (Linux). */
+    QString hashHugePages = QStringLiteral("off");
     int maxConcurrentHashes = 1;
+    /** Cap shared by background reads (full hashes, auto ISO verify) in MB/s; 0 = none. */
+    int backgroundIoLimitMBps = 0;
+    /** Hold background reads while the machine runs on battery. */
+    bool pauseBackgroundOnBattery = true;
+    /** Resident set the app keeps its caches under, in MiB; 0 = none (memory pressure is still answered). */
+    int memoryBudgetMiB = 0;
     QString theme = "dark";
     bool animationsEnabled = true;
     int fontSizePt = 10;
@@ -663,10 +1224,40 @@ struct AppSettings {
     HashScanMode defaultHashScanMode = HashScanMode::Full;
     bool hashResumeCheckpoints = true;
     bool promptHashOptionsOnManual = true;
+    /** Re-verify with XXH3-128 first; only a pre-screen mismatch pays for the crypto digest. */
+    bool hashPrescreenXxh3 = false;
+    /** Re-verify against stored block digests and stop reading at the first changed block. */
+    bool hashStopAtFirstChange = false;
+    /** QuickSample layout for new baselines; verifies reuse the layout in the stored label. */
+    int hashQuickSamples = 15;
+    int hashQuickSampleKB = 1024;
+    bool hashQuickSampleMetadata = false;
+    /** Watch-manifest verify policy per profile; Hybrid follows up with a full hash anyway. */
+    ManifestVerifyPolicy watchManifestVerifyPolicy;
+    ManifestVerifyPolicy hybridManifestVerifyPolicy{true, 0};
+    /** Journal watch paths of mounted drives (inotify) so verifies re-hash only touched files. */
+    bool watchChangeJournal = false;
+    /** Decide on the first differing file; the full diff follows in the background if asked. */
+    bool watchFailFast = false;
+    bool watchFailFastReport = true;
+    /** New baselines keep content-defined chunk lists for large files, to locate changes. */
+    bool watchChunkLargeFiles = false;
+
+    ManifestVerifyPolicy manifestVerifyPolicy(VerificationProfile profile) const {
+        ManifestVerifyPolicy policy = profile == VerificationProfile::Hybrid ? hybridManifestVerifyPolicy
+                                                                             : watchManifestVerifyPolicy;
+        policy.failFast = watchFailFast;
+        policy.failFastReport = watchFailFastReport;
+        return policy;
+    }
     bool blockMountOnIsoVerifyFailure = false;
     bool isoVerifyDecompressed = false;
     bool isoPreferOfflineSidecars = false;
+    QString isoReadCache = QStringLiteral("page-cache");  // "page-cache", "drop-behind", "direct"
+    bool isoVerifyDdImages = false;
     int isoVerifyParallel = 2;
+    /** LAN mirror for publisher checksums and signatures (IsoVerifyOptions::mirrorUrl). */
+    QString isoMirrorUrl;
     bool showFirstRunWizard = true;
     QString settingsProfile = QStringLiteral("default");
     bool badUsbEnabled = true;
@@ -674,13 +1265,27 @@ struct AppSettings {
     bool badUsbAlertCompositeStorage = true;
     bool badUsbAlertInterfaceDrift = true;
     bool badUsbAlertRapidReconnect = true;
+    /** Linux: watch keyboards' typing rate on the native usbmon feed. */
+    bool badUsbAlertKeystrokeRate = true;
     bool badUsbAutoBaselineTrusted = false;
     bool badUsbConfirmAnomalies = true;
     bool badUsbUsbmonEnabled = false;
     bool badUsbUsbmonOnAnomalyOnly = true;
     QString badUsbUsbmonCommand =
         QStringLiteral("tcpdump -i usbmon{bus} -w {out} -G 30 -W 1");
+    /** Linux: seconds of usbmon history kept in memory for each capture; 0 = use the command. */
+    int badUsbUsbmonPreTriggerSeconds = 10;
+    /** Capture only the suspect device's traffic (usbmon ring / USBPcap --devices), not its bus. */
+    bool badUsbUsbmonSuspectOnly = true;
+    /** Attach the background summary of each finished capture to the alert and the audit log. */
+    bool badUsbUsbmonSummarize = true;
+    /** badusb-captures retention: total size, age and zstd/gzip compression of finished captures. */
+    int badUsbCaptureQuotaMiB = 512;  // 0 = no quota
+    int badUsbCaptureMaxAgeDays = 30;  // 0 = keep forever
+    bool badUsbCaptureCompress = true;
     int recentEventsLimit = 100;
+    /** Lines kept by the sidebar activity log ring; the oldest drop off. */
+    int activityLogLines = 5000;
     /** 0 = retain all device history entries. */
     int deviceHistoryRetentionDays = 0;
     int deviceHistoryMaxEntries = 500;
@@ -700,14 +1305,26 @@ struct AppSettings {
         obj["show_notifications"] = showNotifications;
         obj["auto_hash_on_connect"] = autoHashOnConnect;
         obj["auto_hash_on_eject"] = autoHashOnEject;
+        obj["eject_seal"] = ejectSeal;
+        obj["speculative_prefetch"] = speculativePrefetch;
         obj["require_confirmation_new"] = requireConfirmationForNew;
         obj["require_confirmation_modified"] = requireConfirmationForModified;
         obj["block_modified_devices"] = blockModifiedDevices;
         obj["default_trust_level"] = defaultTrustLevel;
         obj["hash_algorithm"] = hashAlgorithm;
         obj["hash_buffer_size_kb"] = hashBufferSizeKB;
+        obj["hash_buffer_auto_tune"] = hashBufferAutoTune;
+        obj["hash_capacity_probe"] = hashCapacityProbe;
+        obj["hash_skip_zero_regions"] = hashSkipZeroRegions;
+        obj["hash_helper_session"] = hashHelperSession;
         obj["use_memory_mapping"] = useMemoryMapping;
+        obj["hash_io_engine"] = hashIoEngine;
+        obj["hash_io_queue_depth"] = hashIoQueueDepth;
+        obj["hash_huge_pages"] = hashHugePages;
         obj["max_concurrent_hashes"] = maxConcurrentHashes;
+        obj["background_io_limit_mbps"] = backgroundIoLimitMBps;
+        obj["pause_background_on_battery"] = pauseBackgroundOnBattery;
+        obj["memory_budget_mib"] = memoryBudgetMiB;
         obj["theme"] = theme;
         obj["animations_enabled"] = animationsEnabled;
         obj["font_size_pt"] = fontSizePt;
@@ -722,7 +1339,10 @@ struct AppSettings {
         obj["block_mount_on_iso_failure"] = blockMountOnIsoVerifyFailure;
         obj["iso_verify_decompressed"] = isoVerifyDecompressed;
         obj["iso_prefer_offline_sidecars"] = isoPreferOfflineSidecars;
+        obj["iso_read_cache"] = isoReadCache;
+        obj["iso_verify_dd_images"] = isoVerifyDdImages;
         obj["iso_verify_parallel"] = isoVerifyParallel;
+        obj["iso_mirror_url"] = isoMirrorUrl;
         obj["show_first_run_wizard"] = showFirstRunWizard;
         obj["settings_profile"] = settingsProfile;
         obj["badusb_enabled"] = badUsbEnabled;
@@ -730,12 +1350,20 @@ struct AppSettings {
         obj["badusb_alert_composite_storage"] = badUsbAlertCompositeStorage;
         obj["badusb_alert_interface_drift"] = badUsbAlertInterfaceDrift;
         obj["badusb_alert_rapid_reconnect"] = badUsbAlertRapidReconnect;
+        obj["badusb_alert_keystroke_rate"] = badUsbAlertKeystrokeRate;
         obj["badusb_auto_baseline_trusted"] = badUsbAutoBaselineTrusted;
         obj["badusb_confirm_anomalies"] = badUsbConfirmAnomalies;
         obj["badusb_usbmon_enabled"] = badUsbUsbmonEnabled;
         obj["badusb_usbmon_on_anomaly_only"] = badUsbUsbmonOnAnomalyOnly;
         obj["badusb_usbmon_command"] = badUsbUsbmonCommand;
+        obj["badusb_usbmon_pre_trigger_seconds"] = badUsbUsbmonPreTriggerSeconds;
+        obj["badusb_usbmon_suspect_only"] = badUsbUsbmonSuspectOnly;
+        obj["badusb_usbmon_summarize"] = badUsbUsbmonSummarize;
+        obj["badusb_capture_quota_mib"] = badUsbCaptureQuotaMiB;
+        obj["badusb_capture_max_age_days"] = badUsbCaptureMaxAgeDays;
+        obj["badusb_capture_compress"] = badUsbCaptureCompress;
         obj["recent_events_limit"] = recentEventsLimit;
+        obj["activity_log_lines"] = activityLogLines;
         obj["device_history_retention_days"] = deviceHistoryRetentionDays;
         obj["device_history_max_entries"] = deviceHistoryMaxEntries;
         obj["allowed_count_mode"] = allowedCountModeToString(allowedCountMode);
@@ -753,14 +1381,26 @@ struct AppSettings {
         settings.showNotifications = obj["show_notifications"].toBool(true);
         settings.autoHashOnConnect = obj["auto_hash_on_connect"].toBool(false);
         settings.autoHashOnEject = obj["auto_hash_on_eject"].toBool(true);
+        settings.ejectSeal = obj["eject_seal"].toBool(true);
+        settings.speculativePrefetch = obj["speculative_prefetch"].toBool(true);
         settings.requireConfirmationForNew = obj["require_confirmation_new"].toBool(true);
         settings.requireConfirmationForModified = obj["require_confirmation_modified"].toBool(true);
         settings.blockModifiedDevices = obj["block_modified_devices"].toBool(false);
         settings.defaultTrustLevel = obj["default_trust_level"].toInt(0);
         settings.hashAlgorithm = obj["hash_algorithm"].toString("SHA256");
         settings.hashBufferSizeKB = obj["hash_buffer_size_kb"].toInt(1024);
+        settings.hashBufferAutoTune = obj["hash_buffer_auto_tune"].toBool(false);
+        settings.hashCapacityProbe = obj["hash_capacity_probe"].toBool(false);
+        settings.hashSkipZeroRegions = obj["hash_skip_zero_regions"].toBool(false);
+        settings.hashHelperSession = obj["hash_helper_session"].toBool(false);
         settings.useMemoryMapping = obj["use_memory_mapping"].toBool(true);
+        settings.hashIoEngine = obj["hash_io_engine"].toString(QStringLiteral("default"));
+        settings.hashIoQueueDepth = obj["hash_io_queue_depth"].toInt(4);
+        settings.hashHugePages = obj["hash_huge_pages"].toString(QStringLiteral("off"));
         settings.maxConcurrentHashes = obj["max_concurrent_hashes"].toInt(1);
+        settings.backgroundIoLimitMBps = obj["background_io_limit_mbps"].toInt(0);
+        settings.pauseBackgroundOnBattery = obj["pause_background_on_battery"].toBool(true);
+        settings.memoryBudgetMiB = obj["memory_budget_mib"].toInt(0);
         settings.theme = obj["theme"].toString("dark");
         settings.animationsEnabled = obj["animations_enabled"].toBool(true);
         settings.fontSizePt = obj["font_size_pt"].toInt(10);
@@ -776,7 +1416,10 @@ struct AppSettings {
         settings.blockMountOnIsoVerifyFailure = obj["block_mount_on_iso_failure"].toBool(false);
         settings.isoVerifyDecompressed = obj["iso_verify_decompressed"].toBool(false);
         settings.isoPreferOfflineSidecars = obj["iso_prefer_offline_sidecars"].toBool(false);
+        settings.isoReadCache = obj["iso_read_cache"].toString(QStringLiteral("page-cache"));
+        settings.isoVerifyDdImages = obj["iso_verify_dd_images"].toBool(false);
         settings.isoVerifyParallel = obj["iso_verify_parallel"].toInt(2);
+        settings.isoMirrorUrl = obj["iso_mirror_url"].toString();
         settings.showFirstRunWizard = obj["show_first_run_wizard"].toBool(true);
         {
             QString profile = obj["settings_profile"].toString(QStringLiteral("default"));
@@ -790,13 +1433,21 @@ struct AppSettings {
         settings.badUsbAlertCompositeStorage = obj["badusb_alert_composite_storage"].toBool(true);
         settings.badUsbAlertInterfaceDrift = obj["badusb_alert_interface_drift"].toBool(true);
         settings.badUsbAlertRapidReconnect = obj["badusb_alert_rapid_reconnect"].toBool(true);
+        settings.badUsbAlertKeystrokeRate = obj["badusb_alert_keystroke_rate"].toBool(true);
         settings.badUsbAutoBaselineTrusted = obj["badusb_auto_baseline_trusted"].toBool(false);
         settings.badUsbConfirmAnomalies = obj["badusb_confirm_anomalies"].toBool(true);
         settings.badUsbUsbmonEnabled = obj["badusb_usbmon_enabled"].toBool(false);
         settings.badUsbUsbmonOnAnomalyOnly = obj["badusb_usbmon_on_anomaly_only"].toBool(true);
         settings.badUsbUsbmonCommand = obj["badusb_usbmon_command"].toString(
             QStringLiteral("tcpdump -i usbmon{bus} -w {out} -G 30 -W 1"));
+        settings.badUsbUsbmonPreTriggerSeconds = obj["badusb_usbmon_pre_trigger_seconds"].toInt(10);
+        settings.badUsbUsbmonSuspectOnly = obj["badusb_usbmon_suspect_only"].toBool(true);
+        settings.badUsbUsbmonSummarize = obj["badusb_usbmon_summarize"].toBool(true);
+        settings.badUsbCaptureQuotaMiB = obj["badusb_capture_quota_mib"].toInt(512);
+        settings.badUsbCaptureMaxAgeDays = obj["badusb_capture_max_age_days"].toInt(30);
+        settings.badUsbCaptureCompress = obj["badusb_capture_compress"].toBool(true);
         settings.recentEventsLimit = obj["recent_events_limit"].toInt(100);
+        settings.activityLogLines = obj["activity_log_lines"].toInt(5000);
         settings.deviceHistoryRetentionDays = obj["device_history_retention_days"].toInt(0);
         settings.deviceHistoryMaxEntries = obj["device_history_max_entries"].toInt(500);
         settings.allowedCountMode =
@@ -841,10 +1492,12 @@ struct LogEntry {
 } // namespace FlashSpartan
 
 Q_DECLARE_METATYPE(FlashSpartan::DeviceInfo)
+Q_DECLARE_METATYPE(FlashSpartan::DeviceHandle)
 Q_DECLARE_METATYPE(FlashSpartan::DeviceRecord)
 Q_DECLARE_METATYPE(FlashSpartan::HashResult)
 Q_DECLARE_METATYPE(FlashSpartan::VerificationStatus)
 Q_DECLARE_METATYPE(FlashSpartan::ManifestVerifyResult)
+Q_DECLARE_METATYPE(FlashSpartan::ManifestBatchVerifyResult)
 Q_DECLARE_METATYPE(FlashSpartan::WatchManifest)
 Q_DECLARE_METATYPE(FlashSpartan::IsoVerifyResult)
 Q_DECLARE_METATYPE(FlashSpartan::HidDeviceInfo)
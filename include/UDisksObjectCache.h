@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+#include <QVariantMap>
+
+namespace FlashSpartan {
+
+/**
+ * Local copy of the UDisks2 object tree (Linux), so MountManager answers block, file system
+ * and drive lookups without a D-Bus round-trip each. Filled from one
+ * org.freedesktop.DBus.ObjectManager.GetManagedObjects reply and kept current from
+ * InterfacesAdded, InterfacesRemoved and PropertiesChanged; MountManager does the D-Bus side
+ * and hands over plain values here (byte strings as QByteArray, "aay" as QByteArrayList,
+ * object paths as QString). Thread-safe.
+ */
+class UDisksObjectCache {
+public:
+    /** Properties by interface name, e.g. "org.freedesktop.UDisks2.Block". */
+    using Interfaces = QHash<QString, QVariantMap>;
+
+    static constexpr const char* kBlockInterface = "org.freedesktop.UDisks2.Block";
+    static constexpr const char* kFilesystemInterface = "org.freedesktop.UDisks2.Filesystem";
+    static constexpr const char* kLoopInterface = "org.freedesktop.UDisks2.Loop";
+    static constexpr const char* kDriveInterface = "org.freedesktop.UDisks2.Drive";
+    static constexpr const char* kManagerInterface = "org.freedesktop.UDisks2.Manager";
+
+    /** Replaces everything with a GetManagedObjects result (object path -> interfaces). */
+    void reset(const QHash<QString, Interfaces>& objects);
+    /** Forgets everything, e.g. when UDisks2 leaves the bus. */
+    void clear();
+    /** True once reset() ran and no clear() since: lookups are authoritative. */
+    bool isLoaded() const;
+
+    void addInterfaces(const QString& objectPath, const Interfaces& interfaces);
+    void removeInterfaces(const QString& objectPath, const QStringList& interfaces);
+    /** Ignored for interfaces the object does not have (InterfacesAdded will bring them). */
+    void changeProperties(const QString& objectPath, const QString& interface, const QVariantMap& changed,
+                          const QStringList& invalidated);
+
+    /**
+     * The block object whose Device, PreferredDevice or one of whose Symlinks is
+     * @p deviceNode (so /dev/disk/by-id paths resolve too); empty when there is none.
+     */
+    QString blockObjectPath(const QString& deviceNode) const;
+
+    bool hasInterface(const QString& objectPath, const QString& interface) const;
+    /** Invalid when the object, interface or property is unknown. */
+    QVariant property(const QString& objectPath, const QString& interface, const QString& name) const;
+
+    /** Block.IdType of @p deviceNode ("vfat", "ext4", ...); empty when unknown. */
+    QString filesystemType(const QString& deviceNode) const;
+    /** Block.Drive of @p deviceNode; empty when unknown or "/" (no drive). */
+    QString driveObjectPath(const QString& deviceNode) const;
+    /** Filesystem.MountPoints of @p deviceNode, as UDisks2 sees them. */
+    QStringList mountPoints(const QString& deviceNode) const;
+    bool hasFilesystem(const QString& deviceNode) const;
+    bool isLoop(const QString& deviceNode) const;
+    /** Manager.Version, from the Manager object the tree includes. */
+    QString version() const;
+
+    /** A NUL-terminated "ay" byte string, as UDisks2 sends device paths. */
+    static QString byteString(const QVariant& value);
+    /** An "aay" list of NUL-terminated byte strings. */
+    static QStringList byteStringList(const QVariant& value);
+    /** An "o" value; "/" (no object) and invalid values are empty. */
+    static QString objectPath(const QVariant& value);
+
+private:
+    QVariant propertyLocked(const QString& objectPath, const QString& interface, const QString& name) const;
+    void indexLocked(const QString& objectPath);
+    void unindexLocked(const QString& objectPath);
+
+    mutable QMutex m_mutex;
+    QHash<QString, Interfaces> m_objects;
+    QHash<QString, QString> m_blockByDevice;  // device node or symlink -> block object path
+    QHash<QString, QStringList> m_devicesByBlock;  // block object path -> its keys above
+    bool m_loaded = false;
+};
+
+} // namespace FlashSpartan
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+
+#include <atomic>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+struct udev_device;
+
+namespace FlashSpartan {
+
+/**
+ * One udev device as a monitor saw it, with what DeviceMonitor and HidDeviceMonitor read
+ * from it: the identity strings, every property, the sysfs attributes in kRecordedSysAttrs
+ * (raw, as sysfs returns them) and the nearest usb_device, usb_interface and block disk
+ * ancestors. The monitors' filter and extraction run on a record the same as on a live
+ * udev_device, through the UdevText overloads below.
+ */
+struct UdevRecord {
+    QByteArray action;
+    QByteArray sysPath;
+    QByteArray sysName;
+    QByteArray devNode;
+    QByteArray subsystem;
+    QByteArray devType;
+    QByteArray driver;
+    quint64 devnum = 0;
+    QHash<QByteArray, QByteArray> properties;
+    QHash<QByteArray, QByteArray> sysAttrs;
+    /** HidDescriptorFingerprint of a usb_device, read when it was recorded. */
+    QByteArray descriptorFingerprint;
+    /** Nearest first; the ancestors carry no parents or properties of their own. */
+    std::vector<UdevRecord> parents;
+
+    static const char* const kRecordedSysAttrs[];
+
+    /** The nearest ancestor of @p subsystem and @p devtype, as udev_device_get_parent_with_subsystem_devtype. */
+    const UdevRecord* parent(const char* subsystem, const char* devtype) const;
+
+    QJsonObject toJson() const;
+    static UdevRecord fromJson(const QJsonObject& object);
+};
+
+/**
+ * Recording of the raw udev streams of DeviceMonitor ("block") and HidDeviceMonitor
+ * ("input"), and their replay without hardware.
+ *
+ * A trace is JSON lines: a header with kFormat, then one line per event with its offset
+ * from the first event and the UdevRecord. Recording is off unless startRecording() was
+ * called (--record-udev); a monitor then pays one relaxed load per event. Replay feeds the
+ * events through a caller's function at 1×–1000× the recorded pace, or as fast as possible,
+ * so a connect storm can be reproduced and its processing timed (bench_udev_replay).
+ */
+class UdevEventTrace {
+public:
+    static constexpr const char* kFormat = "flashspartan.udev-trace/1";
+    static constexpr double kMaxSpeed = 1000.0;
+
+    struct Event {
+        qint64 offsetUs = 0;
+        QByteArray source;  // "block" or "input"
+        UdevRecord device;
+    };
+
+    struct ReplayStats {
+        int delivered = 0;
+        qint64 wallNs = 0;
+        /** Latest an event was delivered after it was due; how far processing fell behind. */
+        qint64 maxLagUs = 0;
+    };
+
+    static bool startRecording(const QString& path, QString* error = nullptr);
+    static void stopRecording();
+    static bool recording() { return s_recording.load(std::memory_order_relaxed); }
+    /** Appends @p dev, as the monitor for @p source received it. Linux only. */
+    static void record(const char* source, struct udev_device* dev);
+
+    static bool save(const QString& path, const QList<Event>& events, QString* error = nullptr);
+    static QList<Event> load(const QString& path, QString* error = nullptr);
+
+    /**
+     * Calls @p deliver for each event when it is due at @p speed times the recorded pace
+     * (clamped to kMaxSpeed; 0 delivers back to back), running the caller's event loop in
+     * between so the monitors' debounce timers fire. Returns when the last one is delivered.
+     */
+    static ReplayStats replay(const QList<Event>& events, double speed,
+                              const std::function<void(const Event&)>& deliver);
+
+private:
+    static inline std::atomic<bool> s_recording{false};
+};
+
+namespace UdevText {
+
+/** UdevRecord counterparts of the libudev accessors in UdevText.h. */
+
+inline std::string_view view(const QByteArray& value)
+{
+    return std::string_view(value.constData(), size_t(value.size()));
+}
+
+inline std::string_view property(const UdevRecord* dev, const char* key)
+{
+    return view(dev->properties.value(QByteArray::fromRawData(key, qsizetype(qstrlen(key)))));
+}
+
+/** Trimmed, as the live sysAttr(). */
+inline std::string_view sysAttr(const UdevRecord* dev, const char* key)
+{
+    const auto it = dev->sysAttrs.constFind(QByteArray::fromRawData(key, qsizetype(qstrlen(key))));
+    if (it == dev->sysAttrs.constEnd()) {
+        return {};
+    }
+    constexpr std::string_view kSpace = " \t\n\r\f\v";
+    const std::string_view value = view(*it);
+    const std::size_t first = value.find_first_not_of(kSpace);
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    return value.substr(first, value.find_last_not_of(kSpace) - first + 1);
+}
+
+inline std::string_view action(const UdevRecord* dev) { return view(dev->action); }
+inline std::string_view sysPath(const UdevRecord* dev) { return view(dev->sysPath); }
+inline std::string_view sysName(const UdevRecord* dev) { return view(dev->sysName); }
+inline std::string_view devNode(const UdevRecord* dev) { return view(dev->devNode); }
+inline std::string_view devType(const UdevRecord* dev) { return view(dev->devType); }
+inline std::string_view driver(const UdevRecord* dev) { return view(dev->driver); }
+inline quint64 devnum(const UdevRecord* dev) { return dev->devnum; }
+
+inline const UdevRecord* parent(const UdevRecord* dev, const char* subsystem, const char* devtype)
+{
+    return dev->parent(subsystem, devtype);
+}
+
+} // namespace UdevText
+
+} // namespace FlashSpartan
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+struct udev;
+struct udev_monitor;
+struct udev_device;
+
+namespace FlashSpartan {
+
+/**
+ * One udev context, netlink socket and epoll thread shared by every Linux device monitor.
+ * Monitors subscribe to a subsystem (and optional devtype); the socket filter is the union
+ * of all subscriptions and each event goes to the subscribers that match it. The thread
+ * sleeps in epoll_wait() with no timeout and is woken through an eventfd, so an idle
+ * kiosk has no periodic wake-ups. Each wake-up drains every queued event from the socket.
+ * It starts with the first subscription and stops with the last.
+ *
+ * Handlers and posted tasks run on the reactor thread, which is also the only thread that
+ * may use context(). Linux only.
+ */
+class UdevReactor {
+public:
+    using EventHandler = std::function<void(struct udev_device* dev)>;
+
+    static constexpr int kMaxEventsPerWake = 256;
+
+    /** Set by packaging/99-flashspartan.rules on USB storage partitions and on input devices. */
+    static constexpr const char* kPartitionTag = "flashspartan-partition";
+    static constexpr const char* kInputTag = "flashspartan-input";
+
+    static UdevReactor& instance();
+
+    /** Whether 99-flashspartan.rules is in one of the udev rules directories. */
+    static bool rulesInstalled();
+
+    /**
+     * -1 when udev or the thread could not be set up. With a @p tag, only devices carrying
+     * it reach @p handler; while every subscription has one, the socket filter matches the
+     * tags too, so untagged events (loop, dm, NVMe churn) never wake the reactor.
+     */
+    int subscribe(const char* subsystem, const char* devtype, EventHandler handler,
+                  const char* tag = nullptr);
+    /**
+     * Drops the subscription and its queued tasks; waits for a running handler to return
+     * unless called from the reactor thread itself.
+     */
+    void unsubscribe(int id);
+
+    /**
+     * Runs @p task on the reactor thread on behalf of subscription @p id, after at least
+     * @p delayMs (the epoll timeout is set from the earliest delayed task).
+     */
+    void post(int id, std::function<void()> task, int delayMs = 0);
+
+    struct udev* context() const { return m_udev; }
+
+private:
+    struct Subscription {
+        int id = 0;
+        QByteArray subsystem;
+        QByteArray devtype;  // empty: any
+        QByteArray tag;  // empty: any
+        EventHandler handler;
+    };
+    struct Task {
+        int id = 0;
+        std::function<void()> run;
+        std::chrono::steady_clock::time_point due;
+    };
+
+    UdevReactor() = default;
+    ~UdevReactor();
+
+    bool startLocked();
+    void stop(std::unique_lock<std::mutex>& lock);
+    void wake();
+    void run();
+    void dispatch(struct udev_device* dev);
+    /** Rebuilds the socket filter from m_subscriptions; reactor thread only. */
+    void updateFilter();
+    /** epoll_wait() timeout until the earliest queued task is due; -1 when none is queued. */
+    int nextTimeoutLocked() const;
+
+    std::mutex m_mutex;
+    std::condition_variable m_idle;  // signalled whenever m_dispatching goes back to 0
+    QList<Subscription> m_subscriptions;
+    QList<Task> m_tasks;
+    int m_nextId = 1;
+    int m_dispatching = 0;  // subscription whose handler or task is running
+    bool m_stop = false;
+
+    struct udev* m_udev = nullptr;
+    struct udev_monitor* m_monitor = nullptr;
+    int m_epollFd = -1;
+    int m_wakeFd = -1;
+    std::thread m_thread;
+};
+
+} // namespace FlashSpartan
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QString>
+
+#include <libudev.h>
+
+#include <string_view>
+
+namespace FlashSpartan::UdevText {
+
+/**
+ * udev properties and sysfs attributes as views of libudev's own strings, so monitors can
+ * filter devices (bus, devtype, interface class) without building a QString for each value;
+ * convert with toString() only what a device that passed is kept with. A view is valid
+ * until the udev_device it came from is unreferenced. Missing values are empty. Linux only.
+ *
+ * UdevEventTrace.h overloads each accessor for a recorded UdevRecord, so monitor code
+ * written against these runs on replayed events as well.
+ */
+
+inline std::string_view view(const char* value)
+{
+    return value ? std::string_view(value) : std::string_view();
+}
+
+/** @p value without leading and trailing ASCII whitespace (sysfs values end in '\n'). */
+inline std::string_view trimmed(std::string_view value)
+{
+    constexpr std::string_view kSpace = " \t\n\r\f\v";
+    const std::size_t first = value.find_first_not_of(kSpace);
+    if (first == std::string_view::npos) {
+        return {};
+    }
+    return value.substr(first, value.find_last_not_of(kSpace) - first + 1);
+}
+
+inline std::string_view property(struct udev_device* dev, const char* key)
+{
+    return view(udev_device_get_property_value(dev, key));
+}
+
+/** Trimmed, like QString::trimmed() on the same value. */
+inline std::string_view sysAttr(struct udev_device* dev, const char* key)
+{
+    return trimmed(view(udev_device_get_sysattr_value(dev, key)));
+}
+
+inline std::string_view action(struct udev_device* dev) { return view(udev_device_get_action(dev)); }
+inline std::string_view sysPath(struct udev_device* dev) { return view(udev_device_get_syspath(dev)); }
+inline std::string_view sysName(struct udev_device* dev) { return view(udev_device_get_sysname(dev)); }
+inline std::string_view devNode(struct udev_device* dev) { return view(udev_device_get_devnode(dev)); }
+inline std::string_view devType(struct udev_device* dev) { return view(udev_device_get_devtype(dev)); }
+inline std::string_view driver(struct udev_device* dev) { return view(udev_device_get_driver(dev)); }
+inline quint64 devnum(struct udev_device* dev) { return udev_device_get_devnum(dev); }
+
+/** Owned by @p dev, like every parent libudev returns. */
+inline struct udev_device* parent(struct udev_device* dev, const char* subsystem, const char* devtype)
+{
+    return udev_device_get_parent_with_subsystem_devtype(dev, subsystem, devtype);
+}
+
+inline QString toString(std::string_view value)
+{
+    return value.empty() ? QString()
+                         : QString::fromUtf8(value.data(), static_cast<qsizetype>(value.size()));
+}
+
+} // namespace FlashSpartan::UdevText
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+
+#include <QtGlobal>
+
+class QIODevice;
+
+namespace FlashSpartan {
+
+/**
+ * @brief What a BadUSB capture holds, decoded without Wireshark.
+ *
+ * summarize() streams a pcap or pcapng file one record at a time, so memory stays at one
+ * frame however long the capture ran. It understands usbmon frames (LINKTYPE_USB_LINUX and
+ * _MMAPPED, as tcpdump and the native ring write them) and USBPcap frames (LINKTYPE_USBPCAP)
+ * and reports, per device and endpoint, packet and byte counts and the time span, and per
+ * keyboard the keys it typed (boot-protocol reports, US layout) and how fast, run through
+ * HidKeystrokeAnalyzer. Safe to call from a worker thread.
+ */
+struct UsbCaptureSummary {
+    static constexpr int kMaxTypedChars = 4096;
+    /** Larger frames are counted as skipped without being read into memory. */
+    static constexpr qint64 kMaxFrameBytes = 256 * 1024;
+
+    struct Endpoint {
+        quint16 bus = 0;
+        quint8 device = 0;
+        quint8 endpoint = 0;  // bit 7 set: IN
+        quint8 transferType = 0;  // 0 iso, 1 interrupt, 2 control, 3 bulk
+        quint64 packets = 0;
+        quint64 bytes = 0;  // captured payload
+        qint64 firstUs = 0;
+        qint64 lastUs = 0;
+    };
+
+    struct Keyboard {
+        quint16 bus = 0;
+        quint8 device = 0;
+        int keyDowns = 0;
+        QString typed;  // non-printing keys and chords as [Enter], [GUI+r]
+        bool truncated = false;  // typed stopped at kMaxTypedChars
+        qint64 firstUs = 0;  // first and last key-down
+        qint64 lastUs = 0;
+        qint64 fastestIntervalUs = 0;  // between two key-downs; 0 with fewer than two
+        bool superhuman = false;  // HidKeystrokeAnalyzer flagged it
+
+        double keysPerSecond() const;
+    };
+
+    QString path;
+    QString format;  // "pcap" or "pcapng"
+    quint16 linkType = 0;  // of the first interface
+    QString error;  // why reading stopped early; the counts cover what was read
+    quint64 packets = 0;
+    quint64 skippedPackets = 0;  // not USB, truncated or oversized
+    qint64 firstUs = 0;
+    qint64 lastUs = 0;
+    QList<Endpoint> endpoints;  // by bus, device, endpoint
+    QList<Keyboard> keyboards;  // by bus, device
+    /**
+     * SHA-256 over every USB event's endpoint, transfer type, direction, status and data,
+     * leaving out timestamps, URB ids and addresses: two captures of the same device doing the
+     * same thing share it, whenever and wherever it was plugged in. Empty without events.
+     */
+    QByteArray contentDigest;
+
+    bool isValid() const { return error.isEmpty(); }
+    /** One line: "412 packets over 12.3 s on 1 device, 3 endpoints; 57 keys typed". */
+    QString headline() const;
+    /** headline(), then one line per endpoint and per keyboard. */
+    QString text() const;
+    QJsonObject toJson() const;
+
+    static UsbCaptureSummary summarize(const QString& path);
+    static UsbCaptureSummary summarize(QIODevice* in);
+
+    /** One boot-keyboard usage as typed under @p modifiers; empty for no key. */
+    static QString keyText(quint8 usage, quint8 modifiers);
+};
+
+} // namespace FlashSpartan
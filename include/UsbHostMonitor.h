@@ -18,6 +18,10 @@ namespace FlashSpartan {
  *
  * Complements storage-volume monitoring and HID detail for security keys,
  * hubs, chargers, and other USB connections without a drive letter.
+ * The thread sleeps until a USB device interface arrives or goes away
+ * (WinDeviceNotifier) and then re-reads only that device; the full scan
+ * runs once at start, on rescan(), and every IDLE_SCAN_INTERVAL_MS only
+ * when notifications could not be registered.
  */
 class UsbHostMonitor : public QThread {
     Q_OBJECT
@@ -46,13 +50,15 @@ protected:
 
 private:
     void scanExistingDevices();
+    void applyChanges(const QList<UsbHostDeviceInfo>& present, const QStringList& gone);
+
+    void* m_wakeEvent = nullptr;  // Windows auto-reset event: notifications, rescan(), stop
 
     mutable QMutex m_devicesMutex;
     QHash<QString, UsbHostDeviceInfo> m_devices;
     std::atomic<bool> m_running{false};
     std::atomic<bool> m_rescanRequested{false};
 
-    static constexpr int POLL_TIMEOUT_MS = 500;
     static constexpr int IDLE_SCAN_INTERVAL_MS = 5000;
 };
 
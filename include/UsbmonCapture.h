@@ -1,33 +1,116 @@
 #pragma once
 
+#include "HidKeystrokeAnalyzer.h"
 #include "Types.h"
+#include "UsbmonRing.h"
 
 #include <QObject>
 #include <QProcess>
 
+#include <memory>
+#include <vector>
+
+class QTimer;
+
 namespace FlashSpartan {
 
+/**
+ * USB packet capture for BadUSB anomalies. By default each capture runs the configured
+ * command (tcpdump on usbmon, USBPcapCMD on Windows) from the moment it is started.
+ *
+ * Linux: startNativeFeed() reads /dev/usbmon0 on a thread through the binary mmap interface
+ * (MON_IOCX_MFETCH). With a pre-trigger window it keeps the last seconds of every bus in a
+ * bounded UsbmonRing, so startCapture() writes the events that led up to the anomaly to a
+ * pcapng file at once and keeps appending that bus for kPostTriggerSeconds. With keystroke
+ * analysis every event also goes through a HidKeystrokeAnalyzer on that thread, and
+ * keystrokeRateExceeded() follows within the event's own fetch.
+ *
+ * With device filtering (the default) the ring keeps only control and interrupt traffic
+ * (enumeration, HID) of a bus, plus everything of a device while it is being dumped, and a
+ * dump holds the suspect device's address alone; on Windows the {devices} placeholder hands
+ * the address to USBPcap. Bulk and isochronous streams of docks, webcams and disks are then
+ * dropped on the header, before anything is copied.
+ *
+ * Each bus has its own capture session, so suspects on different buses are captured at the
+ * same time: native sessions all read the one ring, command sessions run one process each.
+ * A device of unknown bus is captured on every bus and runs alone. At most
+ * kMaxConcurrentCaptures sessions run at once, and once native sessions have written
+ * kMaxConcurrentDumpBytes together, the largest is finished early.
+ */
 class UsbmonCapture : public QObject {
     Q_OBJECT
 
 public:
+    static constexpr int kPostTriggerSeconds = 30;
+    static constexpr int kMaxConcurrentCaptures = 4;
+    static constexpr qint64 kMaxConcurrentDumpBytes = 256LL * 1024 * 1024;
+
     explicit UsbmonCapture(QObject* parent = nullptr);
+    ~UsbmonCapture() override;
 
     QString outputDirectory() const;
+    /** True while any capture session runs. */
     bool isRunning() const;
+    int runningCaptures() const;
+    /** True when a capture on @p bus (0: every bus) would be refused because one overlaps it. */
+    bool isCapturing(quint16 bus) const;
 
+    /** False, with captureFailed(), when the device's bus is already captured or the cap is reached. */
     bool startCapture(const HidDeviceInfo& device, const BadUsbAnomalyResult& anomaly,
                       const QString& commandTemplate);
+    /** Stops every running capture. */
     void stopCapture();
 
+    /**
+     * Starts (or reconfigures) the native usbmon reader with @p preTriggerSeconds of history
+     * (0: none, captures use the command) and optional keystroke-rate analysis. Stops it when
+     * neither is asked for. False with @p error when /dev/usbmon0 cannot be read (usbmon not
+     * loaded, no permission) or off Linux.
+     */
+    bool startNativeFeed(int preTriggerSeconds, bool keystrokeAnalysis, QString* error = nullptr);
+    void stopNativeFeed();
+    bool isNativeFeedRunning() const;
+
+    /** Keep only the suspect device's traffic where its address is known (see above). */
+    void setDeviceFiltering(bool enabled);
+    bool deviceFiltering() const;
+
 signals:
     void captureStarted(const QString& path);
-    void captureFinished(const QString& path, int exitCode);
+    void captureFinished(const QString& path, int exitCode, const FlashSpartan::BadUsbAnomalyResult& anomaly);
     void captureFailed(const QString& error);
+    /** A device on the usbmon feed typed faster than a person can; see HidKeystrokeAnalyzer. */
+    void keystrokeRateExceeded(const FlashSpartan::HidKeystrokeAnalyzer::Finding& finding);
 
 private:
-    QProcess* m_process = nullptr;
-    QString m_outputPath;
+    struct NativeReader;
+    struct Session;
+
+    /** False, with captureFailed(), when a capture on @p bus may not start now. */
+    bool admitCapture(quint16 bus);
+    QString nextOutputPath(quint16 bus, const BadUsbAnomalyResult& anomaly, const QString& extension) const;
+    bool startCommandCapture(std::unique_ptr<Session> session, const QString& program,
+                             const QStringList& arguments, int startTimeoutMs);
+    bool startRingDump(const HidDeviceInfo& device, const BadUsbAnomalyResult& anomaly);
+    /** Appends what the ring got since the session's last flush; false when the file cannot be written. */
+    bool flushRingDump(Session& session);
+    /** Closes the session's pcapng file; captureFinished() unless @p notify is false. */
+    void finishRingDump(Session* session, bool notify = true);
+    void finishRingDumps(bool notify = true);
+    void onDumpTick();
+    UsbmonFilter ringFilter() const;
+    void applyRingFilter();
+
+    std::vector<std::unique_ptr<Session>> m_sessions;
+
+    std::unique_ptr<UsbmonRing> m_ring;
+    int m_budgetId = 0;  // m_ring's MemoryBudget registration
+    std::unique_ptr<NativeReader> m_reader;
+    int m_preTriggerSeconds = 0;
+    bool m_keystrokeAnalysis = false;
+    bool m_deviceFiltering = true;
+
+    QTimer* m_dumpTimer = nullptr;  // flushes every native session once a second
 };
 
 } // namespace FlashSpartan
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+class QIODevice;
+
+namespace FlashSpartan {
+
+/**
+ * One usbmon event as the binary interface delivers it: the 64-byte mon_bin header, any
+ * isochronous descriptors and the captured data, i.e. one LINKTYPE_USB_LINUX_MMAPPED frame.
+ */
+struct UsbmonPacket {
+    quint64 sequence = 0;  // assigned by UsbmonRing::append()
+    qint64 timestampUs = 0;  // wall clock, microseconds since the epoch
+    quint16 bus = 0;
+    quint8 device = 0;
+    char eventType = 0;  // 'S'ubmission, 'C'allback, 'E'rror
+    quint8 transferType = 0;  // 0 iso, 1 interrupt, 2 control, 3 bulk
+    quint8 endpoint = 0;  // bit 7 set: IN
+    qint32 status = 0;
+    quint32 originalLength = 0;  // frame length had the URB been captured in full
+    QByteArray frame;
+};
+
+/**
+ * Which usbmon events a capture keeps. Events of the listed devices are kept (on the listed
+ * endpoints); those of every other device only when their transfer type is in
+ * otherTransfers. The default keeps everything. matchesEvent() decides on the raw mon_bin
+ * header, so rejected events are never copied out of the kernel ring.
+ */
+struct UsbmonFilter {
+    static constexpr quint8 kTransferIso = 0;
+    static constexpr quint8 kTransferInterrupt = 1;
+    static constexpr quint8 kTransferControl = 2;
+    static constexpr quint8 kTransferBulk = 3;
+    static constexpr quint32 kAllEndpoints = 0xFFFFFFFF;
+    /** Bit of otherTransfers for transfer type @p type. */
+    static constexpr quint8 transferBit(quint8 type) { return quint8(1u << (type & 3)); }
+    /** Bit of Device::endpoints for @p endpoint as usbmon reports it (bit 7: IN). */
+    static constexpr quint32 endpointBit(quint8 endpoint)
+    {
+        return 1u << ((endpoint & 0x0F) + ((endpoint & 0x80) ? 16 : 0));
+    }
+
+    struct Device {
+        quint16 bus = 0;  // 0: any bus
+        quint8 address = 0;
+        quint32 endpoints = kAllEndpoints;
+    };
+
+    QList<Device> devices;
+    quint8 otherTransfers = 0x0F;
+
+    /** Control and interrupt traffic of every device, everything of @p devices. */
+    static UsbmonFilter enumerationAndHid(const QList<Device>& devices = {});
+    /**
+     * Only @p address on @p bus, plus the default address 0 of that bus, where the device
+     * enumerated before it was given @p address.
+     */
+    static UsbmonFilter singleDevice(quint16 bus, quint8 address);
+
+    bool acceptsEverything() const { return otherTransfers == 0x0F; }
+    bool matches(quint16 bus, quint8 address, quint8 endpoint, quint8 transferType) const;
+    bool matches(const UsbmonPacket& packet) const;
+    /** Same for the event at @p entry; false when fewer than a header's bytes are available. */
+    bool matchesEvent(const char* entry, size_t available) const;
+};
+
+/**
+ * Bounded pre-trigger history of usbmon events, one window per bus: events older than the
+ * age limit, or past the byte limit, fall off the front. Filled by a capture thread, read
+ * when an anomaly asks for the last seconds of a bus. Thread-safe.
+ */
+class UsbmonRing {
+public:
+    static constexpr size_t kHeaderBytes = 64;
+    static constexpr size_t kIsoDescriptorBytes = 16;
+    /** LINKTYPE_USB_LINUX_MMAPPED (pcap/pcapng). */
+    static constexpr quint16 kLinkType = 220;
+
+    UsbmonRing(qint64 maxAgeUs, qint64 maxBytesPerBus);
+
+    void append(UsbmonPacket packet);
+
+    /**
+     * Events of @p bus (0: every bus, as usbmon0 numbers them) stamped at or after @p fromUs
+     * with a sequence past @p afterSequence, oldest first.
+     */
+    QList<UsbmonPacket> packets(quint16 bus, qint64 fromUs, quint64 afterSequence = 0) const;
+
+    qint64 bytes(quint16 bus) const;
+    /** Frame bytes held over every bus. */
+    qint64 totalBytes() const;
+    /** Drops the oldest events, whatever their bus, until at most @p maxBytes are held. */
+    void shrinkTo(qint64 maxBytes);
+    void clear();
+
+    /**
+     * Reads the event at @p entry (at most @p available bytes of the mmap ring). False for
+     * filler entries and for events whose lengths run past @p available.
+     */
+    static bool parseEvent(const char* entry, size_t available, UsbmonPacket* out);
+
+private:
+    struct Window {
+        std::deque<UsbmonPacket> packets;
+        qint64 bytes = 0;
+    };
+
+    mutable QMutex m_mutex;
+    QHash<quint16, Window> m_windows;
+    qint64 m_maxAgeUs = 0;
+    qint64 m_maxBytesPerBus = 0;
+    quint64 m_nextSequence = 1;
+};
+
+/** Minimal little-endian pcapng writer: one section, its interfaces, enhanced packet blocks. */
+class PcapngWriter {
+public:
+    explicit PcapngWriter(QIODevice* out);
+
+    bool writeSectionHeader(const QString& comment = QString());
+    /** Interfaces are numbered from 0 in the order written. */
+    bool writeInterface(quint16 linkType, const QString& name, quint32 snapLength = 0);
+    bool writePacket(quint32 interfaceId, qint64 timestampUs, const QByteArray& data, quint32 originalLength);
+
+private:
+    bool writeBlock(quint32 type, const QByteArray& body);
+
+    QIODevice* m_out = nullptr;
+};
+
+} // namespace FlashSpartan
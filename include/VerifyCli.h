@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QString>
+#include <QStringList>
 
 namespace FlashSpartan {
 
@@ -18,6 +19,55 @@ public:
     static int runExportReport(const QString& path, const QString& format);
     static int runListPublishers();
     static int runTrustHash(const QString& fileName, const QString& sha256Hex);
+    /** Verify each mount against one watch manifest (JSON export or .fsmf file) in one batch. */
+    static int runVerifyWatch(const QString& manifestPath, const QStringList& mountPoints);
+    /**
+     * Verify images and directories of images as one batch, @p jobs at once (0: scheduler
+     * default). Each result is printed as an NDJSON line when it finishes, then a summary line.
+     */
+    static int runVerifyBatch(const QStringList& inputs, int jobs);
+    /**
+     * Hash raw partitions, @p jobs at once (0: all at once). @p scanMode is "full", "quick" or
+     * "chunked". Full and chunked reads keep the GUI's checkpoints, and with @p resume
+     * continue from one. With @p tolerateBadSectors a full read hashes sectors that fail or
+     * take longer than @p readTimeoutMs (0: the default) as zeros and lists them, instead of
+     * failing. Prints a "result" line per device, then a summary line.
+     */
+    static int runHashDevices(const QStringList& deviceNodes, const QString& scanMode,
+                              const QString& algorithm, bool resume, int jobs,
+                              bool tolerateBadSectors, int readTimeoutMs);
+    /**
+     * Duplicator check: read @p masterPath (an image file or a device) once into block
+     * digests, then every clone in @p cloneNodes at once, scheduled per USB controller with
+     * @p jobs as the ceiling (0: all). Each clone stops at its first block that differs from
+     * the master. Prints a "master" line, a "result" line per clone as it ends, then a summary.
+     */
+    static int runVerifyClones(const QString& masterPath, const QStringList& cloneNodes,
+                               const QString& algorithm, int jobs);
+    /**
+     * Write @p imagePath to the whole disk @p deviceNode and read it back (ImageFlasher):
+     * the image is verified by the same read that writes it, the disk is compared block by
+     * block with what was written. Without @p allowUnverified an image with no published or
+     * trusted hash fails; without @p allowFixedDisk so does a disk that is neither removable
+     * nor on USB. Prints one "result" line.
+     */
+    static int runFlashImage(const QString& imagePath, const QString& deviceNode, const QString& algorithm,
+                             bool allowUnverified, bool allowFixedDisk);
+    /**
+     * Build the watch groups of @p specPath (a manifest or a groups-only spec) on every mount
+     * at once. One mount writes its JSON manifest to @p outputPath; several write
+     * <mount name>.json into the directory @p outputPath.
+     */
+    static int runBuildManifest(const QString& specPath, const QStringList& mountPoints,
+                                const QString& outputPath);
+    /**
+     * Serve this host's catalog and publisher artifacts to the site's other hosts
+     * (IsoMirrorServer) on @p port until killed; they point iso/mirrorUrl at it. Prints one
+     * "mirror" line once listening.
+     */
+    static int runServeMirror(quint16 port);
+    /** Paths listed one per line in @p listPath ("-" for stdin); blank lines and "#" comments skipped. */
+    static QStringList readPathList(const QString& listPath, bool* ok = nullptr);
 
     /** Optional FlashSpartan.conf path for subsequent CLI verify commands. */
     static void setConfigFilePath(const QString& path);
@@ -25,6 +75,9 @@ public:
     /** Machine-readable stdout for verify/export commands. */
     static void setJsonOutput(bool enabled);
 
+    /** With JSON output, a "progress" line per running target every @p ms (0: none). */
+    static void setProgressInterval(int ms);
+
     /** Print only summary lines (no per-file report body). */
     static void setQuietOutput(bool enabled);
 
@@ -1,9 +1,17 @@
 #pragma once
 
+#include "Types.h"
+#include "VerifyRollup.h"
+
 #include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QJsonObject>
 #include <QList>
 #include <QString>
 
+#include <functional>
+
 namespace FlashSpartan {
 
 enum class VerifyHistoryKind {
@@ -12,7 +20,7 @@ enum class VerifyHistoryKind {
     IsoScan,
 };
 
-/** One completed verification event (persisted in verify-history.json). */
+/** One completed verification event (persisted in verify-history.ring). */
 struct VerifyHistoryEntry {
     QDateTime timestamp;
     QString deviceNode;
@@ -24,27 +32,82 @@ struct VerifyHistoryEntry {
     QString summary;
     QString detail;
     uint64_t durationMs = 0;
+    /** How a hash job ran; empty for manifest and ISO scans. */
+    HashPerformance performance;
 };
 
+/**
+ * Verification history in a fixed-size ring file: an append writes one record and a
+ * header, and the oldest records are overwritten once kCapacityBytes is used (tens of
+ * thousands of entries, so a year of kiosk use). Two header copies are written in turn and
+ * evictions are recorded before their bytes are reused, so a crash loses at most the entry
+ * being written. verify-history.json is migrated once.
+ */
 class VerifyHistory {
 public:
+    static constexpr quint64 kCapacityBytes = 16 * 1024 * 1024;
+
     static VerifyHistory& instance();
 
-    void load();
+    /**
+     * Opens the ring; @p path and @p capacityBytes are for tests. An existing file keeps
+     * the capacity it was created with.
+     */
+    void load(const QString& path = {}, quint64 capacityBytes = kCapacityBytes);
+    /** Flushes the ring; append() has already written the entry. */
     void save();
 
     void append(const VerifyHistoryEntry& entry);
 
     QList<VerifyHistoryEntry> recentEntries(int limit = 50) const;
     QList<VerifyHistoryEntry> entriesForDevice(const QString& deviceNode, int limit = 20) const;
+    int entryCount() const { return static_cast<int>(m_entries.size()); }
+    /** Counters over every entry appended, kept beside the ring in verify-history.rollup. */
+    const VerifyRollup& rollup() const { return m_rollup; }
 
     QString formatEntryLine(const VerifyHistoryEntry& entry) const;
+    /** The ring load() opened; empty before. */
+    QString filePath() const { return m_file.fileName(); }
+
+    /** An entry as it is stored in the ring. */
+    static QJsonObject toJson(const VerifyHistoryEntry& entry);
+    /**
+     * Reads the ring at @p path oldest first, one record at a time, with its own handle so it
+     * can run off the thread that appends. Covers the records the header listed when it was
+     * read; a record overwritten meanwhile ends the scan early. @p visit gets each entry and
+     * the fraction read so far, and returns false to stop. False when the ring cannot be read
+     * or @p visit stopped.
+     */
+    static bool scan(const QString& path,
+                     const std::function<bool(const VerifyHistoryEntry& entry, double done)>& visit);
 
 private:
+    struct Header {
+        quint64 seq = 0;
+        quint64 capacity = 0;
+        quint64 tail = 0;  // data offset of the oldest record
+        quint64 head = 0;  // where the next record goes
+        quint64 count = 0;
+    };
+
     VerifyHistory() = default;
 
-    QList<VerifyHistoryEntry> m_entries;
-    static constexpr int kMaxEntries = 500;
+    /** The valid header copy with the higher seq; false when neither is valid. */
+    static bool readHeader(QFile& file, Header* header);
+    bool openRing(const QString& path, quint64 capacityBytes);
+    bool writeHeader();
+    void index(VerifyHistoryEntry entry, quint32 recordBytes);
+    void evictOldest();
+    void migrateLegacy(const QString& legacyPath);
+
+    QFile m_file;
+    Header m_header;
+    QList<VerifyHistoryEntry> m_entries;  // oldest first, one per record in the ring
+    QList<quint32> m_recordBytes;         // parallel to m_entries
+    qint64 m_firstSeq = 0;                // sequence number of m_entries.first()
+    QHash<QString, QList<qint64>> m_byDevice;  // sequence numbers, oldest first
+    VerifyRollup m_rollup;
+    QString m_rollupPath;  // empty while load() rebuilds the ring; appends then skip the save
 };
 
 } // namespace FlashSpartan
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QDate>
+#include <QDateTime>
+#include <QHash>
+#include <QJsonObject>
+#include <QMap>
+#include <QString>
+
+#include <optional>
+
+namespace FlashSpartan {
+
+struct VerifyHistoryEntry;
+
+/**
+ * Running totals over verification history: per local day, per device and overall, kept up
+ * to date by VerifyHistory::append() so pages and sidebar badges read counters instead of
+ * scanning entries. Counts cover every entry ever appended, including ones the ring has
+ * since overwritten; only a rollup rebuilt from the ring (stale or missing file) is limited
+ * to what the ring still holds.
+ */
+class VerifyRollup {
+public:
+    /** Days kept; older ones are dropped as new days are added. */
+    static constexpr int kRetainDays = 400;
+
+    struct Counts {
+        quint32 total = 0;
+        quint32 passed = 0;
+        /** Everything that is not a pass: fail, mismatch, error, partial. */
+        quint32 failed = 0;
+
+        void add(const Counts& other);
+        /** Passed share in percent; 0 with no entries. */
+        int passPercent() const;
+        bool operator==(const Counts&) const = default;
+    };
+
+    struct DeviceSummary {
+        Counts counts;
+        QString label;
+        QString lastStatus;
+        QDateTime lastAt;
+    };
+
+    void add(const VerifyHistoryEntry& entry);
+    void clear();
+
+    const Counts& totals() const { return m_totals; }
+    /** @p day is a local date. */
+    Counts day(const QDate& day) const;
+    /** Days from @p first (local) through today. */
+    Counts since(const QDate& first) const;
+    /** Empty when @p deviceNode has no entries. */
+    DeviceSummary device(const QString& deviceNode) const { return m_devices.value(deviceNode); }
+    int deviceCount() const { return static_cast<int>(m_devices.size()); }
+
+    /** Header seq of the ring this rollup matches; a different seq on load means it is stale. */
+    quint64 ringSeq() const { return m_ringSeq; }
+    void setRingSeq(quint64 seq) { m_ringSeq = seq; }
+
+    QJsonObject toJson() const;
+    static VerifyRollup fromJson(const QJsonObject& obj);
+    bool save(const QString& path) const;
+    /** nullopt when @p path is missing or not a rollup. */
+    static std::optional<VerifyRollup> load(const QString& path);
+
+private:
+    QMap<QDate, Counts> m_days;
+    QHash<QString, DeviceSummary> m_devices;
+    Counts m_totals;
+    quint64 m_ringSeq = 0;
+};
+
+} // namespace FlashSpartan
@@ -0,0 +1,347 @@
+#pragma once
+
+#include "HexEncoding.h"
+
+#include <QDateTime>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QTimeZone>
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace FlashSpartan {
+
+/** One content-defined chunk of a large watched file (see ContentChunker). */
+struct WatchChunk {
+    uint64_t offset = 0;
+    uint32_t length = 0;
+    QString hash;  // hex SHA-256 of the chunk bytes
+};
+
+struct WatchFileEntry {
+    QString relativePath;
+    QString contentHash;
+    uint64_t sizeBytes = 0;
+    QDateTime modifiedUtc;
+    /** Status-change time and inode (0 when the platform has none); verify short-circuit only. */
+    QDateTime changedUtc;
+    uint64_t inode = 0;
+    /** Set for files at or above WatchGroup::chunkThresholdBytes; contentHash stays whole-file. */
+    QList<WatchChunk> chunks;
+
+    bool hasMetadata() const { return modifiedUtc.isValid(); }
+};
+
+/**
+ * The files of a watch group, stored compactly for the lifetime of a baseline: directories
+ * are interned once, names share one string arena, SHA-256 content hashes are 32 raw bytes
+ * and times are UTC milliseconds. The storage is immutable once shared, so copying a list
+ * (a device record, the policy snapshot, a verify result handed to a worker) only bumps a
+ * reference count; append() and clear() on a shared list copy it first.
+ *
+ * Entries are decoded on access: at() and iteration yield WatchFileEntry values, so keep
+ * the value rather than a pointer into the list.
+ */
+class WatchFileList {
+public:
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = WatchFileEntry;
+        using difference_type = qsizetype;
+        using pointer = void;
+        using reference = WatchFileEntry;
+
+        const_iterator() = default;
+        WatchFileEntry operator*() const { return m_list->at(m_index); }
+        const_iterator& operator++()
+        {
+            ++m_index;
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator was = *this;
+            ++m_index;
+            return was;
+        }
+        bool operator==(const const_iterator& other) const { return m_index == other.m_index; }
+        bool operator!=(const const_iterator& other) const { return m_index != other.m_index; }
+
+    private:
+        friend class WatchFileList;
+        const_iterator(const WatchFileList* list, qsizetype index)
+            : m_list(list)
+            , m_index(index)
+        {
+        }
+
+        const WatchFileList* m_list = nullptr;
+        qsizetype m_index = 0;
+    };
+
+    WatchFileList() = default;
+    WatchFileList(std::initializer_list<WatchFileEntry> entries)
+    {
+        reserve(static_cast<qsizetype>(entries.size()));
+        for (const WatchFileEntry& e : entries) {
+            append(e);
+        }
+    }
+
+    qsizetype size() const { return m_storage ? static_cast<qsizetype>(m_storage->records.size()) : 0; }
+    bool isEmpty() const { return size() == 0; }
+
+    WatchFileEntry at(qsizetype i) const
+    {
+        const Storage& s = *m_storage;
+        const Record& r = s.records[static_cast<size_t>(i)];
+        WatchFileEntry e;
+        e.relativePath = pathOf(s, r);
+        e.contentHash = contentHashOf(s, r);
+        e.sizeBytes = r.sizeBytes;
+        e.modifiedUtc = msToTime(r.modifiedMs);
+        e.changedUtc = msToTime(r.changedMs);
+        e.inode = r.inode;
+        if (r.chunks != kNone) {
+            e.chunks = s.chunkLists[r.chunks];
+        }
+        return e;
+    }
+    WatchFileEntry first() const { return at(0); }
+    WatchFileEntry last() const { return at(size() - 1); }
+
+    /** Just the path of entry @p i. */
+    QString relativePath(qsizetype i) const
+    {
+        return pathOf(*m_storage, m_storage->records[static_cast<size_t>(i)]);
+    }
+
+    /**
+     * Orders entry @p i against entry @p j of @p other by path, as QString::compare() would,
+     * without building either path.
+     */
+    int comparePath(qsizetype i, const WatchFileList& other, qsizetype j) const
+    {
+        const PathParts x = partsOf(*m_storage, m_storage->records[static_cast<size_t>(i)]);
+        const PathParts y = partsOf(*other.m_storage, other.m_storage->records[static_cast<size_t>(j)]);
+        const QStringView xs[3] = {x.directory, x.hasDirectory ? QStringView(u"/") : QStringView(), x.name};
+        const QStringView ys[3] = {y.directory, y.hasDirectory ? QStringView(u"/") : QStringView(), y.name};
+        int xp = 0;
+        int yp = 0;
+        qsizetype xo = 0;
+        qsizetype yo = 0;
+        for (;;) {
+            while (xp < 3 && xo == xs[xp].size()) {
+                ++xp;
+                xo = 0;
+            }
+            while (yp < 3 && yo == ys[yp].size()) {
+                ++yp;
+                yo = 0;
+            }
+            if (xp == 3 || yp == 3) {
+                return (xp == 3 ? 0 : 1) - (yp == 3 ? 0 : 1);
+            }
+            const qsizetype run = qMin(xs[xp].size() - xo, ys[yp].size() - yo);
+            if (const int c = xs[xp].mid(xo, run).compare(ys[yp].mid(yo, run)); c != 0) {
+                return c;
+            }
+            xo += run;
+            yo += run;
+        }
+    }
+
+    /** Whether entries @p i and @p j of @p other have the same content hash; raw SHA-256 compare. */
+    bool sameContentHash(qsizetype i, const WatchFileList& other, qsizetype j) const
+    {
+        const Record& x = m_storage->records[static_cast<size_t>(i)];
+        const Record& y = other.m_storage->records[static_cast<size_t>(j)];
+        if ((x.flags & kRawDigest) && (y.flags & kRawDigest)) {
+            return x.digest == y.digest;
+        }
+        return contentHashOf(*m_storage, x) == contentHashOf(*other.m_storage, y);
+    }
+
+    bool isSortedByPath() const
+    {
+        for (qsizetype i = 1; i < size(); ++i) {
+            if (comparePath(i - 1, *this, i) > 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+
+    void reserve(qsizetype count)
+    {
+        Storage& s = mutableStorage();
+        s.records.reserve(static_cast<size_t>(count));
+        // Names average well under 32 UTF-16 units.
+        s.names.reserve(static_cast<qsizetype>(count) * 24);
+    }
+
+    void append(const WatchFileEntry& entry)
+    {
+        Storage& s = mutableStorage();
+        Record r;
+        const qsizetype slash = entry.relativePath.lastIndexOf(QLatin1Char('/'));
+        if (slash >= 0) {
+            const QString directory = entry.relativePath.left(slash);
+            auto it = s.directoryIds.constFind(directory);
+            if (it == s.directoryIds.cend()) {
+                it = s.directoryIds.insert(directory, static_cast<uint32_t>(s.directories.size()));
+                s.directories.push_back(directory);
+            }
+            r.directory = it.value();
+        }
+        const QStringView name = QStringView(entry.relativePath).mid(slash + 1);
+        r.nameOffset = static_cast<uint32_t>(s.names.size());
+        r.nameLength = static_cast<uint32_t>(name.size());
+        s.names.append(name);
+        if (parseDigest(entry.contentHash, r.digest)) {
+            r.flags |= kRawDigest;
+        } else if (!entry.contentHash.isEmpty()) {
+            r.otherHash = static_cast<uint32_t>(s.otherHashes.size());
+            s.otherHashes.push_back(entry.contentHash);
+        }
+        r.sizeBytes = entry.sizeBytes;
+        r.modifiedMs = timeToMs(entry.modifiedUtc);
+        r.changedMs = timeToMs(entry.changedUtc);
+        r.inode = entry.inode;
+        if (!entry.chunks.isEmpty()) {
+            r.chunks = static_cast<uint32_t>(s.chunkLists.size());
+            s.chunkLists.push_back(entry.chunks);
+        }
+        s.records.push_back(r);
+    }
+
+    void clear() { m_storage.reset(); }
+
+    /** True when both lists refer to the same storage, i.e. one is an unmodified copy of the other. */
+    bool sharesStorageWith(const WatchFileList& other) const
+    {
+        return m_storage && m_storage == other.m_storage;
+    }
+
+private:
+    static constexpr uint32_t kNone = std::numeric_limits<uint32_t>::max();
+    static constexpr qint64 kNoTime = std::numeric_limits<qint64>::min();
+    static constexpr uint32_t kRawDigest = 1;
+    static constexpr qsizetype kDigestBytes = 32;
+
+    struct Record {
+        uint32_t directory = kNone;
+        uint32_t nameOffset = 0;
+        uint32_t nameLength = 0;
+        uint32_t flags = 0;
+        std::array<unsigned char, kDigestBytes> digest{};
+        uint64_t sizeBytes = 0;
+        qint64 modifiedMs = kNoTime;
+        qint64 changedMs = kNoTime;
+        uint64_t inode = 0;
+        /** Index into otherHashes for a content hash that is not lowercase hex SHA-256. */
+        uint32_t otherHash = kNone;
+        uint32_t chunks = kNone;
+    };
+
+    struct Storage {
+        std::vector<Record> records;
+        std::vector<QString> directories;
+        QHash<QString, uint32_t> directoryIds;
+        QString names;
+        std::vector<QString> otherHashes;
+        std::vector<QList<WatchChunk>> chunkLists;
+    };
+
+    Storage& mutableStorage()
+    {
+        if (!m_storage) {
+            m_storage = std::make_shared<Storage>();
+        } else if (m_storage.use_count() > 1) {
+            m_storage = std::make_shared<Storage>(*m_storage);
+        }
+        return *m_storage;
+    }
+
+    /** A path as "<directory>/<name>", or just the name for top-level files. */
+    struct PathParts {
+        QStringView directory;
+        QStringView name;
+        bool hasDirectory = false;
+    };
+
+    static PathParts partsOf(const Storage& s, const Record& r)
+    {
+        PathParts parts;
+        parts.name = QStringView(s.names).mid(r.nameOffset, r.nameLength);
+        if (r.directory != kNone) {
+            parts.directory = QStringView(s.directories[r.directory]);
+            parts.hasDirectory = true;
+        }
+        return parts;
+    }
+
+    static QString pathOf(const Storage& s, const Record& r)
+    {
+        const PathParts parts = partsOf(s, r);
+        if (!parts.hasDirectory) {
+            return parts.name.toString();
+        }
+        QString path;
+        path.reserve(parts.directory.size() + 1 + parts.name.size());
+        path.append(parts.directory).append(QLatin1Char('/')).append(parts.name);
+        return path;
+    }
+
+    static QString contentHashOf(const Storage& s, const Record& r)
+    {
+        if (r.flags & kRawDigest) {
+            return HexEncoding::toString(r.digest.data(), r.digest.size());
+        }
+        return r.otherHash != kNone ? s.otherHashes[r.otherHash] : QString();
+    }
+
+    /** Fills @p out from a lowercase hex SHA-256; false for anything else. */
+    static bool parseDigest(const QString& hex, std::array<unsigned char, kDigestBytes>& out)
+    {
+        if (hex.size() != 2 * kDigestBytes) {
+            return false;
+        }
+        auto nibble = [](QChar c) -> int {
+            const char16_t u = c.unicode();
+            if (u >= u'0' && u <= u'9') return u - u'0';
+            if (u >= u'a' && u <= u'f') return u - u'a' + 10;
+            return -1;
+        };
+        for (qsizetype i = 0; i < kDigestBytes; ++i) {
+            const int hi = nibble(hex[2 * i]);
+            const int lo = nibble(hex[2 * i + 1]);
+            if (hi < 0 || lo < 0) {
+                return false;
+            }
+            out[static_cast<size_t>(i)] = static_cast<unsigned char>((hi << 4) | lo);
+        }
+        return true;
+    }
+
+    static qint64 timeToMs(const QDateTime& t) { return t.isValid() ? t.toMSecsSinceEpoch() : kNoTime; }
+    static QDateTime msToTime(qint64 ms)
+    {
+        return ms == kNoTime ? QDateTime() : QDateTime::fromMSecsSinceEpoch(ms, QTimeZone::utc());
+    }
+
+    std::shared_ptr<Storage> m_storage;
+};
+
+} // namespace FlashSpartan
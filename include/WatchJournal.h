@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+class QSocketNotifier;
+
+namespace FlashSpartan {
+
+/**
+ * @brief Change journal for the watch paths of mounted volumes (inotify; Linux only).
+ *
+ * Records which paths under a mount were touched while it stays mounted, so a later watch
+ * manifest verify only re-hashes those. The journal is only trusted from a clean point on:
+ * a verify or baseline that matched, started while the mount was already being watched.
+ * A queue overflow, a watch-limit failure or a moved watch root drops back to a full scan.
+ */
+class WatchJournal : public QObject {
+    Q_OBJECT
+
+public:
+    /** inotify needs one watch per directory; larger trees are not journaled. */
+    static constexpr int kMaxWatchesPerMount = 8192;
+
+    struct Snapshot {
+        /** False when the next verify must list and hash as if there were no journal. */
+        bool usable = false;
+        /** Touched paths relative to the canonical mount point, files and directories. */
+        QSet<QString> touchedPaths;
+    };
+
+    explicit WatchJournal(QObject* parent = nullptr);
+    ~WatchJournal() override;
+
+    static bool isSupported();
+
+    /**
+     * Starts journaling @p watchPaths (relative to @p mountPoint) and forgets any earlier
+     * state for the mount; the first verify after this is always a full one.
+     */
+    void watch(const QString& mountPoint, const QStringList& watchPaths);
+    void unwatch(const QString& mountPoint);
+    bool isWatching(const QString& mountPoint) const;
+
+    /**
+     * Paths touched since the last clean point, and starts collecting afresh for the verify
+     * or baseline build about to run. Pair with finish().
+     */
+    Snapshot begin(const QString& mountPoint);
+    /** @p clean: the job matched (or built) a baseline, so it becomes the next clean point. */
+    void finish(const QString& mountPoint, bool clean);
+
+private slots:
+    void onReadable();
+
+private:
+    struct Mount {
+        QString root;  // canonical mount point
+        QHash<int, QString> dirs;  // watch descriptor -> relative directory ("" = root)
+        QSet<int> shallow;  // parents of watched files; new subdirectories are not followed
+        QSet<QString> touched;
+        bool anchored = false;
+        bool overflowed = false;  // events lost since the last begin()
+        bool incomplete = false;  // part of the watch paths is not covered until watch() again
+    };
+
+    static bool coveredByParent(const Mount& mount, const QString& relativeDir);
+    bool addWatch(const QString& key, Mount& mount, const QString& relativeDir, bool recursive);
+    void addTree(const QString& key, Mount& mount, const QString& relativeDir);
+
+    int m_fd = -1;
+    QSocketNotifier* m_notifier = nullptr;
+    QHash<QString, Mount> m_mounts;  // by normalized mount point
+    QHash<int, QString> m_watchOwners;  // watch descriptor -> mount key
+};
+
+} // namespace FlashSpartan
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "Types.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include <memory>
+#include <optional>
+
+namespace FlashSpartan {
+
+/**
+ * Binary watch manifest ("FSMF"), kept out of line from the policy store.
+ *
+ * Little-endian and fixed-width throughout: a header, then the group table, the watch path
+ * and interned directory prefix tables, one fixed-size record per file (raw SHA-256, size and
+ * millisecond times), the content-defined chunk records of large files (v2) and a UTF-8
+ * string pool. Files of a group are sorted by the UTF-8 bytes of their path, so a lookup
+ * is a binary search over the mapped file without decoding it.
+ * Files are named after the SHA-256 of their contents; the signed device record stores
+ * that digest, which is what makes the file tamper-evident.
+ */
+class WatchManifestFile {
+public:
+    static constexpr quint32 kMagic = 0x464D5346;  // 'FSMF' little-endian
+    /** Written version; version 1 files (no chunk lists) still open. */
+    static constexpr quint16 kVersion = 2;
+
+    /** Empty when a content hash or root is not lowercase hex SHA-256. */
+    static QByteArray encode(const WatchManifest& manifest);
+    static std::optional<WatchManifest> decode(const QByteArray& data);
+
+    static QString pathFor(const QString& directory, const QString& sha256Hex);
+    /** Writes @p manifest into @p directory and returns its SHA-256 hex, or empty on failure. */
+    static QString save(const QString& directory, const WatchManifest& manifest,
+                        QString* error = nullptr);
+    /**
+     * Writes an encoded manifest received from elsewhere (fleet replication) as it is, if
+     * its SHA-256 is @p sha256Hex and it parses; re-encoding could change the digest.
+     */
+    static bool saveEncoded(const QString& directory, const QByteArray& data,
+                            const QString& sha256Hex, QString* error = nullptr);
+
+    /** Maps the file for @p sha256Hex; nullptr when missing, altered or malformed. */
+    static std::unique_ptr<WatchManifestFile> open(const QString& directory, const QString& sha256Hex);
+
+    int groupCount() const;
+    qsizetype fileCount(int group) const;
+    /** Entry of @p relativePath in @p group, by binary search over the mapping. */
+    std::optional<WatchFileEntry> find(int group, const QString& relativePath) const;
+    /** The whole manifest, decoded from the mapping. */
+    WatchManifest manifest() const;
+
+private:
+    WatchManifestFile() = default;
+
+    std::unique_ptr<QFile> m_file;
+    const uchar* m_data = nullptr;
+    qsizetype m_size = 0;
+};
+
+} // namespace FlashSpartan
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#include <cfgmgr32.h>
+#endif
+
+namespace FlashSpartan {
+
+#ifdef Q_OS_WIN
+
+/**
+ * Device-interface arrival/removal notifications (CM_Register_Notification) for one
+ * interface class. The callback runs on a system thread pool: it queues the interface path
+ * and sets @p wakeEvent, so a monitor thread can sleep in WaitForSingleObject() until
+ * something actually changed and then re-read only the devices named in take().
+ */
+class WinDeviceNotifier {
+public:
+    enum class Action {
+        Arrival,
+        Removal,
+    };
+
+    struct Event {
+        Action action = Action::Arrival;
+        QString interfacePath;  // \\?\USB#VID_...#...#{class guid}
+    };
+
+    WinDeviceNotifier(const GUID& interfaceClass, HANDLE wakeEvent);
+    ~WinDeviceNotifier();
+
+    WinDeviceNotifier(const WinDeviceNotifier&) = delete;
+    WinDeviceNotifier& operator=(const WinDeviceNotifier&) = delete;
+
+    /** False when registration failed; the caller should fall back to polling. */
+    bool isActive() const { return m_handle != nullptr; }
+
+    QList<Event> take();
+
+private:
+    static DWORD CALLBACK onNotification(HCMNOTIFICATION handle, PVOID context, CM_NOTIFY_ACTION action,
+                                         PCM_NOTIFY_EVENT_DATA data, DWORD size);
+
+    HCMNOTIFICATION m_handle = nullptr;
+    HANDLE m_wakeEvent = nullptr;
+    QMutex m_mutex;
+    QList<Event> m_events;
+};
+
+#endif
+
+} // namespace FlashSpartan
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QString>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#endif
+
+namespace FlashSpartan {
+
+#ifdef Q_OS_WIN
+
+/**
+ * Sequential reads of a raw disk or volume with several unbuffered (FILE_FLAG_NO_BUFFERING)
+ * overlapped ReadFile calls in flight, handed to the consumer strictly in offset order:
+ * the Windows counterpart of the io_uring loop in RawDeviceHash. The handle is reopened
+ * with ReOpenFile() so callers keep their synchronous handle. Buffers come from
+ * VirtualAlloc (page aligned) and are a multiple of kAlignment, as are all read offsets.
+ */
+class WinOverlappedReader {
+public:
+    static constexpr size_t kAlignment = 4096;
+
+    WinOverlappedReader(HANDLE source, int depth, size_t bufferSize);
+    ~WinOverlappedReader();
+
+    WinOverlappedReader(const WinOverlappedReader&) = delete;
+    WinOverlappedReader& operator=(const WinOverlappedReader&) = delete;
+
+    /** False (with @p error) when the device cannot be reopened unbuffered; use ReadFile then. */
+    bool open(QString* error);
+
+    /**
+     * Reads [@p offset, @p offset + @p length) and calls @p consume for each buffer in order.
+     * @p offset must be a multiple of kAlignment; a tail shorter than a sector is read whole
+     * and trimmed. When @p consume returns false, every read is reaped and false is
+     * returned with @p error untouched.
+     */
+    bool read(uint64_t offset, uint64_t length, const std::function<bool(const char*, size_t)>& consume,
+              QString* error);
+
+private:
+    struct Slot {
+        OVERLAPPED overlapped{};
+        char* buffer = nullptr;
+        uint64_t offset = 0;
+        size_t length = 0;    // bytes handed to the consumer
+        size_t request = 0;   // length rounded up to kAlignment
+        size_t filled = 0;
+        bool inFlight = false;
+    };
+
+    bool submit(Slot& slot, QString* error);
+    void cancelAll();
+
+    HANDLE m_source = nullptr;
+    HANDLE m_handle = INVALID_HANDLE_VALUE;
+    size_t m_bufferSize = 0;
+    std::vector<Slot> m_slots;
+};
+
+#endif
+
+} // namespace FlashSpartan
@@ -12,6 +12,7 @@ namespace FlashSpartan::WinStorage {
 
 QString normalizeVolumeRoot(const QString& path);
 QString volumeDevicePath(const QString& volumeRoot);
+/** Resolved once per volume and kept until invalidateVolumeCache(). */
 QString physicalDrivePathForVolume(const QString& volumeRoot);
 QString physicalDrivePathForDeviceNode(const QString& deviceNode);
 
@@ -29,9 +30,17 @@ bool ejectVolumeRoot(const QString& volumeRoot, bool force, QString* error);
 /** Lock and dismount a lettered volume without ejecting media (for raw disk reads). */
 bool dismountVolumeRootInPlace(const QString& volumeRoot, QString* error);
 
-/** Removable lettered volume or USB mass-storage (including drives reported as "fixed"). */
+/** Removable lettered volume or USB mass-storage (including drives reported as "fixed").
+ *  Drive type and bus type come from the same cached volume map as physicalDrivePathForVolume(). */
 bool isUsbFlashVolumeRoot(const QString& volumeRoot);
 
+/** Drop the cached volume-to-disk map; call when a volume arrives or is removed. Ejecting or
+ *  dismounting through this namespace drops it too. */
+void invalidateVolumeCache();
+
+/** GUID_DEVINTERFACE_VOLUME, for WinDeviceNotifier. */
+extern const GUID kVolumeInterfaceClass;
+
 #endif
 
 } // namespace FlashSpartan::WinStorage
@@ -5,6 +5,10 @@
 #include <QString>
 #include <QStringList>
 
+#ifdef Q_OS_WIN
+#include <qt_windows.h>
+#endif
+
 namespace FlashSpartan {
 
 struct UsbHostDeviceInfo {
@@ -23,8 +27,27 @@ struct UsbHostDeviceInfo {
 namespace WinUsbEnumerator {
 
 #ifdef Q_OS_WIN
-/** All present USB\ host nodes with tier classification (internal vs peripheral). */
+/** All present USB\ host nodes with tier classification (internal vs peripheral).
+ *  Only the ID list is read on every call; node properties come from a cache keyed by
+ *  instance ID and are re-read when the node's status changes. */
 QList<UsbHostDeviceInfo> enumeratePresentUsbDevices();
+
+/** Forget cached node properties, so the next enumeration reads them all again. */
+void invalidateDescriptions();
+
+/** GUID_DEVINTERFACE_USB_DEVICE, for WinDeviceNotifier. */
+extern const GUID kUsbDeviceInterfaceClass;
+
+/** USB\VID_..\SERIAL from a \\?\USB#VID_..#SERIAL#{guid} interface path (also after removal). */
+QString instanceIdFromInterfacePath(const QString& interfacePath);
+
+/** @p instanceId and its present USB\ descendants (composite interfaces), as in
+ *  enumeratePresentUsbDevices(), without walking the rest of the device tree. Always reads
+ *  properties afresh and updates the cache. */
+QList<UsbHostDeviceInfo> describeDeviceTree(const QString& instanceId);
+
+/** Cheap presence check (no property reads). */
+bool isPresent(const QString& instanceId);
 #endif
 
 } // namespace WinUsbEnumerator
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <openssl/evp.h>
+
+namespace FlashSpartan::RawDeviceHash {
+
+/**
+ * XXH3-128 (libxxhash) exposed as an EVP_MD so every existing EVP_Digest* loop —
+ * sequential, pipelined, io_uring, chunked and parallel — can drive it unchanged.
+ * Output is the 16-byte canonical (big-endian) XXH128 value. Returns nullptr when
+ * built without libxxhash.
+ *
+ * Not cryptographic: only use it as a fast pre-screen in front of a real digest.
+ */
+const EVP_MD* xxh3_128Digest();
+
+} // namespace FlashSpartan::RawDeviceHash
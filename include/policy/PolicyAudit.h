@@ -1,17 +1,21 @@
 #pragma once
 
+#include <QByteArray>
 #include <QString>
 
 namespace FlashSpartan::Policy {
 
-/** Append-only audit trail written only by the policy engine / daemon. */
+/**
+ * Append-only audit trail written only by the policy engine / daemon, through the shared
+ * AuditWriter (batched, synced within AuditWriter::kSyncIntervalMs).
+ */
 class PolicyAudit {
 public:
     static void append(const QString& actor, const QString& action,
                        const QString& targetId, const QString& detail = {});
 
 private:
-    static void appendLine(const QString& jsonLine);
+    static void appendLine(const QByteArray& jsonLine, const QString& targetId);
 };
 
 } // namespace FlashSpartan::Policy
@@ -6,14 +6,60 @@
 
 namespace FlashSpartan::Policy {
 
-/** Signed custom on-disk format (not JSON). */
+/**
+ * Signed custom on-disk format (not JSON).
+ *
+ * Version 3 is laid out to be read in place (PolicyBlobView): a header and section table
+ * signed as a whole, then the sections, each with its own HMAC in the table. Devices are an
+ * index of fixed-size entries sorted by unique id, the ids in a string pool, and the
+ * records themselves; blocks follow. Each record is a zstd frame of its JSON where that is
+ * smaller, compressed against a dictionary trained on the store's records (its own
+ * section), so a lookup still inflates one record. Version 2 is the same layout with every
+ * record raw, and version 1 stores (one HMAC over a length-prefixed record stream) are
+ * still read; both are rewritten as version 3 at the next save.
+ */
 class PolicyBlobCodec {
 public:
     static constexpr quint32 kMagic = 0x31505346; // 'FSP1' little-endian
-    static constexpr quint16 kVersion = 1;
+    static constexpr quint16 kVersion = 3;
+    static constexpr quint16 kRawRecordsVersion = 2;
+    static constexpr quint16 kLegacyVersion = 1;
+    static constexpr int kSignatureBytes = 32;
 
-    static QByteArray encode(const PolicySnapshot& snapshot);
-    static bool decode(const QByteArray& fileBytes, PolicySnapshot& out, QString* error = nullptr);
+    enum SectionKind : quint32 {
+        DeviceIndex = 1,
+        IdStrings = 2,
+        DeviceRecords = 3,
+        Blocks = 4,
+        /** Optional: absent when the records were compressed without one, or not at all. */
+        RecordDictionary = 5,
+    };
+    /** u32 kind, u32 count, u64 offset, u64 length, HMAC. */
+    static constexpr int kSectionEntryBytes = 24 + kSignatureBytes;
+    /**
+     * u32 id offset, u32 id length, u64 record offset, u32 record length, u32 raw length:
+     * the JSON length of a compressed record, 0 for one stored raw (always, in version 2).
+     */
+    static constexpr int kIndexEntryBytes = 24;
+    /** u32 magic, u16 version, u16 section count. */
+    static constexpr int kHeaderBytes = 8;
+
+    /** A complete version 3 store file; @p signature receives its header HMAC. */
+    static QByteArray encode(const PolicySnapshot& snapshot, const QByteArray& key,
+                             QByteArray* signature = nullptr);
+    /** Any version; an empty @p key means loadOrCreateKey(). */
+    static bool decode(const QByteArray& fileBytes, PolicySnapshot& out, QString* error = nullptr,
+                       const QByteArray& key = {});
+    /** The HMAC that names @p fileBytes; empty when the header is not recognised. */
+    static QByteArray signatureOf(const QByteArray& fileBytes);
+    /** Version from the header, 0 when @p header is not a policy store. */
+    static quint16 versionOf(const QByteArray& header);
+    /** Whether PolicyBlobView reads @p version in place (2 and 3). */
+    static bool isViewVersion(quint16 version) { return version == kVersion || version == kRawRecordsVersion; }
+
+    /** One record or block as stored in either version. */
+    static DeviceRecord decodeDevice(const QByteArray& blob);
+    static BlockedDriveEntry decodeBlock(const QByteArray& blob);
 
     static QByteArray sign(const QByteArray& payload, const QByteArray& key);
     static bool verify(const QByteArray& payload, const QByteArray& signature, const QByteArray& key);
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "PolicySnapshot.h"
+#include "StoreCompression.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace FlashSpartan::Policy {
+
+/**
+ * Read-only view of a v2 or v3 policy store (see PolicyBlobCodec), usually mmap'ed. Opening
+ * checks the header, the section table and the index and string-pool sections; the
+ * record, dictionary and block sections are checked the first time they are read. A lookup
+ * is a binary search over the fixed-size index and inflates and decodes one record.
+ */
+class PolicyBlobView {
+public:
+    /** Maps the store at @p path. nullptr when it is not a valid v2/v3 store signed with @p key. */
+    static std::unique_ptr<PolicyBlobView> open(const QString& path, const QByteArray& key,
+                                                QString* error = nullptr);
+    /** The same over bytes already in memory; the view keeps a reference to them. */
+    static std::unique_ptr<PolicyBlobView> fromBytes(const QByteArray& fileBytes,
+                                                     const QByteArray& key,
+                                                     QString* error = nullptr);
+
+    /** The header HMAC, which covers every section's HMAC and so names the whole file. */
+    QByteArray signature() const;
+    int deviceCount() const { return static_cast<int>(m_deviceCount); }
+    std::optional<DeviceRecord> device(const QString& uniqueId, QString* error = nullptr) const;
+    /** Decodes every record (in id order) and block into @p out. */
+    bool read(PolicySnapshot& out, QString* error = nullptr) const;
+
+private:
+    struct Section {
+        quint32 kind = 0;
+        quint32 count = 0;
+        quint64 offset = 0;
+        quint64 length = 0;
+        QByteArray hmac;
+    };
+
+    PolicyBlobView() = default;
+    bool parse(QString* error);
+    bool sectionValid(const Section& section) const;
+    bool recordsValid(QString* error) const;
+    QByteArray indexedId(quint32 i) const;
+    /** @p decoder: a copy of m_decoder owned by the calling thread. */
+    std::optional<DeviceRecord> recordAt(quint32 i, StoreCompression::Decoder& decoder,
+                                         QString* error) const;
+
+    QFile m_file;
+    QByteArray m_bytes;  // when not mapped
+    const uchar* m_data = nullptr;
+    qint64 m_size = 0;
+    QByteArray m_key;
+    QByteArray m_signature;
+    Section m_index;
+    Section m_strings;
+    Section m_records;
+    Section m_blocks;
+    Section m_dictionary;
+    quint32 m_deviceCount = 0;
+    mutable std::once_flag m_recordsChecked;
+    mutable bool m_recordsOk = false;
+    /** Holds the digested dictionary once the records are checked; copied per lookup. */
+    mutable std::unique_ptr<StoreCompression::Decoder> m_decoder;
+};
+
+} // namespace FlashSpartan::Policy
@@ -1,6 +1,12 @@
 #pragma once
 
 #include "policy/PolicyGateway.h"
+#include "policy/PolicyProtocol.h"
+
+#include <QLocalSocket>
+#include <QMutex>
+
+#include <utility>
 
 namespace FlashSpartan::Policy {
 
@@ -11,11 +17,16 @@ public:
     bool load(QString* error = nullptr) override;
     bool reload(QString* error = nullptr) override;
     PolicySnapshot snapshot() const override;
+    PolicyDelta changesSince(quint64 epoch, quint64 generation) const override;
 
     bool upsertDevice(const DeviceRecord& record, const QString& actor,
                       const QString& reason) override;
     bool removeDevice(const QString& uniqueId, const QString& actor,
                       const QString& reason) override;
+    bool upsertDevices(const QList<DeviceRecord>& records, const QString& actor,
+                       const QString& reason) override;
+    int removeDevices(const QStringList& uniqueIds, const QString& actor,
+                      const QString& reason) override;
     bool clearDevices(const QString& actor, const QString& reason) override;
     bool blockDrive(const QString& driveKey, const QString& uniqueId, const QString& label,
                     const QString& actor) override;
@@ -28,10 +39,34 @@ public:
 
     bool ping(QString* error = nullptr) const;
 
+protected:
+    /** Holds a Subscribe connection open, reconnecting (and resuming) if policyd restarts. */
+    void startChangeFeed() override;
+
 private:
-    QJsonObject request(const QJsonObject& req, QString* error = nullptr) const;
+    void readFeed();
+    void scheduleFeedReconnect();
+
+    using Call = std::pair<PolicyProtocol::FrameType, PolicyProtocol::Request>;
+
+    PolicyProtocol::Reply request(PolicyProtocol::FrameType type, const PolicyProtocol::Request& req,
+                                  QString* error = nullptr) const;
+    /**
+     * Writes @p calls back to back on the persistent connection, then reads their replies
+     * in order. On failure every reply has ok = false.
+     */
+    QList<PolicyProtocol::Reply> exchange(QList<Call> calls, QString* error = nullptr) const;
 
     QString m_socketPath;
+    mutable QMutex m_connectionMutex;
+    /** Reused by the thread that opened it; other threads get a one-shot socket. */
+    mutable std::unique_ptr<QLocalSocket> m_connection;
+    mutable quint32 m_nextRequestId = 0;
+    std::unique_ptr<QLocalSocket> m_feed;
+    QByteArray m_feedBuffer;
+    bool m_feedRetryPending = false;
+    quint64 m_feedEpoch = 0;
+    quint64 m_feedGeneration = 0;
 };
 
 } // namespace FlashSpartan::Policy
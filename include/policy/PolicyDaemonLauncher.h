@@ -4,7 +4,10 @@
 
 namespace FlashSpartan::Policy {
 
-/** Ensures flashspartan-policyd is running and socket is reachable. */
+/**
+ * Ensures flashspartan-policyd is running and socket is reachable. Under systemd the socket
+ * unit starts it on the first connection; otherwise it is started here.
+ */
 class PolicyDaemonLauncher {
 public:
     static bool ensureRunning(QString* error = nullptr);
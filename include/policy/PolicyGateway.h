@@ -6,6 +6,7 @@
 #include <functional>
 #include <memory>
 #include <optional>
+#include <vector>
 
 namespace FlashSpartan::Policy {
 
@@ -20,11 +21,22 @@ public:
     virtual bool reload(QString* error = nullptr) = 0;
 
     virtual PolicySnapshot snapshot() const = 0;
+    /**
+     * Records changed after (@p epoch, @p generation), as returned in an earlier delta.
+     * Unknown or stale bases (0, 0 included) get a full copy.
+     */
+    virtual PolicyDelta changesSince(quint64 epoch, quint64 generation) const = 0;
 
     virtual bool upsertDevice(const DeviceRecord& record, const QString& actor,
                               const QString& reason) = 0;
     virtual bool removeDevice(const QString& uniqueId, const QString& actor,
                               const QString& reason) = 0;
+    /** Bulk edits: one round-trip and one store commit for all of @p records / @p uniqueIds. */
+    virtual bool upsertDevices(const QList<DeviceRecord>& records, const QString& actor,
+                               const QString& reason) = 0;
+    /** Returns how many records were removed, or -1 on failure. */
+    virtual int removeDevices(const QStringList& uniqueIds, const QString& actor,
+                              const QString& reason) = 0;
     virtual bool clearDevices(const QString& actor, const QString& reason) = 0;
     virtual bool blockDrive(const QString& driveKey, const QString& uniqueId,
                             const QString& label, const QString& actor) = 0;
@@ -35,8 +47,26 @@ public:
     virtual int importJson(const QString& path, bool merge, const QString& actor,
                            QString* error = nullptr) = 0;
 
+    using ChangeListener = std::function<void(const PolicyDelta& delta)>;
+
+    /**
+     * Calls @p listener with each change to the store, queued to the event loop of the
+     * thread that added the first listener. Through policyd that covers every client;
+     * in-process it covers this process only. Deltas overlap a caller's own writes, so
+     * applying one must be idempotent.
+     */
+    void addChangeListener(ChangeListener listener);
+
     static std::unique_ptr<PolicyGateway> createDefault();
     static std::unique_ptr<PolicyGateway> createInProcess(const QString& storePath = {});
+
+protected:
+    /** Called once, when the first listener is added. */
+    virtual void startChangeFeed() {}
+    void publishChange(const PolicyDelta& delta) const;
+
+private:
+    std::vector<ChangeListener> m_listeners;
 };
 
 } // namespace FlashSpartan::Policy
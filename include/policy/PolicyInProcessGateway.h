@@ -3,6 +3,9 @@
 #include "policy/PolicyGateway.h"
 #include "policy/PolicyStoreEngine.h"
 
+#include <QMutex>
+#include <QObject>
+
 namespace FlashSpartan::Policy {
 
 class PolicyInProcessGateway : public PolicyGateway {
@@ -12,11 +15,16 @@ public:
     bool load(QString* error = nullptr) override;
     bool reload(QString* error = nullptr) override;
     PolicySnapshot snapshot() const override;
+    PolicyDelta changesSince(quint64 epoch, quint64 generation) const override;
 
     bool upsertDevice(const DeviceRecord& record, const QString& actor,
                       const QString& reason) override;
     bool removeDevice(const QString& uniqueId, const QString& actor,
                       const QString& reason) override;
+    bool upsertDevices(const QList<DeviceRecord>& records, const QString& actor,
+                       const QString& reason) override;
+    int removeDevices(const QStringList& uniqueIds, const QString& actor,
+                      const QString& reason) override;
     bool clearDevices(const QString& actor, const QString& reason) override;
     bool blockDrive(const QString& driveKey, const QString& uniqueId, const QString& label,
                     const QString& actor) override;
@@ -29,8 +37,18 @@ public:
 
     PolicyStoreEngine& engine() { return m_engine; }
 
+protected:
+    void startChangeFeed() override;
+
 private:
+    /** Queues what this gateway's last call changed to the listeners. */
+    void queueChange();
+
     PolicyStoreEngine m_engine;
+    std::unique_ptr<QObject> m_feedContext;
+    QMutex m_feedMutex;
+    quint64 m_feedEpoch = 0;
+    quint64 m_feedGeneration = 0;
 };
 
 } // namespace FlashSpartan::Policy
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Types.h"
+
+#include <QList>
+#include <QString>
+
+#include <functional>
+
+namespace FlashSpartan::Policy {
+
+class PolicyStoreEngine;
+
+/**
+ * Policy JSON export/import one record at a time. Two layouts are read and written: the
+ * classic document ({"version": "1.0", "devices": [...]}) and, for a path ending in
+ * ".jsonl", JSON lines (a header line, then one compact record per line). Neither side
+ * holds more than one record's JSON plus a write buffer.
+ */
+class PolicyJsonStream {
+public:
+    static constexpr int kImportBatch = 256;
+    static constexpr qsizetype kWriteChunkBytes = 1024 * 1024;
+    static constexpr qsizetype kMaxRecordBytes = 64 * 1024 * 1024;
+
+    static bool write(const QString& path, const QList<DeviceRecord>& devices, bool prettyPrint,
+                      QString* error = nullptr);
+    /**
+     * Hands @p batch up to kImportBatch records at a time, in file order; records without a
+     * unique id are skipped. Stops when @p batch returns false. Returns the records handed
+     * over in accepted batches, or -1 when the file cannot be read or parsed.
+     */
+    static int read(const QString& path, const std::function<bool(const QList<DeviceRecord>&)>& batch,
+                    QString* error = nullptr);
+    /**
+     * Imports @p path into @p engine in kImportBatch upserts. Without @p merge the store is
+     * cleared first, but only once the file has yielded a batch or turned out empty, so an
+     * unreadable file leaves it as it was. Returns the records imported, or -1.
+     */
+    static int importInto(PolicyStoreEngine& engine, const QString& path, bool merge,
+                          const QString& actor, QString* error = nullptr);
+};
+
+} // namespace FlashSpartan::Policy
@@ -14,6 +14,10 @@ public:
     static QString legacyDevicesJsonPath();
     static QString legacyBlockedJsonPath();
     static QString socketPath();
+    /** Fleet replication settings for policyd; absent means replication is off. */
+    static QString replicationConfigPath();
+    /** Out-of-line watch manifest files (WatchManifestFile), named by their SHA-256. */
+    static QString watchManifestDirectory();
 };
 
 } // namespace FlashSpartan::Policy
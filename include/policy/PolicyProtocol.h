@@ -0,0 +1,98 @@
+#pragma once
+
+#include "PolicySnapshot.h"
+
+#include <QByteArray>
+#include <QString>
+
+namespace FlashSpartan::Policy::PolicyProtocol {
+
+/**
+ * Framed stream spoken between PolicyDaemonClient and flashspartan-policyd.
+ *
+ * Frame: u8 type, u32 payload length, payload (little-endian, QDataStream-encoded), the
+ * same layout as HelperProtocol. A connection stays open for any number of requests;
+ * a client may pipeline several before reading, and each Reply echoes its request's id
+ * in order. A Subscribe connection is listen-only from then on: the daemon pushes an
+ * Event after every mutation, from any client. Device records travel as CBOR. Changes and Events carry only
+ * what moved after the client's (epoch, generation), so a routine sync costs a few bytes.
+ */
+inline constexpr quint16 kVersion = 2;
+inline constexpr int kHeaderBytes = 5;
+inline constexpr quint32 kMaxPayloadBytes = 256 * 1024 * 1024;
+
+enum class FrameType : quint8 {
+    Ping = 1,
+    Load = 2,
+    Reload = 3,
+    Changes = 4,       // epoch, generation -> Reply with a PolicyDelta
+    UpsertDevice = 5,
+    RemoveDevice = 6,
+    ClearDevices = 7,
+    BlockDrive = 8,
+    UnblockDrive = 9,
+    ExportJson = 10,
+    ImportJson = 11,
+    Reply = 12,        // daemon -> client, ends the connection
+    Subscribe = 13,    // epoch, generation -> an Event now, then one per mutation
+    Event = 14,        // daemon -> subscriber: a Reply whose delta follows the previous Event
+    UpsertMany = 15,   // records -> one store commit
+    RemoveMany = 16,   // uniqueIds -> one store commit; count = records removed
+    // Fleet replication only (PolicyReplicator):
+    FetchManifests = 17,  // uniqueIds holds watch manifest digests -> one Manifest frame each
+    Manifest = 18,        // an out-of-line watch manifest file, see encodeManifest()
+};
+
+struct Frame {
+    FrameType type = FrameType::Ping;
+    QByteArray payload;
+};
+
+/** Every request frame's payload; each op reads the fields it needs. */
+struct Request {
+    quint32 id = 0;
+    QString actor;
+    QString reason;
+    QString uniqueId;
+    QString driveKey;
+    QString label;
+    QString path;
+    /** ExportJson: pretty-print; ImportJson: merge. */
+    bool flag = false;
+    quint64 epoch = 0;
+    quint64 generation = 0;
+    bool hasRecord = false;
+    DeviceRecord record;
+    QList<DeviceRecord> records;
+    QStringList uniqueIds;
+};
+
+struct Reply {
+    /** The Request::id answered; 0 for Events. */
+    quint32 id = 0;
+    bool ok = false;
+    QString error;
+    qint32 count = -1;
+    bool hasDelta = false;
+    PolicyDelta delta;
+};
+
+QByteArray encodeFrame(FrameType type, const QByteArray& payload = {});
+
+/**
+ * Removes one complete frame from the front of @p buffer. Returns false while the frame
+ * is still incomplete, or with @p error set when the header is malformed.
+ */
+bool takeFrame(QByteArray& buffer, Frame* out, QString* error = nullptr);
+
+QByteArray encodeRequest(const Request& request);
+bool decodeRequest(const QByteArray& payload, Request* out);
+
+QByteArray encodeReply(const Reply& reply);
+bool decodeReply(const QByteArray& payload, Reply* out);
+
+/** A WatchManifestFile named by its SHA-256 @p digest; @p data is empty when the peer lacks it. */
+QByteArray encodeManifest(const QString& digest, const QByteArray& data);
+bool decodeManifest(const QByteArray& payload, QString* digest, QByteArray* data);
+
+} // namespace FlashSpartan::Policy::PolicyProtocol
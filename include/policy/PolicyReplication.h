@@ -0,0 +1,148 @@
+#pragma once
+
+#include "PolicySnapshot.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+namespace FlashSpartan::Policy {
+
+class PolicyStoreEngine;
+
+namespace PolicyReplication {
+
+/**
+ * Fleet replication between flashspartan-policyd instances (PolicyReplicator moves the
+ * bytes). Every daemon serves its store's changes to the peers that follow it, and
+ * follows the peers it is configured with: a follower subscribes with its last (epoch,
+ * generation) and receives the same PolicyDelta events local subscribers get, so a kiosk
+ * that was offline catches up with one delta rather than a copy of the store.
+ *
+ * Records arriving from a peer are merged field by field with the local one (see
+ * mergeRecord()), so two kiosks editing the same device settle on the same record in
+ * either order. Removals and block changes are replayed as the peer made them; a full
+ * resync (first contact, or the peer's store was reloaded or cleared) only merges.
+ *
+ * Records refer to their watch manifest files by digest; a follower fetches the files it
+ * lacks over the same connection before it applies the event.
+ *
+ * Messages are HMAC-SHA256 authenticated with a fleet key; they are not encrypted.
+ */
+
+/**
+ * replication.json: {"listen_port": N, "peers": ["host:port", ...],
+ * "baseline_servers": ["host:port", ...], "key": "hex"}.
+ */
+struct Config {
+    quint16 listenPort = 0;
+    QStringList peers;
+    /** Followed in PeerMode::Baselines; any policyd with a listen port can be one. */
+    QStringList baselineServers;
+    /** Shared by the whole fleet; at least kMinKeyBytes. */
+    QByteArray key;
+
+    bool isEnabled() const
+    {
+        return !key.isEmpty() && (listenPort != 0 || !peers.isEmpty() || !baselineServers.isEmpty());
+    }
+};
+
+inline constexpr int kMinKeyBytes = 16;
+inline constexpr int kNonceBytes = 16;
+inline constexpr int kTagBytes = 32;
+
+/**
+ * Reads @p path (PolicyPaths::replicationConfigPath() when empty). A missing file is a
+ * disabled config, not an error; a malformed one or a short key fails with @p error set.
+ */
+bool loadConfig(Config* out, QString* error = nullptr, const QString& path = {});
+
+/** Which way a sealed message travels; part of what the tag covers. */
+enum class Direction : quint8 {
+    ToLeader = 1,    // follower -> the peer it follows
+    ToFollower = 2,  // leader -> follower
+};
+
+/**
+ * Sealed message: u32 length (little-endian), 32-byte HMAC-SHA256 tag, then a
+ * PolicyProtocol frame. The tag covers the follower's per-connection @p nonce, the
+ * message's sequence number on that connection and its direction, so frames can't be
+ * replayed into another connection, reordered or reflected.
+ */
+QByteArray seal(const QByteArray& key, const QByteArray& nonce, quint64 seq, Direction direction,
+                const QByteArray& frame);
+
+/**
+ * Removes one sealed message from the front of @p buffer. Returns false while it is
+ * still incomplete, or with @p error set when it is oversized or its tag doesn't match.
+ */
+bool unseal(QByteArray& buffer, const QByteArray& key, const QByteArray& nonce, quint64 seq,
+            Direction direction, QByteArray* frame, QString* error = nullptr);
+
+/**
+ * The record both sides agree on, whichever arrives first:
+ *  - trust level, auto-mount, notes and verification profile from the later
+ *    policyChangedAt; on a tie the lower trust level, then auto-mount off, then the
+ *    side that sorts first;
+ *  - the baseline (hash, block and prescreen digests, watch manifest) from the later
+ *    lastHashed; on a tie the smaller hash;
+ *  - the earliest firstSeen, the latest lastSeen, and lastKnownInfo with the latter;
+ *  - buffer tuning, read profile and capacity check stay local: they describe this host's
+ *    ports. The peer's fill them only where the local record has none.
+ */
+DeviceRecord mergeRecord(const DeviceRecord& local, const DeviceRecord& incoming);
+
+/**
+ * @p local with the baseline of @p incoming (hash, block and prescreen digests, watch
+ * manifest) when that one is newer by lastHashed; trust and everything else stay local.
+ */
+DeviceRecord mergeBaseline(const DeviceRecord& local, const DeviceRecord& incoming);
+
+struct BlockChanges {
+    QList<BlockedDriveEntry> blocked;
+    QList<BlockedDriveEntry> unblocked;
+};
+
+/** What a peer blocked and unblocked between two of its complete block lists. */
+BlockChanges diffBlocks(const QList<BlockedDriveEntry>& before, const QList<BlockedDriveEntry>& after);
+
+enum class PeerMode {
+    /** Both stores are one policy: records merge, removals and blocks are replayed. */
+    Full,
+    /**
+     * A fleet baseline service: records this store lacks are taken whole, so a stick's
+     * first visit here verifies against the fleet's baseline instead of hashing from
+     * scratch; records it has only take newer baselines. Nothing is removed or blocked.
+     */
+    Baselines,
+};
+
+/**
+ * Digests of the out-of-line watch manifests (WatchManifestFile) and block digest lists
+ * (BlockHashFile) that records in @p delta refer to and @p directory lacks; they are fetched
+ * before the delta is applied. A list shared by many records is fetched once.
+ */
+QStringList missingManifests(const PolicyDelta& delta, const QString& directory);
+
+/** What a follower knows of the peer it follows; in memory, so a restart resyncs in full. */
+struct PeerCursor {
+    quint64 epoch = 0;
+    quint64 generation = 0;
+    /** The peer's block list as of the last delta; diffed against the next one. */
+    QList<BlockedDriveEntry> blocks;
+    bool hasBlocks = false;
+};
+
+/**
+ * Applies one event of @p peer to @p engine and advances @p cursor. Records equal to the
+ * local ones after merging are skipped, so changes don't echo back and forth. Returns how
+ * many mutations were committed, or -1 when the store could not be saved.
+ */
+int applyDelta(PolicyStoreEngine& engine, const PolicyDelta& delta, PeerCursor& cursor,
+               const QString& peer, PeerMode mode = PeerMode::Full);
+
+} // namespace PolicyReplication
+
+} // namespace FlashSpartan::Policy
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "PolicyReplication.h"
+
+#include <QHash>
+#include <QSet>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace FlashSpartan::Policy {
+
+class PolicyStoreEngine;
+
+/**
+ * The network side of PolicyReplication, run by flashspartan-policyd on its event loop.
+ * Listens for followers on Config::listenPort and follows every Config::peers entry (and
+ * every Config::baselineServers entry, baselines only), reconnecting after kReconnectMs
+ * when a peer goes away.
+ *
+ * A follower connects, sends kNonceBytes of fresh randomness, then a sealed Subscribe with
+ * its cursor; the leader answers with sealed Events as its store changes. When an event
+ * refers to watch manifest files the follower lacks, it sends FetchManifests and applies
+ * the event (and any queued behind it) once the Manifest frames are in. Since the nonce
+ * is the follower's, a recorded stream from an earlier connection fails authentication.
+ */
+class PolicyReplicator {
+public:
+    static constexpr int kReconnectMs = 5000;
+    /** A connection that has not subscribed by then is dropped. */
+    static constexpr int kHandshakeTimeoutMs = 10000;
+
+    PolicyReplicator(PolicyStoreEngine& engine, PolicyReplication::Config config);
+    ~PolicyReplicator();
+
+    PolicyReplicator(const PolicyReplicator&) = delete;
+    PolicyReplicator& operator=(const PolicyReplicator&) = delete;
+
+    bool start(QString* error = nullptr);
+
+    /** Sends followers what changed since their last event; call after every local commit. */
+    void notify();
+
+    /** Runs after a peer's changes were committed here, e.g. to tell local subscribers. */
+    void setAppliedHandler(std::function<void()> handler) { m_applied = std::move(handler); }
+
+private:
+    struct Follower {
+        QByteArray buffer;
+        QByteArray nonce;
+        bool subscribed = false;
+        quint64 recvSeq = 0;
+        quint64 sendSeq = 0;
+        quint64 epoch = 0;
+        quint64 generation = 0;
+    };
+
+    struct Leader {
+        QString name;  // host:port, as configured
+        QString host;
+        quint16 port = 0;
+        PolicyReplication::PeerMode mode = PolicyReplication::PeerMode::Full;
+        QTcpSocket socket;
+        QTimer reconnect;
+        QByteArray buffer;
+        QByteArray nonce;
+        quint64 recvSeq = 0;
+        quint64 sendSeq = 0;
+        PolicyReplication::PeerCursor cursor;
+        /** Events not applied yet, oldest first; the first may wait for awaiting. */
+        QList<PolicyDelta> pending;
+        QSet<QString> awaiting;
+        bool fetched = false;  // the first pending event's manifests were requested
+    };
+
+    void onNewConnection();
+    void readFollower(QTcpSocket* socket);
+    void pushTo(QTcpSocket* socket, Follower& follower, bool evenIfEmpty);
+    void sendManifests(QTcpSocket* socket, Follower& follower, const QStringList& digests);
+    void addLeader(const QString& peer, PolicyReplication::PeerMode mode);
+    void connectLeader(Leader& leader);
+    void readLeader(Leader& leader);
+    /** Applies pending events up to one that waits for manifests; false on a store error. */
+    bool applyPending(Leader& leader, bool* applied);
+
+    PolicyStoreEngine& m_engine;
+    PolicyReplication::Config m_config;
+    QTcpServer m_server;
+    QHash<QTcpSocket*, Follower> m_followers;
+    std::vector<std::unique_ptr<Leader>> m_leaders;
+    std::function<void()> m_applied;
+};
+
+} // namespace FlashSpartan::Policy
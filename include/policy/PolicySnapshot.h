@@ -4,6 +4,7 @@
 #include "Types.h"
 
 #include <QList>
+#include <QStringList>
 
 namespace FlashSpartan::Policy {
 
@@ -11,6 +12,28 @@ namespace FlashSpartan::Policy {
 struct PolicySnapshot {
     QList<DeviceRecord> devices;
     QList<BlockedDriveEntry> blocks;
+    /** Random per load of the store; generations only compare within one epoch. */
+    quint64 epoch = 0;
+    /** Bumped by every mutation. */
+    quint64 generation = 0;
+};
+
+/** What changed after a known (epoch, generation); see PolicyGateway::changesSince(). */
+struct PolicyDelta {
+    quint64 epoch = 0;
+    quint64 generation = 0;
+    /** The base was unknown or too old: @ref devices is every record, replace, don't merge. */
+    bool full = false;
+    QList<DeviceRecord> devices;
+    QStringList removedIds;
+    /** @ref blocks is the complete block list (always set when @ref full). */
+    bool blocksChanged = false;
+    QList<BlockedDriveEntry> blocks;
+
+    bool isEmpty() const
+    {
+        return !full && devices.isEmpty() && removedIds.isEmpty() && !blocksChanged;
+    }
 };
 
 } // namespace FlashSpartan::Policy
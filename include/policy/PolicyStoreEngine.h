@@ -1,16 +1,22 @@
 #pragma once
 
 #include "PolicySnapshot.h"
+#include "PolicyWal.h"
 
 #include "Types.h"
 
+#include <QHash>
 #include <QReadWriteLock>
+#include <QThread>
+
+#include <memory>
 #include <QString>
 
 namespace FlashSpartan::Policy {
 
 /**
- * Private in-process policy store (custom signed blob).
+ * Private in-process policy store (custom signed blob plus its write-ahead log).
+ * Mutations are appended to the log; the blob is rewritten only at checkpoints.
  * Only PolicyGateway / policyd should use this class.
  */
 class PolicyStoreEngine {
@@ -18,27 +24,76 @@ public:
   explicit PolicyStoreEngine(QString storePath = {});
 
     bool load(QString* error = nullptr);
+    /** Checkpoint: rewrites the blob and starts an empty log. */
     bool save(QString* error = nullptr);
 
     PolicySnapshot snapshot() const;
+    /**
+     * The current state, immutable and shared: readers between two mutations get the same
+     * copy through an atomic pointer, without taking the store lock.
+     */
+    std::shared_ptr<const PolicySnapshot> sharedSnapshot() const;
     void setSnapshot(const PolicySnapshot& snap);
+    PolicyDelta changesSince(quint64 epoch, quint64 generation) const;
 
     bool migrateLegacyJsonIfNeeded(QString* error = nullptr);
 
-    // Mutations (audit + save)
+    // Mutations (logged, then audited)
     bool upsertDevice(const DeviceRecord& record, const QString& actor, const QString& reason);
     bool removeDevice(const QString& uniqueId, const QString& actor, const QString& reason);
+    /** Batches: one audit line per record, one log append. */
+    bool upsertDevices(const QList<DeviceRecord>& records, const QString& actor, const QString& reason);
+    /** Returns how many records were removed, or -1 when the store could not be saved. */
+    int removeDevices(const QStringList& uniqueIds, const QString& actor, const QString& reason);
     bool clearDevices(const QString& actor, const QString& reason);
     bool blockDrive(const QString& driveKey, const QString& uniqueId, const QString& label,
                     const QString& actor);
     bool unblockDrive(const QString& driveKey, const QString& uniqueId, const QString& actor);
 
+    /**
+     * Group commit: until commitGroup(), mutations made on the calling thread are logged
+     * without their own fdatasync, and return true once written. commitGroup() makes the
+     * whole group durable with one sync; callers report success only after it.
+     */
+    void beginGroupCommit();
+    bool commitGroup();
+
 private:
-    bool commitMutation(const QString& actor, const QString& action, const QString& target,
-                        const QString& detail);
+    /**
+     * Applies @p mutations (skipping no-ops), logs them and writes one audit line per target;
+     * with no @p targets, per applied mutation. Returns how many applied, or -1 if not persisted.
+     */
+    int commit(const QList<PolicyMutation>& mutations, const QString& actor, const QString& action,
+               QStringList targets, const QString& detail);
+    /** The write lock is held by the caller of the *Locked() helpers. False when @p m is a no-op. */
+    bool applyLocked(const PolicyMutation& m);
+    /** Sets @p record's policyChangedAt to now when it changes the stored policy decisions. */
+    void stampPolicyChangeLocked(DeviceRecord& record) const;
+    void rebuildIndexLocked();
+    void unpublishLocked();
+    /** Appends @p mutations, checkpointing when the log is full. */
+    bool logLocked(const QList<PolicyMutation>& mutations);
+    bool checkpointLocked(QString* error);
+    const QByteArray& keyLocked();
+    QString walPath() const { return m_storePath + QStringLiteral(".wal"); }
+    /** Starts a new epoch: clients resync in full. Caller holds the write lock. */
+    void resetGenerations();
+    void markDeviceChanged(const QString& uniqueId);
+    void markDeviceRemoved(const QString& uniqueId);
+    void markBlocksChanged();
 
     QString m_storePath;
     PolicySnapshot m_snapshot;
+    /** uniqueId -> position in m_snapshot.devices. */
+    QHash<QString, qsizetype> m_deviceIndex;
+    mutable std::shared_ptr<const PolicySnapshot> m_published;
+    QHash<QString, quint64> m_deviceChangedAt;
+    QHash<QString, quint64> m_removedAt;
+    quint64 m_blocksChangedAt = 0;
+    PolicyWal m_wal;
+    QByteArray m_key;
+    QThread* m_groupThread = nullptr;
+    bool m_groupUnsynced = false;
     mutable QReadWriteLock m_lock;
 };
 
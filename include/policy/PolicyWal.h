@@ -0,0 +1,68 @@
+#pragma once
+
+#include "PolicySnapshot.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QString>
+
+#include <memory>
+
+namespace FlashSpartan::Policy {
+
+/** One store edit, as logged; BlockDrive carries its timestamp so replay is exact. */
+struct PolicyMutation {
+    enum class Kind : quint8 {
+        UpsertDevice = 1,
+        RemoveDevice = 2,
+        ClearDevices = 3,
+        BlockDrive = 4,
+        UnblockDrive = 5,
+    };
+
+    Kind kind = Kind::UpsertDevice;
+    DeviceRecord record;       // UpsertDevice
+    BlockedDriveEntry block;   // BlockDrive; UnblockDrive uses driveKey / uniqueId
+    QString uniqueId;          // RemoveDevice
+};
+
+/**
+ * Write-ahead log next to the signed policy blob: a header naming the blob it extends
+ * (by its HMAC), then one entry per mutation, each HMAC-signed over the base, its
+ * sequence number and its payload. A mutation costs one small append and fdatasync
+ * instead of a full re-encode; the engine folds the log into the blob every
+ * kCheckpointEntries entries. On load, entries are replayed up to the first torn or
+ * foreign one, so a crash loses at most the write in progress.
+ */
+class PolicyWal {
+public:
+    static constexpr quint32 kMagic = 0x31575346;  // 'FSW1' little-endian
+    static constexpr quint16 kVersion = 1;
+    static constexpr int kCheckpointEntries = 512;
+    static constexpr qint64 kCheckpointBytes = 8 * 1024 * 1024;
+
+    /** The entries of @p path that extend the blob signed @p baseSignature, in order. */
+    static QList<PolicyMutation> read(const QString& path, const QByteArray& baseSignature,
+                                      const QByteArray& key);
+
+    /** Starts an empty log at @p path for the blob signed @p baseSignature, and opens it. */
+    bool reset(const QString& path, const QByteArray& baseSignature, const QByteArray& key);
+    /** Appends @p mutations in one write, then syncs unless @p sync is false. */
+    bool append(const QList<PolicyMutation>& mutations, bool sync = true);
+    /** fdatasync of everything appended so far. */
+    bool sync();
+    void close();
+
+    bool isOpen() const { return static_cast<bool>(m_file); }
+    int entries() const { return m_entries; }
+    qint64 bytes() const { return m_file ? m_file->size() : 0; }
+
+private:
+    std::unique_ptr<QFile> m_file;
+    QByteArray m_base;
+    QByteArray m_key;
+    int m_entries = 0;
+};
+
+} // namespace FlashSpartan::Policy
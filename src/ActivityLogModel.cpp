@@ -0,0 +1,169 @@
+#include "ActivityLogModel.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace FlashSpartan {
+
+ActivityLogModel::ActivityLogModel(int capacity, QObject* parent)
+    : QAbstractListModel(parent), m_capacity(qMax(kMinCapacity, capacity))
+{
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(kFlushIntervalMs);
+    connect(&m_flushTimer, &QTimer::timeout, this, &ActivityLogModel::flush);
+}
+
+int ActivityLogModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid()) {
+        return 0;
+    }
+    return isFiltered() ? int(m_visible.size()) : heldCount();
+}
+
+QVariant ActivityLogModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= rowCount()) {
+        return {};
+    }
+    const LogEntry& e = entry(index.row());
+    switch (role) {
+        case Qt::DisplayRole:
+            return QStringLiteral("[%1] %2").arg(e.timestamp.toString(QStringLiteral("hh:mm:ss")), e.message);
+        case Qt::ToolTipRole:
+            return e.deviceId.isEmpty() ? e.toString() : QStringLiteral("%1\n%2").arg(e.toString(), e.deviceId);
+        case Qt::ForegroundRole:
+            return m_foreground.isValid() ? QVariant(m_foreground) : QVariant();
+        case Qt::UserRole:
+            return int(e.level);
+        default:
+            return {};
+    }
+}
+
+void ActivityLogModel::append(LogEntry entry)
+{
+    m_pending.append(std::move(entry));
+    if (m_pending.size() > m_capacity) {
+        m_pending.removeFirst();  // would fall off the ring on the next flush anyway
+    }
+    if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
+}
+
+void ActivityLogModel::flush()
+{
+    m_flushTimer.stop();
+    if (m_pending.isEmpty()) {
+        return;
+    }
+    QList<LogEntry> pending = std::exchange(m_pending, {});
+    const quint64 capacity = quint64(m_capacity);
+    const quint64 end = m_end + quint64(pending.size());
+    const quint64 first = qMax(m_first, end > capacity ? end - capacity : quint64(0));
+
+    if (first > m_first) {
+        const int removed = isFiltered()
+            ? int(std::lower_bound(m_visible.cbegin(), m_visible.cend(), first) - m_visible.cbegin())
+            : int(first - m_first);
+        if (removed > 0) {
+            beginRemoveRows(QModelIndex(), 0, removed - 1);
+        }
+        if (isFiltered()) {
+            m_visible.remove(0, removed);
+        }
+        m_first = first;
+        if (removed > 0) {
+            endRemoveRows();
+        }
+    }
+
+    QList<quint64> matches;
+    if (isFiltered()) {
+        for (qsizetype i = 0; i < pending.size(); ++i) {
+            if (accepts(pending.at(i))) {
+                matches.append(m_end + quint64(i));
+            }
+        }
+    }
+    const int inserted = isFiltered() ? int(matches.size()) : int(pending.size());
+    const int row = rowCount();
+    if (inserted > 0) {
+        beginInsertRows(QModelIndex(), row, row + inserted - 1);
+    }
+    // The slots being written belonged to the lines removed above.
+    for (qsizetype i = 0; i < pending.size(); ++i) {
+        const std::size_t slot = std::size_t((m_end + quint64(i)) % capacity);
+        if (slot < m_ring.size()) {
+            m_ring[slot] = std::move(pending[i]);
+        } else {
+            m_ring.push_back(std::move(pending[i]));
+        }
+    }
+    m_end = end;
+    m_visible.append(matches);
+    if (inserted > 0) {
+        endInsertRows();
+    }
+    emit flushed(inserted);
+}
+
+void ActivityLogModel::setCapacity(int capacity)
+{
+    capacity = qMax(kMinCapacity, capacity);
+    if (capacity == m_capacity) {
+        return;
+    }
+    beginResetModel();
+    const quint64 keep = qMin(m_end - m_first, quint64(capacity));
+    std::vector<LogEntry> ring;
+    ring.reserve(std::size_t(keep));
+    for (quint64 seq = m_end - keep; seq < m_end; ++seq) {
+        ring.push_back(std::move(m_ring[seq % quint64(m_capacity)]));
+    }
+    m_ring = std::move(ring);
+    m_capacity = capacity;
+    m_first = 0;
+    m_end = keep;
+    while (m_pending.size() > m_capacity) {
+        m_pending.removeFirst();
+    }
+    rebuildVisible();
+    endResetModel();
+}
+
+void ActivityLogModel::setFilterText(const QString& text)
+{
+    const QString trimmed = text.trimmed();
+    if (trimmed == m_filterText) {
+        return;
+    }
+    beginResetModel();
+    m_filterText = trimmed;
+    rebuildVisible();
+    endResetModel();
+}
+
+bool ActivityLogModel::accepts(const LogEntry& entry) const
+{
+    return entry.message.contains(m_filterText, Qt::CaseInsensitive)
+        || entry.levelString().contains(m_filterText, Qt::CaseInsensitive)
+        || entry.category.contains(m_filterText, Qt::CaseInsensitive)
+        || entry.deviceId.contains(m_filterText, Qt::CaseInsensitive);
+}
+
+void ActivityLogModel::rebuildVisible()
+{
+    m_visible.clear();
+    if (!isFiltered()) {
+        return;
+    }
+    for (quint64 seq = m_first; seq < m_end; ++seq) {
+        if (accepts(at(seq))) {
+            m_visible.append(seq);
+        }
+    }
+}
+
+} // namespace FlashSpartan
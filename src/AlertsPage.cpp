@@ -7,33 +7,17 @@
 #include <QHeaderView>
 #include <QLabel>
 #include <QLineEdit>
-#include <QPushButton>
 #include <QScrollArea>
-#include <QTableWidget>
-#include <QTableWidgetItem>
+#include <QTableView>
 #include <QVBoxLayout>
 
+#include <algorithm>
+
 namespace FlashSpartan {
 
 namespace {
 
-QTableWidgetItem* readOnlyItem(const QString& text)
-{
-    auto* item = new QTableWidgetItem(text);
-    item->setFlags(item->flags() & ~Qt::ItemIsEditable);
-    return item;
-}
-
-QWidget* tableButtonCell(QPushButton* btn)
-{
-    btn->setFixedHeight(20);
-    btn->setStyleSheet(FSStyle.compactTableButtonStyleSheet());
-    auto* cell = new QWidget;
-    auto* lay = new QHBoxLayout(cell);
-    lay->setContentsMargins(2, 1, 2, 1);
-    lay->addWidget(btn, 0, Qt::AlignCenter);
-    return cell;
-}
+enum Column { TimeColumn, SeverityColumn, EventColumn, DeviceColumn, TypeColumn, ResultColumn, DetailsColumn };
 
 QString severityLabel(const QString& result)
 {
@@ -56,6 +40,75 @@ QString severityLabel(const QString& result)
     return QStringLiteral("Notice");
 }
 
+bool alertMatches(const UiEventEntry& e, const QString& kind, const QString& needle)
+{
+    const QString sev = severityLabel(e.result).toLower();
+    const QString r = e.result.toLower();
+    if (kind == QLatin1String("security") && sev != QLatin1String("security") && r != QLatin1String("alert")) {
+        return false;
+    }
+    if (kind == QLatin1String("warn") && sev != QLatin1String("warning") && r != QLatin1String("warn")) {
+        return false;
+    }
+    if (kind == QLatin1String("fail") && r != QLatin1String("fail") && r != QLatin1String("error")
+        && r != QLatin1String("mismatch") && r != QLatin1String("failed")) {
+        return false;
+    }
+    if (kind == QLatin1String("blocked") && r != QLatin1String("blocked") && r != QLatin1String("rejected")) {
+        return false;
+    }
+    if (!needle.isEmpty()) {
+        const QString hay = QStringLiteral("%1 %2 %3 %4 %5")
+                                .arg(e.event, e.device, e.type, e.result, e.detail)
+                                .toLower();
+        if (!hay.contains(needle)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QVariant alertCell(const UiEventEntry& e, int column, int role)
+{
+    if (role == Qt::ToolTipRole) {
+        return column == DetailsColumn ? e.detail : QVariant();
+    }
+    if (column == DetailsColumn) {
+        if (role == Qt::TextAlignmentRole) {
+            return int(Qt::AlignCenter);
+        }
+        if (role == Qt::ForegroundRole) {
+            return FSStyle.color(StyleManager::ColorRole::AccentPrimary);
+        }
+    }
+    if (role != Qt::DisplayRole) {
+        return {};
+    }
+    switch (column) {
+        case TimeColumn:
+            return e.time.toString(QStringLiteral("yyyy-MM-dd hh:mm:ss"));
+        case SeverityColumn:
+            return severityLabel(e.result);
+        case EventColumn:
+            return e.event;
+        case DeviceColumn:
+            return e.device;
+        case TypeColumn:
+            return e.type;
+        case ResultColumn:
+            return e.result;
+        case DetailsColumn:
+            return QStringLiteral("Details");
+        default:
+            return {};
+    }
+}
+
+bool isSecurityAlert(const UiEventEntry& e)
+{
+    return severityLabel(e.result) == QLatin1String("Security");
+}
+
 } // namespace
 
 AlertsPage::AlertsPage(QWidget* parent)
@@ -93,7 +146,8 @@ void AlertsPage::setupUi()
     auto* stats = new QHBoxLayout;
     m_totalLabel = new QLabel;
     m_securityLabel = new QLabel;
-    for (QLabel* lb : {m_totalLabel, m_securityLabel}) {
+    m_failuresLabel = new QLabel;
+    for (QLabel* lb : {m_totalLabel, m_securityLabel, m_failuresLabel}) {
         lb->setStyleSheet(QString("color: %1; font-weight: 600;")
                               .arg(FSStyle.colorCss(StyleManager::ColorRole::AccentPrimary)));
         stats->addWidget(lb);
@@ -121,8 +175,7 @@ void AlertsPage::setupUi()
     toolbar->addWidget(m_searchEdit, 1);
     layout->addLayout(toolbar);
 
-    m_table = new QTableWidget(0, 7);
-    m_table->setHorizontalHeaderLabels({
+    m_model = new RecordTableModel<UiEventEntry>({
         QStringLiteral("Time"),
         QStringLiteral("Severity"),
         QStringLiteral("Event"),
@@ -130,12 +183,27 @@ void AlertsPage::setupUi()
         QStringLiteral("Type"),
         QStringLiteral("Result"),
         QStringLiteral(""),
+    }, alertCell, this);
+    connect(m_model, &RecordTableModelBase::rowsReplaced, this, &AlertsPage::onRowsReplaced);
+    connect(m_model, &QAbstractItemModel::rowsInserted, this, [this](const QModelIndex&, int first, int) {
+        if (first == 0) {
+            setSummary(m_model->matchCount(), m_securityCount);
+        }
     });
+
+    m_table = new QTableView;
+    m_table->setModel(m_model);
     m_table->verticalHeader()->setVisible(false);
     m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
     m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
     m_table->setAlternatingRowColors(true);
     m_table->setStyleSheet(FSStyle.dataTableStyleSheet());
+    connect(m_table, &QTableView::clicked, this, &AlertsPage::onRowClicked);
+    connect(m_table, &QTableView::doubleClicked, this, [this](const QModelIndex& index) {
+        if (index.isValid() && index.column() != DetailsColumn) {
+            emit eventDetailsRequested(m_model->record(index.row()));
+        }
+    });
     layout->addWidget(m_table, 1);
 
     scroll->setWidget(content);
@@ -151,6 +219,14 @@ void AlertsPage::setSummary(int total, int securityCount)
     m_securityLabel->setText(QStringLiteral("Security: %1").arg(securityCount));
 }
 
+void AlertsPage::setVerifyFailures(const VerifyRollup::Counts& today, const VerifyRollup::Counts& week)
+{
+    m_failuresLabel->setText(QStringLiteral("Failed verifications: %1 today, %2 in 7 days (%3% passed)")
+                                 .arg(today.failed)
+                                 .arg(week.failed)
+                                 .arg(week.passPercent()));
+}
+
 QString AlertsPage::filterKind() const
 {
     return m_filterCombo->currentData().toString();
@@ -163,70 +239,31 @@ QString AlertsPage::searchText() const
 
 void AlertsPage::setAlerts(const QList<UiEventEntry>& alerts)
 {
-    m_rows = alerts;
-    const QString kind = filterKind();
-    const QString needle = searchText().toLower();
-
-    QList<UiEventEntry> visible;
-    int securityCount = 0;
-    for (const UiEventEntry& e : m_rows) {
-        const QString sev = severityLabel(e.result).toLower();
-        if (sev == QLatin1String("security")) {
-            ++securityCount;
-        }
-
-        if (kind == QLatin1String("security")
-            && sev != QLatin1String("security") && e.result.toLower() != QLatin1String("alert")) {
-            continue;
-        }
-        if (kind == QLatin1String("warn")
-            && sev != QLatin1String("warning") && e.result.toLower() != QLatin1String("warn")) {
-            continue;
-        }
-        if (kind == QLatin1String("fail")) {
-            const QString r = e.result.toLower();
-            if (r != QLatin1String("fail") && r != QLatin1String("error")
-                && r != QLatin1String("mismatch") && r != QLatin1String("failed")) {
-                continue;
-            }
-        }
-        if (kind == QLatin1String("blocked")) {
-            const QString r = e.result.toLower();
-            if (r != QLatin1String("blocked") && r != QLatin1String("rejected")) {
-                continue;
-            }
-        }
+    m_securityCount = int(std::count_if(alerts.cbegin(), alerts.cend(), isSecurityAlert));
+    m_model->setRecords(alerts);
+}
 
-        if (!needle.isEmpty()) {
-            const QString hay = QStringLiteral("%1 %2 %3 %4 %5")
-                                    .arg(e.event, e.device, e.type, e.result, e.detail)
-                                    .toLower();
-            if (!hay.contains(needle)) {
-                continue;
-            }
-        }
-        visible.append(e);
-    }
+void AlertsPage::addAlerts(const QList<UiEventEntry>& newestFirst)
+{
+    m_securityCount += int(std::count_if(newestFirst.cbegin(), newestFirst.cend(), isSecurityAlert));
+    m_model->prependRecords(newestFirst);
+}
 
-    m_table->setRowCount(visible.size());
-    for (int row = 0; row < visible.size(); ++row) {
-        const UiEventEntry& e = visible.at(row);
-        m_table->setItem(row, 0, readOnlyItem(e.time.toString(QStringLiteral("yyyy-MM-dd hh:mm:ss"))));
-        m_table->setItem(row, 1, readOnlyItem(severityLabel(e.result)));
-        m_table->setItem(row, 2, readOnlyItem(e.event));
-        m_table->setItem(row, 3, readOnlyItem(e.device));
-        m_table->setItem(row, 4, readOnlyItem(e.type));
-        m_table->setItem(row, 5, readOnlyItem(e.result));
-
-        auto* detailsBtn = new QPushButton(QStringLiteral("Details"));
-        detailsBtn->setProperty("alertRow", row);
-        connect(detailsBtn, &QPushButton::clicked, this, &AlertsPage::onDetailsClicked);
-        m_table->setCellWidget(row, 6, tableButtonCell(detailsBtn));
+void AlertsPage::applyFilter()
+{
+    const QString kind = filterKind();
+    const QString needle = searchText().toLower();
+    if (kind == QLatin1String("all") && needle.isEmpty()) {
+        m_model->setFilter({});
+        return;
     }
+    m_model->setFilter([kind, needle](const UiEventEntry& e) { return alertMatches(e, kind, needle); });
+}
 
-    m_visibleRows = visible;
+void AlertsPage::onRowsReplaced()
+{
     applyTableLayout();
-    setSummary(visible.size(), securityCount);
+    setSummary(m_model->matchCount(), m_securityCount);
 }
 
 void AlertsPage::applyTableLayout()
@@ -235,43 +272,23 @@ void AlertsPage::applyTableLayout()
         return;
     }
     m_table->resizeColumnsToContents();
-    const int last = m_table->columnCount() - 1;
-    if (last >= 0) {
-        m_table->horizontalHeader()->setSectionResizeMode(last, QHeaderView::Fixed);
-        m_table->setColumnWidth(last, 72);
-    }
-    if (m_table->columnCount() >= 3) {
-        m_table->horizontalHeader()->setSectionResizeMode(2, QHeaderView::Stretch);
-    }
+    auto* hdr = m_table->horizontalHeader();
+    hdr->setSectionResizeMode(DetailsColumn, QHeaderView::Fixed);
+    m_table->setColumnWidth(DetailsColumn, 72);
+    hdr->setSectionResizeMode(EventColumn, QHeaderView::Stretch);
 }
 
 void AlertsPage::onFilterChanged()
 {
-    setAlerts(m_rows);
+    applyFilter();
     emit filterChanged();
 }
 
-void AlertsPage::onDetailsClicked()
+void AlertsPage::onRowClicked(const QModelIndex& index)
 {
-    const int row = rowIndexForButton(sender());
-    if (row < 0 || row >= m_visibleRows.size()) {
-        return;
-    }
-    emit eventDetailsRequested(m_visibleRows.at(row));
-}
-
-int AlertsPage::rowIndexForButton(QObject* sender) const
-{
-    auto* btn = qobject_cast<QPushButton*>(sender);
-    if (!btn) {
-        return -1;
-    }
-    for (int row = 0; row < m_table->rowCount(); ++row) {
-        if (m_table->cellWidget(row, 6) && m_table->cellWidget(row, 6)->findChild<QPushButton*>() == btn) {
-            return row;
-        }
+    if (index.isValid() && index.column() == DetailsColumn) {
+        emit eventDetailsRequested(m_model->record(index.row()));
     }
-    return btn->property("alertRow").toInt();
 }
 
 } // namespace FlashSpartan
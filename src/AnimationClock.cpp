@@ -0,0 +1,73 @@
+#include "AnimationClock.h"
+
+namespace FlashSpartan {
+
+AnimationClock& AnimationClock::instance()
+{
+    static AnimationClock clock;
+    return clock;
+}
+
+AnimationClock::AnimationClock(QObject* parent)
+    : QObject(parent)
+{
+    m_clock.start();
+    setFrameRate(kDefaultFrameRate);
+    connect(&m_timer, &QTimer::timeout, this, &AnimationClock::tick);
+}
+
+void AnimationClock::subscribe(QObject* client, Tick tick)
+{
+    if (!m_clients.contains(client)) {
+        connect(client, &QObject::destroyed, this, [this, client]() { unsubscribe(client); });
+    }
+    m_clients.insert(client, std::move(tick));
+    updateTimer();
+}
+
+void AnimationClock::unsubscribe(QObject* client)
+{
+    if (m_clients.remove(client)) {
+        disconnect(client, &QObject::destroyed, this, nullptr);
+        updateTimer();
+    }
+}
+
+void AnimationClock::setFrameRate(double hz)
+{
+    if (hz > 0.0) {
+        m_timer.setInterval(qMax(1, qRound(1000.0 / qMin(hz, kMaxFrameRate))));
+    }
+}
+
+void AnimationClock::setSuspended(bool suspended)
+{
+    if (suspended != m_suspended) {
+        m_suspended = suspended;
+        updateTimer();
+    }
+}
+
+void AnimationClock::tick()
+{
+    const qint64 now = m_clock.elapsed();
+    const QList<QObject*> clients = m_clients.keys();  // a client may unsubscribe another
+    for (QObject* client : clients) {
+        const auto it = m_clients.constFind(client);
+        if (it != m_clients.cend()) {
+            const Tick tick = *it;
+            tick(now);
+        }
+    }
+}
+
+void AnimationClock::updateTimer()
+{
+    if (m_suspended || m_clients.isEmpty()) {
+        m_timer.stop();
+    } else if (!m_timer.isActive()) {
+        m_timer.start();
+    }
+}
+
+} // namespace FlashSpartan
@@ -1,6 +1,10 @@
 #include "AppDiagnostics.h"
+#include "FlightRecorder.h"
+#include "PerfMetrics.h"
 
+#include <QCoreApplication>
 #include <QDateTime>
+#include <QDebug>
 #include <QDir>
 #include <QFile>
 #include <QJsonArray>
@@ -8,8 +12,10 @@
 #include <QJsonObject>
 #include <QLoggingCategory>
 #include <QMessageLogContext>
+#include <QSaveFile>
 #include <QStandardPaths>
 #include <QTextStream>
+#include <QTimer>
 
 #include <iostream>
 
@@ -28,6 +34,85 @@ QString AppDiagnostics::qtLogPath()
     return logsDir() + QStringLiteral("/flashspartan.log");
 }
 
+QString AppDiagnostics::badUsbCapturesDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/badusb-captures");
+}
+
+CaptureRetention::Usage AppDiagnostics::badUsbCaptureUsage()
+{
+    return CaptureRetention::usage(badUsbCapturesDir());
+}
+
+QString AppDiagnostics::metricsPath()
+{
+    return logsDir() + QStringLiteral("/flashspartan.prom");
+}
+
+void AppDiagnostics::startMetricsExport(const QString& path, int intervalMs)
+{
+    auto* app = QCoreApplication::instance();
+    if (!app) {
+        return;
+    }
+    const QString target = path.isEmpty() ? metricsPath() : path;
+    const auto write = [target]() {
+        if (!PerfMetrics::writeTo(target)) {
+            qWarning() << "Could not write metrics to" << target;
+        }
+    };
+    auto* timer = new QTimer(app);
+    QObject::connect(timer, &QTimer::timeout, app, write);
+    QObject::connect(app, &QCoreApplication::aboutToQuit, app, write);
+    timer->start(qMax(1000, intervalMs));
+    write();
+}
+
+QString AppDiagnostics::flightRecorderPath()
+{
+    return logsDir() + QStringLiteral("/flight-recorder.ring");
+}
+
+void AppDiagnostics::startFlightRecorder()
+{
+    QString error;
+    if (!FlightRecorder::start(flightRecorderPath(), &error)) {
+        qWarning() << "Flight recorder not started:" << error;
+        return;
+    }
+    auto* app = QCoreApplication::instance();
+    if (!app) {
+        return;
+    }
+    auto* timer = new QTimer(app);
+    QObject::connect(timer, &QTimer::timeout, app, &FlightRecorder::sampleCounters);
+    QObject::connect(app, &QCoreApplication::aboutToQuit, app, &FlightRecorder::sampleCounters);
+    timer->start(kFlightRecorderSampleMs);
+}
+
+bool AppDiagnostics::dumpFlightRecorder(const QString& outPath, QString* error)
+{
+    QString readError;
+    const QList<FlightRecorder::Entry> entries = FlightRecorder::isRunning()
+                                                     ? FlightRecorder::snapshot()
+                                                     : FlightRecorder::read(flightRecorderPath(), &readError);
+    if (!readError.isEmpty()) {
+        if (error) {
+            *error = readError;
+        }
+        return false;
+    }
+    const QByteArray json = FlightRecorder::toTraceJson(entries);
+    QSaveFile file(outPath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit()) {
+        if (error) {
+            *error = file.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
 QString AppDiagnostics::hostUsbInventoryPath()
 {
     return logsDir() + QStringLiteral("/host-usb-inventory.jsonl");
@@ -110,6 +195,9 @@ void AppDiagnostics::installQtMessageHandler()
                                       level.leftJustified(5, QLatin1Char(' ')));
 
         std::cerr << line.toStdString() << std::endl;
+        if (type == QtWarningMsg || type == QtCriticalMsg || type == QtFatalMsg) {
+            FlightRecorder::event("log", msg);
+        }
         if (initialized) {
             logStream << line << QLatin1Char('\n');
             logStream.flush();
@@ -1,9 +1,9 @@
 #include "AuditLog.h"
 
+#include "AuditWriter.h"
+
 #include <QDateTime>
 #include <QDir>
-#include <QFile>
-#include <QFileInfo>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QStandardPaths>
@@ -17,43 +17,41 @@ QString AuditLog::logPath()
     return dir + QStringLiteral("/audit.log");
 }
 
-void AuditLog::appendLine(const QString& jsonLine)
+void AuditLog::appendLine(const QByteArray& jsonLine, const QString& device)
 {
-    QFile f(logPath());
-    if (!f.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
-        return;
-    }
-    f.write(jsonLine.toUtf8());
-    f.write("\n");
+    static AuditWriter& writer = AuditWriter::forPath(logPath());
+    writer.append(jsonLine, device);
 }
 
 void AuditLog::appendEvent(const QString& event, const QString& detail)
 {
-    QJsonObject obj;
-    obj.insert(QStringLiteral("ts"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
-    obj.insert(QStringLiteral("event"), event);
+    AuditLine line;
+    line.addTimestamp().add("event", event);
     if (!detail.isEmpty()) {
-        obj.insert(QStringLiteral("detail"), detail);
+        line.add("detail", detail);
     }
-    appendLine(QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact)));
+    appendLine(line.take());
 }
 
 void AuditLog::appendIsoVerify(const IsoVerifyResult& result)
 {
-    QJsonObject obj;
-    obj.insert(QStringLiteral("ts"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
-    obj.insert(QStringLiteral("event"), QStringLiteral("iso_verify"));
-    obj.insert(QStringLiteral("path"), result.isoPath);
-    obj.insert(QStringLiteral("device"), result.deviceNode);
-    obj.insert(QStringLiteral("publisher"), result.publisherId);
-    obj.insert(QStringLiteral("passed"), result.passed());
-    obj.insert(QStringLiteral("hash_matches"), result.hashMatches);
-    obj.insert(QStringLiteral("pgp_valid"), result.pgpValid);
-    obj.insert(QStringLiteral("source"), static_cast<int>(result.source));
+    AuditLine line;
+    line.addTimestamp()
+        .add("event", QStringLiteral("iso_verify"))
+        .add("path", result.isoPath)
+        .add("device", result.deviceNode)
+        .add("publisher", result.publisherId)
+        .add("passed", result.passed())
+        .add("hash_matches", result.hashMatches)
+        .add("pgp_valid", result.pgpValid)
+        .add("source", static_cast<int>(result.source));
+    if (!result.prescreenMismatch.isEmpty()) {
+        line.add("prescreen_mismatch", result.prescreenMismatch);
+    }
     if (!result.errorMessage.isEmpty()) {
-        obj.insert(QStringLiteral("error"), result.errorMessage);
+        line.add("error", result.errorMessage);
     }
-    appendLine(QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact)));
+    appendLine(line.take(), result.deviceNode);
 }
 
 void AuditLog::appendBadUsbEvent(const BadUsbAnomalyResult& result)
@@ -61,7 +59,15 @@ void AuditLog::appendBadUsbEvent(const BadUsbAnomalyResult& result)
     QJsonObject obj = result.toJson();
     obj.insert(QStringLiteral("ts"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
     obj.insert(QStringLiteral("event"), QStringLiteral("badusb_anomaly"));
-    appendLine(QString::fromUtf8(QJsonDocument(obj).toJson(QJsonDocument::Compact)));
+    appendLine(QJsonDocument(obj).toJson(QJsonDocument::Compact), result.device.stableId());
+}
+
+void AuditLog::appendBadUsbCaptureSummary(const BadUsbAnomalyResult& result)
+{
+    QJsonObject obj = result.toJson();
+    obj.insert(QStringLiteral("ts"), QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+    obj.insert(QStringLiteral("event"), QStringLiteral("badusb_capture_summary"));
+    appendLine(QJsonDocument(obj).toJson(QJsonDocument::Compact), result.device.stableId());
 }
 
 } // namespace FlashSpartan
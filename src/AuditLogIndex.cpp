@@ -0,0 +1,285 @@
+#include "AuditLogIndex.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+
+#include <algorithm>
+#include <limits>
+#include <map>
+
+namespace FlashSpartan {
+
+namespace {
+
+/** The segment's bytes up to (not including) the newline; false for a torn last line. */
+bool readLine(QFile& file, QByteArray* line)
+{
+    *line = file.readLine();
+    if (!line->endsWith('\n')) {
+        return false;
+    }
+    line->chop(1);
+    if (line->endsWith('\r')) {
+        line->chop(1);
+    }
+    return true;
+}
+
+qint64 lineTime(const QByteArray& line)
+{
+    const QJsonObject obj = QJsonDocument::fromJson(line).object();
+    const QDateTime ts = QDateTime::fromString(obj.value(QStringLiteral("ts")).toString(), Qt::ISODate);
+    return ts.isValid() ? ts.toMSecsSinceEpoch() : 0;
+}
+
+} // namespace
+
+QStringList AuditLogIndex::segments(const QString& path)
+{
+    const QFileInfo info(path);
+    const QString prefix = info.fileName() + QLatin1Char('.');
+    std::map<quint64, QString> numbered;
+    const QStringList names =
+        QDir(info.absolutePath()).entryList({prefix + QLatin1Char('*')}, QDir::Files, QDir::NoSort);
+    for (const QString& name : names) {
+        bool ok = false;
+        const quint64 n = QStringView(name).mid(prefix.size()).toULongLong(&ok);
+        if (ok) {
+            numbered.emplace(n, info.absolutePath() + QLatin1Char('/') + name);
+        }
+    }
+    QStringList out;
+    for (const auto& [n, segment] : numbered) {
+        out.append(segment);
+    }
+    if (info.exists()) {
+        out.append(path);
+    }
+    return out;
+}
+
+QString AuditLogIndex::indexPath(const QString& segment)
+{
+    return segment + QStringLiteral(".idx");
+}
+
+quint64 AuditLogIndex::deviceHash(const QString& device)
+{
+    if (device.isEmpty()) {
+        return 0;
+    }
+    const QByteArray digest = QCryptographicHash::hash(device.toUtf8(), QCryptographicHash::Sha256);
+    const quint64 h = qFromLittleEndian<quint64>(digest.constData());
+    return h ? h : 1;
+}
+
+QByteArray AuditLogIndex::lineHash(const QByteArray& line)
+{
+    return QCryptographicHash::hash(line, QCryptographicHash::Sha256).toHex();
+}
+
+QByteArray AuditLogIndex::encodeHeader()
+{
+    QByteArray out(kHeaderBytes, Qt::Uninitialized);
+    qToLittleEndian<quint32>(kMagic, out.data());
+    qToLittleEndian<quint32>(kVersion, out.data() + 4);
+    return out;
+}
+
+QByteArray AuditLogIndex::encodeEntry(const Entry& entry)
+{
+    QByteArray out(kEntryBytes, Qt::Uninitialized);
+    qToLittleEndian<qint64>(entry.msecs, out.data());
+    qToLittleEndian<quint64>(entry.offset, out.data() + 8);
+    qToLittleEndian<quint64>(entry.device, out.data() + 16);
+    return out;
+}
+
+QList<AuditLogIndex::Entry> AuditLogIndex::load(QFile& segment, int* indexed, QByteArray* lastLine)
+{
+    QList<Entry> entries;
+    QFile sidecar(indexPath(segment.fileName()));
+    if (sidecar.open(QIODevice::ReadOnly)) {
+        const QByteArray bytes = sidecar.readAll();
+        if (bytes.size() >= kHeaderBytes && bytes.left(kHeaderBytes) == encodeHeader()) {
+            const qsizetype count = (bytes.size() - kHeaderBytes) / kEntryBytes;
+            entries.reserve(count);
+            for (qsizetype i = 0; i < count; ++i) {
+                const char* p = bytes.constData() + kHeaderBytes + i * kEntryBytes;
+                entries.append({qFromLittleEndian<qint64>(p), qFromLittleEndian<quint64>(p + 8),
+                                qFromLittleEndian<quint64>(p + 16)});
+            }
+        }
+    }
+    // A sidecar that runs past its segment (the log was cut short) is trusted up to the cut.
+    const quint64 size = static_cast<quint64>(segment.size());
+    while (!entries.isEmpty() && entries.constLast().offset >= size) {
+        entries.removeLast();
+    }
+
+    QByteArray last;
+    qint64 scanFrom = 0;
+    if (!entries.isEmpty() && segment.seek(static_cast<qint64>(entries.constLast().offset))
+        && readLine(segment, &last)) {
+        scanFrom = segment.pos();
+    } else {
+        entries.clear();
+        last.clear();
+    }
+    if (indexed) {
+        *indexed = static_cast<int>(entries.size());
+    }
+
+    // Lines the sidecar does not cover yet; they have no device.
+    qint64 msecs = entries.isEmpty() ? 0 : entries.constLast().msecs;
+    segment.seek(scanFrom);
+    QByteArray line;
+    while (!segment.atEnd()) {
+        const qint64 offset = segment.pos();
+        if (!readLine(segment, &line)) {
+            break;  // still being written
+        }
+        if (line.isEmpty()) {
+            continue;
+        }
+        msecs = std::max(msecs, lineTime(line));
+        entries.append({msecs, static_cast<quint64>(offset), 0});
+        last = line;
+    }
+    if (lastLine) {
+        *lastLine = last;
+    }
+    return entries;
+}
+
+QList<QByteArray> AuditLogIndex::query(const QString& path, const Query& query)
+{
+    QList<QByteArray> out;
+    const qint64 from = query.from.isValid() ? query.from.toMSecsSinceEpoch() : 0;
+    const qint64 to = query.to.isValid() ? query.to.toMSecsSinceEpoch()
+                                         : std::numeric_limits<qint64>::max();
+    const quint64 device = deviceHash(query.device);
+    const QStringList files = segments(path);
+    for (auto seg = files.crbegin(); seg != files.crend(); ++seg) {
+        QFile f(*seg);
+        if (!f.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        const QList<Entry> entries = load(f);
+        auto it = std::upper_bound(entries.cbegin(), entries.cend(), to,
+                                   [](qint64 t, const Entry& e) { return t < e.msecs; });
+        while (it != entries.cbegin()) {
+            --it;
+            if (it->msecs < from) {
+                return out;  // older segments are older still
+            }
+            if (device && it->device != device) {
+                continue;
+            }
+            QByteArray line;
+            if (f.seek(static_cast<qint64>(it->offset)) && readLine(f, &line)) {
+                out.append(line);
+                if (query.limit > 0 && out.size() >= query.limit) {
+                    return out;
+                }
+            }
+        }
+    }
+    return out;
+}
+
+bool AuditLogIndex::forEach(const QString& path, const Query& query,
+                            const std::function<bool(const QByteArray& line, double done)>& visit)
+{
+    const qint64 from = query.from.isValid() ? query.from.toMSecsSinceEpoch() : 0;
+    const qint64 to = query.to.isValid() ? query.to.toMSecsSinceEpoch()
+                                         : std::numeric_limits<qint64>::max();
+    const quint64 device = deviceHash(query.device);
+    const QStringList files = segments(path);
+    QList<qint64> sizes;
+    qint64 total = 0;
+    for (const QString& segment : files) {
+        sizes.append(QFileInfo(segment).size());
+        total += sizes.constLast();
+    }
+
+    int visited = 0;
+    qint64 behind = 0;
+    for (qsizetype i = 0; i < files.size(); behind += sizes.at(i), ++i) {
+        QFile f(files.at(i));
+        if (!f.open(QIODevice::ReadOnly)) {
+            continue;
+        }
+        const QList<Entry> entries = load(f);
+        auto it = std::lower_bound(entries.cbegin(), entries.cend(), from,
+                                   [](const Entry& e, qint64 t) { return e.msecs < t; });
+        for (; it != entries.cend(); ++it) {
+            if (it->msecs > to) {
+                return true;  // newer segments are newer still
+            }
+            if (device && it->device != device) {
+                continue;
+            }
+            QByteArray line;
+            if (!f.seek(static_cast<qint64>(it->offset)) || !readLine(f, &line)) {
+                continue;
+            }
+            const double done = total > 0 ? double(behind + f.pos()) / double(total) : 1.0;
+            if (!visit(line, qMin(done, 1.0))) {
+                return false;
+            }
+            if (query.limit > 0 && ++visited >= query.limit) {
+                return true;
+            }
+        }
+    }
+    return true;
+}
+
+bool AuditLogIndex::verifyChain(const QString& path, QString* error)
+{
+    QByteArray previous;
+    bool havePrevious = false;
+    bool chained = false;
+    for (const QString& segment : segments(path)) {
+        QFile f(segment);
+        if (!f.open(QIODevice::ReadOnly)) {
+            if (error) {
+                *error = QStringLiteral("Cannot read %1").arg(segment);
+            }
+            return false;
+        }
+        int lineNo = 0;
+        QByteArray line;
+        while (!f.atEnd() && readLine(f, &line)) {
+            ++lineNo;
+            if (line.isEmpty()) {
+                continue;
+            }
+            const QJsonObject obj = QJsonDocument::fromJson(line).object();
+            const bool linked = obj.contains(QStringLiteral("prev"));
+            bool broken = chained && !linked;  // lines from before the chain only come first
+            if (linked && havePrevious) {
+                broken = obj.value(QStringLiteral("prev")).toString().toLatin1() != previous;
+            }
+            if (broken) {
+                if (error) {
+                    *error = QStringLiteral("Hash chain broken at line %1 of %2")
+                                 .arg(lineNo)
+                                 .arg(segment);
+                }
+                return false;
+            }
+            chained = chained || linked;
+            previous = lineHash(line);
+            havePrevious = true;
+        }
+    }
+    return true;
+}
+
+} // namespace FlashSpartan
@@ -0,0 +1,379 @@
+#include "AuditWriter.h"
+
+#include "AuditLogIndex.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <chrono>
+#include <future>
+#include <map>
+#include <memory>
+#include <utility>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace FlashSpartan {
+
+namespace {
+
+void appendEscaped(QByteArray& out, const QString& value)
+{
+    static const char kHex[] = "0123456789abcdef";
+    out += '"';
+    for (const char c : value.toUtf8()) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                out += "\\u00";
+                out += kHex[(c >> 4) & 0xf];
+                out += kHex[c & 0xf];
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+bool syncFile(QFile& file)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return fdatasync(file.handle()) == 0;
+#endif
+}
+
+struct Registry {
+    std::mutex mutex;
+    std::map<QString, std::unique_ptr<AuditWriter>> writers;
+};
+
+Registry& registry()
+{
+    static Registry r;  // destroyed at exit, which drains and syncs every writer
+    return r;
+}
+
+} // namespace
+
+void AuditLine::addKey(const char* key)
+{
+    m_json += m_json.isEmpty() ? '{' : ',';
+    m_json += '"';
+    m_json += key;
+    m_json += "\":";
+}
+
+AuditLine& AuditLine::add(const char* key, const QString& value)
+{
+    addKey(key);
+    appendEscaped(m_json, value);
+    return *this;
+}
+
+AuditLine& AuditLine::add(const char* key, bool value)
+{
+    addKey(key);
+    m_json += value ? "true" : "false";
+    return *this;
+}
+
+AuditLine& AuditLine::add(const char* key, int value)
+{
+    addKey(key);
+    m_json += QByteArray::number(value);
+    return *this;
+}
+
+AuditLine& AuditLine::addTimestamp()
+{
+    return add("ts", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+}
+
+QByteArray AuditLine::take()
+{
+    m_json += m_json.isEmpty() ? "{}" : "}";
+    return std::exchange(m_json, {});
+}
+
+struct AuditWriter::Node {
+    QByteArray line;
+    /** Set for a flush request instead of a line. */
+    std::promise<void>* flushed = nullptr;
+    qint64 msecs = 0;
+    QString device;
+    Node* next = nullptr;
+};
+
+AuditWriter& AuditWriter::forPath(const QString& path, QFile::Permissions permissions)
+{
+    Registry& r = registry();
+    std::lock_guard lock(r.mutex);
+    std::unique_ptr<AuditWriter>& writer = r.writers[path];
+    if (!writer) {
+        writer.reset(new AuditWriter(path, permissions));
+    }
+    return *writer;
+}
+
+void AuditWriter::flushAll()
+{
+    Registry& r = registry();
+    std::lock_guard lock(r.mutex);
+    for (auto& [path, writer] : r.writers) {
+        writer->flush();
+    }
+}
+
+AuditWriter::AuditWriter(QString path, QFile::Permissions permissions)
+    : m_path(std::move(path))
+    , m_permissions(permissions)
+{
+    m_thread = std::thread([this] { run(); });
+}
+
+AuditWriter::~AuditWriter()
+{
+    {
+        std::lock_guard lock(m_wakeMutex);
+        m_stop = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+void AuditWriter::append(QByteArray line, const QString& device)
+{
+    push(new Node{std::move(line), nullptr, QDateTime::currentMSecsSinceEpoch(), device});
+}
+
+void AuditWriter::flush()
+{
+    std::promise<void> flushed;
+    std::future<void> done = flushed.get_future();
+    push(new Node{{}, &flushed});
+    done.wait();
+}
+
+void AuditWriter::push(Node* node)
+{
+    Node* head = m_head.load(std::memory_order_relaxed);
+    do {
+        node->next = head;
+    } while (!m_head.compare_exchange_weak(head, node, std::memory_order_release,
+                                           std::memory_order_relaxed));
+    if (!head) {
+        // Only the push that found the stack empty wakes the flusher; during a burst it is
+        // already awake.
+        std::lock_guard lock(m_wakeMutex);
+        m_wake.notify_one();
+    }
+}
+
+bool AuditWriter::openFile()
+{
+    if (m_file.isOpen()) {
+        return true;
+    }
+    QDir().mkpath(QFileInfo(m_path).absolutePath());
+    m_file.setFileName(m_path);
+    if (!m_file.open(QIODevice::ReadWrite | QIODevice::Append)) {
+        return false;
+    }
+
+    int indexed = 0;
+    QByteArray last;
+    const QList<AuditLogIndex::Entry> entries = AuditLogIndex::load(m_file, &indexed, &last);
+    m_size = m_file.size();
+    m_lastMsecs = entries.isEmpty() ? 0 : entries.constLast().msecs;
+    if (m_size > 0 && m_file.seek(m_size - 1) && m_file.peek(1) != "\n") {
+        m_size += m_file.write("\n");  // end a torn line so the next one stands alone
+    }
+    if (entries.isEmpty()) {
+        const QStringList segments = AuditLogIndex::segments(m_path);
+        if (segments.size() > 1) {
+            QFile previous(segments.at(segments.size() - 2));
+            if (previous.open(QIODevice::ReadOnly)) {
+                const auto older = AuditLogIndex::load(previous, nullptr, &last);
+                m_lastMsecs = older.isEmpty() ? 0 : older.constLast().msecs;
+            }
+        }
+    }
+    m_lastHash = last.isEmpty() ? QByteArray() : AuditLogIndex::lineHash(last);
+
+    // Bring the sidecar up to date with lines it misses, e.g. from before it existed.
+    const QString indexPath = AuditLogIndex::indexPath(m_path);
+    const qint64 indexBytes =
+        AuditLogIndex::kHeaderBytes + qint64(indexed) * AuditLogIndex::kEntryBytes;
+    if (indexed != entries.size() || QFileInfo(indexPath).size() != indexBytes) {
+        QSaveFile rebuilt(indexPath);
+        if (!rebuilt.open(QIODevice::WriteOnly)) {
+            m_file.close();
+            return false;
+        }
+        QByteArray bytes = AuditLogIndex::encodeHeader();
+        for (const AuditLogIndex::Entry& entry : entries) {
+            bytes += AuditLogIndex::encodeEntry(entry);
+        }
+        if (rebuilt.write(bytes) != bytes.size() || !rebuilt.commit()) {
+            m_file.close();
+            return false;
+        }
+    }
+    m_index.setFileName(indexPath);
+    if (!m_index.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        m_file.close();
+        return false;
+    }
+    if (m_permissions) {
+        m_file.setPermissions(m_permissions);
+        m_index.setPermissions(m_permissions);
+    }
+    return true;
+}
+
+bool AuditWriter::syncFiles()
+{
+    return syncFile(m_file) && syncFile(m_index);
+}
+
+void AuditWriter::rollSegment()
+{
+    syncFiles();
+    m_file.close();
+    m_index.close();
+    quint64 next = 1;
+    for (const QString& segment : AuditLogIndex::segments(m_path)) {
+        if (segment != m_path) {
+            next = std::max(next, QFileInfo(segment).suffix().toULongLong() + 1);
+        }
+    }
+    const QString rolled = m_path + QLatin1Char('.') + QString::number(next);
+    // The index goes first: a log without its sidecar is re-indexed, not the other way round.
+    QFile::rename(AuditLogIndex::indexPath(m_path), AuditLogIndex::indexPath(rolled));
+    QFile::rename(m_path, rolled);
+}
+
+AuditWriter::Node* AuditWriter::drain(bool* wrote)
+{
+    // The stack is newest first; reverse it so lines keep the order they were appended in.
+    Node* fifo = nullptr;
+    for (Node* n = m_head.exchange(nullptr, std::memory_order_acquire); n;) {
+        Node* next = n->next;
+        n->next = fifo;
+        fifo = n;
+        n = next;
+    }
+    QByteArray batch;
+    QByteArray index;
+    *wrote = false;
+    const auto write = [&]() {
+        if (batch.isEmpty()) {
+            return;
+        }
+        if (m_file.write(batch) == batch.size() && m_index.write(index) == index.size()) {
+            *wrote = true;
+            m_size += batch.size();
+        } else {
+            m_file.close();  // reopened, and the chain and index reloaded, on the next line
+            m_index.close();
+        }
+        batch.clear();
+        index.clear();
+    };
+
+    Node* flushes = nullptr;
+    Node** flushesTail = &flushes;
+    while (fifo) {
+        Node* n = fifo;
+        fifo = n->next;
+        if (n->flushed) {
+            n->next = nullptr;
+            *flushesTail = n;
+            flushesTail = &n->next;
+            continue;
+        }
+        if (openFile()) {  // otherwise the line is dropped
+            QByteArray line = std::move(n->line);
+            if (line.endsWith('}')) {
+                line.chop(1);
+                line += line.size() > 1 ? ",\"prev\":\"" : "\"prev\":\"";
+                line += m_lastHash;
+                line += "\"}";
+            }
+            m_lastHash = AuditLogIndex::lineHash(line);
+            m_lastMsecs = std::max(m_lastMsecs, n->msecs);
+            const auto offset = static_cast<quint64>(m_size + batch.size());
+            index += AuditLogIndex::encodeEntry(
+                {m_lastMsecs, offset, AuditLogIndex::deviceHash(n->device)});
+            batch += line;
+            batch += '\n';
+            if (m_size + batch.size() >= AuditLogIndex::kSegmentBytes) {
+                write();
+                rollSegment();
+            }
+        }
+        delete n;
+    }
+    write();
+    return flushes;
+}
+
+void AuditWriter::run()
+{
+    using Clock = std::chrono::steady_clock;
+    const auto interval = std::chrono::milliseconds(kSyncIntervalMs);
+    bool dirty = false;
+    Clock::time_point lastSync;
+    for (;;) {
+        bool stop = false;
+        {
+            std::unique_lock lock(m_wakeMutex);
+            const auto ready = [this] { return m_stop || m_head.load(std::memory_order_acquire); };
+            if (dirty) {
+                m_wake.wait_until(lock, lastSync + interval, ready);
+            } else {
+                m_wake.wait(lock, ready);
+            }
+            stop = m_stop;
+        }
+        bool wrote = false;
+        Node* flushes = drain(&wrote);
+        dirty = dirty || wrote;
+        const Clock::time_point now = Clock::now();
+        if (dirty && (flushes || stop || now - lastSync >= interval)) {
+            syncFiles();
+            dirty = false;
+            lastSync = now;
+        }
+        while (flushes) {
+            Node* next = flushes->next;
+            flushes->flushed->set_value();
+            delete flushes;
+            flushes = next;
+        }
+        if (stop && !m_head.load(std::memory_order_acquire)) {
+            return;
+        }
+    }
+}
+
+} // namespace FlashSpartan
@@ -20,62 +20,65 @@ BadUsbAnomalyResult makeResult(const HidDeviceInfo& device, BadUsbSeverity sever
     return result;
 }
 
-} // namespace
-
-BadUsbAnomalyResult analyzeConnect(const HidDeviceInfo& device,
-                                   const std::optional<BadUsbBaselineEntry>& baseline,
-                                   const QStringList& relatedStorageNodes,
-                                   int recentConnectCount,
-                                   const AppSettings& settings)
+BadUsbAnomalyResult evaluate(const HidDeviceInfo& device,
+                             const std::optional<BadUsbBaselineEntry>& baseline,
+                             const QStringList& relatedStorageNodes,
+                             const BadUsbRuleSet& rules,
+                             const std::function<int(int)>& connectsWithin)
 {
+    if (const BadUsbRuleDefinition* rule = rules.match(device, baseline, relatedStorageNodes, connectsWithin)) {
+        return makeResult(device, rule->severity, rule->id, rule->summary, rule->detail, relatedStorageNodes);
+    }
     BadUsbAnomalyResult ok;
     ok.device = device;
     ok.relatedStorageNodes = relatedStorageNodes;
     ok.detectedAtUtc = QDateTime::currentDateTimeUtc();
+    return ok;
+}
 
-    if (settings.badUsbAlertCompositeStorage && device.isKeyboard()
-        && !relatedStorageNodes.isEmpty()) {
-        return makeResult(
-            device, BadUsbSeverity::Critical, QStringLiteral("composite-storage-keyboard"),
-            QStringLiteral("USB HID keyboard appeared with mass-storage on the same device"),
-            QStringLiteral("A keyboard interface and storage volume share identifiers. This is a "
-                           "common BadUSB pattern and should be trusted only if expected."),
-            relatedStorageNodes);
-    }
-
-    if (settings.badUsbAlertNewKeyboard && device.isKeyboard()
-        && (!baseline.has_value() || !baseline->trusted)) {
-        return makeResult(
-            device, BadUsbSeverity::Warning, QStringLiteral("new-keyboard"),
-            QStringLiteral("New untrusted USB keyboard detected"),
-            QStringLiteral("Keyboards can inject keystrokes immediately after connection. Add this "
-                           "device to the baseline only if you physically recognize it."),
-            relatedStorageNodes);
-    }
+} // namespace
 
-    if (settings.badUsbAlertInterfaceDrift && baseline.has_value()) {
-        const QStringList expected = baseline->device.interfaceSignatures();
-        const QStringList actual = device.interfaceSignatures();
-        if (!expected.isEmpty() && expected != actual) {
-            return makeResult(
-                device, BadUsbSeverity::Warning, QStringLiteral("interface-drift"),
-                QStringLiteral("USB HID interface set changed from baseline"),
-                QStringLiteral("The same HID identity now exposes a different interface, driver, "
-                               "or protocol set than the trusted baseline."),
-                relatedStorageNodes);
-        }
-    }
+BadUsbAnomalyResult analyzeConnect(const HidDeviceInfo& device,
+                                   const std::optional<BadUsbBaselineEntry>& baseline,
+                                   const QStringList& relatedStorageNodes,
+                                   const HidConnectCounter& connects,
+                                   qint64 nowSecs,
+                                   const BadUsbRuleSet& rules)
+{
+    const QString stableId = device.stableId();
+    return evaluate(device, baseline, relatedStorageNodes, rules, [&](int windowSeconds) {
+        return connects.count(stableId, windowSeconds, nowSecs);
+    });
+}
 
-    if (settings.badUsbAlertRapidReconnect && recentConnectCount >= 3) {
-        return makeResult(
-            device, BadUsbSeverity::Warning, QStringLiteral("rapid-reconnect"),
-            QStringLiteral("USB HID device reconnected repeatedly"),
-            QStringLiteral("Repeated disconnect/connect cycles can indicate firmware reset, "
-                           "interface switching, or probing behavior."),
-            relatedStorageNodes);
-    }
+BadUsbAnomalyResult analyzeConnect(const HidDeviceInfo& device,
+                                   const std::optional<BadUsbBaselineEntry>& baseline,
+                                   const QStringList& relatedStorageNodes,
+                                   int recentConnectCount,
+                                   const AppSettings& settings)
+{
+    const BadUsbRuleSet rules = BadUsbRuleSet::compile(BadUsbRuleSet::builtinRules(settings));
+    return evaluate(device, baseline, relatedStorageNodes, rules,
+                    [recentConnectCount](int) { return recentConnectCount; });
+}
 
-    return ok;
+BadUsbAnomalyResult analyzeKeystrokeRate(const HidDeviceInfo& device,
+                                         const HidKeystrokeAnalyzer::Finding& finding,
+                                         const std::optional<BadUsbBaselineEntry>& baseline)
+{
+    // Scripted injection from a trusted keyboard (reflashed firmware, macro hardware) is
+    // still worth a warning; from anything else it is the attack itself.
+    const bool trusted = baseline.has_value() && baseline->trusted;
+    return makeResult(
+        device, trusted ? BadUsbSeverity::Warning : BadUsbSeverity::Critical,
+        QStringLiteral("keystroke-rate"),
+        QStringLiteral("USB keyboard is typing faster than a person can"),
+        QStringLiteral("%1 key presses in %2 ms (%3 keys/s). Inter-key intervals: %4.")
+            .arg(finding.keys)
+            .arg(double(finding.spanUs) / 1000.0, 0, 'f', 1)
+            .arg(finding.keysPerSecond, 0, 'f', 0)
+            .arg(finding.histogramText()),
+        {});
 }
 
 QString severityLabel(BadUsbSeverity severity)
@@ -1,5 +1,6 @@
 #include "BadUsbBaselineStore.h"
 
+#include <QDataStream>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
@@ -10,13 +11,107 @@
 #include <QSaveFile>
 #include <QStandardPaths>
 
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 namespace FlashSpartan {
 
+namespace {
+
+constexpr quint32 kJournalMagic = 0x31425346;  // 'FSB1' little-endian
+constexpr quint16 kJournalVersion = 1;
+constexpr quint32 kMaxRecordBytes = 1024 * 1024;
+
+enum class JournalOp : quint8 {
+    Upsert = 1,
+    Remove = 2,
+};
+
+void prepare(QDataStream& stream)
+{
+    stream.setVersion(QDataStream::Qt_6_4);
+    stream.setByteOrder(QDataStream::LittleEndian);
+}
+
+QByteArray upsertPayload(const BadUsbBaselineEntry& entry)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    prepare(out);
+    out << quint8(JournalOp::Upsert) << QJsonDocument(entry.toJson()).toJson(QJsonDocument::Compact);
+    return payload;
+}
+
+QByteArray removePayload(const QString& stableId)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    prepare(out);
+    out << quint8(JournalOp::Remove) << stableId;
+    return payload;
+}
+
+/** Applies one journal record to @p devices; false for a record that does not decode. */
+bool replay(const QByteArray& payload, QHash<QString, BadUsbBaselineEntry>& devices)
+{
+    QDataStream in(payload);
+    prepare(in);
+    quint8 op = 0;
+    in >> op;
+    switch (JournalOp(op)) {
+    case JournalOp::Upsert: {
+        QByteArray json;
+        in >> json;
+        const BadUsbBaselineEntry entry = BadUsbBaselineEntry::fromJson(QJsonDocument::fromJson(json).object());
+        if (in.status() != QDataStream::Ok || entry.stableId.isEmpty()) {
+            return false;
+        }
+        devices.insert(entry.stableId, entry);
+        return true;
+    }
+    case JournalOp::Remove: {
+        QString stableId;
+        in >> stableId;
+        if (in.status() != QDataStream::Ok) {
+            return false;
+        }
+        devices.remove(stableId);
+        return true;
+    }
+    }
+    return false;
+}
+
+quint16 recordChecksum(const QByteArray& payload)
+{
+    return qChecksum(QByteArrayView(payload), Qt::ChecksumItuV41);
+}
+
+bool syncFile(QFile& file)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return fdatasync(file.handle()) == 0;
+#endif
+}
+
+} // namespace
+
 BadUsbBaselineStore::BadUsbBaselineStore(QObject* parent)
     : QObject(parent)
+    , m_snapshot(std::make_shared<const Snapshot>())
 {
 }
 
+BadUsbBaselineStore::~BadUsbBaselineStore() = default;
+
 QString BadUsbBaselineStore::defaultPath() const
 {
     const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation);
@@ -38,23 +133,44 @@ QString BadUsbBaselineStore::baselinePath() const
     return m_path;
 }
 
-QList<BadUsbBaselineEntry> BadUsbBaselineStore::allDevices() const
+QString BadUsbBaselineStore::journalPath() const
+{
+    return baselinePath() + QStringLiteral(".wal");
+}
+
+int BadUsbBaselineStore::journalEntries() const
 {
     QMutexLocker locker(&m_mutex);
-    return m_devices.values();
+    return m_journalEntries;
+}
+
+std::shared_ptr<const BadUsbBaselineStore::Snapshot> BadUsbBaselineStore::snapshot() const
+{
+    QMutexLocker locker(&m_snapshotMutex);
+    return m_snapshot;
+}
+
+void BadUsbBaselineStore::publish(std::shared_ptr<const Snapshot> next)
+{
+    QMutexLocker locker(&m_snapshotMutex);
+    m_snapshot = std::move(next);
+}
+
+QList<BadUsbBaselineEntry> BadUsbBaselineStore::allDevices() const
+{
+    return snapshot()->values();
 }
 
 bool BadUsbBaselineStore::hasDevice(const QString& stableId) const
 {
-    QMutexLocker locker(&m_mutex);
-    return m_devices.contains(stableId);
+    return snapshot()->contains(stableId);
 }
 
 std::optional<BadUsbBaselineEntry> BadUsbBaselineStore::getDevice(const QString& stableId) const
 {
-    QMutexLocker locker(&m_mutex);
-    const auto it = m_devices.constFind(stableId);
-    if (it == m_devices.constEnd()) {
+    const std::shared_ptr<const Snapshot> devices = snapshot();
+    const auto it = devices->constFind(stableId);
+    if (it == devices->constEnd()) {
         return std::nullopt;
     }
     return *it;
@@ -64,9 +180,11 @@ bool BadUsbBaselineStore::upsertBaseline(const HidDeviceInfo& info, bool trusted
 {
     const QString stableId = info.stableId();
     const QDateTime now = QDateTime::currentDateTimeUtc();
+    bool ok = false;
     {
         QMutexLocker locker(&m_mutex);
-        BadUsbBaselineEntry entry = m_devices.value(stableId);
+        auto next = std::make_shared<Snapshot>(*snapshot());
+        BadUsbBaselineEntry entry = next->value(stableId);
         if (entry.stableId.isEmpty()) {
             entry.stableId = stableId;
             entry.firstSeenUtc = now;
@@ -77,9 +195,10 @@ bool BadUsbBaselineStore::upsertBaseline(const HidDeviceInfo& info, bool trusted
         if (!notes.isEmpty()) {
             entry.notes = notes;
         }
-        m_devices.insert(stableId, entry);
+        next->insert(stableId, entry);
+        ok = commit(*next, upsertPayload(entry));
+        publish(std::move(next));
     }
-    const bool ok = save();
     if (ok) {
         emit baselineChanged();
     }
@@ -88,16 +207,19 @@ bool BadUsbBaselineStore::upsertBaseline(const HidDeviceInfo& info, bool trusted
 
 bool BadUsbBaselineStore::setTrusted(const QString& stableId, bool trusted)
 {
+    bool ok = false;
     {
         QMutexLocker locker(&m_mutex);
-        auto it = m_devices.find(stableId);
-        if (it == m_devices.end()) {
+        auto next = std::make_shared<Snapshot>(*snapshot());
+        auto it = next->find(stableId);
+        if (it == next->end()) {
             return false;
         }
         it->trusted = trusted;
         it->lastSeenUtc = QDateTime::currentDateTimeUtc();
+        ok = commit(*next, upsertPayload(*it));
+        publish(std::move(next));
     }
-    const bool ok = save();
     if (ok) {
         emit baselineChanged();
     }
@@ -106,13 +228,16 @@ bool BadUsbBaselineStore::setTrusted(const QString& stableId, bool trusted)
 
 bool BadUsbBaselineStore::removeDevice(const QString& stableId)
 {
+    bool ok = false;
     {
         QMutexLocker locker(&m_mutex);
-        if (m_devices.remove(stableId) == 0) {
+        auto next = std::make_shared<Snapshot>(*snapshot());
+        if (next->remove(stableId) == 0) {
             return false;
         }
+        ok = commit(*next, removePayload(stableId));
+        publish(std::move(next));
     }
-    const bool ok = save();
     if (ok) {
         emit baselineChanged();
     }
@@ -121,65 +246,103 @@ bool BadUsbBaselineStore::removeDevice(const QString& stableId)
 
 bool BadUsbBaselineStore::load()
 {
-    QString path;
-    {
-        QMutexLocker locker(&m_mutex);
-        if (m_path.isEmpty()) {
-            m_path = defaultPath();
-        }
-        path = m_path;
-        m_devices.clear();
-    }
-
-    QFile file(path);
-    if (!file.exists()) {
-        QDir().mkpath(QFileInfo(path).absolutePath());
-        return true;
+    QMutexLocker locker(&m_mutex);
+    if (m_path.isEmpty()) {
+        m_path = defaultPath();
     }
-    if (!file.open(QIODevice::ReadOnly)) {
-        return false;
+    if (m_journal) {
+        m_journal->close();
+        m_journal.reset();
     }
+    m_journalEntries = 0;
+    m_generation = 0;
+    publish(std::make_shared<const Snapshot>());
 
-    QJsonParseError parseError;
-    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
-    if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
-        return false;
+    Snapshot loaded;
+    QFile file(m_path);
+    if (!file.exists()) {
+        QDir().mkpath(QFileInfo(m_path).absolutePath());
+    } else {
+        if (!file.open(QIODevice::ReadOnly)) {
+            return false;
+        }
+        QJsonParseError parseError;
+        const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+        if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+            return false;
+        }
+        const QJsonObject root = doc.object();
+        m_generation = quint64(qMax<qint64>(0, root.value(QStringLiteral("generation")).toInteger(0)));
+        const QJsonArray devices = root.value(QStringLiteral("devices")).toArray();
+        for (const QJsonValue& value : devices) {
+            const BadUsbBaselineEntry entry = BadUsbBaselineEntry::fromJson(value.toObject());
+            if (!entry.stableId.isEmpty()) {
+                loaded.insert(entry.stableId, entry);
+            }
+        }
     }
 
-    QHash<QString, BadUsbBaselineEntry> loaded;
-    const QJsonArray devices = doc.object().value(QStringLiteral("devices")).toArray();
-    for (const QJsonValue& value : devices) {
-        const BadUsbBaselineEntry entry = BadUsbBaselineEntry::fromJson(value.toObject());
-        if (!entry.stableId.isEmpty()) {
-            loaded.insert(entry.stableId, entry);
+    // Edits since that checkpoint; a journal of another generation is already folded in.
+    int replayed = 0;
+    bool journalPresent = false;
+    QFile journal(m_path + QStringLiteral(".wal"));
+    if (journal.open(QIODevice::ReadOnly)) {
+        journalPresent = true;
+        QDataStream in(journal.readAll());
+        prepare(in);
+        quint32 magic = 0;
+        quint16 version = 0;
+        quint64 generation = 0;
+        in >> magic >> version >> generation;
+        if (in.status() == QDataStream::Ok && magic == kJournalMagic && version == kJournalVersion
+            && generation == m_generation) {
+            for (;;) {
+                quint32 length = 0;
+                in >> length;
+                if (in.status() != QDataStream::Ok || length > kMaxRecordBytes) {
+                    break;
+                }
+                QByteArray payload(qsizetype(length), Qt::Uninitialized);
+                quint16 checksum = 0;
+                if (in.readRawData(payload.data(), int(length)) != int(length)) {
+                    break;
+                }
+                in >> checksum;
+                if (in.status() != QDataStream::Ok || checksum != recordChecksum(payload)
+                    || !replay(payload, loaded)) {
+                    break;  // torn tail
+                }
+                ++replayed;
+            }
         }
     }
 
-    {
-        QMutexLocker locker(&m_mutex);
-        m_devices = loaded;
+    publish(std::make_shared<const Snapshot>(loaded));
+    if (replayed > 0) {
+        return writeCheckpoint(loaded);
     }
-    return true;
+    // A stale or torn journal is replaced, so nothing gets appended behind garbage.
+    return !journalPresent || resetJournal();
 }
 
-bool BadUsbBaselineStore::save() const
+bool BadUsbBaselineStore::save()
 {
-    QString path;
-    QList<BadUsbBaselineEntry> entries;
-    {
-        QMutexLocker locker(&m_mutex);
-        path = m_path.isEmpty() ? defaultPath() : m_path;
-        entries = m_devices.values();
-    }
+    QMutexLocker locker(&m_mutex);
+    return writeCheckpoint(*snapshot());  // edits publish under m_mutex, so this is current
+}
 
+bool BadUsbBaselineStore::writeCheckpoint(const Snapshot& devices)
+{
+    const QString path = m_path.isEmpty() ? defaultPath() : m_path;
     QDir().mkpath(QFileInfo(path).absolutePath());
     QJsonObject root;
     root.insert(QStringLiteral("version"), QStringLiteral("1.0"));
-    QJsonArray devices;
-    for (const BadUsbBaselineEntry& entry : entries) {
-        devices.append(entry.toJson());
+    root.insert(QStringLiteral("generation"), qint64(m_generation + 1));
+    QJsonArray array;
+    for (const BadUsbBaselineEntry& entry : devices) {
+        array.append(entry.toJson());
     }
-    root.insert(QStringLiteral("devices"), devices);
+    root.insert(QStringLiteral("devices"), array);
 
     QSaveFile file(path);
     if (!file.open(QIODevice::WriteOnly)) {
@@ -190,6 +353,63 @@ bool BadUsbBaselineStore::save() const
         return false;
     }
     QFile::setPermissions(path, QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+    // From here the old journal no longer matches and is ignored even if the reset fails.
+    ++m_generation;
+    return resetJournal();
+}
+
+bool BadUsbBaselineStore::resetJournal()
+{
+    if (m_journal) {
+        m_journal->close();
+        m_journal.reset();
+    }
+    m_journalEntries = 0;
+    const QString path = (m_path.isEmpty() ? defaultPath() : m_path) + QStringLiteral(".wal");
+    QByteArray header;
+    QDataStream out(&header, QIODevice::WriteOnly);
+    prepare(out);
+    out << kJournalMagic << kJournalVersion << m_generation;
+
+    QSaveFile sf(path);
+    if (!sf.open(QIODevice::WriteOnly) || sf.write(header) != header.size() || !sf.commit()) {
+        return false;
+    }
+    QFile::setPermissions(path, QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+    auto journal = std::make_unique<QFile>(path);
+    if (!journal->open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return false;
+    }
+    m_journal = std::move(journal);
+    return true;
+}
+
+bool BadUsbBaselineStore::appendJournal(const QByteArray& payload)
+{
+    if (!m_journal && !resetJournal()) {
+        return false;
+    }
+    QByteArray record;
+    QDataStream out(&record, QIODevice::WriteOnly);
+    prepare(out);
+    out << quint32(payload.size());
+    out.writeRawData(payload.constData(), int(payload.size()));
+    out << recordChecksum(payload);
+    if (m_journal->write(record) != record.size() || !syncFile(*m_journal)) {
+        m_journal->close();
+        m_journal.reset();
+        return false;
+    }
+    ++m_journalEntries;
+    return true;
+}
+
+bool BadUsbBaselineStore::commit(const Snapshot& next, const QByteArray& payload)
+{
+    if (m_journalEntries >= kCheckpointEntries || (m_journal && m_journal->size() >= kCheckpointBytes)
+        || !appendJournal(payload)) {
+        return writeCheckpoint(next);
+    }
     return true;
 }
 
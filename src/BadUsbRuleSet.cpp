@@ -0,0 +1,553 @@
+#include "BadUsbRuleSet.h"
+
+#include "HidDescriptorFingerprint.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+namespace FlashSpartan {
+
+namespace {
+
+std::optional<quint16> hex16(const QString& text)
+{
+    bool ok = false;
+    const uint value = text.trimmed().toUInt(&ok, 16);
+    if (!ok || value > 0xFFFF) {
+        return std::nullopt;
+    }
+    return quint16(value);
+}
+
+std::optional<BadUsbSeverity> severityFromString(const QString& text)
+{
+    const QString s = text.trimmed().toLower();
+    if (s == QLatin1String("info")) {
+        return BadUsbSeverity::Info;
+    }
+    if (s.isEmpty() || s == QLatin1String("warning")) {
+        return BadUsbSeverity::Warning;
+    }
+    if (s == QLatin1String("critical")) {
+        return BadUsbSeverity::Critical;
+    }
+    return std::nullopt;
+}
+
+std::optional<BadUsbRuleDefinition::Baseline> baselineFromString(const QString& text)
+{
+    using Baseline = BadUsbRuleDefinition::Baseline;
+    const QString s = text.trimmed().toLower();
+    if (s.isEmpty() || s == QLatin1String("any")) {
+        return Baseline::Any;
+    }
+    if (s == QLatin1String("unknown")) {
+        return Baseline::Unknown;
+    }
+    if (s == QLatin1String("known")) {
+        return Baseline::Known;
+    }
+    if (s == QLatin1String("untrusted")) {
+        return Baseline::Untrusted;
+    }
+    if (s == QLatin1String("trusted")) {
+        return Baseline::Trusted;
+    }
+    return std::nullopt;
+}
+
+QStringList stringList(const QJsonValue& value)
+{
+    QStringList out;
+    if (value.isString()) {
+        out.append(value.toString().trimmed());
+    }
+    for (const QJsonValue& item : value.toArray()) {
+        const QString s = item.toString().trimmed();
+        if (!s.isEmpty()) {
+            out.append(s);
+        }
+    }
+    return out;
+}
+
+bool baselineHolds(BadUsbRuleDefinition::Baseline state, const std::optional<BadUsbBaselineEntry>& baseline)
+{
+    using Baseline = BadUsbRuleDefinition::Baseline;
+    switch (state) {
+        case Baseline::Any: return true;
+        case Baseline::Unknown: return !baseline.has_value();
+        case Baseline::Known: return baseline.has_value();
+        case Baseline::Untrusted: return !baseline.has_value() || !baseline->trusted;
+        case Baseline::Trusted: return baseline.has_value() && baseline->trusted;
+    }
+    return false;
+}
+
+void setBit(std::vector<quint64>& bits, int index)
+{
+    bits[size_t(index / 64)] |= quint64(1) << (index % 64);
+}
+
+} // namespace
+
+bool BadUsbRuleDefinition::hasConditions() const
+{
+    return !vidPids.isEmpty() || !capabilities.isEmpty() || !fingerprints.isEmpty() || !manufacturerPattern.isEmpty()
+           || !productPattern.isEmpty() || !serialPattern.isEmpty() || !interfacePattern.isEmpty()
+           || baseline != Baseline::Any || relatedStorage || interfaceDrift || connectsAtLeast > 0;
+}
+
+int BadUsbRuleSet::intern(const QString& key, const Predicate& predicate)
+{
+    const auto it = m_predicateIndex.constFind(key);
+    if (it != m_predicateIndex.cend()) {
+        return it.value();
+    }
+    const int index = int(m_predicates.size());
+    m_predicates.push_back(predicate);
+    m_predicateIndex.insert(key, index);
+    return index;
+}
+
+BadUsbRuleSet BadUsbRuleSet::compile(const QList<BadUsbRuleDefinition>& rules, QStringList* errors)
+{
+    BadUsbRuleSet set;
+    // Predicate indices per rule; the masks are built once the table has its final size.
+    std::vector<std::vector<int>> conditions;
+    for (const BadUsbRuleDefinition& rule : rules) {
+        const QString where = rule.source.isEmpty() ? rule.id : QStringLiteral("%1 (%2)").arg(rule.id, rule.source);
+        auto fail = [&](const QString& why) {
+            if (errors) {
+                errors->append(QStringLiteral("BadUSB rule %1: %2").arg(where, why));
+            }
+        };
+        if (rule.id.isEmpty() || !rule.hasConditions()) {
+            fail(QStringLiteral("needs an id and at least one condition"));
+            continue;
+        }
+
+        // Patterns first: a bad one drops the rule before it adds anything to the table.
+        const std::pair<Field, const QString*> patternFields[] = {
+            {Field::Manufacturer, &rule.manufacturerPattern},
+            {Field::Product, &rule.productPattern},
+            {Field::Serial, &rule.serialPattern},
+            {Field::Interface, &rule.interfacePattern},
+        };
+        bool patternsOk = true;
+        for (const auto& [field, pattern] : patternFields) {
+            if (!pattern->isEmpty()
+                && !QRegularExpression(*pattern, QRegularExpression::CaseInsensitiveOption).isValid()) {
+                fail(QStringLiteral("invalid pattern \"%1\"").arg(*pattern));
+                patternsOk = false;
+            }
+        }
+        QList<quint32> vidPidKeys;
+        QList<quint16> vendorKeys;
+        for (const QString& entry : rule.vidPids) {
+            const auto vid = hex16(entry.section(QLatin1Char(':'), 0, 0));
+            const QString pidText = entry.section(QLatin1Char(':'), 1, 1).trimmed();
+            const auto pid = hex16(pidText);
+            if (!vid || (pidText != QLatin1String("*") && !pid)) {
+                fail(QStringLiteral("invalid VID:PID \"%1\"").arg(entry));
+                patternsOk = false;
+            } else if (pid) {
+                vidPidKeys.append((quint32(*vid) << 16) | *pid);
+            } else {
+                vendorKeys.append(*vid);
+            }
+        }
+        QList<QByteArray> fingerprintKeys;
+        for (const QString& entry : rule.fingerprints) {
+            const QByteArray fingerprint = HidDescriptorFingerprint::fromHex(entry);
+            if (fingerprint.isEmpty()) {
+                fail(QStringLiteral("invalid fingerprint \"%1\"").arg(entry));
+                patternsOk = false;
+            } else {
+                fingerprintKeys.append(fingerprint);
+            }
+        }
+        if (!patternsOk) {
+            continue;
+        }
+
+        std::vector<int> indices;
+        for (const QString& capability : rule.capabilities) {
+            const QString key = capability.toLower();
+            const int index = set.intern(QStringLiteral("cap:") + key, {PredicateKind::Capability});
+            set.m_capabilityPredicates.insert(key, index);
+            indices.push_back(index);
+        }
+        if (!vidPidKeys.isEmpty() || !vendorKeys.isEmpty()) {
+            std::sort(vidPidKeys.begin(), vidPidKeys.end());
+            std::sort(vendorKeys.begin(), vendorKeys.end());
+            QStringList keyParts;
+            for (quint32 k : vidPidKeys) {
+                keyParts.append(QString::number(k, 16));
+            }
+            for (quint16 k : vendorKeys) {
+                keyParts.append(QString::number(k, 16) + QLatin1String(":*"));
+            }
+            const int before = set.predicateCount();
+            const int index = set.intern(QStringLiteral("ids:") + keyParts.join(QLatin1Char(',')),
+                                         {PredicateKind::VidPid});
+            if (index == before) {
+                for (quint32 k : vidPidKeys) {
+                    set.m_vidPidPredicates[k].push_back(index);
+                }
+                for (quint16 k : vendorKeys) {
+                    set.m_vendorPredicates[k].push_back(index);
+                }
+            }
+            indices.push_back(index);
+        }
+        if (!fingerprintKeys.isEmpty()) {
+            std::sort(fingerprintKeys.begin(), fingerprintKeys.end());
+            fingerprintKeys.erase(std::unique(fingerprintKeys.begin(), fingerprintKeys.end()), fingerprintKeys.end());
+            QStringList keyParts;
+            for (const QByteArray& k : fingerprintKeys) {
+                keyParts.append(QString::fromLatin1(k.toHex()));
+            }
+            const int before = set.predicateCount();
+            const int index = set.intern(QStringLiteral("fp:") + keyParts.join(QLatin1Char(',')),
+                                         {PredicateKind::Fingerprint});
+            if (index == before) {
+                for (const QByteArray& k : fingerprintKeys) {
+                    set.m_fingerprintPredicates[k].push_back(index);
+                }
+            }
+            indices.push_back(index);
+        }
+        for (const auto& [field, pattern] : patternFields) {
+            if (pattern->isEmpty()) {
+                continue;
+            }
+            const QString key = QStringLiteral("re:%1:%2").arg(int(field)).arg(*pattern);
+            const int before = set.predicateCount();
+            const int index = set.intern(key, {PredicateKind::Pattern, int(set.m_patterns.size())});
+            if (index == before) {
+                QRegularExpression regex(*pattern, QRegularExpression::CaseInsensitiveOption);
+                regex.optimize();
+                set.m_patterns.push_back({field, regex});
+            }
+            indices.push_back(index);
+        }
+        if (rule.baseline != BadUsbRuleDefinition::Baseline::Any) {
+            indices.push_back(set.intern(QStringLiteral("baseline:%1").arg(int(rule.baseline)),
+                                         {PredicateKind::Baseline, int(rule.baseline)}));
+        }
+        if (rule.relatedStorage) {
+            indices.push_back(set.intern(QStringLiteral("storage"), {PredicateKind::RelatedStorage}));
+        }
+        if (rule.interfaceDrift) {
+            indices.push_back(set.intern(QStringLiteral("drift"), {PredicateKind::InterfaceDrift}));
+        }
+        if (rule.connectsAtLeast > 0) {
+            const int window = qMax(1, rule.connectsWithinSeconds);
+            indices.push_back(set.intern(QStringLiteral("connects:%1/%2").arg(rule.connectsAtLeast).arg(window),
+                                         {PredicateKind::Connects, rule.connectsAtLeast, window}));
+            set.m_maxWindowSeconds = qMax(set.m_maxWindowSeconds, window);
+        }
+        set.m_rules.append(rule);
+        conditions.push_back(std::move(indices));
+    }
+
+    for (size_t r = 0; r < conditions.size(); ++r) {
+        CompiledRule compiled;
+        compiled.severity = int(set.m_rules.at(qsizetype(r)).severity);
+        compiled.allow = set.m_rules.at(qsizetype(r)).allow;
+        set.m_hasAllowRules |= compiled.allow;
+        std::vector<int>& indices = conditions[r];
+        std::sort(indices.begin(), indices.end());
+        for (int index : indices) {
+            const int word = index / 64;
+            const quint64 bit = quint64(1) << (index % 64);
+            if (!compiled.required.empty() && compiled.required.back().first == word) {
+                compiled.required.back().second |= bit;
+            } else {
+                compiled.required.emplace_back(word, bit);
+            }
+        }
+        set.m_compiled.push_back(std::move(compiled));
+    }
+    set.m_predicateIndex.clear();
+    return set;
+}
+
+const BadUsbRuleDefinition* BadUsbRuleSet::match(const HidDeviceInfo& device,
+                                                 const std::optional<BadUsbBaselineEntry>& baseline,
+                                                 const QStringList& relatedStorageNodes,
+                                                 const std::function<int(int)>& connectsWithin) const
+{
+    if (m_compiled.empty()) {
+        return nullptr;
+    }
+    std::vector<quint64> truth((m_predicates.size() + 63) / 64, 0);
+
+    for (const QString& capability : device.capabilities) {
+        const auto it = m_capabilityPredicates.constFind(capability.toLower());
+        if (it != m_capabilityPredicates.cend()) {
+            setBit(truth, it.value());
+        }
+    }
+    const auto vid = hex16(device.vendorId);
+    const auto pid = hex16(device.productId);
+    if (vid) {
+        if (pid) {
+            const auto it = m_vidPidPredicates.constFind((quint32(*vid) << 16) | *pid);
+            if (it != m_vidPidPredicates.cend()) {
+                for (int index : it.value()) {
+                    setBit(truth, index);
+                }
+            }
+        }
+        const auto it = m_vendorPredicates.constFind(*vid);
+        if (it != m_vendorPredicates.cend()) {
+            for (int index : it.value()) {
+                setBit(truth, index);
+            }
+        }
+    }
+
+    if (!device.descriptorFingerprint.isEmpty()) {
+        const auto it = m_fingerprintPredicates.constFind(device.descriptorFingerprint);
+        if (it != m_fingerprintPredicates.cend()) {
+            for (int index : it.value()) {
+                setBit(truth, index);
+            }
+        }
+    }
+
+    QHash<int, int> connectCounts;  // window -> connects
+    std::optional<QStringList> signatures;
+    auto interfaceSignatures = [&]() -> const QStringList& {
+        if (!signatures) {
+            signatures = device.interfaceSignatures();
+        }
+        return *signatures;
+    };
+    for (size_t i = 0; i < m_predicates.size(); ++i) {
+        const Predicate& predicate = m_predicates[i];
+        bool holds = false;
+        switch (predicate.kind) {
+            case PredicateKind::Capability:
+            case PredicateKind::VidPid:
+            case PredicateKind::Fingerprint:
+                continue;  // set from the hashes above
+            case PredicateKind::Pattern: {
+                const Pattern& pattern = m_patterns[size_t(predicate.arg)];
+                switch (pattern.field) {
+                    case Field::Manufacturer: holds = pattern.regex.match(device.manufacturer).hasMatch(); break;
+                    case Field::Product: holds = pattern.regex.match(device.product).hasMatch(); break;
+                    case Field::Serial: holds = pattern.regex.match(device.serial).hasMatch(); break;
+                    case Field::Interface:
+                        for (const QString& signature : interfaceSignatures()) {
+                            if (pattern.regex.match(signature).hasMatch()) {
+                                holds = true;
+                                break;
+                            }
+                        }
+                        break;
+                }
+                break;
+            }
+            case PredicateKind::Baseline:
+                holds = baselineHolds(BadUsbRuleDefinition::Baseline(predicate.arg), baseline);
+                break;
+            case PredicateKind::RelatedStorage:
+                holds = !relatedStorageNodes.isEmpty();
+                break;
+            case PredicateKind::InterfaceDrift:
+                if (!baseline.has_value()) {
+                    break;
+                }
+                // Both fingerprinted: one fixed-width compare covers every descriptor byte.
+                if (!baseline->device.descriptorFingerprint.isEmpty() && !device.descriptorFingerprint.isEmpty()) {
+                    holds = baseline->device.descriptorFingerprint != device.descriptorFingerprint;
+                } else {
+                    const QStringList expected = baseline->device.interfaceSignatures();
+                    holds = !expected.isEmpty() && expected != interfaceSignatures();
+                }
+                break;
+            case PredicateKind::Connects: {
+                auto cached = connectCounts.constFind(predicate.arg2);
+                if (cached == connectCounts.cend()) {
+                    cached = connectCounts.insert(predicate.arg2, connectsWithin ? connectsWithin(predicate.arg2) : 0);
+                }
+                holds = cached.value() >= predicate.arg;
+                break;
+            }
+        }
+        if (holds) {
+            setBit(truth, int(i));
+        }
+    }
+
+    auto matches = [&](const CompiledRule& rule) {
+        return std::all_of(rule.required.cbegin(), rule.required.cend(), [&](const auto& word) {
+            return (truth[size_t(word.first)] & word.second) == word.second;
+        });
+    };
+    if (m_hasAllowRules && std::any_of(m_compiled.cbegin(), m_compiled.cend(), [&](const CompiledRule& rule) {
+            return rule.allow && matches(rule);
+        })) {
+        return nullptr;
+    }
+    int best = -1;
+    for (size_t r = 0; r < m_compiled.size(); ++r) {
+        const CompiledRule& rule = m_compiled[r];
+        if (rule.allow || (best >= 0 && rule.severity <= m_compiled[size_t(best)].severity)) {
+            continue;
+        }
+        if (matches(rule)) {
+            best = int(r);
+            if (rule.severity == int(BadUsbSeverity::Critical)) {
+                break;
+            }
+        }
+    }
+    return best >= 0 ? &m_rules.at(best) : nullptr;
+}
+
+QList<BadUsbRuleDefinition> BadUsbRuleSet::parse(const QJsonDocument& document, const QString& source,
+                                                 QStringList* errors)
+{
+    QList<BadUsbRuleDefinition> out;
+    const QJsonArray rules = document.object().value(QStringLiteral("rules")).toArray();
+    if (!document.isObject() || rules.isEmpty()) {
+        if (errors) {
+            errors->append(QStringLiteral("BadUSB rules %1: no \"rules\" array").arg(source));
+        }
+        return out;
+    }
+    for (const QJsonValue& value : rules) {
+        const QJsonObject obj = value.toObject();
+        const QJsonObject match = obj.value(QStringLiteral("match")).toObject();
+        BadUsbRuleDefinition rule;
+        rule.id = obj.value(QStringLiteral("id")).toString().trimmed();
+        rule.summary = obj.value(QStringLiteral("summary")).toString();
+        rule.detail = obj.value(QStringLiteral("detail")).toString();
+        rule.source = source;
+        rule.allow = obj.value(QStringLiteral("allow")).toBool(false);
+        const auto severity = severityFromString(obj.value(QStringLiteral("severity")).toString());
+        const auto baseline = baselineFromString(match.value(QStringLiteral("baseline")).toString());
+        if (!severity || !baseline) {
+            if (errors) {
+                errors->append(QStringLiteral("BadUSB rule %1 (%2): unknown severity or baseline state")
+                                   .arg(rule.id, source));
+            }
+            continue;
+        }
+        rule.severity = *severity;
+        rule.baseline = *baseline;
+        if (rule.summary.isEmpty()) {
+            rule.summary = QStringLiteral("USB HID device matches rule %1").arg(rule.id);
+        }
+        rule.vidPids = stringList(match.value(QStringLiteral("vid_pid")));
+        rule.capabilities = stringList(match.value(QStringLiteral("capabilities")));
+        rule.fingerprints = stringList(match.value(QStringLiteral("fingerprint")));
+        rule.manufacturerPattern = match.value(QStringLiteral("manufacturer")).toString();
+        rule.productPattern = match.value(QStringLiteral("product")).toString();
+        rule.serialPattern = match.value(QStringLiteral("serial")).toString();
+        rule.interfacePattern = match.value(QStringLiteral("interface")).toString();
+        rule.relatedStorage = match.value(QStringLiteral("related_storage")).toBool(false);
+        rule.interfaceDrift = match.value(QStringLiteral("interface_drift")).toBool(false);
+        const QJsonObject connects = match.value(QStringLiteral("connects")).toObject();
+        rule.connectsAtLeast = connects.value(QStringLiteral("at_least")).toInt(0);
+        rule.connectsWithinSeconds = connects.value(QStringLiteral("within_seconds")).toInt(10);
+        out.append(rule);
+    }
+    return out;
+}
+
+QList<BadUsbRuleDefinition> BadUsbRuleSet::builtinRules(const AppSettings& settings)
+{
+    QList<BadUsbRuleDefinition> rules;
+    if (settings.badUsbAlertCompositeStorage) {
+        BadUsbRuleDefinition rule;
+        rule.id = QStringLiteral("composite-storage-keyboard");
+        rule.severity = BadUsbSeverity::Critical;
+        rule.summary = QStringLiteral("USB HID keyboard appeared with mass-storage on the same device");
+        rule.detail = QStringLiteral("A keyboard interface and storage volume share identifiers. This is a "
+                                     "common BadUSB pattern and should be trusted only if expected.");
+        rule.capabilities = {QStringLiteral("keyboard")};
+        rule.relatedStorage = true;
+        rules.append(rule);
+    }
+    if (settings.badUsbAlertNewKeyboard) {
+        BadUsbRuleDefinition rule;
+        rule.id = QStringLiteral("new-keyboard");
+        rule.summary = QStringLiteral("New untrusted USB keyboard detected");
+        rule.detail = QStringLiteral("Keyboards can inject keystrokes immediately after connection. Add this "
+                                     "device to the baseline only if you physically recognize it.");
+        rule.capabilities = {QStringLiteral("keyboard")};
+        rule.baseline = BadUsbRuleDefinition::Baseline::Untrusted;
+        rules.append(rule);
+    }
+    if (settings.badUsbAlertInterfaceDrift) {
+        BadUsbRuleDefinition rule;
+        rule.id = QStringLiteral("interface-drift");
+        rule.summary = QStringLiteral("USB HID interface set changed from baseline");
+        rule.detail = QStringLiteral("The same HID identity now exposes a different interface, driver, "
+                                     "or protocol set than the trusted baseline.");
+        rule.interfaceDrift = true;
+        rules.append(rule);
+    }
+    if (settings.badUsbAlertRapidReconnect) {
+        BadUsbRuleDefinition rule;
+        rule.id = QStringLiteral("rapid-reconnect");
+        rule.summary = QStringLiteral("USB HID device reconnected repeatedly");
+        rule.detail = QStringLiteral("Repeated disconnect/connect cycles can indicate firmware reset, "
+                                     "interface switching, or probing behavior.");
+        rule.connectsAtLeast = 3;
+        rule.connectsWithinSeconds = 10;
+        rules.append(rule);
+    }
+    return rules;
+}
+
+QStringList BadUsbRuleSet::dropInDirectories()
+{
+    QStringList dirs;
+    dirs << QStringLiteral("/usr/share/flashspartan/badusb-rules.d");
+    dirs << QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)
+              + QStringLiteral("/badusb-rules.d");
+    return dirs;
+}
+
+QList<BadUsbRuleDefinition> BadUsbRuleSet::loadDropIns(QStringList* errors)
+{
+    QList<BadUsbRuleDefinition> rules;
+    for (const QString& dirPath : dropInDirectories()) {
+        const QDir dir(dirPath);
+        const QFileInfoList files = dir.entryInfoList({QStringLiteral("*.json")}, QDir::Files, QDir::Name);
+        for (const QFileInfo& info : files) {
+            QFile file(info.absoluteFilePath());
+            if (!file.open(QIODevice::ReadOnly)) {
+                if (errors) {
+                    errors->append(QStringLiteral("BadUSB rules %1: %2").arg(info.absoluteFilePath(), file.errorString()));
+                }
+                continue;
+            }
+            QJsonParseError parseError;
+            const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &parseError);
+            if (parseError.error != QJsonParseError::NoError) {
+                if (errors) {
+                    errors->append(QStringLiteral("BadUSB rules %1: %2")
+                                       .arg(info.absoluteFilePath(), parseError.errorString()));
+                }
+                continue;
+            }
+            rules += parse(doc, info.absoluteFilePath(), errors);
+        }
+    }
+    return rules;
+}
+
+} // namespace FlashSpartan
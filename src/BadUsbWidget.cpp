@@ -241,6 +241,18 @@ void BadUsbWidget::addAnomaly(const BadUsbAnomalyResult& anomaly)
     }
 }
 
+void BadUsbWidget::addCaptureSummary(const BadUsbAnomalyResult& anomaly, const QString& headline,
+                                     const QString& text)
+{
+    const QString line = QStringLiteral("[%1] Capture of %2 (%3): %4")
+        .arg(QDateTime::currentDateTime().toString(QStringLiteral("hh:mm:ss")),
+             anomaly.ruleId,
+             anomaly.device.displayName(),
+             headline);
+    m_anomalyList->insertItem(0, line);
+    m_anomalyList->item(0)->setToolTip(text);
+}
+
 void BadUsbWidget::setCaptureStatus(const QString& message)
 {
     m_captureLabel->setText(QStringLiteral("Capture: %1").arg(message));
@@ -0,0 +1,79 @@
+// See Xxh3Digest.cpp: EVP_MD_meth_* is deprecated in OpenSSL 3 but is still the
+// supported way to feed a non-provider digest through EVP_DigestInit_ex.
+#define OPENSSL_SUPPRESS_DEPRECATED
+
+#include "Blake3Digest.h"
+
+#ifdef HAS_BLAKE3
+
+#include <blake3.h>
+
+namespace FlashSpartan::RawDeviceHash {
+
+namespace {
+
+// blake3_hasher is plain data with no alignment demands, so it lives directly in
+// md_data and EVP_MD_CTX_copy_ex's memcpy is a complete copy.
+blake3_hasher* hasherOf(EVP_MD_CTX* ctx)
+{
+    return static_cast<blake3_hasher*>(EVP_MD_CTX_md_data(ctx));
+}
+
+int blake3Init(EVP_MD_CTX* ctx)
+{
+    blake3_hasher_init(hasherOf(ctx));
+    return 1;
+}
+
+int blake3Update(EVP_MD_CTX* ctx, const void* data, size_t count)
+{
+    blake3_hasher_update(hasherOf(ctx), data, count);
+    return 1;
+}
+
+int blake3Final(EVP_MD_CTX* ctx, unsigned char* md)
+{
+    blake3_hasher_finalize(hasherOf(ctx), md, BLAKE3_OUT_LEN);
+    return 1;
+}
+
+EVP_MD* createBlake3Md()
+{
+    EVP_MD* md = EVP_MD_meth_new(NID_undef, NID_undef);
+    if (!md) {
+        return nullptr;
+    }
+    if (EVP_MD_meth_set_result_size(md, BLAKE3_OUT_LEN) != 1
+        || EVP_MD_meth_set_input_blocksize(md, BLAKE3_BLOCK_LEN) != 1
+        || EVP_MD_meth_set_app_datasize(md, sizeof(blake3_hasher)) != 1
+        || EVP_MD_meth_set_init(md, blake3Init) != 1
+        || EVP_MD_meth_set_update(md, blake3Update) != 1
+        || EVP_MD_meth_set_final(md, blake3Final) != 1) {
+        EVP_MD_meth_free(md);
+        return nullptr;
+    }
+    return md;
+}
+
+} // namespace
+
+const EVP_MD* blake3Digest()
+{
+    static const EVP_MD* md = createBlake3Md();
+    return md;
+}
+
+} // namespace FlashSpartan::RawDeviceHash
+
+#else
+
+namespace FlashSpartan::RawDeviceHash {
+
+const EVP_MD* blake3Digest()
+{
+    return nullptr;
+}
+
+} // namespace FlashSpartan::RawDeviceHash
+
+#endif
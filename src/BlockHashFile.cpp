@@ -0,0 +1,170 @@
+#include "BlockHashFile.h"
+
+#include "HexEncoding.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QSaveFile>
+#include <QtEndian>
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr qsizetype kHeaderBytes = 20;
+constexpr int kMaxDigestBytes = 64;
+/** Distinct golden images whose lists stay decoded; a site rarely has more than a few. */
+constexpr qsizetype kMaxCachedLists = 64;
+
+QMutex g_cacheMutex;
+QHash<QString, BlockHashFile::Blocks> g_cache;
+
+QString contentDigest(const QByteArray& data)
+{
+    return HexEncoding::toString(QCryptographicHash::hash(data, QCryptographicHash::Sha256));
+}
+
+bool writeFile(const QString& directory, const QString& path, const QByteArray& data, QString* error)
+{
+    if (QFileInfo::exists(path)) {
+        return true;  // content-addressed: same bytes already there
+    }
+    QDir().mkpath(directory);
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        if (error) {
+            *error = QStringLiteral("Cannot write %1: %2").arg(path, file.errorString());
+        }
+        return false;
+    }
+    QFile::setPermissions(path, QFile::ReadOwner | QFile::WriteOwner);
+    return true;
+}
+
+} // namespace
+
+QByteArray BlockHashFile::encode(const QStringList& blockHashes, uint64_t blockSize)
+{
+    const qsizetype hexChars = blockHashes.isEmpty() ? 0 : blockHashes.first().size();
+    const qsizetype width = hexChars / 2;
+    if (blockHashes.isEmpty() || hexChars % 2 != 0 || width == 0 || width > kMaxDigestBytes) {
+        return {};
+    }
+    QByteArray out;
+    out.reserve(kHeaderBytes + width * blockHashes.size());
+    const auto put = [&out](auto v) {
+        v = qToLittleEndian(v);
+        out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    };
+    put(kMagic);
+    put(kVersion);
+    put(static_cast<quint16>(width));
+    put(static_cast<quint64>(blockSize));
+    put(static_cast<quint32>(blockHashes.size()));
+    for (const QString& hex : blockHashes) {
+        const QByteArray raw = QByteArray::fromHex(hex.toLatin1());
+        if (hex.size() != hexChars || raw.size() != width
+            || HexEncoding::toString(raw) != hex.toLower()) {
+            return {};
+        }
+        out.append(raw);
+    }
+    return out;
+}
+
+std::optional<BlockHashFile::Blocks> BlockHashFile::decode(const QByteArray& data)
+{
+    if (!isEncoded(data) || data.size() < kHeaderBytes) {
+        return std::nullopt;
+    }
+    const auto* p = reinterpret_cast<const uchar*>(data.constData());
+    const quint16 version = qFromLittleEndian<quint16>(p + 4);
+    const quint16 width = qFromLittleEndian<quint16>(p + 6);
+    const quint64 blockSize = qFromLittleEndian<quint64>(p + 8);
+    const quint32 count = qFromLittleEndian<quint32>(p + 16);
+    if (version != kVersion || width == 0 || width > kMaxDigestBytes
+        || data.size() != kHeaderBytes + qsizetype(width) * qsizetype(count)) {
+        return std::nullopt;
+    }
+    Blocks blocks;
+    blocks.blockSize = blockSize;
+    blocks.hashes.reserve(count);
+    for (quint32 i = 0; i < count; ++i) {
+        blocks.hashes.append(HexEncoding::toString(p + kHeaderBytes + qsizetype(i) * width, width));
+    }
+    return blocks;
+}
+
+bool BlockHashFile::isEncoded(const QByteArray& data)
+{
+    return data.size() >= 4
+           && qFromLittleEndian<quint32>(reinterpret_cast<const uchar*>(data.constData())) == kMagic;
+}
+
+QString BlockHashFile::pathFor(const QString& directory, const QString& sha256Hex)
+{
+    return directory + QLatin1Char('/') + sha256Hex + QStringLiteral(".fsbh");
+}
+
+QString BlockHashFile::save(const QString& directory, const QStringList& blockHashes, uint64_t blockSize,
+                            QString* error)
+{
+    const QByteArray data = encode(blockHashes, blockSize);
+    if (data.isEmpty()) {
+        if (error) {
+            *error = QStringLiteral("Block digests are not hex of one width");
+        }
+        return {};
+    }
+    const QString digest = contentDigest(data);
+    return writeFile(directory, pathFor(directory, digest), data, error) ? digest : QString();
+}
+
+bool BlockHashFile::saveEncoded(const QString& directory, const QByteArray& data, const QString& sha256Hex,
+                                QString* error)
+{
+    if (contentDigest(data) != sha256Hex || !decode(data)) {
+        if (error) {
+            *error = QStringLiteral("Block digests %1 are altered or malformed").arg(sha256Hex);
+        }
+        return false;
+    }
+    return writeFile(directory, pathFor(directory, sha256Hex), data, error);
+}
+
+std::optional<BlockHashFile::Blocks> BlockHashFile::load(const QString& directory, const QString& sha256Hex)
+{
+    {
+        QMutexLocker locker(&g_cacheMutex);
+        const auto it = g_cache.constFind(sha256Hex);
+        if (it != g_cache.cend()) {
+            return it.value();
+        }
+    }
+    QFile file(pathFor(directory, sha256Hex));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+    const QByteArray data = file.readAll();
+    std::optional<Blocks> blocks = contentDigest(data) == sha256Hex ? decode(data) : std::nullopt;
+    if (blocks) {
+        QMutexLocker locker(&g_cacheMutex);
+        if (g_cache.size() >= kMaxCachedLists) {
+            g_cache.clear();
+        }
+        g_cache.insert(sha256Hex, *blocks);
+    }
+    return blocks;
+}
+
+void BlockHashFile::clearCache()
+{
+    QMutexLocker locker(&g_cacheMutex);
+    g_cache.clear();
+}
+
+} // namespace FlashSpartan
@@ -13,27 +13,53 @@ BlockedDriveStore& BlockedDriveStore::instance()
 
 void BlockedDriveStore::refreshFromGateway()
 {
-    m_entries.clear();
     Policy::PolicyGateway* gate = Policy::PolicyServiceLocator::gateway();
     if (!gate) {
+        setEntries({});
         return;
     }
-    for (const BlockedDriveEntry& e : gate->snapshot().blocks) {
-        m_entries.append(e);
+    if (m_gateway != gate) {
+        m_gateway = gate;
+        m_epoch = 0;
+        m_generation = 0;
+        gate->addChangeListener([this, gate](const Policy::PolicyDelta& delta) {
+            if (m_gateway == gate && delta.blocksChanged) {
+                setEntries(delta.blocks);
+            }
+        });
     }
+    const Policy::PolicyDelta delta = gate->changesSince(m_epoch, m_generation);
+    if (delta.blocksChanged) {
+        setEntries(delta.blocks);
+    }
+    m_epoch = delta.epoch;
+    m_generation = delta.generation;
 }
 
-bool BlockedDriveStore::isBlocked(const QString& driveKey, const QString& uniqueId) const
+void BlockedDriveStore::setEntries(const QList<BlockedDriveEntry>& entries)
 {
-    for (const BlockedDriveEntry& e : m_entries) {
-        if (!driveKey.isEmpty() && e.driveKey == driveKey) {
-            return true;
+    // Deltas carry the whole block list, so the sets are rebuilt once per block change
+    // rather than searched on every connect.
+    m_entries = entries;
+    ++m_listGeneration;
+    m_driveKeys.clear();
+    m_uniqueIds.clear();
+    m_driveKeys.reserve(entries.size());
+    m_uniqueIds.reserve(entries.size());
+    for (const BlockedDriveEntry& e : entries) {
+        if (!e.driveKey.isEmpty()) {
+            m_driveKeys.insert(e.driveKey);
         }
-        if (!uniqueId.isEmpty() && e.uniqueId == uniqueId) {
-            return true;
+        if (!e.uniqueId.isEmpty()) {
+            m_uniqueIds.insert(e.uniqueId);
         }
     }
-    return false;
+}
+
+bool BlockedDriveStore::isBlocked(const QString& driveKey, const QString& uniqueId) const
+{
+    return (!driveKey.isEmpty() && m_driveKeys.contains(driveKey))
+           || (!uniqueId.isEmpty() && m_uniqueIds.contains(uniqueId));
 }
 
 void BlockedDriveStore::block(const QString& driveKey, const QString& uniqueId, const QString& label)
@@ -66,24 +92,12 @@ QList<BlockedDriveEntry> BlockedDriveStore::entries() const
 
 QSet<QString> BlockedDriveStore::blockedDriveKeys() const
 {
-    QSet<QString> keys;
-    for (const BlockedDriveEntry& e : m_entries) {
-        if (!e.driveKey.isEmpty()) {
-            keys.insert(e.driveKey);
-        }
-    }
-    return keys;
+    return m_driveKeys;
 }
 
 QSet<QString> BlockedDriveStore::blockedUniqueIds() const
 {
-    QSet<QString> ids;
-    for (const BlockedDriveEntry& e : m_entries) {
-        if (!e.uniqueId.isEmpty()) {
-            ids.insert(e.uniqueId);
-        }
-    }
-    return ids;
+    return m_uniqueIds;
 }
 
 } // namespace FlashSpartan
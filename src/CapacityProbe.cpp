@@ -0,0 +1,311 @@
+#include "CapacityProbe.h"
+#include "RawDeviceHash.h"
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#ifdef Q_OS_WIN
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace FlashSpartan::CapacityProbe {
+
+namespace {
+
+char* allocAligned(size_t bytes)
+{
+#ifdef Q_OS_WIN
+    return static_cast<char*>(_aligned_malloc(bytes, kSectorBytes));
+#else
+    void* p = nullptr;
+    return posix_memalign(&p, kSectorBytes, bytes) == 0 ? static_cast<char*>(p) : nullptr;
+#endif
+}
+
+void freeAligned(char* p)
+{
+#ifdef Q_OS_WIN
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+using AlignedBuffer = std::unique_ptr<char, decltype(&freeAligned)>;
+
+/** All one byte value: erased flash, zero fill. Such sectors say nothing about aliasing. */
+bool isBlank(const char* data, size_t length)
+{
+    return length == 0 || std::memcmp(data, data + 1, length - 1) == 0;
+}
+
+uint64_t fingerprint(const char* data, size_t length)
+{
+    return static_cast<uint64_t>(qHashBits(data, length, 0));
+}
+
+QString gib(uint64_t bytes)
+{
+    return QStringLiteral("%1 GiB").arg(static_cast<double>(bytes) / (1024.0 * 1024.0 * 1024.0), 0, 'f', 2);
+}
+
+uint64_t sectorFloor(uint64_t bytes)
+{
+    return bytes / kSectorBytes * kSectorBytes;
+}
+
+struct ProbeRead {
+    uint64_t offset = 0;
+    size_t length = 0;
+    bool ok = false;
+    uint64_t aliasAt = 0;  // offset the head reappears at, judged from this window
+    int aliasVotes = 0;
+};
+
+} // namespace
+
+std::vector<uint64_t> periodOffsets(uint64_t claimedBytes)
+{
+    std::vector<uint64_t> offsets;
+    for (uint64_t p = kMinPeriodBytes; p > 0 && p < claimedBytes; p <<= 1) {
+        if (sectorFloor(claimedBytes - p) > 0) {
+            offsets.push_back(p);
+        }
+    }
+    return offsets;
+}
+
+std::vector<uint64_t> gridOffsets(uint64_t claimedBytes)
+{
+    std::vector<uint64_t> offsets;
+    const uint64_t lastSector = sectorFloor(claimedBytes);
+    if (lastSector < kSectorBytes) {
+        return offsets;
+    }
+    for (int i = 1; i <= kGridReads; ++i) {
+        const uint64_t at = i == kGridReads
+            ? lastSector - kSectorBytes
+            : sectorFloor(claimedBytes / static_cast<uint64_t>(kGridReads) * static_cast<uint64_t>(i));
+        if (at >= kWindowBytes && (offsets.empty() || at > offsets.back())) {
+            offsets.push_back(at);
+        }
+    }
+    return offsets;
+}
+
+CapacityCheck run(uint64_t claimedBytes, const ReadAt& readAt, int readers)
+{
+    QElapsedTimer timer;
+    timer.start();
+    CapacityCheck check;
+    check.claimedBytes = claimedBytes;
+    auto finish = [&](CapacityCheck::Verdict verdict, uint64_t realBytes, const QString& detail) {
+        check.verdict = verdict;
+        check.realBytes = realBytes;
+        check.detail = detail;
+        check.durationMs = static_cast<uint64_t>(timer.elapsed());
+        check.probedAt = QDateTime::currentDateTimeUtc();
+        return check;
+    };
+
+    const size_t headLength = static_cast<size_t>(sectorFloor(qMin(kWindowBytes, claimedBytes)));
+    AlignedBuffer head(allocAligned(kWindowBytes), &freeAligned);
+    if (!head || headLength == 0) {
+        return finish(CapacityCheck::Verdict::Inconclusive, 0, QStringLiteral("Device too small to probe"));
+    }
+    if (!readAt(0, head.get(), headLength)) {
+        return finish(CapacityCheck::Verdict::Inconclusive, 0, QStringLiteral("Start of the device is unreadable"));
+    }
+    check.bytesRead = headLength;
+
+    // Distinct, non-blank head sectors by content. A sector repeated within the head cannot
+    // place an alias, so it is dropped.
+    QHash<uint64_t, uint64_t> headSectors;
+    QSet<uint64_t> repeated;
+    for (uint64_t at = 0; at < headLength; at += kSectorBytes) {
+        const char* sector = head.get() + at;
+        if (isBlank(sector, kSectorBytes)) {
+            continue;
+        }
+        const uint64_t print = fingerprint(sector, kSectorBytes);
+        if (headSectors.contains(print)) {
+            repeated.insert(print);
+        } else {
+            headSectors.insert(print, at);
+        }
+    }
+    for (uint64_t print : std::as_const(repeated)) {
+        headSectors.remove(print);
+    }
+    head.reset();
+
+    std::vector<ProbeRead> reads;
+    for (uint64_t offset : periodOffsets(claimedBytes)) {
+        reads.push_back({offset, static_cast<size_t>(sectorFloor(qMin(kWindowBytes, claimedBytes - offset)))});
+    }
+    for (uint64_t offset : gridOffsets(claimedBytes)) {
+        reads.push_back({offset, static_cast<size_t>(kSectorBytes)});
+    }
+
+    std::atomic<size_t> next{0};
+    auto reader = [&]() {
+        AlignedBuffer buffer(allocAligned(kWindowBytes), &freeAligned);
+        if (!buffer) {
+            return;
+        }
+        for (size_t i = next++; i < reads.size(); i = next++) {
+            ProbeRead& read = reads[i];
+            read.ok = readAt(read.offset, buffer.get(), read.length);
+            if (!read.ok || headSectors.isEmpty()) {
+                continue;
+            }
+            QHash<uint64_t, int> votes;
+            for (size_t at = 0; at < read.length; at += kSectorBytes) {
+                const auto hit = headSectors.constFind(fingerprint(buffer.get() + at, kSectorBytes));
+                if (hit != headSectors.cend() && read.offset + at > hit.value()) {
+                    ++votes[read.offset + at - hit.value()];
+                }
+            }
+            for (auto it = votes.cbegin(); it != votes.cend(); ++it) {
+                if (it.value() > read.aliasVotes) {
+                    read.aliasAt = it.key();
+                    read.aliasVotes = it.value();
+                }
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    const size_t threads = qBound<size_t>(1, static_cast<size_t>(readers), qMax<size_t>(1, reads.size()));
+    pool.reserve(threads);
+    for (size_t t = 0; t < threads; ++t) {
+        pool.emplace_back(reader);
+    }
+    for (std::thread& t : pool) {
+        t.join();
+    }
+    std::sort(reads.begin(), reads.end(), [](const ProbeRead& a, const ProbeRead& b) { return a.offset < b.offset; });
+
+    uint64_t aliasAt = 0;
+    const ProbeRead* firstFailed = nullptr;
+    bool readableAfterFailure = false;
+    for (const ProbeRead& read : reads) {
+        if (read.ok) {
+            check.bytesRead += read.length;
+            readableAfterFailure = readableAfterFailure || firstFailed != nullptr;
+        } else if (!firstFailed) {
+            firstFailed = &read;
+        }
+        // A wrapped device repeats the whole head, so most of its sectors must agree.
+        const bool aliased = read.aliasVotes >= kMinAliasSectors
+                             && 2 * static_cast<qsizetype>(read.aliasVotes) >= headSectors.size();
+        if (aliased && (aliasAt == 0 || read.aliasAt < aliasAt)) {
+            aliasAt = read.aliasAt;
+        }
+    }
+
+    if (aliasAt > 0) {
+        return finish(CapacityCheck::Verdict::Aliased, aliasAt,
+                      QStringLiteral("The start of the device reappears at %1").arg(gib(aliasAt)));
+    }
+    if (firstFailed && !readableAfterFailure) {
+        // Narrow the edge down to one sector between the last good read and the first bad one.
+        uint64_t good = kWindowBytes;
+        for (const ProbeRead& read : reads) {
+            if (read.ok && read.offset < firstFailed->offset) {
+                good = qMax(good, read.offset + read.length);
+            }
+        }
+        uint64_t bad = firstFailed->offset;
+        AlignedBuffer sector(allocAligned(kSectorBytes), &freeAligned);
+        while (sector && bad > good) {
+            const uint64_t mid = sectorFloor(good + (bad - good) / 2);
+            if (readAt(mid, sector.get(), kSectorBytes)) {
+                check.bytesRead += kSectorBytes;
+                good = mid + kSectorBytes;
+            } else {
+                bad = mid;
+            }
+        }
+        return finish(CapacityCheck::Verdict::UnreadableBeyond, bad,
+                      QStringLiteral("Reads fail from %1 to the end").arg(gib(bad)));
+    }
+    if (firstFailed) {
+        return finish(CapacityCheck::Verdict::Inconclusive, 0,
+                      QStringLiteral("Read error at %1, but later reads succeed").arg(gib(firstFailed->offset)));
+    }
+    if (headSectors.size() < kMinAliasSectors) {
+        return finish(CapacityCheck::Verdict::Inconclusive, 0,
+                      QStringLiteral("The start of the device is blank, so aliasing cannot show without writing"));
+    }
+    return finish(CapacityCheck::Verdict::NoAliasing, claimedBytes,
+                  QStringLiteral("No aliasing at %1 offsets").arg(reads.size()));
+}
+
+CapacityCheck probeDevice(const QString& deviceNode)
+{
+    const int fd = RawDeviceHash::openDevice(deviceNode);
+    if (fd < 0) {
+        CapacityCheck check;
+        check.detail = QStringLiteral("Cannot open %1 for reading").arg(deviceNode);
+        return check;
+    }
+    const uint64_t claimed = RawDeviceHash::deviceSize(fd, deviceNode);
+
+#ifdef Q_OS_WIN
+    // One positioned read at a time on the shared handle.
+    const HANDLE handle = reinterpret_cast<HANDLE>(static_cast<intptr_t>(fd));
+    std::mutex handleMutex;
+    const ReadAt readAt = [&](uint64_t offset, char* buffer, size_t length) {
+        std::lock_guard<std::mutex> lock(handleMutex);
+        LARGE_INTEGER pos{};
+        pos.QuadPart = static_cast<LONGLONG>(offset);
+        DWORD read = 0;
+        return SetFilePointerEx(handle, pos, nullptr, FILE_BEGIN) != 0
+               && ReadFile(handle, buffer, static_cast<DWORD>(length), &read, nullptr) && static_cast<size_t>(read) == length;
+    };
+    const CapacityCheck check = run(claimed, readAt, 1);
+#else
+    const ReadAt readAt = [fd](uint64_t offset, char* buffer, size_t length) {
+        size_t filled = 0;
+        while (filled < length) {
+            const ssize_t n = pread(fd, buffer + filled, length - filled, static_cast<off_t>(offset + filled));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            filled += static_cast<size_t>(n);
+        }
+        return true;
+    };
+    const CapacityCheck check = run(claimed, readAt);
+#endif
+    RawDeviceHash::closeDevice(fd);
+    return check;
+}
+
+QString describe(const CapacityCheck& check)
+{
+    QString line = QStringLiteral("%1 (reports %2)").arg(check.detail, gib(check.claimedBytes));
+    if (check.isCounterfeit()) {
+        line = QStringLiteral("Counterfeit capacity: real size at most %1. %2").arg(gib(check.realBytes), line);
+    }
+    return line;
+}
+
+} // namespace FlashSpartan::CapacityProbe
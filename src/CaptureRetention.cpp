@@ -0,0 +1,388 @@
+#include "CaptureRetention.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+
+#include <memory>
+
+#ifdef HAS_ZSTD
+#include <zstd.h>
+#elif defined(HAS_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr auto kIndexFile = "retention.json";
+constexpr qint64 kChunkBytes = 1024 * 1024;
+
+struct IndexEntry {
+    QByteArray digest;
+    int recurrences = 0;
+    QDateTime lastSeenUtc;
+};
+
+using Index = QHash<QString, IndexEntry>;  // by file name
+
+QMutex& retentionMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+QStringList captureFilters()
+{
+    QStringList filters;
+    for (const QString& ext : {QStringLiteral("*.pcap"), QStringLiteral("*.pcapng")}) {
+        filters << ext << ext + QStringLiteral(".zst") << ext + QStringLiteral(".gz");
+    }
+    return filters;
+}
+
+bool isCompressedName(const QString& name)
+{
+    return name.endsWith(QLatin1String(".zst")) || name.endsWith(QLatin1String(".gz"));
+}
+
+QFileInfoList captureFiles(const QString& directory)
+{
+    // Oldest first.
+    return QDir(directory).entryInfoList(captureFilters(), QDir::Files, QDir::Time | QDir::Reversed);
+}
+
+Index loadIndex(const QString& directory)
+{
+    Index index;
+    QFile file(QDir(directory).filePath(QLatin1String(kIndexFile)));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return index;
+    }
+    const QJsonArray captures = QJsonDocument::fromJson(file.readAll()).object().value(QStringLiteral("captures")).toArray();
+    for (const QJsonValue& v : captures) {
+        const QJsonObject o = v.toObject();
+        const QString name = o.value(QStringLiteral("file")).toString();
+        if (name.isEmpty() || name.contains(QLatin1Char('/'))) {
+            continue;
+        }
+        IndexEntry entry;
+        entry.digest = QByteArray::fromHex(o.value(QStringLiteral("digest")).toString().toLatin1());
+        entry.recurrences = o.value(QStringLiteral("recurrences")).toInt();
+        entry.lastSeenUtc = QDateTime::fromString(o.value(QStringLiteral("last_seen")).toString(), Qt::ISODate);
+        index.insert(name, entry);
+    }
+    return index;
+}
+
+bool saveIndex(const QString& directory, const Index& index)
+{
+    QJsonArray captures;
+    for (auto it = index.cbegin(); it != index.cend(); ++it) {
+        QJsonObject o;
+        o.insert(QStringLiteral("file"), it.key());
+        o.insert(QStringLiteral("digest"), QString::fromLatin1(it->digest.toHex()));
+        o.insert(QStringLiteral("recurrences"), it->recurrences);
+        o.insert(QStringLiteral("last_seen"), it->lastSeenUtc.toString(Qt::ISODate));
+        captures.append(o);
+    }
+    QJsonObject root;
+    root.insert(QStringLiteral("version"), 1);
+    root.insert(QStringLiteral("captures"), captures);
+
+    QSaveFile file(QDir(directory).filePath(QLatin1String(kIndexFile)));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+int enforceLocked(const QString& directory, const CaptureRetention::Policy& policy, const QDateTime& nowUtc,
+                  Index* index)
+{
+    const QFileInfoList files = captureFiles(directory);
+    qint64 total = 0;
+    for (const QFileInfo& f : files) {
+        total += f.size();
+    }
+
+    int removed = 0;
+    for (const QFileInfo& f : files) {
+        const qint64 ageSeconds = f.lastModified().toUTC().secsTo(nowUtc);
+        if (ageSeconds < CaptureRetention::kActiveGraceSeconds) {
+            continue;
+        }
+        const bool expired = policy.maxAgeDays > 0 && ageSeconds >= qint64(policy.maxAgeDays) * 86400;
+        const bool overQuota = policy.quotaBytes > 0 && total > policy.quotaBytes;
+        if (!expired && !overQuota) {
+            continue;
+        }
+        if (QFile::remove(f.absoluteFilePath())) {
+            total -= f.size();
+            ++removed;
+            index->remove(f.fileName());
+        }
+    }
+
+    const QDir dir(directory);
+    for (auto it = index->begin(); it != index->end();) {
+        it = QFileInfo::exists(dir.filePath(it.key())) ? std::next(it) : index->erase(it);
+    }
+    return removed;
+}
+
+#ifdef HAS_ZSTD
+bool compressStream(QIODevice& in, QIODevice& out, QString* error)
+{
+    std::unique_ptr<ZSTD_CCtx, decltype(&ZSTD_freeCCtx)> cctx(ZSTD_createCCtx(), &ZSTD_freeCCtx);
+    if (!cctx) {
+        *error = QStringLiteral("zstd: out of memory");
+        return false;
+    }
+    ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_compressionLevel, 9);
+    ZSTD_CCtx_setParameter(cctx.get(), ZSTD_c_checksumFlag, 1);
+
+    QByteArray inBuf(kChunkBytes, Qt::Uninitialized);
+    QByteArray outBuf(qsizetype(ZSTD_CStreamOutSize()), Qt::Uninitialized);
+    for (;;) {
+        const qint64 n = in.read(inBuf.data(), inBuf.size());
+        if (n < 0) {
+            *error = in.errorString();
+            return false;
+        }
+        const bool last = in.atEnd();
+        const ZSTD_EndDirective mode = last ? ZSTD_e_end : ZSTD_e_continue;
+        ZSTD_inBuffer input{inBuf.constData(), size_t(n), 0};
+        bool done = false;
+        while (!done) {
+            ZSTD_outBuffer output{outBuf.data(), size_t(outBuf.size()), 0};
+            const size_t remaining = ZSTD_compressStream2(cctx.get(), &output, &input, mode);
+            if (ZSTD_isError(remaining)) {
+                *error = QStringLiteral("zstd: %1").arg(QString::fromUtf8(ZSTD_getErrorName(remaining)));
+                return false;
+            }
+            if (out.write(outBuf.constData(), qint64(output.pos)) != qint64(output.pos)) {
+                *error = out.errorString();
+                return false;
+            }
+            done = last ? remaining == 0 : input.pos == input.size;
+        }
+        if (last) {
+            return true;
+        }
+    }
+}
+#elif defined(HAS_ZLIB)
+bool compressStream(QIODevice& in, QIODevice& out, QString* error)
+{
+    z_stream zs{};
+    if (deflateInit2(&zs, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        *error = QStringLiteral("zlib: deflateInit2 failed");
+        return false;
+    }
+    std::unique_ptr<z_stream, decltype(&deflateEnd)> guard(&zs, &deflateEnd);
+
+    QByteArray inBuf(kChunkBytes, Qt::Uninitialized);
+    QByteArray outBuf(256 * 1024, Qt::Uninitialized);
+    for (;;) {
+        const qint64 n = in.read(inBuf.data(), inBuf.size());
+        if (n < 0) {
+            *error = in.errorString();
+            return false;
+        }
+        const int flush = in.atEnd() ? Z_FINISH : Z_NO_FLUSH;
+        zs.next_in = reinterpret_cast<Bytef*>(inBuf.data());
+        zs.avail_in = uInt(n);
+        int ret = Z_OK;
+        do {
+            zs.next_out = reinterpret_cast<Bytef*>(outBuf.data());
+            zs.avail_out = uInt(outBuf.size());
+            ret = deflate(&zs, flush);
+            if (ret == Z_STREAM_ERROR) {
+                *error = QStringLiteral("zlib: deflate failed");
+                return false;
+            }
+            const qint64 have = outBuf.size() - zs.avail_out;
+            if (out.write(outBuf.constData(), have) != have) {
+                *error = out.errorString();
+                return false;
+            }
+        } while (zs.avail_out == 0);
+        if (flush == Z_FINISH) {
+            return ret == Z_STREAM_END;
+        }
+    }
+}
+#endif
+
+} // namespace
+
+QString CaptureRetention::Usage::text() const
+{
+    QString line = QStringLiteral("%1 capture%2, %3 MiB")
+                       .arg(captures)
+                       .arg(captures == 1 ? QString() : QStringLiteral("s"))
+                       .arg(double(bytes) / (1024.0 * 1024.0), 0, 'f', 1);
+    QStringList details;
+    if (compressed > 0) {
+        details << QStringLiteral("%1 compressed").arg(compressed);
+    }
+    if (recurrences > 0) {
+        details << QStringLiteral("%1 repeat%2 folded").arg(recurrences).arg(recurrences == 1 ? QString() : QStringLiteral("s"));
+    }
+    if (!details.isEmpty()) {
+        line += QStringLiteral(" (%1)").arg(details.join(QStringLiteral(", ")));
+    }
+    return line;
+}
+
+CaptureRetention::ArchiveResult CaptureRetention::archive(const QString& directory, const QString& capturePath,
+                                                          const QByteArray& contentDigest, const Policy& policy,
+                                                          const QDateTime& nowUtc)
+{
+    QMutexLocker lock(&retentionMutex());
+    ArchiveResult result;
+    Index index = loadIndex(directory);
+    const QDir dir(directory);
+    const QString name = QFileInfo(capturePath).fileName();
+
+    if (policy.deduplicate && !contentDigest.isEmpty()) {
+        for (auto it = index.begin(); it != index.end(); ++it) {
+            if (it.key() == name || it->digest != contentDigest || !QFileInfo::exists(dir.filePath(it.key()))) {
+                continue;
+            }
+            if (!QFile::remove(capturePath)) {
+                result.error = QStringLiteral("Could not remove duplicate capture %1").arg(capturePath);
+                result.path = capturePath;
+                return result;
+            }
+            ++it->recurrences;
+            it->lastSeenUtc = nowUtc;
+            result.duplicateOf = dir.filePath(it.key());
+            result.removed = enforceLocked(directory, policy, nowUtc, &index);
+            saveIndex(directory, index);
+            return result;
+        }
+    }
+
+    result.path = capturePath;
+    if (policy.compress && !compressedSuffix().isEmpty()) {
+        QString compressedPath;
+        if (compressFile(capturePath, &compressedPath, &result.error)) {
+            result.path = compressedPath;
+            result.compressed = true;
+        }
+    }
+    IndexEntry entry;
+    entry.digest = contentDigest;
+    entry.lastSeenUtc = nowUtc;
+    index.insert(QFileInfo(result.path).fileName(), entry);
+    result.removed = enforceLocked(directory, policy, nowUtc, &index);
+    saveIndex(directory, index);
+    return result;
+}
+
+int CaptureRetention::enforce(const QString& directory, const Policy& policy, const QDateTime& nowUtc)
+{
+    QMutexLocker lock(&retentionMutex());
+    Index index = loadIndex(directory);
+    const int removed = enforceLocked(directory, policy, nowUtc, &index);
+    if (removed > 0) {
+        saveIndex(directory, index);
+    }
+    return removed;
+}
+
+CaptureRetention::Usage CaptureRetention::usage(const QString& directory)
+{
+    QMutexLocker lock(&retentionMutex());
+    Usage usage;
+    const QFileInfoList files = captureFiles(directory);
+    for (const QFileInfo& f : files) {
+        ++usage.captures;
+        usage.bytes += f.size();
+        if (isCompressedName(f.fileName())) {
+            ++usage.compressed;
+        }
+    }
+    if (!files.isEmpty()) {
+        usage.oldestUtc = files.first().lastModified().toUTC();
+    }
+    const Index index = loadIndex(directory);
+    for (const IndexEntry& entry : index) {
+        usage.recurrences += entry.recurrences;
+    }
+    return usage;
+}
+
+QString CaptureRetention::compressedSuffix()
+{
+#ifdef HAS_ZSTD
+    return QStringLiteral(".zst");
+#elif defined(HAS_ZLIB)
+    return QStringLiteral(".gz");
+#else
+    return QString();
+#endif
+}
+
+bool CaptureRetention::compressFile(const QString& path, QString* compressedPath, QString* error)
+{
+    QString localError;
+    QString& err = error ? *error : localError;
+    const QString suffix = compressedSuffix();
+    if (suffix.isEmpty()) {
+        err = QStringLiteral("Built without zstd or zlib");
+        return false;
+    }
+#if defined(HAS_ZSTD) || defined(HAS_ZLIB)
+    QFile in(path);
+    if (!in.open(QIODevice::ReadOnly)) {
+        err = in.errorString();
+        return false;
+    }
+    const QDateTime modified = in.fileTime(QFileDevice::FileModificationTime);
+    const QString target = path + suffix;
+    {
+        QSaveFile out(target);
+        if (!out.open(QIODevice::WriteOnly)) {
+            err = out.errorString();
+            return false;
+        }
+        if (!compressStream(in, out, &err)) {
+            out.cancelWriting();
+            return false;
+        }
+        if (!out.commit()) {
+            err = out.errorString();
+            return false;
+        }
+    }
+    in.close();
+
+    QFile written(target);
+    if (written.open(QIODevice::ReadWrite)) {
+        written.setFileTime(modified, QFileDevice::FileModificationTime);
+    }
+    QFile::remove(path);
+    if (compressedPath) {
+        *compressedPath = target;
+    }
+    return true;
+#else
+    Q_UNUSED(path);
+    Q_UNUSED(compressedPath);
+    return false;
+#endif
+}
+
+} // namespace FlashSpartan
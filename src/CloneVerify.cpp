@@ -0,0 +1,151 @@
+#include "CloneVerify.h"
+
+#include "RawDeviceHashAdvanced.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#endif
+
+namespace FlashSpartan::CloneVerify {
+
+namespace {
+
+RawDeviceHash::Options blockReadOptions(const QString& node, RawDeviceHash::Algorithm algorithm,
+                                        std::atomic<bool>* cancelled,
+                                        std::atomic<uint64_t>* bytesProcessed)
+{
+    RawDeviceHash::Options options;
+    options.deviceNode = node;
+    options.algorithm = algorithm;
+    options.scanMode = RawDeviceHash::ScanMode::ParallelChunked;
+    options.cancelled = cancelled;
+    options.bytesProcessed = bytesProcessed;
+    return options;
+}
+
+} // namespace
+
+HashResult hashMaster(const QString& path, RawDeviceHash::Algorithm algorithm,
+                      std::atomic<bool>* cancelled, std::atomic<uint64_t>* bytesProcessed,
+                      uint64_t* lengthOut)
+{
+    const RawDeviceHash::Options options = blockReadOptions(path, algorithm, cancelled, bytesProcessed);
+    const QFileInfo info(path);
+    HashResult result;
+    if (info.isFile()) {
+        // openDevice() only takes block devices; an image file is read through its own handle.
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            result.deviceNode = path;
+            result.errorMessage = QStringLiteral("Cannot open %1: %2").arg(path, file.errorString());
+            return result;
+        }
+        *lengthOut = static_cast<uint64_t>(info.size());
+#ifdef Q_OS_WIN
+        const int fd = static_cast<int>(_get_osfhandle(file.handle()));
+#else
+        const int fd = file.handle();
+#endif
+        result = RawDeviceHash::hashAdvanced(fd, options, *lengthOut);
+    } else {
+        result = RawDeviceHash::hashDevice(options);
+        *lengthOut = result.success ? result.bytesProcessed : 0;
+    }
+    if (result.success && (*lengthOut == 0 || result.blockHashes.isEmpty())) {
+        result.success = false;
+        result.errorMessage = QStringLiteral("The master %1 is empty.").arg(path);
+    }
+    return result;
+}
+
+HashResult hashClone(const QString& deviceNode, const HashResult& master, uint64_t masterLength,
+                     RawDeviceHash::Algorithm algorithm, std::atomic<bool>* cancelled,
+                     std::atomic<uint64_t>* bytesProcessed)
+{
+    RawDeviceHash::Options options = blockReadOptions(deviceNode, algorithm, cancelled, bytesProcessed);
+    // A clone may be larger than the master; only the span written from it has to match.
+    options.lengthLimit = masterLength;
+    options.expectedBlockHashes = &master.blockHashes;
+    options.stopAtFirstMismatch = true;
+    return RawDeviceHash::hashDevice(options);
+}
+
+CloneVerdict judgeClone(const HashResult& master, const HashResult& clone)
+{
+    CloneVerdict out;
+    if (!clone.success) {
+        return out;
+    }
+    if (clone.stoppedAtBlock >= 0) {
+        out.verdict = Verdict::Mismatch;
+        out.firstBadBlock = clone.stoppedAtBlock;
+        return out;
+    }
+    if (clone.hash.compare(master.hash, Qt::CaseInsensitive) == 0) {
+        out.verdict = Verdict::Match;
+        return out;
+    }
+    // Blocks may all match and still differ in number, e.g. a clone read by another engine.
+    out.verdict = Verdict::Mismatch;
+    const qsizetype common = qMin(clone.blockHashes.size(), master.blockHashes.size());
+    out.firstBadBlock = common;
+    for (qsizetype i = 0; i < common; ++i) {
+        if (clone.blockHashes.at(i).compare(master.blockHashes.at(i), Qt::CaseInsensitive) != 0) {
+            out.firstBadBlock = i;
+            break;
+        }
+    }
+    return out;
+}
+
+QString verdictName(Verdict verdict)
+{
+    switch (verdict) {
+        case Verdict::Match: return QStringLiteral("match");
+        case Verdict::Mismatch: return QStringLiteral("mismatch");
+        case Verdict::Error: break;
+    }
+    return QStringLiteral("error");
+}
+
+UsbPlacement usbPlacementFromSysPath(const QString& sysPath)
+{
+    static const QRegularExpression controllerName(QStringLiteral("^usb\\d+$"));
+    static const QRegularExpression portPath(QStringLiteral("^\\d+-[\\d.]+$"));
+    UsbPlacement placement;
+    const QStringList parts = sysPath.split(QLatin1Char('/'), Qt::SkipEmptyParts);
+    for (const QString& part : parts) {
+        if (placement.controller.isEmpty()) {
+            if (controllerName.match(part).hasMatch()) {
+                placement.controller = part;
+            }
+        } else if (portPath.match(part).hasMatch()) {
+            // "3-1.4" is port 4 of a hub on root port 1, keyed "3-1" like HashWorker does.
+            placement.rootPort = part.section(QLatin1Char('.'), 0, 0);
+            break;
+        }
+    }
+    return placement;
+}
+
+UsbPlacement usbPlacement(const QString& deviceNode)
+{
+#ifdef Q_OS_LINUX
+    const QString canonical = QFileInfo(deviceNode).canonicalFilePath();
+    if (canonical.isEmpty()) {
+        return {};
+    }
+    const QString sysPath =
+        QFileInfo(QStringLiteral("/sys/class/block/") + QFileInfo(canonical).fileName()).canonicalFilePath();
+    return sysPath.isEmpty() ? UsbPlacement{} : usbPlacementFromSysPath(sysPath);
+#else
+    Q_UNUSED(deviceNode);
+    return {};
+#endif
+}
+
+} // namespace FlashSpartan::CloneVerify
@@ -0,0 +1,79 @@
+#include "ContentChunker.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace FlashSpartan {
+
+namespace {
+
+/** splitmix64 from a fixed seed; stable, since stored chunk lists depend on it. */
+constexpr std::array<uint64_t, 256> makeGearTable()
+{
+    std::array<uint64_t, 256> table{};
+    uint64_t state = 0x464C415348434443ULL;  // "FLASHCDC"
+    for (uint64_t& entry : table) {
+        state += 0x9E3779B97F4A7C15ULL;
+        uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        entry = z ^ (z >> 31);
+    }
+    return table;
+}
+
+constexpr std::array<uint64_t, 256> kGear = makeGearTable();
+
+/** The top @p bits bits of the gear hash; those depend on the most recent 64 bytes. */
+constexpr uint64_t topBits(int bits)
+{
+    return bits <= 0 ? 0 : ~uint64_t(0) << (64 - bits);
+}
+
+} // namespace
+
+ContentChunker::ContentChunker()
+    : ContentChunker(Params{})
+{
+}
+
+ContentChunker::ContentChunker(const Params& params)
+    : m_params(params)
+{
+    // Normalization level 2: two bits harder before the average size, two easier after.
+    const int bits = std::bit_width(m_params.avgSize) - 1;
+    m_maskSmall = topBits(bits + 2);
+    m_maskLarge = topBits(bits - 2);
+}
+
+size_t ContentChunker::scan(const unsigned char* data, size_t len, bool* boundary)
+{
+    *boundary = false;
+    size_t i = 0;
+    if (m_chunkLength < m_params.minSize) {
+        // No cut can fall inside the minimum size; skip hashing those bytes.
+        const size_t skip = std::min(len, m_params.minSize - m_chunkLength);
+        i = skip;
+        m_chunkLength += skip;
+    }
+    for (; i < len; ++i) {
+        m_hash = (m_hash << 1) + kGear[data[i]];
+        ++m_chunkLength;
+        const uint64_t mask = m_chunkLength < m_params.avgSize ? m_maskSmall : m_maskLarge;
+        if ((m_hash & mask) == 0 || m_chunkLength >= m_params.maxSize) {
+            *boundary = true;
+            reset();
+            return i + 1;
+        }
+    }
+    return len;
+}
+
+void ContentChunker::reset()
+{
+    m_hash = 0;
+    m_chunkLength = 0;
+}
+
+} // namespace FlashSpartan
@@ -1,7 +1,10 @@
 #include "DatabaseManager.h"
+#include "BlockHashFile.h"
+#include "ManifestService.h"
 #include "policy/PolicyGateway.h"
 #include "policy/PolicyPaths.h"
 #include "policy/PolicyServiceLocator.h"
+#include "WatchManifestFile.h"
 
 #include <QFile>
 #include <QDir>
@@ -9,12 +12,18 @@
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QJsonObject>
+#include <QPointer>
 #include <QStandardPaths>
 #include <QReadLocker>
+#include <QSet>
 #include <QWriteLocker>
+#include <QtConcurrent>
 #include <QDebug>
 #include <QDateTime>
 
+#include <algorithm>
+#include <utility>
+
 namespace FlashSpartan {
 
 namespace {
@@ -47,15 +56,78 @@ std::optional<QString> resolveStoredId(const QHash<QString, DeviceRecord>& devic
     return std::nullopt;
 }
 
+/** Hex length of a digest from each baseline algorithm; 0 when unknown. */
+int digestHexLength(const QString& algorithm)
+{
+    if (algorithm == QLatin1String("SHA256") || algorithm == QLatin1String("BLAKE3")) {
+        return 64;
+    }
+    if (algorithm == QLatin1String("SHA512") || algorithm == QLatin1String("BLAKE2b")) {
+        return 128;
+    }
+    if (algorithm == QLatin1String("XXH3-128")) {
+        return 32;
+    }
+    return 0;
+}
+
+bool isDigestHex(const QString& hex, const QString& algorithm)
+{
+    const int expected = digestHexLength(algorithm);
+    if (expected > 0 && hex.size() != expected) {
+        return false;
+    }
+    return std::all_of(hex.cbegin(), hex.cend(), [](QChar c) {
+        return c.isDigit() || (c >= QLatin1Char('a') && c <= QLatin1Char('f'))
+               || (c >= QLatin1Char('A') && c <= QLatin1Char('F'));
+    });
+}
+
+QStringList recordIssues(const DeviceRecord& record)
+{
+    QStringList issues;
+    if (record.uniqueId.isEmpty()) {
+        issues.append("Found device with empty unique ID");
+    }
+    if (record.hash.isEmpty() && record.trustLevel > 0) {
+        issues.append(QString("Trusted device %1 has no hash").arg(record.uniqueId));
+    }
+    if (!record.firstSeen.isValid()) {
+        issues.append(QString("Device %1 has invalid first_seen date").arg(record.uniqueId));
+    }
+    if (!record.hash.isEmpty() && !isDigestHex(record.hash, record.hashAlgorithm)) {
+        issues.append(QString("Device %1 has a malformed %2 hash")
+                          .arg(record.uniqueId, record.hashAlgorithm));
+    }
+    if (!record.prescreenHash.isEmpty()
+        && !isDigestHex(record.prescreenHash, record.prescreenAlgorithm)) {
+        issues.append(QString("Device %1 has a malformed pre-screen hash").arg(record.uniqueId));
+    }
+    const WatchManifest& manifest = record.watchManifest;
+    if (!manifest.groups.isEmpty() && !manifest.manifestRoot.isEmpty()
+        && ManifestService::manifestRootHex(manifest) != manifest.manifestRoot) {
+        issues.append(QString("Device %1 watch manifest root does not match its groups")
+                          .arg(record.uniqueId));
+    }
+    return issues;
+}
+
 } // namespace
 
 DatabaseManager::DatabaseManager(QObject* parent)
     : QObject(parent)
 {
+    m_volatileFlushTimer.setSingleShot(true);
+    m_volatileFlushTimer.setInterval(kVolatileFlushMs);
+    connect(&m_volatileFlushTimer, &QTimer::timeout, this, &DatabaseManager::flushVolatileFields);
 }
 
 DatabaseManager::~DatabaseManager()
 {
+    m_compaction.waitForFinished();  // the job writes back into this manager
+    if (m_initialized) {
+        flushVolatileFields();
+    }
     if (m_modified && m_initialized) {
         save();
     }
@@ -92,6 +164,17 @@ bool DatabaseManager::initialize(const QString& path)
         m_modified = false;
         syncFromPolicyGateway();
     }
+    if (m_changeFeedGateway != gate) {
+        m_changeFeedGateway = gate;
+        QPointer<DatabaseManager> self(this);
+        gate->addChangeListener([self](const Policy::PolicyDelta& delta) {
+            if (self) {
+                self->onPolicyChanged(delta);
+            }
+        });
+    }
+    migrateInlineWatchManifests();
+    migrateInlineBlockHashes();
 
     emit databaseLoaded(m_devices.size());
     return true;
@@ -108,10 +191,81 @@ void DatabaseManager::syncFromPolicyGateway()
     if (!gate) {
         return;
     }
-    const Policy::PolicySnapshot snap = gate->snapshot();
-    m_devices.clear();
-    for (const DeviceRecord& rec : snap.devices) {
-        m_devices.insert(rec.uniqueId, rec);
+    // Only what changed since the last sync crosses the gateway; a new epoch sends everything.
+    const Policy::PolicyDelta delta = gate->changesSince(m_policyEpoch, m_policyGeneration);
+    applyPolicyDelta(delta, nullptr);
+    m_policyEpoch = delta.epoch;
+    m_policyGeneration = delta.generation;
+}
+
+void DatabaseManager::applyPolicyDelta(const Policy::PolicyDelta& delta, PolicyChanges* changes)
+{
+    // Local edits also land here, through the sync after their persist.
+    if (delta.full || !delta.removedIds.isEmpty() || !delta.devices.isEmpty()) {
+        ++m_recordGeneration;
+    }
+    if (delta.full) {
+        QSet<QString> kept;
+        for (const DeviceRecord& rec : delta.devices) {
+            kept.insert(rec.uniqueId);
+        }
+        for (auto it = m_devices.begin(); it != m_devices.end();) {
+            if (kept.contains(it.key())) {
+                ++it;
+                continue;
+            }
+            if (changes) {
+                changes->removed.append(it.key());
+            }
+            it = m_devices.erase(it);
+        }
+    }
+    for (const QString& id : delta.removedIds) {
+        if (m_devices.remove(id) > 0 && changes) {
+            changes->removed.append(id);
+        }
+    }
+    for (const DeviceRecord& stored : delta.devices) {
+        // A last-seen time still waiting for its flush is newer than the stored one
+        const auto pending = m_pendingLastSeen.constFind(stored.uniqueId);
+        std::optional<DeviceRecord> withPending;
+        if (pending != m_pendingLastSeen.cend() && *pending > stored.lastSeen) {
+            withPending = stored;
+            withPending->lastSeen = *pending;
+        }
+        const DeviceRecord& rec = withPending ? *withPending : stored;
+        auto it = m_devices.find(rec.uniqueId);
+        if (it == m_devices.end()) {
+            m_devices.insert(rec.uniqueId, rec);
+            if (changes) {
+                changes->added.append(rec.uniqueId);
+            }
+        } else if (!changes) {
+            *it = rec;
+        } else if (it->toJson() != rec.toJson()) {
+            *it = rec;
+            changes->updated.append(rec.uniqueId);
+        }
+    }
+}
+
+void DatabaseManager::onPolicyChanged(const Policy::PolicyDelta& delta)
+{
+    // Pushed deltas overlap our own syncs; only records that differ raise signals. The
+    // sync cursor stays put, so the next syncFromPolicyGateway() still sees everything.
+    PolicyChanges changes;
+    {
+        QWriteLocker locker(&m_lock);
+        applyPolicyDelta(delta, &changes);
+    }
+    for (const QString& id : changes.added) {
+        emit deviceAdded(id);
+    }
+    for (const QString& id : changes.updated) {
+        emit deviceUpdated(id);
+    }
+    for (const QString& id : changes.removed) {
+        emit deviceRemoved(id);
     }
 }
 
@@ -121,7 +275,13 @@ bool DatabaseManager::persistDevice(const DeviceRecord& record, const QString& r
     if (!gate) {
         return false;
     }
-    return gate->upsertDevice(record, policyActor(), reason);
+    if (!gate->upsertDevice(record, policyActor(), reason)) {
+        // Callers edit m_devices first; a full resync puts the stored record back.
+        QWriteLocker locker(&m_lock);
+        m_policyEpoch = 0;
+        return false;
+    }
+    return true;
 }
 
 bool DatabaseManager::persistRecordById(const QString& uniqueId, const QString& reason)
@@ -170,6 +330,62 @@ QList<DeviceRecord> DatabaseManager::getAllDevices() const
     return m_devices.values();
 }
 
+DatabaseManager::DeviceSummary DatabaseManager::DeviceSummary::of(const DeviceRecord& record)
+{
+    DeviceSummary summary;
+    summary.uniqueId = record.uniqueId;
+    summary.notes = record.notes;
+    summary.lastKnownInfo = record.lastKnownInfo;
+    summary.trustLevel = record.trustLevel;
+    summary.autoMount = record.autoMount;
+    summary.hasHash = !record.hash.isEmpty();
+    summary.lastSeen = record.lastSeen;
+    summary.lastHashed = record.lastHashed;
+    summary.verificationProfile = record.verificationProfile;
+    return summary;
+}
+
+QList<DatabaseManager::DeviceSummary> DatabaseManager::getDeviceSummaries() const
+{
+    QReadLocker locker(&m_lock);
+    QList<DeviceSummary> result;
+    result.reserve(m_devices.size());
+    for (const auto& record : m_devices) {
+        result.append(DeviceSummary::of(record));
+    }
+    return result;
+}
+
+std::optional<WatchManifest> DatabaseManager::watchManifest(const QString& uniqueId) const
+{
+    WatchManifest stored;
+    {
+        QReadLocker locker(&m_lock);
+        const std::optional<QString> storedId = resolveStoredId(m_devices, uniqueId);
+        if (!storedId) {
+            return std::nullopt;
+        }
+        stored = m_devices.value(*storedId).watchManifest;
+    }
+    return loadWatchManifest(stored);
+}
+
+QStringList DatabaseManager::blockHashesFor(const DeviceRecord& record, uint64_t* blockSize)
+{
+    if (record.blockHashesSha256.isEmpty()) {
+        if (blockSize) {
+            *blockSize = record.blockSize;
+        }
+        return record.blockHashes;
+    }
+    const std::optional<BlockHashFile::Blocks> blocks =
+        BlockHashFile::load(watchManifestDirectory(), record.blockHashesSha256);
+    if (blockSize) {
+        *blockSize = blocks ? blocks->blockSize : 0;
+    }
+    return blocks ? blocks->hashes : QStringList();
+}
+
 QList<DeviceRecord> DatabaseManager::getDevicesWhere(
     std::function<bool(const DeviceRecord&)> filter) const
 {
@@ -260,6 +476,7 @@ bool DatabaseManager::removeDevice(const QString& uniqueId)
         syncFromPolicyGateway();
         m_modified = false;
     }
+    pruneOutOfLineFiles();
     emit deviceRemoved(uniqueId);
     return true;
 }
@@ -279,16 +496,17 @@ int DatabaseManager::removeDevices(const QStringList& uniqueIds)
     }
 
     Policy::PolicyGateway* gate = Policy::PolicyServiceLocator::gateway();
-    for (const auto& id : actuallyRemoved) {
-        if (gate && gate->removeDevice(id, policyActor(), QStringLiteral("bulk_remove"))) {
-            ++removed;
-        }
+    if (gate && !actuallyRemoved.isEmpty()) {
+        removed = qMax(0, gate->removeDevices(actuallyRemoved, policyActor(), QStringLiteral("bulk_remove")));
     }
 
     if (removed > 0) {
-        QWriteLocker locker(&m_lock);
-        syncFromPolicyGateway();
-        m_modified = false;
+        {
+            QWriteLocker locker(&m_lock);
+            syncFromPolicyGateway();
+            m_modified = false;
+        }
+        pruneOutOfLineFiles();
     }
 
     for (const auto& id : actuallyRemoved) {
@@ -313,6 +531,7 @@ void DatabaseManager::clearAllDevices()
         syncFromPolicyGateway();
         m_modified = false;
     }
+    pruneOutOfLineFiles();
     for (const auto& id : ids) {
         emit deviceRemoved(id);
     }
@@ -325,6 +544,7 @@ bool DatabaseManager::updateHash(const QString& uniqueId, const QString& hash,
 {
     DeviceRecord rec;
     QString storedId;
+    bool droppedBlockFile = false;
     {
         QWriteLocker locker(&m_lock);
 
@@ -335,6 +555,16 @@ bool DatabaseManager::updateHash(const QString& uniqueId, const QString& hash,
         storedId = *resolved;
 
         DeviceRecord& record = m_devices[storedId];
+        if (record.hash != hash) {
+            droppedBlockFile = !record.blockHashesSha256.isEmpty();
+            record.prescreenHash.clear();
+            record.prescreenAlgorithm.clear();
+            record.blockHashes.clear();
+            record.blockHashesSha256.clear();
+            record.blockSize = 0;
+            record.ejectSeal = {};
+            record.layoutFingerprint = {};
+        }
         record.hash = hash;
         record.hashAlgorithm = algorithm;
         record.hashDurationMs = durationMs;
@@ -355,10 +585,260 @@ bool DatabaseManager::updateHash(const QString& uniqueId, const QString& hash,
         syncFromPolicyGateway();
         m_modified = false;
     }
+    if (droppedBlockFile) {
+        pruneOutOfLineFiles();
+    }
+    emit deviceUpdated(storedId);
+    return true;
+}
+
+bool DatabaseManager::updatePrescreenHash(const QString& uniqueId, const QString& hash,
+                                          const QString& algorithm)
+{
+    DeviceRecord rec;
+    QString storedId;
+    {
+        QWriteLocker locker(&m_lock);
+
+        const std::optional<QString> resolved = resolveStoredId(m_devices, uniqueId);
+        if (!resolved) {
+            return false;
+        }
+        storedId = *resolved;
+
+        DeviceRecord& record = m_devices[storedId];
+        record.prescreenHash = hash;
+        record.prescreenAlgorithm = algorithm;
+        rec = record;
+    }
+    if (!persistDevice(rec, QStringLiteral("update_prescreen_hash"))) {
+        return false;
+    }
+    {
+        QWriteLocker locker(&m_lock);
+        syncFromPolicyGateway();
+        m_modified = false;
+    }
+    emit deviceUpdated(storedId);
+    return true;
+}
+
+bool DatabaseManager::updateBlockHashes(const QString& uniqueId, const QStringList& blockHashes,
+                                        uint64_t blockSize)
+{
+    {
+        QReadLocker locker(&m_lock);
+        if (!resolveStoredId(m_devices, uniqueId)) {
+            return false;
+        }
+    }
+
+    QString digest;
+    if (!blockHashes.isEmpty()) {
+        QString err;
+        digest = BlockHashFile::save(watchManifestDirectory(), blockHashes, blockSize, &err);
+        if (digest.isEmpty()) {
+            // Keep the list inline rather than lose it.
+            qWarning() << "Block digests stored inline:" << err;
+        }
+    }
+
+    DeviceRecord rec;
+    QString storedId;
+    {
+        QWriteLocker locker(&m_lock);
+
+        const std::optional<QString> resolved = resolveStoredId(m_devices, uniqueId);
+        if (!resolved) {
+            return false;
+        }
+        storedId = *resolved;
+
+        DeviceRecord& record = m_devices[storedId];
+        record.blockHashes = digest.isEmpty() ? blockHashes : QStringList();
+        record.blockHashesSha256 = digest;
+        record.blockSize = blockSize;
+        rec = record;
+    }
+    if (!persistDevice(rec, QStringLiteral("update_block_hashes"))) {
+        return false;
+    }
+    {
+        QWriteLocker locker(&m_lock);
+        syncFromPolicyGateway();
+        m_modified = false;
+    }
+    pruneOutOfLineFiles();
+    emit deviceUpdated(storedId);
+    return true;
+}
+
+bool DatabaseManager::updateTunedBufferSize(const QString& uniqueId, int bufferSizeKB)
+{
+    DeviceRecord rec;
+    QString storedId;
+    {
+        QWriteLocker locker(&m_lock);
+
+        const std::optional<QString> resolved = resolveStoredId(m_devices, uniqueId);
+        if (!resolved) {
+            return false;
+        }
+        storedId = *resolved;
+
+        DeviceRecord& record = m_devices[storedId];
+        record.tunedBufferSizeKB = bufferSizeKB;
+        rec = record;
+    }
+    if (!persistDevice(rec, QStringLiteral("tuned_buffer_size"))) {
+        return false;
+    }
+    {
+        QWriteLocker locker(&m_lock);
+        syncFromPolicyGateway();
+        m_modified = false;
+    }
+    emit deviceUpdated(storedId);
+    return true;
+}
+
+bool DatabaseManager::updateReadProfile(const QString& uniqueId, const ReadProfile& profile)
+{
+    DeviceRecord rec;
+    QString storedId;
+    {
+        QWriteLocker locker(&m_lock);
+
+        const std::optional<QString> resolved = resolveStoredId(m_devices, uniqueId);
+        if (!resolved) {
+            return false;
+        }
+        storedId = *resolved;
+
+        DeviceRecord& record = m_devices[storedId];
+        record.readProfile = profile;
+        rec = record;
+    }
+    if (!persistDevice(rec, QStringLiteral("read_profile"))) {
+        return false;
+    }
+    {
+        QWriteLocker locker(&m_lock);
+        syncFromPolicyGateway();
+        m_modified = false;
+    }
     emit deviceUpdated(storedId);
     return true;
 }
 
+bool DatabaseManager::updateCapacityCheck(const QString& uniqueId, const CapacityCheck& check)
+{
+    DeviceRecord rec;
+    QString storedId;
+    {
+        QWriteLocker locker(&m_lock);
+
+        const std::optional<QString> resolved = resolveStoredId(m_devices, uniqueId);
+        if (!resolved) {
+            return false;
+        }
+        storedId = *resolved;
+
+        DeviceRecord& record = m_devices[storedId];
+        record.capacityCheck = check;
+        rec = record;
+    }
+    if (!persistDevice(rec, QStringLiteral("capacity_check"))) {
+        return false;
+    }
+    {
+        QWriteLocker locker(&m_lock);
+        syncFromPolicyGateway();
+        m_modified = false;
+    }
+    emit deviceUpdated(storedId);
+    return true;
+}
+
+bool DatabaseManager::updateEjectSeal(const QString& uniqueId, const EjectSeal& seal)
+{
+    DeviceRecord rec;
+    QString storedId;
+    {
+        QWriteLocker locker(&m_lock);
+
+        const std::optional<QString> resolved = resolveStoredId(m_devices, uniqueId);
+        if (!resolved) {
+            return false;
+        }
+        storedId = *resolved;
+
+        DeviceRecord& record = m_devices[storedId];
+        record.ejectSeal = seal;
+        rec = record;
+    }
+    if (!persistDevice(rec, QStringLiteral("eject_seal"))) {
+        return false;
+    }
+    {
+        QWriteLocker locker(&m_lock);
+        syncFromPolicyGateway();
+        m_modified = false;
+    }
+    emit deviceUpdated(storedId);
+    return true;
+}
+
+bool DatabaseManager::updateLayoutFingerprint(const QString& uniqueId, const LayoutFingerprint& fingerprint)
+{
+    DeviceRecord rec;
+    QString storedId;
+    {
+        QWriteLocker locker(&m_lock);
+
+        const std::optional<QString> resolved = resolveStoredId(m_devices, uniqueId);
+        if (!resolved) {
+            return false;
+        }
+        storedId = *resolved;
+
+        DeviceRecord& record = m_devices[storedId];
+        record.layoutFingerprint = fingerprint;
+        rec = record;
+    }
+    if (!persistDevice(rec, QStringLiteral("layout_fingerprint"))) {
+        return false;
+    }
+    {
+        QWriteLocker locker(&m_lock);
+        syncFromPolicyGateway();
+        m_modified = false;
+    }
+    emit deviceUpdated(storedId);
+    return true;
+}
+
+int DatabaseManager::tunedBufferSizeForModel(const QString& vendor, const QString& model) const
+{
+    if (vendor.isEmpty() && model.isEmpty()) {
+        return 0;
+    }
+    QReadLocker locker(&m_lock);
+    int best = 0;
+    QDateTime bestSeen;
+    for (const DeviceRecord& record : m_devices) {
+        if (record.tunedBufferSizeKB <= 0 || record.lastKnownInfo.vendor != vendor
+            || record.lastKnownInfo.model != model) {
+            continue;
+        }
+        if (best == 0 || record.lastSeen > bestSeen) {
+            best = record.tunedBufferSizeKB;
+            bestSeen = record.lastSeen;
+        }
+    }
+    return best;
+}
+
 std::optional<QString> DatabaseManager::getHash(const QString& uniqueId) const
 {
     QReadLocker locker(&m_lock);
@@ -463,27 +943,77 @@ bool DatabaseManager::setAutoMount(const QString& uniqueId, bool autoMount)
 
 bool DatabaseManager::updateLastSeen(const QString& uniqueId)
 {
-    DeviceRecord rec;
+    bool first = false;
     {
         QWriteLocker locker(&m_lock);
         const std::optional<QString> storedId = resolveStoredId(m_devices, uniqueId);
         if (!storedId) {
             return false;
         }
-        m_devices[*storedId].lastSeen = QDateTime::currentDateTime();
-        rec = m_devices.value(*storedId);
+        const QDateTime now = QDateTime::currentDateTime();
+        m_devices[*storedId].lastSeen = now;
+        first = m_pendingLastSeen.isEmpty();
+        m_pendingLastSeen.insert(*storedId, now);
+    }
+    if (first) {
+        scheduleVolatileFlush();
+    }
+    return true;
+}
+
+void DatabaseManager::scheduleVolatileFlush()
+{
+    // The timer lives on this object's thread; callers may be on another
+    QMetaObject::invokeMethod(this, [this]() {
+        if (!m_volatileFlushTimer.isActive()) {
+            m_volatileFlushTimer.start();
+        }
+    }, Qt::QueuedConnection);
+}
+
+bool DatabaseManager::flushVolatileFields()
+{
+    QHash<QString, QDateTime> pending;
+    QList<DeviceRecord> records;
+    {
+        QWriteLocker locker(&m_lock);
+        pending = std::exchange(m_pendingLastSeen, {});
+        records.reserve(pending.size());
+        for (auto it = pending.cbegin(); it != pending.cend(); ++it) {
+            const auto rec = m_devices.constFind(it.key());
+            if (rec != m_devices.cend()) {
+                records.append(*rec);  // removed records are not brought back
+            }
+        }
+    }
+    if (records.isEmpty()) {
+        return true;
     }
 
-    if (!persistDevice(rec, QStringLiteral("last_seen"))) {
+    Policy::PolicyGateway* gate = Policy::PolicyServiceLocator::gateway();
+    if (!gate || !gate->upsertDevices(records, policyActor(), QStringLiteral("last_seen"))) {
+        QWriteLocker locker(&m_lock);
+        for (auto it = pending.cbegin(); it != pending.cend(); ++it) {
+            if (!m_pendingLastSeen.contains(it.key())) {
+                m_pendingLastSeen.insert(it.key(), it.value());
+            }
+        }
+        locker.unlock();
+        scheduleVolatileFlush();
         return false;
     }
 
     QWriteLocker locker(&m_lock);
     syncFromPolicyGateway();
-    m_modified = false;
     return true;
 }
 
+int DatabaseManager::pendingVolatileCount() const
+{
+    QReadLocker locker(&m_lock);
+    return static_cast<int>(m_pendingLastSeen.size());
+}
+
 bool DatabaseManager::save()
 {
     QWriteLocker locker(&m_lock);
@@ -658,50 +1188,59 @@ void DatabaseManager::setAutoSave(bool enabled)
 
 QStringList DatabaseManager::validateIntegrity() const
 {
-    QReadLocker locker(&m_lock);
-    QStringList issues;
-    
-    for (const auto& record : m_devices) {
-        if (record.uniqueId.isEmpty()) {
-            issues.append("Found device with empty unique ID");
-        }
-        if (record.hash.isEmpty() && record.trustLevel > 0) {
-            issues.append(QString("Trusted device %1 has no hash").arg(record.uniqueId));
-        }
-        if (!record.firstSeen.isValid()) {
-            issues.append(QString("Device %1 has invalid first_seen date").arg(record.uniqueId));
-        }
-    }
-    
-    return issues;
+    return validateIntegrityAsync().result();
+}
+
+QFuture<QStringList> DatabaseManager::validateIntegrityAsync() const
+{
+    QList<DeviceRecord> records;
+    {
+        QReadLocker locker(&m_lock);
+        records = m_devices.values();  // implicitly shared: the lock is held only for the copy
+    }
+    return QtConcurrent::run([records = std::move(records)]() {
+        return QtConcurrent::blockingMappedReduced<QStringList>(
+            records, recordIssues,
+            [](QStringList& all, const QStringList& issues) { all += issues; },
+            QtConcurrent::OrderedReduce);
+    });
 }
 
 void DatabaseManager::compact()
 {
-    QStringList toRemove;
+    compactAsync().waitForFinished();
+}
+
+QFuture<int> DatabaseManager::compactAsync()
+{
+    QHash<QString, DeviceRecord> devices;
     {
         QReadLocker locker(&m_lock);
-        for (auto it = m_devices.begin(); it != m_devices.end(); ++it) {
+        devices = m_devices;
+    }
+    const QString actor = policyActor();
+    m_compaction = QtConcurrent::run([this, devices = std::move(devices), actor]() {
+        QStringList toRemove;
+        for (auto it = devices.cbegin(); it != devices.cend(); ++it) {
             if (it->uniqueId.isEmpty()) {
                 toRemove.append(it.key());
             }
         }
-    }
-
-    if (toRemove.isEmpty()) {
-        return;
-    }
+        if (toRemove.isEmpty()) {
+            return 0;
+        }
 
-    Policy::PolicyGateway* gate = Policy::PolicyServiceLocator::gateway();
-    for (const auto& id : toRemove) {
-        if (gate) {
-            gate->removeDevice(id, policyActor(), QStringLiteral("compact"));
+        int removed = 0;
+        if (Policy::PolicyGateway* gate = Policy::PolicyServiceLocator::gateway()) {
+            removed = qMax(0, gate->removeDevices(toRemove, actor, QStringLiteral("compact")));
         }
-    }
 
-    QWriteLocker locker(&m_lock);
-    syncFromPolicyGateway();
-    m_modified = false;
+        QWriteLocker locker(&m_lock);
+        syncFromPolicyGateway();
+        m_modified = false;
+        return removed;
+    });
+    return m_compaction;
 }
 
 bool DatabaseManager::loadFromFile()
@@ -849,6 +1388,12 @@ QString DatabaseManager::canonicalUniqueId(const DeviceInfo& device) const
     return device.partitionUniqueId();
 }
 
+quint64 DatabaseManager::recordGeneration() const
+{
+    QReadLocker locker(&m_lock);
+    return m_recordGeneration;
+}
+
 std::optional<DeviceRecord> DatabaseManager::getDevice(const DeviceInfo& device) const
 {
     if (auto rec = getDevice(device.uniqueId())) {
@@ -870,8 +1415,32 @@ bool DatabaseManager::updateWatchManifest(const QString& uniqueId, const WatchMa
             return false;
         }
         storedId = *resolved;
-        m_devices[storedId].watchManifest = manifest;
-        m_devices[storedId].lastManifestRoot = manifest.manifestRoot;
+    }
+
+    WatchManifest stored = manifest;
+    bool hasFiles = false;
+    for (const WatchGroup& g : manifest.groups) {
+        hasFiles = hasFiles || !g.files.isEmpty();
+    }
+    if (hasFiles || stored.filesSha256.isEmpty()) {
+        QString err;
+        const QString digest = WatchManifestFile::save(watchManifestDirectory(), manifest, &err);
+        if (!digest.isEmpty()) {
+            stored.filesSha256 = digest;
+            for (WatchGroup& g : stored.groups) {
+                g.files.clear();
+            }
+        } else {
+            // Keep the file list inline rather than lose it.
+            qWarning() << "Watch manifest stored inline:" << err;
+            stored.filesSha256.clear();
+        }
+    }
+
+    {
+        QWriteLocker locker(&m_lock);
+        m_devices[storedId].watchManifest = stored;
+        m_devices[storedId].lastManifestRoot = stored.manifestRoot;
         rec = m_devices.value(storedId);
     }
 
@@ -884,10 +1453,97 @@ bool DatabaseManager::updateWatchManifest(const QString& uniqueId, const WatchMa
         syncFromPolicyGateway();
         m_modified = false;
     }
+    pruneOutOfLineFiles();
     emit deviceUpdated(storedId);
     return true;
 }
 
+std::optional<WatchManifest> DatabaseManager::watchManifestFor(const DeviceRecord& record) const
+{
+    return loadWatchManifest(record.watchManifest);
+}
+
+std::optional<WatchManifest> DatabaseManager::loadWatchManifest(const WatchManifest& stored)
+{
+    if (stored.filesSha256.isEmpty()) {
+        return stored;
+    }
+    const std::unique_ptr<WatchManifestFile> file =
+        WatchManifestFile::open(watchManifestDirectory(), stored.filesSha256);
+    if (!file) {
+        return std::nullopt;
+    }
+    WatchManifest loaded = file->manifest();
+    loaded.filesSha256 = stored.filesSha256;
+    return loaded;
+}
+
+QString DatabaseManager::watchManifestDirectory()
+{
+    return Policy::PolicyPaths::watchManifestDirectory();
+}
+
+void DatabaseManager::migrateInlineWatchManifests()
+{
+    QList<QPair<QString, WatchManifest>> pending;
+    {
+        QReadLocker locker(&m_lock);
+        for (const DeviceRecord& rec : m_devices) {
+            if (!rec.watchManifest.filesSha256.isEmpty()) {
+                continue;
+            }
+            for (const WatchGroup& g : rec.watchManifest.groups) {
+                if (!g.files.isEmpty()) {
+                    pending.append({rec.uniqueId, rec.watchManifest});
+                    break;
+                }
+            }
+        }
+    }
+    for (const auto& [id, manifest] : pending) {
+        updateWatchManifest(id, manifest);
+    }
+}
+
+void DatabaseManager::migrateInlineBlockHashes()
+{
+    QList<DeviceRecord> pending;
+    {
+        QReadLocker locker(&m_lock);
+        for (const DeviceRecord& rec : m_devices) {
+            if (rec.blockHashesSha256.isEmpty() && !rec.blockHashes.isEmpty()) {
+                pending.append(rec);
+            }
+        }
+    }
+    for (const DeviceRecord& rec : pending) {
+        updateBlockHashes(rec.uniqueId, rec.blockHashes, rec.blockSize);
+    }
+}
+
+void DatabaseManager::pruneOutOfLineFiles()
+{
+    QSet<QString> referenced;
+    {
+        QReadLocker locker(&m_lock);
+        for (const DeviceRecord& rec : m_devices) {
+            if (!rec.watchManifest.filesSha256.isEmpty()) {
+                referenced.insert(rec.watchManifest.filesSha256);
+            }
+            if (!rec.blockHashesSha256.isEmpty()) {
+                referenced.insert(rec.blockHashesSha256);
+            }
+        }
+    }
+    QDir dir(watchManifestDirectory());
+    const QStringList files = dir.entryList({QStringLiteral("*.fsmf"), QStringLiteral("*.fsbh")}, QDir::Files);
+    for (const QString& name : files) {
+        if (!referenced.contains(QFileInfo(name).completeBaseName())) {
+            dir.remove(name);
+        }
+    }
+}
+
 bool DatabaseManager::setVerificationProfile(const QString& uniqueId, VerificationProfile profile)
 {
     DeviceRecord rec;
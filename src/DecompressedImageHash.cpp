@@ -0,0 +1,108 @@
+#include "DecompressedImageHash.h"
+#include "HashPipeline.h"
+#include "ImageStreamDecoder.h"
+#include "MultiDigest.h"
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr size_t kOutputBufferBytes = 4 * 1024 * 1024;
+constexpr int kPipelineDepth = 4;
+
+struct Format {
+    const char* suffix;
+    bool (*available)();
+    std::unique_ptr<ImageDecoders::StreamDecoder> (*open)(const QString& path, QString* error);
+};
+
+// Adding a format: one decoder in src/image_decoders/ and one row here.
+const Format kFormats[] = {
+    {".img.xz", ImageDecoders::xzAvailable, ImageDecoders::openXz},
+    {".img.zst", ImageDecoders::zstdAvailable, ImageDecoders::openZstd},
+    {".img.gz", ImageDecoders::gzipAvailable, ImageDecoders::openGzip},
+    {".zip", ImageDecoders::zipAvailable, ImageDecoders::openZipMember},
+};
+
+const Format* formatFor(const QString& fileName)
+{
+    for (const Format& f : kFormats) {
+        if (fileName.endsWith(QLatin1String(f.suffix), Qt::CaseInsensitive)) {
+            return &f;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+bool DecompressedImageHash::canDecode(const QString& fileName)
+{
+    const Format* format = formatFor(fileName);
+    return format && format->available();
+}
+
+QString DecompressedImageHash::sha256(const QString& path, QString* errorOut)
+{
+    DigestValues values;
+    if (!digests(path, DigestAlgorithm::Sha256, &values, errorOut)) {
+        return {};
+    }
+    return values.sha256;
+}
+
+bool DecompressedImageHash::digests(const QString& path, DigestAlgorithms algorithms, DigestValues* out,
+                                    QString* errorOut)
+{
+    const Format* format = formatFor(path);
+    if (!format || !format->available()) {
+        if (errorOut) {
+            *errorOut = QStringLiteral("No built-in decoder for %1").arg(path);
+        }
+        return false;
+    }
+    std::unique_ptr<ImageDecoders::StreamDecoder> decoder = format->open(path, errorOut);
+    if (!decoder) {
+        return false;
+    }
+
+    MultiDigest digest(algorithms);
+    if (!digest.isValid()) {
+        if (errorOut) {
+            *errorOut = QStringLiteral("OpenSSL hash initialization failed");
+        }
+        return false;
+    }
+
+    bool hashFailed = false;
+    QString pipelineError;
+    const bool ok = RawDeviceHash::runPipelined(
+        kPipelineDepth, kOutputBufferBytes,
+        [&](char* buffer, size_t capacity, QString* error) -> int64_t {
+            return decoder->read(buffer, capacity, error);
+        },
+        [&](const char* data, size_t length) -> bool {
+            if (!digest.update(data, length)) {
+                hashFailed = true;
+                return false;
+            }
+            return true;
+        },
+        nullptr, &pipelineError);
+    if (!ok) {
+        if (errorOut) {
+            *errorOut = hashFailed ? QStringLiteral("OpenSSL hash update failed") : pipelineError;
+        }
+        return false;
+    }
+
+    if (!digest.finish(out)) {
+        if (errorOut) {
+            *errorOut = QStringLiteral("OpenSSL hash finalization failed");
+        }
+        return false;
+    }
+    return true;
+}
+
+} // namespace FlashSpartan
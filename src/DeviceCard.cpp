@@ -1,4 +1,5 @@
 #include "DeviceCard.h"
+#include "AnimationClock.h"
 #include "Platform.h"
 #include "UiIcons.h"
 #include "StyleManager.h"
@@ -12,6 +13,44 @@
 
 namespace FlashSpartan {
 
+/** Round status dot; paints its role's colour so pulsing never touches a stylesheet. */
+class StatusDot : public QWidget {
+public:
+    using QWidget::QWidget;
+
+    void setRole(StyleManager::ColorRole role)
+    {
+        if (role != m_role) {
+            m_role = role;
+            update();
+        }
+    }
+
+    void setAlpha(int alpha)
+    {
+        if (alpha != m_alpha) {
+            m_alpha = alpha;
+            update();
+        }
+    }
+
+protected:
+    void paintEvent(QPaintEvent*) override
+    {
+        QColor color = FSStyle.color(m_role);
+        color.setAlpha(m_alpha);
+        QPainter painter(this);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.setPen(Qt::NoPen);
+        painter.setBrush(color);
+        painter.drawEllipse(rect());
+    }
+
+private:
+    StyleManager::ColorRole m_role = StyleManager::ColorRole::TextMuted;
+    int m_alpha = 255;
+};
+
 DeviceCard::DeviceCard(QWidget* parent)
     : QFrame(parent)
 {
@@ -38,9 +77,6 @@ void DeviceCard::setupUi()
     setCursor(Qt::PointingHandCursor);
     setMinimumHeight(120);
     
-    // Apply card styling
-    setStyleSheet(FSStyle.deviceCardStyleSheet());
-    
     // Create glow effect
     m_glowEffect = new QGraphicsDropShadowEffect(this);
     m_glowEffect->setBlurRadius(0);
@@ -61,16 +97,9 @@ void DeviceCard::setupUi()
     
     // Device icon
     m_iconLabel = new QLabel;
+    m_iconLabel->setObjectName(QStringLiteral("DeviceCardIcon"));
     m_iconLabel->setFixedSize(ICON_SIZE, ICON_SIZE);
     m_iconLabel->setAlignment(Qt::AlignCenter);
-    m_iconLabel->setStyleSheet(QString(R"(
-        QLabel {
-            background-color: %1;
-            border-radius: %2px;
-            font-size: 24px;
-        }
-    )").arg(FSStyle.colorCss(StyleManager::ColorRole::BackgroundDark))
-       .arg(ICON_SIZE / 4));
     UiIcons::setLabelPixmap(m_iconLabel, ":/icons/usb-drive.svg", 28);
     m_headerLayout->addWidget(m_iconLabel);
     
@@ -80,16 +109,16 @@ void DeviceCard::setupUi()
     
     // Device name
     m_nameLabel = new QLabel;
-    m_nameLabel->setFont(FSFont(Heading3));
-    m_nameLabel->setStyleSheet(QString("color: %1; font-weight: 600;")
-        .arg(FSStyle.colorCss(StyleManager::ColorRole::TextPrimary)));
+    QFont nameFont = FSFont(Heading3);
+    nameFont.setWeight(QFont::DemiBold);
+    m_nameLabel->setFont(nameFont);
+    StyleManager::setTextRole(m_nameLabel, StyleManager::ColorRole::TextPrimary);
     nameLayout->addWidget(m_nameLabel);
     
     // Device path
     m_devicePathLabel = new QLabel;
     m_devicePathLabel->setFont(FSFont(Small));
-    m_devicePathLabel->setStyleSheet(QString("color: %1;")
-        .arg(FSStyle.colorCss(StyleManager::ColorRole::TextMuted)));
+    StyleManager::setTextRole(m_devicePathLabel, StyleManager::ColorRole::TextMuted);
     nameLayout->addWidget(m_devicePathLabel);
     
     m_headerLayout->addLayout(nameLayout, 1);
@@ -102,12 +131,12 @@ void DeviceCard::setupUi()
     QHBoxLayout* indicatorLayout = new QHBoxLayout;
     indicatorLayout->setSpacing(8);
     
-    m_statusIndicator = new QLabel;
-    m_statusIndicator->setObjectName("StatusIndicator");
+    m_statusIndicator = new StatusDot;
     m_statusIndicator->setFixedSize(STATUS_INDICATOR_SIZE, STATUS_INDICATOR_SIZE);
     indicatorLayout->addWidget(m_statusIndicator);
     
     m_statusLabel = new QLabel;
+    m_statusLabel->setObjectName(QStringLiteral("StatusBadge"));
     m_statusLabel->setFont(FSFont(Small));
     indicatorLayout->addWidget(m_statusLabel);
     
@@ -127,14 +156,12 @@ void DeviceCard::setupUi()
     auto addInfoRow = [this](int row, int col, const QString& label, QLabel*& valueLabel) {
         QLabel* lblLabel = new QLabel(label);
         lblLabel->setFont(FSFont(Small));
-        lblLabel->setStyleSheet(QString("color: %1;")
-            .arg(FSStyle.colorCss(StyleManager::ColorRole::TextMuted)));
+        StyleManager::setTextRole(lblLabel, StyleManager::ColorRole::TextMuted);
         m_infoLayout->addWidget(lblLabel, row, col * 2);
         
         valueLabel = new QLabel("-");
         valueLabel->setFont(FSFont(Small));
-        valueLabel->setStyleSheet(QString("color: %1;")
-            .arg(FSStyle.colorCss(StyleManager::ColorRole::TextSecondary)));
+        StyleManager::setTextRole(valueLabel, StyleManager::ColorRole::TextSecondary);
         m_infoLayout->addWidget(valueLabel, row, col * 2 + 1);
     };
     
@@ -146,6 +173,7 @@ void DeviceCard::setupUi()
     m_isoSummaryLabel = new QLabel;
     m_isoSummaryLabel->setWordWrap(true);
     m_isoSummaryLabel->setFont(FSFont(Small));
+    StyleManager::setTextRole(m_isoSummaryLabel, StyleManager::ColorRole::TextSecondary);
     m_isoSummaryLabel->setVisible(false);
     m_infoLayout->addWidget(m_isoSummaryLabel, 2, 0, 1, 4);
 
@@ -161,15 +189,32 @@ void DeviceCard::setupUi()
     
     m_progressLabel = new QLabel("Calculating hash...");
     m_progressLabel->setFont(FSFont(Small));
-    m_progressLabel->setStyleSheet(QString("color: %1;")
-        .arg(FSStyle.colorCss(StyleManager::ColorRole::TextSecondary)));
+    StyleManager::setTextRole(m_progressLabel, StyleManager::ColorRole::TextSecondary);
     progressHeaderLayout->addWidget(m_progressLabel);
     
     m_speedLabel = new QLabel;
     m_speedLabel->setFont(FSFont(Monospace));
-    m_speedLabel->setStyleSheet(QString("color: %1;")
-        .arg(FSStyle.colorCss(StyleManager::ColorRole::AccentPrimary)));
+    StyleManager::setTextRole(m_speedLabel, StyleManager::ColorRole::AccentPrimary);
     progressHeaderLayout->addWidget(m_speedLabel);
+    progressHeaderLayout->addStretch();
+
+    m_pauseHashBtn = new QPushButton(QStringLiteral("Pause"));
+    m_pauseHashBtn->setToolTip(QStringLiteral("Pause this hash; it keeps its place and resumes where it stopped"));
+    m_pauseHashBtn->setCursor(Qt::PointingHandCursor);
+    m_pauseHashBtn->setFixedHeight(24);
+    connect(m_pauseHashBtn, &QPushButton::clicked, this, [this]() {
+        emit pauseHashRequested(m_device.deviceNode, !m_hashPaused);
+    });
+    progressHeaderLayout->addWidget(m_pauseHashBtn);
+
+    m_cancelHashBtn = new QPushButton(QStringLiteral("Cancel"));
+    m_cancelHashBtn->setToolTip(QStringLiteral("Stop this hash; a full read can resume from its checkpoint"));
+    m_cancelHashBtn->setCursor(Qt::PointingHandCursor);
+    m_cancelHashBtn->setFixedHeight(24);
+    connect(m_cancelHashBtn, &QPushButton::clicked, this, [this]() {
+        emit cancelHashRequested(m_device.deviceNode);
+    });
+    progressHeaderLayout->addWidget(m_cancelHashBtn);
     
     progressLayout->addLayout(progressHeaderLayout);
     
@@ -178,7 +223,6 @@ void DeviceCard::setupUi()
     m_progressBar->setValue(0);
     m_progressBar->setTextVisible(false);
     m_progressBar->setFixedHeight(6);
-    m_progressBar->setStyleSheet(FSStyle.progressBarStyleSheet());
     progressLayout->addWidget(m_progressBar);
     
     m_progressWidget->setVisible(false);
@@ -195,7 +239,6 @@ void DeviceCard::setupUi()
         btn->setToolTip(tooltip);
         btn->setCursor(Qt::PointingHandCursor);
         btn->setFixedHeight(32);
-        btn->setStyleSheet(FSStyle.buttonStyleSheet());
         return btn;
     };
     
@@ -224,11 +267,11 @@ void DeviceCard::setupUi()
     UiIcons::setButtonIcon(m_openBtn, ":/icons/folder-open.svg", 16);
     
     // Style the eject button as danger
-    m_ejectBtn->setStyleSheet(FSStyle.dangerButtonStyleSheet());
+    StyleManager::setButtonVariant(m_ejectBtn, StyleManager::ButtonVariant::Danger);
     
     // Style rehash as primary
-    m_rehashBtn->setStyleSheet(FSStyle.primaryButtonStyleSheet());
-    m_acceptBtn->setStyleSheet(FSStyle.primaryButtonStyleSheet());
+    StyleManager::setButtonVariant(m_rehashBtn, StyleManager::ButtonVariant::Primary);
+    StyleManager::setButtonVariant(m_acceptBtn, StyleManager::ButtonVariant::Primary);
     m_acceptBtn->setVisible(false);
     
     connect(m_mountBtn, &QPushButton::clicked, this, &DeviceCard::onMountClicked);
@@ -264,10 +307,6 @@ void DeviceCard::setupUi()
     m_glowAnimation->setDuration(1000);
     m_glowAnimation->setLoopCount(-1);
     
-    // Setup pulse timer
-    m_pulseTimer = new QTimer(this);
-    connect(m_pulseTimer, &QTimer::timeout, this, &DeviceCard::updatePulse);
-    
     updateDisplay();
 }
 
@@ -306,6 +345,9 @@ void DeviceCard::setHashProgress(double progress)
 
 void DeviceCard::setHashSpeed(double speedMBps)
 {
+    if (m_hashPaused) {
+        return;
+    }
     m_speedLabel->setText(QString("%1 MB/s").arg(speedMBps, 0, 'f', 1));
 }
 
@@ -337,8 +379,6 @@ void DeviceCard::setIsoVerifySummary(const QString& summary)
         return;
     }
     m_isoSummaryLabel->setText(QStringLiteral("Images: %1").arg(summary));
-    m_isoSummaryLabel->setStyleSheet(QString("color: %1;")
-                                         .arg(FSStyle.colorCss(StyleManager::ColorRole::TextSecondary)));
     m_isoSummaryLabel->setVisible(true);
 }
 
@@ -364,15 +404,30 @@ void DeviceCard::setHashBytes(quint64 processed, quint64 total)
     const double pct = 100.0 * static_cast<double>(processed) / static_cast<double>(total);
     const double doneGb = static_cast<double>(processed) / (1024.0 * 1024.0 * 1024.0);
     const double totalGb = static_cast<double>(total) / (1024.0 * 1024.0 * 1024.0);
-    m_progressLabel->setText(QString("Hashing %1% · %2 / %3 GB")
+    m_progressLabel->setText(QString("%1 %2% · %3 / %4 GB")
+                                 .arg(m_hashPaused ? QStringLiteral("Paused") : QStringLiteral("Hashing"))
                                  .arg(static_cast<int>(pct))
                                  .arg(doneGb, 0, 'f', 2)
                                  .arg(totalGb, 0, 'f', 2));
 }
 
+void DeviceCard::setHashPaused(bool paused)
+{
+    m_hashPaused = paused;
+    if (m_pauseHashBtn) {
+        m_pauseHashBtn->setText(paused ? QStringLiteral("Resume") : QStringLiteral("Pause"));
+    }
+    if (paused && m_speedLabel) {
+        m_speedLabel->clear();
+    }
+}
+
 void DeviceCard::setProgressVisible(bool visible)
 {
     m_progressWidget->setVisible(visible);
+    if (!visible) {
+        setHashPaused(false);
+    }
     if (m_cancelHashBtn) {
         m_cancelHashBtn->setVisible(visible);
     }
@@ -384,15 +439,17 @@ void DeviceCard::setProgressVisible(bool visible)
 
 void DeviceCard::startPulseAnimation()
 {
-    if (!m_pulseTimer->isActive()) {
-        m_pulsePhase = 0;
-        m_pulseTimer->start(PULSE_INTERVAL);
-    }
+    m_pulsing = true;
+    updatePulseSubscription();
 }
 
 void DeviceCard::stopAnimations()
 {
-    m_pulseTimer->stop();
+    m_pulsing = false;
+    updatePulseSubscription();
+    if (m_statusIndicator) {
+        m_statusIndicator->setAlpha(255);
+    }
     m_glowAnimation->stop();
     m_glowEffect->setBlurRadius(0);
 }
@@ -524,6 +581,30 @@ void DeviceCard::resizeEvent(QResizeEvent* event)
     QFrame::resizeEvent(event);
 }
 
+void DeviceCard::showEvent(QShowEvent* event)
+{
+    QFrame::showEvent(event);
+    updatePulseSubscription();
+}
+
+void DeviceCard::hideEvent(QHideEvent* event)
+{
+    QFrame::hideEvent(event);
+    updatePulseSubscription();
+}
+
+void DeviceCard::updatePulseSubscription()
+{
+    AnimationClock& clock = AnimationClock::instance();
+    if (m_pulsing && isVisible()) {
+        if (!clock.isSubscribed(this)) {
+            clock.subscribe(this, [this](qint64 elapsedMs) { updatePulse(elapsedMs); });
+        }
+    } else {
+        clock.unsubscribe(this);
+    }
+}
+
 void DeviceCard::onMountClicked()
 {
     emit mountRequested(m_device.deviceNode);
@@ -549,12 +630,15 @@ void DeviceCard::onAcceptClicked()
     emit acceptFingerprintRequested(m_device.deviceNode);
 }
 
-void DeviceCard::updatePulse()
+void DeviceCard::updatePulse(qint64 elapsedMs)
 {
-    m_pulsePhase = (m_pulsePhase + 1) % 100;
-    
+    // Cards scrolled out of the viewport skip the frame; shared time keeps every pulse in step.
+    if (visibleRegion().isEmpty()) {
+        return;
+    }
+
     // Sine wave for smooth pulsing
-    double phase = m_pulsePhase / 100.0 * 2 * M_PI;
+    double phase = double(elapsedMs % PULSE_PERIOD_MS) / PULSE_PERIOD_MS * 2 * M_PI;
     double intensity = (sin(phase) + 1) / 2;  // 0 to 1
     
     m_glowEffect->setBlurRadius(5 + intensity * 15);
@@ -562,17 +646,7 @@ void DeviceCard::updatePulse()
     
     // Also pulse the status indicator opacity
     if (m_statusIndicator) {
-        int alpha = static_cast<int>(155 + intensity * 100);
-        QColor color = statusColor();
-        color.setAlpha(alpha);
-        m_statusIndicator->setStyleSheet(QString(R"(
-            QLabel#StatusIndicator {
-                background-color: %1;
-                border-radius: 6px;
-                min-width: 12px;
-                min-height: 12px;
-            }
-        )").arg(color.name(QColor::HexArgb)));
+        m_statusIndicator->setAlpha(static_cast<int>(155 + intensity * 100));
     }
 }
 
@@ -608,46 +682,39 @@ void DeviceCard::updateStatusIndicator()
 {
     const QString statusText = verificationStatusToString(m_status);
     StyleManager::ColorRole badgeBg = StyleManager::ColorRole::Surface;
-    StyleManager::ColorRole badgeFg = StyleManager::ColorRole::TextSecondary;
     StyleManager::ColorRole dotRole = StyleManager::ColorRole::TextMuted;
 
     switch (m_status) {
         case VerificationStatus::Verified:
             badgeBg = StyleManager::ColorRole::Verified;
-            badgeFg = StyleManager::ColorRole::BackgroundDark;
             dotRole = StyleManager::ColorRole::Verified;
             break;
         case VerificationStatus::Modified:
             badgeBg = StyleManager::ColorRole::Modified;
-            badgeFg = StyleManager::ColorRole::BackgroundDark;
             dotRole = StyleManager::ColorRole::Modified;
             break;
         case VerificationStatus::NewDevice:
             badgeBg = StyleManager::ColorRole::Unknown;
-            badgeFg = StyleManager::ColorRole::BackgroundDark;
             dotRole = StyleManager::ColorRole::Unknown;
             break;
         case VerificationStatus::Hashing:
             badgeBg = StyleManager::ColorRole::Hashing;
-            badgeFg = StyleManager::ColorRole::BackgroundDark;
             dotRole = StyleManager::ColorRole::Hashing;
             break;
         case VerificationStatus::Error:
             badgeBg = StyleManager::ColorRole::Error;
-            badgeFg = StyleManager::ColorRole::BackgroundDark;
             dotRole = StyleManager::ColorRole::Error;
             break;
         default:
             break;
     }
 
-    m_statusIndicator->setStyleSheet(FSStyle.statusIndicatorStyleSheet(dotRole));
+    m_statusIndicator->setRole(dotRole);
     m_statusIndicator->setVisible(m_status == VerificationStatus::Hashing
                                   || m_status == VerificationStatus::Unknown);
 
-    m_statusLabel->setObjectName(QStringLiteral("StatusBadge"));
     m_statusLabel->setText(statusText);
-    m_statusLabel->setStyleSheet(FSStyle.statusBadgeStyleSheet(badgeBg, badgeFg));
+    StyleManager::setStatusBadge(m_statusLabel, badgeBg);
 }
 
 void DeviceCard::updateActionButtons()
@@ -678,10 +745,10 @@ void DeviceCard::updateActionButtons()
         m_acceptBtn->setToolTip(
             "Store the verified hash as the new trusted fingerprint (no re-hash)");
         m_rehashBtn->setText("↻ Rehash");
-        m_rehashBtn->setStyleSheet(FSStyle.dangerButtonStyleSheet());
+        StyleManager::setButtonVariant(m_rehashBtn, StyleManager::ButtonVariant::Danger);
     } else {
         m_rehashBtn->setText("↻ Rehash");
-        m_rehashBtn->setStyleSheet(FSStyle.primaryButtonStyleSheet());
+        StyleManager::setButtonVariant(m_rehashBtn, StyleManager::ButtonVariant::Primary);
     }
 }
 
@@ -0,0 +1,198 @@
+#include "DeviceGeometry.h"
+#include "RawDeviceHash.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#if defined(Q_OS_LINUX)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#endif
+
+namespace FlashSpartan {
+
+struct DeviceGeometryCache::Handle::Open {
+    int fd = -1;
+    std::function<void(int)> close;
+
+    ~Open()
+    {
+        if (close) {
+            close(fd);
+        }
+    }
+};
+
+namespace {
+
+QString readText(const QString& path)
+{
+    QFile f(path);
+    return f.open(QIODevice::ReadOnly) ? QString::fromLatin1(f.readAll()).trimmed() : QString();
+}
+
+int readInt(const QString& path)
+{
+    return static_cast<int>(readText(path).toLongLong());
+}
+
+} // namespace
+
+int DeviceGeometryCache::Handle::fd() const
+{
+    return m_open ? m_open->fd : -1;
+}
+
+DeviceGeometryCache::Backend DeviceGeometryCache::systemBackend()
+{
+    Backend backend;
+    backend.open = [](const QString& deviceNode) { return RawDeviceHash::openDevice(deviceNode); };
+    backend.close = [](int fd) { RawDeviceHash::closeDevice(fd); };
+    backend.probe = [](int fd, const QString& deviceNode) {
+        DeviceGeometry geometry;
+        geometry.sizeBytes = RawDeviceHash::deviceSize(fd, deviceNode);
+#if defined(Q_OS_LINUX)
+        const QString canonical = QFileInfo(deviceNode).canonicalFilePath();
+        readSysfs(QFileInfo(QStringLiteral("/sys/class/block/") + QFileInfo(canonical).fileName()).canonicalFilePath(),
+                  &geometry);
+        // The driver's answer wins over sysfs where both exist.
+        int logical = 0;
+        if (ioctl(fd, BLKSSZGET, &logical) == 0 && logical > 0) {
+            geometry.logicalSectorBytes = logical;
+        }
+        unsigned int physical = 0;
+        if (ioctl(fd, BLKPBSZGET, &physical) == 0 && physical > 0) {
+            geometry.physicalSectorBytes = static_cast<int>(physical);
+        }
+#endif
+        return geometry;
+    };
+    backend.identity = [](const QString& deviceNode) -> quint64 {
+#if defined(Q_OS_LINUX)
+        struct stat st {};
+        if (::stat(QFile::encodeName(deviceNode).constData(), &st) != 0 || !S_ISBLK(st.st_mode)) {
+            return 0;
+        }
+        return static_cast<quint64>(st.st_rdev);
+#else
+        // No device numbers to compare; forget() on removal is what keeps entries current.
+        return deviceNode.isEmpty() ? 0 : 1;
+#endif
+    };
+    return backend;
+}
+
+DeviceGeometryCache& DeviceGeometryCache::instance()
+{
+    static DeviceGeometryCache cache;
+    return cache;
+}
+
+DeviceGeometryCache::DeviceGeometryCache(Backend backend)
+    : m_backend(std::move(backend))
+{
+}
+
+DeviceGeometry DeviceGeometryCache::geometry(const QString& deviceNode)
+{
+    QMutexLocker locker(&m_mutex);
+    const quint64 identity = m_backend.identity(deviceNode);
+    if (identity == 0) {
+        m_entries.remove(deviceNode);
+        return {};
+    }
+    auto it = m_entries.constFind(deviceNode);
+    if (it != m_entries.cend() && it->identity == identity && !it->geometry.isEmpty()) {
+        return it->geometry;
+    }
+    const Handle handle = acquireLocked(deviceNode, identity);
+    if (!handle.isOpen()) {
+        return {};
+    }
+    Entry& entry = m_entries[deviceNode];
+    entry.geometry = m_backend.probe(handle.fd(), deviceNode);
+    return entry.geometry;
+}
+
+DeviceGeometryCache::Handle DeviceGeometryCache::acquire(const QString& deviceNode)
+{
+    QMutexLocker locker(&m_mutex);
+    const quint64 identity = m_backend.identity(deviceNode);
+    if (identity == 0) {
+        m_entries.remove(deviceNode);
+        return {};
+    }
+    Handle handle = acquireLocked(deviceNode, identity);
+    if (handle.isOpen()) {
+        Entry& entry = m_entries[deviceNode];
+        if (entry.geometry.isEmpty()) {
+            entry.geometry = m_backend.probe(handle.fd(), deviceNode);
+        }
+    }
+    return handle;
+}
+
+DeviceGeometryCache::Handle DeviceGeometryCache::acquireLocked(const QString& deviceNode, quint64 identity)
+{
+    Entry& entry = m_entries[deviceNode];
+    if (entry.identity != identity) {
+        // Another device behind the node: handles to the old one keep their descriptor.
+        entry = Entry();
+        entry.identity = identity;
+    }
+    if (std::shared_ptr<const Handle::Open> open = entry.open.lock()) {
+        return Handle(std::move(open));
+    }
+    const int fd = m_backend.open(deviceNode);
+    if (fd < 0) {
+        if (entry.geometry.isEmpty()) {
+            m_entries.remove(deviceNode);
+        }
+        return {};
+    }
+    auto open = std::make_shared<Handle::Open>();
+    open->fd = fd;
+    open->close = m_backend.close;
+    entry.open = open;
+    return Handle(std::move(open));
+}
+
+void DeviceGeometryCache::forget(const QString& deviceNode)
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.remove(deviceNode);
+}
+
+bool DeviceGeometryCache::contains(const QString& deviceNode) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_entries.constFind(deviceNode);
+    return it != m_entries.cend() && !it->geometry.isEmpty();
+}
+
+void DeviceGeometryCache::readSysfs(const QString& blockDir, DeviceGeometry* geometry)
+{
+    if (blockDir.isEmpty() || !geometry) {
+        return;
+    }
+    // Partitions have no queue/ of their own; it lives on the parent disk.
+    const QString disk =
+        QFileInfo::exists(blockDir + QStringLiteral("/partition")) ? QFileInfo(blockDir).absolutePath() : blockDir;
+    const QString queue = disk + QStringLiteral("/queue/");
+    geometry->logicalSectorBytes = readInt(queue + QStringLiteral("logical_block_size"));
+    geometry->physicalSectorBytes = readInt(queue + QStringLiteral("physical_block_size"));
+    geometry->optimalIoKB = readInt(queue + QStringLiteral("optimal_io_size")) / 1024;
+    geometry->maxSectorsKB = readInt(queue + QStringLiteral("max_sectors_kb"));
+    geometry->rotational = readInt(queue + QStringLiteral("rotational")) == 1;
+    geometry->usbSpeedMbps = 0;
+    for (QString dir = disk; dir.contains(QLatin1String("/devices/")); dir = QFileInfo(dir).absolutePath()) {
+        if (QFileInfo::exists(dir + QStringLiteral("/idVendor"))) {
+            geometry->usbSpeedMbps = static_cast<int>(readText(dir + QStringLiteral("/speed")).toDouble());
+            break;
+        }
+    }
+}
+
+} // namespace FlashSpartan
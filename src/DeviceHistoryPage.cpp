@@ -4,35 +4,50 @@
 #include <QComboBox>
 #include <QFormLayout>
 #include <QHeaderView>
-#include <QHBoxLayout>
 #include <QLabel>
-#include <QPushButton>
 #include <QScrollArea>
-#include <QTableWidget>
-#include <QTableWidgetItem>
+#include <QTableView>
 #include <QVBoxLayout>
 
 namespace FlashSpartan {
 
 namespace {
 
-QTableWidgetItem* readOnlyItem(const QString& text)
-{
-    auto* item = new QTableWidgetItem(text);
-    item->setFlags(item->flags() & ~Qt::ItemIsEditable);
-    return item;
-}
+enum Column { TimeColumn, EventColumn, DeviceColumn, TypeColumn, ResultColumn, DetailsColumn };
 
-QWidget* tableButtonCell(QPushButton* btn)
+QVariant eventCell(const UiEventEntry& e, int column, int role)
 {
-    btn->setFixedHeight(20);
-    btn->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
-    btn->setStyleSheet(FSStyle.compactTableButtonStyleSheet());
-    auto* cell = new QWidget;
-    auto* lay = new QHBoxLayout(cell);
-    lay->setContentsMargins(2, 1, 2, 1);
-    lay->addWidget(btn, 0, Qt::AlignCenter);
-    return cell;
+    if (column == DetailsColumn) {
+        switch (role) {
+            case Qt::DisplayRole:
+                return QStringLiteral("Details");
+            case Qt::TextAlignmentRole:
+                return int(Qt::AlignCenter);
+            case Qt::ForegroundRole:
+                return FSStyle.color(StyleManager::ColorRole::AccentPrimary);
+            case Qt::ToolTipRole:
+                return e.detail;
+            default:
+                return {};
+        }
+    }
+    if (role != Qt::DisplayRole) {
+        return {};
+    }
+    switch (column) {
+        case TimeColumn:
+            return e.time.toString(QStringLiteral("yyyy-MM-dd hh:mm:ss"));
+        case EventColumn:
+            return e.event;
+        case DeviceColumn:
+            return e.device;
+        case TypeColumn:
+            return e.type;
+        case ResultColumn:
+            return e.result;
+        default:
+            return {};
+    }
 }
 
 } // namespace
@@ -67,22 +82,36 @@ void DeviceHistoryPage::setupUi()
     connect(m_deviceCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this,
             &DeviceHistoryPage::onDeviceComboChanged);
     picker->addRow(QStringLiteral("Device:"), m_deviceCombo);
+    m_summaryLabel = new QLabel;
+    m_summaryLabel->setStyleSheet(QString("color: %1;")
+                                      .arg(FSStyle.colorCss(StyleManager::ColorRole::TextSecondary)));
+    picker->addRow(QStringLiteral("Verified:"), m_summaryLabel);
     layout->addLayout(picker);
 
-    m_eventsTable = new QTableWidget(0, 6);
-    m_eventsTable->setHorizontalHeaderLabels({
+    m_eventsModel = new RecordTableModel<UiEventEntry>({
         QStringLiteral("Time"),
         QStringLiteral("Event"),
         QStringLiteral("Device"),
         QStringLiteral("Type"),
         QStringLiteral("Result"),
         QStringLiteral(""),
-    });
+    }, eventCell, this);
+    connect(m_eventsModel, &RecordTableModelBase::rowsReplaced, this, &DeviceHistoryPage::applyTableLayout);
+
+    m_eventsTable = new QTableView;
+    m_eventsTable->setModel(m_eventsModel);
     m_eventsTable->verticalHeader()->setVisible(false);
+    m_eventsTable->verticalHeader()->setDefaultSectionSize(30);
     m_eventsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
     m_eventsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
     m_eventsTable->setAlternatingRowColors(true);
     m_eventsTable->setStyleSheet(FSStyle.dataTableStyleSheet());
+    connect(m_eventsTable, &QTableView::clicked, this, &DeviceHistoryPage::onEventClicked);
+    connect(m_eventsTable, &QTableView::doubleClicked, this, [this](const QModelIndex& index) {
+        if (index.isValid() && index.column() != DetailsColumn) {
+            emit eventDetailsRequested(m_eventsModel->record(index.row()));
+        }
+    });
     layout->addWidget(m_eventsTable, 1);
 
     scroll->setWidget(content);
@@ -110,6 +139,19 @@ void DeviceHistoryPage::setSelectedDevice(const QString& deviceNode)
     }
 }
 
+void DeviceHistoryPage::setDeviceSummary(const VerifyRollup::DeviceSummary& summary)
+{
+    if (summary.counts.total == 0) {
+        m_summaryLabel->setText(QStringLiteral("never"));
+        return;
+    }
+    m_summaryLabel->setText(QStringLiteral("%1 times, %2 failed · last %3 on %4")
+                                .arg(summary.counts.total)
+                                .arg(summary.counts.failed)
+                                .arg(summary.lastStatus.isEmpty() ? QStringLiteral("—") : summary.lastStatus,
+                                     summary.lastAt.toLocalTime().toString(QStringLiteral("yyyy-MM-dd hh:mm"))));
+}
+
 QString DeviceHistoryPage::selectedDeviceNode() const
 {
     return m_deviceCombo->currentData().toString();
@@ -117,44 +159,33 @@ QString DeviceHistoryPage::selectedDeviceNode() const
 
 void DeviceHistoryPage::setEvents(const QList<UiEventEntry>& events)
 {
-    m_eventRows = events;
-    m_eventsTable->setRowCount(events.size());
-    const QString timeFmt = QStringLiteral("yyyy-MM-dd hh:mm:ss");
-    for (int r = 0; r < events.size(); ++r) {
-        const UiEventEntry& e = events.at(r);
-        m_eventsTable->setItem(r, 0, readOnlyItem(e.time.toString(timeFmt)));
-        m_eventsTable->setItem(r, 1, readOnlyItem(e.event));
-        m_eventsTable->setItem(r, 2, readOnlyItem(e.device));
-        m_eventsTable->setItem(r, 3, readOnlyItem(e.type));
-        m_eventsTable->setItem(r, 4, readOnlyItem(e.result));
-
-        auto* detailsBtn = new QPushButton(QStringLiteral("Details"));
-        detailsBtn->setProperty("eventRow", r);
-        detailsBtn->setCursor(Qt::PointingHandCursor);
-        connect(detailsBtn, &QPushButton::clicked, this, &DeviceHistoryPage::onEventDetailsClicked);
-        m_eventsTable->setCellWidget(r, 5, tableButtonCell(detailsBtn));
-        m_eventsTable->setRowHeight(r, 30);
+    m_eventsModel->setRecords(events);
+}
+
+void DeviceHistoryPage::addEvent(const UiEventEntry& event)
+{
+    if (!event.deviceNode.isEmpty() && event.deviceNode == selectedDeviceNode()) {
+        m_eventsModel->prependRecords({event});
     }
-    applyTableLayout();
 }
 
 void DeviceHistoryPage::applyTableLayout()
 {
     auto* hdr = m_eventsTable->horizontalHeader();
     hdr->setStretchLastSection(false);
-    hdr->setSectionResizeMode(1, QHeaderView::Stretch);
-    hdr->setSectionResizeMode(2, QHeaderView::ResizeToContents);
-    hdr->setSectionResizeMode(3, QHeaderView::ResizeToContents);
-    hdr->setSectionResizeMode(4, QHeaderView::ResizeToContents);
-    hdr->setSectionResizeMode(5, QHeaderView::Fixed);
-    m_eventsTable->setColumnWidth(5, 88);
+    hdr->setSectionResizeMode(EventColumn, QHeaderView::Stretch);
+    hdr->setSectionResizeMode(DeviceColumn, QHeaderView::ResizeToContents);
+    hdr->setSectionResizeMode(TypeColumn, QHeaderView::ResizeToContents);
+    hdr->setSectionResizeMode(ResultColumn, QHeaderView::ResizeToContents);
+    hdr->setSectionResizeMode(DetailsColumn, QHeaderView::Fixed);
+    m_eventsTable->setColumnWidth(DetailsColumn, 88);
 
     const QFontMetrics fm(m_eventsTable->font());
     const int minTime = fm.horizontalAdvance(QStringLiteral("2026-05-28 12:34:56")) + 28;
-    hdr->setSectionResizeMode(0, QHeaderView::Interactive);
-    m_eventsTable->setColumnWidth(0, qMax(minTime, m_eventsTable->columnWidth(0)));
-    if (m_eventsTable->columnWidth(0) < minTime * 2) {
-        m_eventsTable->setColumnWidth(0, minTime * 2);
+    hdr->setSectionResizeMode(TimeColumn, QHeaderView::Interactive);
+    m_eventsTable->setColumnWidth(TimeColumn, qMax(minTime, m_eventsTable->columnWidth(TimeColumn)));
+    if (m_eventsTable->columnWidth(TimeColumn) < minTime * 2) {
+        m_eventsTable->setColumnWidth(TimeColumn, minTime * 2);
     }
 }
 
@@ -166,15 +197,10 @@ void DeviceHistoryPage::onDeviceComboChanged(int index)
     emit deviceSelectionChanged(m_deviceCombo->itemData(index).toString());
 }
 
-void DeviceHistoryPage::onEventDetailsClicked()
+void DeviceHistoryPage::onEventClicked(const QModelIndex& index)
 {
-    auto* btn = qobject_cast<QPushButton*>(sender());
-    if (!btn) {
-        return;
-    }
-    const int row = btn->property("eventRow").toInt();
-    if (row >= 0 && row < m_eventRows.size()) {
-        emit eventDetailsRequested(m_eventRows.at(row));
+    if (index.isValid() && index.column() == DetailsColumn) {
+        emit eventDetailsRequested(m_eventsModel->record(index.row()));
     }
 }
 
@@ -2,6 +2,7 @@
 
 #ifdef Q_OS_WIN
 
+#include "WinDeviceNotifier.h"
 #include "WinStorage.h"
 
 #include <QMutexLocker>
@@ -9,16 +10,23 @@
 #include <QStorageInfo>
 #include <qt_windows.h>
 
+#include <utility>
+
 namespace FlashSpartan {
 
 DeviceMonitor::DeviceMonitor(QObject* parent)
     : QThread(parent)
+    , m_wakeEvent(CreateEventW(nullptr, FALSE, FALSE, nullptr))
+    , m_devices(std::make_shared<const DeviceSet>())
 {
 }
 
 DeviceMonitor::~DeviceMonitor()
 {
     stopMonitoring();
+    if (m_wakeEvent) {
+        CloseHandle(m_wakeEvent);
+    }
 }
 
 void DeviceMonitor::startMonitoring()
@@ -36,6 +44,7 @@ void DeviceMonitor::stopMonitoring()
         return;
     }
     m_running.store(false);
+    SetEvent(m_wakeEvent);
     if (!wait(5000)) {
         qWarning() << "DeviceMonitor: thread did not stop within timeout";
     }
@@ -43,46 +52,60 @@ void DeviceMonitor::stopMonitoring()
 
 QList<DeviceInfo> DeviceMonitor::connectedDevices() const
 {
-    QMutexLocker locker(&m_devicesMutex);
-    return m_devices.values();
+    const std::shared_ptr<const DeviceSet> set = devices();
+    QList<DeviceInfo> out;
+    out.reserve(set->size());
+    for (const DeviceHandle& device : *set) {
+        out.append(*device);
+    }
+    return out;
+}
+
+std::shared_ptr<const DeviceMonitor::DeviceSet> DeviceMonitor::devices() const
+{
+    return std::atomic_load(&m_devices);
+}
+
+void DeviceMonitor::publish(std::shared_ptr<const DeviceSet> next)
+{
+    std::atomic_store(&m_devices, std::move(next));
 }
 
 std::optional<DeviceInfo> DeviceMonitor::getDevice(const QString& deviceNode) const
 {
-    QMutexLocker locker(&m_devicesMutex);
-    const auto it = m_devices.constFind(deviceNode);
-    if (it == m_devices.constEnd()) {
+    const DeviceHandle device = devices()->value(deviceNode);
+    if (!device) {
         return std::nullopt;
     }
-    return *it;
+    return *device;
 }
 
 void DeviceMonitor::rescan()
 {
     m_rescanRequested.store(true);
+    SetEvent(m_wakeEvent);
 }
 
 void DeviceMonitor::run()
 {
+    // A new stick is scanned as soon as its volume appears rather than at the next idle
+    // scan; the idle scan stays for label and readiness changes, which are not notified.
+    WinDeviceNotifier notifier(WinStorage::kVolumeInterfaceClass, m_wakeEvent);
     scanExistingDevices();
-    {
-        QMutexLocker locker(&m_devicesMutex);
-        emit initialScanComplete(m_devices.size());
-    }
-    int idleTicks = 0;
+    emit initialScanComplete(static_cast<int>(devices()->size()));
     while (m_running.load()) {
-        const bool rescanNow = m_rescanRequested.exchange(false);
-        if (rescanNow) {
-            scanExistingDevices();
-            idleTicks = 0;
-        } else {
-            ++idleTicks;
-            if (idleTicks * POLL_TIMEOUT_MS >= 5000) {
-                scanExistingDevices();
-                idleTicks = 0;
-            }
+        bool preparing = false;
+        for (const DeviceHandle& device : *devices()) {
+            preparing = preparing || !device->isMounted;
+        }
+        WaitForSingleObject(m_wakeEvent, preparing ? POLL_TIMEOUT_MS : IDLE_SCAN_INTERVAL_MS);
+        if (!m_running.load()) {
+            break;
         }
-        msleep(POLL_TIMEOUT_MS);
+        if (m_rescanRequested.exchange(false) || !notifier.take().isEmpty()) {
+            WinStorage::invalidateVolumeCache();
+        }
+        scanExistingDevices();
     }
 }
 
@@ -97,7 +120,7 @@ void DeviceMonitor::cleanupUdev()
 
 void DeviceMonitor::scanExistingDevices()
 {
-    QHash<QString, DeviceInfo> detected;
+    auto detected = std::make_shared<DeviceSet>();
     for (const QStorageInfo& storage : QStorageInfo::mountedVolumes()) {
         if (!storage.isValid()
             || !WinStorage::isUsbFlashVolumeRoot(storage.rootPath())) {
@@ -124,34 +147,36 @@ void DeviceMonitor::scanExistingDevices()
         }
         info.mountPoint = storage.rootPath();
         info.isRemovable = true;
-        detected.insert(info.deviceNode, info);
+        detected->insert(info.deviceNode, std::make_shared<const DeviceInfo>(std::move(info)));
     }
 
-    QList<DeviceInfo> connected;
-    QList<DeviceInfo> changed;
+    QList<DeviceHandle> connected;
+    QList<DeviceHandle> changed;
     QStringList disconnected;
     {
         QMutexLocker locker(&m_devicesMutex);
-        for (auto it = detected.constBegin(); it != detected.constEnd(); ++it) {
-            if (!m_devices.contains(it.key())) {
+        const std::shared_ptr<const DeviceSet> previous = devices();
+        for (auto it = detected->constBegin(); it != detected->constEnd(); ++it) {
+            const DeviceHandle known = previous->value(it.key());
+            if (!known) {
                 connected.append(it.value());
-            } else if (m_devices.value(it.key()).mountPoint != it.value().mountPoint
-                       || m_devices.value(it.key()).label != it.value().label) {
+            } else if (known->mountPoint != it.value()->mountPoint
+                       || known->label != it.value()->label) {
                 changed.append(it.value());
             }
         }
-        for (auto it = m_devices.constBegin(); it != m_devices.constEnd(); ++it) {
-            if (!detected.contains(it.key())) {
+        for (auto it = previous->constBegin(); it != previous->constEnd(); ++it) {
+            if (!detected->contains(it.key())) {
                 disconnected.append(it.key());
             }
         }
-        m_devices = detected;
+        publish(std::move(detected));
     }
-    for (const DeviceInfo& info : connected) {
-        emit deviceConnected(info);
+    for (const DeviceHandle& device : connected) {
+        emit deviceConnected(device);
     }
-    for (const DeviceInfo& info : changed) {
-        emit deviceChanged(info);
+    for (const DeviceHandle& device : changed) {
+        emit deviceChanged(device);
     }
     for (const QString& node : disconnected) {
         emit deviceDisconnected(node);
@@ -162,63 +187,58 @@ void DeviceMonitor::processUdevEvent(struct udev_device* /*dev*/)
 {
 }
 
-DeviceInfo DeviceMonitor::extractDeviceInfo(struct udev_device* /*dev*/)
-{
-    return {};
-}
-
-bool DeviceMonitor::isUsbStoragePartition(struct udev_device* /*dev*/)
-{
-    return false;
-}
-
-struct udev_device* DeviceMonitor::getUsbParent(struct udev_device* /*dev*/)
-{
-    return nullptr;
-}
-
-QString DeviceMonitor::getProperty(struct udev_device* /*dev*/, const char* /*key*/)
+void DeviceMonitor::replayEvent(const UdevRecord& /*event*/, double /*speed*/)
 {
-    return {};
-}
-
-QString DeviceMonitor::getSysAttr(struct udev_device* /*dev*/, const char* /*key*/)
-{
-    return {};
 }
 
 } // namespace FlashSpartan
 
 #else
 
+#include "MountTable.h"
+#include "PerfMetrics.h"
+#include "UdevEventTrace.h"
+#include "UdevReactor.h"
+#include "UdevText.h"
+
 #include <libudev.h>
-#include <poll.h>
-#include <unistd.h>
-#include <fcntl.h>
+#include <sys/sysmacros.h>
 
 #include <QDebug>
 #include <QMutexLocker>
-#include <QFile>
-#include <QIODevice>
+#include <QTimer>
+
+#include <algorithm>
+#include <charconv>
+#include <utility>
 
 namespace FlashSpartan {
 
+namespace {
+
+template <typename Device>
+QString propertyString(Device dev, const char* key)
+{
+    return UdevText::toString(UdevText::property(dev, key));
+}
+
+template <typename Device>
+QString sysAttrString(Device dev, const char* key)
+{
+    return UdevText::toString(UdevText::sysAttr(dev, key));
+}
+
+} // namespace
+
 DeviceMonitor::DeviceMonitor(QObject* parent)
     : QThread(parent)
+    , m_devices(std::make_shared<const DeviceSet>())
 {
-    // Create a pipe for thread-safe wakeup
-    if (pipe2(m_wakeupPipe, O_NONBLOCK | O_CLOEXEC) != 0) {
-        qWarning() << "DeviceMonitor: Failed to create wakeup pipe";
-        m_wakeupPipe[0] = m_wakeupPipe[1] = -1;
-    }
 }
 
 DeviceMonitor::~DeviceMonitor()
 {
     stopMonitoring();
-    
-    if (m_wakeupPipe[0] >= 0) close(m_wakeupPipe[0]);
-    if (m_wakeupPipe[1] >= 0) close(m_wakeupPipe[1]);
 }
 
 void DeviceMonitor::startMonitoring()
@@ -228,8 +248,17 @@ void DeviceMonitor::startMonitoring()
         return;
     }
     
+    if (!initializeUdev()) {
+        emit monitorError("Failed to initialize udev");
+        return;
+    }
     m_running.store(true);
-    start(QThread::NormalPriority);
+    
+    // Scan for existing devices first; events that arrive meanwhile wait behind it
+    UdevReactor::instance().post(m_subscription, [this]() {
+        scanExistingDevices();
+        emit initialScanComplete(static_cast<int>(devices()->size()));
+    });
 }
 
 void DeviceMonitor::stopMonitoring()
@@ -237,156 +266,78 @@ void DeviceMonitor::stopMonitoring()
     if (!m_running.load()) return;
     
     m_running.store(false);
-    
-    // Wake up the poll() call
-    if (m_wakeupPipe[1] >= 0) {
-        char c = 'x';
-        [[maybe_unused]] auto ret = write(m_wakeupPipe[1], &c, 1);
-    }
-    
-    if (!wait(5000)) {
-        qWarning() << "DeviceMonitor: thread did not stop within timeout";
-    }
+    cleanupUdev();
 }
 
 QList<DeviceInfo> DeviceMonitor::connectedDevices() const
 {
-    QMutexLocker locker(&m_devicesMutex);
-    return m_devices.values();
+    const std::shared_ptr<const DeviceSet> set = devices();
+    QList<DeviceInfo> out;
+    out.reserve(set->size());
+    for (const DeviceHandle& device : *set) {
+        out.append(*device);
+    }
+    return out;
+}
+
+std::shared_ptr<const DeviceMonitor::DeviceSet> DeviceMonitor::devices() const
+{
+    return std::atomic_load(&m_devices);
+}
+
+void DeviceMonitor::publish(std::shared_ptr<const DeviceSet> next)
+{
+    std::atomic_store(&m_devices, std::move(next));
 }
 
 std::optional<DeviceInfo> DeviceMonitor::getDevice(const QString& deviceNode) const
 {
-    QMutexLocker locker(&m_devicesMutex);
-    auto it = m_devices.find(deviceNode);
-    if (it != m_devices.end()) {
-        return *it;
+    if (const DeviceHandle device = devices()->value(deviceNode)) {
+        return *device;
     }
     return std::nullopt;
 }
 
 void DeviceMonitor::rescan()
 {
-    m_rescanRequested.store(true);
+    if (!m_running.load()) return;
     
-    // Wake up the poll() call
-    if (m_wakeupPipe[1] >= 0) {
-        char c = 'r';
-        [[maybe_unused]] auto ret = write(m_wakeupPipe[1], &c, 1);
-    }
+    UdevReactor::instance().post(m_subscription, [this]() { scanExistingDevices(); });
 }
 
 void DeviceMonitor::run()
 {
-    if (!initializeUdev()) {
-        emit monitorError("Failed to initialize udev");
-        return;
-    }
-    
-    // Scan for existing devices first
-    scanExistingDevices();
-    
-    int devCount;
-    {
-        QMutexLocker locker(&m_devicesMutex);
-        devCount = m_devices.size();
-    }
-    emit initialScanComplete(devCount);
-    
-    // Get monitor file descriptor
-    int udevFd = udev_monitor_get_fd(m_monitor);
-    if (udevFd < 0) {
-        emit monitorError("Failed to get udev monitor fd");
-        cleanupUdev();
-        return;
-    }
-    
-    // Main event loop
-    while (m_running.load()) {
-        // Handle rescan requests
-        if (m_rescanRequested.exchange(false)) {
-            scanExistingDevices();
-        }
-        
-        struct pollfd fds[2];
-        fds[0].fd = udevFd;
-        fds[0].events = POLLIN;
-        fds[0].revents = 0;
-        
-        fds[1].fd = m_wakeupPipe[0];
-        fds[1].events = POLLIN;
-        fds[1].revents = 0;
-        
-        int nfds = (m_wakeupPipe[0] >= 0) ? 2 : 1;
-        
-        int ret = poll(fds, nfds, POLL_TIMEOUT_MS);
-        
-        if (ret < 0) {
-            if (errno == EINTR) continue;
-            emit monitorError(QString("poll() failed: %1").arg(strerror(errno)));
-            break;
-        }
-        
-        // Drain wakeup pipe if signaled
-        if (nfds > 1 && (fds[1].revents & POLLIN)) {
-            char buf[16];
-            while (read(m_wakeupPipe[0], buf, sizeof(buf)) > 0) {}
-        }
-        
-        // Process udev events
-        if (fds[0].revents & POLLIN) {
-            struct udev_device* dev = udev_monitor_receive_device(m_monitor);
-            if (dev) {
-                processUdevEvent(dev);
-                udev_device_unref(dev);
-            }
-        }
-    }
-    
-    cleanupUdev();
+    // Unused on Linux: events are delivered on the shared UdevReactor thread.
 }
 
 bool DeviceMonitor::initializeUdev()
 {
-    m_udev = udev_new();
-    if (!m_udev) {
-        qCritical() << "DeviceMonitor: Failed to create udev context";
+    UdevReactor& reactor = UdevReactor::instance();
+    // With the shipped rule, only USB partitions (tagged by it) are delivered at all
+    const bool tagged = UdevReactor::rulesInstalled();
+    m_subscription = reactor.subscribe(
+        "block", "partition", [this](struct udev_device* dev) { processUdevEvent(dev); },
+        tagged ? UdevReactor::kPartitionTag : nullptr);
+    if (m_subscription < 0) {
+        qCritical() << "DeviceMonitor: Failed to subscribe to block partition events";
         return false;
     }
-    
-    m_monitor = udev_monitor_new_from_netlink(m_udev, "udev");
-    if (!m_monitor) {
-        qCritical() << "DeviceMonitor: Failed to create udev monitor";
-        udev_unref(m_udev);
-        m_udev = nullptr;
-        return false;
-    }
-    
-    // Filter for block device partitions
-    if (udev_monitor_filter_add_match_subsystem_devtype(m_monitor, "block", "partition") < 0) {
-        qWarning() << "DeviceMonitor: Failed to add subsystem filter";
-    }
-    
-    // Enable receiving
-    if (udev_monitor_enable_receiving(m_monitor) < 0) {
-        qCritical() << "DeviceMonitor: Failed to enable monitor receiving";
-        cleanupUdev();
-        return false;
-    }
-    
+    m_udev = reactor.context();
     return true;
 }
 
 void DeviceMonitor::cleanupUdev()
 {
-    if (m_monitor) {
-        udev_monitor_unref(m_monitor);
-        m_monitor = nullptr;
-    }
-    if (m_udev) {
-        udev_unref(m_udev);
-        m_udev = nullptr;
+    if (m_subscription >= 0) {
+        UdevReactor::instance().unsubscribe(m_subscription);
+        m_subscription = -1;
     }
+    m_udev = nullptr;
+    
+    // The reactor no longer runs our handlers, so the half-collected burst can go
+    m_pendingOrder.clear();
+    m_pendingEvents.clear();
+    m_flushScheduled = false;
 }
 
 void DeviceMonitor::scanExistingDevices()
@@ -400,203 +351,257 @@ void DeviceMonitor::scanExistingDevices()
     udev_enumerate_add_match_property(enumerate, "DEVTYPE", "partition");
     udev_enumerate_scan_devices(enumerate);
     
-    struct udev_list_entry* devices = udev_enumerate_get_list_entry(enumerate);
+    struct udev_list_entry* entries = udev_enumerate_get_list_entry(enumerate);
     struct udev_list_entry* entry;
     
-    QSet<QString> currentNodes;
+    QList<DeviceHandle> found;
     
-    udev_list_entry_foreach(entry, devices) {
+    udev_list_entry_foreach(entry, entries) {
         const char* path = udev_list_entry_get_name(entry);
         struct udev_device* dev = udev_device_new_from_syspath(m_udev, path);
         
         if (dev && isUsbStoragePartition(dev)) {
-            DeviceInfo info = extractDeviceInfo(dev);
-            currentNodes.insert(info.deviceNode);
-            
-            QMutexLocker locker(&m_devicesMutex);
-            if (!m_devices.contains(info.deviceNode)) {
-                m_devices.insert(info.deviceNode, info);
-                locker.unlock();
-                emit deviceConnected(info);
-            } else if (m_devices[info.deviceNode].isMounted != info.isMounted) {
-                m_devices[info.deviceNode] = info;
-                locker.unlock();
-                emit deviceChanged(info);
-            }
+            found.append(std::make_shared<const DeviceInfo>(extractDeviceInfo(dev)));
         }
         
         if (dev) udev_device_unref(dev);
     }
+    udev_enumerate_unref(enumerate);
     
-    // Check for removed devices
+    // Apply the whole scan as one new set; unchanged devices keep their handle
+    QList<DeviceHandle> connected;
+    QList<DeviceHandle> changed;
+    QStringList disconnected;
     {
         QMutexLocker locker(&m_devicesMutex);
-        QStringList toRemove;
-        for (const auto& node : m_devices.keys()) {
-            if (!currentNodes.contains(node)) {
-                toRemove.append(node);
+        const std::shared_ptr<const DeviceSet> previous = devices();
+        auto next = std::make_shared<DeviceSet>();
+        next->reserve(found.size());
+        for (const DeviceHandle& device : std::as_const(found)) {
+            const DeviceHandle known = previous->value(device->deviceNode);
+            if (!known) {
+                next->insert(device->deviceNode, device);
+                connected.append(device);
+            } else if (known->isMounted != device->isMounted) {
+                next->insert(device->deviceNode, device);
+                changed.append(device);
+            } else {
+                next->insert(device->deviceNode, known);
             }
         }
-        for (const auto& node : toRemove) {
-            m_devices.remove(node);
-            locker.unlock();
-            emit deviceDisconnected(node);
-            locker.relock();
+        for (auto it = previous->constBegin(); it != previous->constEnd(); ++it) {
+            if (!next->contains(it.key())) {
+                disconnected.append(it.key());
+            }
         }
+        publish(std::move(next));
     }
     
-    udev_enumerate_unref(enumerate);
+    for (const DeviceHandle& device : connected) {
+        emit deviceConnected(device);
+    }
+    for (const DeviceHandle& device : changed) {
+        emit deviceChanged(device);
+    }
+    for (const QString& node : disconnected) {
+        emit deviceDisconnected(node);
+    }
 }
 
 void DeviceMonitor::processUdevEvent(struct udev_device* dev)
 {
     if (!dev) return;
     
-    QString action = udev_device_get_action(dev);
-    QString devNode = udev_device_get_devnode(dev);
+    if (UdevEventTrace::recording()) {
+        UdevEventTrace::record("block", dev);
+    }
+    queueEvent(dev, nullptr, 1.0);
+}
+
+void DeviceMonitor::replayEvent(const UdevRecord& event, double speed)
+{
+    auto record = std::make_shared<const UdevRecord>(event);
+    queueEvent(record.get(), record, speed);
+}
+
+template <typename Device>
+void DeviceMonitor::queueEvent(Device dev, std::shared_ptr<const UdevRecord> replayed, double speed)
+{
+    const std::string_view node = UdevText::devNode(dev);
+    const std::string_view sysPath = UdevText::sysPath(dev);
+    if (node.empty() || sysPath.empty()) return;
     
-    if (devNode.isEmpty()) return;
+    // Coalesced per node: the flush only needs the last action of a burst
+    const QString devNode = UdevText::toString(node);
+    const bool first = !m_pendingEvents.contains(devNode);
+    if (first) {
+        m_pendingOrder.append(devNode);
+    }
+    PendingEvent& pending = m_pendingEvents[devNode];
+    if (first) {
+        pending.firstEventNs = PerfMetrics::nowNs();
+    }
+    pending.removed = UdevText::action(dev) == "remove";
+    pending.sysPath = QByteArray(sysPath.data(), qsizetype(sysPath.size()));
+    pending.replayed = std::move(replayed);
     
-    if (!isUsbStoragePartition(dev)) return;
+    if (m_flushScheduled) return;
+    m_flushScheduled = true;
+    if (pending.replayed) {
+        // Replay runs on the caller's event loop, on the replay's clock
+        const int delayMs = speed > 0 ? qRound(DEBOUNCE_MS / std::min(speed, UdevEventTrace::kMaxSpeed)) : 0;
+        QTimer::singleShot(delayMs, this, [this]() { flushPendingEvents(); });
+    } else {
+        UdevReactor::instance().post(m_subscription, [this]() { flushPendingEvents(); },
+                                     DEBOUNCE_MS);
+    }
+}
+
+void DeviceMonitor::flushPendingEvents()
+{
+    m_flushScheduled = false;
+    const QStringList order = std::exchange(m_pendingOrder, {});
+    const QHash<QString, PendingEvent> events = std::exchange(m_pendingEvents, {});
     
-    if (action == "add") {
-        DeviceInfo info = extractDeviceInfo(dev);
-        
-        {
-            QMutexLocker locker(&m_devicesMutex);
-            m_devices.insert(info.deviceNode, info);
+    // Read each device once, in its state after the burst; a null handle means it is gone
+    QList<std::pair<QString, DeviceHandle>> results;
+    results.reserve(order.size());
+    for (const QString& devNode : order) {
+        const PendingEvent& event = events.value(devNode);
+        const auto accept = [&](auto dev) {
+            if (isUsbStoragePartition(dev)) {
+                DeviceInfo info = extractDeviceInfo(dev);
+                info.udevEventNs = event.firstEventNs;
+                results.append({devNode, std::make_shared<const DeviceInfo>(std::move(info))});
+            }
+        };
+        if (event.replayed && !event.removed) {
+            accept(event.replayed.get());
+            continue;
         }
-        
-        emit deviceConnected(info);
-        
-    } else if (action == "remove") {
-        {
-            QMutexLocker locker(&m_devicesMutex);
-            m_devices.remove(devNode);
+        struct udev_device* dev =
+            event.removed ? nullptr : udev_device_new_from_syspath(m_udev, event.sysPath.constData());
+        if (!dev) {
+            results.append({devNode, nullptr});
+            continue;
         }
-        
-        emit deviceDisconnected(devNode);
-        
-    } else if (action == "change") {
-        DeviceInfo info = extractDeviceInfo(dev);
-        
-        {
-            QMutexLocker locker(&m_devicesMutex);
-            m_devices[info.deviceNode] = info;
+        accept(dev);
+        udev_device_unref(dev);
+    }
+    
+    // ...and publish the burst as one new set
+    QList<DeviceHandle> connected;
+    QList<DeviceHandle> changed;
+    QStringList disconnected;
+    {
+        QMutexLocker locker(&m_devicesMutex);
+        auto next = std::make_shared<DeviceSet>(*devices());
+        for (const auto& [devNode, device] : std::as_const(results)) {
+            if (!device) {
+                if (next->remove(devNode) > 0) {
+                    disconnected.append(devNode);
+                }
+                continue;
+            }
+            const bool known = next->contains(device->deviceNode);
+            next->insert(device->deviceNode, device);
+            (known ? changed : connected).append(device);
         }
-        
-        emit deviceChanged(info);
+        publish(std::move(next));
+    }
+    
+    for (const QString& devNode : disconnected) {
+        emit deviceDisconnected(devNode);
+    }
+    for (const DeviceHandle& device : connected) {
+        emit deviceConnected(device);
+    }
+    for (const DeviceHandle& device : changed) {
+        emit deviceChanged(device);
     }
 }
 
-DeviceInfo DeviceMonitor::extractDeviceInfo(struct udev_device* dev)
+template <typename Device>
+DeviceInfo DeviceMonitor::extractDeviceInfo(Device dev)
 {
     DeviceInfo info;
     
-    info.deviceNode = udev_device_get_devnode(dev);
+    info.deviceNode = UdevText::toString(UdevText::devNode(dev));
     
     // Get parent device node (the whole disk)
-    struct udev_device* parent = udev_device_get_parent_with_subsystem_devtype(dev, "block", "disk");
-    if (parent) {
-        info.parentDevice = udev_device_get_devnode(parent);
+    if (const auto parent = UdevText::parent(dev, "block", "disk")) {
+        info.parentDevice = UdevText::toString(UdevText::devNode(parent));
     }
     
     // Get USB parent for vendor/model info
-    struct udev_device* usb = getUsbParent(dev);
-    if (usb) {
-        info.vendor = getSysAttr(usb, "manufacturer");
+    if (const auto usb = UdevText::parent(dev, "usb", "usb_device")) {
+        info.vendor = sysAttrString(usb, "manufacturer");
         if (info.vendor.isEmpty()) {
-            info.vendor = getProperty(dev, "ID_VENDOR");
+            info.vendor = propertyString(dev, "ID_VENDOR");
         }
         
-        info.model = getSysAttr(usb, "product");
+        info.model = sysAttrString(usb, "product");
         if (info.model.isEmpty()) {
-            info.model = getProperty(dev, "ID_MODEL");
+            info.model = propertyString(dev, "ID_MODEL");
         }
         
-        info.serial = getSysAttr(usb, "serial");
+        info.serial = sysAttrString(usb, "serial");
         if (info.serial.isEmpty()) {
-            info.serial = getProperty(dev, "ID_SERIAL_SHORT");
+            info.serial = propertyString(dev, "ID_SERIAL_SHORT");
         }
+
+        info.usbBus = sysAttrString(usb, "busnum");
+        info.usbPortPath = UdevText::toString(UdevText::sysName(usb));
     }
     
     // Filesystem info
-    info.fsType = getProperty(dev, "ID_FS_TYPE");
-    info.label = getProperty(dev, "ID_FS_LABEL");
+    info.fsType = propertyString(dev, "ID_FS_TYPE");
+    info.label = propertyString(dev, "ID_FS_LABEL");
     
-    // Size (from sysfs)
-    QString sizeStr = getSysAttr(dev, "size");
-    if (!sizeStr.isEmpty()) {
-        // Size is in 512-byte sectors
-        info.sizeBytes = sizeStr.toULongLong() * 512;
+    // Size (from sysfs), in 512-byte sectors
+    const std::string_view sectors = UdevText::sysAttr(dev, "size");
+    uint64_t sectorCount = 0;
+    if (std::from_chars(sectors.data(), sectors.data() + sectors.size(), sectorCount).ec == std::errc()) {
+        info.sizeBytes = sectorCount * 512;
     }
     
-    // Mount status - check /proc/mounts
-    QFile mounts("/proc/mounts");
-    if (mounts.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QByteArray data = mounts.readAll();
-        QString devNodeSearch = info.deviceNode + " ";
-        
-        for (const auto& line : data.split('\n')) {
-            if (line.startsWith(info.deviceNode.toUtf8() + " ")) {
-                info.isMounted = true;
-                QList<QByteArray> parts = line.split(' ');
-                if (parts.size() >= 2) {
-                    info.mountPoint = QString::fromUtf8(parts[1]);
-                    // Unescape mount point (handles spaces, etc.)
-                    info.mountPoint.replace("\\040", " ");
-                    info.mountPoint.replace("\\011", "\t");
-                }
-                break;
-            }
-        }
+    // Mount status - shared mount table, re-read only after the kernel reports a change
+    const dev_t devnum = static_cast<dev_t>(UdevText::devnum(dev));
+    const auto mounts = MountTable::current();
+    if (const MountEntry* mount = mounts->find(info.deviceNode, major(devnum), minor(devnum))) {
+        info.isMounted = true;
+        info.mountPoint = mount->mountPoint;
     }
     
-    info.isRemovable = (getProperty(dev, "ID_BUS") == "usb");
+    info.isRemovable = UdevText::property(dev, "ID_BUS") == "usb";
     
     return info;
 }
 
-bool DeviceMonitor::isUsbStoragePartition(struct udev_device* dev)
+template <typename Device>
+bool DeviceMonitor::isUsbStoragePartition(Device dev)
 {
+    // Compared on libudev's strings: loop, dm and NVMe partitions never become QStrings
+    
     // Must be a partition
-    QString devType = udev_device_get_devtype(dev);
-    if (devType != "partition") return false;
+    if (UdevText::devType(dev) != "partition") return false;
     
     // Check if it's a USB device
-    QString bus = getProperty(dev, "ID_BUS");
-    if (bus != "usb") return false;
+    if (UdevText::property(dev, "ID_BUS") != "usb") return false;
     
     // Additional check: must have a USB parent
-    struct udev_device* usb = getUsbParent(dev);
+    const auto usb = UdevText::parent(dev, "usb", "usb_device");
     if (!usb) return false;
     
     // Check it's a storage device (not a USB hub, etc.)
-    QString usbDriver = getSysAttr(usb, "bDeviceClass");
+    const std::string_view deviceClass = UdevText::sysAttr(usb, "bDeviceClass");
     // Class 0 means defined at interface level, which is typical for storage
     // Class 8 is mass storage
     // We'll also accept if ID_USB_DRIVER is usb-storage
-    QString driver = getProperty(dev, "ID_USB_DRIVER");
+    const std::string_view driver = UdevText::property(dev, "ID_USB_DRIVER");
     
     return (driver == "usb-storage" || driver == "uas" || 
-            usbDriver == "00" || usbDriver == "08" || usbDriver.isEmpty());
-}
-
-struct udev_device* DeviceMonitor::getUsbParent(struct udev_device* dev)
-{
-    return udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_device");
-}
-
-QString DeviceMonitor::getProperty(struct udev_device* dev, const char* key)
-{
-    const char* value = udev_device_get_property_value(dev, key);
-    return value ? QString::fromUtf8(value) : QString();
-}
-
-QString DeviceMonitor::getSysAttr(struct udev_device* dev, const char* key)
-{
-    const char* value = udev_device_get_sysattr_value(dev, key);
-    return value ? QString::fromUtf8(value).trimmed() : QString();
+            deviceClass == "00" || deviceClass == "08" || deviceClass.empty());
 }
 
 } // namespace FlashSpartan
@@ -1,23 +1,41 @@
 #include "DeviceTimelineLog.h"
 
 #include "AppPaths.h"
+#include "StoreCompression.h"
 
 #include <QDir>
-#include <QFile>
+#include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QStandardPaths>
+#include <QPair>
+#include <QSaveFile>
 #include <QUuid>
+#include <QtConcurrent>
+
+#include <algorithm>
 
 namespace FlashSpartan {
 
 namespace {
 
-QString timelineFilePath()
+constexpr qint64 kSegmentMs = qint64(DeviceTimelineLog::kSegmentDays) * 24 * 60 * 60 * 1000;
+
+QString defaultDirectory()
 {
-    const QString dir = AppPaths::configDir();
-    return dir + QStringLiteral("/device-timeline.json");
+    return AppPaths::configDir() + QStringLiteral("/device-timeline");
+}
+
+/** The single-file format this replaced, beside the segment directory. */
+QString legacyFilePath(const QString& dir)
+{
+    return QFileInfo(dir).absolutePath() + QStringLiteral("/device-timeline.json");
+}
+
+/** Zero-padded, so name order is time order. */
+QString segmentName(qint64 startMs)
+{
+    return QStringLiteral("%1.jsonl").arg(startMs, 13, 10, QLatin1Char('0'));
 }
 
 QJsonObject entryToJson(const UiEventEntry& e)
@@ -51,6 +69,78 @@ UiEventEntry entryFromJson(const QJsonObject& o)
     return e;
 }
 
+QByteArray entryLine(const UiEventEntry& e)
+{
+    return QJsonDocument(entryToJson(e)).toJson(QJsonDocument::Compact) + '\n';
+}
+
+bool isCompressed(const QString& path)
+{
+    return path.endsWith(QLatin1String(".zst"));
+}
+
+/** Where a closed segment is kept: compressed, when the build has zstd. */
+QString closedPath(const QString& path)
+{
+    return StoreCompression::available() && !isCompressed(path) ? path + QStringLiteral(".zst") : path;
+}
+
+/** Calls @p take with each complete line of a segment; a compressed one is inflated as it goes. */
+template <typename Take>
+void forEachLine(const QString& path, Take take)
+{
+    QByteArray line;
+    if (isCompressed(path)) {
+        StoreCompression::LineReader reader(path);
+        if (reader.open()) {
+            while (reader.readLine(&line) && line.endsWith('\n')) {
+                take(line);
+            }
+        }
+        return;
+    }
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    while (!f.atEnd()) {
+        line = f.readLine();
+        if (!line.endsWith('\n')) {
+            break;  // torn by a crash mid-append
+        }
+        take(line);
+    }
+}
+
+QList<UiEventEntry> readSegment(const QString& path)
+{
+    QList<UiEventEntry> out;
+    forEachLine(path, [&out](const QByteArray& line) {
+        const QJsonDocument doc = QJsonDocument::fromJson(line);
+        if (doc.isObject()) {
+            out.append(entryFromJson(doc.object()));
+        }
+    });
+    return out;
+}
+
+QByteArray segmentLines(const QString& path)
+{
+    QByteArray lines;
+    forEachLine(path, [&lines](const QByteArray& line) { lines += line; });
+    return lines;
+}
+
+bool writeSegment(const QString& path, const QByteArray& lines)
+{
+    const QByteArray bytes = isCompressed(path) ? StoreCompression::compressFile(lines) : lines;
+    if (bytes.isEmpty() && !lines.isEmpty()) {
+        return false;
+    }
+    QSaveFile out(path);
+    return out.open(QIODevice::WriteOnly) && out.write(bytes) == bytes.size() && out.commit();
+}
+
 } // namespace
 
 DeviceTimelineLog& DeviceTimelineLog::instance()
@@ -59,41 +149,92 @@ DeviceTimelineLog& DeviceTimelineLog::instance()
     return inst;
 }
 
-void DeviceTimelineLog::load()
+DeviceTimelineLog::~DeviceTimelineLog()
+{
+    waitForCompaction();
+}
+
+void DeviceTimelineLog::waitForCompaction()
+{
+    m_compaction.waitForFinished();
+}
+
+void DeviceTimelineLog::load(const QString& dir)
 {
+    waitForCompaction();
+    m_open.close();
     m_entries.clear();
-    QFile f(timelineFilePath());
-    if (!f.open(QIODevice::ReadOnly)) {
-        return;
+    m_byDevice.clear();
+    m_firstSeq = 0;
+    m_segments.clear();
+    m_dir = dir.isEmpty() ? defaultDirectory() : dir;
+    QDir().mkpath(m_dir);
+
+    QStringList names = QDir(m_dir).entryList({QStringLiteral("*.jsonl"), QStringLiteral("*.jsonl.zst")},
+                                              QDir::Files, QDir::Name);
+    for (qsizetype i = 0; i + 1 < names.size(); ++i) {
+        if (names.at(i + 1) == names.at(i) + QStringLiteral(".zst")) {
+            // Compressed and committed, but the raw file was not removed yet.
+            QFile::remove(m_dir + QLatin1Char('/') + names.takeAt(i));
+        }
     }
-    const QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
-    if (!doc.isObject()) {
-        return;
+    const QString legacy = legacyFilePath(m_dir);
+    if (names.isEmpty() && QFile::exists(legacy)) {
+        QFile f(legacy);
+        if (f.open(QIODevice::ReadOnly)) {
+            const QJsonArray arr =
+                QJsonDocument::fromJson(f.readAll()).object()[QStringLiteral("entries")].toArray();
+            QList<UiEventEntry> entries;
+            for (auto it = arr.crbegin(); it != arr.crend(); ++it) {  // stored newest first
+                if (it->isObject()) {
+                    entries.append(entryFromJson(it->toObject()));
+                }
+            }
+            bool written = true;
+            for (qsizetype i = 0; i < entries.size() && written; i += kSegmentEntries) {
+                const QString name = segmentName(entries.at(i).time.toMSecsSinceEpoch() + i);
+                QSaveFile out(m_dir + QLatin1Char('/') + name);
+                QByteArray bytes;
+                for (qsizetype k = i; k < std::min(entries.size(), i + kSegmentEntries); ++k) {
+                    bytes += entryLine(entries.at(k));
+                }
+                written = out.open(QIODevice::WriteOnly) && out.write(bytes) == bytes.size()
+                          && out.commit();
+                names.append(name);
+            }
+            f.close();
+            if (written) {
+                QFile::rename(legacy, legacy + QStringLiteral(".migrated"));
+            }
+        }
     }
-    const QJsonArray arr = doc.object()[QStringLiteral("entries")].toArray();
-    for (const QJsonValue& v : arr) {
-        if (v.isObject()) {
-            m_entries.append(entryFromJson(v.toObject()));
+
+    for (const QString& name : names) {
+        Segment seg;
+        seg.path = m_dir + QLatin1Char('/') + name;
+        seg.startMs = QStringView(name).left(name.indexOf(QLatin1Char('.'))).toLongLong();
+        const QList<UiEventEntry> entries = readSegment(seg.path);
+        seg.count = static_cast<int>(entries.size());
+        for (const UiEventEntry& e : entries) {
+            index(e);
         }
+        m_segments.append(seg);
     }
+    if (!m_segments.isEmpty()) {
+        const Segment& last = m_segments.constLast();
+        if (last.count < kSegmentEntries && !isCompressed(last.path)
+            && QDateTime::currentMSecsSinceEpoch() - last.startMs < kSegmentMs) {
+            m_open.setFileName(last.path);
+            m_open.open(QIODevice::WriteOnly | QIODevice::Append);
+        }
+    }
+    dropOldSegments();
+    startCompaction();
 }
 
 void DeviceTimelineLog::save()
 {
-    const QString path = timelineFilePath();
-    QDir().mkpath(QFileInfo(path).absolutePath());
-
-    QJsonArray arr;
-    for (const UiEventEntry& e : m_entries) {
-        arr.append(entryToJson(e));
-    }
-    QJsonObject root;
-    root[QStringLiteral("entries")] = arr;
-    QFile f(path);
-    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-        return;
-    }
-    f.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    m_open.flush();
 }
 
 void DeviceTimelineLog::append(const UiEventEntry& entry)
@@ -105,11 +246,131 @@ void DeviceTimelineLog::append(const UiEventEntry& entry)
     if (!e.time.isValid()) {
         e.time = QDateTime::currentDateTime();
     }
-    m_entries.prepend(e);
-    while (m_entries.size() > kMaxTotalEntries) {
-        m_entries.removeLast();
+    if (m_dir.isEmpty()) {
+        m_dir = defaultDirectory();
     }
-    save();
+
+    bool rolled = false;
+    {
+        QMutexLocker lock(&m_segmentsMutex);
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+        if (!m_open.isOpen() || m_segments.constLast().count >= kSegmentEntries
+            || now - m_segments.constLast().startMs >= kSegmentMs) {
+            rolled = !m_segments.isEmpty();
+            openSegment(now);
+        }
+        const QByteArray line = entryLine(e);
+        if (m_open.isOpen() && m_open.write(line) == line.size() && m_open.flush()) {
+            ++m_segments.last().count;
+        }
+    }
+    index(std::move(e));
+    dropOldSegments();
+    if (rolled) {
+        startCompaction();
+    }
+}
+
+void DeviceTimelineLog::index(UiEventEntry entry)
+{
+    const qint64 seq = m_firstSeq + m_entries.size();
+    if (!entry.deviceNode.isEmpty()) {
+        m_byDevice[entry.deviceNode].append(seq);
+    }
+    m_entries.append(std::move(entry));
+}
+
+bool DeviceTimelineLog::openSegment(qint64 startMs)
+{
+    m_open.close();
+    QDir().mkpath(m_dir);
+    QString path = m_dir + QLatin1Char('/') + segmentName(startMs);
+    while (QFile::exists(path)) {
+        path = m_dir + QLatin1Char('/') + segmentName(++startMs);
+    }
+    m_open.setFileName(path);
+    if (!m_open.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return false;
+    }
+    m_segments.append({path, startMs, 0});
+    return true;
+}
+
+void DeviceTimelineLog::dropOldSegments()
+{
+    qsizetype dropped = 0;
+    {
+        QMutexLocker lock(&m_segmentsMutex);
+        while (m_segments.size() > 1
+               && m_entries.size() - dropped - m_segments.constFirst().count >= kMaxTotalEntries) {
+            dropped += m_segments.constFirst().count;
+            QFile::remove(m_segments.constFirst().path);
+            m_segments.removeFirst();
+        }
+    }
+    if (dropped == 0) {
+        return;
+    }
+    dropped = std::min(dropped, m_entries.size());
+    m_entries.remove(0, dropped);
+    m_firstSeq += dropped;
+    for (auto it = m_byDevice.begin(); it != m_byDevice.end();) {
+        QList<qint64>& seqs = it.value();
+        const auto keep = std::lower_bound(seqs.begin(), seqs.end(), m_firstSeq);
+        seqs.erase(seqs.begin(), keep);
+        it = seqs.isEmpty() ? m_byDevice.erase(it) : std::next(it);
+    }
+}
+
+void DeviceTimelineLog::startCompaction()
+{
+    if (m_compaction.isRunning()) {
+        return;
+    }
+    m_compaction = QtConcurrent::run([this]() {
+        QMutexLocker lock(&m_segmentsMutex);
+        // Closed segments only: the last one is open for appends.
+        for (qsizetype i = 0; i + 2 < m_segments.size(); ++i) {
+            qsizetype end = i + 1;
+            int total = m_segments.at(i).count;
+            while (end + 1 < m_segments.size()
+                   && total + m_segments.at(end).count <= kSegmentEntries) {
+                total += m_segments.at(end).count;
+                ++end;
+            }
+            if (end == i + 1) {
+                continue;
+            }
+            QByteArray merged;
+            for (qsizetype k = i; k < end; ++k) {
+                merged += segmentLines(m_segments.at(k).path);  // a torn line stays behind
+            }
+            const QString path = closedPath(m_segments.at(i).path);
+            if (!writeSegment(path, merged)) {
+                return;
+            }
+            for (qsizetype k = i; k < end; ++k) {
+                if (m_segments.at(k).path != path) {
+                    QFile::remove(m_segments.at(k).path);
+                }
+            }
+            m_segments[i].path = path;
+            m_segments[i].count = total;
+            m_segments.remove(i + 1, end - i - 1);
+        }
+        // Closed segments are read once per start, streaming; JSON lines shrink several-fold.
+        for (qsizetype i = 0; i + 1 < m_segments.size(); ++i) {
+            const QString path = closedPath(m_segments.at(i).path);
+            if (path == m_segments.at(i).path) {
+                continue;
+            }
+            if (!writeSegment(path, segmentLines(m_segments.at(i).path))) {
+                return;
+            }
+            QFile::remove(m_segments.at(i).path);
+            m_segments[i].path = path;
+        }
+    });
 }
 
 QList<UiEventEntry> DeviceTimelineLog::entriesForDevice(const QString& deviceNode,
@@ -120,16 +381,25 @@ QList<UiEventEntry> DeviceTimelineLog::entriesForDevice(const QString& deviceNod
     const QDateTime cutoff = retentionDays > 0
                                  ? QDateTime::currentDateTime().addDays(-retentionDays)
                                  : QDateTime();
-
-    for (const UiEventEntry& e : m_entries) {
-        if (!deviceNode.isEmpty() && e.deviceNode != deviceNode) {
-            continue;
-        }
+    const auto take = [&](const UiEventEntry& e) {
         if (retentionDays > 0 && e.time < cutoff) {
-            continue;
+            return true;
         }
         out.append(e);
-        if (maxEntries > 0 && out.size() >= maxEntries) {
+        return maxEntries <= 0 || out.size() < maxEntries;
+    };
+
+    if (deviceNode.isEmpty()) {
+        for (auto it = m_entries.crbegin(); it != m_entries.crend(); ++it) {
+            if (!take(*it)) {
+                break;
+            }
+        }
+        return out;
+    }
+    const QList<qint64> seqs = m_byDevice.value(deviceNode);
+    for (auto it = seqs.crbegin(); it != seqs.crend(); ++it) {
+        if (!take(m_entries.at(*it - m_firstSeq))) {
             break;
         }
     }
@@ -138,11 +408,16 @@ QList<UiEventEntry> DeviceTimelineLog::entriesForDevice(const QString& deviceNod
 
 QStringList DeviceTimelineLog::knownDeviceNodes() const
 {
+    QList<QPair<qint64, QString>> latest;
+    latest.reserve(m_byDevice.size());
+    for (auto it = m_byDevice.cbegin(); it != m_byDevice.cend(); ++it) {
+        latest.append({it.value().constLast(), it.key()});
+    }
+    std::sort(latest.begin(), latest.end(),
+              [](const auto& a, const auto& b) { return a.first > b.first; });
     QStringList nodes;
-    for (const UiEventEntry& e : m_entries) {
-        if (!e.deviceNode.isEmpty() && !nodes.contains(e.deviceNode)) {
-            nodes.append(e.deviceNode);
-        }
+    for (const auto& [seq, node] : latest) {
+        nodes.append(node);
     }
     return nodes;
 }
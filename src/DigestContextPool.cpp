@@ -0,0 +1,157 @@
+#include "DigestContextPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace FlashSpartan::DigestContextPool {
+
+namespace {
+
+// A thread rarely holds more than one or two contexts at once (e.g. file + Merkle leaf).
+constexpr std::size_t kMaxPooledPerThread = 4;
+
+const EVP_MD* fetchOnce(const char* name, const EVP_MD* builtin)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    // Deliberately never freed: it lives as long as the process and OpenSSL's own cleanup.
+    if (EVP_MD* md = EVP_MD_fetch(nullptr, name, nullptr)) {
+        return md;
+    }
+#else
+    (void)name;
+#endif
+    return builtin;
+}
+
+struct ThreadPool {
+    std::vector<EVP_MD_CTX*> free;
+
+    ~ThreadPool()
+    {
+        for (EVP_MD_CTX* ctx : free) {
+            EVP_MD_CTX_free(ctx);
+        }
+    }
+};
+
+ThreadPool& threadPool()
+{
+    thread_local ThreadPool pool;
+    return pool;
+}
+
+bool digestSlice(const EVP_MD* md, const Message* messages, std::size_t count, unsigned char* out,
+                 std::size_t digestSize)
+{
+    Context ctx;
+    if (!ctx) {
+        return false;
+    }
+    unsigned int len = 0;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (EVP_DigestInit_ex(ctx.get(), md, nullptr) != 1
+            || EVP_DigestUpdate(ctx.get(), messages[i].data, messages[i].size) != 1
+            || EVP_DigestFinal_ex(ctx.get(), out + i * digestSize, &len) != 1) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+const EVP_MD* sha256()
+{
+    static const EVP_MD* md = fetchOnce("SHA2-256", EVP_sha256());
+    return md;
+}
+
+const EVP_MD* sha512()
+{
+    static const EVP_MD* md = fetchOnce("SHA2-512", EVP_sha512());
+    return md;
+}
+
+const EVP_MD* blake2b512()
+{
+    static const EVP_MD* md = fetchOnce("BLAKE2B-512", EVP_blake2b512());
+    return md;
+}
+
+Context::Context()
+{
+    ThreadPool& pool = threadPool();
+    if (!pool.free.empty()) {
+        m_ctx = pool.free.back();
+        pool.free.pop_back();
+    } else {
+        m_ctx = EVP_MD_CTX_new();
+    }
+}
+
+Context::~Context()
+{
+    if (!m_ctx) {
+        return;
+    }
+    ThreadPool& pool = threadPool();
+    if (pool.free.size() < kMaxPooledPerThread) {
+        // Not reset: the next EVP_DigestInit_ex reinitialises it and, for the same
+        // digest, can keep the provider context.
+        pool.free.push_back(m_ctx);
+    } else {
+        EVP_MD_CTX_free(m_ctx);
+    }
+}
+
+bool digest(const EVP_MD* md, const void* data, std::size_t size, unsigned char* out,
+            unsigned int* outLen)
+{
+    Context ctx;
+    return ctx && md && EVP_DigestInit_ex(ctx.get(), md, nullptr) == 1
+        && EVP_DigestUpdate(ctx.get(), data, size) == 1
+        && EVP_DigestFinal_ex(ctx.get(), out, outLen) == 1;
+}
+
+bool digestBatch(const EVP_MD* md, const Message* messages, std::size_t count, unsigned char* out)
+{
+    if (!md) {
+        return false;
+    }
+    if (count == 0) {
+        return true;
+    }
+    const int mdSize = EVP_MD_size(md);
+    if (mdSize <= 0) {
+        return false;
+    }
+    const std::size_t digestSize = static_cast<std::size_t>(mdSize);
+
+    const std::size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t threads = std::min({hardware, static_cast<std::size_t>(kMaxBatchThreads),
+                                          count / kMinMessagesPerThread});
+    if (threads <= 1) {
+        return digestSlice(md, messages, count, out, digestSize);
+    }
+
+    const std::size_t perThread = (count + threads - 1) / threads;
+    std::atomic<bool> ok{true};
+    std::vector<std::thread> pool;
+    pool.reserve(threads);
+    for (std::size_t begin = 0; begin < count; begin += perThread) {
+        const std::size_t n = std::min(perThread, count - begin);
+        pool.emplace_back([&, begin, n]() {
+            if (!digestSlice(md, messages + begin, n, out + begin * digestSize, digestSize)) {
+                ok.store(false);
+            }
+        });
+    }
+    for (std::thread& t : pool) {
+        t.join();
+    }
+    return ok.load();
+}
+
+} // namespace FlashSpartan::DigestContextPool
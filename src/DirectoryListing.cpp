@@ -0,0 +1,95 @@
+#include "DirectoryListing.h"
+
+#include <QDir>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+
+#include <string>
+#include <vector>
+#endif
+
+namespace FlashSpartan::DirectoryListing {
+
+namespace {
+
+#ifdef Q_OS_WIN
+
+constexpr DWORD kBatchBytes = 64 * 1024;
+
+/** FILETIME ticks (100 ns since 1601) to ms since 1970, truncated as QFileInfo does. */
+qint64 toUnixMs(const LARGE_INTEGER& ticks)
+{
+    constexpr qint64 kEpochTicks = 116444736000000000LL;
+    return ticks.QuadPart <= kEpochTicks ? 0 : (ticks.QuadPart - kEpochTicks) / 10000;
+}
+
+Entry::Kind kindOf(const FILE_ID_BOTH_DIR_INFO& info)
+{
+    const DWORD attributes = info.FileAttributes;
+    // For a reparse point the directory entry carries the reparse tag in EaSize.
+    if ((attributes & FILE_ATTRIBUTE_REPARSE_POINT)
+        && (info.EaSize == IO_REPARSE_TAG_SYMLINK || info.EaSize == IO_REPARSE_TAG_MOUNT_POINT)) {
+        return Entry::Kind::Link;
+    }
+    if (attributes & FILE_ATTRIBUTE_DIRECTORY) {
+        return Entry::Kind::Directory;
+    }
+    return (attributes & FILE_ATTRIBUTE_DEVICE) ? Entry::Kind::Other : Entry::Kind::File;
+}
+
+#endif
+
+} // namespace
+
+bool list(const QString& dir, QVector<Entry>* out)
+{
+#ifdef Q_OS_WIN
+    const std::wstring native = QDir::toNativeSeparators(dir).toStdWString();
+    HANDLE handle = CreateFileW(native.c_str(), FILE_LIST_DIRECTORY,
+                                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    // LONGLONG elements keep the records 8-byte aligned, as their LARGE_INTEGER fields need.
+    std::vector<LONGLONG> buffer(kBatchBytes / sizeof(LONGLONG));
+    FILE_INFO_BY_HANDLE_CLASS infoClass = FileIdBothDirectoryRestartInfo;
+    bool ok = true;
+    for (;;) {
+        if (!GetFileInformationByHandleEx(handle, infoClass, buffer.data(), kBatchBytes)) {
+            ok = GetLastError() == ERROR_NO_MORE_FILES;
+            break;
+        }
+        infoClass = FileIdBothDirectoryInfo;
+        const auto* bytes = reinterpret_cast<const unsigned char*>(buffer.data());
+        for (DWORD offset = 0;;) {
+            const auto& info = *reinterpret_cast<const FILE_ID_BOTH_DIR_INFO*>(bytes + offset);
+            const QString name = QString::fromWCharArray(info.FileName,
+                                                         static_cast<qsizetype>(info.FileNameLength / sizeof(WCHAR)));
+            if (name != QLatin1String(".") && name != QLatin1String("..")) {
+                Entry entry;
+                entry.name = name;
+                entry.kind = kindOf(info);
+                entry.hidden = (info.FileAttributes & FILE_ATTRIBUTE_HIDDEN) != 0;
+                entry.size = static_cast<uint64_t>(info.EndOfFile.QuadPart);
+                entry.modifiedMs = toUnixMs(info.LastWriteTime);
+                entry.fileId = static_cast<uint64_t>(info.FileId.QuadPart);
+                out->append(entry);
+            }
+            if (info.NextEntryOffset == 0) {
+                break;
+            }
+            offset += info.NextEntryOffset;
+        }
+    }
+    CloseHandle(handle);
+    return ok;
+#else
+    Q_UNUSED(dir);
+    Q_UNUSED(out);
+    return false;
+#endif
+}
+
+} // namespace FlashSpartan::DirectoryListing
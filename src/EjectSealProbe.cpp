@@ -0,0 +1,158 @@
+#include "EjectSealProbe.h"
+#include "HexEncoding.h"
+#include "RawDeviceHash.h"
+
+#include <QCryptographicHash>
+#include <QtEndian>
+
+#include <cstdlib>
+#include <memory>
+
+#ifdef Q_OS_WIN
+#include <malloc.h>
+#endif
+
+namespace FlashSpartan::EjectSealProbe {
+
+namespace {
+
+/** A sector-aligned buffer, so readers may use O_DIRECT. */
+struct AlignedFree {
+    void operator()(char* p) const
+    {
+#ifdef Q_OS_WIN
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+};
+using AlignedBuffer = std::unique_ptr<char, AlignedFree>;
+
+AlignedBuffer allocAligned(size_t bytes)
+{
+#ifdef Q_OS_WIN
+    return AlignedBuffer(static_cast<char*>(_aligned_malloc(bytes, kSectorBytes)));
+#else
+    void* p = nullptr;
+    return AlignedBuffer(posix_memalign(&p, kSectorBytes, bytes) == 0 ? static_cast<char*>(p) : nullptr);
+#endif
+}
+
+} // namespace
+
+std::vector<uint64_t> sampleOffsets(uint64_t volumeBytes)
+{
+    std::vector<uint64_t> offsets;
+    if (volumeBytes < kSampleBytes) {
+        return offsets;
+    }
+    const uint64_t span = (volumeBytes - kSampleBytes) / kSectorBytes;
+    for (int i = 0; i < kSamples; ++i) {
+        const uint64_t at = span * static_cast<uint64_t>(i) / (kSamples - 1) * kSectorBytes;
+        if (offsets.empty() || at > offsets.back()) {
+            offsets.push_back(at);
+        }
+    }
+    return offsets;
+}
+
+EjectSeal capture(const ReadAt& volume, uint64_t volumeBytes, const ReadAt& disk)
+{
+    const std::vector<uint64_t> offsets = sampleOffsets(volumeBytes);
+    AlignedBuffer buffer = allocAligned(kSampleBytes);
+    LayoutProbe::VolumeHead head;
+    const LayoutFingerprint layout =
+        offsets.empty() ? LayoutFingerprint() : LayoutProbe::capture(volume, volumeBytes, disk, &head);
+    if (!buffer || layout.isEmpty()) {
+        return {};
+    }
+    EjectSeal seal;
+    seal.partitionTableSha256 = layout.partitionTableSha256;
+    seal.fsType = layout.fsType;
+    seal.volumeSerial = layout.volumeSerial;
+    seal.volumeDirty = head.volumeDirty;
+    seal.writeCounter = head.writeCounter;
+    seal.mountCount = head.mountCount;
+    seal.lastWriteTime = head.lastWriteTime;
+
+    // The size and every window's offset go into the digest, so a shifted or resized volume
+    // with the same bytes in different places does not match.
+    QCryptographicHash sample(QCryptographicHash::Sha256);
+    const quint64 sizeLe = qToLittleEndian<quint64>(volumeBytes);
+    sample.addData(QByteArrayView(reinterpret_cast<const char*>(&sizeLe), sizeof(sizeLe)));
+    for (uint64_t offset : offsets) {
+        if (!volume(offset, buffer.get(), kSampleBytes)) {
+            return {};
+        }
+        const quint64 offsetLe = qToLittleEndian<quint64>(offset);
+        sample.addData(QByteArrayView(reinterpret_cast<const char*>(&offsetLe), sizeof(offsetLe)));
+        sample.addData(QByteArrayView(buffer.get(), kSampleBytes));
+    }
+    seal.sampleSha256 = HexEncoding::toString(sample.result());
+    seal.volumeBytes = volumeBytes;
+    seal.sealedAt = QDateTime::currentDateTimeUtc();
+    return seal;
+}
+
+EjectSeal captureDevice(const QString& volumeNode, const QString& diskNode)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(volumeNode);
+    Q_UNUSED(diskNode);
+    return {};
+#else
+    const int volumeFd = RawDeviceHash::openDevice(volumeNode);
+    if (volumeFd < 0) {
+        return {};
+    }
+    EjectSeal seal;
+    const uint64_t volumeBytes = RawDeviceHash::deviceSize(volumeFd, volumeNode);
+    const LayoutProbe::ReadAt volume = LayoutProbe::descriptorReader(volumeFd);
+    if (diskNode.isEmpty() || diskNode == volumeNode) {
+        seal = capture(volume, volumeBytes, {});
+    } else if (const int diskFd = RawDeviceHash::openDevice(diskNode); diskFd >= 0) {
+        seal = capture(volume, volumeBytes, LayoutProbe::descriptorReader(diskFd));
+        RawDeviceHash::closeDevice(diskFd);
+    }
+    RawDeviceHash::closeDevice(volumeFd);
+    return seal;
+#endif
+}
+
+LayoutFingerprint layoutOf(const EjectSeal& seal)
+{
+    LayoutFingerprint layout;
+    layout.partitionTableSha256 = seal.partitionTableSha256;
+    layout.fsType = seal.fsType;
+    layout.volumeSerial = seal.volumeSerial;
+    layout.volumeBytes = seal.volumeBytes;
+    layout.takenAt = seal.sealedAt;
+    return layout;
+}
+
+QString mismatch(const EjectSeal& sealed, const EjectSeal& now)
+{
+    if (sealed.isEmpty()) {
+        return QStringLiteral("no seal from the last eject");
+    }
+    if (now.isEmpty()) {
+        return QStringLiteral("the device could not be read");
+    }
+    if (const QString layout = LayoutProbe::mismatch(layoutOf(sealed), layoutOf(now)); !layout.isEmpty()) {
+        return layout;
+    }
+    if (now.volumeDirty) {
+        return QStringLiteral("volume is marked dirty");
+    }
+    if (now.mountCount != sealed.mountCount || now.lastWriteTime != sealed.lastWriteTime
+        || now.writeCounter != sealed.writeCounter) {
+        return QStringLiteral("file system was mounted or written elsewhere");
+    }
+    if (now.sampleSha256 != sealed.sampleSha256) {
+        return QStringLiteral("sampled content changed");
+    }
+    return {};
+}
+
+} // namespace FlashSpartan::EjectSealProbe
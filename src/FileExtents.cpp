@@ -0,0 +1,149 @@
+#include "FileExtents.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStorageInfo>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <winioctl.h>
+#endif
+
+namespace FlashSpartan::FileExtents {
+
+namespace {
+
+#ifdef Q_OS_LINUX
+
+/** USB links at or below high speed (USB 2.0) are the seek-bound ones. */
+constexpr double kSlowUsbMbps = 480.0;
+
+QString readSysfs(const QString& path)
+{
+    QFile f(path);
+    return f.open(QIODevice::ReadOnly) ? QString::fromLatin1(f.readAll()).trimmed() : QString();
+}
+
+#endif
+
+} // namespace
+
+uint64_t physicalOffset(const QString& path)
+{
+#if defined(Q_OS_LINUX)
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return kUnknownOffset;
+    }
+    // One extent is all the ordering needs; no FIEMAP_FLAG_SYNC, which would flush the file.
+    alignas(struct fiemap) char buffer[sizeof(struct fiemap) + sizeof(struct fiemap_extent)] {};
+    auto* map = reinterpret_cast<struct fiemap*>(buffer);
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+    const int rc = ::ioctl(fd, FS_IOC_FIEMAP, map);
+    ::close(fd);
+    const struct fiemap_extent& first = map->fm_extents[0];
+    constexpr quint32 kNoPlace = FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_NOT_ALIGNED;
+    if (rc != 0 || map->fm_mapped_extents == 0 || (first.fe_flags & kNoPlace) != 0) {
+        return kUnknownOffset;
+    }
+    return first.fe_physical;
+#elif defined(Q_OS_WIN)
+    const HANDLE file = CreateFileW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(path).utf16()),
+                                    FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                    nullptr, OPEN_EXISTING, 0, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return kUnknownOffset;
+    }
+    STARTING_VCN_INPUT_BUFFER in {};
+    RETRIEVAL_POINTERS_BUFFER out {};
+    DWORD returned = 0;
+    // ERROR_MORE_DATA still fills the first extent, which is all that is asked for.
+    const BOOL ok = DeviceIoControl(file, FSCTL_GET_RETRIEVAL_POINTERS, &in, sizeof(in), &out, sizeof(out),
+                                    &returned, nullptr);
+    const bool filled = ok || GetLastError() == ERROR_MORE_DATA;
+    CloseHandle(file);
+    if (!filled || out.ExtentCount == 0 || out.Extents[0].Lcn.QuadPart < 0) {
+        return kUnknownOffset;  // resident in the MFT, sparse, or not a cluster file system
+    }
+    DWORD sectorsPerCluster = 0;
+    DWORD bytesPerSector = 0;
+    DWORD freeClusters = 0;
+    DWORD totalClusters = 0;
+    const QString root = QDir::toNativeSeparators(QStorageInfo(path).rootPath());
+    if (!GetDiskFreeSpaceW(reinterpret_cast<LPCWSTR>(root.utf16()), &sectorsPerCluster, &bytesPerSector,
+                           &freeClusters, &totalClusters)) {
+        return kUnknownOffset;
+    }
+    return static_cast<uint64_t>(out.Extents[0].Lcn.QuadPart) * sectorsPerCluster * bytesPerSector;
+#else
+    Q_UNUSED(path);
+    return kUnknownOffset;
+#endif
+}
+
+bool seekSensitive(const QString& mountPoint)
+{
+#if defined(Q_OS_LINUX)
+    struct stat st {};
+    if (::stat(QFile::encodeName(mountPoint).constData(), &st) != 0) {
+        return false;
+    }
+    QString dir = QFileInfo(QStringLiteral("/sys/dev/block/%1:%2").arg(major(st.st_dev)).arg(minor(st.st_dev)))
+                      .canonicalFilePath();
+    if (dir.isEmpty()) {
+        return false;
+    }
+    // A partition's queue settings are its disk's, one directory up.
+    const QString disk = QFileInfo::exists(dir + QStringLiteral("/partition")) ? QFileInfo(dir).absolutePath() : dir;
+    if (readSysfs(disk + QStringLiteral("/queue/rotational")) == QLatin1String("1")) {
+        return true;
+    }
+    // The USB device the disk hangs off is the nearest ancestor with a link speed.
+    for (; dir.startsWith(QLatin1String("/sys/devices/")); dir = QFileInfo(dir).absolutePath()) {
+        if (QFileInfo::exists(dir + QStringLiteral("/idVendor"))) {
+            bool ok = false;
+            const double mbps = readSysfs(dir + QStringLiteral("/speed")).toDouble(&ok);
+            return ok && mbps > 0 && mbps <= kSlowUsbMbps;
+        }
+    }
+    return false;
+#elif defined(Q_OS_WIN)
+    const QString root = QStorageInfo(mountPoint).rootPath();
+    if (root.size() < 2 || root.at(1) != QLatin1Char(':')) {
+        return false;
+    }
+    const QString volume = QStringLiteral("\\\\.\\") + root.left(2);
+    const HANDLE handle = CreateFileW(reinterpret_cast<LPCWSTR>(volume.utf16()), 0,
+                                      FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    STORAGE_PROPERTY_QUERY query {};
+    query.PropertyId = StorageDeviceSeekPenaltyProperty;
+    query.QueryType = PropertyStandardQuery;
+    DEVICE_SEEK_PENALTY_DESCRIPTOR penalty {};
+    DWORD returned = 0;
+    const BOOL ok = DeviceIoControl(handle, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query), &penalty,
+                                    sizeof(penalty), &returned, nullptr);
+    CloseHandle(handle);
+    return ok && returned >= sizeof(penalty) && penalty.IncursSeekPenalty;
+#else
+    Q_UNUSED(mountPoint);
+    return false;
+#endif
+}
+
+} // namespace FlashSpartan::FileExtents
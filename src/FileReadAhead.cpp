@@ -0,0 +1,45 @@
+#include "FileReadAhead.h"
+
+#include <QFile>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace FlashSpartan::FileReadAhead {
+
+void sequential(int fd)
+{
+#ifdef Q_OS_LINUX
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#else
+    (void)fd;
+#endif
+}
+
+bool prefetch(const QString& path, qint64 bytes)
+{
+#ifdef Q_OS_LINUX
+    if (bytes <= 0) {
+        return false;
+    }
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    // The read-ahead is queued against the page cache, not the descriptor, so it carries on
+    // after the close.
+    const bool hinted = posix_fadvise(fd, 0, static_cast<off_t>(bytes), POSIX_FADV_WILLNEED) == 0;
+    ::close(fd);
+    return hinted;
+#else
+    (void)path;
+    (void)bytes;
+    return false;
+#endif
+}
+
+} // namespace FlashSpartan::FileReadAhead
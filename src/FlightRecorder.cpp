@@ -0,0 +1,367 @@
+#include "FlightRecorder.h"
+#include "PerfMetrics.h"
+#include "PerfTrace.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string_view>
+
+namespace FlashSpartan {
+
+namespace {
+
+struct Slot {
+    quint64 sequence;  // 0 while being written; stored last
+    qint64 wallUs;
+    qint64 durationNs;
+    qint64 value;  // a sample's double, bit for bit
+    quint32 pid;
+    quint32 thread;
+    quint8 kind;
+    quint8 labelLength;
+    char label[FlightRecorder::kLabelBytes];
+};
+static_assert(sizeof(Slot) == FlightRecorder::kSlotBytes);
+
+/** The first slot's worth of the file. */
+struct Header {
+    quint32 magic;
+    quint16 version;
+    quint16 slotBytes;
+    quint32 slotCount;
+    quint32 reserved;
+    quint64 next;  // sequence of the next entry; claimed with an atomic add
+    char padding[FlightRecorder::kSlotBytes - 24];
+};
+static_assert(sizeof(Header) == FlightRecorder::kSlotBytes);
+
+constexpr qint64 kFileBytes = qint64(FlightRecorder::kSlots + 1) * FlightRecorder::kSlotBytes;
+
+std::mutex g_stateMutex;
+QFile* g_file = nullptr;
+Header* g_header = nullptr;
+std::atomic<Slot*> g_slots{nullptr};
+/** Added to PerfTrace::nowNs() for wall-clock nanoseconds. */
+qint64 g_wallOffsetNs = 0;
+quint32 g_pid = 0;
+std::atomic<quint32> g_nextThread{1};
+
+qint64 wallNowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+quint32 threadNumber()
+{
+    thread_local const quint32 number = g_nextThread.fetch_add(1, std::memory_order_relaxed);
+    return number;
+}
+
+void fail(QString* error, const QString& message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+bool validHeader(const Header& header)
+{
+    return header.magic == FlightRecorder::kMagic && header.version == FlightRecorder::kVersion
+           && header.slotBytes == FlightRecorder::kSlotBytes && header.slotCount == FlightRecorder::kSlots;
+}
+
+void recordSlot(FlightRecorder::Kind kind, qint64 wallUs, qint64 durationNs, qint64 value, std::string_view label)
+{
+    Slot* slots = g_slots.load(std::memory_order_acquire);
+    if (!slots) {
+        return;
+    }
+    const quint64 sequence = std::atomic_ref(g_header->next).fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots[sequence % FlightRecorder::kSlots];
+    std::atomic_ref published(slot.sequence);
+    published.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.wallUs = wallUs;
+    slot.durationNs = durationNs;
+    slot.value = value;
+    slot.pid = g_pid;
+    slot.thread = threadNumber();
+    slot.kind = static_cast<quint8>(kind);
+    const size_t length = std::min<size_t>(label.size(), FlightRecorder::kLabelBytes);
+    std::memcpy(slot.label, label.data(), length);
+    slot.labelLength = static_cast<quint8>(length);
+    published.store(sequence, std::memory_order_release);
+}
+
+/** @p text cut to @p bytes without splitting a UTF-8 sequence. */
+std::string_view clipUtf8(const QByteArray& text, qsizetype bytes)
+{
+    qsizetype n = std::min(text.size(), bytes);
+    if (n < text.size()) {
+        while (n > 0 && (static_cast<uchar>(text.at(n)) & 0xC0) == 0x80) {
+            --n;
+        }
+    }
+    return {text.constData(), size_t(n)};
+}
+
+/** Published slots from @p slots, oldest first; @p live slots may be written meanwhile. */
+QList<FlightRecorder::Entry> collect(const uchar* slots, bool live)
+{
+    QList<FlightRecorder::Entry> out;
+    for (int i = 0; i < FlightRecorder::kSlots; ++i) {
+        const uchar* at = slots + qsizetype(i) * FlightRecorder::kSlotBytes;
+        Slot copy;
+        if (live) {
+            quint64& sequence = reinterpret_cast<Slot*>(const_cast<uchar*>(at))->sequence;
+            const quint64 before = std::atomic_ref(sequence).load(std::memory_order_acquire);
+            if (before == 0) {
+                continue;
+            }
+            std::memcpy(&copy, at, sizeof(copy));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (std::atomic_ref(sequence).load(std::memory_order_relaxed) != before) {
+                continue;  // overwritten while copied
+            }
+            copy.sequence = before;
+        } else {
+            std::memcpy(&copy, at, sizeof(copy));
+        }
+        if (copy.sequence == 0 || copy.kind < 1 || copy.kind > 4 || copy.labelLength > FlightRecorder::kLabelBytes) {
+            continue;  // never written, or cut off mid-write by a crash
+        }
+        FlightRecorder::Entry e;
+        e.sequence = copy.sequence;
+        e.kind = static_cast<FlightRecorder::Kind>(copy.kind);
+        e.wallUs = copy.wallUs;
+        e.durationNs = copy.durationNs;
+        if (e.kind == FlightRecorder::Kind::Counter) {
+            e.sample = std::bit_cast<double>(copy.value);
+        } else {
+            e.value = copy.value;
+        }
+        e.pid = copy.pid;
+        e.thread = copy.thread;
+        e.label = QString::fromUtf8(copy.label, copy.labelLength);
+        out.append(e);
+    }
+    std::sort(out.begin(), out.end(), [](const FlightRecorder::Entry& a, const FlightRecorder::Entry& b) {
+        return a.sequence < b.sequence;
+    });
+    return out;
+}
+
+} // namespace
+
+bool FlightRecorder::start(const QString& path, QString* error)
+{
+    std::lock_guard lock(g_stateMutex);
+    if (g_file) {
+        return true;
+    }
+    auto file = std::make_unique<QFile>(path);
+    if (!file->open(QIODevice::ReadWrite)) {
+        fail(error, file->errorString());
+        return false;
+    }
+    bool reset = file->size() != kFileBytes;
+    if (reset && !(file->resize(0) && file->resize(kFileBytes))) {
+        fail(error, file->errorString());
+        return false;
+    }
+    uchar* map = file->map(0, kFileBytes);
+    if (!map) {
+        fail(error, file->errorString());
+        return false;
+    }
+    auto* header = reinterpret_cast<Header*>(map);
+    if (reset || !validHeader(*header)) {
+        // New, or another format: start over rather than misread it.
+        std::memset(map, 0, size_t(kFileBytes));
+        header->magic = kMagic;
+        header->version = kVersion;
+        header->slotBytes = kSlotBytes;
+        header->slotCount = kSlots;
+        header->next = 1;
+    }
+    g_file = file.release();
+    g_header = header;
+    g_wallOffsetNs = wallNowNs() - PerfTrace::nowNs();
+    g_pid = quint32(QCoreApplication::applicationPid());
+    g_slots.store(reinterpret_cast<Slot*>(map + kSlotBytes), std::memory_order_release);
+    PerfTrace::setSink(&FlightRecorder::span);
+
+    const QByteArray session = (QCoreApplication::applicationName() + QLatin1Char(' ')
+                                + QCoreApplication::applicationVersion())
+                                   .trimmed()
+                                   .toUtf8();
+    recordSlot(Kind::SessionStart, wallNowNs() / 1000, 0, g_pid, clipUtf8(session, kLabelBytes));
+    return true;
+}
+
+void FlightRecorder::stop()
+{
+    std::lock_guard lock(g_stateMutex);
+    if (!g_file) {
+        return;
+    }
+    PerfTrace::setSink(nullptr);
+    g_slots.store(nullptr, std::memory_order_release);
+    g_file->unmap(reinterpret_cast<uchar*>(g_header));
+    delete g_file;
+    g_file = nullptr;
+    g_header = nullptr;
+}
+
+bool FlightRecorder::isRunning()
+{
+    return g_slots.load(std::memory_order_acquire) != nullptr;
+}
+
+void FlightRecorder::span(const char* category, const char* name, qint64 beginNs, qint64 endNs, qint64 value)
+{
+    if (endNs - beginNs < kMinSpanNs) {
+        return;
+    }
+    char label[kLabelBytes];
+    size_t length = 0;
+    const auto append = [&](std::string_view part) {
+        const size_t n = std::min(part.size(), sizeof(label) - length);
+        std::memcpy(label + length, part.data(), n);
+        length += n;
+    };
+    append(category);
+    append("/");
+    append(name);
+    recordSlot(Kind::Span, (beginNs + g_wallOffsetNs) / 1000, endNs - beginNs, value, {label, length});
+}
+
+void FlightRecorder::event(const char* category, const QString& text, qint64 value)
+{
+    if (!isRunning()) {
+        return;
+    }
+    const QByteArray label = QByteArray(category) + ": " + text.toUtf8();
+    recordSlot(Kind::Event, wallNowNs() / 1000, 0, value, clipUtf8(label, kLabelBytes));
+}
+
+void FlightRecorder::sampleCounters()
+{
+    if (!isRunning()) {
+        return;
+    }
+    static std::mutex mutex;
+    static QHash<QString, double> last;
+    std::lock_guard lock(mutex);
+    const qint64 wallUs = wallNowNs() / 1000;
+    // Histograms are left out: their observations are spans, and slow ones are kept as such.
+    for (const PerfMetrics::Series& s : PerfMetrics::snapshot()) {
+        if (s.kind == PerfMetrics::Kind::Histogram) {
+            continue;
+        }
+        const QString key = s.labels.isEmpty() ? s.name : s.name + QLatin1Char('{') + s.labels + QLatin1Char('}');
+        const auto it = last.constFind(key);
+        if (it != last.constEnd() && *it == s.value) {
+            continue;
+        }
+        last.insert(key, s.value);
+        recordSlot(Kind::Counter, wallUs, 0, std::bit_cast<qint64>(s.value), clipUtf8(key.toUtf8(), kLabelBytes));
+    }
+}
+
+QList<FlightRecorder::Entry> FlightRecorder::snapshot()
+{
+    std::lock_guard lock(g_stateMutex);
+    const Slot* slots = g_slots.load(std::memory_order_acquire);
+    return slots ? collect(reinterpret_cast<const uchar*>(slots), true) : QList<Entry>();
+}
+
+QList<FlightRecorder::Entry> FlightRecorder::read(const QString& path, QString* error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fail(error, file.errorString());
+        return {};
+    }
+    const QByteArray bytes = file.readAll();
+    Header header{};
+    if (bytes.size() == kFileBytes) {
+        std::memcpy(&header, bytes.constData(), sizeof(header));
+    }
+    if (!validHeader(header)) {
+        fail(error, QStringLiteral("%1 is not a flight recording").arg(path));
+        return {};
+    }
+    return collect(reinterpret_cast<const uchar*>(bytes.constData()) + kSlotBytes, false);
+}
+
+QByteArray FlightRecorder::toTraceJson(const QList<Entry>& entries)
+{
+    QJsonArray trace;
+    QSet<quint32> named;
+    for (const Entry& e : entries) {
+        QJsonObject obj;
+        obj[QStringLiteral("ts")] = double(e.wallUs);
+        obj[QStringLiteral("pid")] = qint64(e.pid);
+        obj[QStringLiteral("tid")] = qint64(e.thread);
+        switch (e.kind) {
+            case Kind::Span: {
+                const qsizetype slash = e.label.indexOf(QLatin1Char('/'));
+                obj[QStringLiteral("cat")] = e.label.left(qMax<qsizetype>(0, slash));
+                obj[QStringLiteral("name")] = e.label.mid(slash + 1);
+                obj[QStringLiteral("ph")] = QStringLiteral("X");
+                obj[QStringLiteral("dur")] = double(e.durationNs) / 1000.0;
+                break;
+            }
+            case Kind::Counter:
+                obj[QStringLiteral("name")] = e.label;
+                obj[QStringLiteral("ph")] = QStringLiteral("C");
+                obj[QStringLiteral("args")] = QJsonObject{{QStringLiteral("value"), e.sample}};
+                break;
+            case Kind::Event:
+                obj[QStringLiteral("name")] = e.label;
+                obj[QStringLiteral("ph")] = QStringLiteral("i");
+                obj[QStringLiteral("s")] = QStringLiteral("p");
+                break;
+            case Kind::SessionStart:
+                obj[QStringLiteral("name")] = QStringLiteral("session start");
+                obj[QStringLiteral("ph")] = QStringLiteral("i");
+                obj[QStringLiteral("s")] = QStringLiteral("g");
+                if (!named.contains(e.pid)) {
+                    named.insert(e.pid);
+                    QJsonObject meta;
+                    meta[QStringLiteral("name")] = QStringLiteral("process_name");
+                    meta[QStringLiteral("ph")] = QStringLiteral("M");
+                    meta[QStringLiteral("pid")] = qint64(e.pid);
+                    meta[QStringLiteral("args")] = QJsonObject{{QStringLiteral("name"), e.label}};
+                    trace.append(meta);
+                }
+                break;
+        }
+        if (e.kind != Kind::Counter && e.kind != Kind::SessionStart && e.value >= 0) {
+            obj[QStringLiteral("args")] = QJsonObject{{QStringLiteral("value"), double(e.value)}};
+        }
+        trace.append(obj);
+    }
+    QJsonObject root;
+    root[QStringLiteral("traceEvents")] = trace;
+    root[QStringLiteral("displayTimeUnit")] = QStringLiteral("ms");
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+} // namespace FlashSpartan
@@ -1,7 +1,10 @@
 #include "HashCheckpoint.h"
 
 #include "AppPaths.h"
+#include "HexEncoding.h"
 
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDir>
 #include <QFile>
 #include <QJsonArray>
@@ -10,31 +13,70 @@
 #include <QSaveFile>
 #include <QStandardPaths>
 
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
 namespace FlashSpartan {
 
-HashCheckpointStore& HashCheckpointStore::instance()
+namespace {
+
+constexpr quint32 kLogMagic = 0x4C435346;  // 'FSCL' little-endian
+// Version 2 adds storageId and layoutFingerprint to the header; version 1 logs still load.
+constexpr quint16 kLogVersion = 2;
+
+void prepare(QDataStream& stream)
 {
-    static HashCheckpointStore store;
-    return store;
+    stream.setVersion(QDataStream::Qt_6_4);
+    stream.setByteOrder(QDataStream::LittleEndian);
 }
 
-static QString checkpointPath()
+QByteArray encodeHeader(const HashCheckpoint& cp, int digestBytes)
 {
-    const QString dir = AppPaths::configDir();
-    QDir().mkpath(dir);
-    return dir + QStringLiteral("/hash-checkpoints.json");
+    QByteArray header;
+    QDataStream out(&header, QIODevice::WriteOnly);
+    prepare(out);
+    out << kLogMagic << kLogVersion << cp.deviceNode << cp.algorithm << cp.scanMode
+        << quint64(cp.deviceSize) << quint64(cp.blockSize) << quint32(digestBytes) << cp.storageId
+        << cp.layoutFingerprint;
+    return header;
 }
 
-void HashCheckpointStore::load()
+QByteArray rawDigests(const QStringList& blockHashes, int from)
 {
-    m_checkpoints.clear();
-    QFile file(checkpointPath());
+    QByteArray raw;
+    for (int i = from; i < blockHashes.size(); ++i) {
+        raw += QByteArray::fromHex(blockHashes.at(i).toLatin1());
+    }
+    return raw;
+}
+
+bool sameTarget(const HashCheckpoint& a, const HashCheckpoint& b)
+{
+    return a.deviceNode == b.deviceNode && a.algorithm == b.algorithm && a.scanMode == b.scanMode
+        && a.deviceSize == b.deviceSize && a.blockSize == b.blockSize && a.storageId == b.storageId
+        && a.layoutFingerprint == b.layoutFingerprint;
+}
+
+QString legacyCheckpointPath()
+{
+    return AppPaths::configDir() + QStringLiteral("/hash-checkpoints.json");
+}
+
+QList<HashCheckpoint> readLegacyJson(const QString& path)
+{
+    QList<HashCheckpoint> checkpoints;
+    QFile file(path);
     if (!file.open(QIODevice::ReadOnly)) {
-        return;
+        return checkpoints;
     }
     const QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
     if (!doc.isObject()) {
-        return;
+        return checkpoints;
     }
     for (const QJsonValue& v : doc.object().value(QStringLiteral("checkpoints")).toArray()) {
         const QJsonObject o = v.toObject();
@@ -49,77 +91,291 @@ void HashCheckpointStore::load()
             cp.blockHashes.append(hv.toString());
         }
         if (cp.isValid()) {
-            m_checkpoints.append(cp);
+            checkpoints.append(cp);
         }
     }
+    return checkpoints;
 }
 
-void HashCheckpointStore::save()
+} // namespace
+
+HashCheckpointLog::~HashCheckpointLog()
 {
-    QJsonArray arr;
-    for (const HashCheckpoint& cp : m_checkpoints) {
-        QJsonObject o;
-        o.insert(QStringLiteral("device_node"), cp.deviceNode);
-        o.insert(QStringLiteral("algorithm"), cp.algorithm);
-        o.insert(QStringLiteral("scan_mode"), cp.scanMode);
-        o.insert(QStringLiteral("device_size"), static_cast<double>(cp.deviceSize));
-        o.insert(QStringLiteral("block_size"), static_cast<double>(cp.blockSize));
-        o.insert(QStringLiteral("bytes_completed"), static_cast<double>(cp.bytesCompleted));
-        QJsonArray hashes;
-        for (const QString& h : cp.blockHashes) {
-            hashes.append(h);
-        }
-        o.insert(QStringLiteral("block_hashes"), hashes);
-        arr.append(o);
+    close();
+}
+
+std::optional<HashCheckpoint> HashCheckpointLog::read(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+    const QByteArray data = file.readAll();
+    QDataStream in(data);
+    prepare(in);
+    quint32 magic = 0;
+    quint16 version = 0;
+    quint64 deviceSize = 0;
+    quint64 blockSize = 0;
+    quint32 digestBytes = 0;
+    HashCheckpoint cp;
+    in >> magic >> version >> cp.deviceNode >> cp.algorithm >> cp.scanMode >> deviceSize
+       >> blockSize >> digestBytes;
+    if (version >= 2) {
+        in >> cp.storageId >> cp.layoutFingerprint;
     }
-    QJsonObject root;
-    root.insert(QStringLiteral("version"), QStringLiteral("1.0"));
-    root.insert(QStringLiteral("checkpoints"), arr);
+    if (in.status() != QDataStream::Ok || magic != kLogMagic || version < 1 || version > kLogVersion
+        || digestBytes == 0) {
+        return std::nullopt;
+    }
+    cp.deviceSize = deviceSize;
+    cp.blockSize = blockSize;
 
-    QSaveFile file(checkpointPath());
+    // A crash mid-append leaves a partial last record; it is simply not a block yet.
+    const qsizetype bodyStart = static_cast<qsizetype>(in.device()->pos());
+    const qsizetype blocks = (data.size() - bodyStart) / static_cast<qsizetype>(digestBytes);
+    cp.blockHashes.reserve(blocks);
+    for (qsizetype i = 0; i < blocks; ++i) {
+        cp.blockHashes.append(HexEncoding::toString(
+            reinterpret_cast<const unsigned char*>(data.constData() + bodyStart + i * digestBytes),
+            digestBytes));
+    }
+    cp.bytesCompleted = qMin(cp.deviceSize, static_cast<uint64_t>(blocks) * cp.blockSize);
+    if (!cp.isValid()) {
+        return std::nullopt;
+    }
+    return cp;
+}
+
+bool HashCheckpointLog::write(const QString& path, const HashCheckpoint& cp)
+{
+    if (cp.blockHashes.isEmpty()) {
+        return false;
+    }
+    const int digestBytes = static_cast<int>(cp.blockHashes.first().size() / 2);
+    QSaveFile file(path);
     if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(encodeHeader(cp, digestBytes));
+    file.write(rawDigests(cp.blockHashes, 0));
+    return file.commit();
+}
+
+bool HashCheckpointLog::update(const QString& path, const HashCheckpoint& cp)
+{
+    if (cp.blockHashes.isEmpty()) {
+        return true;
+    }
+    if (!m_file || m_file->fileName() != path || !sameTarget(m_header, cp)
+        || cp.blockHashes.size() < m_blocks) {
+        return reopen(path, cp);
+    }
+    if (cp.blockHashes.size() == m_blocks) {
+        return true;
+    }
+
+    const QByteArray raw = rawDigests(cp.blockHashes, m_blocks);
+    if (m_file->write(raw) != raw.size() || !m_file->flush()) {
+        close();
+        return false;
+    }
+    m_blocks = static_cast<int>(cp.blockHashes.size());
+    if (m_lastSync.elapsed() >= kSyncIntervalMs) {
+        sync();
+    }
+    return true;
+}
+
+void HashCheckpointLog::close()
+{
+    if (m_file) {
+        sync();
+        m_file->close();
+        m_file.reset();
+    }
+    m_blocks = 0;
+}
+
+bool HashCheckpointLog::reopen(const QString& path, const HashCheckpoint& cp)
+{
+    close();
+    // One full write per job start (or resume rewind); every later checkpoint appends.
+    if (!write(path, cp)) {
+        return false;
+    }
+    auto file = std::make_unique<QFile>(path);
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return false;
+    }
+    m_file = std::move(file);
+    m_header = cp;
+    m_header.blockHashes.clear();
+    m_blocks = static_cast<int>(cp.blockHashes.size());
+    m_lastSync.start();
+    return true;
+}
+
+void HashCheckpointLog::sync()
+{
+    if (!m_file) {
         return;
     }
-    file.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
-    file.commit();
+    m_file->flush();
+#ifdef Q_OS_WIN
+    _commit(m_file->handle());
+#else
+    fdatasync(m_file->handle());
+#endif
+    m_lastSync.start();
+}
+
+HashCheckpointStore& HashCheckpointStore::instance()
+{
+    static HashCheckpointStore store;
+    return store;
+}
+
+QString HashCheckpointStore::logDirectory()
+{
+    const QString dir = AppPaths::configDir() + QStringLiteral("/hash-checkpoints");
+    QDir().mkpath(dir);
+    return dir;
+}
+
+QString HashCheckpointStore::logPathFor(const QString& key, const QString& algorithm, const QString& scanMode)
+{
+    const QByteArray name = (key + QLatin1Char('\n') + algorithm + QLatin1Char('\n') + scanMode).toUtf8();
+    return logDirectory() + QLatin1Char('/')
+           + QString::fromLatin1(QCryptographicHash::hash(name, QCryptographicHash::Sha1).toHex())
+           + QStringLiteral(".log");
+}
+
+void HashCheckpointStore::load()
+{
+    QMutexLocker locker(&m_mutex);
+    m_openLogs.clear();
+    m_checkpoints.clear();
+
+    const QDir dir(logDirectory());
+    for (const QString& name : dir.entryList({QStringLiteral("*.log")}, QDir::Files)) {
+        if (auto cp = HashCheckpointLog::read(dir.filePath(name))) {
+            m_checkpoints.append(*cp);
+        }
+    }
+
+    // hash-checkpoints.json rewrote every block string on each save; move it to logs once.
+    const QString legacyPath = legacyCheckpointPath();
+    if (QFile::exists(legacyPath)) {
+        for (const HashCheckpoint& cp : readLegacyJson(legacyPath)) {
+            const bool known = std::any_of(m_checkpoints.cbegin(), m_checkpoints.cend(),
+                                           [&](const HashCheckpoint& c) {
+                                               return c.deviceNode == cp.deviceNode
+                                                   && c.algorithm == cp.algorithm
+                                                   && c.scanMode == cp.scanMode;
+                                           });
+            if (!known && HashCheckpointLog::write(logPathFor(cp.key(), cp.algorithm, cp.scanMode), cp)) {
+                m_checkpoints.append(cp);
+            }
+        }
+        QFile::remove(legacyPath);
+    }
 }
 
 std::optional<HashCheckpoint> HashCheckpointStore::checkpointFor(const QString& deviceNode,
                                                                    const QString& algorithm,
-                                                                   const QString& scanMode) const
+                                                                   const QString& scanMode,
+                                                                   const QString& storageId,
+                                                                   const QString& layoutFingerprint) const
 {
+    QMutexLocker locker(&m_mutex);
+    const HashCheckpoint* byNode = nullptr;
     for (const HashCheckpoint& cp : m_checkpoints) {
-        if (cp.deviceNode == deviceNode && cp.algorithm == algorithm && cp.scanMode == scanMode) {
-            return cp;
+        if (cp.algorithm != algorithm || cp.scanMode != scanMode) {
+            continue;
         }
+        if (!storageId.isEmpty() && cp.storageId == storageId) {
+            if (cp.layoutFingerprint != layoutFingerprint) {
+                continue;  // repartitioned since; the blocks no longer line up
+            }
+            HashCheckpoint found = cp;
+            found.deviceNode = deviceNode;
+            return found;
+        }
+        // Kept by node (no identity then, or a version 1 log): only while nothing says it
+        // belonged to another device.
+        if (cp.deviceNode == deviceNode && (cp.storageId.isEmpty() || storageId.isEmpty()) && !byNode) {
+            byNode = &cp;
+        }
+    }
+    if (byNode) {
+        return *byNode;
     }
     return std::nullopt;
 }
 
+void HashCheckpointStore::record(const HashCheckpoint& cp)
+{
+    if (!cp.isValid()) {
+        return;
+    }
+    const QString path = logPathFor(cp.key(), cp.algorithm, cp.scanMode);
+    std::shared_ptr<HashCheckpointLog> log;
+    {
+        QMutexLocker locker(&m_mutex);
+        std::shared_ptr<HashCheckpointLog>& slot = m_openLogs[path];
+        if (!slot) {
+            slot = std::make_shared<HashCheckpointLog>();
+        }
+        log = slot;
+    }
+    // One job per device at a time, so the log itself needs no lock.
+    log->update(path, cp);
+}
+
 void HashCheckpointStore::upsert(const HashCheckpoint& cp)
 {
-    remove(cp.deviceNode, cp.algorithm, cp.scanMode);
-    m_checkpoints.append(cp);
-    save();
+    remove(cp);
+    if (cp.blockHashes.isEmpty()) {
+        return;
+    }
+    if (HashCheckpointLog::write(logPathFor(cp.key(), cp.algorithm, cp.scanMode), cp)) {
+        QMutexLocker locker(&m_mutex);
+        m_checkpoints.append(cp);
+    }
 }
 
-void HashCheckpointStore::remove(const QString& deviceNode, const QString& algorithm,
-                                 const QString& scanMode)
+void HashCheckpointStore::remove(const QString& key, const QString& algorithm, const QString& scanMode)
 {
+    const QString path = logPathFor(key, algorithm, scanMode);
+    QMutexLocker locker(&m_mutex);
+    m_openLogs.remove(path);
     m_checkpoints.erase(
         std::remove_if(m_checkpoints.begin(), m_checkpoints.end(),
                        [&](const HashCheckpoint& c) {
-                           return c.deviceNode == deviceNode && c.algorithm == algorithm
-                               && c.scanMode == scanMode;
+                           return c.key() == key && c.algorithm == algorithm && c.scanMode == scanMode;
                        }),
         m_checkpoints.end());
-    save();
+    QFile::remove(path);
+}
+
+void HashCheckpointStore::remove(const HashCheckpoint& cp)
+{
+    remove(cp.key(), cp.algorithm, cp.scanMode);
+    if (!cp.storageId.isEmpty()) {
+        remove(cp.deviceNode, cp.algorithm, cp.scanMode);
+    }
 }
 
 void HashCheckpointStore::clearAll()
 {
+    QMutexLocker locker(&m_mutex);
+    m_openLogs.clear();
     m_checkpoints.clear();
-    save();
+    const QDir dir(logDirectory());
+    for (const QString& name : dir.entryList({QStringLiteral("*.log")}, QDir::Files)) {
+        QFile::remove(dir.filePath(name));
+    }
 }
 
 } // namespace FlashSpartan
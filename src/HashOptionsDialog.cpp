@@ -71,6 +71,8 @@ HashOptionsDialog::HashOptionsDialog(const DeviceInfo& device,
     m_modeCombo = new QComboBox;
     m_modeCombo->addItem(QStringLiteral("Full partition read (slow, strongest)"),
                          static_cast<int>(HashScanMode::Full));
+    m_modeCombo->addItem(QStringLiteral("Full read, parallel blocks (multi-core, same result)"),
+                         static_cast<int>(HashScanMode::ParallelFull));
     m_modeCombo->addItem(QStringLiteral("Quick sample (first/last + spaced 1 MiB chunks)"),
                          static_cast<int>(HashScanMode::QuickSample));
     if (hasWatchBaseline) {
@@ -0,0 +1,145 @@
+#include "HashPipeline.h"
+
+#include "IoBufferPool.h"
+
+#include <QtGlobal>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace FlashSpartan::RawDeviceHash {
+
+namespace {
+
+uint64_t elapsedMs(std::chrono::steady_clock::time_point since)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(
+                                     std::chrono::steady_clock::now() - since)
+                                     .count());
+}
+
+struct Slot {
+    IoBufferPool::Buffer buffer;
+    char* data = nullptr;
+    size_t length = 0;
+};
+
+} // namespace
+
+bool runPipelined(int depth, size_t bufferSize, const PipelineReadFn& read,
+                  const PipelineConsumeFn& consume, PipelineStats* stats, QString* error)
+{
+    const size_t slotCount = static_cast<size_t>(qMax(2, depth));
+    std::vector<Slot> slots(slotCount);
+    for (Slot& slot : slots) {
+        slot.buffer = IoBufferPool::Buffer(bufferSize);
+        slot.data = slot.buffer.data();
+        if (!slot.data) {
+            if (error) {
+                *error = QStringLiteral("Failed to allocate buffer");
+            }
+            return false;
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable notEmpty;
+    std::condition_variable notFull;
+    size_t filled = 0;
+    bool endOfData = false;
+    bool stop = false;
+    bool readFailed = false;
+    QString readError;
+    uint64_t readerStallMs = 0;
+    uint64_t hasherStallMs = 0;
+
+    std::thread reader([&]() {
+        size_t writeIdx = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (filled >= slotCount && !stop) {
+                    const auto waitStart = std::chrono::steady_clock::now();
+                    notFull.wait(lock, [&]() { return filled < slotCount || stop; });
+                    readerStallMs += elapsedMs(waitStart);
+                }
+                if (stop) {
+                    break;
+                }
+            }
+
+            Slot& slot = slots[writeIdx];
+            QString err;
+            const int64_t n = read(slot.data, bufferSize, &err);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (n < 0) {
+                readFailed = true;
+                readError = err;
+                endOfData = true;
+                notEmpty.notify_one();
+                break;
+            }
+            if (n == 0) {
+                endOfData = true;
+                notEmpty.notify_one();
+                break;
+            }
+            slot.length = static_cast<size_t>(n);
+            writeIdx = (writeIdx + 1) % slotCount;
+            ++filled;
+            notEmpty.notify_one();
+        }
+    });
+
+    bool consumerOk = true;
+    size_t readIdx = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (filled == 0 && !endOfData) {
+                const auto waitStart = std::chrono::steady_clock::now();
+                notEmpty.wait(lock, [&]() { return filled > 0 || endOfData; });
+                hasherStallMs += elapsedMs(waitStart);
+            }
+            if (filled == 0 && endOfData) {
+                break;
+            }
+        }
+
+        const Slot& slot = slots[readIdx];
+        consumerOk = consume(slot.data, slot.length);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        readIdx = (readIdx + 1) % slotCount;
+        --filled;
+        notFull.notify_one();
+        if (!consumerOk) {
+            break;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    notFull.notify_all();
+    reader.join();
+
+    if (stats) {
+        stats->readerStallMs = readerStallMs;
+        stats->hasherStallMs = hasherStallMs;
+    }
+    if (readFailed) {
+        if (error) {
+            *error = readError;
+        }
+        return false;
+    }
+    return consumerOk;
+}
+
+} // namespace FlashSpartan::RawDeviceHash
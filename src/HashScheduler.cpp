@@ -0,0 +1,114 @@
+#include "HashScheduler.h"
+
+#include <QtGlobal>
+
+#include <tuple>
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr double kEwmaWeight = 0.2;
+/** Below this gain over one job fewer, the extra job only splits the same bandwidth. */
+constexpr double kKeepGain = 1.05;
+
+} // namespace
+
+void HashScheduler::setGlobalLimit(int limit)
+{
+    m_globalLimit = qMax(1, limit);
+}
+
+void HashScheduler::pinLimit(const QString& controller, int limit)
+{
+    if (controller.isEmpty()) {
+        return;
+    }
+    ControllerStats& stats = m_controllers[controller];
+    stats.limit = qMax(1, limit);
+    stats.ceiling = stats.limit;
+}
+
+int HashScheduler::controllerLimit(const QString& controller) const
+{
+    if (controller.isEmpty()) {
+        return m_globalLimit;
+    }
+    auto it = m_controllers.constFind(controller);
+    const int limit = it == m_controllers.constEnd() ? 1 : it->limit;
+    return qMin(limit, m_globalLimit);
+}
+
+int HashScheduler::pickNext(const QList<Pending>& pending, const QList<Running>& running) const
+{
+    if (running.size() >= m_globalLimit) {
+        return -1;
+    }
+
+    QHash<QString, int> perController;
+    QHash<QString, int> perRootPort;
+    for (const Running& job : running) {
+        ++perController[job.controller];
+        ++perRootPort[job.controller + QLatin1Char('/') + job.rootPort];
+    }
+
+    int best = -1;
+    std::tuple<bool, uint64_t, int, int> bestKey;
+    for (int i = 0; i < pending.size(); ++i) {
+        const Pending& job = pending.at(i);
+        if (perController.value(job.controller) >= controllerLimit(job.controller)) {
+            continue;
+        }
+        const bool starved = job.waitedMs >= kStarvationMs;
+        const uint64_t size =
+            m_order == Order::LongestFirst ? UINT64_MAX - job.estimatedBytes : job.estimatedBytes;
+        // Starved jobs run in arrival order (their index); the rest by size, spread across
+        // root ports, then by arrival.
+        const std::tuple<bool, uint64_t, int, int> key{
+            !starved, starved ? 0 : size,
+            perRootPort.value(job.controller + QLatin1Char('/') + job.rootPort), i};
+        if (best < 0 || key < bestKey) {
+            best = i;
+            bestKey = key;
+        }
+    }
+    return best;
+}
+
+bool HashScheduler::recordThroughput(const QString& controller, int concurrency, double mbps)
+{
+    if (controller.isEmpty() || concurrency < 1 || mbps <= 0.0) {
+        return false;
+    }
+
+    ControllerStats& stats = m_controllers[controller];
+    const int count = ++stats.samples[concurrency];
+    const double previous = stats.mbps.value(concurrency, mbps);
+    stats.mbps[concurrency] = count == 1 ? mbps : previous + kEwmaWeight * (mbps - previous);
+
+    // Only the concurrency the limit currently allows says anything about moving it.
+    if (concurrency != stats.limit || count < kMinSamples) {
+        return false;
+    }
+
+    if (stats.limit > 1 && stats.samples.value(stats.limit - 1) >= kMinSamples) {
+        const double fewer = stats.mbps.value(stats.limit - 1);
+        if (stats.mbps.value(stats.limit) < fewer * kKeepGain) {
+            --stats.limit;
+            stats.ceiling = stats.limit;
+            return true;
+        }
+        if (stats.mbps.value(stats.limit) < fewer * kGrowGain) {
+            stats.ceiling = stats.limit;  // still pays off a little; stop probing higher
+            return false;
+        }
+    }
+
+    if ((stats.ceiling == 0 || stats.limit < stats.ceiling) && stats.limit < m_globalLimit) {
+        ++stats.limit;
+        return true;
+    }
+    return false;
+}
+
+} // namespace FlashSpartan
@@ -1,12 +1,15 @@
 #include "HashWorker.h"
+#include "CapacityProbe.h"
+#include "DeviceGeometry.h"
 #include "HashCheckpoint.h"
+#include "IoScheduler.h"
 #include "RawDeviceHash.h"
 #include "RawDeviceHashAdvanced.h"
+#include "SharedReadPass.h"
 
 #include <QTimer>
 #include <QDateTime>
 #include <QDebug>
-#include <QtConcurrent>
 
 namespace FlashSpartan {
 
@@ -17,8 +20,9 @@ RawDeviceHash::Algorithm toRawAlgorithm(HashWorker::Algorithm algo)
     switch (algo) {
         case HashWorker::Algorithm::SHA512: return RawDeviceHash::Algorithm::SHA512;
         case HashWorker::Algorithm::BLAKE2b: return RawDeviceHash::Algorithm::BLAKE2b;
+        case HashWorker::Algorithm::BLAKE3: return RawDeviceHash::Algorithm::BLAKE3;
+        case HashWorker::Algorithm::XXH3_128: return RawDeviceHash::Algorithm::XXH3_128;
         case HashWorker::Algorithm::SHA256:
-        case HashWorker::Algorithm::XXH3_128:
         default:
             return RawDeviceHash::Algorithm::SHA256;
     }
@@ -26,8 +30,45 @@ RawDeviceHash::Algorithm toRawAlgorithm(HashWorker::Algorithm algo)
 
 RawDeviceHash::ScanMode toRawScanMode(HashScanMode mode)
 {
-    return mode == HashScanMode::QuickSample ? RawDeviceHash::ScanMode::QuickSample
-                                             : RawDeviceHash::ScanMode::Full;
+    switch (mode) {
+        case HashScanMode::QuickSample: return RawDeviceHash::ScanMode::QuickSample;
+        case HashScanMode::ParallelFull: return RawDeviceHash::ScanMode::ParallelChunked;
+        case HashScanMode::Full:
+        case HashScanMode::WatchManifestOnly:
+        default:
+            return RawDeviceHash::ScanMode::Full;
+    }
+}
+
+QString controllerKey(const HashWorker::HashJob& job)
+{
+    return job.usbBus.isEmpty() ? QString() : QStringLiteral("usb%1").arg(job.usbBus);
+}
+
+QString rootPortKey(const HashWorker::HashJob& job)
+{
+    return job.usbPortPath.section(QLatin1Char('.'), 0, 0);
+}
+
+RawDeviceHash::QuickSampleLayout quickSampleLayout(const HashWorker::HashJob& job)
+{
+    RawDeviceHash::QuickSampleLayout layout;
+    layout.samples = job.quickSamples;
+    layout.sampleKB = job.quickSampleKB;
+    layout.metadataHotSpots = job.quickSampleMetadata;
+    return RawDeviceHash::normalizedQuickSampleLayout(layout);
+}
+
+/** Bytes a job will read, for shortest-first ordering. */
+uint64_t estimatedReadBytes(const HashWorker::HashJob& job, uint64_t totalBytes)
+{
+    const uint64_t size = totalBytes > 0 ? totalBytes : job.sizeHintBytes;
+    if (job.scanMode == HashScanMode::QuickSample) {
+        const RawDeviceHash::QuickSampleLayout layout = quickSampleLayout(job);
+        const uint64_t samples = RawDeviceHash::quickSampleOffsets(layout, size).size();
+        return qMin(size, samples * static_cast<uint64_t>(layout.sampleKB) * 1024);
+    }
+    return size;
 }
 
 } // namespace
@@ -35,9 +76,10 @@ RawDeviceHash::ScanMode toRawScanMode(HashScanMode mode)
 HashWorker::HashWorker(QObject* parent)
     : QObject(parent)
 {
-    m_progressTimer = new QTimer(this);
-    m_progressTimer->setInterval(PROGRESS_UPDATE_INTERVAL_MS);
-    connect(m_progressTimer, &QTimer::timeout, this, &HashWorker::updateProgress);
+    m_throughputTimer = new QTimer(this);
+    m_throughputTimer->setInterval(THROUGHPUT_SAMPLE_INTERVAL_MS);
+    connect(m_throughputTimer, &QTimer::timeout, this, &HashWorker::sampleThroughput);
+    ProgressHub::instance().addSource(this, [this]() { return progressSnapshot(); });
 }
 
 HashWorker::~HashWorker()
@@ -55,21 +97,19 @@ QString HashWorker::startHash(const HashJob& job)
     state->cancelled.store(false);
     state->bytesProcessed.store(0);
 
-    const int fd = RawDeviceHash::openDevice(job.deviceNode);
-    if (fd >= 0) {
-        state->totalBytes.store(RawDeviceHash::deviceSize(fd, job.deviceNode));
-        RawDeviceHash::closeDevice(fd);
-    }
+    state->totalBytes.store(DeviceGeometryCache::instance().geometry(job.deviceNode).sizeBytes);
 
     {
         QMutexLocker locker(&m_jobsMutex);
-        if (static_cast<int>(m_jobs.size()) >= m_maxConcurrent) {
-            m_pendingQueue.enqueue(qMakePair(jobId, job));
-            return jobId;
-        }
+        PendingJob pending;
+        pending.state = std::move(state);
+        pending.queued.start();
+        m_pendingQueue.append(std::move(pending));
+        publishMetrics();
     }
 
-    return launchJob(jobId, job, std::move(state));
+    processPendingQueue();
+    return jobId;
 }
 
 QString HashWorker::launchJob(const QString& jobId, const HashJob& job,
@@ -81,11 +121,7 @@ QString HashWorker::launchJob(const QString& jobId, const HashJob& job,
         state->config = job;
         state->cancelled.store(false);
         state->bytesProcessed.store(0);
-        const int fd = RawDeviceHash::openDevice(job.deviceNode);
-        if (fd >= 0) {
-            state->totalBytes.store(RawDeviceHash::deviceSize(fd, job.deviceNode));
-            RawDeviceHash::closeDevice(fd);
-        }
+        state->totalBytes.store(DeviceGeometryCache::instance().geometry(job.deviceNode).sizeBytes);
     }
 
     state->timer.start();
@@ -93,16 +129,27 @@ QString HashWorker::launchJob(const QString& jobId, const HashJob& job,
     connect(state->watcher.get(), &QFutureWatcher<HashResult>::finished,
             this, [this, jobId]() { onJobFinished(jobId); });
 
-    state->future = QtConcurrent::run(&HashWorker::executeHash, state);
+    // Quick checks answer "is this stick still the one I trusted"; full reads can wait.
+    const IoScheduler::Task task{IoScheduler::wholeDiskNode(job.deviceNode),
+                                 job.scanMode == HashScanMode::QuickSample ? IoScheduler::Priority::Normal
+                                                                           : IoScheduler::Priority::Background,
+                                 IoScheduler::Pool::Io};
+    state->future = IoScheduler::instance().run(task, [state]() {
+        state->dispatched.store(true);
+        return executeHash(state);
+    });
     state->watcher->setFuture(state->future);
 
     {
         QMutexLocker locker(&m_jobsMutex);
+        state->hashedBytes = &PerfMetrics::hashedBytes(algorithmName(job.algorithm));
         m_jobs.insert(jobId, state);
-        if (!m_progressTimer->isActive()) {
-            m_progressTimer->start();
+        publishMetrics();
+        if (!m_throughputTimer->isActive()) {
+            m_throughputTimer->start();
         }
     }
+    ProgressHub::instance().wake();
 
     emit hashStarted(jobId, job.deviceNode);
     return jobId;
@@ -115,14 +162,18 @@ bool HashWorker::cancelHash(const QString& jobId)
     auto it = m_jobs.find(jobId);
     if (it == m_jobs.end()) {
         for (int i = 0; i < m_pendingQueue.size(); ++i) {
-            if (m_pendingQueue.at(i).first == jobId) {
+            if (m_pendingQueue.at(i).state->jobId == jobId) {
                 m_pendingQueue.removeAt(i);
+                publishMetrics();
                 return true;
             }
         }
         return false;
     }
 
+    (*it)->paused.store(false);
+    (*it)->preempted = false;
+    (*it)->userCancelled = true;
     (*it)->cancelled.store(true);
     return true;
 }
@@ -132,9 +183,41 @@ void HashWorker::cancelAll()
     QMutexLocker locker(&m_jobsMutex);
 
     for (auto& state : m_jobs) {
+        state->paused.store(false);
+        state->preempted = false;
+        state->userCancelled = true;
         state->cancelled.store(true);
     }
     m_pendingQueue.clear();
+    publishMetrics();
+}
+
+bool HashWorker::setHashPaused(const QString& jobId, bool paused)
+{
+    {
+        QMutexLocker locker(&m_jobsMutex);
+        auto it = m_jobs.find(jobId);
+        if (it == m_jobs.end() || (*it)->cancelled.load() || (*it)->paused.load() == paused) {
+            return false;
+        }
+        (*it)->paused.store(paused);
+        // Paused time is not throughput; start the slowest-window sample afresh.
+        (*it)->windowStartMs = -1;
+    }
+    ProgressHub::instance().wake();
+    emit hashPaused(jobId, paused);
+    if (paused) {
+        // A paused full read is the first one a waiting quick check may take over.
+        processPendingQueue();
+    }
+    return true;
+}
+
+bool HashWorker::isPaused(const QString& jobId) const
+{
+    QMutexLocker locker(&m_jobsMutex);
+    auto it = m_jobs.constFind(jobId);
+    return it != m_jobs.cend() && (*it)->paused.load();
 }
 
 bool HashWorker::isRunning(const QString& jobId) const
@@ -172,9 +255,48 @@ double HashWorker::progress(const QString& jobId) const
     return static_cast<double>((*it)->bytesProcessed.load()) / static_cast<double>(total);
 }
 
+QList<ProgressSample> HashWorker::progressSnapshot() const
+{
+    QMutexLocker locker(&m_jobsMutex);
+    QList<ProgressSample> samples;
+    samples.reserve(m_jobs.size());
+    for (const auto& state : m_jobs) {
+        ProgressSample sample;
+        sample.kind = ProgressSample::Kind::Hash;
+        sample.jobId = state->jobId;
+        if (state->paused.load()) {
+            sample.detail = QStringLiteral("Paused");
+        }
+        sample.bytesTotal = state->totalBytes.load();
+        sample.bytesDone = qMin<uint64_t>(state->bytesProcessed.load(), sample.bytesTotal);
+        if (sample.bytesTotal > 0) {
+            sample.fraction = static_cast<double>(sample.bytesDone) / static_cast<double>(sample.bytesTotal);
+            const qint64 elapsedMs = state->timer.elapsed();
+            if (elapsedMs > 100) {
+                sample.speedMBps = (static_cast<double>(sample.bytesDone) / (1024.0 * 1024.0))
+                    / (static_cast<double>(elapsedMs) / 1000.0);
+            }
+            if (sample.speedMBps > 0.01 && sample.bytesDone < sample.bytesTotal) {
+                const double remainingMb =
+                    static_cast<double>(sample.bytesTotal - sample.bytesDone) / (1024.0 * 1024.0);
+                sample.etaSeconds = remainingMb / sample.speedMBps;
+            }
+        }
+        samples.append(sample);
+    }
+    return samples;
+}
+
 void HashWorker::setMaxConcurrent(int max)
 {
-    m_maxConcurrent = qMax(1, max);
+    {
+        QMutexLocker locker(&m_jobsMutex);
+        m_maxConcurrent = qMax(1, max);
+        m_scheduler.setGlobalLimit(m_maxConcurrent);
+    }
+    // Room for every allowed hash plus a manifest and an ISO verify beside them.
+    IoScheduler::instance().setIoLimit(qMax(IoScheduler::kDefaultIoLimit, m_maxConcurrent + 2));
+    processPendingQueue();
 }
 
 QString HashWorker::algorithmName(Algorithm algo)
@@ -183,6 +305,7 @@ QString HashWorker::algorithmName(Algorithm algo)
         case Algorithm::SHA256: return "SHA256";
         case Algorithm::SHA512: return "SHA512";
         case Algorithm::BLAKE2b: return "BLAKE2b";
+        case Algorithm::BLAKE3: return "BLAKE3";
         case Algorithm::XXH3_128: return "XXH3-128";
     }
     return "Unknown";
@@ -190,11 +313,14 @@ QString HashWorker::algorithmName(Algorithm algo)
 
 HashWorker::Algorithm HashWorker::algorithmFromName(const QString& name)
 {
+    if (name.startsWith(QStringLiteral("XXH3"), Qt::CaseInsensitive)) {
+        return Algorithm::XXH3_128;
+    }
     const QString base = name.section(QLatin1Char('-'), 0, 0);
     if (base.compare("SHA256", Qt::CaseInsensitive) == 0) return Algorithm::SHA256;
     if (base.compare("SHA512", Qt::CaseInsensitive) == 0) return Algorithm::SHA512;
     if (base.compare("BLAKE2b", Qt::CaseInsensitive) == 0) return Algorithm::BLAKE2b;
-    if (base.compare("XXH3-128", Qt::CaseInsensitive) == 0) return Algorithm::XXH3_128;
+    if (base.compare("BLAKE3", Qt::CaseInsensitive) == 0) return Algorithm::BLAKE3;
     return Algorithm::SHA256;
 }
 
@@ -208,21 +334,90 @@ QString HashWorker::generateJobId()
 void HashWorker::processPendingQueue()
 {
     for (;;) {
-        QPair<QString, HashJob> pair;
+        std::shared_ptr<JobState> state;
         {
             QMutexLocker locker(&m_jobsMutex);
-            if (m_jobs.size() >= static_cast<size_t>(m_maxConcurrent) || m_pendingQueue.isEmpty()) {
+            if (m_pendingQueue.isEmpty()) {
+                break;
+            }
+            QList<HashScheduler::Pending> pending;
+            pending.reserve(m_pendingQueue.size());
+            for (const PendingJob& job : std::as_const(m_pendingQueue)) {
+                const HashJob& config = job.state->config;
+                pending.append({controllerKey(config), rootPortKey(config),
+                                estimatedReadBytes(config, job.state->totalBytes.load()),
+                                job.queued.elapsed()});
+            }
+            QList<HashScheduler::Running> running;
+            running.reserve(m_jobs.size());
+            for (const auto& job : std::as_const(m_jobs)) {
+                running.append({controllerKey(job->config), rootPortKey(job->config)});
+            }
+            const int next = m_scheduler.pickNext(pending, running);
+            if (next < 0) {
+                for (int i = 0; i < m_pendingQueue.size(); ++i) {
+                    if (m_pendingQueue.at(i).state->config.scanMode == HashScanMode::QuickSample
+                        && preemptForLocked(i, pending)) {
+                        break;
+                    }
+                }
                 break;
             }
-            pair = m_pendingQueue.dequeue();
+            state = m_pendingQueue.takeAt(next).state;
+            publishMetrics();
+        }
+        launchJob(state->jobId, state->config, state);
+    }
+}
+
+bool HashWorker::preemptForLocked(int pendingIndex, const QList<HashScheduler::Pending>& pending)
+{
+    std::shared_ptr<JobState> victim;
+    uint64_t victimRemaining = 0;
+    for (const auto& job : std::as_const(m_jobs)) {
+        if (job->preempted) {
+            // One stop at a time: the quick check may fit once that slot is free.
+            return false;
+        }
+    }
+    for (const auto& job : std::as_const(m_jobs)) {
+        // Only full reads keep a checkpoint to come back to.
+        if (!hashScanModeReadsAll(job->config.scanMode) || job->cancelled.load()
+            || job->preemptions >= MAX_PREEMPTIONS) {
+            continue;
+        }
+        QList<HashScheduler::Running> without;
+        for (const auto& other : std::as_const(m_jobs)) {
+            if (other != job) {
+                without.append({controllerKey(other->config), rootPortKey(other->config)});
+            }
+        }
+        if (m_scheduler.pickNext({pending.at(pendingIndex)}, without) < 0) {
+            continue;
+        }
+        const uint64_t total = job->totalBytes.load();
+        const uint64_t remaining = total - qMin(total, job->bytesProcessed.load());
+        // A paused read costs nothing to stop; otherwise the one furthest from done.
+        if (!victim || (job->paused.load() && !victim->paused.load())
+            || (job->paused.load() == victim->paused.load() && remaining > victimRemaining)) {
+            victim = job;
+            victimRemaining = remaining;
         }
-        launchJob(pair.first, pair.second, nullptr);
     }
+    if (!victim) {
+        return false;
+    }
+    victim->preempted = true;
+    ++victim->preemptions;
+    victim->paused.store(false);
+    victim->cancelled.store(true);
+    return true;
 }
 
 void HashWorker::onJobFinished(const QString& jobId)
 {
     std::shared_ptr<JobState> state;
+    bool requeued = false;
 
     {
         QMutexLocker locker(&m_jobsMutex);
@@ -232,12 +427,49 @@ void HashWorker::onJobFinished(const QString& jobId)
         }
         state = *it;
         m_jobs.erase(it);
+        publishMetrics(state.get());
+
+        // A user's cancel wins over a stop for a quick check that landed first.
+        if (state->userCancelled) {
+            state->preempted = false;
+        }
+        // A read that finished before it saw the stop keeps its result.
+        bool finishedAnyway = false;
+        if (state->preempted) {
+            try {
+                finishedAnyway = state->future.result().success;
+            } catch (const std::exception&) {
+            }
+        }
+        if (state->preempted && !finishedAnyway) {
+            state->preempted = false;
+            state->cancelled.store(false);
+            state->dispatched.store(false);
+            state->sampled = false;
+            state->windowStartMs = -1;
+            // executeHash picks the saved checkpoint up again.
+            state->config.resumeFromCheckpoint = true;
+            PendingJob pending;
+            pending.state = state;
+            pending.queued.start();
+            m_pendingQueue.append(std::move(pending));
+            publishMetrics();
+            requeued = true;
+        } else if (state->preempted) {
+            state->cancelled.store(false);
+        }
 
         if (m_jobs.isEmpty() && m_pendingQueue.isEmpty()) {
-            m_progressTimer->stop();
+            m_throughputTimer->stop();
         }
     }
 
+    if (requeued) {
+        emit hashPreempted(jobId);
+        processPendingQueue();
+        return;
+    }
+
     processPendingQueue();
 
     if (state->cancelled.load()) {
@@ -247,13 +479,18 @@ void HashWorker::onJobFinished(const QString& jobId)
 
     try {
         HashResult result = state->future.result();
+        result.performance.avgMBps = result.speedMBps();
+        {
+            QMutexLocker locker(&m_jobsMutex);
+            result.performance.minMBps = state->minMBps;
+        }
 
         if (result.success) {
             result.hashScopeLabel = state->config.scope == HashScope::WholeDisk
                                         ? QStringLiteral("whole_disk")
                                         : QStringLiteral("partition");
             result.scanModeLabel = hashScanModeToString(state->config.scanMode);
-            result.resumedFromCheckpoint = state->config.resumeFromCheckpoint;
+            result.resumedFromCheckpoint = state->config.resumeFromCheckpoint && !result.checkpointRejected;
             emit hashCompleted(jobId, result);
         } else {
             emit hashFailed(jobId, result.errorMessage);
@@ -263,36 +500,106 @@ void HashWorker::onJobFinished(const QString& jobId)
     }
 }
 
-void HashWorker::updateProgress()
+void HashWorker::sampleThroughput()
 {
     QMutexLocker locker(&m_jobsMutex);
+    const bool limitsChanged = sampleControllerThroughput();
+    sampleJobWindows();
+    publishMetrics();
+    locker.unlock();
+    if (limitsChanged) {
+        processPendingQueue();
+    }
+}
 
-    for (auto& state : m_jobs) {
-        const uint64_t total = state->totalBytes.load();
-        const uint64_t processed = state->bytesProcessed.load();
+void HashWorker::publishMetrics(JobState* finished)
+{
+    const auto countBytes = [](JobState& job) {
+        const uint64_t processed = job.bytesProcessed.load();
+        if (job.hashedBytes && processed > job.countedBytes) {
+            job.hashedBytes->add(processed - job.countedBytes);
+            job.countedBytes = processed;
+        }
+    };
+    for (auto& job : m_jobs) {
+        countBytes(*job);
+    }
+    if (finished) {
+        countBytes(*finished);
+    }
+    PerfMetrics::hashQueueDepth(false).set(m_pendingQueue.size());
+    PerfMetrics::hashQueueDepth(true).set(m_jobs.size());
+}
 
-        if (total == 0) {
+void HashWorker::sampleJobWindows()
+{
+    for (auto& job : m_jobs) {
+        const qint64 nowMs = job->timer.elapsed();
+        const uint64_t processed = job->bytesProcessed.load();
+        if (job->windowStartMs < 0) {
+            job->windowStartMs = nowMs;
+            job->windowStartBytes = processed;
+            continue;
+        }
+        const qint64 spanMs = nowMs - job->windowStartMs;
+        if (spanMs < 1000) {
             continue;
         }
+        const double mbps = (static_cast<double>(processed - qMin(processed, job->windowStartBytes))
+                             / (1024.0 * 1024.0))
+                            / (static_cast<double>(spanMs) / 1000.0);
+        job->minMBps = job->minMBps > 0.0 ? qMin(job->minMBps, mbps) : mbps;
+        job->windowStartMs = nowMs;
+        job->windowStartBytes = processed;
+    }
+}
 
-        const double prog = static_cast<double>(processed) / static_cast<double>(total);
+bool HashWorker::sampleControllerThroughput()
+{
+    qint64 tickMs = 0;
+    if (m_lastTick.isValid()) {
+        tickMs = m_lastTick.restart();
+    } else {
+        m_lastTick.start();
+    }
 
-        const qint64 elapsedMs = state->timer.elapsed();
-        double speedMBps = 0.0;
-        if (elapsedMs > 100) {
-            speedMBps = (static_cast<double>(processed) / (1024.0 * 1024.0))
-                / (static_cast<double>(elapsedMs) / 1000.0);
+    // A controller's sample counts only if the same jobs ran on it for the whole tick.
+    struct Tick {
+        int jobs = 0;
+        uint64_t bytes = 0;
+        bool complete = true;
+    };
+    QHash<QString, Tick> ticks;
+    for (auto& state : m_jobs) {
+        const QString controller = controllerKey(state->config);
+        // Still queued behind another job's read of the same disk: not moving any bytes.
+        if (controller.isEmpty() || !state->dispatched.load()) {
+            continue;
         }
-
-        double etaSeconds = 0.0;
-        if (speedMBps > 0.01 && processed < total) {
-            const double remainingMb =
-                static_cast<double>(total - processed) / (1024.0 * 1024.0);
-            etaSeconds = remainingMb / speedMBps;
+        const uint64_t processed = state->bytesProcessed.load();
+        Tick& tick = ticks[controller];
+        ++tick.jobs;
+        if (!state->sampled || processed < state->sampledBytes) {
+            tick.complete = false;
+        } else {
+            tick.bytes += processed - state->sampledBytes;
         }
+        state->sampled = true;
+        state->sampledBytes = processed;
+    }
 
-        emit hashProgress(state->jobId, prog, processed, speedMBps, etaSeconds, total);
+    bool changed = false;
+    QHash<QString, int> jobsNow;
+    for (auto it = ticks.cbegin(); it != ticks.cend(); ++it) {
+        jobsNow.insert(it.key(), it->jobs);
+        if (tickMs > 0 && it->complete && m_lastTickJobs.value(it.key()) == it->jobs) {
+            const double mbps = (static_cast<double>(it->bytes) / (1024.0 * 1024.0))
+                / (static_cast<double>(tickMs) / 1000.0);
+            changed = m_scheduler.recordThroughput(it.key(), it->jobs, mbps) || changed;
+        }
     }
+    m_lastTickJobs = jobsNow;
+    return changed;
 }
 
 HashResult HashWorker::executeHash(std::shared_ptr<JobState> state)
@@ -302,17 +609,54 @@ HashResult HashWorker::executeHash(std::shared_ptr<JobState> state)
     options.algorithm = toRawAlgorithm(state->config.algorithm);
     options.bufferSizeKB = state->config.bufferSizeKB;
     options.useMemoryMapping = state->config.useMemoryMapping;
+    options.ioEngine = state->config.useIoUring ? RawDeviceHash::IoEngine::IoUring
+                                                : RawDeviceHash::IoEngine::Default;
+    options.ioQueueDepth = state->config.ioQueueDepth;
+    options.pipelineDepth = state->config.pipelineDepth;
+    options.skipZeroRegions = state->config.skipZeroRegions;
+    options.quickSample = quickSampleLayout(state->config);
+    options.reuseHelperSession = state->config.reuseHelperSession;
+    if (!state->config.expectedBlockHashes.isEmpty()) {
+        options.expectedBlockHashes = &state->config.expectedBlockHashes;
+        options.stopAtFirstMismatch = state->config.stopAtFirstMismatch;
+    }
+    if (const std::shared_ptr<SharedReadPass>& pass = state->config.sharedRead) {
+        options.dataRead = [pass](uint64_t offset, const char* data, size_t length) {
+            pass->publish(offset, data, length);
+        };
+        // A hole is never published, and the reader would wait for it.
+        options.skipZeroRegions = false;
+    }
+    if (state->config.partitionHashes && state->config.scope == HashScope::WholeDisk
+        && hashScanModeReadsAll(state->config.scanMode)) {
+        options.regions = RawDeviceHash::partitionRegions(state->config.deviceNode);
+    }
     options.cancelled = &state->cancelled;
+    options.paused = &state->paused;
     options.bytesProcessed = &state->bytesProcessed;
+    options.totalBytes = &state->totalBytes;
     options.scanMode = toRawScanMode(state->config.scanMode);
+    if (options.algorithm == RawDeviceHash::Algorithm::BLAKE3
+        && options.scanMode == RawDeviceHash::ScanMode::Full) {
+        // Full reads always go through the 64 MiB block tree here, and ParallelChunked
+        // builds the identical tree, so BLAKE3 gets every core at no compatibility cost.
+        options.scanMode = RawDeviceHash::ScanMode::ParallelChunked;
+    }
 
     HashCheckpoint checkpoint;
     HashCheckpoint* cpPtr = nullptr;
-    if (state->config.scanMode == HashScanMode::Full) {
+    if (hashScanModeReadsAll(state->config.scanMode)) {
+        // Kept under the disk's serial, so a replug that changes the node still resumes.
+        const RawDeviceHash::StorageIdentity identity = RawDeviceHash::storageIdentity(state->config.deviceNode);
+        checkpoint.storageId = identity.storageId;
+        checkpoint.layoutFingerprint = identity.layoutFingerprint;
         const QString algo = algorithmName(state->config.algorithm);
         if (auto existing = HashCheckpointStore::instance().checkpointFor(
-                state->config.deviceNode, algo, QStringLiteral("full"))) {
+                state->config.deviceNode, algo, QStringLiteral("full"), identity.storageId,
+                identity.layoutFingerprint)) {
             checkpoint = *existing;
+            checkpoint.storageId = identity.storageId;
+            checkpoint.layoutFingerprint = identity.layoutFingerprint;
         }
         cpPtr = &checkpoint;
         options.checkpointOut = cpPtr;
@@ -323,46 +667,65 @@ HashResult HashWorker::executeHash(std::shared_ptr<JobState> state)
         cpPtr = &checkpoint;
         options.checkpointOut = cpPtr;
     }
+    if (cpPtr) {
+        // Appends only the new block digests, so a crash or unplug loses at most ~1 s.
+        options.checkpointed = [](const HashCheckpoint& cp) {
+            HashCheckpointStore::instance().record(cp);
+        };
+    }
 
+    DeviceGeometryCache& geometryCache = DeviceGeometryCache::instance();
+    const DeviceGeometry geometry = geometryCache.geometry(state->config.deviceNode);
     if (state->totalBytes.load() == 0) {
-        const int fd = RawDeviceHash::openDevice(state->config.deviceNode);
-        if (fd >= 0) {
-            state->totalBytes.store(RawDeviceHash::deviceSize(fd, state->config.deviceNode));
-            RawDeviceHash::closeDevice(fd);
+        state->totalBytes.store(geometry.sizeBytes);
+    }
+
+    int tunedBufferSizeKB = 0;
+    if (state->config.autoTuneBuffer && !geometry.isEmpty()) {
+        // Jobs on the same device share this descriptor instead of each opening their own.
+        const DeviceGeometryCache::Handle handle = geometryCache.acquire(state->config.deviceNode);
+        if (handle.isOpen()) {
+            const RawDeviceHash::BufferTuning tuning = RawDeviceHash::autoTuneBufferSize(
+                handle.fd(), {geometry.maxSectorsKB, geometry.optimalIoKB}, geometry.sizeBytes);
+            if (tuning.bufferSizeKB > 0) {
+                tunedBufferSizeKB = tuning.bufferSizeKB;
+                options.bufferSizeKB = tuning.bufferSizeKB;
+            }
         }
     }
 
+    // Read-only and in-process, like the buffer probe: skipped when the device needs elevation.
+    CapacityCheck capacityCheck;
+    if (state->config.probeCapacity && !state->cancelled.load()) {
+        capacityCheck = CapacityProbe::probeDevice(state->config.deviceNode);
+    }
+
     QElapsedTimer timer;
     timer.start();
 
     HashResult result = RawDeviceHash::hashDevice(options);
+    if (state->config.sharedRead) {
+        state->config.sharedRead->finish();
+    }
+    result.tunedBufferSizeKB = tunedBufferSizeKB;
+    result.capacityCheck = capacityCheck;
     result.durationMs = static_cast<uint64_t>(timer.elapsed());
 
     if (result.success && cpPtr && cpPtr->isValid() && !result.errorMessage.contains(
             QStringLiteral("Cancelled"))) {
-        HashCheckpointStore::instance().remove(state->config.deviceNode, cpPtr->algorithm,
-                                               cpPtr->scanMode);
-    } else if (!result.success && result.errorMessage.contains(QStringLiteral("Cancelled"))
-               && cpPtr && cpPtr->isValid()) {
+        HashCheckpointStore::instance().remove(*cpPtr);
+    } else if (!result.success && cpPtr && cpPtr->isValid()) {
+        // Cancelled, or a read error such as an unplug: the log already holds the progress;
+        // compact it into the resume point.
         HashCheckpointStore::instance().upsert(*cpPtr);
     }
 
-    if (state->config.algorithm == Algorithm::XXH3_128 && result.success) {
-        result.algorithm = "SHA256";
-    }
-
     return result;
 }
 
 uint64_t HashWorker::getDeviceSize(const QString& deviceNode)
 {
-    const int fd = RawDeviceHash::openDevice(deviceNode);
-    if (fd < 0) {
-        return 0;
-    }
-    const uint64_t size = RawDeviceHash::deviceSize(fd, deviceNode);
-    RawDeviceHash::closeDevice(fd);
-    return size;
+    return DeviceGeometryCache::instance().geometry(deviceNode).sizeBytes;
 }
 
 HashResult HashWorker::hashWithRead(std::shared_ptr<JobState> state)
@@ -0,0 +1,46 @@
+#include "HeadlessPlan.h"
+
+namespace FlashSpartan {
+
+namespace HeadlessPlan {
+
+ConnectPlan onConnect(const DeviceInfo& device, bool blocked, const DeviceRecord* record,
+                      bool autoHashOnConnect)
+{
+    ConnectPlan plan;
+    if (blocked) {
+        plan.verdict = QStringLiteral("blocked");
+        return plan;
+    }
+    plan.scanIsos = true;
+    if (!record) {
+        plan.verdict = QStringLiteral("new");
+        return plan;
+    }
+    plan.verdict = QStringLiteral("known");
+    if (!autoHashOnConnect) {
+        return plan;
+    }
+    if (record->verificationProfile != VerificationProfile::FullPartition) {
+        plan.verify = Verify::WatchManifest;
+    } else if (record->hash.isEmpty()) {
+        plan.verify = Verify::Skip;
+        plan.skipReason = QStringLiteral("No baseline hash");
+    } else if (device.isMounted) {
+        // The GUI asks before unmounting for a raw read; unattended runs never do.
+        plan.verify = Verify::Skip;
+        plan.skipReason = QStringLiteral("Mounted; a full-partition verify needs it unmounted");
+    } else {
+        plan.verify = Verify::FullHash;
+    }
+    return plan;
+}
+
+bool scanIsosOnChange(const DeviceInfo& before, const DeviceInfo& after, const QString& verdict)
+{
+    return after.isMounted && !before.isMounted && verdict != QLatin1String("blocked");
+}
+
+} // namespace HeadlessPlan
+
+} // namespace FlashSpartan
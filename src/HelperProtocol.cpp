@@ -0,0 +1,334 @@
+#include "HelperProtocol.h"
+#include "HexEncoding.h"
+
+#include <QDataStream>
+#include <QIODevice>
+
+namespace FlashSpartan::HelperProtocol {
+
+namespace {
+
+void prepare(QDataStream& stream)
+{
+    stream.setVersion(QDataStream::Qt_6_4);
+    stream.setByteOrder(QDataStream::LittleEndian);
+}
+
+void writeCheckpoint(QDataStream& out, const HashCheckpoint& cp)
+{
+    out << cp.deviceNode << cp.algorithm << cp.scanMode << quint64(cp.deviceSize)
+        << quint64(cp.blockSize) << cp.blockHashes << quint64(cp.bytesCompleted);
+}
+
+void readCheckpoint(QDataStream& in, HashCheckpoint& cp)
+{
+    quint64 deviceSize = 0;
+    quint64 blockSize = 0;
+    quint64 bytesCompleted = 0;
+    in >> cp.deviceNode >> cp.algorithm >> cp.scanMode >> deviceSize >> blockSize
+       >> cp.blockHashes >> bytesCompleted;
+    cp.deviceSize = deviceSize;
+    cp.blockSize = blockSize;
+    cp.bytesCompleted = bytesCompleted;
+}
+
+} // namespace
+
+QByteArray encodeFrame(FrameType type, const QByteArray& payload)
+{
+    QByteArray frame;
+    frame.reserve(kHeaderBytes + payload.size());
+    QDataStream out(&frame, QIODevice::WriteOnly);
+    prepare(out);
+    out << quint8(type) << quint32(payload.size());
+    if (!payload.isEmpty()) {
+        out.writeRawData(payload.constData(), static_cast<int>(payload.size()));
+    }
+    return frame;
+}
+
+bool takeFrame(QByteArray& buffer, Frame* out, QString* error)
+{
+    if (buffer.size() < kHeaderBytes) {
+        return false;
+    }
+    QDataStream header(buffer);
+    prepare(header);
+    quint8 type = 0;
+    quint32 length = 0;
+    header >> type >> length;
+    if (type < quint8(FrameType::Hello) || type > quint8(FrameType::DeviceFd)
+        || length > kMaxPayloadBytes) {
+        if (error) {
+            *error = QStringLiteral("Malformed helper frame");
+        }
+        return false;
+    }
+    if (buffer.size() < kHeaderBytes + static_cast<qsizetype>(length)) {
+        return false;
+    }
+    if (out) {
+        out->type = static_cast<FrameType>(type);
+        out->payload = buffer.mid(kHeaderBytes, static_cast<qsizetype>(length));
+    }
+    buffer.remove(0, kHeaderBytes + static_cast<qsizetype>(length));
+    return true;
+}
+
+QByteArray encodeHello()
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    prepare(out);
+    out << kMagic << kVersion;
+    return payload;
+}
+
+bool decodeHello(const QByteArray& payload, quint16* versionOut)
+{
+    QDataStream in(payload);
+    prepare(in);
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != kMagic) {
+        return false;
+    }
+    if (versionOut) {
+        *versionOut = version;
+    }
+    return true;
+}
+
+QByteArray encodeJob(const JobRequest& job)
+{
+    const RawDeviceHash::Options& o = job.options;
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    prepare(out);
+    out << o.deviceNode << qint32(o.algorithm) << qint32(o.bufferSizeKB) << o.useMemoryMapping
+        << qint32(o.ioEngine) << qint32(o.ioQueueDepth) << qint32(o.pipelineDepth)
+        << qint32(o.hashThreads) << qint32(o.scanMode) << quint64(o.resumeFromBytes)
+        << qint32(o.checkpointEveryBlocks) << o.skipZeroRegions << o.stopAtFirstMismatch
+        << job.expectedBlockHashes << job.useCheckpoint;
+    writeCheckpoint(out, job.checkpoint);
+    out << qint32(o.quickSample.samples) << qint32(o.quickSample.sampleKB)
+        << o.quickSample.metadataHotSpots << quint64(o.lengthLimit);
+    return payload;
+}
+
+bool decodeJob(const QByteArray& payload, JobRequest* out)
+{
+    QDataStream in(payload);
+    prepare(in);
+    JobRequest job;
+    RawDeviceHash::Options& o = job.options;
+    qint32 algorithm = 0;
+    qint32 bufferSizeKB = 0;
+    qint32 ioEngine = 0;
+    qint32 ioQueueDepth = 0;
+    qint32 pipelineDepth = 0;
+    qint32 hashThreads = 0;
+    qint32 scanMode = 0;
+    quint64 resumeFromBytes = 0;
+    qint32 checkpointEveryBlocks = 0;
+    qint32 quickSamples = 0;
+    qint32 quickSampleKB = 0;
+    quint64 lengthLimit = 0;
+    in >> o.deviceNode >> algorithm >> bufferSizeKB >> o.useMemoryMapping >> ioEngine
+       >> ioQueueDepth >> pipelineDepth >> hashThreads >> scanMode >> resumeFromBytes
+       >> checkpointEveryBlocks >> o.skipZeroRegions >> o.stopAtFirstMismatch
+       >> job.expectedBlockHashes >> job.useCheckpoint;
+    readCheckpoint(in, job.checkpoint);
+    in >> quickSamples >> quickSampleKB >> o.quickSample.metadataHotSpots >> lengthLimit;
+    if (in.status() != QDataStream::Ok || o.deviceNode.isEmpty()) {
+        return false;
+    }
+    o.algorithm = static_cast<RawDeviceHash::Algorithm>(algorithm);
+    o.bufferSizeKB = bufferSizeKB;
+    o.ioEngine = static_cast<RawDeviceHash::IoEngine>(ioEngine);
+    o.ioQueueDepth = ioQueueDepth;
+    o.pipelineDepth = pipelineDepth;
+    o.hashThreads = hashThreads;
+    o.scanMode = static_cast<RawDeviceHash::ScanMode>(scanMode);
+    o.resumeFromBytes = resumeFromBytes;
+    o.checkpointEveryBlocks = checkpointEveryBlocks;
+    o.quickSample.samples = quickSamples;
+    o.quickSample.sampleKB = quickSampleKB;
+    o.lengthLimit = lengthLimit;
+    if (out) {
+        *out = job;
+    }
+    return true;
+}
+
+QByteArray encodeProgress(const ProgressUpdate& progress)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    prepare(out);
+    out << quint64(progress.bytesProcessed) << quint64(progress.totalBytes);
+    return payload;
+}
+
+bool decodeProgress(const QByteArray& payload, ProgressUpdate* out)
+{
+    QDataStream in(payload);
+    prepare(in);
+    quint64 processed = 0;
+    quint64 total = 0;
+    in >> processed >> total;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    if (out) {
+        out->bytesProcessed = processed;
+        out->totalBytes = total;
+    }
+    return true;
+}
+
+QByteArray encodeBlock(const BlockDigest& block)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    prepare(out);
+    out << quint64(block.index) << QByteArray::fromHex(block.hex.toLatin1());
+    return payload;
+}
+
+bool decodeBlock(const QByteArray& payload, BlockDigest* out)
+{
+    QDataStream in(payload);
+    prepare(in);
+    quint64 index = 0;
+    QByteArray digest;
+    in >> index >> digest;
+    if (in.status() != QDataStream::Ok || digest.isEmpty()) {
+        return false;
+    }
+    if (out) {
+        out->index = index;
+        out->hex = HexEncoding::toString(digest);
+    }
+    return true;
+}
+
+QByteArray encodeResult(const JobResult& job)
+{
+    const HashResult& r = job.result;
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    prepare(out);
+    out << r.success << r.hash << r.algorithm << r.errorMessage << quint64(r.bytesProcessed)
+        << quint64(r.durationMs) << quint64(r.readStallMs) << quint64(r.hashStallMs)
+        << r.blockHashes << quint64(r.blockSize) << qint64(r.stoppedAtBlock)
+        << job.hasCheckpoint;
+    writeCheckpoint(out, job.checkpoint);
+    const HashPerformance& p = r.performance;
+    out << p.engine << qint32(p.bufferSizeKB) << qint32(p.queueDepth) << quint64(p.ioWaitMs)
+        << quint64(p.cpuMs) << qint32(p.readRetries) << quint64(p.blockMsMedian) << quint64(p.blockMsMax)
+        << qint64(p.slowestBlock) << qint32(p.timedBlocks);
+    return payload;
+}
+
+bool decodeResult(const QByteArray& payload, JobResult* out)
+{
+    QDataStream in(payload);
+    prepare(in);
+    JobResult job;
+    HashResult& r = job.result;
+    quint64 bytesProcessed = 0;
+    quint64 durationMs = 0;
+    quint64 readStallMs = 0;
+    quint64 hashStallMs = 0;
+    quint64 blockSize = 0;
+    qint64 stoppedAtBlock = -1;
+    in >> r.success >> r.hash >> r.algorithm >> r.errorMessage >> bytesProcessed >> durationMs
+       >> readStallMs >> hashStallMs >> r.blockHashes >> blockSize >> stoppedAtBlock
+       >> job.hasCheckpoint;
+    readCheckpoint(in, job.checkpoint);
+    qint32 perfBufferSizeKB = 0;
+    qint32 perfQueueDepth = 0;
+    quint64 perfIoWaitMs = 0;
+    quint64 perfCpuMs = 0;
+    qint32 perfReadRetries = 0;
+    quint64 perfBlockMsMedian = 0;
+    quint64 perfBlockMsMax = 0;
+    qint64 perfSlowestBlock = -1;
+    qint32 perfTimedBlocks = 0;
+    in >> r.performance.engine >> perfBufferSizeKB >> perfQueueDepth >> perfIoWaitMs >> perfCpuMs
+       >> perfReadRetries >> perfBlockMsMedian >> perfBlockMsMax >> perfSlowestBlock >> perfTimedBlocks;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    r.performance.bufferSizeKB = perfBufferSizeKB;
+    r.performance.queueDepth = perfQueueDepth;
+    r.performance.ioWaitMs = perfIoWaitMs;
+    r.performance.cpuMs = perfCpuMs;
+    r.performance.readRetries = perfReadRetries;
+    r.performance.blockMsMedian = perfBlockMsMedian;
+    r.performance.blockMsMax = perfBlockMsMax;
+    r.performance.slowestBlock = perfSlowestBlock;
+    r.performance.timedBlocks = perfTimedBlocks;
+    r.bytesProcessed = bytesProcessed;
+    r.durationMs = durationMs;
+    r.readStallMs = readStallMs;
+    r.hashStallMs = hashStallMs;
+    r.blockSize = blockSize;
+    r.stoppedAtBlock = stoppedAtBlock;
+    if (out) {
+        *out = job;
+    }
+    return true;
+}
+
+QByteArray encodeOpenDevice(const QString& deviceNode)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    prepare(out);
+    out << deviceNode;
+    return payload;
+}
+
+bool decodeOpenDevice(const QByteArray& payload, QString* deviceNode)
+{
+    QDataStream in(payload);
+    prepare(in);
+    QString node;
+    in >> node;
+    if (in.status() != QDataStream::Ok || node.isEmpty()) {
+        return false;
+    }
+    if (deviceNode) {
+        *deviceNode = node;
+    }
+    return true;
+}
+
+QByteArray encodeDeviceFd(const QString& errorMessage)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    prepare(out);
+    out << errorMessage;
+    return payload;
+}
+
+bool decodeDeviceFd(const QByteArray& payload, QString* errorMessage)
+{
+    QDataStream in(payload);
+    prepare(in);
+    QString message;
+    in >> message;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    if (errorMessage) {
+        *errorMessage = message;
+    }
+    return true;
+}
+
+} // namespace FlashSpartan::HelperProtocol
@@ -0,0 +1,579 @@
+#include <QtGlobal>
+
+#ifndef Q_OS_WIN
+
+#include "HelperSession.h"
+
+#include <QFile>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern char** environ;
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr int kCancelGraceMs = 5000;
+constexpr qsizetype kMaxStderrBytes = 64 * 1024;
+
+struct CachedFd {
+    int fd = -1;
+    dev_t rdev = 0;
+    QElapsedTimer cached;
+};
+
+std::mutex g_idleMutex;
+std::unique_ptr<HelperSession> g_idle;
+std::map<QString, CachedFd> g_deviceFds;
+
+void dropCachedFd(std::map<QString, CachedFd>::iterator it)
+{
+    close(it->second.fd);
+    g_deviceFds.erase(it);
+}
+
+} // namespace
+
+HelperSession::~HelperSession()
+{
+    shutdown();
+}
+
+std::unique_ptr<HelperSession> HelperSession::launch(const QString& helperPath,
+                                                     const Limits& limits, QString* error)
+{
+    int sv[2] = {-1, -1};
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+        *error = QString("Failed to start pkexec: %1").arg(strerror(errno));
+        return nullptr;
+    }
+    int errPipe[2] = {-1, -1};
+    if (pipe2(errPipe, O_CLOEXEC) != 0) {
+        *error = QString("Failed to start pkexec: %1").arg(strerror(errno));
+        close(sv[0]);
+        close(sv[1]);
+        return nullptr;
+    }
+
+    // The helper reads frames from stdin and writes them to stdout: both ends are one socket,
+    // so a write to a helper that went away fails with EPIPE instead of raising SIGPIPE.
+    QList<QByteArray> args = {QByteArrayLiteral("pkexec"), helperPath.toLocal8Bit(),
+                              QByteArrayLiteral("hash"), QByteArrayLiteral("--stream")};
+    if (limits.maxSeconds > 0) {
+        args << QByteArrayLiteral("--session") << QByteArray::number(limits.maxDevices)
+             << QByteArray::number(limits.maxSeconds);
+    }
+    std::vector<char*> argv;
+    for (QByteArray& arg : args) {
+        argv.push_back(arg.data());
+    }
+    argv.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, sv[1], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, sv[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, errPipe[1], STDERR_FILENO);
+
+    pid_t pid = -1;
+    const int rc = posix_spawnp(&pid, "pkexec", &actions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(sv[1]);
+    close(errPipe[1]);
+    if (rc != 0) {
+        *error = QString("Failed to start pkexec: %1").arg(strerror(rc));
+        close(sv[0]);
+        close(errPipe[0]);
+        return nullptr;
+    }
+
+    std::unique_ptr<HelperSession> session = adopt(sv[0], limits);
+    session->m_pid = pid;
+    session->m_stderr = errPipe[0];
+    fcntl(session->m_stderr, F_SETFL, fcntl(session->m_stderr, F_GETFL) | O_NONBLOCK);
+    return session;
+}
+
+std::unique_ptr<HelperSession> HelperSession::adopt(int socket, const Limits& limits)
+{
+    std::unique_ptr<HelperSession> session(new HelperSession);
+    session->m_socket = socket;
+    session->m_limits = limits;
+    session->m_started.start();
+    session->m_idle.start();
+    fcntl(session->m_socket, F_SETFL, fcntl(session->m_socket, F_GETFL) | O_NONBLOCK);
+    return session;
+}
+
+std::optional<HelperProtocol::JobResult> HelperSession::run(const RawDeviceHash::Options& options,
+                                                            QString* error)
+{
+    m_answered = false;
+    m_devices.insert(options.deviceNode);
+
+    HelperProtocol::JobRequest job;
+    job.options = options;
+    if (options.expectedBlockHashes) {
+        job.expectedBlockHashes = *options.expectedBlockHashes;
+    }
+    if (options.checkpointOut) {
+        job.useCheckpoint = true;
+        job.checkpoint = *options.checkpointOut;
+    }
+    m_outbox += HelperProtocol::encodeFrame(HelperProtocol::FrameType::Job,
+                                            HelperProtocol::encodeJob(job));
+
+    std::optional<HelperProtocol::JobResult> reply;
+    bool cancelSent = false;
+    QElapsedTimer cancelTimer;
+    while (!reply) {
+        // Not reading frames while paused fills the pipe, which stalls the helper's loop too.
+        RawDeviceHash::waitWhilePaused(options);
+        if (options.cancelled && options.cancelled->load() && !cancelSent) {
+            m_outbox += HelperProtocol::encodeFrame(HelperProtocol::FrameType::Cancel);
+            cancelSent = true;
+            cancelTimer.start();
+        }
+        if (cancelSent && cancelTimer.elapsed() > kCancelGraceMs) {
+            *error = QStringLiteral("Cancelled");
+            shutdown();
+            return std::nullopt;
+        }
+
+        const bool alive = pump(200);
+
+        HelperProtocol::Frame frame;
+        QString protocolError;
+        while (!reply && protocolError.isEmpty()
+               && HelperProtocol::takeFrame(m_inbox, &frame, &protocolError)) {
+            switch (frame.type) {
+                case HelperProtocol::FrameType::Hello:
+                    handleHello(frame, &protocolError);
+                    break;
+                case HelperProtocol::FrameType::Progress: {
+                    m_answered = true;
+                    HelperProtocol::ProgressUpdate progress;
+                    if (HelperProtocol::decodeProgress(frame.payload, &progress)) {
+                        if (options.bytesProcessed) {
+                            options.bytesProcessed->store(progress.bytesProcessed);
+                        }
+                        if (options.totalBytes && progress.totalBytes > 0) {
+                            options.totalBytes->store(progress.totalBytes);
+                        }
+                    }
+                    break;
+                }
+                case HelperProtocol::FrameType::Block: {
+                    m_answered = true;
+                    HelperProtocol::BlockDigest block;
+                    if (options.blockHashed && HelperProtocol::decodeBlock(frame.payload, &block)) {
+                        options.blockHashed(block.index, block.hex);
+                    }
+                    break;
+                }
+                case HelperProtocol::FrameType::Result: {
+                    m_answered = true;
+                    HelperProtocol::JobResult decoded;
+                    if (HelperProtocol::decodeResult(frame.payload, &decoded)) {
+                        reply = decoded;
+                    } else {
+                        protocolError = QStringLiteral("Invalid helper result");
+                    }
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        if (!protocolError.isEmpty()) {
+            *error = protocolError;
+            shutdown();
+            return std::nullopt;
+        }
+        if (!reply && !alive) {
+            *error = cancelSent ? QStringLiteral("Cancelled") : exitMessage();
+            return std::nullopt;
+        }
+    }
+
+    m_idle.start();
+    if (m_limits.maxSeconds <= 0) {
+        shutdown();
+    }
+    return reply;
+}
+
+int HelperSession::openDevice(const QString& deviceNode, const std::atomic<bool>* cancelled,
+                              QString* error)
+{
+    m_answered = false;
+    m_outbox += HelperProtocol::encodeFrame(HelperProtocol::FrameType::OpenDevice,
+                                            HelperProtocol::encodeOpenDevice(deviceNode));
+
+    // No Cancel frame here: the helper answers an open at once, so only the wait for
+    // polkit authentication can be long, and closing the session ends that too.
+    for (;;) {
+        if (cancelled && cancelled->load()) {
+            *error = QStringLiteral("Cancelled");
+            shutdown();
+            return -1;
+        }
+
+        const bool alive = pump(200);
+
+        HelperProtocol::Frame frame;
+        QString protocolError;
+        while (protocolError.isEmpty() && HelperProtocol::takeFrame(m_inbox, &frame, &protocolError)) {
+            if (frame.type == HelperProtocol::FrameType::Hello) {
+                handleHello(frame, &protocolError);
+                continue;
+            }
+            if (frame.type != HelperProtocol::FrameType::DeviceFd) {
+                continue;
+            }
+            m_answered = true;
+            QString refused;
+            if (!HelperProtocol::decodeDeviceFd(frame.payload, &refused)) {
+                protocolError = QStringLiteral("Invalid helper reply");
+                break;
+            }
+            if (!refused.isEmpty()) {
+                *error = refused;
+                return -1;
+            }
+            if (m_passedFds.empty()) {
+                protocolError = QStringLiteral("Privileged helper sent no device descriptor");
+                break;
+            }
+            const int fd = m_passedFds.front();
+            m_passedFds.pop_front();
+            m_devices.insert(deviceNode);
+            m_idle.start();
+            if (m_limits.maxSeconds <= 0) {
+                shutdown();
+            }
+            return fd;
+        }
+        if (!protocolError.isEmpty()) {
+            *error = protocolError;
+            shutdown();
+            return -1;
+        }
+        if (!alive) {
+            *error = exitMessage();
+            return -1;
+        }
+    }
+}
+
+bool HelperSession::reapIfExited()
+{
+    if (m_pid > 0) {
+        int status = 0;
+        pid_t rc = -1;
+        do {
+            rc = waitpid(m_pid, &status, WNOHANG);
+        } while (rc < 0 && errno == EINTR);
+        if (rc == m_pid) {
+            m_exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        }
+        if (rc != 0) {
+            m_pid = -1;
+            m_exited = true;
+        }
+    }
+    return m_exited;
+}
+
+bool HelperSession::accepts(const QString& deviceNode) const
+{
+    if (m_socket < 0 || m_limits.maxSeconds <= 0 || !m_helloSeen || m_exited) {
+        return false;
+    }
+    if (m_started.elapsed() >= qint64(m_limits.maxSeconds) * 1000
+        || m_idle.elapsed() >= qint64(kHostIdleSeconds) * 1000) {
+        return false;
+    }
+    return m_devices.contains(deviceNode) || m_devices.size() < m_limits.maxDevices;
+}
+
+std::unique_ptr<HelperSession> HelperSession::takeIdle(const QString& deviceNode)
+{
+    std::unique_ptr<HelperSession> session;
+    {
+        std::lock_guard<std::mutex> lock(g_idleMutex);
+        if (!g_idle) {
+            return nullptr;
+        }
+        if (!g_idle->reapIfExited() && g_idle->accepts(deviceNode)) {
+            return std::move(g_idle);
+        }
+        // Past its limits (or the helper exited idle): close it outside the lock.
+        session = std::move(g_idle);
+    }
+    return nullptr;
+}
+
+void HelperSession::keepIdle(std::unique_ptr<HelperSession> session)
+{
+    if (!session || session->m_socket < 0) {
+        return;
+    }
+    std::unique_ptr<HelperSession> previous;
+    std::lock_guard<std::mutex> lock(g_idleMutex);
+    previous = std::move(g_idle);
+    g_idle = std::move(session);
+}
+
+void HelperSession::closeIdle()
+{
+    std::unique_ptr<HelperSession> session;
+    std::lock_guard<std::mutex> lock(g_idleMutex);
+    session = std::move(g_idle);
+    for (auto& [node, cached] : g_deviceFds) {
+        close(cached.fd);
+    }
+    g_deviceFds.clear();
+}
+
+void HelperSession::cacheDeviceFd(const QString& deviceNode, int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISBLK(st.st_mode)) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(g_idleMutex);
+    auto it = g_deviceFds.find(deviceNode);
+    if (it != g_deviceFds.end()) {
+        dropCachedFd(it);
+    } else if (g_deviceFds.size() >= size_t(kReusableMaxDevices)) {
+        return;
+    }
+    const int copy = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (copy < 0) {
+        return;
+    }
+    CachedFd entry;
+    entry.fd = copy;
+    entry.rdev = st.st_rdev;
+    entry.cached.start();
+    g_deviceFds.emplace(deviceNode, entry);
+}
+
+int HelperSession::cachedDeviceFd(const QString& deviceNode)
+{
+    std::lock_guard<std::mutex> lock(g_idleMutex);
+    auto it = g_deviceFds.find(deviceNode);
+    if (it == g_deviceFds.end()) {
+        return -1;
+    }
+    struct stat st;
+    if (it->second.cached.elapsed() >= qint64(kReusableMaxSeconds) * 1000
+        || stat(QFile::encodeName(deviceNode).constData(), &st) != 0 || !S_ISBLK(st.st_mode)
+        || st.st_rdev != it->second.rdev) {
+        dropCachedFd(it);
+        return -1;
+    }
+    // dup()s share the file offset; the read loops start wherever it was left.
+    const int fd = fcntl(it->second.fd, F_DUPFD_CLOEXEC, 0);
+    if (fd >= 0) {
+        lseek(fd, 0, SEEK_SET);
+    }
+    return fd;
+}
+
+void HelperSession::forgetDevice(const QString& deviceNode)
+{
+    std::lock_guard<std::mutex> lock(g_idleMutex);
+    auto it = g_deviceFds.find(deviceNode);
+    if (it != g_deviceFds.end()) {
+        dropCachedFd(it);
+    }
+}
+
+bool HelperSession::pump(int timeoutMs)
+{
+    if (m_socket < 0) {
+        return false;
+    }
+    pollfd fds[2] = {{m_socket, short(POLLIN | (m_outbox.isEmpty() ? 0 : POLLOUT)), 0},
+                     {m_stderr, POLLIN, 0}};
+    const int n = poll(fds, m_stderr >= 0 ? 2 : 1, timeoutMs);
+    if (n < 0) {
+        return errno == EINTR;
+    }
+    if (n == 0) {
+        return true;
+    }
+    if ((fds[0].revents & POLLOUT) && !flushOutbox()) {
+        return false;
+    }
+    if (m_stderr >= 0 && fds[1].revents) {
+        drainStderr();
+    }
+    if (!(fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+        return true;
+    }
+    for (;;) {
+        char chunk[64 * 1024];
+        iovec iov{chunk, sizeof(chunk)};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * 4)];
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        const ssize_t got = recvmsg(m_socket, &msg, MSG_CMSG_CLOEXEC);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+                continue;
+            }
+            const size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            for (size_t i = 0; i < count; ++i) {
+                int fd = -1;
+                std::memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                m_passedFds.push_back(fd);
+            }
+        }
+        m_inbox.append(chunk, got);
+    }
+}
+
+void HelperSession::handleHello(const HelperProtocol::Frame& frame, QString* protocolError)
+{
+    quint16 version = 0;
+    if (!HelperProtocol::decodeHello(frame.payload, &version) || version != HelperProtocol::kVersion) {
+        *protocolError = QStringLiteral(
+            "Privileged helper speaks a different protocol version; reinstall flashspartan");
+    }
+    m_helloSeen = true;
+}
+
+QString HelperSession::exitMessage()
+{
+    drainStderr();
+    shutdown();
+    QString msg = QString::fromUtf8(m_stderrText.trimmed());
+    if (msg.isEmpty()) {
+        msg = QString("Privileged hash failed (exit %1)").arg(m_exitCode);
+    }
+    return msg;
+}
+
+bool HelperSession::flushOutbox()
+{
+    while (!m_outbox.isEmpty()) {
+        const ssize_t n = send(m_socket, m_outbox.constData(), size_t(m_outbox.size()), MSG_NOSIGNAL);
+        if (n > 0) {
+            m_outbox.remove(0, n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+    return true;
+}
+
+void HelperSession::drainStderr()
+{
+    if (m_stderr < 0) {
+        return;
+    }
+    char chunk[4096];
+    for (;;) {
+        const ssize_t n = read(m_stderr, chunk, sizeof(chunk));
+        if (n > 0) {
+            if (m_stderrText.size() < kMaxStderrBytes) {
+                m_stderrText.append(chunk, n);
+            }
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            close(m_stderr);
+            m_stderr = -1;
+        }
+        return;
+    }
+}
+
+void HelperSession::shutdown()
+{
+    for (int fd : m_passedFds) {
+        close(fd);
+    }
+    m_passedFds.clear();
+    if (m_socket >= 0) {
+        // EOF on its stdin cancels a running job and ends the helper's job loop.
+        close(m_socket);
+        m_socket = -1;
+    }
+    if (m_pid > 0) {
+        m_exitCode = reap(3000);
+    }
+    drainStderr();
+    if (m_stderr >= 0) {
+        close(m_stderr);
+        m_stderr = -1;
+    }
+}
+
+int HelperSession::reap(int timeoutMs)
+{
+    QElapsedTimer timer;
+    timer.start();
+    int status = 0;
+    for (;;) {
+        const pid_t rc = waitpid(m_pid, &status, WNOHANG);
+        if (rc == m_pid) {
+            m_pid = -1;
+            return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        }
+        if (rc < 0 && errno != EINTR) {
+            m_pid = -1;
+            return -1;
+        }
+        if (timer.elapsed() >= timeoutMs) {
+            break;
+        }
+        usleep(20 * 1000);
+    }
+    // The helper runs as root, so it may not be ours to kill; reap it whenever it exits.
+    kill(m_pid, SIGKILL);
+    const pid_t pid = m_pid;
+    m_pid = -1;
+    std::thread([pid]() { waitpid(pid, nullptr, 0); }).detach();
+    return -1;
+}
+
+} // namespace FlashSpartan
+
+#endif
@@ -0,0 +1,73 @@
+#include "HidConnectCounter.h"
+
+#include <algorithm>
+
+namespace FlashSpartan {
+
+HidConnectCounter::HidConnectCounter(int maxWindowSeconds)
+{
+    setMaxWindowSeconds(maxWindowSeconds);
+}
+
+void HidConnectCounter::setMaxWindowSeconds(int seconds)
+{
+    seconds = std::clamp(seconds, 1, kMaxWindowSeconds);
+    if (seconds == m_maxWindowSeconds) {
+        return;
+    }
+    m_maxWindowSeconds = seconds;
+    // One slot more than the window, so its oldest second is still in the ring.
+    size_t size = 2;
+    while (size < size_t(seconds) + 2) {
+        size <<= 1;
+    }
+    m_mask = size - 1;
+    m_devices.clear();
+}
+
+void HidConnectCounter::record(const QString& stableId, qint64 nowSecs)
+{
+    if (m_devices.size() >= kPruneAboveDevices && !m_devices.contains(stableId)) {
+        prune(nowSecs);
+    }
+    auto it = m_devices.find(stableId);
+    if (it == m_devices.end()) {
+        Device device;
+        device.before.assign(m_mask + 1, 0);
+        device.lastSecond = nowSecs;
+        it = m_devices.insert(stableId, std::move(device));
+    } else if (nowSecs > it->lastSecond) {
+        // Seconds without a connect start at the running total; older ones wrap out anyway.
+        const qint64 ring = qint64(m_mask) + 1;
+        for (qint64 s = std::max(it->lastSecond + 1, nowSecs - ring + 1); s <= nowSecs; ++s) {
+            it->before[slot(s)] = it->total;
+        }
+        it->lastSecond = nowSecs;
+    }
+    // A clock that went back counts into the newest second.
+    ++it->total;
+}
+
+int HidConnectCounter::count(const QString& stableId, int windowSeconds, qint64 nowSecs) const
+{
+    const auto it = m_devices.constFind(stableId);
+    if (it == m_devices.cend()) {
+        return 0;
+    }
+    const Device& device = it.value();
+    qint64 from = nowSecs - std::clamp(windowSeconds, 0, m_maxWindowSeconds);
+    if (from > device.lastSecond) {
+        return 0;
+    }
+    from = std::max(from, device.lastSecond - qint64(m_mask));
+    return int(device.total - device.before[slot(from)]);
+}
+
+void HidConnectCounter::prune(qint64 nowSecs)
+{
+    m_devices.removeIf([this, nowSecs](const QHash<QString, Device>::iterator& it) {
+        return nowSecs - it->lastSecond > m_maxWindowSeconds;
+    });
+}
+
+} // namespace FlashSpartan
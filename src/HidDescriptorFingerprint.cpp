@@ -0,0 +1,110 @@
+#include "HidDescriptorFingerprint.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QtEndian>
+
+#include <algorithm>
+
+namespace FlashSpartan::HidDescriptorFingerprint {
+
+namespace {
+
+/** The leading run of whole descriptors; a zero bLength or a short tail ends it. */
+QByteArrayView wholeDescriptors(const QByteArray& raw)
+{
+    qsizetype pos = 0;
+    while (pos + 2 <= raw.size()) {
+        const auto length = qsizetype(quint8(raw.at(pos)));
+        if (length < 2 || pos + length > raw.size()) {
+            break;
+        }
+        pos += length;
+    }
+    return QByteArrayView(raw.constData(), pos);
+}
+
+void addBlock(QCryptographicHash& hash, QByteArrayView block)
+{
+    const quint32 length = qToLittleEndian(quint32(block.size()));
+    hash.addData(QByteArrayView(reinterpret_cast<const char*>(&length), sizeof(length)));
+    hash.addData(block);
+}
+
+QByteArray readFile(const QString& path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+} // namespace
+
+QByteArray compute(const QByteArray& usbDescriptors,
+                   const QList<QPair<QString, QByteArray>>& reportDescriptors)
+{
+    const QByteArrayView descriptors = wholeDescriptors(usbDescriptors);
+    if (descriptors.isEmpty()) {
+        return {};
+    }
+    QList<QPair<QString, QByteArray>> reports = reportDescriptors;
+    std::sort(reports.begin(), reports.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    hash.addData(QByteArrayView("flashspartan-hid-fingerprint-v1"));
+    addBlock(hash, descriptors);
+    for (const auto& [name, report] : reports) {
+        addBlock(hash, name.toLatin1());
+        addBlock(hash, report);
+    }
+    return hash.result();
+}
+
+QByteArray fromSysfs(const QString& usbDevicePath)
+{
+#ifdef Q_OS_LINUX
+    if (usbDevicePath.isEmpty()) {
+        return {};
+    }
+    const QDir device(usbDevicePath);
+    const QByteArray descriptors = readFile(device.filePath(QStringLiteral("descriptors")));
+    if (descriptors.isEmpty()) {
+        return {};
+    }
+    // <sysname>:<config>.<interface>/<bus>:<vid>:<pid>.<n>/report_descriptor
+    QList<QPair<QString, QByteArray>> reports;
+    const QStringList interfaces =
+        device.entryList({device.dirName() + QStringLiteral(":*")}, QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString& interfaceName : interfaces) {
+        const QDir interfaceDir(device.filePath(interfaceName));
+        const QStringList hidDevices =
+            interfaceDir.entryList({QStringLiteral("*:*:*.*")}, QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+        for (const QString& hid : hidDevices) {
+            const QByteArray report = readFile(interfaceDir.filePath(hid + QStringLiteral("/report_descriptor")));
+            if (!report.isEmpty()) {
+                reports.append({interfaceName.section(QLatin1Char(':'), 1), report});
+                break;
+            }
+        }
+    }
+    return compute(descriptors, reports);
+#else
+    Q_UNUSED(usbDevicePath);
+    return {};
+#endif
+}
+
+QByteArray fromHex(const QString& text)
+{
+    const QString trimmed = text.trimmed();
+    if (trimmed.size() != 2 * kSize) {
+        return {};
+    }
+    const bool hex = std::all_of(trimmed.cbegin(), trimmed.cend(), [](QChar c) {
+        const char16_t u = c.unicode();
+        return (u >= '0' && u <= '9') || (u >= 'a' && u <= 'f') || (u >= 'A' && u <= 'F');
+    });
+    return hex ? QByteArray::fromHex(trimmed.toLatin1()) : QByteArray();
+}
+
+} // namespace FlashSpartan::HidDescriptorFingerprint
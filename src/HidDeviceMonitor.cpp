@@ -4,16 +4,22 @@
 
 #include <QMutexLocker>
 
+#include <qt_windows.h>
+
 namespace FlashSpartan {
 
 HidDeviceMonitor::HidDeviceMonitor(QObject* parent)
     : QThread(parent)
+    , m_wakeEvent(CreateEventW(nullptr, FALSE, FALSE, nullptr))
 {
 }
 
 HidDeviceMonitor::~HidDeviceMonitor()
 {
     stopMonitoring();
+    if (m_wakeEvent) {
+        CloseHandle(m_wakeEvent);
+    }
 }
 
 void HidDeviceMonitor::startMonitoring()
@@ -31,6 +37,7 @@ void HidDeviceMonitor::stopMonitoring()
         return;
     }
     m_running.store(false);
+    SetEvent(m_wakeEvent);
     wait(3000);
 }
 
@@ -54,10 +61,12 @@ std::optional<HidDeviceInfo> HidDeviceMonitor::getDevice(const QString& stableId
 
 #else
 
+#include "HidDescriptorFingerprint.h"
+#include "UdevEventTrace.h"
+#include "UdevReactor.h"
+#include "UdevText.h"
+
 #include <libudev.h>
-#include <fcntl.h>
-#include <poll.h>
-#include <unistd.h>
 
 #include <QDebug>
 #include <QMutexLocker>
@@ -65,20 +74,34 @@ std::optional<HidDeviceInfo> HidDeviceMonitor::getDevice(const QString& stableId
 
 namespace FlashSpartan {
 
+namespace {
+
+template <typename Device>
+QString sysAttrString(Device dev, const char* key)
+{
+    return UdevText::toString(UdevText::sysAttr(dev, key));
+}
+
+QByteArray descriptorFingerprint(struct udev_device* usb)
+{
+    return HidDescriptorFingerprint::fromSysfs(UdevText::toString(UdevText::sysPath(usb)));
+}
+
+QByteArray descriptorFingerprint(const UdevRecord* usb)
+{
+    return usb->descriptorFingerprint;
+}
+
+} // namespace
+
 HidDeviceMonitor::HidDeviceMonitor(QObject* parent)
     : QThread(parent)
 {
-    if (pipe2(m_wakeupPipe, O_NONBLOCK | O_CLOEXEC) != 0) {
-        qWarning() << "HidDeviceMonitor: Failed to create wakeup pipe";
-        m_wakeupPipe[0] = m_wakeupPipe[1] = -1;
-    }
 }
 
 HidDeviceMonitor::~HidDeviceMonitor()
 {
     stopMonitoring();
-    if (m_wakeupPipe[0] >= 0) close(m_wakeupPipe[0]);
-    if (m_wakeupPipe[1] >= 0) close(m_wakeupPipe[1]);
 }
 
 void HidDeviceMonitor::startMonitoring()
@@ -86,8 +109,16 @@ void HidDeviceMonitor::startMonitoring()
     if (m_running.load()) {
         return;
     }
+    if (!initializeUdev()) {
+        emit monitorError(QStringLiteral("Failed to initialize HID udev monitor"));
+        return;
+    }
     m_running.store(true);
-    start(QThread::NormalPriority);
+    UdevReactor::instance().post(m_subscription, [this]() {
+        scanExistingDevices();
+        QMutexLocker locker(&m_devicesMutex);
+        emit initialScanComplete(m_devices.size());
+    });
 }
 
 void HidDeviceMonitor::stopMonitoring()
@@ -96,22 +127,15 @@ void HidDeviceMonitor::stopMonitoring()
         return;
     }
     m_running.store(false);
-    if (m_wakeupPipe[1] >= 0) {
-        char c = 'x';
-        [[maybe_unused]] const auto ret = write(m_wakeupPipe[1], &c, 1);
-    }
-    if (!wait(5000)) {
-        qWarning() << "HidDeviceMonitor: thread did not stop within timeout";
-    }
+    cleanupUdev();
 }
 
 void HidDeviceMonitor::rescan()
 {
-    m_rescanRequested.store(true);
-    if (m_wakeupPipe[1] >= 0) {
-        char c = 'r';
-        [[maybe_unused]] const auto ret = write(m_wakeupPipe[1], &c, 1);
+    if (!m_running.load()) {
+        return;
     }
+    UdevReactor::instance().post(m_subscription, [this]() { scanExistingDevices(); });
 }
 
 QList<HidDeviceInfo> HidDeviceMonitor::connectedDevices() const
@@ -132,96 +156,31 @@ std::optional<HidDeviceInfo> HidDeviceMonitor::getDevice(const QString& stableId
 
 void HidDeviceMonitor::run()
 {
-    if (!initializeUdev()) {
-        emit monitorError(QStringLiteral("Failed to initialize HID udev monitor"));
-        m_running.store(false);
-        return;
-    }
-
-    scanExistingDevices();
-    {
-        QMutexLocker locker(&m_devicesMutex);
-        emit initialScanComplete(m_devices.size());
-    }
-
-    const int udevFd = udev_monitor_get_fd(m_monitor);
-    if (udevFd < 0) {
-        emit monitorError(QStringLiteral("Failed to get HID udev monitor fd"));
-        cleanupUdev();
-        m_running.store(false);
-        return;
-    }
-
-    while (m_running.load()) {
-        if (m_rescanRequested.exchange(false)) {
-            scanExistingDevices();
-        }
-
-        struct pollfd fds[2];
-        fds[0].fd = udevFd;
-        fds[0].events = POLLIN;
-        fds[0].revents = 0;
-        fds[1].fd = m_wakeupPipe[0];
-        fds[1].events = POLLIN;
-        fds[1].revents = 0;
-
-        const int nfds = (m_wakeupPipe[0] >= 0) ? 2 : 1;
-        const int ret = poll(fds, nfds, POLL_TIMEOUT_MS);
-        if (ret < 0) {
-            if (errno == EINTR) {
-                continue;
-            }
-            emit monitorError(QStringLiteral("HID poll failed: %1").arg(strerror(errno)));
-            break;
-        }
-        if (nfds > 1 && (fds[1].revents & POLLIN)) {
-            char buf[16];
-            while (read(m_wakeupPipe[0], buf, sizeof(buf)) > 0) {}
-        }
-        if (fds[0].revents & POLLIN) {
-            struct udev_device* dev = udev_monitor_receive_device(m_monitor);
-            if (dev) {
-                processUdevEvent(dev);
-                udev_device_unref(dev);
-            }
-        }
-    }
-
-    cleanupUdev();
+    // Unused on Linux: events are delivered on the shared UdevReactor thread.
 }
 
 bool HidDeviceMonitor::initializeUdev()
 {
-    m_udev = udev_new();
-    if (!m_udev) {
-        return false;
-    }
-    m_monitor = udev_monitor_new_from_netlink(m_udev, "udev");
-    if (!m_monitor) {
-        udev_unref(m_udev);
-        m_udev = nullptr;
-        return false;
-    }
-    if (udev_monitor_filter_add_match_subsystem_devtype(m_monitor, "input", nullptr) < 0) {
-        qWarning() << "HidDeviceMonitor: Failed to add input subsystem filter";
-    }
-    if (udev_monitor_enable_receiving(m_monitor) < 0) {
-        cleanupUdev();
+    UdevReactor& reactor = UdevReactor::instance();
+    // Every input device is tagged by the shipped rule, so the block subscription's tag
+    // filter can go to the kernel without hiding anything from us
+    m_subscription = reactor.subscribe(
+        "input", nullptr, [this](struct udev_device* dev) { processUdevEvent(dev); },
+        UdevReactor::rulesInstalled() ? UdevReactor::kInputTag : nullptr);
+    if (m_subscription < 0) {
         return false;
     }
+    m_udev = reactor.context();
     return true;
 }
 
 void HidDeviceMonitor::cleanupUdev()
 {
-    if (m_monitor) {
-        udev_monitor_unref(m_monitor);
-        m_monitor = nullptr;
-    }
-    if (m_udev) {
-        udev_unref(m_udev);
-        m_udev = nullptr;
+    if (m_subscription >= 0) {
+        UdevReactor::instance().unsubscribe(m_subscription);
+        m_subscription = -1;
     }
+    m_udev = nullptr;
 }
 
 void HidDeviceMonitor::scanExistingDevices()
@@ -286,15 +245,28 @@ void HidDeviceMonitor::scanExistingDevices()
 }
 
 void HidDeviceMonitor::processUdevEvent(struct udev_device* dev)
+{
+    if (UdevEventTrace::recording()) {
+        UdevEventTrace::record("input", dev);
+    }
+    handleEvent(dev);
+}
+
+void HidDeviceMonitor::replayEvent(const UdevRecord& event)
+{
+    handleEvent(&event);
+}
+
+template <typename Device>
+void HidDeviceMonitor::handleEvent(Device dev)
 {
     if (!isUsbHidInput(dev)) {
         return;
     }
-    const QString action = QString::fromUtf8(udev_device_get_action(dev) ?: "");
     const HidDeviceInfo info = extractDeviceInfo(dev);
     const QString stableId = info.stableId();
 
-    if (action == QStringLiteral("remove")) {
+    if (UdevText::action(dev) == "remove") {
         {
             QMutexLocker locker(&m_devicesMutex);
             m_devices.remove(stableId);
@@ -316,65 +288,68 @@ void HidDeviceMonitor::processUdevEvent(struct udev_device* dev)
     }
 }
 
-bool HidDeviceMonitor::isUsbHidInput(struct udev_device* dev) const
+template <typename Device>
+bool HidDeviceMonitor::isUsbHidInput(Device dev) const
 {
-    if (!dev || !getUsbDeviceParent(dev)) {
+    if (!dev || !UdevText::parent(dev, "usb", "usb_device")) {
         return false;
     }
-    const QString devNode = QString::fromUtf8(udev_device_get_devnode(dev) ?: "");
-    if (!devNode.startsWith(QStringLiteral("/dev/input/event"))) {
+    // Filtered on libudev's strings; only devices that pass are converted
+    if (UdevText::devNode(dev).substr(0, 16) != "/dev/input/event") {
         return false;
     }
     const bool hasInputProp =
-        getProperty(dev, "ID_INPUT_KEYBOARD") == QStringLiteral("1")
-        || getProperty(dev, "ID_INPUT_MOUSE") == QStringLiteral("1")
-        || getProperty(dev, "ID_INPUT_TOUCHPAD") == QStringLiteral("1")
-        || getProperty(dev, "ID_INPUT_JOYSTICK") == QStringLiteral("1");
-    struct udev_device* iface = getUsbInterfaceParent(dev);
-    const QString cls = iface ? getSysAttr(iface, "bInterfaceClass") : QString();
-    return hasInputProp || cls.compare(QStringLiteral("03"), Qt::CaseInsensitive) == 0;
+        UdevText::property(dev, "ID_INPUT_KEYBOARD") == "1"
+        || UdevText::property(dev, "ID_INPUT_MOUSE") == "1"
+        || UdevText::property(dev, "ID_INPUT_TOUCHPAD") == "1"
+        || UdevText::property(dev, "ID_INPUT_JOYSTICK") == "1";
+    const auto iface = UdevText::parent(dev, "usb", "usb_interface");
+    return hasInputProp || (iface && UdevText::sysAttr(iface, "bInterfaceClass") == "03");
 }
 
-HidDeviceInfo HidDeviceMonitor::extractDeviceInfo(struct udev_device* dev) const
+template <typename Device>
+HidDeviceInfo HidDeviceMonitor::extractDeviceInfo(Device dev) const
 {
     HidDeviceInfo info;
-    info.sysPath = QString::fromUtf8(udev_device_get_syspath(dev) ?: "");
-    info.devNode = QString::fromUtf8(udev_device_get_devnode(dev) ?: "");
+    info.sysPath = UdevText::toString(UdevText::sysPath(dev));
+    info.devNode = UdevText::toString(UdevText::devNode(dev));
     info.seenAtUtc = QDateTime::currentDateTimeUtc();
 
-    struct udev_device* usb = getUsbDeviceParent(dev);
-    struct udev_device* iface = getUsbInterfaceParent(dev);
+    const auto usb = UdevText::parent(dev, "usb", "usb_device");
+    const auto iface = UdevText::parent(dev, "usb", "usb_interface");
     if (usb) {
-        info.usbPath = QString::fromUtf8(udev_device_get_syspath(usb) ?: "");
-        info.usbBus = getSysAttr(usb, "busnum");
-        info.usbPort = QString::fromUtf8(udev_device_get_sysname(usb) ?: "");
-        info.vendorId = getSysAttr(usb, "idVendor").toLower();
-        info.productId = getSysAttr(usb, "idProduct").toLower();
-        info.serial = getSysAttr(usb, "serial");
-        info.manufacturer = getSysAttr(usb, "manufacturer");
-        info.product = getSysAttr(usb, "product");
+        info.usbPath = UdevText::toString(UdevText::sysPath(usb));
+        info.usbBus = sysAttrString(usb, "busnum");
+        info.usbPort = UdevText::toString(UdevText::sysName(usb));
+        info.usbDevNum = sysAttrString(usb, "devnum");
+        info.vendorId = sysAttrString(usb, "idVendor").toLower();
+        info.productId = sysAttrString(usb, "idProduct").toLower();
+        info.serial = sysAttrString(usb, "serial");
+        info.manufacturer = sysAttrString(usb, "manufacturer");
+        info.product = sysAttrString(usb, "product");
+        info.descriptorFingerprint = descriptorFingerprint(usb);
     }
     if (iface) {
         HidInterfaceInfo hidIface;
-        hidIface.number = getSysAttr(iface, "bInterfaceNumber");
-        hidIface.interfaceClass = getSysAttr(iface, "bInterfaceClass");
-        hidIface.interfaceSubClass = getSysAttr(iface, "bInterfaceSubClass");
-        hidIface.interfaceProtocol = getSysAttr(iface, "bInterfaceProtocol");
-        hidIface.driver = QString::fromUtf8(udev_device_get_driver(iface) ?: "");
+        hidIface.number = sysAttrString(iface, "bInterfaceNumber");
+        hidIface.interfaceClass = sysAttrString(iface, "bInterfaceClass");
+        hidIface.interfaceSubClass = sysAttrString(iface, "bInterfaceSubClass");
+        hidIface.interfaceProtocol = sysAttrString(iface, "bInterfaceProtocol");
+        hidIface.driver = UdevText::toString(UdevText::driver(iface));
         info.driver = hidIface.driver;
         info.interfaces.append(hidIface);
     }
 
-    if (getProperty(dev, "ID_INPUT_KEYBOARD") == QStringLiteral("1")) {
+    if (UdevText::property(dev, "ID_INPUT_KEYBOARD") == "1") {
         info.capabilities.append(QStringLiteral("keyboard"));
     }
-    if (getProperty(dev, "ID_INPUT_MOUSE") == QStringLiteral("1")) {
+    if (UdevText::property(dev, "ID_INPUT_MOUSE") == "1") {
         info.capabilities.append(QStringLiteral("mouse"));
     }
-    if (getProperty(dev, "ID_INPUT_TOUCHPAD") == QStringLiteral("1")) {
+    if (UdevText::property(dev, "ID_INPUT_TOUCHPAD") == "1") {
         info.capabilities.append(QStringLiteral("touchpad"));
     }
-    if (getProperty(dev, "ID_INPUT_JOYSTICK") == QStringLiteral("1")) {
+    if (UdevText::property(dev, "ID_INPUT_JOYSTICK") == "1") {
         info.capabilities.append(QStringLiteral("joystick"));
     }
     if (info.capabilities.isEmpty()) {
@@ -384,28 +359,6 @@ HidDeviceInfo HidDeviceMonitor::extractDeviceInfo(struct udev_device* dev) const
     return info;
 }
 
-struct udev_device* HidDeviceMonitor::getUsbDeviceParent(struct udev_device* dev) const
-{
-    return udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_device");
-}
-
-struct udev_device* HidDeviceMonitor::getUsbInterfaceParent(struct udev_device* dev) const
-{
-    return udev_device_get_parent_with_subsystem_devtype(dev, "usb", "usb_interface");
-}
-
-QString HidDeviceMonitor::getProperty(struct udev_device* dev, const char* key) const
-{
-    const char* value = udev_device_get_property_value(dev, key);
-    return value ? QString::fromUtf8(value) : QString();
-}
-
-QString HidDeviceMonitor::getSysAttr(struct udev_device* dev, const char* key) const
-{
-    const char* value = udev_device_get_sysattr_value(dev, key);
-    return value ? QString::fromUtf8(value).trimmed() : QString();
-}
-
 } // namespace FlashSpartan
 
 #endif
@@ -2,6 +2,8 @@
 
 #ifdef Q_OS_WIN
 
+#include "WinDeviceNotifier.h"
+
 #include <qt_windows.h>
 
 #include <QDateTime>
@@ -16,6 +18,11 @@
 #include <cfgmgr32.h>
 #include <devpropdef.h>
 #include <devpkey.h>
+#include <usbiodef.h>
+#include <usbioctl.h>
+
+#include <string>
+#include <vector>
 
 namespace FlashSpartan {
 
@@ -126,6 +133,76 @@ QString parentUsbInstanceId(const QString& devicePath)
     return {};
 }
 
+/**
+ * USB address of @p usbInstanceId as its hub assigned it, the number USBPcap's --devices
+ * takes. Interface nodes of composite devices (&MI_xx) are resolved to the device itself.
+ */
+QString usbDeviceAddress(const QString& usbInstanceId)
+{
+    std::wstring id = usbInstanceId.toStdWString();
+    DEVINST devInst = 0;
+    if (id.empty() || CM_Locate_DevNodeW(&devInst, id.data(), CM_LOCATE_DEVNODE_NORMAL) != CR_SUCCESS) {
+        return {};
+    }
+    for (int depth = 0; depth < 4 && usbInstanceId.contains(QStringLiteral("&MI_"), Qt::CaseInsensitive); ++depth) {
+        DEVINST parent = 0;
+        wchar_t parentId[MAX_DEVICE_ID_LEN] = {};
+        if (CM_Get_Parent(&parent, devInst, 0) != CR_SUCCESS
+            || CM_Get_Device_IDW(parent, parentId, MAX_DEVICE_ID_LEN, 0) != CR_SUCCESS) {
+            return {};
+        }
+        devInst = parent;
+        if (!QString::fromWCharArray(parentId).contains(QStringLiteral("&MI_"), Qt::CaseInsensitive)) {
+            break;
+        }
+    }
+
+    ULONG port = 0;
+    DEVPROPTYPE propType = 0;
+    ULONG propSize = sizeof(port);
+    if (CM_Get_DevNode_PropertyW(devInst, &DEVPKEY_Device_Address, &propType,
+                                 reinterpret_cast<PBYTE>(&port), &propSize, 0)
+            != CR_SUCCESS
+        || propType != DEVPROP_TYPE_UINT32 || port == 0) {
+        return {};
+    }
+    DEVINST hub = 0;
+    wchar_t hubId[MAX_DEVICE_ID_LEN] = {};
+    if (CM_Get_Parent(&hub, devInst, 0) != CR_SUCCESS
+        || CM_Get_Device_IDW(hub, hubId, MAX_DEVICE_ID_LEN, 0) != CR_SUCCESS) {
+        return {};
+    }
+    ULONG listSize = 0;
+    if (CM_Get_Device_Interface_List_SizeW(&listSize, const_cast<LPGUID>(&GUID_DEVINTERFACE_USB_HUB), hubId,
+                                          CM_GET_DEVICE_INTERFACE_LIST_PRESENT)
+            != CR_SUCCESS
+        || listSize <= 1) {
+        return {};
+    }
+    std::vector<wchar_t> hubPaths(listSize);
+    if (CM_Get_Device_Interface_ListW(const_cast<LPGUID>(&GUID_DEVINTERFACE_USB_HUB), hubId, hubPaths.data(),
+                                      listSize, CM_GET_DEVICE_INTERFACE_LIST_PRESENT)
+        != CR_SUCCESS) {
+        return {};
+    }
+
+    HANDLE hubHandle = CreateFileW(hubPaths.data(), GENERIC_WRITE, FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0,
+                                   nullptr);
+    if (hubHandle == INVALID_HANDLE_VALUE) {
+        return {};
+    }
+    USB_NODE_CONNECTION_INFORMATION_EX connection{};
+    connection.ConnectionIndex = port;
+    DWORD returned = 0;
+    const BOOL ok = DeviceIoControl(hubHandle, IOCTL_USB_GET_NODE_CONNECTION_INFORMATION_EX, &connection,
+                                    sizeof(connection), &connection, sizeof(connection), &returned, nullptr);
+    CloseHandle(hubHandle);
+    if (!ok || connection.DeviceAddress == 0) {
+        return {};
+    }
+    return QString::number(connection.DeviceAddress);
+}
+
 void parseVidPidFromPath(const QString& path, QString& vendorId, QString& productId)
 {
     static const QRegularExpression re(
@@ -186,6 +263,7 @@ std::optional<HidDeviceInfo> readHidInterface(const QString& devicePath)
     info.usbPath = usbInstance.isEmpty() ? devicePath : usbInstance;
     info.usbBus = busFromInstanceId(usbInstance.isEmpty() ? devicePath : usbInstance);
     info.usbPort = info.usbPath;
+    info.usbDevNum = usbDeviceAddress(usbInstance);
 
     if (info.capabilities.isEmpty()) {
         info.capabilities.append(QStringLiteral("hid"));
@@ -276,26 +354,104 @@ void HidDeviceMonitor::scanExistingDevices()
     }
 }
 
+bool HidDeviceMonitor::interfaceArrived(const QString& devicePath)
+{
+    const std::optional<HidDeviceInfo> info = readHidInterface(devicePath);
+    if (!info) {
+        return false;  // not openable yet right after arrival
+    }
+    bool connected = false;
+    bool changed = false;
+    {
+        QMutexLocker locker(&m_devicesMutex);
+        const auto it = m_devices.constFind(info->stableId());
+        if (it == m_devices.constEnd()) {
+            connected = true;
+        } else {
+            changed = it->interfaceSignatures() != info->interfaceSignatures();
+        }
+        m_devices.insert(info->stableId(), *info);
+    }
+    if (connected) {
+        emit hidConnected(*info);
+    } else if (changed) {
+        emit hidChanged(*info);
+    }
+    return true;
+}
+
+bool HidDeviceMonitor::tracksInterface(const QString& devicePath) const
+{
+    QMutexLocker locker(&m_devicesMutex);
+    for (auto it = m_devices.constBegin(); it != m_devices.constEnd(); ++it) {
+        if (it->sysPath.compare(devicePath, Qt::CaseInsensitive) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void HidDeviceMonitor::run()
 {
+    GUID hidGuid{};
+    HidD_GetHidGuid(&hidGuid);
+    // Registered before the first scan, so an interface added during it is still reported.
+    WinDeviceNotifier notifier(hidGuid, m_wakeEvent);
     scanExistingDevices();
     {
         QMutexLocker locker(&m_devicesMutex);
         emit initialScanComplete(m_devices.size());
     }
 
+    QHash<QString, int> retries;  // arrived interfaces that could not be opened yet
     while (m_running.load()) {
-        if (m_rescanRequested.exchange(false)) {
+        DWORD timeout = INFINITE;
+        if (!notifier.isActive()) {
+            timeout = POLL_TIMEOUT_MS;
+        } else if (!retries.isEmpty()) {
+            timeout = ARRIVAL_RETRY_MS;
+        }
+        WaitForSingleObject(m_wakeEvent, timeout);
+        if (!m_running.load()) {
+            break;
+        }
+        if (m_rescanRequested.exchange(false) || !notifier.isActive()) {
+            notifier.take();  // the scan covers anything queued so far
+            retries.clear();
             scanExistingDevices();
+            continue;
+        }
+
+        bool fullScan = false;
+        for (const WinDeviceNotifier::Event& event : notifier.take()) {
+            if (event.action == WinDeviceNotifier::Action::Removal) {
+                retries.remove(event.interfacePath);
+                // A device keeps one entry for all its interfaces: re-read them all to
+                // tell a closed collection from an unplugged device.
+                fullScan = fullScan || tracksInterface(event.interfacePath);
+            } else if (!retries.contains(event.interfacePath)) {
+                retries.insert(event.interfacePath, ARRIVAL_RETRIES);
+            }
+        }
+        if (fullScan) {
+            retries.clear();
+            scanExistingDevices();
+            continue;
+        }
+        for (auto it = retries.begin(); it != retries.end();) {
+            if (interfaceArrived(it.key()) || --it.value() <= 0) {
+                it = retries.erase(it);
+            } else {
+                ++it;
+            }
         }
-        msleep(POLL_TIMEOUT_MS);
-        scanExistingDevices();
     }
 }
 
 void HidDeviceMonitor::rescan()
 {
     m_rescanRequested.store(true);
+    SetEvent(m_wakeEvent);
 }
 
 bool HidDeviceMonitor::initializeUdev()
@@ -307,35 +463,7 @@ void HidDeviceMonitor::cleanupUdev() {}
 
 void HidDeviceMonitor::processUdevEvent(struct udev_device* /*dev*/) {}
 
-bool HidDeviceMonitor::isUsbHidInput(struct udev_device* /*dev*/) const
-{
-    return false;
-}
-
-HidDeviceInfo HidDeviceMonitor::extractDeviceInfo(struct udev_device* /*dev*/) const
-{
-    return {};
-}
-
-struct udev_device* HidDeviceMonitor::getUsbDeviceParent(struct udev_device* /*dev*/) const
-{
-    return nullptr;
-}
-
-struct udev_device* HidDeviceMonitor::getUsbInterfaceParent(struct udev_device* /*dev*/) const
-{
-    return nullptr;
-}
-
-QString HidDeviceMonitor::getProperty(struct udev_device* /*dev*/, const char* /*key*/) const
-{
-    return {};
-}
-
-QString HidDeviceMonitor::getSysAttr(struct udev_device* /*dev*/, const char* /*key*/) const
-{
-    return {};
-}
+void HidDeviceMonitor::replayEvent(const UdevRecord& /*event*/) {}
 
 } // namespace FlashSpartan
 
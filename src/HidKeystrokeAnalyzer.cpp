@@ -0,0 +1,133 @@
+#include "HidKeystrokeAnalyzer.h"
+#include "UsbmonRing.h"
+
+#include <QStringList>
+
+#include <algorithm>
+#include <bit>
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr size_t kBootReportBytes = 8;
+constexpr quint8 kInterruptTransfer = 1;
+constexpr quint8 kEndpointIn = 0x80;
+constexpr quint8 kFirstKeyUsage = 0x04;  // below: no key, ErrorRollOver, POSTFail, ErrorUndefined
+constexpr quint8 kLastKeyUsage = 0xE7;
+constexpr int kMaxTrackedDevices = 256;
+constexpr qint64 kForgetIdleUs = 60 * 1000000;
+
+} // namespace
+
+QString HidKeystrokeAnalyzer::Finding::histogramText() const
+{
+    QStringList parts;
+    for (int i = 0; i < kHistogramBuckets; ++i) {
+        if (histogram[size_t(i)] == 0) {
+            continue;
+        }
+        const QString label = i == kHistogramBuckets - 1
+            ? QStringLiteral(">=%1 ms").arg(1 << i)
+            : QStringLiteral("<%1 ms").arg(1 << (i + 1));
+        parts.append(QStringLiteral("%1: %2").arg(label).arg(histogram[size_t(i)]));
+    }
+    return parts.join(QStringLiteral(", "));
+}
+
+bool HidKeystrokeAnalyzer::isBootKeyboardReport(const char* report, size_t length)
+{
+    if (length != kBootReportBytes || report[1] != 0) {
+        return false;
+    }
+    // Keys are packed from byte 2 on; a gap or a reserved usage means another report format.
+    bool ended = false;
+    for (size_t i = 2; i < kBootReportBytes; ++i) {
+        const quint8 usage = quint8(report[i]);
+        if (usage == 0) {
+            ended = true;
+        } else if (ended || usage > kLastKeyUsage) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int HidKeystrokeAnalyzer::bucketFor(qint64 intervalUs)
+{
+    const quint64 ms = quint64(std::max<qint64>(intervalUs, 0) / 1000);
+    const int bucket = ms == 0 ? 0 : int(std::bit_width(ms)) - 1;
+    return std::min(bucket, kHistogramBuckets - 1);
+}
+
+std::optional<HidKeystrokeAnalyzer::Finding> HidKeystrokeAnalyzer::feed(const UsbmonPacket& packet)
+{
+    if (packet.eventType != 'C' || packet.transferType != kInterruptTransfer
+        || !(packet.endpoint & kEndpointIn) || packet.status != 0
+        || size_t(packet.frame.size()) != UsbmonRing::kHeaderBytes + kBootReportBytes) {
+        return std::nullopt;
+    }
+    const char* report = packet.frame.constData() + UsbmonRing::kHeaderBytes;
+    if (!isBootKeyboardReport(report, kBootReportBytes)) {
+        return std::nullopt;
+    }
+
+    const qint64 now = packet.timestampUs;
+    if (m_devices.size() >= kMaxTrackedDevices) {
+        m_devices.removeIf([now](const QHash<quint32, DeviceState>::iterator& it) {
+            return now - it.value().lastDownUs > kForgetIdleUs;
+        });
+    }
+    DeviceState& state = m_devices[(quint32(packet.bus) << 8) | packet.device];
+
+    int downs = 0;
+    std::array<quint8, 6> keys{};
+    for (size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = quint8(report[i + 2]);
+        if (keys[i] >= kFirstKeyUsage
+            && std::find(state.keys.cbegin(), state.keys.cend(), keys[i]) == state.keys.cend()) {
+            ++downs;
+        }
+    }
+    state.keys = keys;
+
+    std::optional<Finding> finding;
+    for (int d = 0; d < downs; ++d) {
+        if (state.lastDownUs != 0) {
+            const qint64 interval = now - state.lastDownUs;
+            if (interval > kRearmIdleUs) {
+                state.downCount = 0;
+                state.alerted = false;
+            }
+            ++state.histogram[size_t(bucketFor(interval))];
+        }
+        state.downs[size_t(state.downCount % kWindowKeys)] = now;
+        ++state.downCount;
+        if (state.downCount >= 2 * kWindowKeys) {
+            state.downCount -= kWindowKeys;  // same slot order, no overflow
+        }
+        state.lastDownUs = now;
+
+        if (state.alerted || state.downCount < kWindowKeys) {
+            continue;
+        }
+        // After the increment the slot at downCount % kWindowKeys holds the oldest key-down.
+        const qint64 span = now - state.downs[size_t(state.downCount % kWindowKeys)];
+        if (span * kMaxHumanKeysPerSecond >= qint64(kWindowKeys - 1) * 1000000) {
+            continue;
+        }
+        state.alerted = true;
+        Finding f;
+        f.bus = packet.bus;
+        f.device = packet.device;
+        f.timestampUs = now;
+        f.keys = kWindowKeys;
+        f.spanUs = span;
+        f.keysPerSecond = span > 0 ? double(kWindowKeys - 1) * 1e6 / double(span) : 1e6;
+        f.histogram = state.histogram;
+        finding = f;
+    }
+    return finding;
+}
+
+} // namespace FlashSpartan
@@ -0,0 +1,323 @@
+#include "ImageFlasher.h"
+
+#include "CloneVerify.h"
+#include "IoBufferPool.h"
+#include "IsoVerifier.h"
+#include "RawDeviceHashAdvanced.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace FlashSpartan {
+
+namespace {
+
+#ifdef Q_OS_LINUX
+
+/**
+ * Writes a stream to the disk from offset 0 through an aligned staging buffer, so an
+ * O_DIRECT descriptor only ever sees whole, aligned writes. The unaligned tail goes through
+ * the page cache with O_DIRECT cleared.
+ */
+class StagedWriter {
+public:
+    static constexpr size_t kStagingBytes = 8 * 1024 * 1024;
+    static constexpr size_t kAlignment = IoBufferPool::kAlignment;
+
+    StagedWriter(int fd, bool direct, std::atomic<uint64_t>* written)
+        : m_fd(fd)
+        , m_direct(direct)
+        , m_written(written)
+        , m_staging(kStagingBytes)
+        , m_buffer(m_staging.data())
+    {
+        if (!m_buffer) {
+            m_error = QStringLiteral("Failed to allocate the write buffer");
+        }
+    }
+
+    StagedWriter(const StagedWriter&) = delete;
+    StagedWriter& operator=(const StagedWriter&) = delete;
+
+    bool write(const char* data, size_t length)
+    {
+        while (length > 0 && m_error.isEmpty()) {
+            const size_t n = qMin(length, kStagingBytes - m_fill);
+            std::memcpy(m_buffer + m_fill, data, n);
+            m_fill += n;
+            data += n;
+            length -= n;
+            if (m_fill == kStagingBytes && writeOut(m_buffer, m_fill)) {
+                m_fill = 0;
+            }
+        }
+        return m_error.isEmpty();
+    }
+
+    /** Writes what is staged and syncs the disk. */
+    bool finish()
+    {
+        if (!m_error.isEmpty()) {
+            return false;
+        }
+        const size_t aligned = m_direct ? m_fill & ~(kAlignment - 1) : m_fill;
+        if (aligned > 0 && !writeOut(m_buffer, aligned)) {
+            return false;
+        }
+        if (aligned < m_fill) {
+            const int flags = fcntl(m_fd, F_GETFL);
+            if (flags < 0 || fcntl(m_fd, F_SETFL, flags & ~O_DIRECT) != 0) {
+                m_error = QString::fromLocal8Bit(std::strerror(errno));
+                return false;
+            }
+            if (!writeOut(m_buffer + aligned, m_fill - aligned)) {
+                return false;
+            }
+        }
+        m_fill = 0;
+        if (fsync(m_fd) != 0) {
+            m_error = QString::fromLocal8Bit(std::strerror(errno));
+            return false;
+        }
+        // The read back must come from the disk, not from pages the tail left behind.
+        posix_fadvise(m_fd, 0, 0, POSIX_FADV_DONTNEED);
+        return true;
+    }
+
+    const QString& errorString() const { return m_error; }
+
+private:
+    bool writeOut(const char* data, size_t length)
+    {
+        while (length > 0) {
+            const ssize_t n = pwrite(m_fd, data, length, static_cast<off_t>(m_offset));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                m_error = n < 0 ? QString::fromLocal8Bit(std::strerror(errno))
+                                : QStringLiteral("The disk accepted no more data at byte %1").arg(m_offset);
+                return false;
+            }
+            m_offset += static_cast<uint64_t>(n);
+            data += n;
+            length -= static_cast<size_t>(n);
+            if (m_written) {
+                m_written->store(m_offset);
+            }
+        }
+        return true;
+    }
+
+    int m_fd;
+    bool m_direct;
+    std::atomic<uint64_t>* m_written;
+    IoBufferPool::Buffer m_staging;
+    char* m_buffer = nullptr;
+    size_t m_fill = 0;
+    uint64_t m_offset = 0;
+    QString m_error;
+};
+
+#endif
+
+} // namespace
+
+bool ImageFlasher::isCompressedImage(const QString& path)
+{
+    static const char* const kSuffixes[] = {".xz", ".zst", ".gz", ".zip", ".bz2", ".7z"};
+    for (const char* suffix : kSuffixes) {
+        if (path.endsWith(QLatin1String(suffix), Qt::CaseInsensitive)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QString ImageFlasher::targetRefusal(const Options& options, uint64_t imageBytes,
+                                   const RawDeviceHash::DeviceAttachment& target)
+{
+    const QString imageName = QFileInfo(options.imagePath).fileName();
+    if (isCompressedImage(options.imagePath)) {
+        return QStringLiteral("%1 is compressed; decompress it before flashing.").arg(imageName);
+    }
+    if (imageBytes == 0) {
+        return QStringLiteral("%1 is empty.").arg(imageName);
+    }
+    if (target.isPartition) {
+        return QStringLiteral("%1 is a partition; flash the whole disk.").arg(options.deviceNode);
+    }
+    const QString refused = RawDeviceHash::externalDiskRefusal(target, options.allowFixedDisk);
+    if (!refused.isEmpty()) {
+        return QStringLiteral("Refusing to write %1: %2.").arg(options.deviceNode, refused);
+    }
+    if (target.sizeBytes > 0 && target.sizeBytes < imageBytes) {
+        return QStringLiteral("%1 (%2 bytes) does not fit on %3 (%4 bytes).")
+            .arg(imageName)
+            .arg(imageBytes)
+            .arg(options.deviceNode)
+            .arg(target.sizeBytes);
+    }
+    return QString();
+}
+
+ImageFlasher::Result ImageFlasher::flash(const Options& options)
+{
+    Result result;
+    result.imagePath = options.imagePath;
+    result.deviceNode = options.deviceNode;
+
+#ifndef Q_OS_LINUX
+    result.errorMessage = QStringLiteral("Flashing is only supported on Linux.");
+    return result;
+#else
+    const QFileInfo image(options.imagePath);
+    if (!image.isFile()) {
+        result.errorMessage = QStringLiteral("Image not found: %1").arg(options.imagePath);
+        return result;
+    }
+    result.imageBytes = static_cast<uint64_t>(image.size());
+    if (isCompressedImage(options.imagePath) || result.imageBytes == 0) {
+        result.errorMessage = targetRefusal(options, result.imageBytes, {});
+        return result;
+    }
+
+    const QString disk = QFileInfo(options.deviceNode).canonicalFilePath();
+    if (!disk.startsWith(QStringLiteral("/dev/"))) {
+        result.errorMessage = QStringLiteral("%1 is not a device node.").arg(options.deviceNode);
+        return result;
+    }
+    result.errorMessage = targetRefusal(options, result.imageBytes, RawDeviceHash::deviceAttachment(disk));
+    if (!result.errorMessage.isEmpty()) {
+        return result;
+    }
+
+    // O_EXCL on a block device fails with EBUSY while it or one of its partitions is mounted.
+    const QByteArray encoded = QFile::encodeName(disk);
+    bool direct = true;
+    int fd = ::open(encoded.constData(), O_WRONLY | O_EXCL | O_CLOEXEC | O_DIRECT);
+    if (fd < 0 && errno == EINVAL) {
+        direct = false;
+        fd = ::open(encoded.constData(), O_WRONLY | O_EXCL | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        result.errorMessage = errno == EBUSY
+            ? QStringLiteral("%1 is in use; unmount it first.").arg(options.deviceNode)
+            : QStringLiteral("Cannot open %1 for writing: %2")
+                  .arg(options.deviceNode, QString::fromLocal8Bit(std::strerror(errno)));
+        return result;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISBLK(st.st_mode)) {
+        ::close(fd);
+        result.errorMessage = QStringLiteral("%1 is not a block device.").arg(options.deviceNode);
+        return result;
+    }
+    const uint64_t capacity = RawDeviceHash::deviceSize(fd, disk);
+    if (capacity < result.imageBytes) {
+        ::close(fd);
+        result.errorMessage = QStringLiteral("%1 (%2 bytes) does not fit on %3 (%4 bytes).")
+                                  .arg(image.fileName())
+                                  .arg(result.imageBytes)
+                                  .arg(options.deviceNode)
+                                  .arg(capacity);
+        return result;
+    }
+
+    // The verify's single read of the image feeds the digest, the disk and the block digests.
+    StagedWriter writer(fd, direct, options.bytesWritten);
+    RawDeviceHash::BlockStreamHasher blocks(options.algorithm);
+    QString writeError;
+    IsoVerifyOptions verifyOptions = IsoVerifier::verifyOptions();
+    verifyOptions.verifyDecompressed = false;
+    verifyOptions.verifyDdImages = false;
+    verifyOptions.cancelled = options.cancelled;
+    verifyOptions.imageDataRead = [&](const char* data, size_t length) {
+        if (options.cancelled && options.cancelled->load()) {
+            writeError = QStringLiteral("Cancelled");
+        } else if (!writer.write(data, length)) {
+            writeError = writer.errorString();
+        } else if (!blocks.update(data, length)) {
+            writeError = QStringLiteral("Block digest update failed");
+        }
+        return writeError.isEmpty();
+    };
+
+    QElapsedTimer timer;
+    timer.start();
+    {
+        const IsoVerifier::OptionsScope scope(verifyOptions);
+        result.image = IsoVerifier::verifyIso(options.imagePath);
+    }
+    if (writeError.isEmpty() && blocks.bytes() != result.imageBytes) {
+        writeError = result.image.errorMessage.isEmpty()
+            ? QStringLiteral("the image changed size while it was read")
+            : result.image.errorMessage;
+    }
+    if (writeError.isEmpty() && !writer.finish()) {
+        writeError = writer.errorString();
+    }
+    if (writeError.isEmpty() && !blocks.finish()) {
+        writeError = QStringLiteral("Block digest finalization failed");
+    }
+    ::close(fd);
+    result.writeMs = static_cast<uint64_t>(timer.elapsed());
+    if (!writeError.isEmpty()) {
+        result.errorMessage = QStringLiteral("Writing %1 failed: %2").arg(options.deviceNode, writeError);
+        return result;
+    }
+    result.blockHashes = blocks.blockHashes();
+    result.blockHash = blocks.hash();
+
+    HashResult written;
+    written.success = true;
+    written.hash = result.blockHash;
+    written.blockHashes = result.blockHashes;
+    timer.restart();
+    result.readBack = CloneVerify::hashClone(disk, written, result.imageBytes, options.algorithm, options.cancelled,
+                                             options.bytesVerified);
+    result.readBack.durationMs = static_cast<uint64_t>(timer.elapsed());
+    result.verifyMs = result.readBack.durationMs;
+
+    const CloneVerify::CloneVerdict readBack = CloneVerify::judgeClone(written, result.readBack);
+    if (readBack.verdict == CloneVerify::Verdict::Error) {
+        result.errorMessage = QStringLiteral("Reading %1 back failed: %2")
+                                  .arg(options.deviceNode, result.readBack.errorMessage);
+        return result;
+    }
+    if (readBack.verdict == CloneVerify::Verdict::Mismatch) {
+        result.firstBadBlock = readBack.firstBadBlock;
+        result.errorMessage =
+            QStringLiteral("%1 reads back differently from what was written, from %2 MiB on.")
+                .arg(options.deviceNode)
+                .arg(static_cast<uint64_t>(readBack.firstBadBlock) * RawDeviceHash::kDefaultChunkBytes
+                     / (1024 * 1024));
+        return result;
+    }
+
+    if (!result.image.passed()) {
+        result.errorMessage = result.image.errorMessage.isEmpty()
+            ? QStringLiteral("The image failed verification; the disk holds it as read.")
+            : result.image.errorMessage;
+        return result;
+    }
+    if (!result.imageVerified() && !options.allowUnverifiedImage) {
+        result.errorMessage = QStringLiteral("No published or trusted hash to check %1 against.").arg(image.fileName());
+        return result;
+    }
+    result.success = true;
+    return result;
+#endif
+}
+
+} // namespace FlashSpartan
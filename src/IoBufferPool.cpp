@@ -0,0 +1,278 @@
+#include "IoBufferPool.h"
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#ifdef Q_OS_WIN
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace FlashSpartan::IoBufferPool {
+
+namespace {
+
+struct Block {
+    char* data = nullptr;
+    std::size_t capacity = 0;
+    bool mapped = false;
+    bool huge = false;
+};
+
+struct Pool {
+    std::mutex mutex;
+    std::map<std::size_t, std::vector<Block>> idle;  // by capacity
+    std::size_t idleBytes = 0;
+    std::atomic<HugePages> hugePages{HugePages::Off};
+    std::atomic<uint64_t> allocations{0};
+    std::atomic<uint64_t> reuses{0};
+    std::atomic<uint64_t> hugePageBytes{0};
+};
+
+Pool& pool()
+{
+    // Never destroyed: buffers may still be returned by threads that outlive static teardown.
+    static Pool* p = new Pool;
+    return *p;
+}
+
+std::size_t capacityFor(std::size_t bytes)
+{
+    std::size_t capacity = kMinBufferBytes;
+    while (capacity < bytes) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+#ifdef Q_OS_LINUX
+bool wantsHugePages(std::size_t capacity, HugePages mode)
+{
+    return mode != HugePages::Off && capacity >= kHugePageBytes;
+}
+#endif
+
+char* allocAligned(std::size_t capacity, std::size_t alignment)
+{
+#ifdef Q_OS_WIN
+    return static_cast<char*>(_aligned_malloc(capacity, alignment));
+#else
+    void* ptr = nullptr;
+    return posix_memalign(&ptr, alignment, capacity) == 0 ? static_cast<char*>(ptr) : nullptr;
+#endif
+}
+
+Block allocate(std::size_t capacity, HugePages mode)
+{
+    Block block;
+    block.capacity = capacity;
+#ifdef Q_OS_LINUX
+    if (wantsHugePages(capacity, mode)) {
+        pool().hugePageBytes.fetch_add(capacity, std::memory_order_relaxed);
+        block.huge = true;
+        if (mode == HugePages::Explicit) {
+            // Power-of-two capacities from 2 MiB up are whole huge pages.
+            void* mapped = mmap(nullptr, capacity, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (mapped != MAP_FAILED) {
+                block.data = static_cast<char*>(mapped);
+                block.mapped = true;
+                return block;
+            }
+        }
+        block.data = allocAligned(capacity, kHugePageBytes);
+        if (block.data) {
+            madvise(block.data, capacity, MADV_HUGEPAGE);
+        }
+        return block;
+    }
+#else
+    Q_UNUSED(mode);
+#endif
+    block.data = allocAligned(capacity, kAlignment);
+    return block;
+}
+
+void freeBlock(const Block& block)
+{
+    if (!block.data) {
+        return;
+    }
+#ifdef Q_OS_WIN
+    _aligned_free(block.data);
+#else
+    if (block.mapped) {
+        munmap(block.data, block.capacity);
+    } else {
+        std::free(block.data);
+    }
+#endif
+}
+
+void forgetHugePages(const Block& block)
+{
+    if (block.huge) {
+        pool().hugePageBytes.fetch_sub(block.capacity, std::memory_order_relaxed);
+    }
+}
+
+} // namespace
+
+void setHugePages(HugePages mode)
+{
+#ifdef Q_OS_LINUX
+    pool().hugePages.store(mode);
+#else
+    Q_UNUSED(mode);
+#endif
+}
+
+HugePages hugePages()
+{
+    return pool().hugePages.load();
+}
+
+HugePages hugePagesFromName(const QString& name)
+{
+    if (name.compare(QLatin1String("transparent"), Qt::CaseInsensitive) == 0) {
+        return HugePages::Transparent;
+    }
+    if (name.compare(QLatin1String("explicit"), Qt::CaseInsensitive) == 0) {
+        return HugePages::Explicit;
+    }
+    return HugePages::Off;
+}
+
+QString hugePagesName(HugePages mode)
+{
+    switch (mode) {
+        case HugePages::Transparent: return QStringLiteral("transparent");
+        case HugePages::Explicit: return QStringLiteral("explicit");
+        case HugePages::Off: break;
+    }
+    return QStringLiteral("off");
+}
+
+Buffer::Buffer(std::size_t bytes)
+    : m_size(bytes)
+{
+    Pool& p = pool();
+    const std::size_t capacity = capacityFor(bytes);
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        auto it = p.idle.find(capacity);
+        if (it != p.idle.end() && !it->second.empty()) {
+            const Block block = it->second.back();
+            it->second.pop_back();
+            p.idleBytes -= block.capacity;
+            m_data = block.data;
+            m_capacity = block.capacity;
+            m_mapped = block.mapped;
+            m_huge = block.huge;
+            p.reuses.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    const Block block = allocate(capacity, p.hugePages.load());
+    if (!block.data) {
+        m_size = 0;
+        return;
+    }
+    m_data = block.data;
+    m_capacity = block.capacity;
+    m_mapped = block.mapped;
+    m_huge = block.huge;
+    p.allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+Buffer::~Buffer()
+{
+    release();
+}
+
+Buffer::Buffer(Buffer&& other) noexcept
+    : m_data(other.m_data)
+    , m_size(other.m_size)
+    , m_capacity(other.m_capacity)
+    , m_mapped(other.m_mapped)
+    , m_huge(other.m_huge)
+{
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_capacity = 0;
+}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept
+{
+    if (this != &other) {
+        release();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_capacity = other.m_capacity;
+        m_mapped = other.m_mapped;
+        m_huge = other.m_huge;
+        other.m_data = nullptr;
+        other.m_size = 0;
+        other.m_capacity = 0;
+    }
+    return *this;
+}
+
+void Buffer::release()
+{
+    if (!m_data) {
+        return;
+    }
+    const Block block{m_data, m_capacity, m_mapped, m_huge};
+    m_data = nullptr;
+    m_size = 0;
+    Pool& p = pool();
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        if (p.idleBytes + block.capacity <= kMaxIdleBytes) {
+            p.idle[block.capacity].push_back(block);
+            p.idleBytes += block.capacity;
+            return;
+        }
+    }
+    forgetHugePages(block);
+    freeBlock(block);
+}
+
+Stats stats()
+{
+    Pool& p = pool();
+    Stats s;
+    s.allocations = p.allocations.load(std::memory_order_relaxed);
+    s.reuses = p.reuses.load(std::memory_order_relaxed);
+    s.hugePageBytes = p.hugePageBytes.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(p.mutex);
+    s.idleBytes = p.idleBytes;
+    return s;
+}
+
+void trim()
+{
+    Pool& p = pool();
+    std::vector<Block> blocks;
+    {
+        std::lock_guard<std::mutex> lock(p.mutex);
+        for (auto& [capacity, list] : p.idle) {
+            blocks.insert(blocks.end(), list.begin(), list.end());
+        }
+        p.idle.clear();
+        p.idleBytes = 0;
+    }
+    for (const Block& block : blocks) {
+        forgetHugePages(block);
+        freeBlock(block);
+    }
+}
+
+} // namespace FlashSpartan::IoBufferPool
@@ -0,0 +1,178 @@
+#include "IoPriority.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#elif defined(Q_OS_LINUX)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr int kPollMs = 50;
+
+#ifdef Q_OS_LINUX
+// From linux/ioprio.h, which not every libc ships.
+constexpr int kIoprioWhoProcess = 1;  // with pid 0: the calling thread
+constexpr int kIoprioClassShift = 13;
+constexpr int kIoprioClassIdle = 3;
+#endif
+
+thread_local IoPriority::Class t_class = IoPriority::Class::Normal;
+
+std::atomic<qint64> g_limit{0};
+std::atomic<bool> g_held{false};
+QMutex g_bucketMutex;
+qint64 g_nextFreeNs = 0;
+
+qint64 clockNs()
+{
+    static const QElapsedTimer clock = []() {
+        QElapsedTimer t;
+        t.start();
+        return t;
+    }();
+    return clock.nsecsElapsed();
+}
+
+bool isCancelled(const std::atomic<bool>* cancelled)
+{
+    return cancelled && cancelled->load();
+}
+
+#ifdef Q_OS_LINUX
+QByteArray readSysValue(const QString& path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll().trimmed() : QByteArray();
+}
+#endif
+
+} // namespace
+
+IoPriority::Scope::Scope(Class ioClass)
+    : m_previous(t_class)
+{
+    if (ioClass == m_previous) {
+        return;
+    }
+    t_class = ioClass;
+    m_applied = true;
+#if defined(Q_OS_WIN)
+    SetThreadPriority(GetCurrentThread(), ioClass == Class::Background ? THREAD_MODE_BACKGROUND_BEGIN
+                                                                        : THREAD_MODE_BACKGROUND_END);
+#elif defined(Q_OS_LINUX)
+    m_savedPrio = static_cast<int>(syscall(SYS_ioprio_get, kIoprioWhoProcess, 0));
+    if (ioClass == Class::Background) {
+        syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, kIoprioClassIdle << kIoprioClassShift);
+    } else {
+        syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, 0);
+    }
+#endif
+}
+
+IoPriority::Scope::~Scope()
+{
+    if (!m_applied) {
+        return;
+    }
+    t_class = m_previous;
+#if defined(Q_OS_WIN)
+    SetThreadPriority(GetCurrentThread(), m_previous == Class::Background ? THREAD_MODE_BACKGROUND_BEGIN
+                                                                           : THREAD_MODE_BACKGROUND_END);
+#elif defined(Q_OS_LINUX)
+    if (m_savedPrio >= 0) {
+        syscall(SYS_ioprio_set, kIoprioWhoProcess, 0, m_savedPrio);
+    }
+#endif
+}
+
+IoPriority::Class IoPriority::current()
+{
+    return t_class;
+}
+
+void IoPriority::setBandwidthLimit(qint64 bytesPerSecond)
+{
+    g_limit.store(qMax<qint64>(0, bytesPerSecond));
+}
+
+qint64 IoPriority::bandwidthLimit()
+{
+    return g_limit.load();
+}
+
+void IoPriority::setHeld(bool held)
+{
+    g_held.store(held);
+}
+
+bool IoPriority::isHeld()
+{
+    return g_held.load();
+}
+
+qint64 IoPriority::reserveNs(qint64& nextFreeNs, qint64 nowNs, qint64 bytes, qint64 bytesPerSecond)
+{
+    if (bytesPerSecond <= 0 || bytes <= 0) {
+        return 0;
+    }
+    nextFreeNs = qMax(nextFreeNs, nowNs - kBurstNs)
+                 + static_cast<qint64>(static_cast<double>(bytes) * 1e9 / static_cast<double>(bytesPerSecond));
+    return qMax<qint64>(0, nextFreeNs - nowNs);
+}
+
+void IoPriority::pace(qint64 bytes, const std::atomic<bool>* cancelled)
+{
+    while (g_held.load() && !isCancelled(cancelled)) {
+        QThread::msleep(kPollMs);
+    }
+    qint64 waitNs = 0;
+    {
+        QMutexLocker lock(&g_bucketMutex);
+        waitNs = reserveNs(g_nextFreeNs, clockNs(), bytes, g_limit.load());
+    }
+    while (waitNs > 0 && !isCancelled(cancelled)) {
+        const qint64 ms = qMin<qint64>(kPollMs, (waitNs + 999'999) / 1'000'000);
+        QThread::msleep(static_cast<unsigned long>(ms));
+        waitNs -= ms * 1'000'000;
+    }
+}
+
+bool IoPriority::onBatteryPower()
+{
+#if defined(Q_OS_WIN)
+    SYSTEM_POWER_STATUS status;
+    return GetSystemPowerStatus(&status) && status.ACLineStatus == 0;
+#elif defined(Q_OS_LINUX)
+    // Desktops have no battery; a laptop on the charger has a Mains (or USB-C) supply online.
+    const QString root = QStringLiteral("/sys/class/power_supply");
+    bool discharging = false;
+    const QStringList supplies = QDir(root).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString& name : supplies) {
+        const QString base = root + QLatin1Char('/') + name + QLatin1Char('/');
+        const QByteArray type = readSysValue(base + QStringLiteral("type"));
+        if ((type == "Mains" || type == "USB") && readSysValue(base + QStringLiteral("online")) == "1") {
+            return false;
+        }
+        if (type == "Battery" && readSysValue(base + QStringLiteral("scope")) != "Device"
+            && readSysValue(base + QStringLiteral("status")) == "Discharging") {
+            discharging = true;
+        }
+    }
+    return discharging;
+#else
+    return false;
+#endif
+}
+
+} // namespace FlashSpartan
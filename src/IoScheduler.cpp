@@ -0,0 +1,181 @@
+#include "IoScheduler.h"
+#include "IoPriority.h"
+
+#include <QDeadlineTimer>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <tuple>
+#include <utility>
+
+namespace FlashSpartan {
+
+namespace {
+
+/** An Interactive task may share a lane with this many Background ones at most. */
+constexpr int kInteractiveJoin = 1;
+
+bool laneAdmits(const IoScheduler::Task& task, const IoScheduler::LaneLoad& lane)
+{
+    if (lane.running == 0) {
+        return true;
+    }
+    return task.priority == IoScheduler::Priority::Interactive && lane.running == lane.background
+           && lane.running <= kInteractiveJoin;
+}
+
+} // namespace
+
+IoScheduler::IoScheduler()
+{
+    m_ioPool.setMaxThreadCount(m_ioLimit);
+    m_cpuPool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+}
+
+IoScheduler::~IoScheduler()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_queue.clear();  // their promises finish as cancelled
+    }
+    m_ioPool.waitForDone();
+    m_cpuPool.waitForDone();
+}
+
+IoScheduler& IoScheduler::instance()
+{
+    static IoScheduler inst;
+    return inst;
+}
+
+QString IoScheduler::wholeDiskNode(const QString& deviceNode)
+{
+#ifdef Q_OS_LINUX
+    const QString name = QFileInfo(QFileInfo(deviceNode).canonicalFilePath()).fileName();
+    if (!name.isEmpty()) {
+        const QString sysPath = QFileInfo(QStringLiteral("/sys/class/block/") + name).canonicalFilePath();
+        if (!sysPath.isEmpty() && QFileInfo::exists(sysPath + QStringLiteral("/partition"))) {
+            return QStringLiteral("/dev/") + QFileInfo(QFileInfo(sysPath).absolutePath()).fileName();
+        }
+    }
+#endif
+    return deviceNode;
+}
+
+int IoScheduler::pickNext(const QList<Waiting>& waiting, const Load& load, int ioLimit, int cpuLimit)
+{
+    int best = -1;
+    std::tuple<bool, int, int> bestKey;
+    for (int i = 0; i < waiting.size(); ++i) {
+        const Task& task = waiting.at(i).task;
+        const bool io = task.pool == Pool::Io;
+        if ((io ? load.ioRunning >= ioLimit : load.cpuRunning >= cpuLimit)
+            || (!task.lane.isEmpty() && !laneAdmits(task, load.lanes.value(task.lane)))) {
+            continue;
+        }
+        const bool starved = waiting.at(i).waitedMs >= kStarvationMs;
+        const std::tuple<bool, int, int> key{!starved, starved ? 0 : int(task.priority), i};
+        if (best < 0 || key < bestKey) {
+            best = i;
+            bestKey = key;
+        }
+    }
+    return best;
+}
+
+void IoScheduler::setIoLimit(int limit)
+{
+    QMutexLocker lock(&m_mutex);
+    m_ioLimit = qMax(1, limit);
+    m_ioPool.setMaxThreadCount(m_ioLimit);
+    dispatchLocked();
+}
+
+int IoScheduler::ioLimit() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_ioLimit;
+}
+
+int IoScheduler::queuedCount() const
+{
+    QMutexLocker lock(&m_mutex);
+    return int(m_queue.size());
+}
+
+bool IoScheduler::waitForIdle(int timeoutMs)
+{
+    QDeadlineTimer deadline(timeoutMs < 0 ? QDeadlineTimer::Forever : QDeadlineTimer(timeoutMs));
+    QMutexLocker lock(&m_mutex);
+    while (!m_queue.isEmpty() || m_load.ioRunning > 0 || m_load.cpuRunning > 0) {
+        if (!m_idle.wait(&m_mutex, deadline)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void IoScheduler::enqueue(const Task& task, std::function<void()> body)
+{
+    QMutexLocker lock(&m_mutex);
+    Queued queued{task, std::move(body), {}};
+    queued.waited.start();
+    m_queue.append(std::move(queued));
+    dispatchLocked();
+}
+
+void IoScheduler::dispatchLocked()
+{
+    for (;;) {
+        QList<Waiting> waiting;
+        waiting.reserve(m_queue.size());
+        for (const Queued& queued : std::as_const(m_queue)) {
+            waiting.append({queued.task, queued.waited.elapsed()});
+        }
+        const int next = pickNext(waiting, m_load, m_ioLimit, m_cpuPool.maxThreadCount());
+        if (next < 0) {
+            return;
+        }
+        Queued queued = m_queue.takeAt(next);
+        const Task task = queued.task;
+        if (!task.lane.isEmpty()) {
+            LaneLoad& lane = m_load.lanes[task.lane];
+            ++lane.running;
+            lane.background += task.priority == Priority::Background ? 1 : 0;
+        }
+        ++(task.pool == Pool::Io ? m_load.ioRunning : m_load.cpuRunning);
+        QThreadPool& pool = task.pool == Pool::Io ? m_ioPool : m_cpuPool;
+        pool.start([this, task, body = std::move(queued.body)]() {
+            {
+                const IoPriority::Scope io(task.priority == Priority::Background || task.backgroundIo
+                                               ? IoPriority::Class::Background
+                                               : IoPriority::Class::Normal);
+                body();
+            }
+            finished(task);
+        });
+    }
+}
+
+void IoScheduler::finished(const Task& task)
+{
+    QMutexLocker lock(&m_mutex);
+    if (!task.lane.isEmpty()) {
+        auto it = m_load.lanes.find(task.lane);
+        if (it != m_load.lanes.end()) {
+            --it->running;
+            it->background -= task.priority == Priority::Background ? 1 : 0;
+            if (it->running <= 0) {
+                m_load.lanes.erase(it);
+            }
+        }
+    }
+    --(task.pool == Pool::Io ? m_load.ioRunning : m_load.cpuRunning);
+    dispatchLocked();
+    if (m_queue.isEmpty() && m_load.ioRunning == 0 && m_load.cpuRunning == 0) {
+        m_idle.wakeAll();
+    }
+}
+
+} // namespace FlashSpartan
@@ -0,0 +1,267 @@
+#include "IsoArtifactStore.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLockFile>
+#include <QMutex>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QTimeZone>
+
+#include <algorithm>
+#include <vector>
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr int kLockStaleMs = 30000;
+
+struct IndexEntry {
+    QString sha256;
+    qint64 fetchedMs = 0;
+    qint64 expiresMs = 0;
+};
+
+using Index = QHash<QString, IndexEntry>;
+
+struct State {
+    QMutex mutex;  // guards dir
+    QString dir;
+};
+
+State& state()
+{
+    static State s;
+    return s;
+}
+
+QString defaultDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+           + QStringLiteral("/iso-verify/artifacts");
+}
+
+QString currentDir()
+{
+    State& s = state();
+    QMutexLocker lock(&s.mutex);
+    return s.dir.isEmpty() ? defaultDir() : s.dir;
+}
+
+QString indexPath(const QString& dir)
+{
+    return dir + QStringLiteral("/index.json");
+}
+
+QString blobPath(const QString& dir, const QString& sha256)
+{
+    return dir + QLatin1Char('/') + sha256;
+}
+
+QString sha256Hex(const QByteArray& data)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+}
+
+Index readIndex(const QString& dir)
+{
+    Index index;
+    QFile file(indexPath(dir));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return index;
+    }
+    const QJsonObject entries =
+        QJsonDocument::fromJson(file.readAll()).object().value(QStringLiteral("entries")).toObject();
+    for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+        const QJsonObject o = it.value().toObject();
+        IndexEntry e;
+        e.sha256 = o.value(QStringLiteral("sha256")).toString();
+        e.fetchedMs = static_cast<qint64>(o.value(QStringLiteral("fetched_ms")).toDouble());
+        e.expiresMs = static_cast<qint64>(o.value(QStringLiteral("expires_ms")).toDouble());
+        if (e.sha256.size() == 64) {
+            index.insert(it.key(), e);
+        }
+    }
+    return index;
+}
+
+bool writeIndex(const QString& dir, const Index& index)
+{
+    QJsonObject entries;
+    for (auto it = index.cbegin(); it != index.cend(); ++it) {
+        QJsonObject o;
+        o.insert(QStringLiteral("sha256"), it->sha256);
+        o.insert(QStringLiteral("fetched_ms"), static_cast<double>(it->fetchedMs));
+        o.insert(QStringLiteral("expires_ms"), static_cast<double>(it->expiresMs));
+        entries.insert(it.key(), o);
+    }
+    QJsonObject root;
+    root.insert(QStringLiteral("version"), 1);
+    root.insert(QStringLiteral("entries"), entries);
+
+    QSaveFile file(indexPath(dir));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+/** Drops the oldest fetches beyond kMaxEntries, then blobs no entry points at. */
+void prune(const QString& dir, Index& index)
+{
+    if (index.size() > IsoArtifactStore::kMaxEntries) {
+        std::vector<std::pair<qint64, QString>> byAge;
+        byAge.reserve(static_cast<size_t>(index.size()));
+        for (auto it = index.cbegin(); it != index.cend(); ++it) {
+            byAge.emplace_back(it->fetchedMs, it.key());
+        }
+        std::sort(byAge.begin(), byAge.end());
+        const size_t excess = static_cast<size_t>(index.size() - IsoArtifactStore::kMaxEntries);
+        for (size_t i = 0; i < excess; ++i) {
+            index.remove(byAge[i].second);
+        }
+    }
+    QSet<QString> referenced;
+    for (const IndexEntry& e : std::as_const(index)) {
+        referenced.insert(e.sha256);
+    }
+    const QStringList blobs = QDir(dir).entryList(QDir::Files);
+    for (const QString& name : blobs) {
+        if (name.size() == 64 && !referenced.contains(name)) {
+            QFile::remove(dir + QLatin1Char('/') + name);
+        }
+    }
+}
+
+bool blobMatches(const QString& path, const QString& sha256)
+{
+    QFile blob(path);
+    return blob.open(QIODevice::ReadOnly) && sha256Hex(blob.readAll()) == sha256;
+}
+
+IsoArtifactStore::Artifact toArtifact(const QString& dir, const QString& url, const IndexEntry& e)
+{
+    IsoArtifactStore::Artifact a;
+    a.url = url;
+    a.sha256 = e.sha256;
+    a.path = blobPath(dir, e.sha256);
+    a.fetchedAt = QDateTime::fromMSecsSinceEpoch(e.fetchedMs, QTimeZone::utc());
+    if (e.expiresMs > 0) {
+        a.expiresAt = QDateTime::fromMSecsSinceEpoch(e.expiresMs, QTimeZone::utc());
+    }
+    return a;
+}
+
+} // namespace
+
+std::optional<IsoArtifactStore::Artifact> IsoArtifactStore::lookup(const QString& url)
+{
+    const QString dir = currentDir();
+    const Index index = readIndex(dir);
+    const auto it = index.constFind(url);
+    if (it == index.cend()) {
+        return std::nullopt;
+    }
+    Artifact a = toArtifact(dir, url, it.value());
+    QFile blob(a.path);
+    if (!blob.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+    a.data = blob.readAll();
+    if (sha256Hex(a.data) != a.sha256) {
+        return std::nullopt;  // truncated or altered on disk; the next put() replaces it
+    }
+    return a;
+}
+
+std::optional<IsoArtifactStore::Artifact> IsoArtifactStore::put(const QString& url, const QByteArray& data,
+                                                                const QDateTime& expiresAt)
+{
+    if (url.isEmpty() || data.isEmpty()) {
+        return std::nullopt;
+    }
+    const QString dir = currentDir();
+    if (!QDir().mkpath(dir)) {
+        return std::nullopt;
+    }
+    QLockFile fileLock(indexPath(dir) + QStringLiteral(".lock"));
+    fileLock.setStaleLockTime(kLockStaleMs);
+    if (!fileLock.tryLock(kLockStaleMs)) {
+        return std::nullopt;
+    }
+
+    IndexEntry e;
+    e.sha256 = sha256Hex(data);
+    e.fetchedMs = QDateTime::currentMSecsSinceEpoch();
+    e.expiresMs = expiresAt.isValid() ? expiresAt.toMSecsSinceEpoch() : 0;
+
+    const QString path = blobPath(dir, e.sha256);
+    if (!blobMatches(path, e.sha256)) {
+        QSaveFile blob(path);
+        if (!blob.open(QIODevice::WriteOnly)) {
+            return std::nullopt;
+        }
+        blob.write(data);
+        if (!blob.commit()) {
+            return std::nullopt;
+        }
+        QFile::setPermissions(path, QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+    }
+
+    Index index = readIndex(dir);
+    index.insert(url, e);
+    prune(dir, index);
+    if (!writeIndex(dir, index)) {
+        return std::nullopt;
+    }
+    Artifact a = toArtifact(dir, url, e);
+    a.data = data;
+    return a;
+}
+
+QDateTime IsoArtifactStore::expiryFor(bool rollingRelease, const QDateTime& serverExpires,
+                                      const QDateTime& now)
+{
+    if (!rollingRelease) {
+        return now.addSecs(kPinnedReleaseMaxAgeSecs);
+    }
+    const QDateTime cap = now.addSecs(kRollingReleaseMaxAgeSecs);
+    if (!serverExpires.isValid()) {
+        return cap;
+    }
+    return std::min(serverExpires, cap);
+}
+
+void IsoArtifactStore::clear()
+{
+    const QString dir = currentDir();
+    QLockFile fileLock(indexPath(dir) + QStringLiteral(".lock"));
+    fileLock.setStaleLockTime(kLockStaleMs);
+    if (!fileLock.tryLock(kLockStaleMs)) {
+        return;
+    }
+    Index empty;
+    prune(dir, empty);
+    QFile::remove(indexPath(dir));
+}
+
+void IsoArtifactStore::setStorageDir(const QString& dir)
+{
+    State& s = state();
+    QMutexLocker lock(&s.mutex);
+    s.dir = dir;
+}
+
+QString IsoArtifactStore::storageDir()
+{
+    return currentDir();
+}
+
+} // namespace FlashSpartan
@@ -1,23 +1,33 @@
 #include "IsoCatalogManifest.h"
 #include "GpgUtil.h"
+#include "IsoCatalogInternal.h"
+#include "IsoHttpClient.h"
+#include "OpenPgpVerifier.h"
+#include "PerfMetrics.h"
 
+#include <QCoreApplication>
 #include <QCryptographicHash>
+#include <QDataStream>
 #include <QDateTime>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
-#include <QNetworkRequest>
+#include <QMutex>
+#include <QPromise>
 #include <QRegularExpression>
+#include <QSaveFile>
+#include <QSet>
 #include <QStandardPaths>
-#include <QEventLoop>
 #include <QProcess>
 #include <QTemporaryDir>
-#include <QTimer>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <memory>
 
 namespace FlashSpartan {
 
@@ -35,18 +45,59 @@ struct ManifestEntry {
     QStringList signingKeyIds;
     QStringList trustedFingerprints;
     bool hintOnly = false;
+    bool rollingRelease = false;
     bool userTofu = false;
+    /** Pattern for the ISO 9660 volume label of a stick the image was dd-written to. */
+    QString volumeLabelPattern;
+    quint64 imageSize = 0;
+    /** SHA-256 of the image's first and last IsoPrescreen::kEdgeBytes, for the pre-screen. */
+    QString headSha256;
+    QString tailSha256;
     QRegularExpression regex;
+    QRegularExpression volumeLabelRegex;
+};
+
+/** One loaded catalog. Never changed once published, so readers need no lock while using it. */
+struct CatalogState {
+    QVector<ManifestEntry> entries;
+    /** Built once per load over entries' file patterns. */
+    IsoCatalogInternal::FileNamePatternIndex index;
+    int manifestVersion = 0;
+    QString remoteUrl;
+    bool embeddedShaOk = true;
+    bool embeddedGpgOk = true;
+    QString embeddedShaDetail;
+    QString embeddedGpgDetail;
+    bool fromSnapshot = false;
+    /** The cached remote manifest's entries, entries[remoteBegin, remoteBegin + remoteCount). */
+    int remoteBegin = 0;
+    int remoteCount = 0;
+    /** The cached remote manifest's catalog_version; 0 when it has none (no deltas). */
+    qint64 catalogVersion = 0;
+    QString deltaUrlTemplate;
 };
 
-QVector<ManifestEntry> g_entries;
-int g_manifestVersion = 0;
-QString g_remoteUrl;
-bool g_loaded = false;
-bool g_embeddedShaOk = true;
-bool g_embeddedGpgOk = true;
+/** Guards only the g_state pointer; a refresh swaps it after building its replacement. */
+QMutex g_stateMutex;
+std::shared_ptr<const CatalogState> g_state;
+/** Serializes loads, and guards what a load touches below. */
+QMutex g_loadMutex;
 QString g_embeddedShaDetail;
 QString g_embeddedGpgDetail;
+/** gpg homedirs that already hold the catalog key in this session. */
+QSet<QString> g_gpgHomesWithCatalogKey;
+QMutex g_refreshMutex;
+QFuture<bool> g_refresh;  // guarded by g_refreshMutex
+
+constexpr quint32 kSnapshotMagic = 0x46534353;  // "FSCS"
+constexpr quint32 kSnapshotFormat = 4;
+constexpr int kCatalogDeltaFormat = 1;
+
+/** One manifest document in load order, read before deciding whether it needs parsing. */
+struct ManifestSource {
+    QByteArray bytes;
+    bool userTofu = false;
+};
 
 QString manifestCachePath()
 {
@@ -54,6 +105,13 @@ QString manifestCachePath()
            + QStringLiteral("/iso-catalog-manifest.json");
 }
 
+/** Parsed, verified catalog from an earlier launch; valid only for the same source bytes. */
+QString snapshotPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+           + QStringLiteral("/iso-catalog-snapshot.bin");
+}
+
 QString userTofuPath()
 {
     const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation);
@@ -97,6 +155,11 @@ bool parseEntryObject(const QJsonObject& obj, ManifestEntry* out, bool userTofu
         }
     }
     e.hintOnly = obj.value(QStringLiteral("hint_only")).toBool(false);
+    e.rollingRelease = obj.value(QStringLiteral("rolling_release")).toBool(false);
+    e.volumeLabelPattern = obj.value(QStringLiteral("volume_label")).toString();
+    e.imageSize = static_cast<quint64>(qMax<qint64>(0, obj.value(QStringLiteral("image_size")).toInteger(0)));
+    e.headSha256 = obj.value(QStringLiteral("head_sha256")).toString().trimmed().toLower();
+    e.tailSha256 = obj.value(QStringLiteral("tail_sha256")).toString().trimmed().toLower();
     e.userTofu = userTofu;
     if (e.publisherId.isEmpty() || e.filePattern.isEmpty()) {
         return false;
@@ -105,21 +168,27 @@ bool parseEntryObject(const QJsonObject& obj, ManifestEntry* out, bool userTofu
     if (!e.regex.isValid()) {
         return false;
     }
+    if (!e.volumeLabelPattern.isEmpty()) {
+        e.volumeLabelRegex = QRegularExpression(e.volumeLabelPattern, QRegularExpression::CaseInsensitiveOption);
+        if (!e.volumeLabelRegex.isValid()) {
+            return false;
+        }
+    }
     *out = e;
     return true;
 }
 
-void mergeManifestDocument(const QJsonDocument& doc, bool prependUserTofu = false)
+void mergeManifestDocument(CatalogState& state, const QJsonDocument& doc, bool prependUserTofu = false)
 {
     if (!doc.isObject()) {
         return;
     }
     const QJsonObject root = doc.object();
-    if (g_manifestVersion == 0) {
-        g_manifestVersion = root.value(QStringLiteral("manifest_version")).toInt(0);
+    if (state.manifestVersion == 0) {
+        state.manifestVersion = root.value(QStringLiteral("manifest_version")).toInt(0);
     }
-    if (g_remoteUrl.isEmpty()) {
-        g_remoteUrl = root.value(QStringLiteral("remote_url")).toString();
+    if (state.remoteUrl.isEmpty()) {
+        state.remoteUrl = root.value(QStringLiteral("remote_url")).toString();
     }
 
     QVector<ManifestEntry> parsed;
@@ -131,9 +200,9 @@ void mergeManifestDocument(const QJsonDocument& doc, bool prependUserTofu = fals
         }
     }
     if (prependUserTofu) {
-        g_entries = parsed + g_entries;
+        state.entries = parsed + state.entries;
     } else {
-        g_entries += parsed;
+        state.entries += parsed;
     }
 }
 
@@ -218,8 +287,11 @@ bool verifyEmbeddedGpgWithPaths(const QString& gpgHome, const QString& pubPath,
     };
 
     g_embeddedGpgDetail.clear();
-    if (!runGpgInHome({QStringLiteral("--import"), QDir::toNativeSeparators(pubPath)}, nullptr)) {
-        return false;
+    if (!g_gpgHomesWithCatalogKey.contains(gpgHome)) {
+        if (!runGpgInHome({QStringLiteral("--import"), QDir::toNativeSeparators(pubPath)}, nullptr)) {
+            return false;
+        }
+        g_gpgHomesWithCatalogKey.insert(gpgHome);
     }
     return runGpgInHome({QStringLiteral("--verify"), QDir::toNativeSeparators(sigPath),
                          QDir::toNativeSeparators(manifestPath)},
@@ -247,9 +319,26 @@ bool verifyEmbeddedGpgOnDisk()
     return verifyEmbeddedGpgWithPaths(gpgHome, pubPath, sigPath, manifestPath);
 }
 
+/** The bundled key and signature need no keyserver, so this normally settles it without gpg. */
+bool verifyEmbeddedInProcess(const QByteArray& manifestBytes)
+{
+    QFile sigFile(QStringLiteral(":/iso-catalog/iso-catalog/embedded-manifest.json.asc"));
+    QFile pubFile(QStringLiteral(":/iso-catalog/iso-catalog/catalog-signing.pub"));
+    if (!sigFile.open(QIODevice::ReadOnly) || !pubFile.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    OpenPgpVerifier::KeyRing keys;
+    keys.addKeys(pubFile.readAll());
+    if (!OpenPgpVerifier::verifyDetached(keys, sigFile.readAll(), manifestBytes).good()) {
+        return false;
+    }
+    g_embeddedGpgDetail.clear();
+    return true;
+}
+
 bool verifyEmbeddedGpgSignature(const QByteArray& manifestBytes)
 {
-    if (verifyEmbeddedGpgOnDisk()) {
+    if (verifyEmbeddedInProcess(manifestBytes) || verifyEmbeddedGpgOnDisk()) {
         return true;
     }
 
@@ -267,9 +356,13 @@ bool verifyEmbeddedGpgSignature(const QByteArray& manifestBytes)
         return false;
     }
 
-    const QString scratchRoot = gpgScratchRoot() + QStringLiteral("/.flashspartan-gpg-scratch");
-    QDir().mkpath(scratchRoot);
-    QTemporaryDir temp(scratchRoot + QStringLiteral("/verify-XXXXXX"));
+    // One private scratch dir (and gpg homedir) per session; reloads only rewrite the inputs.
+    static const std::unique_ptr<QTemporaryDir> session = [] {
+        const QString scratchRoot = gpgScratchRoot() + QStringLiteral("/.flashspartan-gpg-scratch");
+        QDir().mkpath(scratchRoot);
+        return std::make_unique<QTemporaryDir>(scratchRoot + QStringLiteral("/verify-XXXXXX"));
+    }();
+    const QTemporaryDir& temp = *session;
     if (!temp.isValid()) {
         return false;
     }
@@ -298,17 +391,17 @@ bool verifyEmbeddedGpgSignature(const QByteArray& manifestBytes)
     return verifyEmbeddedGpgWithPaths(gpgHome, pubPath, sigPath, manifestPath);
 }
 
-void loadFromFile(const QString& path, bool userTofu = false)
+QByteArray readFileBytes(const QString& path)
 {
     QFile f(path);
-    if (!f.open(QIODevice::ReadOnly)) {
-        return;
-    }
-    mergeManifestDocument(QJsonDocument::fromJson(f.readAll()), userTofu);
+    return f.open(QIODevice::ReadOnly) ? f.readAll() : QByteArray();
 }
 
-void loadCatalogDropIns()
+/** Cached remote manifest, drop-ins and the user TOFU file, in merge order. */
+QList<ManifestSource> readManifestSources()
 {
+    QList<ManifestSource> sources;
+    sources.append({readFileBytes(manifestCachePath()), false});
     for (const QString& dirPath : catalogDropInDirs()) {
         QDir dir(dirPath);
         if (!dir.exists()) {
@@ -316,35 +409,364 @@ void loadCatalogDropIns()
         }
         const QStringList files = dir.entryList({QStringLiteral("*.json")}, QDir::Files, QDir::Name);
         for (const QString& name : files) {
-            loadFromFile(dir.absoluteFilePath(name));
+            sources.append({readFileBytes(dir.absoluteFilePath(name)), false});
+        }
+    }
+    sources.append({readFileBytes(userTofuPath()), true});
+    return sources;
+}
+
+/**
+ * Digest of everything a load depends on: the embedded manifest and the files its SHA-256
+ * and signature checks read, every other source's bytes, and the build.
+ */
+QByteArray snapshotKey(const QByteArray& embedded, const QList<ManifestSource>& sources)
+{
+    QCryptographicHash h(QCryptographicHash::Sha256);
+    const auto add = [&h](const QByteArray& part) {
+        h.addData(QByteArray::number(part.size()) + ':');
+        h.addData(part);
+    };
+    add(QByteArray::number(kSnapshotFormat));
+#ifdef FLASHSPARTAN_VERSION
+    add(QByteArrayLiteral(FLASHSPARTAN_VERSION));
+#endif
+    add(embedded);
+    const QString disk = gpgScratchRoot() + QStringLiteral("/resources/iso-catalog/");
+    const QString qrc = QStringLiteral(":/iso-catalog/iso-catalog/");
+    for (const QString& name : {QStringLiteral("embedded-manifest.json.sha256"),
+                                QStringLiteral("embedded-manifest.json.asc"),
+                                QStringLiteral("catalog-signing.pub")}) {
+        add(readFileBytes(disk + name));
+        add(readFileBytes(qrc + name));
+    }
+    for (const ManifestSource& source : sources) {
+        add(source.userTofu ? QByteArrayLiteral("tofu") : QByteArrayLiteral("doc"));
+        add(source.bytes);
+    }
+    return h.result();
+}
+
+/** Written only after both embedded checks passed, so a hit skips parsing and verification. */
+void writeSnapshot(const CatalogState& state, const QByteArray& key)
+{
+    const QString path = snapshotPath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_4);
+    out << kSnapshotMagic << kSnapshotFormat << key << qint32(state.manifestVersion) << state.remoteUrl
+        << qint32(state.remoteBegin) << qint32(state.remoteCount) << state.catalogVersion << state.deltaUrlTemplate
+        << qint32(state.entries.size());
+    for (const ManifestEntry& e : state.entries) {
+        out << e.publisherId << e.publisherName << e.filePattern << e.releaseLabel << e.sha256 << e.referenceUrl
+            << e.checksumUrlTemplate << e.signatureUrlTemplate << e.signingKeyIds << e.trustedFingerprints
+            << e.hintOnly << e.rollingRelease << e.userTofu << e.volumeLabelPattern << e.imageSize << e.headSha256
+            << e.tailSha256;
+    }
+    if (out.status() == QDataStream::Ok) {
+        file.commit();
+    }
+}
+
+bool loadSnapshot(CatalogState& state, const QByteArray& key)
+{
+    QFile file(snapshotPath());
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        return false;
+    }
+    const uchar* map = file.map(0, file.size());
+    if (!map) {
+        return false;
+    }
+    const QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char*>(map), file.size());
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_6_4);
+    quint32 magic = 0;
+    quint32 format = 0;
+    QByteArray storedKey;
+    in >> magic >> format >> storedKey;
+    if (in.status() != QDataStream::Ok || magic != kSnapshotMagic || format != kSnapshotFormat || storedKey != key) {
+        return false;
+    }
+    qint32 manifestVersion = 0;
+    QString remoteUrl;
+    qint32 remoteBegin = 0;
+    qint32 remoteCount = 0;
+    qint64 catalogVersion = 0;
+    QString deltaUrlTemplate;
+    qint32 count = 0;
+    in >> manifestVersion >> remoteUrl >> remoteBegin >> remoteCount >> catalogVersion >> deltaUrlTemplate >> count;
+    if (in.status() != QDataStream::Ok || count < 0 || remoteBegin < 0 || remoteCount < 0
+        || remoteBegin + remoteCount > count) {
+        return false;
+    }
+    QVector<ManifestEntry> entries;
+    entries.reserve(count);
+    for (qint32 i = 0; i < count; ++i) {
+        ManifestEntry e;
+        in >> e.publisherId >> e.publisherName >> e.filePattern >> e.releaseLabel >> e.sha256 >> e.referenceUrl
+            >> e.checksumUrlTemplate >> e.signatureUrlTemplate >> e.signingKeyIds >> e.trustedFingerprints
+            >> e.hintOnly >> e.rollingRelease >> e.userTofu >> e.volumeLabelPattern >> e.imageSize >> e.headSha256
+            >> e.tailSha256;
+        // Patterns were validated before the snapshot was written; they compile on first match.
+        e.regex = QRegularExpression(e.filePattern, QRegularExpression::CaseInsensitiveOption);
+        if (!e.volumeLabelPattern.isEmpty()) {
+            e.volumeLabelRegex =
+                QRegularExpression(e.volumeLabelPattern, QRegularExpression::CaseInsensitiveOption);
         }
+        entries.append(e);
     }
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    state.entries = entries;
+    state.manifestVersion = manifestVersion;
+    state.remoteUrl = remoteUrl;
+    state.remoteBegin = remoteBegin;
+    state.remoteCount = remoteCount;
+    state.catalogVersion = catalogVersion;
+    state.deltaUrlTemplate = deltaUrlTemplate;
+    return true;
 }
 
-void reloadAll()
+/** Reads, verifies and indexes every source; the caller holds g_loadMutex. */
+std::shared_ptr<const CatalogState> buildState()
 {
-    g_entries.clear();
-    g_manifestVersion = 0;
-    g_remoteUrl.clear();
-    g_embeddedShaOk = true;
-    g_embeddedGpgOk = true;
+    auto state = std::make_shared<CatalogState>();
     g_embeddedShaDetail.clear();
     g_embeddedGpgDetail.clear();
 
     const QByteArray bytes = loadEmbeddedManifestBytes();
-    if (!bytes.isEmpty()) {
-        g_embeddedShaOk = verifyEmbeddedSha256(bytes);
-        g_embeddedGpgOk = verifyEmbeddedGpgSignature(bytes);
-        mergeManifestDocument(QJsonDocument::fromJson(bytes));
+    const QList<ManifestSource> sources = readManifestSources();
+    const QByteArray key = snapshotKey(bytes, sources);
+    state->fromSnapshot = loadSnapshot(*state, key);
+    if (!state->fromSnapshot) {
+        if (!bytes.isEmpty()) {
+            state->embeddedShaOk = verifyEmbeddedSha256(bytes);
+            state->embeddedGpgOk = verifyEmbeddedGpgSignature(bytes);
+            state->embeddedShaDetail = g_embeddedShaDetail;
+            state->embeddedGpgDetail = g_embeddedGpgDetail;
+            mergeManifestDocument(*state, QJsonDocument::fromJson(bytes));
+        }
+        for (qsizetype i = 0; i < sources.size(); ++i) {
+            const ManifestSource& source = sources.at(i);
+            if (source.bytes.isEmpty()) {
+                continue;
+            }
+            const QJsonDocument doc = QJsonDocument::fromJson(source.bytes);
+            if (i == 0) {  // the cached remote manifest; deltas patch its entries alone
+                state->remoteBegin = int(state->entries.size());
+                state->catalogVersion = doc.object().value(QStringLiteral("catalog_version")).toInteger();
+                state->deltaUrlTemplate = doc.object().value(QStringLiteral("delta_url_template")).toString();
+            }
+            mergeManifestDocument(*state, doc, source.userTofu);
+            if (i == 0) {
+                state->remoteCount = int(state->entries.size()) - state->remoteBegin;
+            }
+        }
+        if (state->embeddedShaOk && state->embeddedGpgOk) {
+            writeSnapshot(*state, key);
+        }
     }
 
-    const QString cachePath = manifestCachePath();
-    if (QFileInfo::exists(cachePath)) {
-        loadFromFile(cachePath);
+    for (int i = 0; i < state->entries.size(); ++i) {
+        state->index.add(i, state->entries.at(i).filePattern);
+    }
+    return state;
+}
+
+void publish(std::shared_ptr<const CatalogState> state)
+{
+    QMutexLocker lock(&g_stateMutex);
+    g_state = std::move(state);
+}
+
+/** The catalog readers use; only the first call of a session waits for a load. */
+std::shared_ptr<const CatalogState> currentState()
+{
+    {
+        QMutexLocker lock(&g_stateMutex);
+        if (g_state) {
+            return g_state;
+        }
+    }
+    QMutexLocker load(&g_loadMutex);
+    {
+        QMutexLocker lock(&g_stateMutex);
+        if (g_state) {
+            return g_state;  // another thread finished the first load meanwhile
+        }
+    }
+    auto state = buildState();
+    publish(state);
+    return state;
+}
+
+/** @p url and its detached signature at @p sigUrl; empty unless the bundled catalog key made it. */
+QByteArray fetchSignedByCatalogKey(const QString& url, const QString& sigUrl)
+{
+    QString err;
+    const QByteArray body = IsoHttpClient::get(url, &err, 60000);
+    if (body.isEmpty()) {
+        return {};
+    }
+    const QByteArray sig = IsoHttpClient::get(sigUrl, &err, 60000);
+    QFile pubFile(QStringLiteral(":/iso-catalog/iso-catalog/catalog-signing.pub"));
+    if (sig.isEmpty() || !pubFile.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    OpenPgpVerifier::KeyRing keys;
+    keys.addKeys(pubFile.readAll());
+    if (!OpenPgpVerifier::verifyDetached(keys, sig, body).good()) {
+        qWarning("%s is not signed by the ISO catalog key", qPrintable(url));
+        return {};
+    }
+    return body;
+}
+
+/**
+ * @p url (the remote catalog or a delta) from the LAN mirror, or empty when none is set
+ * or its copy lacks a signature by the bundled catalog key: the mirror itself is not trusted.
+ */
+QByteArray fetchFromMirror(const QString& url)
+{
+    const QString mirrored = IsoHttpClient::mirrorUrlFor(url);
+    if (mirrored.isEmpty()) {
+        return {};
+    }
+    return fetchSignedByCatalogKey(mirrored, IsoHttpClient::mirrorUrlFor(url + QStringLiteral(".asc")));
+}
+
+/** What identifies an entry across catalog versions: a delta replaces or removes by it. */
+QString entryKey(const QString& publisherId, const QString& filePattern)
+{
+    return publisherId + QLatin1Char('\n') + filePattern;
+}
+
+QString entryKey(const QJsonObject& obj)
+{
+    return entryKey(obj.value(QStringLiteral("publisher_id")).toString(),
+                    obj.value(QStringLiteral("file_pattern")).toString());
+}
+
+/**
+ * @p current with a catalog delta applied to the cached remote manifest's entries. The
+ * other sources' entries are copied as they are, already compiled; only the delta's own
+ * entries are parsed. Null when the delta doesn't start at current's catalog_version or
+ * carries a bad entry.
+ */
+std::shared_ptr<const CatalogState> patchedState(const CatalogState& current, const QJsonObject& delta)
+{
+    if (current.catalogVersion <= 0
+        || delta.value(QStringLiteral("from_version")).toInteger() != current.catalogVersion) {
+        return nullptr;
+    }
+    QSet<QString> removed;
+    for (const QJsonValue& v : delta.value(QStringLiteral("removals")).toArray()) {
+        removed.insert(entryKey(v.toObject()));
+    }
+    QVector<ManifestEntry> remote;
+    QHash<QString, qsizetype> position;
+    for (qsizetype i = current.remoteBegin; i < current.remoteBegin + current.remoteCount; ++i) {
+        const ManifestEntry& e = current.entries.at(i);
+        const QString key = entryKey(e.publisherId, e.filePattern);
+        if (!removed.contains(key)) {
+            position.insert(key, remote.size());
+            remote.append(e);
+        }
+    }
+    for (const QJsonValue& v : delta.value(QStringLiteral("upserts")).toArray()) {
+        ManifestEntry e;
+        if (!parseEntryObject(v.toObject(), &e)) {
+            return nullptr;
+        }
+        const QString key = entryKey(e.publisherId, e.filePattern);
+        const auto it = position.constFind(key);
+        if (it != position.cend()) {
+            remote[it.value()] = e;
+        } else {
+            position.insert(key, remote.size());
+            remote.append(e);
+        }
     }
 
-    loadCatalogDropIns();
-    loadFromFile(userTofuPath(), true);
+    auto next = std::make_shared<CatalogState>(current);
+    next->entries = current.entries.mid(0, current.remoteBegin) + remote
+                    + current.entries.mid(current.remoteBegin + current.remoteCount);
+    next->remoteCount = int(remote.size());
+    next->catalogVersion = delta.value(QStringLiteral("to_version")).toInteger();
+    next->deltaUrlTemplate =
+        delta.value(QStringLiteral("delta_url_template")).toString(current.deltaUrlTemplate);
+    next->fromSnapshot = false;
+    next->index.clear();
+    for (int i = 0; i < next->entries.size(); ++i) {
+        next->index.add(i, next->entries.at(i).filePattern);
+    }
+    return next;
+}
+
+/**
+ * Brings the cached remote manifest forward with the signed delta from its catalog_version,
+ * patching the loaded catalog in place of a reload. False when there is no delta to apply
+ * (no version yet, not published, unsigned, or not from this version); the caller then
+ * downloads the whole document.
+ */
+bool refreshFromDelta()
+{
+    const auto state = currentState();
+    if (state->catalogVersion <= 0 || !state->deltaUrlTemplate.contains(QStringLiteral("{version}"))) {
+        return false;
+    }
+    QString deltaUrl = state->deltaUrlTemplate;
+    deltaUrl.replace(QStringLiteral("{version}"), QString::number(state->catalogVersion));
+    QByteArray delta = fetchFromMirror(deltaUrl);
+    if (delta.isEmpty()) {
+        delta = fetchSignedByCatalogKey(deltaUrl, deltaUrl + QStringLiteral(".asc"));
+    }
+    if (delta.isEmpty()) {
+        return false;
+    }
+
+    QMutexLocker load(&g_loadMutex);
+    {
+        QMutexLocker lock(&g_stateMutex);
+        if (g_state != state) {
+            return false;  // reloaded meanwhile; the delta may not fit any more
+        }
+    }
+    QByteArray patched;
+    QString err;
+    if (!IsoCatalogInternal::applyCatalogDelta(readFileBytes(manifestCachePath()), delta, &patched, &err)) {
+        qWarning("ISO catalog delta %s not applied: %s", qPrintable(deltaUrl), qPrintable(err));
+        return false;
+    }
+    const auto next = patchedState(*state, QJsonDocument::fromJson(delta).object());
+    if (!next) {
+        return false;
+    }
+    QSaveFile cache(manifestCachePath());
+    if (!cache.open(QIODevice::WriteOnly) || cache.write(patched) != patched.size() || !cache.commit()) {
+        return false;
+    }
+    if (next->embeddedShaOk && next->embeddedGpgOk) {
+        writeSnapshot(*next, snapshotKey(loadEmbeddedManifestBytes(), readManifestSources()));
+    }
+    publish(next);
+    return true;
+}
+
+bool remoteIsStale(int maxAgeSeconds, bool force)
+{
+    const QString cachePath = manifestCachePath();
+    if (force || !QFileInfo::exists(cachePath)) {
+        return true;
+    }
+    const qint64 age = QFileInfo(cachePath).lastModified().secsTo(QDateTime::currentDateTime());
+    return age < 0 || age >= maxAgeSeconds;
 }
 
 IsoPublisherMatch entryToMatch(const ManifestEntry& e, const QString& fileName)
@@ -356,6 +778,10 @@ IsoPublisherMatch entryToMatch(const ManifestEntry& e, const QString& fileName)
     match.isoFileName = fileName;
     match.embeddedSha256 = e.sha256;
     match.hintOnly = e.hintOnly;
+    match.rollingRelease = e.rollingRelease;
+    match.imageSizeBytes = e.imageSize;
+    match.headSha256 = e.headSha256;
+    match.tailSha256 = e.tailSha256;
     match.referenceUrl = e.referenceUrl;
     if (!e.checksumUrlTemplate.isEmpty()) {
         match.checksumUrl = e.checksumUrlTemplate;
@@ -372,57 +798,153 @@ IsoPublisherMatch entryToMatch(const ManifestEntry& e, const QString& fileName)
 
 } // namespace
 
+namespace IsoCatalogInternal {
+
+bool applyCatalogDelta(const QByteArray& manifestJson, const QByteArray& deltaJson, QByteArray* patchedOut,
+                       QString* error)
+{
+    const auto fail = [error](const QString& why) {
+        if (error) {
+            *error = why;
+        }
+        return false;
+    };
+    QJsonObject root = QJsonDocument::fromJson(manifestJson).object();
+    const QJsonObject delta = QJsonDocument::fromJson(deltaJson).object();
+    if (delta.value(QStringLiteral("delta_format")).toInt() != kCatalogDeltaFormat) {
+        return fail(QStringLiteral("unsupported delta format"));
+    }
+    const qint64 version = root.value(QStringLiteral("catalog_version")).toInteger();
+    const qint64 from = delta.value(QStringLiteral("from_version")).toInteger();
+    const qint64 to = delta.value(QStringLiteral("to_version")).toInteger();
+    if (version <= 0 || from != version || to < from) {
+        return fail(QStringLiteral("delta from version %1 to %2 does not follow version %3")
+                        .arg(from)
+                        .arg(to)
+                        .arg(version));
+    }
+
+    QSet<QString> removed;
+    for (const QJsonValue& v : delta.value(QStringLiteral("removals")).toArray()) {
+        removed.insert(entryKey(v.toObject()));
+    }
+    QJsonArray entries;
+    QHash<QString, qsizetype> position;
+    for (const QJsonValue& v : root.value(QStringLiteral("entries")).toArray()) {
+        const QString key = entryKey(v.toObject());
+        if (!removed.contains(key)) {
+            position.insert(key, entries.size());
+            entries.append(v);
+        }
+    }
+    for (const QJsonValue& v : delta.value(QStringLiteral("upserts")).toArray()) {
+        const QJsonObject obj = v.toObject();
+        ManifestEntry checked;
+        if (!parseEntryObject(obj, &checked)) {
+            return fail(QStringLiteral("invalid entry for %1").arg(obj.value(QStringLiteral("publisher_id")).toString()));
+        }
+        const QString key = entryKey(obj);
+        const auto it = position.constFind(key);
+        if (it != position.cend()) {
+            entries.replace(it.value(), v);
+        } else {
+            position.insert(key, entries.size());
+            entries.append(v);
+        }
+    }
+
+    root.insert(QStringLiteral("entries"), entries);
+    root.insert(QStringLiteral("catalog_version"), to);
+    if (delta.contains(QStringLiteral("delta_url_template"))) {
+        root.insert(QStringLiteral("delta_url_template"), delta.value(QStringLiteral("delta_url_template")));
+    }
+    *patchedOut = QJsonDocument(root).toJson(QJsonDocument::Indented);
+    return true;
+}
+
+QString lookupInManifest(const QByteArray& manifestJson, const QString& fileName, bool userTofu)
+{
+    CatalogState state;
+    mergeManifestDocument(state, QJsonDocument::fromJson(manifestJson), userTofu);
+    for (int i = 0; i < state.entries.size(); ++i) {
+        state.index.add(i, state.entries.at(i).filePattern);
+    }
+    for (int id : state.index.candidates(fileName)) {
+        const ManifestEntry& e = state.entries.at(id);
+        if (e.regex.match(fileName).hasMatch()) {
+            return e.publisherId;
+        }
+    }
+    return {};
+}
+
+} // namespace IsoCatalogInternal
+
+IsoCatalogNotifier::IsoCatalogNotifier()
+{
+    if (QCoreApplication* app = QCoreApplication::instance()) {
+        moveToThread(app->thread());
+    }
+}
+
+IsoCatalogNotifier& IsoCatalogNotifier::instance()
+{
+    static IsoCatalogNotifier notifier;
+    return notifier;
+}
+
 void IsoCatalogManifest::reload()
 {
-    g_loaded = true;
-    reloadAll();
+    QMutexLocker load(&g_loadMutex);
+    publish(buildState());
 }
 
 void IsoCatalogManifest::ensureLoaded()
 {
-    if (!g_loaded) {
-        reload();
-    }
+    currentState();
 }
 
 bool IsoCatalogManifest::lastEmbeddedIntegrityOk()
 {
-    ensureLoaded();
-    return g_embeddedShaOk && g_embeddedGpgOk;
+    const auto state = currentState();
+    return state->embeddedShaOk && state->embeddedGpgOk;
 }
 
 bool IsoCatalogManifest::lastEmbeddedSha256Ok()
 {
-    ensureLoaded();
-    return g_embeddedShaOk;
+    return currentState()->embeddedShaOk;
 }
 
 bool IsoCatalogManifest::lastEmbeddedGpgOk()
 {
-    ensureLoaded();
-    return g_embeddedGpgOk;
+    return currentState()->embeddedGpgOk;
+}
+
+bool IsoCatalogManifest::lastLoadFromSnapshot()
+{
+    return currentState()->fromSnapshot;
 }
 
 QString IsoCatalogManifest::integrityStatusText()
 {
-    ensureLoaded();
-    if (g_embeddedShaOk && g_embeddedGpgOk) {
+    const auto state = currentState();
+    if (state->embeddedShaOk && state->embeddedGpgOk) {
         return QStringLiteral("Embedded ISO catalog integrity OK (%1 manifest entries).")
-            .arg(entryCount());
+            .arg(state->entries.size());
     }
     QStringList issues;
-    if (!g_embeddedShaOk) {
-        if (g_embeddedShaDetail.isEmpty()) {
+    if (!state->embeddedShaOk) {
+        if (state->embeddedShaDetail.isEmpty()) {
             issues << QStringLiteral("SHA-256 digest mismatch");
         } else {
-            issues << g_embeddedShaDetail;
+            issues << state->embeddedShaDetail;
         }
     }
-    if (!g_embeddedGpgOk) {
-        if (g_embeddedGpgDetail.isEmpty()) {
+    if (!state->embeddedGpgOk) {
+        if (state->embeddedGpgDetail.isEmpty()) {
             issues << QStringLiteral("OpenPGP signature check failed (missing gpg or invalid signature)");
         } else {
-            issues << g_embeddedGpgDetail;
+            issues << state->embeddedGpgDetail;
         }
     }
     return QStringLiteral("Embedded catalog integrity failed: %1")
@@ -431,79 +953,121 @@ QString IsoCatalogManifest::integrityStatusText()
 
 bool IsoCatalogManifest::refreshRemoteIfStale(int maxAgeSeconds, bool force)
 {
-    ensureLoaded();
+    const QString remoteUrl = currentState()->remoteUrl;
     if (qEnvironmentVariableIsSet("FLASHSPARTAN_SKIP_REMOTE_CATALOG")) {
         return true;
     }
-    if (g_remoteUrl.isEmpty()) {
+    if (remoteUrl.isEmpty()) {
         return false;
     }
-
-    const QString cachePath = manifestCachePath();
-    if (!force && QFileInfo::exists(cachePath)) {
-        const qint64 age = QFileInfo(cachePath).lastModified().secsTo(QDateTime::currentDateTime());
-        if (age >= 0 && age < maxAgeSeconds) {
-            return true;
-        }
+    if (!remoteIsStale(maxAgeSeconds, force)) {
+        return true;
     }
 
-    QNetworkAccessManager nam;
-    QNetworkRequest req{QUrl(g_remoteUrl)};
-    req.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
-                     QNetworkRequest::NoLessSafeRedirectPolicy);
-#ifdef FLASHSPARTAN_VERSION
-    req.setHeader(QNetworkRequest::UserAgentHeader,
-                  QStringLiteral("FlashSpartan/" FLASHSPARTAN_VERSION));
-#endif
-
-    QNetworkReply* reply = nam.get(req);
-    QEventLoop loop;
-    QTimer timer;
-    timer.setSingleShot(true);
-    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-    QObject::connect(&timer, &QTimer::timeout, &loop, &QEventLoop::quit);
-    timer.start(60000);
-    loop.exec();
-
-    if (!reply->isFinished() || reply->error() != QNetworkReply::NoError) {
-        reply->deleteLater();
-        return false;
+    if (refreshFromDelta()) {
+        return true;
     }
 
-    const QByteArray body = reply->readAll();
-    reply->deleteLater();
+    QString err;
+    QByteArray body = fetchFromMirror(remoteUrl);
     if (body.isEmpty()) {
+        body = IsoHttpClient::get(remoteUrl, &err, 60000);
+    }
+    if (!err.isEmpty() || body.isEmpty()) {
         return false;
     }
 
+    const QString cachePath = manifestCachePath();
     QDir().mkpath(QFileInfo(cachePath).absolutePath());
-    QFile cache(cachePath);
+    QSaveFile cache(cachePath);
     if (cache.open(QIODevice::WriteOnly)) {
         cache.write(body);
-        cache.close();
+        cache.commit();
     }
 
+    // Lookups keep using the previous catalog until the new one is built.
     reload();
     return true;
 }
 
+QFuture<bool> IsoCatalogManifest::refreshInBackground(int maxAgeSeconds, bool force)
+{
+    QMutexLocker lock(&g_refreshMutex);
+    if (g_refresh.isRunning()) {
+        return g_refresh;
+    }
+    if (!force && (qEnvironmentVariableIsSet("FLASHSPARTAN_SKIP_REMOTE_CATALOG")
+                   || !remoteIsStale(maxAgeSeconds, force))) {
+        QPromise<bool> done;
+        done.start();
+        done.addResult(true);
+        done.finish();
+        return done.future();
+    }
+    g_refresh = QtConcurrent::run([maxAgeSeconds, force]() {
+        const bool ok = refreshRemoteIfStale(maxAgeSeconds, force);
+        emit IsoCatalogNotifier::instance().refreshFinished(ok);
+        return ok;
+    });
+    return g_refresh;
+}
+
 std::optional<IsoPublisherMatch> IsoCatalogManifest::lookup(const QString& fileName)
 {
-    ensureLoaded();
+    const auto state = currentState();
+    for (int id : state->index.candidates(fileName)) {
+        const ManifestEntry& e = state->entries.at(id);
+        if (e.regex.match(fileName).hasMatch()) {
+            PerfMetrics::cacheLookup(PerfMetrics::Cache::Catalog, true).add();
+            return entryToMatch(e, fileName);
+        }
+    }
+    PerfMetrics::cacheLookup(PerfMetrics::Cache::Catalog, false).add();
+    return std::nullopt;
+}
 
-    for (const ManifestEntry& e : g_entries) {
-        if (!e.regex.match(fileName).hasMatch()) {
+std::optional<IsoPublisherMatch> IsoCatalogManifest::lookupDdImage(const QString& volumeLabel)
+{
+    if (volumeLabel.isEmpty()) {
+        return std::nullopt;
+    }
+    const auto state = currentState();
+    for (const ManifestEntry& e : state->entries) {
+        if (e.imageSize == 0 || e.sha256.isEmpty() || e.hintOnly || e.volumeLabelPattern.isEmpty()) {
             continue;
         }
-        return entryToMatch(e, fileName);
+        if (e.volumeLabelRegex.match(volumeLabel).hasMatch()) {
+            return entryToMatch(e, QString());
+        }
     }
     return std::nullopt;
 }
 
+bool IsoCatalogManifest::isCatalogUrl(const QString& url)
+{
+    const auto state = currentState();
+    const QString target = url.endsWith(QStringLiteral(".asc")) ? url.chopped(4) : url;
+    if (!state->remoteUrl.isEmpty() && target == state->remoteUrl) {
+        return true;
+    }
+    const QString placeholder = QStringLiteral("{version}");
+    const qsizetype at = state->deltaUrlTemplate.indexOf(placeholder);
+    if (at < 0) {
+        return false;
+    }
+    const QString prefix = state->deltaUrlTemplate.left(at);
+    const QString suffix = state->deltaUrlTemplate.mid(at + placeholder.size());
+    if (target.size() <= prefix.size() + suffix.size() || !target.startsWith(prefix) || !target.endsWith(suffix)) {
+        return false;
+    }
+    const QStringView version = QStringView(target).mid(prefix.size(), target.size() - prefix.size() - suffix.size());
+    return std::all_of(version.begin(), version.end(),
+                       [](QChar c) { return c >= QLatin1Char('0') && c <= QLatin1Char('9'); });
+}
+
 int IsoCatalogManifest::entryCount()
 {
-    ensureLoaded();
-    return g_entries.size();
+    return currentState()->entries.size();
 }
 
 bool IsoCatalogManifest::trustUserHash(const QString& fileName, const QString& sha256Hex)
@@ -513,6 +1077,8 @@ bool IsoCatalogManifest::trustUserHash(const QString& fileName, const QString& s
         return false;
     }
 
+    // Held across the read-modify-write so two trusts cannot drop each other's entry.
+    QMutexLocker load(&g_loadMutex);
     QJsonArray entries;
     QFile existing(userTofuPath());
     if (existing.open(QIODevice::ReadOnly)) {
@@ -543,14 +1109,16 @@ bool IsoCatalogManifest::trustUserHash(const QString& fileName, const QString& s
     root.insert(QStringLiteral("manifest_version"), 1);
     root.insert(QStringLiteral("entries"), filtered);
 
-    QFile out(userTofuPath());
+    QSaveFile out(userTofuPath());
     if (!out.open(QIODevice::WriteOnly)) {
         return false;
     }
     out.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
-    out.close();
+    if (!out.commit()) {
+        return false;
+    }
 
-    reload();
+    publish(buildState());
     return true;
 }
 
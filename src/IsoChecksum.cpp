@@ -1,15 +1,88 @@
 #include "IsoChecksum.h"
 
-#include <QRegularExpression>
-#include <QStringList>
+#include <QMutex>
+
+#include <utility>
 
 namespace FlashSpartan {
 
 namespace {
 
-QString normalizeHash(const QString& h)
+/** `*name` (binary mode) and `./name` both list name. */
+QString listedName(QString name)
+{
+    if (name.startsWith(QLatin1Char('*'))) {
+        name = name.mid(1);
+    }
+    if (name.startsWith(QStringLiteral("./"))) {
+        name = name.mid(2);
+    }
+    return name;
+}
+
+bool namesImage(const QString& name, const QString& isoBaseName)
+{
+    return isoBaseName.isEmpty() || name == isoBaseName || name.endsWith(QLatin1Char('/') + isoBaseName);
+}
+
+bool isHex(QByteArrayView s)
+{
+    for (const char c : s) {
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))) {
+            return false;
+        }
+    }
+    return !s.isEmpty();
+}
+
+bool isTagChar(char c)
+{
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-';
+}
+
+/** Lists kept by ChecksumList::cached, most recently used first. */
+constexpr int kCachedLists = 8;
+
+bool namesBlake2List(const QString& sourceName)
 {
-    return h.trimmed().toLower();
+    const QString name = sourceName.section(QLatin1Char('/'), -1).toLower();
+    return name.contains(QStringLiteral("b2sum")) || name.contains(QStringLiteral("blake2"))
+           || name.endsWith(QStringLiteral(".b2"));
+}
+
+/** Algorithm of an untagged digest from its length; false for lengths no list uses. */
+bool algorithmForLength(qsizetype hexLength, const QString& sourceName, DigestAlgorithm* out)
+{
+    if (hexLength == 64) {
+        *out = DigestAlgorithm::Sha256;
+        return true;
+    }
+    if (hexLength == 128) {
+        *out = namesBlake2List(sourceName) ? DigestAlgorithm::Blake2b512 : DigestAlgorithm::Sha512;
+        return true;
+    }
+    return false;
+}
+
+bool algorithmForTag(const QString& tag, DigestAlgorithm* out)
+{
+    const QString t = tag.toUpper();
+    if (t == QStringLiteral("SHA256")) {
+        *out = DigestAlgorithm::Sha256;
+    } else if (t == QStringLiteral("SHA512")) {
+        *out = DigestAlgorithm::Sha512;
+    } else if (t == QStringLiteral("BLAKE2B") || t == QStringLiteral("BLAKE2B-512")
+               || t == QStringLiteral("BLAKE2B512")) {
+        *out = DigestAlgorithm::Blake2b512;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+int hexLengthFor(DigestAlgorithm algorithm)
+{
+    return algorithm == DigestAlgorithm::Sha256 ? 64 : 128;
 }
 
 } // namespace
@@ -17,54 +90,170 @@ QString normalizeHash(const QString& h)
 QString IsoChecksum::parseSha256Content(const QString& content, const QString& isoBaseName,
                                         QString* errorOut)
 {
-    if (!isoBaseName.isEmpty()) {
-        static const QRegularExpression parenRe(
-            QStringLiteral("^SHA256 \\((.+?)\\) = ([0-9a-fA-F]{64})$"),
-            QRegularExpression::CaseInsensitiveOption);
-        for (QString line : content.split(QLatin1Char('\n'), Qt::SkipEmptyParts)) {
-            line.remove(QLatin1Char('\r'));
-            const QRegularExpressionMatch m = parenRe.match(line.trimmed());
-            if (m.hasMatch() && m.captured(1) == isoBaseName) {
-                return normalizeHash(m.captured(2));
+    const Digest d = ChecksumList::parse(content.toUtf8(), QString()).find(isoBaseName, DigestAlgorithm::Sha256);
+    if (d.isEmpty() && errorOut) {
+        *errorOut = isoBaseName.isEmpty()
+            ? QStringLiteral("No valid SHA-256 checksum in file")
+            : QStringLiteral("ISO not listed in checksum file");
+    }
+    return d.hex;
+}
+
+IsoChecksum::Digest IsoChecksum::parseDigestContent(const QString& content, const QString& isoBaseName,
+                                                    const QString& sourceName, QString* errorOut)
+{
+    return ChecksumList::parse(content.toUtf8(), sourceName).find(isoBaseName, ChecksumList::kAllAlgorithms, errorOut);
+}
+
+DigestAlgorithms IsoChecksum::algorithmsForSource(const QString& sourceName)
+{
+    const QString name = sourceName.section(QLatin1Char('/'), -1).toLower();
+    if (name.contains(QStringLiteral("sha512"))) {
+        return DigestAlgorithm::Sha512;
+    }
+    if (namesBlake2List(name)) {
+        return DigestAlgorithm::Blake2b512;
+    }
+    return DigestAlgorithm::Sha256;
+}
+
+ChecksumList ChecksumList::parse(const QByteArray& content, const QString& sourceName)
+{
+    ChecksumList list;
+    QByteArrayView rest(content);
+    while (!rest.isEmpty()) {
+        const qsizetype end = rest.indexOf('\n');
+        list.addLine(end < 0 ? rest : rest.first(end), sourceName);
+        rest = end < 0 ? QByteArrayView() : rest.sliced(end + 1);
+    }
+
+    const QByteArrayView whole = QByteArrayView(content).trimmed();
+    DigestAlgorithm algorithm = DigestAlgorithm::Sha256;
+    if (isHex(whole) && algorithmForLength(whole.size(), sourceName, &algorithm)) {
+        list.m_bare.algorithm = algorithm;
+        list.m_bare.hex = QString::fromLatin1(whole).toLower();
+    }
+    return list;
+}
+
+void ChecksumList::addLine(QByteArrayView line, const QString& sourceName)
+{
+    line = line.trimmed();
+    if (line.isEmpty() || line.front() == '#') {
+        return;
+    }
+
+    // BSD: TAG (name) = hex. The name ends at the first ") = " followed only by hex.
+    qsizetype tagEnd = 0;
+    while (tagEnd < line.size() && isTagChar(line.at(tagEnd))) {
+        ++tagEnd;
+    }
+    if (tagEnd > 0 && line.sliced(tagEnd).startsWith(QByteArrayView(" ("))) {
+        const qsizetype nameStart = tagEnd + 2;
+        for (qsizetype close = line.indexOf(QByteArrayView(") = "), nameStart + 1); close >= 0;
+             close = line.indexOf(QByteArrayView(") = "), close + 1)) {
+            const QByteArrayView hex = line.sliced(close + 4);
+            if (!isHex(hex)) {
+                continue;
             }
+            DigestAlgorithm algorithm = DigestAlgorithm::Sha256;
+            if (algorithmForTag(QString::fromLatin1(line.first(tagEnd)), &algorithm)
+                && hex.size() == hexLengthFor(algorithm)) {
+                addEntry(QString::fromUtf8(line.sliced(nameStart, close - nameStart)), hex, algorithm, true);
+                return;
+            }
+            break;
         }
     }
 
-    for (QString line : content.split(QLatin1Char('\n'), Qt::SkipEmptyParts)) {
-        line.remove(QLatin1Char('\r'));
-        line = line.trimmed();
-        if (line.startsWith(QLatin1Char('#'))) {
-            continue;
-        }
-        const int space = line.indexOf(QLatin1Char(' '));
-        if (space <= 0) {
-            continue;
-        }
-        QString hash = line.left(space);
-        QString name = line.mid(space).trimmed();
-        if (name.startsWith(QLatin1Char('*'))) {
-            name = name.mid(1);
+    // GNU: hex  name (or hex *name for binary mode).
+    const qsizetype space = line.indexOf(' ');
+    if (space <= 0) {
+        return;
+    }
+    const QByteArrayView hex = line.first(space);
+    DigestAlgorithm algorithm = DigestAlgorithm::Sha256;
+    if (!isHex(hex) || !algorithmForLength(hex.size(), sourceName, &algorithm)) {
+        return;
+    }
+    addEntry(listedName(QString::fromUtf8(line.sliced(space).trimmed())), hex, algorithm, false);
+}
+
+void ChecksumList::addEntry(const QString& name, QByteArrayView hex, DigestAlgorithm algorithm, bool tagged)
+{
+    Entry e;
+    e.name = name;
+    e.digest.algorithm = algorithm;
+    e.digest.hex = QString::fromLatin1(hex).toLower();
+    e.tagged = tagged;
+    m_byBaseName[name.section(QLatin1Char('/'), -1)].append(m_entries.size());
+    m_entries.append(e);
+}
+
+IsoChecksum::Digest ChecksumList::find(const QString& isoBaseName, DigestAlgorithms accepted,
+                                       QString* errorOut) const
+{
+    if (isoBaseName.isEmpty()) {
+        for (const Entry& e : m_entries) {
+            if (!e.tagged && accepted.testFlag(e.digest.algorithm)) {
+                return e.digest;
+            }
         }
-        if (name.startsWith(QStringLiteral("./"))) {
-            name = name.mid(2);
+    } else {
+        const QList<int> ids = m_byBaseName.value(isoBaseName.section(QLatin1Char('/'), -1));
+        for (int id : ids) {
+            const Entry& e = m_entries.at(id);
+            if (e.tagged && e.name == isoBaseName && accepted.testFlag(e.digest.algorithm)) {
+                return e.digest;
+            }
         }
-        if (isoBaseName.isEmpty() || name == isoBaseName
-            || name.endsWith(QLatin1Char('/') + isoBaseName)) {
-            return normalizeHash(hash);
+        for (int id : ids) {
+            const Entry& e = m_entries.at(id);
+            if (!e.tagged && namesImage(e.name, isoBaseName) && accepted.testFlag(e.digest.algorithm)) {
+                return e.digest;
+            }
         }
     }
 
-    const QString trimmed = content.trimmed();
-    if (trimmed.size() == 64 && trimmed.indexOf(QLatin1Char(' ')) < 0) {
-        return normalizeHash(trimmed);
+    if (!m_bare.isEmpty() && accepted.testFlag(m_bare.algorithm)) {
+        return m_bare;
     }
 
     if (errorOut) {
         *errorOut = isoBaseName.isEmpty()
-            ? QStringLiteral("No valid SHA-256 checksum in file")
+            ? QStringLiteral("No valid checksum in file")
             : QStringLiteral("ISO not listed in checksum file");
     }
     return {};
 }
 
+std::shared_ptr<const ChecksumList> ChecksumList::cached(const QByteArray& content, const QString& sourceName)
+{
+    struct Slot {
+        QString sourceName;
+        QByteArray content;
+        std::shared_ptr<const ChecksumList> list;
+    };
+    static QMutex mutex;
+    static QList<Slot> recent;
+
+    {
+        QMutexLocker lock(&mutex);
+        for (qsizetype i = 0; i < recent.size(); ++i) {
+            if (recent.at(i).sourceName == sourceName && recent.at(i).content == content) {
+                recent.move(i, 0);
+                return recent.first().list;
+            }
+        }
+    }
+
+    auto list = std::make_shared<const ChecksumList>(parse(content, sourceName));
+    QMutexLocker lock(&mutex);
+    recent.prepend({sourceName, content, list});
+    if (recent.size() > kCachedLists) {
+        recent.removeLast();
+    }
+    return list;
+}
+
 } // namespace FlashSpartan
@@ -0,0 +1,180 @@
+#include "IsoFileReader.h"
+#include "FileReadAhead.h"
+#include "HashPipeline.h"
+
+#include <QByteArray>
+#include <QFile>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr qint64 kBufferedChunkBytes = 1024 * 1024;
+/** Two buffers: one is filled from the file while the consumer hashes the other. */
+constexpr int kBufferedPipelineDepth = 2;
+
+bool readBuffered(const QString& path, qint64 startOffset, const IsoFileReader::ConsumeFn& consume,
+                  QString* errorOut)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || !file.seek(startOffset)) {
+        if (errorOut) *errorOut = file.errorString();
+        return false;
+    }
+    FileReadAhead::sequential(file.handle());
+    QString error;
+    const bool ok = RawDeviceHash::runPipelined(
+        kBufferedPipelineDepth, static_cast<std::size_t>(kBufferedChunkBytes),
+        [&file](char* buffer, size_t capacity, QString* err) -> int64_t {
+            const qint64 n = file.read(buffer, static_cast<qint64>(capacity));
+            if (n < 0) {
+                *err = file.errorString();
+            }
+            return n;
+        },
+        consume, nullptr, &error);
+    if (!ok && errorOut && !error.isEmpty()) {
+        *errorOut = error;
+    }
+    return ok;
+}
+
+#ifdef Q_OS_LINUX
+
+constexpr std::size_t kStreamedChunkBytes = 8 * 1024 * 1024;
+constexpr int kPipelineDepth = 3;
+/** O_DIRECT offsets and lengths must be multiples of the logical block size; a page covers it. */
+constexpr std::size_t kDirectAlignment = 4096;
+/** Pages are dropped in batches, not per read, to keep fadvise calls rare. */
+constexpr off_t kDropBehindBytes = 32 * 1024 * 1024;
+
+class StreamedFile {
+public:
+    ~StreamedFile()
+    {
+        if (m_fd >= 0) {
+            dropBehind(true);
+            ::close(m_fd);
+        }
+    }
+
+    bool open(const QString& path, IsoReadCache mode, qint64 startOffset, QString* errorOut)
+    {
+        m_start = static_cast<off_t>(startOffset);
+        m_offset = m_start;
+        m_dropped = m_start;
+        const QByteArray encoded = QFile::encodeName(path);
+        if (mode == IsoReadCache::Direct) {
+            m_fd = ::open(encoded.constData(), O_RDONLY | O_DIRECT | O_CLOEXEC);
+            m_direct = m_fd >= 0;
+        }
+        if (m_fd < 0) {
+            m_fd = ::open(encoded.constData(), O_RDONLY | O_CLOEXEC);
+        }
+        if (m_fd < 0) {
+            if (errorOut) *errorOut = QString::fromLocal8Bit(std::strerror(errno));
+            return false;
+        }
+        if (!m_direct) {
+            posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+        return true;
+    }
+
+    /** Fills @p buffer from the cursor; short only at end of file. Runs on the reader thread. */
+    int64_t read(char* buffer, std::size_t capacity, QString* error)
+    {
+        std::size_t filled = 0;
+        while (filled < capacity) {
+            const ssize_t n = ::pread(m_fd, buffer + filled, capacity - filled, m_offset);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n < 0 && errno == EINVAL && m_direct && m_offset == m_start) {
+                // Some filesystems accept O_DIRECT at open() and refuse it on read, or the
+                // resume offset is not block aligned.
+                fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) & ~O_DIRECT);
+                m_direct = false;
+                posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+                continue;
+            }
+            if (n < 0) {
+                *error = QString::fromLocal8Bit(std::strerror(errno));
+                return -1;
+            }
+            if (n == 0) {
+                break;
+            }
+            filled += static_cast<std::size_t>(n);
+            m_offset += n;
+            if (m_direct && filled % kDirectAlignment != 0) {
+                break;  // an unaligned short read is the tail; another pread would be EINVAL
+            }
+        }
+        dropBehind(false);
+        return static_cast<int64_t>(filled);
+    }
+
+private:
+    void dropBehind(bool all)
+    {
+        // O_DIRECT never fills the cache; for buffered reads the data is already in our
+        // buffers, so nothing is lost by forgetting the pages.
+        if (m_direct || m_offset <= m_dropped || (!all && m_offset - m_dropped < kDropBehindBytes)) {
+            return;
+        }
+        posix_fadvise(m_fd, m_dropped, m_offset - m_dropped, POSIX_FADV_DONTNEED);
+        m_dropped = m_offset;
+    }
+
+    int m_fd = -1;
+    bool m_direct = false;
+    off_t m_start = 0;
+    off_t m_offset = 0;
+    off_t m_dropped = 0;
+};
+
+bool readStreamed(const QString& path, IsoReadCache mode, qint64 startOffset,
+                  const IsoFileReader::ConsumeFn& consume, QString* errorOut)
+{
+    StreamedFile file;
+    if (!file.open(path, mode, startOffset, errorOut)) {
+        return false;
+    }
+    QString error;
+    const bool ok = RawDeviceHash::runPipelined(
+        kPipelineDepth, kStreamedChunkBytes,
+        [&file](char* buffer, size_t capacity, QString* err) { return file.read(buffer, capacity, err); },
+        consume, nullptr, &error);
+    if (!ok && errorOut && !error.isEmpty()) {
+        *errorOut = error;
+    }
+    return ok;
+}
+
+#endif
+
+} // namespace
+
+bool IsoFileReader::readAll(const QString& path, IsoReadCache mode, const ConsumeFn& consume,
+                            QString* errorOut, qint64 startOffset)
+{
+#ifdef Q_OS_LINUX
+    if (mode != IsoReadCache::PageCache) {
+        return readStreamed(path, mode, startOffset, consume, errorOut);
+    }
+#else
+    (void)mode;
+#endif
+    return readBuffered(path, startOffset, consume, errorOut);
+}
+
+} // namespace FlashSpartan
@@ -0,0 +1,199 @@
+// SHA256_Init and friends are deprecated in OpenSSL 3, but SHA256_CTX is the only SHA-256
+// state whose bytes can be saved and restored.
+#define OPENSSL_SUPPRESS_DEPRECATED
+
+#include "IsoHashResume.h"
+#include "HexEncoding.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <openssl/opensslv.h>
+#include <openssl/sha.h>
+
+#include <cstring>
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr quint32 kMagic = 0x46534852;  // "FSHR"
+constexpr quint32 kFormat = 1;
+
+struct Storage {
+    QMutex mutex;
+    QString dir;
+};
+
+Storage& storage()
+{
+    static Storage s;
+    return s;
+}
+
+QString defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/iso-verify/resume");
+}
+
+QString pathFor(const IsoVerifyCache::FileKey& key)
+{
+    const QByteArray id = key.volumeId.toUtf8() + '\n' + key.relativePath.toUtf8();
+    return IsoHashResume::storageDirectory() + QLatin1Char('/')
+           + HexEncoding::toString(QCryptographicHash::hash(id, QCryptographicHash::Sha256)).left(32)
+           + QStringLiteral(".resume");
+}
+
+/** Everything but the inode; see the class comment. */
+bool sameFile(const IsoVerifyCache::FileKey& a, const IsoVerifyCache::FileKey& b)
+{
+    return a.volumeId == b.volumeId && a.relativePath == b.relativePath && a.size == b.size
+           && a.mtimeMs == b.mtimeMs && a.ctimeMs == b.ctimeMs;
+}
+
+void pruneStale(const QString& dir)
+{
+    const QDateTime cutoff = QDateTime::currentDateTimeUtc().addDays(-IsoHashResume::kMaxAgeDays);
+    const QFileInfoList files = QDir(dir).entryInfoList({QStringLiteral("*.resume")}, QDir::Files);
+    for (const QFileInfo& fi : files) {
+        if (fi.lastModified().toUTC() < cutoff) {
+            QFile::remove(fi.absoluteFilePath());
+        }
+    }
+}
+
+} // namespace
+
+struct IsoHashResume::Sha256::Context {
+    SHA256_CTX ctx;
+};
+
+IsoHashResume::Sha256::Sha256()
+    : m_ctx(std::make_unique<Context>())
+{
+    SHA256_Init(&m_ctx->ctx);
+}
+
+IsoHashResume::Sha256::~Sha256() = default;
+
+bool IsoHashResume::Sha256::update(const void* data, std::size_t size)
+{
+    return SHA256_Update(&m_ctx->ctx, data, size) == 1;
+}
+
+QString IsoHashResume::Sha256::finish()
+{
+    unsigned char md[SHA256_DIGEST_LENGTH];
+    if (SHA256_Final(md, &m_ctx->ctx) != 1) {
+        return {};
+    }
+    return HexEncoding::toString(md, sizeof(md));
+}
+
+QByteArray IsoHashResume::Sha256::saveState() const
+{
+    QByteArray state;
+    QDataStream out(&state, QIODevice::WriteOnly);
+    out << quint64(OPENSSL_VERSION_NUMBER) << quint32(sizeof(SHA256_CTX));
+    out.writeRawData(reinterpret_cast<const char*>(&m_ctx->ctx), sizeof(SHA256_CTX));
+    return state;
+}
+
+bool IsoHashResume::Sha256::restoreState(const QByteArray& state)
+{
+    QDataStream in(state);
+    quint64 version = 0;
+    quint32 size = 0;
+    in >> version >> size;
+    if (in.status() != QDataStream::Ok || version != quint64(OPENSSL_VERSION_NUMBER) || size != sizeof(SHA256_CTX)) {
+        return false;
+    }
+    SHA256_CTX restored;
+    if (in.readRawData(reinterpret_cast<char*>(&restored), sizeof(restored)) != int(sizeof(restored))) {
+        return false;
+    }
+    std::memcpy(&m_ctx->ctx, &restored, sizeof(restored));
+    return true;
+}
+
+std::optional<IsoHashResume::Checkpoint> IsoHashResume::load(const IsoVerifyCache::FileKey& key)
+{
+    if (!key.isValid()) {
+        return std::nullopt;
+    }
+    QFile file(pathFor(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_4);
+    quint32 magic = 0;
+    quint32 format = 0;
+    IsoVerifyCache::FileKey stored;
+    Checkpoint checkpoint;
+    in >> magic >> format;
+    if (magic != kMagic || format != kFormat) {
+        return std::nullopt;
+    }
+    in >> stored.volumeId >> stored.relativePath >> stored.size >> stored.mtimeMs >> stored.ctimeMs
+        >> checkpoint.offset >> checkpoint.state;
+    if (in.status() != QDataStream::Ok || !sameFile(stored, key) || checkpoint.offset <= 0
+        || checkpoint.offset > key.size) {
+        return std::nullopt;
+    }
+    return checkpoint;
+}
+
+bool IsoHashResume::save(const IsoVerifyCache::FileKey& key, const Checkpoint& checkpoint)
+{
+    if (!key.isValid()) {
+        return false;
+    }
+    const QString dir = storageDirectory();
+    if (!QDir().mkpath(dir)) {
+        return false;
+    }
+    QSaveFile file(pathFor(key));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_4);
+    out << kMagic << kFormat << key.volumeId << key.relativePath << key.size << key.mtimeMs << key.ctimeMs
+        << checkpoint.offset << checkpoint.state;
+    if (out.status() != QDataStream::Ok || !file.commit()) {
+        return false;
+    }
+    pruneStale(dir);
+    return true;
+}
+
+void IsoHashResume::remove(const IsoVerifyCache::FileKey& key)
+{
+    if (key.isValid()) {
+        QFile::remove(pathFor(key));
+    }
+}
+
+void IsoHashResume::setStorageDirectory(const QString& dir)
+{
+    Storage& s = storage();
+    QMutexLocker lock(&s.mutex);
+    s.dir = dir;
+}
+
+QString IsoHashResume::storageDirectory()
+{
+    Storage& s = storage();
+    QMutexLocker lock(&s.mutex);
+    return s.dir.isEmpty() ? defaultDirectory() : s.dir;
+}
+
+} // namespace FlashSpartan
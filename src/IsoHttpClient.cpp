@@ -1,66 +1,180 @@
 #include "IsoHttpClient.h"
+#include "PerfMetrics.h"
 
-#include <QEventLoop>
+#include <QCoreApplication>
+#include <QHash>
+#include <QMutex>
 #include <QNetworkAccessManager>
+#include <QNetworkDiskCache>
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QPromise>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QThread>
 #include <QTimer>
 #include <QUrl>
 
+#include <memory>
+
 namespace FlashSpartan {
 
 namespace {
 
-QByteArray networkFetch(const QString& url, QString* errorOut, int timeoutMs)
+constexpr qint64 kHttpCacheBytes = 64 * 1024 * 1024;
+
+QMutex g_mirrorMutex;
+QString g_mirrorBase;
+
+QNetworkRequest makeRequest(const QString& url)
 {
-    QNetworkAccessManager nam;
     QNetworkRequest req{QUrl(url)};
     req.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
                      QNetworkRequest::NoLessSafeRedirectPolicy);
+    req.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+    req.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferNetwork);
 #ifdef FLASHSPARTAN_VERSION
     req.setHeader(QNetworkRequest::UserAgentHeader,
                   QStringLiteral("FlashSpartan/" FLASHSPARTAN_VERSION));
 #else
     req.setHeader(QNetworkRequest::UserAgentHeader, QStringLiteral("FlashSpartan"));
 #endif
+    return req;
+}
 
-    QNetworkReply* reply = nam.get(req);
-    QEventLoop loop;
-    QTimer timer;
-    timer.setSingleShot(true);
-    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
-    QObject::connect(&timer, &QTimer::timeout, &loop, &QEventLoop::quit);
-    timer.start(timeoutMs);
-    loop.exec();
-
-    if (!reply->isFinished()) {
-        if (errorOut) {
-            *errorOut = QStringLiteral("Download timed out");
-        }
-        reply->abort();
-        reply->deleteLater();
-        return {};
+QDateTime serverExpiry(const QNetworkReply* reply)
+{
+    const QByteArray cacheControl = reply->rawHeader("Cache-Control").toLower();
+    if (cacheControl.contains("no-store") || cacheControl.contains("no-cache")) {
+        return QDateTime::currentDateTimeUtc();
+    }
+    static const QRegularExpression maxAge(QStringLiteral("max-age=(\\d+)"));
+    const QRegularExpressionMatch m = maxAge.match(QString::fromLatin1(cacheControl));
+    if (m.hasMatch()) {
+        return QDateTime::currentDateTimeUtc().addSecs(m.captured(1).toLongLong());
+    }
+    const QByteArray expires = reply->rawHeader("Expires");
+    if (!expires.isEmpty()) {
+        return QDateTime::fromString(QString::fromLatin1(expires), Qt::RFC2822Date);
     }
-    if (reply->error() != QNetworkReply::NoError) {
-        if (errorOut) {
-            *errorOut = reply->errorString();
+    return {};
+}
+
+/**
+ * Owns the network thread and its QNetworkAccessManager. Callers on any thread get a
+ * future; the requests themselves are only touched on the network thread.
+ */
+class NetworkHost {
+public:
+    static NetworkHost& instance()
+    {
+        static NetworkHost* host = [] {
+            auto* h = new NetworkHost;
+            qAddPostRoutine([] { NetworkHost::instance().shutdown(); });
+            return h;
+        }();
+        return *host;
+    }
+
+    QFuture<IsoHttpClient::Response> fetch(const QString& url, int timeoutMs)
+    {
+        QMutexLocker lock(&m_mutex);
+        auto it = m_inFlight.constFind(url);
+        if (it != m_inFlight.cend()) {
+            return it.value();
         }
-        reply->deleteLater();
-        return {};
+        auto promise = std::make_shared<QPromise<IsoHttpClient::Response>>();
+        promise->start();
+        QFuture<IsoHttpClient::Response> future = promise->future();
+        if (!m_context) {
+            IsoHttpClient::Response r;
+            r.error = QStringLiteral("Network unavailable");
+            promise->addResult(r);
+            promise->finish();
+            return future;
+        }
+        m_inFlight.insert(url, future);
+        QMetaObject::invokeMethod(m_context, [this, url, timeoutMs, promise]() {
+            start(url, timeoutMs, promise);
+        }, Qt::QueuedConnection);
+        return future;
+    }
+
+private:
+    NetworkHost()
+    {
+        m_thread.setObjectName(QStringLiteral("IsoHttpClient"));
+        m_thread.start();
+        m_context = new QObject;
+        m_context->moveToThread(&m_thread);
+        QMetaObject::invokeMethod(m_context, [this]() {
+            m_nam = new QNetworkAccessManager(m_context);
+            auto* cache = new QNetworkDiskCache(m_nam);
+            cache->setCacheDirectory(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                                     + QStringLiteral("/iso-verify/http"));
+            cache->setMaximumCacheSize(kHttpCacheBytes);
+            m_nam->setCache(cache);
+        }, Qt::BlockingQueuedConnection);
     }
 
-    const QByteArray data = reply->readAll();
-    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-    reply->deleteLater();
+    void start(const QString& url, int timeoutMs, std::shared_ptr<QPromise<IsoHttpClient::Response>> promise)
+    {
+        QNetworkReply* reply = m_nam->get(makeRequest(url));
+        auto timedOut = std::make_shared<bool>(false);
+        auto* timer = new QTimer(reply);
+        timer->setSingleShot(true);
+        QObject::connect(timer, &QTimer::timeout, reply, [reply, timedOut]() {
+            *timedOut = true;
+            reply->abort();
+        });
+        timer->start(timeoutMs);
+
+        QObject::connect(reply, &QNetworkReply::finished, m_context, [this, url, reply, timedOut, promise]() {
+            IsoHttpClient::Response r;
+            r.httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            r.fromCache = reply->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool();
+            r.expires = serverExpiry(reply);
+            if (*timedOut) {
+                r.error = QStringLiteral("Download timed out");
+            } else if (reply->error() != QNetworkReply::NoError) {
+                r.error = reply->errorString();
+            } else if (r.httpStatus >= 400) {
+                r.error = QStringLiteral("HTTP %1").arg(r.httpStatus);
+            } else {
+                r.data = reply->readAll();
+                PerfMetrics::cacheLookup(PerfMetrics::Cache::Http, r.fromCache).add();
+            }
+            reply->deleteLater();
+            {
+                QMutexLocker lock(&m_mutex);
+                m_inFlight.remove(url);
+            }
+            promise->addResult(r);
+            promise->finish();
+        });
+    }
 
-    if (status >= 400) {
-        if (errorOut) {
-            *errorOut = QStringLiteral("HTTP %1").arg(status);
+    void shutdown()
+    {
+        QObject* context = nullptr;
+        {
+            QMutexLocker lock(&m_mutex);
+            context = m_context;
+            m_context = nullptr;
         }
-        return {};
+        if (context) {
+            QMetaObject::invokeMethod(context, [context]() { delete context; }, Qt::BlockingQueuedConnection);
+        }
+        m_thread.quit();
+        m_thread.wait();
     }
-    return data;
-}
+
+    QThread m_thread;
+    QObject* m_context = nullptr;       // lives on m_thread; owns m_nam
+    QNetworkAccessManager* m_nam = nullptr;
+    QMutex m_mutex;
+    QHash<QString, QFuture<IsoHttpClient::Response>> m_inFlight;
+};
 
 } // namespace
 
@@ -70,13 +184,31 @@ IsoHttpClient::Handler& IsoHttpClient::handlerRef()
     return handler;
 }
 
+QFuture<IsoHttpClient::Response> IsoHttpClient::fetch(const QString& url, int timeoutMs)
+{
+    Handler& custom = handlerRef();
+    if (custom) {
+        Response r;
+        r.data = custom(url, &r.error, timeoutMs);
+        if (r.data.isEmpty() && r.error.isEmpty()) {
+            r.error = QStringLiteral("Empty response");
+        }
+        return QtFuture::makeReadyFuture(r);
+    }
+    return NetworkHost::instance().fetch(url, timeoutMs);
+}
+
 QByteArray IsoHttpClient::get(const QString& url, QString* errorOut, int timeoutMs)
 {
     Handler& custom = handlerRef();
     if (custom) {
         return custom(url, errorOut, timeoutMs);
     }
-    return networkFetch(url, errorOut, timeoutMs);
+    const Response r = fetch(url, timeoutMs).result();
+    if (!r.ok() && errorOut) {
+        *errorOut = r.error;
+    }
+    return r.data;
 }
 
 void IsoHttpClient::setHandler(Handler handler)
@@ -89,4 +221,31 @@ void IsoHttpClient::reset()
     handlerRef() = nullptr;
 }
 
+void IsoHttpClient::setMirror(const QString& baseUrl)
+{
+    QString base = baseUrl.trimmed();
+    while (base.endsWith(QLatin1Char('/'))) {
+        base.chop(1);
+    }
+    QMutexLocker lock(&g_mirrorMutex);
+    g_mirrorBase = base;
+}
+
+QString IsoHttpClient::mirrorUrlFor(const QString& url, const QString& imageFileName)
+{
+    QString base;
+    {
+        QMutexLocker lock(&g_mirrorMutex);
+        base = g_mirrorBase;
+    }
+    if (base.isEmpty()) {
+        return {};
+    }
+    QString target = base + QStringLiteral("/fetch?url=") + QString::fromLatin1(QUrl::toPercentEncoding(url));
+    if (!imageFileName.isEmpty()) {
+        target += QStringLiteral("&image=") + QString::fromLatin1(QUrl::toPercentEncoding(imageFileName));
+    }
+    return target;
+}
+
 } // namespace FlashSpartan
@@ -0,0 +1,283 @@
+#include "IsoImageScanner.h"
+
+#include "DirectoryListing.h"
+#include "IsoCatalog.h"
+#include "IsoScanRules.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QSet>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef Q_OS_WIN
+#include <dirent.h>
+#include <fcntl.h>
+#include <strings.h>
+#include <sys/stat.h>
+#endif
+
+namespace FlashSpartan {
+
+namespace {
+
+struct Subdirectory {
+    QString path;
+    /** "dev:inode" on POSIX, so a directory reached twice (bind mounts, symlinks) is listed once. */
+    QString id;
+};
+
+struct Listing {
+    QVector<Subdirectory> subdirectories;
+    QStringList images;
+};
+
+QString joinPath(const QString& dir, const QString& name)
+{
+    return dir.endsWith(QLatin1Char('/')) ? dir + name : dir + QLatin1Char('/') + name;
+}
+
+void addIfImage(Listing& out, const QString& dir, const QString& name)
+{
+    if (!IsoCatalog::isVerifiableImageFileName(name)) {
+        return;
+    }
+    const QString path = joinPath(dir, name);
+    if (!IsoScanRules::isExcludedImagePath(path)) {
+        out.images.append(path);
+    }
+}
+
+#ifndef Q_OS_WIN
+/** Suffix pre-check on the raw name, so non-image files never become a QString. */
+bool mayBeImageName(const char* name)
+{
+    const size_t len = std::strlen(name);
+    for (const char* suffix : {".iso", ".img", ".xz", ".zst", ".gz", ".zip"}) {
+        const size_t n = std::strlen(suffix);
+        if (len > n && strncasecmp(name + len - n, suffix, n) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QString directoryId(const struct stat& sb)
+{
+    return QString::number(static_cast<quint64>(sb.st_dev)) + QLatin1Char(':')
+           + QString::number(static_cast<quint64>(sb.st_ino));
+}
+
+QString directoryId(const QString& path)
+{
+    struct stat sb {};
+    return ::stat(QFile::encodeName(path).constData(), &sb) == 0 ? directoryId(sb) : QString();
+}
+
+Listing listDirectory(const QString& dir)
+{
+    Listing out;
+    DIR* handle = ::opendir(QFile::encodeName(dir).constData());
+    if (!handle) {
+        return out;
+    }
+    const int dirFd = ::dirfd(handle);
+    while (const dirent* entry = ::readdir(handle)) {
+        if (entry->d_name[0] == '.') {
+            continue;  // ".", ".." and hidden entries, like QDir without QDir::Hidden
+        }
+        const unsigned char type = entry->d_type;
+        if (type == DT_REG) {
+            // Judged by name alone: the bulk of a data stick is files that are never stat()ed.
+            if (mayBeImageName(entry->d_name)) {
+                addIfImage(out, dir, QFile::decodeName(entry->d_name));
+            }
+            continue;
+        }
+        if (type != DT_DIR && type != DT_LNK && type != DT_UNKNOWN) {
+            continue;
+        }
+        const QString name = QFile::decodeName(entry->d_name);
+        if (type == DT_DIR && IsoScanRules::isReservedMultibootDirectory(name)) {
+            continue;
+        }
+        struct stat sb {};
+        if (::fstatat(dirFd, entry->d_name, &sb, 0) != 0) {
+            continue;  // follows symlinks, as QFileInfo does
+        }
+        if (S_ISDIR(sb.st_mode)) {
+            if (!IsoScanRules::isReservedMultibootDirectory(name)) {
+                out.subdirectories.append({joinPath(dir, name), directoryId(sb)});
+            }
+        } else if (S_ISREG(sb.st_mode)) {
+            addIfImage(out, dir, name);
+        }
+    }
+    ::closedir(handle);
+    return out;
+}
+#else
+QString directoryId(const QString& /*path*/)
+{
+    return {};
+}
+
+Listing listDirectory(const QString& dir)
+{
+    // One listing call per directory; only links need a QFileInfo to see where they lead.
+    Listing out;
+    QVector<DirectoryListing::Entry> entries;
+    if (!DirectoryListing::list(dir, &entries)) {
+        return out;
+    }
+    for (const DirectoryListing::Entry& entry : entries) {
+        if (entry.hidden) {
+            continue;  // like QDir without QDir::Hidden
+        }
+        using Kind = DirectoryListing::Entry::Kind;
+        bool isDir = entry.kind == Kind::Directory;
+        bool isFile = entry.kind == Kind::File;
+        if (entry.kind == Kind::Link) {
+            const QFileInfo target(joinPath(dir, entry.name));  // follows the link, as QDir does
+            isDir = target.isDir();
+            isFile = target.isFile();
+        }
+        if (isDir) {
+            if (!IsoScanRules::isReservedMultibootDirectory(entry.name)) {
+                out.subdirectories.append({joinPath(dir, entry.name), QString()});
+            }
+        } else if (isFile) {
+            addIfImage(out, dir, entry.name);
+        }
+    }
+    return out;
+}
+#endif
+
+/** Directories still to list are shared by every walker thread; each takes the newest. */
+class Walk {
+public:
+    Walk(const IsoImageScanner::Limits& limits, const std::function<void(const QString&)>& found)
+        : m_limits(limits), m_found(found)
+    {
+        m_timer.start();
+    }
+
+    IsoImageScanner::Result run(const QString& root, int threads)
+    {
+        m_pending.push_back({QDir(root).absolutePath(), 0});
+        const QString rootId = directoryId(root);
+        if (!rootId.isEmpty()) {
+            m_visited.insert(rootId);
+        }
+        std::vector<std::thread> helpers;
+        for (int i = 1; i < threads; ++i) {
+            helpers.emplace_back([this] { work(); });
+        }
+        work();
+        for (std::thread& t : helpers) {
+            t.join();
+        }
+        if (!m_pending.empty()) {
+            m_result.truncated = true;
+        }
+        m_result.paths.sort();
+        return m_result;
+    }
+
+private:
+    struct Pending {
+        QString path;
+        int depth = 0;
+    };
+
+    bool outOfBudget() const
+    {
+        if (m_limits.cancelled && m_limits.cancelled->load()) {
+            return true;
+        }
+        return m_limits.timeBudgetMs > 0 && m_timer.elapsed() >= m_limits.timeBudgetMs;
+    }
+
+    void work()
+    {
+        QMutexLocker lock(&m_mutex);
+        for (;;) {
+            while (m_pending.empty() && m_busy > 0 && !m_stop) {
+                m_wake.wait(&m_mutex);
+            }
+            if (m_stop || m_pending.empty()) {
+                break;
+            }
+            const Pending dir = std::move(m_pending.back());
+            m_pending.pop_back();
+            ++m_busy;
+            lock.unlock();
+
+            const Listing listing = listDirectory(dir.path);
+            if (m_found) {
+                for (const QString& path : listing.images) {
+                    m_found(path);
+                }
+            }
+
+            lock.relock();
+            --m_busy;
+            ++m_result.directories;
+            m_result.paths += listing.images;
+            for (const Subdirectory& sub : listing.subdirectories) {
+                if (dir.depth >= m_limits.maxDepth) {
+                    m_result.truncated = true;
+                    break;
+                }
+                if (!sub.id.isEmpty()) {
+                    if (m_visited.contains(sub.id)) {
+                        continue;
+                    }
+                    m_visited.insert(sub.id);
+                }
+                m_pending.push_back({sub.path, dir.depth + 1});
+            }
+            if (outOfBudget()) {
+                m_stop = true;
+            }
+            m_wake.wakeAll();
+        }
+    }
+
+    const IsoImageScanner::Limits m_limits;
+    const std::function<void(const QString&)>& m_found;
+    QElapsedTimer m_timer;
+    QMutex m_mutex;
+    QWaitCondition m_wake;
+    std::vector<Pending> m_pending;  // guarded by m_mutex, as is everything below
+    int m_busy = 0;
+    bool m_stop = false;
+    QSet<QString> m_visited;
+    IsoImageScanner::Result m_result;
+};
+
+} // namespace
+
+IsoImageScanner::Result IsoImageScanner::scan(const QString& root, const Limits& limits,
+                                              const std::function<void(const QString& path)>& found)
+{
+    if (root.isEmpty() || !QFileInfo(root).isDir()) {
+        return {};
+    }
+    const int threads = limits.threads > 0
+                            ? qMin(limits.threads, kMaxThreads)
+                            : qBound(1, QThread::idealThreadCount(), kMaxThreads);
+    Walk walk(limits, found);
+    return walk.run(root, threads);
+}
+
+} // namespace FlashSpartan
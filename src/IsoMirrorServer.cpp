@@ -0,0 +1,159 @@
+#include "IsoMirrorServer.h"
+
+#include "IsoArtifactStore.h"
+#include "IsoHttpClient.h"
+
+#include <QDebug>
+#include <QTimer>
+#include <QUrl>
+#include <QUrlQuery>
+
+#include <optional>
+
+namespace FlashSpartan {
+
+namespace {
+
+QByteArray statusText(int status)
+{
+    switch (status) {
+    case 200:
+        return "OK";
+    case 400:
+        return "Bad Request";
+    case 403:
+        return "Forbidden";
+    case 404:
+        return "Not Found";
+    case 405:
+        return "Method Not Allowed";
+    default:
+        return "Bad Gateway";
+    }
+}
+
+} // namespace
+
+IsoMirrorServer::IsoMirrorServer(Allow allow)
+    : m_allow(std::move(allow))
+{
+    QObject::connect(&m_server, &QTcpServer::newConnection, &m_server, [this]() { onNewConnection(); });
+}
+
+IsoMirrorServer::~IsoMirrorServer()
+{
+    // Sockets are the server's children; they must not call back while it goes away.
+    for (QTcpSocket* socket : m_requests.keys()) {
+        QObject::disconnect(socket, nullptr, &m_server, nullptr);
+    }
+}
+
+bool IsoMirrorServer::listen(const QHostAddress& address, quint16 port, QString* error)
+{
+    if (!m_server.listen(address, port)) {
+        if (error) {
+            *error = m_server.errorString();
+        }
+        return false;
+    }
+    return true;
+}
+
+void IsoMirrorServer::onNewConnection()
+{
+    while (QTcpSocket* socket = m_server.nextPendingConnection()) {
+        m_requests.insert(socket, QByteArray());
+        QObject::connect(socket, &QTcpSocket::disconnected, &m_server, [this, socket]() {
+            m_requests.remove(socket);
+            socket->deleteLater();
+        });
+        QObject::connect(socket, &QTcpSocket::readyRead, &m_server, [this, socket]() { readRequest(socket); });
+        QTimer::singleShot(kRequestTimeoutMs, socket, [this, socket]() {
+            if (m_requests.contains(socket)) {
+                socket->abort();
+            }
+        });
+    }
+}
+
+void IsoMirrorServer::readRequest(QTcpSocket* socket)
+{
+    const auto it = m_requests.find(socket);
+    if (it == m_requests.end()) {
+        socket->readAll();  // already answering; one request per connection
+        return;
+    }
+    it.value() += socket->readAll();
+    const qsizetype headerEnd = it.value().indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        if (it.value().size() > kMaxRequestBytes) {
+            m_requests.erase(it);
+            respond(socket, 400, "request too large\n");
+        }
+        return;
+    }
+    const QList<QByteArray> requestLine = it.value().left(it.value().indexOf("\r\n")).split(' ');
+    m_requests.erase(it);
+
+    if (requestLine.size() != 3 || !requestLine.at(2).startsWith("HTTP/1.")) {
+        respond(socket, 400, "malformed request\n");
+        return;
+    }
+    if (requestLine.at(0) != "GET") {
+        respond(socket, 405, "only GET\n");
+        return;
+    }
+    const QUrl target(QString::fromLatin1(requestLine.at(1)));
+    if (target.path() != QStringLiteral("/fetch")) {
+        respond(socket, 404, "not found\n");
+        return;
+    }
+    const QUrlQuery query(target);
+    const QString url = query.queryItemValue(QStringLiteral("url"), QUrl::FullyDecoded);
+    const QString image = query.queryItemValue(QStringLiteral("image"), QUrl::FullyDecoded);
+    const QUrl origin(url, QUrl::StrictMode);
+    const bool web = origin.scheme() == QStringLiteral("https") || origin.scheme() == QStringLiteral("http");
+    if (!origin.isValid() || !web || !origin.userInfo().isEmpty() || !m_allow || !m_allow(url, image)) {
+        respond(socket, 403, "not a catalog artifact\n");
+        return;
+    }
+    serve(socket, url);
+}
+
+void IsoMirrorServer::serve(QTcpSocket* socket, const QString& url)
+{
+    std::optional<IsoArtifactStore::Artifact> stored = IsoArtifactStore::lookup(url);
+    if (stored && stored->isFresh()) {
+        respond(socket, 200, stored->data, stored->expiresAt);
+        return;
+    }
+    IsoHttpClient::fetch(url).then(socket, [socket, url, stored](const IsoHttpClient::Response& resp) {
+        if (resp.ok() && !resp.data.isEmpty()) {
+            // The mirror can't tell pinned from rolling releases, so it keeps the shorter cap.
+            const QDateTime expires = IsoArtifactStore::expiryFor(true, resp.expires);
+            IsoArtifactStore::put(url, resp.data, expires);
+            respond(socket, 200, resp.data, expires);
+        } else if (stored) {
+            qWarning() << "ISO mirror: serving an expired copy of" << url << resp.error;
+            respond(socket, 200, stored->data);
+        } else {
+            respond(socket, 502, resp.error.toUtf8() + '\n');
+        }
+    });
+}
+
+void IsoMirrorServer::respond(QTcpSocket* socket, int status, const QByteArray& body, const QDateTime& expires)
+{
+    const qint64 maxAge = expires.isValid() ? QDateTime::currentDateTimeUtc().secsTo(expires) : 0;
+    QByteArray head = "HTTP/1.1 " + QByteArray::number(status) + ' ' + statusText(status) + "\r\n";
+    head += status == 200 ? "Content-Type: application/octet-stream\r\n" : "Content-Type: text/plain\r\n";
+    head += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    head += maxAge > 0 ? "Cache-Control: max-age=" + QByteArray::number(maxAge) + "\r\n"
+                       : QByteArray("Cache-Control: no-cache\r\n");
+    head += "Connection: close\r\n\r\n";
+    socket->write(head);
+    socket->write(body);
+    socket->disconnectFromHost();
+}
+
+} // namespace FlashSpartan
@@ -0,0 +1,87 @@
+#include "IsoPrescreen.h"
+#include "HexEncoding.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+
+namespace FlashSpartan::IsoPrescreen {
+
+namespace {
+
+QString digestAt(QFile& file, qint64 offset, QString* errorOut)
+{
+    if (!file.seek(offset)) {
+        if (errorOut) *errorOut = file.errorString();
+        return {};
+    }
+    const QByteArray data = file.read(kEdgeBytes);
+    if (data.size() != qMin(kEdgeBytes, file.size() - offset)) {
+        if (errorOut) *errorOut = QStringLiteral("short read: %1").arg(file.errorString());
+        return {};
+    }
+    return HexEncoding::toString(QCryptographicHash::hash(data, QCryptographicHash::Sha256));
+}
+
+} // namespace
+
+EdgeDigests edgeDigests(const QString& path, QString* errorOut)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorOut) *errorOut = file.errorString();
+        return {};
+    }
+    EdgeDigests edges;
+    edges.headSha256 = digestAt(file, 0, errorOut);
+    edges.tailSha256 = digestAt(file, qMax<qint64>(0, file.size() - kEdgeBytes), errorOut);
+    if (edges.headSha256.isEmpty() || edges.tailSha256.isEmpty()) {
+        return {};
+    }
+    return edges;
+}
+
+bool appliesTo(const QString& fileName)
+{
+    for (const char* suffix : {".img.xz", ".img.zst", ".img.gz", ".zip"}) {
+        if (fileName.endsWith(QLatin1String(suffix), Qt::CaseInsensitive)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+QString mismatch(const QString& path, const IsoPublisherMatch& match)
+{
+    if (!appliesTo(path)) {
+        return {};
+    }
+    if (match.imageSizeBytes > 0) {
+        const quint64 size = static_cast<quint64>(qMax<qint64>(0, QFile(path).size()));
+        if (size < match.imageSizeBytes) {
+            return QStringLiteral("file is %1 bytes, the catalog lists %2: truncated")
+                .arg(size)
+                .arg(match.imageSizeBytes);
+        }
+        if (size > match.imageSizeBytes) {
+            return QStringLiteral("file is %1 bytes, the catalog lists %2: a different build")
+                .arg(size)
+                .arg(match.imageSizeBytes);
+        }
+    }
+    if (match.headSha256.isEmpty() && match.tailSha256.isEmpty()) {
+        return {};
+    }
+    const EdgeDigests edges = edgeDigests(path);
+    if (edges.isEmpty()) {
+        return {};
+    }
+    if (!match.headSha256.isEmpty() && edges.headSha256 != match.headSha256) {
+        return QStringLiteral("first %1 MiB differ from the catalog's").arg(kEdgeBytes / (1024 * 1024));
+    }
+    if (!match.tailSha256.isEmpty() && edges.tailSha256 != match.tailSha256) {
+        return QStringLiteral("last %1 MiB differ from the catalog's").arg(kEdgeBytes / (1024 * 1024));
+    }
+    return {};
+}
+
+} // namespace FlashSpartan::IsoPrescreen
@@ -1,19 +1,33 @@
 #include "IsoVerifier.h"
+#include "FileExtents.h"
 #include "GpgUtil.h"
+#include "HashScheduler.h"
+#include "IoBufferPool.h"
+#include "IoPriority.h"
+#include "IoScheduler.h"
 #include "IsoScanRules.h"
 #include "AuditLog.h"
+#include "DecompressedImageHash.h"
 #include "IsoCatalog.h"
 #include "IsoCatalogManifest.h"
 #include "IsoChecksum.h"
+#include "IsoPrescreen.h"
+#include "IsoFileReader.h"
+#include "IsoHashResume.h"
+#include "IsoImageScanner.h"
+#include "IsoArtifactStore.h"
 #include "IsoHttpClient.h"
 #include "IsoVerifyCache.h"
-
-#include <openssl/evp.h>
+#include "MultiDigest.h"
+#include "OpenPgpVerifier.h"
+#include "PerfTrace.h"
+#include "RawDeviceHash.h"
 
 #include <QDir>
 #include <QDirIterator>
 #include <QFile>
 #include <QFileInfo>
+#include <QMutex>
 #include <QProcess>
 #include <QRegularExpression>
 #include <QElapsedTimer>
@@ -22,20 +36,109 @@
 #include <QNetworkReply>
 #include <QEventLoop>
 #include <QTimer>
+#include <QSaveFile>
+#include <QSet>
 #include <QStandardPaths>
+#include <QStorageInfo>
 #include <QCryptographicHash>
 #include <QtConcurrent>
+#include <QThread>
 #include <QThreadPool>
+#include <QWaitCondition>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
 
 namespace FlashSpartan {
 
 namespace {
 
-IsoVerifyOptions g_verifyOptions;
+// Published options; readers std::atomic_load them, so a verify never waits on a settings change.
+std::shared_ptr<const IsoVerifyOptions> g_verifyOptions = std::make_shared<const IsoVerifyOptions>();
+thread_local const IsoVerifyOptions* t_jobOptions = nullptr;
+
+/** The OptionsScope or PinnedOptions installed on this thread. */
+const IsoVerifyOptions& activeOptions()
+{
+    // Every entry point pins; only a helper called outside a run gets here without one.
+    static const IsoVerifyOptions unpinned;
+    return t_jobOptions ? *t_jobOptions : unpinned;
+}
+
+/**
+ * Installs the published options for one run unless an OptionsScope already did, and
+ * keeps them alive until the run ends.
+ */
+class PinnedOptions {
+public:
+    PinnedOptions()
+        : m_previous(t_jobOptions)
+    {
+        if (!t_jobOptions) {
+            m_pinned = std::atomic_load(&g_verifyOptions);
+            t_jobOptions = m_pinned.get();
+        }
+    }
+    ~PinnedOptions() { t_jobOptions = m_previous; }
+
+    PinnedOptions(const PinnedOptions&) = delete;
+    PinnedOptions& operator=(const PinnedOptions&) = delete;
+
+private:
+    const IsoVerifyOptions* m_previous;
+    std::shared_ptr<const IsoVerifyOptions> m_pinned;
+};
+
+/** Reports one stage of an image to IsoVerifyOptions::stageTimed and the trace when it ends. */
+class StageTimer {
+public:
+    StageTimer(const QString& isoPath, const char* stage)
+        : m_isoPath(isoPath), m_stage(stage), m_beginNs(PerfTrace::nowNs())
+    {
+    }
+    ~StageTimer() { end(); }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    void end()
+    {
+        if (m_ended) {
+            return;
+        }
+        m_ended = true;
+        const qint64 endNs = PerfTrace::nowNs();
+        FLASHSPARTAN_TRACE_RECORD("iso", m_stage, m_beginNs, endNs);
+        if (activeOptions().stageTimed) {
+            activeOptions().stageTimed(m_isoPath, m_stage, m_beginNs, endNs);
+        }
+    }
+
+private:
+    const QString& m_isoPath;
+    const char* m_stage;
+    qint64 m_beginNs;
+    bool m_ended = false;
+};
 
-QString hashFileSha256(const QString& path, QString* errorOut);
+bool hashFileDigests(const QString& path, IsoReadCache readCache, DigestAlgorithms algorithms,
+                     std::atomic<uint64_t>* hashedBytes, const std::function<bool(const char*, size_t)>& tap,
+                     DigestValues* out, QString* errorOut);
 
-QString hashDecompressedXz(const QString& path, QString* errorOut)
+IsoVerifyResult verifyIsoCounted(const QString& isoPath, const QString& mountPoint, const QString& deviceNode,
+                                 std::atomic<uint64_t>* hashedBytes);
+
+bool hashDecompressedXz(const QString& path, DigestAlgorithms algorithms, DigestValues* out, QString* errorOut)
 {
     QProcess proc;
     proc.setProgram(QStringLiteral("xz"));
@@ -46,88 +149,172 @@ QString hashDecompressedXz(const QString& path, QString* errorOut)
         if (errorOut) {
             *errorOut = QStringLiteral("xz decompressor not available (install xz)");
         }
-        return {};
+        return false;
     }
 
-    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
-    if (!ctx) {
+    MultiDigest digest(algorithms);
+    if (!digest.isValid()) {
         proc.kill();
         proc.waitForFinished(3000);
         if (errorOut) {
-            *errorOut = QStringLiteral("OpenSSL context failed");
+            *errorOut = QStringLiteral("OpenSSL hash initialization failed");
         }
-        return {};
+        return false;
     }
-    if (EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) != 1) {
-        EVP_MD_CTX_free(ctx);
+    constexpr qint64 kPipeChunkBytes = 1024 * 1024;
+    const IoBufferPool::Buffer buf(kPipeChunkBytes);
+    if (!buf) {
         proc.kill();
         proc.waitForFinished(3000);
         if (errorOut) {
-            *errorOut = QStringLiteral("OpenSSL hash initialization failed");
+            *errorOut = QStringLiteral("Failed to allocate buffer");
         }
-        return {};
+        return false;
     }
-    QByteArray buf(1024 * 1024, Qt::Uninitialized);
     while (proc.waitForReadyRead(30000)) {
-        const qint64 n = proc.read(buf.data(), buf.size());
+        const qint64 n = proc.read(buf.data(), kPipeChunkBytes);
         if (n <= 0) {
             break;
         }
-        if (EVP_DigestUpdate(ctx, buf.constData(), static_cast<size_t>(n)) != 1) {
-            EVP_MD_CTX_free(ctx);
+        if (!digest.update(buf.data(), static_cast<size_t>(n))) {
             proc.kill();
             proc.waitForFinished(3000);
             if (errorOut) {
                 *errorOut = QStringLiteral("OpenSSL hash update failed");
             }
-            return {};
+            return false;
         }
     }
     proc.waitForFinished(3600000);
     if (proc.exitStatus() != QProcess::NormalExit || proc.exitCode() != 0) {
-        EVP_MD_CTX_free(ctx);
         if (errorOut) {
             *errorOut = proc.errorString().isEmpty() ? QStringLiteral("xz decompress failed")
                                                      : proc.errorString();
         }
-        return {};
+        return false;
     }
 
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int len = 0;
-    if (EVP_DigestFinal_ex(ctx, hash, &len) != 1) {
-        EVP_MD_CTX_free(ctx);
+    if (!digest.finish(out)) {
         if (errorOut) {
             *errorOut = QStringLiteral("OpenSSL hash finalization failed");
         }
-        return {};
+        return false;
     }
-    EVP_MD_CTX_free(ctx);
-    return QByteArray(reinterpret_cast<char*>(hash), static_cast<int>(len)).toHex();
+    return true;
 }
 
-QString computeFileSha256(const QString& path, const IsoVerifyOptions& options, QString* errorOut)
+/**
+ * SHA-256 of @p path that an unplug or cancel does not throw away: the digest state is
+ * saved as IsoHashResume describes, and a resume point for the unchanged file is picked
+ * up instead of starting at byte 0.
+ */
+bool hashFileSha256Resumable(const QString& path, const IsoVerifyCache::FileKey& key, IsoReadCache readCache,
+                             std::atomic<uint64_t>* hashedBytes, DigestValues* out, QString* errorOut)
 {
-    const QFileInfo fi(path);
+    IsoHashResume::Sha256 digest;
+    qint64 offset = 0;
+    if (const auto resume = IsoHashResume::load(key); resume && digest.restoreState(resume->state)) {
+        offset = resume->offset;
+    }
+    qint64 savedAt = offset;
+    const std::atomic<bool>* cancelled = activeOptions().cancelled;
+    bool hashFailed = false;
+    bool stopped = false;
+    const bool read = IsoFileReader::readAll(
+        path, readCache,
+        [&, paced = IoPriority::current() == IoPriority::Class::Background](const char* data, size_t length) {
+            if (cancelled && cancelled->load()) {
+                stopped = true;
+                return false;
+            }
+            hashFailed = !digest.update(data, length);
+            if (hashFailed) {
+                return false;
+            }
+            offset += static_cast<qint64>(length);
+            if (hashedBytes) {
+                hashedBytes->fetch_add(length, std::memory_order_relaxed);
+            }
+            if (offset - savedAt >= IsoHashResume::kCheckpointBytes) {
+                IsoHashResume::save(key, {offset, digest.saveState()});
+                savedAt = offset;
+            }
+            if (paced) {
+                IoPriority::pace(static_cast<qint64>(length), cancelled);
+            }
+            return true;
+        },
+        errorOut, offset);
+    if (!read) {
+        // Everything consumed so far went into the digest, so the state is good up to here.
+        if (!hashFailed && offset > savedAt) {
+            IsoHashResume::save(key, {offset, digest.saveState()});
+        }
+        if (hashFailed && errorOut) *errorOut = QStringLiteral("OpenSSL hash update failed");
+        if (stopped && errorOut) *errorOut = QStringLiteral("Cancelled");
+        return false;
+    }
+    out->sha256 = digest.finish();
+    if (out->sha256.isEmpty()) {
+        if (errorOut) *errorOut = QStringLiteral("OpenSSL hash finalization failed");
+        return false;
+    }
+    IsoHashResume::remove(key);
+    return true;
+}
+
+/**
+ * Hashes @p path once for every digest in @p algorithms. The cache holds SHA-256 only, so
+ * it answers when nothing else is asked for; a full pass still refreshes its entry.
+ * @p hashedBytes, when set, counts plain-file bytes as they are hashed.
+ */
+bool computeFileDigests(const QString& path, const IsoVerifyOptions& options, DigestAlgorithms algorithms,
+                        std::atomic<uint64_t>* hashedBytes, DigestValues* out, QString* errorOut)
+{
+    IsoVerifyCache::FileKey key;
     if (options.useHashCache) {
-        const QString cached =
-            IsoVerifyCache::lookup(path, fi.size(), fi.lastModified().toMSecsSinceEpoch());
-        if (!cached.isEmpty()) {
-            return cached;
+        key = IsoVerifyCache::keyFor(path);
+        if (algorithms == DigestAlgorithm::Sha256 && !options.imageDataRead) {
+            const QString cached = IsoVerifyCache::lookup(key);
+            if (!cached.isEmpty()) {
+                out->sha256 = cached;
+                return true;
+            }
         }
     }
 
-    QString hash;
-    if (options.verifyDecompressed && path.endsWith(QStringLiteral(".img.xz"), Qt::CaseInsensitive)) {
-        hash = hashDecompressedXz(path, errorOut);
+    bool ok = false;
+    if (options.verifyDecompressed && DecompressedImageHash::canDecode(path)) {
+        ok = DecompressedImageHash::digests(path, algorithms, out, errorOut);
+    } else if (options.verifyDecompressed && path.endsWith(QStringLiteral(".img.xz"), Qt::CaseInsensitive)) {
+        ok = hashDecompressedXz(path, algorithms, out, errorOut);  // built without liblzma: pipe through xz(1)
+    } else if (key.isValid() && key.size >= IsoHashResume::kMinFileBytes && algorithms == DigestAlgorithm::Sha256
+               && !options.imageDataRead) {
+        ok = hashFileSha256Resumable(path, key, options.readCache, hashedBytes, out, errorOut);
     } else {
-        hash = hashFileSha256(path, errorOut);
+        ok = hashFileDigests(path, options.readCache, algorithms, hashedBytes, options.imageDataRead, out,
+                             errorOut);
     }
 
-    if (!hash.isEmpty() && options.useHashCache) {
-        IsoVerifyCache::store(path, fi.size(), fi.lastModified().toMSecsSinceEpoch(), hash);
+    // Not cached if the file changed while it was being read.
+    if (ok && !out->sha256.isEmpty() && key.isValid() && IsoVerifyCache::keyFor(path) == key) {
+        IsoVerifyCache::store(key, out->sha256);
     }
-    return hash;
+    return ok;
+}
+
+/**
+ * Runs the local-hash stage of each verify so it overlaps that verify's network and gpg work.
+ * Sized for every parallel verify to have one; a waiting verify runs a queued hash itself.
+ */
+QThreadPool& hashStagePool()
+{
+    static QThreadPool* pool = [] {
+        auto* p = new QThreadPool;
+        p->setMaxThreadCount(qMax(QThread::idealThreadCount(), 4));
+        return p;
+    }();
+    return *pool;
 }
 
 QString normalizeHash(const QString& h)
@@ -135,49 +322,64 @@ QString normalizeHash(const QString& h)
     return h.trimmed().toLower();
 }
 
-QString hashFileSha256(const QString& path, QString* errorOut)
+bool hashFileDigests(const QString& path, IsoReadCache readCache, DigestAlgorithms algorithms,
+                     std::atomic<uint64_t>* hashedBytes, const std::function<bool(const char*, size_t)>& tap,
+                     DigestValues* out, QString* errorOut)
 {
-    QFile file(path);
-    if (!file.open(QIODevice::ReadOnly)) {
-        if (errorOut) *errorOut = file.errorString();
-        return {};
-    }
-
-    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
-    if (!ctx) {
-        if (errorOut) *errorOut = QStringLiteral("OpenSSL context failed");
-        return {};
-    }
-    if (EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) != 1) {
-        EVP_MD_CTX_free(ctx);
+    MultiDigest digest(algorithms);
+    if (!digest.isValid()) {
         if (errorOut) *errorOut = QStringLiteral("OpenSSL hash initialization failed");
-        return {};
+        return false;
     }
-    QByteArray buf(1024 * 1024, Qt::Uninitialized);
-    while (true) {
-        const qint64 n = file.read(buf.data(), buf.size());
-        if (n < 0) {
-            EVP_MD_CTX_free(ctx);
-            if (errorOut) *errorOut = file.errorString();
-            return {};
-        }
-        if (n == 0) break;
-        if (EVP_DigestUpdate(ctx, buf.constData(), static_cast<size_t>(n)) != 1) {
-            EVP_MD_CTX_free(ctx);
-            if (errorOut) *errorOut = QStringLiteral("OpenSSL hash update failed");
-            return {};
-        }
-    }
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int len = 0;
-    if (EVP_DigestFinal_ex(ctx, hash, &len) != 1) {
-        EVP_MD_CTX_free(ctx);
+    bool hashFailed = false;
+    bool tapFailed = false;
+    const bool read = IsoFileReader::readAll(
+        path, readCache,
+        [&digest, &hashFailed, &tapFailed, &tap, hashedBytes,
+         paced = IoPriority::current() == IoPriority::Class::Background](const char* data, size_t length) {
+            if (tap && !tap(data, length)) {
+                tapFailed = true;
+                return false;
+            }
+            hashFailed = !digest.update(data, length);
+            if (hashedBytes) {
+                hashedBytes->fetch_add(length, std::memory_order_relaxed);
+            }
+            if (paced) {
+                IoPriority::pace(static_cast<qint64>(length), activeOptions().cancelled);
+            }
+            return !hashFailed;
+        },
+        errorOut);
+    if (!read) {
+        if (hashFailed && errorOut) *errorOut = QStringLiteral("OpenSSL hash update failed");
+        if (tapFailed && errorOut) *errorOut = QStringLiteral("Image read stopped by its consumer");
+        return false;
+    }
+    if (!digest.finish(out)) {
         if (errorOut) *errorOut = QStringLiteral("OpenSSL hash finalization failed");
-        return {};
+        return false;
     }
-    EVP_MD_CTX_free(ctx);
+    return true;
+}
 
-    return QByteArray(reinterpret_cast<char*>(hash), static_cast<int>(len)).toHex();
+/**
+ * SHA-256 plus whatever the catalog's checksum list and the checksum sidecar are named for
+ * (SHA512SUMS, b2sums, …), so the one read of the image covers every source tried below.
+ */
+DigestAlgorithms digestsToCompute(const QString& isoPath)
+{
+    DigestAlgorithms algorithms = DigestAlgorithm::Sha256;
+    if (const auto match = IsoCatalog::matchIso(isoPath)) {
+        if (!match->checksumUrl.isEmpty() && match->embeddedSha256.isEmpty()) {
+            algorithms |= IsoChecksum::algorithmsForSource(match->checksumUrl);
+        }
+    }
+    const QString sidecar = IsoVerifier::findChecksumSidecar(isoPath);
+    if (!sidecar.isEmpty()) {
+        algorithms |= IsoChecksum::algorithmsForSource(sidecar);
+    }
+    return algorithms;
 }
 
 QString cacheDir()
@@ -205,18 +407,78 @@ QStringList mirrorFallbackUrls(const QString& url)
     return urls;
 }
 
-QByteArray httpGet(const QString& url, QString* errorOut, int timeoutMs = 90000)
+/** Tries the LAN mirror first when @p imageFileName is set and one is configured. */
+IsoHttpClient::Response httpGet(const QString& url, const QString& imageFileName = {}, int timeoutMs = 90000)
 {
-    const QStringList urls = mirrorFallbackUrls(url);
-    QString lastErr;
+    QStringList urls = mirrorFallbackUrls(url);
+    const QString mirrored = imageFileName.isEmpty() ? QString() : IsoHttpClient::mirrorUrlFor(url, imageFileName);
+    if (!mirrored.isEmpty()) {
+        urls.prepend(mirrored);
+    }
+    IsoHttpClient::Response last;
     for (const QString& tryUrl : urls) {
-        const QByteArray data = IsoHttpClient::get(tryUrl, &lastErr, timeoutMs);
-        if (!data.isEmpty()) {
-            return data;
+        last = IsoHttpClient::fetch(tryUrl, timeoutMs).result();
+        if (last.ok() && !last.data.isEmpty()) {
+            return last;
         }
     }
+    if (last.error.isEmpty()) {
+        last.error = QStringLiteral("HTTP download failed");
+    }
+    last.data.clear();
+    return last;
+}
+
+QString writeScratchFile(const QString& name, const QByteArray& data)
+{
+    const QString path = cacheDir() + QLatin1Char('/') + name;
+    QFile::remove(path);
+    QFile file(path);
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(data);
+    }
+    return path;
+}
+
+/** A publisher checksum or signature file and a path gpg can read it from. */
+struct PublisherArtifact {
+    QByteArray data;
+    QString path;
+    bool fromStore = false;
+};
+
+/**
+ * Serves @p url from the artifact store when its entry is fresh (or whenever
+ * preferOfflineSidecars is set and @p allowStored), else downloads it into the store. An
+ * entry @p usable rejects, such as a rolling SUMS that predates the image, is ignored. When
+ * the download fails an expired copy is still returned; the signature check decides.
+ */
+PublisherArtifact fetchPublisherArtifact(const QString& url, const IsoPublisherMatch& match,
+                                         const QString& scratchName, bool allowStored,
+                                         QString* errorOut,
+                                         const std::function<bool(const QByteArray&)>& usable = {})
+{
+    std::optional<IsoArtifactStore::Artifact> stored = IsoArtifactStore::lookup(url);
+    if (stored && usable && !usable(stored->data)) {
+        stored.reset();
+    }
+    if (stored && allowStored && (stored->isFresh() || activeOptions().preferOfflineSidecars)) {
+        return {stored->data, stored->path, true};
+    }
+
+    // Only signed artifacts may come from the LAN mirror: gpg still checks them here.
+    const IsoHttpClient::Response resp =
+        httpGet(url, match.signatureUrl.isEmpty() ? QString() : match.isoFileName);
+    if (resp.ok()) {
+        const QDateTime expires = IsoArtifactStore::expiryFor(match.rollingRelease, resp.expires);
+        const auto put = IsoArtifactStore::put(url, resp.data, expires);
+        return {resp.data, put ? put->path : writeScratchFile(scratchName, resp.data), false};
+    }
+    if (stored) {
+        return {stored->data, stored->path, true};
+    }
     if (errorOut) {
-        *errorOut = lastErr.isEmpty() ? QStringLiteral("HTTP download failed") : lastErr;
+        *errorOut = resp.error;
     }
     return {};
 }
@@ -230,13 +492,55 @@ QString gpgHomedir()
     return cacheDir() + QStringLiteral("/gnupg");
 }
 
+/**
+ * What this process already knows about one gpg homedir, so repeat verifications neither
+ * re-list nor re-import keys. Keyed by path because tests point FLASHSPARTAN_TEST_GPG_HOME
+ * elsewhere between cases.
+ */
+struct GpgHomeState {
+    bool prepared = false;
+    bool listed = false;
+    bool catalogKeyImported = false;
+    QString listing;           // `--list-keys --with-colons`, taken once
+    QSet<QString> importedKeys; // upper-case key IDs received since the listing
+};
+
+struct GpgSession {
+    QMutex mutex;
+    QHash<QString, GpgHomeState> homes;
+};
+
+GpgSession& gpgSession()
+{
+    static GpgSession session;
+    return session;
+}
+
+QString normalizedKeyId(const QString& keyId)
+{
+    QString id = keyId.trimmed().toUpper();
+    if (id.startsWith(QStringLiteral("0X"))) {
+        id = id.mid(2);
+    }
+    return id;
+}
+
 bool ensureGpgHome(QString* errorOut)
 {
-    QDir dir(gpgHomedir());
+    const QString home = gpgHomedir();
+    GpgSession& session = gpgSession();
+    QMutexLocker lock(&session.mutex);
+    GpgHomeState& state = session.homes[home];
+    if (state.prepared) {
+        return true;
+    }
+    QDir dir(home);
     if (!dir.exists() && !dir.mkpath(QStringLiteral("."))) {
         if (errorOut) *errorOut = QStringLiteral("Cannot create GPG directory");
         return false;
     }
+    QFile::setPermissions(home, QFileDevice::ReadOwner | QFileDevice::WriteOwner | QFileDevice::ExeOwner);
+    state.prepared = true;
     return true;
 }
 
@@ -269,23 +573,112 @@ QString runGpg(const QStringList& args, QString* outputOut, QString* errorOut, i
     return out.trimmed();
 }
 
-bool publisherKeyAvailable(const QString& keyId)
+bool gpgInstalled()
+{
+    return QFileInfo::exists(gpgProgram());
+}
+
+QString openPgpKeyDir()
 {
-    QString listOut;
+    return cacheDir() + QStringLiteral("/openpgp-keys");
+}
+
+/** Armored export from the gpg homedir (all keys when @p keyIds is empty). */
+QByteArray exportGpgKeys(const QStringList& keyIds = {})
+{
+    QString out;
     QString err;
-    runGpg({QStringLiteral("--list-keys"), QStringLiteral("--with-colons")}, &listOut, &err);
-    QString needle = keyId.trimmed();
-    if (needle.startsWith(QStringLiteral("0x"), Qt::CaseInsensitive)) {
-        needle = needle.mid(2);
+    runGpg(QStringList{QStringLiteral("--armor"), QStringLiteral("--export")} + keyIds, &out, &err);
+    return out.toUtf8();
+}
+
+/** Keys for in-process signature checks: parsed once per session, extended on import. */
+struct SessionKeys {
+    QMutex mutex;
+    bool loaded = false;
+    OpenPgpVerifier::KeyRing ring;
+};
+
+SessionKeys& sessionKeys()
+{
+    static SessionKeys keys;
+    return keys;
+}
+
+/**
+ * The embedded catalog key, keys saved by earlier imports, and (one gpg launch per session)
+ * whatever the gpg homedir already holds. Returned by value; copies share the data.
+ */
+OpenPgpVerifier::KeyRing trustedKeyRing()
+{
+    SessionKeys& keys = sessionKeys();
+    QMutexLocker lock(&keys.mutex);
+    if (!keys.loaded) {
+        keys.loaded = true;
+        QFile embedded(QStringLiteral(":/iso-catalog/iso-catalog/catalog-signing.pub"));
+        if (embedded.open(QIODevice::ReadOnly)) {
+            keys.ring.addKeys(embedded.readAll());
+        }
+        const QDir dir(openPgpKeyDir());
+        for (const QString& name : dir.entryList({QStringLiteral("*.asc")}, QDir::Files)) {
+            QFile f(dir.filePath(name));
+            if (f.open(QIODevice::ReadOnly)) {
+                keys.ring.addKeys(f.readAll());
+            }
+        }
+        const QDir home(gpgHomedir());
+        if (gpgInstalled()
+            && (home.exists(QStringLiteral("pubring.kbx")) || home.exists(QStringLiteral("pubring.gpg")))) {
+            keys.ring.addKeys(exportGpgKeys());
+        }
     }
-    return listOut.contains(needle, Qt::CaseInsensitive);
+    return keys.ring;
 }
 
-bool importEmbeddedCatalogSigningKey(QString* logOut)
+/** Copies keys gpg just received into the session ring and the key directory. */
+void rememberGpgKey(const QString& keyId)
 {
-    if (!ensureGpgHome(logOut)) {
-        return false;
+    const QByteArray armored = exportGpgKeys({keyId});
+    SessionKeys& keys = sessionKeys();
+    QMutexLocker lock(&keys.mutex);
+    if (keys.ring.addKeys(armored) == 0) {
+        return;
+    }
+    QDir().mkpath(openPgpKeyDir());
+    QString name = keyId.trimmed();
+    name.remove(QRegularExpression(QStringLiteral("[^0-9A-Za-z]")));
+    QSaveFile file(openPgpKeyDir() + QLatin1Char('/') + name + QStringLiteral(".asc"));
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(armored);
+        file.commit();
+    }
+}
+
+/** One `gpg --list-keys` per homedir and session; later imports are tracked in memory. */
+bool publisherKeyAvailable(const QString& keyId)
+{
+    const QString home = gpgHomedir();
+    const QString needle = normalizedKeyId(keyId);
+    GpgSession& session = gpgSession();
+    QMutexLocker lock(&session.mutex);
+    GpgHomeState& state = session.homes[home];
+    if (!state.listed) {
+        QString err;
+        runGpg({QStringLiteral("--list-keys"), QStringLiteral("--with-colons")}, &state.listing, &err);
+        state.listed = err.isEmpty();
     }
+    return state.importedKeys.contains(needle) || state.listing.contains(needle, Qt::CaseInsensitive);
+}
+
+void markPublisherKeyImported(const QString& keyId)
+{
+    GpgSession& session = gpgSession();
+    QMutexLocker lock(&session.mutex);
+    session.homes[gpgHomedir()].importedKeys.insert(normalizedKeyId(keyId));
+}
+
+bool importEmbeddedCatalogSigningKey(QString* logOut)
+{
     const QString diskPub =
         gpgScratchRoot() + QStringLiteral("/resources/iso-catalog/catalog-signing.pub");
     if (QFile::exists(diskPub)) {
@@ -324,13 +717,36 @@ bool importEmbeddedCatalogSigningKey(QString* logOut)
     return err.isEmpty();
 }
 
+/** Imports the catalog key into the homedir once per session. */
+bool importEmbeddedCatalogSigningKeyOnce(QString* logOut)
+{
+    if (!ensureGpgHome(logOut)) {
+        return false;
+    }
+    const QString home = gpgHomedir();
+    GpgSession& session = gpgSession();
+    {
+        QMutexLocker lock(&session.mutex);
+        if (session.homes[home].catalogKeyImported) {
+            return true;
+        }
+    }
+    if (!importEmbeddedCatalogSigningKey(logOut)) {
+        return false;
+    }
+    QMutexLocker lock(&session.mutex);
+    session.homes[home].catalogKeyImported = true;
+    return true;
+}
+
 bool importPublisherKeys(const QStringList& keyIds, const QString& keyserver, QString* logOut)
 {
     if (!ensureGpgHome(logOut)) {
         return false;
     }
+    const OpenPgpVerifier::KeyRing ring = trustedKeyRing();
     for (const QString& keyId : keyIds) {
-        if (publisherKeyAvailable(keyId)) {
+        if (ring.contains(keyId) || publisherKeyAvailable(keyId)) {
             continue;
         }
         if (qEnvironmentVariableIsSet("FLASHSPARTAN_SKIP_KEYSERVER_IMPORT")) {
@@ -349,6 +765,8 @@ bool importPublisherKeys(const QStringList& keyIds, const QString& keyserver, QS
             }
             return false;
         }
+        markPublisherKeyImported(keyId);
+        rememberGpgKey(keyId);
     }
     return true;
 }
@@ -360,9 +778,27 @@ struct GpgVerifyDetails {
     QString fingerprint;
 };
 
-GpgVerifyDetails gpgVerifyDetached(const QString& sigPath, const QString& dataPath)
+/**
+ * Checks in-process against trustedKeyRing(); gpg only runs when that cannot decide (key not
+ * in the ring, algorithm it does not handle), after @p prepareGpg.
+ */
+GpgVerifyDetails gpgVerifyDetached(const QString& sigPath, const QString& dataPath,
+                                   const std::function<void()>& prepareGpg = {})
 {
     GpgVerifyDetails d;
+    const OpenPgpVerifier::Result native =
+        OpenPgpVerifier::verifyDetachedFile(trustedKeyRing(), sigPath, dataPath);
+    if (native.good() || native.status == OpenPgpVerifier::Status::Bad || !gpgInstalled()) {
+        d.valid = native.good();
+        d.summary = native.detail;
+        d.keyId = native.keyId;
+        d.fingerprint = native.fingerprint;
+        return d;
+    }
+    if (prepareGpg) {
+        prepareGpg();
+    }
+
     QString output;
     QString err;
     runGpg({QStringLiteral("--verify"),
@@ -405,10 +841,19 @@ QString buildReport(const IsoVerifyResult& r)
         lines << QStringLiteral("Publisher: %1 (%2)").arg(r.publisherName, r.releaseLabel);
     }
     if (!r.layoutNote.isEmpty()) lines << r.layoutNote;
-    lines << QStringLiteral("SHA-256: %1").arg(r.computedSha256);
+    if (!r.prescreenMismatch.isEmpty()) {
+        lines << QStringLiteral("Pre-screen: %1 [MISMATCH]").arg(r.prescreenMismatch);
+        lines << QStringLiteral("SHA-256: not computed");
+    } else {
+        lines << QStringLiteral("SHA-256: %1").arg(r.computedSha256);
+    }
     if (!r.expectedSha256.isEmpty()) {
         lines << QStringLiteral("Expected: %1 [%2]")
                      .arg(r.expectedSha256, r.hashMatches ? QStringLiteral("MATCH") : QStringLiteral("MISMATCH"));
+    } else if (!r.expectedDigest.isEmpty()) {
+        lines << QStringLiteral("%1: %2").arg(r.expectedDigestAlgorithm, r.computedDigest);
+        lines << QStringLiteral("Expected: %1 [%2]")
+                     .arg(r.expectedDigest, r.hashMatches ? QStringLiteral("MATCH") : QStringLiteral("MISMATCH"));
     }
     if (r.pgpChecked) {
         lines << QStringLiteral("OpenPGP: %1").arg(r.pgpValid ? QStringLiteral("valid") : QStringLiteral("FAILED"));
@@ -419,7 +864,10 @@ QString buildReport(const IsoVerifyResult& r)
         }
         if (!r.pgpSummary.isEmpty()) lines << r.pgpSummary;
     }
-    if (!r.checksumUrl.isEmpty()) lines << QStringLiteral("Checksums: %1").arg(r.checksumUrl);
+    if (!r.checksumUrl.isEmpty()) {
+        lines << QStringLiteral("Checksums: %1%2")
+                     .arg(r.checksumUrl, r.artifactsFromStore ? QStringLiteral(" (stored copy)") : QString());
+    }
     lines << QStringLiteral("Result: %1").arg(r.passed() ? QStringLiteral("PASS") : QStringLiteral("FAIL"));
     if (!r.errorMessage.isEmpty()) lines << QStringLiteral("Note: %1").arg(r.errorMessage);
     return lines.join(QLatin1Char('\n'));
@@ -429,46 +877,20 @@ QString buildReport(const IsoVerifyResult& r)
 
 namespace {
 
-void collectIsoFilesRecursive(const QString& directory, QStringList* out, int depth = 0)
-{
-    if (!out || depth > 64) {
-        return;
-    }
-    QDir dir(directory);
-    if (!dir.exists()) {
-        return;
-    }
-    const QFileInfoList entries =
-        dir.entryInfoList(QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
-    for (const QFileInfo& entry : entries) {
-        if (entry.isDir()) {
-            if (IsoScanRules::isReservedMultibootDirectory(entry.fileName())) {
-                continue;
-            }
-            collectIsoFilesRecursive(entry.absoluteFilePath(), out, depth + 1);
-        } else if (IsoCatalog::isVerifiableImageFileName(entry.fileName())) {
-            const QString path = entry.absoluteFilePath();
-            if (!IsoScanRules::isExcludedImagePath(path)) {
-                out->append(path);
-            }
-        }
-    }
-}
-
-} // namespace
+/** A mount scan that runs longer than this verifies what it has found and reports the rest as unscanned. */
+constexpr qint64 kMountScanBudgetMs = 30'000;
 
-IsoVerifier::MountScanResult IsoVerifier::scanMountPoint(const QString& mountPoint)
+/** Fills in the layout fields of @p scan once its image list is complete. */
+void describeMountLayout(IsoVerifier::MountScanResult& scan)
 {
-    MountScanResult scan;
-    scan.mountPoint = mountPoint;
-    scan.isoPaths = findIsoFiles(mountPoint);
-
+    const QString& mountPoint = scan.mountPoint;
     const MultibootLayout multiboot = IsoScanRules::detectMultibootLayout(mountPoint);
     const QDir root(mountPoint);
     const bool hasArchiso = root.exists(QStringLiteral("arch"));
     const bool hasDiskInfo = root.exists(QStringLiteral(".disk/info"));
     const bool hasEfi = root.exists(QStringLiteral("EFI"));
-    scan.looksLikeDdIsoStick = scan.isoPaths.isEmpty() && (hasArchiso || hasDiskInfo) && hasEfi;
+    scan.looksLikeDdIsoStick = scan.isoPaths.isEmpty() && !scan.scanTruncated
+                               && (hasArchiso || hasDiskInfo) && hasEfi;
 
     if (!multiboot.summary.isEmpty() && !scan.isoPaths.isEmpty()) {
         const QString note = IsoScanRules::coexistenceNote(multiboot.tool);
@@ -481,15 +903,37 @@ IsoVerifier::MountScanResult IsoVerifier::scanMountPoint(const QString& mountPoi
             "Bootable live-USB layout detected (dd/hybrid write). No loose .iso file — "
             "use full-partition verification or copy the original .iso onto the drive for automated checks.");
     }
+    if (scan.scanTruncated) {
+        const QString note = QStringLiteral("Scan stopped early (time or depth limit); images deeper in the drive were not checked.");
+        scan.layoutNote = scan.layoutNote.isEmpty() ? note : scan.layoutNote + QLatin1Char(' ') + note;
+    }
+}
+
+IsoImageScanner::Limits mountScanLimits()
+{
+    IsoImageScanner::Limits limits;
+    limits.timeBudgetMs = kMountScanBudgetMs;
+    limits.cancelled = activeOptions().cancelled;
+    return limits;
+}
+
+} // namespace
+
+IsoVerifier::MountScanResult IsoVerifier::scanMountPoint(const QString& mountPoint)
+{
+    const PinnedOptions pinned;
+    MountScanResult scan;
+    scan.mountPoint = mountPoint;
+    const IsoImageScanner::Result found = IsoImageScanner::scan(mountPoint, mountScanLimits());
+    scan.isoPaths = found.paths;
+    scan.scanTruncated = found.truncated;
+    describeMountLayout(scan);
     return scan;
 }
 
 QStringList IsoVerifier::findIsoFiles(const QString& directory)
 {
-    QStringList result;
-    collectIsoFilesRecursive(directory, &result);
-    result.sort();
-    return result;
+    return IsoImageScanner::scan(directory).paths;
 }
 
 QString IsoVerifier::findChecksumSidecar(const QString& isoPath)
@@ -507,6 +951,14 @@ QString IsoVerifier::findChecksumSidecar(const QString& isoPath)
         iso.absolutePath() + QStringLiteral("/sha256sum.txt"),
         iso.absolutePath() + QStringLiteral("/CHECKSUM"),
         iso.absoluteFilePath() + QStringLiteral(".CHECKSUM"),
+        // Publishers that ship only longer digests (Debian SHA512SUMS, Arch b2sums).
+        iso.absoluteFilePath() + QStringLiteral(".sha512"),
+        iso.absoluteFilePath() + QStringLiteral(".sha512sum"),
+        iso.absolutePath() + QStringLiteral("/SHA512SUMS"),
+        iso.absolutePath() + QStringLiteral("/sha512sums.txt"),
+        iso.absoluteFilePath() + QStringLiteral(".b2"),
+        iso.absolutePath() + QStringLiteral("/b2sums"),
+        iso.absolutePath() + QStringLiteral("/b2sums.txt"),
     };
     for (const QString& c : candidates) {
         if (QFileInfo::exists(c)) {
@@ -526,6 +978,7 @@ QString IsoVerifier::findSignatureSidecar(const QString& isoPath)
         iso.absolutePath() + QStringLiteral("/SHA256SUMS.gpg"),
         iso.absolutePath() + QStringLiteral("/sha256sums.txt.sig"),
         iso.absolutePath() + QStringLiteral("/sha256sum.txt.gpg"),
+        iso.absolutePath() + QStringLiteral("/SHA512SUMS.sign"),
         base + QStringLiteral(".sig"),
         iso.absoluteFilePath() + QStringLiteral(".sig"),
     };
@@ -545,6 +998,15 @@ IsoVerifyResult IsoVerifier::verifyIso(const QString& isoPath, const QString& mo
 
 IsoVerifyResult IsoVerifier::verifyIsoAutomated(const QString& isoPath, const QString& mountPoint,
                                                 const QString& deviceNode)
+{
+    const PinnedOptions pinned;
+    return verifyIsoCounted(isoPath, mountPoint, deviceNode, nullptr);
+}
+
+namespace {
+
+IsoVerifyResult verifyIsoCounted(const QString& isoPath, const QString& mountPoint, const QString& deviceNode,
+                                 std::atomic<uint64_t>* hashedBytes)
 {
     IsoVerifyResult r;
     r.isoPath = isoPath;
@@ -552,40 +1014,81 @@ IsoVerifyResult IsoVerifier::verifyIsoAutomated(const QString& isoPath, const QS
     r.deviceNode = deviceNode;
     QElapsedTimer timer;
     timer.start();
+    StageTimer imageStage(isoPath, "image");
 
     if (!QFileInfo::exists(isoPath)) {
         r.errorMessage = QStringLiteral("ISO not found");
         return r;
     }
 
-    if (g_verifyOptions.cancelled && g_verifyOptions.cancelled->load()) {
+    if (activeOptions().cancelled && activeOptions().cancelled->load()) {
         r.errorMessage = QStringLiteral("Cancelled");
         return r;
     }
 
-    QString hashErr;
-    r.computedSha256 = computeFileSha256(isoPath, g_verifyOptions, &hashErr);
-    if (r.computedSha256.isEmpty()) {
-        r.errorMessage = hashErr;
-        return r;
+    // A file of the wrong size or with the wrong first or last MiB is not the listed image;
+    // say so now instead of after the full read.
+    if (const auto listed = IsoCatalog::matchIso(isoPath)) {
+        StageTimer prescreenStage(isoPath, "prescreen");
+        r.prescreenMismatch = IsoPrescreen::mismatch(isoPath, *listed);
+        prescreenStage.end();
+        if (!r.prescreenMismatch.isEmpty()) {
+            r.publisherId = listed->publisherId;
+            r.publisherName = listed->publisherName;
+            r.releaseLabel = listed->releaseLabel;
+            r.source = IsoVerifySource::EmbeddedCatalog;
+            r.expectedSha256 = normalizeHash(listed->embeddedSha256);
+            r.success = true;
+            r.durationMs = static_cast<uint64_t>(timer.elapsed());
+            r.reportSummary = buildReport(r);
+            AuditLog::appendIsoVerify(r);
+            return r;
+        }
     }
-    r.hashChecked = true;
+
+    // The local hash streams on its own thread while this one fetches the publisher files and
+    // runs gpg; nothing below needs the hash until the comparison at the end.
+    const DigestAlgorithms algorithms = digestsToCompute(isoPath);
+    QString hashErr;
+    QFuture<DigestValues> hashFuture =
+        QtConcurrent::run(&hashStagePool(), [isoPath, algorithms, hashedBytes, &hashErr,
+                                             ioClass = IoPriority::current(), options = &activeOptions()]() {
+            const IoPriority::Scope io(ioClass);
+            const IsoVerifier::OptionsScope scope(*options);
+            StageTimer stage(isoPath, "hash");
+            DigestValues values;
+            computeFileDigests(isoPath, activeOptions(), algorithms, hashedBytes, &values, &hashErr);
+            return values;
+        });
 
     const QFileInfo isoFi(isoPath);
     const QString isoName = isoFi.fileName();
 
-    IsoCatalogManifest::refreshRemoteIfStale();
+    // SHA-256 lands in expectedSha256; a list that only has SHA-512 or BLAKE2b fills expectedDigest.
+    DigestAlgorithm expectedAlgorithm = DigestAlgorithm::Sha256;
+    const auto takeExpected = [&r, &isoName, &expectedAlgorithm](const QByteArray& data,
+                                                                 const QString& sourceName,
+                                                                 QString* parseErr) {
+        const IsoChecksum::Digest d =
+            ChecksumList::cached(data, sourceName)->find(isoName, ChecksumList::kAllAlgorithms, parseErr);
+        expectedAlgorithm = d.algorithm;
+        if (d.algorithm == DigestAlgorithm::Sha256) {
+            r.expectedSha256 = d.hex;
+        } else if (!d.isEmpty()) {
+            r.expectedDigest = d.hex;
+            r.expectedDigestAlgorithm = digestAlgorithmName(d.algorithm);
+        }
+    };
 
-    if (g_verifyOptions.preferOfflineSidecars) {
+    IsoCatalogManifest::refreshInBackground();
+
+    if (activeOptions().preferOfflineSidecars) {
         const QString checksumPath = IsoVerifier::findChecksumSidecar(isoPath);
         if (!checksumPath.isEmpty()) {
             QFile f(checksumPath);
             if (f.open(QIODevice::ReadOnly)) {
                 QString parseErr;
-                r.expectedSha256 =
-                    IsoChecksum::parseSha256Content(QString::fromUtf8(f.readAll()), isoName, &parseErr);
-                r.hashMatches = !r.expectedSha256.isEmpty()
-                                && normalizeHash(r.computedSha256) == normalizeHash(r.expectedSha256);
+                takeExpected(f.readAll(), checksumPath, &parseErr);
                 r.source = IsoVerifySource::LocalSidecar;
             }
         }
@@ -603,7 +1106,7 @@ IsoVerifyResult IsoVerifier::verifyIsoAutomated(const QString& isoPath, const QS
     }
 
     // 1) Try publisher catalog (remote, embedded, or hint)
-    if (r.expectedSha256.isEmpty()) {
+    if (!r.hasExpectedHash()) {
     if (auto match = IsoCatalog::matchIso(isoPath)) {
         r.publisherId = match->publisherId;
         r.publisherName = match->publisherName;
@@ -615,7 +1118,6 @@ IsoVerifyResult IsoVerifier::verifyIsoAutomated(const QString& isoPath, const QS
         if (!match->embeddedSha256.isEmpty()) {
             r.source = IsoVerifySource::EmbeddedCatalog;
             r.expectedSha256 = normalizeHash(match->embeddedSha256);
-            r.hashMatches = normalizeHash(r.computedSha256) == r.expectedSha256;
         } else if (match->hintOnly) {
             r.source = IsoVerifySource::EmbeddedCatalog;
             if (!match->referenceUrl.isEmpty()) {
@@ -626,45 +1128,55 @@ IsoVerifyResult IsoVerifier::verifyIsoAutomated(const QString& isoPath, const QS
         }
 
         QString fetchErr;
-        const QByteArray sumsData = match->checksumUrl.isEmpty() || !match->embeddedSha256.isEmpty()
-                                       ? QByteArray()
-                                       : httpGet(match->checksumUrl, &fetchErr);
+        const QString checksumSource = match->checksumUrl;
+        const auto namesImage = [&isoName, &checksumSource](const QByteArray& data) {
+            return !ChecksumList::cached(data, checksumSource)->find(isoName).isEmpty();
+        };
+        StageTimer sumsStage(isoPath, "checksums");
+        const PublisherArtifact sums =
+            match->checksumUrl.isEmpty() || !match->embeddedSha256.isEmpty()
+                ? PublisherArtifact()
+                : fetchPublisherArtifact(match->checksumUrl, *match,
+                                         match->publisherId + QStringLiteral("-SHA256SUMS.txt"),
+                                         true, &fetchErr, namesImage);
+        sumsStage.end();
+        const QByteArray& sumsData = sums.data;
         if (!sumsData.isEmpty()) {
             r.remoteFetched = true;
-            const QString sumsPath = cacheDir() + QLatin1Char('/') + match->publisherId
-                                     + QStringLiteral("-SHA256SUMS.txt");
-            QFile::remove(sumsPath);
-            QFile sumsFile(sumsPath);
-            if (sumsFile.open(QIODevice::WriteOnly)) {
-                sumsFile.write(sumsData);
-                sumsFile.close();
-            }
+            r.artifactsFromStore = sums.fromStore;
+            const QString& sumsPath = sums.path;
 
             QString parseErr;
-            r.expectedSha256 = IsoChecksum::parseSha256Content(QString::fromUtf8(sumsData), isoName, &parseErr);
-            if (!r.expectedSha256.isEmpty()) {
-                r.hashMatches = normalizeHash(r.computedSha256) == normalizeHash(r.expectedSha256);
-            } else if (!parseErr.isEmpty()) {
+            takeExpected(sumsData, match->checksumUrl, &parseErr);
+            if (!r.hasExpectedHash() && !parseErr.isEmpty()) {
                 r.errorMessage = parseErr;
             }
 
-            const QByteArray sigData = httpGet(match->signatureUrl, &fetchErr);
-            if (!sigData.isEmpty()) {
-                const QString sigSuffix = match->perFileArtifacts ? QStringLiteral("-iso.sig")
-                                                                  : QStringLiteral("-SHA256SUMS.sig");
-                const QString sigPath = cacheDir() + QLatin1Char('/') + match->publisherId + sigSuffix;
-                QFile sigFile(sigPath);
-                if (sigFile.open(QIODevice::WriteOnly)) {
-                    sigFile.write(sigData);
-                    sigFile.close();
-                }
+            // A stored signature only pairs with stored checksums; fresh SUMS get a fresh sig.
+            const QString sigSuffix = match->perFileArtifacts ? QStringLiteral("-iso.sig")
+                                                              : QStringLiteral("-SHA256SUMS.sig");
+            StageTimer sigStage(isoPath, "signature_download");
+            const PublisherArtifact sig =
+                match->signatureUrl.isEmpty()
+                    ? PublisherArtifact()
+                    : fetchPublisherArtifact(match->signatureUrl, *match, match->publisherId + sigSuffix,
+                                             sums.fromStore, &fetchErr);
+            sigStage.end();
+            if (!sig.data.isEmpty()) {
+                r.artifactsFromStore = r.artifactsFromStore && sig.fromStore;
+                const QString& sigPath = sig.path;
 
                 r.keyserverUsed = QStringLiteral("hkps://keys.openpgp.org");
                 QString importLog;
-                if (importPublisherKeys(match->signingKeyIds, r.keyserverUsed, &importLog)) {
+                StageTimer importStage(isoPath, "key_import");
+                const bool keysReady = importPublisherKeys(match->signingKeyIds, r.keyserverUsed, &importLog);
+                importStage.end();
+                if (keysReady) {
                     r.pgpChecked = true;
                     const QString signedDataPath = match->perFileArtifacts ? isoPath : sumsPath;
+                    StageTimer verifyStage(isoPath, "signature_verify");
                     const GpgVerifyDetails vd = gpgVerifyDetached(sigPath, signedDataPath);
+                    verifyStage.end();
                     r.pgpValid = vd.valid;
                     r.pgpSummary = vd.summary;
                     r.signingKeyId = vd.keyId;
@@ -684,7 +1196,7 @@ IsoVerifyResult IsoVerifier::verifyIsoAutomated(const QString& isoPath, const QS
             }
         } else if (r.errorMessage.isEmpty() && !match->hintOnly && !match->checksumUrl.isEmpty()) {
             r.errorMessage = QStringLiteral("Could not download publisher checksums: %1").arg(fetchErr);
-        } else if (match->hintOnly && r.expectedSha256.isEmpty() && r.errorMessage.isEmpty()) {
+        } else if (match->hintOnly && !r.hasExpectedHash() && r.errorMessage.isEmpty()) {
             r.errorMessage = QStringLiteral(
                 "Known image type — add a .sha256 sidecar next to the file or update the embedded "
                 "catalog (see %1).")
@@ -695,23 +1207,20 @@ IsoVerifyResult IsoVerifier::verifyIsoAutomated(const QString& isoPath, const QS
     }
 
     // 2) Local sidecars on drive (Rufus users often copy .sha256 + .asc alongside)
-    if (r.expectedSha256.isEmpty()) {
+    if (!r.hasExpectedHash()) {
         const QString checksumPath = IsoVerifier::findChecksumSidecar(isoPath);
         if (!checksumPath.isEmpty()) {
             QFile f(checksumPath);
             if (f.open(QIODevice::ReadOnly)) {
                 QString parseErr;
-                r.expectedSha256 = IsoChecksum::parseSha256Content(QString::fromUtf8(f.readAll()), isoName, &parseErr);
-                r.hashMatches = !r.expectedSha256.isEmpty()
-                                && normalizeHash(r.computedSha256) == normalizeHash(r.expectedSha256);
+                takeExpected(f.readAll(), checksumPath, &parseErr);
                 r.source = IsoVerifySource::LocalSidecar;
             }
         }
     }
 
-    if (r.expectedSha256.isEmpty()) {
+    if (!r.hasExpectedHash()) {
         r.source = IsoVerifySource::ComputedOnly;
-        r.hashMatches = true;
         r.reportSummary = QStringLiteral(
             "Computed SHA-256 only — unknown publisher, offline, or no checksum available. "
             "Add a .sha256 sidecar or update the catalog.");
@@ -719,11 +1228,14 @@ IsoVerifyResult IsoVerifier::verifyIsoAutomated(const QString& isoPath, const QS
 
     const QString sigPath = IsoVerifier::findSignatureSidecar(isoPath);
     if (!sigPath.isEmpty() && !r.pgpChecked) {
-        ensureGpgHome(nullptr);
-        if (!r.trustedFingerprints.isEmpty()
-            && qEnvironmentVariableIsSet("FLASHSPARTAN_SKIP_KEYSERVER_IMPORT")) {
-            importEmbeddedCatalogSigningKey(nullptr);
-        }
+        const bool importCatalogKey = !r.trustedFingerprints.isEmpty()
+                                      && qEnvironmentVariableIsSet("FLASHSPARTAN_SKIP_KEYSERVER_IMPORT");
+        const auto prepareGpg = [importCatalogKey]() {
+            ensureGpgHome(nullptr);
+            if (importCatalogKey) {
+                importEmbeddedCatalogSigningKeyOnce(nullptr);
+            }
+        };
         r.pgpChecked = true;
         QString signedDataPath = isoPath;
         const QFileInfo sigFi(sigPath);
@@ -731,7 +1243,9 @@ IsoVerifyResult IsoVerifier::verifyIsoAutomated(const QString& isoPath, const QS
         const QStringList sumsNames = {QStringLiteral("SHA256SUMS"),
                                        QStringLiteral("sha256sums.txt"),
                                        QStringLiteral("sha256sum.txt"),
-                                       QStringLiteral("CHECKSUM")};
+                                       QStringLiteral("CHECKSUM"),
+                                       QStringLiteral("SHA512SUMS"),
+                                       QStringLiteral("b2sums.txt")};
         for (const QString& name : sumsNames) {
             const QString candidate = dir + QLatin1Char('/') + name;
             if (QFileInfo::exists(candidate)) {
@@ -739,7 +1253,9 @@ IsoVerifyResult IsoVerifier::verifyIsoAutomated(const QString& isoPath, const QS
                 break;
             }
         }
-        const GpgVerifyDetails vd = gpgVerifyDetached(sigPath, signedDataPath);
+        StageTimer verifyStage(isoPath, "signature_verify");
+        const GpgVerifyDetails vd = gpgVerifyDetached(sigPath, signedDataPath, prepareGpg);
+        verifyStage.end();
         r.pgpValid = vd.valid;
         r.pgpSummary = vd.summary;
         r.signingKeyFingerprint = vd.fingerprint;
@@ -751,6 +1267,33 @@ IsoVerifyResult IsoVerifier::verifyIsoAutomated(const QString& isoPath, const QS
         }
     }
 
+    StageTimer waitStage(isoPath, "hash_wait");
+    DigestValues computed = hashFuture.result();
+    waitStage.end();
+    r.computedSha256 = computed.sha256;
+    if (r.computedSha256.isEmpty()) {
+        r.errorMessage = hashErr;
+        return r;
+    }
+    if (!r.expectedDigest.isEmpty()) {
+        // A second pass; whoever took the first one's data does not get it again.
+        IsoVerifyOptions again = activeOptions();
+        again.imageDataRead = nullptr;
+        if (computed.value(expectedAlgorithm).isEmpty()
+            && !computeFileDigests(isoPath, again, expectedAlgorithm, nullptr, &computed, &hashErr)) {
+            // The list turned out to use an algorithm digestsToCompute did not foresee.
+            r.errorMessage = hashErr;
+            return r;
+        }
+        r.computedDigest = computed.value(expectedAlgorithm);
+    }
+    r.hashChecked = true;
+    if (!r.expectedSha256.isEmpty()) {
+        r.hashMatches = normalizeHash(r.computedSha256) == normalizeHash(r.expectedSha256);
+    } else {
+        r.hashMatches = r.expectedDigest.isEmpty() || r.computedDigest == r.expectedDigest;
+    }
+
     r.success = true;
     r.durationMs = static_cast<uint64_t>(timer.elapsed());
     r.reportSummary = buildReport(r);
@@ -758,52 +1301,234 @@ IsoVerifyResult IsoVerifier::verifyIsoAutomated(const QString& isoPath, const QS
     return r;
 }
 
-namespace {
+/** Ceiling for learned per-drive concurrency when iso/verifyParallel does not ask for more. */
+constexpr int kMaxAutoParallel = 8;
+/** How often each drive's aggregate hash throughput is sampled. */
+constexpr int kThroughputTickMs = 250;
+
+/**
+ * Whole-disk identity of the device holding @p path ("block:sdb" for a file on /dev/sdb1),
+ * so images on two partitions of one stick share its limit; the volume's device elsewhere.
+ * Empty when unknown.
+ */
+QString backingDeviceKey(const QString& path)
+{
+#ifdef Q_OS_LINUX
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) == 0) {
+        const QString sysPath =
+            QFileInfo(QStringLiteral("/sys/dev/block/%1:%2").arg(major(st.st_dev)).arg(minor(st.st_dev)))
+                .canonicalFilePath();
+        if (!sysPath.isEmpty()) {
+            // A partition's sysfs directory sits inside its disk's.
+            const QFileInfo node(sysPath);
+            const bool partition = QFileInfo::exists(sysPath + QStringLiteral("/partition"));
+            return QStringLiteral("block:")
+                   + (partition ? QFileInfo(node.absolutePath()).fileName() : node.fileName());
+        }
+    }
+#endif
+    const QStorageInfo storage(path);
+    return storage.isValid() ? QStringLiteral("volume:") + QString::fromUtf8(storage.device()) : QString();
+}
 
+/** Runs on its own thread and reports each image it finds through @p found. */
+using ImageProducer = std::function<void(const std::function<void(const QString& path)>& found)>;
+
+/**
+ * Verifies @p paths with HashScheduler deciding what runs: images are grouped by backing
+ * drive, each drive starts at one verify and gets another only while that raises its
+ * measured hash throughput, and the largest images start first. A slow stick stays
+ * serial instead of thrashing (a seek-sensitive one from the start, see FileExtents); an
+ * NVMe drive scales up to the ceiling. With @p producer,
+ * images it finds join the queue as they arrive, so hashing starts while a scan goes on.
+ * Results come back in path order.
+ */
 QList<IsoVerifyResult> verifyPathsParallel(const QStringList& paths, const QString& mountPoint,
-                                           const QString& deviceNode)
+                                           const QString& deviceNode, const ImageProducer& producer = {})
 {
     QList<IsoVerifyResult> results;
-    if (paths.isEmpty()) {
+    if (paths.isEmpty() && !producer) {
         return results;
     }
 
-    const int parallel = qMax(1, g_verifyOptions.maxParallel);
-    QThreadPool pool;
-    pool.setMaxThreadCount(parallel);
-
+    // 1 keeps verification serial; otherwise the setting only raises the learned ceiling.
+    const int ceiling = activeOptions().parallelLimit > 0 ? activeOptions().parallelLimit
+                        : activeOptions().maxParallel <= 1
+                            ? 1
+                            : qMax(activeOptions().maxParallel,
+                                   qMin(QThread::idealThreadCount(), kMaxAutoParallel));
+    HashScheduler scheduler;
+    scheduler.setGlobalLimit(ceiling);
+    scheduler.setOrder(HashScheduler::Order::LongestFirst);
+
+    struct Job {
+        QString device;
+        uint64_t size = 0;
+        std::atomic<uint64_t> hashedBytes{0};
+        uint64_t sampledBytes = 0;
+    };
+    std::deque<Job> jobs;  // running verifies hold references into it
+    QStringList allPaths;
+    QList<int> waiting;
     QMutex mutex;
-    results.resize(paths.size());
+    QWaitCondition jobFinished;
+    QList<int> finished;  // guarded by mutex, as are results, arrived and scanning
+    QStringList arrived;
+    bool scanning = static_cast<bool>(producer);
+
+    QSet<QString> probedDevices;
+    const auto enqueue = [&](const QString& path) {
+        Job& job = jobs.emplace_back();
+        job.device = backingDeviceKey(path);
+        // Concurrent image reads on a seek-bound stick only interleave; do not even probe.
+        if (!job.device.isEmpty() && !probedDevices.contains(job.device)) {
+            probedDevices.insert(job.device);
+            if (FileExtents::seekSensitive(QFileInfo(path).absolutePath())) {
+                scheduler.pinLimit(job.device, 1);
+            }
+        }
+        job.size = static_cast<uint64_t>(qMax<qint64>(0, QFileInfo(path).size()));
+        waiting.append(static_cast<int>(allPaths.size()));
+        allPaths.append(path);
+        QMutexLocker lock(&mutex);
+        results.append(IsoVerifyResult());
+    };
+    for (const QString& path : paths) {
+        enqueue(path);
+    }
 
-    auto verifyOne = [&](int index) {
-        if (g_verifyOptions.cancelled && g_verifyOptions.cancelled->load()) {
-            return;
+    // Nor the caller's OptionsScope, which the scan and pool threads put back in place.
+    const IsoVerifyOptions* options = &activeOptions();
+    std::thread scanThread;
+    if (producer) {
+        scanThread = std::thread([&]() {
+            const IsoVerifier::OptionsScope scope(*options);
+            producer([&](const QString& path) {
+                QMutexLocker lock(&mutex);
+                arrived.append(path);
+                jobFinished.wakeAll();
+            });
+            QMutexLocker lock(&mutex);
+            scanning = false;
+            jobFinished.wakeAll();
+        });
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(ceiling);
+    // Pool threads do not inherit the caller's I/O class.
+    const IoPriority::Class ioClass = IoPriority::current();
+
+    QList<int> running;
+    QSet<QString> changedDevices;  // a job started or ended there during this tick
+    int started = 0;
+    QElapsedTimer tick;
+    tick.start();
+
+    const auto sampleThroughput = [&]() {
+        const double seconds = static_cast<double>(qMax<qint64>(1, tick.restart())) / 1000.0;
+        QHash<QString, uint64_t> bytes;
+        QHash<QString, int> active;
+        QHash<QString, int> jobsOn;
+        for (int index : running) {
+            Job& job = jobs[index];
+            const uint64_t now = job.hashedBytes.load(std::memory_order_relaxed);
+            ++jobsOn[job.device];
+            if (now > job.sampledBytes) {
+                bytes[job.device] += now - job.sampledBytes;
+                ++active[job.device];
+            }
+            job.sampledBytes = now;
         }
-        if (g_verifyOptions.progress) {
-            g_verifyOptions.progress(index + 1, paths.size(), QFileInfo(paths.at(index)).fileName());
+        for (auto it = jobsOn.constBegin(); it != jobsOn.constEnd(); ++it) {
+            // Only ticks where every job on the drive was hashing say what that concurrency delivers.
+            if (it.key().isEmpty() || changedDevices.contains(it.key()) || active.value(it.key()) != it.value()) {
+                continue;
+            }
+            scheduler.recordThroughput(it.key(), it.value(),
+                                       static_cast<double>(bytes.value(it.key())) / (1024.0 * 1024.0) / seconds);
         }
-        IsoVerifyResult r = IsoVerifier::verifyIsoAutomated(paths.at(index), mountPoint, deviceNode);
-        QMutexLocker lock(&mutex);
-        results[index] = r;
+        changedDevices.clear();
     };
 
-    if (parallel <= 1 || paths.size() == 1) {
-        for (int i = 0; i < paths.size(); ++i) {
-            verifyOne(i);
+    bool stillScanning = scanning;
+    while (!waiting.isEmpty() || !running.isEmpty() || stillScanning) {
+        if (activeOptions().cancelled && activeOptions().cancelled->load()) {
+            waiting.clear();
         }
-    } else {
-        QList<QFuture<void>> futures;
-        futures.reserve(paths.size());
-        for (int i = 0; i < paths.size(); ++i) {
-            futures.append(QtConcurrent::run(&pool, verifyOne, i));
+        while (!waiting.isEmpty()) {
+            QList<HashScheduler::Pending> pending;
+            for (int index : waiting) {
+                pending.append({jobs[index].device, QString(), jobs[index].size, 0});
+            }
+            QList<HashScheduler::Running> active;
+            for (int index : running) {
+                active.append({jobs[index].device, QString()});
+            }
+            const int pick = scheduler.pickNext(pending, active);
+            if (pick < 0) {
+                break;
+            }
+            const int index = waiting.takeAt(pick);
+            const QString path = allPaths.at(index);
+            if (activeOptions().progress) {
+                activeOptions().progress(++started, allPaths.size(), QFileInfo(path).fileName());
+            }
+            running.append(index);
+            changedDevices.insert(jobs[index].device);
+            std::atomic<uint64_t>* hashedBytes = &jobs[index].hashedBytes;
+            QtConcurrent::run(&pool, [&, index, path, hashedBytes]() {
+                const IoPriority::Scope io(ioClass);
+                const IsoVerifier::OptionsScope scope(*options);
+                IsoVerifyResult r = verifyIsoCounted(path, mountPoint, deviceNode, hashedBytes);
+                QMutexLocker lock(&mutex);
+                if (activeOptions().resultReady) {
+                    activeOptions().resultReady(r);
+                }
+                results[index] = r;
+                finished.append(index);
+                jobFinished.wakeAll();
+            });
+        }
+        if (running.isEmpty() && !stillScanning) {
+            break;
+        }
+
+        QStringList newPaths;
+        {
+            QMutexLocker lock(&mutex);
+            if (finished.isEmpty() && arrived.isEmpty() && (scanning || !running.isEmpty())) {
+                jobFinished.wait(&mutex, static_cast<unsigned long>(
+                                             qMax<qint64>(1, kThroughputTickMs - tick.elapsed())));
+            }
+            for (int index : finished) {
+                running.removeOne(index);
+                changedDevices.insert(jobs[index].device);
+            }
+            finished.clear();
+            newPaths.swap(arrived);
+            stillScanning = scanning;
+        }
+        for (const QString& path : newPaths) {
+            enqueue(path);
         }
-        for (QFuture<void>& f : futures) {
-            f.waitForFinished();
+        if (tick.elapsed() >= kThroughputTickMs) {
+            sampleThroughput();
         }
     }
+    pool.waitForDone();
+    if (scanThread.joinable()) {
+        scanThread.join();
+    }
 
+    std::vector<int> order(static_cast<size_t>(allPaths.size()));
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](int a, int b) { return allPaths.at(a) < allPaths.at(b); });
     QList<IsoVerifyResult> ordered;
-    for (const IsoVerifyResult& r : results) {
+    for (int index : order) {
+        const IsoVerifyResult& r = results.at(index);
         if (!r.isoPath.isEmpty() || !r.layoutNote.isEmpty()) {
             ordered.append(r);
         }
@@ -811,16 +1536,79 @@ QList<IsoVerifyResult> verifyPathsParallel(const QStringList& paths, const QStri
     return ordered;
 }
 
+/**
+ * A dd-written installer has no image file to hash, but the image is still the first
+ * image_size bytes of the disk. When the catalog knows the stick's volume label, hash
+ * exactly that prefix of the raw device (elevated helper when the node is not readable).
+ */
+std::optional<IsoVerifyResult> verifyDdImagePrefix(const QString& mountPoint, const QString& deviceNode)
+{
+    if (deviceNode.isEmpty()) {
+        return std::nullopt;
+    }
+    const QString label = QStorageInfo(mountPoint).name();
+    const std::optional<IsoPublisherMatch> match = IsoCatalogManifest::lookupDdImage(label);
+    if (!match) {
+        return std::nullopt;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    IsoVerifyResult r;
+    r.mountPoint = mountPoint;
+    r.deviceNode = IoScheduler::wholeDiskNode(deviceNode);
+    r.isoPath = r.deviceNode;
+    r.publisherId = match->publisherId;
+    r.publisherName = match->publisherName;
+    r.releaseLabel = match->releaseLabel;
+    r.source = IsoVerifySource::EmbeddedCatalog;
+    r.expectedSha256 = normalizeHash(match->embeddedSha256);
+    r.layoutNote = QStringLiteral("dd-written image \"%1\": first %2 bytes of %3 hashed")
+                       .arg(label, QString::number(match->imageSizeBytes), r.deviceNode);
+
+    RawDeviceHash::Options options;
+    options.deviceNode = r.deviceNode;
+    options.lengthLimit = match->imageSizeBytes;
+    options.cancelled = activeOptions().cancelled;
+    std::atomic<uint64_t> hashedBytes{0};
+    options.bytesProcessed = &hashedBytes;  // lets a background verify pace the read
+    const HashResult hashed = RawDeviceHash::hashDevice(options);
+    if (!hashed.success) {
+        r.errorMessage = hashed.errorMessage;
+    } else {
+        r.computedSha256 = normalizeHash(hashed.hash);
+        r.hashChecked = true;
+        r.hashMatches = r.computedSha256 == r.expectedSha256;
+        r.success = true;
+    }
+    r.durationMs = static_cast<uint64_t>(timer.elapsed());
+    r.reportSummary = buildReport(r);
+    AuditLog::appendIsoVerify(r);
+    return r;
+}
+
 } // namespace
 
-IsoVerifyOptions& IsoVerifier::verifyOptions()
+IsoVerifier::OptionsScope::OptionsScope(const IsoVerifyOptions& options)
+    : m_previous(t_jobOptions)
+{
+    t_jobOptions = &options;
+}
+
+IsoVerifier::OptionsScope::~OptionsScope()
 {
-    return g_verifyOptions;
+    t_jobOptions = m_previous;
+}
+
+IsoVerifyOptions IsoVerifier::verifyOptions()
+{
+    return *std::atomic_load(&g_verifyOptions);
 }
 
 void IsoVerifier::setVerifyOptions(const IsoVerifyOptions& options)
 {
-    g_verifyOptions = options;
+    std::atomic_store(&g_verifyOptions, std::make_shared<const IsoVerifyOptions>(options));
+    IsoHttpClient::setMirror(options.mirrorUrl);
 }
 
 bool IsoVerifier::mountScanHasFailures(const QList<IsoVerifyResult>& results)
@@ -835,21 +1623,42 @@ bool IsoVerifier::mountScanHasFailures(const QList<IsoVerifyResult>& results)
 
 QList<IsoVerifyResult> IsoVerifier::verifyDirectory(const QString& directory)
 {
+    const PinnedOptions pinned;
     return verifyPathsParallel(findIsoFiles(directory), directory, {});
 }
 
-QList<IsoVerifyResult> IsoVerifier::verifyMountPoint(const QString& mountPoint, const QString& deviceNode)
+QList<IsoVerifyResult> IsoVerifier::verifyFiles(const QStringList& paths)
 {
-    QList<IsoVerifyResult> results;
-    const MountScanResult scan = scanMountPoint(mountPoint);
+    const PinnedOptions pinned;
+    return verifyPathsParallel(paths, {}, {});
+}
 
-    results = verifyPathsParallel(scan.isoPaths, mountPoint, deviceNode);
+QList<IsoVerifyResult> IsoVerifier::verifyMountPoint(const QString& mountPoint, const QString& deviceNode)
+{
+    const PinnedOptions pinned;
+    MountScanResult scan;
+    scan.mountPoint = mountPoint;
+    // Images are hashed as the walk finds them; the layout is only known once it ends.
+    QList<IsoVerifyResult> results = verifyPathsParallel(
+        {}, mountPoint, deviceNode, [&](const std::function<void(const QString& path)>& found) {
+            const IsoImageScanner::Result walked = IsoImageScanner::scan(mountPoint, mountScanLimits(), found);
+            scan.isoPaths = walked.paths;
+            scan.scanTruncated = walked.truncated;
+        });
+    describeMountLayout(scan);
     for (IsoVerifyResult& r : results) {
         if (!scan.layoutNote.isEmpty() && r.layoutNote.isEmpty()) {
             r.layoutNote = scan.layoutNote;
         }
     }
 
+    if (results.isEmpty() && scan.looksLikeDdIsoStick && activeOptions().verifyDdImages) {
+        if (std::optional<IsoVerifyResult> dd = verifyDdImagePrefix(mountPoint, deviceNode)) {
+            results.append(*dd);
+            return results;
+        }
+    }
+
     if (results.isEmpty() && scan.looksLikeDdIsoStick) {
         IsoVerifyResult note;
         note.success = true;
@@ -3,7 +3,9 @@
 #include "IsoVerifier.h"
 #include "IsoCatalogManifest.h"
 #include "IsoScanRules.h"
+#include "IsoVerifyCache.h"
 #include "IsoVerifyReport.h"
+#include "ProgressHub.h"
 #include "SettingsProfiles.h"
 #include "StyleManager.h"
 
@@ -123,18 +125,35 @@ IsoVerifierWidget::IsoVerifierWidget(QWidget* parent)
         m_verifyBtn->setEnabled(false);
         m_summaryStrip->setVisible(false);
     });
-    connect(m_worker, &IsoVerifierWorker::verificationFileProgress, this,
-            [this](int current, int total, const QString& file) {
-                if (total > 0) {
-                    m_progress->setRange(0, total);
-                    m_progress->setValue(current);
-                    m_progress->setFormat(QStringLiteral("%1 / %2 — %3").arg(current).arg(total).arg(
-                        QFileInfo(file).fileName()));
+    connect(&ProgressHub::instance(), &ProgressHub::published, this,
+            [this](const QList<ProgressSample>& samples) {
+                // Several sticks may verify at once; the bar counts their images together.
+                int current = 0;
+                int total = 0;
+                int runs = 0;
+                QString detail;
+                for (const ProgressSample& sample : samples) {
+                    if (sample.kind != ProgressSample::Kind::IsoVerify || sample.itemsTotal == 0
+                        || !m_worker->ownsJob(sample.jobId)) {
+                        continue;
+                    }
+                    current += int(sample.itemsDone);
+                    total += int(sample.itemsTotal);
+                    ++runs;
+                    if (sample.jobId == m_worker->jobId() || detail.isEmpty()) {
+                        detail = sample.detail;
+                    }
                 }
-                const QString msg =
-                    QStringLiteral("Verifying %1 (%2/%3)…").arg(file).arg(current).arg(total);
-                m_summaryLabel->setText(msg);
-                emit logMessageRequested(msg);
+                if (total == 0) {
+                    return;
+                }
+                m_progress->setRange(0, total);
+                m_progress->setValue(current);
+                m_progress->setFormat(QStringLiteral("%1 / %2 — %3").arg(current).arg(total).arg(
+                    QFileInfo(detail).fileName()));
+                m_summaryLabel->setText(
+                    runs > 1 ? QStringLiteral("Verifying %1 drives (%2/%3)…").arg(runs).arg(current).arg(total)
+                             : QStringLiteral("Verifying %1 (%2/%3)…").arg(detail).arg(current).arg(total));
             });
     connect(m_worker, &IsoVerifierWorker::verificationProgress, this, [this](const QString& msg) {
         m_summaryLabel->setText(msg);
@@ -144,12 +163,25 @@ IsoVerifierWidget::IsoVerifierWidget(QWidget* parent)
             &IsoVerifierWidget::onVerificationFinished);
     connect(m_worker, &IsoVerifierWorker::verificationFailed, this,
             [this](const QString& mount, const QString& err) {
-                m_progress->setVisible(false);
-                m_verifyBtn->setEnabled(true);
+                if (!m_worker->hasActiveJobs()) {
+                    m_progress->setVisible(false);
+                    m_verifyBtn->setEnabled(true);
+                }
                 m_summaryLabel->setText(QStringLiteral("Verification failed: %1").arg(err));
                 emit logMessageRequested(QStringLiteral("ISO verify failed (%1): %2").arg(mount, err));
             });
 
+    connect(&IsoCatalogNotifier::instance(), &IsoCatalogNotifier::refreshFinished, this, [this](bool ok) {
+        updateCatalogIntegrityBanner();
+        if (!m_catalogUpdateRequested) {
+            return;
+        }
+        m_catalogUpdateRequested = false;
+        m_summaryLabel->setText(ok ? QStringLiteral("Catalog updated (%1 entries)")
+                                         .arg(IsoCatalogManifest::entryCount())
+                                   : QStringLiteral("Catalog update failed (using embedded copy)"));
+    });
+
     applyChromeStyles();
     updateCatalogIntegrityBanner();
     updateMultibootBadge();
@@ -608,11 +640,8 @@ void IsoVerifierWidget::onCopyReport()
 void IsoVerifierWidget::onUpdateCatalog()
 {
     m_summaryLabel->setText(QStringLiteral("Updating ISO catalog…"));
-    const bool ok = IsoCatalogManifest::refreshRemoteIfStale(0, true);
-    updateCatalogIntegrityBanner();
-    m_summaryLabel->setText(ok ? QStringLiteral("Catalog updated (%1 entries)")
-                                         .arg(IsoCatalogManifest::entryCount())
-                               : QStringLiteral("Catalog update failed (using embedded copy)"));
+    m_catalogUpdateRequested = true;
+    IsoCatalogManifest::refreshInBackground(0, true);
 }
 
 void IsoVerifierWidget::updateCatalogIntegrityBanner()
@@ -658,8 +687,10 @@ void IsoVerifierWidget::onVerificationFinished(const QString& location, const QS
     Q_UNUSED(location)
     m_lastDeviceNode = deviceNode;
     setResults(results);
-    m_progress->setVisible(false);
-    m_verifyBtn->setEnabled(true);
+    if (!m_worker->hasActiveJobs()) {
+        m_progress->setVisible(false);
+        m_verifyBtn->setEnabled(true);
+    }
     updatePageVisibility();
     emit verificationReportReady(deviceNode, results);
 }
@@ -680,8 +711,10 @@ void IsoVerifierWidget::setResults(const QList<IsoVerifyResult>& results)
             r.publisherName.isEmpty() ? QStringLiteral("—")
                                       : r.publisherName + QLatin1Char(' ') + r.releaseLabel));
 
-        QString hashCol = r.hashChecked
-                              ? (r.expectedSha256.isEmpty()
+        QString hashCol = !r.prescreenMismatch.isEmpty()
+                              ? QStringLiteral("MISMATCH (pre-screen)")
+                              : r.hashChecked
+                              ? (!r.hasExpectedHash()
                                      ? QStringLiteral("computed")
                                      : (r.hashMatches ? QStringLiteral("OK") : QStringLiteral("MISMATCH")))
                               : QStringLiteral("—");
@@ -718,6 +751,13 @@ void IsoVerifierWidget::setResults(const QList<IsoVerifyResult>& results)
     updateSummaryStrip(counts.passed, counts.total, counts.needsSidecar);
     m_summaryLabel->setText(IsoVerifyReport::summaryLine(results));
     emit logMessageRequested(QStringLiteral("ISO verify: %1").arg(IsoVerifyReport::summaryLine(results)));
+    const IsoVerifyCache::Stats cache = IsoVerifyCache::stats();
+    if (cache.hits + cache.misses > 0) {
+        emit logMessageRequested(QStringLiteral("ISO hash cache: %1 hit(s), %2 miss(es), %3 entr(ies) this session")
+                                     .arg(cache.hits)
+                                     .arg(cache.misses)
+                                     .arg(cache.entries));
+    }
 
     if (!results.isEmpty()) {
         m_table->selectRow(0);
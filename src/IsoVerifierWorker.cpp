@@ -1,75 +1,189 @@
 #include "IsoVerifierWorker.h"
 #include "IsoVerifier.h"
 
-#include <QtConcurrent>
+#include <QMutexLocker>
+#include <QUuid>
 
 namespace FlashSpartan {
 
 IsoVerifierWorker::IsoVerifierWorker(QObject* parent)
     : QObject(parent)
 {
+    ProgressHub::instance().addSource(this, [this]() { return progressSnapshot(); });
 }
 
-void IsoVerifierWorker::cancel()
+IsoVerifierWorker::~IsoVerifierWorker()
 {
-    m_cancelled = true;
-    m_cancelledFlag = true;
+    cancel();
+    QList<std::shared_ptr<Job>> jobs;
+    {
+        QMutexLocker lock(&m_jobsMutex);
+        jobs = m_jobs.values();
+    }
+    // Mount jobs post progress through this object; a queued job that never starts ends as
+    // cancelled. Jobs still awaiting are destroyed with their watchers, without emitting.
+    for (const auto& job : std::as_const(jobs)) {
+        job->future.waitForFinished();
+    }
 }
 
-void IsoVerifierWorker::verifyMountPoint(const QString& mountPoint, const QString& deviceNode)
+QList<ProgressSample> IsoVerifierWorker::progressSnapshot() const
 {
-    m_cancelled = false;
-    m_cancelledFlag = false;
-    IsoVerifyOptions opt = IsoVerifier::verifyOptions();
-    opt.cancelled = &m_cancelledFlag;
-    opt.progress = [this](int current, int total, const QString& file) {
-        emit verificationFileProgress(current, total, file);
-        emit verificationProgress(
-            QStringLiteral("Verifying %1 (%2/%3)…").arg(file).arg(current).arg(total));
+    QMutexLocker lock(&m_jobsMutex);
+    QList<ProgressSample> samples;
+    samples.reserve(m_jobs.size());
+    for (const auto& job : std::as_const(m_jobs)) {
+        ProgressSample sample;
+        sample.kind = ProgressSample::Kind::IsoVerify;
+        sample.jobId = job->id;
+        sample.itemsDone = quint64(qMax(0, job->filesStarted.load()));
+        sample.itemsTotal = quint64(qMax(0, job->filesTotal.load()));
+        if (sample.itemsTotal > 0) {
+            sample.fraction = double(sample.itemsDone) / double(sample.itemsTotal);
+        }
+        {
+            QMutexLocker fileLock(&job->fileMutex);
+            sample.detail = job->currentFile;
+        }
+        samples.append(sample);
+    }
+    return samples;
+}
+
+std::shared_ptr<IsoVerifierWorker::Job> IsoVerifierWorker::beginJob(const QString& target,
+                                                                     const QString& deviceNode,
+                                                                     QString* existingId)
+{
+    QMutexLocker lock(&m_jobsMutex);
+    for (const auto& job : std::as_const(m_jobs)) {
+        if (job->target == target && !job->cancelled.load()) {
+            *existingId = job->id;
+            return nullptr;
+        }
+    }
+
+    auto job = std::make_shared<Job>();
+    job->id = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    job->target = target;
+    job->deviceNode = deviceNode;
+    job->options = IsoVerifier::verifyOptions();
+    job->options.cancelled = &job->cancelled;
+    // Called per image from the verifier threads; ProgressHub reads the counters per frame.
+    Job* raw = job.get();
+    job->options.progress = [raw](int current, int total, const QString& file) {
+        {
+            QMutexLocker fileLock(&raw->fileMutex);
+            raw->currentFile = file;
+        }
+        raw->filesTotal = total;
+        raw->filesStarted = current;
     };
-    IsoVerifier::setVerifyOptions(opt);
+    m_jobs.insert(job->id, job);
+    m_latestJobId = job->id;
+    lock.unlock();
+    ProgressHub::instance().wake();
+    return job;
+}
 
-    emit verificationStarted(mountPoint, deviceNode);
+AsyncTask<> IsoVerifierWorker::runJob(std::shared_ptr<Job> job, IoScheduler::Task task,
+                                      std::function<QList<IsoVerifyResult>()> verify)
+{
+    job->future = IoScheduler::instance().run(task, [job, verify = std::move(verify)]() -> QList<IsoVerifyResult> {
+        if (job->cancelled.load()) {
+            return {};
+        }
+        const IsoVerifier::OptionsScope scope(job->options);
+        return verify();
+    });
+    const std::optional<QList<IsoVerifyResult>> results = co_await resumeOn(this, job->future);
+    {
+        QMutexLocker lock(&m_jobsMutex);
+        m_jobs.remove(job->id);
+    }
+    if (results && !job->cancelled.load()) {
+        emit verificationFinished(job->target, job->deviceNode, *results, job->id);
+    }
+}
 
-    m_activeJob = QtConcurrent::run([this, mountPoint, deviceNode]() {
-        if (m_cancelled) return;
-        emit verificationProgress(QStringLiteral("Scanning %1 for images…").arg(mountPoint));
+void IsoVerifierWorker::cancel()
+{
+    QMutexLocker lock(&m_jobsMutex);
+    for (const auto& job : std::as_const(m_jobs)) {
+        job->cancelled = true;
+    }
+}
 
-        const QList<IsoVerifyResult> results = IsoVerifier::verifyMountPoint(mountPoint, deviceNode);
-        if (m_cancelled) return;
+bool IsoVerifierWorker::cancelJob(const QString& jobId)
+{
+    QMutexLocker lock(&m_jobsMutex);
+    const auto it = m_jobs.constFind(jobId);
+    if (it == m_jobs.cend()) {
+        return false;
+    }
+    (*it)->cancelled = true;
+    return true;
+}
+
+bool IsoVerifierWorker::hasActiveJobs() const
+{
+    QMutexLocker lock(&m_jobsMutex);
+    return !m_jobs.isEmpty();
+}
+
+bool IsoVerifierWorker::ownsJob(const QString& jobId) const
+{
+    QMutexLocker lock(&m_jobsMutex);
+    return m_jobs.contains(jobId);
+}
 
-        QMetaObject::invokeMethod(this, [this, mountPoint, deviceNode, results]() {
-            emit verificationFinished(mountPoint, deviceNode, results);
+QString IsoVerifierWorker::jobId() const
+{
+    QMutexLocker lock(&m_jobsMutex);
+    return m_latestJobId;
+}
+
+QString IsoVerifierWorker::verifyMountPoint(const QString& mountPoint, const QString& deviceNode)
+{
+    QString existing;
+    const std::shared_ptr<Job> job = beginJob(mountPoint, deviceNode, &existing);
+    if (!job) {
+        return existing;
+    }
+    emit verificationStarted(mountPoint, deviceNode, job->id);
+
+    // Mount-triggered: ahead of background hashes, after what the user asked for directly,
+    // and at background I/O priority so it does not slow the user's own copy to the stick.
+    const IoScheduler::Task task{IoScheduler::wholeDiskNode(deviceNode), IoScheduler::Priority::Normal,
+                                 IoScheduler::Pool::Io, true};
+    runJob(job, task, [this, job]() {
+        QMetaObject::invokeMethod(this, [this, job]() {
+            emit verificationProgress(QStringLiteral("Scanning %1 for images…").arg(job->target), job->id);
         }, Qt::QueuedConnection);
+        return IsoVerifier::verifyMountPoint(job->target, job->deviceNode);
     });
+    return job->id;
 }
 
-void IsoVerifierWorker::verifyDirectory(const QString& directory, const QString& deviceNode)
+QString IsoVerifierWorker::verifyDirectory(const QString& directory, const QString& deviceNode)
 {
-    m_cancelled = false;
-    m_cancelledFlag = false;
-    IsoVerifyOptions opt = IsoVerifier::verifyOptions();
-    opt.cancelled = &m_cancelledFlag;
-    opt.progress = [this](int current, int total, const QString& file) {
-        emit verificationFileProgress(current, total, file);
-        emit verificationProgress(
-            QStringLiteral("Verifying %1 (%2/%3)…").arg(file).arg(current).arg(total));
-    };
-    IsoVerifier::setVerifyOptions(opt);
+    QString existing;
+    const std::shared_ptr<Job> job = beginJob(directory, deviceNode, &existing);
+    if (!job) {
+        return existing;
+    }
+    emit verificationStarted(directory, deviceNode, job->id);
+    emit verificationProgress(QStringLiteral("Verifying images in %1…").arg(directory), job->id);
 
-    emit verificationStarted(directory, deviceNode);
-    emit verificationProgress(QStringLiteral("Verifying images in %1…").arg(directory));
-
-    m_activeJob = QtConcurrent::run([this, directory, deviceNode]() {
-        QList<IsoVerifyResult> results = IsoVerifier::verifyDirectory(directory);
+    const IoScheduler::Task task{IoScheduler::wholeDiskNode(deviceNode), IoScheduler::Priority::Interactive,
+                                 IoScheduler::Pool::Io};
+    runJob(job, task, [job]() {
+        QList<IsoVerifyResult> results = IsoVerifier::verifyDirectory(job->target);
         for (IsoVerifyResult& r : results) {
-            r.deviceNode = deviceNode;
+            r.deviceNode = job->deviceNode;
         }
-        if (m_cancelled) return;
-        QMetaObject::invokeMethod(this, [this, directory, deviceNode, results]() {
-            emit verificationFinished(directory, deviceNode, results);
-        }, Qt::QueuedConnection);
+        return results;
     });
+    return job->id;
 }
 
 } // namespace FlashSpartan
@@ -1,53 +1,412 @@
 #include "IsoVerifyCache.h"
+#include "PerfMetrics.h"
 
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLockFile>
 #include <QMutex>
+#include <QReadWriteLock>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStorageInfo>
 #include <QString>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <vector>
+
+#ifndef Q_OS_WIN
+#include <sys/stat.h>
+#endif
+
 namespace FlashSpartan {
 
 namespace {
 
-struct CacheKey {
-    QString path;
-    qint64 size = 0;
-    qint64 mtimeMs = 0;
+// A hit refreshes the entry's LRU time on disk at most this often.
+constexpr qint64 kTouchPersistMs = 3600 * 1000;
+constexpr int kLockStaleMs = 30000;
+constexpr int kShardLimit = IsoVerifyCache::kMaxEntries / IsoVerifyCache::kShardCount;
 
-    bool operator==(const CacheKey& o) const
+/** One entry per file location; a changed file replaces its old entry. */
+struct PathKey {
+    QString volumeId;
+    QString relativePath;
+
+    bool operator==(const PathKey& o) const
     {
-        return path == o.path && size == o.size && mtimeMs == o.mtimeMs;
+        return volumeId == o.volumeId && relativePath == o.relativePath;
     }
 };
 
-size_t qHash(const CacheKey& k, size_t seed = 0)
+size_t qHash(const PathKey& k, size_t seed = 0)
+{
+    return qHashMulti(seed, k.volumeId, k.relativePath);
+}
+
+PathKey pathKey(const IsoVerifyCache::FileKey& key)
+{
+    return PathKey{key.volumeId, key.relativePath};
+}
+
+struct Entry {
+    IsoVerifyCache::FileKey key;
+    QString sha256;
+    qint64 lastUsedMs = 0;
+};
+
+using EntryMap = QHash<PathKey, Entry>;
+
+struct Shard {
+    QReadWriteLock lock;
+    EntryMap entries;
+};
+
+struct State {
+    QMutex loadMutex;  // guards path and loading
+    std::atomic<bool> loaded{false};
+    QString path;
+    std::array<Shard, IsoVerifyCache::kShardCount> shards;
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> stores{0};
+    std::atomic<uint64_t> evictions{0};
+};
+
+State& state()
+{
+    static State s;
+    return s;
+}
+
+Shard& shardFor(const PathKey& key)
+{
+    // Seed 0 rather than QHash's own seed, so shard and bucket choice use different bits.
+    return state().shards[qHash(key, 0) % IsoVerifyCache::kShardCount];
+}
+
+QString defaultPath()
 {
-    return qHash(k.path, seed) ^ static_cast<size_t>(k.size) ^ static_cast<size_t>(k.mtimeMs);
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+           + QStringLiteral("/iso-verify/hash-cache.json");
 }
 
-QMutex g_mutex;
-QHash<CacheKey, QString> g_cache;
+QString volumeIdFor(const QStorageInfo& storage)
+{
+    const QString device = QString::fromLocal8Bit(storage.device());
+#ifdef Q_OS_LINUX
+    // The filesystem UUID survives re-plugging and a different mount point.
+    const QString canonicalDevice = QFileInfo(device).canonicalFilePath();
+    if (!canonicalDevice.isEmpty()) {
+        const QFileInfoList links = QDir(QStringLiteral("/dev/disk/by-uuid"))
+                                        .entryInfoList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot);
+        for (const QFileInfo& link : links) {
+            if (link.canonicalFilePath() == canonicalDevice) {
+                return QStringLiteral("uuid:") + link.fileName();
+            }
+        }
+    }
+#endif
+    // Windows reports the volume GUID path here, which is stable per volume.
+    if (!device.isEmpty()) {
+        return QStringLiteral("dev:") + device;
+    }
+    return QStringLiteral("root:") + storage.rootPath();
+}
+
+QJsonObject entryToJson(const Entry& e)
+{
+    QJsonObject o;
+    o.insert(QStringLiteral("volume"), e.key.volumeId);
+    o.insert(QStringLiteral("path"), e.key.relativePath);
+    o.insert(QStringLiteral("size"), static_cast<double>(e.key.size));
+    o.insert(QStringLiteral("mtime_ms"), static_cast<double>(e.key.mtimeMs));
+    o.insert(QStringLiteral("inode"), QString::number(e.key.inode));
+    o.insert(QStringLiteral("ctime_ms"), static_cast<double>(e.key.ctimeMs));
+    o.insert(QStringLiteral("sha256"), e.sha256);
+    o.insert(QStringLiteral("last_used_ms"), static_cast<double>(e.lastUsedMs));
+    return o;
+}
+
+EntryMap readFile(const QString& path)
+{
+    EntryMap entries;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return entries;
+    }
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    for (const QJsonValue& v : root.value(QStringLiteral("entries")).toArray()) {
+        const QJsonObject o = v.toObject();
+        Entry e;
+        e.key.volumeId = o.value(QStringLiteral("volume")).toString();
+        e.key.relativePath = o.value(QStringLiteral("path")).toString();
+        e.key.size = static_cast<qint64>(o.value(QStringLiteral("size")).toDouble(-1));
+        e.key.mtimeMs = static_cast<qint64>(o.value(QStringLiteral("mtime_ms")).toDouble());
+        e.key.inode = o.value(QStringLiteral("inode")).toString().toULongLong();
+        e.key.ctimeMs = static_cast<qint64>(o.value(QStringLiteral("ctime_ms")).toDouble());
+        e.sha256 = o.value(QStringLiteral("sha256")).toString();
+        e.lastUsedMs = static_cast<qint64>(o.value(QStringLiteral("last_used_ms")).toDouble());
+        if (e.key.isValid() && e.sha256.size() == 64) {
+            entries.insert(pathKey(e.key), e);
+        }
+    }
+    return entries;
+}
+
+bool writeFile(const QString& path, const EntryMap& entries)
+{
+    QJsonArray list;
+    for (const Entry& e : entries) {
+        list.append(entryToJson(e));
+    }
+    QJsonObject root;
+    root.insert(QStringLiteral("version"), 1);
+    root.insert(QStringLiteral("entries"), list);
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+/** Drops the least recently used entries beyond @p limit; returns how many. */
+qsizetype evictToLimit(EntryMap& entries, qsizetype limit)
+{
+    if (entries.size() <= limit) {
+        return 0;
+    }
+    std::vector<std::pair<qint64, PathKey>> byAge;
+    byAge.reserve(static_cast<size_t>(entries.size()));
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+        byAge.emplace_back(it.value().lastUsedMs, it.key());
+    }
+    const size_t excess = static_cast<size_t>(entries.size() - limit);
+    std::nth_element(byAge.begin(), byAge.begin() + static_cast<std::ptrdiff_t>(excess - 1), byAge.end(),
+                     [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (size_t i = 0; i < excess; ++i) {
+        entries.remove(byAge[i].second);
+    }
+    return static_cast<qsizetype>(excess);
+}
+
+/** Replaces every shard's contents with @p entries. */
+void distribute(const EntryMap& entries)
+{
+    std::array<EntryMap, IsoVerifyCache::kShardCount> parts;
+    for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+        parts[qHash(it.key(), 0) % IsoVerifyCache::kShardCount].insert(it.key(), it.value());
+    }
+    State& s = state();
+    for (int i = 0; i < IsoVerifyCache::kShardCount; ++i) {
+        QWriteLocker lock(&s.shards[i].lock);
+        s.shards[i].entries = std::move(parts[i]);
+    }
+}
+
+void ensureLoaded()
+{
+    State& s = state();
+    if (s.loaded.load(std::memory_order_acquire)) {
+        return;
+    }
+    QMutexLocker lock(&s.loadMutex);
+    if (s.loaded.load(std::memory_order_relaxed)) {
+        return;
+    }
+    if (s.path.isEmpty()) {
+        s.path = defaultPath();
+    }
+    distribute(readFile(s.path));
+    s.loaded.store(true, std::memory_order_release);
+}
+
+QString currentPath()
+{
+    State& s = state();
+    QMutexLocker lock(&s.loadMutex);
+    return s.path.isEmpty() ? defaultPath() : s.path;
+}
+
+/**
+ * Writes @p changed into the cache file. Other processes (the CLI, a second window) may have
+ * added entries since we read it, so under the file lock the disk copy is re-read and merged,
+ * newest use winning, before the LRU bound is applied; the shards then take the merged set.
+ */
+void persist(const Entry& changed)
+{
+    const QString path = currentPath();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QLockFile fileLock(path + QStringLiteral(".lock"));
+    fileLock.setStaleLockTime(kLockStaleMs);
+    if (!fileLock.tryLock(kLockStaleMs)) {
+        return;  // the in-memory entry still serves this session
+    }
+
+    EntryMap merged = readFile(path);
+    const PathKey id = pathKey(changed.key);
+    auto it = merged.find(id);
+    if (it == merged.end() || !(it->key == changed.key) || it->lastUsedMs <= changed.lastUsedMs) {
+        merged.insert(id, changed);
+    }
+    state().evictions += static_cast<uint64_t>(evictToLimit(merged, IsoVerifyCache::kMaxEntries));
+    if (!writeFile(path, merged)) {
+        return;
+    }
+    QFile::setPermissions(path, QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+    if (currentPath() == path) {
+        distribute(merged);
+    }
+}
 
 } // namespace
 
-QString IsoVerifyCache::lookup(const QString& filePath, qint64 size, qint64 mtimeMs)
+IsoVerifyCache::FileKey IsoVerifyCache::keyFor(const QString& filePath)
 {
-    const CacheKey key{filePath, size, mtimeMs};
-    QMutexLocker lock(&g_mutex);
-    return g_cache.value(key);
+    FileKey key;
+    const QFileInfo info(filePath);
+    const QString canonical = info.canonicalFilePath();
+    if (canonical.isEmpty() || !info.isFile()) {
+        return key;
+    }
+    const QStorageInfo storage(canonical);
+    if (!storage.isValid()) {
+        return key;
+    }
+    key.relativePath = QDir(storage.rootPath()).relativeFilePath(canonical);
+#ifndef Q_OS_WIN
+    struct stat sb {};
+    if (::stat(QFile::encodeName(canonical).constData(), &sb) != 0) {
+        return key;
+    }
+    key.size = static_cast<qint64>(sb.st_size);
+    key.inode = static_cast<quint64>(sb.st_ino);
+#if defined(Q_OS_MACOS)
+    key.mtimeMs = static_cast<qint64>(sb.st_mtimespec.tv_sec) * 1000 + sb.st_mtimespec.tv_nsec / 1000000;
+    key.ctimeMs = static_cast<qint64>(sb.st_ctimespec.tv_sec) * 1000 + sb.st_ctimespec.tv_nsec / 1000000;
+#else
+    key.mtimeMs = static_cast<qint64>(sb.st_mtim.tv_sec) * 1000 + sb.st_mtim.tv_nsec / 1000000;
+    key.ctimeMs = static_cast<qint64>(sb.st_ctim.tv_sec) * 1000 + sb.st_ctim.tv_nsec / 1000000;
+#endif
+#else
+    key.size = info.size();
+    key.mtimeMs = info.lastModified().toMSecsSinceEpoch();
+    key.ctimeMs = info.metadataChangeTime().toMSecsSinceEpoch();
+#endif
+    key.volumeId = volumeIdFor(storage);
+    return key;
+}
+
+QString IsoVerifyCache::lookup(const FileKey& key)
+{
+    if (!key.isValid()) {
+        return {};
+    }
+    ensureLoaded();
+    State& s = state();
+    const PathKey id = pathKey(key);
+    Shard& shard = shardFor(id);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    Entry touched;
+    {
+        QReadLocker lock(&shard.lock);
+        const auto it = shard.entries.constFind(id);
+        if (it == shard.entries.cend() || !(it->key == key)) {
+            ++s.misses;
+            PerfMetrics::cacheLookup(PerfMetrics::Cache::IsoHash, false).add();
+            return {};
+        }
+        ++s.hits;
+        PerfMetrics::cacheLookup(PerfMetrics::Cache::IsoHash, true).add();
+        if (now - it->lastUsedMs < kTouchPersistMs) {
+            return it->sha256;
+        }
+        touched = *it;
+    }
+    touched.lastUsedMs = now;
+    {
+        QWriteLocker lock(&shard.lock);
+        shard.entries.insert(id, touched);
+    }
+    persist(touched);
+    return touched.sha256;
 }
 
-void IsoVerifyCache::store(const QString& filePath, qint64 size, qint64 mtimeMs,
-                           const QString& sha256Hex)
+void IsoVerifyCache::store(const FileKey& key, const QString& sha256Hex)
 {
-    const CacheKey key{filePath, size, mtimeMs};
-    QMutexLocker lock(&g_mutex);
-    g_cache.insert(key, sha256Hex.trimmed().toLower());
+    if (!key.isValid()) {
+        return;
+    }
+    ensureLoaded();
+    State& s = state();
+    Entry e;
+    e.key = key;
+    e.sha256 = sha256Hex.trimmed().toLower();
+    e.lastUsedMs = QDateTime::currentMSecsSinceEpoch();
+    {
+        const PathKey id = pathKey(key);
+        Shard& shard = shardFor(id);
+        QWriteLocker lock(&shard.lock);
+        shard.entries.insert(id, e);
+        s.evictions += static_cast<uint64_t>(evictToLimit(shard.entries, kShardLimit));
+    }
+    ++s.stores;
+    persist(e);
+}
+
+IsoVerifyCache::Stats IsoVerifyCache::stats()
+{
+    State& s = state();
+    Stats out;
+    out.hits = s.hits.load();
+    out.misses = s.misses.load();
+    out.stores = s.stores.load();
+    out.evictions = s.evictions.load();
+    for (Shard& shard : s.shards) {
+        QReadLocker lock(&shard.lock);
+        out.entries += static_cast<int>(shard.entries.size());
+    }
+    return out;
 }
 
 void IsoVerifyCache::clear()
 {
-    QMutexLocker lock(&g_mutex);
-    g_cache.clear();
+    ensureLoaded();
+    distribute({});
+    State& s = state();
+    s.hits = 0;
+    s.misses = 0;
+    s.stores = 0;
+    s.evictions = 0;
+    const QString path = currentPath();
+    QLockFile fileLock(path + QStringLiteral(".lock"));
+    fileLock.setStaleLockTime(kLockStaleMs);
+    if (fileLock.tryLock(kLockStaleMs)) {
+        QFile::remove(path);
+    }
+}
+
+void IsoVerifyCache::setStoragePath(const QString& path)
+{
+    State& s = state();
+    QMutexLocker lock(&s.loadMutex);
+    s.path = path.isEmpty() ? defaultPath() : path;
+    distribute({});
+    s.loaded.store(false, std::memory_order_release);
+}
+
+QString IsoVerifyCache::storagePath()
+{
+    return currentPath();
 }
 
 } // namespace FlashSpartan
@@ -18,7 +18,7 @@ IsoVerifyReport::SummaryCounts IsoVerifyReport::countSummary(const QList<IsoVeri
     counts.total = results.size();
     for (const IsoVerifyResult& r : results) {
         const bool computedOnly =
-            r.hashChecked && r.expectedSha256.isEmpty() && !r.isoPath.isEmpty();
+            r.hashChecked && !r.hasExpectedHash() && !r.isoPath.isEmpty();
         if (computedOnly) {
             ++counts.needsSidecar;
         } else if (r.passed()) {
@@ -64,13 +64,15 @@ QString IsoVerifyReport::buildCsv(const QList<IsoVerifyResult>& results)
                                 r.passed() ? QStringLiteral("yes") : QStringLiteral("no"),
                                 r.hashMatches ? QStringLiteral("yes") : QStringLiteral("no"),
                                 r.pgpValid ? QStringLiteral("yes") : QStringLiteral("no"),
-                                csvEscape(r.errorMessage));
+                                csvEscape(r.prescreenMismatch.isEmpty()
+                                              ? r.errorMessage
+                                              : QStringLiteral("pre-screen: ") + r.prescreenMismatch));
         out += line;
     }
     return out;
 }
 
-static QJsonObject isoResultToJson(const IsoVerifyResult& r)
+QJsonObject IsoVerifyReport::resultToJson(const IsoVerifyResult& r)
 {
     const QString file = r.isoPath.isEmpty() ? r.layoutNote : QFileInfo(r.isoPath).fileName();
     QJsonObject obj;
@@ -85,11 +87,19 @@ static QJsonObject isoResultToJson(const IsoVerifyResult& r)
     obj.insert(QStringLiteral("hash_matches"), r.hashMatches);
     obj.insert(QStringLiteral("expected_sha256"), r.expectedSha256);
     obj.insert(QStringLiteral("computed_sha256"), r.computedSha256);
+    if (!r.expectedDigest.isEmpty()) {
+        obj.insert(QStringLiteral("digest_algorithm"), r.expectedDigestAlgorithm);
+        obj.insert(QStringLiteral("expected_digest"), r.expectedDigest);
+        obj.insert(QStringLiteral("computed_digest"), r.computedDigest);
+    }
     obj.insert(QStringLiteral("pgp_checked"), r.pgpChecked);
     obj.insert(QStringLiteral("pgp_valid"), r.pgpValid);
     obj.insert(QStringLiteral("fingerprint_trusted"), r.fingerprintTrusted);
     obj.insert(QStringLiteral("signing_key_fingerprint"), r.signingKeyFingerprint);
     obj.insert(QStringLiteral("source"), static_cast<int>(r.source));
+    if (!r.prescreenMismatch.isEmpty()) {
+        obj.insert(QStringLiteral("prescreen_mismatch"), r.prescreenMismatch);
+    }
     if (!r.errorMessage.isEmpty()) {
         obj.insert(QStringLiteral("error"), r.errorMessage);
     }
@@ -112,7 +122,7 @@ QString IsoVerifyReport::buildJson(const QList<IsoVerifyResult>& results)
 
     QJsonArray items;
     for (const IsoVerifyResult& r : results) {
-        items.append(isoResultToJson(r));
+        items.append(resultToJson(r));
     }
     root.insert(QStringLiteral("results"), items);
 
@@ -130,8 +140,10 @@ QString IsoVerifyReport::buildHtml(const QList<IsoVerifyResult>& results)
                 .arg(summaryLine(results).toHtmlEscaped());
     for (const IsoVerifyResult& r : results) {
         const QString file = r.isoPath.isEmpty() ? r.layoutNote : QFileInfo(r.isoPath).fileName();
-        const QString hashCol = r.hashChecked
-                                    ? (r.expectedSha256.isEmpty()
+        const QString hashCol = !r.prescreenMismatch.isEmpty()
+                                    ? QStringLiteral("MISMATCH (pre-screen)")
+                                    : r.hashChecked
+                                    ? (!r.hasExpectedHash()
                                            ? QStringLiteral("computed only")
                                            : (r.hashMatches ? QStringLiteral("OK")
                                                             : QStringLiteral("MISMATCH")))
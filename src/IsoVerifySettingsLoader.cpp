@@ -1,31 +1,35 @@
 #include "IsoVerifySettingsLoader.h"
 
 #include "IsoVerifier.h"
+#include "SettingsSnapshot.h"
 
 #include <QSettings>
 
 namespace FlashSpartan {
 
-IsoVerifyOptions IsoVerifySettingsLoader::load(const QString& configFilePath)
+namespace {
+
+/** The iso/ keys of @p settings, with the GUI's defaults. */
+AppSettings readIsoKeys(const QSettings& settings)
 {
-    IsoVerifyOptions opt;
-    opt.useHashCache = true;
+    AppSettings s;
+    s.isoVerifyParallel = settings.value(QStringLiteral("iso/verifyParallel"), 2).toInt();
+    s.isoVerifyDecompressed = settings.value(QStringLiteral("iso/verifyDecompressed"), false).toBool();
+    s.isoPreferOfflineSidecars = settings.value(QStringLiteral("iso/preferOfflineSidecars"), false).toBool();
+    s.isoReadCache = settings.value(QStringLiteral("iso/readCache")).toString();
+    s.isoVerifyDdImages = settings.value(QStringLiteral("iso/verifyDdImages"), false).toBool();
+    s.isoMirrorUrl = settings.value(QStringLiteral("iso/mirrorUrl")).toString();
+    return s;
+}
 
+} // namespace
+
+IsoVerifyOptions IsoVerifySettingsLoader::load(const QString& configFilePath)
+{
     if (!configFilePath.isEmpty()) {
-        QSettings settings(configFilePath, QSettings::IniFormat);
-        opt.maxParallel = qMax(1, settings.value(QStringLiteral("iso/verifyParallel"), 2).toInt());
-        opt.verifyDecompressed = settings.value(QStringLiteral("iso/verifyDecompressed"), false).toBool();
-        opt.preferOfflineSidecars =
-            settings.value(QStringLiteral("iso/preferOfflineSidecars"), false).toBool();
-        return opt;
+        return fromSettings(readIsoKeys(QSettings(configFilePath, QSettings::IniFormat)));
     }
-
-    QSettings settings(QStringLiteral("flashspartan"), QStringLiteral("FlashSpartan"));
-    opt.maxParallel = qMax(1, settings.value(QStringLiteral("iso/verifyParallel"), 2).toInt());
-    opt.verifyDecompressed = settings.value(QStringLiteral("iso/verifyDecompressed"), false).toBool();
-    opt.preferOfflineSidecars =
-        settings.value(QStringLiteral("iso/preferOfflineSidecars"), false).toBool();
-    return opt;
+    return fromSettings(readIsoKeys(QSettings(QStringLiteral("flashspartan"), QStringLiteral("FlashSpartan"))));
 }
 
 void IsoVerifySettingsLoader::applyToVerifier(const QString& configFilePath)
@@ -33,4 +37,25 @@ void IsoVerifySettingsLoader::applyToVerifier(const QString& configFilePath)
     IsoVerifier::setVerifyOptions(load(configFilePath));
 }
 
+IsoVerifyOptions IsoVerifySettingsLoader::fromSettings(const AppSettings& settings)
+{
+    IsoVerifyOptions opt;
+    opt.useHashCache = true;
+    opt.maxParallel = qMax(1, settings.isoVerifyParallel);
+    opt.verifyDecompressed = settings.isoVerifyDecompressed;
+    opt.preferOfflineSidecars = settings.isoPreferOfflineSidecars;
+    opt.readCache = isoReadCacheFromString(settings.isoReadCache);
+    opt.verifyDdImages = settings.isoVerifyDdImages;
+    opt.mirrorUrl = settings.isoMirrorUrl;
+    return opt;
+}
+
+void IsoVerifySettingsLoader::followSnapshot()
+{
+    IsoVerifier::setVerifyOptions(fromSettings(*SettingsSnapshot::current()));
+    SettingsSnapshot::addListener([](const SettingsSnapshot::Ptr& settings) {
+        IsoVerifier::setVerifyOptions(fromSettings(*settings));
+    });
+}
+
 } // namespace FlashSpartan
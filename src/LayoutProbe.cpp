@@ -0,0 +1,198 @@
+#include "LayoutProbe.h"
+#include "HexEncoding.h"
+#include "RawDeviceHash.h"
+
+#include <QCryptographicHash>
+#include <QtEndian>
+
+#include <cstdlib>
+#include <memory>
+
+#ifdef Q_OS_WIN
+#include <malloc.h>
+#else
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace FlashSpartan::LayoutProbe {
+
+namespace {
+
+/** ext2/3/4 superblock offset, and the fields read from it. */
+constexpr int kExtSuperblock = 1024;
+constexpr int kExtWtime = 0x30;
+constexpr int kExtMntCount = 0x34;
+constexpr int kExtMagicAt = 0x38;
+constexpr int kExtState = 0x3A;
+constexpr int kExtUuid = 0x68;
+constexpr int kExtKbytesWritten = 0x178;
+constexpr quint16 kExtMagic = 0xEF53;
+constexpr quint16 kExtValidFs = 0x1;
+constexpr quint16 kExtErrorFs = 0x2;
+
+template <typename T>
+T readLe(const QByteArray& data, int offset)
+{
+    return qFromLittleEndian<T>(reinterpret_cast<const uchar*>(data.constData()) + offset);
+}
+
+QString serialHex(const QByteArray& data, int offset, int length)
+{
+    return HexEncoding::toString(data.mid(offset, length));
+}
+
+struct AlignedFree {
+    void operator()(char* p) const
+    {
+#ifdef Q_OS_WIN
+        _aligned_free(p);
+#else
+        free(p);
+#endif
+    }
+};
+using AlignedBuffer = std::unique_ptr<char, AlignedFree>;
+
+AlignedBuffer allocAligned(size_t bytes)
+{
+#ifdef Q_OS_WIN
+    return AlignedBuffer(static_cast<char*>(_aligned_malloc(bytes, kSectorBytes)));
+#else
+    void* p = nullptr;
+    return AlignedBuffer(posix_memalign(&p, kSectorBytes, bytes) == 0 ? static_cast<char*>(p) : nullptr);
+#endif
+}
+
+QString tableDigest(const char* data)
+{
+    return HexEncoding::toString(
+        QCryptographicHash::hash(QByteArrayView(data, kTableBytes), QCryptographicHash::Sha256));
+}
+
+} // namespace
+
+VolumeHead parseVolumeHead(const QByteArray& head)
+{
+    VolumeHead parsed;
+    if (head.size() >= 512 && head.mid(3, 8) == "EXFAT   ") {
+        parsed.fsType = QStringLiteral("exfat");
+        parsed.volumeSerial = serialHex(head, 100, 4);
+        parsed.volumeDirty = (readLe<quint16>(head, 106) & 0x2) != 0;
+        return parsed;
+    }
+    if (head.size() >= kExtSuperblock + kExtKbytesWritten + 8
+        && readLe<quint16>(head, kExtSuperblock + kExtMagicAt) == kExtMagic) {
+        const quint16 state = readLe<quint16>(head, kExtSuperblock + kExtState);
+        parsed.fsType = QStringLiteral("ext");
+        parsed.volumeSerial = serialHex(head, kExtSuperblock + kExtUuid, 16);
+        parsed.volumeDirty = (state & kExtValidFs) == 0 || (state & kExtErrorFs) != 0;
+        parsed.mountCount = readLe<quint16>(head, kExtSuperblock + kExtMntCount);
+        parsed.lastWriteTime = readLe<quint32>(head, kExtSuperblock + kExtWtime);
+        parsed.writeCounter = readLe<quint64>(head, kExtSuperblock + kExtKbytesWritten);
+        return parsed;
+    }
+    const bool bootSignature = head.size() >= 512 && readLe<quint16>(head, 510) == 0xAA55;
+    const quint16 bytesPerSector = head.size() >= 512 ? readLe<quint16>(head, 11) : 0;
+    if (!bootSignature || bytesPerSector < 512 || (bytesPerSector & (bytesPerSector - 1)) != 0) {
+        return parsed;
+    }
+    // FAT32 leaves the 16-bit FAT size zero and moves the extended BPB from 0x24 to 0x40.
+    const int ext = readLe<quint16>(head, 22) == 0 ? 0x40 : 0x24;
+    parsed.fsType = QStringLiteral("fat");
+    parsed.volumeDirty = (static_cast<uchar>(head.at(ext + 1)) & 0x1) != 0;
+    if (static_cast<uchar>(head.at(ext + 2)) == 0x29) {
+        parsed.volumeSerial = serialHex(head, ext + 3, 4);
+    }
+    return parsed;
+}
+
+LayoutFingerprint capture(const ReadAt& volume, uint64_t volumeBytes, const ReadAt& disk, VolumeHead* head)
+{
+    AlignedBuffer buffer = allocAligned(kHeadBytes);
+    if (!buffer || volumeBytes < kHeadBytes) {
+        return {};
+    }
+    LayoutFingerprint fingerprint;
+    if (disk) {
+        if (!disk(0, buffer.get(), kTableBytes)) {
+            return {};
+        }
+        fingerprint.partitionTableSha256 = tableDigest(buffer.get());
+    }
+    if (!volume(0, buffer.get(), kHeadBytes)) {
+        return {};
+    }
+    if (!disk) {
+        fingerprint.partitionTableSha256 = tableDigest(buffer.get());
+    }
+    const VolumeHead parsed = parseVolumeHead(QByteArray(buffer.get(), kHeadBytes));
+    fingerprint.fsType = parsed.fsType;
+    fingerprint.volumeSerial = parsed.volumeSerial;
+    fingerprint.volumeBytes = volumeBytes;
+    fingerprint.takenAt = QDateTime::currentDateTimeUtc();
+    if (head) {
+        *head = parsed;
+    }
+    return fingerprint;
+}
+
+#ifndef Q_OS_WIN
+ReadAt descriptorReader(int fd)
+{
+    return [fd](uint64_t offset, char* buffer, size_t length) {
+        size_t filled = 0;
+        while (filled < length) {
+            const ssize_t n = pread(fd, buffer + filled, length - filled, static_cast<off_t>(offset + filled));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            filled += static_cast<size_t>(n);
+        }
+        return true;
+    };
+}
+#endif
+
+LayoutFingerprint captureDevice(const QString& volumeNode, const QString& diskNode)
+{
+#ifdef Q_OS_WIN
+    Q_UNUSED(volumeNode);
+    Q_UNUSED(diskNode);
+    return {};
+#else
+    const int volumeFd = RawDeviceHash::openDevice(volumeNode);
+    if (volumeFd < 0) {
+        return {};
+    }
+    LayoutFingerprint fingerprint;
+    const uint64_t volumeBytes = RawDeviceHash::deviceSize(volumeFd, volumeNode);
+    if (diskNode.isEmpty() || diskNode == volumeNode) {
+        fingerprint = capture(descriptorReader(volumeFd), volumeBytes, {});
+    } else if (const int diskFd = RawDeviceHash::openDevice(diskNode); diskFd >= 0) {
+        fingerprint = capture(descriptorReader(volumeFd), volumeBytes, descriptorReader(diskFd));
+        RawDeviceHash::closeDevice(diskFd);
+    }
+    RawDeviceHash::closeDevice(volumeFd);
+    return fingerprint;
+#endif
+}
+
+QString mismatch(const LayoutFingerprint& baseline, const LayoutFingerprint& now)
+{
+    if (now.partitionTableSha256 != baseline.partitionTableSha256) {
+        return QStringLiteral("partition table changed");
+    }
+    if (now.volumeBytes != baseline.volumeBytes) {
+        return QStringLiteral("volume size changed");
+    }
+    if (now.fsType != baseline.fsType || now.volumeSerial != baseline.volumeSerial) {
+        return QStringLiteral("file system was replaced");
+    }
+    return {};
+}
+
+} // namespace FlashSpartan::LayoutProbe
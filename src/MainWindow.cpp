@@ -7,6 +7,8 @@
 #include "StyledMessageBox.h"
 #include "AutostartManager.h"
 #include "AuditLog.h"
+#include "AuditLogIndex.h"
+#include "AuditWriter.h"
 #include "IsoCatalogManifest.h"
 #include "SettingsProfiles.h"
 #include "WelcomeWizard.h"
@@ -19,9 +21,27 @@
 #include "VerifyHistory.h"
 #include "HashCheckpoint.h"
 #include "HashOptionsDialog.h"
+#include "IsoVerifySettingsLoader.h"
+#include "RawDeviceHash.h"
+#include "RawDeviceHashAdvanced.h"
+#include "ReadHealth.h"
+#include "SettingsSnapshot.h"
+#include "CapacityProbe.h"
+#include "DeviceGeometry.h"
+#include "EjectSealProbe.h"
+#include "LayoutProbe.h"
+#include "ManifestPrefetch.h"
+#include "IoBufferPool.h"
+#include "IoPriority.h"
+#include "IoScheduler.h"
+#include "MemoryBudget.h"
+#include "MonitorService.h"
 #include "AlertsPage.h"
 #include "ReportsPage.h"
 #include "AboutPage.h"
+#include "AnimationClock.h"
+#include "PerfMetrics.h"
+#include "StartupTrace.h"
 #include "policy/PolicyPaths.h"
 
 #include <algorithm>
@@ -52,6 +72,8 @@
 #include <QCursor>
 #include <QUuid>
 
+#include <utility>
+
 #ifdef Q_OS_WIN
 #include <dbt.h>
 #include <qt_windows.h>
@@ -75,6 +97,15 @@ FlashSpartan::UiEventEntry makeUiEvent(const QString& event, const QString& devi
     return e;
 }
 
+/** What the device search matches against, one field per line so a query cannot span two. */
+QString deviceSearchText(const FlashSpartan::DeviceInfo& device)
+{
+    return QStringList{device.displayName(), device.vendor, device.model, device.serial,
+                       device.mountPoint, device.deviceNode}
+        .join(QLatin1Char('\n'))
+        .toLower();
+}
+
 bool isAlertResult(const QString& result)
 {
     const QString r = result.toLower();
@@ -96,63 +127,75 @@ bool isAlertUiEvent(const FlashSpartan::UiEventEntry& e)
            || ev.contains(QStringLiteral("reject")) || ev.contains(QStringLiteral("security"));
 }
 
-QList<FlashSpartan::AuditLogRow> readAuditLogTail(const QString& path, int maxLines, bool policyFormat)
+/** Rows of audit @p lines (newest first); lines that are not JSON objects are skipped. */
+QList<FlashSpartan::AuditLogRow> parseAuditLines(const QList<QByteArray>& lines, const QString& path,
+                                                 bool policyFormat)
 {
     QList<FlashSpartan::AuditLogRow> rows;
-    QFile f(path);
-    if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        return rows;
-    }
-
-    QStringList lines;
-    while (!f.atEnd()) {
-        const QString line = QString::fromUtf8(f.readLine()).trimmed();
-        if (line.isEmpty()) {
-            continue;
-        }
-        lines.append(line);
-        while (lines.size() > maxLines) {
-            lines.removeFirst();
+    for (const QByteArray& line : lines) {
+        if (auto row = FlashSpartan::ReportExport::auditRow(line, path, policyFormat)) {
+            rows.append(std::move(*row));
         }
     }
+    return rows;
+}
 
-    for (int i = lines.size() - 1; i >= 0; --i) {
-        const QJsonDocument doc = QJsonDocument::fromJson(lines.at(i).toUtf8());
-        if (!doc.isObject()) {
-            continue;
-        }
-        const QJsonObject o = doc.object();
-        FlashSpartan::AuditLogRow row;
-        row.time = QDateTime::fromString(o.value(QStringLiteral("ts")).toString(), Qt::ISODate);
-        if (!row.time.isValid()) {
-            row.time = QDateTime::currentDateTime();
-        }
-        row.source = path;
+QList<FlashSpartan::AuditLogRow> readAuditLogTail(const QString& path, int maxLines, bool policyFormat)
+{
+    FlashSpartan::AuditLogIndex::Query query;
+    query.limit = maxLines;
+    return parseAuditLines(FlashSpartan::AuditLogIndex::query(path, query), path, policyFormat);
+}
 
-        if (policyFormat) {
-            row.category = o.value(QStringLiteral("actor")).toString();
-            row.event = o.value(QStringLiteral("action")).toString();
-            row.detail = o.value(QStringLiteral("target")).toString();
-            row.source = o.value(QStringLiteral("detail")).toString();
-        } else {
-            row.event = o.value(QStringLiteral("event")).toString();
-            if (row.event == QLatin1String("iso_verify")) {
-                row.category = QStringLiteral("ISO");
-                row.detail = o.value(QStringLiteral("path")).toString();
-                if (row.detail.isEmpty()) {
-                    row.detail = o.value(QStringLiteral("device")).toString();
-                }
-            } else if (row.event == QLatin1String("badusb_anomaly")) {
-                row.category = QStringLiteral("BadUSB");
-                row.detail = o.value(QStringLiteral("summary")).toString();
-            } else {
-                row.category = QStringLiteral("System");
-                row.detail = o.value(QStringLiteral("detail")).toString();
-            }
-        }
-        rows.append(row);
+/** Up to @p count rows older than all of @p held (oldest first), found through the log's time index. */
+QList<FlashSpartan::AuditLogRow> readAuditLogBefore(const QString& path, const QList<FlashSpartan::AuditLogRow>& held,
+                                                    int count, bool policyFormat)
+{
+    if (held.isEmpty()) {
+        return readAuditLogTail(path, count, policyFormat);
+    }
+    // Rows sharing the oldest held time are the newest lines up to that time; skip them.
+    const QDateTime oldest = held.first().time;
+    int sameTime = 0;
+    while (sameTime < held.size() && held.at(sameTime).time == oldest) {
+        ++sameTime;
+    }
+    FlashSpartan::AuditLogIndex::Query query;
+    query.to = oldest;
+    query.limit = count + sameTime;
+    QList<FlashSpartan::AuditLogRow> rows =
+        parseAuditLines(FlashSpartan::AuditLogIndex::query(path, query), path, policyFormat);
+    int skip = 0;
+    while (skip < sameTime && skip < rows.size() && rows.at(skip).time == oldest) {
+        ++skip;
+    }
+    return rows.mid(skip);
+}
+
+/** A failed or mismatching verification as it is listed on the Alerts page. */
+FlashSpartan::UiEventEntry verifyAlertEntry(const FlashSpartan::VerifyHistoryEntry& vh)
+{
+    FlashSpartan::UiEventEntry e;
+    e.id = QStringLiteral("vh-%1").arg(vh.timestamp.toSecsSinceEpoch());
+    e.time = vh.timestamp;
+    e.event = vh.summary.isEmpty() ? QStringLiteral("Verification") : vh.summary;
+    e.device = vh.deviceLabel.isEmpty() ? vh.deviceNode : vh.deviceLabel;
+    switch (vh.kind) {
+        case FlashSpartan::VerifyHistoryKind::IsoScan:
+            e.type = QStringLiteral("ISO");
+            break;
+        case FlashSpartan::VerifyHistoryKind::Manifest:
+            e.type = QStringLiteral("Watch");
+            break;
+        case FlashSpartan::VerifyHistoryKind::Hash:
+        default:
+            e.type = QStringLiteral("Verify");
+            break;
     }
-    return rows;
+    e.result = vh.status;
+    e.detail = vh.detail.isEmpty() ? vh.summary : vh.detail;
+    e.deviceNode = vh.deviceNode;
+    return e;
 }
 
 } // namespace
@@ -170,21 +213,30 @@ MainWindow::MainWindow(QWidget* parent)
     FSStyle.initialize();
     
     // Setup UI first
-    setupUi();
-    setupShortcuts();
+    {
+        StartupTrace::Phase phase(QStringLiteral("MainWindow: setupUi"));
+        setupUi();
+        setupShortcuts();
+    }
     
     // Initialize backend components
-    initializeBackend();
+    {
+        StartupTrace::Phase phase(QStringLiteral("MainWindow: initializeBackend"));
+        initializeBackend();
+    }
     
     // Connect all signals
     connectSignals();
     
     // Load settings
-    loadSettings();
-    VerifyHistory::instance().load();
-    DeviceTimelineLog::instance().load();
-    BlockedDriveStore::instance().refreshFromGateway();
-    HashCheckpointStore::instance().load();
+    {
+        StartupTrace::Phase phase(QStringLiteral("MainWindow: loadSettings"));
+        IsoVerifySettingsLoader::followSnapshot();
+        loadSettings();
+        startHistoryLoad();
+        BlockedDriveStore::instance().refreshFromGateway();
+        HashCheckpointStore::instance().load();
+    }
 
     m_liveSettingsTimer = new QTimer(this);
     m_liveSettingsTimer->setSingleShot(true);
@@ -197,7 +249,6 @@ MainWindow::MainWindow(QWidget* parent)
     
     // Apply styling
     applyStyle();
-    refreshVerifyHistoryPanel();
     
     // Setup status update timer
     m_statusUpdateTimer = new QTimer(this);
@@ -205,6 +256,21 @@ MainWindow::MainWindow(QWidget* parent)
     connect(m_statusUpdateTimer, &QTimer::timeout, this, &MainWindow::updateStatusBar);
     m_statusUpdateTimer->start();
 
+    m_powerTimer = new QTimer(this);
+    m_powerTimer->setInterval(POWER_POLL_INTERVAL_MS);
+    connect(m_powerTimer, &QTimer::timeout, this, &MainWindow::updateBackgroundIoHold);
+
+    MemoryBudget& budget = MemoryBudget::instance();
+    budget.add({QStringLiteral("Idle read buffers"), MemoryBudget::Keep::Low,
+                []() { return qint64(IoBufferPool::stats().idleBytes); }, [](qint64) { IoBufferPool::trim(); }});
+    connect(&budget, &MemoryBudget::reclaimed, this, [this](qint64 bytes, const QString& reason) {
+        logMessage(QStringLiteral("Released %1 MiB of cached memory (%2)")
+                       .arg(double(bytes) / (1024.0 * 1024.0), 0, 'f', 1)
+                       .arg(reason == QLatin1String("limit") ? QStringLiteral("over the memory budget")
+                                                             : QStringLiteral("memory pressure")));
+    });
+    budget.start();
+
     m_usbMonitorRefreshTimer = new QTimer(this);
     m_usbMonitorRefreshTimer->setSingleShot(true);
     m_usbMonitorRefreshTimer->setInterval(400);
@@ -231,7 +297,17 @@ MainWindow::MainWindow(QWidget* parent)
     });
 #endif
     
-    // Start device monitoring
+    // Until the window attaches to the headless service as a client, the service's automatic
+    // hashes and ISO scans stand in for ours rather than running beside them.
+    m_headlessServiceRunning = MonitorService::isListening();
+    if (m_headlessServiceRunning) {
+        logMessage(QStringLiteral("The headless FlashSpartan service is monitoring drives; automatic "
+                                  "verification and ISO scans are left to it"),
+                   LogLevel::Warning);
+    }
+
+    // Start device monitoring; the initial udev scan runs on the monitor's thread
+    m_initialScanBeginUs = StartupTrace::nowUs();
     m_deviceMonitor->startMonitoring();
     configureBadUsbMonitoring();
 
@@ -251,13 +327,20 @@ MainWindow::MainWindow(QWidget* parent)
     
     logMessage("FlashSpartan started", LogLevel::Info);
 
-    IsoCatalogManifest::ensureLoaded();
+    {
+        // Usually loaded already by main()'s background load; otherwise waits for it
+        StartupTrace::Phase phase(QStringLiteral("MainWindow: wait for ISO catalog"));
+        IsoCatalogManifest::ensureLoaded();
+    }
     QTimer::singleShot(0, this, [this]() { warnIfCatalogIntegrityFailed(); });
 }
 
 MainWindow::~MainWindow()
 {
     m_isClosing = true;
+    if (m_historyLoad) {
+        m_historyLoad->waitForFinished();
+    }
 
 #ifdef Q_OS_WIN
     if (m_volumeDeviceNotify) {
@@ -348,6 +431,122 @@ void MainWindow::setupUi()
             });
     m_pageStack->addWidget(m_usbMonitorPage);
 
+    // Every page but the USB monitor, ISO verifier and BadUSB monitor is built on its first
+    // visit (ensurePage); until then its slot in the stack holds an empty placeholder.
+    for (int i = appPageStackIndex(AppPage::DeviceHistory); i <= appPageStackIndex(AppPage::Reports); ++i) {
+        m_pageStack->addWidget(new QWidget);
+    }
+
+    m_isoWidget = new IsoVerifierWidget;
+    connect(m_isoWidget, &IsoVerifierWidget::logMessageRequested,
+            this, &MainWindow::onIsoLogMessage);
+    connect(m_isoWidget, &IsoVerifierWidget::verificationReportReady, this,
+            &MainWindow::handleIsoVerificationReport);
+    connect(m_isoWidget, &IsoVerifierWidget::settingsProfileSelected, this,
+            [this](const QString& profileId) {
+                SettingsProfiles::applyProfile(profileId, m_settings);
+                applySettings(m_settings);
+                saveSettings();
+                logMessage(QStringLiteral("Profile: %1")
+                               .arg(SettingsProfiles::profileDisplayName(profileId)),
+                           LogLevel::Info);
+            });
+    m_isoVerifierPage = new ContentPageShell(QStringLiteral("ISO Verifier"), m_isoWidget);
+    m_pageStack->addWidget(m_isoVerifierPage);
+
+    m_badUsbWidget = new BadUsbWidget;
+    connect(m_badUsbWidget, &BadUsbWidget::logMessageRequested,
+            this, &MainWindow::onIsoLogMessage);
+    connect(m_badUsbWidget, &BadUsbWidget::trustRequested,
+            this, &MainWindow::onBadUsbTrustRequested);
+    connect(m_badUsbWidget, &BadUsbWidget::captureRequested,
+            this, &MainWindow::onBadUsbCaptureRequested);
+    connect(m_badUsbWidget, &BadUsbWidget::refreshRequested, this, [this]() {
+        if (m_hidMonitor) {
+            m_hidMonitor->rescan();
+        }
+    });
+    connect(m_badUsbWidget, &BadUsbWidget::downloadUsbPcapRequested, this, [this]() {
+        if (m_usbPcapInstaller) {
+            m_usbPcapInstaller->startDownloadAndInstall();
+        }
+    });
+    connect(m_badUsbWidget, &BadUsbWidget::openUsbPcapPageRequested, this, []() {
+        UsbPcapInstaller::openInstallPage();
+    });
+
+    connect(m_badUsbWidget, &BadUsbWidget::openCaptureFolderRequested, this, [this]() {
+        if (m_usbmonCapture) {
+            QDesktopServices::openUrl(QUrl::fromLocalFile(m_usbmonCapture->outputDirectory()));
+        }
+    });
+    m_badUsbMonitorPage = new ContentPageShell(QStringLiteral("BadUSB Monitor"), m_badUsbWidget);
+    m_pageStack->addWidget(m_badUsbMonitorPage);
+
+    for (int i = appPageStackIndex(AppPage::Settings); i <= appPageStackIndex(AppPage::About); ++i) {
+        m_pageStack->addWidget(new QWidget);
+    }
+
+    shell->addWidget(m_pageStack, 1);
+    m_mainLayout->addLayout(shell, 1);
+
+    m_hiddenDeviceHost = new QWidget;
+    m_hiddenDeviceHost->setVisible(false);
+    m_hiddenDeviceLayout = new QVBoxLayout(m_hiddenDeviceHost);
+    m_hiddenDeviceLayout->setContentsMargins(0, 0, 0, 0);
+
+    m_watchListsPanel = new WatchListsPanel;
+    connect(m_watchListsPanel, &WatchListsPanel::editDeviceRequested, this,
+            &MainWindow::onWatchListRequested);
+
+    createStatusBar();
+    m_navSidebar->setCurrentPage(AppPage::UsbMonitor);
+    m_pageStack->setCurrentWidget(m_usbMonitorPage);
+    refreshUsbMonitorHome();
+}
+
+void MainWindow::ensurePage(AppPage page)
+{
+    if (!m_pageStack) {
+        return;
+    }
+    QWidget* created = nullptr;
+    switch (page) {
+        case AppPage::DeviceHistory:
+            created = m_deviceHistoryPage ? nullptr : createDeviceHistoryPage();
+            break;
+        case AppPage::AllowBlockList:
+            created = m_allowBlockListPage ? nullptr : createAllowBlockListPage();
+            break;
+        case AppPage::Alerts:
+            created = m_alertsPage ? nullptr : createAlertsPage();
+            break;
+        case AppPage::Reports:
+            created = m_reportsPage ? nullptr : createReportsPage();
+            break;
+        case AppPage::Settings:
+            created = m_settingsPage ? nullptr : createSettingsPage();
+            break;
+        case AppPage::About:
+            created = m_aboutPage ? nullptr : createAboutPage();
+            break;
+        case AppPage::UsbMonitor:
+        case AppPage::IsoVerifier:
+        case AppPage::BadUsbMonitor:
+            break;
+    }
+    if (!created) {
+        return;
+    }
+    const int index = appPageStackIndex(page);
+    QWidget* placeholder = m_pageStack->widget(index);
+    m_pageStack->insertWidget(index, created);
+    m_pageStack->removeWidget(placeholder);
+    delete placeholder;
+}
+
+DeviceHistoryPage* MainWindow::createDeviceHistoryPage()
+{
     m_deviceHistoryPage = new DeviceHistoryPage;
     connect(m_deviceHistoryPage, &DeviceHistoryPage::deviceSelectionChanged, this,
             [this](const QString& node) {
@@ -359,8 +558,11 @@ void MainWindow::setupUi()
                 EventDetailDialog dlg(entry, this);
                 dlg.exec();
             });
-    m_pageStack->addWidget(m_deviceHistoryPage);
+    return m_deviceHistoryPage;
+}
 
+AllowBlockListPage* MainWindow::createAllowBlockListPage()
+{
     m_allowBlockListPage = new AllowBlockListPage;
     connect(m_allowBlockListPage, &AllowBlockListPage::filterChanged, this,
             &MainWindow::refreshAllowBlockListPage);
@@ -403,19 +605,38 @@ void MainWindow::setupUi()
             });
     connect(m_allowBlockListPage, &AllowBlockListPage::historyRequested, this,
             &MainWindow::showDeviceHistory);
-    m_pageStack->addWidget(m_allowBlockListPage);
+    return m_allowBlockListPage;
+}
 
+AlertsPage* MainWindow::createAlertsPage()
+{
     m_alertsPage = new AlertsPage;
     connect(m_alertsPage, &AlertsPage::eventDetailsRequested, this,
             [this](const UiEventEntry& entry) {
                 EventDetailDialog dlg(entry, this);
                 dlg.exec();
             });
-    connect(m_alertsPage, &AlertsPage::filterChanged, this, &MainWindow::refreshAlertsPage);
-    m_pageStack->addWidget(m_alertsPage);
+    return m_alertsPage;
+}
 
+ReportsPage* MainWindow::createReportsPage()
+{
     m_reportsPage = new ReportsPage;
     connect(m_reportsPage, &ReportsPage::refreshRequested, this, &MainWindow::refreshReportsPage);
+    m_reportsPage->setOlderSources(
+        [this](const QList<VerifyHistoryEntry>& held, int count) {
+            if (!m_historyLoaded) {
+                return QList<VerifyHistoryEntry>();
+            }
+            return VerifyHistory::instance().recentEntries(int(held.size()) + count).mid(held.size());
+        },
+        [](const QList<AuditLogRow>& held, int count) {
+            AuditWriter::flushAll();
+            return readAuditLogBefore(AuditLog::logPath(), held, count, false);
+        },
+        [](const QList<AuditLogRow>& held, int count) {
+            return readAuditLogBefore(Policy::PolicyPaths::auditLogPath(), held, count, true);
+        });
     connect(m_reportsPage, &ReportsPage::openAuditLogRequested, this, [this]() {
         const QString path = AuditLog::logPath();
         if (QFileInfo::exists(path)) {
@@ -434,63 +655,55 @@ void MainWindow::setupUi()
                        LogLevel::Info);
         }
     });
-    m_pageStack->addWidget(m_reportsPage);
-
-    m_aboutPage = new AboutPage;
-    connect(m_aboutPage, &AboutPage::openRepositoryRequested, this, []() {
-        QDesktopServices::openUrl(QUrl(QStringLiteral("https://github.com/RNAX0N/flashsentry")));
-    });
-    connect(m_aboutPage, &AboutPage::openUserGuideRequested, this, []() {
-        QDesktopServices::openUrl(
-            QUrl(QStringLiteral("https://github.com/RNAX0N/flashsentry/blob/main/docs/USER_GUIDE.md")));
-    });
-
-    m_isoWidget = new IsoVerifierWidget;
-    connect(m_isoWidget, &IsoVerifierWidget::logMessageRequested,
-            this, &MainWindow::onIsoLogMessage);
-    connect(m_isoWidget, &IsoVerifierWidget::verificationReportReady, this,
-            &MainWindow::handleIsoVerificationReport);
-    connect(m_isoWidget, &IsoVerifierWidget::settingsProfileSelected, this,
-            [this](const QString& profileId) {
-                SettingsProfiles::applyProfile(profileId, m_settings);
-                applySettings(m_settings);
-                saveSettings();
-                logMessage(QStringLiteral("Profile: %1")
-                               .arg(SettingsProfiles::profileDisplayName(profileId)),
-                           LogLevel::Info);
-            });
-    m_isoVerifierPage = new ContentPageShell(QStringLiteral("ISO Verifier"), m_isoWidget);
-    m_pageStack->addWidget(m_isoVerifierPage);
-
-    m_badUsbWidget = new BadUsbWidget;
-    connect(m_badUsbWidget, &BadUsbWidget::logMessageRequested,
-            this, &MainWindow::onIsoLogMessage);
-    connect(m_badUsbWidget, &BadUsbWidget::trustRequested,
-            this, &MainWindow::onBadUsbTrustRequested);
-    connect(m_badUsbWidget, &BadUsbWidget::captureRequested,
-            this, &MainWindow::onBadUsbCaptureRequested);
-    connect(m_badUsbWidget, &BadUsbWidget::refreshRequested, this, [this]() {
-        if (m_hidMonitor) {
-            m_hidMonitor->rescan();
+    connect(m_reportsPage, &ReportsPage::exportRequested, this, [this](ReportExport::Request request) {
+        if (m_reportExportCancel) {
+            return;
         }
-    });
-    connect(m_badUsbWidget, &BadUsbWidget::downloadUsbPcapRequested, this, [this]() {
-        if (m_usbPcapInstaller) {
-            m_usbPcapInstaller->startDownloadAndInstall();
+        if (request.source == ReportExport::Source::Verification) {
+            VerifyHistory::instance().save();
+            request.sourcePath = VerifyHistory::instance().filePath();
+        } else if (request.source == ReportExport::Source::Audit) {
+            AuditWriter::flushAll();
         }
+        auto cancelled = std::make_shared<std::atomic<bool>>(false);
+        m_reportExportCancel = cancelled;
+        ReportsPage* page = m_reportsPage;
+        auto* watcher = new QFutureWatcher<ReportExport::Result>(this);
+        connect(watcher, &QFutureWatcher<ReportExport::Result>::finished, this,
+                [this, watcher, page, outputPath = request.outputPath]() {
+                    watcher->deleteLater();
+                    m_reportExportCancel.reset();
+                    const ReportExport::Result result = watcher->result();
+                    page->setExportFinished(result, outputPath);
+                    if (result.success) {
+                        logMessage(QStringLiteral("Exported %1 report rows to %2").arg(result.rows).arg(outputPath),
+                                   LogLevel::Info);
+                    } else if (!result.cancelled) {
+                        logMessage(QStringLiteral("Report export failed: %1").arg(result.errorMessage),
+                                   LogLevel::Warning);
+                    }
+                });
+        // Reads the whole history: behind anything a device is waiting for.
+        const IoScheduler::Task task{QString(), IoScheduler::Priority::Background};
+        watcher->setFuture(IoScheduler::instance().run(task, [request, cancelled, page]() {
+            return ReportExport::run(
+                request,
+                [page](qint64 rows, double done) {
+                    QMetaObject::invokeMethod(page, [page, rows, done]() { page->setExportProgress(rows, done); });
+                },
+                cancelled.get());
+        }));
     });
-    connect(m_badUsbWidget, &BadUsbWidget::openUsbPcapPageRequested, this, []() {
-        UsbPcapInstaller::openInstallPage();
-    });
-
-    connect(m_badUsbWidget, &BadUsbWidget::openCaptureFolderRequested, this, [this]() {
-        if (m_usbmonCapture) {
-            QDesktopServices::openUrl(QUrl::fromLocalFile(m_usbmonCapture->outputDirectory()));
+    connect(m_reportsPage, &ReportsPage::exportCancelRequested, this, [this]() {
+        if (m_reportExportCancel) {
+            m_reportExportCancel->store(true);
         }
     });
-    m_badUsbMonitorPage = new ContentPageShell(QStringLiteral("BadUSB Monitor"), m_badUsbWidget);
-    m_pageStack->addWidget(m_badUsbMonitorPage);
+    return m_reportsPage;
+}
 
+SettingsPage* MainWindow::createSettingsPage()
+{
     m_settingsPage = new SettingsPage;
     connect(m_settingsPage, &SettingsPage::settingsApplyRequested, this,
             &MainWindow::applySettingsPage);
@@ -540,25 +753,20 @@ void MainWindow::setupUi()
         logMessage(QStringLiteral("Database cleared"), LogLevel::Warning);
         updateSidebarStats();
     });
-    m_pageStack->addWidget(m_settingsPage);
-    m_pageStack->addWidget(m_aboutPage);
-
-    shell->addWidget(m_pageStack, 1);
-    m_mainLayout->addLayout(shell, 1);
-
-    m_hiddenDeviceHost = new QWidget;
-    m_hiddenDeviceHost->setVisible(false);
-    m_hiddenDeviceLayout = new QVBoxLayout(m_hiddenDeviceHost);
-    m_hiddenDeviceLayout->setContentsMargins(0, 0, 0, 0);
-
-    m_watchListsPanel = new WatchListsPanel;
-    connect(m_watchListsPanel, &WatchListsPanel::editDeviceRequested, this,
-            &MainWindow::onWatchListRequested);
+    return m_settingsPage;
+}
 
-    createStatusBar();
-    m_navSidebar->setCurrentPage(AppPage::UsbMonitor);
-    m_pageStack->setCurrentWidget(m_usbMonitorPage);
-    refreshUsbMonitorHome();
+AboutPage* MainWindow::createAboutPage()
+{
+    m_aboutPage = new AboutPage;
+    connect(m_aboutPage, &AboutPage::openRepositoryRequested, this, []() {
+        QDesktopServices::openUrl(QUrl(QStringLiteral("https://github.com/RNAX0N/flashsentry")));
+    });
+    connect(m_aboutPage, &AboutPage::openUserGuideRequested, this, []() {
+        QDesktopServices::openUrl(
+            QUrl(QStringLiteral("https://github.com/RNAX0N/flashsentry/blob/main/docs/USER_GUIDE.md")));
+    });
+    return m_aboutPage;
 }
 
 QWidget* MainWindow::createHeader()
@@ -623,6 +831,10 @@ QWidget* MainWindow::createHeader()
     UiIcons::addLeadingSearchAction(m_searchEdit);
     connect(m_searchEdit, &QLineEdit::textChanged, this, &MainWindow::onSearchTextChanged);
     layout->addWidget(m_searchEdit);
+    m_searchTimer = new QTimer(this);
+    m_searchTimer->setSingleShot(true);
+    m_searchTimer->setInterval(150);
+    connect(m_searchTimer, &QTimer::timeout, this, qOverload<>(&MainWindow::applyDeviceSearch));
     
     layout->addSpacing(16);
     
@@ -793,11 +1005,27 @@ QWidget* MainWindow::createSidebar()
         FSStyle.colorCss(StyleManager::ColorRole::TextSecondary)));
     layout->addWidget(logLabel);
     
-    m_logList = new QListWidget;
-    m_logList->setFrameShape(QFrame::NoFrame);
-    m_logList->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
-    m_logList->setStyleSheet(FSStyle.listWidgetStyleSheet());
-    layout->addWidget(m_logList, 1);
+    m_logFilterEdit = new QLineEdit;
+    m_logFilterEdit->setPlaceholderText(QStringLiteral("Filter log..."));
+    m_logFilterEdit->setClearButtonEnabled(true);
+    UiIcons::addLeadingSearchAction(m_logFilterEdit);
+    layout->addWidget(m_logFilterEdit);
+
+    m_logModel = new ActivityLogModel(m_settings.activityLogLines, this);
+    m_logModel->setForeground(FSStyle.color(StyleManager::ColorRole::TextSecondary));
+    m_logView = new QListView;
+    m_logView->setModel(m_logModel);
+    m_logView->setUniformItemSizes(true);
+    m_logView->setFrameShape(QFrame::NoFrame);
+    m_logView->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
+    m_logView->setStyleSheet(FSStyle.listWidgetStyleSheet());
+    layout->addWidget(m_logView, 1);
+    connect(m_logFilterEdit, &QLineEdit::textChanged, m_logModel, &ActivityLogModel::setFilterText);
+    connect(m_logModel, &ActivityLogModel::flushed, this, [this](int appended) {
+        if (appended > 0) {
+            m_logView->scrollToBottom();
+        }
+    });
     
     return m_sidebarWidget;
 }
@@ -857,6 +1085,7 @@ void MainWindow::initializeBackend()
     m_hashWorker = std::make_unique<HashWorker>(this);
 
     m_manifestWorker = std::make_unique<ManifestWorker>(this);
+    m_watchJournal = std::make_unique<WatchJournal>(this);
     
     // Create database manager (trust data via policy gateway / policyd)
     m_database = std::make_unique<DatabaseManager>(this);
@@ -912,11 +1141,11 @@ void MainWindow::connectSignals()
 {
     // Device monitor signals
     connect(m_deviceMonitor.get(), &DeviceMonitor::deviceConnected,
-            this, &MainWindow::onDeviceConnected);
+            this, [this](const DeviceHandle& device) { onDeviceConnected(*device); });
     connect(m_deviceMonitor.get(), &DeviceMonitor::deviceDisconnected,
             this, &MainWindow::onDeviceDisconnected);
     connect(m_deviceMonitor.get(), &DeviceMonitor::deviceChanged,
-            this, &MainWindow::onDeviceChanged);
+            this, [this](const DeviceHandle& device) { onDeviceChanged(*device); });
     connect(m_deviceMonitor.get(), &DeviceMonitor::initialScanComplete,
             this, &MainWindow::onInitialScanComplete);
     connect(m_deviceMonitor.get(), &DeviceMonitor::monitorError,
@@ -983,11 +1212,21 @@ void MainWindow::connectSignals()
         if (m_badUsbWidget) m_badUsbWidget->setCaptureStatus(path);
     });
     connect(m_usbmonCapture.get(), &UsbmonCapture::captureFinished, this,
-            [this](const QString& path, int exitCode) {
+            [this](const QString& path, int exitCode, const BadUsbAnomalyResult& anomaly) {
                 logMessage(QStringLiteral("BadUSB usbmon capture finished (%1): %2").arg(exitCode).arg(path),
                            LogLevel::Info);
-                if (m_badUsbWidget) m_badUsbWidget->setCaptureStatus(QStringLiteral("finished"));
+                if (m_badUsbWidget) {
+                    const int running = m_usbmonCapture->runningCaptures();
+                    m_badUsbWidget->setCaptureStatus(running > 0
+                        ? QStringLiteral("finished, %1 still running").arg(running)
+                        : QStringLiteral("finished"));
+                }
+                if (QFileInfo::exists(path)) {
+                    archiveBadUsbCapture(path, anomaly);
+                }
             });
+    connect(m_usbmonCapture.get(), &UsbmonCapture::keystrokeRateExceeded,
+            this, &MainWindow::onKeystrokeRateExceeded);
     connect(m_usbmonCapture.get(), &UsbmonCapture::captureFailed, this, [this](const QString& error) {
         logMessage(QStringLiteral("BadUSB usbmon capture failed: %1").arg(error), LogLevel::Warning);
         if (m_badUsbWidget) m_badUsbWidget->setCaptureStatus(error);
@@ -996,14 +1235,31 @@ void MainWindow::connectSignals()
     // Hash worker signals
     connect(m_hashWorker.get(), &HashWorker::hashStarted,
             this, &MainWindow::onHashStarted);
-    connect(m_hashWorker.get(), &HashWorker::hashProgress,
-            this, &MainWindow::onHashProgress);
     connect(m_hashWorker.get(), &HashWorker::hashCompleted,
             this, &MainWindow::onHashCompleted);
     connect(m_hashWorker.get(), &HashWorker::hashFailed,
             this, &MainWindow::onHashFailed);
     connect(m_hashWorker.get(), &HashWorker::hashCancelled,
             this, &MainWindow::onHashCancelled);
+    connect(m_hashWorker.get(), &HashWorker::hashPaused, this, [this](const QString& jobId, bool paused) {
+        const QString deviceNode = m_hashJobDevices.value(jobId);
+        if (DeviceCard* card = getDeviceCard(deviceNode)) {
+            card->setHashPaused(paused);
+        }
+        logMessage(QStringLiteral("Hash %1 for %2").arg(paused ? QStringLiteral("paused") : QStringLiteral("resumed"),
+                                                         deviceNode));
+    });
+    connect(m_hashWorker.get(), &HashWorker::hashPreempted, this, [this](const QString& jobId) {
+        // Queued again under the same id; hashStarted() counts it once more when it resumes.
+        m_activeHashCount = qMax(0, m_activeHashCount - 1);
+        const QString deviceNode = m_hashJobDevices.value(jobId);
+        if (DeviceCard* card = getDeviceCard(deviceNode)) {
+            card->setHashPaused(false);
+            card->setHashSpeed(0.0);
+        }
+        logMessage(QStringLiteral("Full hash of %1 yielded to a quick check; it resumes from its checkpoint")
+                       .arg(deviceNode));
+    });
     
 
     connect(m_manifestWorker.get(), &ManifestWorker::manifestStarted,
@@ -1014,6 +1270,12 @@ void MainWindow::connectSignals()
             this, &MainWindow::onManifestBaselineBuilt);
     connect(m_manifestWorker.get(), &ManifestWorker::manifestFailed,
             this, &MainWindow::onManifestFailed);
+    connect(m_manifestWorker.get(), &ManifestWorker::manifestReportReady,
+            this, &MainWindow::onManifestReportReady);
+    connect(m_manifestWorker.get(), &ManifestWorker::manifestCancelled,
+            this, &MainWindow::onManifestCancelled);
+    connect(&ProgressHub::instance(), &ProgressHub::published,
+            this, &MainWindow::onProgressPublished);
 
     // Mount manager signals
     connect(m_mountManager.get(), &MountManager::mountCompleted,
@@ -1022,6 +1284,8 @@ void MainWindow::connectSignals()
             this, &MainWindow::onUnmountCompleted);
     connect(m_mountManager.get(), &MountManager::powerOffCompleted,
             this, &MainWindow::onPowerOffCompleted);
+    connect(m_mountManager.get(), &MountManager::bulkEjectCompleted,
+            this, &MainWindow::onBulkEjectCompleted);
     connect(m_mountManager.get(), &MountManager::mountStatusChanged, this,
             [this](const QString& deviceNode, bool mounted, const QString& mountPoint) {
                 if (auto info = m_deviceMonitor->getDevice(deviceNode)) {
@@ -1060,6 +1324,8 @@ void MainWindow::connectSignals()
     });
     connect(m_trayIcon.get(), &TrayIcon::deviceEjectRequested,
             this, &MainWindow::onEjectRequested);
+    connect(m_trayIcon.get(), &TrayIcon::ejectAllRequested,
+            this, &MainWindow::onEjectAllRequested);
 }
 
 void MainWindow::loadSettings()
@@ -1070,9 +1336,23 @@ void MainWindow::loadSettings()
     m_settings.showNotifications = m_qsettings->value("general/showNotifications", true).toBool();
     m_settings.autoHashOnConnect = m_qsettings->value("security/autoHashOnConnect", false).toBool();
     m_settings.autoHashOnEject = m_qsettings->value("security/autoHashOnEject", true).toBool();
+    m_settings.ejectSeal = m_qsettings->value("security/ejectSeal", true).toBool();
+    m_settings.speculativePrefetch = m_qsettings->value("hashing/speculativePrefetch", true).toBool();
     m_settings.appModule = appModuleFromString(m_qsettings->value("general/appModule", "usb_monitor").toString());
     m_settings.defaultVerificationProfile = verificationProfileFromString(
         m_qsettings->value("security/defaultVerificationProfile", "watch_manifest").toString());
+    m_settings.watchManifestVerifyPolicy.metadataFirst =
+        m_qsettings->value("security/watchMetadataFirst", false).toBool();
+    m_settings.watchManifestVerifyPolicy.samplePercent =
+        m_qsettings->value("security/watchSamplePercent", 5).toInt();
+    m_settings.hybridManifestVerifyPolicy.metadataFirst =
+        m_qsettings->value("security/hybridMetadataFirst", true).toBool();
+    m_settings.hybridManifestVerifyPolicy.samplePercent =
+        m_qsettings->value("security/hybridSamplePercent", 0).toInt();
+    m_settings.watchChangeJournal = m_qsettings->value("security/watchChangeJournal", false).toBool();
+    m_settings.watchFailFast = m_qsettings->value("security/watchFailFast", false).toBool();
+    m_settings.watchFailFastReport = m_qsettings->value("security/watchFailFastReport", true).toBool();
+    m_settings.watchChunkLargeFiles = m_qsettings->value("security/watchChunkLargeFiles", false).toBool();
     m_settings.isoScanDirectory = m_qsettings->value("iso/scanDirectory").toString();
     m_settings.isoAutoVerifyOnScan = m_qsettings->value("iso/autoVerify", true).toBool();
     m_settings.isoAutoVerifyOnUsbMount = m_qsettings->value("iso/autoVerifyOnUsbMount", true).toBool();
@@ -1080,7 +1360,10 @@ void MainWindow::loadSettings()
         m_qsettings->value("iso/blockMountOnFailure", false).toBool();
     m_settings.isoVerifyDecompressed = m_qsettings->value("iso/verifyDecompressed", false).toBool();
     m_settings.isoPreferOfflineSidecars = m_qsettings->value("iso/preferOfflineSidecars", false).toBool();
+    m_settings.isoReadCache = m_qsettings->value("iso/readCache", QStringLiteral("page-cache")).toString();
+    m_settings.isoVerifyDdImages = m_qsettings->value("iso/verifyDdImages", false).toBool();
     m_settings.isoVerifyParallel = m_qsettings->value("iso/verifyParallel", 2).toInt();
+    m_settings.isoMirrorUrl = m_qsettings->value("iso/mirrorUrl").toString();
     m_settings.showFirstRunWizard = m_qsettings->value("general/showFirstRunWizard", true).toBool();
     m_settings.badUsbEnabled = m_qsettings->value("badusb/enabled", true).toBool();
     m_settings.badUsbAlertNewKeyboard =
@@ -1091,6 +1374,8 @@ void MainWindow::loadSettings()
         m_qsettings->value("badusb/alertInterfaceDrift", true).toBool();
     m_settings.badUsbAlertRapidReconnect =
         m_qsettings->value("badusb/alertRapidReconnect", true).toBool();
+    m_settings.badUsbAlertKeystrokeRate =
+        m_qsettings->value("badusb/alertKeystrokeRate", true).toBool();
     m_settings.badUsbAutoBaselineTrusted =
         m_qsettings->value("badusb/autoBaselineTrusted", false).toBool();
     m_settings.badUsbConfirmAnomalies =
@@ -1102,8 +1387,22 @@ void MainWindow::loadSettings()
     m_settings.badUsbUsbmonCommand =
         m_qsettings->value("badusb/usbmonCommand",
                            QStringLiteral("tcpdump -i usbmon{bus} -w {out} -G 30 -W 1")).toString();
+    m_settings.badUsbUsbmonPreTriggerSeconds =
+        m_qsettings->value("badusb/usbmonPreTriggerSeconds", 10).toInt();
+    m_settings.badUsbUsbmonSuspectOnly =
+        m_qsettings->value("badusb/usbmonSuspectOnly", true).toBool();
+    m_settings.badUsbUsbmonSummarize =
+        m_qsettings->value("badusb/usbmonSummarize", true).toBool();
+    m_settings.badUsbCaptureQuotaMiB =
+        m_qsettings->value("badusb/captureQuotaMiB", 512).toInt();
+    m_settings.badUsbCaptureMaxAgeDays =
+        m_qsettings->value("badusb/captureMaxAgeDays", 30).toInt();
+    m_settings.badUsbCaptureCompress =
+        m_qsettings->value("badusb/captureCompress", true).toBool();
     m_settings.recentEventsLimit =
         m_qsettings->value("ui/recentEventsLimit", m_settings.recentEventsLimit).toInt();
+    m_settings.activityLogLines =
+        m_qsettings->value("ui/activityLogLines", m_settings.activityLogLines).toInt();
     m_settings.deviceHistoryRetentionDays =
         m_qsettings->value("ui/deviceHistoryRetentionDays", m_settings.deviceHistoryRetentionDays)
             .toInt();
@@ -1121,6 +1420,9 @@ void MainWindow::loadSettings()
     m_settings.defaultTrustLevel =
         m_qsettings->value("security/defaultTrustLevel", m_settings.defaultTrustLevel).toInt();
     m_maxUiEvents = qMax(20, m_settings.recentEventsLimit);
+    if (m_logModel) {
+        m_logModel->setCapacity(m_settings.activityLogLines);
+    }
     {
         const QString storedProfile =
             m_qsettings->value("general/settingsProfile", QStringLiteral("default")).toString();
@@ -1134,14 +1436,30 @@ void MainWindow::loadSettings()
     m_settings.blockModifiedDevices = m_qsettings->value("security/blockModified", false).toBool();
     m_settings.hashAlgorithm = m_qsettings->value("hashing/algorithm", "SHA256").toString();
     m_settings.hashBufferSizeKB = m_qsettings->value("hashing/bufferSizeKB", 1024).toInt();
+    m_settings.hashBufferAutoTune = m_qsettings->value("hashing/bufferAutoTune", false).toBool();
+    m_settings.hashCapacityProbe = m_qsettings->value("hashing/capacityProbe", false).toBool();
+    m_settings.hashSkipZeroRegions = m_qsettings->value("hashing/skipZeroRegions", false).toBool();
+    m_settings.hashHelperSession = m_qsettings->value("hashing/helperSession", false).toBool();
     m_settings.useMemoryMapping = m_qsettings->value("hashing/useMemoryMapping", true).toBool();
+    m_settings.hashIoEngine =
+        m_qsettings->value("hashing/ioEngine", QStringLiteral("default")).toString();
+    m_settings.hashIoQueueDepth = m_qsettings->value("hashing/ioQueueDepth", 4).toInt();
+    m_settings.hashHugePages = m_qsettings->value("hashing/hugePages", QStringLiteral("off")).toString();
     m_settings.maxConcurrentHashes = m_qsettings->value("hashing/maxConcurrent", 1).toInt();
+    m_settings.backgroundIoLimitMBps = m_qsettings->value("hashing/backgroundLimitMBps", 0).toInt();
+    m_settings.pauseBackgroundOnBattery = m_qsettings->value("hashing/pauseBackgroundOnBattery", true).toBool();
+    m_settings.memoryBudgetMiB = m_qsettings->value("hashing/memoryBudgetMiB", 0).toInt();
     m_settings.defaultHashScope = hashScopeFromString(
         m_qsettings->value("hashing/defaultScope", "partition").toString());
     m_settings.defaultHashScanMode = hashScanModeFromString(
         m_qsettings->value("hashing/defaultScanMode", "full").toString());
     m_settings.hashResumeCheckpoints = m_qsettings->value("hashing/resumeCheckpoints", true).toBool();
     m_settings.promptHashOptionsOnManual = m_qsettings->value("hashing/promptOnManual", true).toBool();
+    m_settings.hashPrescreenXxh3 = m_qsettings->value("hashing/prescreenXxh3", false).toBool();
+    m_settings.hashStopAtFirstChange = m_qsettings->value("hashing/stopAtFirstChange", false).toBool();
+    m_settings.hashQuickSamples = m_qsettings->value("hashing/quickSamples", 15).toInt();
+    m_settings.hashQuickSampleKB = m_qsettings->value("hashing/quickSampleKB", 1024).toInt();
+    m_settings.hashQuickSampleMetadata = m_qsettings->value("hashing/quickSampleMetadata", false).toBool();
     m_settings.animationsEnabled = m_qsettings->value("appearance/animations", true).toBool();
     m_settings.fontSizePt = m_qsettings->value("appearance/fontSizePt", 10).toInt();
     FSStyle.setBaseFontSize(m_settings.fontSizePt);
@@ -1157,9 +1475,10 @@ void MainWindow::loadSettings()
     // Apply settings
     m_trayIcon->setNotificationsEnabled(m_settings.showNotifications);
     m_hashWorker->setMaxConcurrent(m_settings.maxConcurrentHashes);
+    applyBackgroundIo();
     FSStyle.setAnimationsEnabled(m_settings.animationsEnabled);
     applyAppModule();
-    applyIsoVerifyOptions();
+    SettingsSnapshot::publish(m_settings);
     configureBadUsbMonitoring();
 
     // Restore window geometry
@@ -1184,6 +1503,8 @@ void MainWindow::saveSettings()
     m_qsettings->setValue("general/showNotifications", m_settings.showNotifications);
     m_qsettings->setValue("security/autoHashOnConnect", m_settings.autoHashOnConnect);
     m_qsettings->setValue("security/autoHashOnEject", m_settings.autoHashOnEject);
+    m_qsettings->setValue("security/ejectSeal", m_settings.ejectSeal);
+    m_qsettings->setValue("hashing/speculativePrefetch", m_settings.speculativePrefetch);
     m_qsettings->setValue("security/confirmNewDevice", m_settings.requireConfirmationForNew);
     m_qsettings->setValue("security/confirmModified", m_settings.requireConfirmationForModified);
     m_qsettings->setValue("security/blockModified", m_settings.blockModifiedDevices);
@@ -1192,23 +1513,49 @@ void MainWindow::saveSettings()
                           allowedCountModeToString(m_settings.allowedCountMode));
     m_qsettings->setValue("hashing/algorithm", m_settings.hashAlgorithm);
     m_qsettings->setValue("hashing/bufferSizeKB", m_settings.hashBufferSizeKB);
+    m_qsettings->setValue("hashing/bufferAutoTune", m_settings.hashBufferAutoTune);
+    m_qsettings->setValue("hashing/capacityProbe", m_settings.hashCapacityProbe);
+    m_qsettings->setValue("hashing/skipZeroRegions", m_settings.hashSkipZeroRegions);
+    m_qsettings->setValue("hashing/helperSession", m_settings.hashHelperSession);
     m_qsettings->setValue("hashing/useMemoryMapping", m_settings.useMemoryMapping);
+    m_qsettings->setValue("hashing/ioEngine", m_settings.hashIoEngine);
+    m_qsettings->setValue("hashing/ioQueueDepth", m_settings.hashIoQueueDepth);
+    m_qsettings->setValue("hashing/hugePages", m_settings.hashHugePages);
     m_qsettings->setValue("hashing/maxConcurrent", m_settings.maxConcurrentHashes);
+    m_qsettings->setValue("hashing/backgroundLimitMBps", m_settings.backgroundIoLimitMBps);
+    m_qsettings->setValue("hashing/pauseBackgroundOnBattery", m_settings.pauseBackgroundOnBattery);
+    m_qsettings->setValue("hashing/memoryBudgetMiB", m_settings.memoryBudgetMiB);
     m_qsettings->setValue("hashing/defaultScope", hashScopeToString(m_settings.defaultHashScope));
     m_qsettings->setValue("hashing/defaultScanMode", hashScanModeToString(m_settings.defaultHashScanMode));
     m_qsettings->setValue("hashing/resumeCheckpoints", m_settings.hashResumeCheckpoints);
     m_qsettings->setValue("hashing/promptOnManual", m_settings.promptHashOptionsOnManual);
+    m_qsettings->setValue("hashing/prescreenXxh3", m_settings.hashPrescreenXxh3);
+    m_qsettings->setValue("hashing/stopAtFirstChange", m_settings.hashStopAtFirstChange);
+    m_qsettings->setValue("hashing/quickSamples", m_settings.hashQuickSamples);
+    m_qsettings->setValue("hashing/quickSampleKB", m_settings.hashQuickSampleKB);
+    m_qsettings->setValue("hashing/quickSampleMetadata", m_settings.hashQuickSampleMetadata);
     m_qsettings->setValue("appearance/animations", m_settings.animationsEnabled);
     m_qsettings->setValue("appearance/fontSizePt", m_settings.fontSizePt);
     m_qsettings->setValue("general/appModule", appModuleToString(m_settings.appModule));
     m_qsettings->setValue("security/defaultVerificationProfile", verificationProfileToString(m_settings.defaultVerificationProfile));
+    m_qsettings->setValue("security/watchMetadataFirst", m_settings.watchManifestVerifyPolicy.metadataFirst);
+    m_qsettings->setValue("security/watchSamplePercent", m_settings.watchManifestVerifyPolicy.samplePercent);
+    m_qsettings->setValue("security/hybridMetadataFirst", m_settings.hybridManifestVerifyPolicy.metadataFirst);
+    m_qsettings->setValue("security/hybridSamplePercent", m_settings.hybridManifestVerifyPolicy.samplePercent);
+    m_qsettings->setValue("security/watchChangeJournal", m_settings.watchChangeJournal);
+    m_qsettings->setValue("security/watchFailFast", m_settings.watchFailFast);
+    m_qsettings->setValue("security/watchFailFastReport", m_settings.watchFailFastReport);
+    m_qsettings->setValue("security/watchChunkLargeFiles", m_settings.watchChunkLargeFiles);
     m_qsettings->setValue("iso/scanDirectory", m_settings.isoScanDirectory);
     m_qsettings->setValue("iso/autoVerify", m_settings.isoAutoVerifyOnScan);
     m_qsettings->setValue("iso/autoVerifyOnUsbMount", m_settings.isoAutoVerifyOnUsbMount);
     m_qsettings->setValue("iso/blockMountOnFailure", m_settings.blockMountOnIsoVerifyFailure);
     m_qsettings->setValue("iso/verifyDecompressed", m_settings.isoVerifyDecompressed);
     m_qsettings->setValue("iso/preferOfflineSidecars", m_settings.isoPreferOfflineSidecars);
+    m_qsettings->setValue("iso/readCache", m_settings.isoReadCache);
+    m_qsettings->setValue("iso/verifyDdImages", m_settings.isoVerifyDdImages);
     m_qsettings->setValue("iso/verifyParallel", m_settings.isoVerifyParallel);
+    m_qsettings->setValue("iso/mirrorUrl", m_settings.isoMirrorUrl);
     m_qsettings->setValue("general/showFirstRunWizard", m_settings.showFirstRunWizard);
     m_qsettings->setValue("general/settingsProfile", m_settings.settingsProfile);
     m_qsettings->setValue("badusb/enabled", m_settings.badUsbEnabled);
@@ -1216,12 +1563,20 @@ void MainWindow::saveSettings()
     m_qsettings->setValue("badusb/alertCompositeStorage", m_settings.badUsbAlertCompositeStorage);
     m_qsettings->setValue("badusb/alertInterfaceDrift", m_settings.badUsbAlertInterfaceDrift);
     m_qsettings->setValue("badusb/alertRapidReconnect", m_settings.badUsbAlertRapidReconnect);
+    m_qsettings->setValue("badusb/alertKeystrokeRate", m_settings.badUsbAlertKeystrokeRate);
     m_qsettings->setValue("badusb/autoBaselineTrusted", m_settings.badUsbAutoBaselineTrusted);
     m_qsettings->setValue("badusb/confirmAnomalies", m_settings.badUsbConfirmAnomalies);
     m_qsettings->setValue("badusb/usbmonEnabled", m_settings.badUsbUsbmonEnabled);
     m_qsettings->setValue("badusb/usbmonOnAnomalyOnly", m_settings.badUsbUsbmonOnAnomalyOnly);
     m_qsettings->setValue("badusb/usbmonCommand", m_settings.badUsbUsbmonCommand);
+    m_qsettings->setValue("badusb/usbmonPreTriggerSeconds", m_settings.badUsbUsbmonPreTriggerSeconds);
+    m_qsettings->setValue("badusb/usbmonSuspectOnly", m_settings.badUsbUsbmonSuspectOnly);
+    m_qsettings->setValue("badusb/usbmonSummarize", m_settings.badUsbUsbmonSummarize);
+    m_qsettings->setValue("badusb/captureQuotaMiB", m_settings.badUsbCaptureQuotaMiB);
+    m_qsettings->setValue("badusb/captureMaxAgeDays", m_settings.badUsbCaptureMaxAgeDays);
+    m_qsettings->setValue("badusb/captureCompress", m_settings.badUsbCaptureCompress);
     m_qsettings->setValue("ui/recentEventsLimit", m_settings.recentEventsLimit);
+    m_qsettings->setValue("ui/activityLogLines", m_settings.activityLogLines);
     m_qsettings->setValue("ui/deviceHistoryRetentionDays", m_settings.deviceHistoryRetentionDays);
     m_qsettings->setValue("ui/deviceHistoryMaxEntries", m_settings.deviceHistoryMaxEntries);
     m_qsettings->setValue("diagnostics/logHostUsbInventory", m_settings.diagnosticLogHostUsbInventory);
@@ -1302,6 +1657,12 @@ void MainWindow::showEvent(QShowEvent* event)
 {
     QMainWindow::showEvent(event);
     m_trayIcon->updateWindowVisibility(true);
+    if (QScreen* screen = this->screen()) {
+        ProgressHub::instance().setFrameRate(screen->refreshRate());
+        AnimationClock::instance().setFrameRate(screen->refreshRate());
+    }
+    ProgressHub::instance().setBackground(isMinimized());
+    AnimationClock::instance().setSuspended(isMinimized());
 
 #ifdef Q_OS_WIN
     if (!m_volumeDeviceNotify && internalWinId()) {
@@ -1333,6 +1694,17 @@ void MainWindow::hideEvent(QHideEvent* event)
 {
     QMainWindow::hideEvent(event);
     m_trayIcon->updateWindowVisibility(false);
+    ProgressHub::instance().setBackground(true);
+    AnimationClock::instance().setSuspended(true);
+}
+
+void MainWindow::changeEvent(QEvent* event)
+{
+    QMainWindow::changeEvent(event);
+    if (event->type() == QEvent::WindowStateChange) {
+        ProgressHub::instance().setBackground(isMinimized() || !isVisible());
+        AnimationClock::instance().setSuspended(isMinimized() || !isVisible());
+    }
 }
 
 #ifdef Q_OS_WIN
@@ -1376,10 +1748,34 @@ void MainWindow::onDeviceConnected(const DeviceInfo& device)
     
     // Add device card
     addDeviceCard(device);
-    
+    if (device.udevEventNs > 0) {
+        PerfMetrics::udevToCardLatency().observeNs(PerfMetrics::nowNs() - device.udevEventNs);
+    }
+
+    primeDeviceGeometry(device.deviceNode);
+
+    // Identity is the first verification stage: a lookup, decided before any read.
+    const PolicyDecision decision = policyDecision(device);
+    const bool known = decision.known;
+    m_stagedVerdicts.insert(device.deviceNode, StagedVerdict(decision.finalStage));
+    auto record = known ? m_database->getDevice(device) : std::nullopt;
+    if (decision.blocked) {
+        recordVerifyStage(device.deviceNode, VerifyStage::Identity, StageOutcome::Fail,
+                          QStringLiteral("drive is blocked"));
+    } else if (record) {
+        recordVerifyStage(device.deviceNode, VerifyStage::Identity, StageOutcome::Pass,
+                          QStringLiteral("whitelisted"));
+    } else {
+        recordVerifyStage(device.deviceNode, VerifyStage::Identity, StageOutcome::Inconclusive,
+                          QStringLiteral("not in the whitelist"));
+    }
+
+    if (record && m_stagedVerdicts.value(device.deviceNode).verdict() != ProvisionalVerdict::Block) {
+        checkLayout(device, *record);
+    }
+
     // Check if device is known
-    if (m_database->hasDevice(device)) {
-        auto record = m_database->getDevice(device);
+    if (known) {
         if (record) {
             handleKnownDevice(device, *record);
             m_trayIcon->notifyDeviceConnected(device, true);
@@ -1395,6 +1791,9 @@ void MainWindow::onDeviceConnected(const DeviceInfo& device)
         m_trayIcon->notifyDeviceConnected(device, false);
     }
     
+    // Whatever the verify is waiting for (the eject seal's deferral, the user), the stick is idle.
+    maybeStartSpeculativePrefetch(device);
+
     updateSidebarStats();
     updateEmptyState();
     m_trayIcon->updateDeviceList(m_deviceMonitor->connectedDevices());
@@ -1434,9 +1833,19 @@ void MainWindow::onDeviceDisconnected(const QString& deviceNode)
         }
     }
     
+    cancelManifestJobs(deviceNode);
+    stopSpeculativePrefetch(deviceNode);
+    m_speculativePrefetches.remove(deviceNode);
     removeDeviceCard(deviceNode);
+    stopWatchJournal(deviceNode);
     m_pendingHashActions.remove(deviceNode);
+    m_sharedReadHybrids.remove(deviceNode);
     m_lastVerificationHashes.remove(deviceNode);
+    m_stoppedEarlyVerifies.remove(deviceNode);
+    m_stagedVerdicts.remove(deviceNode);
+    m_sealableDevices.remove(deviceNode);
+    RawDeviceHash::forgetDeviceAccess(deviceNode);
+    DeviceGeometryCache::instance().forget(deviceNode);
 
     if (!drive.isEmpty()) {
         bool driveStillPresent = false;
@@ -1466,6 +1875,7 @@ void MainWindow::onDeviceDisconnected(const QString& deviceNode)
 void MainWindow::onDeviceChanged(const DeviceInfo& device)
 {
     updateDeviceCard(device);
+    maybeStartSpeculativePrefetch(device);  // mounted after the connect
 #ifdef Q_OS_WIN
     QTimer::singleShot(600, this, [this, deviceNode = device.deviceNode]() {
         if (auto info = m_deviceMonitor->getDevice(deviceNode)) {
@@ -1481,6 +1891,10 @@ void MainWindow::onDeviceChanged(const DeviceInfo& device)
 void MainWindow::onInitialScanComplete(int deviceCount)
 {
     logMessage(QString("Initial scan complete: %1 device(s) found").arg(deviceCount), LogLevel::Info);
+    if (m_initialScanBeginUs >= 0) {
+        StartupTrace::record(QStringLiteral("udev initial scan"), m_initialScanBeginUs, StartupTrace::nowUs());
+        m_initialScanBeginUs = -1;
+    }
     updateSidebarStats();
     updateEmptyState();
     scheduleUsbMonitorRefresh();
@@ -1510,7 +1924,7 @@ void MainWindow::handleNewDevice(const DeviceInfo& device)
     }
 
     const QString drive = driveKey(device);
-    if (isDriveBlocked(device)) {
+    if (policyDecision(device).blocked) {
         logMessage(QString("Drive blocked: %1").arg(device.displayName()), LogLevel::Warning);
         return;
     }
@@ -1565,7 +1979,7 @@ void MainWindow::handleNewDevicePartition(const DeviceInfo& device)
     m_database->addDevice(record);
     logMessage(QString("Device whitelisted: %1").arg(device.displayName()));
 
-    if (m_settings.autoHashOnConnect) {
+    if (autoHashOnConnect()) {
         startDeviceVerification(device.deviceNode);
         hashAllPartitionsOnParent(device);
     }
@@ -1625,40 +2039,302 @@ void MainWindow::whitelistDrivePartitions(const DeviceInfo& device)
 
     logMessage(QString("Drive whitelisted: %1").arg(drive));
 
-    if (m_settings.autoHashOnConnect) {
-        for (const DeviceInfo& part : m_deviceMonitor->connectedDevices()) {
-            if (driveKey(part) != drive) {
-                continue;
-            }
-            if (!m_database->hasDevice(part)) {
-                continue;
-            }
-            if (m_hashJobDevices.values().contains(part.deviceNode)) {
-                continue;
-            }
-            startHashing(part.deviceNode);
+    if (autoHashOnConnect()) {
+        for (const DeviceInfo& part : m_deviceMonitor->connectedDevices()) {
+            if (driveKey(part) != drive) {
+                continue;
+            }
+            if (!m_database->hasDevice(part)) {
+                continue;
+            }
+            if (m_hashJobDevices.values().contains(part.deviceNode)) {
+                continue;
+            }
+            startHashing(part.deviceNode);
+        }
+    }
+}
+
+void MainWindow::handleKnownDevice(const DeviceInfo& device, const DeviceRecord& record)
+{
+    const QString deviceId = m_database->canonicalUniqueId(device);
+    m_database->updateLastSeen(deviceId);
+    
+    DeviceCard* card = getDeviceCard(device.deviceNode);
+    if (card) {
+        if (auto updated = m_database->getDevice(deviceId)) {
+            card->setDeviceRecord(*updated);
+        } else {
+            card->setDeviceRecord(record);
+        }
+    }
+    
+    if (m_stagedVerdicts.value(device.deviceNode).verdict() == ProvisionalVerdict::Block) {
+        return;  // conclusive at identity: reading the device cannot change the outcome
+    }
+    if (autoHashOnConnect()) {
+        const VerifyStage finalStage = m_stagedVerdicts.value(device.deviceNode).finalStage();
+        if (m_settings.ejectSeal && !record.ejectSeal.isEmpty() && finalStage > VerifyStage::QuickSample) {
+            checkEjectSeal(device, record);
+        } else {
+            startDeviceVerification(device.deviceNode);
+        }
+        hashAllPartitionsOnParent(device);
+    }
+}
+
+void MainWindow::checkEjectSeal(const DeviceInfo& device, const DeviceRecord& record)
+{
+    // One-shot: whatever this read finds, the next connect needs a fresh eject to skip ahead.
+    m_database->updateEjectSeal(record.uniqueId, {});
+    const EjectSeal sealed = record.ejectSeal;
+    if (sealed.baselineHash != record.hash || sealed.manifestRoot != record.watchManifest.manifestRoot) {
+        logMessage(QStringLiteral("Eject seal for %1 predates its baseline; verifying").arg(device.displayName()),
+                   LogLevel::Info, device.deviceNode);
+        startDeviceVerification(device.deviceNode);
+        return;
+    }
+
+    const QString deviceNode = device.deviceNode;
+    const QString deviceName = device.displayName();
+    auto* watcher = new QFutureWatcher<EjectSeal>(this);
+    connect(watcher, &QFutureWatcher<EjectSeal>::finished, this, [this, watcher, sealed, deviceNode, deviceName]() {
+        watcher->deleteLater();
+        if (!m_stagedVerdicts.contains(deviceNode)) {
+            return;  // disconnected meanwhile
+        }
+        const QString reason = EjectSealProbe::mismatch(sealed, watcher->result());
+        if (!reason.isEmpty()) {
+            logMessage(QStringLiteral("Eject seal for %1 does not hold (%2); verifying").arg(deviceName, reason),
+                       LogLevel::Info, deviceNode);
+            startDeviceVerification(deviceNode);
+            return;
+        }
+        logMessage(QStringLiteral("Eject seal for %1 holds; full verify in %2 s")
+                       .arg(deviceName)
+                       .arg(EjectSealProbe::kDeferredVerifyDelayMs / 1000),
+                   LogLevel::Info, deviceNode);
+        recordVerifyStage(deviceNode, VerifyStage::QuickSample, StageOutcome::Pass,
+                          QStringLiteral("eject seal holds"));
+        if (DeviceCard* card = getDeviceCard(deviceNode)) {
+            card->setVerificationStatus(VerificationStatus::Verified);
+        }
+        QTimer::singleShot(EjectSealProbe::kDeferredVerifyDelayMs, this, [this, deviceNode]() {
+            if (m_stagedVerdicts.contains(deviceNode)) {
+                startDeviceVerification(deviceNode);
+            }
+        });
+    });
+    // About 1 MB of reads; queued like a quick sample on the device's lane.
+    const IoScheduler::Task task{IoScheduler::wholeDiskNode(deviceNode), IoScheduler::Priority::Normal};
+    watcher->setFuture(IoScheduler::instance().run(task, [deviceNode]() {
+        return EjectSealProbe::captureDevice(deviceNode, IoScheduler::wholeDiskNode(deviceNode));
+    }));
+}
+
+void MainWindow::checkLayout(const DeviceInfo& device, const DeviceRecord& record)
+{
+    if (record.layoutFingerprint.isEmpty()) {
+        recordVerifyStage(device.deviceNode, VerifyStage::Layout, StageOutcome::Inconclusive,
+                          QStringLiteral("no layout baseline"));
+        return;
+    }
+    const LayoutFingerprint baseline = record.layoutFingerprint;
+    const QString deviceNode = device.deviceNode;
+    const QString deviceName = device.displayName();
+    auto* watcher = new QFutureWatcher<LayoutFingerprint>(this);
+    connect(watcher, &QFutureWatcher<LayoutFingerprint>::finished, this,
+            [this, watcher, baseline, deviceNode, deviceName]() {
+                watcher->deleteLater();
+                const LayoutFingerprint now = watcher->result();
+                if (!m_stagedVerdicts.contains(deviceNode)) {
+                    return;  // disconnected meanwhile
+                }
+                if (now.isEmpty()) {
+                    recordVerifyStage(deviceNode, VerifyStage::Layout, StageOutcome::Inconclusive,
+                                      QStringLiteral("first sectors not readable directly"));
+                    return;
+                }
+                const QString reason = LayoutProbe::mismatch(baseline, now);
+                if (reason.isEmpty()) {
+                    recordVerifyStage(deviceNode, VerifyStage::Layout, StageOutcome::Pass,
+                                      QStringLiteral("layout matches"));
+                    return;
+                }
+                logMessage(QStringLiteral("ALERT: %1 - %2 since the baseline").arg(deviceName, reason),
+                           LogLevel::Security, deviceNode);
+                recordVerifyStage(deviceNode, VerifyStage::Layout, StageOutcome::Fail, reason);
+                if (DeviceCard* card = getDeviceCard(deviceNode)) {
+                    card->setVerificationStatus(VerificationStatus::Modified);
+                }
+                m_trayIcon->notifyVerificationResult(deviceName, VerificationStatus::Modified);
+                VerifyHistoryEntry he;
+                he.deviceNode = deviceNode;
+                he.deviceLabel = deviceName;
+                he.kind = VerifyHistoryKind::Hash;
+                he.status = QStringLiteral("fail");
+                he.summary = QStringLiteral("Layout check: %1").arg(reason);
+                recordVerifyHistory(he);
+            });
+    // Two small reads ahead of anything else queued for the device.
+    const IoScheduler::Task task{IoScheduler::wholeDiskNode(deviceNode), IoScheduler::Priority::Interactive};
+    watcher->setFuture(IoScheduler::instance().run(task, [deviceNode]() {
+        return LayoutProbe::captureDevice(deviceNode, IoScheduler::wholeDiskNode(deviceNode));
+    }));
+}
+
+void MainWindow::primeDeviceGeometry(const QString& deviceNode)
+{
+    if (deviceNode.isEmpty()) {
+        return;
+    }
+    auto* watcher = new QFutureWatcher<DeviceGeometry>(this);
+    connect(watcher, &QFutureWatcher<DeviceGeometry>::finished, this, [this, watcher, deviceNode]() {
+        watcher->deleteLater();
+        const DeviceGeometry geometry = watcher->result();
+        if (geometry.isEmpty()) {
+            return;  // not openable without elevation; hashing falls back to its own probe
+        }
+        logMessage(QStringLiteral("Geometry: %1 MB, %2/%3-byte sectors, max request %4 KB%5")
+                       .arg(geometry.sizeBytes / (1024 * 1024))
+                       .arg(geometry.logicalSectorBytes)
+                       .arg(geometry.physicalSectorBytes)
+                       .arg(geometry.maxSectorsKB)
+                       .arg(geometry.usbSpeedMbps > 0
+                                ? QStringLiteral(", USB %1 Mbit/s").arg(geometry.usbSpeedMbps)
+                                : QString()),
+                   LogLevel::Debug, deviceNode);
+    });
+    // Ahead of the hash and layout reads on the device's lane, which then find it cached.
+    const IoScheduler::Task task{IoScheduler::wholeDiskNode(deviceNode), IoScheduler::Priority::Interactive};
+    watcher->setFuture(IoScheduler::instance().run(task, [deviceNode]() {
+        return DeviceGeometryCache::instance().geometry(deviceNode);
+    }));
+}
+
+void MainWindow::captureLayoutBaseline(const QString& deviceNode, const QString& storageId)
+{
+    if (deviceNode.isEmpty()) {
+        return;
+    }
+    auto* watcher = new QFutureWatcher<LayoutFingerprint>(this);
+    connect(watcher, &QFutureWatcher<LayoutFingerprint>::finished, this, [this, watcher, storageId]() {
+        watcher->deleteLater();
+        const LayoutFingerprint fingerprint = watcher->result();
+        if (!fingerprint.isEmpty()) {
+            m_database->updateLayoutFingerprint(storageId, fingerprint);
+        }
+    });
+    const IoScheduler::Task task{IoScheduler::wholeDiskNode(deviceNode), IoScheduler::Priority::Normal};
+    watcher->setFuture(IoScheduler::instance().run(task, [deviceNode]() {
+        return LayoutProbe::captureDevice(deviceNode, IoScheduler::wholeDiskNode(deviceNode));
+    }));
+}
+
+void MainWindow::maybeStartSpeculativePrefetch(const DeviceInfo& device)
+{
+    const QString deviceNode = device.deviceNode;
+    if (!m_settings.speculativePrefetch || device.mountPoint.isEmpty() || m_speculativePrefetches.contains(deviceNode)
+        || m_pendingHashActions.contains(deviceNode) || !m_manifestJobDevices.keys(deviceNode).isEmpty()
+        || m_stagedVerdicts.value(deviceNode).verdict() == ProvisionalVerdict::Block) {
+        return;
+    }
+    const auto record = m_database->getDevice(canonicalDeviceId(device));
+    // A full-partition hash reads the block device, and a metadata-first verify only a
+    // sample of the files: warming them all would not help either.
+    if (!record || !record->watchManifest.hasBaseline()
+        || record->verificationProfile == VerificationProfile::FullPartition
+        || m_settings.manifestVerifyPolicy(record->verificationProfile).metadataFirst) {
+        return;
+    }
+    std::optional<WatchManifest> manifest = m_database->watchManifestFor(*record);
+    if (!manifest) {
+        return;
+    }
+
+    auto cancelled = std::make_shared<std::atomic<bool>>(false);
+    m_speculativePrefetches.insert(deviceNode, cancelled);
+    const QString deviceName = device.displayName();
+    auto* watcher = new QFutureWatcher<ManifestPrefetch::Result>(this);
+    connect(watcher, &QFutureWatcher<ManifestPrefetch::Result>::finished, this,
+            [this, watcher, deviceNode, deviceName]() {
+                watcher->deleteLater();
+                const ManifestPrefetch::Result result = watcher->result();
+                if (result.files > 0) {
+                    logMessage(QStringLiteral("Prefetched %1 watched file(s) (%2 MB) of %3 ahead of its verify")
+                                   .arg(result.files)
+                                   .arg(result.bytes / (1024 * 1024))
+                                   .arg(deviceName),
+                               LogLevel::Debug, deviceNode);
+                }
+            });
+    // Idle priority on the device's lane: it queues behind the connect-time layout and seal
+    // reads, and the verify it is meant for can join the lane while it runs.
+    const IoScheduler::Task task{IoScheduler::wholeDiskNode(deviceNode), IoScheduler::Priority::Background};
+    watcher->setFuture(IoScheduler::instance().run(
+        task, [mountPoint = device.mountPoint, manifest = std::move(*manifest), cancelled]() {
+            return ManifestPrefetch::run(mountPoint, manifest, ManifestPrefetch::kBudgetBytes, cancelled.get());
+        }));
+}
+
+void MainWindow::stopSpeculativePrefetch(const QString& deviceNode)
+{
+    // The entry stays while the device does, so a later mount change does not start another.
+    if (const auto cancelled = m_speculativePrefetches.value(deviceNode)) {
+        cancelled->store(true);
+    }
+}
+
+VerifyStage MainWindow::finalVerifyStage(const std::optional<DeviceRecord>& record) const
+{
+    const VerificationProfile profile =
+        record ? record->verificationProfile : m_settings.defaultVerificationProfile;
+    if (profile == VerificationProfile::WatchManifest) {
+        return VerifyStage::Metadata;
+    }
+    if (profile == VerificationProfile::FullPartition) {
+        if (m_settings.defaultHashScanMode == HashScanMode::QuickSample) {
+            return VerifyStage::QuickSample;
+        }
+        if (m_settings.defaultHashScanMode == HashScanMode::WatchManifestOnly) {
+            return VerifyStage::Metadata;
         }
     }
+    return VerifyStage::FullContent;
 }
 
-void MainWindow::handleKnownDevice(const DeviceInfo& device, const DeviceRecord& record)
+void MainWindow::recordVerifyStage(const QString& deviceNode, VerifyStage stage, StageOutcome outcome,
+                                   const QString& detail)
 {
-    const QString deviceId = m_database->canonicalUniqueId(device);
-    m_database->updateLastSeen(deviceId);
-    
-    DeviceCard* card = getDeviceCard(device.deviceNode);
-    if (card) {
-        if (auto updated = m_database->getDevice(deviceId)) {
-            card->setDeviceRecord(*updated);
-        } else {
-            card->setDeviceRecord(record);
+    auto it = m_stagedVerdicts.find(deviceNode);
+    if (it == m_stagedVerdicts.end()) {
+        return;  // disconnected meanwhile
+    }
+    const bool changed = it->record(stage, outcome, detail);
+    if (it->verdict() == ProvisionalVerdict::Allow && it->isConclusive()) {
+        const std::optional<DeviceInfo> device = m_deviceMonitor->getDevice(deviceNode);
+        if (device && !device->isMounted) {
+            m_sealableDevices.insert(deviceNode);
         }
+        // Baselines from before layout fingerprints were kept pick one up on their next pass.
+        const std::optional<DeviceRecord> record =
+            changed && device ? m_database->getDevice(*device) : std::nullopt;
+        if (record && record->layoutFingerprint.isEmpty()) {
+            captureLayoutBaseline(deviceNode, record->uniqueId);
+        }
+    } else {
+        m_sealableDevices.remove(deviceNode);
     }
-    
-    if (m_settings.autoHashOnConnect) {
-        startDeviceVerification(device.deviceNode);
-        hashAllPartitionsOnParent(device);
+    if (!changed) {
+        return;
     }
+    const StagedVerdict::StageResult& last = it->stages().constLast();
+    logMessage(QStringLiteral("Verdict for %1: %2 (%3 %4%5, %6 ms after connect)")
+                   .arg(deviceNode, it->describe(), verifyStageName(stage), stageOutcomeName(outcome),
+                        detail.isEmpty() ? QString() : QStringLiteral(": ") + detail)
+                   .arg(last.elapsedMs),
+               it->verdict() == ProvisionalVerdict::Block ? LogLevel::Security : LogLevel::Info,
+               deviceNode);
 }
 
 // ============================================================================
@@ -1682,21 +2358,44 @@ void MainWindow::onHashStarted(const QString& jobId, const QString& deviceNode)
     updateSidebarStats();
 }
 
-void MainWindow::onHashProgress(const QString& jobId, double progress,
-                                 quint64 bytesProcessed, double speedMBps,
-                                 double etaSeconds, quint64 totalBytes)
+void MainWindow::onProgressPublished(const QList<ProgressSample>& samples)
 {
-    QString deviceNode = m_hashJobDevices.value(jobId);
-    if (deviceNode.isEmpty()) return;
-    
-    DeviceCard* card = getDeviceCard(deviceNode);
-    if (card) {
-        card->setHashProgress(progress);
-        card->setHashSpeed(speedMBps);
-        card->setHashEta(etaSeconds);
-        card->setHashBytes(bytesProcessed, totalBytes);
+    const ProgressSample* lastHash = nullptr;
+    for (const ProgressSample& sample : samples) {
+        if (sample.bytesTotal == 0) {
+            continue;
+        }
+        QString deviceNode;
+        if (sample.kind == ProgressSample::Kind::Hash) {
+            deviceNode = m_hashJobDevices.value(sample.jobId);
+            lastHash = &sample;
+        } else if (sample.kind == ProgressSample::Kind::Manifest) {
+            deviceNode = m_manifestJobDevices.value(sample.jobId);
+        }
+        if (deviceNode.isEmpty()) {
+            continue;
+        }
+        DeviceCard* card = getDeviceCard(deviceNode);
+        if (!card) {
+            continue;
+        }
+        // Scrolled out, on another page or in the tray: show it once the card is on screen.
+        if (!card->isVisible() || card->visibleRegion().isEmpty()) {
+            ProgressHub::instance().republish(sample);
+            continue;
+        }
+        card->setHashProgress(sample.fraction);
+        card->setHashSpeed(sample.speedMBps);
+        card->setHashEta(sample.etaSeconds);
+        card->setHashBytes(sample.bytesDone, sample.bytesTotal);
+    }
+    if (!lastHash) {
+        return;
     }
 
+    const double progress = lastHash->fraction;
+    const double speedMBps = lastHash->speedMBps;
+    const double etaSeconds = lastHash->etaSeconds;
     QString etaText;
     if (etaSeconds > 1.0) {
         const int mins = static_cast<int>(etaSeconds) / 60;
@@ -1735,6 +2434,45 @@ void MainWindow::onHashCompleted(const QString& jobId, const HashResult& result)
         record = m_database->getDevice(deviceId);
     }
     const QString storageId = record ? record->uniqueId : deviceId;
+
+    if (result.tunedBufferSizeKB > 0) {
+        m_database->updateTunedBufferSize(storageId, result.tunedBufferSizeKB);
+        logMessage(QString("Buffer auto-tune for %1 %2: %3 KB")
+                       .arg(deviceInfo->vendor, deviceInfo->model)
+                       .arg(result.tunedBufferSizeKB));
+    }
+    if (!result.capacityCheck.isEmpty()) {
+        m_database->updateCapacityCheck(storageId, result.capacityCheck);
+        const QString line = CapacityProbe::describe(result.capacityCheck);
+        if (result.capacityCheck.isCounterfeit()) {
+            logMessage(QString("Capacity probe: %1 - %2").arg(deviceInfo->displayName(), line),
+                       LogLevel::Warning);
+            appendUiEvent(makeUiEvent(QStringLiteral("Capacity anomaly"), deviceInfo->displayName(),
+                                      QStringLiteral("Health"), QStringLiteral("failed"), line, deviceNode));
+            m_trayIcon->notifyCounterfeitCapacity(deviceInfo->displayName(), line);
+        } else {
+            logMessage(QString("Capacity probe: %1 - %2").arg(deviceInfo->displayName(), line));
+        }
+    }
+    if (record && ReadHealth::isAssessable(result)) {
+        const QList<ReadFinding> findings = ReadHealth::assess(record->readProfile, result);
+        m_database->updateReadProfile(storageId, ReadHealth::advance(record->readProfile, result, findings));
+        for (const ReadFinding& finding : findings) {
+            logMessage(QString("Read health: %1 - %2: %3")
+                           .arg(deviceInfo->displayName(), readAnomalyName(finding.kind), finding.detail),
+                       LogLevel::Warning);
+            appendUiEvent(makeUiEvent(QStringLiteral("Read speed anomaly"), deviceInfo->displayName(),
+                                      QStringLiteral("Health"), QStringLiteral("warning"),
+                                      finding.detail, deviceNode));
+        }
+        if (!findings.isEmpty()) {
+            m_trayIcon->notifyReadAnomaly(deviceInfo->displayName(), findings.first().detail);
+        }
+    }
+    
+    if (!result.regionHashes.isEmpty()) {
+        reportRegionHashes(*deviceInfo, result);
+    }
     
     auto finishVerified = [&]() {
         if (pending == PendingHashAction::UnmountAfterVerify) {
@@ -1750,10 +2488,86 @@ void MainWindow::onHashCompleted(const QString& jobId, const HashResult& result)
             mountIfVerified(deviceNode);
         }
     };
-    
-    if (record && !record->hash.isEmpty()) {
+
+    // After a baseline-algorithm pass, read the device once more for the pre-screen
+    // digest so the next reconnect can skip the expensive hash; mounting waits for it.
+    auto seedPrescreen = [&]() {
+        if (!m_settings.hashPrescreenXxh3 || ctx.hashDeviceNode.isEmpty()
+            || !hashScanModeReadsAll(ctx.scanMode)
+            || !RawDeviceHash::algorithmAvailable(RawDeviceHash::Algorithm::XXH3_128)) {
+            return false;
+        }
+        const auto stored = m_database->getDevice(storageId);
+        if (!stored || (!stored->prescreenHash.isEmpty() && ctx.purpose != HashJobPurpose::Confirm)) {
+            return false;
+        }
+        logMessage(QString("Recording XXH3-128 pre-screen for %1").arg(deviceInfo->displayName()));
+        if (pending != PendingHashAction::None) {
+            m_pendingHashActions[deviceNode] = pending;
+        }
+        startHashJob(deviceNode, ctx.hashDeviceNode, ctx.scope, ctx.scanMode, false,
+                     HashJobPurpose::SeedPrescreen);
+        return true;
+    };
+
+    const VerifyStage contentStage = ctx.scanMode == HashScanMode::QuickSample ? VerifyStage::QuickSample
+                                                                               : VerifyStage::FullContent;
+    if (ctx.purpose == HashJobPurpose::SeedPrescreen) {
+        m_database->updatePrescreenHash(storageId, result.hash, result.algorithm);
+        logMessage(QString("XXH3-128 pre-screen stored for %1").arg(deviceInfo->displayName()));
+        if (card) {
+            card->setVerificationStatus(VerificationStatus::Verified);
+            card->setProgressVisible(false);
+        }
+        finishVerified();
+    } else if (ctx.purpose == HashJobPurpose::Prescreen) {
+        if (record && !record->prescreenHash.isEmpty()
+            && record->prescreenHash.compare(result.hash, Qt::CaseInsensitive) == 0) {
+            logMessage(QString("Verified: %1 - XXH3-128 pre-screen matches (non-cryptographic)")
+                           .arg(deviceInfo->displayName()));
+            recordVerifyStage(deviceNode, VerifyStage::FullContent, StageOutcome::Pass,
+                              QStringLiteral("XXH3-128 pre-screen matches"));
+
+            if (card) {
+                card->setVerificationStatus(VerificationStatus::Verified);
+                card->setProgressVisible(false);
+                card->flash(FSColor(Verified));
+            }
+
+            m_trayIcon->notifyVerificationResult(deviceInfo->displayName(), VerificationStatus::Verified);
+            {
+                VerifyHistoryEntry he;
+                he.deviceNode = deviceNode;
+                he.deviceLabel = deviceInfo->displayName();
+                he.mountPoint = deviceInfo->mountPoint;
+                he.kind = VerifyHistoryKind::Hash;
+                he.status = QStringLiteral("pass");
+                he.summary = QStringLiteral("Pre-screen matches (%1, non-cryptographic)")
+                                 .arg(result.algorithm);
+                he.durationMs = result.durationMs;
+                he.performance = result.performance;
+                recordVerifyHistory(he);
+            }
+            finishVerified();
+        } else {
+            // A changed pre-screen is never reported as tampering: only the baseline
+            // algorithm gets to say "modified".
+            logMessage(QString("%1 - XXH3-128 pre-screen changed; confirming with %2")
+                           .arg(deviceInfo->displayName(),
+                                record ? record->hashAlgorithm : m_settings.hashAlgorithm));
+            recordVerifyStage(deviceNode, VerifyStage::FullContent, StageOutcome::Inconclusive,
+                              QStringLiteral("pre-screen changed"));
+            if (pending != PendingHashAction::None) {
+                m_pendingHashActions[deviceNode] = pending;
+            }
+            startHashJob(deviceNode, ctx.hashDeviceNode, ctx.scope, ctx.scanMode, false,
+                         HashJobPurpose::Confirm);
+        }
+    } else if (record && !record->hash.isEmpty()) {
         if (m_database->verifyHash(*deviceInfo, result.hash)) {
             logMessage(QString("Verified: %1 - hash matches").arg(deviceInfo->displayName()));
+            recordVerifyStage(deviceNode, contentStage, StageOutcome::Pass,
+                              QStringLiteral("%1 matches").arg(result.algorithm));
             
             if (card) {
                 card->setVerificationStatus(VerificationStatus::Verified);
@@ -1771,12 +2585,43 @@ void MainWindow::onHashCompleted(const QString& jobId, const HashResult& result)
                 he.status = QStringLiteral("pass");
                 he.summary = QStringLiteral("Hash matches (%1)").arg(result.algorithm);
                 he.durationMs = result.durationMs;
+                he.performance = result.performance;
                 recordVerifyHistory(he);
             }
-            finishVerified();
+            if (!result.blockHashes.isEmpty()
+                && DatabaseManager::blockHashesFor(*record) != result.blockHashes) {
+                // Baselines from before block digests were kept pick them up on the next pass.
+                m_database->updateBlockHashes(storageId, result.blockHashes, result.blockSize);
+            }
+            if (!seedPrescreen()) {
+                finishVerified();
+            }
         } else {
+            const bool stoppedEarly = result.stoppedAtBlock >= 0;
+            QString changedText;
+            if (!result.blockHashes.isEmpty() && record->blockSize == result.blockSize) {
+                changedText = RawDeviceHash::describeByteRanges(RawDeviceHash::changedBlockRanges(
+                    DatabaseManager::blockHashesFor(*record), result.blockHashes, result.blockSize,
+                    stoppedEarly ? 0 : result.bytesProcessed));
+            }
             logMessage(QString("ALERT: %1 - hash MISMATCH!").arg(deviceInfo->displayName()), LogLevel::Security);
-            m_lastVerificationHashes[deviceNode] = result.hash;
+            recordVerifyStage(deviceNode, contentStage, StageOutcome::Fail,
+                              QStringLiteral("%1 mismatch").arg(result.algorithm));
+            if (!changedText.isEmpty()) {
+                logMessage(QString("%1 - %2 %3")
+                               .arg(deviceInfo->displayName(),
+                                    stoppedEarly ? QStringLiteral("verify stopped at first changed block:")
+                                                 : QStringLiteral("changed regions:"),
+                                    changedText),
+                           LogLevel::Security);
+            }
+            // Approve on an early stop finds no hash here and re-hashes in full first.
+            if (stoppedEarly) {
+                m_lastVerificationHashes.remove(deviceNode);
+                m_stoppedEarlyVerifies.insert(deviceNode);
+            } else {
+                m_lastVerificationHashes[deviceNode] = result.hash;
+            }
 
             if (card) {
                 card->setVerificationStatus(VerificationStatus::Modified);
@@ -1791,15 +2636,22 @@ void MainWindow::onHashCompleted(const QString& jobId, const HashResult& result)
                 he.mountPoint = deviceInfo->mountPoint;
                 he.kind = VerifyHistoryKind::Hash;
                 he.status = QStringLiteral("mismatch");
-                he.summary = QStringLiteral("Hash mismatch");
+                he.summary = changedText.isEmpty()
+                                 ? QStringLiteral("Hash mismatch")
+                                 : QStringLiteral("Hash mismatch at %1").arg(changedText);
+                if (stoppedEarly) {
+                    he.summary += QStringLiteral(" (stopped at first changed block)");
+                }
                 he.durationMs = result.durationMs;
+                he.performance = result.performance;
                 recordVerifyHistory(he);
             }
 
+            // After an early stop there is no full hash to approve or mount with.
             const bool offerMount = !deviceInfo->isMounted;
-            if (m_settings.requireConfirmationForModified) {
+            if (!stoppedEarly && m_settings.requireConfirmationForModified) {
                 showModifiedDeviceAlert(*deviceInfo, record->hash, result.hash, offerMount);
-            } else if (pending == PendingHashAction::MountAfterVerify
+            } else if (!stoppedEarly && pending == PendingHashAction::MountAfterVerify
                        && !m_settings.blockModifiedDevices) {
                 acceptFingerprintAndMount(*deviceInfo, result.hash, result.algorithm);
             }
@@ -1807,7 +2659,13 @@ void MainWindow::onHashCompleted(const QString& jobId, const HashResult& result)
     } else {
         m_database->updateHash(storageId, result.hash, result.algorithm, result.durationMs,
                                result.hashScopeLabel, result.scanModeLabel);
+        if (!result.blockHashes.isEmpty()) {
+            m_database->updateBlockHashes(storageId, result.blockHashes, result.blockSize);
+        }
+        captureLayoutBaseline(deviceNode, storageId);
         logMessage(QString("Hash stored for %1").arg(deviceInfo->displayName()));
+        recordVerifyStage(deviceNode, contentStage, StageOutcome::Inconclusive,
+                          QStringLiteral("baseline stored"));
         {
             VerifyHistoryEntry he;
             he.deviceNode = deviceNode;
@@ -1817,6 +2675,7 @@ void MainWindow::onHashCompleted(const QString& jobId, const HashResult& result)
             he.status = QStringLiteral("pass");
             he.summary = QStringLiteral("Baseline stored (%1)").arg(result.algorithm);
             he.durationMs = result.durationMs;
+            he.performance = result.performance;
             recordVerifyHistory(he);
         }
         
@@ -1826,7 +2685,9 @@ void MainWindow::onHashCompleted(const QString& jobId, const HashResult& result)
         }
         
         m_trayIcon->notifyHashCompleted(deviceInfo->displayName(), result.durationMs, result.speedMBps());
-        finishVerified();
+        if (!seedPrescreen()) {
+            finishVerified();
+        }
     }
     
     if (m_activeHashCount == 0) {
@@ -1907,7 +2768,7 @@ void MainWindow::onHashCancelled(const QString& jobId)
 
 void MainWindow::triggerIsoVerificationOnMount(const MountManager::MountResult& result)
 {
-    if (!m_isoWidget || result.mountPoint.isEmpty()) return;
+    if (!m_isoWidget || result.mountPoint.isEmpty() || m_headlessServiceRunning) return;
     if (!m_settings.isoAutoVerifyOnUsbMount && m_settings.appModule != AppModule::IsoVerifier) return;
     if (m_isoVerifyTriggeredMounts.contains(result.mountPoint)) {
         return;
@@ -1928,6 +2789,7 @@ void MainWindow::onMountCompleted(const MountManager::MountResult& result)
 {
     if (result.success) {
         logMessage(QString("Mounted %1 at %2").arg(result.deviceNode, result.mountPoint));
+        m_sealableDevices.remove(result.deviceNode);
         m_deviceMonitor->rescan();
         if (m_pendingHashActions.value(result.deviceNode) == PendingHashAction::MountAfterVerify) {
             m_pendingHashActions.remove(result.deviceNode);
@@ -1944,11 +2806,13 @@ void MainWindow::onUnmountCompleted(const MountManager::UnmountResult& result)
     if (m_unmountBeforeHash.remove(result.deviceNode)) {
         if (result.success) {
             logMessage(QString("Unmounted %1; starting hash").arg(result.deviceNode));
+            cancelManifestJobs(result.deviceNode);
+            stopWatchJournal(result.deviceNode);
             m_deviceMonitor->rescan();
             if (m_pendingHashLaunch.contains(result.deviceNode)) {
                 const PendingHashLaunch pending = m_pendingHashLaunch.take(result.deviceNode);
                 startHashJob(result.deviceNode, pending.hashDeviceNode, pending.scope,
-                             pending.mode, pending.resume);
+                             pending.mode, pending.resume, pending.purpose);
             } else {
                 startHashing(result.deviceNode, true);
             }
@@ -1963,6 +2827,8 @@ void MainWindow::onUnmountCompleted(const MountManager::UnmountResult& result)
 
     if (result.success) {
         logMessage(QString("Unmounted %1").arg(result.deviceNode));
+        cancelManifestJobs(result.deviceNode);
+        stopWatchJournal(result.deviceNode);
         m_deviceMonitor->rescan();
     } else {
         logMessage(QString("Unmount failed for %1: %2").arg(result.deviceNode, result.errorMessage), LogLevel::Error);
@@ -1978,6 +2844,19 @@ void MainWindow::onPowerOffCompleted(const QString& deviceNode, bool success, co
     }
 }
 
+void MainWindow::onBulkEjectCompleted(const MountManager::BulkEjectResult& result)
+{
+    for (const MountManager::EjectResult& device : result.devices) {
+        if (!device.success) {
+            logMessage(QString("Eject failed for %1: %2").arg(device.deviceNode, device.errorMessage),
+                       LogLevel::Error);
+        }
+    }
+    logMessage(QString("Ejected %1 of %2 device(s)").arg(result.succeeded()).arg(result.devices.size()),
+               result.success() ? LogLevel::Info : LogLevel::Warning);
+    m_deviceMonitor->rescan();
+}
+
 // ============================================================================
 // Database Events
 // ============================================================================
@@ -2065,13 +2944,77 @@ void MainWindow::onEjectRequested(const QString& deviceNode)
 #ifdef Q_OS_WIN
     m_mountManager->unmount(deviceNode);
 #else
-    if (device->isMounted) {
-        m_mountManager->unmount(deviceNode);
-    }
-    m_mountManager->powerOff(deviceNode);
+    sealBeforeEject({deviceNode}, [this, deviceNode, mounted = device->isMounted]() {
+        if (mounted) {
+            m_mountManager->unmount(deviceNode);
+        }
+        m_mountManager->powerOff(deviceNode);
+    });
 #endif
 }
 
+void MainWindow::onEjectAllRequested(const QStringList& deviceNodes)
+{
+    QStringList present;
+    for (const QString& deviceNode : deviceNodes) {
+        if (m_deviceMonitor->getDevice(deviceNode)) {
+            present.append(deviceNode);
+        }
+    }
+    if (present.isEmpty()) return;
+
+    logMessage(QString("Eject all requested: %1 device(s)").arg(present.size()));
+    sealBeforeEject(present, [this, present]() { m_mountManager->ejectAll(present); });
+}
+
+void MainWindow::sealBeforeEject(const QStringList& deviceNodes, std::function<void()> eject)
+{
+    QStringList nodes;
+    QStringList storageIds;
+    for (const QString& deviceNode : deviceNodes) {
+        const std::optional<DeviceInfo> device = m_deviceMonitor->getDevice(deviceNode);
+        const std::optional<DeviceRecord> record = device ? m_database->getDevice(*device) : std::nullopt;
+        if (m_settings.ejectSeal && m_sealableDevices.contains(deviceNode) && device && !device->isMounted
+            && record) {
+            nodes.append(deviceNode);
+            storageIds.append(record->uniqueId);
+        }
+    }
+    if (nodes.isEmpty()) {
+        eject();
+        return;
+    }
+
+    auto* watcher = new QFutureWatcher<QList<EjectSeal>>(this);
+    connect(watcher, &QFutureWatcher<QList<EjectSeal>>::finished, this,
+            [this, watcher, nodes, storageIds, eject = std::move(eject)]() {
+                watcher->deleteLater();
+                const QList<EjectSeal> seals = watcher->result();
+                for (qsizetype i = 0; i < nodes.size(); ++i) {
+                    const std::optional<DeviceRecord> record = m_database->getDevice(storageIds.at(i));
+                    if (seals.at(i).isEmpty() || !record || !m_sealableDevices.contains(nodes.at(i))) {
+                        continue;
+                    }
+                    EjectSeal seal = seals.at(i);
+                    seal.baselineHash = record->hash;
+                    seal.manifestRoot = record->watchManifest.manifestRoot;
+                    if (m_database->updateEjectSeal(record->uniqueId, seal)) {
+                        logMessage(QStringLiteral("Sealed %1 on eject").arg(nodes.at(i)), LogLevel::Info,
+                                   nodes.at(i));
+                    }
+                }
+                eject();
+            });
+    const IoScheduler::Task task{QString(), IoScheduler::Priority::Normal};
+    watcher->setFuture(IoScheduler::instance().run(task, [nodes]() {
+        QList<EjectSeal> seals;
+        for (const QString& deviceNode : nodes) {
+            seals.append(EjectSealProbe::captureDevice(deviceNode, IoScheduler::wholeDiskNode(deviceNode)));
+        }
+        return seals;
+    }));
+}
+
 void MainWindow::onRehashRequested(const QString& deviceNode)
 {
     logMessage(QString("Rehash requested: %1").arg(deviceNode));
@@ -2114,16 +3057,21 @@ void MainWindow::onDeviceCardClicked(const QString& deviceNode)
 
 void MainWindow::recordVerifyHistory(const VerifyHistoryEntry& entry)
 {
-    VerifyHistory::instance().append(entry);
+    if (m_historyLoaded) {
+        VerifyHistory::instance().append(entry);
+        refreshRollupViews();
+    } else {
+        m_pendingVerifyHistory.append(entry);
+    }
     refreshVerifyHistoryPanel(m_historyFilterDevice);
     if (m_reportsPage) {
-        refreshReportsPage();
+        m_reportsPage->addVerificationRow(entry);
     }
     const QString status = entry.status.toLower();
     if (m_alertsPage
         && (status == QLatin1String("fail") || status == QLatin1String("mismatch")
             || status == QLatin1String("error") || status == QLatin1String("partial"))) {
-        refreshAlertsPage();
+        m_alertsPage->addAlerts({verifyAlertEntry(entry)});
     }
 
     QString type = QStringLiteral("Verify");
@@ -2141,7 +3089,7 @@ void MainWindow::recordVerifyHistory(const VerifyHistoryEntry& entry)
 
 void MainWindow::refreshVerifyHistoryPanel(const QString& deviceNodeFilter)
 {
-    if (!m_historyList) {
+    if (!m_historyList || !m_historyLoaded) {
         return;
     }
     m_historyList->clear();
@@ -2200,18 +3148,33 @@ void MainWindow::onSettingsRequested()
 
 void MainWindow::onSearchTextChanged(const QString& text)
 {
-    QString searchLower = text.toLower();
-    
-    for (auto it = m_deviceCards.begin(); it != m_deviceCards.end(); ++it) {
-        DeviceCard* card = it.value();
-        if (text.isEmpty()) {
-            card->setVisible(true);
-        } else {
-            bool matches = card->device().displayName().toLower().contains(searchLower) ||
-                           card->device().deviceNode.toLower().contains(searchLower) ||
-                           card->device().serial.toLower().contains(searchLower);
-            card->setVisible(matches);
-        }
+    // Clearing the box shows everything at once; a query waits for typing to pause.
+    if (text.isEmpty()) {
+        m_searchTimer->stop();
+        applyDeviceSearch();
+        return;
+    }
+    m_searchTimer->start();
+}
+
+void MainWindow::applyDeviceSearch()
+{
+    const QString query = m_searchEdit ? m_searchEdit->text().toLower() : QString();
+    if (query == m_appliedSearch) {
+        return;
+    }
+    m_appliedSearch = query;
+    for (DeviceCard* card : std::as_const(m_deviceCards)) {
+        applyDeviceSearch(card);
+    }
+}
+
+void MainWindow::applyDeviceSearch(DeviceCard* card)
+{
+    const bool matches = m_appliedSearch.isEmpty()
+                         || m_deviceSearchText.value(card->device().deviceNode).contains(m_appliedSearch);
+    if (card->isHidden() == matches) {
+        card->setVisible(matches);
     }
 }
 
@@ -2256,20 +3219,45 @@ void MainWindow::onThemeChanged(StyleManager::Theme theme)
     FSStyle.setTheme(theme);
     applyStyle();
     refreshShellStyles();
+}
+
+void MainWindow::applyBackgroundIo()
+{
+    IoPriority::setBandwidthLimit(qint64(qMax(0, m_settings.backgroundIoLimitMBps)) * 1024 * 1024);
+    IoBufferPool::setHugePages(IoBufferPool::hugePagesFromName(m_settings.hashHugePages));
+    MemoryBudget::instance().setLimit(qint64(qMax(0, m_settings.memoryBudgetMiB)) * 1024 * 1024);
+    if (m_settings.pauseBackgroundOnBattery) {
+        m_powerTimer->start();
+    } else {
+        m_powerTimer->stop();
+    }
+    updateBackgroundIoHold();
+}
 
-    for (auto* card : m_deviceCards) {
-        card->setStyleSheet(FSStyle.deviceCardStyleSheet());
+void MainWindow::updateBackgroundIoHold()
+{
+    const bool hold = m_settings.pauseBackgroundOnBattery && IoPriority::onBatteryPower();
+    if (hold == IoPriority::isHeld()) {
+        return;
     }
+    IoPriority::setHeld(hold);
+    logMessage(hold ? QStringLiteral("On battery: background hashes and verifies are paused")
+                    : QStringLiteral("Background hashes and verifies resumed"));
 }
 
 void MainWindow::applySettings(const AppSettings& settings)
 {
+    SettingsSnapshot::publish(settings);
     m_maxUiEvents = qMax(20, settings.recentEventsLimit);
+    if (m_logModel) {
+        m_logModel->setCapacity(settings.activityLogLines);
+    }
     while (m_uiEvents.size() > m_maxUiEvents) {
         m_uiEvents.removeLast();
     }
     m_trayIcon->setNotificationsEnabled(settings.showNotifications);
     m_hashWorker->setMaxConcurrent(settings.maxConcurrentHashes);
+    applyBackgroundIo();
     FSStyle.setAnimationsEnabled(settings.animationsEnabled);
     FSStyle.setBaseFontSize(settings.fontSizePt);
 
@@ -2282,10 +3270,15 @@ void MainWindow::applySettings(const AppSettings& settings)
     }
 
     applyAppModule();
-    applyIsoVerifyOptions();
     if (m_isoWidget) {
         m_isoWidget->setActiveProfile(settings.settingsProfile);
     }
+    if (!settings.watchChangeJournal) {
+        for (auto it = m_journaledMounts.constBegin(); it != m_journaledMounts.constEnd(); ++it) {
+            m_watchJournal->unwatch(it.value());
+        }
+        m_journaledMounts.clear();
+    }
     configureBadUsbMonitoring();
     refreshShellStyles();
 
@@ -2392,6 +3385,7 @@ void MainWindow::onNavPageSelected(AppPage page)
     if (!m_pageStack) {
         return;
     }
+    ensurePage(page);
     const int index = appPageStackIndex(page);
     if (index >= 0 && index < m_pageStack->count()) {
         m_pageStack->setCurrentIndex(index);
@@ -2427,11 +3421,45 @@ void MainWindow::onNavPageSelected(AppPage page)
     }
 }
 
+void MainWindow::startHistoryLoad()
+{
+    // Both stores are only touched here until the load finishes; appends made meanwhile are
+    // queued and the pages that read them wait for onHistoryLoaded().
+    m_historyLoad = new QFutureWatcher<void>(this);
+    connect(m_historyLoad, &QFutureWatcher<void>::finished, this, &MainWindow::onHistoryLoaded);
+    // JSON parsing off the local profile: CPU work, kept off the I/O pool the device reads use.
+    const IoScheduler::Task task{QString(), IoScheduler::Priority::Normal, IoScheduler::Pool::Cpu};
+    m_historyLoad->setFuture(IoScheduler::instance().run(task, []() {
+        VerifyHistory::instance().load();
+        DeviceTimelineLog::instance().load();
+    }));
+}
+
+void MainWindow::onHistoryLoaded()
+{
+    m_historyLoaded = true;
+    for (const VerifyHistoryEntry& entry : std::exchange(m_pendingVerifyHistory, {})) {
+        VerifyHistory::instance().append(entry);
+    }
+    for (const UiEventEntry& entry : std::exchange(m_pendingTimeline, {})) {
+        DeviceTimelineLog::instance().append(entry);
+    }
+    refreshVerifyHistoryPanel(m_historyFilterDevice);
+    refreshDeviceHistoryPage();
+    refreshAlertsPage();
+    refreshReportsPage();
+    refreshRollupViews();
+}
+
 void MainWindow::persistTimelineEvent(const UiEventEntry& entry)
 {
     if (entry.deviceNode.isEmpty()) {
         return;
     }
+    if (!m_historyLoaded) {
+        m_pendingTimeline.append(entry);
+        return;
+    }
     DeviceTimelineLog::instance().append(entry);
 }
 
@@ -2444,7 +3472,10 @@ void MainWindow::appendUiEvent(const UiEventEntry& entry)
     persistTimelineEvent(entry);
     refreshUsbMonitorHome();
     if (m_alertsPage && isAlertUiEvent(entry)) {
-        refreshAlertsPage();
+        m_alertsPage->addAlerts({entry});
+    }
+    if (m_deviceHistoryPage) {
+        m_deviceHistoryPage->addEvent(entry);
     }
 }
 
@@ -2517,7 +3548,7 @@ QList<UiEventEntry> MainWindow::deviceHistoryEvents(const QString& deviceNode) c
 
 void MainWindow::refreshDeviceHistoryPage()
 {
-    if (!m_deviceHistoryPage || !m_deviceMonitor) {
+    if (!m_deviceHistoryPage || !m_deviceMonitor || !m_historyLoaded) {
         return;
     }
 
@@ -2541,7 +3572,7 @@ void MainWindow::refreshDeviceHistoryPage()
         }
         addDevice(node, label);
     }
-    for (const DeviceRecord& rec : m_database->getAllDevices()) {
+    for (const DatabaseManager::DeviceSummary& rec : m_database->getDeviceSummaries()) {
         if (!rec.lastKnownInfo.deviceNode.isEmpty()) {
             addDevice(rec.lastKnownInfo.deviceNode, rec.lastKnownInfo.displayName());
         }
@@ -2557,6 +3588,7 @@ void MainWindow::refreshDeviceHistoryPage()
 
     const QString selected = m_deviceHistoryPage->selectedDeviceNode();
     m_deviceHistoryPage->setEvents(deviceHistoryEvents(selected));
+    m_deviceHistoryPage->setDeviceSummary(VerifyHistory::instance().rollup().device(selected));
 }
 
 void MainWindow::showDeviceHistory(const QString& deviceNode)
@@ -2564,22 +3596,23 @@ void MainWindow::showDeviceHistory(const QString& deviceNode)
     if (m_navSidebar) {
         m_navSidebar->setCurrentPage(AppPage::DeviceHistory);
     }
+    ensurePage(AppPage::DeviceHistory);
     if (m_deviceHistoryPage && !deviceNode.isEmpty()) {
         m_deviceHistoryPage->setSelectedDevice(deviceNode);
     }
     onNavPageSelected(AppPage::DeviceHistory);
 }
 
-bool MainWindow::isRecordCountedAsAllowed(const DeviceRecord& record) const
+bool MainWindow::isRecordCountedAsAllowed(const DatabaseManager::DeviceSummary& record) const
 {
     switch (m_settings.allowedCountMode) {
         case AllowedCountMode::TrustLevel:
             return record.trustLevel >= 1;
         case AllowedCountMode::VerifiedHash:
-            return !record.hash.isEmpty();
+            return record.hasHash;
         case AllowedCountMode::TrustOrHash:
         default:
-            return record.trustLevel >= 1 || !record.hash.isEmpty();
+            return record.trustLevel >= 1 || record.hasHash;
     }
 }
 
@@ -2590,6 +3623,35 @@ bool MainWindow::isDriveBlocked(const DeviceInfo& device) const
     return BlockedDriveStore::instance().isBlocked(key, uid);
 }
 
+PolicyDecision MainWindow::policyDecision(const DeviceInfo& device)
+{
+    const QString deviceId = canonicalDeviceId(device);
+    const QString drive = driveKey(device);
+    const PolicyDecisionCache::Sources sources{m_database->recordGeneration(),
+                                               BlockedDriveStore::instance().listGeneration(), SettingsSnapshot::version()};
+    if (std::optional<PolicyDecision> cached = m_policyDecisions.find(deviceId, drive, sources)) {
+        return *cached;
+    }
+
+    PolicyDecision decision;
+    decision.driveKey = drive;
+    decision.blocked = BlockedDriveStore::instance().isBlocked(drive, deviceId);
+    const std::optional<DeviceRecord> record = m_database->getDevice(device);
+    decision.known = record.has_value();
+    decision.finalStage = finalVerifyStage(record);
+    if (record) {
+        decision.trustLevel = record->trustLevel;
+        decision.profile = record->verificationProfile;
+        decision.autoMount = record->autoMount || record->trustLevel >= 1;
+        decision.countedAllowed =
+            !decision.blocked && isRecordCountedAsAllowed(DatabaseManager::DeviceSummary::of(*record));
+    } else {
+        decision.profile = m_settings.defaultVerificationProfile;
+    }
+    m_policyDecisions.insert(deviceId, decision);
+    return decision;
+}
+
 void MainWindow::blockDriveForDevice(const DeviceInfo& device, const QString& label)
 {
     const QString key = driveKey(device);
@@ -2619,6 +3681,9 @@ void MainWindow::applyLiveSettings(const AppSettings& settings)
     m_settings = settings;
     applySettings(m_settings);
     saveSettings();
+    if (!m_settings.hashHelperSession) {
+        RawDeviceHash::closeHelperSession();
+    }
     if (m_settingsPage && m_database) {
         m_settingsPage->setDatabaseStatistics(m_database->deviceCount(),
                                               m_database->databasePath());
@@ -2685,7 +3750,7 @@ void MainWindow::refreshAllowBlockListPage()
         byId.insert(row.uniqueId.isEmpty() ? row.driveKey : row.uniqueId, row);
     };
 
-    for (const DeviceRecord& rec : m_database->getAllDevices()) {
+    for (const DatabaseManager::DeviceSummary& rec : m_database->getDeviceSummaries()) {
         AllowBlockRow row;
         row.uniqueId = rec.uniqueId;
         row.driveKey = rec.lastKnownInfo.deviceNode.isEmpty()
@@ -2702,8 +3767,8 @@ void MainWindow::refreshAllowBlockListPage()
                                                     : QStringLiteral("Unknown"));
         row.trustDetail = rec.trustLevel >= 1
                               ? QStringLiteral("Trust %1").arg(rec.trustLevel)
-                              : (rec.hash.isEmpty() ? QStringLiteral("No hash")
-                                                    : QStringLiteral("Hash on file"));
+                              : (rec.hasHash ? QStringLiteral("Hash on file")
+                                             : QStringLiteral("No hash"));
         mergeRow(row);
     }
 
@@ -2734,13 +3799,13 @@ void MainWindow::refreshAllowBlockListPage()
                 row.driveKey = driveKey(d);
                 row.displayName = d.displayName();
                 row.vendorModel = QStringLiteral("%1 / %2").arg(d.vendor, d.model);
-                row.isBlocked = isDriveBlocked(d);
-                auto rec = m_database->getDevice(d);
-                row.isAllowed = rec && isRecordCountedAsAllowed(*rec) && !row.isBlocked;
+                const PolicyDecision decision = policyDecision(d);
+                row.isBlocked = decision.blocked;
+                row.isAllowed = decision.countedAllowed;
                 row.status = row.isBlocked ? QStringLiteral("Blocked")
                                            : (row.isAllowed ? QStringLiteral("Allowed")
                                                             : QStringLiteral("Unknown"));
-                row.trustDetail = rec ? QStringLiteral("In database") : QStringLiteral("Not listed");
+                row.trustDetail = decision.known ? QStringLiteral("In database") : QStringLiteral("Not listed");
             }
             row.deviceNode = d.deviceNode;
             row.isConnected = true;
@@ -2781,27 +3846,7 @@ QList<UiEventEntry> MainWindow::collectAlertEntries() const
         if (s == QLatin1String("pass") || s.isEmpty()) {
             continue;
         }
-        UiEventEntry e;
-        e.id = QStringLiteral("vh-%1").arg(vh.timestamp.toSecsSinceEpoch());
-        e.time = vh.timestamp;
-        e.event = vh.summary.isEmpty() ? QStringLiteral("Verification") : vh.summary;
-        e.device = vh.deviceLabel.isEmpty() ? vh.deviceNode : vh.deviceLabel;
-        switch (vh.kind) {
-            case VerifyHistoryKind::IsoScan:
-                e.type = QStringLiteral("ISO");
-                break;
-            case VerifyHistoryKind::Manifest:
-                e.type = QStringLiteral("Watch");
-                break;
-            case VerifyHistoryKind::Hash:
-            default:
-                e.type = QStringLiteral("Verify");
-                break;
-        }
-        e.result = vh.status;
-        e.detail = vh.detail.isEmpty() ? vh.summary : vh.detail;
-        e.deviceNode = vh.deviceNode;
-        alerts.append(e);
+        alerts.append(verifyAlertEntry(vh));
     }
 
     std::sort(alerts.begin(), alerts.end(), [](const UiEventEntry& a, const UiEventEntry& b) {
@@ -2825,24 +3870,51 @@ QList<UiEventEntry> MainWindow::collectAlertEntries() const
 
 void MainWindow::refreshAlertsPage()
 {
-    if (!m_alertsPage) {
+    if (!m_alertsPage || !m_historyLoaded) {
         return;
     }
     m_alertsPage->setAlerts(collectAlertEntries());
+    refreshRollupViews();
 }
 
 void MainWindow::refreshReportsPage()
 {
-    if (!m_reportsPage) {
+    if (!m_reportsPage || !m_historyLoaded) {
         return;
     }
 
     const QString auditPath = AuditLog::logPath();
     const QString policyPath = Policy::PolicyPaths::auditLogPath();
+    AuditWriter::flushAll();  // queued lines show up in the tails below
     m_reportsPage->setLogPaths(auditPath, policyPath);
-    m_reportsPage->setVerificationRows(VerifyHistory::instance().recentEntries(150));
-    m_reportsPage->setAuditRows(readAuditLogTail(auditPath, 200, false));
-    m_reportsPage->setPolicyAuditRows(readAuditLogTail(policyPath, 200, true));
+    // First pages only; the tables read further back as they are scrolled.
+    const int page = RecordTableModelBase::kFetchBatch;
+    m_reportsPage->setVerificationRows(VerifyHistory::instance().recentEntries(page));
+    m_reportsPage->setAuditRows(readAuditLogTail(auditPath, page, false));
+    m_reportsPage->setPolicyAuditRows(readAuditLogTail(policyPath, page, true));
+    refreshRollupViews();
+}
+
+void MainWindow::refreshRollupViews()
+{
+    if (!m_historyLoaded) {
+        return;
+    }
+    const VerifyRollup& rollup = VerifyHistory::instance().rollup();
+    const QDate today = QDate::currentDate();
+    const VerifyRollup::Counts todayCounts = rollup.day(today);
+    if (m_navSidebar) {
+        m_navSidebar->setBadge(AppPage::Alerts, static_cast<int>(todayCounts.failed));
+    }
+    if (m_alertsPage) {
+        m_alertsPage->setVerifyFailures(todayCounts, rollup.since(today.addDays(-6)));
+    }
+    if (m_reportsPage) {
+        m_reportsPage->setVerificationSummary(rollup.since(today.addDays(-29)), rollup.totals());
+    }
+    if (m_deviceHistoryPage) {
+        m_deviceHistoryPage->setDeviceSummary(rollup.device(m_deviceHistoryPage->selectedDeviceNode()));
+    }
 }
 
 void MainWindow::refreshAboutPage()
@@ -2873,7 +3945,7 @@ void MainWindow::refreshUsbMonitorHome()
     }
 
     int allowed = 0;
-    for (const DeviceRecord& rec : m_database->getAllDevices()) {
+    for (const DatabaseManager::DeviceSummary& rec : m_database->getDeviceSummaries()) {
         if (isRecordCountedAsAllowed(rec)) {
             ++allowed;
         }
@@ -3089,6 +4161,14 @@ DeviceCard* MainWindow::addDeviceCard(const DeviceInfo& device)
             }
         }
     });
+    connect(card, &DeviceCard::pauseHashRequested, this, [this](const QString& node, bool pause) {
+        for (auto it = m_hashJobDevices.constBegin(); it != m_hashJobDevices.constEnd(); ++it) {
+            if (it.value() == node) {
+                m_hashWorker->setHashPaused(it.key(), pause);
+                break;
+            }
+        }
+    });
     connect(card, &DeviceCard::watchListRequested, this, &MainWindow::onWatchListRequested);
     connect(card, &DeviceCard::acceptFingerprintRequested,
             this, &MainWindow::onAcceptFingerprintRequested);
@@ -3100,6 +4180,10 @@ DeviceCard* MainWindow::addDeviceCard(const DeviceInfo& device)
         m_hiddenDeviceLayout->addWidget(card);
     }
     m_deviceCards[device.deviceNode] = card;
+    m_deviceSearchText.insert(device.deviceNode, deviceSearchText(device));
+    if (!m_appliedSearch.isEmpty() && card->parentWidget()) {
+        applyDeviceSearch(card);
+    }
     
     // Note: Don't use FSStyle.applyFadeIn(card) here as DeviceCard 
     // already has its own graphics effect (m_glowEffect) which would be replaced
@@ -3113,6 +4197,7 @@ void MainWindow::removeDeviceCard(const QString& deviceNode)
     if (it != m_deviceCards.end()) {
         DeviceCard* card = it.value();
         m_deviceCards.erase(it);
+        m_deviceSearchText.remove(deviceNode);
         card->deleteLater();
     }
 }
@@ -3127,6 +4212,10 @@ void MainWindow::updateDeviceCard(const DeviceInfo& device)
     DeviceCard* card = getDeviceCard(device.deviceNode);
     if (card) {
         card->setDevice(device);
+        m_deviceSearchText.insert(device.deviceNode, deviceSearchText(device));
+        if (!m_appliedSearch.isEmpty()) {
+            applyDeviceSearch(card);
+        }
     }
 }
 
@@ -3160,6 +4249,33 @@ QString MainWindow::hashStorageIdFor(const DeviceInfo& device, HashScope scope)
     return m_database->canonicalUniqueId(device);
 }
 
+void MainWindow::reportRegionHashes(const DeviceInfo& disk, const HashResult& result)
+{
+    for (const RegionHash& region : result.regionHashes) {
+        if (region.name == QLatin1String("table")) {
+            logMessage(QString("Partition table area of %1 (%2 bytes): %3 %4")
+                           .arg(disk.displayName())
+                           .arg(region.length)
+                           .arg(result.algorithm, region.hash));
+            continue;
+        }
+        auto partition = m_deviceMonitor->getDevice(region.name);
+        auto record = partition ? m_database->getDevice(*partition) : std::nullopt;
+        const bool comparable = record && !record->hash.isEmpty()
+            && record->hashAlgorithm.compare(result.algorithm, Qt::CaseInsensitive) == 0
+            && hashScopeFromString(record->hashScope) == HashScope::Partition
+            && hashScanModeReadsAll(hashScanModeFromString(record->hashScanMode));
+        if (!comparable) {
+            logMessage(QString("Partition %1: %2 %3").arg(region.name, result.algorithm, region.hash));
+        } else if (record->hash.compare(region.hash, Qt::CaseInsensitive) == 0) {
+            logMessage(QString("Partition %1 matches its baseline (whole-disk read)").arg(region.name));
+        } else {
+            logMessage(QString("Partition %1 differs from its baseline (whole-disk read)").arg(region.name),
+                       LogLevel::Warning, region.name);
+        }
+    }
+}
+
 void MainWindow::promptAndStartHash(const QString& deviceNode, bool allowDialog)
 {
     auto deviceInfo = m_deviceMonitor->getDevice(deviceNode);
@@ -3179,10 +4295,14 @@ void MainWindow::promptAndStartHash(const QString& deviceNode, bool allowDialog)
     const QString algo = record && !record->hashAlgorithm.isEmpty() ? record->hashAlgorithm
                                                                       : m_settings.hashAlgorithm;
     const QString hashNodePreview = resolveHashDeviceNode(*deviceInfo, scope);
+    const RawDeviceHash::StorageIdentity identity = RawDeviceHash::storageIdentity(hashNodePreview);
     const bool hasCheckpoint =
         m_settings.hashResumeCheckpoints
         && HashCheckpointStore::instance()
-               .checkpointFor(hashNodePreview, algo, hashScanModeToString(mode))
+               .checkpointFor(hashNodePreview, algo,
+                              hashScanModeReadsAll(mode) ? QStringLiteral("full")
+                                                         : hashScanModeToString(mode),
+                              identity.storageId, identity.layoutFingerprint)
                .has_value();
 
     const bool needDialog = allowDialog && m_settings.promptHashOptionsOnManual
@@ -3196,7 +4316,7 @@ void MainWindow::promptAndStartHash(const QString& deviceNode, bool allowDialog)
         scope = dlg.choice().scope;
         mode = dlg.choice().scanMode;
         resume = dlg.choice().resumeFromCheckpoint;
-    } else if (hasCheckpoint && m_settings.hashResumeCheckpoints && mode == HashScanMode::Full) {
+    } else if (hasCheckpoint && m_settings.hashResumeCheckpoints && hashScanModeReadsAll(mode)) {
         resume = true;
     }
 
@@ -3209,8 +4329,19 @@ void MainWindow::promptAndStartHash(const QString& deviceNode, bool allowDialog)
     startHashJob(deviceNode, hashNode, scope, mode, resume);
 }
 
+bool MainWindow::shouldPrescreen(const DeviceRecord& record, HashScanMode mode, bool resume) const
+{
+    // Only a full read can stand in for a full read, and a resumed job already has
+    // half a baseline-algorithm block list behind it.
+    return m_settings.hashPrescreenXxh3 && !resume && hashScanModeReadsAll(mode)
+        && !record.hash.isEmpty() && !record.prescreenHash.isEmpty()
+        && hashScanModeReadsAll(hashScanModeFromString(record.hashScanMode))
+        && RawDeviceHash::algorithmAvailable(RawDeviceHash::Algorithm::XXH3_128);
+}
+
 void MainWindow::startHashJob(const QString& uiDeviceNode, const QString& hashDeviceNode,
-                              HashScope scope, HashScanMode mode, bool resume)
+                              HashScope scope, HashScanMode mode, bool resume,
+                              HashJobPurpose purpose)
 {
     auto deviceInfo = m_deviceMonitor->getDevice(uiDeviceNode);
     if (!deviceInfo) {
@@ -3231,7 +4362,7 @@ void MainWindow::startHashJob(const QString& uiDeviceNode, const QString& hashDe
         if (mounted && hashDeviceNode == uiDeviceNode) {
             logMessage(QString("Unmounting %1 before hash verification").arg(uiDeviceNode));
             m_unmountBeforeHash.insert(uiDeviceNode);
-            m_pendingHashLaunch[uiDeviceNode] = {hashDeviceNode, scope, mode, resume};
+            m_pendingHashLaunch[uiDeviceNode] = {hashDeviceNode, scope, mode, resume, purpose};
             m_mountManager->unmount(uiDeviceNode);
             return;
         }
@@ -3259,23 +4390,73 @@ void MainWindow::startHashJob(const QString& uiDeviceNode, const QString& hashDe
     job.scanMode = mode;
     job.resumeFromCheckpoint = resume;
     job.canonicalStorageId = storageId;
+    job.usbBus = deviceInfo->usbBus;
+    job.usbPortPath = deviceInfo->usbPortPath;
+    job.sizeHintBytes = deviceInfo->sizeBytes;
     job.bufferSizeKB = m_settings.hashBufferSizeKB;
+    if (m_settings.hashBufferAutoTune) {
+        const int tuned = m_database->tunedBufferSizeForModel(deviceInfo->vendor, deviceInfo->model);
+        if (tuned > 0) {
+            job.bufferSizeKB = tuned;
+        } else {
+            job.autoTuneBuffer = true;
+        }
+    }
     job.useMemoryMapping = m_settings.useMemoryMapping && mode == HashScanMode::Full && !resume;
+    job.useIoUring = m_settings.hashIoEngine == QStringLiteral("io_uring");
+    job.ioQueueDepth = m_settings.hashIoQueueDepth;
+    job.skipZeroRegions = m_settings.hashSkipZeroRegions;
+    job.reuseHelperSession = m_settings.hashHelperSession;
+    job.quickSamples = m_settings.hashQuickSamples;
+    job.quickSampleKB = m_settings.hashQuickSampleKB;
+    job.quickSampleMetadata = m_settings.hashQuickSampleMetadata;
+    if (m_settings.hashCapacityProbe) {
+        const auto stored = m_database->getDevice(storageId);
+        job.probeCapacity = !stored || stored->capacityCheck.isEmpty();
+    }
 
     if (auto record = m_database->getDevice(storageId)) {
         job.algorithm = HashWorker::algorithmFromName(
             record->hashAlgorithm.isEmpty() ? m_settings.hashAlgorithm : record->hashAlgorithm);
+        if (mode == HashScanMode::QuickSample
+            && record->hashAlgorithm.contains(QStringLiteral("-QUICK"), Qt::CaseInsensitive)) {
+            // A quick baseline only matches a quick hash with the same layout.
+            const RawDeviceHash::QuickSampleLayout layout =
+                RawDeviceHash::quickSampleLayoutFromLabel(record->hashAlgorithm);
+            job.quickSamples = layout.samples;
+            job.quickSampleKB = layout.sampleKB;
+            job.quickSampleMetadata = layout.metadataHotSpots;
+        }
+        if (purpose == HashJobPurpose::Verify && shouldPrescreen(*record, mode, resume)) {
+            purpose = HashJobPurpose::Prescreen;
+        }
+        if ((purpose == HashJobPurpose::Verify || purpose == HashJobPurpose::Confirm)
+            && hashScanModeReadsAll(mode) && record->blockSize == RawDeviceHash::kDefaultChunkBytes) {
+            job.expectedBlockHashes = DatabaseManager::blockHashesFor(*record);
+            job.stopAtFirstMismatch = m_settings.hashStopAtFirstChange
+                                      && !m_stoppedEarlyVerifies.remove(uiDeviceNode);
+        }
     } else {
         job.algorithm = HashWorker::algorithmFromName(m_settings.hashAlgorithm);
     }
+    if (purpose == HashJobPurpose::Prescreen || purpose == HashJobPurpose::SeedPrescreen) {
+        job.algorithm = HashWorker::Algorithm::XXH3_128;
+    }
+    if (hashDeviceNode == uiDeviceNode && hashScanModeReadsAll(mode)) {
+        job.sharedRead = m_sharedReadPasses.take(uiDeviceNode);
+    }
+    job.partitionHashes = scope == HashScope::WholeDisk
+                          && (purpose == HashJobPurpose::Verify || purpose == HashJobPurpose::Confirm);
 
     const QString jobId = m_hashWorker->startHash(job);
     m_hashJobDevices[jobId] = uiDeviceNode;
     HashJobContext ctx;
     ctx.uiDeviceNode = uiDeviceNode;
+    ctx.hashDeviceNode = hashDeviceNode;
     ctx.storageId = storageId;
     ctx.scope = scope;
     ctx.scanMode = mode;
+    ctx.purpose = purpose;
     m_hashJobContext[jobId] = ctx;
 }
 
@@ -3289,7 +4470,7 @@ void MainWindow::startHashing(const QString& deviceNode, bool skipUnmount)
         if (m_pendingHashLaunch.contains(deviceNode)) {
             const PendingHashLaunch pending = m_pendingHashLaunch.take(deviceNode);
             startHashJob(deviceNode, pending.hashDeviceNode, pending.scope, pending.mode,
-                         pending.resume);
+                         pending.resume, pending.purpose);
             return;
         }
     }
@@ -3301,9 +4482,14 @@ QString MainWindow::canonicalDeviceId(const DeviceInfo& device)
     return m_database->canonicalUniqueId(device);
 }
 
+bool MainWindow::autoHashOnConnect() const
+{
+    return m_settings.autoHashOnConnect && !m_headlessServiceRunning;
+}
+
 void MainWindow::hashAllPartitionsOnParent(const DeviceInfo& device)
 {
-    if (!m_settings.autoHashOnConnect || device.parentDevice.isEmpty()) {
+    if (!autoHashOnConnect() || device.parentDevice.isEmpty()) {
         return;
     }
 
@@ -3330,13 +4516,14 @@ void MainWindow::mountIfVerified(const QString& deviceNode)
     if (!deviceInfo || deviceInfo->isMounted) {
         return;
     }
-
-    auto record = m_database->getDevice(canonicalDeviceId(*deviceInfo));
-    if (!record) {
+    if (m_stagedVerdicts.value(deviceNode).verdict() == ProvisionalVerdict::Block) {
+        logMessage(QStringLiteral("Not mounting %1: %2").arg(deviceInfo->displayName(),
+                                                             m_stagedVerdicts.value(deviceNode).describe()),
+                   LogLevel::Security, deviceNode);
         return;
     }
 
-    if (record->autoMount || record->trustLevel >= 1) {
+    if (policyDecision(*deviceInfo).autoMount) {
         m_mountManager->mount(deviceNode);
     }
 }
@@ -3386,19 +4573,20 @@ void MainWindow::logMessage(const QString& message, LogLevel level, const QStrin
         m_usbMonitorPage->setStats(stats);
     }
     if (m_alertsPage && isAlertUiEvent(ev)) {
-        refreshAlertsPage();
+        m_alertsPage->addAlerts({ev});
+    }
+    if (m_deviceHistoryPage) {
+        m_deviceHistoryPage->addEvent(ev);
     }
 
-    if (m_logList) {
-        const QString timestamp = QDateTime::currentDateTime().toString("hh:mm:ss");
-        const QString logText = QString("[%1] %2").arg(timestamp, message);
-        auto* item = new QListWidgetItem(logText);
-        item->setForeground(QColor(FSStyle.color(StyleManager::ColorRole::TextSecondary)));
-        m_logList->addItem(item);
-        m_logList->scrollToBottom();
-        while (m_logList->count() > 500) {
-            delete m_logList->takeItem(0);
-        }
+    if (m_logModel) {
+        LogEntry entry;
+        entry.timestamp = QDateTime::currentDateTime();
+        entry.level = level;
+        entry.category = QStringLiteral("System");
+        entry.message = message;
+        entry.deviceId = deviceNode;
+        m_logModel->append(std::move(entry));
     }
 
     qDebug() << QString("[%1] %2").arg(prefix, message);
@@ -3528,6 +4716,7 @@ void MainWindow::acceptFingerprint(const DeviceInfo& device, const QString& actu
     const QString deviceId = canonicalDeviceId(device);
     m_database->updateHash(deviceId, actualHash, algorithm, 0);
     m_lastVerificationHashes.remove(device.deviceNode);
+    captureLayoutBaseline(device.deviceNode, deviceId);
 
     DeviceCard* card = getDeviceCard(device.deviceNode);
     if (card) {
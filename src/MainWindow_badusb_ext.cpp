@@ -1,13 +1,37 @@
 #include "MainWindow.h"
+#include "AppDiagnostics.h"
 #include "AuditLog.h"
 #include "BadUsbAnalyzer.h"
+#include "CaptureRetention.h"
 #include "Platform.h"
+#include "UsbCaptureSummary.h"
 
 #include <QDateTime>
+#include <QFutureWatcher>
 #include <QMessageBox>
+#include <QThreadPool>
+#include <QtConcurrent>
 
 namespace FlashSpartan {
 
+namespace {
+
+struct ArchivedCapture {
+    UsbCaptureSummary summary;
+    CaptureRetention::ArchiveResult archive;
+};
+
+CaptureRetention::Policy captureRetentionPolicy(const AppSettings& settings)
+{
+    CaptureRetention::Policy policy;
+    policy.quotaBytes = qint64(qMax(0, settings.badUsbCaptureQuotaMiB)) * 1024 * 1024;
+    policy.maxAgeDays = qMax(0, settings.badUsbCaptureMaxAgeDays);
+    policy.compress = settings.badUsbCaptureCompress;
+    return policy;
+}
+
+} // namespace
+
 void MainWindow::configureBadUsbMonitoring()
 {
     const PlatformCapabilities caps = Platform::capabilities();
@@ -18,9 +42,32 @@ void MainWindow::configureBadUsbMonitoring()
             m_badUsbWidget->setBaselineCount(m_badUsbBaselineStore->allDevices().size());
         }
     }
+    // Captures from earlier sessions age out here, and a tightened quota applies right away.
+    const CaptureRetention::Policy retention = captureRetentionPolicy(m_settings);
+    QThreadPool::globalInstance()->start([retention]() {
+        CaptureRetention::enforce(AppDiagnostics::badUsbCapturesDir(), retention);
+    });
     if (!m_hidMonitor) {
         return;
     }
+
+    QStringList ruleErrors;
+    const QList<BadUsbRuleDefinition> fleetRules = BadUsbRuleSet::loadDropIns(&ruleErrors);
+    m_badUsbRules = BadUsbRuleSet::compile(BadUsbRuleSet::builtinRules(m_settings) + fleetRules, &ruleErrors);
+    m_hidConnects.setMaxWindowSeconds(qMax(10, m_badUsbRules.maxWindowSeconds()));
+    for (const QString& error : ruleErrors) {
+        logMessage(error, LogLevel::Warning);
+    }
+    if (!fleetRules.isEmpty()) {
+        logMessage(QStringLiteral("BadUSB rules: %1 active (%2 predicates)")
+                       .arg(m_badUsbRules.ruleCount())
+                       .arg(m_badUsbRules.predicateCount()),
+                   LogLevel::Info);
+    }
+
+    if (m_usbmonCapture) {
+        m_usbmonCapture->setDeviceFiltering(m_settings.badUsbUsbmonSuspectOnly);
+    }
 #ifdef Q_OS_WIN
     if (m_usbHostMonitor && !m_usbHostMonitor->isMonitoring()) {
         m_usbHostMonitor->startMonitoring();
@@ -34,6 +81,29 @@ void MainWindow::configureBadUsbMonitoring()
     } else if (!badUsbActive && m_hidMonitor->isMonitoring()) {
         m_hidMonitor->stopMonitoring();
     }
+
+    // The pre-trigger ring has to run before the anomaly it is meant to explain.
+    if (m_usbmonCapture) {
+        const int preTrigger = badUsbActive && m_settings.badUsbUsbmonEnabled
+            ? m_settings.badUsbUsbmonPreTriggerSeconds
+            : 0;
+        const bool keystrokes = badUsbActive && m_settings.badUsbAlertKeystrokeRate;
+        const bool wasRunning = m_usbmonCapture->isNativeFeedRunning();
+        QString feedError;
+        if (preTrigger <= 0 && !keystrokes) {
+            m_usbmonCapture->stopNativeFeed();
+        } else if (!m_usbmonCapture->startNativeFeed(preTrigger, keystrokes, &feedError)) {
+            logMessage(QStringLiteral("Native usbmon feed unavailable (%1); keystroke-rate alerts are "
+                                      "off and captures use the capture command")
+                           .arg(feedError),
+                       LogLevel::Warning);
+        } else if (!wasRunning) {
+            logMessage(QStringLiteral("usbmon feed started (pre-trigger history: %1 s, keystroke rate: %2)")
+                           .arg(preTrigger)
+                           .arg(keystrokes ? QStringLiteral("on") : QStringLiteral("off")),
+                       LogLevel::Info);
+        }
+    }
 #endif
 
     refreshUsbPcapIntegration();
@@ -97,17 +167,13 @@ void MainWindow::processBadUsbDevice(const HidDeviceInfo& device)
     }
 
     const QString stableId = device.stableId();
-    const QDateTime now = QDateTime::currentDateTimeUtc();
-    QList<QDateTime>& history = m_hidConnectHistory[stableId];
-    history.append(now);
-    while (!history.isEmpty() && history.first().secsTo(now) > 10) {
-        history.removeFirst();
-    }
+    const qint64 nowSecs = QDateTime::currentSecsSinceEpoch();
+    m_hidConnects.record(stableId, nowSecs);
 
     const auto baseline = m_badUsbBaselineStore->getDevice(stableId);
     const QStringList relatedStorage = relatedStorageNodesForHid(device);
     const BadUsbAnomalyResult anomaly = BadUsbAnalyzer::analyzeConnect(
-        device, baseline, relatedStorage, history.size(), m_settings);
+        device, baseline, relatedStorage, m_hidConnects, nowSecs, m_badUsbRules);
 
     const bool trusted = baseline.has_value() && baseline->trusted;
     if (m_badUsbWidget) {
@@ -125,6 +191,29 @@ void MainWindow::processBadUsbDevice(const HidDeviceInfo& device)
         return;
     }
 
+    reportBadUsbAnomaly(device, anomaly);
+}
+
+void MainWindow::onKeystrokeRateExceeded(const HidKeystrokeAnalyzer::Finding& finding)
+{
+    if (!m_settings.badUsbEnabled || !m_settings.badUsbAlertKeystrokeRate || !m_hidMonitor) {
+        return;
+    }
+    // usbmon knows the bus and device address; the HID monitor knows what sits there.
+    for (const HidDeviceInfo& device : m_hidMonitor->connectedDevices()) {
+        if (device.usbBus.toUShort() != finding.bus || device.usbDevNum.toUShort() != finding.device
+            || !device.isKeyboard()) {
+            continue;
+        }
+        const auto baseline = m_badUsbBaselineStore ? m_badUsbBaselineStore->getDevice(device.stableId())
+                                                    : std::nullopt;
+        reportBadUsbAnomaly(device, BadUsbAnalyzer::analyzeKeystrokeRate(device, finding, baseline));
+        return;
+    }
+}
+
+void MainWindow::reportBadUsbAnomaly(const HidDeviceInfo& device, const BadUsbAnomalyResult& anomaly)
+{
     logMessage(QStringLiteral("BadUSB anomaly [%1]: %2")
                    .arg(anomaly.ruleId, anomaly.summary),
                LogLevel::Security);
@@ -147,6 +236,51 @@ void MainWindow::processBadUsbDevice(const HidDeviceInfo& device)
     }
 }
 
+void MainWindow::archiveBadUsbCapture(const QString& path, BadUsbAnomalyResult anomaly)
+{
+    // Summarized even when summaries are off: retention de-duplicates on the content digest.
+    const CaptureRetention::Policy policy = captureRetentionPolicy(m_settings);
+    auto* watcher = new QFutureWatcher<ArchivedCapture>(this);
+    connect(watcher, &QFutureWatcher<ArchivedCapture>::finished, this, [this, watcher, anomaly]() mutable {
+        const ArchivedCapture done = watcher->result();
+        watcher->deleteLater();
+        const CaptureRetention::ArchiveResult& archive = done.archive;
+        if (!archive.error.isEmpty()) {
+            logMessage(QStringLiteral("BadUSB capture retention: %1").arg(archive.error), LogLevel::Warning);
+        }
+        if (!archive.duplicateOf.isEmpty()) {
+            logMessage(QStringLiteral("BadUSB capture repeats %1; not kept").arg(archive.duplicateOf),
+                       LogLevel::Info);
+        }
+        if (m_badUsbWidget) {
+            m_badUsbWidget->setCaptureStatus(QStringLiteral("finished; %1")
+                                                 .arg(AppDiagnostics::badUsbCaptureUsage().text()));
+        }
+        if (!m_settings.badUsbUsbmonSummarize) {
+            return;
+        }
+        const UsbCaptureSummary& summary = done.summary;
+        anomaly.captureSummary = summary.toJson();
+        anomaly.captureSummary.insert(QStringLiteral("archived_path"), archive.path);
+        if (!archive.duplicateOf.isEmpty()) {
+            anomaly.captureSummary.insert(QStringLiteral("duplicate_of"), archive.duplicateOf);
+        }
+        AuditLog::appendBadUsbCaptureSummary(anomaly);
+        logMessage(QStringLiteral("BadUSB capture summary [%1]: %2").arg(anomaly.ruleId, summary.headline()),
+                   summary.isValid() ? LogLevel::Info : LogLevel::Warning);
+        if (m_badUsbWidget) {
+            m_badUsbWidget->addCaptureSummary(anomaly, summary.headline(), summary.text());
+        }
+    });
+    watcher->setFuture(QtConcurrent::run([path, policy]() {
+        ArchivedCapture done;
+        done.summary = UsbCaptureSummary::summarize(path);
+        done.archive = CaptureRetention::archive(AppDiagnostics::badUsbCapturesDir(), path,
+                                                 done.summary.contentDigest, policy);
+        return done;
+    }));
+}
+
 void MainWindow::onBadUsbTrustRequested(const QString& stableId)
 {
     if (!m_hidMonitor || !m_badUsbBaselineStore) {
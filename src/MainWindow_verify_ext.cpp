@@ -2,10 +2,12 @@
 #include "WatchListDialog.h"
 #include "IsoVerifier.h"
 #include "IsoVerifyReport.h"
-#include "IsoVerifySettingsLoader.h"
+#include "IoScheduler.h"
 #include "IsoCatalogManifest.h"
 #include "IsoScanRules.h"
+#include "ManifestService.h"
 #include "SettingsProfiles.h"
+#include "SharedReadPass.h"
 #include "VerifyHistory.h"
 #include <QMessageBox>
 
@@ -48,7 +50,7 @@ void MainWindow::startDeviceVerification(const QString& deviceNode)
 
     if (deviceInfo->mountPoint.isEmpty()) {
         m_pendingHashActions[deviceNode] = PendingHashAction::MountAfterVerify;
-        if (!deviceInfo->isMounted) {
+        if (!deviceInfo->isMounted && !startUnmountedManifestVerification(deviceNode)) {
             m_mountManager->mount(deviceNode);
         }
         return;
@@ -57,6 +59,65 @@ void MainWindow::startDeviceVerification(const QString& deviceNode)
     startManifestVerification(deviceNode);
 }
 
+bool MainWindow::startUnmountedManifestVerification(const QString& deviceNode)
+{
+#ifdef Q_OS_WIN
+    // Windows mounts volumes itself before the app sees them.
+    Q_UNUSED(deviceNode)
+    return false;
+#else
+    // Verify straight from the block device, so a matching stick is mounted once and a
+    // mismatching one never is. Anything the raw reader cannot do fails the job, and
+    // onManifestFailed() falls back to mounting and verifying as before.
+    auto deviceInfo = m_deviceMonitor->getDevice(deviceNode);
+    if (!deviceInfo) {
+        return false;
+    }
+    const QString deviceId = canonicalDeviceId(*deviceInfo);
+    auto record = m_database->getDevice(deviceId);
+    if (!record || !record->watchManifest.hasBaseline()) {
+        return false;
+    }
+    const std::optional<WatchManifest> baseline = m_database->watchManifestFor(*record);
+    if (!baseline) {
+        return false;  // the mounted verify reports the altered manifest file
+    }
+
+    // Hybrid: start the full hash first and let the manifest take file data from its read,
+    // instead of reading the device again after the manifest passes. The hash joins the
+    // disk's lane as background work, which the interactive verify may then share.
+    std::shared_ptr<SharedReadPass> sharedRead;
+    if (record->verificationProfile == VerificationProfile::Hybrid
+        && hashScanModeReadsAll(m_settings.defaultHashScanMode)
+        && resolveHashDeviceNode(*deviceInfo, m_settings.defaultHashScope) == deviceNode
+        && !m_hashJobDevices.values().contains(deviceNode)) {
+        sharedRead = std::make_shared<SharedReadPass>();
+        m_sharedReadPasses[deviceNode] = sharedRead;
+        promptAndStartHash(deviceNode, false);
+        if (m_sharedReadPasses.remove(deviceNode) > 0) {
+            sharedRead.reset();  // no full hash started
+        } else {
+            m_sharedReadHybrids.insert(deviceNode);
+            // As after a sequential hybrid pass: the hash's verdict decides the mount.
+            m_pendingHashActions[deviceNode] = PendingHashAction::RunFullHashAfterManifest;
+        }
+    }
+
+    if (DeviceCard* card = getDeviceCard(deviceNode)) {
+        card->setVerificationStatus(VerificationStatus::Hashing);
+        card->setProgressVisible(true);
+        card->setHashProgress(0);
+    }
+    stopSpeculativePrefetch(deviceNode);
+    const QString jobId = m_manifestWorker->startVerifyUnmounted(
+        deviceNode, deviceId, *baseline, m_settings.manifestVerifyPolicy(record->verificationProfile),
+        std::move(sharedRead));
+    m_manifestJobDevices[jobId] = deviceNode;
+    m_unmountedManifestJobs.insert(jobId);
+    return true;
+#endif
+}
+
 void MainWindow::startManifestVerification(const QString& deviceNode)
 {
     auto deviceInfo = m_deviceMonitor->getDevice(deviceNode);
@@ -76,6 +137,16 @@ void MainWindow::startManifestVerification(const QString& deviceNode)
         openWatchListDialog(deviceNode);
         return;
     }
+    const std::optional<WatchManifest> baseline = m_database->watchManifestFor(*record);
+    if (!baseline) {
+        logMessage(QStringLiteral("Watch manifest file for %1 is missing or altered; rebuild the baseline")
+                       .arg(deviceInfo->displayName()),
+                   LogLevel::Security);
+        if (DeviceCard* card = getDeviceCard(deviceNode)) {
+            card->setVerificationStatus(VerificationStatus::Error);
+        }
+        return;
+    }
 
     DeviceCard* card = getDeviceCard(deviceNode);
     if (card) {
@@ -84,9 +155,51 @@ void MainWindow::startManifestVerification(const QString& deviceNode)
         card->setHashProgress(0);
     }
 
+    std::optional<QSet<QString>> touchedPaths;
+    const bool journaled = m_settings.watchChangeJournal && WatchJournal::isSupported();
+    if (journaled) {
+        if (m_journaledMounts.value(deviceNode) != deviceInfo->mountPoint) {
+            QStringList watchPaths;
+            for (const WatchGroup& group : baseline->groups) {
+                watchPaths += group.watchPaths;
+            }
+            m_watchJournal->watch(deviceInfo->mountPoint, watchPaths);
+            m_journaledMounts[deviceNode] = deviceInfo->mountPoint;
+        }
+        WatchJournal::Snapshot snapshot = m_watchJournal->begin(deviceInfo->mountPoint);
+        if (snapshot.usable) {
+            logMessage(QStringLiteral("Change journal: %1 path(s) touched on %2 since the last verify")
+                           .arg(snapshot.touchedPaths.size())
+                           .arg(deviceInfo->displayName()));
+            touchedPaths = std::move(snapshot.touchedPaths);
+        }
+    }
+
+    stopSpeculativePrefetch(deviceNode);
     const QString jobId = m_manifestWorker->startVerify(
-        deviceNode, deviceInfo->mountPoint, deviceId, record->watchManifest);
+        deviceNode, deviceInfo->mountPoint, deviceId, *baseline,
+        m_settings.manifestVerifyPolicy(record->verificationProfile), std::move(touchedPaths));
     m_manifestJobDevices[jobId] = deviceNode;
+    if (journaled) {
+        m_manifestJournalJobs[jobId] = deviceInfo->mountPoint;
+    }
+}
+
+void MainWindow::stopWatchJournal(const QString& deviceNode)
+{
+    const QString mountPoint = m_journaledMounts.take(deviceNode);
+    if (!mountPoint.isEmpty()) {
+        m_watchJournal->unwatch(mountPoint);
+    }
+}
+
+void MainWindow::cancelManifestJobs(const QString& deviceNode)
+{
+    // The mount is gone or going; a walk or read on it would only fail slowly.
+    const QStringList jobIds = m_manifestJobDevices.keys(deviceNode);
+    for (const QString& jobId : jobIds) {
+        m_manifestWorker->cancelJob(jobId);
+    }
 }
 
 void MainWindow::openWatchListDialog(const QString& deviceNode)
@@ -105,7 +218,8 @@ void MainWindow::openWatchListDialog(const QString& deviceNode)
     const QString deviceId = canonicalDeviceId(*deviceInfo);
     WatchManifest manifest;
     if (auto record = m_database->getDevice(deviceId)) {
-        manifest = record->watchManifest;
+        // Without its file list the dialog can still edit groups; a rebuild replaces it.
+        manifest = m_database->watchManifestFor(*record).value_or(record->watchManifest);
     }
 
     WatchListDialog dialog(deviceInfo->mountPoint, deviceInfo->displayName(), manifest, this);
@@ -115,8 +229,14 @@ void MainWindow::openWatchListDialog(const QString& deviceNode)
                 if (!info) {
                     return;
                 }
+                WatchManifest build = spec;
+                for (WatchGroup& group : build.groups) {
+                    group.chunkThresholdBytes = m_settings.watchChunkLargeFiles
+                                                    ? ManifestService::kDefaultChunkThresholdBytes
+                                                    : 0;
+                }
                 const QString jobId = m_manifestWorker->startBuildBaseline(
-                    deviceNode, info->mountPoint, deviceId, spec);
+                    deviceNode, info->mountPoint, deviceId, build);
                 m_manifestJobDevices[jobId] = deviceNode;
             });
 
@@ -150,6 +270,12 @@ void MainWindow::onManifestStarted(const QString& jobId, const QString& deviceNo
 void MainWindow::onManifestCompleted(const QString& jobId, const ManifestVerifyResult& result)
 {
     m_manifestJobDevices.remove(jobId);
+    const bool unmounted = m_unmountedManifestJobs.remove(jobId);
+    const bool hashedAlongside = m_sharedReadHybrids.remove(result.deviceNode);
+    if (m_manifestJournalJobs.contains(jobId)) {
+        // Only a matching verify is a point later journal snapshots may build on.
+        m_watchJournal->finish(m_manifestJournalJobs.take(jobId), result.matches);
+    }
     auto deviceInfo = m_deviceMonitor->getDevice(result.deviceNode);
     if (!deviceInfo) {
         return;
@@ -160,8 +286,22 @@ void MainWindow::onManifestCompleted(const QString& jobId, const ManifestVerifyR
         card->setProgressVisible(false);
     }
 
+    recordVerifyStage(result.deviceNode, VerifyStage::Metadata,
+                      result.matches ? StageOutcome::Pass : StageOutcome::Fail,
+                      result.matches ? QString()
+                                     : QStringLiteral("%1 changed, %2 missing, %3 added")
+                                           .arg(result.changedPaths.size())
+                                           .arg(result.missingPaths.size())
+                                           .arg(result.addedPaths.size()));
     if (result.matches) {
-        logMessage(QStringLiteral("Watch manifest verified: %1").arg(deviceInfo->displayName()));
+        if (result.filesHashed < result.filesChecked) {
+            logMessage(QStringLiteral("Watch manifest verified: %1 (%2 of %3 files re-hashed, rest unchanged)")
+                           .arg(deviceInfo->displayName())
+                           .arg(result.filesHashed)
+                           .arg(result.filesChecked));
+        } else {
+            logMessage(QStringLiteral("Watch manifest verified: %1").arg(deviceInfo->displayName()));
+        }
         {
             VerifyHistoryEntry he;
             he.deviceNode = result.deviceNode;
@@ -179,7 +319,9 @@ void MainWindow::onManifestCompleted(const QString& jobId, const ManifestVerifyR
         m_trayIcon->notifyVerificationResult(deviceInfo->displayName(), VerificationStatus::Verified);
 
         const QString deviceId = canonicalDeviceId(*deviceInfo);
-        if (auto record = m_database->getDevice(deviceId)) {
+        if (hashedAlongside) {
+            // The full hash read the device together with this verify; it reports on its own.
+        } else if (auto record = m_database->getDevice(deviceId)) {
             if (record->verificationProfile == VerificationProfile::Hybrid) {
                 m_pendingHashActions[result.deviceNode] = PendingHashAction::RunFullHashAfterManifest;
                 startHashing(result.deviceNode);
@@ -191,6 +333,10 @@ void MainWindow::onManifestCompleted(const QString& jobId, const ManifestVerifyR
             m_mountManager->mount(result.deviceNode);
         }
     } else {
+        if (unmounted) {
+            // Not mounted, and a mount now would only verify the same mismatch again.
+            m_pendingHashActions.remove(result.deviceNode);
+        }
         m_lastManifestResults[result.deviceNode] = result;
         {
             VerifyHistoryEntry he;
@@ -213,6 +359,9 @@ void MainWindow::onManifestBaselineBuilt(const QString& jobId, const QString& de
 {
     const QString deviceNode = m_manifestJobDevices.take(jobId);
     m_database->updateWatchManifest(deviceId, manifest);
+    captureLayoutBaseline(deviceNode, deviceId);
+    // Watch paths may have changed; the verify below re-arms the journal from scratch.
+    stopWatchJournal(deviceNode);
 
     DeviceCard* card = getDeviceCard(deviceNode);
     if (card) {
@@ -229,6 +378,16 @@ void MainWindow::onManifestBaselineBuilt(const QString& jobId, const QString& de
 void MainWindow::onManifestFailed(const QString& jobId, const QString& error)
 {
     const QString deviceNode = m_manifestJobDevices.take(jobId);
+    if (m_manifestJournalJobs.contains(jobId)) {
+        m_watchJournal->finish(m_manifestJournalJobs.take(jobId), false);
+    }
+    if (m_unmountedManifestJobs.remove(jobId) && !deviceNode.isEmpty()) {
+        // MountAfterVerify is still pending: the mount runs the usual verify.
+        logMessage(QStringLiteral("Pre-mount verify unavailable for %1 (%2); mounting to verify")
+                       .arg(deviceNode, error));
+        m_mountManager->mount(deviceNode);
+        return;
+    }
     logMessage(QStringLiteral("Manifest verify failed: %1").arg(error), LogLevel::Error);
     DeviceCard* card = getDeviceCard(deviceNode);
     if (card) {
@@ -237,10 +396,60 @@ void MainWindow::onManifestFailed(const QString& jobId, const QString& error)
     }
 }
 
+void MainWindow::onManifestCancelled(const QString& jobId)
+{
+    const QString deviceNode = m_manifestJobDevices.take(jobId);
+    m_unmountedManifestJobs.remove(jobId);
+    m_sharedReadHybrids.remove(deviceNode);
+    if (m_manifestJournalJobs.contains(jobId)) {
+        m_watchJournal->finish(m_manifestJournalJobs.take(jobId), false);
+    }
+    if (deviceNode.isEmpty()) {
+        return;
+    }
+    logMessage(QStringLiteral("Manifest job cancelled for %1").arg(deviceNode));
+    if (DeviceCard* card = getDeviceCard(deviceNode)) {
+        card->setProgressVisible(false);
+        card->setVerificationStatus(VerificationStatus::Pending);
+    }
+}
+
+void MainWindow::onManifestReportReady(const QString& jobId, const ManifestVerifyResult& result)
+{
+    Q_UNUSED(jobId)
+    auto deviceInfo = m_deviceMonitor->getDevice(result.deviceNode);
+    if (!deviceInfo) {
+        return;
+    }
+    logMessage(QStringLiteral("Watch manifest report for %1: %2 changed, %3 missing, %4 added (%5 files)")
+                   .arg(deviceInfo->displayName())
+                   .arg(result.changedPaths.size())
+                   .arg(result.missingPaths.size())
+                   .arg(result.addedPaths.size())
+                   .arg(result.filesChecked),
+               LogLevel::Security);
+    for (const QString& p : result.changedPaths) {
+        logMessage(QStringLiteral("  changed: %1").arg(p), LogLevel::Security);
+    }
+    for (const QString& p : result.missingPaths) {
+        logMessage(QStringLiteral("  missing: %1").arg(p), LogLevel::Security);
+    }
+    for (const QString& p : result.addedPaths) {
+        logMessage(QStringLiteral("  added: %1").arg(p), LogLevel::Security);
+    }
+    for (const QString& r : result.changedRanges) {
+        logMessage(QStringLiteral("  changed bytes: %1").arg(r), LogLevel::Security);
+    }
+    m_lastVerificationHashes[result.deviceNode] = result.computedRootHex;
+}
+
 void MainWindow::handleManifestMismatch(const DeviceInfo& device, const ManifestVerifyResult& result)
 {
     logMessage(QStringLiteral("Watch manifest mismatch: %1").arg(device.displayName()),
                LogLevel::Security);
+    for (const QString& r : result.changedRanges) {
+        logMessage(QStringLiteral("  changed bytes: %1").arg(r), LogLevel::Security);
+    }
 
     DeviceCard* card = getDeviceCard(device.deviceNode);
     if (card) {
@@ -251,6 +460,12 @@ void MainWindow::handleManifestMismatch(const DeviceInfo& device, const Manifest
     if (detail.isEmpty()) {
         detail = result.addedPaths.join(QStringLiteral(", "));
     }
+    if (detail.isEmpty()) {
+        detail = result.missingPaths.join(QStringLiteral(", "));
+    }
+    if (!result.complete) {
+        detail += QStringLiteral(" (stopped at the first difference)");
+    }
     m_lastVerificationHashes[device.deviceNode] = result.computedRootHex;
 
     if (m_settings.requireConfirmationForModified) {
@@ -278,43 +493,44 @@ void MainWindow::acceptManifestBaseline(const DeviceInfo& device, const WatchMan
 {
     const QString deviceId = canonicalDeviceId(device);
     m_database->updateWatchManifest(deviceId, manifest);
+    captureLayoutBaseline(device.deviceNode, deviceId);
     DeviceCard* card = getDeviceCard(device.deviceNode);
     if (card) {
         card->setVerificationStatus(VerificationStatus::Verified);
     }
 }
 
-void MainWindow::applyIsoVerifyOptions()
-{
-    IsoVerifyOptions opt = IsoVerifySettingsLoader::load();
-    opt.maxParallel = qMax(1, m_settings.isoVerifyParallel);
-    opt.verifyDecompressed = m_settings.isoVerifyDecompressed;
-    opt.preferOfflineSidecars = m_settings.isoPreferOfflineSidecars;
-    IsoVerifier::setVerifyOptions(opt);
-}
-
-void MainWindow::maybeTriggerIsoVerifyForMountedDevice(const DeviceInfo& device)
+AsyncTask<> MainWindow::maybeTriggerIsoVerifyForMountedDevice(DeviceInfo device)
 {
     if (!m_isoWidget || device.mountPoint.isEmpty() || !device.isMounted) {
-        return;
+        co_return;
     }
     if (!m_settings.isoAutoVerifyOnUsbMount && m_settings.appModule != AppModule::IsoVerifier) {
-        return;
+        co_return;
     }
     if (m_isoVerifyTriggeredMounts.contains(device.mountPoint)) {
-        return;
+        co_return;
     }
 
-    const IsoVerifier::MountScanResult scan = IsoVerifier::scanMountPoint(device.mountPoint);
+    // A large stick takes a while to walk; the window keeps painting meanwhile.
+    const IoScheduler::Task task{IoScheduler::wholeDiskNode(device.deviceNode), IoScheduler::Priority::Interactive};
+    const QString mountPoint = device.mountPoint;
+    const std::optional<IsoVerifier::MountScanResult> scan = co_await resumeOn(
+        this, IoScheduler::instance().run(task, [mountPoint]() { return IsoVerifier::scanMountPoint(mountPoint); }));
+    // The stick may have gone, or another mount event started its verify, while this one walked.
+    if (!scan || !m_deviceMonitor->getDevice(device.deviceNode)
+        || m_isoVerifyTriggeredMounts.contains(device.mountPoint)) {
+        co_return;
+    }
     if (IsoScanRules::shouldSkipAutoVerifyPartition(device.mountPoint, device.sizeBytes,
-                                                    scan.isoPaths.size())) {
-        if (!scan.layoutNote.isEmpty()) {
-            logMessage(scan.layoutNote, LogLevel::Info);
+                                                    scan->isoPaths.size())) {
+        if (!scan->layoutNote.isEmpty()) {
+            logMessage(scan->layoutNote, LogLevel::Info);
         }
-        return;
+        co_return;
     }
-    if (scan.isoPaths.isEmpty() && !scan.looksLikeDdIsoStick) {
-        return;
+    if (scan->isoPaths.isEmpty() && !scan->looksLikeDdIsoStick) {
+        co_return;
     }
 
     MountManager::MountResult synthetic;
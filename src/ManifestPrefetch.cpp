@@ -0,0 +1,71 @@
+#include "ManifestPrefetch.h"
+#include "FileReadAhead.h"
+
+#include <QDir>
+#include <QSet>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace FlashSpartan::ManifestPrefetch {
+
+namespace {
+
+/** (recorded size, relative path) of the planned files, smallest first. */
+std::vector<std::pair<uint64_t, QString>> pick(const WatchManifest& manifest, qint64 budgetBytes)
+{
+    std::vector<std::pair<uint64_t, QString>> files;
+    QSet<QString> seen;
+    for (const WatchGroup& group : manifest.groups) {
+        for (const WatchFileEntry& entry : group.files) {
+            if (entry.sizeBytes > 0 && !seen.contains(entry.relativePath)) {
+                seen.insert(entry.relativePath);
+                files.emplace_back(entry.sizeBytes, entry.relativePath);
+            }
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    uint64_t total = 0;
+    size_t fit = 0;
+    while (fit < files.size() && budgetBytes > 0
+           && total + files[fit].first <= static_cast<uint64_t>(budgetBytes)) {
+        total += files[fit].first;
+        ++fit;
+    }
+    files.resize(fit);
+    return files;
+}
+
+} // namespace
+
+QStringList plan(const WatchManifest& manifest, qint64 budgetBytes)
+{
+    QStringList planned;
+    for (const auto& [size, path] : pick(manifest, budgetBytes)) {
+        planned.append(path);
+    }
+    return planned;
+}
+
+Result run(const QString& mountPoint, const WatchManifest& manifest, qint64 budgetBytes,
+           const std::atomic<bool>* cancelled)
+{
+    Result result;
+    const QDir mount(mountPoint);
+    for (const auto& [size, relativePath] : pick(manifest, budgetBytes)) {
+        if (cancelled && cancelled->load()) {
+            result.cancelled = true;
+            break;
+        }
+        // The recorded size: a file that has since grown is only warmed that far.
+        if (FileReadAhead::prefetch(mount.filePath(relativePath), static_cast<qint64>(size))) {
+            ++result.files;
+            result.bytes += static_cast<qint64>(size);
+        }
+    }
+    return result;
+}
+
+} // namespace FlashSpartan::ManifestPrefetch
@@ -1,18 +1,84 @@
 #include "ManifestService.h"
+#include "ContentChunker.h"
+#include "DigestContextPool.h"
+#include "DirectoryListing.h"
+#include "FileExtents.h"
+#include "FileReadAhead.h"
+#include "HashPipeline.h"
+#include "HexEncoding.h"
+#include "IoBufferPool.h"
 #include "MerkleTree.h"
+#include "PerfTrace.h"
+#include "RawFsReader.h"
 
 #include <openssl/evp.h>
 
 #include <QDir>
-#include <QDirIterator>
 #include <QFile>
 #include <QFileInfo>
 #include <QElapsedTimer>
+#include <QMap>
+#include <QMutex>
+#include <QRandomGenerator>
+#include <QTimeZone>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#ifndef Q_OS_WIN
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
 
 namespace FlashSpartan {
 
 namespace {
 
+constexpr qint64 kReadBufferBytes = 1024 * 1024;
+/** WatchManifest::version of rebuilt manifests; "1.0" ones keep a V1 manifest root. */
+constexpr QLatin1String kManifestVersion("2.0");
+/** Manifest root over the group roots of a kManifestVersion manifest. */
+constexpr MerkleShape kManifestRootShape{MerkleFormat::V2, 4};
+constexpr size_t kMaxHashThreads = 8;
+// Hash threads shared by all mounts of one verifyManifestBatch() (at least one per mount).
+constexpr size_t kMaxBatchHashThreads = 16;
+// Files below this are grouped into micro-batches of up to kMicroBatchFiles / kMicroBatchBytes.
+constexpr qint64 kSmallFileBytes = 256 * 1024;
+constexpr qsizetype kMicroBatchFiles = 64;
+constexpr qint64 kMicroBatchBytes = 8 * 1024 * 1024;
+// Files from this size on overlap reads with hashing through the raw-device read pipeline.
+constexpr qint64 kLargeFileBytes = 64 * 1024 * 1024;
+constexpr int kLargeFilePipelineDepth = 3;
+constexpr size_t kLargeFileBufferBytes = 4 * 1024 * 1024;
+// Files modified this recently count as recently changed for hash ordering.
+constexpr qint64 kRecentChangeSecs = 7 * 24 * 3600;
+
+using Progress = ManifestService::Progress;
+/** Baseline entries of one group by relative path, decoded once from the group's file list. */
+using RecordedEntries = QHash<QString, WatchFileEntry>;
+
+const WatchFileEntry* recordedEntry(const RecordedEntries& recorded, const QString& relativePath)
+{
+    const auto it = recorded.constFind(relativePath);
+    return it != recorded.cend() ? &it.value() : nullptr;
+}
+
+QString cancelledMessage()
+{
+    return QStringLiteral("Cancelled");
+}
+
+bool isCancelled(const Progress* progress)
+{
+    return progress && progress->cancelled.load(std::memory_order_relaxed);
+}
+
 QString normalizeMount(const QString& mountPoint)
 {
     QString m = QDir::fromNativeSeparators(mountPoint);
@@ -42,11 +108,287 @@ QString relativePathUnder(const QString& mountPoint, const QString& absolutePath
     return {};
 }
 
-QStringList collectFilesForPaths(const QString& mountPoint, const QStringList& paths, QString* errorOut)
+struct FileStat {
+    bool exists = false;
+    uint64_t size = 0;
+    QDateTime modifiedUtc;
+    QDateTime changedUtc;
+    uint64_t inode = 0;
+};
+
+#ifdef Q_OS_WIN
+FileStat fromListing(const DirectoryListing::Entry& entry)
+{
+    FileStat st;
+    st.exists = true;
+    st.size = entry.size;
+    st.modifiedUtc = QDateTime::fromMSecsSinceEpoch(entry.modifiedMs, QTimeZone::utc());
+    // Windows has no separate change time for QFileInfo::metadataChangeTime() to report
+    // either; statFile() gets the write time there too.
+    st.changedUtc = st.modifiedUtc;
+    st.inode = entry.fileId;
+    return st;
+}
+#else
+FileStat fromStat(const struct stat& sb)
+{
+    auto toUtc = [](const timespec& ts) {
+        return QDateTime::fromMSecsSinceEpoch(
+            static_cast<qint64>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000, QTimeZone::utc());
+    };
+    FileStat st;
+    st.exists = true;
+    st.size = static_cast<uint64_t>(sb.st_size);
+    st.modifiedUtc = toUtc(sb.st_mtim);
+    st.changedUtc = toUtc(sb.st_ctim);
+    st.inode = static_cast<uint64_t>(sb.st_ino);
+    return st;
+}
+#endif
+
+FileStat statFile(const QString& absolutePath)
+{
+    FileStat st;
+#ifdef Q_OS_WIN
+    const QFileInfo fi(absolutePath);
+    if (!fi.exists()) {
+        return st;
+    }
+    st.exists = true;
+    st.size = static_cast<uint64_t>(fi.size());
+    st.modifiedUtc = fi.lastModified().toUTC();
+    st.changedUtc = fi.metadataChangeTime().toUTC();
+#else
+    struct stat sb {};
+    if (::stat(QFile::encodeName(absolutePath).constData(), &sb) != 0) {
+        return st;
+    }
+    st = fromStat(sb);
+#endif
+    return st;
+}
+
+bool isUnder(const QString& path, const QString& dir)
+{
+    return dir.endsWith(QLatin1Char('/')) ? path.startsWith(dir)
+                                          : path.startsWith(dir + QLatin1Char('/'));
+}
+
+/**
+ * Whether files on @p canonicalMount are hashed one at a time in disk order (see
+ * FileExtents). FLASHSPARTAN_EXTENT_ORDER=1 or 0 forces it either way.
+ */
+bool useDiskOrder(const QString& canonicalMount)
+{
+    bool forced = false;
+    const int value = qEnvironmentVariableIntValue("FLASHSPARTAN_EXTENT_ORDER", &forced);
+    return forced ? value != 0 : FileExtents::seekSensitive(canonicalMount);
+}
+
+QString joinPath(const QString& dir, const QString& name)
+{
+    return dir.endsWith(QLatin1Char('/')) ? dir + name : dir + QLatin1Char('/') + name;
+}
+
+/**
+ * Tree walks, stat data and content hashes for one mount, shared by every group of a
+ * build or verify. A directory is walked once however many watch paths cover it, and a
+ * file in several groups is hashed once. Lives only as long as the one operation.
+ */
+class MountIndex {
+public:
+    explicit MountIndex(const QString& mountPoint, Progress* progress = nullptr)
+        : m_mountPoint(mountPoint)
+        , m_canonicalMount(QFileInfo(normalizeMount(mountPoint)).canonicalFilePath())
+        , m_progress(progress)
+        , m_diskOrder(useDiskOrder(m_canonicalMount))
+    {
+    }
+
+    const QString& mountPoint() const { return m_mountPoint; }
+    const QString& canonicalMount() const { return m_canonicalMount; }
+    Progress* progress() const { return m_progress; }
+    bool cancelled() const { return isCancelled(m_progress); }
+    /** Hash workers for this mount; a batch splits the thread budget across its mounts. */
+    size_t maxHashThreads() const { return m_maxHashThreads; }
+    void setMaxHashThreads(size_t threads) { m_maxHashThreads = std::max<size_t>(1, threads); }
+    /** Files are read by one worker in the order they sit on the device; see useDiskOrder(). */
+    bool diskOrder() const { return m_diskOrder; }
+
+    /**
+     * Canonical paths of the files below @p canonicalDir, as QDirIterator(QDir::Files,
+     * Subdirectories) lists them: no hidden entries, symlinked files resolved, symlinked
+     * directories not followed.
+     */
+    QStringList filesUnder(const QString& canonicalDir, QString* errorOut)
+    {
+        const Tree* tree = nullptr;
+        for (auto it = m_trees.cbegin(); it != m_trees.cend(); ++it) {
+            if (it.key() == canonicalDir
+                || (isUnder(canonicalDir, it.key())
+                    && !hasHiddenComponent(canonicalDir.mid(it.key().size() + 1)))) {
+                tree = &it.value();
+                break;
+            }
+        }
+        if (!tree) {
+            tree = &m_trees.insert(canonicalDir, walk(canonicalDir)).value();
+        }
+
+        const bool whole = m_trees.contains(canonicalDir);
+        QStringList files;
+        files.reserve(tree->entries.size());
+        for (const Entry& e : tree->entries) {
+            if (!whole && !isUnder(e.listed, canonicalDir)) {
+                continue;
+            }
+            if (e.canonical.isEmpty()) {
+                if (errorOut) {
+                    *errorOut = QStringLiteral("Watched file escapes mount point: %1").arg(e.listed);
+                }
+                return {};
+            }
+            files.append(e.canonical);
+        }
+        return files;
+    }
+
+    /** Stat from the walk when it saw the file, otherwise a fresh one (then kept). */
+    FileStat stat(const QString& canonicalPath) const
+    {
+        auto it = m_stats.constFind(canonicalPath);
+        if (it == m_stats.cend()) {
+            it = m_stats.insert(canonicalPath, statFile(canonicalPath));
+        }
+        return it.value();
+    }
+
+    QHash<QString, QString>& contentHashes() { return m_hashes; }
+    /** Chunk lists of files hashed in chunked mode during this operation. */
+    QHash<QString, QList<WatchChunk>>& chunkLists() { return m_chunks; }
+    const QHash<QString, QList<WatchChunk>>& chunkLists() const { return m_chunks; }
+
+private:
+    struct Entry {
+        QString listed;     // path as found in the tree
+        QString canonical;  // empty: a symlink leaving the mount
+    };
+    struct Tree {
+        QVector<Entry> entries;
+    };
+
+    static bool hasHiddenComponent(const QString& relative)
+    {
+        for (const QStringView part : QStringView(relative).split(QLatin1Char('/'))) {
+            if (part.startsWith(QLatin1Char('.'))) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void addSymlink(Tree& tree, const QString& path)
+    {
+        const QFileInfo info(path);
+        if (!info.isFile()) {
+            return;
+        }
+        const QString canonical = info.canonicalFilePath();
+        if (canonical.isEmpty() || !isWithinMount(m_canonicalMount, canonical)) {
+            tree.entries.append(Entry{path, QString()});
+            return;
+        }
+        tree.entries.append(Entry{path, canonical});
+    }
+
+    Tree walk(const QString& canonicalDir)
+    {
+        Tree tree;
+#ifdef Q_OS_WIN
+        // One listing call per directory brings size, write time and file ID along, so a
+        // plain file costs neither a stat nor a canonicalization; only links are resolved.
+        QStringList pending{canonicalDir};
+        QVector<DirectoryListing::Entry> listing;
+        while (!pending.isEmpty() && !cancelled()) {
+            const QString dir = pending.takeLast();
+            listing.clear();
+            if (!DirectoryListing::list(dir, &listing)) {
+                continue;
+            }
+            for (const DirectoryListing::Entry& entry : listing) {
+                if (entry.hidden) {
+                    continue;  // like QDir without QDir::Hidden
+                }
+                const QString path = joinPath(dir, entry.name);
+                if (entry.kind == DirectoryListing::Entry::Kind::Directory) {
+                    pending.append(path);
+                } else if (entry.kind == DirectoryListing::Entry::Kind::File) {
+                    tree.entries.append(Entry{path, path});
+                    m_stats.insert(path, fromListing(entry));
+                } else if (entry.kind == DirectoryListing::Entry::Kind::Link) {
+                    addSymlink(tree, path);
+                }
+            }
+        }
+#else
+        // readdir() hands out glibc's getdents64 batches; d_type avoids a stat for
+        // directories, and regular files get one fstatat() relative to the open directory.
+        QStringList pending{canonicalDir};
+        while (!pending.isEmpty() && !cancelled()) {
+            const QString dir = pending.takeLast();
+            DIR* handle = ::opendir(QFile::encodeName(dir).constData());
+            if (!handle) {
+                continue;
+            }
+            const int dirFd = ::dirfd(handle);
+            while (const dirent* entry = ::readdir(handle)) {
+                if (entry->d_name[0] == '.') {
+                    continue;  // ".", ".." and hidden entries, like QDir without QDir::Hidden
+                }
+                const QString path = joinPath(dir, QFile::decodeName(entry->d_name));
+                struct stat sb {};
+                unsigned char type = entry->d_type;
+                if (type == DT_UNKNOWN || type == DT_REG) {
+                    if (::fstatat(dirFd, entry->d_name, &sb, AT_SYMLINK_NOFOLLOW) != 0) {
+                        continue;
+                    }
+                    type = S_ISDIR(sb.st_mode) ? DT_DIR
+                           : S_ISREG(sb.st_mode) ? DT_REG
+                           : S_ISLNK(sb.st_mode) ? DT_LNK
+                                                 : DT_UNKNOWN;
+                }
+                if (type == DT_DIR) {
+                    pending.append(path);
+                } else if (type == DT_REG) {
+                    tree.entries.append(Entry{path, path});
+                    m_stats.insert(path, fromStat(sb));
+                } else if (type == DT_LNK) {
+                    addSymlink(tree, path);
+                }
+            }
+            ::closedir(handle);
+        }
+#endif
+        return tree;
+    }
+
+    QString m_mountPoint;
+    QString m_canonicalMount;
+    QHash<QString, Tree> m_trees;  // by canonical directory walked
+    mutable QHash<QString, FileStat> m_stats;
+    QHash<QString, QString> m_hashes;
+    QHash<QString, QList<WatchChunk>> m_chunks;
+    Progress* m_progress = nullptr;
+    bool m_diskOrder = false;
+    size_t m_maxHashThreads = kMaxHashThreads;
+};
+
+QStringList collectFilesForPaths(MountIndex& index, const QStringList& paths, QString* errorOut)
 {
+    FLASHSPARTAN_TRACE_SPAN("manifest", "walk");
     QStringList files;
-    const QString normalizedMount = normalizeMount(mountPoint);
-    const QString mount = QFileInfo(normalizedMount).canonicalFilePath();
+    const QString& mountPoint = index.mountPoint();
+    const QString& mount = index.canonicalMount();
     if (mount.isEmpty()) {
         if (errorOut) {
             *errorOut = QStringLiteral("Mount point does not exist: %1").arg(mountPoint);
@@ -96,18 +438,15 @@ QStringList collectFilesForPaths(const QString& mountPoint, const QStringList& p
             continue;
         }
         if (info.isDir()) {
-            QDirIterator it(canonical, QDir::Files, QDirIterator::Subdirectories);
-            while (it.hasNext()) {
-                const QString filePath = it.next();
-                const QString fileCanonical = QFileInfo(filePath).canonicalFilePath();
-                if (fileCanonical.isEmpty() || !isWithinMount(mount, fileCanonical)) {
-                    if (errorOut) {
-                        *errorOut = QStringLiteral("Watched file escapes mount point: %1").arg(filePath);
-                    }
-                    return {};
+            QString err;
+            const QStringList found = index.filesUnder(canonical, &err);
+            if (!err.isEmpty()) {
+                if (errorOut) {
+                    *errorOut = err;
                 }
-                files.append(fileCanonical);
+                return {};
             }
+            files += found;
         }
     }
 
@@ -116,35 +455,370 @@ QStringList collectFilesForPaths(const QString& mountPoint, const QStringList& p
     return files;
 }
 
-WatchGroup finalizeGroup(const QString& mountPoint, const QString& groupId, const QString& name,
-                         const QStringList& watchPaths, const QVector<MerkleTree::Leaf>& leaves)
+/** Baseline metadata still describes the file, so its recorded content hash can stand. */
+bool metadataUnchanged(const WatchFileEntry& baseline, const FileStat& now)
+{
+    return baseline.hasMetadata() && now.exists && baseline.sizeBytes == now.size
+        && baseline.modifiedUtc == now.modifiedUtc
+        && (!baseline.changedUtc.isValid() || baseline.changedUtc == now.changedUtc)
+        && (baseline.inode == 0 || baseline.inode == now.inode);
+}
+
+/** @p relativePath, or a directory above it, is in the change journal's touched set. */
+bool journalTouched(const QSet<QString>& touched, const QString& relativePath)
+{
+    QString path = relativePath;
+    for (;;) {
+        if (touched.contains(path)) {
+            return true;
+        }
+        const int slash = path.lastIndexOf(QLatin1Char('/'));
+        if (slash < 0) {
+            return touched.contains(QString());
+        }
+        path.truncate(slash);
+    }
+}
+
+/** Whether any touched path lies in, above or below one of @p watchPaths. */
+bool journalTouchesGroup(const QString& mount, const QStringList& watchPaths,
+                         const QSet<QString>& touched)
+{
+    if (touched.isEmpty()) {
+        return false;
+    }
+    const QDir root(mount);
+    for (const QString& path : watchPaths) {
+        const QString trimmed = path.trimmed();
+        if (trimmed.isEmpty()) {
+            continue;
+        }
+        const QString canonical =
+            QFileInfo(QDir::isAbsolutePath(trimmed) ? trimmed : root.absoluteFilePath(trimmed))
+                .canonicalFilePath();
+        if (mount.isEmpty() || canonical.isEmpty()) {
+            return true;
+        }
+        const QString watched = canonical == mount ? QString() : root.relativeFilePath(canonical);
+        for (const QString& t : touched) {
+            if (t.isEmpty() || watched.isEmpty() || t == watched
+                || t.startsWith(watched + QLatin1Char('/')) || watched.startsWith(t + QLatin1Char('/'))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Byte ranges of @p current whose chunks are not in @p baseline, merged when adjacent.
+ * Nothing when either side has no chunk list.
+ */
+void appendChangedRanges(const WatchFileEntry& baseline, const WatchFileEntry& current, QStringList& out)
+{
+    if (baseline.chunks.isEmpty() || current.chunks.isEmpty()) {
+        return;
+    }
+    QSet<QString> known;
+    for (const WatchChunk& c : baseline.chunks) {
+        known.insert(c.hash);
+    }
+    uint64_t start = 0;
+    uint64_t end = 0;  // exclusive; start == end: no open range
+    auto flush = [&]() {
+        if (end > start) {
+            out.append(QStringLiteral("%1: %2-%3").arg(current.relativePath).arg(start).arg(end - 1));
+        }
+        start = end = 0;
+    };
+    for (const WatchChunk& c : current.chunks) {
+        if (known.contains(c.hash)) {
+            flush();
+            continue;
+        }
+        if (end == start || c.offset != end) {
+            flush();
+            start = c.offset;
+        }
+        end = c.offset + c.length;
+    }
+    flush();
+}
+
+RecordedEntries recordedEntries(const WatchGroup& baseline)
+{
+    RecordedEntries recorded;
+    recorded.reserve(baseline.files.size());
+    for (const WatchFileEntry& e : baseline.files) {
+        recorded.insert(e.relativePath, e);
+    }
+    return recorded;
+}
+
+/** Indices of @p files in path order: the identity unless the list was stored unsorted. */
+std::vector<qsizetype> pathOrder(const WatchFileList& files)
+{
+    std::vector<qsizetype> order(static_cast<size_t>(files.size()));
+    std::iota(order.begin(), order.end(), qsizetype(0));
+    if (!files.isSortedByPath()) {
+        std::sort(order.begin(), order.end(),
+                  [&](qsizetype a, qsizetype b) { return files.comparePath(a, files, b) < 0; });
+    }
+    return order;
+}
+
+/**
+ * Diffs @p current against @p baseline with one merge over both path-ordered file lists,
+ * comparing raw content digests, straight into the path lists of @p result.
+ */
+void compareGroups(const WatchGroup& baseline, const WatchGroup& current, ManifestService::VerifyResult& result)
+{
+    result.computedRootHex = current.merkleRoot;
+    result.expectedRootHex = baseline.merkleRoot;
+    result.filesChecked = static_cast<uint64_t>(current.files.size());
+
+    const std::vector<qsizetype> expected = pathOrder(baseline.files);
+    const std::vector<qsizetype> actual = pathOrder(current.files);
+    size_t e = 0;
+    size_t a = 0;
+    while (e < expected.size() || a < actual.size()) {
+        const int order = e == expected.size() ? 1
+                          : a == actual.size() ? -1
+                                               : baseline.files.comparePath(expected[e], current.files, actual[a]);
+        if (order < 0) {
+            result.missingPaths.append(baseline.files.relativePath(expected[e++]));
+        } else if (order > 0) {
+            result.addedPaths.append(current.files.relativePath(actual[a++]));
+        } else {
+            if (!baseline.files.sameContentHash(expected[e], current.files, actual[a])) {
+                const WatchFileEntry now = current.files.at(actual[a]);
+                result.changedPaths.append(now.relativePath);
+                appendChangedRanges(baseline.files.at(expected[e]), now, result.changedRanges);
+            }
+            ++e;
+            ++a;
+        }
+    }
+
+    result.matches = (result.computedRootHex == result.expectedRootHex)
+                     && result.changedPaths.isEmpty()
+                     && result.missingPaths.isEmpty()
+                     && result.addedPaths.isEmpty();
+}
+
+/**
+ * Last tree computed per watch group. When a later build or verify of the group sees the
+ * same paths, only the leaves whose content hash changed are rehashed with their
+ * ancestors (O(k log n)) instead of rebuilding the whole tree.
+ *
+ * Trees are also found by root: sticks cloned from one golden image have their own group
+ * ids but the same baseline root, so verifying the next one starts from the last one's tree.
+ */
+class TreeCache {
+public:
+    static TreeCache& instance()
+    {
+        static TreeCache cache;
+        return cache;
+    }
+
+    std::shared_ptr<const MerkleTree> find(const QString& groupId) const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_trees.value(groupId);
+    }
+
+    std::shared_ptr<const MerkleTree> findByRoot(const QString& rootHex) const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_byRoot.value(rootHex);
+    }
+
+    void store(const QString& groupId, std::shared_ptr<const MerkleTree> tree)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_trees.size() >= kMaxCachedTrees && !m_trees.contains(groupId)) {
+            m_trees.clear();
+        }
+        if (m_byRoot.size() >= kMaxCachedTrees) {
+            m_byRoot.clear();
+        }
+        m_byRoot.insert(tree->rootHex(), tree);
+        m_trees.insert(groupId, std::move(tree));
+    }
+
+private:
+    static constexpr qsizetype kMaxCachedTrees = 32;
+
+    mutable QMutex m_mutex;
+    QHash<QString, std::shared_ptr<const MerkleTree>> m_trees;
+    QHash<QString, std::shared_ptr<const MerkleTree>> m_byRoot;
+};
+
+MerkleTree::Shape merkleShapeOf(const WatchGroup& group)
+{
+    return {static_cast<MerkleTree::Format>(group.merkleFormat), group.merkleFanOut};
+}
+
+/** @p spec for a new baseline: whatever format its old root had, the new one is the latest. */
+WatchGroup withLatestMerkleShape(WatchGroup spec)
+{
+    const MerkleTree::Shape latest = MerkleTree::latestShape();
+    spec.merkleFormat = static_cast<int>(latest.format);
+    spec.merkleFanOut = latest.fanOut;
+    return spec;
+}
+
+/**
+ * Merkle root of @p leaves (already in path order) in @p shape, reusing the group's cached
+ * tree, or else one cached with @p baselineRoot (the root the group was built with, if any).
+ */
+QString groupRootHex(const QString& groupId, const QVector<MerkleTree::Leaf>& leaves,
+                     const MerkleTree::Shape& shape, const QString& baselineRoot = {})
+{
+    if (groupId.isEmpty()) {
+        return MerkleTree::rootHex(leaves, shape);
+    }
+    std::shared_ptr<const MerkleTree> cached = TreeCache::instance().find(groupId);
+    if ((!cached || cached->leafCount() != leaves.size() || cached->shape() != shape)
+        && !baselineRoot.isEmpty()) {
+        cached = TreeCache::instance().findByRoot(baselineRoot);
+    }
+    if (cached && cached->leafCount() == leaves.size() && cached->shape() == shape) {
+        QVector<MerkleTree::Leaf> changed;
+        bool samePaths = true;
+        for (qsizetype i = 0; i < leaves.size(); ++i) {
+            const MerkleTree::Leaf& old = cached->leaves().at(i);
+            if (old.relativePath != leaves.at(i).relativePath) {
+                samePaths = false;
+                break;
+            }
+            if (old.contentHashHex != leaves.at(i).contentHashHex) {
+                changed.append(leaves.at(i));
+            }
+        }
+        if (samePaths && changed.isEmpty()) {
+            return cached->rootHex();
+        }
+        if (samePaths) {
+            auto updated = std::make_shared<MerkleTree>(*cached);
+            if (updated->updateLeaves(changed)) {
+                const QString root = updated->rootHex();
+                TreeCache::instance().store(groupId, std::move(updated));
+                return root;
+            }
+        }
+    }
+
+    auto tree = std::make_shared<MerkleTree>(MerkleTree::build(leaves, shape));
+    const QString root = tree->rootHex();
+    TreeCache::instance().store(groupId, std::move(tree));
+    return root;
+}
+
+/** Stat data and chunk lists (nullptr when none) of listed files, by relative path. */
+using StatLookup = std::function<FileStat(const QString& relativePath)>;
+using ChunkLookup = std::function<const QList<WatchChunk>*(const QString& relativePath)>;
+
+/**
+ * Group entries for @p leaves with stat data from @p statOf. Chunk lists come from files
+ * hashed in chunked mode (@p chunksOf), or from the @p recorded baseline entry when the file
+ * was not re-hashed and kept its content hash.
+ */
+WatchGroup finalizeGroupWith(const WatchGroup& spec, const QVector<MerkleTree::Leaf>& leaves,
+                             const StatLookup& statOf, const ChunkLookup& chunksOf,
+                             const RecordedEntries* recorded)
 {
     WatchGroup group;
-    group.id = groupId;
-    group.name = name;
-    group.watchPaths = watchPaths;
+    group.id = spec.id;
+    group.name = spec.name;
+    group.watchPaths = spec.watchPaths;
+    group.chunkThresholdBytes = spec.chunkThresholdBytes;
+    group.merkleFormat = spec.merkleFormat;
+    group.merkleFanOut = spec.merkleFanOut;
     group.builtAt = QDateTime::currentDateTimeUtc();
 
     for (const MerkleTree::Leaf& leaf : leaves) {
         WatchFileEntry entry;
         entry.relativePath = leaf.relativePath;
         entry.contentHash = leaf.contentHashHex;
-        QFileInfo fi(normalizeMount(mountPoint) + QLatin1Char('/') + leaf.relativePath);
-        if (fi.exists()) {
-            entry.sizeBytes = static_cast<uint64_t>(fi.size());
-            entry.modifiedUtc = fi.lastModified().toUTC();
+        // Stat from the listing, taken before the file was read.
+        const FileStat st = statOf(leaf.relativePath);
+        if (st.exists) {
+            entry.sizeBytes = st.size;
+            entry.modifiedUtc = st.modifiedUtc;
+            entry.changedUtc = st.changedUtc;
+            entry.inode = st.inode;
+        }
+        if (spec.chunkThresholdBytes > 0) {
+            if (const QList<WatchChunk>* chunks = chunksOf(leaf.relativePath)) {
+                entry.chunks = *chunks;
+            } else if (const WatchFileEntry* old = recorded ? recordedEntry(*recorded, leaf.relativePath) : nullptr;
+                       old && old->contentHash == leaf.contentHashHex) {
+                entry.chunks = old->chunks;
+            }
         }
         group.files.append(entry);
     }
 
-    group.merkleRoot = MerkleTree::rootHex(leaves);
+    group.merkleRoot = groupRootHex(spec.id, leaves, merkleShapeOf(spec), spec.merkleRoot);
     return group;
 }
 
-} // namespace
+WatchGroup finalizeGroup(const MountIndex& index, const WatchGroup& spec,
+                         const QVector<MerkleTree::Leaf>& leaves,
+                         const RecordedEntries* recorded = nullptr)
+{
+    FLASHSPARTAN_TRACE_SPAN_VALUE("manifest", "finalize", leaves.size());
+    const QString mount = normalizeMount(index.mountPoint());
+    return finalizeGroupWith(
+        spec, leaves, [&](const QString& relativePath) { return index.stat(joinPath(mount, relativePath)); },
+        [&](const QString& relativePath) -> const QList<WatchChunk>* {
+            auto it = index.chunkLists().constFind(joinPath(mount, relativePath));
+            return it != index.chunkLists().cend() ? &it.value() : nullptr;
+        },
+        recorded);
+}
 
-QString ManifestService::hashFileContents(const QString& absolutePath, QString* errorOut)
+/**
+ * For ManifestVerifyPolicy::failFast: additions and removals are known from the listing
+ * alone. When there are any, @p result becomes an incomplete mismatch and true is returned.
+ */
+bool listingDiffers(const QVector<MerkleTree::Leaf>& leaves, const WatchGroup& baseline,
+                    const RecordedEntries& recorded, ManifestService::VerifyResult& result)
+{
+    QSet<QString> listed;
+    for (const MerkleTree::Leaf& leaf : leaves) {
+        listed.insert(leaf.relativePath);
+        if (!recorded.contains(leaf.relativePath)) {
+            result.addedPaths.append(leaf.relativePath);
+        }
+    }
+    for (const WatchFileEntry& e : baseline.files) {
+        if (!listed.contains(e.relativePath)) {
+            result.missingPaths.append(e.relativePath);
+        }
+    }
+    if (result.addedPaths.isEmpty() && result.missingPaths.isEmpty()) {
+        return false;
+    }
+    result.success = true;
+    result.complete = false;
+    result.expectedRootHex = baseline.merkleRoot;
+    result.filesChecked = static_cast<uint64_t>(leaves.size());
+    return true;
+}
+
+QString hashWithBuffer(const QString& absolutePath, const IoBufferPool::Buffer& buffer, QString* errorOut,
+                       Progress* progress = nullptr)
 {
+    FLASHSPARTAN_TRACE_SPAN("manifest", "hash_file");
+    if (!buffer) {
+        if (errorOut) {
+            *errorOut = QStringLiteral("Failed to allocate buffer");
+        }
+        return {};
+    }
     QFile file(absolutePath);
     if (!file.open(QIODevice::ReadOnly)) {
         if (errorOut) {
@@ -152,28 +826,34 @@ QString ManifestService::hashFileContents(const QString& absolutePath, QString*
         }
         return {};
     }
+    if (file.size() > static_cast<qint64>(buffer.size())) {
+        FileReadAhead::sequential(file.handle());
+    }
 
-    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    DigestContextPool::Context pooled;
+    EVP_MD_CTX* ctx = pooled.get();
     if (!ctx) {
         if (errorOut) {
             *errorOut = QStringLiteral("OpenSSL context failed");
         }
         return {};
     }
-    if (EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) != 1) {
-        EVP_MD_CTX_free(ctx);
+    if (EVP_DigestInit_ex(ctx, DigestContextPool::sha256(), nullptr) != 1) {
         if (errorOut) {
             *errorOut = QStringLiteral("OpenSSL hash initialization failed");
         }
         return {};
     }
 
-    QByteArray buffer;
-    buffer.resize(1024 * 1024);
     while (true) {
-        const qint64 n = file.read(buffer.data(), buffer.size());
+        if (isCancelled(progress)) {
+            if (errorOut) {
+                *errorOut = cancelledMessage();
+            }
+            return {};
+        }
+        const qint64 n = file.read(buffer.data(), static_cast<qint64>(buffer.size()));
         if (n < 0) {
-            EVP_MD_CTX_free(ctx);
             if (errorOut) {
                 *errorOut = file.errorString();
             }
@@ -182,34 +862,471 @@ QString ManifestService::hashFileContents(const QString& absolutePath, QString*
         if (n == 0) {
             break;
         }
-        if (EVP_DigestUpdate(ctx, buffer.constData(), static_cast<size_t>(n)) != 1) {
-            EVP_MD_CTX_free(ctx);
+        if (EVP_DigestUpdate(ctx, buffer.data(), static_cast<size_t>(n)) != 1) {
             if (errorOut) {
                 *errorOut = QStringLiteral("OpenSSL hash update failed");
             }
             return {};
         }
+        if (progress) {
+            progress->bytesDone += static_cast<uint64_t>(n);
+        }
+    }
+
+    unsigned char hash[EVP_MAX_MD_SIZE];
+    unsigned int len = 0;
+    if (EVP_DigestFinal_ex(ctx, hash, &len) != 1) {
+        if (errorOut) {
+            *errorOut = QStringLiteral("OpenSSL hash finalization failed");
+        }
+        return {};
+    }
+
+    return HexEncoding::toString(hash, len);
+}
+
+QString hashPipelined(const QString& absolutePath, QString* errorOut, Progress* progress = nullptr)
+{
+    FLASHSPARTAN_TRACE_SPAN("manifest", "hash_file_pipelined");
+    QFile file(absolutePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorOut) {
+            *errorOut = file.errorString();
+        }
+        return {};
+    }
+    FileReadAhead::sequential(file.handle());
+
+    DigestContextPool::Context pooled;
+    EVP_MD_CTX* ctx = pooled.get();
+    if (!ctx || EVP_DigestInit_ex(ctx, DigestContextPool::sha256(), nullptr) != 1) {
+        if (errorOut) {
+            *errorOut = QStringLiteral("OpenSSL hash initialization failed");
+        }
+        return {};
+    }
+
+    QString err;
+    const bool ok = RawDeviceHash::runPipelined(
+        kLargeFilePipelineDepth, kLargeFileBufferBytes,
+        [&file, progress](char* data, size_t capacity, QString* readError) -> int64_t {
+            if (isCancelled(progress)) {
+                if (readError) {
+                    *readError = cancelledMessage();
+                }
+                return -1;
+            }
+            const qint64 n = file.read(data, static_cast<qint64>(capacity));
+            if (n < 0 && readError) {
+                *readError = file.errorString();
+            }
+            return n;
+        },
+        [ctx, progress](const char* data, size_t length) {
+            if (progress) {
+                progress->bytesDone += length;
+            }
+            return EVP_DigestUpdate(ctx, data, length) == 1;
+        },
+        nullptr, &err);
+    if (!ok) {
+        if (errorOut) {
+            *errorOut = err.isEmpty() ? QStringLiteral("OpenSSL hash update failed") : err;
+        }
+        return {};
     }
 
     unsigned char hash[EVP_MAX_MD_SIZE];
     unsigned int len = 0;
     if (EVP_DigestFinal_ex(ctx, hash, &len) != 1) {
-        EVP_MD_CTX_free(ctx);
         if (errorOut) {
             *errorOut = QStringLiteral("OpenSSL hash finalization failed");
         }
         return {};
     }
-    EVP_MD_CTX_free(ctx);
+    return HexEncoding::toString(hash, len);
+}
+
+/**
+ * Whole-file SHA-256 plus content-defined chunk digests, fed in any buffer sizes. The
+ * whole-file hash is what the Merkle leaf uses, so roots do not depend on chunking.
+ */
+class ChunkedDigest {
+public:
+    bool init()
+    {
+        return m_file && m_chunk && EVP_DigestInit_ex(m_file.get(), DigestContextPool::sha256(), nullptr) == 1
+               && EVP_DigestInit_ex(m_chunk.get(), DigestContextPool::sha256(), nullptr) == 1;
+    }
+
+    bool update(const char* data, size_t length)
+    {
+        if (EVP_DigestUpdate(m_file.get(), data, length) != 1) {
+            return false;
+        }
+        const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+        while (length > 0) {
+            bool boundary = false;
+            const size_t n = m_chunker.scan(bytes, length, &boundary);
+            if (EVP_DigestUpdate(m_chunk.get(), bytes, n) != 1) {
+                return false;
+            }
+            m_offset += n;
+            bytes += n;
+            length -= n;
+            if (boundary && !endChunk()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** The whole-file hash, empty on failure; the chunk list goes to @p chunksOut. */
+    QString finish(QList<WatchChunk>* chunksOut)
+    {
+        if (m_offset > m_chunkStart && !endChunk()) {
+            return {};
+        }
+        unsigned char hash[EVP_MAX_MD_SIZE];
+        unsigned int len = 0;
+        if (EVP_DigestFinal_ex(m_file.get(), hash, &len) != 1) {
+            return {};
+        }
+        if (chunksOut) {
+            *chunksOut = std::move(m_chunks);
+        }
+        return HexEncoding::toString(hash, len);
+    }
+
+private:
+    bool endChunk()
+    {
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int len = 0;
+        if (EVP_DigestFinal_ex(m_chunk.get(), digest, &len) != 1
+            || EVP_DigestInit_ex(m_chunk.get(), DigestContextPool::sha256(), nullptr) != 1) {
+            return false;
+        }
+        m_chunks.append(WatchChunk{m_chunkStart, static_cast<uint32_t>(m_offset - m_chunkStart),
+                                   HexEncoding::toString(digest, len)});
+        m_chunkStart = m_offset;
+        return true;
+    }
+
+    DigestContextPool::Context m_file;
+    DigestContextPool::Context m_chunk;
+    ContentChunker m_chunker;
+    QList<WatchChunk> m_chunks;
+    uint64_t m_offset = 0;
+    uint64_t m_chunkStart = 0;
+};
+
+/** ChunkedDigest of a file in one pass through the read pipeline. */
+QString hashChunked(const QString& absolutePath, QString* errorOut, QList<WatchChunk>* chunksOut,
+                    Progress* progress = nullptr)
+{
+    FLASHSPARTAN_TRACE_SPAN("manifest", "hash_file_chunked");
+    QFile file(absolutePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (errorOut) {
+            *errorOut = file.errorString();
+        }
+        return {};
+    }
+    FileReadAhead::sequential(file.handle());
+
+    ChunkedDigest digest;
+    if (!digest.init()) {
+        if (errorOut) {
+            *errorOut = QStringLiteral("OpenSSL hash initialization failed");
+        }
+        return {};
+    }
+
+    QString err;
+    const bool ok = RawDeviceHash::runPipelined(
+        kLargeFilePipelineDepth, kLargeFileBufferBytes,
+        [&file, progress](char* data, size_t capacity, QString* readError) -> int64_t {
+            if (isCancelled(progress)) {
+                if (readError) {
+                    *readError = cancelledMessage();
+                }
+                return -1;
+            }
+            const qint64 n = file.read(data, static_cast<qint64>(capacity));
+            if (n < 0 && readError) {
+                *readError = file.errorString();
+            }
+            return n;
+        },
+        [&digest, progress](const char* data, size_t length) {
+            if (progress) {
+                progress->bytesDone += length;
+            }
+            return digest.update(data, length);
+        },
+        nullptr, &err);
+    const QString hash = ok ? digest.finish(chunksOut) : QString();
+    if (hash.isEmpty() && errorOut) {
+        *errorOut = err.isEmpty() ? QStringLiteral("OpenSSL hash update failed") : err;
+    }
+    return hash;
+}
+
+/**
+ * Called from hash workers as each file is hashed; returning false stops the remaining work.
+ * Must be thread-safe.
+ */
+using HashedCallback = std::function<bool(qsizetype index, const QString& hash)>;
+
+/**
+ * Content hashes of @p files, in the same order. Work items are taken from a shared
+ * cursor by up to kMaxHashThreads workers, largest first so a big file never starts last;
+ * runs of small files travel as one item so their open/read/close latency overlaps with
+ * other workers instead of costing one dispatch each, and within a run the next file is
+ * prefetched (FileReadAhead) while the current one is hashed. On failure @p errorOut names the
+ * first failed file in list order. When @p onHashed stops the run, files not reached keep
+ * an empty hash. With @p priority (one ManifestService::hashPriority() per file) lower
+ * tiers are handed out first and batches never mix tiers; size order applies within a tier.
+ * When @p index reads in disk order, one worker takes the files of each tier by the
+ * physical offset of their first extent instead, so a slow stick sees one near-sequential
+ * stream; files whose place is unknown follow in list order. The result order is the same.
+ * Files of @p chunkThreshold bytes and more (when non-zero) are hashed with hashChunked()
+ * and their chunk lists land in @p chunksOut, indexed like @p files. Progress and the cancel
+ * flag come from @p index; a cancel fails the run with "Cancelled".
+ */
+QStringList hashFilesParallel(const QStringList& files, QString* errorOut,
+                              const MountIndex* index = nullptr,
+                              const HashedCallback& onHashed = {},
+                              const QVector<int>* priority = nullptr,
+                              uint64_t chunkThreshold = 0,
+                              std::vector<QList<WatchChunk>>* chunksOut = nullptr)
+{
+    struct WorkItem {
+        qsizetype first = 0;  // into order
+        qsizetype count = 0;
+        qint64 bytes = 0;
+        int tier = 0;
+    };
+
+    auto tierOf = [&](qsizetype i) { return priority ? priority->at(i) : 0; };
+    std::vector<qsizetype> order(static_cast<size_t>(files.size()));
+    std::iota(order.begin(), order.end(), qsizetype(0));
+    const bool diskOrder = index && index->diskOrder();
+    if (diskOrder) {
+        std::vector<uint64_t> offsets(static_cast<size_t>(files.size()));
+        for (qsizetype i = 0; i < files.size(); ++i) {
+            offsets[static_cast<size_t>(i)] = FileExtents::physicalOffset(files.at(i));
+        }
+        std::stable_sort(order.begin(), order.end(), [&](qsizetype a, qsizetype b) {
+            return tierOf(a) != tierOf(b) ? tierOf(a) < tierOf(b)
+                                          : offsets[static_cast<size_t>(a)] < offsets[static_cast<size_t>(b)];
+        });
+    } else if (priority) {
+        std::stable_sort(order.begin(), order.end(),
+                         [&](qsizetype a, qsizetype b) { return tierOf(a) < tierOf(b); });
+    }
+
+    std::vector<WorkItem> items;
+    std::vector<qint64> sizes(static_cast<size_t>(files.size()));
+    if (chunksOut) {
+        chunksOut->assign(static_cast<size_t>(files.size()), {});
+    }
+    WorkItem batch;
+    auto flushBatch = [&]() {
+        if (batch.count > 0) {
+            items.push_back(batch);
+        }
+        batch = {};
+    };
+    for (qsizetype pos = 0; pos < files.size(); ++pos) {
+        const qsizetype i = order[static_cast<size_t>(pos)];
+        const qint64 size = index ? static_cast<qint64>(index->stat(files.at(i)).size)
+                                  : QFileInfo(files.at(i)).size();
+        sizes[static_cast<size_t>(i)] = size;
+        if (batch.count > 0 && batch.tier != tierOf(i)) {
+            flushBatch();
+        }
+        if (size >= kSmallFileBytes) {
+            flushBatch();
+            items.push_back({pos, 1, size, tierOf(i)});
+            continue;
+        }
+        if (batch.count == 0) {
+            batch.first = pos;
+            batch.tier = tierOf(i);
+        }
+        ++batch.count;
+        batch.bytes += size;
+        if (batch.count >= kMicroBatchFiles || batch.bytes >= kMicroBatchBytes) {
+            flushBatch();
+        }
+    }
+    flushBatch();
+    if (!diskOrder) {
+        std::stable_sort(items.begin(), items.end(), [](const WorkItem& a, const WorkItem& b) {
+            return a.tier != b.tier ? a.tier < b.tier : a.bytes > b.bytes;
+        });
+    }
+
+    Progress* progress = index ? index->progress() : nullptr;
+    if (progress) {
+        progress->filesTotal += static_cast<uint64_t>(files.size());
+        for (const qint64 size : sizes) {
+            progress->bytesTotal += static_cast<uint64_t>(std::max<qint64>(size, 0));
+        }
+    }
+
+    std::vector<QString> hashes(static_cast<size_t>(files.size()));
+    std::vector<QString> errors(static_cast<size_t>(files.size()));
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::atomic<bool> stopped{false};
+    auto work = [&]() {
+        const IoBufferPool::Buffer buffer(kReadBufferBytes);
+        for (size_t item = next++; item < items.size() && !failed.load() && !stopped.load();
+             item = next++) {
+            const WorkItem& w = items[item];
+            for (qsizetype pos = w.first; pos < w.first + w.count && !stopped.load(); ++pos) {
+                const qsizetype i = order[static_cast<size_t>(pos)];
+                const QString& path = files.at(i);
+                QString& error = errors[static_cast<size_t>(i)];
+                QString& hash = hashes[static_cast<size_t>(i)];
+                const qint64 size = sizes[static_cast<size_t>(i)];
+                if (pos + 1 < w.first + w.count) {
+                    // The next file of the batch is fetched while this one is hashed.
+                    const qsizetype following = order[static_cast<size_t>(pos + 1)];
+                    FileReadAhead::prefetch(files.at(following), sizes[static_cast<size_t>(following)]);
+                }
+                if (chunkThreshold > 0 && size >= 0 && static_cast<uint64_t>(size) >= chunkThreshold) {
+                    hash = hashChunked(path, &error, chunksOut ? &(*chunksOut)[static_cast<size_t>(i)] : nullptr,
+                                       progress);
+                } else {
+                    hash = w.bytes >= kLargeFileBytes ? hashPipelined(path, &error, progress)
+                                                      : hashWithBuffer(path, buffer, &error, progress);
+                }
+                if (hash.isEmpty()) {
+                    if (error.isEmpty()) {
+                        error = QStringLiteral("Hash failed");
+                    }
+                    failed.store(true);
+                    break;
+                }
+                if (progress) {
+                    ++progress->filesDone;
+                }
+                if (onHashed && !onHashed(i, hash)) {
+                    stopped.store(true);
+                }
+            }
+        }
+    };
+
+    const size_t threads = diskOrder ? 1
+                                     : std::min<size_t>({std::max(1u, std::thread::hardware_concurrency()),
+                                                         index ? index->maxHashThreads() : kMaxHashThreads,
+                                                         items.size()});
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; ++t) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (std::thread& t : pool) {
+        t.join();
+    }
+
+    if (failed.load()) {
+        if (isCancelled(progress)) {
+            if (errorOut) {
+                *errorOut = cancelledMessage();
+            }
+            return {};
+        }
+        for (qsizetype i = 0; i < files.size(); ++i) {
+            const QString& error = errors[static_cast<size_t>(i)];
+            if (!error.isEmpty()) {
+                if (errorOut) {
+                    *errorOut = QStringLiteral("%1: %2").arg(files.at(i), error);
+                }
+                return {};
+            }
+        }
+    }
+    return QStringList(hashes.begin(), hashes.end());
+}
 
-    return MerkleTree::toHex(QByteArray(reinterpret_cast<const char*>(hash), static_cast<int>(len)));
+/**
+ * hashFilesParallel() for files not already hashed during this operation. @p onHashed sees
+ * cached files first, on the calling thread. A file due a chunk list that an earlier group
+ * hashed without one is hashed again.
+ */
+QStringList hashFilesCached(MountIndex& index, const QStringList& files, QString* errorOut,
+                            const HashedCallback& onHashed = {},
+                            const QVector<int>* priority = nullptr,
+                            uint64_t chunkThreshold = 0)
+{
+    QHash<QString, QString>& cache = index.contentHashes();
+    QStringList missing;
+    QVector<qsizetype> missingIndex;
+    QVector<int> missingPriority;
+    for (qsizetype i = 0; i < files.size(); ++i) {
+        auto it = cache.constFind(files.at(i));
+        const bool needsChunks = chunkThreshold > 0 && index.stat(files.at(i)).size >= chunkThreshold
+                                 && !index.chunkLists().contains(files.at(i));
+        if (it == cache.cend() || needsChunks) {
+            missing.append(files.at(i));
+            missingIndex.append(i);
+            if (priority) {
+                missingPriority.append(priority->at(i));
+            }
+        } else if (onHashed && !onHashed(i, it.value())) {
+            QStringList out;
+            for (const QString& f : files) {
+                out.append(cache.value(f));
+            }
+            return out;
+        }
+    }
+    if (!missing.isEmpty()) {
+        HashedCallback forward;
+        if (onHashed) {
+            forward = [&](qsizetype k, const QString& hash) { return onHashed(missingIndex.at(k), hash); };
+        }
+        std::vector<QList<WatchChunk>> chunks;
+        const QStringList hashes = hashFilesParallel(missing, errorOut, &index, forward,
+                                                     priority ? &missingPriority : nullptr,
+                                                     chunkThreshold, &chunks);
+        if (hashes.isEmpty()) {
+            return {};
+        }
+        for (qsizetype i = 0; i < missing.size(); ++i) {
+            if (!hashes.at(i).isEmpty()) {
+                cache.insert(missing.at(i), hashes.at(i));
+            }
+            if (!chunks[static_cast<size_t>(i)].isEmpty()) {
+                index.chunkLists().insert(missing.at(i), std::move(chunks[static_cast<size_t>(i)]));
+            }
+        }
+    }
+    QStringList out;
+    out.reserve(files.size());
+    for (const QString& f : files) {
+        out.append(cache.value(f));
+    }
+    return out;
 }
 
-ManifestService::BuildResult ManifestService::buildGroup(const QString& mountPoint, const WatchGroup& spec)
+ManifestService::BuildResult buildGroupIn(MountIndex& index, const WatchGroup& spec)
 {
-    BuildResult result;
+    FLASHSPARTAN_TRACE_SPAN("manifest", "build_group");
+    const QString& mountPoint = index.mountPoint();
+    ManifestService::BuildResult result;
     QString err;
-    const QStringList files = collectFilesForPaths(mountPoint, spec.watchPaths, &err);
+    const QStringList files = collectFilesForPaths(index, spec.watchPaths, &err);
+    if (index.cancelled()) {
+        result.errorMessage = cancelledMessage();
+        return result;
+    }
     if (!err.isEmpty()) {
         result.errorMessage = err;
         return result;
@@ -219,78 +1336,169 @@ ManifestService::BuildResult ManifestService::buildGroup(const QString& mountPoi
         return result;
     }
 
+    const QStringList hashes = hashFilesCached(index, files, &err, {}, nullptr, spec.chunkThresholdBytes);
+    if (hashes.isEmpty()) {
+        result.errorMessage = err;
+        return result;
+    }
+
     QVector<MerkleTree::Leaf> leaves;
     leaves.reserve(files.size());
-    for (const QString& abs : files) {
-        QString fileErr;
-        const QString hash = hashFileContents(abs, &fileErr);
-        if (hash.isEmpty()) {
-            result.errorMessage = QStringLiteral("%1: %2").arg(abs, fileErr);
-            return result;
-        }
+    for (qsizetype i = 0; i < files.size(); ++i) {
         MerkleTree::Leaf leaf;
-        leaf.relativePath = relativePathUnder(mountPoint, abs);
-        leaf.contentHashHex = hash;
+        leaf.relativePath = relativePathUnder(mountPoint, files.at(i));
+        leaf.contentHashHex = hashes.at(i);
         leaves.append(leaf);
     }
 
-    result.group = finalizeGroup(mountPoint, spec.id, spec.name, spec.watchPaths, leaves);
+    result.group = finalizeGroup(index, spec, leaves);
     result.success = true;
     return result;
 }
 
-ManifestService::VerifyResult ManifestService::verifyGroup(const QString& mountPoint, const WatchGroup& baseline)
+/** @p recordedIn, when given, is recordedEntries(@p baseline), shared across the mounts of a batch. */
+ManifestService::VerifyResult verifyGroupIn(MountIndex& index, const WatchGroup& baseline,
+                                            const ManifestVerifyPolicy& policy,
+                                            const QSet<QString>* touchedPaths,
+                                            const RecordedEntries* recordedIn = nullptr)
 {
-    VerifyResult result;
+    FLASHSPARTAN_TRACE_SPAN("manifest", "verify_group");
+    const QString& mountPoint = index.mountPoint();
+    ManifestService::VerifyResult result;
     QElapsedTimer timer;
     timer.start();
 
-    WatchGroup spec = baseline;
-    spec.watchPaths = baseline.watchPaths;
-    const BuildResult built = buildGroup(mountPoint, spec);
-    if (!built.success) {
-        result.errorMessage = built.errorMessage;
+    if (touchedPaths && !journalTouchesGroup(index.canonicalMount(), baseline.watchPaths, *touchedPaths)) {
+        // Nothing under the group changed since the last clean verify: no listing at all.
+        result.success = true;
+        compareGroups(baseline, baseline, result);
+        result.durationMs = static_cast<uint64_t>(timer.elapsed());
         return result;
     }
 
-    result.success = true;
-    result.computedRootHex = built.group.merkleRoot;
-    result.expectedRootHex = baseline.merkleRoot;
-    result.filesChecked = static_cast<uint64_t>(built.group.files.size());
-    result.durationMs = static_cast<uint64_t>(timer.elapsed());
+    if (!policy.metadataFirst && !touchedPaths && !policy.failFast) {
+        const ManifestService::BuildResult built = buildGroupIn(index, baseline);
+        if (!built.success) {
+            result.errorMessage = built.errorMessage;
+            return result;
+        }
+        result.success = true;
+        compareGroups(baseline, built.group, result);
+        result.filesHashed = result.filesChecked;
+        result.durationMs = static_cast<uint64_t>(timer.elapsed());
+        return result;
+    }
 
-    QHash<QString, QString> expected;
-    for (const WatchFileEntry& e : baseline.files) {
-        expected.insert(e.relativePath, e.contentHash);
+    // Stage 1: listing plus stat (or the journal). Only entries that fail the metadata check
+    // (or are sampled, or were touched) move on to stage 2, content hashing. Without a
+    // metadata policy or journal (fail-fast alone) every file is hashed.
+    QString err;
+    const QStringList files = collectFilesForPaths(index, baseline.watchPaths, &err);
+    if (index.cancelled()) {
+        result.errorMessage = cancelledMessage();
+        return result;
+    }
+    if (!err.isEmpty()) {
+        result.errorMessage = err;
+        return result;
     }
-    QHash<QString, QString> actual;
-    for (const WatchFileEntry& e : built.group.files) {
-        actual.insert(e.relativePath, e.contentHash);
+    if (files.isEmpty()) {
+        result.errorMessage = QStringLiteral("No files found for watch paths");
+        return result;
     }
 
-    for (auto it = expected.constBegin(); it != expected.constEnd(); ++it) {
-        if (!actual.contains(it.key())) {
-            result.missingPaths.append(it.key());
-        } else if (actual.value(it.key()) != it.value()) {
-            result.changedPaths.append(it.key());
+    const RecordedEntries ownRecorded = recordedIn ? RecordedEntries() : recordedEntries(baseline);
+    const RecordedEntries& recorded = recordedIn ? *recordedIn : ownRecorded;
+    const int samplePercent = qBound(0, policy.samplePercent, 100);
+
+    QVector<MerkleTree::Leaf> leaves(files.size());
+    QStringList toHash;
+    QVector<qsizetype> toHashIndex;
+    QVector<int> toHashPriority;
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    for (qsizetype i = 0; i < files.size(); ++i) {
+        MerkleTree::Leaf& leaf = leaves[i];
+        leaf.relativePath = relativePathUnder(mountPoint, files.at(i));
+        const WatchFileEntry* entry = recordedEntry(recorded, leaf.relativePath);
+        bool unchanged = false;
+        if (entry && touchedPaths) {
+            unchanged = !journalTouched(*touchedPaths, leaf.relativePath);
+        } else if (entry && policy.metadataFirst) {
+            const bool sampled = samplePercent > 0
+                                 && static_cast<int>(QRandomGenerator::global()->bounded(100)) < samplePercent;
+            unchanged = !sampled && metadataUnchanged(*entry, index.stat(files.at(i)));
         }
+        if (unchanged) {
+            leaf.contentHashHex = entry->contentHash;
+        } else {
+            toHash.append(files.at(i));
+            toHashIndex.append(i);
+            toHashPriority.append(ManifestService::hashPriority(
+                leaf.relativePath, index.stat(files.at(i)).modifiedUtc, baseline.builtAt, now));
+        }
+    }
+
+    if (policy.failFast && listingDiffers(leaves, baseline, recorded, result)) {
+        result.durationMs = static_cast<uint64_t>(timer.elapsed());
+        return result;
     }
-    for (auto it = actual.constBegin(); it != actual.end(); ++it) {
-        if (!expected.contains(it.key())) {
-            result.addedPaths.append(it.key());
+
+    if (!toHash.isEmpty()) {
+        QMutex changedMutex;
+        std::atomic<uint64_t> hashed{0};
+        HashedCallback firstDifference;
+        if (policy.failFast) {
+            firstDifference = [&](qsizetype k, const QString& hash) {
+                ++hashed;
+                const QString& path = leaves.at(toHashIndex.at(k)).relativePath;
+                if (recorded.value(path).contentHash == hash) {
+                    return true;
+                }
+                QMutexLocker locker(&changedMutex);
+                result.changedPaths.append(path);
+                return false;
+            };
+        }
+        const QStringList hashes = hashFilesCached(index, toHash, &err, firstDifference, &toHashPriority,
+                                                   baseline.chunkThresholdBytes);
+        if (hashes.isEmpty()) {
+            result.errorMessage = err;
+            return result;
+        }
+        if (!result.changedPaths.isEmpty()) {
+            result.success = true;
+            result.complete = false;
+            result.expectedRootHex = baseline.merkleRoot;
+            result.filesChecked = static_cast<uint64_t>(files.size());
+            result.filesHashed = hashed.load();
+            result.durationMs = static_cast<uint64_t>(timer.elapsed());
+            return result;
+        }
+        for (qsizetype k = 0; k < toHashIndex.size(); ++k) {
+            leaves[toHashIndex.at(k)].contentHashHex = hashes.at(k);
         }
     }
 
-    result.matches = (result.computedRootHex == result.expectedRootHex)
-                     && result.changedPaths.isEmpty()
-                     && result.missingPaths.isEmpty()
-                     && result.addedPaths.isEmpty();
+    const WatchGroup current =
+        finalizeGroup(index, baseline, leaves, &recorded);
+    result.success = true;
+    compareGroups(baseline, current, result);
+    result.filesHashed = static_cast<uint64_t>(toHash.size());
+    result.durationMs = static_cast<uint64_t>(timer.elapsed());
     return result;
 }
 
-ManifestService::VerifyResult ManifestService::verifyManifest(const QString& mountPoint,
-                                                              const WatchManifest& manifest)
+using GroupVerifier = std::function<ManifestService::VerifyResult(qsizetype groupIndex)>;
+
+/**
+ * Runs @p verifyGroupAt for each group of @p manifest and merges the results, paths
+ * prefixed with the group name: the first failure is returned as is, and with failFast the
+ * first mismatching group ends the run.
+ */
+ManifestService::VerifyResult combineGroups(const WatchManifest& manifest, const ManifestVerifyPolicy& policy,
+                                            const Progress* progress, const GroupVerifier& verifyGroupAt)
 {
+    using VerifyResult = ManifestService::VerifyResult;
     VerifyResult combined;
     combined.success = true;
     combined.matches = true;
@@ -303,17 +1511,26 @@ ManifestService::VerifyResult ManifestService::verifyManifest(const QString& mou
         return combined;
     }
 
-    for (const WatchGroup& group : manifest.groups) {
+    for (qsizetype g = 0; g < manifest.groups.size(); ++g) {
+        const WatchGroup& group = manifest.groups.at(g);
+        if (isCancelled(progress)) {
+            combined.success = false;
+            combined.matches = false;
+            combined.errorMessage = cancelledMessage();
+            return combined;
+        }
         if (group.merkleRoot.isEmpty()) {
             combined.matches = false;
             combined.errorMessage = QStringLiteral("Group '%1' has no baseline").arg(group.name);
             return combined;
         }
-        const VerifyResult one = verifyGroup(mountPoint, group);
+        const VerifyResult one = verifyGroupAt(g);
         if (!one.success) {
             return one;
         }
         combined.filesChecked += one.filesChecked;
+        combined.filesHashed += one.filesHashed;
+        combined.complete = combined.complete && one.complete;
         if (!one.matches) {
             combined.matches = false;
             for (const QString& p : one.changedPaths) {
@@ -325,10 +1542,15 @@ ManifestService::VerifyResult ManifestService::verifyManifest(const QString& mou
             for (const QString& p : one.addedPaths) {
                 combined.addedPaths.append(group.name + QLatin1String(": ") + p);
             }
+            if (policy.failFast) {
+                // The answer is known; later groups are left for the background report.
+                combined.complete = combined.complete && &group == &manifest.groups.constLast();
+                break;
+            }
         }
     }
 
-    combined.computedRootHex = manifestRootHex(manifest);
+    combined.computedRootHex = ManifestService::manifestRootHex(manifest);
     combined.expectedRootHex = manifest.manifestRoot;
     if (!combined.expectedRootHex.isEmpty() && combined.computedRootHex != combined.expectedRootHex) {
         combined.matches = false;
@@ -337,6 +1559,445 @@ ManifestService::VerifyResult ManifestService::verifyManifest(const QString& mou
     return combined;
 }
 
+/** verifyManifest() over an existing index; @p recordedByGroup as in verifyGroupIn(), per group. */
+ManifestService::VerifyResult verifyManifestIn(MountIndex& index, const WatchManifest& manifest,
+                                               const ManifestVerifyPolicy& policy,
+                                               const QSet<QString>* touchedPaths,
+                                               const QVector<RecordedEntries>* recordedByGroup = nullptr)
+{
+    return combineGroups(manifest, policy, index.progress(), [&](qsizetype g) {
+        return verifyGroupIn(index, manifest.groups.at(g), policy, touchedPaths,
+                             recordedByGroup ? &recordedByGroup->at(g) : nullptr);
+    });
+}
+
+/**
+ * Listings and content hashes of one unmounted volume read through a RawFsReader, the
+ * counterpart of MountIndex for verifyManifestOnVolume(). Paths are relative to the volume
+ * root, spelled as the watch paths and directory entries spell them. Files are read one at
+ * a time: the reader is not thread-safe, and one block device gains little from parallel reads.
+ */
+class VolumeIndex {
+public:
+    using Files = QMap<QString, RawFsReader::Entry>;  // by relative path, sorted
+
+    VolumeIndex(RawFsReader& volume, Progress* progress)
+        : m_volume(volume)
+        , m_progress(progress)
+    {
+    }
+
+    RawFsReader& volume() { return m_volume; }
+    Progress* progress() const { return m_progress; }
+    bool cancelled() const { return isCancelled(m_progress); }
+
+    /**
+     * The files under watch @p paths, as collectFilesForPaths() finds them on the mount: no
+     * hidden entries below a watch path, only regular files. Any symbolic link on the way is
+     * an error, since only a mount resolves it; so is an absolute watch path.
+     */
+    bool collect(const QStringList& paths, Files* files, QString* errorOut)
+    {
+        for (const QString& path : paths) {
+            const QString trimmed = path.trimmed();
+            if (trimmed.isEmpty()) {
+                continue;
+            }
+            if (QDir::isAbsolutePath(trimmed)) {
+                *errorOut = QStringLiteral("Watch path %1 needs a mounted volume").arg(trimmed);
+                return false;
+            }
+            const QString clean = QDir::cleanPath(QDir::fromNativeSeparators(trimmed));
+            if (clean == QLatin1String("..") || clean.startsWith(QLatin1String("../"))) {
+                *errorOut = QStringLiteral("Watch path escapes mount point: %1").arg(trimmed);
+                return false;
+            }
+            const QString relative = clean == QLatin1String(".") ? QString() : clean;
+            RawFsReader::Entry entry;
+            QString err;
+            if (!m_volume.lookup(relative, &entry, &err)) {
+                if (!err.isEmpty()) {
+                    *errorOut = err;
+                    return false;
+                }
+                continue;
+            }
+            if (entry.isSymlink) {
+                *errorOut = QStringLiteral("Symbolic link needs a mounted volume: %1").arg(trimmed);
+                return false;
+            }
+            if (entry.isRegular) {
+                files->insert(relative, entry);
+            } else if (entry.isDirectory && !walk(relative, entry, files, errorOut)) {
+                return false;
+            }
+        }
+        return !cancelled();
+    }
+
+    FileStat stat(const RawFsReader::Entry& entry) const
+    {
+        FileStat st;
+        st.exists = true;
+        st.size = entry.size;
+        st.modifiedUtc = entry.modifiedUtc;
+        st.changedUtc = entry.changedUtc;
+        st.inode = entry.inode;
+        return st;
+    }
+
+    /**
+     * SHA-256 of @p file, once per operation; files of @p chunkThreshold bytes and more (when
+     * non-zero) also get a chunk list. Empty with @p errorOut set on failure.
+     */
+    QString hash(const QString& relativePath, const RawFsReader::Entry& file, uint64_t chunkThreshold,
+                 QString* errorOut)
+    {
+        const bool chunked = chunkThreshold > 0 && file.size >= chunkThreshold;
+        auto cached = m_hashes.constFind(relativePath);
+        if (cached != m_hashes.cend() && (!chunked || m_chunks.contains(relativePath))) {
+            return cached.value();
+        }
+
+        ChunkedDigest chunkDigest;
+        DigestContextPool::Context pooled;
+        EVP_MD_CTX* ctx = pooled.get();
+        if (chunked ? !chunkDigest.init()
+                    : !ctx || EVP_DigestInit_ex(ctx, DigestContextPool::sha256(), nullptr) != 1) {
+            *errorOut = QStringLiteral("OpenSSL hash initialization failed");
+            return {};
+        }
+        bool digestFailed = false;
+        QString err;
+        const bool ok = m_volume.read(file, [&](const char* data, size_t length) {
+            if (cancelled()) {
+                return false;
+            }
+            if (m_progress) {
+                m_progress->bytesDone += length;
+            }
+            digestFailed = chunked ? !chunkDigest.update(data, length) : EVP_DigestUpdate(ctx, data, length) != 1;
+            return !digestFailed;
+        }, &err);
+        if (!ok) {
+            *errorOut = cancelled() ? cancelledMessage()
+                        : digestFailed ? QStringLiteral("OpenSSL hash update failed")
+                                       : QStringLiteral("%1: %2").arg(relativePath, err);
+            return {};
+        }
+
+        QString hex;
+        if (chunked) {
+            QList<WatchChunk> chunks;
+            hex = chunkDigest.finish(&chunks);
+            m_chunks.insert(relativePath, std::move(chunks));
+        } else {
+            unsigned char digest[EVP_MAX_MD_SIZE];
+            unsigned int len = 0;
+            if (EVP_DigestFinal_ex(ctx, digest, &len) == 1) {
+                hex = HexEncoding::toString(digest, len);
+            }
+        }
+        if (hex.isEmpty()) {
+            *errorOut = QStringLiteral("OpenSSL hash finalization failed");
+            return {};
+        }
+        if (m_progress) {
+            ++m_progress->filesDone;
+        }
+        m_hashes.insert(relativePath, hex);
+        return hex;
+    }
+
+    const QList<WatchChunk>* chunks(const QString& relativePath) const
+    {
+        auto it = m_chunks.constFind(relativePath);
+        return it != m_chunks.cend() ? &it.value() : nullptr;
+    }
+
+private:
+    bool walk(const QString& relativeDir, const RawFsReader::Entry& dir, Files* files, QString* errorOut)
+    {
+        // A copy: the walks below add listings, which may rehash m_listings.
+        QVector<RawFsReader::Entry> entries = m_listings.value(relativeDir);
+        if (!m_listings.contains(relativeDir)) {
+            if (!m_volume.list(dir, &entries, errorOut)) {
+                return false;
+            }
+            m_listings.insert(relativeDir, entries);
+        }
+        for (const RawFsReader::Entry& e : std::as_const(entries)) {
+            if (cancelled()) {
+                return false;
+            }
+            if (e.name.startsWith(QLatin1Char('.'))) {
+                continue;  // hidden, as the mounted walk skips them
+            }
+            const QString path = relativeDir.isEmpty() ? e.name : relativeDir + QLatin1Char('/') + e.name;
+            if (e.isSymlink) {
+                *errorOut = QStringLiteral("Symbolic link needs a mounted volume: %1").arg(path);
+                return false;
+            }
+            if (e.isDirectory) {
+                if (!walk(path, e, files, errorOut)) {
+                    return false;
+                }
+            } else if (e.isRegular) {
+                files->insert(path, e);
+            }
+        }
+        return true;
+    }
+
+    RawFsReader& m_volume;
+    Progress* m_progress = nullptr;
+    QHash<QString, QVector<RawFsReader::Entry>> m_listings;  // by relative directory
+    QHash<QString, QString> m_hashes;
+    QHash<QString, QList<WatchChunk>> m_chunks;
+};
+
+/**
+ * verifyGroupIn() on an unmounted volume. Metadata-first only trusts ext, whose stat fields
+ * are exactly what a mount reports; FAT and exFAT timestamps depend on mount options and
+ * their inode numbers are made up, so there every file is hashed.
+ */
+ManifestService::VerifyResult verifyGroupOnVolume(VolumeIndex& index, const WatchGroup& baseline,
+                                                  const ManifestVerifyPolicy& policy)
+{
+    FLASHSPARTAN_TRACE_SPAN("manifest", "verify_group_on_volume");
+    ManifestService::VerifyResult result;
+    QElapsedTimer timer;
+    timer.start();
+
+    QString err;
+    VolumeIndex::Files files;
+    if (!index.collect(baseline.watchPaths, &files, &err)) {
+        result.errorMessage = index.cancelled() ? cancelledMessage() : err;
+        return result;
+    }
+    if (files.isEmpty()) {
+        result.errorMessage = QStringLiteral("No files found for watch paths");
+        return result;
+    }
+
+    const RecordedEntries recorded = recordedEntries(baseline);
+    const bool metadataFirst = policy.metadataFirst && index.volume().type() == RawFsReader::Type::Ext;
+    const int samplePercent = qBound(0, policy.samplePercent, 100);
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+
+    QVector<MerkleTree::Leaf> leaves;
+    leaves.reserve(files.size());
+    QVector<const RawFsReader::Entry*> entries;
+    entries.reserve(files.size());
+    QVector<qsizetype> toHash;
+    QVector<int> tiers;  // by leaf
+    for (auto it = files.cbegin(); it != files.cend(); ++it) {
+        MerkleTree::Leaf leaf;
+        leaf.relativePath = it.key();
+        const WatchFileEntry* entry = recordedEntry(recorded, leaf.relativePath);
+        bool unchanged = false;
+        if (entry && metadataFirst) {
+            const bool sampled = samplePercent > 0
+                                 && static_cast<int>(QRandomGenerator::global()->bounded(100)) < samplePercent;
+            unchanged = !sampled && metadataUnchanged(*entry, index.stat(it.value()));
+        }
+        if (unchanged) {
+            leaf.contentHashHex = entry->contentHash;
+            tiers.append(0);
+        } else {
+            toHash.append(leaves.size());
+            tiers.append(ManifestService::hashPriority(leaf.relativePath, it.value().modifiedUtc,
+                                                       baseline.builtAt, now));
+        }
+        leaves.append(leaf);
+        entries.append(&it.value());
+    }
+
+    if (policy.failFast && listingDiffers(leaves, baseline, recorded, result)) {
+        result.durationMs = static_cast<uint64_t>(timer.elapsed());
+        return result;
+    }
+
+    std::stable_sort(toHash.begin(), toHash.end(),
+                     [&](qsizetype a, qsizetype b) { return tiers.at(a) < tiers.at(b); });
+    if (Progress* progress = index.progress()) {
+        progress->filesTotal += static_cast<uint64_t>(toHash.size());
+        for (const qsizetype i : std::as_const(toHash)) {
+            progress->bytesTotal += entries.at(i)->size;
+        }
+    }
+    for (const qsizetype i : std::as_const(toHash)) {
+        MerkleTree::Leaf& leaf = leaves[i];
+        leaf.contentHashHex = index.hash(leaf.relativePath, *entries.at(i), baseline.chunkThresholdBytes, &err);
+        if (leaf.contentHashHex.isEmpty()) {
+            result.errorMessage = err;
+            return result;
+        }
+        ++result.filesHashed;
+        if (policy.failFast && recorded.value(leaf.relativePath).contentHash != leaf.contentHashHex) {
+            result.changedPaths.append(leaf.relativePath);
+            result.success = true;
+            result.complete = false;
+            result.expectedRootHex = baseline.merkleRoot;
+            result.filesChecked = static_cast<uint64_t>(leaves.size());
+            result.durationMs = static_cast<uint64_t>(timer.elapsed());
+            return result;
+        }
+    }
+
+    const WatchGroup current = finalizeGroupWith(
+        baseline, leaves, [&](const QString& relativePath) { return index.stat(files.value(relativePath)); },
+        [&](const QString& relativePath) { return index.chunks(relativePath); }, &recorded);
+    result.success = true;
+    compareGroups(baseline, current, result);
+    result.durationMs = static_cast<uint64_t>(timer.elapsed());
+    return result;
+}
+
+} // namespace
+
+int ManifestService::hashPriority(const QString& relativePath, const QDateTime& modifiedUtc,
+                                  const QDateTime& baselineBuiltAt, const QDateTime& now)
+{
+    // Things that run or launch something when the drive is opened.
+    static const QSet<QString> kRiskySuffixes = {
+        QStringLiteral("exe"), QStringLiteral("dll"), QStringLiteral("scr"), QStringLiteral("com"),
+        QStringLiteral("sys"), QStringLiteral("msi"), QStringLiteral("cpl"), QStringLiteral("lnk"),
+        QStringLiteral("bat"), QStringLiteral("cmd"), QStringLiteral("ps1"), QStringLiteral("vbs"),
+        QStringLiteral("vbe"), QStringLiteral("js"), QStringLiteral("jse"), QStringLiteral("wsf"),
+        QStringLiteral("hta"), QStringLiteral("sh"), QStringLiteral("py"), QStringLiteral("desktop"),
+        QStringLiteral("so"), QStringLiteral("dylib"), QStringLiteral("appimage"), QStringLiteral("jar")};
+
+    const QString name = relativePath.section(QLatin1Char('/'), -1).toLower();
+    const int dot = name.lastIndexOf(QLatin1Char('.'));
+    const bool risky = name == QLatin1String("autorun.inf")
+                       || (dot >= 0 && kRiskySuffixes.contains(name.mid(dot + 1)));
+    const bool recent = modifiedUtc.isValid()
+                        && ((baselineBuiltAt.isValid() && modifiedUtc > baselineBuiltAt)
+                            || modifiedUtc.secsTo(now) < kRecentChangeSecs);
+    if (risky) {
+        return recent ? 0 : 1;
+    }
+    return recent ? 2 : 3;
+}
+
+QString ManifestService::hashFileContents(const QString& absolutePath, QString* errorOut)
+{
+    const IoBufferPool::Buffer buffer(kReadBufferBytes);
+    return hashWithBuffer(absolutePath, buffer, errorOut);
+}
+
+ManifestService::BuildResult ManifestService::buildGroup(const QString& mountPoint, const WatchGroup& spec,
+                                                       Progress* progress)
+{
+    MountIndex index(mountPoint, progress);
+    return buildGroupIn(index, withLatestMerkleShape(spec));
+}
+
+ManifestService::VerifyResult ManifestService::verifyGroup(const QString& mountPoint, const WatchGroup& baseline,
+                                                         const ManifestVerifyPolicy& policy,
+                                                         const QSet<QString>* touchedPaths,
+                                                         Progress* progress)
+{
+    MountIndex index(mountPoint, progress);
+    return verifyGroupIn(index, baseline, policy, touchedPaths);
+}
+
+ManifestService::VerifyResult ManifestService::verifyManifest(const QString& mountPoint,
+                                                              const WatchManifest& manifest,
+                                                              const ManifestVerifyPolicy& policy,
+                                                              const QSet<QString>* touchedPaths,
+                                                              Progress* progress)
+{
+    // One listing of the mount for all groups; overlapping groups share walks and hashes.
+    MountIndex index(mountPoint, progress);
+    return verifyManifestIn(index, manifest, policy, touchedPaths);
+}
+
+ManifestService::BatchVerifyResult ManifestService::verifyManifestBatch(const QStringList& mountPoints,
+                                                                        const WatchManifest& manifest,
+                                                                        const ManifestVerifyPolicy& policy,
+                                                                        Progress* progress)
+{
+    BatchVerifyResult batch;
+    QElapsedTimer timer;
+    timer.start();
+    batch.mounts.resize(mountPoints.size());
+    if (mountPoints.isEmpty()) {
+        return batch;
+    }
+
+    // The baseline is indexed once and read by every mount's verify.
+    QVector<RecordedEntries> recorded;
+    recorded.reserve(manifest.groups.size());
+    for (const WatchGroup& group : manifest.groups) {
+        recorded.append(recordedEntries(group));
+    }
+
+    // One verify thread per mount, each a separate device; the hash thread budget is split
+    // between them so a dozen sticks do not start a dozen full pools.
+    const size_t budget = std::max<size_t>(
+        std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), kMaxBatchHashThreads),
+        static_cast<size_t>(mountPoints.size()));
+    const size_t perMount = std::max<size_t>(1, budget / static_cast<size_t>(mountPoints.size()));
+    MountResult* results = batch.mounts.data();
+    auto verifyOne = [&](qsizetype i) {
+        MountIndex index(mountPoints.at(i), progress);
+        index.setMaxHashThreads(perMount);
+        results[i].mountPoint = mountPoints.at(i);
+        results[i].result = verifyManifestIn(index, manifest, policy, nullptr, &recorded);
+    };
+    std::vector<std::thread> workers;
+    for (qsizetype i = 1; i < mountPoints.size(); ++i) {
+        workers.emplace_back(verifyOne, i);
+    }
+    verifyOne(0);
+    for (std::thread& t : workers) {
+        t.join();
+    }
+
+    QHash<QString, int> changedCounts;
+    for (const MountResult& m : batch.mounts) {
+        if (!m.result.success) {
+            ++batch.failed;
+        } else if (m.result.matches) {
+            ++batch.matched;
+        } else {
+            ++batch.mismatched;
+            QSet<QString> seen;
+            for (const QStringList* list : {&m.result.changedPaths, &m.result.missingPaths, &m.result.addedPaths}) {
+                for (const QString& p : *list) {
+                    seen.insert(p);
+                }
+            }
+            for (const QString& p : std::as_const(seen)) {
+                ++changedCounts[p];
+            }
+        }
+    }
+    if (batch.mismatched > 1) {
+        for (auto it = changedCounts.cbegin(); it != changedCounts.cend(); ++it) {
+            if (it.value() == batch.mismatched) {
+                batch.sharedDifferences.append(it.key());
+            }
+        }
+        batch.sharedDifferences.sort();
+    }
+    batch.durationMs = static_cast<uint64_t>(timer.elapsed());
+    return batch;
+}
+
+ManifestService::VerifyResult ManifestService::verifyManifestOnVolume(RawFsReader& volume,
+                                                                      const WatchManifest& manifest,
+                                                                      const ManifestVerifyPolicy& policy,
+                                                                      Progress* progress)
+{
+    VolumeIndex index(volume, progress);
+    return combineGroups(manifest, policy, progress, [&](qsizetype g) {
+        return verifyGroupOnVolume(index, manifest.groups.at(g), policy);
+    });
+}
+
 QString ManifestService::manifestRootHex(const WatchManifest& manifest)
 {
     QVector<MerkleTree::Leaf> groupLeaves;
@@ -350,19 +2011,32 @@ QString ManifestService::manifestRootHex(const WatchManifest& manifest)
         leaf.contentHashHex = g.merkleRoot;
         groupLeaves.append(leaf);
     }
-    return MerkleTree::rootHex(groupLeaves);
+    // Manifests from before Merkle v2 keep their binary root over the group roots.
+    if (manifest.version == QLatin1String("1.0")) {
+        return MerkleTree::rootHex(groupLeaves);
+    }
+    if (manifest.version != kManifestVersion) {
+        return {};
+    }
+    return MerkleTree::rootHex(groupLeaves, kManifestRootShape);
 }
 
-WatchManifest ManifestService::rebuildManifestRoots(const QString& mountPoint, const WatchManifest& spec)
+WatchManifest ManifestService::rebuildManifestRoots(const QString& mountPoint, const WatchManifest& spec,
+                                                   Progress* progress)
 {
     WatchManifest out = spec;
     out.groups.clear();
+    MountIndex index(mountPoint, progress);
     for (const WatchGroup& g : spec.groups) {
-        const BuildResult built = buildGroup(mountPoint, g);
+        if (index.cancelled()) {
+            break;
+        }
+        const BuildResult built = buildGroupIn(index, withLatestMerkleShape(g));
         if (built.success) {
             out.groups.append(built.group);
         }
     }
+    out.version = kManifestVersion;
     out.manifestRoot = manifestRootHex(out);
     out.updatedAt = QDateTime::currentDateTimeUtc();
     return out;
@@ -1,26 +1,174 @@
 #include "ManifestWorker.h"
+#include "IoScheduler.h"
 #include "ManifestService.h"
+#include "RawFsReader.h"
+#include "SharedReadPass.h"
 
+#ifndef Q_OS_WIN
+#include "HelperSession.h"
+#include "RawDeviceHash.h"
+#endif
+
+#include <QElapsedTimer>
 #include <QUuid>
-#include <QtConcurrent>
 #include <QFutureWatcher>
 #include <QMutexLocker>
 
 namespace FlashSpartan {
 
+namespace {
+
+ManifestVerifyResult toWorkerResult(const ManifestService::VerifyResult& vr)
+{
+    ManifestVerifyResult r;
+    r.success = vr.success;
+    r.matches = vr.matches;
+    r.computedRootHex = vr.computedRootHex;
+    r.expectedRootHex = vr.expectedRootHex;
+    r.changedPaths = vr.changedPaths;
+    r.missingPaths = vr.missingPaths;
+    r.addedPaths = vr.addedPaths;
+    r.changedRanges = vr.changedRanges;
+    r.errorMessage = vr.errorMessage;
+    r.complete = vr.complete;
+    r.filesChecked = vr.filesChecked;
+    r.filesHashed = vr.filesHashed;
+    r.durationMs = vr.durationMs;
+    return r;
+}
+
+/** Device reads of one manifest job, queued on the disk behind @p deviceNode. */
+IoScheduler::Task ioTask(const QString& deviceNode, IoScheduler::Priority priority)
+{
+    return {IoScheduler::wholeDiskNode(deviceNode), priority, IoScheduler::Pool::Io};
+}
+
+ManifestBatchVerifyResult runBatchVerify(const QStringList& deviceNodes, const QStringList& mountPoints,
+                                         const WatchManifest& manifest, const ManifestVerifyPolicy& policy,
+                                         ManifestService::Progress* progress)
+{
+    const ManifestService::BatchVerifyResult batch =
+        ManifestService::verifyManifestBatch(mountPoints, manifest, policy, progress);
+    ManifestBatchVerifyResult r;
+    for (qsizetype i = 0; i < batch.mounts.size(); ++i) {
+        ManifestVerifyResult one = toWorkerResult(batch.mounts.at(i).result);
+        one.deviceNode = deviceNodes.value(i);
+        r.results.append(one);
+    }
+    r.matched = batch.matched;
+    r.mismatched = batch.mismatched;
+    r.failed = batch.failed;
+    r.sharedDifferences = batch.sharedDifferences;
+    r.durationMs = batch.durationMs;
+    return r;
+}
+
+/**
+ * verifyManifestOnVolume() straight from @p deviceNode: a direct open, or the descriptor a
+ * reusable helper session left cached. Never authenticates; without either it fails and the
+ * caller mounts instead. File data comes from @p sharedRead when given; listings do not.
+ */
+ManifestService::VerifyResult verifyUnmounted(const QString& deviceNode, const WatchManifest& manifest,
+                                              const ManifestVerifyPolicy& policy,
+                                              ManifestService::Progress* progress,
+                                              SharedReadPass* sharedRead)
+{
+    ManifestService::VerifyResult vr;
+#ifdef Q_OS_WIN
+    Q_UNUSED(deviceNode);
+    Q_UNUSED(manifest);
+    Q_UNUSED(policy);
+    Q_UNUSED(progress);
+    Q_UNUSED(sharedRead);
+    vr.errorMessage = QStringLiteral("Unmounted verification is not supported on Windows");
+#else
+    int fd = RawDeviceHash::openDevice(deviceNode);
+    if (fd < 0) {
+        fd = HelperSession::cachedDeviceFd(deviceNode);
+    }
+    if (fd < 0) {
+        if (sharedRead) {
+            sharedRead->detach();
+        }
+        vr.errorMessage = QStringLiteral("Cannot open %1 without the privileged helper").arg(deviceNode);
+        return vr;
+    }
+    QString error;
+    const RawFsReader::ReadAt direct = RawFsReader::descriptorReader(fd);
+    const std::unique_ptr<RawFsReader> volume =
+        RawFsReader::open(direct, RawDeviceHash::deviceSize(fd, deviceNode), &error);
+    if (volume) {
+        if (sharedRead) {
+            const std::atomic<bool>* cancelled = progress ? &progress->cancelled : nullptr;
+            volume->setContentReader(
+                [sharedRead, direct, cancelled](uint64_t offset, char* data, size_t length, QString* readError) {
+                    return sharedRead->read(offset, data, length, direct, readError, cancelled);
+                });
+        }
+        vr = ManifestService::verifyManifestOnVolume(*volume, manifest, policy, progress);
+    } else {
+        vr.errorMessage = error;
+    }
+    if (sharedRead) {
+        sharedRead->detach();
+    }
+    RawDeviceHash::closeDevice(fd);
+#endif
+    return vr;
+}
+
+/** An empty @p mountPoint verifies the unmounted @p deviceNode instead (no change journal). */
+ManifestVerifyResult runVerify(const QString& deviceNode, const QString& mountPoint,
+                               const WatchManifest& manifest, const ManifestVerifyPolicy& policy,
+                               const std::optional<QSet<QString>>& touchedPaths,
+                               ManifestService::Progress* progress, SharedReadPass* sharedRead = nullptr)
+{
+    const auto vr = mountPoint.isEmpty()
+                        ? verifyUnmounted(deviceNode, manifest, policy, progress, sharedRead)
+                        : ManifestService::verifyManifest(mountPoint, manifest, policy,
+                                                          touchedPaths ? &*touchedPaths : nullptr, progress);
+    ManifestVerifyResult r = toWorkerResult(vr);
+    r.success = r.errorMessage.isEmpty() || r.filesChecked > 0 || !manifest.groups.isEmpty();
+    if (manifest.groups.isEmpty()) {
+        r.success = false;
+        r.errorMessage = QStringLiteral("No watch groups configured");
+    }
+    return r;
+}
+
+} // namespace
+
 struct ManifestWorker::JobState {
     Job config;
     std::unique_ptr<QFutureWatcher<ManifestVerifyResult>> verifyWatcher;
+    std::unique_ptr<QFutureWatcher<ManifestVerifyResult>> reportWatcher;
     std::unique_ptr<QFutureWatcher<WatchManifest>> buildWatcher;
+    std::unique_ptr<QFutureWatcher<ManifestBatchVerifyResult>> batchWatcher;
+    // Shared with the running task, which may outlive this state after a cancel.
+    std::shared_ptr<ManifestService::Progress> progress = std::make_shared<ManifestService::Progress>();
+    QElapsedTimer timer;
 };
 
 ManifestWorker::ManifestWorker(QObject* parent)
     : QObject(parent)
 {
+    ProgressHub::instance().addSource(this, [this]() { return progressSnapshot(); });
+}
+
+void ManifestWorker::insertJob(const QString& jobId, const std::shared_ptr<JobState>& state)
+{
+    state->timer.start();
+    {
+        QMutexLocker lock(&m_mutex);
+        m_jobs.insert(jobId, state);
+    }
+    ProgressHub::instance().wake();
 }
 
 QString ManifestWorker::startVerify(const QString& deviceNode, const QString& mountPoint,
-                                    const QString& deviceId, const WatchManifest& manifest)
+                                    const QString& deviceId, const WatchManifest& manifest,
+                                    const ManifestVerifyPolicy& policy,
+                                    std::optional<QSet<QString>> touchedPaths)
 {
     Job job;
     job.jobId = QUuid::createUuid().toString(QUuid::WithoutBraces);
@@ -29,7 +177,13 @@ QString ManifestWorker::startVerify(const QString& deviceNode, const QString& mo
     job.deviceId = deviceId;
     job.kind = JobKind::Verify;
     job.manifest = manifest;
+    job.policy = policy;
+    job.touchedPaths = std::move(touchedPaths);
+    return launchVerify(job);
+}
 
+QString ManifestWorker::launchVerify(const Job& job)
+{
     auto state = std::make_shared<JobState>();
     state->config = job;
     state->verifyWatcher = std::make_unique<QFutureWatcher<ManifestVerifyResult>>();
@@ -47,48 +201,79 @@ QString ManifestWorker::startVerify(const QString& deviceNode, const QString& mo
                 }
                 ManifestVerifyResult result = st->verifyWatcher->result();
                 result.deviceNode = st->config.deviceNode;
-                {
+                const bool report = result.success && !result.complete && st->config.policy.failFastReport;
+                if (!report) {
                     QMutexLocker lock(&m_mutex);
                     m_jobs.remove(jobId);
                 }
                 if (!result.success) {
                     emit manifestFailed(jobId, result.errorMessage);
-                } else {
-                    emit manifestCompleted(jobId, result);
+                    return;
+                }
+                emit manifestCompleted(jobId, result);
+                if (!report) {
+                    return;
                 }
+
+                // The decision is out; the full diff runs from a fresh listing for the report.
+                ManifestVerifyPolicy full = st->config.policy;
+                full.failFast = false;
+                st->reportWatcher = std::make_unique<QFutureWatcher<ManifestVerifyResult>>();
+                connect(st->reportWatcher.get(), &QFutureWatcher<ManifestVerifyResult>::finished, this,
+                        [this, jobId]() {
+                            std::shared_ptr<JobState> reported;
+                            {
+                                QMutexLocker lock(&m_mutex);
+                                reported = m_jobs.take(jobId);
+                            }
+                            if (!reported) {
+                                return;
+                            }
+                            ManifestVerifyResult fullResult = reported->reportWatcher->result();
+                            fullResult.deviceNode = reported->config.deviceNode;
+                            if (fullResult.success) {
+                                emit manifestReportReady(jobId, fullResult);
+                            }
+                        });
+                const Job& cfg = st->config;
+                st->reportWatcher->setFuture(IoScheduler::instance().run(
+                    ioTask(cfg.deviceNode, IoScheduler::Priority::Background),
+                    [deviceNode = cfg.deviceNode, mountPoint = cfg.mountPoint, manifest = cfg.manifest, full,
+                     touchedPaths = cfg.touchedPaths, progress = st->progress]() {
+                        return runVerify(deviceNode, mountPoint, manifest, full, touchedPaths, progress.get());
+                    }));
             });
 
-    const QFuture<ManifestVerifyResult> future = QtConcurrent::run(
-        [mountPoint, manifest]() {
-            auto vr = ManifestService::verifyManifest(mountPoint, manifest);
-            ManifestVerifyResult r;
-            r.success = vr.success;
-            r.matches = vr.matches;
-            r.computedRootHex = vr.computedRootHex;
-            r.expectedRootHex = vr.expectedRootHex;
-            r.changedPaths = vr.changedPaths;
-            r.missingPaths = vr.missingPaths;
-            r.addedPaths = vr.addedPaths;
-            r.errorMessage = vr.errorMessage;
-            r.filesChecked = vr.filesChecked;
-            r.durationMs = vr.durationMs;
-            r.success = r.errorMessage.isEmpty() || r.filesChecked > 0 || !manifest.groups.isEmpty();
-            if (manifest.groups.isEmpty()) {
-                r.success = false;
-                r.errorMessage = QStringLiteral("No watch groups configured");
-            }
-            return r;
+    // A manifest verify decides whether the stick is trusted on connect; it goes first.
+    const QFuture<ManifestVerifyResult> future = IoScheduler::instance().run(
+        ioTask(job.deviceNode, IoScheduler::Priority::Interactive),
+        [deviceNode = job.deviceNode, mountPoint = job.mountPoint, manifest = job.manifest, policy = job.policy,
+         touchedPaths = job.touchedPaths, sharedRead = job.sharedRead, progress = state->progress]() {
+            return runVerify(deviceNode, mountPoint, manifest, policy, touchedPaths, progress.get(),
+                             sharedRead.get());
         });
 
     state->verifyWatcher->setFuture(future);
-    {
-        QMutexLocker lock(&m_mutex);
-        m_jobs.insert(job.jobId, state);
-    }
-    emit manifestStarted(job.jobId, deviceNode);
+    insertJob(job.jobId, state);
+    emit manifestStarted(job.jobId, job.deviceNode);
     return job.jobId;
 }
 
+QString ManifestWorker::startVerifyUnmounted(const QString& deviceNode, const QString& deviceId,
+                                             const WatchManifest& manifest, const ManifestVerifyPolicy& policy,
+                                             std::shared_ptr<SharedReadPass> sharedRead)
+{
+    Job job;
+    job.jobId = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    job.deviceNode = deviceNode;
+    job.deviceId = deviceId;
+    job.kind = JobKind::Verify;
+    job.manifest = manifest;
+    job.policy = policy;
+    job.sharedRead = std::move(sharedRead);
+    return launchVerify(job);
+}
+
 QString ManifestWorker::startBuildBaseline(const QString& deviceNode, const QString& mountPoint,
                                            const QString& deviceId, const WatchManifest& spec)
 {
@@ -123,29 +308,117 @@ QString ManifestWorker::startBuildBaseline(const QString& deviceNode, const QStr
                 emit manifestBaselineBuilt(jobId, st->config.deviceId, built);
             });
 
-    const QFuture<WatchManifest> future = QtConcurrent::run([mountPoint, spec]() {
-        return ManifestService::rebuildManifestRoots(mountPoint, spec);
-    });
+    const QFuture<WatchManifest> future = IoScheduler::instance().run(
+        ioTask(deviceNode, IoScheduler::Priority::Background), [mountPoint, spec, progress = state->progress]() {
+            return ManifestService::rebuildManifestRoots(mountPoint, spec, progress.get());
+        });
 
     state->buildWatcher->setFuture(future);
-    {
-        QMutexLocker lock(&m_mutex);
-        m_jobs.insert(job.jobId, state);
-    }
+    insertJob(job.jobId, state);
     emit manifestStarted(job.jobId, deviceNode);
     return job.jobId;
 }
 
+QString ManifestWorker::startBatchVerify(const QStringList& deviceNodes, const QStringList& mountPoints,
+                                         const WatchManifest& manifest, const ManifestVerifyPolicy& policy)
+{
+    Job job;
+    job.jobId = QUuid::createUuid().toString(QUuid::WithoutBraces);
+    job.kind = JobKind::BatchVerify;
+    job.deviceNodes = deviceNodes;
+    job.mountPoints = mountPoints;
+    job.manifest = manifest;
+    job.policy = policy;
+    // One report per batch; there is no background full diff after a fail-fast stop.
+    job.policy.failFastReport = false;
+
+    auto state = std::make_shared<JobState>();
+    state->config = job;
+    state->batchWatcher = std::make_unique<QFutureWatcher<ManifestBatchVerifyResult>>();
+
+    connect(state->batchWatcher.get(), &QFutureWatcher<ManifestBatchVerifyResult>::finished, this,
+            [this, jobId = job.jobId]() {
+                std::shared_ptr<JobState> st;
+                {
+                    QMutexLocker lock(&m_mutex);
+                    st = m_jobs.take(jobId);
+                }
+                if (!st) {
+                    return;
+                }
+                emit manifestBatchCompleted(jobId, st->batchWatcher->result());
+            });
+
+    // Reads several sticks, so it holds no single lane; the I/O limit still applies.
+    const QFuture<ManifestBatchVerifyResult> future = IoScheduler::instance().run(
+        ioTask(QString(), IoScheduler::Priority::Normal),
+        [deviceNodes, mountPoints, manifest, policy = job.policy, progress = state->progress]() {
+            return runBatchVerify(deviceNodes, mountPoints, manifest, policy, progress.get());
+        });
+
+    state->batchWatcher->setFuture(future);
+    insertJob(job.jobId, state);
+    for (const QString& deviceNode : deviceNodes) {
+        emit manifestStarted(job.jobId, deviceNode);
+    }
+    return job.jobId;
+}
+
 bool ManifestWorker::cancelJob(const QString& jobId)
 {
-    QMutexLocker lock(&m_mutex);
-    return m_jobs.remove(jobId);
+    std::shared_ptr<JobState> state;
+    {
+        QMutexLocker lock(&m_mutex);
+        state = m_jobs.take(jobId);
+    }
+    if (!state) {
+        return false;
+    }
+    state->progress->cancelled.store(true);
+    emit manifestCancelled(jobId);
+    return true;
 }
 
 void ManifestWorker::cancelAll()
+{
+    QHash<QString, std::shared_ptr<JobState>> jobs;
+    {
+        QMutexLocker lock(&m_mutex);
+        jobs.swap(m_jobs);
+    }
+    for (auto it = jobs.cbegin(); it != jobs.cend(); ++it) {
+        it.value()->progress->cancelled.store(true);
+        emit manifestCancelled(it.key());
+    }
+}
+
+QList<ProgressSample> ManifestWorker::progressSnapshot() const
 {
     QMutexLocker lock(&m_mutex);
-    m_jobs.clear();
+    QList<ProgressSample> samples;
+    for (auto it = m_jobs.cbegin(); it != m_jobs.cend(); ++it) {
+        const ManifestService::Progress& p = *it.value()->progress;
+        ProgressSample s;
+        s.kind = ProgressSample::Kind::Manifest;
+        s.jobId = it.key();
+        s.bytesTotal = p.bytesTotal.load();
+        s.bytesDone = qMin<quint64>(p.bytesDone.load(), s.bytesTotal);
+        s.itemsDone = p.filesDone.load();
+        s.itemsTotal = p.filesTotal.load();
+        if (s.bytesTotal > 0) {
+            s.fraction = static_cast<double>(s.bytesDone) / static_cast<double>(s.bytesTotal);
+            const qint64 elapsedMs = it.value()->timer.elapsed();
+            if (elapsedMs > 100) {
+                s.speedMBps = (static_cast<double>(s.bytesDone) / (1024.0 * 1024.0))
+                    / (static_cast<double>(elapsedMs) / 1000.0);
+            }
+            if (s.speedMBps > 0.01 && s.bytesDone < s.bytesTotal) {
+                s.etaSeconds = static_cast<double>(s.bytesTotal - s.bytesDone) / (1024.0 * 1024.0) / s.speedMBps;
+            }
+        }
+        samples.append(s);
+    }
+    return samples;
 }
 
 } // namespace FlashSpartan
@@ -0,0 +1,342 @@
+#include "MemoryBudget.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QRegularExpression>
+
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <QSocketNotifier>
+
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(Q_OS_LINUX) && defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#ifdef Q_OS_WIN
+#include <QWinEventNotifier>
+
+#include <qt_windows.h>
+#include <psapi.h>
+#endif
+
+namespace FlashSpartan {
+
+namespace {
+
+#ifdef Q_OS_LINUX
+/** 200 ms of stalls within 2 s; unprivileged triggers need a window of whole 2 s steps. */
+constexpr char kPsiTrigger[] = "some 200000 2000000";
+/** Polled averages (percent of the last 10 s) when no trigger could be set. */
+constexpr double kPollModerateSome = 10.0;
+constexpr double kPollCriticalFull = 5.0;
+
+/** memory.pressure of this process's cgroup (v2), or the system-wide file. */
+QString pressurePath()
+{
+    QFile cgroup(QStringLiteral("/proc/self/cgroup"));
+    if (cgroup.open(QIODevice::ReadOnly)) {
+        for (const QByteArray& line : cgroup.readAll().split('\n')) {
+            if (line.startsWith("0::")) {
+                const QString path = QStringLiteral("/sys/fs/cgroup") + QString::fromUtf8(line.mid(3).trimmed())
+                                     + QStringLiteral("/memory.pressure");
+                if (QFile::exists(path)) {
+                    return path;
+                }
+            }
+        }
+    }
+    return QFile::exists(QStringLiteral("/proc/pressure/memory")) ? QStringLiteral("/proc/pressure/memory")
+                                                                 : QString();
+}
+
+double pressureAverage(const QByteArray& text, const char* kind)
+{
+    static const QRegularExpression avg10(QStringLiteral("avg10=([0-9.]+)"));
+    for (const QByteArray& line : text.split('\n')) {
+        if (line.startsWith(kind)) {
+            const QRegularExpressionMatch m = avg10.match(QString::fromLatin1(line));
+            return m.hasMatch() ? m.captured(1).toDouble() : 0.0;
+        }
+    }
+    return 0.0;
+}
+#endif
+
+int keepRank(MemoryBudget::Keep keep)
+{
+    return static_cast<int>(keep);
+}
+
+} // namespace
+
+MemoryBudget& MemoryBudget::instance()
+{
+    static MemoryBudget budget;
+    return budget;
+}
+
+MemoryBudget::MemoryBudget(QObject* parent)
+    : QObject(parent)
+{
+    m_timer.setInterval(kCheckIntervalMs);
+    connect(&m_timer, &QTimer::timeout, this, &MemoryBudget::check);
+}
+
+MemoryBudget::~MemoryBudget()
+{
+#ifdef Q_OS_LINUX
+    delete m_psiNotifier;
+    if (m_psiFd >= 0) {
+        ::close(m_psiFd);
+    }
+#endif
+#ifdef Q_OS_WIN
+    delete m_lowMemoryNotifier;
+    if (m_lowMemory) {
+        CloseHandle(static_cast<HANDLE>(m_lowMemory));
+    }
+#endif
+}
+
+int MemoryBudget::add(Consumer consumer)
+{
+    const int id = m_nextId++;
+    m_consumers.insert(id, std::move(consumer));
+    return id;
+}
+
+void MemoryBudget::remove(int id)
+{
+    m_consumers.remove(id);
+}
+
+void MemoryBudget::setLimit(qint64 bytes)
+{
+    m_limit = qMax<qint64>(0, bytes);
+    if (m_started) {
+        check();
+    }
+}
+
+QList<MemoryBudget::Usage> MemoryBudget::usage() const
+{
+    QList<Usage> out;
+    for (const Consumer& c : m_consumers) {
+        out.append({c.name, c.usage ? qMax<qint64>(0, c.usage()) : 0});
+    }
+    return out;
+}
+
+qint64 MemoryBudget::totalUsage() const
+{
+    qint64 total = 0;
+    for (const Usage& u : usage()) {
+        total += u.bytes;
+    }
+    return total;
+}
+
+QList<MemoryBudget::Consumer> MemoryBudget::ordered() const
+{
+    QList<Consumer> out = m_consumers.values();  // by id: registration order within a rank
+    std::stable_sort(out.begin(), out.end(),
+                     [](const Consumer& a, const Consumer& b) { return keepRank(a.keep) < keepRank(b.keep); });
+    return out;
+}
+
+qint64 MemoryBudget::reclaim(qint64 bytes)
+{
+    qint64 total = 0;
+    for (const Consumer& c : ordered()) {
+        if (total >= bytes) {
+            break;
+        }
+        if (!c.usage || !c.shrink) {
+            continue;
+        }
+        const qint64 before = c.usage();
+        if (before <= 0) {
+            continue;
+        }
+        c.shrink(qMax<qint64>(0, before - (bytes - total)));
+        total += qMax<qint64>(0, before - c.usage());
+    }
+    if (total > 0) {
+        releaseFreeHeap();
+    }
+    return total;
+}
+
+void MemoryBudget::relieve(Pressure pressure)
+{
+    setPressure(pressure);
+    if (pressure == Pressure::None) {
+        return;
+    }
+    qint64 total = 0;
+    for (const Consumer& c : ordered()) {
+        if (!c.usage || !c.shrink) {
+            continue;
+        }
+        const qint64 before = c.usage();
+        if (before <= 0) {
+            continue;
+        }
+        qint64 target = before;
+        switch (c.keep) {
+            case Keep::Low:
+                target = 0;
+                break;
+            case Keep::Normal:
+                target = pressure == Pressure::Critical ? 0 : before / 2;
+                break;
+            case Keep::High:
+                target = pressure == Pressure::Critical ? before / 2 : before;
+                break;
+        }
+        if (target < before) {
+            c.shrink(target);
+            total += qMax<qint64>(0, before - c.usage());
+        }
+    }
+    if (total > 0) {
+        releaseFreeHeap();
+        emit reclaimed(total, QStringLiteral("pressure"));
+    }
+}
+
+void MemoryBudget::check()
+{
+#ifdef Q_OS_LINUX
+    if (m_psiFd < 0 && !m_psiPath.isEmpty()) {
+        QFile file(m_psiPath);
+        if (file.open(QIODevice::ReadOnly)) {
+            const QByteArray text = file.readAll();
+            if (pressureAverage(text, "full") >= kPollCriticalFull) {
+                relieve(Pressure::Critical);
+            } else if (pressureAverage(text, "some") >= kPollModerateSome) {
+                relieve(Pressure::Moderate);
+            } else {
+                setPressure(Pressure::None);
+            }
+        }
+    }
+#endif
+    // Event-driven pressure ends when the OS has been quiet for a while.
+    if (m_pressure != Pressure::None && m_lastSignalMs > 0
+        && QDateTime::currentMSecsSinceEpoch() - m_lastSignalMs >= kEscalateMs) {
+        setPressure(Pressure::None);
+    }
+
+    if (m_limit <= 0) {
+        return;
+    }
+    const qint64 resident = m_residentProbe ? m_residentProbe() : residentBytes();
+    if (resident <= m_limit) {
+        return;
+    }
+    const qint64 got = reclaim(resident - qint64(double(m_limit) * kHeadroom));
+    if (got > 0) {
+        emit reclaimed(got, QStringLiteral("limit"));
+    }
+}
+
+void MemoryBudget::start()
+{
+    if (m_started) {
+        return;
+    }
+    m_started = true;
+    m_timer.start();
+
+#ifdef Q_OS_LINUX
+    m_psiPath = pressurePath();
+    if (!m_psiPath.isEmpty()) {
+        const QByteArray path = QFile::encodeName(m_psiPath);
+        m_psiFd = ::open(path.constData(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (m_psiFd >= 0 && ::write(m_psiFd, kPsiTrigger, sizeof(kPsiTrigger)) < 0) {
+            ::close(m_psiFd);  // no trigger support or permission: check() polls the averages
+            m_psiFd = -1;
+        }
+        if (m_psiFd >= 0) {
+            // The kernel signals a trigger as POLLPRI.
+            m_psiNotifier = new QSocketNotifier(m_psiFd, QSocketNotifier::Exception);
+            connect(m_psiNotifier, &QSocketNotifier::activated, this, &MemoryBudget::onPressureSignal);
+        }
+    }
+#endif
+#ifdef Q_OS_WIN
+    HANDLE handle = CreateMemoryResourceNotification(LowMemoryResourceNotification);
+    if (handle) {
+        m_lowMemory = handle;
+        auto* notifier = new QWinEventNotifier(handle);
+        m_lowMemoryNotifier = notifier;
+        connect(notifier, &QWinEventNotifier::activated, this, [this, notifier]() {
+            // The event stays signalled while memory is low; look again after a check interval.
+            notifier->setEnabled(false);
+            onPressureSignal();
+            QTimer::singleShot(kCheckIntervalMs, notifier, [notifier]() { notifier->setEnabled(true); });
+        });
+    }
+#endif
+    check();
+}
+
+void MemoryBudget::onPressureSignal()
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const bool repeated = m_pressure != Pressure::None && now - m_lastSignalMs < kEscalateMs;
+    m_lastSignalMs = now;
+#ifdef Q_OS_WIN
+    // Windows only says so when memory is already low.
+    relieve(Pressure::Critical);
+#else
+    relieve(repeated ? Pressure::Critical : Pressure::Moderate);
+#endif
+}
+
+void MemoryBudget::setPressure(Pressure pressure)
+{
+    if (pressure != m_pressure) {
+        m_pressure = pressure;
+        emit pressureChanged(pressure);
+    }
+}
+
+void MemoryBudget::setResidentProbe(std::function<qint64()> probe)
+{
+    m_residentProbe = std::move(probe);
+}
+
+qint64 MemoryBudget::residentBytes()
+{
+#if defined(Q_OS_LINUX)
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (!statm.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.size() > 1 ? fields.at(1).toLongLong() * ::sysconf(_SC_PAGESIZE) : 0;
+#elif defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return static_cast<qint64>(counters.WorkingSetSize);
+#else
+    return 0;
+#endif
+}
+
+void MemoryBudget::releaseFreeHeap()
+{
+#if defined(Q_OS_LINUX) && defined(__GLIBC__)
+    // Freed cache entries otherwise stay in malloc's arenas and in the resident set.
+    malloc_trim(0);
+#endif
+}
+
+} // namespace FlashSpartan
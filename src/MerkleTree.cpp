@@ -1,43 +1,147 @@
 #include "MerkleTree.h"
+#include "DigestContextPool.h"
+#include "HexEncoding.h"
 
 #include <openssl/evp.h>
 
 #include <algorithm>
+#include <cstring>
+#include <vector>
 
 namespace FlashSpartan {
 
 namespace {
 
-QByteArray sha256(const QByteArray& data)
+constexpr int kDigestBytes = 32;  // SHA-256
+constexpr char kLeafPrefix = '\x00';
+constexpr char kNodePrefix = '\x01';
+/** Leaves per digest batch when only the root is kept. */
+constexpr size_t kStreamLeaves = 16 * DigestContextPool::kMinMessagesPerThread;
+
+QByteArray sha256(const char* data, size_t size)
 {
     unsigned char hash[EVP_MAX_MD_SIZE];
     unsigned int len = 0;
-    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
-    if (!ctx) {
-        return {};
-    }
-    if (EVP_DigestInit_ex(ctx, EVP_sha256(), nullptr) != 1
-        || EVP_DigestUpdate(ctx, data.constData(), static_cast<size_t>(data.size())) != 1
-        || EVP_DigestFinal_ex(ctx, hash, &len) != 1) {
-        EVP_MD_CTX_free(ctx);
+    if (!DigestContextPool::digest(DigestContextPool::sha256(), data, size, hash, &len)) {
         return {};
     }
-    EVP_MD_CTX_free(ctx);
     return QByteArray(reinterpret_cast<const char*>(hash), static_cast<int>(len));
 }
 
 QByteArray sha256HexPair(const QByteArray& leftBin, const QByteArray& rightBin)
 {
-    const QByteArray payload = leftBin.toHex() + rightBin.toHex();
-    return sha256(payload);
+    // Combines run once per interior node; keep the hex payload on the stack.
+    const size_t leftLen = static_cast<size_t>(leftBin.size());
+    const size_t rightLen = static_cast<size_t>(rightBin.size());
+    if (leftLen + rightLen > HexEncoding::kMaxDigestHexChars) {
+        const QByteArray payload = leftBin.toHex() + rightBin.toHex();
+        return sha256(payload.constData(), static_cast<size_t>(payload.size()));
+    }
+    char payload[2 * HexEncoding::kMaxDigestHexChars];
+    char* end = HexEncoding::encode(reinterpret_cast<const unsigned char*>(leftBin.constData()),
+                                    leftLen, payload);
+    end = HexEncoding::encode(reinterpret_cast<const unsigned char*>(rightBin.constData()),
+                              rightLen, end);
+    return sha256(payload, static_cast<size_t>(end - payload));
 }
 
+QByteArray leafPayload(const QString& relativePath, const QString& contentHashHex, MerkleFormat format)
+{
+    QByteArray payload;
+    if (format == MerkleFormat::V2) {
+        payload.append(kLeafPrefix);
+    }
+    return payload + relativePath.toUtf8() + '\0' + contentHashHex.toLatin1();
+}
+
+/**
+ * V2 root without the levels: each level keeps only its unfinished node (the prefix and
+ * fewer than fanOut children), so memory is O(fanOut log n) whatever the leaf count.
+ */
+class RootStream {
+public:
+    explicit RootStream(int fanOut)
+        : m_nodeBytes(1 + static_cast<qsizetype>(fanOut) * kDigestBytes)
+    {
+    }
+
+    bool push(const unsigned char* digest) { return push(0, digest); }
+
+    /** Closes every unfinished node bottom-up, as build() does with each level's last one. */
+    QByteArray finish()
+    {
+        for (size_t level = 0; level < m_levels.size(); ++level) {
+            const qsizetype children = (m_levels[level].node.size() - 1) / kDigestBytes;
+            if (m_levels[level].pushed == 1) {
+                return m_levels[level].node.mid(1);
+            }
+            if (children == 0) {
+                continue;
+            }
+            const QByteArray up = children == 1
+                                      ? m_levels[level].node.mid(1)
+                                      : sha256(m_levels[level].node.constData(),
+                                               static_cast<size_t>(m_levels[level].node.size()));
+            m_levels[level].node.truncate(1);
+            if (up.size() != kDigestBytes
+                || !push(level + 1, reinterpret_cast<const unsigned char*>(up.constData()))) {
+                return {};
+            }
+        }
+        return {};
+    }
+
+private:
+    struct Level {
+        QByteArray node;
+        quint64 pushed = 0;
+    };
+
+    bool push(size_t level, const unsigned char* digest)
+    {
+        unsigned char carry[EVP_MAX_MD_SIZE];
+        std::memcpy(carry, digest, kDigestBytes);
+        for (;; ++level) {
+            if (level == m_levels.size()) {
+                m_levels.push_back({QByteArray(1, kNodePrefix), 0});
+                m_levels.back().node.reserve(m_nodeBytes);
+            }
+            Level& l = m_levels[level];
+            l.node.append(reinterpret_cast<const char*>(carry), kDigestBytes);
+            ++l.pushed;
+            if (l.node.size() < m_nodeBytes) {
+                return true;
+            }
+            unsigned int len = 0;
+            if (!DigestContextPool::digest(DigestContextPool::sha256(), l.node.constData(),
+                                           static_cast<size_t>(l.node.size()), carry, &len)) {
+                return false;
+            }
+            l.node.truncate(1);
+        }
+    }
+
+    qsizetype m_nodeBytes;
+    std::vector<Level> m_levels;
+};
+
 } // namespace
 
-QByteArray MerkleTree::leafDigest(const QString& relativePath, const QString& contentHashHex)
+bool MerkleShape::isValid() const
 {
-    const QByteArray payload = relativePath.toUtf8() + '\0' + contentHashHex.toLatin1();
-    return sha256(payload);
+    switch (format) {
+    case MerkleFormat::V1:
+        return fanOut == 2;
+    case MerkleFormat::V2:
+        return fanOut >= 2 && fanOut <= MerkleTree::kMaxFanOut;
+    }
+    return false;
+}
+
+QByteArray MerkleTree::leafDigest(const QString& relativePath, const QString& contentHashHex, Format format)
+{
+    const QByteArray payload = leafPayload(relativePath, contentHashHex, format);
+    return sha256(payload.constData(), static_cast<size_t>(payload.size()));
 }
 
 QByteArray MerkleTree::combine(const QByteArray& left, const QByteArray& right)
@@ -45,56 +149,287 @@ QByteArray MerkleTree::combine(const QByteArray& left, const QByteArray& right)
     return sha256HexPair(left, right);
 }
 
+QByteArray MerkleTree::combineChildren(const QByteArray& children)
+{
+    char payload[1 + kMaxFanOut * kDigestBytes];
+    if (children.size() >= qsizetype(sizeof(payload))) {
+        const QByteArray joined = kNodePrefix + children;
+        return sha256(joined.constData(), static_cast<size_t>(joined.size()));
+    }
+    payload[0] = kNodePrefix;
+    std::memcpy(payload + 1, children.constData(), static_cast<size_t>(children.size()));
+    return sha256(payload, static_cast<size_t>(children.size()) + 1);
+}
+
 QString MerkleTree::toHex(const QByteArray& data)
 {
-    return QString::fromLatin1(data.toHex());
+    return HexEncoding::toString(data);
 }
 
-MerkleTree MerkleTree::build(const QVector<Leaf>& leaves)
+MerkleTree MerkleTree::build(const QVector<Leaf>& leaves, Shape shape)
 {
     QVector<Leaf> sorted = leaves;
     std::sort(sorted.begin(), sorted.end(), [](const Leaf& a, const Leaf& b) {
         return a.relativePath < b.relativePath;
     });
 
-    for (Leaf& leaf : sorted) {
-        leaf.digest = leafDigest(leaf.relativePath, leaf.contentHashHex);
+    if (sorted.isEmpty() || !shape.isValid()) {
+        return MerkleTree(std::move(sorted), {}, QString(), shape);
     }
 
-    if (sorted.isEmpty()) {
-        return MerkleTree({}, QString());
+    // Same digests as leafDigest() and combine()/combineChildren(), but every leaf and then
+    // every level is hashed as one batch into a contiguous array of kDigestBytes digests.
+    const size_t leafCount = static_cast<size_t>(sorted.size());
+    std::vector<QByteArray> payloads;
+    std::vector<DigestContextPool::Message> messages;
+    payloads.reserve(leafCount);
+    messages.reserve(leafCount);
+    for (const Leaf& leaf : sorted) {
+        payloads.push_back(leafPayload(leaf.relativePath, leaf.contentHashHex, shape.format));
+        messages.push_back({payloads.back().constData(), static_cast<size_t>(payloads.back().size())});
     }
 
-    QVector<QByteArray> level;
-    level.reserve(sorted.size());
-    for (const Leaf& leaf : sorted) {
-        level.append(leaf.digest);
+    QByteArray level(static_cast<qsizetype>(leafCount) * kDigestBytes, Qt::Uninitialized);
+    auto digests = [](QByteArray& bytes) {
+        return reinterpret_cast<unsigned char*>(bytes.data());
+    };
+    if (!DigestContextPool::digestBatch(DigestContextPool::sha256(), messages.data(), leafCount,
+                                        digests(level))) {
+        return MerkleTree(std::move(sorted), {}, QString(), shape);
+    }
+    payloads.clear();
+    for (size_t i = 0; i < leafCount; ++i) {
+        sorted[static_cast<qsizetype>(i)].digest = level.mid(static_cast<qsizetype>(i) * kDigestBytes,
+                                                             kDigestBytes);
     }
 
-    while (level.size() > 1) {
-        QVector<QByteArray> next;
-        next.reserve((level.size() + 1) / 2);
-        for (int i = 0; i < level.size(); i += 2) {
-            if (i + 1 < level.size()) {
-                next.append(combine(level[i], level[i + 1]));
+    QVector<QByteArray> levels{level};
+    const size_t fanOut = static_cast<size_t>(shape.fanOut);
+    // V1 hexes a pair of children; V2 is the prefix then up to fanOut raw children.
+    const size_t stride = shape.format == Format::V1 ? 4 * kDigestBytes : 1 + fanOut * kDigestBytes;
+    std::vector<char> nodes;
+    size_t count = leafCount;
+    while (count > 1) {
+        const size_t parents = (count + fanOut - 1) / fanOut;
+        // A lone last child in V2 moves up as it is.
+        const size_t lone = shape.format == Format::V2 && count % fanOut == 1 ? 1 : 0;
+        const size_t hashed = parents - lone;
+        nodes.resize(hashed * stride);
+        messages.resize(hashed);
+        const auto* children = reinterpret_cast<const unsigned char*>(level.constData());
+        for (size_t p = 0; p < hashed; ++p) {
+            char* node = nodes.data() + p * stride;
+            if (shape.format == Format::V1) {
+                const size_t left = 2 * p;
+                const size_t right = std::min(left + 1, count - 1);  // odd node pairs with itself
+                char* end = HexEncoding::encode(children + left * kDigestBytes, kDigestBytes, node);
+                HexEncoding::encode(children + right * kDigestBytes, kDigestBytes, end);
+                messages[p] = {node, stride};
             } else {
-                next.append(combine(level[i], level[i]));
+                const size_t first = p * fanOut;
+                const size_t n = std::min(fanOut, count - first);
+                node[0] = kNodePrefix;
+                std::memcpy(node + 1, children + first * kDigestBytes, n * kDigestBytes);
+                messages[p] = {node, 1 + n * kDigestBytes};
             }
         }
+        QByteArray next(static_cast<qsizetype>(parents) * kDigestBytes, Qt::Uninitialized);
+        if (!DigestContextPool::digestBatch(DigestContextPool::sha256(), messages.data(), hashed,
+                                            digests(next))) {
+            return MerkleTree(std::move(sorted), {}, QString(), shape);
+        }
+        if (lone) {
+            std::memcpy(digests(next) + hashed * kDigestBytes, children + (count - 1) * kDigestBytes,
+                        kDigestBytes);
+        }
+        levels.append(next);
         level = std::move(next);
+        count = parents;
     }
 
-    return MerkleTree(std::move(sorted), toHex(level.first()));
+    const QString root = toHex(level);
+    return MerkleTree(std::move(sorted), std::move(levels), root, shape);
 }
 
-QString MerkleTree::rootHex(const QVector<Leaf>& leaves)
+QString MerkleTree::rootHex(const QVector<Leaf>& leaves, Shape shape)
 {
-    return build(leaves).rootHex();
+    if (shape.format != Format::V2 || !shape.isValid()) {
+        return build(leaves, shape).rootHex();
+    }
+
+    std::vector<const Leaf*> sorted;
+    sorted.reserve(static_cast<size_t>(leaves.size()));
+    for (const Leaf& leaf : leaves) {
+        sorted.push_back(&leaf);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Leaf* a, const Leaf* b) {
+        return a->relativePath < b->relativePath;
+    });
+
+    // Leaves are still hashed in batches; only the interior levels are never materialized.
+    RootStream stream(shape.fanOut);
+    std::vector<QByteArray> payloads;
+    std::vector<DigestContextPool::Message> messages;
+    std::vector<unsigned char> block;
+    for (size_t first = 0; first < sorted.size(); first += kStreamLeaves) {
+        const size_t n = std::min(kStreamLeaves, sorted.size() - first);
+        payloads.clear();
+        messages.clear();
+        for (size_t i = first; i < first + n; ++i) {
+            payloads.push_back(leafPayload(sorted[i]->relativePath, sorted[i]->contentHashHex, Format::V2));
+            messages.push_back({payloads.back().constData(), static_cast<size_t>(payloads.back().size())});
+        }
+        block.resize(n * kDigestBytes);
+        if (!DigestContextPool::digestBatch(DigestContextPool::sha256(), messages.data(), n, block.data())) {
+            return {};
+        }
+        for (size_t i = 0; i < n; ++i) {
+            if (!stream.push(block.data() + i * kDigestBytes)) {
+                return {};
+            }
+        }
+    }
+    const QByteArray root = stream.finish();
+    return root.isEmpty() ? QString() : toHex(root);
+}
+
+qsizetype MerkleTree::indexOf(const QString& relativePath) const
+{
+    const auto it = std::lower_bound(m_leaves.cbegin(), m_leaves.cend(), relativePath,
+                                     [](const Leaf& leaf, const QString& path) {
+                                         return leaf.relativePath < path;
+                                     });
+    if (it == m_leaves.cend() || it->relativePath != relativePath) {
+        return -1;
+    }
+    return it - m_leaves.cbegin();
+}
+
+QByteArray MerkleTree::parentDigest(const QByteArray& children, size_t count, size_t parent) const
+{
+    if (m_shape.format == Format::V1) {
+        const size_t left = 2 * parent;
+        const size_t right = std::min(left + 1, count - 1);
+        return sha256HexPair(children.mid(static_cast<qsizetype>(left) * kDigestBytes, kDigestBytes),
+                             children.mid(static_cast<qsizetype>(right) * kDigestBytes, kDigestBytes));
+    }
+    const size_t fanOut = static_cast<size_t>(m_shape.fanOut);
+    const size_t first = parent * fanOut;
+    const size_t n = std::min(fanOut, count - first);
+    const QByteArray span = children.mid(static_cast<qsizetype>(first) * kDigestBytes,
+                                         static_cast<qsizetype>(n) * kDigestBytes);
+    return n == 1 ? span : combineChildren(span);
+}
+
+bool MerkleTree::updateLeaves(const QVector<Leaf>& changed)
+{
+    if (m_levels.isEmpty()) {
+        return false;
+    }
+    std::vector<size_t> dirty;
+    dirty.reserve(static_cast<size_t>(changed.size()));
+    for (const Leaf& update : changed) {
+        const qsizetype index = indexOf(update.relativePath);
+        if (index < 0) {
+            return false;
+        }
+        dirty.push_back(static_cast<size_t>(index));
+    }
+    // Every path is resolved above, so an unknown one leaves the tree untouched.
+    for (qsizetype k = 0; k < changed.size(); ++k) {
+        Leaf& leaf = m_leaves[static_cast<qsizetype>(dirty[static_cast<size_t>(k)])];
+        leaf.contentHashHex = changed.at(k).contentHashHex;
+        leaf.digest = leafDigest(leaf.relativePath, leaf.contentHashHex, m_shape.format);
+        if (leaf.digest.size() != kDigestBytes) {
+            return false;
+        }
+        std::copy(leaf.digest.cbegin(), leaf.digest.cend(),
+                  m_levels[0].begin() + static_cast<qsizetype>(dirty[static_cast<size_t>(k)]) * kDigestBytes);
+    }
+
+    // Walk up: each level recomputes only the parents of nodes that changed below it.
+    const size_t fanOut = static_cast<size_t>(m_shape.fanOut);
+    for (qsizetype l = 0; l + 1 < m_levels.size(); ++l) {
+        const size_t count = static_cast<size_t>(m_levels.at(l).size() / kDigestBytes);
+        for (size_t& index : dirty) {
+            index /= fanOut;
+        }
+        std::sort(dirty.begin(), dirty.end());
+        dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+        const QByteArray& children = m_levels.at(l);
+        QByteArray& parents = m_levels[l + 1];
+        for (size_t p : dirty) {
+            const QByteArray node = parentDigest(children, count, p);
+            if (node.size() != kDigestBytes) {
+                return false;
+            }
+            std::copy(node.cbegin(), node.cend(), parents.begin() + static_cast<qsizetype>(p) * kDigestBytes);
+        }
+    }
+
+    m_rootHex = toHex(m_levels.last());
+    return true;
+}
+
+QVector<MerkleTree::ProofStep> MerkleTree::inclusionProof(const QString& relativePath) const
+{
+    QVector<ProofStep> proof;
+    qsizetype index = indexOf(relativePath);
+    if (index < 0 || m_levels.isEmpty()) {
+        return proof;
+    }
+    const qsizetype fanOut = m_shape.fanOut;
+    for (qsizetype l = 0; l + 1 < m_levels.size(); ++l) {
+        const QByteArray& level = m_levels.at(l);
+        const qsizetype count = level.size() / kDigestBytes;
+        ProofStep step;
+        if (m_shape.format == Format::V1) {
+            if (index % 2 == 0) {
+                step.after = level.mid(qMin(index + 1, count - 1) * kDigestBytes, kDigestBytes);
+            } else {
+                step.before = level.mid((index - 1) * kDigestBytes, kDigestBytes);
+            }
+        } else {
+            const qsizetype first = index / fanOut * fanOut;
+            const qsizetype end = qMin(first + fanOut, count);
+            step.before = level.mid(first * kDigestBytes, (index - first) * kDigestBytes);
+            step.after = level.mid((index + 1) * kDigestBytes, (end - index - 1) * kDigestBytes);
+        }
+        proof.append(step);
+        index /= fanOut;
+    }
+    return proof;
+}
+
+bool MerkleTree::verifyInclusion(const QString& relativePath, const QString& contentHashHex,
+                                 const QVector<ProofStep>& proof, const QString& rootHex, Shape shape)
+{
+    if (!shape.isValid()) {
+        return false;
+    }
+    QByteArray node = leafDigest(relativePath, contentHashHex, shape.format);
+    for (const ProofStep& step : proof) {
+        const qsizetype others = step.before.size() + step.after.size();
+        if (shape.format == Format::V1) {
+            if (others != kDigestBytes) {
+                return false;
+            }
+            node = step.after.isEmpty() ? combine(step.before, node) : combine(node, step.after);
+        } else if (others > 0) {
+            if (others % kDigestBytes != 0 || others / kDigestBytes >= shape.fanOut) {
+                return false;
+            }
+            node = combineChildren(step.before + node + step.after);
+        }
+    }
+    return !node.isEmpty() && toHex(node) == rootHex;
 }
 
-MerkleTree::MerkleTree(QVector<Leaf> leaves, QString rootHex)
+MerkleTree::MerkleTree(QVector<Leaf> leaves, QVector<QByteArray> levels, QString rootHex, Shape shape)
     : m_leaves(std::move(leaves))
+    , m_levels(std::move(levels))
     , m_rootHex(std::move(rootHex))
+    , m_shape(shape)
 {
 }
 
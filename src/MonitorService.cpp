@@ -0,0 +1,517 @@
+#include "MonitorService.h"
+
+#include "AuditLog.h"
+#include "BadUsbBaselineStore.h"
+#include "BlockedDriveStore.h"
+#include "DatabaseManager.h"
+#include "DeviceMonitor.h"
+#include "HashWorker.h"
+#include "HeadlessPlan.h"
+#include "HidDeviceMonitor.h"
+#include "IsoScanRules.h"
+#include "IsoVerifier.h"
+#include "IsoVerifierWorker.h"
+#include "ManifestWorker.h"
+#include "ReadHealth.h"
+#include "policy/PolicyGateway.h"
+#include "policy/PolicyServiceLocator.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QSettings>
+#include <QSocketNotifier>
+#include <QStandardPaths>
+
+#ifndef Q_OS_WIN
+#include "MountTable.h"
+
+#include <unistd.h>
+#endif
+
+namespace FlashSpartan {
+
+namespace {
+
+struct HeadlessSettings {
+    bool autoHashOnConnect = true;
+    bool isoAutoVerifyOnUsbMount = false;
+    QString algorithm = QStringLiteral("SHA256");
+    int bufferSizeKB = 1024;
+    int maxConcurrent = 2;
+};
+
+/** The subset of the GUI's settings an unattended run acts on. */
+HeadlessSettings loadHeadlessSettings()
+{
+    QSettings settings(QStringLiteral("flashspartan"), QStringLiteral("FlashSpartan"));
+    HeadlessSettings s;
+    s.autoHashOnConnect = settings.value(QStringLiteral("security/autoHashOnConnect"), s.autoHashOnConnect).toBool();
+    s.isoAutoVerifyOnUsbMount =
+        settings.value(QStringLiteral("iso/autoVerifyOnUsbMount"), s.isoAutoVerifyOnUsbMount).toBool();
+    s.algorithm = settings.value(QStringLiteral("hashing/algorithm"), s.algorithm).toString();
+    s.bufferSizeKB = settings.value(QStringLiteral("hashing/bufferSizeKB"), s.bufferSizeKB).toInt();
+    s.maxConcurrent = settings.value(QStringLiteral("hashing/maxConcurrent"), s.maxConcurrent).toInt();
+    return s;
+}
+
+QString driveKey(const DeviceInfo& device)
+{
+    if (!device.parentDevice.isEmpty()) {
+        return device.parentDevice;
+    }
+#ifdef Q_OS_WIN
+    return QDir::toNativeSeparators(device.deviceNode).trimmed().toUpper();
+#else
+    return device.deviceNode.section(QLatin1Char('/'), -1);
+#endif
+}
+
+} // namespace
+
+MonitorService::MonitorService(QObject* parent)
+    : QObject(parent)
+{
+    connect(&m_server, &QLocalServer::newConnection, this, &MonitorService::onNewConnection);
+}
+
+MonitorService::~MonitorService()
+{
+    stop();
+}
+
+QString MonitorService::socketPath()
+{
+    QString runtime = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (runtime.isEmpty()) {
+        runtime = QStandardPaths::writableLocation(QStandardPaths::TempLocation);
+    }
+    return runtime + QStringLiteral("/flashspartan-monitor.sock");
+}
+
+bool MonitorService::isListening()
+{
+    QLocalSocket socket;
+    socket.connectToServer(socketPath());
+    return socket.waitForConnected(500);
+}
+
+bool MonitorService::start(QString* error)
+{
+    if (m_running) {
+        return true;
+    }
+    if (!Policy::PolicyServiceLocator::hasGateway()) {
+        Policy::PolicyServiceLocator::install(Policy::PolicyGateway::createDefault());
+    }
+
+    m_database = std::make_unique<DatabaseManager>(this);
+    if (!m_database->initialize()) {
+        if (error) {
+            *error = QStringLiteral("Could not open the device database at %1").arg(m_database->databasePath());
+        }
+        return false;
+    }
+    BlockedDriveStore::instance().refreshFromGateway();
+    m_badUsbBaselineStore = std::make_unique<BadUsbBaselineStore>(this);
+    m_badUsbBaselineStore->initialize();
+
+    const HeadlessSettings settings = loadHeadlessSettings();
+    m_hashWorker = std::make_unique<HashWorker>(this);
+    m_hashWorker->setMaxConcurrent(settings.maxConcurrent);
+    m_manifestWorker = std::make_unique<ManifestWorker>(this);
+    m_isoWorker = std::make_unique<IsoVerifierWorker>(this);
+
+    connect(m_hashWorker.get(), &HashWorker::hashCompleted, this,
+            [this](const QString& jobId, const HashResult& result) {
+                const QString node = m_jobDevices.take(jobId);
+                const auto it = m_devices.constFind(node);
+                if (it == m_devices.cend()) {
+                    return;
+                }
+                const bool matches = m_database->verifyHash(it->info, result.hash);
+                if (matches) {
+                    m_database->updateLastSeen(m_database->canonicalUniqueId(it->info));
+                }
+                const auto record = m_database->getDevice(it->info);
+                if (record && ReadHealth::isAssessable(result)) {
+                    const QList<ReadFinding> findings = ReadHealth::assess(record->readProfile, result);
+                    m_database->updateReadProfile(record->uniqueId,
+                                                  ReadHealth::advance(record->readProfile, result, findings));
+                    for (const ReadFinding& finding : findings) {
+                        qWarning().noquote() << "headless: read health:" << node << readAnomalyName(finding.kind)
+                                             << "-" << finding.detail;
+                    }
+                }
+                setVerdict(node, matches ? QStringLiteral("verified") : QStringLiteral("modified"),
+                           QStringLiteral("%1 %2").arg(result.algorithm, result.hash),
+                           PerfMetrics::ConnectStage::HashVerdict);
+            });
+    connect(m_hashWorker.get(), &HashWorker::hashFailed, this,
+            [this](const QString& jobId, const QString& message) {
+                setVerdict(m_jobDevices.take(jobId), QStringLiteral("error"), message,
+                           PerfMetrics::ConnectStage::HashVerdict);
+            });
+    connect(m_manifestWorker.get(), &ManifestWorker::manifestCompleted, this,
+            [this](const QString& jobId, const ManifestVerifyResult& result) {
+                const QString node = m_jobDevices.take(jobId);
+                constexpr auto stage = PerfMetrics::ConnectStage::ManifestVerdict;
+                if (!result.success) {
+                    setVerdict(node, QStringLiteral("error"), result.errorMessage, stage);
+                } else if (result.matches) {
+                    setVerdict(node, QStringLiteral("verified"), {}, stage);
+                } else {
+                    setVerdict(node, QStringLiteral("modified"), result.changedPaths.join(QStringLiteral(", ")), stage);
+                }
+            });
+    connect(m_manifestWorker.get(), &ManifestWorker::manifestFailed, this,
+            [this](const QString& jobId, const QString& message) {
+                setVerdict(m_jobDevices.take(jobId), QStringLiteral("error"), message,
+                           PerfMetrics::ConnectStage::ManifestVerdict);
+            });
+    connect(m_isoWorker.get(), &IsoVerifierWorker::verificationFinished, this,
+            [this](const QString& mountPoint, const QString& deviceNode, const QList<IsoVerifyResult>& results,
+                   const QString& jobId) {
+                m_jobDevices.remove(jobId);
+                QJsonObject payload;  // each image is already in the audit log
+                payload[QStringLiteral("device_node")] = deviceNode;
+                payload[QStringLiteral("mount_point")] = mountPoint;
+                payload[QStringLiteral("images")] = int(results.size());
+                payload[QStringLiteral("failed")] = IsoVerifier::mountScanHasFailures(results);
+                if (const auto it = m_devices.find(deviceNode); it != m_devices.end()) {
+                    noteLatency(*it, PerfMetrics::ConnectStage::IsoVerdict, payload);
+                }
+                publish(QStringLiteral("iso_verified"), payload);
+            });
+    connect(m_isoWorker.get(), &IsoVerifierWorker::verificationFailed, this,
+            [this](const QString& mountPoint, const QString& message, const QString& jobId) {
+                const QString deviceNode = m_jobDevices.take(jobId);
+                QJsonObject payload;
+                payload[QStringLiteral("device_node")] = deviceNode;
+                payload[QStringLiteral("mount_point")] = mountPoint;
+                payload[QStringLiteral("error")] = message;
+                if (const auto it = m_devices.find(deviceNode); it != m_devices.end()) {
+                    noteLatency(*it, PerfMetrics::ConnectStage::IsoVerdict, payload);
+                }
+                publish(QStringLiteral("iso_failed"), payload);
+            });
+
+    QLocalServer::removeServer(socketPath());
+    m_server.setSocketOptions(QLocalServer::UserAccessOption);
+    if (!m_server.listen(socketPath())) {
+        if (error) {
+            *error = m_server.errorString();
+        }
+        return false;
+    }
+
+    m_deviceMonitor = std::make_unique<DeviceMonitor>(this);
+    connect(m_deviceMonitor.get(), &DeviceMonitor::deviceConnected, this,
+            [this](const DeviceHandle& device) { onDeviceConnected(*device); });
+    connect(m_deviceMonitor.get(), &DeviceMonitor::deviceDisconnected, this, &MonitorService::onDeviceDisconnected);
+    connect(m_deviceMonitor.get(), &DeviceMonitor::deviceChanged, this,
+            [this](const DeviceHandle& device) { onDeviceChanged(*device); });
+    connect(m_deviceMonitor.get(), &DeviceMonitor::monitorError, this,
+            [](const QString& message) { qWarning() << "headless: device monitor:" << message; });
+
+    m_hidMonitor = std::make_unique<HidDeviceMonitor>(this);
+    connect(m_hidMonitor.get(), &HidDeviceMonitor::hidConnected, this, &MonitorService::onHidConnected);
+    connect(m_hidMonitor.get(), &HidDeviceMonitor::hidChanged, this, &MonitorService::onHidConnected);
+    connect(m_hidMonitor.get(), &HidDeviceMonitor::hidDisconnected, this, &MonitorService::onHidDisconnected);
+    connect(m_hidMonitor.get(), &HidDeviceMonitor::monitorError, this,
+            [](const QString& message) { qWarning() << "headless: HID monitor:" << message; });
+
+#ifndef Q_OS_WIN
+    // Nothing here mounts; the desktop's automounter or the admin does, without a udev event.
+    m_mountWatchFd = MountTable::openChangeFd();
+    if (m_mountWatchFd >= 0) {
+        m_mountWatch = new QSocketNotifier(m_mountWatchFd, QSocketNotifier::Exception, this);
+        connect(m_mountWatch, &QSocketNotifier::activated, this, [this]() { m_deviceMonitor->rescan(); });
+    }
+#endif
+
+    m_running = true;
+    m_deviceMonitor->startMonitoring();
+    m_hidMonitor->startMonitoring();
+    AuditLog::appendEvent(QStringLiteral("headless_start"), socketPath());
+    return true;
+}
+
+void MonitorService::stop()
+{
+    if (!m_running) {
+        return;
+    }
+    m_running = false;
+    delete m_mountWatch;
+    m_mountWatch = nullptr;
+#ifndef Q_OS_WIN
+    if (m_mountWatchFd >= 0) {
+        ::close(m_mountWatchFd);
+        m_mountWatchFd = -1;
+    }
+#endif
+    m_deviceMonitor->stopMonitoring();
+    m_hidMonitor->stopMonitoring();
+    m_hashWorker->cancelAll();
+    m_manifestWorker->cancelAll();
+    m_isoWorker->cancel();
+    for (const QPointer<QLocalSocket>& client : std::as_const(m_clients)) {
+        if (client) {
+            client->disconnectFromServer();
+        }
+    }
+    m_clients.clear();
+    m_server.close();
+    AuditLog::appendEvent(QStringLiteral("headless_stop"));
+}
+
+QJsonObject MonitorService::snapshot() const
+{
+    QJsonArray devices;
+    for (const DeviceState& state : m_devices) {
+        devices.append(deviceJson(state));
+    }
+    QJsonArray hid;
+    for (const QJsonObject& device : m_hidDevices) {
+        hid.append(device);
+    }
+    QJsonObject obj;
+    obj[QStringLiteral("type")] = QStringLiteral("snapshot");
+    obj[QStringLiteral("devices")] = devices;
+    obj[QStringLiteral("hid_devices")] = hid;
+    return obj;
+}
+
+void MonitorService::onDeviceConnected(const DeviceInfo& device)
+{
+    DeviceState& state = m_devices[device.deviceNode];
+    state = DeviceState();
+    state.info = device;
+    state.udevEventNs = device.udevEventNs;
+    QJsonObject payload = deviceJson(state);
+    noteLatency(state, PerfMetrics::ConnectStage::Card, payload);
+    if (device.isMounted) {
+        noteLatency(state, PerfMetrics::ConnectStage::Mount, payload);
+    }
+    publish(QStringLiteral("connected"), payload);
+
+    const bool blocked = isDriveBlocked(device);
+    const std::optional<DeviceRecord> record = blocked ? std::nullopt : m_database->getDevice(device);
+    const HeadlessPlan::ConnectPlan plan = HeadlessPlan::onConnect(
+        device, blocked, record ? &*record : nullptr, record && loadHeadlessSettings().autoHashOnConnect);
+    setVerdict(device.deviceNode, plan.verdict);
+    switch (plan.verify) {
+        case HeadlessPlan::Verify::None:
+            break;
+        case HeadlessPlan::Verify::Skip:
+            setVerdict(device.deviceNode, QStringLiteral("skipped"), plan.skipReason);
+            break;
+        case HeadlessPlan::Verify::WatchManifest:
+            verifyWatchManifest(device, *record);
+            break;
+        case HeadlessPlan::Verify::FullHash:
+            startFullHash(device, *record);
+            break;
+    }
+    if (plan.scanIsos) {
+        maybeScanIsos(device);
+    }
+}
+
+void MonitorService::onDeviceDisconnected(const QString& deviceNode)
+{
+    const auto it = m_devices.find(deviceNode);
+    if (it == m_devices.end()) {
+        return;
+    }
+    QJsonObject payload = deviceJson(*it);
+    m_isoScannedMounts.remove(it->info.mountPoint);
+    m_devices.erase(it);
+    for (auto job = m_jobDevices.begin(); job != m_jobDevices.end();) {
+        if (job.value() == deviceNode) {
+            m_hashWorker->cancelHash(job.key());
+            m_manifestWorker->cancelJob(job.key());
+            m_isoWorker->cancelJob(job.key());
+            job = m_jobDevices.erase(job);
+        } else {
+            ++job;
+        }
+    }
+    publish(QStringLiteral("disconnected"), payload);
+}
+
+void MonitorService::onDeviceChanged(const DeviceInfo& device)
+{
+    const auto it = m_devices.find(device.deviceNode);
+    if (it == m_devices.end()) {
+        onDeviceConnected(device);
+        return;
+    }
+    const bool newlyMounted = device.isMounted && !it->info.isMounted;
+    const bool scanIsos = HeadlessPlan::scanIsosOnChange(it->info, device, it->verdict);
+    it->info = device;
+    QJsonObject payload = deviceJson(*it);
+    if (newlyMounted) {
+        noteLatency(*it, PerfMetrics::ConnectStage::Mount, payload);
+    }
+    publish(QStringLiteral("changed"), payload);
+    if (scanIsos) {
+        maybeScanIsos(device);
+    }
+}
+
+void MonitorService::onHidConnected(const HidDeviceInfo& device)
+{
+    QJsonObject obj = device.toJson();
+    const std::optional<BadUsbBaselineEntry> entry = m_badUsbBaselineStore->getDevice(device.stableId());
+    obj[QStringLiteral("baseline")] = !entry ? QStringLiteral("unknown")
+                                    : entry->trusted ? QStringLiteral("trusted")
+                                                     : QStringLiteral("untrusted");
+    m_hidDevices.insert(device.stableId(), obj);
+    publish(QStringLiteral("hid_connected"), obj);
+    if (!entry || !entry->trusted) {
+        AuditLog::appendEvent(QStringLiteral("headless_hid_untrusted"),
+                              QStringLiteral("%1 (%2)").arg(device.displayName(), device.stableId()));
+    }
+}
+
+void MonitorService::onHidDisconnected(const QString& stableId)
+{
+    QJsonObject payload = m_hidDevices.take(stableId);
+    payload[QStringLiteral("stable_id")] = stableId;
+    publish(QStringLiteral("hid_disconnected"), payload);
+}
+
+void MonitorService::verifyWatchManifest(const DeviceInfo& device, const DeviceRecord& record)
+{
+    const std::optional<WatchManifest> baseline = m_database->watchManifestFor(record);
+    if (!baseline) {
+        setVerdict(device.deviceNode, QStringLiteral("error"),
+                   QStringLiteral("Watch manifest is missing or altered"));
+        return;
+    }
+    const QString deviceId = m_database->canonicalUniqueId(device);
+    const QString jobId = device.isMounted && !device.mountPoint.isEmpty()
+        ? m_manifestWorker->startVerify(device.deviceNode, device.mountPoint, deviceId, *baseline)
+        : m_manifestWorker->startVerifyUnmounted(device.deviceNode, deviceId, *baseline);
+    m_jobDevices.insert(jobId, device.deviceNode);
+    setVerdict(device.deviceNode, QStringLiteral("verifying"), QStringLiteral("watch manifest"));
+}
+
+void MonitorService::startFullHash(const DeviceInfo& device, const DeviceRecord& record)
+{
+    const HeadlessSettings settings = loadHeadlessSettings();
+    HashWorker::HashJob job;
+    job.deviceNode = device.deviceNode;
+    job.algorithm = HashWorker::algorithmFromName(record.hashAlgorithm.isEmpty() ? settings.algorithm
+                                                                                 : record.hashAlgorithm);
+    job.bufferSizeKB = record.tunedBufferSizeKB > 0 ? record.tunedBufferSizeKB : settings.bufferSizeKB;
+    job.scope = record.hashScope == QLatin1String("whole_disk") ? HashScope::WholeDisk : HashScope::Partition;
+    job.scanMode = HashScanMode::Full;
+    job.expectedBlockHashes = DatabaseManager::blockHashesFor(record);
+    job.canonicalStorageId = m_database->canonicalUniqueId(device);
+    job.usbBus = device.usbBus;
+    job.usbPortPath = device.usbPortPath;
+    job.sizeHintBytes = device.sizeBytes;
+    m_jobDevices.insert(m_hashWorker->startHash(job), device.deviceNode);
+    setVerdict(device.deviceNode, QStringLiteral("verifying"), HashWorker::algorithmName(job.algorithm));
+}
+
+void MonitorService::maybeScanIsos(const DeviceInfo& device)
+{
+    if (!device.isMounted || device.mountPoint.isEmpty() || m_isoScannedMounts.contains(device.mountPoint)
+        || !loadHeadlessSettings().isoAutoVerifyOnUsbMount) {
+        return;
+    }
+    const IsoVerifier::MountScanResult scan = IsoVerifier::scanMountPoint(device.mountPoint);
+    if (IsoScanRules::shouldSkipAutoVerifyPartition(device.mountPoint, device.sizeBytes, scan.isoPaths.size())
+        || (scan.isoPaths.isEmpty() && !scan.looksLikeDdIsoStick)) {
+        return;
+    }
+    m_isoScannedMounts.insert(device.mountPoint);
+    // Scans of sticks on different disks run side by side (IoScheduler lanes).
+    m_jobDevices.insert(m_isoWorker->verifyMountPoint(device.mountPoint, device.deviceNode), device.deviceNode);
+}
+
+void MonitorService::setVerdict(const QString& deviceNode, const QString& verdict, const QString& detail,
+                                std::optional<PerfMetrics::ConnectStage> stage)
+{
+    const auto it = m_devices.find(deviceNode);
+    if (it == m_devices.end()) {
+        return;
+    }
+    it->verdict = verdict;
+    it->detail = detail;
+    QJsonObject payload = deviceJson(*it);
+    if (stage) {
+        noteLatency(*it, *stage, payload);
+    }
+    publish(QStringLiteral("verdict"), payload);
+    if (verdict != QLatin1String("verifying")) {
+        AuditLog::appendEvent(QStringLiteral("headless_verdict"),
+                              QStringLiteral("%1 %2: %3%4")
+                                  .arg(it->info.displayName(), deviceNode, verdict,
+                                       detail.isEmpty() ? QString() : QStringLiteral(" (%1)").arg(detail)));
+    }
+}
+
+void MonitorService::noteLatency(DeviceState& state, PerfMetrics::ConnectStage stage, QJsonObject& payload)
+{
+    const quint8 bit = quint8(1u << static_cast<int>(stage));
+    if (state.udevEventNs <= 0 || (state.stagesReached & bit)) {
+        return;  // found by a scan, or a later mount or verify of the same connect
+    }
+    state.stagesReached |= bit;
+    const qint64 ns = PerfMetrics::nowNs() - state.udevEventNs;
+    PerfMetrics::connectLatency(stage).observeNs(ns);
+    QJsonObject latency = payload.value(QStringLiteral("latency_ms")).toObject();
+    latency.insert(QLatin1String(PerfMetrics::connectStageName(stage)), double(ns) / 1e6);
+    payload[QStringLiteral("latency_ms")] = latency;
+}
+
+bool MonitorService::isDriveBlocked(const DeviceInfo& device) const
+{
+    return BlockedDriveStore::instance().isBlocked(driveKey(device), m_database->canonicalUniqueId(device));
+}
+
+void MonitorService::onNewConnection()
+{
+    while (QLocalSocket* socket = m_server.nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, socket, [socket]() { socket->readAll(); });
+        socket->write(QJsonDocument(snapshot()).toJson(QJsonDocument::Compact) + '\n');
+        m_clients.append(socket);
+    }
+}
+
+void MonitorService::publish(const QString& kind, QJsonObject payload)
+{
+    payload[QStringLiteral("type")] = QStringLiteral("event");
+    payload[QStringLiteral("event")] = kind;
+    payload[QStringLiteral("at")] = QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs);
+    emit eventPublished(payload);
+
+    const QByteArray line = QJsonDocument(payload).toJson(QJsonDocument::Compact) + '\n';
+    m_clients.removeIf([](const QPointer<QLocalSocket>& client) { return client.isNull(); });
+    for (const QPointer<QLocalSocket>& client : std::as_const(m_clients)) {
+        if (client->state() == QLocalSocket::ConnectedState) {
+            client->write(line);
+        }
+    }
+}
+
+QJsonObject MonitorService::deviceJson(const DeviceState& state)
+{
+    QJsonObject obj = state.info.toJson();
+    obj[QStringLiteral("verdict")] = state.verdict;
+    if (!state.detail.isEmpty()) {
+        obj[QStringLiteral("detail")] = state.detail;
+    }
+    return obj;
+}
+
+} // namespace FlashSpartan
@@ -1,13 +1,29 @@
 #include "MountManager.h"
 
+namespace FlashSpartan {
+
+int MountManager::BulkEjectResult::succeeded() const
+{
+    int count = 0;
+    for (const EjectResult& device : devices) {
+        count += device.success ? 1 : 0;
+    }
+    return count;
+}
+
+} // namespace FlashSpartan
+
 #ifdef Q_OS_WIN
 
 #include "WinStorage.h"
 
 #include <QMutexLocker>
 #include <QDir>
+#include <QFutureWatcher>
 #include <QStorageInfo>
+#include <QThreadPool>
 #include <QTimer>
+#include <QtConcurrent>
 #include <qt_windows.h>
 
 namespace FlashSpartan {
@@ -17,6 +33,7 @@ MountManager::MountManager(QObject* parent)
 {
     qRegisterMetaType<MountResult>("MountResult");
     qRegisterMetaType<UnmountResult>("UnmountResult");
+    qRegisterMetaType<BulkEjectResult>("BulkEjectResult");
     refreshMountStatus();
 }
 
@@ -113,6 +130,53 @@ void MountManager::powerOff(const QString& deviceNode)
     });
 }
 
+void MountManager::ejectAll(const QStringList& deviceNodes, const UnmountOptions& options)
+{
+    // Ejecting a volume is one blocking lock/dismount/eject sequence; run them side by side.
+    QList<QPair<QString, QString>> targets;  // device node, volume root
+    for (const QString& deviceNode : deviceNodes) {
+        const QString mountPoint = getMountPoint(deviceNode);
+        targets.append({deviceNode, WinStorage::normalizeVolumeRoot(mountPoint.isEmpty() ? deviceNode : mountPoint)});
+    }
+
+    const bool force = options.force;
+    auto* watcher = new QFutureWatcher<BulkEjectResult>(this);
+    connect(watcher, &QFutureWatcher<BulkEjectResult>::finished, this, [this, watcher, targets]() {
+        const BulkEjectResult result = watcher->result();
+        watcher->deleteLater();
+        for (int i = 0; i < result.devices.size(); ++i) {
+            if (!result.devices.at(i).success) {
+                continue;
+            }
+            const auto& [deviceNode, volumeRoot] = targets.at(i);
+            {
+                QMutexLocker locker(&m_mutex);
+                m_mountPoints.remove(deviceNode);
+                m_mountPoints.remove(volumeRoot);
+            }
+            emit mountStatusChanged(deviceNode, false, QString());
+        }
+        emit bulkEjectCompleted(result);
+    });
+    watcher->setFuture(QtConcurrent::run([targets, force]() {
+        QThreadPool pool;
+        pool.setMaxThreadCount(qMax(1, int(targets.size())));
+        BulkEjectResult result;
+        result.devices = QtConcurrent::blockingMapped<QList<EjectResult>>(
+            &pool, targets, [force](const QPair<QString, QString>& target) {
+                EjectResult entry;
+                entry.deviceNode = target.first;
+                QString error;
+                entry.success = WinStorage::ejectVolumeRoot(target.second, force, &error);
+                if (!entry.success) {
+                    entry.errorMessage = error.isEmpty() ? QStringLiteral("Failed to eject device") : error;
+                }
+                return entry;
+            });
+        return result;
+    }));
+}
+
 QString MountManager::getMountPoint(const QString& deviceNode) const
 {
     QMutexLocker locker(&m_mutex);
@@ -178,43 +242,124 @@ bool MountManager::isLoopDevice(const QString& /*deviceNode*/) const
 
 #else
 
+#include <QDBusArgument>
 #include <QDBusConnection>
 #include <QDBusError>
-#include <QDBusReply>
+#include <QDBusObjectPath>
 #include <QDBusPendingReply>
-#include <QDBusMetaType>
+#include <QDBusServiceWatcher>
+#include <QByteArrayList>
 #include <QDebug>
-#include <QFile>
 #include <QMutexLocker>
+#include <QSocketNotifier>
+
+#include "MountTable.h"
+
+#include <unistd.h>
 
 namespace FlashSpartan {
 
+namespace {
+
+/**
+ * A property value as UDisksObjectCache keeps it: object paths as strings and "aay" as a
+ * QByteArrayList. Other containers are dropped; nothing looks them up.
+ */
+QVariant plainValue(const QVariant& value)
+{
+    if (value.userType() == qMetaTypeId<QDBusObjectPath>()) {
+        return value.value<QDBusObjectPath>().path();
+    }
+    if (value.userType() == qMetaTypeId<QDBusArgument>()) {
+        const QDBusArgument arg = value.value<QDBusArgument>();
+        if (arg.currentSignature() == QLatin1String("aay")) {
+            QByteArrayList list;
+            arg >> list;
+            return QVariant::fromValue(list);
+        }
+        return {};
+    }
+    return value;
+}
+
+QVariantMap plainProperties(const QDBusArgument& arg)
+{
+    QVariantMap properties;
+    arg >> properties;
+    for (auto it = properties.begin(); it != properties.end(); ++it) {
+        it.value() = plainValue(it.value());
+    }
+    return properties;
+}
+
+/** a{sa{sv}}: properties by interface name. */
+UDisksObjectCache::Interfaces interfacesFrom(const QDBusArgument& arg)
+{
+    UDisksObjectCache::Interfaces interfaces;
+    arg.beginMap();
+    while (!arg.atEnd()) {
+        QString name;
+        arg.beginMapEntry();
+        arg >> name;
+        interfaces.insert(name, plainProperties(arg));
+        arg.endMapEntry();
+    }
+    arg.endMap();
+    return interfaces;
+}
+
+} // namespace
+
 MountManager::MountManager(QObject* parent)
     : QObject(parent)
 {
     // Register meta types for signals
     qRegisterMetaType<MountResult>("MountResult");
     qRegisterMetaType<UnmountResult>("UnmountResult");
-    
-    // Create UDisks2 manager interface
-    m_udisksInterface = std::make_unique<QDBusInterface>(
-        UDISKS2_SERVICE,
-        UDISKS2_PATH,
-        UDISKS2_MANAGER_IFACE,
-        QDBusConnection::systemBus()
-    );
-    
-    if (!m_udisksInterface->isValid()) {
-        qWarning() << "MountManager: Failed to connect to UDisks2:"
-                   << m_udisksInterface->lastError().message();
+    qRegisterMetaType<BulkEjectResult>("BulkEjectResult");
+    
+    // Subscribe before loading so no change falls between the snapshot and the signals.
+    QDBusConnection bus = QDBusConnection::systemBus();
+    bus.connect(UDISKS2_SERVICE, UDISKS2_PATH, DBUS_OBJECT_MANAGER_IFACE, "InterfacesAdded",
+                this, SLOT(onInterfacesAdded(QDBusMessage)));
+    bus.connect(UDISKS2_SERVICE, UDISKS2_PATH, DBUS_OBJECT_MANAGER_IFACE, "InterfacesRemoved",
+                this, SLOT(onInterfacesRemoved(QDBusMessage)));
+    bus.connect(UDISKS2_SERVICE, QString(), DBUS_PROPERTIES_IFACE, "PropertiesChanged",
+                this, SLOT(onPropertiesChanged(QDBusMessage)));
+    auto* serviceWatcher = new QDBusServiceWatcher(UDISKS2_SERVICE, bus,
+                                                   QDBusServiceWatcher::WatchForOwnerChange, this);
+    connect(serviceWatcher, &QDBusServiceWatcher::serviceOwnerChanged,
+            this, &MountManager::onUdisksOwnerChanged);
+
+    // One blocking call for the whole object tree; every later lookup is local.
+    const QDBusMessage reply = bus.call(
+        QDBusMessage::createMethodCall(UDISKS2_SERVICE, UDISKS2_PATH, DBUS_OBJECT_MANAGER_IFACE,
+                                       "GetManagedObjects"),
+        QDBus::Block, MANAGED_OBJECTS_TIMEOUT_MS);
+    if (reply.type() == QDBusMessage::ReplyMessage) {
+        applyManagedObjects(reply);
+    } else {
+        qWarning() << "MountManager: Failed to connect to UDisks2:" << reply.errorMessage();
     }
     
     // Initial mount status refresh
     refreshMountStatus();
+
+    // The kernel flags mountinfo with POLLPRI on every mount and unmount.
+    m_mountWatchFd = MountTable::openChangeFd();
+    if (m_mountWatchFd >= 0) {
+        m_mountWatch = new QSocketNotifier(m_mountWatchFd, QSocketNotifier::Exception, this);
+        connect(m_mountWatch, &QSocketNotifier::activated, this, &MountManager::refreshMountStatus);
+    }
 }
 
 MountManager::~MountManager()
 {
+    delete m_mountWatch;
+    if (m_mountWatchFd >= 0) {
+        ::close(m_mountWatchFd);
+    }
+
     // Cancel any pending operations
     QMutexLocker locker(&m_mutex);
     
@@ -231,31 +376,12 @@ MountManager::~MountManager()
 
 bool MountManager::isAvailable() const
 {
-    return m_udisksInterface && m_udisksInterface->isValid();
+    return m_udisks.isLoaded();
 }
 
 QString MountManager::udisksVersion() const
 {
-    if (!isAvailable()) {
-        return QString();
-    }
-    
-    QDBusInterface propsInterface(
-        UDISKS2_SERVICE,
-        "/org/freedesktop/UDisks2/Manager",
-        DBUS_PROPERTIES_IFACE,
-        QDBusConnection::systemBus()
-    );
-    
-    QDBusReply<QVariant> reply = propsInterface.call(
-        "Get", UDISKS2_MANAGER_IFACE, "Version"
-    );
-    
-    if (reply.isValid()) {
-        return reply.value().toString();
-    }
-    
-    return QString();
+    return m_udisks.version();
 }
 
 void MountManager::mount(const QString& deviceNode)
@@ -265,9 +391,9 @@ void MountManager::mount(const QString& deviceNode)
 
 void MountManager::mount(const QString& deviceNode, const MountOptions& options)
 {
-    auto fsInterface = createFilesystemInterface(deviceNode);
+    const QString objectPath = getBlockObjectPath(deviceNode);
     
-    if (!fsInterface || !fsInterface->isValid()) {
+    if (objectPath.isEmpty() || (m_udisks.isLoaded() && !m_udisks.hasInterface(objectPath, UDISKS2_FS_IFACE))) {
         MountResult result;
         result.deviceNode = deviceNode;
         result.success = false;
@@ -278,7 +404,7 @@ void MountManager::mount(const QString& deviceNode, const MountOptions& options)
     
     QVariantMap mountOptions = mountOptionsToVariant(options);
     
-    QDBusPendingCall pendingCall = fsInterface->asyncCall("Mount", mountOptions);
+    QDBusPendingCall pendingCall = callAsync(objectPath, UDISKS2_FS_IFACE, "Mount", mountOptions);
     QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(pendingCall, this);
     
     {
@@ -297,9 +423,9 @@ void MountManager::unmount(const QString& deviceNode)
 
 void MountManager::unmount(const QString& deviceNode, const UnmountOptions& options)
 {
-    auto fsInterface = createFilesystemInterface(deviceNode);
+    const QString objectPath = getBlockObjectPath(deviceNode);
     
-    if (!fsInterface || !fsInterface->isValid()) {
+    if (objectPath.isEmpty() || (m_udisks.isLoaded() && !m_udisks.hasInterface(objectPath, UDISKS2_FS_IFACE))) {
         UnmountResult result;
         result.deviceNode = deviceNode;
         result.success = false;
@@ -310,7 +436,7 @@ void MountManager::unmount(const QString& deviceNode, const UnmountOptions& opti
     
     QVariantMap unmountOptions = unmountOptionsToVariant(options);
     
-    QDBusPendingCall pendingCall = fsInterface->asyncCall("Unmount", unmountOptions);
+    QDBusPendingCall pendingCall = callAsync(objectPath, UDISKS2_FS_IFACE, "Unmount", unmountOptions);
     QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(pendingCall, this);
     
     {
@@ -324,24 +450,21 @@ void MountManager::unmount(const QString& deviceNode, const UnmountOptions& opti
 
 void MountManager::powerOff(const QString& deviceNode)
 {
-    QString blockPath = getBlockObjectPath(deviceNode);
-    QString drivePath = getDriveObjectPath(blockPath);
+    const QString drivePath = m_udisks.driveObjectPath(deviceNode);
     
     if (drivePath.isEmpty()) {
         emit powerOffCompleted(deviceNode, false, "Could not find drive for device");
         return;
     }
     
-    auto driveInterface = createDriveInterface(drivePath);
-    
-    if (!driveInterface || !driveInterface->isValid()) {
+    if (!m_udisks.hasInterface(drivePath, UDISKS2_DRIVE_IFACE)) {
         emit powerOffCompleted(deviceNode, false, "Could not access drive interface");
         return;
     }
     
     QVariantMap options;
     
-    QDBusPendingCall pendingCall = driveInterface->asyncCall("PowerOff", options);
+    QDBusPendingCall pendingCall = callAsync(drivePath, UDISKS2_DRIVE_IFACE, "PowerOff", options);
     QDBusPendingCallWatcher* watcher = new QDBusPendingCallWatcher(pendingCall, this);
     
     {
@@ -353,6 +476,52 @@ void MountManager::powerOff(const QString& deviceNode)
             this, &MountManager::onPowerOffFinished);
 }
 
+void MountManager::ejectAll(const QStringList& deviceNodes, const UnmountOptions& options)
+{
+    const quint64 batchId = m_nextEjectBatch++;
+    EjectBatch batch;
+    QList<QPair<int, QString>> unmounts;  // index, block object path
+
+    for (const QString& deviceNode : deviceNodes) {
+        const int index = batch.result.devices.size();
+        EjectResult entry;
+        entry.deviceNode = deviceNode;
+        entry.success = true;
+
+        const QString drivePath = m_udisks.driveObjectPath(deviceNode);
+        if (drivePath.isEmpty() || !m_udisks.hasInterface(drivePath, UDISKS2_DRIVE_IFACE)) {
+            entry.success = false;
+            entry.errorMessage = "Could not find drive for device";
+        } else {
+            batch.entriesByDrive[drivePath].append(index);
+            const QString objectPath = getBlockObjectPath(deviceNode);
+            if (!getMountPoint(deviceNode).isEmpty() || !m_udisks.mountPoints(deviceNode).isEmpty()) {
+                unmounts.append({index, objectPath});
+            }
+        }
+        batch.result.devices.append(entry);
+    }
+
+    batch.pending = unmounts.size();
+    {
+        QMutexLocker locker(&m_mutex);
+        m_ejectBatches.insert(batchId, batch);
+    }
+
+    if (unmounts.isEmpty()) {
+        powerOffEjectBatch(batchId);
+        return;
+    }
+
+    const QVariantMap unmountOptions = unmountOptionsToVariant(options);
+    for (const auto& [index, objectPath] : std::as_const(unmounts)) {
+        auto* watcher = new QDBusPendingCallWatcher(
+            callAsync(objectPath, UDISKS2_FS_IFACE, "Unmount", unmountOptions), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this,
+                [this, batchId, index](QDBusPendingCallWatcher* w) { onEjectUnmountFinished(batchId, index, w); });
+    }
+}
+
 QString MountManager::getMountPoint(const QString& deviceNode) const
 {
     QMutexLocker locker(&m_mutex);
@@ -364,7 +533,8 @@ bool MountManager::hasPendingOperations() const
     QMutexLocker locker(&m_mutex);
     return !m_pendingMounts.isEmpty() || 
            !m_pendingUnmounts.isEmpty() ||
-           !m_pendingPowerOffs.isEmpty();
+           !m_pendingPowerOffs.isEmpty() ||
+           !m_ejectBatches.isEmpty();
 }
 
 QStringList MountManager::mountedDevices() const
@@ -383,33 +553,12 @@ QStringList MountManager::mountedDevices() const
 
 void MountManager::refreshMountStatus()
 {
-    // Parse /proc/mounts to get current mount status
-    QFile mounts("/proc/mounts");
-    if (!mounts.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "MountManager: Failed to open /proc/mounts";
-        return;
-    }
-    
+    // Current mount status from the shared mount table (not re-read unless it changed)
+    const auto mounts = MountTable::current();
     QHash<QString, QString> newMountPoints;
-    
-    while (!mounts.atEnd()) {
-        QByteArray line = mounts.readLine();
-        QList<QByteArray> parts = line.split(' ');
-        
-        if (parts.size() >= 2) {
-            QString device = QString::fromUtf8(parts[0]);
-            QString mountPoint = QString::fromUtf8(parts[1]);
-            
-            // Unescape special characters in mount point
-            mountPoint.replace("\\040", " ");
-            mountPoint.replace("\\011", "\t");
-            mountPoint.replace("\\012", "\n");
-            mountPoint.replace("\\134", "\\");
-            
-            if (device.startsWith("/dev/")) {
-                newMountPoints.insert(device, mountPoint);
-            }
-        }
+    newMountPoints.reserve(mounts->bySource.size());
+    for (auto it = mounts->bySource.cbegin(); it != mounts->bySource.cend(); ++it) {
+        newMountPoints.insert(it.key(), mounts->entries.at(it.value()).mountPoint);
     }
     
     // Update mount points and emit changes
@@ -443,32 +592,13 @@ void MountManager::refreshMountStatus()
 
 QString MountManager::getFilesystemType(const QString& deviceNode) const
 {
-    QString objectPath = getBlockObjectPath(deviceNode);
-    if (objectPath.isEmpty()) {
-        return QString();
-    }
-    
-    QDBusInterface propsInterface(
-        UDISKS2_SERVICE,
-        objectPath,
-        DBUS_PROPERTIES_IFACE,
-        QDBusConnection::systemBus()
-    );
-    
-    QDBusReply<QVariant> reply = propsInterface.call(
-        "Get", UDISKS2_BLOCK_IFACE, "IdType"
-    );
-    
-    if (reply.isValid()) {
-        return reply.value().toString();
-    }
-    
-    return QString();
+    return m_udisks.property(getBlockObjectPath(deviceNode), UDISKS2_BLOCK_IFACE, QStringLiteral("IdType"))
+        .toString();
 }
 
 bool MountManager::isLoopDevice(const QString& deviceNode) const
 {
-    return deviceNode.startsWith("/dev/loop");
+    return m_udisks.isLoop(deviceNode) || deviceNode.startsWith("/dev/loop");
 }
 
 void MountManager::onMountFinished(QDBusPendingCallWatcher* watcher)
@@ -515,6 +645,12 @@ void MountManager::onUnmountFinished(QDBusPendingCallWatcher* watcher)
         deviceNode = m_pendingUnmounts.take(watcher);
     }
     
+    emit unmountCompleted(unmountResult(deviceNode, watcher));
+    watcher->deleteLater();
+}
+
+MountManager::UnmountResult MountManager::unmountResult(const QString& deviceNode, QDBusPendingCallWatcher* watcher)
+{
     UnmountResult result;
     result.deviceNode = deviceNode;
     
@@ -536,8 +672,7 @@ void MountManager::onUnmountFinished(QDBusPendingCallWatcher* watcher)
         qInfo() << "MountManager: Unmounted" << deviceNode;
     }
     
-    emit unmountCompleted(result);
-    watcher->deleteLater();
+    return result;
 }
 
 void MountManager::onPowerOffFinished(QDBusPendingCallWatcher* watcher)
@@ -564,8 +699,126 @@ void MountManager::onPowerOffFinished(QDBusPendingCallWatcher* watcher)
     watcher->deleteLater();
 }
 
+void MountManager::onEjectUnmountFinished(quint64 batchId, int index, QDBusPendingCallWatcher* watcher)
+{
+    watcher->deleteLater();
+    QString deviceNode;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto batch = m_ejectBatches.find(batchId);
+        if (batch == m_ejectBatches.end()) {
+            return;
+        }
+        deviceNode = batch->result.devices.at(index).deviceNode;
+    }
+
+    const UnmountResult result = unmountResult(deviceNode, watcher);
+    emit unmountCompleted(result);
+
+    bool last = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        EjectBatch& batch = m_ejectBatches[batchId];
+        if (!result.success) {
+            EjectResult& entry = batch.result.devices[index];
+            entry.success = false;
+            entry.errorMessage = result.errorMessage;
+        }
+        last = --batch.pending == 0;
+    }
+    if (last) {
+        powerOffEjectBatch(batchId);
+    }
+}
+
+void MountManager::powerOffEjectBatch(quint64 batchId)
+{
+    QStringList drives;
+    {
+        QMutexLocker locker(&m_mutex);
+        EjectBatch& batch = m_ejectBatches[batchId];
+        for (auto it = batch.entriesByDrive.cbegin(); it != batch.entriesByDrive.cend(); ++it) {
+            // A drive keeps its power while any of its volumes is still mounted.
+            QString blocker;
+            for (int index : it.value()) {
+                const EjectResult& entry = batch.result.devices.at(index);
+                if (!entry.success) {
+                    blocker = entry.deviceNode;
+                    break;
+                }
+            }
+            if (blocker.isEmpty()) {
+                drives.append(it.key());
+                continue;
+            }
+            for (int index : it.value()) {
+                EjectResult& entry = batch.result.devices[index];
+                if (entry.success) {
+                    entry.success = false;
+                    entry.errorMessage = QString("Drive not powered off: %1 could not be unmounted").arg(blocker);
+                }
+            }
+        }
+        batch.pending = drives.size();
+    }
+
+    if (drives.isEmpty()) {
+        BulkEjectResult result;
+        {
+            QMutexLocker locker(&m_mutex);
+            result = m_ejectBatches.take(batchId).result;
+        }
+        emit bulkEjectCompleted(result);
+        return;
+    }
+
+    for (const QString& drivePath : std::as_const(drives)) {
+        auto* watcher = new QDBusPendingCallWatcher(
+            callAsync(drivePath, UDISKS2_DRIVE_IFACE, "PowerOff", QVariantMap()), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this,
+                [this, batchId, drivePath](QDBusPendingCallWatcher* w) { onEjectPowerOffFinished(batchId, drivePath, w); });
+    }
+}
+
+void MountManager::onEjectPowerOffFinished(quint64 batchId, const QString& drivePath, QDBusPendingCallWatcher* watcher)
+{
+    watcher->deleteLater();
+    const QDBusPendingReply<> reply = *watcher;
+    const QString errorMsg = reply.isError() ? extractErrorMessage(reply.error()) : QString();
+
+    BulkEjectResult result;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto batch = m_ejectBatches.find(batchId);
+        if (batch == m_ejectBatches.end()) {
+            return;
+        }
+        for (int index : batch->entriesByDrive.value(drivePath)) {
+            EjectResult& entry = batch->result.devices[index];
+            if (reply.isError()) {
+                entry.success = false;
+                entry.errorMessage = errorMsg;
+                qWarning() << "MountManager: Power off failed for" << entry.deviceNode << "-" << errorMsg;
+            } else {
+                qInfo() << "MountManager: Powered off" << entry.deviceNode;
+            }
+        }
+        if (--batch->pending > 0) {
+            return;
+        }
+        result = m_ejectBatches.take(batchId).result;
+    }
+    emit bulkEjectCompleted(result);
+}
+
 QString MountManager::getBlockObjectPath(const QString& deviceNode) const
 {
+    // The cache also knows symlinks (/dev/disk/by-id/...) and renamed nodes.
+    const QString cached = m_udisks.blockObjectPath(deviceNode);
+    if (!cached.isEmpty() || m_udisks.isLoaded()) {
+        return cached;
+    }
+
     // Convert device node to UDisks2 object path
     // /dev/sda1 -> /org/freedesktop/UDisks2/block_devices/sda1
     
@@ -579,91 +832,87 @@ QString MountManager::getBlockObjectPath(const QString& deviceNode) const
     return QString("/org/freedesktop/UDisks2/block_devices/%1").arg(deviceName);
 }
 
-QString MountManager::getDriveObjectPath(const QString& blockObjectPath) const
+QDBusPendingCall MountManager::callAsync(const QString& objectPath, const char* interface, const char* method,
+                                         const QVariantMap& options) const
 {
-    if (blockObjectPath.isEmpty()) {
-        return QString();
-    }
-    
-    QDBusInterface propsInterface(
-        UDISKS2_SERVICE,
-        blockObjectPath,
-        DBUS_PROPERTIES_IFACE,
-        QDBusConnection::systemBus()
-    );
-    
-    QDBusReply<QVariant> reply = propsInterface.call(
-        "Get", UDISKS2_BLOCK_IFACE, "Drive"
-    );
-    
-    if (reply.isValid()) {
-        QDBusObjectPath drivePath = qvariant_cast<QDBusObjectPath>(reply.value());
-        return drivePath.path();
-    }
-    
-    return QString();
+    QDBusMessage call = QDBusMessage::createMethodCall(UDISKS2_SERVICE, objectPath, interface, method);
+    call << options;
+    return QDBusConnection::systemBus().asyncCall(call);
 }
 
-std::unique_ptr<QDBusInterface> MountManager::createBlockInterface(const QString& deviceNode) const
+void MountManager::applyManagedObjects(const QDBusMessage& reply)
 {
-    QString objectPath = getBlockObjectPath(deviceNode);
-    if (objectPath.isEmpty()) {
-        return nullptr;
+    QHash<QString, UDisksObjectCache::Interfaces> objects;
+    if (!reply.arguments().isEmpty()) {
+        const QDBusArgument arg = reply.arguments().constFirst().value<QDBusArgument>();
+        arg.beginMap();
+        while (!arg.atEnd()) {
+            QDBusObjectPath path;
+            arg.beginMapEntry();
+            arg >> path;
+            objects.insert(path.path(), interfacesFrom(arg));
+            arg.endMapEntry();
+        }
+        arg.endMap();
     }
-    
-    auto interface = std::make_unique<QDBusInterface>(
-        UDISKS2_SERVICE,
-        objectPath,
-        UDISKS2_BLOCK_IFACE,
-        QDBusConnection::systemBus()
-    );
-    
-    if (!interface->isValid()) {
-        return nullptr;
+    m_udisks.reset(objects);
+}
+
+void MountManager::onManagedObjectsFinished(QDBusPendingCallWatcher* watcher)
+{
+    const QDBusPendingReply<> reply = *watcher;
+    if (reply.isError()) {
+        qWarning() << "MountManager: Failed to reload UDisks2 objects:" << reply.error().message();
+    } else {
+        applyManagedObjects(reply.reply());
     }
-    
-    return interface;
+    watcher->deleteLater();
 }
 
-std::unique_ptr<QDBusInterface> MountManager::createFilesystemInterface(const QString& deviceNode) const
+void MountManager::onInterfacesAdded(const QDBusMessage& message)
 {
-    QString objectPath = getBlockObjectPath(deviceNode);
-    if (objectPath.isEmpty()) {
-        return nullptr;
+    const QList<QVariant> args = message.arguments();
+    if (args.size() < 2) {
+        return;
     }
-    
-    auto interface = std::make_unique<QDBusInterface>(
-        UDISKS2_SERVICE,
-        objectPath,
-        UDISKS2_FS_IFACE,
-        QDBusConnection::systemBus()
-    );
-    
-    if (!interface->isValid()) {
-        return nullptr;
+    m_udisks.addInterfaces(args.at(0).value<QDBusObjectPath>().path(),
+                           interfacesFrom(args.at(1).value<QDBusArgument>()));
+}
+
+void MountManager::onInterfacesRemoved(const QDBusMessage& message)
+{
+    const QList<QVariant> args = message.arguments();
+    if (args.size() < 2) {
+        return;
     }
-    
-    return interface;
+    m_udisks.removeInterfaces(args.at(0).value<QDBusObjectPath>().path(), args.at(1).toStringList());
 }
 
-std::unique_ptr<QDBusInterface> MountManager::createDriveInterface(const QString& driveObjectPath) const
+void MountManager::onPropertiesChanged(const QDBusMessage& message)
 {
-    if (driveObjectPath.isEmpty() || driveObjectPath == "/") {
-        return nullptr;
+    const QList<QVariant> args = message.arguments();
+    if (args.size() < 3) {
+        return;
     }
-    
-    auto interface = std::make_unique<QDBusInterface>(
-        UDISKS2_SERVICE,
-        driveObjectPath,
-        UDISKS2_DRIVE_IFACE,
-        QDBusConnection::systemBus()
-    );
-    
-    if (!interface->isValid()) {
-        return nullptr;
+    m_udisks.changeProperties(message.path(), args.at(0).toString(),
+                              plainProperties(args.at(1).value<QDBusArgument>()), args.at(2).toStringList());
+}
+
+void MountManager::onUdisksOwnerChanged(const QString& /*service*/, const QString& /*oldOwner*/,
+                                        const QString& newOwner)
+{
+    // A restarted daemon starts from a new tree: drop the old one and reload in the background.
+    m_udisks.clear();
+    if (newOwner.isEmpty()) {
+        return;
     }
-    
-    return interface;
+    const QDBusPendingCall pendingCall = QDBusConnection::systemBus().asyncCall(
+        QDBusMessage::createMethodCall(UDISKS2_SERVICE, UDISKS2_PATH, DBUS_OBJECT_MANAGER_IFACE,
+                                       "GetManagedObjects"),
+        MANAGED_OBJECTS_TIMEOUT_MS);
+    auto* watcher = new QDBusPendingCallWatcher(pendingCall, this);
+    connect(watcher, &QDBusPendingCallWatcher::finished,
+            this, &MountManager::onManagedObjectsFinished);
 }
 
 QVariantMap MountManager::mountOptionsToVariant(const MountOptions& options) const
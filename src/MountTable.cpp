@@ -0,0 +1,160 @@
+#include "MountTable.h"
+
+#ifndef Q_OS_WIN
+
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <cerrno>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr const char* kMountInfoPath = "/proc/self/mountinfo";
+
+/** mountinfo escapes space, tab, newline and backslash as \ooo. */
+QString unescape(const QByteArray& field)
+{
+    if (!field.contains('\\')) {
+        return QString::fromUtf8(field);
+    }
+    QByteArray out;
+    out.reserve(field.size());
+    for (qsizetype i = 0; i < field.size(); ++i) {
+        if (field.at(i) == '\\' && i + 3 < field.size()) {
+            bool ok = false;
+            const int value = field.mid(i + 1, 3).toInt(&ok, 8);
+            if (ok && value < 256) {
+                out.append(static_cast<char>(value));
+                i += 3;
+                continue;
+            }
+        }
+        out.append(field.at(i));
+    }
+    return QString::fromUtf8(out);
+}
+
+quint64 devNumKey(quint32 major, quint32 minor)
+{
+    return (static_cast<quint64>(major) << 32) | minor;
+}
+
+QByteArray readAll(int fd)
+{
+    QByteArray data;
+    if (::lseek(fd, 0, SEEK_SET) != 0) {
+        return data;
+    }
+    char buffer[16384];
+    for (;;) {
+        const ssize_t n = ::read(fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            data.append(buffer, n);
+        } else if (n == 0 || errno != EINTR) {
+            break;
+        }
+    }
+    return data;
+}
+
+struct Cache {
+    QMutex mutex;
+    int fd = -1;
+    std::shared_ptr<const MountTable::Snapshot> snapshot;  // guarded by mutex
+};
+
+Cache& cache()
+{
+    static Cache* c = [] {
+        auto* created = new Cache;
+        created->fd = MountTable::openChangeFd();
+        return created;
+    }();
+    return *c;
+}
+
+} // namespace
+
+const MountEntry* MountTable::Snapshot::find(const QString& deviceNode, quint32 major, quint32 minor) const
+{
+    if (major != 0 || minor != 0) {
+        const auto it = byDevNum.constFind(devNumKey(major, minor));
+        if (it != byDevNum.cend()) {
+            return &entries.at(it.value());
+        }
+    }
+    const auto it = bySource.constFind(deviceNode);
+    return it != bySource.cend() ? &entries.at(it.value()) : nullptr;
+}
+
+std::shared_ptr<const MountTable::Snapshot> MountTable::parse(const QByteArray& mountinfo)
+{
+    auto snapshot = std::make_shared<Snapshot>();
+    for (const QByteArray& line : mountinfo.split('\n')) {
+        // id parent major:minor root mount-point options [optional...] - fstype source super-options
+        const QList<QByteArray> fields = line.split(' ');
+        if (fields.size() < 7) {
+            continue;
+        }
+        const qsizetype separator = fields.indexOf(QByteArray("-"), 6);
+        if (separator < 0 || separator + 2 >= fields.size()) {
+            continue;
+        }
+        MountEntry entry;
+        const QList<QByteArray> devNum = fields.at(2).split(':');
+        if (devNum.size() == 2) {
+            entry.major = devNum.at(0).toUInt();
+            entry.minor = devNum.at(1).toUInt();
+        }
+        entry.mountPoint = unescape(fields.at(4));
+        entry.fsType = unescape(fields.at(separator + 1));
+        entry.source = unescape(fields.at(separator + 2));
+
+        const qsizetype index = snapshot->entries.size();
+        if (entry.source.startsWith(QLatin1String("/dev/"))) {
+            // A source mounted twice (bind mounts) resolves to its first mount point.
+            if (!snapshot->bySource.contains(entry.source)) {
+                snapshot->bySource.insert(entry.source, index);
+            }
+            const quint64 key = devNumKey(entry.major, entry.minor);
+            if (!snapshot->byDevNum.contains(key)) {
+                snapshot->byDevNum.insert(key, index);
+            }
+        }
+        snapshot->entries.append(std::move(entry));
+    }
+    return snapshot;
+}
+
+std::shared_ptr<const MountTable::Snapshot> MountTable::current()
+{
+    Cache& c = cache();
+    QMutexLocker locker(&c.mutex);
+    if (c.fd < 0) {
+        // No watchable descriptor (e.g. /proc not mounted yet): read every time.
+        QFile f(QString::fromLatin1(kMountInfoPath));
+        return parse(f.open(QIODevice::ReadOnly) ? f.readAll() : QByteArray());
+    }
+    pollfd pfd{c.fd, POLLPRI, 0};
+    const bool changed = ::poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLPRI | POLLERR));
+    if (!c.snapshot || changed) {
+        c.snapshot = parse(readAll(c.fd));
+    }
+    return c.snapshot;
+}
+
+int MountTable::openChangeFd()
+{
+    return ::open(kMountInfoPath, O_RDONLY | O_CLOEXEC);
+}
+
+} // namespace FlashSpartan
+
+#endif
@@ -0,0 +1,72 @@
+#include "MultiDigest.h"
+#include "HexEncoding.h"
+
+namespace FlashSpartan {
+
+namespace {
+
+const EVP_MD* evpFor(DigestAlgorithm algorithm)
+{
+    switch (algorithm) {
+    case DigestAlgorithm::Sha256: return DigestContextPool::sha256();
+    case DigestAlgorithm::Sha512: return DigestContextPool::sha512();
+    case DigestAlgorithm::Blake2b512: return DigestContextPool::blake2b512();
+    }
+    return nullptr;
+}
+
+} // namespace
+
+MultiDigest::MultiDigest(DigestAlgorithms algorithms)
+{
+    for (DigestAlgorithm algorithm :
+         {DigestAlgorithm::Sha256, DigestAlgorithm::Sha512, DigestAlgorithm::Blake2b512}) {
+        if (!algorithms.testFlag(algorithm)) {
+            continue;
+        }
+        Slot& slot = m_slots[m_count++];
+        slot.algorithm = algorithm;
+        slot.context.emplace();
+        const EVP_MD* md = evpFor(algorithm);
+        if (!*slot.context || !md || EVP_DigestInit_ex(slot.context->get(), md, nullptr) != 1) {
+            m_valid = false;
+        }
+    }
+    if (m_count == 0) {
+        m_valid = false;
+    }
+}
+
+bool MultiDigest::update(const void* data, std::size_t size)
+{
+    if (!m_valid) {
+        return false;
+    }
+    for (int i = 0; i < m_count; ++i) {
+        if (EVP_DigestUpdate(m_slots[i].context->get(), data, size) != 1) {
+            m_valid = false;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MultiDigest::finish(DigestValues* out)
+{
+    if (!m_valid || !out) {
+        return false;
+    }
+    for (int i = 0; i < m_count; ++i) {
+        unsigned char hash[EVP_MAX_MD_SIZE];
+        unsigned int len = 0;
+        if (EVP_DigestFinal_ex(m_slots[i].context->get(), hash, &len) != 1) {
+            m_valid = false;
+            return false;
+        }
+        out->slot(m_slots[i].algorithm) = HexEncoding::toString(hash, len);
+    }
+    m_valid = false;  // contexts are finalised
+    return true;
+}
+
+} // namespace FlashSpartan
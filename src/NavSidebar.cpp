@@ -118,7 +118,7 @@ void NavSidebar::rebuildButtons()
     group->setExclusive(true);
 
     for (AppPage page : pages) {
-        auto* btn = new QPushButton(appPageLabel(page));
+        auto* btn = new QPushButton(buttonText(page));
         btn->setProperty("navItem", true);
         btn->setCheckable(true);
         btn->setCursor(Qt::PointingHandCursor);
@@ -143,6 +143,32 @@ void NavSidebar::setCurrentPage(AppPage page)
     }
 }
 
+void NavSidebar::setBadge(AppPage page, int count)
+{
+    if (m_badges.value(static_cast<int>(page)) == count) {
+        return;
+    }
+    if (count > 0) {
+        m_badges.insert(static_cast<int>(page), count);
+    } else {
+        m_badges.remove(static_cast<int>(page));
+    }
+    for (QPushButton* btn : m_buttons) {
+        if (btn->property("appPage").toInt() == static_cast<int>(page)) {
+            btn->setText(buttonText(page));
+        }
+    }
+}
+
+QString NavSidebar::buttonText(AppPage page) const
+{
+    const int count = m_badges.value(static_cast<int>(page));
+    if (count <= 0) {
+        return appPageLabel(page);
+    }
+    return QStringLiteral("%1  (%2)").arg(appPageLabel(page), count > 99 ? QStringLiteral("99+") : QString::number(count));
+}
+
 void NavSidebar::onButtonClicked()
 {
     auto* btn = qobject_cast<QPushButton*>(sender());
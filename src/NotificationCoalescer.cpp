@@ -0,0 +1,166 @@
+#include "NotificationCoalescer.h"
+
+#include <QMap>
+#include <QStringList>
+
+#include <utility>
+
+namespace FlashSpartan {
+
+namespace {
+
+QString devices(int n)
+{
+    return n == 1 ? QStringLiteral("1 device") : QStringLiteral("%1 devices").arg(n);
+}
+
+QString categoryTitle(TrayNotice::Category category)
+{
+    switch (category) {
+        case TrayNotice::Category::DeviceConnected:
+            return QStringLiteral("Devices connected");
+        case TrayNotice::Category::DeviceRemoved:
+            return QStringLiteral("Devices removed");
+        case TrayNotice::Category::Verification:
+            return QStringLiteral("Verification");
+        case TrayNotice::Category::HashCompleted:
+            return QStringLiteral("Hash Complete");
+        case TrayNotice::Category::IsoVerify:
+            return QStringLiteral("ISO verification");
+        case TrayNotice::Category::ReadAnomaly:
+            return QStringLiteral("Read speed anomaly");
+        case TrayNotice::Category::Security:
+        case TrayNotice::Category::General:
+        default:
+            return QStringLiteral("FlashSpartan");
+    }
+}
+
+} // namespace
+
+NotificationCoalescer::NotificationCoalescer(QObject* parent)
+    : QObject(parent)
+{
+    m_clock.start();
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &NotificationCoalescer::flush);
+}
+
+void NotificationCoalescer::setIntervals(int windowMs, int minIntervalMs, int securityRepeatMs)
+{
+    m_windowMs = qMax(0, windowMs);
+    m_minIntervalMs = qMax(0, minIntervalMs);
+    m_securityRepeatMs = qMax(0, securityRepeatMs);
+}
+
+void NotificationCoalescer::post(const TrayNotice& notice)
+{
+    const qint64 now = m_clock.elapsed();
+    if (notice.category == TrayNotice::Category::Security) {
+        for (auto it = m_securityShownAt.begin(); it != m_securityShownAt.end();) {
+            it = now - it.value() >= m_securityRepeatMs ? m_securityShownAt.erase(it) : std::next(it);
+        }
+        const QString key = notice.title + QLatin1Char('\n') + notice.message;
+        if (m_securityShownAt.contains(key)) {
+            return;  // the same device re-enumerating: already on screen
+        }
+        m_securityShownAt.insert(key, now);
+        emit deliver(notice);
+        return;
+    }
+
+    m_pending.append(notice);
+    if (!m_timer.isActive()) {
+        qint64 delay = m_windowMs;
+        if (m_lastDeliveredMs >= 0) {
+            delay = qMax(delay, m_lastDeliveredMs + m_minIntervalMs - now);
+        }
+        m_timer.start(static_cast<int>(delay));
+    }
+}
+
+void NotificationCoalescer::flush()
+{
+    m_timer.stop();
+    if (m_pending.isEmpty()) {
+        return;
+    }
+    const QList<TrayNotice> batch = std::exchange(m_pending, {});
+    m_lastDeliveredMs = m_clock.elapsed();
+    if (batch.size() == 1) {
+        emit deliver(batch.first());
+        return;
+    }
+
+    struct Tally {
+        int count = 0;
+        int failed = 0;
+    };
+    QList<TrayNotice::Category> order;
+    QMap<int, Tally> tallies;
+    TrayNotice out;
+    out.category = batch.first().category;
+    out.durationMs = 0;
+    for (const TrayNotice& n : batch) {
+        const int key = static_cast<int>(n.category);
+        if (!tallies.contains(key)) {
+            order.append(n.category);
+        }
+        Tally& t = tallies[key];
+        ++t.count;
+        t.failed += n.failed ? 1 : 0;
+        out.failed = out.failed || n.failed;
+        out.level = qMax(out.level, n.level);
+        out.durationMs = qMax(out.durationMs, n.durationMs);
+    }
+
+    QStringList lines;
+    for (TrayNotice::Category category : order) {
+        const Tally& t = tallies[static_cast<int>(category)];
+        lines.append(summaryLine(category, t.count, t.failed));
+    }
+    out.title = order.size() == 1 ? categoryTitle(order.first())
+                                  : QStringLiteral("FlashSpartan: %1 events").arg(batch.size());
+    out.message = lines.join(QLatin1Char('\n'));
+    emit deliver(out);
+}
+
+void NotificationCoalescer::clear()
+{
+    m_timer.stop();
+    m_pending.clear();
+}
+
+QString NotificationCoalescer::summaryLine(TrayNotice::Category category, int count, int failed)
+{
+    const int ok = count - failed;
+    switch (category) {
+        case TrayNotice::Category::DeviceConnected:
+            return failed > 0 ? QStringLiteral("%1 connected, %2 not whitelisted").arg(devices(count)).arg(failed)
+                              : QStringLiteral("%1 connected").arg(devices(count));
+        case TrayNotice::Category::DeviceRemoved:
+            return QStringLiteral("%1 removed").arg(devices(count));
+        case TrayNotice::Category::Verification:
+            if (failed == 0) {
+                return QStringLiteral("%1 verified").arg(devices(count));
+            }
+            if (ok == 0) {
+                return QStringLiteral("%1 failed verification").arg(devices(count));
+            }
+            return QStringLiteral("%1 verified, %2 failed").arg(devices(ok)).arg(failed);
+        case TrayNotice::Category::HashCompleted:
+            return QStringLiteral("%1 hashed").arg(devices(count));
+        case TrayNotice::Category::IsoVerify:
+            return failed > 0 ? QStringLiteral("ISO images checked on %1, %2 with failures").arg(devices(count)).arg(failed)
+                              : QStringLiteral("ISO images checked on %1").arg(devices(count));
+        case TrayNotice::Category::ReadAnomaly:
+            return QStringLiteral("Read speed anomalies on %1").arg(devices(count));
+        case TrayNotice::Category::Security:
+            return QStringLiteral("%1 security alerts").arg(count);
+        case TrayNotice::Category::General:
+        default:
+            return QStringLiteral("%1 notifications").arg(count);
+    }
+}
+
+} // namespace FlashSpartan
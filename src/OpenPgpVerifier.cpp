@@ -0,0 +1,738 @@
+#include "OpenPgpVerifier.h"
+
+#include <openssl/bn.h>
+#include <openssl/evp.h>
+#include <openssl/rsa.h>
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#include <openssl/param_build.h>
+#endif
+
+#include <QCryptographicHash>
+#include <QFile>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr int kTagSignature = 2;
+constexpr int kTagPublicKey = 6;
+constexpr int kTagPublicSubkey = 14;
+
+constexpr int kAlgoRsa = 1;
+constexpr int kAlgoRsaSignOnly = 3;
+constexpr int kAlgoEdDsaLegacy = 22;
+constexpr int kAlgoEd25519 = 27;
+
+constexpr int kSigBinary = 0x00;
+constexpr int kSigText = 0x01;
+constexpr int kSigSubkeyBinding = 0x18;
+constexpr int kSigPrimaryKeyBinding = 0x19;
+
+constexpr int kSubIssuerKeyId = 16;
+constexpr int kSubKeyFlags = 27;
+constexpr int kSubEmbeddedSignature = 32;
+constexpr int kSubIssuerFingerprint = 33;
+constexpr int kKeyFlagSign = 0x02;
+
+constexpr qint64 kMaxSignatureFileBytes = 1024 * 1024;
+constexpr qint64 kReadChunkBytes = 1024 * 1024;
+
+struct EvpPkeyFree {
+    void operator()(EVP_PKEY* p) const { EVP_PKEY_free(p); }
+};
+struct EvpPkeyCtxFree {
+    void operator()(EVP_PKEY_CTX* p) const { EVP_PKEY_CTX_free(p); }
+};
+struct EvpMdCtxFree {
+    void operator()(EVP_MD_CTX* p) const { EVP_MD_CTX_free(p); }
+};
+using EvpPkeyPtr = std::unique_ptr<EVP_PKEY, EvpPkeyFree>;
+using EvpPkeyCtxPtr = std::unique_ptr<EVP_PKEY_CTX, EvpPkeyCtxFree>;
+using EvpMdCtxPtr = std::unique_ptr<EVP_MD_CTX, EvpMdCtxFree>;
+
+const QByteArray& ed25519Oid()
+{
+    static const QByteArray oid = QByteArray::fromHex("2b06010401da470f01");
+    return oid;
+}
+
+/** Bounds-checked big-endian reader; any overrun clears ok and yields zeros. */
+struct Reader {
+    const QByteArray& data;
+    qsizetype pos = 0;
+    bool ok = true;
+
+    qsizetype remaining() const { return data.size() - pos; }
+
+    quint32 uint(int bytes)
+    {
+        if (remaining() < bytes) {
+            ok = false;
+            return 0;
+        }
+        quint32 v = 0;
+        for (int i = 0; i < bytes; ++i) {
+            v = (v << 8) | static_cast<quint8>(data.at(pos++));
+        }
+        return v;
+    }
+
+    QByteArray bytes(qsizetype n)
+    {
+        if (n < 0 || remaining() < n) {
+            ok = false;
+            return {};
+        }
+        const QByteArray out = data.mid(pos, n);
+        pos += n;
+        return out;
+    }
+
+    QByteArray mpi()
+    {
+        const quint32 bits = uint(2);
+        return bytes((bits + 7) / 8);
+    }
+};
+
+quint64 keyIdOf(const QByteArray& fingerprint)
+{
+    quint64 id = 0;
+    for (qsizetype i = fingerprint.size() - 8; i < fingerprint.size(); ++i) {
+        id = (id << 8) | static_cast<quint8>(fingerprint.at(i));
+    }
+    return id;
+}
+
+QString keyIdHex(quint64 id)
+{
+    return QStringLiteral("%1").arg(id, 16, 16, QLatin1Char('0')).toUpper();
+}
+
+struct Packet {
+    int tag = 0;
+    QByteArray body;
+};
+
+/** Splits @p data into packets; false on truncation or partial lengths (data packets only). */
+bool readPackets(const QByteArray& data, QList<Packet>* out)
+{
+    Reader r{data};
+    while (r.remaining() > 0) {
+        const quint32 ctb = r.uint(1);
+        if (!(ctb & 0x80)) {
+            return false;
+        }
+        Packet p;
+        qint64 len = 0;
+        if (ctb & 0x40) {
+            p.tag = static_cast<int>(ctb & 0x3f);
+            const quint32 o1 = r.uint(1);
+            if (o1 < 192) {
+                len = o1;
+            } else if (o1 < 224) {
+                len = ((o1 - 192) << 8) + r.uint(1) + 192;
+            } else if (o1 == 255) {
+                len = r.uint(4);
+            } else {
+                return false;
+            }
+        } else {
+            p.tag = static_cast<int>((ctb >> 2) & 0x0f);
+            const int lengthType = static_cast<int>(ctb & 3);
+            len = lengthType == 3 ? r.remaining() : r.uint(1 << lengthType);
+        }
+        p.body = r.bytes(len);
+        if (!r.ok) {
+            return false;
+        }
+        out->append(p);
+    }
+    return true;
+}
+
+/** Binary packets from @p data, decoding ASCII-armored blocks when present. */
+QByteArray dearmor(const QByteArray& data)
+{
+    if (!data.contains("-----BEGIN PGP")) {
+        return data;
+    }
+    enum class State { Outside, Headers, Body };
+    State state = State::Outside;
+    QByteArray out;
+    QByteArray base64;
+    for (const QByteArray& raw : data.split('\n')) {
+        const QByteArray line = raw.trimmed();
+        switch (state) {
+        case State::Outside:
+            if (line.startsWith("-----BEGIN PGP")) {
+                state = State::Headers;
+            }
+            break;
+        case State::Headers:
+            if (line.isEmpty()) {
+                state = State::Body;
+            } else if (!line.contains(':')) {
+                state = State::Body;  // no blank line after the armor headers
+                base64 += line;
+            }
+            break;
+        case State::Body:
+            if (line.startsWith("-----END PGP")) {
+                out += QByteArray::fromBase64(base64);
+                base64.clear();
+                state = State::Outside;
+            } else if (!(line.startsWith('=') && line.size() == 5)) {
+                base64 += line;  // CRC-24 line skipped: the signature check covers integrity
+            }
+            break;
+        }
+    }
+    return out;
+}
+
+struct ParsedKey {
+    int algorithm = 0;
+    QByteArray first;
+    QByteArray second;
+    QByteArray fingerprint;
+};
+
+/** 0x99, two-octet length, key body: what v4 fingerprints and key signatures hash. */
+QByteArray keyHashPrefix(const QByteArray& body)
+{
+    QByteArray out;
+    out.reserve(body.size() + 3);
+    out.append(static_cast<char>(0x99));
+    out.append(static_cast<char>((body.size() >> 8) & 0xff));
+    out.append(static_cast<char>(body.size() & 0xff));
+    out.append(body);
+    return out;
+}
+
+std::optional<ParsedKey> parsePublicKey(const QByteArray& body)
+{
+    Reader r{body};
+    if (r.uint(1) != 4) {
+        return std::nullopt;  // v3 and v6 keys are left to gpg
+    }
+    r.uint(4);  // creation time
+    ParsedKey k;
+    k.algorithm = static_cast<int>(r.uint(1));
+    switch (k.algorithm) {
+    case kAlgoRsa:
+    case kAlgoRsaSignOnly:
+        k.first = r.mpi();
+        k.second = r.mpi();
+        break;
+    case kAlgoEdDsaLegacy: {
+        const QByteArray oid = r.bytes(r.uint(1));
+        const QByteArray point = r.mpi();
+        if (oid != ed25519Oid() || point.size() != 33 || static_cast<quint8>(point.at(0)) != 0x40) {
+            return std::nullopt;
+        }
+        k.first = point.mid(1);
+        break;
+    }
+    case kAlgoEd25519:
+        k.first = r.bytes(32);
+        break;
+    default:
+        return std::nullopt;
+    }
+    if (!r.ok || k.first.isEmpty()) {
+        return std::nullopt;
+    }
+    k.fingerprint = QCryptographicHash::hash(keyHashPrefix(body), QCryptographicHash::Sha1);
+    return k;
+}
+
+struct ParsedSignature {
+    int type = -1;
+    int publicKeyAlgorithm = 0;
+    int hashAlgorithm = 0;
+    /** Version through the end of the hashed subpackets. */
+    QByteArray hashedPart;
+    quint32 left16 = 0;
+    QByteArray issuerFingerprint;
+    quint64 issuerKeyId = 0;
+    int keyFlags = -1;
+    QByteArray embeddedSignature;
+    QByteArray first;
+    QByteArray second;
+};
+
+bool readSubpackets(const QByteArray& area, bool hashed, ParsedSignature* s)
+{
+    Reader r{area};
+    while (r.remaining() > 0) {
+        const quint32 o1 = r.uint(1);
+        qint64 len = o1;
+        if (o1 >= 255) {
+            len = r.uint(4);
+        } else if (o1 >= 192) {
+            len = ((o1 - 192) << 8) + r.uint(1) + 192;
+        }
+        const QByteArray sub = r.bytes(len);
+        if (!r.ok || sub.isEmpty()) {
+            return false;
+        }
+        const int type = static_cast<quint8>(sub.at(0)) & 0x7f;
+        const QByteArray content = sub.mid(1);
+        if (type == kSubIssuerKeyId && content.size() == 8) {
+            s->issuerKeyId = keyIdOf(content);
+        } else if (type == kSubIssuerFingerprint && content.size() == 21 && content.at(0) == 4) {
+            s->issuerFingerprint = content.mid(1);
+        } else if (type == kSubKeyFlags && hashed && !content.isEmpty()) {
+            s->keyFlags = static_cast<quint8>(content.at(0));
+        } else if (type == kSubEmbeddedSignature) {
+            s->embeddedSignature = content;
+        }
+    }
+    return true;
+}
+
+std::optional<ParsedSignature> parseSignature(const QByteArray& body)
+{
+    Reader r{body};
+    if (r.uint(1) != 4) {
+        return std::nullopt;
+    }
+    ParsedSignature s;
+    s.type = static_cast<int>(r.uint(1));
+    s.publicKeyAlgorithm = static_cast<int>(r.uint(1));
+    s.hashAlgorithm = static_cast<int>(r.uint(1));
+    const QByteArray hashed = r.bytes(r.uint(2));
+    const QByteArray unhashed = r.bytes(r.uint(2));
+    s.left16 = r.uint(2);
+    if (!r.ok || !readSubpackets(hashed, true, &s) || !readSubpackets(unhashed, false, &s)) {
+        return std::nullopt;
+    }
+    s.hashedPart = body.left(6 + hashed.size());
+    if (s.issuerKeyId == 0 && !s.issuerFingerprint.isEmpty()) {
+        s.issuerKeyId = keyIdOf(s.issuerFingerprint);
+    }
+    switch (s.publicKeyAlgorithm) {
+    case kAlgoRsa:
+    case kAlgoRsaSignOnly:
+        s.first = r.mpi();
+        break;
+    case kAlgoEdDsaLegacy:
+        s.first = r.mpi();
+        s.second = r.mpi();
+        break;
+    case kAlgoEd25519:
+        s.first = r.bytes(64);
+        break;
+    default:
+        break;  // no key of that kind is ever in the ring
+    }
+    if (!r.ok) {
+        return std::nullopt;
+    }
+    return s;
+}
+
+const EVP_MD* digestFor(int hashAlgorithm)
+{
+    switch (hashAlgorithm) {
+    case 8: return EVP_sha256();
+    case 9: return EVP_sha384();
+    case 10: return EVP_sha512();
+    case 11: return EVP_sha224();
+    default: return nullptr;  // MD5, SHA-1, RIPEMD-160 and SHA-3 are decided by gpg
+    }
+}
+
+bool algorithmsMatch(int keyAlgorithm, int signatureAlgorithm)
+{
+    const auto isRsa = [](int a) { return a == kAlgoRsa || a == kAlgoRsaSignOnly; };
+    return keyAlgorithm == signatureAlgorithm || (isRsa(keyAlgorithm) && isRsa(signatureAlgorithm));
+}
+
+EvpPkeyPtr rsaPublicKey(const QByteArray& n, const QByteArray& e)
+{
+    BIGNUM* bn = BN_bin2bn(reinterpret_cast<const unsigned char*>(n.constData()), static_cast<int>(n.size()), nullptr);
+    BIGNUM* be = BN_bin2bn(reinterpret_cast<const unsigned char*>(e.constData()), static_cast<int>(e.size()), nullptr);
+    if (!bn || !be) {
+        BN_free(bn);
+        BN_free(be);
+        return nullptr;
+    }
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+    EVP_PKEY* pkey = nullptr;
+    OSSL_PARAM_BLD* bld = OSSL_PARAM_BLD_new();
+    OSSL_PARAM* params = nullptr;
+    if (bld && OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_RSA_N, bn) == 1
+        && OSSL_PARAM_BLD_push_BN(bld, OSSL_PKEY_PARAM_RSA_E, be) == 1) {
+        params = OSSL_PARAM_BLD_to_param(bld);
+    }
+    EvpPkeyCtxPtr ctx(EVP_PKEY_CTX_new_from_name(nullptr, "RSA", nullptr));
+    if (params && ctx && EVP_PKEY_fromdata_init(ctx.get()) == 1) {
+        EVP_PKEY_fromdata(ctx.get(), &pkey, EVP_PKEY_PUBLIC_KEY, params);
+    }
+    OSSL_PARAM_free(params);
+    OSSL_PARAM_BLD_free(bld);
+    BN_free(bn);
+    BN_free(be);
+    return EvpPkeyPtr(pkey);
+#else
+    RSA* rsa = RSA_new();
+    if (!rsa || RSA_set0_key(rsa, bn, be, nullptr) != 1) {
+        RSA_free(rsa);
+        BN_free(bn);
+        BN_free(be);
+        return nullptr;
+    }
+    EvpPkeyPtr pkey(EVP_PKEY_new());
+    if (!pkey || EVP_PKEY_assign_RSA(pkey.get(), rsa) != 1) {
+        RSA_free(rsa);
+        return nullptr;
+    }
+    return pkey;
+#endif
+}
+
+/** @p value left-padded with zeros to @p size; empty when it is longer. */
+QByteArray leftPadded(const QByteArray& value, qsizetype size)
+{
+    if (value.size() > size) {
+        return {};
+    }
+    return QByteArray(size - value.size(), '\0') + value;
+}
+
+template <typename Key>
+bool verifyDigest(const Key& key, const ParsedSignature& sig, const QByteArray& digest)
+{
+    if (digest.size() < 2 || static_cast<quint8>(digest.at(0)) != (sig.left16 >> 8)
+        || static_cast<quint8>(digest.at(1)) != (sig.left16 & 0xff)) {
+        return false;
+    }
+    const auto* digestBytes = reinterpret_cast<const unsigned char*>(digest.constData());
+
+    if (key.algorithm == kAlgoRsa || key.algorithm == kAlgoRsaSignOnly) {
+        EvpPkeyPtr pkey = rsaPublicKey(key.first, key.second);
+        const QByteArray signature = leftPadded(sig.first, key.first.size());
+        if (!pkey || signature.isEmpty()) {
+            return false;
+        }
+        EvpPkeyCtxPtr ctx(EVP_PKEY_CTX_new(pkey.get(), nullptr));
+        return ctx && EVP_PKEY_verify_init(ctx.get()) == 1
+               && EVP_PKEY_CTX_set_rsa_padding(ctx.get(), RSA_PKCS1_PADDING) == 1
+               && EVP_PKEY_CTX_set_signature_md(ctx.get(), digestFor(sig.hashAlgorithm)) == 1
+               && EVP_PKEY_verify(ctx.get(), reinterpret_cast<const unsigned char*>(signature.constData()),
+                                  static_cast<size_t>(signature.size()), digestBytes,
+                                  static_cast<size_t>(digest.size())) == 1;
+    }
+
+    // EdDSA signs the digest itself, not the data.
+    const QByteArray signature = key.algorithm == kAlgoEdDsaLegacy
+                                     ? leftPadded(sig.first, 32) + leftPadded(sig.second, 32)
+                                     : sig.first;
+    if (signature.size() != 64 || key.first.size() != 32) {
+        return false;
+    }
+    EvpPkeyPtr pkey(EVP_PKEY_new_raw_public_key(EVP_PKEY_ED25519, nullptr,
+                                                reinterpret_cast<const unsigned char*>(key.first.constData()),
+                                                32));
+    EvpMdCtxPtr ctx(EVP_MD_CTX_new());
+    return pkey && ctx && EVP_DigestVerifyInit(ctx.get(), nullptr, nullptr, nullptr, pkey.get()) == 1
+           && EVP_DigestVerify(ctx.get(), reinterpret_cast<const unsigned char*>(signature.constData()), 64,
+                               digestBytes, static_cast<size_t>(digest.size())) == 1;
+}
+
+bool updateDigest(EVP_MD_CTX* ctx, const QByteArray& bytes)
+{
+    return EVP_DigestUpdate(ctx, bytes.constData(), static_cast<size_t>(bytes.size())) == 1;
+}
+
+/** Adds the signature's hashed part and the v4 trailer, then finalizes a copy of @p ctx. */
+QByteArray finishDigest(const EVP_MD_CTX* ctx, const ParsedSignature& sig)
+{
+    EvpMdCtxPtr copy(EVP_MD_CTX_new());
+    if (!copy || EVP_MD_CTX_copy_ex(copy.get(), ctx) != 1 || !updateDigest(copy.get(), sig.hashedPart)) {
+        return {};
+    }
+    const auto n = static_cast<quint32>(sig.hashedPart.size());
+    const unsigned char trailer[6] = {0x04, 0xff, static_cast<unsigned char>(n >> 24),
+                                      static_cast<unsigned char>(n >> 16), static_cast<unsigned char>(n >> 8),
+                                      static_cast<unsigned char>(n)};
+    unsigned char out[EVP_MAX_MD_SIZE];
+    unsigned int len = 0;
+    if (EVP_DigestUpdate(copy.get(), trailer, sizeof(trailer)) != 1
+        || EVP_DigestFinal_ex(copy.get(), out, &len) != 1) {
+        return {};
+    }
+    return QByteArray(reinterpret_cast<const char*>(out), static_cast<qsizetype>(len));
+}
+
+/** Key signatures (bindings) hash both key packets ahead of the trailer. */
+template <typename Key>
+bool verifyKeySignature(const Key& signer, const ParsedSignature& sig, const QByteArray& hashedKeys)
+{
+    const EVP_MD* md = digestFor(sig.hashAlgorithm);
+    if (!md || !algorithmsMatch(signer.algorithm, sig.publicKeyAlgorithm)) {
+        return false;
+    }
+    EvpMdCtxPtr ctx(EVP_MD_CTX_new());
+    if (!ctx || EVP_DigestInit_ex(ctx.get(), md, nullptr) != 1 || !updateDigest(ctx.get(), hashedKeys)) {
+        return false;
+    }
+    return verifyDigest(signer, sig, finishDigest(ctx.get(), sig));
+}
+
+/** LF to CRLF for text-mode signatures, remembering a CR that ended the previous chunk. */
+class TextCanonicalizer {
+public:
+    QByteArray feed(const char* data, qint64 size)
+    {
+        QByteArray out;
+        out.reserve(static_cast<qsizetype>(size + size / 16));
+        for (qint64 i = 0; i < size; ++i) {
+            const char c = data[i];
+            if (c == '\n' && !m_lastWasCr) {
+                out.append('\r');
+            }
+            out.append(c);
+            m_lastWasCr = c == '\r';
+        }
+        return out;
+    }
+
+private:
+    bool m_lastWasCr = false;
+};
+
+} // namespace
+
+int OpenPgpVerifier::KeyRing::addKeys(const QByteArray& data)
+{
+    QList<Packet> packets;
+    readPackets(dearmor(data), &packets);  // keys before a damaged packet are still usable
+
+    int added = 0;
+    std::optional<ParsedKey> primary;
+    QByteArray primaryBody;
+    std::optional<ParsedKey> subkey;
+    QByteArray subkeyBody;
+
+    const auto insert = [this](const ParsedKey& k, const QByteArray& primaryFingerprint) {
+        for (const qsizetype i : m_byKeyId.values(keyIdOf(k.fingerprint))) {
+            if (m_keys.at(i).fingerprint == k.fingerprint) {
+                return false;
+            }
+        }
+        m_byKeyId.insert(keyIdOf(k.fingerprint), m_keys.size());
+        m_keys.append({k.algorithm, k.first, k.second, k.fingerprint, primaryFingerprint});
+        return true;
+    };
+
+    for (const Packet& p : std::as_const(packets)) {
+        if (p.tag == kTagPublicKey) {
+            primary = parsePublicKey(p.body);
+            primaryBody = p.body;
+            subkey.reset();
+            if (primary && insert(*primary, primary->fingerprint)) {
+                ++added;
+            }
+        } else if (p.tag == kTagPublicSubkey) {
+            subkey = primary ? parsePublicKey(p.body) : std::nullopt;
+            subkeyBody = p.body;
+        } else if (p.tag == kTagSignature && primary && subkey) {
+            // A signing subkey needs the primary's binding and its own back-signature, so a
+            // subkey copied under someone else's primary is not attributed to it.
+            const std::optional<ParsedSignature> binding = parseSignature(p.body);
+            if (!binding || binding->type != kSigSubkeyBinding || binding->keyFlags < 0
+                || !(binding->keyFlags & kKeyFlagSign)) {
+                continue;
+            }
+            const QByteArray hashedKeys = keyHashPrefix(primaryBody) + keyHashPrefix(subkeyBody);
+            const std::optional<ParsedSignature> back = parseSignature(binding->embeddedSignature);
+            if (verifyKeySignature(*primary, *binding, hashedKeys) && back
+                && back->type == kSigPrimaryKeyBinding && verifyKeySignature(*subkey, *back, hashedKeys)) {
+                insert(*subkey, primary->fingerprint);
+                subkey.reset();
+            }
+        }
+    }
+    return added;
+}
+
+bool OpenPgpVerifier::KeyRing::contains(const QString& keyIdOrFingerprint) const
+{
+    QString id = keyIdOrFingerprint.trimmed().remove(QLatin1Char(' ')).toUpper();
+    if (id.startsWith(QStringLiteral("0X"))) {
+        id = id.mid(2);
+    }
+    if (id.size() < 8) {
+        return false;
+    }
+    for (const SigningKey& k : m_keys) {
+        const QString fp = QString::fromLatin1(k.fingerprint.toHex()).toUpper();
+        if (fp.endsWith(id)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QList<const OpenPgpVerifier::KeyRing::SigningKey*>
+OpenPgpVerifier::KeyRing::candidates(const QByteArray& issuerFingerprint, quint64 issuerKeyId) const
+{
+    QList<const SigningKey*> out;
+    for (const qsizetype i : m_byKeyId.values(issuerKeyId)) {
+        const SigningKey& k = m_keys.at(i);
+        if (issuerFingerprint.isEmpty() || k.fingerprint == issuerFingerprint) {
+            out.append(&k);
+        }
+    }
+    return out;
+}
+
+OpenPgpVerifier::Result OpenPgpVerifier::verifyDetached(const KeyRing& keys, const QByteArray& signature,
+                                                        const QByteArray& data)
+{
+    qsizetype pos = 0;
+    return verifyStream(keys, signature, [&data, &pos](char* buffer, qint64 maxBytes) -> qint64 {
+        const qint64 n = qMin<qint64>(maxBytes, data.size() - pos);
+        memcpy(buffer, data.constData() + pos, static_cast<size_t>(n));
+        pos += n;
+        return n;
+    });
+}
+
+OpenPgpVerifier::Result OpenPgpVerifier::verifyDetachedFile(const KeyRing& keys, const QString& signaturePath,
+                                                            const QString& dataPath)
+{
+    Result result;
+    QFile sigFile(signaturePath);
+    if (!sigFile.open(QIODevice::ReadOnly) || sigFile.size() > kMaxSignatureFileBytes) {
+        result.detail = QStringLiteral("Cannot read signature %1").arg(signaturePath);
+        return result;
+    }
+    QFile dataFile(dataPath);
+    if (!dataFile.open(QIODevice::ReadOnly)) {
+        result.detail = QStringLiteral("Cannot read %1: %2").arg(dataPath, dataFile.errorString());
+        return result;
+    }
+    return verifyStream(keys, sigFile.readAll(), [&dataFile](char* buffer, qint64 maxBytes) {
+        return dataFile.read(buffer, maxBytes);
+    });
+}
+
+OpenPgpVerifier::Result OpenPgpVerifier::verifyStream(const KeyRing& keys, const QByteArray& signature,
+                                                      const std::function<qint64(char*, qint64)>& read)
+{
+    Result result;
+    QList<Packet> packets;
+    if (!readPackets(dearmor(signature), &packets)) {
+        result.detail = QStringLiteral("Signature is not OpenPGP data");
+        return result;
+    }
+
+    // Every (signature, known key) pair gets its own digest; the data is read once for all.
+    struct Candidate {
+        ParsedSignature sig;
+        const KeyRing::SigningKey* key = nullptr;
+        EvpMdCtxPtr ctx;
+    };
+    std::vector<Candidate> candidates;
+    bool sawSignature = false;
+    bool unsupported = false;
+    for (const Packet& p : std::as_const(packets)) {
+        if (p.tag != kTagSignature) {
+            continue;
+        }
+        const std::optional<ParsedSignature> sig = parseSignature(p.body);
+        if (!sig || (sig->type != kSigBinary && sig->type != kSigText)) {
+            continue;
+        }
+        if (!sawSignature) {
+            result.keyId = keyIdHex(sig->issuerKeyId);
+            sawSignature = true;
+        }
+        const EVP_MD* md = digestFor(sig->hashAlgorithm);
+        for (const KeyRing::SigningKey* key : keys.candidates(sig->issuerFingerprint, sig->issuerKeyId)) {
+            if (!md || !algorithmsMatch(key->algorithm, sig->publicKeyAlgorithm)) {
+                unsupported = true;
+                continue;
+            }
+            EvpMdCtxPtr ctx(EVP_MD_CTX_new());
+            if (ctx && EVP_DigestInit_ex(ctx.get(), md, nullptr) == 1) {
+                candidates.push_back({*sig, key, std::move(ctx)});
+            }
+        }
+    }
+    if (candidates.empty()) {
+        result.status = !sawSignature ? Status::Malformed
+                        : unsupported ? Status::Unsupported
+                                      : Status::NoPublicKey;
+        result.detail = !sawSignature ? QStringLiteral("No document signature found")
+                                      : QStringLiteral("%1 for key %2").arg(statusText(result.status), result.keyId);
+        return result;
+    }
+
+    const bool anyText = std::any_of(candidates.cbegin(), candidates.cend(),
+                                     [](const Candidate& c) { return c.sig.type == kSigText; });
+    TextCanonicalizer canonicalizer;
+    QByteArray buffer(kReadChunkBytes, Qt::Uninitialized);
+    while (true) {
+        const qint64 n = read(buffer.data(), buffer.size());
+        if (n < 0) {
+            result.status = Status::Malformed;
+            result.detail = QStringLiteral("Read error while checking the signature");
+            return result;
+        }
+        if (n == 0) {
+            break;
+        }
+        const QByteArray text = anyText ? canonicalizer.feed(buffer.constData(), n) : QByteArray();
+        for (Candidate& c : candidates) {
+            if (c.sig.type == kSigText) {
+                updateDigest(c.ctx.get(), text);
+            } else {
+                EVP_DigestUpdate(c.ctx.get(), buffer.constData(), static_cast<size_t>(n));
+            }
+        }
+    }
+
+    for (const Candidate& c : candidates) {
+        if (verifyDigest(*c.key, c.sig, finishDigest(c.ctx.get(), c.sig))) {
+            result.status = Status::Good;
+            result.keyId = keyIdHex(keyIdOf(c.key->fingerprint));
+            result.fingerprint = QString::fromLatin1(c.key->primaryFingerprint.toHex()).toUpper();
+            result.detail = QStringLiteral("Good signature from key %1 (in-process OpenPGP)\n"
+                                           "Primary key fingerprint: %2")
+                                .arg(result.keyId, result.fingerprint);
+            return result;
+        }
+    }
+    const Candidate& first = candidates.front();
+    result.status = Status::Bad;
+    result.keyId = keyIdHex(keyIdOf(first.key->fingerprint));
+    result.fingerprint = QString::fromLatin1(first.key->primaryFingerprint.toHex()).toUpper();
+    result.detail = QStringLiteral("BAD signature from key %1").arg(result.keyId);
+    return result;
+}
+
+QString OpenPgpVerifier::statusText(Status status)
+{
+    switch (status) {
+    case Status::Good: return QStringLiteral("Good signature");
+    case Status::Bad: return QStringLiteral("BAD signature");
+    case Status::NoPublicKey: return QStringLiteral("No public key");
+    case Status::Unsupported: return QStringLiteral("Unsupported signature");
+    case Status::Malformed: return QStringLiteral("Malformed signature");
+    }
+    return {};
+}
+
+} // namespace FlashSpartan
@@ -0,0 +1,181 @@
+#include "PerfMetricsDialog.h"
+#include "AppDiagnostics.h"
+#include "PerfMetrics.h"
+#include "StyleManager.h"
+
+#include <QApplication>
+#include <QClipboard>
+#include <QDialogButtonBox>
+#include <QFileDialog>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLocale>
+#include <QMap>
+#include <QMessageBox>
+#include <QPushButton>
+#include <QTableWidget>
+#include <QTimer>
+#include <QVBoxLayout>
+
+#include <cmath>
+
+namespace FlashSpartan {
+
+namespace {
+
+QString formatSeconds(double seconds)
+{
+    if (std::isinf(seconds)) {
+        return QStringLiteral("> %1 s").arg(
+            PerfMetrics::Histogram::upperBoundSeconds(PerfMetrics::Histogram::kBuckets - 1), 0, 'f', 0);
+    }
+    if (seconds < 1e-3) {
+        return QStringLiteral("%1 µs").arg(seconds * 1e6, 0, 'f', 0);
+    }
+    if (seconds < 1.0) {
+        return QStringLiteral("%1 ms").arg(seconds * 1e3, 0, 'f', 1);
+    }
+    return QStringLiteral("%1 s").arg(seconds, 0, 'f', 2);
+}
+
+QString formatValue(const PerfMetrics::Series& s)
+{
+    if (s.kind == PerfMetrics::Kind::Histogram) {
+        if (s.count == 0) {
+            return QStringLiteral("no samples");
+        }
+        return QStringLiteral("n=%1  p50 ≤ %2  p90 ≤ %3  p99 ≤ %4")
+            .arg(s.count)
+            .arg(formatSeconds(s.p50), formatSeconds(s.p90), formatSeconds(s.p99));
+    }
+    if (s.name.endsWith(QStringLiteral("_bytes_total"))) {
+        return QLocale().formattedDataSize(static_cast<qint64>(s.value));
+    }
+    return QString::number(static_cast<qint64>(s.value));
+}
+
+QTableWidgetItem* readOnlyItem(const QString& text, const QString& tip = {})
+{
+    auto* item = new QTableWidgetItem(text);
+    item->setFlags(item->flags() & ~Qt::ItemIsEditable);
+    item->setToolTip(tip);
+    return item;
+}
+
+}  // namespace
+
+PerfMetricsDialog::PerfMetricsDialog(QWidget* parent)
+    : QDialog(parent)
+{
+    setWindowTitle(QStringLiteral("Performance counters"));
+    setMinimumSize(720, 420);
+    setStyleSheet(FSStyle.dialogStyleSheet());
+
+    auto* layout = new QVBoxLayout(this);
+    auto* intro = new QLabel(QStringLiteral(
+        "Counters since this session started. Latencies are bucket upper bounds (within 2×). "
+        "Start with --metrics <path> to have them written for Prometheus."));
+    intro->setWordWrap(true);
+    layout->addWidget(intro);
+
+    m_table = new QTableWidget(0, 3);
+    m_table->setHorizontalHeaderLabels({QStringLiteral("Metric"), QStringLiteral("Labels"),
+                                       QStringLiteral("Value")});
+    m_table->verticalHeader()->setVisible(false);
+    m_table->horizontalHeader()->setStretchLastSection(true);
+    m_table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setAlternatingRowColors(true);
+    m_table->setStyleSheet(FSStyle.dataTableStyleSheet());
+    layout->addWidget(m_table, 1);
+
+    auto* buttons = new QDialogButtonBox(QDialogButtonBox::Close);
+    QPushButton* copyBtn = buttons->addButton(QStringLiteral("Copy as Prometheus text"),
+                                              QDialogButtonBox::ActionRole);
+    QPushButton* saveBtn = buttons->addButton(QStringLiteral("Save…"), QDialogButtonBox::ActionRole);
+    QPushButton* recordingBtn = buttons->addButton(QStringLiteral("Save flight recording…"),
+                                                   QDialogButtonBox::ActionRole);
+    recordingBtn->setToolTip(QStringLiteral("Slow spans, counters and warnings of recent sessions, "
+                                            "as a Chrome trace (chrome://tracing, Perfetto)"));
+    connect(copyBtn, &QPushButton::clicked, this, []() {
+        QApplication::clipboard()->setText(QString::fromUtf8(PerfMetrics::toPrometheusText()));
+    });
+    connect(saveBtn, &QPushButton::clicked, this, &PerfMetricsDialog::saveAs);
+    connect(recordingBtn, &QPushButton::clicked, this, &PerfMetricsDialog::saveFlightRecording);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    layout->addWidget(buttons);
+
+    m_refreshTimer = new QTimer(this);
+    m_refreshTimer->setInterval(1000);
+    connect(m_refreshTimer, &QTimer::timeout, this, &PerfMetricsDialog::refresh);
+    m_refreshTimer->start();
+    refresh();
+}
+
+void PerfMetricsDialog::refresh()
+{
+    const QList<PerfMetrics::Series> series = PerfMetrics::snapshot();
+
+    // Hit rates per cache, derived from the hit and miss counters
+    struct Lookups {
+        double hits = 0;
+        double misses = 0;
+    };
+    QMap<QString, Lookups> caches;
+    for (const PerfMetrics::Series& s : series) {
+        if (s.name != QLatin1String("flashspartan_cache_lookups_total")) {
+            continue;
+        }
+        const QString cache = s.labels.section(QLatin1Char('"'), 1, 1);
+        (s.labels.contains(QLatin1String("result=\"hit\"")) ? caches[cache].hits : caches[cache].misses) += s.value;
+    }
+
+    m_table->setRowCount(static_cast<int>(series.size() + caches.size()));
+    int row = 0;
+    for (const PerfMetrics::Series& s : series) {
+        m_table->setItem(row, 0, readOnlyItem(s.name, s.help));
+        m_table->setItem(row, 1, readOnlyItem(s.labels));
+        m_table->setItem(row, 2, readOnlyItem(formatValue(s)));
+        ++row;
+    }
+    for (auto it = caches.cbegin(); it != caches.cend(); ++it) {
+        const double total = it->hits + it->misses;
+        m_table->setItem(row, 0, readOnlyItem(QStringLiteral("cache hit rate"),
+                                             QStringLiteral("hits / lookups")));
+        m_table->setItem(row, 1, readOnlyItem(QStringLiteral("cache=\"%1\"").arg(it.key())));
+        m_table->setItem(row, 2, readOnlyItem(total > 0 ? QStringLiteral("%1 % of %2")
+                                                             .arg(100.0 * it->hits / total, 0, 'f', 1)
+                                                             .arg(static_cast<qint64>(total))
+                                                       : QStringLiteral("no lookups")));
+        ++row;
+    }
+    m_table->resizeColumnToContents(0);
+    m_table->resizeColumnToContents(1);
+}
+
+void PerfMetricsDialog::saveAs()
+{
+    const QString path = QFileDialog::getSaveFileName(
+        this, QStringLiteral("Save performance counters"), AppDiagnostics::metricsPath(),
+        QStringLiteral("Prometheus text (*.prom);;All files (*)"));
+    if (!path.isEmpty()) {
+        PerfMetrics::writeTo(path);
+    }
+}
+
+void PerfMetricsDialog::saveFlightRecording()
+{
+    const QString path = QFileDialog::getSaveFileName(
+        this, QStringLiteral("Save flight recording"),
+        AppDiagnostics::logsDir() + QStringLiteral("/flight-recording.json"),
+        QStringLiteral("Chrome trace (*.json);;All files (*)"));
+    if (path.isEmpty()) {
+        return;
+    }
+    QString error;
+    if (!AppDiagnostics::dumpFlightRecorder(path, &error)) {
+        QMessageBox::warning(this, QStringLiteral("Save flight recording"), error);
+    }
+}
+
+} // namespace FlashSpartan
@@ -0,0 +1,30 @@
+#include "PolicyDecisionCache.h"
+
+namespace FlashSpartan {
+
+std::optional<PolicyDecision> PolicyDecisionCache::find(const QString& deviceId, const QString& driveKey,
+                                                        const Sources& sources)
+{
+    if (!(sources == m_sources)) {
+        m_decisions.clear();
+        m_sources = sources;
+        return std::nullopt;
+    }
+    const auto it = m_decisions.constFind(deviceId);
+    if (it == m_decisions.cend() || it->driveKey != driveKey) {
+        return std::nullopt;
+    }
+    return *it;
+}
+
+void PolicyDecisionCache::insert(const QString& deviceId, const PolicyDecision& decision)
+{
+    m_decisions.insert(deviceId, decision);
+}
+
+void PolicyDecisionCache::clear()
+{
+    m_decisions.clear();
+}
+
+} // namespace FlashSpartan
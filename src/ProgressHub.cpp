@@ -0,0 +1,103 @@
+#include "ProgressHub.h"
+
+#include <QSet>
+#include <QThread>
+
+namespace FlashSpartan {
+
+ProgressHub& ProgressHub::instance()
+{
+    static ProgressHub hub;
+    return hub;
+}
+
+ProgressHub::ProgressHub(QObject* parent)
+    : QObject(parent)
+{
+    m_clock.start();
+    updateInterval();
+    connect(&m_timer, &QTimer::timeout, this, &ProgressHub::tick);
+}
+
+void ProgressHub::addSource(QObject* owner, Source source)
+{
+    m_sources.insert(owner, std::move(source));
+    connect(owner, &QObject::destroyed, this, [this, owner]() { m_sources.remove(owner); });
+}
+
+void ProgressHub::wake()
+{
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, &ProgressHub::wake, Qt::QueuedConnection);
+        return;
+    }
+    if (!m_timer.isActive()) {
+        m_timer.start();
+    }
+}
+
+void ProgressHub::setFrameRate(double hz)
+{
+    if (hz > 0.0) {
+        m_frameRate = hz;
+        updateInterval();
+    }
+}
+
+void ProgressHub::setBackground(bool background)
+{
+    if (background != m_background) {
+        m_background = background;
+        updateInterval();
+    }
+}
+
+void ProgressHub::republish(const ProgressSample& sample)
+{
+    m_published.remove(keyOf(sample));
+}
+
+void ProgressHub::tick()
+{
+    const qint64 now = m_clock.elapsed();
+    QList<ProgressSample> changed;
+    QSet<QString> running;
+    const QList<Source> sources = m_sources.values();  // a receiver may add one
+    for (const Source& source : sources) {
+        for (const ProgressSample& sample : source()) {
+            const QString key = keyOf(sample);
+            running.insert(key);
+            const auto it = m_published.constFind(key);
+            if (it != m_published.cend()) {
+                const bool moved = qAbs(sample.fraction - it->fraction) >= kFractionStep
+                    || (sample.fraction >= 1.0 && it->fraction < 1.0);
+                if (!moved && sample.detail == it->detail && now - it->atMs < kLabelRefreshMs) {
+                    continue;
+                }
+            }
+            m_published.insert(key, Published{sample.fraction, sample.detail, now});
+            changed.append(sample);
+        }
+    }
+    for (auto it = m_published.begin(); it != m_published.end();) {
+        it = running.contains(it.key()) ? std::next(it) : m_published.erase(it);
+    }
+    if (running.isEmpty()) {
+        m_timer.stop();
+    }
+    if (!changed.isEmpty()) {
+        emit published(changed);
+    }
+}
+
+QString ProgressHub::keyOf(const ProgressSample& sample)
+{
+    return QString::number(int(sample.kind)) + QLatin1Char(':') + sample.jobId;
+}
+
+void ProgressHub::updateInterval()
+{
+    m_timer.setInterval(m_background ? kBackgroundIntervalMs : qMax(1, qRound(1000.0 / m_frameRate)));
+}
+
+} // namespace FlashSpartan
@@ -1,14 +1,28 @@
 #include "RawDeviceHash.h"
 #include "RawDeviceHashAdvanced.h"
+#include "HashEngine.h"
+#include "HashPipeline.h"
+#include "HelperProtocol.h"
+#include "HexEncoding.h"
+#include "IoBufferPool.h"
+#include "IoPriority.h"
+#include "PerfMetrics.h"
+#include "PerfTrace.h"
+#include "Blake3Digest.h"
+#include "Xxh3Digest.h"
 
 #include <QProcess>
 #include <QProcessEnvironment>
+#include <QCryptographicHash>
 #include <QDir>
 #include <QFileInfo>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QFile>
+#include <QRegularExpression>
 #include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
 
 #include <cerrno>
 
@@ -16,8 +30,85 @@
 #define ENOTSUP EINVAL
 #endif
 
+#include <algorithm>
+#include <optional>
+
+namespace FlashSpartan::RawDeviceHash {
+
+void waitWhilePaused(const Options& options)
+{
+    while (options.paused && options.paused->load()
+           && !(options.cancelled && options.cancelled->load())) {
+        QThread::msleep(50);
+    }
+    if (options.pacedBytes && options.bytesProcessed) {
+        // Parallel workers share the counters; only the thread that moves the mark pays.
+        const uint64_t done = options.bytesProcessed->load();
+        uint64_t charged = options.pacedBytes->load();
+        while (done > charged && !options.pacedBytes->compare_exchange_weak(charged, done)) {
+        }
+        if (done > charged) {
+            IoPriority::pace(static_cast<qint64>(done - charged), options.cancelled);
+        }
+    }
+}
+
+namespace {
+
+/** @p options, paced from @p paced when the calling thread reads in the background class. */
+Options withBackgroundPacing(const Options& options, std::atomic<uint64_t>& paced)
+{
+    Options out = options;
+    if (!out.pacedBytes && out.bytesProcessed && IoPriority::current() == IoPriority::Class::Background) {
+        // A resume reports its starting offset first; that was read by an earlier run.
+        paced.store(qMax<uint64_t>(out.bytesProcessed->load(), out.resumeFromBytes));
+        out.pacedBytes = &paced;
+    }
+    return out;
+}
+
+} // namespace
+
+std::vector<int> bufferTuneCandidatesKB(const QueueLimits& limits)
+{
+    std::vector<int> candidates = {256, 512, 1024, 2048, 4096, 8192};
+    // Whole multiples of the largest request keep the queue full without a short tail request.
+    if (limits.maxSectorsKB > 0) {
+        for (int factor : {1, 4, 16}) {
+            candidates.push_back(limits.maxSectorsKB * factor);
+        }
+    }
+    if (limits.optimalIoKB > 0) {
+        candidates.push_back(((1024 + limits.optimalIoKB - 1) / limits.optimalIoKB)
+                             * limits.optimalIoKB);
+    }
+    for (int& kb : candidates) {
+        kb = normalizedBufferSizeKB(kb);
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+    return candidates;
+}
+
+QString externalDiskRefusal(const DeviceAttachment& attachment, bool allowFixed)
+{
+    if (!attachment.known) {
+        return QStringLiteral("Not a disk in /sys/class/block");
+    }
+    if (attachment.backsRoot) {
+        return QStringLiteral("%1 holds the root filesystem").arg(attachment.disk);
+    }
+    if (!allowFixed && !attachment.removable && !attachment.usb) {
+        return QStringLiteral("%1 is neither removable nor attached over USB").arg(attachment.disk);
+    }
+    return QString();
+}
+
+} // namespace FlashSpartan::RawDeviceHash
+
 #ifdef Q_OS_WIN
 
+#include "WinOverlappedReader.h"
 #include "WinStorage.h"
 #include "RawDeviceHashAdvanced.h"
 
@@ -43,30 +134,8 @@ namespace FlashSpartan::RawDeviceHash {
 
 namespace {
 
-const EVP_MD* mdFor(Algorithm algo)
-{
-    switch (algo) {
-        case Algorithm::SHA512:
-            return EVP_sha512();
-        case Algorithm::BLAKE2b:
-            return EVP_blake2b512();
-        case Algorithm::SHA256:
-        default:
-            return EVP_sha256();
-    }
-}
-
-bool cancelled(const Options& options)
-{
-    return options.cancelled && options.cancelled->load();
-}
-
-void reportProgress(const Options& options, uint64_t value)
-{
-    if (options.bytesProcessed) {
-        options.bytesProcessed->store(value);
-    }
-}
+using Engine::cancelled;
+using Engine::reportProgress;
 
 HANDLE handleFromFd(int fd)
 {
@@ -130,82 +199,89 @@ QString resolveHelperPath(const QString& helperPath)
     return compiled;
 }
 
-HashResult hashReadLoopWin(HANDLE handle, const Options& options, uint64_t deviceSize)
-{
-    HashResult result;
-    result.deviceNode = options.deviceNode;
-    result.algorithm = algorithmName(options.algorithm);
-
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    if (!mdctx || EVP_DigestInit_ex(mdctx, mdFor(options.algorithm), nullptr) != 1) {
-        if (mdctx) {
-            EVP_MD_CTX_free(mdctx);
-        }
-        result.errorMessage = QStringLiteral("Failed to initialize hash algorithm");
-        return result;
-    }
-
-    const size_t bufferSize =
-        static_cast<size_t>(normalizedBufferSizeKB(options.bufferSizeKB)) * 1024;
-    QByteArray buffer;
-    buffer.resize(static_cast<int>(bufferSize));
-
-    uint64_t totalRead = 0;
-    while (totalRead < deviceSize) {
-        if (cancelled(options)) {
-            EVP_MD_CTX_free(mdctx);
-            result.errorMessage = QStringLiteral("Cancelled");
-            return result;
-        }
+/** Positioned ReadFile() of [offset, offset + length) on a synchronous handle. */
+struct WinReadAt {
+    HANDLE handle;
 
+    int64_t operator()(char* buffer, size_t length, uint64_t offset, JobMeter& /*meter*/, QString* error) const
+    {
         LARGE_INTEGER pos{};
-        pos.QuadPart = static_cast<LONGLONG>(totalRead);
+        pos.QuadPart = static_cast<LONGLONG>(offset);
         if (!SetFilePointerEx(handle, pos, nullptr, FILE_BEGIN)) {
-            EVP_MD_CTX_free(mdctx);
-            result.errorMessage =
-                QStringLiteral("Seek failed: Win32 error %1").arg(GetLastError());
-            return result;
+            *error = QStringLiteral("Seek failed: Win32 error %1").arg(GetLastError());
+            return -1;
         }
-
-        const DWORD toRead =
-            static_cast<DWORD>(qMin<uint64_t>(bufferSize, deviceSize - totalRead));
         DWORD bytesRead = 0;
-        if (!ReadFile(handle, buffer.data(), toRead, &bytesRead, nullptr) || bytesRead == 0) {
-            EVP_MD_CTX_free(mdctx);
-            result.errorMessage = QStringLiteral("Read error: Win32 error %1")
-                                      .arg(GetLastError());
-            return result;
+        if (!ReadFile(handle, buffer, static_cast<DWORD>(length), &bytesRead, nullptr)) {
+            *error = QStringLiteral("Read error: Win32 error %1").arg(GetLastError());
+            return -1;
         }
+        return static_cast<int64_t>(bytesRead);
+    }
+};
 
-        if (EVP_DigestUpdate(mdctx, buffer.constData(), bytesRead) != 1) {
-            EVP_MD_CTX_free(mdctx);
-            result.errorMessage = QStringLiteral("Failed to update hash");
-            return result;
-        }
+HashResult hashReadLoopWin(HANDLE handle, const Options& options, uint64_t deviceSize)
+{
+    const size_t bufferSize = static_cast<size_t>(normalizedBufferSizeKB(options.bufferSizeKB)) * 1024;
+    if (options.pipelineDepth >= 2) {
+        Engine::PipelinedSource<WinReadAt> source(WinReadAt{handle}, bufferSize,
+                                                  qMin(options.pipelineDepth, kMaxPipelineDepth));
+        return Engine::hash(source, options, deviceSize);
+    }
+    Engine::ReadSource<WinReadAt> source(WinReadAt{handle}, bufferSize);
+    return Engine::hash(source, options, deviceSize);
+}
 
-        totalRead += bytesRead;
-        reportProgress(options, totalRead);
+/** WinOverlappedReader as an engine source; it already delivers buffers in offset order. */
+class OverlappedSource {
+public:
+    OverlappedSource(HANDLE handle, int depth, size_t bufferSize)
+        : m_reader(handle, depth, bufferSize)
+        , m_depth(depth)
+        , m_bufferSize(bufferSize)
+    {
     }
 
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hashLen = 0;
-    if (EVP_DigestFinal_ex(mdctx, hash, &hashLen) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        result.errorMessage = QStringLiteral("Failed to finalize hash");
-        return result;
+    bool open(QString* error) { return m_reader.open(error); }
+
+    template <class Consume>
+    bool run(uint64_t deviceSize, JobMeter& /*meter*/, Consume&& consume, QString* error)
+    {
+        return m_reader.read(0, deviceSize, [&](const char* data, size_t length) { return consume(data, length); },
+                             error);
     }
 
-    QByteArray hashHex;
-    hashHex.reserve(static_cast<int>(hashLen * 2));
-    for (unsigned int i = 0; i < hashLen; ++i) {
-        hashHex.append(QStringLiteral("%1").arg(hash[i], 2, 16, QChar('0')).toLatin1());
+    void describe(HashResult& result, JobMeter& meter, uint64_t elapsedMs) const
+    {
+        meter.readsTookTheRest(elapsedMs);
+        meter.fill(result.performance, QStringLiteral("overlapped"), static_cast<int>(m_bufferSize / 1024), m_depth);
     }
 
-    result.hash = QString::fromLatin1(hashHex);
-    result.bytesProcessed = totalRead;
-    result.success = true;
-    EVP_MD_CTX_free(mdctx);
-    return result;
+private:
+    WinOverlappedReader m_reader;
+    int m_depth;
+    size_t m_bufferSize;
+};
+
+/**
+ * Full hash with normalizedIoQueueDepth() unbuffered reads in flight (WinOverlappedReader),
+ * hashed in offset order so the digest matches hashReadLoopWin(). Sets *unsupported when the
+ * device cannot be reopened that way, so the caller can use the ReadFile loop.
+ */
+HashResult hashOverlappedWin(HANDLE handle, const Options& options, uint64_t deviceSize, bool* unsupported)
+{
+    OverlappedSource source(handle, normalizedIoQueueDepth(options.ioQueueDepth),
+                            static_cast<size_t>(normalizedBufferSizeKB(options.bufferSizeKB)) * 1024);
+    QString error;
+    *unsupported = !source.open(&error);
+    if (*unsupported) {
+        HashResult result;
+        result.deviceNode = options.deviceNode;
+        result.algorithm = algorithmName(options.algorithm);
+        result.errorMessage = error;
+        return result;
+    }
+    return Engine::hash(source, options, deviceSize);
 }
 
 HashResult hashViaElevatedHelper(const Options& options, const QString& helperPath)
@@ -283,6 +359,10 @@ HashResult hashViaElevatedHelper(const Options& options, const QString& helperPa
 
     result.hash = obj.value(QStringLiteral("hash")).toString();
     result.bytesProcessed = static_cast<uint64_t>(obj.value(QStringLiteral("bytes")).toDouble());
+    result.readStallMs = static_cast<uint64_t>(obj.value(QStringLiteral("read_stall_ms")).toDouble());
+    result.hashStallMs = static_cast<uint64_t>(obj.value(QStringLiteral("hash_stall_ms")).toDouble());
+    result.performance = HashPerformance::fromJson(obj.value(QStringLiteral("perf")).toObject());
+    result.performance.elevated = true;
     result.success = true;
     reportProgress(options, result.bytesProcessed);
     return result;
@@ -299,6 +379,10 @@ QString algorithmName(Algorithm algo)
             return QStringLiteral("SHA512");
         case Algorithm::BLAKE2b:
             return QStringLiteral("BLAKE2b");
+        case Algorithm::BLAKE3:
+            return QStringLiteral("BLAKE3");
+        case Algorithm::XXH3_128:
+            return QStringLiteral("XXH3-128");
     }
     return QStringLiteral("SHA256");
 }
@@ -312,9 +396,29 @@ Algorithm algorithmFromName(const QString& name)
     if (upper == QStringLiteral("BLAKE2B") || upper == QStringLiteral("BLAKE2b")) {
         return Algorithm::BLAKE2b;
     }
+    if (upper == QStringLiteral("BLAKE3")) {
+        return Algorithm::BLAKE3;
+    }
+    if (upper == QStringLiteral("XXH3-128") || upper == QStringLiteral("XXH3")) {
+        return Algorithm::XXH3_128;
+    }
     return Algorithm::SHA256;
 }
 
+bool algorithmIsCryptographic(Algorithm algo)
+{
+    return algo != Algorithm::XXH3_128;
+}
+
+bool algorithmAvailable(Algorithm algo)
+{
+    switch (algo) {
+        case Algorithm::BLAKE3: return blake3Digest() != nullptr;
+        case Algorithm::XXH3_128: return xxh3_128Digest() != nullptr;
+        default: return true;
+    }
+}
+
 int normalizedBufferSizeKB(int requestedKB)
 {
     if (requestedKB <= 0) {
@@ -329,6 +433,89 @@ int normalizedBufferSizeKB(int requestedKB)
     return requestedKB;
 }
 
+QString ioEngineName(IoEngine engine)
+{
+    return engine == IoEngine::IoUring ? QStringLiteral("io_uring") : QStringLiteral("default");
+}
+
+IoEngine ioEngineFromName(const QString& name)
+{
+    const QString lower = name.trimmed().toLower();
+    if (lower == QStringLiteral("io_uring") || lower == QStringLiteral("uring")) {
+        return IoEngine::IoUring;
+    }
+    return IoEngine::Default;
+}
+
+int normalizedIoQueueDepth(int requested)
+{
+    if (requested <= 0) {
+        return kDefaultIoQueueDepth;
+    }
+    return qBound(kMinIoQueueDepth, requested, kMaxIoQueueDepth);
+}
+
+bool ioUringAvailable()
+{
+    return false;
+}
+
+QueueLimits queueLimits(const QString& /*deviceNode*/)
+{
+    return {};
+}
+
+std::vector<Region> partitionRegions(const QString& /*diskNode*/)
+{
+    return {};
+}
+
+StorageIdentity storageIdentity(const QString& /*deviceNode*/)
+{
+    return {};
+}
+
+DeviceAttachment deviceAttachment(const QString& /*deviceNode*/)
+{
+    return {};
+}
+
+DeviceAttachment deviceAttachmentAt(const QString& /*sysEntry*/, const QStringList& /*rootDisks*/)
+{
+    return {};
+}
+
+QStringList rootDisks()
+{
+    return {};
+}
+
+int openHelperDevice(const QString& deviceNode, QString* refusal)
+{
+    return openHelperDeviceAt(deviceNode, QString(), {}, refusal);
+}
+
+int openHelperDeviceAt(const QString& deviceNode, const QString& /*sysDevBlock*/, const QStringList& /*rootDisks*/,
+                       QString* refusal)
+{
+    const int fd = openDevice(deviceNode);
+    if (fd < 0 && refusal) {
+        *refusal = QStringLiteral("Failed to open device: %1").arg(QString::fromLocal8Bit(strerror(errno)));
+    }
+    return fd;
+}
+
+BufferTuning autoTuneBufferSize(int /*fd*/, const QString& /*deviceNode*/, uint64_t /*probeBytes*/)
+{
+    return {};
+}
+
+BufferTuning autoTuneBufferSize(int /*fd*/, const QueueLimits& /*limits*/, uint64_t /*deviceBytes*/,
+                                uint64_t /*probeBytes*/)
+{
+    return {};
+}
+
 int openDevice(const QString& deviceNode)
 {
     int validationError = 0;
@@ -365,25 +552,54 @@ void closeDevice(int fd)
 
 HashResult hashOpenFd(int fd, const Options& options)
 {
+    FLASHSPARTAN_TRACE_SPAN("raw", "hashOpenFd");
     HashResult result;
     result.deviceNode = options.deviceNode;
 
-    const uint64_t size = deviceSize(fd, options.deviceNode);
+    if (!algorithmAvailable(options.algorithm)) {
+        result.errorMessage = QStringLiteral("%1 is not available in this build")
+                                  .arg(algorithmName(options.algorithm));
+        return result;
+    }
+
+    uint64_t size = deviceSize(fd, options.deviceNode);
     if (size == 0) {
         result.errorMessage = QStringLiteral("Device size is 0");
         return result;
     }
+    if (options.lengthLimit > 0) {
+        if (size < options.lengthLimit) {
+            result.errorMessage = QStringLiteral("Device holds %1 bytes, fewer than the %2 to hash")
+                                      .arg(size)
+                                      .arg(options.lengthLimit);
+            return result;
+        }
+        size = options.lengthLimit;
+    }
+    if (options.totalBytes) {
+        options.totalBytes->store(size);
+    }
 
-    if (options.scanMode == ScanMode::QuickSample || options.checkpointOut
-        || options.resumeFromBytes > 0) {
+    if (options.tolerateReadErrors) {
+        return hashTolerant({}, options, size);
+    }
+    if (options.scanMode == ScanMode::QuickSample || options.scanMode == ScanMode::ParallelChunked
+        || options.checkpointOut || options.resumeFromBytes > 0) {
         return hashAdvanced(fd, options, size);
     }
 
+    bool unsupported = false;
+    result = hashOverlappedWin(handleFromFd(fd), options, size, &unsupported);
+    if (!unsupported) {
+        return result;
+    }
     return hashReadLoopWin(handleFromFd(fd), options, size);
 }
 
-HashResult hashDevice(const Options& options, const QString& pkexecHelperPath)
+HashResult hashDevice(const Options& callerOptions, const QString& pkexecHelperPath)
 {
+    std::atomic<uint64_t> paced{0};
+    const Options options = withBackgroundPacing(callerOptions, paced);
     HashResult result;
     result.deviceNode = options.deviceNode;
     result.algorithm = algorithmName(options.algorithm);
@@ -404,10 +620,20 @@ HashResult hashDevice(const Options& options, const QString& pkexecHelperPath)
     return result;
 }
 
+void closeHelperSession()
+{
+}
+
+void forgetDeviceAccess(const QString& /*deviceNode*/)
+{
+}
+
 } // namespace FlashSpartan::RawDeviceHash
 
 #else
 
+#include "HelperSession.h"
+
 #include <openssl/evp.h>
 
 #include <fcntl.h>
@@ -415,28 +641,22 @@ HashResult hashDevice(const Options& options, const QString& pkexecHelperPath)
 #include <sys/stat.h>
 #include <sys/mman.h>
 #include <sys/ioctl.h>
+#include <sys/sysmacros.h>
 #include <linux/fs.h>
 #include <cerrno>
 #include <cstring>
+#include <vector>
+
+#ifdef HAS_LIBURING
+#include <liburing.h>
+#endif
 
 namespace FlashSpartan::RawDeviceHash {
 
 namespace {
 
-const EVP_MD* mdFor(Algorithm algo)
-{
-    switch (algo) {
-        case Algorithm::SHA256: return EVP_sha256();
-        case Algorithm::SHA512: return EVP_sha512();
-        case Algorithm::BLAKE2b: return EVP_blake2b512();
-    }
-    return EVP_sha256();
-}
-
-bool cancelled(const Options& options)
-{
-    return options.cancelled && options.cancelled->load();
-}
+using Engine::cancelled;
+using Engine::reportProgress;
 
 bool isUnderDev(const QString& path)
 {
@@ -468,165 +688,301 @@ QString validatedDevicePath(const QString& deviceNode, int* errorCode)
     return canonical;
 }
 
-void reportProgress(const Options& options, uint64_t value)
-{
-    if (options.bytesProcessed) {
-        options.bytesProcessed->store(value);
+/** pread() of [offset, offset + length), retried on EINTR. */
+struct PreadAt {
+    int fd;
+
+    int64_t operator()(char* buffer, size_t length, uint64_t offset, JobMeter& meter, QString* error) const
+    {
+        for (;;) {
+            const ssize_t n = pread(fd, buffer, length, static_cast<off_t>(offset));
+            if (n >= 0) {
+                return static_cast<int64_t>(n);
+            }
+            if (errno != EINTR) {
+                *error = QString("Read error: %1").arg(strerror(errno));
+                return -1;
+            }
+            meter.retried();
+        }
     }
-}
+};
 
-HashResult hashReadLoop(int fd, const Options& options, uint64_t /*deviceSize*/)
+/** Reads [0, deviceSize) with pread(), so the descriptor's file offset does not matter. */
+HashResult hashReadLoop(int fd, const Options& options, uint64_t deviceSize)
 {
-    HashResult result;
-    result.deviceNode = options.deviceNode;
-    result.algorithm = algorithmName(options.algorithm);
-
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    if (!mdctx) {
-        result.errorMessage = "Failed to create hash context";
-        return result;
-    }
-
-    if (EVP_DigestInit_ex(mdctx, mdFor(options.algorithm), nullptr) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        result.errorMessage = "Failed to initialize hash algorithm";
-        return result;
-    }
-
     const size_t bufferSize = static_cast<size_t>(normalizedBufferSizeKB(options.bufferSizeKB)) * 1024;
-    void* buffer = nullptr;
-    if (posix_memalign(&buffer, 4096, bufferSize) != 0) {
-        EVP_MD_CTX_free(mdctx);
-        result.errorMessage = "Failed to allocate buffer";
-        return result;
+    if (options.pipelineDepth >= 2) {
+        Engine::PipelinedSource<PreadAt> source(PreadAt{fd}, bufferSize,
+                                                qMin(options.pipelineDepth, kMaxPipelineDepth));
+        return Engine::hash(source, options, deviceSize);
     }
+    Engine::ReadSource<PreadAt> source(PreadAt{fd}, bufferSize);
+    return Engine::hash(source, options, deviceSize);
+}
 
-    uint64_t totalRead = 0;
-    ssize_t bytesRead = 0;
-
-    while ((bytesRead = read(fd, buffer, bufferSize)) > 0) {
-        if (cancelled(options)) {
-            free(buffer);
-            EVP_MD_CTX_free(mdctx);
-            result.errorMessage = "Cancelled";
-            return result;
-        }
-        if (EVP_DigestUpdate(mdctx, buffer, static_cast<size_t>(bytesRead)) != 1) {
-            free(buffer);
-            EVP_MD_CTX_free(mdctx);
-            result.errorMessage = "Failed to update hash";
-            return result;
+/** Maps the device a window at a time and hands the mapping out one read buffer at a time. */
+class MmapSource {
+public:
+    static constexpr size_t kWindowBytes = 256 * 1024 * 1024;
+
+    MmapSource(int fd, size_t sliceSize)
+        : m_fd(fd)
+        , m_sliceSize(sliceSize)
+    {
+    }
+
+    template <class Consume>
+    bool run(uint64_t deviceSize, JobMeter& /*meter*/, Consume&& consume, QString* error)
+    {
+        for (uint64_t offset = 0; offset < deviceSize;) {
+            const size_t mapSize = static_cast<size_t>(qMin<uint64_t>(deviceSize - offset, kWindowBytes));
+            void* mapped = mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, m_fd, static_cast<off_t>(offset));
+            if (mapped == MAP_FAILED) {
+                *error = QString("mmap failed: %1").arg(strerror(errno));
+                return false;
+            }
+            madvise(mapped, mapSize, MADV_SEQUENTIAL);
+            FLASHSPARTAN_TRACE_SPAN_VALUE("raw", "digest_mapped", mapSize);
+            // Slices, not the whole mapping: on a slow stick a mapping is many seconds of
+            // page faults, too long to wait for a cancel or pause.
+            bool ok = true;
+            for (size_t done = 0; ok && done < mapSize;) {
+                const size_t slice = qMin(mapSize - done, m_sliceSize);
+                ok = consume(static_cast<const char*>(mapped) + done, slice);
+                done += slice;
+            }
+            munmap(mapped, mapSize);
+            if (!ok) {
+                return false;
+            }
+            offset += mapSize;
         }
-        totalRead += static_cast<uint64_t>(bytesRead);
-        reportProgress(options, totalRead);
-    }
-
-    if (bytesRead < 0) {
-        free(buffer);
-        EVP_MD_CTX_free(mdctx);
-        result.errorMessage = QString("Read error: %1").arg(strerror(errno));
-        return result;
+        return true;
     }
 
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hashLen = 0;
-    if (EVP_DigestFinal_ex(mdctx, hash, &hashLen) != 1) {
-        free(buffer);
-        EVP_MD_CTX_free(mdctx);
-        result.errorMessage = "Failed to finalize hash";
-        return result;
+    void describe(HashResult& result, JobMeter& meter, uint64_t /*elapsedMs*/) const
+    {
+        // Page faults are taken inside the digest, so mapped reads count as CPU time
+        meter.fill(result.performance, QStringLiteral("mmap"), static_cast<int>(kWindowBytes / 1024), 1);
     }
 
-    QByteArray hashHex;
-    hashHex.reserve(static_cast<int>(hashLen * 2));
-    for (unsigned int i = 0; i < hashLen; ++i) {
-        hashHex.append(QString("%1").arg(hash[i], 2, 16, QChar('0')).toLatin1());
-    }
-
-    result.hash = QString::fromLatin1(hashHex);
-    result.bytesProcessed = totalRead;
-    result.success = true;
-
-    free(buffer);
-    EVP_MD_CTX_free(mdctx);
-    return result;
-}
+private:
+    int m_fd;
+    size_t m_sliceSize;
+};
 
 HashResult hashMmapLoop(int fd, const Options& options, uint64_t deviceSize)
 {
-    HashResult result;
-    result.deviceNode = options.deviceNode;
-    result.algorithm = algorithmName(options.algorithm);
-
-    if (deviceSize == 0) {
-        result.errorMessage = "Device size is 0";
-        return result;
-    }
+    MmapSource source(fd, static_cast<size_t>(normalizedBufferSizeKB(options.bufferSizeKB)) * 1024);
+    return Engine::hash(source, options, deviceSize);
+}
 
-    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
-    if (!mdctx) {
-        result.errorMessage = "Failed to create hash context";
-        return result;
+#ifdef HAS_LIBURING
+/**
+ * Keeps up to depth O_DIRECT reads outstanding and hands completed buffers out strictly in
+ * offset order, so the digest is identical to hashReadLoop().
+ */
+class UringSource {
+public:
+    UringSource(int fd, size_t bufferSize, size_t depth)
+        : m_fd(fd)
+        , m_bufferSize(bufferSize)
+        , m_slots(depth)
+    {
+    }
+
+    ~UringSource()
+    {
+        if (!m_open) {
+            return;
+        }
+        // Reap every outstanding read before the buffers are released.
+        for (Slot& slot : m_slots) {
+            while (slot.inFlight) {
+                io_uring_cqe* cqe = nullptr;
+                if (io_uring_wait_cqe(&m_ring, &cqe) < 0) {
+                    break;
+                }
+                const size_t idx = static_cast<size_t>(reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)));
+                io_uring_cqe_seen(&m_ring, cqe);
+                if (idx < m_slots.size()) {
+                    m_slots[idx].inFlight = false;
+                }
+            }
+        }
+        io_uring_queue_exit(&m_ring);
     }
 
-    if (EVP_DigestInit_ex(mdctx, mdFor(options.algorithm), nullptr) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        result.errorMessage = "Failed to initialize hash algorithm";
-        return result;
-    }
+    UringSource(const UringSource&) = delete;
+    UringSource& operator=(const UringSource&) = delete;
 
-    const size_t chunkSize = 256 * 1024 * 1024;
-    uint64_t offset = 0;
-
-    while (offset < deviceSize) {
-        if (cancelled(options)) {
-            EVP_MD_CTX_free(mdctx);
-            result.errorMessage = "Cancelled";
-            return result;
+    /** False (with @p error) when the ring cannot be created (old kernel, seccomp). */
+    bool open(QString* error)
+    {
+        const int rc = io_uring_queue_init(static_cast<unsigned>(m_slots.size()), &m_ring, 0);
+        if (rc < 0) {
+            *error = QString("io_uring unavailable: %1").arg(strerror(-rc));
+            return false;
         }
-
-        const size_t mapSize = static_cast<size_t>(qMin(deviceSize - offset, static_cast<uint64_t>(chunkSize)));
-        void* mapped = mmap(nullptr, mapSize, PROT_READ, MAP_PRIVATE, fd, static_cast<off_t>(offset));
-        if (mapped == MAP_FAILED) {
-            EVP_MD_CTX_free(mdctx);
-            result.errorMessage = QString("mmap failed: %1").arg(strerror(errno));
-            return result;
+        m_open = true;
+        return true;
+    }
+
+    template <class Consume>
+    bool run(uint64_t deviceSize, JobMeter& meter, Consume&& consume, QString* error)
+    {
+        for (Slot& slot : m_slots) {
+            slot.pooled = IoBufferPool::Buffer(m_bufferSize);
+            if (!slot.pooled) {
+                *error = QStringLiteral("Failed to allocate buffer");
+                return false;
+            }
         }
-
-        madvise(mapped, mapSize, MADV_SEQUENTIAL);
-        if (EVP_DigestUpdate(mdctx, mapped, mapSize) != 1) {
-            munmap(mapped, mapSize);
-            EVP_MD_CTX_free(mdctx);
-            result.errorMessage = "Failed to update hash";
-            return result;
+        m_deviceSize = deviceSize;
+        for (size_t i = 0; i < m_slots.size() && m_nextOffset < deviceSize; ++i) {
+            assignNext(m_slots[i]);
+            queue(i);
+        }
+        io_uring_submit(&m_ring);
+
+        uint64_t handed = 0;
+        size_t head = 0;
+        while (handed < deviceSize) {
+            if (!waitFor(head, meter, error)) {
+                return false;
+            }
+            Slot& ready = m_slots[head];
+            if (!consume(static_cast<const char*>(ready.pooled.data()), ready.length)) {
+                return false;
+            }
+            handed += ready.length;
+            if (m_nextOffset < deviceSize) {
+                assignNext(ready);
+                queue(head);
+                io_uring_submit(&m_ring);
+            }
+            head = (head + 1) % m_slots.size();
         }
-        munmap(mapped, mapSize);
+        return true;
+    }
 
-        offset += mapSize;
-        reportProgress(options, offset);
+    void describe(HashResult& result, JobMeter& meter, uint64_t elapsedMs) const
+    {
+        meter.readsTookTheRest(elapsedMs);
+        meter.fill(result.performance, QStringLiteral("io_uring"), static_cast<int>(m_bufferSize / 1024),
+                   static_cast<int>(m_slots.size()));
     }
 
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hashLen = 0;
-    if (EVP_DigestFinal_ex(mdctx, hash, &hashLen) != 1) {
-        EVP_MD_CTX_free(mdctx);
-        result.errorMessage = "Failed to finalize hash";
-        return result;
+private:
+    struct Slot {
+        IoBufferPool::Buffer pooled;
+        uint64_t offset = 0;
+        size_t length = 0;
+        size_t filled = 0;
+        bool inFlight = false;
+    };
+
+    void assignNext(Slot& slot)
+    {
+        slot.offset = m_nextOffset;
+        slot.length = static_cast<size_t>(qMin<uint64_t>(m_bufferSize, m_deviceSize - m_nextOffset));
+        slot.filled = 0;
+        m_nextOffset += slot.length;
     }
 
-    QByteArray hashHex;
-    hashHex.reserve(static_cast<int>(hashLen * 2));
-    for (unsigned int i = 0; i < hashLen; ++i) {
-        hashHex.append(QString("%1").arg(hash[i], 2, 16, QChar('0')).toLatin1());
+    bool queue(size_t index)
+    {
+        Slot& slot = m_slots[index];
+        io_uring_sqe* sqe = io_uring_get_sqe(&m_ring);
+        if (!sqe) {
+            return false;
+        }
+        io_uring_prep_read(sqe, m_fd, slot.pooled.data() + slot.filled,
+                           static_cast<unsigned>(slot.length - slot.filled), slot.offset + slot.filled);
+        io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(index)));
+        slot.inFlight = true;
+        return true;
+    }
+
+    /** Reaps completions until slot @p head is filled, requeueing short reads. */
+    bool waitFor(size_t head, JobMeter& meter, QString* error)
+    {
+        const qint64 waitBeginNs = m_slots[head].inFlight && PerfTrace::active() ? PerfTrace::nowNs() : 0;
+        while (m_slots[head].inFlight) {
+            io_uring_cqe* cqe = nullptr;
+            const int waitRc = io_uring_wait_cqe(&m_ring, &cqe);
+            if (waitRc == -EINTR) {
+                continue;
+            }
+            if (waitRc < 0) {
+                *error = QString("io_uring wait failed: %1").arg(strerror(-waitRc));
+                return false;
+            }
+            const size_t idx = static_cast<size_t>(reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)));
+            const int res = cqe->res;
+            io_uring_cqe_seen(&m_ring, cqe);
+            if (idx >= m_slots.size()) {
+                continue;
+            }
+            Slot& done = m_slots[idx];
+            done.inFlight = false;
+            if (res <= 0) {
+                *error = res < 0 ? QString("Read error: %1").arg(strerror(-res)) : QStringLiteral("Unexpected EOF");
+                return false;
+            }
+            done.filled += static_cast<size_t>(res);
+            if (done.filled < done.length) {
+                meter.retried();
+                queue(idx);
+                io_uring_submit(&m_ring);
+            }
+        }
+        if (waitBeginNs > 0) {
+            FLASHSPARTAN_TRACE_RECORD("raw", "uring_wait", waitBeginNs, PerfTrace::nowNs());
+        }
+        return true;
     }
 
-    result.hash = QString::fromLatin1(hashHex);
-    result.bytesProcessed = offset;
-    result.success = true;
+    int m_fd;
+    size_t m_bufferSize;
+    std::vector<Slot> m_slots;
+    io_uring m_ring{};
+    bool m_open = false;
+    uint64_t m_deviceSize = 0;
+    uint64_t m_nextOffset = 0;
+};
 
-    EVP_MD_CTX_free(mdctx);
+/** Sets *unsupported when the ring cannot be created, so the caller can use the plain loops. */
+HashResult hashUringLoop(int fd, const Options& options, uint64_t deviceSize, bool* unsupported)
+{
+    // O_DIRECT needs block-aligned lengths; round the user's buffer up to a page.
+    const size_t bufferSize =
+        ((static_cast<size_t>(normalizedBufferSizeKB(options.bufferSizeKB)) * 1024 + 4095) / 4096) * 4096;
+    UringSource source(fd, bufferSize, static_cast<size_t>(normalizedIoQueueDepth(options.ioQueueDepth)));
+    QString error;
+    *unsupported = !source.open(&error);
+    if (*unsupported) {
+        HashResult result;
+        result.deviceNode = options.deviceNode;
+        result.algorithm = algorithmName(options.algorithm);
+        result.errorMessage = error;
+        return result;
+    }
+    return Engine::hash(source, options, deviceSize);
+}
+#else
+HashResult hashUringLoop(int /*fd*/, const Options& options, uint64_t /*deviceSize*/,
+                         bool* unsupported)
+{
+    HashResult result;
+    result.deviceNode = options.deviceNode;
+    result.algorithm = algorithmName(options.algorithm);
+    result.errorMessage = QStringLiteral("io_uring support not compiled in");
+    *unsupported = true;
     return result;
 }
+#endif
 
 QString defaultHelperPath()
 {
@@ -668,7 +1024,6 @@ HashResult hashViaPkexec(const Options& options, const QString& helperPath)
 
     const QString path = helperPath.isEmpty() ? resolveHelperPath() : helperPath;
 
-    QProcess proc;
     if (!QFileInfo::exists(path)) {
         result.errorMessage = QString(
             "Privileged helper not found at %1. Reinstall flashspartan or: sudo usermod -aG storage $USER")
@@ -676,72 +1031,104 @@ HashResult hashViaPkexec(const Options& options, const QString& helperPath)
         return result;
     }
 
-    // pkexec matches org.flashspartan.read-raw-device via exec.path on the helper.
-    proc.setProgram(QStringLiteral("pkexec"));
-    proc.setArguments({
-        path,
-        QStringLiteral("hash"),
-        options.deviceNode,
-        algorithmName(options.algorithm),
-        QString::number(normalizedBufferSizeKB(options.bufferSizeKB)),
-        options.useMemoryMapping ? QStringLiteral("1") : QStringLiteral("0"),
-    });
-    proc.setProcessEnvironment(QProcessEnvironment::systemEnvironment());
-
-    proc.start();
-    if (!proc.waitForStarted(10000)) {
-        result.errorMessage = QString("Failed to start pkexec: %1").arg(proc.errorString());
-        return result;
-    }
-
-    while (proc.state() != QProcess::NotRunning) {
-        if (cancelled(options)) {
-            proc.kill();
-            proc.waitForFinished(3000);
-            result.errorMessage = "Cancelled";
+    if (options.reuseHelperSession) {
+        const int cached = HelperSession::cachedDeviceFd(options.deviceNode);
+        if (cached >= 0) {
+            result = hashOpenFd(cached, options);
+            result.performance.elevated = true;
+            closeDevice(cached);
             return result;
         }
-        proc.waitForFinished(200);
     }
 
-    const QByteArray stdoutData = proc.readAllStandardOutput().trimmed();
-    const QByteArray stderrData = proc.readAllStandardError().trimmed();
-
-    if (proc.exitStatus() != QProcess::NormalExit || proc.exitCode() != 0) {
-        QString msg = QString::fromUtf8(stderrData);
-        if (msg.isEmpty()) {
-            msg = QString("Privileged hash failed (exit %1)").arg(proc.exitCode());
+    // pkexec matches org.flashspartan.read-raw-device via exec.path on the helper; argv1
+    // stays "hash" for the policy's exec.argv1 annotation. Requests go over stdin.
+    HelperSession::Limits limits;
+    if (options.reuseHelperSession) {
+        limits.maxDevices = HelperSession::kReusableMaxDevices;
+        limits.maxSeconds = HelperSession::kReusableMaxSeconds;
+    }
+
+    // The helper only validates and opens the device; the fd it passes back runs through
+    // the same in-process engine (parallel blocks, io_uring) as a directly opened device.
+    QString error;
+    int fd = -1;
+    std::unique_ptr<HelperSession> session;
+    if (options.reuseHelperSession) {
+        session = HelperSession::takeIdle(options.deviceNode);
+        if (session) {
+            fd = session->openDevice(options.deviceNode, options.cancelled, &error);
+            if (fd < 0 && !session->answered() && !cancelled(options)) {
+                session.reset();  // exited while idle; start a fresh one below
+            }
+        }
+    }
+    if (fd < 0 && !session) {
+        session = HelperSession::launch(path, limits, &error);
+        if (session) {
+            fd = session->openDevice(options.deviceNode, options.cancelled, &error);
         }
-        const QString lower = msg.toLower();
-        if (lower.contains(QStringLiteral("not authorized"))
-            || lower.contains(QStringLiteral("permission denied"))
-            || lower.contains(QStringLiteral("cannot run"))) {
-            msg += QStringLiteral(
-                "\n\nEnsure flashspartan is reinstalled, a polkit agent is running in your "
-                "desktop session (e.g. polkit-kde-agent or polkit-gnome), and try: "
-                "sudo usermod -aG storage $USER (then log out and back in).");
+    }
+
+    if (fd >= 0) {
+        if (options.reuseHelperSession) {
+            HelperSession::cacheDeviceFd(options.deviceNode, fd);
+            HelperSession::keepIdle(std::move(session));
         }
-        result.errorMessage = msg;
+        session.reset();
+        result = hashOpenFd(fd, options);
+        result.performance.elevated = true;
+        closeDevice(fd);
         return result;
     }
 
-    QJsonParseError parseError;
-    const QJsonDocument doc = QJsonDocument::fromJson(stdoutData, &parseError);
-    if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
-        result.errorMessage = QString("Invalid helper output: %1").arg(parseError.errorString());
+    // The helper could not hand the fd over (e.g. an LSM refuses SCM_RIGHTS): hash inside it.
+    std::optional<HelperProtocol::JobResult> reply;
+    if (session && session->connected() && !cancelled(options)) {
+        reply = session->run(options, &error);
+    }
+
+    if (reply) {
+        const QString algorithm = result.algorithm;
+        result = reply->result;
+        result.deviceNode = options.deviceNode;
+        if (result.algorithm.isEmpty()) {
+            result.algorithm = algorithm;
+        }
+        result.performance.elevated = true;
+        if (reply->hasCheckpoint && options.checkpointOut) {
+            // The helper protocol carries no storage identity; keep the caller's.
+            const QString storageId = options.checkpointOut->storageId;
+            const QString layoutFingerprint = options.checkpointOut->layoutFingerprint;
+            *options.checkpointOut = reply->checkpoint;
+            options.checkpointOut->storageId = storageId;
+            options.checkpointOut->layoutFingerprint = layoutFingerprint;
+        }
+        if (result.success) {
+            reportProgress(options, result.bytesProcessed);
+        }
+        if (options.reuseHelperSession) {
+            HelperSession::keepIdle(std::move(session));
+        }
         return result;
     }
 
-    const QJsonObject obj = doc.object();
-    if (!obj.value(QStringLiteral("success")).toBool()) {
-        result.errorMessage = obj.value(QStringLiteral("error")).toString(QStringLiteral("Unknown error"));
+    if (cancelled(options)) {
+        result.errorMessage = QStringLiteral("Cancelled");
         return result;
     }
 
-    result.hash = obj.value(QStringLiteral("hash")).toString();
-    result.bytesProcessed = static_cast<uint64_t>(obj.value(QStringLiteral("bytes")).toDouble());
-    result.success = true;
-    reportProgress(options, result.bytesProcessed);
+    QString msg = error;
+    const QString lower = msg.toLower();
+    if (lower.contains(QStringLiteral("not authorized"))
+        || lower.contains(QStringLiteral("permission denied"))
+        || lower.contains(QStringLiteral("cannot run"))) {
+        msg += QStringLiteral(
+            "\n\nEnsure flashspartan is reinstalled, a polkit agent is running in your "
+            "desktop session (e.g. polkit-kde-agent or polkit-gnome), and try: "
+            "sudo usermod -aG storage $USER (then log out and back in).");
+    }
+    result.errorMessage = msg;
     return result;
 }
 
@@ -753,6 +1140,8 @@ QString algorithmName(Algorithm algo)
         case Algorithm::SHA256: return QStringLiteral("SHA256");
         case Algorithm::SHA512: return QStringLiteral("SHA512");
         case Algorithm::BLAKE2b: return QStringLiteral("BLAKE2b");
+        case Algorithm::BLAKE3: return QStringLiteral("BLAKE3");
+        case Algorithm::XXH3_128: return QStringLiteral("XXH3-128");
     }
     return QStringLiteral("SHA256");
 }
@@ -764,9 +1153,29 @@ Algorithm algorithmFromName(const QString& name)
     if (upper == QStringLiteral("BLAKE2B") || upper == QStringLiteral("BLAKE2b")) {
         return Algorithm::BLAKE2b;
     }
+    if (upper == QStringLiteral("BLAKE3")) {
+        return Algorithm::BLAKE3;
+    }
+    if (upper == QStringLiteral("XXH3-128") || upper == QStringLiteral("XXH3")) {
+        return Algorithm::XXH3_128;
+    }
     return Algorithm::SHA256;
 }
 
+bool algorithmIsCryptographic(Algorithm algo)
+{
+    return algo != Algorithm::XXH3_128;
+}
+
+bool algorithmAvailable(Algorithm algo)
+{
+    switch (algo) {
+        case Algorithm::BLAKE3: return blake3Digest() != nullptr;
+        case Algorithm::XXH3_128: return xxh3_128Digest() != nullptr;
+        default: return true;
+    }
+}
+
 int normalizedBufferSizeKB(int requestedKB)
 {
     if (requestedKB <= 0) {
@@ -781,6 +1190,374 @@ int normalizedBufferSizeKB(int requestedKB)
     return requestedKB;
 }
 
+QString ioEngineName(IoEngine engine)
+{
+    return engine == IoEngine::IoUring ? QStringLiteral("io_uring") : QStringLiteral("default");
+}
+
+IoEngine ioEngineFromName(const QString& name)
+{
+    const QString lower = name.trimmed().toLower();
+    if (lower == QStringLiteral("io_uring") || lower == QStringLiteral("uring")) {
+        return IoEngine::IoUring;
+    }
+    return IoEngine::Default;
+}
+
+int normalizedIoQueueDepth(int requested)
+{
+    if (requested <= 0) {
+        return kDefaultIoQueueDepth;
+    }
+    return qBound(kMinIoQueueDepth, requested, kMaxIoQueueDepth);
+}
+
+bool ioUringAvailable()
+{
+#ifdef HAS_LIBURING
+    static const bool available = []() {
+        io_uring ring;
+        if (io_uring_queue_init(2, &ring, 0) < 0) {
+            return false;
+        }
+        io_uring_queue_exit(&ring);
+        return true;
+    }();
+    return available;
+#else
+    return false;
+#endif
+}
+
+QueueLimits queueLimits(const QString& deviceNode)
+{
+    QueueLimits limits;
+    const QString canonical = validatedDevicePath(deviceNode, nullptr);
+    if (canonical.isEmpty()) {
+        return limits;
+    }
+    // Partitions have no queue/ of their own; it lives on the parent disk.
+    QString sysDir = QFileInfo(QStringLiteral("/sys/class/block/") + QFileInfo(canonical).fileName())
+                         .canonicalFilePath();
+    if (!sysDir.isEmpty() && !QFileInfo::exists(sysDir + QStringLiteral("/queue"))) {
+        sysDir = QFileInfo(sysDir).path();
+    }
+    auto readInt = [&](const QString& name) -> qint64 {
+        QFile file(sysDir + QStringLiteral("/queue/") + name);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return 0;
+        }
+        return file.readAll().trimmed().toLongLong();
+    };
+    limits.maxSectorsKB = static_cast<int>(readInt(QStringLiteral("max_sectors_kb")));
+    limits.optimalIoKB = static_cast<int>(readInt(QStringLiteral("optimal_io_size")) / 1024);
+    return limits;
+}
+
+std::vector<Region> partitionRegions(const QString& diskNode)
+{
+    std::vector<Region> regions;
+    const QString canonical = validatedDevicePath(diskNode, nullptr);
+    if (canonical.isEmpty()) {
+        return regions;
+    }
+    const QString sysDir = QFileInfo(QStringLiteral("/sys/class/block/") + QFileInfo(canonical).fileName())
+                               .canonicalFilePath();
+    if (sysDir.isEmpty() || QFileInfo::exists(sysDir + QStringLiteral("/partition"))) {
+        return regions;
+    }
+    auto readSectors = [](const QString& path) -> uint64_t {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return 0;
+        }
+        return file.readAll().trimmed().toULongLong();
+    };
+    // A disk's partitions are the subdirectories with a "partition" file; start and size
+    // count 512-byte sectors whatever the logical block size.
+    const QStringList children = QDir(sysDir).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString& child : children) {
+        const QString partDir = sysDir + QLatin1Char('/') + child;
+        if (!QFileInfo::exists(partDir + QStringLiteral("/partition"))) {
+            continue;
+        }
+        Region region;
+        region.name = QStringLiteral("/dev/") + child;
+        region.offset = readSectors(partDir + QStringLiteral("/start")) * 512;
+        region.length = readSectors(partDir + QStringLiteral("/size")) * 512;
+        if (region.length > 0) {
+            regions.push_back(region);
+        }
+    }
+    std::sort(regions.begin(), regions.end(),
+              [](const Region& a, const Region& b) { return a.offset < b.offset; });
+    if (!regions.empty() && regions.front().offset > 0) {
+        regions.insert(regions.begin(), Region{QStringLiteral("table"), 0, regions.front().offset});
+    }
+    return regions;
+}
+
+StorageIdentity storageIdentity(const QString& deviceNode)
+{
+    StorageIdentity identity;
+    const QString canonical = validatedDevicePath(deviceNode, nullptr);
+    if (canonical.isEmpty()) {
+        return identity;
+    }
+    const QString sysDir = QFileInfo(QStringLiteral("/sys/class/block/") + QFileInfo(canonical).fileName())
+                               .canonicalFilePath();
+    if (sysDir.isEmpty()) {
+        return identity;
+    }
+    auto readValue = [](const QString& path) -> QByteArray {
+        QFile file(path);
+        return file.open(QIODevice::ReadOnly) ? file.readAll().trimmed() : QByteArray();
+    };
+    const QByteArray partition = readValue(sysDir + QStringLiteral("/partition"));
+    const QString diskDir = partition.isEmpty() ? sysDir : QFileInfo(sysDir).path();
+    const QString diskNode = QStringLiteral("/dev/") + QFileInfo(diskDir).fileName();
+
+    // udev names the whole disk after its bus, model and serial; wwn- names are skipped as
+    // not every bridge reports one, and -part links name partitions.
+    QString byId;
+    const QDir idDir(QStringLiteral("/dev/disk/by-id"));
+    for (const QString& name : idDir.entryList(QDir::System | QDir::Files, QDir::Name)) {
+        if (name.startsWith(QLatin1String("wwn-")) || name.contains(QLatin1String("-part"))) {
+            continue;
+        }
+        if (QFileInfo(idDir.filePath(name)).canonicalFilePath() == diskNode) {
+            byId = name;
+            break;
+        }
+    }
+    if (byId.isEmpty()) {
+        return identity;
+    }
+    identity.storageId = partition.isEmpty() ? byId : byId + QStringLiteral("#part") + QString::fromLatin1(partition);
+
+    QByteArray layout = readValue(diskDir + QStringLiteral("/size"));
+    QStringList parts;
+    for (const QString& child : QDir(diskDir).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name)) {
+        const QString partDir = diskDir + QLatin1Char('/') + child;
+        const QByteArray number = readValue(partDir + QStringLiteral("/partition"));
+        if (!number.isEmpty()) {
+            parts.append(QString::fromLatin1(number + ':' + readValue(partDir + QStringLiteral("/start")) + ':'
+                                             + readValue(partDir + QStringLiteral("/size"))));
+        }
+    }
+    parts.sort();
+    layout += ';' + parts.join(QLatin1Char(';')).toLatin1();
+    identity.layoutFingerprint =
+        QString::fromLatin1(QCryptographicHash::hash(layout, QCryptographicHash::Sha256).toHex().left(16));
+    return identity;
+}
+
+
+namespace {
+
+QByteArray readSysValue(const QString& path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll().trimmed() : QByteArray();
+}
+
+/** The whole disks a sysfs block entry stands on: its disk, or for dm/md that disk's slaves. */
+void collectDisks(const QString& sysEntry, QStringList& out, int depth = 0)
+{
+    const QString canonical = QFileInfo(sysEntry).canonicalFilePath();
+    if (canonical.isEmpty() || depth > 8) {
+        return;
+    }
+    const QString diskDir =
+        QFileInfo::exists(canonical + QStringLiteral("/partition")) ? QFileInfo(canonical).path() : canonical;
+    const QString slavesDir = diskDir + QStringLiteral("/slaves");
+    const QStringList slaves = QDir(slavesDir).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    if (slaves.isEmpty()) {
+        out.append(QFileInfo(diskDir).fileName());
+        return;
+    }
+    for (const QString& slave : slaves) {
+        collectDisks(slavesDir + QLatin1Char('/') + slave, out, depth + 1);
+    }
+}
+
+} // namespace
+
+QStringList rootDisks()
+{
+    QStringList disks;
+    struct stat st;
+    if (stat("/", &st) == 0) {
+        collectDisks(QStringLiteral("/sys/dev/block/%1:%2").arg(major(st.st_dev)).arg(minor(st.st_dev)), disks);
+    }
+    if (disks.isEmpty()) {
+        // btrfs and friends report an anonymous st_dev; go by the mount source instead.
+        QFile mounts(QStringLiteral("/proc/self/mounts"));
+        QString source;
+        if (mounts.open(QIODevice::ReadOnly)) {
+            for (const QByteArray& line : mounts.readAll().split('\n')) {
+                const QList<QByteArray> fields = line.split(' ');
+                if (fields.size() > 1 && fields.at(1) == "/") {
+                    source = QString::fromLocal8Bit(fields.at(0));
+                }
+            }
+        }
+        const QString canonical = validatedDevicePath(source, nullptr);
+        if (!canonical.isEmpty()) {
+            collectDisks(QStringLiteral("/sys/class/block/") + QFileInfo(canonical).fileName(), disks);
+        }
+    }
+    disks.removeDuplicates();
+    return disks;
+}
+
+DeviceAttachment deviceAttachmentAt(const QString& sysEntry, const QStringList& rootDisks)
+{
+    DeviceAttachment attachment;
+    const QString canonical = QFileInfo(sysEntry).canonicalFilePath();
+    if (canonical.isEmpty()) {
+        return attachment;
+    }
+    attachment.known = true;
+    attachment.isPartition = QFileInfo::exists(canonical + QStringLiteral("/partition"));
+    const QString diskDir = attachment.isPartition ? QFileInfo(canonical).path() : canonical;
+    attachment.disk = QFileInfo(diskDir).fileName();
+    attachment.removable = readSysValue(diskDir + QStringLiteral("/removable")) == "1";
+    // "size" counts 512-byte sectors whatever the logical block size.
+    attachment.sizeBytes = readSysValue(canonical + QStringLiteral("/size")).toULongLong() * 512;
+
+    // The device path runs through the host controller: .../usb2/2-1/2-1:1.0/host6/.../block/sdb.
+    static const QRegularExpression usbBus(QStringLiteral("^usb\\d+$"));
+    for (const QString& component : diskDir.split(QLatin1Char('/'), Qt::SkipEmptyParts)) {
+        if (usbBus.match(component).hasMatch()) {
+            attachment.usb = true;
+            break;
+        }
+    }
+
+    QStringList below;
+    collectDisks(diskDir, below);
+    for (const QString& disk : below) {
+        if (rootDisks.contains(disk)) {
+            attachment.backsRoot = true;
+        }
+    }
+    return attachment;
+}
+
+DeviceAttachment deviceAttachment(const QString& deviceNode)
+{
+    const QString canonical = validatedDevicePath(deviceNode, nullptr);
+    if (canonical.isEmpty()) {
+        return {};
+    }
+    return deviceAttachmentAt(QStringLiteral("/sys/class/block/") + QFileInfo(canonical).fileName(), rootDisks());
+}
+
+int openHelperDevice(const QString& deviceNode, QString* refusal)
+{
+    return openHelperDeviceAt(deviceNode, QStringLiteral("/sys/dev/block"), rootDisks(), refusal);
+}
+
+int openHelperDeviceAt(const QString& deviceNode, const QString& sysDevBlock, const QStringList& rootDisks,
+                       QString* refusal)
+{
+    auto refuse = [refusal](const QString& why) {
+        if (refusal) {
+            *refusal = why;
+        }
+        return -1;
+    };
+    const int fd = openDevice(deviceNode);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return refuse(QStringLiteral("No such device"));
+        }
+        if (errno == EINVAL) {
+            return refuse(QStringLiteral("Not a device node under /dev"));
+        }
+        if (errno == ENOTBLK) {
+            return refuse(QStringLiteral("Not a block device"));
+        }
+        return refuse(QStringLiteral("Failed to open device: %1").arg(QString::fromLocal8Bit(strerror(errno))));
+    }
+    // The path may point elsewhere by now; the descriptor's device number is what gets read.
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISBLK(st.st_mode)) {
+        closeDevice(fd);
+        return refuse(QStringLiteral("Not a block device"));
+    }
+    const QString notExternal = externalDiskRefusal(deviceAttachmentAt(
+        QStringLiteral("%1/%2:%3").arg(sysDevBlock).arg(major(st.st_rdev)).arg(minor(st.st_rdev)), rootDisks));
+    if (!notExternal.isEmpty()) {
+        closeDevice(fd);
+        return refuse(notExternal);
+    }
+    return fd;
+}
+
+BufferTuning autoTuneBufferSize(int fd, const QString& deviceNode, uint64_t probeBytes)
+{
+    return autoTuneBufferSize(fd, queueLimits(deviceNode), deviceSize(fd, deviceNode), probeBytes);
+}
+
+BufferTuning autoTuneBufferSize(int fd, const QueueLimits& limits, uint64_t deviceBytes, uint64_t probeBytes)
+{
+    BufferTuning tuning;
+    tuning.limits = limits;
+    const std::vector<int> candidates = bufferTuneCandidatesKB(tuning.limits);
+
+    const uint64_t window = qMin(probeBytes, deviceBytes);
+    // 4 KiB multiples keep every pread() legal on an O_DIRECT fd.
+    const uint64_t sliceBytes = (window / candidates.size()) & ~uint64_t(4095);
+    const size_t largest = static_cast<size_t>(candidates.back()) * 1024;
+    if (sliceBytes < largest) {
+        return tuning;  // too small to tell the sizes apart
+    }
+
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, 4096, largest) != 0) {
+        return tuning;
+    }
+
+    // Each size reads a fresh slice so no candidate is served from cache or readahead
+    // left behind by the previous one.
+    uint64_t offset = 0;
+    for (int kb : candidates) {
+        const size_t chunk = static_cast<size_t>(kb) * 1024;
+        const uint64_t end = offset + sliceBytes;
+        uint64_t done = 0;
+        QElapsedTimer timer;
+        timer.start();
+        while (offset < end) {
+            const size_t want = static_cast<size_t>(qMin<uint64_t>(chunk, end - offset));
+            const ssize_t n = pread(fd, buffer, want, static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            offset += static_cast<uint64_t>(n);
+            done += static_cast<uint64_t>(n);
+        }
+        const qint64 elapsedNs = timer.nsecsElapsed();
+        offset = end;
+        if (done == 0 || elapsedNs <= 0) {
+            continue;
+        }
+        const double mbps = (static_cast<double>(done) / (1024.0 * 1024.0))
+            / (static_cast<double>(elapsedNs) / 1e9);
+        if (tuning.bufferSizeKB == 0 || mbps > tuning.bestMBps * 1.05) {
+            tuning.bufferSizeKB = kb;
+            tuning.bestMBps = mbps;
+        }
+    }
+
+    free(buffer);
+    return tuning;
+}
+
 int openDevice(const QString& deviceNode)
 {
     int validationError = 0;
@@ -790,10 +1567,11 @@ int openDevice(const QString& deviceNode)
         return -1;
     }
 
+    // O_NONBLOCK until the fstat() below: a FIFO swapped in for the node must not hang the open.
     const QByteArray encodedPath = QFile::encodeName(path);
-    int fd = open(encodedPath.constData(), O_RDONLY | O_DIRECT | O_CLOEXEC);
+    int fd = open(encodedPath.constData(), O_RDONLY | O_DIRECT | O_CLOEXEC | O_NONBLOCK);
     if (fd < 0) {
-        fd = open(encodedPath.constData(), O_RDONLY | O_CLOEXEC);
+        fd = open(encodedPath.constData(), O_RDONLY | O_CLOEXEC | O_NONBLOCK);
     }
     if (fd < 0) {
         return -1;
@@ -811,6 +1589,14 @@ int openDevice(const QString& deviceNode)
         errno = ENOTBLK;
         return -1;
     }
+    // io_uring hands EAGAIN back for O_NONBLOCK files instead of waiting.
+    const int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags & ~O_NONBLOCK) != 0) {
+        const int savedErrno = errno;
+        close(fd);
+        errno = savedErrno;
+        return -1;
+    }
 
     uint64_t size = 0;
     if (ioctl(fd, BLKGETSIZE64, &size) != 0) {
@@ -854,20 +1640,55 @@ void closeDevice(int fd)
 
 HashResult hashOpenFd(int fd, const Options& options)
 {
+    FLASHSPARTAN_TRACE_SPAN("raw", "hashOpenFd");
     HashResult result;
     result.deviceNode = options.deviceNode;
 
-    const uint64_t size = deviceSize(fd, options.deviceNode);
+    if (!algorithmAvailable(options.algorithm)) {
+        result.errorMessage = QStringLiteral("%1 is not available in this build")
+                                  .arg(algorithmName(options.algorithm));
+        return result;
+    }
+
+    uint64_t size = deviceSize(fd, options.deviceNode);
     if (size == 0) {
         result.errorMessage = QStringLiteral("Device size is 0");
         return result;
     }
+    if (options.lengthLimit > 0) {
+        if (size < options.lengthLimit) {
+            result.errorMessage = QStringLiteral("Device holds %1 bytes, fewer than the %2 to hash")
+                                      .arg(size)
+                                      .arg(options.lengthLimit);
+            return result;
+        }
+        size = options.lengthLimit;
+    }
+    if (options.totalBytes) {
+        options.totalBytes->store(size);
+    }
 
-    if (options.scanMode == ScanMode::QuickSample || options.checkpointOut
-        || options.resumeFromBytes > 0) {
+    if (options.tolerateReadErrors) {
+        // pread, not the engines below: a failed or stuck read is skipped instead of ending the hash.
+        return hashTolerant(
+            [fd](char* data, size_t length, uint64_t offset) -> int64_t {
+                return pread(fd, data, length, static_cast<off_t>(offset));
+            },
+            options, size);
+    }
+    if (options.scanMode == ScanMode::QuickSample || options.scanMode == ScanMode::ParallelChunked
+        || options.checkpointOut || options.resumeFromBytes > 0 || !options.regions.empty()) {
         return hashAdvanced(fd, options, size);
     }
 
+    if (options.ioEngine == IoEngine::IoUring) {
+        bool unsupported = false;
+        result = hashUringLoop(fd, options, size, &unsupported);
+        if (!unsupported) {
+            return result;
+        }
+    }
+
     if (options.useMemoryMapping && size > 0) {
         result = hashMmapLoop(fd, options, size);
         if (!result.success && result.errorMessage.contains(QStringLiteral("mmap"))) {
@@ -880,8 +1701,10 @@ HashResult hashOpenFd(int fd, const Options& options)
     return result;
 }
 
-HashResult hashDevice(const Options& options, const QString& pkexecHelperPath)
+HashResult hashDevice(const Options& callerOptions, const QString& pkexecHelperPath)
 {
+    std::atomic<uint64_t> paced{0};
+    const Options options = withBackgroundPacing(callerOptions, paced);
     HashResult result;
     result.deviceNode = options.deviceNode;
     result.algorithm = algorithmName(options.algorithm);
@@ -901,6 +1724,16 @@ HashResult hashDevice(const Options& options, const QString& pkexecHelperPath)
     return result;
 }
 
+void closeHelperSession()
+{
+    HelperSession::closeIdle();
+}
+
+void forgetDeviceAccess(const QString& deviceNode)
+{
+    HelperSession::forgetDevice(deviceNode);
+}
+
 } // namespace FlashSpartan::RawDeviceHash
 
 #endif
@@ -1,15 +1,184 @@
 #include "RawDeviceHashAdvanced.h"
+#include "Blake3Digest.h"
+#include "HashEngine.h"
+#include "HexEncoding.h"
+#include "IoBufferPool.h"
+#include "Xxh3Digest.h"
 
 #include <openssl/evp.h>
 
 #include <QByteArray>
+#include <QElapsedTimer>
 #include <QVector>
 
+#include <algorithm>
+
+namespace FlashSpartan::RawDeviceHash {
+
+std::vector<ByteRange> changedBlockRanges(const QStringList& baseline, const QStringList& current,
+                                          uint64_t blockSize, uint64_t deviceSize)
+{
+    std::vector<ByteRange> ranges;
+    if (blockSize == 0) {
+        return ranges;
+    }
+    for (int i = 0; i < current.size(); ++i) {
+        if (i < baseline.size() && baseline.at(i).compare(current.at(i), Qt::CaseInsensitive) == 0) {
+            continue;
+        }
+        const uint64_t offset = static_cast<uint64_t>(i) * blockSize;
+        uint64_t length = blockSize;
+        if (deviceSize > 0) {
+            if (offset >= deviceSize) {
+                break;
+            }
+            length = qMin(blockSize, deviceSize - offset);
+        }
+        if (!ranges.empty() && ranges.back().offset + ranges.back().length == offset) {
+            ranges.back().length += length;
+        } else {
+            ranges.push_back({offset, length});
+        }
+    }
+    return ranges;
+}
+
+QString describeByteRanges(const std::vector<ByteRange>& ranges, int maxShown)
+{
+    auto mib = [](uint64_t bytes) {
+        const uint64_t unit = 1024ULL * 1024;
+        return bytes % unit == 0 ? QString::number(bytes / unit)
+                                 : QString::number(static_cast<double>(bytes) / unit, 'f', 1);
+    };
+    QStringList parts;
+    for (size_t i = 0; i < ranges.size() && static_cast<int>(i) < maxShown; ++i) {
+        parts.append(QStringLiteral("%1–%2 MiB")
+                         .arg(mib(ranges[i].offset), mib(ranges[i].offset + ranges[i].length)));
+    }
+    QString text = parts.join(QStringLiteral(", "));
+    if (static_cast<int>(ranges.size()) > maxShown) {
+        text += QStringLiteral(" (+%1 more)").arg(static_cast<int>(ranges.size()) - maxShown);
+    }
+    return text;
+}
+
+QuickSampleLayout normalizedQuickSampleLayout(QuickSampleLayout layout)
+{
+    layout.samples = std::clamp(layout.samples, kMinQuickSamples, kMaxQuickSamples);
+    // Whole 4 KiB pages keep aligned reads on an O_DIRECT fd the same size as the sample.
+    layout.sampleKB = std::clamp(layout.sampleKB, kMinQuickSampleKB, kMaxQuickSampleKB) / 4 * 4;
+    return layout;
+}
+
+QString quickSampleLabelSuffix(const QuickSampleLayout& layout)
+{
+    const QuickSampleLayout n = normalizedQuickSampleLayout(layout);
+    if (n.isDefault()) {
+        return {};
+    }
+    QString suffix = QStringLiteral("-%1x%2K").arg(n.samples).arg(n.sampleKB);
+    if (n.metadataHotSpots) {
+        suffix += QStringLiteral("-META");
+    }
+    return suffix;
+}
+
+QuickSampleLayout quickSampleLayoutFromLabel(const QString& algorithmLabel)
+{
+    QuickSampleLayout layout;
+    const QStringList parts = algorithmLabel.toUpper().split(QLatin1Char('-'));
+    const int quick = parts.indexOf(QStringLiteral("QUICK"));
+    if (quick < 0 || quick + 1 >= parts.size()) {
+        return layout;
+    }
+    const QString shape = parts.at(quick + 1);
+    const int x = shape.indexOf(QLatin1Char('X'));
+    bool samplesOk = false;
+    bool sizeOk = false;
+    const int samples = shape.left(x).toInt(&samplesOk);
+    const int sampleKB = shape.mid(x + 1).chopped(shape.endsWith(QLatin1Char('K')) ? 1 : 0)
+                             .toInt(&sizeOk);
+    if (x <= 0 || !samplesOk || !sizeOk) {
+        return layout;
+    }
+    layout.samples = samples;
+    layout.sampleKB = sampleKB;
+    layout.metadataHotSpots = parts.mid(quick + 2).contains(QStringLiteral("META"));
+    return normalizedQuickSampleLayout(layout);
+}
+
+std::vector<uint64_t> quickSampleOffsets(const QuickSampleLayout& layout, uint64_t deviceSize)
+{
+    std::vector<uint64_t> offsets;
+    if (deviceSize == 0) {
+        return offsets;
+    }
+    const QuickSampleLayout n = normalizedQuickSampleLayout(layout);
+    const uint64_t sampleSize = qMin<uint64_t>(static_cast<uint64_t>(n.sampleKB) * 1024, deviceSize);
+    const uint64_t lastStart = deviceSize - sampleSize;
+    auto covered = [&](uint64_t off) {
+        return std::find(offsets.begin(), offsets.end(), off) != offsets.end();
+    };
+
+    offsets.push_back(0);
+    if (deviceSize > sampleSize) {
+        offsets.push_back(lastStart);
+    }
+    // Interior samples at i/(samples-1) of the device; the default (15) is the original
+    // head + tail + 13 layout, in the same order, so its digest is unchanged.
+    const uint64_t spaced = static_cast<uint64_t>(n.samples - 1);
+    for (uint64_t i = 1; i < spaced; ++i) {
+        const uint64_t off = qMin((deviceSize * i) / spaced, lastStart);
+        if (!covered(off)) {
+            offsets.push_back(off);
+        }
+    }
+
+    if (n.metadataHotSpots) {
+        constexpr uint64_t kMiB = 1024ULL * 1024;
+        // Right after the head: FAT/exFAT tables, ext group descriptors, and the first
+        // partition's boot sector on whole-drive hashes; btrfs superblock mirrors at 64 MiB
+        // and 256 GiB; ext2/3/4 backup superblocks (4 KiB blocks, sparse_super groups);
+        // NTFS's default $MFT cluster at 3 GiB.
+        const uint64_t hotSpots[] = {
+            sampleSize,      64 * kMiB,       128 * kMiB,      3 * 128 * kMiB,
+            5 * 128 * kMiB,  7 * 128 * kMiB,  9 * 128 * kMiB,  3072 * kMiB,
+            25 * 128 * kMiB, 27 * 128 * kMiB, 49 * 128 * kMiB, 81 * 128 * kMiB,
+            256 * 1024 * kMiB,
+        };
+        for (uint64_t off : hotSpots) {
+            if (off <= lastStart && !covered(off)) {
+                offsets.push_back(off);
+            }
+        }
+    }
+    return offsets;
+}
+
+namespace {
+
+bool differsFromBaseline(const Options& options, uint64_t block, const QString& blockHex)
+{
+    return options.stopAtFirstMismatch && options.expectedBlockHashes
+           && block < static_cast<uint64_t>(options.expectedBlockHashes->size())
+           && options.expectedBlockHashes->at(static_cast<int>(block))
+                      .compare(blockHex, Qt::CaseInsensitive) != 0;
+}
+
+} // namespace
+
+} // namespace FlashSpartan::RawDeviceHash
+
 #ifdef Q_OS_WIN
+#include "WinOverlappedReader.h"
+
 #include <qt_windows.h>
 
+#include <memory>
+
 namespace FlashSpartan::RawDeviceHash {
 
+// ParallelChunked produces the same block list as Full, so it shares its checkpoints.
 QString scanModeTag(ScanMode mode)
 {
     return mode == ScanMode::QuickSample ? QStringLiteral("quick") : QStringLiteral("full");
@@ -29,6 +198,12 @@ QString combineBlockHashes(const QStringList& blockHex, Algorithm algo)
         case Algorithm::BLAKE2b:
             md = EVP_blake2b512();
             break;
+        case Algorithm::BLAKE3:
+            md = blake3Digest();
+            break;
+        case Algorithm::XXH3_128:
+            md = xxh3_128Digest();
+            break;
         case Algorithm::SHA256:
         default:
             md = EVP_sha256();
@@ -46,12 +221,7 @@ QString combineBlockHashes(const QStringList& blockHex, Algorithm algo)
     unsigned int hashLen = 0;
     QString out;
     if (EVP_DigestFinal_ex(mdctx, hash, &hashLen) == 1) {
-        QByteArray hashHex;
-        hashHex.reserve(static_cast<int>(hashLen * 2));
-        for (unsigned int i = 0; i < hashLen; ++i) {
-            hashHex.append(QStringLiteral("%1").arg(hash[i], 2, 16, QChar('0')).toLatin1());
-        }
-        out = QString::fromLatin1(hashHex);
+        out = HexEncoding::toString(hash, hashLen);
     }
     EVP_MD_CTX_free(mdctx);
     return out;
@@ -83,51 +253,10 @@ bool winRead(HANDLE handle, char* buffer, size_t toRead, size_t* bytesReadOut)
     return read > 0;
 }
 
-const EVP_MD* mdFor(Algorithm algo)
-{
-    switch (algo) {
-        case Algorithm::SHA512:
-            return EVP_sha512();
-        case Algorithm::BLAKE2b:
-            return EVP_blake2b512();
-        case Algorithm::SHA256:
-        default:
-            return EVP_sha256();
-    }
-}
-
-bool cancelled(const Options& options)
-{
-    return options.cancelled && options.cancelled->load();
-}
-
-void reportProgress(const Options& options, uint64_t value)
-{
-    if (options.bytesProcessed) {
-        options.bytesProcessed->store(value);
-    }
-}
-
-QString digestToHex(const unsigned char* hash, unsigned int hashLen)
-{
-    QByteArray hashHex;
-    hashHex.reserve(static_cast<int>(hashLen * 2));
-    for (unsigned int i = 0; i < hashLen; ++i) {
-        hashHex.append(QStringLiteral("%1").arg(hash[i], 2, 16, QChar('0')).toLatin1());
-    }
-    return QString::fromLatin1(hashHex);
-}
-
-bool finalizeCtx(EVP_MD_CTX* mdctx, QString& outHex)
-{
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hashLen = 0;
-    if (EVP_DigestFinal_ex(mdctx, hash, &hashLen) != 1) {
-        return false;
-    }
-    outHex = digestToHex(hash, hashLen);
-    return true;
-}
+using Engine::cancelled;
+using Engine::finalizeCtx;
+using Engine::mdFor;
+using Engine::reportProgress;
 
 void writeCheckpoint(const Options& options, const QString& algoName, uint64_t deviceSize,
                      uint64_t blockSize, const QStringList& blockHashes, uint64_t bytesDone)
@@ -142,13 +271,17 @@ void writeCheckpoint(const Options& options, const QString& algoName, uint64_t d
     options.checkpointOut->blockSize = blockSize;
     options.checkpointOut->blockHashes = blockHashes;
     options.checkpointOut->bytesCompleted = bytesDone;
+    if (options.checkpointed) {
+        options.checkpointed(*options.checkpointOut);
+    }
 }
 
 HashResult hashQuickSampleWin(HANDLE handle, const Options& options, uint64_t deviceSize)
 {
     HashResult result;
     result.deviceNode = options.deviceNode;
-    result.algorithm = algorithmName(options.algorithm) + QStringLiteral("-QUICK");
+    result.algorithm = algorithmName(options.algorithm) + QStringLiteral("-QUICK")
+                       + quickSampleLabelSuffix(options.quickSample);
 
     EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
     if (!mdctx || EVP_DigestInit_ex(mdctx, mdFor(options.algorithm), nullptr) != 1) {
@@ -159,26 +292,15 @@ HashResult hashQuickSampleWin(HANDLE handle, const Options& options, uint64_t de
         return result;
     }
 
-    const uint64_t sampleSize = qMin<uint64_t>(1024ULL * 1024, deviceSize);
-    QVector<uint64_t> offsets;
-    offsets.append(0);
-    if (deviceSize > sampleSize) {
-        offsets.append(deviceSize - sampleSize);
-    }
-    const int spaced = 14;
-    for (int i = 1; i < spaced; ++i) {
-        uint64_t off = (deviceSize * static_cast<uint64_t>(i)) / static_cast<uint64_t>(spaced);
-        if (off + sampleSize > deviceSize) {
-            off = deviceSize > sampleSize ? deviceSize - sampleSize : 0;
-        }
-        if (!offsets.contains(off)) {
-            offsets.append(off);
-        }
-    }
+    // Sequential on Windows; the Linux path overlaps the reads.
+    const QuickSampleLayout layout = normalizedQuickSampleLayout(options.quickSample);
+    const uint64_t sampleSize = qMin<uint64_t>(static_cast<uint64_t>(layout.sampleKB) * 1024, deviceSize);
+    const std::vector<uint64_t> offsets = quickSampleOffsets(layout, deviceSize);
 
     QByteArray buffer;
     buffer.resize(static_cast<int>(sampleSize));
     uint64_t processed = 0;
+    JobMeter meter;
 
     for (uint64_t off : offsets) {
         if (cancelled(options)) {
@@ -194,11 +316,17 @@ HashResult hashQuickSampleWin(HANDLE handle, const Options& options, uint64_t de
         }
         const size_t toRead = static_cast<size_t>(qMin(sampleSize, deviceSize - off));
         size_t got = 0;
-        if (!winRead(handle, buffer.data(), toRead, &got)) {
+        bool readOk = false;
+        {
+            const JobMeter::Timed readTime = meter.reading();
+            readOk = winRead(handle, buffer.data(), toRead, &got);
+        }
+        if (!readOk) {
             EVP_MD_CTX_free(mdctx);
             result.errorMessage = QStringLiteral("Read error: Win32 error %1").arg(GetLastError());
             return result;
         }
+        const JobMeter::Timed hashTime = meter.hashing();
         if (EVP_DigestUpdate(mdctx, buffer.constData(), got) != 1) {
             EVP_MD_CTX_free(mdctx);
             result.errorMessage = QStringLiteral("Hash update failed");
@@ -218,6 +346,7 @@ HashResult hashQuickSampleWin(HANDLE handle, const Options& options, uint64_t de
     result.hash = outHex;
     result.bytesProcessed = processed;
     result.success = true;
+    meter.fill(result.performance, QStringLiteral("quick_sample"), static_cast<int>(sampleSize / 1024), 1);
     return result;
 }
 
@@ -249,7 +378,17 @@ HashResult hashChunkedResumeWin(HANDLE handle, const Options& options, uint64_t
 
     const size_t bufSize = static_cast<size_t>(normalizedBufferSizeKB(options.bufferSizeKB)) * 1024;
     QByteArray buffer;
-    buffer.resize(static_cast<int>(bufSize));
+    // Blocks start on kDefaultChunkBytes boundaries, so every block can be read unbuffered.
+    auto reader = std::make_unique<WinOverlappedReader>(
+        handle, normalizedIoQueueDepth(options.ioQueueDepth), bufSize);
+    QString openError;
+    if (!reader->open(&openError)) {
+        reader.reset();
+        buffer.resize(static_cast<int>(bufSize));
+    }
+    JobMeter meter;
+    QElapsedTimer elapsed;
+    elapsed.start();
 
     for (uint64_t block = startBlock; block < numBlocks; ++block) {
         if (cancelled(options)) {
@@ -260,7 +399,8 @@ HashResult hashChunkedResumeWin(HANDLE handle, const Options& options, uint64_t
 
         const uint64_t offset = block * blockSize;
         const uint64_t chunkLen = qMin(blockSize, deviceSize - offset);
-        if (!winSeek(handle, offset)) {
+        const uint64_t blockBeginNs = JobMeter::nowNs();
+        if (!reader && !winSeek(handle, offset)) {
             result.errorMessage =
                 QStringLiteral("Seek failed: Win32 error %1").arg(GetLastError());
             return result;
@@ -276,6 +416,35 @@ HashResult hashChunkedResumeWin(HANDLE handle, const Options& options, uint64_t
         }
 
         uint64_t readInBlock = 0;
+        if (reader) {
+            QString readError;
+            const bool ok = reader->read(offset, chunkLen,
+                                         [&](const char* data, size_t n) {
+                                             if (cancelled(options)) {
+                                                 return false;
+                                             }
+                                             {
+                                                 const JobMeter::Timed hashTime = meter.hashing();
+                                                 EVP_DigestUpdate(blockCtx, data, n);
+                                             }
+                                             readInBlock += n;
+                                             bytesDone += n;
+                                             reportProgress(options, bytesDone);
+                                             return true;
+                                         },
+                                         &readError);
+            if (!ok) {
+                EVP_MD_CTX_free(blockCtx);
+                if (cancelled(options)) {
+                    writeCheckpoint(options, result.algorithm, deviceSize, blockSize, blockHashes,
+                                    bytesDone);
+                    result.errorMessage = QStringLiteral("Cancelled");
+                } else {
+                    result.errorMessage = readError;
+                }
+                return result;
+            }
+        }
         while (readInBlock < chunkLen) {
             if (cancelled(options)) {
                 EVP_MD_CTX_free(blockCtx);
@@ -293,7 +462,10 @@ HashResult hashChunkedResumeWin(HANDLE handle, const Options& options, uint64_t
                                           .arg(GetLastError());
                 return result;
             }
-            EVP_DigestUpdate(blockCtx, buffer.constData(), n);
+            {
+                const JobMeter::Timed hashTime = meter.hashing();
+                EVP_DigestUpdate(blockCtx, buffer.constData(), n);
+            }
             readInBlock += n;
             bytesDone += n;
             reportProgress(options, bytesDone);
@@ -306,7 +478,23 @@ HashResult hashChunkedResumeWin(HANDLE handle, const Options& options, uint64_t
             return result;
         }
         EVP_MD_CTX_free(blockCtx);
+        meter.blockTimed(block, JobMeter::nowNs() - blockBeginNs);
         blockHashes.append(blockHex);
+        if (options.blockHashed) {
+            options.blockHashed(block, blockHex);
+        }
+
+        if (differsFromBaseline(options, block, blockHex)) {
+            result.blockHashes = blockHashes;
+            result.blockSize = blockSize;
+            result.stoppedAtBlock = static_cast<qint64>(block);
+            result.bytesProcessed = bytesDone;
+            result.success = true;
+            meter.readsTookTheRest(static_cast<uint64_t>(elapsed.elapsed()));
+            meter.fill(result.performance, reader ? QStringLiteral("overlapped") : QStringLiteral("chunked"),
+                       static_cast<int>(bufSize / 1024), reader ? normalizedIoQueueDepth(options.ioQueueDepth) : 1);
+            return result;
+        }
 
         const int every = qMax(1, options.checkpointEveryBlocks);
         if (options.checkpointOut
@@ -316,8 +504,13 @@ HashResult hashChunkedResumeWin(HANDLE handle, const Options& options, uint64_t
     }
 
     result.hash = combineBlockHashes(blockHashes, options.algorithm);
+    result.blockHashes = blockHashes;
+    result.blockSize = blockSize;
     result.bytesProcessed = bytesDone;
     result.success = !result.hash.isEmpty();
+    meter.readsTookTheRest(static_cast<uint64_t>(elapsed.elapsed()));
+    meter.fill(result.performance, reader ? QStringLiteral("overlapped") : QStringLiteral("chunked"),
+               static_cast<int>(bufSize / 1024), reader ? normalizedIoQueueDepth(options.ioQueueDepth) : 1);
     if (!result.success && result.errorMessage.isEmpty()) {
         result.errorMessage = QStringLiteral("Failed to combine block hashes");
     }
@@ -332,65 +525,271 @@ HashResult hashAdvanced(int fd, const Options& options, uint64_t deviceSize)
     if (options.scanMode == ScanMode::QuickSample) {
         return hashQuickSampleWin(handle, options, deviceSize);
     }
+    // ParallelChunked runs the sequential block loop here; the combined digest is identical.
     return hashChunkedResumeWin(handle, options, deviceSize);
 }
 
+HashResult hashTolerant(const ReadAtFn& readAt, const Options& options, uint64_t deviceSize)
+{
+    Q_UNUSED(readAt);
+    Q_UNUSED(deviceSize);
+    HashResult result;
+    result.deviceNode = options.deviceNode;
+    result.algorithm = algorithmName(options.algorithm);
+    result.errorMessage = QStringLiteral("Bad-sector-tolerant reads are only supported on Linux.");
+    return result;
+}
+
 } // namespace FlashSpartan::RawDeviceHash
 
 #else
 
 #include <fcntl.h>
 #include <unistd.h>
+#include <atomic>
 #include <cerrno>
+#include <cstdlib>
+#include <chrono>
+#include <condition_variable>
 #include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef HAS_LIBURING
+#include <liburing.h>
+#endif
 
 namespace FlashSpartan::RawDeviceHash {
 
 namespace {
 
-const EVP_MD* mdFor(Algorithm algo)
+using Engine::cancelled;
+using Engine::finalizeCtx;
+using Engine::mdFor;
+using Engine::reportProgress;
+
+bool isAllZero(const char* data, size_t length)
 {
-    switch (algo) {
-        case Algorithm::SHA512: return EVP_sha512();
-        case Algorithm::BLAKE2b: return EVP_blake2b512();
-        case Algorithm::SHA256:
-        default: return EVP_sha256();
-    }
+    // Compare against itself shifted by one byte; memcmp is vectorised, a byte loop is not.
+    return length == 0 || (data[0] == 0 && std::memcmp(data, data + 1, length - 1) == 0);
 }
 
-bool cancelled(const Options& options)
+/** True when SEEK_DATA finds no data in [offset, offset + length). Block devices never do. */
+bool rangeIsHole(int fd, uint64_t offset, uint64_t length)
 {
-    return options.cancelled && options.cancelled->load();
+    const off_t data = lseek(fd, static_cast<off_t>(offset), SEEK_DATA);
+    if (data < 0) {
+        return errno == ENXIO;  // nothing but hole up to EOF
+    }
+    return static_cast<uint64_t>(data) >= offset + length;
 }
 
-void reportProgress(const Options& options, uint64_t value)
+const std::vector<char>& zeroBuffer()
 {
-    if (options.bytesProcessed) {
-        options.bytesProcessed->store(value);
-    }
+    static const std::vector<char> zeros(1024 * 1024, 0);
+    return zeros;
 }
 
-QString digestToHex(const unsigned char* hash, unsigned int hashLen)
+bool feedZeros(EVP_MD_CTX* ctx, uint64_t length)
 {
-    QByteArray hashHex;
-    hashHex.reserve(static_cast<int>(hashLen * 2));
-    for (unsigned int i = 0; i < hashLen; ++i) {
-        hashHex.append(QString("%1").arg(hash[i], 2, 16, QChar('0')).toLatin1());
+    const std::vector<char>& zeros = zeroBuffer();
+    while (length > 0) {
+        const size_t n = static_cast<size_t>(qMin<uint64_t>(zeros.size(), length));
+        if (EVP_DigestUpdate(ctx, zeros.data(), n) != 1) {
+            return false;
+        }
+        length -= n;
     }
-    return QString::fromLatin1(hashHex);
+    return true;
 }
 
-bool finalizeCtx(EVP_MD_CTX* mdctx, QString& outHex)
+/** Digest of @p length zero bytes, computed once per (algorithm, length) and shared. */
+QString zeroBlockDigest(Algorithm algo, uint64_t length)
 {
-    unsigned char hash[EVP_MAX_MD_SIZE];
-    unsigned int hashLen = 0;
-    if (EVP_DigestFinal_ex(mdctx, hash, &hashLen) != 1) {
-        return false;
+    static std::mutex cacheMutex;
+    static std::map<std::pair<int, uint64_t>, QString> cache;
+    const auto key = std::make_pair(static_cast<int>(algo), length);
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        const auto it = cache.find(key);
+        if (it != cache.end()) {
+            return it->second;
+        }
     }
-    outHex = digestToHex(hash, hashLen);
-    return true;
+
+    QString hex;
+    EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+    if (ctx && EVP_DigestInit_ex(ctx, mdFor(algo), nullptr) == 1 && feedZeros(ctx, length)) {
+        if (!finalizeCtx(ctx, hex)) {
+            hex.clear();
+        }
+    }
+    EVP_MD_CTX_free(ctx);
+    if (!hex.isEmpty()) {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        cache.emplace(key, hex);
+    }
+    return hex;
 }
 
+/**
+ * Feeds one block's digest. With skipZeros, leading all-zero buffers and holes are only
+ * counted; they are replayed into the digest as soon as real data shows up, and a block
+ * that never sees any takes zeroBlockDigest() instead. Either way the block hash equals
+ * hashing every byte.
+ */
+class BlockFeed {
+public:
+    BlockFeed(EVP_MD_CTX* ctx, bool skipZeros)
+        : m_ctx(ctx)
+        , m_deferring(skipZeros)
+    {
+    }
+
+    bool update(const char* data, size_t length)
+    {
+        if (m_deferring && isAllZero(data, length)) {
+            m_zeroPrefix += length;
+            return true;
+        }
+        if (m_deferring) {
+            m_deferring = false;
+            if (!feedZeros(m_ctx, m_zeroPrefix)) {
+                return false;
+            }
+        }
+        return EVP_DigestUpdate(m_ctx, data, length) == 1;
+    }
+
+    /** @p length bytes known to read as zero without reading them. */
+    bool addZeros(uint64_t length)
+    {
+        if (m_deferring) {
+            m_zeroPrefix += length;
+            return true;
+        }
+        return feedZeros(m_ctx, length);
+    }
+
+    bool finish(Algorithm algo, uint64_t blockLength, QString* outHex)
+    {
+        if (m_deferring) {
+            *outHex = zeroBlockDigest(algo, blockLength);
+            return !outHex->isEmpty();
+        }
+        return finalizeCtx(m_ctx, *outHex);
+    }
+
+private:
+    EVP_MD_CTX* m_ctx;
+    bool m_deferring;
+    uint64_t m_zeroPrefix = 0;
+};
+
+/**
+ * Options::regions of a chunked full read, fed the device in offset order. Each region cuts
+ * its own kDefaultChunkBytes blocks from its start and folds them with combineBlockHashes(),
+ * like a full read of only that range; regions may overlap.
+ */
+class RegionHasher {
+public:
+    /** Regions that start before @p start (a resume point) are dropped. */
+    RegionHasher(const Options& options, uint64_t start)
+        : m_algorithm(options.algorithm)
+    {
+        for (const Region& region : options.regions) {
+            if (region.offset >= start && region.length > 0) {
+                m_regions.push_back({region});
+            }
+        }
+    }
+
+    ~RegionHasher()
+    {
+        for (Active& active : m_regions) {
+            EVP_MD_CTX_free(active.block);
+        }
+    }
+
+    RegionHasher(const RegionHasher&) = delete;
+    RegionHasher& operator=(const RegionHasher&) = delete;
+
+    bool empty() const { return m_regions.empty(); }
+
+    /** @p length bytes at @p offset; a null @p data means they are all zero. */
+    bool update(uint64_t offset, const char* data, uint64_t length)
+    {
+        for (Active& active : m_regions) {
+            const uint64_t begin = qMax(offset, active.region.offset);
+            const uint64_t end = qMin(offset + length, active.region.offset + active.region.length);
+            if (begin < end && !feed(active, data ? data + (begin - offset) : nullptr, end - begin)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void finish(QList<RegionHash>* out) const
+    {
+        for (const Active& active : m_regions) {
+            if (active.done != active.region.length) {
+                continue;  // the read stopped early
+            }
+            out->append({active.region.name, active.region.offset, active.region.length,
+                         combineBlockHashes(active.blocks, m_algorithm)});
+        }
+    }
+
+private:
+    struct Active {
+        Region region;
+        EVP_MD_CTX* block = nullptr;
+        uint64_t done = 0;  // bytes of the region fed so far
+        QStringList blocks;
+    };
+
+    bool feed(Active& active, const char* data, uint64_t length)
+    {
+        while (length > 0) {
+            if (!active.block) {
+                active.block = EVP_MD_CTX_new();
+                if (!active.block || EVP_DigestInit_ex(active.block, mdFor(m_algorithm), nullptr) != 1) {
+                    return false;
+                }
+            }
+            const uint64_t blockRoom = kDefaultChunkBytes - active.done % kDefaultChunkBytes;
+            const uint64_t n = qMin(length, blockRoom);
+            if (!(data ? EVP_DigestUpdate(active.block, data, static_cast<size_t>(n)) == 1
+                       : feedZeros(active.block, n))) {
+                return false;
+            }
+            active.done += n;
+            length -= n;
+            if (data) {
+                data += n;
+            }
+            if (n == blockRoom || active.done == active.region.length) {
+                QString hex;
+                const bool finalized = finalizeCtx(active.block, hex);
+                EVP_MD_CTX_free(active.block);
+                active.block = nullptr;
+                if (!finalized) {
+                    return false;
+                }
+                active.blocks.append(hex);
+            }
+        }
+        return true;
+    }
+
+    Algorithm m_algorithm;
+    std::vector<Active> m_regions;
+};
+
 void writeCheckpoint(const Options& options, const QString& algoName,
                      uint64_t deviceSize, uint64_t blockSize, const QStringList& blockHashes,
                      uint64_t bytesDone)
@@ -405,13 +804,158 @@ void writeCheckpoint(const Options& options, const QString& algoName,
     options.checkpointOut->blockSize = blockSize;
     options.checkpointOut->blockHashes = blockHashes;
     options.checkpointOut->bytesCompleted = bytesDone;
+    if (options.checkpointed) {
+        options.checkpointed(*options.checkpointOut);
+    }
+}
+
+/** One quick-sample read, widened to 4 KiB boundaries so it is legal on an O_DIRECT fd. */
+struct SampleRead {
+    uint64_t alignedOffset = 0;
+    size_t alignedLength = 0;
+    size_t skip = 0;    // bytes before the sample within the aligned read
+    size_t length = 0;  // sample bytes fed to the digest
+    char* buffer = nullptr;
+    size_t filled = 0;
+};
+
+/** Samples fetched per round trip; bounds memory for large layouts (256 x 16 MiB). */
+constexpr size_t kQuickBatchBytes = 64ULL * 1024 * 1024;
+constexpr size_t kMaxQuickReaders = 16;
+
+bool preadSample(int fd, SampleRead& read, QString* error)
+{
+    while (read.filled < read.alignedLength) {
+        const ssize_t n = pread(fd, read.buffer + read.filled, read.alignedLength - read.filled,
+                                static_cast<off_t>(read.alignedOffset + read.filled));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            *error = n < 0 ? QString("Read error: %1").arg(strerror(errno))
+                           : QStringLiteral("Unexpected EOF");
+            return false;
+        }
+        read.filled += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/** Every read of the batch outstanding at once, one pread() per reader thread. */
+bool fetchSamplesThreaded(int fd, std::vector<SampleRead>& reads, QString* error)
+{
+    if (reads.size() == 1) {
+        return preadSample(fd, reads.front(), error);
+    }
+    std::atomic<size_t> next{0};
+    std::atomic<bool> failed{false};
+    std::mutex errorMutex;
+    auto reader = [&]() {
+        for (size_t i = next++; i < reads.size() && !failed.load(); i = next++) {
+            QString readError;
+            if (!preadSample(fd, reads[i], &readError)) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                if (!failed.exchange(true)) {
+                    *error = readError;
+                }
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    const size_t threads = qMin(reads.size(), kMaxQuickReaders);
+    pool.reserve(threads);
+    for (size_t t = 0; t < threads; ++t) {
+        pool.emplace_back(reader);
+    }
+    for (std::thread& t : pool) {
+        t.join();
+    }
+    return !failed.load();
 }
 
+#ifdef HAS_LIBURING
+/** The whole batch in one io_uring submission; *unsupported when no ring can be set up. */
+bool fetchSamplesUring(int fd, std::vector<SampleRead>& reads, QString* error, bool* unsupported)
+{
+    io_uring ring;
+    const unsigned entries = static_cast<unsigned>(qMin<size_t>(reads.size(), kMaxIoQueueDepth * 4));
+    const int initRc = io_uring_queue_init(entries, &ring, 0);
+    if (initRc < 0) {
+        *unsupported = true;
+        return false;
+    }
+    auto queue = [&](size_t index) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        if (!sqe) {
+            return false;
+        }
+        SampleRead& read = reads[index];
+        io_uring_prep_read(sqe, fd, read.buffer + read.filled,
+                           static_cast<unsigned>(read.alignedLength - read.filled),
+                           read.alignedOffset + read.filled);
+        io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(static_cast<uintptr_t>(index)));
+        return true;
+    };
+
+    size_t queued = 0;
+    size_t inFlight = 0;
+    bool ok = true;
+    while (ok && (queued < reads.size() || inFlight > 0)) {
+        while (queued < reads.size() && inFlight < entries && queue(queued)) {
+            ++queued;
+            ++inFlight;
+        }
+        io_uring_submit(&ring);
+        io_uring_cqe* cqe = nullptr;
+        const int waitRc = io_uring_wait_cqe(&ring, &cqe);
+        if (waitRc < 0) {
+            *error = QString("io_uring wait failed: %1").arg(strerror(-waitRc));
+            ok = false;
+            break;
+        }
+        const size_t index = static_cast<size_t>(reinterpret_cast<uintptr_t>(io_uring_cqe_get_data(cqe)));
+        const int res = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+        --inFlight;
+        if (res <= 0) {
+            *error = res < 0 ? QString("Read error: %1").arg(strerror(-res))
+                             : QStringLiteral("Unexpected EOF");
+            ok = false;
+            break;
+        }
+        SampleRead& read = reads[index];
+        read.filled += static_cast<size_t>(res);
+        if (read.filled < read.alignedLength) {
+            // Short read: resubmit the rest of this sample.
+            if (!queue(index)) {
+                *error = QStringLiteral("io_uring submission queue full");
+                ok = false;
+                break;
+            }
+            ++inFlight;
+        }
+    }
+    // On failure, completions still owed reference our buffers; collect them first.
+    while (!ok && inFlight > 0) {
+        io_uring_submit(&ring);
+        io_uring_cqe* cqe = nullptr;
+        if (io_uring_wait_cqe(&ring, &cqe) < 0) {
+            break;
+        }
+        io_uring_cqe_seen(&ring, cqe);
+        --inFlight;
+    }
+    io_uring_queue_exit(&ring);
+    return ok;
+}
+#endif
+
 HashResult hashQuickSample(int fd, const Options& options, uint64_t deviceSize)
 {
     HashResult result;
     result.deviceNode = options.deviceNode;
-    result.algorithm = algorithmName(options.algorithm) + QStringLiteral("-QUICK");
+    result.algorithm = algorithmName(options.algorithm) + QStringLiteral("-QUICK")
+                       + quickSampleLabelSuffix(options.quickSample);
 
     EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
     if (!mdctx || EVP_DigestInit_ex(mdctx, mdFor(options.algorithm), nullptr) != 1) {
@@ -422,52 +966,74 @@ HashResult hashQuickSample(int fd, const Options& options, uint64_t deviceSize)
         return result;
     }
 
-    const uint64_t sampleSize = qMin<uint64_t>(1024ULL * 1024, deviceSize);
-    QVector<uint64_t> offsets;
-    offsets.append(0);
-    if (deviceSize > sampleSize) {
-        offsets.append(deviceSize - sampleSize);
-    }
-    const int spaced = 14;
-    for (int i = 1; i < spaced; ++i) {
-        uint64_t off = (deviceSize * static_cast<uint64_t>(i)) / static_cast<uint64_t>(spaced);
-        if (off + sampleSize > deviceSize) {
-            off = deviceSize > sampleSize ? deviceSize - sampleSize : 0;
-        }
-        if (!offsets.contains(off)) {
-            offsets.append(off);
-        }
+    const QuickSampleLayout layout = normalizedQuickSampleLayout(options.quickSample);
+    const uint64_t sampleSize = qMin<uint64_t>(static_cast<uint64_t>(layout.sampleKB) * 1024, deviceSize);
+    const std::vector<uint64_t> offsets = quickSampleOffsets(layout, deviceSize);
+
+    // Every slot can hold one sample widened by up to a page on each side.
+    const size_t slotBytes = static_cast<size_t>(sampleSize) + 2 * 4096;
+    const size_t batch = qMax<size_t>(1, qMin(offsets.size(), kQuickBatchBytes / slotBytes));
+    const IoBufferPool::Buffer pool(batch * slotBytes);
+    if (!pool) {
+        EVP_MD_CTX_free(mdctx);
+        result.errorMessage = QStringLiteral("Failed to allocate buffer");
+        return result;
     }
 
-    QByteArray buffer;
-    buffer.resize(static_cast<int>(sampleSize));
+    JobMeter meter;
     uint64_t processed = 0;
-
-    for (uint64_t off : offsets) {
+    for (size_t first = 0; first < offsets.size(); first += batch) {
         if (cancelled(options)) {
             EVP_MD_CTX_free(mdctx);
             result.errorMessage = QStringLiteral("Cancelled");
             return result;
         }
-        if (lseek(fd, static_cast<off_t>(off), SEEK_SET) < 0) {
+
+        std::vector<SampleRead> reads(qMin(batch, offsets.size() - first));
+        for (size_t i = 0; i < reads.size(); ++i) {
+            const uint64_t off = offsets[first + i];
+            const uint64_t end = qMin(off + sampleSize, deviceSize);
+            SampleRead& read = reads[i];
+            read.alignedOffset = off & ~uint64_t(4095);
+            read.alignedLength = static_cast<size_t>(qMin((end + 4095) & ~uint64_t(4095), deviceSize)
+                                                     - read.alignedOffset);
+            read.skip = static_cast<size_t>(off - read.alignedOffset);
+            read.length = static_cast<size_t>(end - off);
+            read.buffer = pool.data() + i * slotBytes;
+        }
+
+        QString readError;
+        bool fetched = false;
+        {
+            const JobMeter::Timed readTime = meter.reading();
+#ifdef HAS_LIBURING
+            bool unsupported = options.ioEngine != IoEngine::IoUring;
+            if (!unsupported) {
+                fetched = fetchSamplesUring(fd, reads, &readError, &unsupported);
+            }
+            if (unsupported) {
+                fetched = fetchSamplesThreaded(fd, reads, &readError);
+            }
+#else
+            fetched = fetchSamplesThreaded(fd, reads, &readError);
+#endif
+        }
+        if (!fetched) {
             EVP_MD_CTX_free(mdctx);
-            result.errorMessage = QString("Seek failed: %1").arg(strerror(errno));
+            result.errorMessage = readError;
             return result;
         }
-        const size_t toRead = static_cast<size_t>(qMin(sampleSize, deviceSize - off));
-        size_t got = 0;
-        while (got < toRead) {
-            const ssize_t n = read(fd, buffer.data() + got, toRead - got);
-            if (n <= 0) {
+
+        // Hashed strictly in layout order, whatever order the reads completed in.
+        const JobMeter::Timed hashTime = meter.hashing();
+        for (const SampleRead& read : reads) {
+            if (EVP_DigestUpdate(mdctx, read.buffer + read.skip, read.length) != 1) {
                 EVP_MD_CTX_free(mdctx);
-                result.errorMessage = n < 0 ? QString("Read error: %1").arg(strerror(errno))
-                                            : QStringLiteral("Unexpected EOF");
+                result.errorMessage = QStringLiteral("Hash update failed");
                 return result;
             }
-            got += static_cast<size_t>(n);
+            processed += read.length;
         }
-        EVP_DigestUpdate(mdctx, buffer.constData(), got);
-        processed += got;
         reportProgress(options, processed);
     }
 
@@ -476,6 +1042,8 @@ HashResult hashQuickSample(int fd, const Options& options, uint64_t deviceSize)
     } else {
         result.bytesProcessed = processed;
         result.success = true;
+        meter.fill(result.performance, QStringLiteral("quick_sample"), static_cast<int>(sampleSize / 1024),
+                   static_cast<int>(batch));
     }
     EVP_MD_CTX_free(mdctx);
     return result;
@@ -509,9 +1077,16 @@ HashResult hashChunkedResume(int fd, const Options& options, uint64_t deviceSize
         }
     }
 
-    const size_t bufSize = static_cast<size_t>(options.bufferSizeKB) * 1024;
-    QByteArray buffer;
-    buffer.resize(static_cast<int>(bufSize));
+    const size_t bufSize = static_cast<size_t>(normalizedBufferSizeKB(options.bufferSizeKB)) * 1024;
+    // openDevice() prefers O_DIRECT, which needs an aligned destination.
+    const IoBufferPool::Buffer pooled(bufSize);
+    char* buffer = pooled.data();
+    if (!buffer) {
+        result.errorMessage = QStringLiteral("Failed to allocate buffer");
+        return result;
+    }
+    JobMeter meter;
+    RegionHasher regions(options, startBlock * blockSize);
 
     for (uint64_t block = startBlock; block < numBlocks; ++block) {
         if (cancelled(options)) {
@@ -522,10 +1097,7 @@ HashResult hashChunkedResume(int fd, const Options& options, uint64_t deviceSize
 
         const uint64_t offset = block * blockSize;
         const uint64_t chunkLen = qMin(blockSize, deviceSize - offset);
-        if (lseek(fd, static_cast<off_t>(offset), SEEK_SET) < 0) {
-            result.errorMessage = QString("Seek failed: %1").arg(strerror(errno));
-            return result;
-        }
+        const uint64_t blockBeginNs = JobMeter::nowNs();
 
         EVP_MD_CTX* blockCtx = EVP_MD_CTX_new();
         if (!blockCtx || EVP_DigestInit_ex(blockCtx, mdFor(options.algorithm), nullptr) != 1) {
@@ -535,6 +1107,7 @@ HashResult hashChunkedResume(int fd, const Options& options, uint64_t deviceSize
             result.errorMessage = QStringLiteral("Block hash init failed");
             return result;
         }
+        BlockFeed feed(blockCtx, options.skipZeroRegions);
 
         uint64_t readInBlock = 0;
         while (readInBlock < chunkLen) {
@@ -546,27 +1119,74 @@ HashResult hashChunkedResume(int fd, const Options& options, uint64_t deviceSize
                 return result;
             }
             const size_t toRead = static_cast<size_t>(qMin<uint64_t>(bufSize, chunkLen - readInBlock));
-            const ssize_t n = read(fd, buffer.data(), toRead);
+            const uint64_t at = offset + readInBlock;
+            if (options.skipZeroRegions && rangeIsHole(fd, at, toRead)) {
+                if (!feed.addZeros(toRead) || !regions.update(at, nullptr, toRead)) {
+                    EVP_MD_CTX_free(blockCtx);
+                    result.errorMessage = QStringLiteral("Failed to update hash");
+                    return result;
+                }
+                readInBlock += toRead;
+                bytesDone += toRead;
+                reportProgress(options, bytesDone);
+                continue;
+            }
+            ssize_t n = 0;
+            {
+                const JobMeter::Timed readTime = meter.reading();
+                n = pread(fd, buffer, toRead, static_cast<off_t>(at));
+            }
+            if (n < 0 && errno == EINTR) {
+                meter.retried();
+                continue;
+            }
             if (n <= 0) {
                 EVP_MD_CTX_free(blockCtx);
                 result.errorMessage = n < 0 ? QString("Read error: %1").arg(strerror(errno))
                                             : QStringLiteral("Unexpected EOF");
                 return result;
             }
-            EVP_DigestUpdate(blockCtx, buffer.constData(), static_cast<size_t>(n));
+            if (options.dataRead) {
+                options.dataRead(at, buffer, static_cast<size_t>(n));
+            }
+            bool updated = false;
+            {
+                const JobMeter::Timed hashTime = meter.hashing();
+                updated = feed.update(buffer, static_cast<size_t>(n))
+                          && regions.update(at, buffer, static_cast<uint64_t>(n));
+            }
+            if (!updated) {
+                EVP_MD_CTX_free(blockCtx);
+                result.errorMessage = QStringLiteral("Failed to update hash");
+                return result;
+            }
             readInBlock += static_cast<uint64_t>(n);
             bytesDone += static_cast<uint64_t>(n);
             reportProgress(options, bytesDone);
         }
 
         QString blockHex;
-        if (!finalizeCtx(blockCtx, blockHex)) {
+        if (!feed.finish(options.algorithm, chunkLen, &blockHex)) {
             EVP_MD_CTX_free(blockCtx);
             result.errorMessage = QStringLiteral("Block finalize failed");
             return result;
         }
         EVP_MD_CTX_free(blockCtx);
+        meter.blockTimed(block, JobMeter::nowNs() - blockBeginNs);
         blockHashes.append(blockHex);
+        if (options.blockHashed) {
+            options.blockHashed(block, blockHex);
+        }
+
+        if (differsFromBaseline(options, block, blockHex)) {
+            result.blockHashes = blockHashes;
+            result.blockSize = blockSize;
+            result.stoppedAtBlock = static_cast<qint64>(block);
+            result.bytesProcessed = bytesDone;
+            result.success = true;
+            meter.fill(result.performance, QStringLiteral("chunked"), static_cast<int>(bufSize / 1024), 1);
+            return result;
+        }
 
         const int every = qMax(1, options.checkpointEveryBlocks);
         if (options.checkpointOut
@@ -576,14 +1196,237 @@ HashResult hashChunkedResume(int fd, const Options& options, uint64_t deviceSize
     }
 
     result.hash = combineBlockHashes(blockHashes, options.algorithm);
+    result.blockHashes = blockHashes;
+    result.blockSize = blockSize;
     result.bytesProcessed = bytesDone;
     result.success = !result.hash.isEmpty();
+    regions.finish(&result.regionHashes);
+    meter.fill(result.performance, QStringLiteral("chunked"), static_cast<int>(bufSize / 1024), 1);
     if (!result.success && result.errorMessage.isEmpty()) {
         result.errorMessage = QStringLiteral("Failed to combine block hashes");
     }
     return result;
 }
 
+int effectiveHashThreads(const Options& options, uint64_t blocks)
+{
+    int threads = options.hashThreads;
+    if (threads <= 0) {
+        threads = static_cast<int>(std::thread::hardware_concurrency());
+    }
+    threads = qBound(1, threads, kMaxHashThreads);
+    return static_cast<int>(qMin<uint64_t>(static_cast<uint64_t>(threads), qMax<uint64_t>(1, blocks)));
+}
+
+/**
+ * Workers claim block indices from a shared counter and pread() them independently.
+ * Block digests land in their index slot and are folded in order afterwards, so the
+ * root matches hashChunkedResume(). On cancel/error only the contiguous finished
+ * prefix goes into the checkpoint, keeping resume semantics identical.
+ */
+HashResult hashChunkedParallel(int fd, const Options& options, uint64_t deviceSize)
+{
+    HashResult result;
+    result.deviceNode = options.deviceNode;
+    result.algorithm = algorithmName(options.algorithm);
+
+    const uint64_t blockSize = kDefaultChunkBytes;
+    const uint64_t numBlocks = (deviceSize + blockSize - 1) / blockSize;
+
+    QStringList blockHashes;
+    uint64_t startBlock = 0;
+    if (options.checkpointOut && options.checkpointOut->isValid()
+        && options.checkpointOut->deviceSize == deviceSize
+        && options.checkpointOut->blockSize == blockSize) {
+        blockHashes = options.checkpointOut->blockHashes;
+        startBlock = static_cast<uint64_t>(blockHashes.size());
+        if (options.resumeFromBytes > 0) {
+            startBlock = qMin<uint64_t>(startBlock, options.resumeFromBytes / blockSize);
+            while (static_cast<uint64_t>(blockHashes.size()) > startBlock) {
+                blockHashes.removeLast();
+            }
+        }
+    }
+
+    const uint64_t pending = numBlocks - startBlock;
+    std::vector<QString> blockHex(static_cast<size_t>(pending));
+    std::vector<uint8_t> completed(static_cast<size_t>(pending), 0);
+    std::atomic<uint64_t> nextBlock{startBlock};
+    std::atomic<uint64_t> bytesDone{qMin(deviceSize, startBlock * blockSize)};
+    std::atomic<bool> failed{false};
+    std::atomic<bool> mismatchFound{false};
+    uint64_t firstMismatch = numBlocks;
+    std::mutex errorMutex;
+    QString errorMessage;
+
+    const size_t bufSize = static_cast<size_t>(normalizedBufferSizeKB(options.bufferSizeKB)) * 1024;
+    const EVP_MD* md = mdFor(options.algorithm);
+    JobMeter meter;
+
+    auto fail = [&](const QString& message) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!failed.exchange(true)) {
+            errorMessage = message;
+        }
+    };
+
+    auto worker = [&]() {
+        const IoBufferPool::Buffer pooled(bufSize);
+        char* buffer = pooled.data();
+        if (!buffer) {
+            fail(QStringLiteral("Failed to allocate buffer"));
+            return;
+        }
+        EVP_MD_CTX* ctx = EVP_MD_CTX_new();
+        if (!ctx) {
+            fail(QStringLiteral("Block hash init failed"));
+            return;
+        }
+
+        for (;;) {
+            // Blocks already claimed still finish after a mismatch, so every block below
+            // the first one found is hashed and firstMismatch really is the first.
+            if (failed.load() || cancelled(options) || mismatchFound.load()) {
+                break;
+            }
+            const uint64_t block = nextBlock.fetch_add(1);
+            if (block >= numBlocks) {
+                break;
+            }
+            if (EVP_DigestInit_ex(ctx, md, nullptr) != 1) {
+                fail(QStringLiteral("Block hash init failed"));
+                break;
+            }
+
+            const uint64_t offset = block * blockSize;
+            const uint64_t chunkLen = qMin(blockSize, deviceSize - offset);
+            const uint64_t blockBeginNs = JobMeter::nowNs();
+            BlockFeed feed(ctx, options.skipZeroRegions);
+            uint64_t readInBlock = 0;
+            bool blockOk = true;
+            while (readInBlock < chunkLen) {
+                if (cancelled(options) || failed.load()) {
+                    blockOk = false;
+                    break;
+                }
+                const size_t toRead =
+                    static_cast<size_t>(qMin<uint64_t>(bufSize, chunkLen - readInBlock));
+                if (options.skipZeroRegions && rangeIsHole(fd, offset + readInBlock, toRead)) {
+                    if (!feed.addZeros(toRead)) {
+                        fail(QStringLiteral("Failed to update hash"));
+                        blockOk = false;
+                        break;
+                    }
+                    readInBlock += toRead;
+                    reportProgress(options, bytesDone.fetch_add(toRead) + toRead);
+                    continue;
+                }
+                ssize_t n = 0;
+                {
+                    const JobMeter::Timed readTime = meter.reading();
+                    n = pread(fd, buffer, toRead, static_cast<off_t>(offset + readInBlock));
+                }
+                if (n < 0 && errno == EINTR) {
+                    meter.retried();
+                    continue;
+                }
+                if (n <= 0) {
+                    fail(n < 0 ? QString("Read error: %1").arg(strerror(errno))
+                               : QStringLiteral("Unexpected EOF"));
+                    blockOk = false;
+                    break;
+                }
+                if (options.dataRead) {
+                    options.dataRead(offset + readInBlock, buffer, static_cast<size_t>(n));
+                }
+                bool updated = false;
+                {
+                    const JobMeter::Timed hashTime = meter.hashing();
+                    updated = feed.update(buffer, static_cast<size_t>(n));
+                }
+                if (!updated) {
+                    fail(QStringLiteral("Failed to update hash"));
+                    blockOk = false;
+                    break;
+                }
+                readInBlock += static_cast<uint64_t>(n);
+                reportProgress(options, bytesDone.fetch_add(static_cast<uint64_t>(n))
+                                            + static_cast<uint64_t>(n));
+            }
+            if (!blockOk) {
+                break;
+            }
+
+            QString hex;
+            if (!feed.finish(options.algorithm, chunkLen, &hex)) {
+                fail(QStringLiteral("Block finalize failed"));
+                break;
+            }
+            meter.blockTimed(block, JobMeter::nowNs() - blockBeginNs);
+            const size_t slot = static_cast<size_t>(block - startBlock);
+            blockHex[slot] = hex;
+            completed[slot] = 1;
+            if (options.blockHashed) {
+                options.blockHashed(block, hex);
+            }
+            if (differsFromBaseline(options, block, hex)) {
+                std::lock_guard<std::mutex> lock(errorMutex);
+                firstMismatch = qMin(firstMismatch, block);
+                mismatchFound.store(true);
+            }
+        }
+
+        EVP_MD_CTX_free(ctx);
+    };
+
+    const int threads = effectiveHashThreads(options, pending);
+    std::vector<std::thread> pool;
+    pool.reserve(static_cast<size_t>(threads));
+    for (int i = 0; i < threads; ++i) {
+        pool.emplace_back(worker);
+    }
+    for (std::thread& t : pool) {
+        t.join();
+    }
+    // Read and digest time summed over every worker, so either can exceed the wall time
+    meter.fill(result.performance, QStringLiteral("parallel"), static_cast<int>(bufSize / 1024), threads);
+
+    uint64_t prefix = 0;
+    while (prefix < pending && completed[static_cast<size_t>(prefix)]) {
+        blockHashes.append(blockHex[static_cast<size_t>(prefix)]);
+        ++prefix;
+    }
+    const uint64_t prefixBytes = qMin(deviceSize, (startBlock + prefix) * blockSize);
+    writeCheckpoint(options, result.algorithm, deviceSize, blockSize, blockHashes, prefixBytes);
+
+    if (failed.load() || cancelled(options)) {
+        result.errorMessage = cancelled(options) ? QStringLiteral("Cancelled") : errorMessage;
+        return result;
+    }
+
+    if (mismatchFound.load()) {
+        while (static_cast<uint64_t>(blockHashes.size()) > firstMismatch + 1) {
+            blockHashes.removeLast();
+        }
+        result.blockHashes = blockHashes;
+        result.blockSize = blockSize;
+        result.stoppedAtBlock = static_cast<qint64>(firstMismatch);
+        result.bytesProcessed = bytesDone.load();
+        result.success = true;
+        return result;
+    }
+
+    result.hash = combineBlockHashes(blockHashes, options.algorithm);
+    result.blockHashes = blockHashes;
+    result.blockSize = blockSize;
+    result.bytesProcessed = prefixBytes;
+    result.success = !result.hash.isEmpty();
+    if (!result.success) {
+        result.errorMessage = QStringLiteral("Failed to combine block hashes");
+    }
+    return result;
+}
+
 } // namespace
 
 QString scanModeTag(ScanMode mode)
@@ -612,11 +1455,394 @@ QString combineBlockHashes(const QStringList& blockHex, Algorithm algo)
     return out;
 }
 
+namespace {
+
+/**
+ * Runs one read at a time on a worker thread and waits for it with a deadline. A read that
+ * misses it is abandoned: its worker keeps the buffer, exits when the kernel returns, and a
+ * fresh worker takes the next read.
+ */
+class TimedReader {
+public:
+    enum class Status { Ok, Failed, TimedOut, Cancelled };
+
+    TimedReader(ReadAtFn readAt, size_t bufferSize, int timeoutMs, const Options& options)
+        : m_readAt(std::move(readAt))
+        , m_bufferSize(bufferSize)
+        , m_timeoutMs(qMax(timeoutMs, kMinReadTimeoutMs))
+        , m_options(options)
+    {
+    }
+
+    ~TimedReader()
+    {
+        if (m_state) {
+            {
+                std::lock_guard<std::mutex> lock(m_state->mutex);
+                m_state->stop = true;
+            }
+            m_state->wake.notify_all();
+            m_thread.join();
+        }
+    }
+
+    TimedReader(const TimedReader&) = delete;
+    TimedReader& operator=(const TimedReader&) = delete;
+
+    /** Reads at most bufferSize bytes into data(); @p count is what pread() returned. */
+    Status read(uint64_t offset, size_t length, int64_t* count, int* error)
+    {
+        if (!m_state && !startWorker()) {
+            *error = ENOMEM;
+            return Status::Failed;
+        }
+        std::unique_lock<std::mutex> lock(m_state->mutex);
+        m_state->offset = offset;
+        m_state->length = qMin(length, m_bufferSize);
+        m_state->pending = true;
+        m_state->done = false;
+        m_state->wake.notify_all();
+
+        // Waited for in slices, so Cancel does not wait out a stuck read.
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(m_timeoutMs);
+        while (!m_state->done) {
+            const auto slice = std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(100));
+            m_state->wake.wait_until(lock, slice, [this] { return m_state->done; });
+            if (m_state->done) {
+                break;
+            }
+            const bool stop = cancelled(m_options);
+            if (stop || std::chrono::steady_clock::now() >= deadline) {
+                m_state->abandoned = true;
+                lock.unlock();
+                m_thread.detach();
+                m_state.reset();
+                ++m_abandoned;
+                return stop ? Status::Cancelled : Status::TimedOut;
+            }
+        }
+        *count = m_state->count;
+        *error = m_state->error;
+        return m_state->count < 0 ? Status::Failed : Status::Ok;
+    }
+
+    const char* data() const { return m_state ? m_state->buffer : nullptr; }
+    int abandoned() const { return m_abandoned; }
+
+private:
+    struct State {
+        std::mutex mutex;
+        std::condition_variable wake;
+        char* buffer = nullptr;
+        uint64_t offset = 0;
+        size_t length = 0;
+        bool pending = false;
+        bool done = false;
+        bool stop = false;
+        bool abandoned = false;
+        int64_t count = 0;
+        int error = 0;
+
+        ~State() { free(buffer); }
+    };
+
+    bool startWorker()
+    {
+        auto state = std::make_shared<State>();
+        void* buffer = nullptr;
+        if (posix_memalign(&buffer, 4096, m_bufferSize) != 0) {
+            return false;
+        }
+        state->buffer = static_cast<char*>(buffer);
+        // The worker owns copies of what it needs: an abandoned one outlives this reader.
+        m_thread = std::thread([state, readAt = m_readAt] {
+            std::unique_lock<std::mutex> lock(state->mutex);
+            for (;;) {
+                state->wake.wait(lock, [&state] { return state->pending || state->stop; });
+                if (state->stop) {
+                    return;
+                }
+                state->pending = false;
+                const uint64_t offset = state->offset;
+                const size_t length = state->length;
+                lock.unlock();
+                int64_t n = 0;
+                do {
+                    n = readAt(state->buffer, length, offset);
+                } while (n < 0 && errno == EINTR);
+                const int error = n < 0 ? errno : 0;
+                lock.lock();
+                state->count = n;
+                state->error = error;
+                state->done = true;
+                state->wake.notify_all();
+                if (state->abandoned) {
+                    return;
+                }
+            }
+        });
+        m_state = std::move(state);
+        return true;
+    }
+
+    ReadAtFn m_readAt;
+    size_t m_bufferSize;
+    int m_timeoutMs;
+    const Options& m_options;
+    std::shared_ptr<State> m_state;
+    std::thread m_thread;
+    int m_abandoned = 0;
+};
+
+} // namespace
+
+HashResult hashTolerant(const ReadAtFn& readAt, const Options& options, uint64_t deviceSize)
+{
+    HashResult result;
+    result.deviceNode = options.deviceNode;
+    result.algorithm = algorithmName(options.algorithm);
+
+    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
+    if (!mdctx || EVP_DigestInit_ex(mdctx, mdFor(options.algorithm), nullptr) != 1) {
+        EVP_MD_CTX_free(mdctx);
+        result.errorMessage = QStringLiteral("Failed to initialize hash algorithm");
+        return result;
+    }
+
+    const size_t bufferSize = static_cast<size_t>(normalizedBufferSizeKB(options.bufferSizeKB)) * 1024;
+    std::vector<size_t> pieceSizes{bufferSize};
+    for (size_t retry : kTolerantRetryBytes) {
+        if (retry < pieceSizes.back()) {
+            pieceSizes.push_back(retry);
+        }
+    }
+    TimedReader reader(readAt, bufferSize, options.readTimeoutMs, options);
+    JobMeter meter;
+    QElapsedTimer elapsed;
+    elapsed.start();
+    uint64_t done = 0;
+    QString error;
+
+    // Unreadable bytes go into the digest as zeros, so the same damage gives the same hash.
+    auto giveUp = [&](uint64_t offset, uint64_t length, bool timedOut) {
+        if (!result.unreadableRanges.isEmpty()) {
+            UnreadableRange& last = result.unreadableRanges.last();
+            if (last.offset + last.length == offset && last.timedOut == timedOut) {
+                last.length += length;
+                return feedZeros(mdctx, length);
+            }
+        }
+        result.unreadableRanges.append(UnreadableRange{offset, length, timedOut});
+        return feedZeros(mdctx, length);
+    };
+
+    std::function<bool(uint64_t, uint64_t, size_t)> readRange = [&](uint64_t offset, uint64_t length,
+                                                                    size_t level) {
+        const uint64_t end = offset + length;
+        uint64_t pos = offset;
+        while (pos < end) {
+            const size_t piece = static_cast<size_t>(qMin<uint64_t>(pieceSizes[level], end - pos));
+            int64_t n = 0;
+            int readError = 0;
+            TimedReader::Status status;
+            {
+                const JobMeter::Timed readTime = meter.reading();
+                status = reader.read(pos, piece, &n, &readError);
+            }
+            if (status == TimedReader::Status::Cancelled || cancelled(options)) {
+                error = QStringLiteral("Cancelled");
+                return false;
+            }
+            if (status == TimedReader::Status::Ok && n > 0) {
+                const JobMeter::Timed hashTime = meter.hashing();
+                if (EVP_DigestUpdate(mdctx, reader.data(), static_cast<size_t>(n)) != 1) {
+                    error = QStringLiteral("Failed to update hash");
+                    return false;
+                }
+                pos += static_cast<uint64_t>(n);
+            } else if (status == TimedReader::Status::Ok) {
+                // The device ended early; the rest of the range cannot be read.
+                if (!giveUp(pos, end - pos, false)) {
+                    error = QStringLiteral("Failed to update hash");
+                    return false;
+                }
+                pos = end;
+            } else if (status == TimedReader::Status::Failed && level + 1 < pieceSizes.size()) {
+                meter.retried();
+                if (!readRange(pos, piece, level + 1)) {
+                    return false;
+                }
+                pos += piece;
+            } else {
+                // A timed-out read is not split: every piece of it could cost another timeout.
+                if (!giveUp(pos, piece, status == TimedReader::Status::TimedOut)) {
+                    error = QStringLiteral("Failed to update hash");
+                    return false;
+                }
+                pos += piece;
+                if (reader.abandoned() >= kMaxAbandonedReads) {
+                    error = QStringLiteral("The device stopped responding at byte %1 (%2 reads timed out)")
+                                .arg(pos)
+                                .arg(reader.abandoned());
+                    return false;
+                }
+            }
+            if (level == 0) {
+                done = pos;
+                reportProgress(options, done);
+            }
+        }
+        return true;
+    };
+
+    const bool ok = readRange(0, deviceSize, 0);
+    meter.readsTookTheRest(static_cast<uint64_t>(elapsed.elapsed()));
+    meter.fill(result.performance, QStringLiteral("tolerant"), static_cast<int>(bufferSize / 1024), 1);
+    if (!ok) {
+        EVP_MD_CTX_free(mdctx);
+        result.errorMessage = error;
+        result.bytesProcessed = done;
+        return result;
+    }
+    if (!finalizeCtx(mdctx, result.hash)) {
+        EVP_MD_CTX_free(mdctx);
+        result.errorMessage = QStringLiteral("Failed to finalize hash");
+        return result;
+    }
+    EVP_MD_CTX_free(mdctx);
+    result.bytesProcessed = deviceSize;
+    result.success = true;
+    return result;
+}
+
+namespace {
+
+/**
+ * Whether the device still holds what a resume checkpoint hashed: its first and last blocks
+ * are read again. A checkpoint that followed the device to a new node (storageIdentity())
+ * could otherwise carry on over a disk that was rewritten while it was away.
+ */
+bool resumeBlocksMatch(int fd, const Options& options, uint64_t deviceSize)
+{
+    const HashCheckpoint& cp = *options.checkpointOut;
+    if (cp.deviceSize != deviceSize || cp.blockSize != kDefaultChunkBytes) {
+        return true;  // not resumable anyway; the engines start over
+    }
+    const uint64_t blocks = qMin<uint64_t>(static_cast<uint64_t>(cp.blockHashes.size()),
+                                           options.resumeFromBytes / cp.blockSize);
+    if (blocks == 0) {
+        return true;
+    }
+    const size_t bufSize = static_cast<size_t>(normalizedBufferSizeKB(options.bufferSizeKB)) * 1024;
+    const IoBufferPool::Buffer buffer(bufSize);
+    if (!buffer) {
+        return false;
+    }
+    EVP_MD_CTX* mdctx = EVP_MD_CTX_new();
+    if (!mdctx) {
+        return false;
+    }
+
+    bool match = true;
+    for (const uint64_t block : {uint64_t(0), blocks - 1}) {
+        const uint64_t offset = block * cp.blockSize;
+        const uint64_t end = qMin(offset + cp.blockSize, deviceSize);
+        QString digest;
+        bool ok = EVP_DigestInit_ex(mdctx, mdFor(options.algorithm), nullptr) == 1;
+        for (uint64_t pos = offset; ok && pos < end;) {
+            const ssize_t n = pread(fd, buffer.data(), static_cast<size_t>(qMin<uint64_t>(bufSize, end - pos)),
+                                    static_cast<off_t>(pos));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            ok = n > 0 && EVP_DigestUpdate(mdctx, buffer.data(), static_cast<size_t>(n)) == 1;
+            pos += n > 0 ? static_cast<uint64_t>(n) : 0;
+        }
+        if (!ok || !finalizeCtx(mdctx, digest)
+            || digest.compare(cp.blockHashes.at(static_cast<qsizetype>(block)), Qt::CaseInsensitive) != 0) {
+            match = false;
+            break;
+        }
+        if (blocks == 1) {
+            break;
+        }
+    }
+    EVP_MD_CTX_free(mdctx);
+    return match;
+}
+
+} // namespace
+
+struct BlockStreamHasher::State {
+    EVP_MD_CTX* ctx = nullptr;
+};
+
+BlockStreamHasher::BlockStreamHasher(Algorithm algo)
+    : m_state(std::make_unique<State>())
+    , m_algorithm(algo)
+{
+    m_state->ctx = EVP_MD_CTX_new();
+    m_failed = !m_state->ctx || EVP_DigestInit_ex(m_state->ctx, mdFor(algo), nullptr) != 1;
+}
+
+BlockStreamHasher::~BlockStreamHasher()
+{
+    EVP_MD_CTX_free(m_state->ctx);
+}
+
+bool BlockStreamHasher::update(const char* data, size_t length)
+{
+    while (length > 0 && !m_failed) {
+        const size_t n = static_cast<size_t>(qMin<uint64_t>(length, kDefaultChunkBytes - m_inBlock));
+        m_failed = EVP_DigestUpdate(m_state->ctx, data, n) != 1;
+        m_inBlock += n;
+        m_bytes += n;
+        data += n;
+        length -= n;
+        if (m_inBlock == kDefaultChunkBytes && !m_failed) {
+            QString hex;
+            m_failed = !finalizeCtx(m_state->ctx, hex)
+                       || EVP_DigestInit_ex(m_state->ctx, mdFor(m_algorithm), nullptr) != 1;
+            m_blockHashes.append(hex);
+            m_inBlock = 0;
+        }
+    }
+    return !m_failed;
+}
+
+bool BlockStreamHasher::finish()
+{
+    if (m_inBlock > 0 && !m_failed) {
+        QString hex;
+        m_failed = !finalizeCtx(m_state->ctx, hex);
+        m_blockHashes.append(hex);
+        m_inBlock = 0;
+    }
+    if (!m_failed) {
+        m_hash = combineBlockHashes(m_blockHashes, m_algorithm);
+        m_failed = m_hash.isEmpty();
+    }
+    return !m_failed;
+}
+
 HashResult hashAdvanced(int fd, const Options& options, uint64_t deviceSize)
 {
     if (options.scanMode == ScanMode::QuickSample) {
         return hashQuickSample(fd, options, deviceSize);
     }
+    if (options.resumeFromBytes > 0 && options.checkpointOut && !resumeBlocksMatch(fd, options, deviceSize)) {
+        options.checkpointOut->blockHashes.clear();
+        options.checkpointOut->bytesCompleted = 0;
+        Options fresh = options;
+        fresh.resumeFromBytes = 0;
+        HashResult result = hashAdvanced(fd, fresh, deviceSize);
+        result.checkpointRejected = true;
+        return result;
+    }
+    // Region digests need the device in offset order, which only the sequential loop gives.
+    if (options.scanMode == ScanMode::ParallelChunked && options.regions.empty()) {
+        return hashChunkedParallel(fd, options, deviceSize);
+    }
     return hashChunkedResume(fd, options, deviceSize);
 }
 
@@ -0,0 +1,1148 @@
+#include "RawFsReader.h"
+
+#include <QByteArray>
+#include <QDate>
+#include <QHash>
+#include <QStringList>
+#include <QTime>
+#include <QTimeZone>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#ifndef Q_OS_WIN
+#include <cerrno>
+#include <cstdlib>
+#include <unistd.h>
+#endif
+
+namespace FlashSpartan {
+
+namespace {
+
+// Directories larger than this are treated as corrupt (exFAT allows 256 MiB, FAT32 2 MiB).
+constexpr uint64_t kMaxDirectoryBytes = 256ULL * 1024 * 1024;
+// Indirect and extent-tree levels followed before a volume counts as corrupt.
+constexpr int kMaxMapDepth = 5;
+
+uint16_t le16(const char* p)
+{
+    const auto* b = reinterpret_cast<const unsigned char*>(p);
+    return static_cast<uint16_t>(b[0] | (b[1] << 8));
+}
+
+uint32_t le32(const char* p)
+{
+    return static_cast<uint32_t>(le16(p)) | (static_cast<uint32_t>(le16(p + 2)) << 16);
+}
+
+uint64_t le64(const char* p)
+{
+    return static_cast<uint64_t>(le32(p)) | (static_cast<uint64_t>(le32(p + 4)) << 32);
+}
+
+uint8_t byteAt(const char* p)
+{
+    return static_cast<uint8_t>(*p);
+}
+
+bool isPowerOfTwo(uint64_t value)
+{
+    return value != 0 && (value & (value - 1)) == 0;
+}
+
+QString corrupt(const QString& what)
+{
+    return QStringLiteral("Corrupt volume: %1").arg(what);
+}
+
+/** Date and time fields as FAT and exFAT store them; @p utcOffsetMinutes absent means local time. */
+QDateTime dosDateTime(uint16_t date, uint16_t time, int extraMs, const int* utcOffsetMinutes)
+{
+    const QDate d(1980 + (date >> 9), (date >> 5) & 0x0F, date & 0x1F);
+    const QTime t(time >> 11, (time >> 5) & 0x3F, (time & 0x1F) * 2);
+    if (!d.isValid() || !t.isValid()) {
+        return {};
+    }
+    if (utcOffsetMinutes) {
+        return QDateTime(d, t, QTimeZone::utc()).addMSecs(extraMs).addSecs(-*utcOffsetMinutes * 60);
+    }
+    // No zone on disk: the kernel reads it as local time, as a mount does by default.
+    return QDateTime(d, t).addMSecs(extraMs).toUTC();
+}
+
+/** Shared by FAT and exFAT: a cluster heap addressed through a file allocation table. */
+class ClusterVolume : public RawFsReader {
+protected:
+    using RawFsReader::RawFsReader;
+
+    bool isDataCluster(uint32_t cluster) const
+    {
+        return cluster >= 2 && cluster - 2 < m_clusterCount;
+    }
+
+    uint64_t clusterOffset(uint32_t cluster) const
+    {
+        return m_heapOffset + static_cast<uint64_t>(cluster - 2) * m_clusterBytes;
+    }
+
+    /** The FAT entry of @p cluster; end-of-chain values are left to isEndOfChain(). */
+    virtual bool fatEntry(uint32_t cluster, uint32_t* value, QString* error) = 0;
+    virtual bool isEndOfChain(uint32_t value) const = 0;
+
+    /** @p length bytes of the FAT at @p offset, through a window of the table. */
+    bool fatBytes(uint64_t offset, size_t length, char* out, QString* error)
+    {
+        if (offset + length > m_fatBytes) {
+            *error = corrupt(QStringLiteral("FAT entry out of range"));
+            return false;
+        }
+        if (offset < m_windowStart || offset + length > m_windowStart + static_cast<uint64_t>(m_window.size())) {
+            // Windows overlap by a few bytes so FAT12 entries never straddle two of them.
+            const uint64_t start = offset - offset % kFatWindowBytes;
+            const uint64_t size = std::min<uint64_t>(kFatWindowBytes + 8, m_fatBytes - start);
+            m_window.resize(static_cast<qsizetype>(size));
+            m_windowStart = UINT64_MAX;
+            if (!readAt(m_fatOffset + start, m_window.data(), static_cast<size_t>(size), error)) {
+                return false;
+            }
+            m_windowStart = start;
+        }
+        std::memcpy(out, m_window.constData() + (offset - m_windowStart), length);
+        return true;
+    }
+
+    /** Clusters of the chain from @p first; fails when it is longer than @p limit or broken. */
+    bool chain(uint32_t first, uint64_t limit, std::vector<uint32_t>* out, QString* error)
+    {
+        out->clear();
+        uint32_t cluster = first;
+        while (true) {
+            if (!isDataCluster(cluster)) {
+                *error = corrupt(QStringLiteral("cluster %1 outside the data area").arg(cluster));
+                return false;
+            }
+            if (out->size() >= limit || out->size() >= m_clusterCount) {
+                *error = corrupt(QStringLiteral("cluster chain too long"));
+                return false;
+            }
+            out->push_back(cluster);
+            uint32_t next = 0;
+            if (!fatEntry(cluster, &next, error)) {
+                return false;
+            }
+            if (isEndOfChain(next)) {
+                return true;
+            }
+            cluster = next;
+        }
+    }
+
+    /**
+     * The clusters holding @p length bytes: followed through the FAT, or consecutive from
+     * @p first when @p contiguous.
+     */
+    bool clustersFor(uint32_t first, uint64_t length, bool contiguous, std::vector<uint32_t>* out,
+                     QString* error)
+    {
+        const uint64_t needed = (length + m_clusterBytes - 1) / m_clusterBytes;
+        out->clear();
+        if (needed == 0) {
+            return true;
+        }
+        if (contiguous) {
+            if (!isDataCluster(first) || needed > m_clusterCount - (first - 2)) {
+                *error = corrupt(QStringLiteral("contiguous run outside the data area"));
+                return false;
+            }
+            out->reserve(static_cast<size_t>(needed));
+            for (uint64_t i = 0; i < needed; ++i) {
+                out->push_back(static_cast<uint32_t>(first + i));
+            }
+            return true;
+        }
+        if (!chain(first, needed, out, error)) {
+            return false;
+        }
+        if (out->size() < needed) {
+            *error = corrupt(QStringLiteral("cluster chain ends before the data"));
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Streams @p length bytes held in @p clusters, adjacent clusters read together. Bytes
+     * from @p validLength on are zeros (exFAT's ValidDataLength). @p content: file data, not
+     * a directory.
+     */
+    bool readClusters(const std::vector<uint32_t>& clusters, uint64_t length, uint64_t validLength,
+                      bool content, const ConsumeFn& consume, QString* error)
+    {
+        QByteArray buffer;
+        uint64_t position = 0;
+        size_t i = 0;
+        while (position < length) {
+            if (i >= clusters.size()) {
+                *error = corrupt(QStringLiteral("cluster chain ends before the data"));
+                return false;
+            }
+            size_t run = 1;
+            while (i + run < clusters.size() && clusters[i + run] == clusters[i] + run
+                   && run * static_cast<uint64_t>(m_clusterBytes) < kReadChunkBytes) {
+                ++run;
+            }
+            const uint64_t runBytes = std::min<uint64_t>(static_cast<uint64_t>(run) * m_clusterBytes,
+                                                         length - position);
+            // exFAT clusters can be far larger than one read chunk.
+            for (uint64_t done = 0; done < runBytes;) {
+                const size_t bytes = static_cast<size_t>(std::min<uint64_t>(kReadChunkBytes, runBytes - done));
+                const uint64_t at = position + done;
+                buffer.resize(static_cast<qsizetype>(bytes));
+                const size_t stored =
+                    at >= validLength ? 0 : static_cast<size_t>(std::min<uint64_t>(bytes, validLength - at));
+                const uint64_t from = clusterOffset(clusters[i]) + done;
+                if (stored > 0
+                    && !(content ? readContentAt(from, buffer.data(), stored, error)
+                                 : readAt(from, buffer.data(), stored, error))) {
+                    return false;
+                }
+                std::memset(buffer.data() + stored, 0, bytes - stored);
+                if (!consume(buffer.constData(), bytes)) {
+                    return false;
+                }
+                done += bytes;
+            }
+            position += runBytes;
+            i += run;
+        }
+        return true;
+    }
+
+    /** The whole of a directory, for parsing in memory. */
+    bool readDirectory(const std::vector<uint32_t>& clusters, QByteArray* out, QString* error)
+    {
+        out->clear();
+        const uint64_t length = static_cast<uint64_t>(clusters.size()) * m_clusterBytes;
+        if (length > kMaxDirectoryBytes) {
+            *error = corrupt(QStringLiteral("directory too large"));
+            return false;
+        }
+        out->reserve(static_cast<qsizetype>(length));
+        return readClusters(clusters, length, length, false,
+                            [out](const char* data, size_t n) {
+                                out->append(data, static_cast<qsizetype>(n));
+                                return true;
+                            },
+                            error);
+    }
+
+    static constexpr uint64_t kFatWindowBytes = 64 * 1024;
+
+    uint64_t m_fatOffset = 0;
+    uint64_t m_fatBytes = 0;
+    uint64_t m_heapOffset = 0;
+    uint32_t m_clusterBytes = 0;
+    uint32_t m_clusterCount = 0;
+
+private:
+    QByteArray m_window;
+    uint64_t m_windowStart = UINT64_MAX;
+};
+
+class FatReader final : public ClusterVolume {
+public:
+    FatReader(ReadAt read, uint64_t volumeSize)
+        : ClusterVolume(std::move(read), volumeSize)
+    {
+    }
+
+    bool init(const char* boot, uint64_t volumeSize, QString* error)
+    {
+        const uint32_t sectorBytes = le16(boot + 11);
+        const uint32_t sectorsPerCluster = byteAt(boot + 13);
+        const uint32_t reservedSectors = le16(boot + 14);
+        const uint32_t fatCount = byteAt(boot + 16);
+        const uint32_t rootEntries = le16(boot + 17);
+        const uint64_t totalSectors = le16(boot + 19) != 0 ? le16(boot + 19) : le32(boot + 32);
+        const uint64_t fatSectors = le16(boot + 22) != 0 ? le16(boot + 22) : le32(boot + 36);
+        if (sectorBytes < 512 || sectorBytes > 4096 || !isPowerOfTwo(sectorBytes)
+            || !isPowerOfTwo(sectorsPerCluster) || reservedSectors == 0 || fatCount == 0
+            || fatSectors == 0 || totalSectors == 0) {
+            *error = QStringLiteral("Not a FAT volume");
+            return false;
+        }
+
+        const uint64_t rootSectors = (static_cast<uint64_t>(rootEntries) * 32 + sectorBytes - 1) / sectorBytes;
+        const uint64_t metaSectors = reservedSectors + fatCount * fatSectors + rootSectors;
+        if (metaSectors >= totalSectors || totalSectors * sectorBytes > volumeSize) {
+            *error = corrupt(QStringLiteral("FAT layout exceeds the volume"));
+            return false;
+        }
+        const uint64_t clusters = (totalSectors - metaSectors) / sectorsPerCluster;
+        m_width = clusters < 4085 ? 12 : clusters < 65525 ? 16 : 32;
+        if (m_width == 32 && (rootEntries != 0 || clusters > 0x0FFFFFF5)) {
+            *error = corrupt(QStringLiteral("FAT32 layout"));
+            return false;
+        }
+
+        m_clusterBytes = sectorBytes * sectorsPerCluster;
+        m_clusterCount = static_cast<uint32_t>(clusters);
+        m_fatOffset = static_cast<uint64_t>(reservedSectors) * sectorBytes;
+        m_fatBytes = fatSectors * sectorBytes;
+        m_rootOffset = m_fatOffset + fatCount * m_fatBytes;
+        m_rootBytes = rootSectors * sectorBytes;
+        m_heapOffset = m_rootOffset + m_rootBytes;
+        if ((m_clusterCount + 2) * static_cast<uint64_t>(m_width) / 8 > m_fatBytes) {
+            *error = corrupt(QStringLiteral("FAT smaller than the cluster count"));
+            return false;
+        }
+
+        m_root.isDirectory = true;
+        m_root.location = m_width == 32 ? le32(boot + 44) : 0;
+        if (m_width == 32 && !isDataCluster(static_cast<uint32_t>(m_root.location))) {
+            *error = corrupt(QStringLiteral("root directory cluster"));
+            return false;
+        }
+        return true;
+    }
+
+    Type type() const override { return Type::Fat; }
+
+    bool list(const Entry& dir, QVector<Entry>* out, QString* error) override
+    {
+        out->clear();
+        QByteArray data;
+        if (dir.location == 0) {
+            // FAT12/16 root: a fixed region ahead of the cluster heap.
+            data.resize(static_cast<qsizetype>(m_rootBytes));
+            if (!readAt(m_rootOffset, data.data(), static_cast<size_t>(m_rootBytes), error)) {
+                return false;
+            }
+        } else {
+            std::vector<uint32_t> clusters;
+            if (!chain(static_cast<uint32_t>(dir.location), kMaxDirectoryBytes / m_clusterBytes, &clusters, error)
+                || !readDirectory(clusters, &data, error)) {
+                return false;
+            }
+        }
+
+        QString longName;
+        int expectedOrder = 0;  // next long-name slot wanted, 0 when none is pending
+        uint8_t longChecksum = 0;
+        for (qsizetype pos = 0; pos + 32 <= data.size(); pos += 32) {
+            const char* e = data.constData() + pos;
+            const uint8_t first = byteAt(e);
+            if (first == 0x00) {
+                break;
+            }
+            const uint8_t attributes = byteAt(e + 11);
+            if (first == 0xE5) {
+                longName.clear();
+                expectedOrder = 0;
+                continue;
+            }
+            if ((attributes & 0x3F) == 0x0F) {
+                const int order = first & 0x1F;
+                if (first & 0x40) {
+                    longName = QString(order * 13, QChar(0xFFFF));
+                    longChecksum = byteAt(e + 13);
+                    expectedOrder = order;
+                }
+                if (order == 0 || order > 20 || order != expectedOrder || byteAt(e + 13) != longChecksum) {
+                    longName.clear();
+                    expectedOrder = 0;
+                    continue;
+                }
+                static constexpr int kOffsets[13] = {1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30};
+                for (int k = 0; k < 13; ++k) {
+                    longName[(order - 1) * 13 + k] = QChar(le16(e + kOffsets[k]));
+                }
+                expectedOrder = order - 1;
+                continue;
+            }
+            const bool haveLongName = expectedOrder == 0 && !longName.isEmpty();
+            const QString pendingLong = longName;
+            longName.clear();
+            expectedOrder = 0;
+            if (attributes & 0x08) {
+                continue;  // volume label
+            }
+
+            char shortName[11];
+            std::memcpy(shortName, e, 11);
+            if (byteAt(shortName) == 0x05) {
+                shortName[0] = static_cast<char>(0xE5);
+            }
+            uint8_t sum = 0;
+            for (const char c : shortName) {
+                sum = static_cast<uint8_t>(((sum & 1) << 7) + (sum >> 1) + static_cast<uint8_t>(c));
+            }
+
+            Entry entry;
+            if (haveLongName && sum == longChecksum) {
+                entry.name = pendingLong;
+                const qsizetype end = entry.name.indexOf(QChar(0));
+                if (end >= 0) {
+                    entry.name.truncate(end);
+                }
+                entry.name.remove(QChar(0xFFFF));
+            } else {
+                // Case flags written by Windows NT for all-lowercase bases and extensions.
+                const uint8_t caseFlags = byteAt(e + 12);
+                QString base = QString::fromLatin1(shortName, 8).trimmed();
+                QString extension = QString::fromLatin1(shortName + 8, 3).trimmed();
+                if (caseFlags & 0x08) {
+                    base = base.toLower();
+                }
+                if (caseFlags & 0x10) {
+                    extension = extension.toLower();
+                }
+                entry.name = extension.isEmpty() ? base : base + QLatin1Char('.') + extension;
+            }
+            if (entry.name.isEmpty() || entry.name == QLatin1String(".") || entry.name == QLatin1String("..")) {
+                continue;
+            }
+            entry.isDirectory = (attributes & 0x10) != 0;
+            entry.isRegular = !entry.isDirectory;
+            entry.location = (m_width == 32 ? static_cast<uint32_t>(le16(e + 20)) << 16 : 0) | le16(e + 26);
+            entry.size = entry.isDirectory ? 0 : le32(e + 28);
+            entry.modifiedUtc = dosDateTime(le16(e + 24), le16(e + 22), 0, nullptr);
+            if (entry.isDirectory && entry.location == 0) {
+                continue;  // a directory without clusters cannot be listed; the kernel rejects it too
+            }
+            out->append(entry);
+        }
+        return true;
+    }
+
+    bool read(const Entry& file, const ConsumeFn& consume, QString* error) override
+    {
+        std::vector<uint32_t> clusters;
+        if (file.size == 0) {
+            return true;
+        }
+        if (!clustersFor(static_cast<uint32_t>(file.location), file.size, false, &clusters, error)) {
+            return false;
+        }
+        return readClusters(clusters, file.size, file.size, true, consume, error);
+    }
+
+protected:
+    bool fatEntry(uint32_t cluster, uint32_t* value, QString* error) override
+    {
+        char raw[4] = {};
+        if (m_width == 12) {
+            const uint64_t offset = cluster + cluster / 2;
+            if (!fatBytes(offset, 2, raw, error)) {
+                return false;
+            }
+            const uint16_t pair = le16(raw);
+            *value = (cluster & 1) ? pair >> 4 : pair & 0x0FFF;
+        } else if (m_width == 16) {
+            if (!fatBytes(static_cast<uint64_t>(cluster) * 2, 2, raw, error)) {
+                return false;
+            }
+            *value = le16(raw);
+        } else {
+            if (!fatBytes(static_cast<uint64_t>(cluster) * 4, 4, raw, error)) {
+                return false;
+            }
+            *value = le32(raw) & 0x0FFFFFFF;
+        }
+        return true;
+    }
+
+    bool isEndOfChain(uint32_t value) const override
+    {
+        const uint32_t end = m_width == 12 ? 0x0FF8 : m_width == 16 ? 0xFFF8 : 0x0FFFFFF8;
+        return value >= end;
+    }
+
+private:
+    int m_width = 32;
+    uint64_t m_rootOffset = 0;
+    uint64_t m_rootBytes = 0;
+};
+
+class ExFatReader final : public ClusterVolume {
+public:
+    ExFatReader(ReadAt read, uint64_t volumeSize)
+        : ClusterVolume(std::move(read), volumeSize)
+    {
+    }
+
+    bool init(const char* boot, uint64_t volumeSize, QString* error)
+    {
+        const uint32_t sectorShift = byteAt(boot + 108);
+        const uint32_t clusterShift = byteAt(boot + 109);
+        if (sectorShift < 9 || sectorShift > 12 || sectorShift + clusterShift > 25) {
+            *error = corrupt(QStringLiteral("exFAT sector or cluster size"));
+            return false;
+        }
+        const uint64_t sectorBytes = 1ULL << sectorShift;
+        const uint64_t volumeBytes = le64(boot + 72) * sectorBytes;
+        const uint32_t fatCount = byteAt(boot + 110);
+        const bool secondFatActive = (le16(boot + 106) & 0x1) != 0;
+        m_clusterBytes = static_cast<uint32_t>(sectorBytes << clusterShift);
+        m_clusterCount = le32(boot + 92);
+        m_fatBytes = static_cast<uint64_t>(le32(boot + 84)) * sectorBytes;
+        m_fatOffset = static_cast<uint64_t>(le32(boot + 80)) * sectorBytes
+                      + (secondFatActive && fatCount == 2 ? m_fatBytes : 0);
+        m_heapOffset = static_cast<uint64_t>(le32(boot + 88)) * sectorBytes;
+        if (volumeBytes > volumeSize || fatCount == 0 || fatCount > 2
+            || (static_cast<uint64_t>(m_clusterCount) + 2) * 4 > m_fatBytes
+            || m_heapOffset + static_cast<uint64_t>(m_clusterCount) * m_clusterBytes > volumeBytes) {
+            *error = corrupt(QStringLiteral("exFAT layout exceeds the volume"));
+            return false;
+        }
+
+        m_root.isDirectory = true;
+        m_root.location = le32(boot + 96);
+        if (!isDataCluster(static_cast<uint32_t>(m_root.location))) {
+            *error = corrupt(QStringLiteral("root directory cluster"));
+            return false;
+        }
+        return true;
+    }
+
+    Type type() const override { return Type::ExFat; }
+
+    bool list(const Entry& dir, QVector<Entry>* out, QString* error) override
+    {
+        out->clear();
+        std::vector<uint32_t> clusters;
+        // The root records no length (size 0 here); its chain in the FAT is all there is.
+        const bool isRoot = dir.location == m_root.location && dir.size == 0;
+        const bool ok = isRoot
+                            ? chain(static_cast<uint32_t>(dir.location), kMaxDirectoryBytes / m_clusterBytes,
+                                    &clusters, error)
+                            : (dir.size <= kMaxDirectoryBytes
+                               && clustersFor(static_cast<uint32_t>(dir.location), dir.size, dir.contiguous,
+                                              &clusters, error));
+        if (!ok) {
+            if (error->isEmpty()) {
+                *error = corrupt(QStringLiteral("directory too large"));
+            }
+            return false;
+        }
+        QByteArray data;
+        if (!readDirectory(clusters, &data, error)) {
+            return false;
+        }
+
+        const qsizetype count = data.size() / 32;
+        for (qsizetype i = 0; i < count; ++i) {
+            const char* e = data.constData() + i * 32;
+            const uint8_t entryType = byteAt(e);
+            if (entryType == 0x00) {
+                break;
+            }
+            if (entryType != 0x85) {
+                continue;  // unused slots, bitmap, up-case table, label, GUID, ...
+            }
+            // A file entry set: File, Stream Extension, then File Name entries.
+            const int secondaries = byteAt(e + 1);
+            if (secondaries < 2 || i + secondaries >= count) {
+                continue;
+            }
+            const char* stream = e + 32;
+            if (byteAt(stream) != 0xC0) {
+                continue;
+            }
+            const int nameLength = byteAt(stream + 3);
+            QString name;
+            for (int k = 2; k <= secondaries && name.size() < nameLength; ++k) {
+                const char* part = e + k * 32;
+                if (byteAt(part) != 0xC1) {
+                    break;
+                }
+                for (int c = 0; c < 15 && name.size() < nameLength; ++c) {
+                    name.append(QChar(le16(part + 2 + c * 2)));
+                }
+            }
+            i += secondaries;
+            if (name.size() != nameLength || name.isEmpty()) {
+                continue;
+            }
+
+            Entry entry;
+            entry.name = name;
+            entry.isDirectory = (le16(e + 4) & 0x10) != 0;
+            entry.isRegular = !entry.isDirectory;
+            entry.contiguous = (byteAt(stream + 1) & 0x02) != 0;
+            entry.validLength = le64(stream + 8);
+            entry.location = le32(stream + 20);
+            entry.size = le64(stream + 24);
+            if (entry.validLength > entry.size) {
+                entry.validLength = entry.size;
+            }
+            const uint32_t stamp = le32(e + 12);
+            const uint8_t offset = byteAt(e + 23);
+            // Bit 7 marks a valid offset: a signed count of 15-minute steps ahead of UTC.
+            const int offsetMinutes = (offset & 0x40 ? static_cast<int>(offset & 0x7F) - 0x80 : offset & 0x7F) * 15;
+            entry.modifiedUtc = dosDateTime(static_cast<uint16_t>(stamp >> 16), static_cast<uint16_t>(stamp),
+                                            byteAt(e + 21) * 10, (offset & 0x80) ? &offsetMinutes : nullptr);
+            out->append(entry);
+        }
+        return true;
+    }
+
+    bool read(const Entry& file, const ConsumeFn& consume, QString* error) override
+    {
+        if (file.size == 0) {
+            return true;
+        }
+        std::vector<uint32_t> clusters;
+        if (!clustersFor(static_cast<uint32_t>(file.location), file.size, file.contiguous, &clusters, error)) {
+            return false;
+        }
+        return readClusters(clusters, file.size, file.validLength, true, consume, error);
+    }
+
+protected:
+    bool fatEntry(uint32_t cluster, uint32_t* value, QString* error) override
+    {
+        char raw[4];
+        if (!fatBytes(static_cast<uint64_t>(cluster) * 4, 4, raw, error)) {
+            return false;
+        }
+        *value = le32(raw);
+        return true;
+    }
+
+    bool isEndOfChain(uint32_t value) const override
+    {
+        return value == 0xFFFFFFFFu;
+    }
+};
+
+class ExtReader final : public RawFsReader {
+public:
+    ExtReader(ReadAt read, uint64_t volumeSize)
+        : RawFsReader(std::move(read), volumeSize)
+    {
+    }
+
+    bool init(const char* super, uint64_t volumeSize, QString* error)
+    {
+        static constexpr uint32_t kFiletype = 0x0002;
+        static constexpr uint32_t kRecover = 0x0004;
+        static constexpr uint32_t kMetaBg = 0x0010;
+        static constexpr uint32_t kExtents = 0x0040;
+        static constexpr uint32_t k64Bit = 0x0080;
+        static constexpr uint32_t kMmp = 0x0100;
+        static constexpr uint32_t kFlexBg = 0x0200;
+        static constexpr uint32_t kEaInode = 0x0400;
+        static constexpr uint32_t kCsumSeed = 0x2000;
+        static constexpr uint32_t kLargeDir = 0x4000;
+        static constexpr uint32_t kSupported =
+            kFiletype | kExtents | k64Bit | kMmp | kFlexBg | kEaInode | kCsumSeed | kLargeDir;
+
+        const uint32_t incompat = le32(super + 96);
+        if (incompat & kRecover) {
+            *error = QStringLiteral("The ext journal needs recovery, which only a mount replays");
+            return false;
+        }
+        if (incompat & ~kSupported) {
+            *error = QStringLiteral("Unsupported ext features (0x%1)%2")
+                         .arg(incompat & ~kSupported, 0, 16)
+                         .arg(incompat & kMetaBg ? QStringLiteral(": meta_bg") : QString());
+            return false;
+        }
+
+        const uint32_t logBlock = le32(super + 24);
+        if (logBlock > 6) {
+            *error = corrupt(QStringLiteral("ext block size"));
+            return false;
+        }
+        m_blockBytes = 1024u << logBlock;
+        m_blocksCount = le32(super + 4) | (incompat & k64Bit ? static_cast<uint64_t>(le32(super + 336)) << 32 : 0);
+        m_inodesCount = le32(super + 0);
+        m_inodesPerGroup = le32(super + 40);
+        m_firstDataBlock = le32(super + 20);
+        m_inodeBytes = le32(super + 76) >= 1 ? le16(super + 88) : 128;
+        m_descBytes = incompat & k64Bit ? le16(super + 254) : 32;
+        m_hasFiletype = (incompat & kFiletype) != 0;
+        m_has64Bit = (incompat & k64Bit) != 0;
+        if (m_inodesPerGroup == 0 || m_inodeBytes < 128 || m_inodeBytes > m_blockBytes
+            || !isPowerOfTwo(m_inodeBytes) || m_descBytes < 32 || m_descBytes > m_blockBytes
+            || m_blocksCount * m_blockBytes > volumeSize) {
+            *error = corrupt(QStringLiteral("ext superblock"));
+            return false;
+        }
+
+        m_root.isDirectory = true;
+        return stat(2, &m_root, error);
+    }
+
+    Type type() const override { return Type::Ext; }
+
+    bool list(const Entry& dir, QVector<Entry>* out, QString* error) override
+    {
+        out->clear();
+        if (dir.size > kMaxDirectoryBytes) {
+            *error = corrupt(QStringLiteral("directory too large"));
+            return false;
+        }
+        QByteArray data;
+        data.reserve(static_cast<qsizetype>(dir.size));
+        if (!readInode(dir, false, [&data](const char* bytes, size_t n) {
+                data.append(bytes, static_cast<qsizetype>(n));
+                return true;
+            }, error)) {
+            return false;
+        }
+
+        // Linear dirents; hash-tree directories keep theirs in the same leaf blocks.
+        for (uint64_t block = 0; block + m_blockBytes <= static_cast<uint64_t>(data.size()); block += m_blockBytes) {
+            uint32_t pos = 0;
+            while (pos + 8 <= m_blockBytes) {
+                const char* d = data.constData() + block + pos;
+                const uint32_t inode = le32(d);
+                const uint16_t recordLength = le16(d + 4);
+                const uint32_t nameLength = m_hasFiletype ? byteAt(d + 6) : le16(d + 6);
+                if (recordLength < 8 || recordLength % 4 != 0 || pos + recordLength > m_blockBytes
+                    || nameLength + 8 > recordLength) {
+                    *error = corrupt(QStringLiteral("directory entry"));
+                    return false;
+                }
+                pos += recordLength;
+                if (inode == 0 || nameLength == 0) {
+                    continue;  // free slot or checksum tail
+                }
+                const QByteArray raw(d + 8, static_cast<qsizetype>(nameLength));
+                if (raw == "." || raw == "..") {
+                    continue;
+                }
+                Entry entry;
+                entry.name = QString::fromUtf8(raw);
+                if (!stat(inode, &entry, error)) {
+                    return false;
+                }
+                out->append(entry);
+            }
+        }
+        return true;
+    }
+
+    bool read(const Entry& file, const ConsumeFn& consume, QString* error) override
+    {
+        return readInode(file, true, consume, error);
+    }
+
+private:
+    /** Logical blocks [logical, logical + count) live at @p physical; zero: a hole or unwritten. */
+    struct Run {
+        uint64_t logical = 0;
+        uint64_t physical = 0;
+        uint64_t count = 0;
+        bool zero = false;
+    };
+
+    bool readInodeRecord(uint64_t inode, QByteArray* out, QString* error)
+    {
+        if (inode == 0 || inode > m_inodesCount) {
+            *error = corrupt(QStringLiteral("inode %1 out of range").arg(inode));
+            return false;
+        }
+        const uint64_t group = (inode - 1) / m_inodesPerGroup;
+        const uint64_t index = (inode - 1) % m_inodesPerGroup;
+        uint64_t table = m_inodeTables.value(group, 0);
+        if (table == 0) {
+            const uint64_t descriptors = (static_cast<uint64_t>(m_firstDataBlock) + 1) * m_blockBytes;
+            QByteArray desc(static_cast<qsizetype>(m_descBytes), Qt::Uninitialized);
+            if (!readAt(descriptors + group * m_descBytes, desc.data(), m_descBytes, error)) {
+                return false;
+            }
+            table = le32(desc.constData() + 8);
+            if (m_has64Bit && m_descBytes >= 64) {
+                table |= static_cast<uint64_t>(le32(desc.constData() + 40)) << 32;
+            }
+            if (table == 0 || table >= m_blocksCount) {
+                *error = corrupt(QStringLiteral("inode table of group %1").arg(group));
+                return false;
+            }
+            m_inodeTables.insert(group, table);
+        }
+        out->resize(static_cast<qsizetype>(m_inodeBytes));
+        return readAt(table * m_blockBytes + index * m_inodeBytes, out->data(), m_inodeBytes, error);
+    }
+
+    static QDateTime extTime(const char* record, uint32_t inodeBytes, int secondsAt, int extraAt)
+    {
+        // Seconds are signed 32-bit; the extra field adds two epoch bits and nanoseconds.
+        int64_t seconds = static_cast<int32_t>(le32(record + secondsAt));
+        int64_t nanos = 0;
+        const uint32_t extraSize = inodeBytes > 128 ? le16(record + 128) : 0;
+        if (128 + extraSize >= static_cast<uint32_t>(extraAt) + 4) {
+            const uint32_t extra = le32(record + extraAt);
+            seconds += static_cast<int64_t>(extra & 0x3) << 32;
+            nanos = extra >> 2;
+        }
+        return QDateTime::fromMSecsSinceEpoch(seconds * 1000 + nanos / 1000000, QTimeZone::utc());
+    }
+
+    bool stat(uint64_t inode, Entry* entry, QString* error)
+    {
+        QByteArray record;
+        if (!readInodeRecord(inode, &record, error)) {
+            return false;
+        }
+        const char* r = record.constData();
+        const uint16_t mode = le16(r);
+        entry->isDirectory = (mode & 0xF000) == 0x4000;
+        entry->isRegular = (mode & 0xF000) == 0x8000;
+        entry->isSymlink = (mode & 0xF000) == 0xA000;
+        entry->size = le32(r + 4) | static_cast<uint64_t>(le32(r + 108)) << 32;
+        entry->modifiedUtc = extTime(r, m_inodeBytes, 16, 136);
+        entry->changedUtc = extTime(r, m_inodeBytes, 12, 132);
+        entry->inode = inode;
+        entry->location = inode;
+        return true;
+    }
+
+    /** Reads block @p block (absolute) into @p out. */
+    bool readBlock(uint64_t block, QByteArray* out, QString* error)
+    {
+        if (block == 0 || block >= m_blocksCount) {
+            *error = corrupt(QStringLiteral("block %1 out of range").arg(block));
+            return false;
+        }
+        out->resize(static_cast<qsizetype>(m_blockBytes));
+        return readAt(block * m_blockBytes, out->data(), m_blockBytes, error);
+    }
+
+    bool addRun(std::vector<Run>* runs, uint64_t logical, uint64_t physical, uint64_t count, bool zero,
+                uint64_t fileBlocks, QString* error)
+    {
+        if (count == 0 || logical >= fileBlocks) {
+            return true;  // preallocated past the end of the file
+        }
+        if (!zero && (physical == 0 || physical >= m_blocksCount || count > m_blocksCount - physical)) {
+            *error = corrupt(QStringLiteral("extent outside the volume"));
+            return false;
+        }
+        if (runs->size() > fileBlocks) {
+            *error = corrupt(QStringLiteral("block map larger than the file"));
+            return false;
+        }
+        Run* last = runs->empty() ? nullptr : &runs->back();
+        if (last && !zero && !last->zero && last->logical + last->count == logical
+            && last->physical + last->count == physical) {
+            last->count += count;
+        } else {
+            runs->push_back({logical, physical, count, zero});
+        }
+        return true;
+    }
+
+    bool mapExtents(const char* node, size_t length, int depth, uint64_t fileBlocks, std::vector<Run>* runs,
+                    QString* error)
+    {
+        if (length < 12 || le16(node) != 0xF30A || depth > kMaxMapDepth) {
+            *error = corrupt(QStringLiteral("extent tree"));
+            return false;
+        }
+        const uint16_t entries = le16(node + 2);
+        const uint16_t nodeDepth = le16(node + 6);
+        if (12 + static_cast<size_t>(entries) * 12 > length || (depth > 0 && nodeDepth + 1 != depth)) {
+            *error = corrupt(QStringLiteral("extent tree"));
+            return false;
+        }
+        for (uint16_t i = 0; i < entries; ++i) {
+            const char* e = node + 12 + i * 12;
+            const uint32_t logical = le32(e);
+            if (nodeDepth == 0) {
+                uint32_t count = le16(e + 4);
+                const bool unwritten = count > 32768;
+                if (unwritten) {
+                    count -= 32768;
+                }
+                const uint64_t physical = le32(e + 8) | static_cast<uint64_t>(le16(e + 6)) << 32;
+                if (!addRun(runs, logical, physical, count, unwritten, fileBlocks, error)) {
+                    return false;
+                }
+            } else {
+                const uint64_t child = le32(e + 4) | static_cast<uint64_t>(le16(e + 8)) << 32;
+                QByteArray block;
+                if (!readBlock(child, &block, error)
+                    || !mapExtents(block.constData(), m_blockBytes, nodeDepth, fileBlocks, runs, error)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /** ext2/3 block map: direct pointers, then single, double and triple indirect blocks. */
+    bool mapIndirect(uint64_t pointer, int level, uint64_t* logical, uint64_t fileBlocks, std::vector<Run>* runs,
+                     QString* error)
+    {
+        const uint64_t span = [&] {
+            uint64_t s = 1;
+            for (int i = 0; i < level; ++i) {
+                s *= m_blockBytes / 4;
+            }
+            return s;
+        }();
+        if (*logical >= fileBlocks) {
+            return true;
+        }
+        if (pointer == 0) {
+            *logical += span;  // a hole; reads as zeros
+            return true;
+        }
+        if (level == 0) {
+            const bool ok = addRun(runs, *logical, pointer, 1, false, fileBlocks, error);
+            ++*logical;
+            return ok;
+        }
+        QByteArray block;
+        if (!readBlock(pointer, &block, error)) {
+            return false;
+        }
+        for (uint32_t i = 0; i < m_blockBytes / 4 && *logical < fileBlocks; ++i) {
+            if (!mapIndirect(le32(block.constData() + i * 4), level - 1, logical, fileBlocks, runs, error)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** @p content: file data, not a directory. */
+    bool readInode(const Entry& file, bool content, const ConsumeFn& consume, QString* error)
+    {
+        QByteArray record;
+        if (!readInodeRecord(file.location, &record, error)) {
+            return false;
+        }
+        const char* r = record.constData();
+        const uint32_t flags = le32(r + 32);
+        const uint64_t size = le32(r + 4) | static_cast<uint64_t>(le32(r + 108)) << 32;
+        if (flags & 0x10000000) {
+            *error = QStringLiteral("Inline data is not supported");
+            return false;
+        }
+        if (size == 0) {
+            return true;
+        }
+        const uint64_t fileBlocks = (size + m_blockBytes - 1) / m_blockBytes;
+        std::vector<Run> runs;
+        if (flags & 0x80000) {
+            if (!mapExtents(r + 40, 60, 0, fileBlocks, &runs, error)) {
+                return false;
+            }
+        } else {
+            uint64_t logical = 0;
+            for (int i = 0; i < 12; ++i) {
+                if (!mapIndirect(le32(r + 40 + i * 4), 0, &logical, fileBlocks, &runs, error)) {
+                    return false;
+                }
+            }
+            for (int level = 1; level <= 3; ++level) {
+                if (!mapIndirect(le32(r + 40 + (11 + level) * 4), level, &logical, fileBlocks, &runs, error)) {
+                    return false;
+                }
+            }
+        }
+        std::sort(runs.begin(), runs.end(), [](const Run& a, const Run& b) { return a.logical < b.logical; });
+
+        QByteArray buffer;
+        uint64_t position = 0;  // bytes handed out
+        size_t next = 0;
+        const uint64_t chunkBlocks = std::max<uint64_t>(1, kReadChunkBytes / m_blockBytes);
+        while (position < size) {
+            const uint64_t logical = position / m_blockBytes;
+            while (next < runs.size() && runs[next].logical + runs[next].count <= logical) {
+                ++next;
+            }
+            uint64_t blocks = 0;
+            uint64_t physical = 0;
+            bool zero = true;
+            if (next < runs.size() && runs[next].logical <= logical) {
+                const Run& run = runs[next];
+                blocks = std::min(run.logical + run.count - logical, chunkBlocks);
+                physical = run.physical + (logical - run.logical);
+                zero = run.zero;
+            } else {
+                const uint64_t holeEnd = next < runs.size() ? runs[next].logical : fileBlocks;
+                blocks = std::min(holeEnd - logical, chunkBlocks);
+            }
+            const size_t bytes = static_cast<size_t>(std::min<uint64_t>(blocks * m_blockBytes, size - position));
+            buffer.resize(static_cast<qsizetype>(bytes));
+            if (zero) {
+                std::memset(buffer.data(), 0, bytes);
+            } else if (!(content ? readContentAt(physical * m_blockBytes, buffer.data(), bytes, error)
+                                 : readAt(physical * m_blockBytes, buffer.data(), bytes, error))) {
+                return false;
+            }
+            if (!consume(buffer.constData(), bytes)) {
+                return false;
+            }
+            position += bytes;
+        }
+        return true;
+    }
+
+    uint32_t m_blockBytes = 1024;
+    uint64_t m_blocksCount = 0;
+    uint32_t m_inodesCount = 0;
+    uint32_t m_inodesPerGroup = 0;
+    uint32_t m_firstDataBlock = 0;
+    uint32_t m_inodeBytes = 128;
+    uint32_t m_descBytes = 32;
+    bool m_hasFiletype = false;
+    bool m_has64Bit = false;
+    QHash<uint64_t, uint64_t> m_inodeTables;  // group -> first block of its inode table
+};
+
+} // namespace
+
+RawFsReader::RawFsReader(ReadAt read, uint64_t volumeSize)
+    : m_read(std::move(read))
+    , m_volumeSize(volumeSize)
+{
+}
+
+bool RawFsReader::readAt(uint64_t offset, char* data, size_t length, QString* error) const
+{
+    if (offset > m_volumeSize || length > m_volumeSize - offset) {
+        *error = corrupt(QStringLiteral("read past the end of the volume"));
+        return false;
+    }
+    return m_read(offset, data, length, error);
+}
+
+bool RawFsReader::readContentAt(uint64_t offset, char* data, size_t length, QString* error) const
+{
+    if (!m_contentRead) {
+        return readAt(offset, data, length, error);
+    }
+    if (offset > m_volumeSize || length > m_volumeSize - offset) {
+        *error = corrupt(QStringLiteral("read past the end of the volume"));
+        return false;
+    }
+    return m_contentRead(offset, data, length, error);
+}
+
+QString RawFsReader::typeName(Type type)
+{
+    switch (type) {
+        case Type::Fat: return QStringLiteral("FAT");
+        case Type::ExFat: return QStringLiteral("exFAT");
+        case Type::Ext: return QStringLiteral("ext");
+    }
+    return QStringLiteral("FAT");
+}
+
+std::unique_ptr<RawFsReader> RawFsReader::open(ReadAt read, uint64_t volumeSize, QString* error)
+{
+    // The FAT/exFAT boot sector and the ext superblock (at 1024) are all in the first 4 KiB.
+    static constexpr size_t kProbeBytes = 4096;
+    if (volumeSize < kProbeBytes) {
+        *error = QStringLiteral("Volume too small");
+        return nullptr;
+    }
+    QByteArray probe(kProbeBytes, Qt::Uninitialized);
+    if (!read(0, probe.data(), kProbeBytes, error)) {
+        return nullptr;
+    }
+    const char* p = probe.constData();
+
+    if (le16(p + 1024 + 56) == 0xEF53) {
+        auto reader = std::make_unique<ExtReader>(std::move(read), volumeSize);
+        return reader->init(p + 1024, volumeSize, error) ? std::move(reader) : nullptr;
+    }
+    if (std::memcmp(p + 3, "EXFAT   ", 8) == 0) {
+        auto reader = std::make_unique<ExFatReader>(std::move(read), volumeSize);
+        return reader->init(p, volumeSize, error) ? std::move(reader) : nullptr;
+    }
+    if (byteAt(p + 510) == 0x55 && byteAt(p + 511) == 0xAA && (byteAt(p) == 0xEB || byteAt(p) == 0xE9)) {
+        auto reader = std::make_unique<FatReader>(std::move(read), volumeSize);
+        return reader->init(p, volumeSize, error) ? std::move(reader) : nullptr;
+    }
+    *error = QStringLiteral("No FAT, exFAT or ext file system found");
+    return nullptr;
+}
+
+bool RawFsReader::lookup(const QString& relativePath, Entry* out, QString* error)
+{
+    error->clear();
+    Entry current = m_root;
+    const QStringList parts = relativePath.split(QLatin1Char('/'), Qt::SkipEmptyParts);
+    const Qt::CaseSensitivity cs = caseSensitive() ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    for (const QString& part : parts) {
+        if (current.isSymlink) {
+            *error = QStringLiteral("Symbolic link in path (mount to resolve it): %1").arg(relativePath);
+            return false;
+        }
+        if (!current.isDirectory) {
+            return false;
+        }
+        QVector<Entry> entries;
+        if (!list(current, &entries, error)) {
+            return false;
+        }
+        const auto it = std::find_if(entries.cbegin(), entries.cend(), [&](const Entry& e) {
+            return e.name.compare(part, cs) == 0;
+        });
+        if (it == entries.cend()) {
+            return false;
+        }
+        current = *it;
+    }
+    *out = current;
+    return true;
+}
+
+#ifndef Q_OS_WIN
+RawFsReader::ReadAt RawFsReader::descriptorReader(int fd)
+{
+    struct Bounce {
+        char* data = nullptr;
+        size_t capacity = 0;
+        ~Bounce() { std::free(data); }
+    };
+    static constexpr uint64_t kAlignment = 4096;
+    auto bounce = std::make_shared<Bounce>();
+    return [fd, bounce](uint64_t offset, char* data, size_t length, QString* error) {
+        const uint64_t start = offset - offset % kAlignment;
+        const uint64_t end = (offset + length + kAlignment - 1) / kAlignment * kAlignment;
+        const size_t span = static_cast<size_t>(end - start);
+        if (span > bounce->capacity) {
+            void* grown = nullptr;
+            if (posix_memalign(&grown, kAlignment, span) != 0) {
+                *error = QStringLiteral("Failed to allocate buffer");
+                return false;
+            }
+            std::free(bounce->data);
+            bounce->data = static_cast<char*>(grown);
+            bounce->capacity = span;
+        }
+        const size_t needed = static_cast<size_t>(offset - start) + length;
+        size_t got = 0;
+        while (got < needed) {
+            const ssize_t n = ::pread(fd, bounce->data + got, span - got, static_cast<off_t>(start + got));
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                *error = QStringLiteral("Read error: %1").arg(QString::fromLocal8Bit(std::strerror(errno)));
+                return false;
+            }
+            if (n == 0) {
+                *error = QStringLiteral("Unexpected EOF");
+                return false;
+            }
+            got += static_cast<size_t>(n);
+        }
+        std::memcpy(data, bounce->data + (offset - start), length);
+        return true;
+    };
+}
+#endif
+
+} // namespace FlashSpartan
@@ -0,0 +1,113 @@
+#include "ReadHealth.h"
+
+#include <algorithm>
+
+namespace FlashSpartan {
+
+QString readAnomalyName(ReadAnomaly anomaly)
+{
+    switch (anomaly) {
+        case ReadAnomaly::SpeedCollapse: return QStringLiteral("speed collapse");
+        case ReadAnomaly::InJobSlowdown: return QStringLiteral("slowdown during read");
+        case ReadAnomaly::BlockLatencySpike: return QStringLiteral("block latency spike");
+    }
+    return {};
+}
+
+namespace ReadHealth {
+
+bool isAssessable(const HashResult& result)
+{
+    return result.success && result.stoppedAtBlock < 0 && result.durationMs >= kMinDurationMs
+           && !result.performance.isEmpty()
+           && result.performance.engine != QLatin1String("quick_sample");
+}
+
+double baselineMBps(const ReadProfile& profile)
+{
+    if (profile.recentMBps.isEmpty()) {
+        return 0.0;
+    }
+    QList<double> sorted = profile.recentMBps;
+    std::sort(sorted.begin(), sorted.end());
+    const qsizetype mid = sorted.size() / 2;
+    return sorted.size() % 2 ? sorted.at(mid) : (sorted.at(mid - 1) + sorted.at(mid)) / 2.0;
+}
+
+QList<ReadFinding> assess(const ReadProfile& profile, const HashResult& result)
+{
+    QList<ReadFinding> findings;
+    if (!isAssessable(result)) {
+        return findings;
+    }
+    const HashPerformance& perf = result.performance;
+
+    const bool sameSetup = profile.engine == perf.engine && profile.elevated == perf.elevated;
+    const double baseline = baselineMBps(profile);
+    if (sameSetup && profile.recentMBps.size() >= kMinProfileReads && baseline > 0.0
+        && perf.avgMBps < kCollapseFraction * baseline) {
+        findings.append({ReadAnomaly::SpeedCollapse,
+                         QStringLiteral("Read at %1 MB/s, against a median of %2 MB/s over its last %3 reads")
+                             .arg(perf.avgMBps, 0, 'f', 1)
+                             .arg(baseline, 0, 'f', 1)
+                             .arg(profile.recentMBps.size())});
+    }
+
+    if (perf.minMBps > 0.0 && perf.minMBps < kSlowdownFraction * perf.avgMBps) {
+        findings.append({ReadAnomaly::InJobSlowdown,
+                         QStringLiteral("Slowest second read at %1 MB/s, against %2 MB/s on average")
+                             .arg(perf.minMBps, 0, 'f', 1)
+                             .arg(perf.avgMBps, 0, 'f', 1)});
+    }
+
+    if (perf.slowestBlock >= 0 && perf.timedBlocks >= kMinTimedBlocks && perf.blockMsMax >= kSpikeMinMs
+        && static_cast<double>(perf.blockMsMax) > kSpikeRatio * static_cast<double>(qMax<uint64_t>(1, perf.blockMsMedian))) {
+        const double offsetGiB = static_cast<double>(static_cast<uint64_t>(perf.slowestBlock) * result.blockSize)
+                                 / (1024.0 * 1024.0 * 1024.0);
+        findings.append({ReadAnomaly::BlockLatencySpike,
+                         QStringLiteral("Block %1 (at %2 GiB) took %3 ms, against a median of %4 ms")
+                             .arg(perf.slowestBlock)
+                             .arg(offsetGiB, 0, 'f', 2)
+                             .arg(perf.blockMsMax)
+                             .arg(perf.blockMsMedian)});
+    }
+    return findings;
+}
+
+ReadProfile advance(ReadProfile profile, const HashResult& result, const QList<ReadFinding>& findings)
+{
+    if (!isAssessable(result)) {
+        return profile;
+    }
+    const HashPerformance& perf = result.performance;
+    if (profile.engine != perf.engine || profile.elevated != perf.elevated) {
+        profile.engine = perf.engine;
+        profile.elevated = perf.elevated;
+        profile.recentMBps.clear();
+        profile.worstBlockRatio = 0.0;
+    }
+
+    // A collapsed read stays out of the window, so one bad read cannot become the new normal.
+    const bool collapsed = std::any_of(findings.cbegin(), findings.cend(), [](const ReadFinding& f) {
+        return f.kind == ReadAnomaly::SpeedCollapse;
+    });
+    if (!collapsed && perf.avgMBps > 0.0) {
+        profile.recentMBps.append(perf.avgMBps);
+        while (profile.recentMBps.size() > ReadProfile::kWindow) {
+            profile.recentMBps.removeFirst();
+        }
+    }
+    if (perf.slowestBlock >= 0 && perf.blockMsMedian > 0) {
+        profile.worstBlockRatio = qMax(profile.worstBlockRatio, static_cast<double>(perf.blockMsMax)
+                                                                    / static_cast<double>(perf.blockMsMedian));
+    }
+    if (!findings.isEmpty()) {
+        profile.anomalies += static_cast<int>(findings.size());
+        profile.lastAnomaly = QDateTime::currentDateTimeUtc();
+    }
+    return profile;
+}
+
+} // namespace ReadHealth
+
+} // namespace FlashSpartan
@@ -0,0 +1,89 @@
+#include "RecordTableModel.h"
+
+namespace FlashSpartan {
+
+namespace {
+
+/** Older pages pulled in one fetchMore() while a filter matches none of them. */
+constexpr int kMaxOlderPagesPerFetch = 16;
+
+} // namespace
+
+RecordTableModelBase::RecordTableModelBase(const QStringList& headers, QObject* parent)
+    : QAbstractTableModel(parent), m_headers(headers)
+{
+}
+
+int RecordTableModelBase::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : m_fetched;
+}
+
+int RecordTableModelBase::columnCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : int(m_headers.size());
+}
+
+QVariant RecordTableModelBase::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole || section < 0 || section >= m_headers.size()) {
+        return {};
+    }
+    return m_headers.at(section);
+}
+
+bool RecordTableModelBase::canFetchMore(const QModelIndex& parent) const
+{
+    return !parent.isValid() && (m_fetched < m_visible.size() || canFetchOlder());
+}
+
+void RecordTableModelBase::fetchMore(const QModelIndex& parent)
+{
+    if (parent.isValid()) {
+        return;
+    }
+    for (int page = 0; m_fetched >= m_visible.size() && canFetchOlder() && page < kMaxOlderPagesPerFetch; ++page) {
+        fetchOlder(kFetchBatch);
+    }
+    const int more = qMin(kFetchBatch, int(m_visible.size()) - m_fetched);
+    if (more <= 0) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), m_fetched, m_fetched + more - 1);
+    m_fetched += more;
+    endInsertRows();
+}
+
+void RecordTableModelBase::resetVisible(QList<int> visible)
+{
+    beginResetModel();
+    m_visible = std::move(visible);
+    m_fetched = qMin(kFetchBatch, int(m_visible.size()));
+    endResetModel();
+    emit rowsReplaced();
+}
+
+void RecordTableModelBase::insertNewest(const QList<int>& indexes)
+{
+    if (indexes.isEmpty()) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), 0, int(indexes.size()) - 1);
+    m_visible.append(indexes);
+    m_fetched += int(indexes.size());
+    endInsertRows();
+}
+
+void RecordTableModelBase::insertOldest(const QList<int>& indexes, int count)
+{
+    // Rows below m_fetched keep their records, so the view needs no signal for this.
+    QList<int> visible;
+    visible.reserve(indexes.size() + m_visible.size());
+    visible.append(indexes);
+    for (int index : std::as_const(m_visible)) {
+        visible.append(index + count);
+    }
+    m_visible = std::move(visible);
+}
+
+} // namespace FlashSpartan
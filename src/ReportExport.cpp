@@ -0,0 +1,307 @@
+#include "ReportExport.h"
+#include "AuditLogIndex.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr int kProgressEveryRows = 256;
+
+QString timeText(const QDateTime& time)
+{
+    return time.toString(Qt::ISODate);
+}
+
+QString csvField(const QString& value)
+{
+    if (!value.contains(QLatin1Char(',')) && !value.contains(QLatin1Char('"'))
+        && !value.contains(QLatin1Char('\n')) && !value.contains(QLatin1Char('\r'))) {
+        return value;
+    }
+    QString quoted = value;
+    return QLatin1Char('"') + quoted.replace(QLatin1Char('"'), QStringLiteral("\"\"")) + QLatin1Char('"');
+}
+
+/** Formats rows as they come; nothing but the current row is kept. */
+class RowWriter {
+public:
+    RowWriter(QSaveFile* out, ReportExport::Format format, const QStringList& columns, const QString& title)
+        : m_out(out)
+        , m_format(format)
+    {
+        switch (m_format) {
+            case ReportExport::Format::Csv: {
+                QStringList header;
+                for (const QString& c : columns) {
+                    header.append(csvField(c));
+                }
+                write(header.join(QLatin1Char(',')) + QStringLiteral("\r\n"));
+                break;
+            }
+            case ReportExport::Format::Html: {
+                QString html = QStringLiteral(
+                    "<!DOCTYPE html><html><head><meta charset=\"utf-8\"><title>%1</title>"
+                    "<style>body{font-family:sans-serif}table{border-collapse:collapse;width:100%}"
+                    "td,th{border:1px solid #ccc;padding:6px}tr.fail{background:#fdd}</style></head>"
+                    "<body><h1>%1</h1><table><tr>")
+                                   .arg(title.toHtmlEscaped());
+                for (const QString& c : columns) {
+                    html += QStringLiteral("<th>%1</th>").arg(c.toHtmlEscaped());
+                }
+                write(html + QStringLiteral("</tr>\n"));
+                break;
+            }
+            case ReportExport::Format::Ndjson:
+                break;
+        }
+    }
+
+    /** @p json is the NDJSON line, without its newline; @p flagged marks the row in HTML. */
+    void row(const QStringList& cells, const QByteArray& json, bool flagged)
+    {
+        switch (m_format) {
+            case ReportExport::Format::Csv: {
+                QStringList fields;
+                for (const QString& c : cells) {
+                    fields.append(csvField(c));
+                }
+                write(fields.join(QLatin1Char(',')) + QStringLiteral("\r\n"));
+                break;
+            }
+            case ReportExport::Format::Html: {
+                QString html = flagged ? QStringLiteral("<tr class=\"fail\">") : QStringLiteral("<tr>");
+                for (const QString& c : cells) {
+                    html += QStringLiteral("<td>%1</td>").arg(c.toHtmlEscaped());
+                }
+                write(html + QStringLiteral("</tr>\n"));
+                break;
+            }
+            case ReportExport::Format::Ndjson:
+                m_ok = m_ok && m_out->write(json + '\n') == json.size() + 1;
+                break;
+        }
+    }
+
+    void finish()
+    {
+        if (m_format == ReportExport::Format::Html) {
+            write(QStringLiteral("</table></body></html>\n"));
+        }
+    }
+
+    bool ok() const { return m_ok; }
+
+private:
+    void write(const QString& text)
+    {
+        const QByteArray bytes = text.toUtf8();
+        m_ok = m_ok && m_out->write(bytes) == bytes.size();
+    }
+
+    QSaveFile* m_out;
+    ReportExport::Format m_format;
+    bool m_ok = true;
+};
+
+bool containsText(const QString& needle, std::initializer_list<const QString*> fields)
+{
+    for (const QString* f : fields) {
+        if (f->contains(needle, Qt::CaseInsensitive)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+ReportExport::Format ReportExport::formatForPath(const QString& path)
+{
+    if (path.endsWith(QStringLiteral(".ndjson"), Qt::CaseInsensitive)
+        || path.endsWith(QStringLiteral(".jsonl"), Qt::CaseInsensitive)) {
+        return Format::Ndjson;
+    }
+    if (path.endsWith(QStringLiteral(".html"), Qt::CaseInsensitive)
+        || path.endsWith(QStringLiteral(".htm"), Qt::CaseInsensitive)) {
+        return Format::Html;
+    }
+    return Format::Csv;
+}
+
+QString ReportExport::kindLabel(VerifyHistoryKind kind)
+{
+    switch (kind) {
+        case VerifyHistoryKind::IsoScan:
+            return QStringLiteral("ISO");
+        case VerifyHistoryKind::Manifest:
+            return QStringLiteral("Watch");
+        case VerifyHistoryKind::Hash:
+        default:
+            return QStringLiteral("Hash");
+    }
+}
+
+std::optional<AuditLogRow> ReportExport::auditRow(const QByteArray& line, const QString& path, bool policyFormat)
+{
+    const QJsonDocument doc = QJsonDocument::fromJson(line);
+    if (!doc.isObject()) {
+        return std::nullopt;
+    }
+    const QJsonObject o = doc.object();
+    AuditLogRow row;
+    row.time = QDateTime::fromString(o.value(QStringLiteral("ts")).toString(), Qt::ISODate);
+    if (!row.time.isValid()) {
+        row.time = QDateTime::currentDateTime();
+    }
+    row.source = path;
+
+    if (policyFormat) {
+        row.category = o.value(QStringLiteral("actor")).toString();
+        row.event = o.value(QStringLiteral("action")).toString();
+        row.detail = o.value(QStringLiteral("target")).toString();
+        row.source = o.value(QStringLiteral("detail")).toString();
+    } else {
+        row.event = o.value(QStringLiteral("event")).toString();
+        if (row.event == QLatin1String("iso_verify")) {
+            row.category = QStringLiteral("ISO");
+            row.detail = o.value(QStringLiteral("path")).toString();
+            if (row.detail.isEmpty()) {
+                row.detail = o.value(QStringLiteral("device")).toString();
+            }
+        } else if (row.event == QLatin1String("badusb_anomaly")) {
+            row.category = QStringLiteral("BadUSB");
+            row.detail = o.value(QStringLiteral("summary")).toString();
+        } else {
+            row.category = QStringLiteral("System");
+            row.detail = o.value(QStringLiteral("detail")).toString();
+        }
+    }
+    return row;
+}
+
+ReportExport::Result ReportExport::run(const Request& request, const ProgressFn& progress,
+                                       const std::atomic<bool>* cancelled)
+{
+    Result result;
+    QSaveFile out(request.outputPath);
+    if (!out.open(QIODevice::WriteOnly)) {
+        result.errorMessage = QStringLiteral("Cannot write %1: %2").arg(request.outputPath, out.errorString());
+        return result;
+    }
+
+    const Filter& filter = request.filter;
+    const bool policy = request.source == Source::PolicyAudit;
+    QStringList columns;
+    QString title;
+    if (request.source == Source::Verification) {
+        columns = {QStringLiteral("Time"), QStringLiteral("Device"), QStringLiteral("Node"),
+                   QStringLiteral("Type"), QStringLiteral("Status"), QStringLiteral("Summary"),
+                   QStringLiteral("Detail"), QStringLiteral("Duration (s)")};
+        title = QStringLiteral("FlashSpartan verification history");
+    } else if (policy) {
+        columns = {QStringLiteral("Time"), QStringLiteral("Actor"), QStringLiteral("Action"),
+                   QStringLiteral("Target"), QStringLiteral("Detail")};
+        title = QStringLiteral("FlashSpartan policy audit");
+    } else {
+        columns = {QStringLiteral("Time"), QStringLiteral("Category"), QStringLiteral("Event"),
+                   QStringLiteral("Detail")};
+        title = QStringLiteral("FlashSpartan verification audit");
+    }
+    RowWriter writer(&out, request.format, columns, title);
+
+    qint64 visited = 0;
+    bool stopped = false;
+    // Shared by both sources: false ends the read.
+    auto step = [&](double done) {
+        if (!writer.ok() || (cancelled && cancelled->load())) {
+            stopped = true;
+            return false;
+        }
+        if (progress && ++visited % kProgressEveryRows == 0) {
+            progress(result.rows, done);
+        }
+        return true;
+    };
+
+    bool readable = true;
+    if (request.source == Source::Verification) {
+        const qint64 to = filter.to.isValid() ? filter.to.toMSecsSinceEpoch() : 0;
+        bool pastRange = false;
+        readable = VerifyHistory::scan(request.sourcePath, [&](const VerifyHistoryEntry& e, double done) {
+            if (!step(done)) {
+                return false;
+            }
+            if (to && e.timestamp.toMSecsSinceEpoch() > to) {
+                pastRange = true;  // appended in time order: the rest is later still
+                return false;
+            }
+            if ((filter.from.isValid() && e.timestamp < filter.from)
+                || (!filter.device.isEmpty() && e.deviceNode != filter.device)
+                || (!filter.status.isEmpty() && e.status.compare(filter.status, Qt::CaseInsensitive) != 0)
+                || (!filter.text.isEmpty()
+                    && !containsText(filter.text, {&e.deviceNode, &e.deviceLabel, &e.summary, &e.detail}))) {
+                return true;
+            }
+            writer.row({timeText(e.timestamp), e.deviceLabel, e.deviceNode, kindLabel(e.kind), e.status,
+                        e.summary, e.detail,
+                        e.durationMs > 0 ? QString::number(e.durationMs / 1000.0, 'f', 1) : QString()},
+                       QJsonDocument(VerifyHistory::toJson(e)).toJson(QJsonDocument::Compact),
+                       e.status.compare(QLatin1String("pass"), Qt::CaseInsensitive) != 0);
+            ++result.rows;
+            return true;
+        }) || pastRange;
+    } else {
+        AuditLogIndex::Query query;
+        query.from = filter.from;
+        query.to = filter.to;
+        query.device = filter.device;
+        AuditLogIndex::forEach(request.sourcePath, query, [&](const QByteArray& line, double done) {
+            if (!step(done)) {
+                return false;
+            }
+            const std::optional<AuditLogRow> row = auditRow(line, request.sourcePath, policy);
+            if (!row) {
+                return true;
+            }
+            if (!filter.text.isEmpty()
+                && !containsText(filter.text, {&row->category, &row->event, &row->detail, &row->source})) {
+                return true;
+            }
+            QStringList cells{timeText(row->time), row->category, row->event, row->detail};
+            if (policy) {
+                cells.append(row->source);
+            }
+            writer.row(cells, line, false);
+            ++result.rows;
+            return true;
+        });
+    }
+
+    if (cancelled && cancelled->load()) {
+        out.cancelWriting();
+        result.cancelled = true;
+        result.errorMessage = QStringLiteral("Cancelled");
+        return result;
+    }
+    if (!readable && !stopped) {
+        out.cancelWriting();
+        result.errorMessage = QStringLiteral("Cannot read %1").arg(request.sourcePath);
+        return result;
+    }
+    writer.finish();
+    if (!writer.ok() || !out.commit()) {
+        result.errorMessage = QStringLiteral("Cannot write %1: %2").arg(request.outputPath, out.errorString());
+        return result;
+    }
+    if (progress) {
+        progress(result.rows, 1.0);
+    }
+    result.success = true;
+    return result;
+}
+
+} // namespace FlashSpartan
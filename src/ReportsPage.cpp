@@ -3,16 +3,17 @@
 
 #include <QComboBox>
 #include <QDesktopServices>
+#include <QFileDialog>
 #include <QFileInfo>
 #include <QHBoxLayout>
 #include <QHeaderView>
 #include <QLabel>
 #include <QLineEdit>
+#include <QProgressBar>
 #include <QPushButton>
 #include <QScrollArea>
 #include <QTabWidget>
-#include <QTableWidget>
-#include <QTableWidgetItem>
+#include <QTableView>
 #include <QUrl>
 #include <QVBoxLayout>
 
@@ -20,24 +21,68 @@ namespace FlashSpartan {
 
 namespace {
 
-QTableWidgetItem* readOnlyItem(const QString& text)
+QString timeText(const QDateTime& time)
 {
-    auto* item = new QTableWidgetItem(text);
-    item->setFlags(item->flags() & ~Qt::ItemIsEditable);
-    return item;
+    return time.toString(QStringLiteral("yyyy-MM-dd hh:mm:ss"));
 }
 
-QString verifyKindLabel(VerifyHistoryKind kind)
+QVariant verifyCell(const VerifyHistoryEntry& e, int column, int role)
 {
-    switch (kind) {
-        case VerifyHistoryKind::IsoScan:
-            return QStringLiteral("ISO");
-        case VerifyHistoryKind::Manifest:
-            return QStringLiteral("Watch");
-        case VerifyHistoryKind::Hash:
+    if (role != Qt::DisplayRole) {
+        if (role != Qt::ToolTipRole) {
+            return {};
+        }
+        if (column == 4 && !e.detail.isEmpty()) {
+            return e.detail;
+        }
+        if (column == 5 && !e.performance.isEmpty()) {
+            return e.performance.summary();
+        }
+        return {};
+    }
+    switch (column) {
+        case 0:
+            return timeText(e.timestamp);
+        case 1:
+            return e.deviceLabel.isEmpty() ? e.deviceNode : e.deviceLabel;
+        case 2:
+            return ReportExport::kindLabel(e.kind);
+        case 3:
+            return e.status;
+        case 4:
+            return e.summary;
+        case 5:
+            return e.durationMs > 0 ? QStringLiteral("%1 s").arg(e.durationMs / 1000.0, 0, 'f', 1) : QString();
+        default:
+            return {};
+    }
+}
+
+QVariant auditCell(const AuditLogRow& r, int column, int role)
+{
+    if (role != Qt::DisplayRole) {
+        return {};
+    }
+    switch (column) {
+        case 0:
+            return timeText(r.time);
+        case 1:
+            return r.category;
+        case 2:
+            return r.event;
+        case 3:
+            return r.detail;
         default:
-            return QStringLiteral("Hash");
+            return {};
+    }
+}
+
+QVariant policyAuditCell(const AuditLogRow& r, int column, int role)
+{
+    if (role == Qt::DisplayRole && column == 4) {
+        return r.source.isEmpty() ? QStringLiteral("—") : r.source;
     }
+    return auditCell(r, column, role);
 }
 
 } // namespace
@@ -85,8 +130,41 @@ void ReportsPage::setupUi()
     actions->addWidget(openAuditBtn);
     actions->addWidget(openPolicyBtn);
     actions->addStretch();
+    m_exportRange = new QComboBox;
+    m_exportRange->addItem(QStringLiteral("All time"), 0);
+    m_exportRange->addItem(QStringLiteral("Last 30 days"), 30);
+    m_exportRange->addItem(QStringLiteral("Last 90 days"), 90);
+    m_exportRange->addItem(QStringLiteral("Last 365 days"), 365);
+    m_exportButton = new QPushButton(QStringLiteral("Export…"));
+    m_exportButton->setToolTip(QStringLiteral(
+        "Write the current tab to CSV, NDJSON or HTML. Reads the full history in the background; "
+        "the Verification tab's status and search filters apply."));
+    connect(m_exportButton, &QPushButton::clicked, this, &ReportsPage::onExportClicked);
+    m_exportCancel = new QPushButton(QStringLiteral("Cancel"));
+    m_exportCancel->setVisible(false);
+    connect(m_exportCancel, &QPushButton::clicked, this, &ReportsPage::exportCancelRequested);
+    actions->addWidget(m_exportRange);
+    actions->addWidget(m_exportButton);
+    actions->addWidget(m_exportCancel);
     layout->addLayout(actions);
 
+    auto* exportRow = new QHBoxLayout;
+    m_exportProgress = new QProgressBar;
+    m_exportProgress->setRange(0, 1000);
+    m_exportProgress->setTextVisible(false);
+    m_exportProgress->setVisible(false);
+    m_exportStatus = new QLabel;
+    m_exportStatus->setStyleSheet(QString("color: %1; font-size: 9pt;")
+                                      .arg(FSStyle.colorCss(StyleManager::ColorRole::TextMuted)));
+    exportRow->addWidget(m_exportProgress, 1);
+    exportRow->addWidget(m_exportStatus, 2);
+    layout->addLayout(exportRow);
+
+    m_summaryLabel = new QLabel;
+    m_summaryLabel->setStyleSheet(QString("color: %1; font-weight: 600;")
+                                      .arg(FSStyle.colorCss(StyleManager::ColorRole::AccentPrimary)));
+    layout->addWidget(m_summaryLabel);
+
     m_auditPathLabel = new QLabel;
     m_policyPathLabel = new QLabel;
     for (QLabel* lb : {m_auditPathLabel, m_policyPathLabel}) {
@@ -118,47 +196,38 @@ void ReportsPage::setupUi()
     verifyToolbar->addWidget(m_verifySearch, 1);
     verifyLay->addLayout(verifyToolbar);
 
-    m_verifyTable = new QTableWidget(0, 6);
-    m_verifyTable->setHorizontalHeaderLabels({
+    m_verifyModel = new VerifyModel({
         QStringLiteral("Time"),
         QStringLiteral("Device"),
         QStringLiteral("Type"),
         QStringLiteral("Status"),
         QStringLiteral("Summary"),
         QStringLiteral("Duration"),
-    });
-    m_verifyTable->verticalHeader()->setVisible(false);
-    m_verifyTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
-    m_verifyTable->setAlternatingRowColors(true);
-    m_verifyTable->setStyleSheet(FSStyle.dataTableStyleSheet());
+    }, verifyCell, this);
+    connect(m_verifyModel, &RecordTableModelBase::rowsReplaced, this, &ReportsPage::applyVerifyTableLayout);
+    m_verifyTable = createTable(m_verifyModel);
     verifyLay->addWidget(m_verifyTable);
     m_tabs->addTab(verifyTab, QStringLiteral("Verification"));
 
-    m_auditTable = new QTableWidget(0, 4);
-    m_auditTable->setHorizontalHeaderLabels({
+    m_auditModel = new AuditModel({
         QStringLiteral("Time"),
         QStringLiteral("Category"),
         QStringLiteral("Event"),
         QStringLiteral("Detail"),
-    });
-    m_auditTable->verticalHeader()->setVisible(false);
-    m_auditTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
-    m_auditTable->setAlternatingRowColors(true);
-    m_auditTable->setStyleSheet(FSStyle.dataTableStyleSheet());
+    }, auditCell, this);
+    m_auditTable = createTable(m_auditModel);
+    connect(m_auditModel, &RecordTableModelBase::rowsReplaced, this, [this]() { applyAuditTableLayout(m_auditTable); });
     m_tabs->addTab(m_auditTable, QStringLiteral("Verification audit"));
 
-    m_policyTable = new QTableWidget(0, 5);
-    m_policyTable->setHorizontalHeaderLabels({
+    m_policyModel = new AuditModel({
         QStringLiteral("Time"),
         QStringLiteral("Actor"),
         QStringLiteral("Action"),
         QStringLiteral("Target"),
         QStringLiteral("Detail"),
-    });
-    m_policyTable->verticalHeader()->setVisible(false);
-    m_policyTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
-    m_policyTable->setAlternatingRowColors(true);
-    m_policyTable->setStyleSheet(FSStyle.dataTableStyleSheet());
+    }, policyAuditCell, this);
+    m_policyTable = createTable(m_policyModel);
+    connect(m_policyModel, &RecordTableModelBase::rowsReplaced, this, [this]() { applyAuditTableLayout(m_policyTable); });
     m_tabs->addTab(m_policyTable, QStringLiteral("Policy audit"));
 
     layout->addWidget(m_tabs, 1);
@@ -172,95 +241,73 @@ void ReportsPage::setupUi()
 
 void ReportsPage::setLogPaths(const QString& auditPath, const QString& policyAuditPath)
 {
+    m_auditPath = auditPath;
+    m_policyAuditPath = policyAuditPath;
     m_auditPathLabel->setText(QStringLiteral("Verification audit: %1").arg(auditPath));
     m_policyPathLabel->setText(QStringLiteral("Policy audit: %1").arg(policyAuditPath));
 }
 
-void ReportsPage::setVerificationRows(const QList<VerifyHistoryEntry>& entries)
+void ReportsPage::setVerificationSummary(const VerifyRollup::Counts& last30Days, const VerifyRollup::Counts& allTime)
 {
-    m_verifyRows = entries;
-    const QString statusFilter = m_verifyStatusFilter->currentData().toString();
-    const QString needle = m_verifySearch->text().trimmed().toLower();
+    m_summaryLabel->setText(
+        QStringLiteral("Last 30 days: %1 verifications, %2 passed, %3 failed (%4%) · All time: %5, %6% passed")
+            .arg(last30Days.total)
+            .arg(last30Days.passed)
+            .arg(last30Days.failed)
+            .arg(last30Days.passPercent())
+            .arg(allTime.total)
+            .arg(allTime.passPercent()));
+}
 
-    QList<VerifyHistoryEntry> visible;
-    for (const VerifyHistoryEntry& e : m_verifyRows) {
-        if (!statusFilter.isEmpty() && e.status.compare(statusFilter, Qt::CaseInsensitive) != 0) {
-            continue;
-        }
-        if (!needle.isEmpty()) {
-            const QString hay = QStringLiteral("%1 %2 %3 %4")
-                                    .arg(e.deviceNode, e.deviceLabel, e.summary, e.detail)
-                                    .toLower();
-            if (!hay.contains(needle)) {
-                continue;
-            }
-        }
-        visible.append(e);
-    }
+QTableView* ReportsPage::createTable(QAbstractItemModel* model)
+{
+    auto* table = new QTableView;
+    table->setModel(model);
+    table->verticalHeader()->setVisible(false);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setAlternatingRowColors(true);
+    table->setStyleSheet(FSStyle.dataTableStyleSheet());
+    return table;
+}
 
-    m_verifyTable->setRowCount(visible.size());
-    for (int row = 0; row < visible.size(); ++row) {
-        const VerifyHistoryEntry& e = visible.at(row);
-        m_verifyTable->setItem(
-            row, 0, readOnlyItem(e.timestamp.toString(QStringLiteral("yyyy-MM-dd hh:mm:ss"))));
-        const QString device = e.deviceLabel.isEmpty() ? e.deviceNode : e.deviceLabel;
-        m_verifyTable->setItem(row, 1, readOnlyItem(device));
-        m_verifyTable->setItem(row, 2, readOnlyItem(verifyKindLabel(e.kind)));
-        m_verifyTable->setItem(row, 3, readOnlyItem(e.status));
-        m_verifyTable->setItem(row, 4, readOnlyItem(e.summary));
-        QString dur;
-        if (e.durationMs > 0) {
-            dur = QStringLiteral("%1 s").arg(e.durationMs / 1000.0, 0, 'f', 1);
-        }
-        m_verifyTable->setItem(row, 5, readOnlyItem(dur));
-    }
-    applyVerifyTableLayout();
+void ReportsPage::setVerificationRows(const QList<VerifyHistoryEntry>& entries)
+{
+    m_verifyModel->setRecords(entries);
+}
+
+void ReportsPage::addVerificationRow(const VerifyHistoryEntry& entry)
+{
+    m_verifyModel->prependRecords({entry});
 }
 
 void ReportsPage::setAuditRows(const QList<AuditLogRow>& rows)
 {
-    m_auditTable->setRowCount(rows.size());
-    for (int row = 0; row < rows.size(); ++row) {
-        const AuditLogRow& r = rows.at(row);
-        m_auditTable->setItem(
-            row, 0, readOnlyItem(r.time.toString(QStringLiteral("yyyy-MM-dd hh:mm:ss"))));
-        m_auditTable->setItem(row, 1, readOnlyItem(r.category));
-        m_auditTable->setItem(row, 2, readOnlyItem(r.event));
-        m_auditTable->setItem(row, 3, readOnlyItem(r.detail));
-    }
-    applyAuditTableLayout(m_auditTable);
+    m_auditModel->setRecords(rows);
 }
 
 void ReportsPage::setPolicyAuditRows(const QList<AuditLogRow>& rows)
 {
-    m_policyTable->setRowCount(rows.size());
-    for (int row = 0; row < rows.size(); ++row) {
-        const AuditLogRow& r = rows.at(row);
-        m_policyTable->setItem(
-            row, 0, readOnlyItem(r.time.toString(QStringLiteral("yyyy-MM-dd hh:mm:ss"))));
-        m_policyTable->setItem(row, 1, readOnlyItem(r.category));
-        m_policyTable->setItem(row, 2, readOnlyItem(r.event));
-        m_policyTable->setItem(row, 3, readOnlyItem(r.detail));
-        m_policyTable->setItem(row, 4, readOnlyItem(r.source.isEmpty() ? QStringLiteral("—") : r.source));
-    }
-    applyAuditTableLayout(m_policyTable);
+    m_policyModel->setRecords(rows);
+}
+
+void ReportsPage::setOlderSources(VerifyModel::OlderFn verify, AuditModel::OlderFn audit,
+                                  AuditModel::OlderFn policyAudit)
+{
+    m_verifyModel->setOlderSource(std::move(verify));
+    m_auditModel->setOlderSource(std::move(audit));
+    m_policyModel->setOlderSource(std::move(policyAudit));
 }
 
 void ReportsPage::applyVerifyTableLayout()
 {
     m_verifyTable->resizeColumnsToContents();
-    if (m_verifyTable->columnCount() >= 5) {
-        m_verifyTable->horizontalHeader()->setSectionResizeMode(4, QHeaderView::Stretch);
-    }
+    m_verifyTable->horizontalHeader()->setSectionResizeMode(4, QHeaderView::Stretch);
 }
 
-void ReportsPage::applyAuditTableLayout(QTableWidget* table)
+void ReportsPage::applyAuditTableLayout(QTableView* table)
 {
     table->resizeColumnsToContents();
-    if (table->columnCount() >= 4) {
-        table->horizontalHeader()->setSectionResizeMode(table->columnCount() - 1,
-                                                        QHeaderView::Stretch);
-    }
+    table->horizontalHeader()->setSectionResizeMode(table->model()->columnCount() - 1, QHeaderView::Stretch);
 }
 
 void ReportsPage::onRefreshClicked()
@@ -280,7 +327,83 @@ void ReportsPage::onOpenPolicyAuditClicked()
 
 void ReportsPage::onVerifyFilterChanged()
 {
-    setVerificationRows(m_verifyRows);
+    const QString statusFilter = m_verifyStatusFilter->currentData().toString();
+    const QString needle = m_verifySearch->text().trimmed().toLower();
+    if (statusFilter.isEmpty() && needle.isEmpty()) {
+        m_verifyModel->setFilter({});
+        return;
+    }
+    m_verifyModel->setFilter([statusFilter, needle](const VerifyHistoryEntry& e) {
+        if (!statusFilter.isEmpty() && e.status.compare(statusFilter, Qt::CaseInsensitive) != 0) {
+            return false;
+        }
+        if (needle.isEmpty()) {
+            return true;
+        }
+        return QStringLiteral("%1 %2 %3 %4")
+            .arg(e.deviceNode, e.deviceLabel, e.summary, e.detail)
+            .toLower()
+            .contains(needle);
+    });
+}
+
+void ReportsPage::onExportClicked()
+{
+    ReportExport::Request request;
+    QString name;
+    if (m_tabs->currentIndex() == 1) {
+        request.source = ReportExport::Source::Audit;
+        request.sourcePath = m_auditPath;
+        name = QStringLiteral("verification-audit");
+    } else if (m_tabs->currentIndex() == 2) {
+        request.source = ReportExport::Source::PolicyAudit;
+        request.sourcePath = m_policyAuditPath;
+        name = QStringLiteral("policy-audit");
+    } else {
+        request.source = ReportExport::Source::Verification;
+        request.filter.status = m_verifyStatusFilter->currentData().toString();
+        request.filter.text = m_verifySearch->text().trimmed();
+        name = QStringLiteral("verification-history");
+    }
+    const int days = m_exportRange->currentData().toInt();
+    if (days > 0) {
+        request.filter.from = QDateTime::currentDateTime().addDays(-days);
+    }
+
+    request.outputPath = QFileDialog::getSaveFileName(
+        this, QStringLiteral("Export report"), QStringLiteral("flashspartan-%1.csv").arg(name),
+        QStringLiteral("CSV (*.csv);;NDJSON (*.ndjson);;HTML (*.html)"));
+    if (request.outputPath.isEmpty()) {
+        return;
+    }
+    request.format = ReportExport::formatForPath(request.outputPath);
+
+    m_exportButton->setEnabled(false);
+    m_exportCancel->setVisible(true);
+    m_exportProgress->setValue(0);
+    m_exportProgress->setVisible(true);
+    m_exportStatus->setText(QStringLiteral("Exporting…"));
+    emit exportRequested(request);
+}
+
+void ReportsPage::setExportProgress(qint64 rows, double done)
+{
+    m_exportProgress->setValue(static_cast<int>(done * 1000));
+    m_exportStatus->setText(QStringLiteral("Exporting… %1 rows").arg(rows));
+}
+
+void ReportsPage::setExportFinished(const ReportExport::Result& result, const QString& outputPath)
+{
+    m_exportButton->setEnabled(true);
+    m_exportCancel->setVisible(false);
+    m_exportProgress->setVisible(false);
+    if (result.success) {
+        m_exportStatus->setText(QStringLiteral("Exported %1 rows to %2").arg(result.rows).arg(outputPath));
+    } else if (result.cancelled) {
+        m_exportStatus->setText(QStringLiteral("Export cancelled"));
+    } else {
+        m_exportStatus->setText(QStringLiteral("Export failed: %1").arg(result.errorMessage));
+    }
 }
 
 } // namespace FlashSpartan
@@ -1,8 +1,11 @@
 #include "SettingsDialog.h"
 #include "AutostartManager.h"
+#include "PerfMetricsDialog.h"
 #include "Platform.h"
+#include "RawDeviceHash.h"
 #include "SettingsProfiles.h"
 #include "UiIcons.h"
+#include "WatchJournal.h"
 
 #include <QApplication>
 #include <QMessageBox>
@@ -44,6 +47,9 @@ void SettingsDialog::loadSettings(const AppSettings& settings)
     if (m_recentEventsLimitSpin) {
         m_recentEventsLimitSpin->setValue(settings.recentEventsLimit);
     }
+    if (m_activityLogLinesSpin) {
+        m_activityLogLinesSpin->setValue(settings.activityLogLines);
+    }
     if (m_deviceHistoryRetentionSpin) {
         m_deviceHistoryRetentionSpin->setValue(settings.deviceHistoryRetentionDays);
     }
@@ -54,6 +60,8 @@ void SettingsDialog::loadSettings(const AppSettings& settings)
     // Security
     m_autoHashOnConnectCheck->setChecked(settings.autoHashOnConnect);
     m_autoHashOnEjectCheck->setChecked(settings.autoHashOnEject);
+    m_ejectSealCheck->setChecked(settings.ejectSeal);
+    m_speculativePrefetchCheck->setChecked(settings.speculativePrefetch);
     m_confirmNewDeviceCheck->setChecked(settings.requireConfirmationForNew);
     m_confirmModifiedCheck->setChecked(settings.requireConfirmationForModified);
     m_blockModifiedCheck->setChecked(settings.blockModifiedDevices);
@@ -69,6 +77,17 @@ void SettingsDialog::loadSettings(const AppSettings& settings)
             break;
         }
     }
+    m_watchMetadataFirstCheck->setChecked(settings.watchManifestVerifyPolicy.metadataFirst);
+    m_watchSampleSpin->setValue(settings.watchManifestVerifyPolicy.samplePercent);
+    m_hybridMetadataFirstCheck->setChecked(settings.hybridManifestVerifyPolicy.metadataFirst);
+    m_hybridSampleSpin->setValue(settings.hybridManifestVerifyPolicy.samplePercent);
+    m_watchSampleSpin->setEnabled(m_watchMetadataFirstCheck->isChecked());
+    m_hybridSampleSpin->setEnabled(m_hybridMetadataFirstCheck->isChecked());
+    m_watchJournalCheck->setChecked(settings.watchChangeJournal);
+    m_watchFailFastCheck->setChecked(settings.watchFailFast);
+    m_watchFailFastReportCheck->setChecked(settings.watchFailFastReport);
+    m_watchFailFastReportCheck->setEnabled(settings.watchFailFast);
+    m_watchChunkCheck->setChecked(settings.watchChunkLargeFiles);
     m_isoDirEdit->setText(settings.isoScanDirectory);
     m_isoAutoVerifyCheck->setChecked(settings.isoAutoVerifyOnScan);
     if (m_isoAutoVerifyOnUsbMountCheck)
@@ -79,6 +98,12 @@ void SettingsDialog::loadSettings(const AppSettings& settings)
         m_isoVerifyDecompressedCheck->setChecked(settings.isoVerifyDecompressed);
     if (m_isoPreferOfflineCheck)
         m_isoPreferOfflineCheck->setChecked(settings.isoPreferOfflineSidecars);
+    if (m_isoReadCacheCombo) {
+        const int ri = m_isoReadCacheCombo->findData(settings.isoReadCache);
+        m_isoReadCacheCombo->setCurrentIndex(ri >= 0 ? ri : 0);
+    }
+    if (m_isoVerifyDdImagesCheck)
+        m_isoVerifyDdImagesCheck->setChecked(settings.isoVerifyDdImages);
     if (m_isoParallelSpin)
         m_isoParallelSpin->setValue(settings.isoVerifyParallel);
     if (m_settingsProfileCombo) {
@@ -93,11 +118,18 @@ void SettingsDialog::loadSettings(const AppSettings& settings)
     if (m_badUsbAlertCompositeCheck) m_badUsbAlertCompositeCheck->setChecked(settings.badUsbAlertCompositeStorage);
     if (m_badUsbAlertInterfaceDriftCheck) m_badUsbAlertInterfaceDriftCheck->setChecked(settings.badUsbAlertInterfaceDrift);
     if (m_badUsbAlertRapidReconnectCheck) m_badUsbAlertRapidReconnectCheck->setChecked(settings.badUsbAlertRapidReconnect);
+    if (m_badUsbAlertKeystrokeRateCheck) m_badUsbAlertKeystrokeRateCheck->setChecked(settings.badUsbAlertKeystrokeRate);
     if (m_badUsbAutoBaselineCheck) m_badUsbAutoBaselineCheck->setChecked(settings.badUsbAutoBaselineTrusted);
     if (m_badUsbConfirmCheck) m_badUsbConfirmCheck->setChecked(settings.badUsbConfirmAnomalies);
     if (m_badUsbUsbmonCheck) m_badUsbUsbmonCheck->setChecked(settings.badUsbUsbmonEnabled);
     if (m_badUsbUsbmonOnAnomalyCheck) m_badUsbUsbmonOnAnomalyCheck->setChecked(settings.badUsbUsbmonOnAnomalyOnly);
     if (m_badUsbUsbmonCommandEdit) m_badUsbUsbmonCommandEdit->setText(settings.badUsbUsbmonCommand);
+    if (m_badUsbUsbmonPreTriggerSpin) m_badUsbUsbmonPreTriggerSpin->setValue(settings.badUsbUsbmonPreTriggerSeconds);
+    if (m_badUsbUsbmonSuspectOnlyCheck) m_badUsbUsbmonSuspectOnlyCheck->setChecked(settings.badUsbUsbmonSuspectOnly);
+    if (m_badUsbUsbmonSummarizeCheck) m_badUsbUsbmonSummarizeCheck->setChecked(settings.badUsbUsbmonSummarize);
+    if (m_badUsbCaptureQuotaSpin) m_badUsbCaptureQuotaSpin->setValue(settings.badUsbCaptureQuotaMiB);
+    if (m_badUsbCaptureMaxAgeSpin) m_badUsbCaptureMaxAgeSpin->setValue(settings.badUsbCaptureMaxAgeDays);
+    if (m_badUsbCaptureCompressCheck) m_badUsbCaptureCompressCheck->setChecked(settings.badUsbCaptureCompress);
     m_defaultTrustCombo->setCurrentIndex(settings.defaultTrustLevel);
     if (m_allowedCountModeCombo) {
         const int mi = m_allowedCountModeCombo->findData(
@@ -112,7 +144,31 @@ void SettingsDialog::loadSettings(const AppSettings& settings)
     }
     m_bufferSizeSpin->setValue(settings.hashBufferSizeKB);
     m_useMemoryMappingCheck->setChecked(settings.useMemoryMapping);
+    m_capacityProbeCheck->setChecked(settings.hashCapacityProbe);
+    if (m_bufferAutoTuneCheck) {
+        m_bufferAutoTuneCheck->setChecked(settings.hashBufferAutoTune);
+    }
+    if (m_skipZeroRegionsCheck) {
+        m_skipZeroRegionsCheck->setChecked(settings.hashSkipZeroRegions);
+    }
+    if (m_helperSessionCheck) {
+        m_helperSessionCheck->setChecked(settings.hashHelperSession);
+    }
+    if (m_ioEngineCombo) {
+        const int ei = m_ioEngineCombo->findData(settings.hashIoEngine);
+        m_ioEngineCombo->setCurrentIndex(ei >= 0 ? ei : 0);
+    }
+    if (m_hugePagesCombo) {
+        const int hi = m_hugePagesCombo->findData(settings.hashHugePages);
+        m_hugePagesCombo->setCurrentIndex(hi >= 0 ? hi : 0);
+    }
+    if (m_ioQueueDepthSpin) {
+        m_ioQueueDepthSpin->setValue(settings.hashIoQueueDepth);
+    }
     m_maxConcurrentSpin->setValue(settings.maxConcurrentHashes);
+    m_backgroundLimitSpin->setValue(settings.backgroundIoLimitMBps);
+    m_pauseOnBatteryCheck->setChecked(settings.pauseBackgroundOnBattery);
+    m_memoryBudgetSpin->setValue(settings.memoryBudgetMiB);
     if (m_defaultHashScopeCombo) {
         const int si = m_defaultHashScopeCombo->findData(hashScopeToString(settings.defaultHashScope));
         m_defaultHashScopeCombo->setCurrentIndex(si >= 0 ? si : 0);
@@ -127,6 +183,13 @@ void SettingsDialog::loadSettings(const AppSettings& settings)
     if (m_promptHashOptionsCheck) {
         m_promptHashOptionsCheck->setChecked(settings.promptHashOptionsOnManual);
     }
+    if (m_hashPrescreenCheck) {
+        m_hashPrescreenCheck->setChecked(settings.hashPrescreenXxh3);
+    }
+    m_stopAtFirstChangeCheck->setChecked(settings.hashStopAtFirstChange);
+    m_quickSamplesSpin->setValue(settings.hashQuickSamples);
+    m_quickSampleKBSpin->setValue(settings.hashQuickSampleKB);
+    m_quickSampleMetadataCheck->setChecked(settings.hashQuickSampleMetadata);
     
     // Appearance
     int themeIndex = m_themeList.indexOf(FSStyle.currentTheme());
@@ -158,6 +221,9 @@ AppSettings SettingsDialog::getSettings() const
     if (m_recentEventsLimitSpin) {
         settings.recentEventsLimit = m_recentEventsLimitSpin->value();
     }
+    if (m_activityLogLinesSpin) {
+        settings.activityLogLines = m_activityLogLinesSpin->value();
+    }
     if (m_deviceHistoryRetentionSpin) {
         settings.deviceHistoryRetentionDays = m_deviceHistoryRetentionSpin->value();
     }
@@ -168,12 +234,22 @@ AppSettings SettingsDialog::getSettings() const
     // Security
     settings.autoHashOnConnect = m_autoHashOnConnectCheck->isChecked();
     settings.autoHashOnEject = m_autoHashOnEjectCheck->isChecked();
+    settings.ejectSeal = m_ejectSealCheck->isChecked();
+    settings.speculativePrefetch = m_speculativePrefetchCheck->isChecked();
     settings.requireConfirmationForNew = m_confirmNewDeviceCheck->isChecked();
     settings.requireConfirmationForModified = m_confirmModifiedCheck->isChecked();
     settings.blockModifiedDevices = m_blockModifiedCheck->isChecked();
     settings.appModule = static_cast<AppModule>(m_appModuleCombo->currentData().toInt());
     settings.defaultVerificationProfile = static_cast<VerificationProfile>(
         m_defaultProfileCombo->currentData().toInt());
+    settings.watchManifestVerifyPolicy.metadataFirst = m_watchMetadataFirstCheck->isChecked();
+    settings.watchManifestVerifyPolicy.samplePercent = m_watchSampleSpin->value();
+    settings.hybridManifestVerifyPolicy.metadataFirst = m_hybridMetadataFirstCheck->isChecked();
+    settings.hybridManifestVerifyPolicy.samplePercent = m_hybridSampleSpin->value();
+    settings.watchChangeJournal = m_watchJournalCheck->isChecked();
+    settings.watchFailFast = m_watchFailFastCheck->isChecked();
+    settings.watchFailFastReport = m_watchFailFastReportCheck->isChecked();
+    settings.watchChunkLargeFiles = m_watchChunkCheck->isChecked();
     settings.isoScanDirectory = m_isoDirEdit->text().trimmed();
     settings.isoAutoVerifyOnScan = m_isoAutoVerifyCheck->isChecked();
     if (m_isoAutoVerifyOnUsbMountCheck)
@@ -184,6 +260,10 @@ AppSettings SettingsDialog::getSettings() const
         settings.isoVerifyDecompressed = m_isoVerifyDecompressedCheck->isChecked();
     if (m_isoPreferOfflineCheck)
         settings.isoPreferOfflineSidecars = m_isoPreferOfflineCheck->isChecked();
+    if (m_isoReadCacheCombo)
+        settings.isoReadCache = m_isoReadCacheCombo->currentData().toString();
+    if (m_isoVerifyDdImagesCheck)
+        settings.isoVerifyDdImages = m_isoVerifyDdImagesCheck->isChecked();
     if (m_isoParallelSpin)
         settings.isoVerifyParallel = m_isoParallelSpin->value();
     if (m_settingsProfileCombo) {
@@ -195,11 +275,18 @@ AppSettings SettingsDialog::getSettings() const
     if (m_badUsbAlertCompositeCheck) settings.badUsbAlertCompositeStorage = m_badUsbAlertCompositeCheck->isChecked();
     if (m_badUsbAlertInterfaceDriftCheck) settings.badUsbAlertInterfaceDrift = m_badUsbAlertInterfaceDriftCheck->isChecked();
     if (m_badUsbAlertRapidReconnectCheck) settings.badUsbAlertRapidReconnect = m_badUsbAlertRapidReconnectCheck->isChecked();
+    if (m_badUsbAlertKeystrokeRateCheck) settings.badUsbAlertKeystrokeRate = m_badUsbAlertKeystrokeRateCheck->isChecked();
     if (m_badUsbAutoBaselineCheck) settings.badUsbAutoBaselineTrusted = m_badUsbAutoBaselineCheck->isChecked();
     if (m_badUsbConfirmCheck) settings.badUsbConfirmAnomalies = m_badUsbConfirmCheck->isChecked();
     if (m_badUsbUsbmonCheck) settings.badUsbUsbmonEnabled = m_badUsbUsbmonCheck->isChecked();
     if (m_badUsbUsbmonOnAnomalyCheck) settings.badUsbUsbmonOnAnomalyOnly = m_badUsbUsbmonOnAnomalyCheck->isChecked();
     if (m_badUsbUsbmonCommandEdit) settings.badUsbUsbmonCommand = m_badUsbUsbmonCommandEdit->text().trimmed();
+    if (m_badUsbUsbmonPreTriggerSpin) settings.badUsbUsbmonPreTriggerSeconds = m_badUsbUsbmonPreTriggerSpin->value();
+    if (m_badUsbUsbmonSuspectOnlyCheck) settings.badUsbUsbmonSuspectOnly = m_badUsbUsbmonSuspectOnlyCheck->isChecked();
+    if (m_badUsbUsbmonSummarizeCheck) settings.badUsbUsbmonSummarize = m_badUsbUsbmonSummarizeCheck->isChecked();
+    if (m_badUsbCaptureQuotaSpin) settings.badUsbCaptureQuotaMiB = m_badUsbCaptureQuotaSpin->value();
+    if (m_badUsbCaptureMaxAgeSpin) settings.badUsbCaptureMaxAgeDays = m_badUsbCaptureMaxAgeSpin->value();
+    if (m_badUsbCaptureCompressCheck) settings.badUsbCaptureCompress = m_badUsbCaptureCompressCheck->isChecked();
     settings.defaultTrustLevel = m_defaultTrustCombo->currentIndex();
     if (m_allowedCountModeCombo) {
         settings.allowedCountMode =
@@ -210,7 +297,29 @@ AppSettings SettingsDialog::getSettings() const
     settings.hashAlgorithm = m_hashAlgorithmCombo->currentText();
     settings.hashBufferSizeKB = m_bufferSizeSpin->value();
     settings.useMemoryMapping = m_useMemoryMappingCheck->isChecked();
+    settings.hashCapacityProbe = m_capacityProbeCheck->isChecked();
+    if (m_bufferAutoTuneCheck) {
+        settings.hashBufferAutoTune = m_bufferAutoTuneCheck->isChecked();
+    }
+    if (m_skipZeroRegionsCheck) {
+        settings.hashSkipZeroRegions = m_skipZeroRegionsCheck->isChecked();
+    }
+    if (m_helperSessionCheck) {
+        settings.hashHelperSession = m_helperSessionCheck->isChecked();
+    }
+    if (m_hugePagesCombo) {
+        settings.hashHugePages = m_hugePagesCombo->currentData().toString();
+    }
+    if (m_ioEngineCombo) {
+        settings.hashIoEngine = m_ioEngineCombo->currentData().toString();
+    }
+    if (m_ioQueueDepthSpin) {
+        settings.hashIoQueueDepth = m_ioQueueDepthSpin->value();
+    }
     settings.maxConcurrentHashes = m_maxConcurrentSpin->value();
+    settings.backgroundIoLimitMBps = m_backgroundLimitSpin->value();
+    settings.pauseBackgroundOnBattery = m_pauseOnBatteryCheck->isChecked();
+    settings.memoryBudgetMiB = m_memoryBudgetSpin->value();
     if (m_defaultHashScopeCombo) {
         settings.defaultHashScope = hashScopeFromString(m_defaultHashScopeCombo->currentData().toString());
     }
@@ -223,6 +332,13 @@ AppSettings SettingsDialog::getSettings() const
     if (m_promptHashOptionsCheck) {
         settings.promptHashOptionsOnManual = m_promptHashOptionsCheck->isChecked();
     }
+    if (m_hashPrescreenCheck) {
+        settings.hashPrescreenXxh3 = m_hashPrescreenCheck->isChecked();
+    }
+    settings.hashStopAtFirstChange = m_stopAtFirstChangeCheck->isChecked();
+    settings.hashQuickSamples = m_quickSamplesSpin->value();
+    settings.hashQuickSampleKB = m_quickSampleKBSpin->value();
+    settings.hashQuickSampleMetadata = m_quickSampleMetadataCheck->isChecked();
     
     // Appearance
     settings.theme = m_themeCombo->currentText();
@@ -336,6 +452,14 @@ QWidget* SettingsDialog::createGeneralTab()
             &SettingsDialog::onSettingChanged);
     historyForm->addRow(QStringLiteral("Recent events (USB Monitor):"), m_recentEventsLimitSpin);
 
+    m_activityLogLinesSpin = new QSpinBox;
+    m_activityLogLinesSpin->setRange(100, 100000);
+    m_activityLogLinesSpin->setSingleStep(1000);
+    m_activityLogLinesSpin->setToolTip(QStringLiteral("Lines kept in the sidebar activity log; the oldest drop off"));
+    connect(m_activityLogLinesSpin, QOverload<int>::of(&QSpinBox::valueChanged), this,
+            &SettingsDialog::onSettingChanged);
+    historyForm->addRow(QStringLiteral("Activity log lines:"), m_activityLogLinesSpin);
+
     m_deviceHistoryRetentionSpin = new QSpinBox;
     m_deviceHistoryRetentionSpin->setRange(0, 3650);
     m_deviceHistoryRetentionSpin->setSpecialValueText(QStringLiteral("Unlimited"));
@@ -422,6 +546,60 @@ QWidget* SettingsDialog::createVerificationTab()
     connect(m_defaultProfileCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
             this, &SettingsDialog::onSettingChanged);
     profileForm->addRow(QStringLiteral("Default:"), m_defaultProfileCombo);
+
+    const QString metadataTip = QStringLiteral(
+        "Compare size, modification/change time and inode first and only re-hash files whose "
+        "metadata changed, plus the given share of the rest at random. Much faster on large "
+        "watch lists, but someone editing the drive offline can forge metadata; keep a sample "
+        "or use Hybrid for untrusted drives. Baselines built before this option re-hash fully "
+        "until rebuilt.");
+    auto addPolicyRow = [&](const QString& label, QCheckBox*& check, QSpinBox*& spin) {
+        check = new QCheckBox(QStringLiteral("Re-hash only files whose metadata changed"));
+        check->setToolTip(metadataTip);
+        spin = new QSpinBox;
+        spin->setRange(0, 100);
+        spin->setSuffix(QStringLiteral(" % random re-hash"));
+        spin->setToolTip(metadataTip);
+        connect(check, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+        connect(check, &QCheckBox::toggled, spin, &QWidget::setEnabled);
+        connect(spin, QOverload<int>::of(&QSpinBox::valueChanged), this, &SettingsDialog::onSettingChanged);
+        QHBoxLayout* row = new QHBoxLayout;
+        row->addWidget(check);
+        row->addWidget(spin);
+        row->addStretch();
+        profileForm->addRow(label, row);
+    };
+    addPolicyRow(QStringLiteral("Watch folders:"), m_watchMetadataFirstCheck, m_watchSampleSpin);
+    addPolicyRow(QStringLiteral("Hybrid:"), m_hybridMetadataFirstCheck, m_hybridSampleSpin);
+    m_watchJournalCheck = new QCheckBox(QStringLiteral("Journal changes while the drive stays mounted"));
+    m_watchJournalCheck->setToolTip(QStringLiteral(
+        "Watch the watch paths of verified drives with inotify and, on the next verify, re-hash "
+        "only files touched since the last clean check. Changes made while the drive is not "
+        "mounted here are never in the journal, so each mount starts with a full verify. "
+        "Linux only."));
+    m_watchJournalCheck->setEnabled(WatchJournal::isSupported());
+    connect(m_watchJournalCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    profileForm->addRow(QStringLiteral("Change journal:"), m_watchJournalCheck);
+    m_watchFailFastCheck = new QCheckBox(QStringLiteral("Stop at the first differing file"));
+    m_watchFailFastCheck->setToolTip(QStringLiteral(
+        "Decide block or allow as soon as one watched file is added, missing or changed, "
+        "instead of hashing every file first."));
+    m_watchFailFastReportCheck = new QCheckBox(QStringLiteral("Then finish the full diff for the log"));
+    connect(m_watchFailFastCheck, &QCheckBox::toggled, m_watchFailFastReportCheck, &QWidget::setEnabled);
+    connect(m_watchFailFastCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    connect(m_watchFailFastReportCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    QHBoxLayout* failFastRow = new QHBoxLayout;
+    failFastRow->addWidget(m_watchFailFastCheck);
+    failFastRow->addWidget(m_watchFailFastReportCheck);
+    failFastRow->addStretch();
+    profileForm->addRow(QStringLiteral("Fail fast:"), failFastRow);
+    m_watchChunkCheck = new QCheckBox(QStringLiteral("Record chunk digests for files of 64 MiB and more"));
+    m_watchChunkCheck->setToolTip(QStringLiteral(
+        "New watch baselines split large files (disk images, archives) into content-defined "
+        "chunks, so a mismatch names the byte ranges that changed. The whole file is still "
+        "read on every verify."));
+    connect(m_watchChunkCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    profileForm->addRow(QStringLiteral("Large files:"), m_watchChunkCheck);
     layout->addWidget(profileGroup);
 
     QGroupBox* isoGroup = new QGroupBox(QStringLiteral("ISO verification module"));
@@ -455,6 +633,22 @@ QWidget* SettingsDialog::createVerificationTab()
     m_isoPreferOfflineCheck = new QCheckBox(QStringLiteral("Prefer local .sha256 sidecars before downloading checksums"));
     connect(m_isoPreferOfflineCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
     isoForm->addRow(QStringLiteral(""), m_isoPreferOfflineCheck);
+    m_isoReadCacheCombo = new QComboBox;
+    m_isoReadCacheCombo->addItem(QStringLiteral("Page cache (fastest re-reads)"), QStringLiteral("page-cache"));
+    m_isoReadCacheCombo->addItem(QStringLiteral("Drop pages behind the read"), QStringLiteral("drop-behind"));
+    m_isoReadCacheCombo->addItem(QStringLiteral("Direct I/O (bypass the cache)"), QStringLiteral("direct"));
+    m_isoReadCacheCombo->setToolTip(QStringLiteral(
+        "Keeps hashing a multi-gigabyte image from pushing other programs out of memory. "
+        "Linux only; other systems always use the page cache."));
+    connect(m_isoReadCacheCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &SettingsDialog::onSettingChanged);
+    isoForm->addRow(QStringLiteral("Image reads:"), m_isoReadCacheCombo);
+    m_isoVerifyDdImagesCheck = new QCheckBox(QStringLiteral("Check dd-written installer sticks against the catalog"));
+    m_isoVerifyDdImagesCheck->setToolTip(QStringLiteral(
+        "Hashes only the image's length from the start of the drive when the catalog knows the "
+        "stick's volume label. Reading the drive may ask for administrator access."));
+    connect(m_isoVerifyDdImagesCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    isoForm->addRow(QStringLiteral(""), m_isoVerifyDdImagesCheck);
     layout->addWidget(isoGroup);
 
     QGroupBox* badUsbGroup = new QGroupBox(QStringLiteral("BadUSB behavior monitoring"));
@@ -474,6 +668,11 @@ QWidget* SettingsDialog::createVerificationTab()
         connect(box, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
         badUsbForm->addRow(QStringLiteral(""), box);
     }
+    if (!Platform::isWindows()) {
+        m_badUsbAlertKeystrokeRateCheck = new QCheckBox(QStringLiteral("Alert on superhuman typing rates (reads /dev/usbmon0)"));
+        connect(m_badUsbAlertKeystrokeRateCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+        badUsbForm->addRow(QStringLiteral(""), m_badUsbAlertKeystrokeRateCheck);
+    }
     m_badUsbUsbmonCheck =
         new QCheckBox(Platform::isWindows()
                           ? QStringLiteral("Start USB packet capture on anomalies (requires USBPcap)")
@@ -486,11 +685,63 @@ QWidget* SettingsDialog::createVerificationTab()
     m_badUsbUsbmonCommandEdit = new QLineEdit;
     m_badUsbUsbmonCommandEdit->setPlaceholderText(
         Platform::isWindows()
-            ? QStringLiteral("USBPcapCMD.exe -d \\\\.\\USBPcap{bus} -o \"{out}\" -A")
+            ? QStringLiteral("USBPcapCMD.exe -d \\\\.\\USBPcap{bus} -o \"{out}\" {devices}")
             : QStringLiteral("tcpdump -i usbmon{bus} -w {out} -G 30 -W 1"));
-    m_badUsbUsbmonCommandEdit->setToolTip(QStringLiteral("Template variables: {bus}, {out}, {stable_id}, {rule_id}"));
+    m_badUsbUsbmonCommandEdit->setToolTip(Platform::isWindows()
+            ? QStringLiteral("Template variables: {bus}, {out}, {stable_id}, {rule_id}, {device} (USB address), "
+                             "{devices} (--devices <address> when capturing only the suspect device, else -A)")
+            : QStringLiteral("Template variables: {bus}, {out}, {stable_id}, {rule_id}, {device} (USB address)"));
     connect(m_badUsbUsbmonCommandEdit, &QLineEdit::textChanged, this, &SettingsDialog::onSettingChanged);
     badUsbForm->addRow(QStringLiteral("Capture command:"), m_badUsbUsbmonCommandEdit);
+    if (!Platform::isWindows()) {
+        m_badUsbUsbmonPreTriggerSpin = new QSpinBox;
+        m_badUsbUsbmonPreTriggerSpin->setRange(0, 120);
+        m_badUsbUsbmonPreTriggerSpin->setSuffix(QStringLiteral(" s"));
+        m_badUsbUsbmonPreTriggerSpin->setSpecialValueText(QStringLiteral("Off (use capture command)"));
+        m_badUsbUsbmonPreTriggerSpin->setToolTip(QStringLiteral(
+            "Keeps this much USB traffic in memory (read natively from /dev/usbmon0) so a capture "
+            "includes what happened before the anomaly. Needs read access to /dev/usbmon0."));
+        connect(m_badUsbUsbmonPreTriggerSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+                this, &SettingsDialog::onSettingChanged);
+        badUsbForm->addRow(QStringLiteral("Pre-trigger history:"), m_badUsbUsbmonPreTriggerSpin);
+    }
+    m_badUsbUsbmonSuspectOnlyCheck = new QCheckBox(QStringLiteral("Capture only the suspect device, not its whole bus"));
+    m_badUsbUsbmonSuspectOnlyCheck->setToolTip(
+        Platform::isWindows()
+            ? QStringLiteral("Passes the device's USB address to USBPcap through {devices}.")
+            : QStringLiteral("The in-memory history keeps only enumeration and HID traffic of other devices, "
+                             "and captures contain the suspect device alone."));
+    connect(m_badUsbUsbmonSuspectOnlyCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    badUsbForm->addRow(QStringLiteral(""), m_badUsbUsbmonSuspectOnlyCheck);
+    m_badUsbUsbmonSummarizeCheck = new QCheckBox(QStringLiteral("Summarize finished captures in the alert"));
+    m_badUsbUsbmonSummarizeCheck->setToolTip(
+        QStringLiteral("Decodes each capture in the background: devices, endpoints, typed keys and timing "
+                       "are added to the alert and the audit log."));
+    connect(m_badUsbUsbmonSummarizeCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    badUsbForm->addRow(QStringLiteral(""), m_badUsbUsbmonSummarizeCheck);
+    m_badUsbCaptureQuotaSpin = new QSpinBox;
+    m_badUsbCaptureQuotaSpin->setRange(0, 1024 * 1024);
+    m_badUsbCaptureQuotaSpin->setSingleStep(64);
+    m_badUsbCaptureQuotaSpin->setSuffix(QStringLiteral(" MiB"));
+    m_badUsbCaptureQuotaSpin->setSpecialValueText(QStringLiteral("Unlimited"));
+    m_badUsbCaptureQuotaSpin->setToolTip(QStringLiteral(
+        "Oldest captures are deleted once the capture folder grows past this size."));
+    connect(m_badUsbCaptureQuotaSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &SettingsDialog::onSettingChanged);
+    badUsbForm->addRow(QStringLiteral("Capture disk quota:"), m_badUsbCaptureQuotaSpin);
+    m_badUsbCaptureMaxAgeSpin = new QSpinBox;
+    m_badUsbCaptureMaxAgeSpin->setRange(0, 3650);
+    m_badUsbCaptureMaxAgeSpin->setSuffix(QStringLiteral(" days"));
+    m_badUsbCaptureMaxAgeSpin->setSpecialValueText(QStringLiteral("Forever"));
+    connect(m_badUsbCaptureMaxAgeSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &SettingsDialog::onSettingChanged);
+    badUsbForm->addRow(QStringLiteral("Keep captures for:"), m_badUsbCaptureMaxAgeSpin);
+    m_badUsbCaptureCompressCheck = new QCheckBox(QStringLiteral("Compress finished captures"));
+    m_badUsbCaptureCompressCheck->setToolTip(QStringLiteral(
+        "Compresses each capture with zstd (or gzip) once it is summarized. A capture identical to "
+        "one already kept is not stored again; the kept one counts the repeat."));
+    connect(m_badUsbCaptureCompressCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    badUsbForm->addRow(QStringLiteral(""), m_badUsbCaptureCompressCheck);
     if (Platform::isWindows()) {
         auto* usbPcapHint = new QLabel(QStringLiteral(
             "Packet capture requires USBPcap. Use BadUSB Monitor → Download USBPcap; "
@@ -524,6 +775,20 @@ QWidget* SettingsDialog::createSecurityTab()
     m_autoHashOnEjectCheck->setToolTip("Recalculate hash before safely ejecting a device");
     connect(m_autoHashOnEjectCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
     hashingLayout->addWidget(m_autoHashOnEjectCheck);
+
+    m_ejectSealCheck = new QCheckBox("Seal verified devices on eject");
+    m_ejectSealCheck->setToolTip("Record the partition table, file system markers and a sampled digest when a "
+                                 "verified device is ejected; if they are unchanged on reconnect it passes at "
+                                 "once and the full verify runs a little later");
+    connect(m_ejectSealCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    hashingLayout->addWidget(m_ejectSealCheck);
+
+    m_speculativePrefetchCheck = new QCheckBox("Prefetch watched files before the verify");
+    m_speculativePrefetchCheck->setToolTip("While a mounted device waits for its watch-list verify, read its "
+                                           "smallest watched files into memory at idle priority so the verify "
+                                           "starts warm; up to 256 MB per connect");
+    connect(m_speculativePrefetchCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    hashingLayout->addWidget(m_speculativePrefetchCheck);
     
     layout->addWidget(hashingGroup);
     
@@ -591,6 +856,9 @@ QWidget* SettingsDialog::createHashingTab()
     
     m_hashAlgorithmCombo = new QComboBox;
     m_hashAlgorithmCombo->addItems({"SHA256", "SHA512", "BLAKE2b"});
+    if (RawDeviceHash::algorithmAvailable(RawDeviceHash::Algorithm::BLAKE3)) {
+        m_hashAlgorithmCombo->addItem(QStringLiteral("BLAKE3"));
+    }
     m_hashAlgorithmCombo->setToolTip("Cryptographic hash algorithm to use for device verification");
     connect(m_hashAlgorithmCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
             this, &SettingsDialog::onSettingChanged);
@@ -598,7 +866,8 @@ QWidget* SettingsDialog::createHashingTab()
     
     QLabel* algoNote = new QLabel(
         "<small>SHA256 is recommended for most users. "
-        "SHA512 and BLAKE2b provide stronger security but may be slower.</small>");
+        "SHA512 and BLAKE2b provide stronger security but may be slower. "
+        "BLAKE3 (when built with libblake3) is the fastest on multi-core machines.</small>");
     algoNote->setWordWrap(true);
     algoNote->setStyleSheet(QString("color: %1;").arg(FSStyle.colorCss(StyleManager::ColorRole::TextMuted)));
     algoLayout->addRow(algoNote);
@@ -625,11 +894,76 @@ QWidget* SettingsDialog::createHashingTab()
     bufferLayout->addStretch();
     
     perfLayout->addRow("Buffer size:", bufferLayout);
+
+#ifndef Q_OS_WIN
+    m_bufferAutoTuneCheck = new QCheckBox(QStringLiteral("Auto-tune buffer size per drive model"));
+    m_bufferAutoTuneCheck->setToolTip(QStringLiteral(
+        "The first hash of a new drive model reads the first 256 MB at several buffer sizes "
+        "(including the kernel's max_sectors_kb) and keeps the fastest for that model. "
+        "The buffer size above is used until then."));
+    connect(m_bufferAutoTuneCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    perfLayout->addRow(m_bufferAutoTuneCheck);
+
+    m_skipZeroRegionsCheck = new QCheckBox(QStringLiteral("Fast path for empty (all-zero) regions"));
+    m_skipZeroRegionsCheck->setToolTip(QStringLiteral(
+        "Full reads give all-zero 64 MB blocks a precomputed digest and skip reading holes "
+        "reported by the filesystem. The resulting hash is identical to a plain full read."));
+    connect(m_skipZeroRegionsCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    perfLayout->addRow(m_skipZeroRegionsCheck);
+
+    m_helperSessionCheck = new QCheckBox(QStringLiteral("Reuse the elevated read helper between hashes"));
+    m_helperSessionCheck->setToolTip(QStringLiteral(
+        "When hashing needs polkit, keep the authenticated helper running for the next hashes "
+        "(up to 16 devices and 10 minutes, ending after 90 s idle) instead of asking "
+        "and starting it again for every device."));
+    connect(m_helperSessionCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    perfLayout->addRow(m_helperSessionCheck);
+#endif
+
+    m_capacityProbeCheck = new QCheckBox(QStringLiteral("Probe new devices for counterfeit capacity"));
+    m_capacityProbeCheck->setToolTip(QStringLiteral(
+        "Before the first hash of a device, read its start, a window at every power of two "
+        "and a grid of sectors up to the reported size (about 60 MB for 256 GB). A start that "
+        "reappears higher up, or reads that fail past some point, mean the stick is smaller "
+        "than it claims. Read-only; a blank stick cannot be judged without writing."));
+    connect(m_capacityProbeCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    perfLayout->addRow(m_capacityProbeCheck);
     
     m_useMemoryMappingCheck = new QCheckBox("Use memory-mapped I/O");
     m_useMemoryMappingCheck->setToolTip("Use mmap for faster reading on supported filesystems");
     connect(m_useMemoryMappingCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
     perfLayout->addRow(m_useMemoryMappingCheck);
+
+#ifndef Q_OS_WIN
+    m_ioEngineCombo = new QComboBox;
+    m_ioEngineCombo->addItem(QStringLiteral("Standard (mmap / read)"), QStringLiteral("default"));
+    m_ioEngineCombo->addItem(QStringLiteral("io_uring queued reads"), QStringLiteral("io_uring"));
+    m_ioEngineCombo->setToolTip(QStringLiteral(
+        "io_uring keeps several O_DIRECT reads in flight while hashing. Falls back to the "
+        "standard engine when the kernel or build does not support it."));
+    connect(m_ioEngineCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &SettingsDialog::onSettingChanged);
+    perfLayout->addRow(QStringLiteral("I/O engine:"), m_ioEngineCombo);
+
+    m_ioQueueDepthSpin = new QSpinBox;
+    m_ioQueueDepthSpin->setRange(2, 32);
+    m_ioQueueDepthSpin->setToolTip(QStringLiteral("Reads kept in flight by the io_uring engine"));
+    connect(m_ioQueueDepthSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &SettingsDialog::onSettingChanged);
+    perfLayout->addRow(QStringLiteral("Queue depth:"), m_ioQueueDepthSpin);
+
+    m_hugePagesCombo = new QComboBox;
+    m_hugePagesCombo->addItem(QStringLiteral("Off"), QStringLiteral("off"));
+    m_hugePagesCombo->addItem(QStringLiteral("Transparent"), QStringLiteral("transparent"));
+    m_hugePagesCombo->addItem(QStringLiteral("Reserved (hugetlbfs)"), QStringLiteral("explicit"));
+    m_hugePagesCombo->setToolTip(QStringLiteral(
+        "Back read buffers of 2 MB and more with huge pages, which cuts TLB misses on fast "
+        "drives. Reserved pages come from vm.nr_hugepages and fall back to transparent ones "
+        "when none are free. Applies to buffers allocated after the change."));
+    connect(m_hugePagesCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &SettingsDialog::onSettingChanged);
+    perfLayout->addRow(QStringLiteral("Huge pages:"), m_hugePagesCombo);
+#endif
     
     m_maxConcurrentSpin = new QSpinBox;
     m_maxConcurrentSpin->setRange(1, 4);
@@ -637,6 +971,46 @@ QWidget* SettingsDialog::createHashingTab()
     connect(m_maxConcurrentSpin, QOverload<int>::of(&QSpinBox::valueChanged),
             this, &SettingsDialog::onSettingChanged);
     perfLayout->addRow("Max concurrent hashes:", m_maxConcurrentSpin);
+
+    m_backgroundLimitSpin = new QSpinBox;
+    m_backgroundLimitSpin->setRange(0, 2000);
+    m_backgroundLimitSpin->setSingleStep(10);
+    m_backgroundLimitSpin->setSuffix(QStringLiteral(" MB/s"));
+    m_backgroundLimitSpin->setSpecialValueText(QStringLiteral("Unlimited"));
+    m_backgroundLimitSpin->setToolTip(QStringLiteral(
+        "Shared by full hashes, baselines and automatic ISO verification. These already read at "
+        "idle disk priority; the cap also holds them back on schedulers that ignore priority. "
+        "Quick checks and verifies you start keep full speed."));
+    connect(m_backgroundLimitSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &SettingsDialog::onSettingChanged);
+    perfLayout->addRow(QStringLiteral("Background read cap:"), m_backgroundLimitSpin);
+
+    m_pauseOnBatteryCheck = new QCheckBox(QStringLiteral("Pause background reads on battery"));
+    m_pauseOnBatteryCheck->setToolTip(QStringLiteral(
+        "Full hashes and automatic ISO verification wait at their next buffer until AC power returns"));
+    connect(m_pauseOnBatteryCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    perfLayout->addRow(m_pauseOnBatteryCheck);
+
+    m_memoryBudgetSpin = new QSpinBox;
+    m_memoryBudgetSpin->setRange(0, 16384);
+    m_memoryBudgetSpin->setSingleStep(64);
+    m_memoryBudgetSpin->setSuffix(QStringLiteral(" MiB"));
+    m_memoryBudgetSpin->setSpecialValueText(QStringLiteral("Unlimited"));
+    m_memoryBudgetSpin->setToolTip(QStringLiteral(
+        "Resident memory FlashSpartan keeps itself under by dropping idle read buffers and older "
+        "usbmon history. Caches are released under system memory pressure either way."));
+    connect(m_memoryBudgetSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &SettingsDialog::onSettingChanged);
+    perfLayout->addRow(QStringLiteral("Memory budget:"), m_memoryBudgetSpin);
+
+    auto* countersBtn = new QPushButton(QStringLiteral("Performance counters…"));
+    countersBtn->setToolTip(QStringLiteral(
+        "Live hashing throughput, read latency, cache hit rates and queue depths of this session"));
+    connect(countersBtn, &QPushButton::clicked, this, [this]() {
+        PerfMetricsDialog dialog(this);
+        dialog.exec();
+    });
+    perfLayout->addRow(QString(), countersBtn);
     
     QGroupBox* smartGroup = new QGroupBox(QStringLiteral("Smarter hashing"));
     QFormLayout* smartLayout = new QFormLayout(smartGroup);
@@ -650,12 +1024,42 @@ QWidget* SettingsDialog::createHashingTab()
 
     m_defaultHashScanModeCombo = new QComboBox;
     m_defaultHashScanModeCombo->addItem(QStringLiteral("Full partition read"), QStringLiteral("full"));
+    m_defaultHashScanModeCombo->addItem(QStringLiteral("Full read, parallel blocks"), QStringLiteral("parallel"));
     m_defaultHashScanModeCombo->addItem(QStringLiteral("Quick sample"), QStringLiteral("quick"));
     m_defaultHashScanModeCombo->addItem(QStringLiteral("Watch folders only (no raw read)"), QStringLiteral("watch"));
     connect(m_defaultHashScanModeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
             this, &SettingsDialog::onSettingChanged);
     smartLayout->addRow(QStringLiteral("Default scan:"), m_defaultHashScanModeCombo);
 
+    m_quickSamplesSpin = new QSpinBox;
+    m_quickSamplesSpin->setRange(RawDeviceHash::kMinQuickSamples, RawDeviceHash::kMaxQuickSamples);
+    m_quickSamplesSpin->setSuffix(QStringLiteral(" samples"));
+    m_quickSampleKBSpin = new QSpinBox;
+    m_quickSampleKBSpin->setRange(RawDeviceHash::kMinQuickSampleKB, RawDeviceHash::kMaxQuickSampleKB);
+    m_quickSampleKBSpin->setSingleStep(256);
+    m_quickSampleKBSpin->setSuffix(QStringLiteral(" KB each"));
+    QHBoxLayout* quickRow = new QHBoxLayout;
+    quickRow->addWidget(m_quickSamplesSpin);
+    quickRow->addWidget(m_quickSampleKBSpin);
+    quickRow->addStretch();
+    const QString quickTip = QStringLiteral(
+        "Head, tail and evenly spaced reads, fetched together. Existing quick baselines keep "
+        "the layout they were recorded with; new settings apply to new baselines.");
+    m_quickSamplesSpin->setToolTip(quickTip);
+    m_quickSampleKBSpin->setToolTip(quickTip);
+    connect(m_quickSamplesSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &SettingsDialog::onSettingChanged);
+    connect(m_quickSampleKBSpin, QOverload<int>::of(&QSpinBox::valueChanged),
+            this, &SettingsDialog::onSettingChanged);
+    smartLayout->addRow(QStringLiteral("Quick sample:"), quickRow);
+
+    m_quickSampleMetadataCheck = new QCheckBox(QStringLiteral("Quick sample: also read filesystem metadata areas"));
+    m_quickSampleMetadataCheck->setToolTip(QStringLiteral(
+        "Adds reads where FAT tables, ext superblock backups, btrfs superblock mirrors and the "
+        "NTFS MFT usually live, so edits to filesystem structures change the quick hash."));
+    connect(m_quickSampleMetadataCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    smartLayout->addRow(m_quickSampleMetadataCheck);
+
     m_hashResumeCheckpointsCheck = new QCheckBox(QStringLiteral("Save resume checkpoints (64 MiB blocks)"));
     connect(m_hashResumeCheckpointsCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
     smartLayout->addRow(m_hashResumeCheckpointsCheck);
@@ -664,6 +1068,26 @@ QWidget* SettingsDialog::createHashingTab()
     connect(m_promptHashOptionsCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
     smartLayout->addRow(m_promptHashOptionsCheck);
 
+    m_hashPrescreenCheck = new QCheckBox(QStringLiteral("Fast XXH3-128 pre-screen on re-verify"));
+    m_hashPrescreenCheck->setToolTip(QStringLiteral(
+        "Full-read re-verifications hash with non-cryptographic XXH3-128 first and only re-run "
+        "the baseline algorithm when it differs. The first pass after enabling reads the "
+        "device twice to record the pre-screen value."));
+    if (!RawDeviceHash::algorithmAvailable(RawDeviceHash::Algorithm::XXH3_128)) {
+        m_hashPrescreenCheck->setEnabled(false);
+        m_hashPrescreenCheck->setToolTip(QStringLiteral("This build has no XXH3 support (libxxhash)."));
+    }
+    connect(m_hashPrescreenCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    smartLayout->addRow(m_hashPrescreenCheck);
+
+    m_stopAtFirstChangeCheck = new QCheckBox(QStringLiteral("Stop verify at the first changed block"));
+    m_stopAtFirstChangeCheck->setToolTip(QStringLiteral(
+        "Full-read re-verifications compare each 64 MB block with the digests stored with the "
+        "baseline and stop as soon as one differs, reporting where. Approving the change "
+        "re-reads the whole device first."));
+    connect(m_stopAtFirstChangeCheck, &QCheckBox::toggled, this, &SettingsDialog::onSettingChanged);
+    smartLayout->addRow(m_stopAtFirstChangeCheck);
+
     layout->addWidget(smartGroup);
 
     layout->addWidget(perfGroup);
@@ -85,6 +85,7 @@ void SettingsProfiles::applyProfile(const QString& profileId, AppSettings& setti
         settings.defaultVerificationProfile = VerificationProfile::WatchManifest;
         settings.autoHashOnConnect = true;
         settings.autoHashOnEject = true;
+        settings.ejectSeal = false;
         settings.isoAutoVerifyOnUsbMount = true;
         settings.isoAutoVerifyOnScan = true;
         settings.blockMountOnIsoVerifyFailure = true;
@@ -0,0 +1,75 @@
+#include "SettingsSnapshot.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+namespace FlashSpartan::SettingsSnapshot {
+
+namespace {
+
+struct State {
+    // Readers std::atomic_load current; publishers also hold the mutex, so the version and
+    // the snapshot advance together.
+    QMutex mutex;
+    Ptr current = std::make_shared<const AppSettings>();
+    std::atomic<quint64> version{0};
+    std::vector<std::pair<int, Listener>> listeners;
+    int nextListenerId = 1;
+};
+
+State& state()
+{
+    static State s;
+    return s;
+}
+
+} // namespace
+
+Ptr current()
+{
+    return std::atomic_load(&state().current);
+}
+
+quint64 version()
+{
+    return state().version.load(std::memory_order_acquire);
+}
+
+void publish(const AppSettings& settings)
+{
+    State& s = state();
+    const Ptr next = std::make_shared<const AppSettings>(settings);
+    std::vector<std::pair<int, Listener>> listeners;
+    {
+        QMutexLocker lock(&s.mutex);
+        std::atomic_store(&s.current, next);
+        s.version.fetch_add(1, std::memory_order_acq_rel);
+        listeners = s.listeners;
+    }
+    // Outside the lock: a listener may read current() or publish in turn.
+    for (const auto& [id, listener] : listeners) {
+        listener(next);
+    }
+}
+
+int addListener(Listener listener)
+{
+    State& s = state();
+    QMutexLocker lock(&s.mutex);
+    const int id = s.nextListenerId++;
+    s.listeners.emplace_back(id, std::move(listener));
+    return id;
+}
+
+void removeListener(int id)
+{
+    State& s = state();
+    QMutexLocker lock(&s.mutex);
+    std::erase_if(s.listeners, [id](const auto& entry) { return entry.first == id; });
+}
+
+} // namespace FlashSpartan::SettingsSnapshot
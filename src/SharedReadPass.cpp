@@ -0,0 +1,149 @@
+#include "SharedReadPass.h"
+
+#include <QDeadlineTimer>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <cstring>
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr int kPollMs = 100;
+
+bool isCancelled(const std::atomic<bool>* cancelled)
+{
+    return cancelled && cancelled->load();
+}
+
+} // namespace
+
+SharedReadPass::SharedReadPass(uint64_t windowBytes)
+    : m_windowBytes(std::max<uint64_t>(windowBytes, 1))
+{
+    m_sincePublish.start();  // a hash that never gets going counts as stalled too
+}
+
+void SharedReadPass::publish(uint64_t offset, const char* data, size_t length)
+{
+    QMutexLocker lock(&m_mutex);
+    if (length == 0 || m_finished || m_detached) {
+        return;
+    }
+    if (!m_started) {
+        m_started = true;
+        // A resumed hash starts part-way in and never delivers what lies before; parallel
+        // workers may publish a few blocks out of order, which the window allows for.
+        m_floor = offset > m_windowBytes ? offset - m_windowBytes : 0;
+    }
+
+    const QDeadlineTimer hold(kHoldMs);
+    while (m_heldBytes + length > m_windowBytes && !m_segments.empty()) {
+        const auto oldest = m_segments.begin();
+        const uint64_t oldestEnd = oldest->first + static_cast<uint64_t>(oldest->second.size());
+        const bool readerNeedsIt = oldestEnd > m_readerAt && m_readerAt != m_holdGaveUpAt;
+        if (readerNeedsIt && !m_detached) {
+            if (!hold.hasExpired()) {
+                m_consumed.wait(&m_mutex, hold);
+                continue;
+            }
+            m_holdGaveUpAt = m_readerAt;  // not again until the reader moves
+        }
+        m_floor = std::max(m_floor, oldestEnd);
+        m_heldBytes -= static_cast<uint64_t>(oldest->second.size());
+        m_segments.erase(oldest);
+    }
+    if (m_detached) {
+        return;
+    }
+
+    QByteArray& segment = m_segments[offset];
+    m_heldBytes -= static_cast<uint64_t>(segment.size());
+    segment = QByteArray(data, static_cast<qsizetype>(length));
+    m_heldBytes += length;
+    m_sincePublish.start();
+    m_published.wakeAll();
+}
+
+void SharedReadPass::finish()
+{
+    QMutexLocker lock(&m_mutex);
+    m_finished = true;
+    m_published.wakeAll();
+}
+
+void SharedReadPass::detach()
+{
+    QMutexLocker lock(&m_mutex);
+    m_detached = true;
+    m_segments.clear();
+    m_heldBytes = 0;
+    m_consumed.wakeAll();
+}
+
+bool SharedReadPass::read(uint64_t offset, char* data, size_t length, const DirectRead& direct,
+                          QString* error, const std::atomic<bool>* cancelled)
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_readerAt = offset;
+        m_consumed.wakeAll();
+        for (;;) {
+            if (copyLocked(offset, data, length)) {
+                m_shared += length;
+                m_readerAt = offset + length;
+                m_consumed.wakeAll();
+                return true;
+            }
+            const bool stalled = m_sincePublish.hasExpired(kStallMs);
+            if (m_finished || m_detached || offset < m_floor || stalled || isCancelled(cancelled)) {
+                break;
+            }
+            m_published.wait(&m_mutex, QDeadlineTimer(kPollMs));
+        }
+        m_direct += length;
+        m_readerAt = offset + length;
+    }
+    return direct(offset, data, length, error);
+}
+
+uint64_t SharedReadPass::sharedBytes() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_shared;
+}
+
+uint64_t SharedReadPass::directBytes() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_direct;
+}
+
+bool SharedReadPass::copyLocked(uint64_t offset, char* data, size_t length) const
+{
+    auto it = m_segments.upper_bound(offset);
+    if (it == m_segments.cbegin()) {
+        return false;
+    }
+    --it;
+    uint64_t at = offset;
+    size_t done = 0;
+    while (done < length) {
+        if (it == m_segments.cend() || it->first > at) {
+            return false;
+        }
+        const uint64_t end = it->first + static_cast<uint64_t>(it->second.size());
+        if (end <= at) {
+            return false;
+        }
+        const size_t n = static_cast<size_t>(std::min<uint64_t>(end - at, length - done));
+        std::memcpy(data + done, it->second.constData() + (at - it->first), n);
+        done += n;
+        at += n;
+        ++it;
+    }
+    return true;
+}
+
+} // namespace FlashSpartan
@@ -0,0 +1,76 @@
+#include "StagedVerdict.h"
+
+namespace FlashSpartan {
+
+QString verifyStageName(VerifyStage stage)
+{
+    switch (stage) {
+        case VerifyStage::Identity: return QStringLiteral("identity");
+        case VerifyStage::Layout: return QStringLiteral("layout");
+        case VerifyStage::QuickSample: return QStringLiteral("quick sample");
+        case VerifyStage::Metadata: return QStringLiteral("watch manifest");
+        case VerifyStage::FullContent: return QStringLiteral("full content");
+    }
+    return QStringLiteral("identity");
+}
+
+QString stageOutcomeName(StageOutcome outcome)
+{
+    switch (outcome) {
+        case StageOutcome::Pass: return QStringLiteral("pass");
+        case StageOutcome::Fail: return QStringLiteral("fail");
+        case StageOutcome::Inconclusive: return QStringLiteral("inconclusive");
+    }
+    return QStringLiteral("inconclusive");
+}
+
+QString provisionalVerdictName(ProvisionalVerdict verdict)
+{
+    switch (verdict) {
+        case ProvisionalVerdict::Pending: return QStringLiteral("Pending");
+        case ProvisionalVerdict::Allow: return QStringLiteral("Allow");
+        case ProvisionalVerdict::Block: return QStringLiteral("Block");
+    }
+    return QStringLiteral("Pending");
+}
+
+StagedVerdict::StagedVerdict(VerifyStage finalStage)
+    : m_finalStage(finalStage)
+{
+    m_timer.start();
+}
+
+bool StagedVerdict::record(VerifyStage stage, StageOutcome outcome, const QString& detail)
+{
+    m_stages.append({stage, outcome, detail, m_timer.elapsed()});
+
+    if (m_verdict == ProvisionalVerdict::Block) {
+        return false;
+    }
+    const ProvisionalVerdict before = m_verdict;
+    const bool wasConclusive = isConclusive();
+    if (outcome == StageOutcome::Fail) {
+        m_verdict = ProvisionalVerdict::Block;
+        m_decidedAt = stage;
+    } else if (outcome == StageOutcome::Pass) {
+        m_verdict = ProvisionalVerdict::Allow;
+        if (!m_decidedAt && stage >= m_finalStage) {
+            m_decidedAt = stage;
+        }
+    }
+    return m_verdict != before || isConclusive() != wasConclusive;
+}
+
+QString StagedVerdict::describe() const
+{
+    const QString name = provisionalVerdictName(m_verdict);
+    if (m_decidedAt) {
+        return QStringLiteral("%1 at %2").arg(name, verifyStageName(*m_decidedAt));
+    }
+    if (m_stages.isEmpty()) {
+        return name;
+    }
+    return QStringLiteral("%1 (provisional, after %2)").arg(name, verifyStageName(m_stages.constLast().stage));
+}
+
+} // namespace FlashSpartan
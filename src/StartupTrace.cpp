@@ -0,0 +1,153 @@
+#include "StartupTrace.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSaveFile>
+
+#include <atomic>
+#include <utility>
+
+namespace FlashSpartan {
+
+namespace {
+
+QMutex g_mutex;
+QElapsedTimer g_clock;
+QList<StartupTrace::Event> g_events;
+QString g_outputPath;
+bool g_finished = false;
+std::atomic<int> g_nextThread{1};
+
+int threadIndex()
+{
+    thread_local const int index = g_nextThread.fetch_add(1);
+    return index;
+}
+
+bool writeTrace(const QString& path, const QByteArray& json)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+        return false;
+    }
+    return file.commit();
+}
+
+} // namespace
+
+StartupTrace::Phase::Phase(QString name)
+    : m_name(std::move(name)), m_beginUs(StartupTrace::nowUs())
+{
+}
+
+StartupTrace::Phase::~Phase()
+{
+    end();
+}
+
+void StartupTrace::Phase::end()
+{
+    if (!m_ended) {
+        m_ended = true;
+        StartupTrace::record(m_name, m_beginUs, StartupTrace::nowUs());
+    }
+}
+
+void StartupTrace::start()
+{
+    QMutexLocker lock(&g_mutex);
+    if (!g_clock.isValid()) {
+        g_clock.start();
+        threadIndex();
+    }
+}
+
+qint64 StartupTrace::nowUs()
+{
+    QMutexLocker lock(&g_mutex);
+    if (!g_clock.isValid()) {
+        g_clock.start();
+    }
+    return g_clock.nsecsElapsed() / 1000;
+}
+
+void StartupTrace::record(const QString& name, qint64 beginUs, qint64 endUs)
+{
+    const Event event{name, beginUs, qMax<qint64>(0, endUs - beginUs), threadIndex()};
+    qInfo().noquote() << QStringLiteral("startup: %1 %2 ms").arg(name).arg(event.durationUs / 1000.0, 0, 'f', 1);
+
+    QString path;
+    {
+        QMutexLocker lock(&g_mutex);
+        g_events.append(event);
+        if (g_finished) {
+            path = g_outputPath;
+        }
+    }
+    if (!path.isEmpty()) {
+        writeTrace(path, toJson());
+    }
+}
+
+void StartupTrace::setOutputPath(const QString& path)
+{
+    QMutexLocker lock(&g_mutex);
+    g_outputPath = path;
+}
+
+void StartupTrace::finish()
+{
+    record(QStringLiteral("main() to first event loop turn"), 0, nowUs());
+    QString path;
+    {
+        QMutexLocker lock(&g_mutex);
+        g_finished = true;
+        path = g_outputPath;
+    }
+    if (!path.isEmpty() && !writeTrace(path, toJson())) {
+        qWarning() << "Could not write the start-up trace to" << path;
+    }
+}
+
+QList<StartupTrace::Event> StartupTrace::events()
+{
+    QMutexLocker lock(&g_mutex);
+    return g_events;
+}
+
+QByteArray StartupTrace::toJson()
+{
+    const qint64 pid = QCoreApplication::applicationPid();
+    QJsonArray trace;
+    for (const Event& event : events()) {
+        QJsonObject obj;
+        obj[QStringLiteral("name")] = event.name;
+        obj[QStringLiteral("cat")] = QStringLiteral("startup");
+        obj[QStringLiteral("ph")] = QStringLiteral("X");
+        obj[QStringLiteral("ts")] = event.beginUs;
+        obj[QStringLiteral("dur")] = event.durationUs;
+        obj[QStringLiteral("pid")] = pid;
+        obj[QStringLiteral("tid")] = event.thread;
+        trace.append(obj);
+    }
+    QJsonObject root;
+    root[QStringLiteral("traceEvents")] = trace;
+    root[QStringLiteral("displayTimeUnit")] = QStringLiteral("ms");
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+void StartupTrace::reset()
+{
+    QMutexLocker lock(&g_mutex);
+    g_events.clear();
+    g_outputPath.clear();
+    g_finished = false;
+    g_clock.invalidate();
+}
+
+} // namespace FlashSpartan
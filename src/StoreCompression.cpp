@@ -0,0 +1,345 @@
+#include "StoreCompression.h"
+
+#ifdef HAS_ZSTD
+#include <zdict.h>
+#include <zstd.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+namespace FlashSpartan::StoreCompression {
+
+namespace {
+
+constexpr qsizetype kStreamChunk = 64 * 1024;
+
+void fail(QString* error, const QString& message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+} // namespace
+
+#ifdef HAS_ZSTD
+
+namespace {
+
+QString zstdError(size_t code)
+{
+    return QStringLiteral("zstd decompress failed: %1").arg(QString::fromUtf8(ZSTD_getErrorName(code)));
+}
+
+} // namespace
+
+bool available()
+{
+    return true;
+}
+
+QByteArray trainDictionary(const QList<QByteArray>& samples)
+{
+    if (samples.size() < kMinDictionarySamples) {
+        return {};
+    }
+    qsizetype total = 0;
+    for (const QByteArray& s : samples) {
+        total += s.size();
+    }
+    // Every stride-th sample, so a big store trains on a spread of it in bounded time.
+    const qsizetype stride = std::max<qsizetype>(1, (total + kMaxTrainingBytes - 1) / kMaxTrainingBytes);
+    QByteArray joined;
+    std::vector<size_t> sizes;
+    for (qsizetype i = 0; i < samples.size(); i += stride) {
+        joined += samples.at(i);
+        sizes.push_back(size_t(samples.at(i).size()));
+    }
+    if (qsizetype(sizes.size()) < kMinDictionarySamples) {
+        return {};
+    }
+    // Zstd's rule of thumb: a dictionary about a hundredth of what it was trained on.
+    const size_t capacity = size_t(std::clamp<qsizetype>(joined.size() / 100, 1024, kDictionaryBytes));
+    QByteArray dictionary(qsizetype(capacity), Qt::Uninitialized);
+    const size_t n = ZDICT_trainFromBuffer(dictionary.data(), capacity, joined.constData(), sizes.data(),
+                                           unsigned(sizes.size()));
+    if (ZDICT_isError(n)) {
+        return {};  // samples too alike or too few to learn from; compress without
+    }
+    dictionary.truncate(qsizetype(n));
+    return dictionary;
+}
+
+struct Encoder::State {
+    ZSTD_CCtx* context = nullptr;
+    ZSTD_CDict* dictionary = nullptr;
+    int level = kLevel;
+
+    ~State()
+    {
+        ZSTD_freeCDict(dictionary);
+        ZSTD_freeCCtx(context);
+    }
+};
+
+Encoder::Encoder(const QByteArray& dictionary, int level)
+    : d(std::make_unique<State>())
+{
+    d->context = ZSTD_createCCtx();
+    d->level = level;
+    if (!dictionary.isEmpty()) {
+        d->dictionary = ZSTD_createCDict(dictionary.constData(), size_t(dictionary.size()), level);
+    }
+}
+
+Encoder::~Encoder() = default;
+
+QByteArray Encoder::compress(QByteArrayView raw)
+{
+    if (!d->context || raw.isEmpty()) {
+        return {};
+    }
+    QByteArray out(qsizetype(ZSTD_compressBound(size_t(raw.size()))), Qt::Uninitialized);
+    const size_t n = d->dictionary
+                         ? ZSTD_compress_usingCDict(d->context, out.data(), size_t(out.size()), raw.data(),
+                                                    size_t(raw.size()), d->dictionary)
+                         : ZSTD_compressCCtx(d->context, out.data(), size_t(out.size()), raw.data(),
+                                             size_t(raw.size()), d->level);
+    if (ZSTD_isError(n) || qsizetype(n) >= raw.size()) {
+        return {};
+    }
+    out.truncate(qsizetype(n));
+    return out;
+}
+
+struct Decoder::State {
+    std::shared_ptr<ZSTD_DDict> dictionary;
+    bool hasDictionary = false;
+    ZSTD_DCtx* context = nullptr;
+
+    ~State() { ZSTD_freeDCtx(context); }
+};
+
+Decoder::Decoder(const QByteArray& dictionary)
+    : d(std::make_unique<State>())
+{
+    d->context = ZSTD_createDCtx();
+    if (!dictionary.isEmpty()) {
+        d->hasDictionary = true;
+        d->dictionary.reset(ZSTD_createDDict(dictionary.constData(), size_t(dictionary.size())),
+                            ZSTD_freeDDict);
+    }
+}
+
+Decoder::Decoder(const Decoder& other)
+    : d(std::make_unique<State>())
+{
+    d->context = ZSTD_createDCtx();
+    d->dictionary = other.d->dictionary;
+    d->hasDictionary = other.d->hasDictionary;
+}
+
+Decoder::~Decoder() = default;
+
+bool Decoder::isValid() const
+{
+    return d->context && (!d->hasDictionary || d->dictionary);
+}
+
+std::optional<QByteArray> Decoder::decompress(QByteArrayView stored, qsizetype rawLength, QString* error)
+{
+    if (!isValid()) {
+        fail(error, QStringLiteral("zstd decompress failed: out of memory"));
+        return std::nullopt;
+    }
+    QByteArray out(rawLength, Qt::Uninitialized);
+    const size_t n = d->dictionary
+                         ? ZSTD_decompress_usingDDict(d->context, out.data(), size_t(out.size()), stored.data(),
+                                                      size_t(stored.size()), d->dictionary.get())
+                         : ZSTD_decompressDCtx(d->context, out.data(), size_t(out.size()), stored.data(),
+                                               size_t(stored.size()));
+    if (ZSTD_isError(n)) {
+        fail(error, zstdError(n));
+        return std::nullopt;
+    }
+    if (qsizetype(n) != rawLength) {
+        fail(error, QStringLiteral("zstd decompress failed: size mismatch"));
+        return std::nullopt;
+    }
+    return out;
+}
+
+QByteArray compressFile(QByteArrayView raw, int level)
+{
+    QByteArray out(qsizetype(ZSTD_compressBound(size_t(raw.size()))), Qt::Uninitialized);
+    const size_t n = ZSTD_compress(out.data(), size_t(out.size()), raw.data(), size_t(raw.size()), level);
+    if (ZSTD_isError(n)) {
+        return {};
+    }
+    out.truncate(qsizetype(n));
+    return out;
+}
+
+struct LineReader::State {
+    ZSTD_DStream* stream = nullptr;
+    QByteArray input;
+    QByteArray output;
+    ZSTD_inBuffer in{};
+    /** Inside a frame: input running out now means the file was cut short. */
+    bool inFrame = false;
+    /** The last call filled the output; the stream may hold more before it needs input. */
+    bool outputFull = false;
+
+    ~State() { ZSTD_freeDStream(stream); }
+};
+
+LineReader::LineReader(const QString& path)
+    : m_file(path)
+    , d(std::make_unique<State>())
+{
+}
+
+LineReader::~LineReader() = default;
+
+bool LineReader::open(QString* error)
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        fail(error, m_file.errorString());
+        return false;
+    }
+    d->stream = ZSTD_createDStream();
+    if (!d->stream) {
+        fail(error, QStringLiteral("zstd decompress failed: out of memory"));
+        return false;
+    }
+    d->input.resize(kStreamChunk);
+    d->output.resize(kStreamChunk);
+    return true;
+}
+
+bool LineReader::fill()
+{
+    if (m_eof || !d->stream) {
+        return false;
+    }
+    m_pending.remove(0, m_pendingPos);
+    m_pendingPos = 0;
+    for (;;) {
+        if (d->in.pos == d->in.size && !d->outputFull) {
+            const qint64 n = m_file.read(d->input.data(), d->input.size());
+            if (n <= 0) {
+                m_eof = true;
+                if (d->inFrame) {
+                    m_error = QStringLiteral("zstd decompress failed: file is truncated");
+                }
+                return false;
+            }
+            d->in = {d->input.constData(), size_t(n), 0};
+        }
+        ZSTD_outBuffer out{d->output.data(), size_t(d->output.size()), 0};
+        const size_t ret = ZSTD_decompressStream(d->stream, &out, &d->in);
+        if (ZSTD_isError(ret)) {
+            m_eof = true;
+            m_error = zstdError(ret);
+            return false;
+        }
+        d->inFrame = ret != 0;
+        d->outputFull = out.pos == out.size;
+        if (out.pos > 0) {
+            m_pending.append(d->output.constData(), qsizetype(out.pos));
+            return true;
+        }
+    }
+}
+
+#else
+
+bool available()
+{
+    return false;
+}
+
+QByteArray trainDictionary(const QList<QByteArray>&)
+{
+    return {};
+}
+
+struct Encoder::State {};
+
+Encoder::Encoder(const QByteArray&, int) {}
+
+Encoder::~Encoder() = default;
+
+QByteArray Encoder::compress(QByteArrayView)
+{
+    return {};
+}
+
+struct Decoder::State {};
+
+Decoder::Decoder(const QByteArray&) {}
+
+Decoder::Decoder(const Decoder&) {}
+
+Decoder::~Decoder() = default;
+
+bool Decoder::isValid() const
+{
+    return false;
+}
+
+std::optional<QByteArray> Decoder::decompress(QByteArrayView, qsizetype, QString* error)
+{
+    fail(error, QStringLiteral("Built without zstd"));
+    return std::nullopt;
+}
+
+QByteArray compressFile(QByteArrayView, int)
+{
+    return {};
+}
+
+struct LineReader::State {};
+
+LineReader::LineReader(const QString& path)
+    : m_file(path)
+{
+}
+
+LineReader::~LineReader() = default;
+
+bool LineReader::open(QString* error)
+{
+    fail(error, QStringLiteral("Built without zstd"));
+    return false;
+}
+
+bool LineReader::fill()
+{
+    return false;
+}
+
+#endif
+
+bool LineReader::readLine(QByteArray* line)
+{
+    for (;;) {
+        const qsizetype newline = m_pending.indexOf('\n', m_pendingPos);
+        if (newline >= 0) {
+            *line = m_pending.mid(m_pendingPos, newline + 1 - m_pendingPos);
+            m_pendingPos = newline + 1;
+            return true;
+        }
+        if (!fill()) {
+            if (m_pendingPos < m_pending.size()) {
+                *line = m_pending.mid(m_pendingPos);
+                m_pendingPos = m_pending.size();
+                return true;
+            }
+            return false;
+        }
+    }
+}
+
+} // namespace FlashSpartan::StoreCompression
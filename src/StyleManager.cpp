@@ -2,12 +2,29 @@
 
 #include <QApplication>
 #include <QGraphicsDropShadowEffect>
+#include <QMetaEnum>
+#include <QStyle>
 #include <QPropertyAnimation>
 #include <QParallelAnimationGroup>
 #include <QDebug>
 
 namespace FlashSpartan {
 
+namespace {
+
+QString colorRoleKey(StyleManager::ColorRole role)
+{
+    return QLatin1String(QMetaEnum::fromType<StyleManager::ColorRole>().valueToKey(int(role)));
+}
+
+/** @p sheet with every @p selector narrowed to @p scoped, e.g. to a property selector. */
+QString scopedSheet(QString sheet, const QString& selector, const QString& scoped)
+{
+    return sheet.replace(selector, scoped);
+}
+
+} // namespace
+
 // Static theme palettes
 const QHash<StyleManager::Theme, QHash<StyleManager::ColorRole, QColor>> StyleManager::s_themePalettes = {
     // CyberDark - Default dark theme with cyan accents
@@ -205,7 +222,12 @@ StyleManager::StyleManager()
 void StyleManager::initialize()
 {
     loadTheme(Theme::CyberDark);
-    
+    loadFonts();
+    generateStyleSheet();
+}
+
+void StyleManager::loadFonts()
+{
     // Setup default fonts
     m_fonts[FontRole::Default] = QFont("Segoe UI", m_baseFontSize);
     m_fonts[FontRole::Heading1] = QFont("Segoe UI", m_baseFontSize + 8, QFont::Bold);
@@ -223,8 +245,6 @@ void StyleManager::initialize()
             m_fonts[FontRole::Monospace] = QFont("monospace", m_baseFontSize);
         }
     }
-    
-    generateStyleSheet();
 }
 
 void StyleManager::setTheme(Theme theme)
@@ -291,8 +311,15 @@ QFont StyleManager::font(FontRole role) const
 
 void StyleManager::setBaseFontSize(int size)
 {
-    m_baseFontSize = qBound(8, size, 24);
-    initialize();  // Regenerate fonts
+    size = qBound(8, size, 24);
+    if (size == m_baseFontSize) {
+        return;  // applySettings() calls this on every save
+    }
+    m_baseFontSize = size;
+    loadFonts();
+    m_sheetCache.clear();
+    generateStyleSheet();
+    applyToApplication();
 }
 
 QString StyleManager::applicationStyleSheet() const
@@ -300,517 +327,599 @@ QString StyleManager::applicationStyleSheet() const
     return m_cachedStyleSheet;
 }
 
+QString StyleManager::cachedSheet(int key, const std::function<QString()>& build) const
+{
+    QHash<int, QString>& sheets = m_sheetCache[int(m_currentTheme)];
+    const auto it = sheets.constFind(key);
+    if (it != sheets.cend()) {
+        return *it;
+    }
+    // build() may cache the sheets it embeds into the same table.
+    const QString sheet = build();
+    sheets.insert(key, sheet);
+    return sheet;
+}
+
+void StyleManager::setStyleProperty(QWidget* widget, const char* name, const QString& value)
+{
+    if (!widget || widget->property(name).toString() == value) {
+        return;
+    }
+    widget->setProperty(name, value);
+    widget->style()->unpolish(widget);
+    widget->style()->polish(widget);
+}
+
+void StyleManager::setTextRole(QWidget* label, ColorRole role)
+{
+    setStyleProperty(label, "fsText", colorRoleKey(role));
+}
+
+void StyleManager::setButtonVariant(QWidget* button, ButtonVariant variant)
+{
+    switch (variant) {
+        case ButtonVariant::Primary: setStyleProperty(button, "fsVariant", QStringLiteral("primary")); break;
+        case ButtonVariant::Danger:  setStyleProperty(button, "fsVariant", QStringLiteral("danger")); break;
+        case ButtonVariant::Default: setStyleProperty(button, "fsVariant", QString()); break;
+    }
+}
+
+void StyleManager::setStatusBadge(QWidget* label, ColorRole background)
+{
+    setStyleProperty(label, "fsStatus", colorRoleKey(background));
+}
+
 QString StyleManager::mainWindowStyleSheet() const
 {
-    return QString(R"(
-        QMainWindow {
-            background-color: %1;
-        }
-        QMainWindow::separator {
-            background: %2;
-            width: 1px;
-            height: 1px;
-        }
-    )")
-    .arg(colorCss(ColorRole::Background))
-    .arg(colorCss(ColorRole::Border));
+    return cachedSheet(sheetKey(Sheet::MainWindow), [this]() {
+        return QString(R"(
+            QMainWindow {
+                background-color: %1;
+            }
+            QMainWindow::separator {
+                background: %2;
+                width: 1px;
+                height: 1px;
+            }
+        )")
+        .arg(colorCss(ColorRole::Background))
+        .arg(colorCss(ColorRole::Border));
+    });
 }
 
 QString StyleManager::deviceCardStyleSheet() const
 {
-    return QString(R"(
-        QFrame#DeviceCard {
-            background-color: %1;
-            border: 1px solid %2;
-            border-radius: %5px;
-            padding: 12px;
-        }
-        QFrame#DeviceCard:hover {
-            background-color: %3;
-            border-color: %4;
-        }
-    )")
-    .arg(colorCss(ColorRole::Surface))
-    .arg(colorCss(ColorRole::Border))
-    .arg(colorCss(ColorRole::SurfaceHover))
-    .arg(colorCss(ColorRole::BorderActive))
-    .arg(m_borderRadius);
+    return cachedSheet(sheetKey(Sheet::DeviceCard), [this]() {
+        return QString(R"(
+            QFrame#DeviceCard {
+                background-color: %1;
+                border: 1px solid %2;
+                border-radius: %5px;
+                padding: 12px;
+            }
+            QFrame#DeviceCard:hover {
+                background-color: %3;
+                border-color: %4;
+            }
+        )")
+        .arg(colorCss(ColorRole::Surface))
+        .arg(colorCss(ColorRole::Border))
+        .arg(colorCss(ColorRole::SurfaceHover))
+        .arg(colorCss(ColorRole::BorderActive))
+        .arg(m_borderRadius);
+    });
 }
 
 QString StyleManager::buttonStyleSheet() const
 {
-    return QString(R"(
-        QPushButton {
-            background-color: %1;
-            color: %2;
-            border: 1px solid %3;
-            border-radius: %7px;
-            padding: 8px 16px;
-            font-weight: 500;
-            min-height: 20px;
-        }
-        QPushButton:hover {
-            background-color: %4;
-            border-color: %5;
-        }
-        QPushButton:pressed {
-            background-color: %6;
-        }
-        QPushButton:disabled {
-            background-color: %1;
-            color: %8;
-            border-color: %3;
-        }
-    )")
-    .arg(colorCss(ColorRole::Surface))
-    .arg(colorCss(ColorRole::TextPrimary))
-    .arg(colorCss(ColorRole::Border))
-    .arg(colorCss(ColorRole::SurfaceHover))
-    .arg(colorCss(ColorRole::BorderActive))
-    .arg(colorCss(ColorRole::BackgroundDark))
-    .arg(m_borderRadius)
-    .arg(colorCss(ColorRole::TextDisabled));
+    return cachedSheet(sheetKey(Sheet::Button), [this]() {
+        return QString(R"(
+            QPushButton {
+                background-color: %1;
+                color: %2;
+                border: 1px solid %3;
+                border-radius: %7px;
+                padding: 8px 16px;
+                font-weight: 500;
+                min-height: 20px;
+            }
+            QPushButton:hover {
+                background-color: %4;
+                border-color: %5;
+            }
+            QPushButton:pressed {
+                background-color: %6;
+            }
+            QPushButton:disabled {
+                background-color: %1;
+                color: %8;
+                border-color: %3;
+            }
+        )")
+        .arg(colorCss(ColorRole::Surface))
+        .arg(colorCss(ColorRole::TextPrimary))
+        .arg(colorCss(ColorRole::Border))
+        .arg(colorCss(ColorRole::SurfaceHover))
+        .arg(colorCss(ColorRole::BorderActive))
+        .arg(colorCss(ColorRole::BackgroundDark))
+        .arg(m_borderRadius)
+        .arg(colorCss(ColorRole::TextDisabled));
+    });
 }
 
 QString StyleManager::primaryButtonStyleSheet() const
 {
-    return QString(R"(
-        QPushButton {
-            background-color: %1;
-            color: %2;
-            border: none;
-            border-radius: %6px;
-            padding: 10px 20px;
-            font-weight: 600;
-            min-height: 22px;
-        }
-        QPushButton:hover {
-            background-color: %3;
-        }
-        QPushButton:pressed {
-            background-color: %4;
-        }
-        QPushButton:disabled {
-            background-color: %5;
-            color: %7;
-        }
-    )")
-    .arg(colorCss(ColorRole::AccentPrimary))
-    .arg(colorCss(ColorRole::BackgroundDark))
-    .arg(colorCss(ColorRole::AccentSecondary))
-    .arg(colorCss(ColorRole::AccentSecondary))
-    .arg(colorCss(ColorRole::Surface))
-    .arg(m_borderRadius)
-    .arg(colorCss(ColorRole::TextDisabled));
+    return cachedSheet(sheetKey(Sheet::PrimaryButton), [this]() {
+        return QString(R"(
+            QPushButton {
+                background-color: %1;
+                color: %2;
+                border: none;
+                border-radius: %6px;
+                padding: 10px 20px;
+                font-weight: 600;
+                min-height: 22px;
+            }
+            QPushButton:hover {
+                background-color: %3;
+            }
+            QPushButton:pressed {
+                background-color: %4;
+            }
+            QPushButton:disabled {
+                background-color: %5;
+                color: %7;
+            }
+        )")
+        .arg(colorCss(ColorRole::AccentPrimary))
+        .arg(colorCss(ColorRole::BackgroundDark))
+        .arg(colorCss(ColorRole::AccentSecondary))
+        .arg(colorCss(ColorRole::AccentSecondary))
+        .arg(colorCss(ColorRole::Surface))
+        .arg(m_borderRadius)
+        .arg(colorCss(ColorRole::TextDisabled));
+    });
 }
 
 QString StyleManager::dangerButtonStyleSheet() const
 {
-    return QString(R"(
-        QPushButton {
-            background-color: transparent;
-            color: %1;
-            border: 1px solid %1;
-            border-radius: %4px;
-            padding: 8px 16px;
-            font-weight: 500;
-        }
-        QPushButton:hover {
-            background-color: %2;
-            color: %3;
-        }
-        QPushButton:pressed {
-            background-color: %1;
-        }
-    )")
-    .arg(colorCss(ColorRole::Error))
-    .arg(colorCss(ColorRole::Error))
-    .arg(colorCss(ColorRole::TextPrimary))
-    .arg(m_borderRadius);
+    return cachedSheet(sheetKey(Sheet::DangerButton), [this]() {
+        return QString(R"(
+            QPushButton {
+                background-color: transparent;
+                color: %1;
+                border: 1px solid %1;
+                border-radius: %4px;
+                padding: 8px 16px;
+                font-weight: 500;
+            }
+            QPushButton:hover {
+                background-color: %2;
+                color: %3;
+            }
+            QPushButton:pressed {
+                background-color: %1;
+            }
+        )")
+        .arg(colorCss(ColorRole::Error))
+        .arg(colorCss(ColorRole::Error))
+        .arg(colorCss(ColorRole::TextPrimary))
+        .arg(m_borderRadius);
+    });
 }
 
 QString StyleManager::listWidgetStyleSheet() const
 {
-    return QString(R"(
-        QListWidget {
-            background-color: %1;
-            border: 1px solid %2;
-            border-radius: %6px;
-            padding: 4px;
-            outline: none;
-        }
-        QListWidget::item {
-            background-color: transparent;
-            color: %3;
-            padding: 8px 12px;
-            border-radius: 4px;
-            margin: 2px 0;
-        }
-        QListWidget::item:hover {
-            background-color: %4;
-        }
-        QListWidget::item:selected {
-            background-color: %5;
-            color: %3;
-        }
-    )")
-    .arg(colorCss(ColorRole::BackgroundAlt))
-    .arg(colorCss(ColorRole::Border))
-    .arg(colorCss(ColorRole::TextPrimary))
-    .arg(colorCss(ColorRole::SurfaceHover))
-    .arg(colorCss(ColorRole::AccentPrimary) + "40")  // 25% opacity
-    .arg(m_borderRadius);
+    return cachedSheet(sheetKey(Sheet::ListWidget), [this]() {
+        return QString(R"(
+            QListWidget {
+                background-color: %1;
+                border: 1px solid %2;
+                border-radius: %6px;
+                padding: 4px;
+                outline: none;
+            }
+            QListWidget::item {
+                background-color: transparent;
+                color: %3;
+                padding: 8px 12px;
+                border-radius: 4px;
+                margin: 2px 0;
+            }
+            QListWidget::item:hover {
+                background-color: %4;
+            }
+            QListWidget::item:selected {
+                background-color: %5;
+                color: %3;
+            }
+        )")
+        .arg(colorCss(ColorRole::BackgroundAlt))
+        .arg(colorCss(ColorRole::Border))
+        .arg(colorCss(ColorRole::TextPrimary))
+        .arg(colorCss(ColorRole::SurfaceHover))
+        .arg(colorCss(ColorRole::AccentPrimary) + "40")  // 25% opacity
+        .arg(m_borderRadius);
+    });
 }
 
 QString StyleManager::progressBarStyleSheet() const
 {
-    return QString(R"(
-        QProgressBar {
-            background-color: %1;
-            border: none;
-            border-radius: 4px;
-            height: 8px;
-            text-align: center;
-        }
-        QProgressBar::chunk {
-            background: qlineargradient(x1:0, y1:0, x2:1, y2:0,
-                stop:0 %2, stop:1 %3);
-            border-radius: 4px;
-        }
-    )")
-    .arg(colorCss(ColorRole::BackgroundDark))
-    .arg(colorCss(ColorRole::AccentSecondary))
-    .arg(colorCss(ColorRole::AccentPrimary));
+    return cachedSheet(sheetKey(Sheet::ProgressBar), [this]() {
+        return QString(R"(
+            QProgressBar {
+                background-color: %1;
+                border: none;
+                border-radius: 4px;
+                height: 8px;
+                text-align: center;
+            }
+            QProgressBar::chunk {
+                background: qlineargradient(x1:0, y1:0, x2:1, y2:0,
+                    stop:0 %2, stop:1 %3);
+                border-radius: 4px;
+            }
+        )")
+        .arg(colorCss(ColorRole::BackgroundDark))
+        .arg(colorCss(ColorRole::AccentSecondary))
+        .arg(colorCss(ColorRole::AccentPrimary));
+    });
 }
 
 QString StyleManager::inputFieldStyleSheet() const
 {
-    return QString(R"(
-        QLineEdit, QTextEdit, QPlainTextEdit {
-            background-color: %1;
-            color: %2;
-            border: 1px solid %3;
-            border-radius: %6px;
-            padding: 8px 12px;
-            selection-background-color: %5;
-        }
-        QLineEdit:focus, QTextEdit:focus, QPlainTextEdit:focus {
-            border-color: %4;
-        }
-        QLineEdit:disabled, QTextEdit:disabled {
-            background-color: %7;
-            color: %8;
-        }
-    )")
-    .arg(colorCss(ColorRole::BackgroundDark))
-    .arg(colorCss(ColorRole::TextPrimary))
-    .arg(colorCss(ColorRole::Border))
-    .arg(colorCss(ColorRole::AccentPrimary))
-    .arg(colorCss(ColorRole::AccentPrimary) + "40")
-    .arg(m_borderRadius)
-    .arg(colorCss(ColorRole::Surface))
-    .arg(colorCss(ColorRole::TextDisabled));
+    return cachedSheet(sheetKey(Sheet::InputField), [this]() {
+        return QString(R"(
+            QLineEdit, QTextEdit, QPlainTextEdit {
+                background-color: %1;
+                color: %2;
+                border: 1px solid %3;
+                border-radius: %6px;
+                padding: 8px 12px;
+                selection-background-color: %5;
+            }
+            QLineEdit:focus, QTextEdit:focus, QPlainTextEdit:focus {
+                border-color: %4;
+            }
+            QLineEdit:disabled, QTextEdit:disabled {
+                background-color: %7;
+                color: %8;
+            }
+        )")
+        .arg(colorCss(ColorRole::BackgroundDark))
+        .arg(colorCss(ColorRole::TextPrimary))
+        .arg(colorCss(ColorRole::Border))
+        .arg(colorCss(ColorRole::AccentPrimary))
+        .arg(colorCss(ColorRole::AccentPrimary) + "40")
+        .arg(m_borderRadius)
+        .arg(colorCss(ColorRole::Surface))
+        .arg(colorCss(ColorRole::TextDisabled));
+    });
 }
 
 QString StyleManager::labelStyleSheet() const
 {
-    return QString(R"(
-        QLabel {
-            color: %1;
-            background: transparent;
-        }
-        QLabel#heading {
-            color: %2;
-            font-weight: 600;
-        }
-        QLabel#muted {
-            color: %3;
-        }
-    )")
-    .arg(colorCss(ColorRole::TextPrimary))
-    .arg(colorCss(ColorRole::AccentPrimary))
-    .arg(colorCss(ColorRole::TextMuted));
+    return cachedSheet(sheetKey(Sheet::Label), [this]() {
+        return QString(R"(
+            QLabel {
+                color: %1;
+                background: transparent;
+            }
+            QLabel#heading {
+                color: %2;
+                font-weight: 600;
+            }
+            QLabel#muted {
+                color: %3;
+            }
+        )")
+        .arg(colorCss(ColorRole::TextPrimary))
+        .arg(colorCss(ColorRole::AccentPrimary))
+        .arg(colorCss(ColorRole::TextMuted));
+    });
 }
 
 QString StyleManager::scrollAreaStyleSheet() const
 {
-    return QString(R"(
-        QScrollArea {
-            background: transparent;
-            border: none;
-        }
-        QScrollBar:vertical {
-            background-color: %1;
-            width: 10px;
-            margin: 0;
-            border-radius: 5px;
-        }
-        QScrollBar::handle:vertical {
-            background-color: %2;
-            min-height: 30px;
-            border-radius: 5px;
-            margin: 2px;
-        }
-        QScrollBar::handle:vertical:hover {
-            background-color: %3;
-        }
-        QScrollBar::add-line:vertical, QScrollBar::sub-line:vertical {
-            height: 0;
-        }
-        QScrollBar:horizontal {
-            background-color: %1;
-            height: 10px;
-            margin: 0;
-            border-radius: 5px;
-        }
-        QScrollBar::handle:horizontal {
-            background-color: %2;
-            min-width: 30px;
-            border-radius: 5px;
-            margin: 2px;
-        }
-        QScrollBar::handle:horizontal:hover {
-            background-color: %3;
-        }
-        QScrollBar::add-line:horizontal, QScrollBar::sub-line:horizontal {
-            width: 0;
-        }
-    )")
-    .arg(colorCss(ColorRole::BackgroundDark))
-    .arg(colorCss(ColorRole::Border))
-    .arg(colorCss(ColorRole::AccentSecondary));
+    return cachedSheet(sheetKey(Sheet::ScrollArea), [this]() {
+        return QString(R"(
+            QScrollArea {
+                background: transparent;
+                border: none;
+            }
+            QScrollBar:vertical {
+                background-color: %1;
+                width: 10px;
+                margin: 0;
+                border-radius: 5px;
+            }
+            QScrollBar::handle:vertical {
+                background-color: %2;
+                min-height: 30px;
+                border-radius: 5px;
+                margin: 2px;
+            }
+            QScrollBar::handle:vertical:hover {
+                background-color: %3;
+            }
+            QScrollBar::add-line:vertical, QScrollBar::sub-line:vertical {
+                height: 0;
+            }
+            QScrollBar:horizontal {
+                background-color: %1;
+                height: 10px;
+                margin: 0;
+                border-radius: 5px;
+            }
+            QScrollBar::handle:horizontal {
+                background-color: %2;
+                min-width: 30px;
+                border-radius: 5px;
+                margin: 2px;
+            }
+            QScrollBar::handle:horizontal:hover {
+                background-color: %3;
+            }
+            QScrollBar::add-line:horizontal, QScrollBar::sub-line:horizontal {
+                width: 0;
+            }
+        )")
+        .arg(colorCss(ColorRole::BackgroundDark))
+        .arg(colorCss(ColorRole::Border))
+        .arg(colorCss(ColorRole::AccentSecondary));
+    });
 }
 
 QString StyleManager::compactTableButtonStyleSheet() const
 {
-    return buttonStyleSheet()
-           + QStringLiteral(
-                 " QPushButton { min-height: 20px; max-height: 20px; padding: 2px 10px; font-size: 11px; }");
+    return cachedSheet(sheetKey(Sheet::CompactTableButton), [this]() {
+        return buttonStyleSheet()
+               + QStringLiteral(
+                     " QPushButton { min-height: 20px; max-height: 20px; padding: 2px 10px; font-size: 11px; }");
+    });
 }
 
 QString StyleManager::dataTableStyleSheet() const
 {
-    return QString(R"(
-        QTableWidget {
-            background-color: %1;
-            alternate-background-color: %2;
-            color: %3;
-            gridline-color: %4;
-            border: 1px solid %4;
-            border-radius: 8px;
-        }
-        QTableWidget::item {
-            padding: 6px 8px;
-        }
-        QTableWidget::item:selected {
-            background-color: %5;
-            color: %3;
-        }
-        QHeaderView::section {
-            background-color: %6;
-            color: %7;
-            padding: 8px;
-            border: none;
-            border-bottom: 1px solid %4;
-            font-weight: 600;
-        }
-    )")
-        .arg(colorCss(ColorRole::Surface))
-        .arg(colorCss(ColorRole::BackgroundAlt))
-        .arg(colorCss(ColorRole::TextPrimary))
-        .arg(colorCss(ColorRole::Border))
-        .arg(colorCss(ColorRole::SurfaceHover))
-        .arg(colorCss(ColorRole::BackgroundAlt))
-        .arg(colorCss(ColorRole::TextSecondary));
+    return cachedSheet(sheetKey(Sheet::DataTable), [this]() {
+        return QString(R"(
+            QTableWidget {
+                background-color: %1;
+                alternate-background-color: %2;
+                color: %3;
+                gridline-color: %4;
+                border: 1px solid %4;
+                border-radius: 8px;
+            }
+            QTableWidget::item {
+                padding: 6px 8px;
+            }
+            QTableWidget::item:selected {
+                background-color: %5;
+                color: %3;
+            }
+            QHeaderView::section {
+                background-color: %6;
+                color: %7;
+                padding: 8px;
+                border: none;
+                border-bottom: 1px solid %4;
+                font-weight: 600;
+            }
+        )")
+            .arg(colorCss(ColorRole::Surface))
+            .arg(colorCss(ColorRole::BackgroundAlt))
+            .arg(colorCss(ColorRole::TextPrimary))
+            .arg(colorCss(ColorRole::Border))
+            .arg(colorCss(ColorRole::SurfaceHover))
+            .arg(colorCss(ColorRole::BackgroundAlt))
+            .arg(colorCss(ColorRole::TextSecondary));
+    });
 }
 
 QString StyleManager::tooltipStyleSheet() const
 {
-    return QString(R"(
-        QToolTip {
-            background-color: %1;
-            color: %2;
-            border: 1px solid %3;
-            border-radius: 4px;
-            padding: 6px 10px;
-        }
-    )")
-    .arg(colorCss(ColorRole::Surface))
-    .arg(colorCss(ColorRole::TextPrimary))
-    .arg(colorCss(ColorRole::Border));
+    return cachedSheet(sheetKey(Sheet::Tooltip), [this]() {
+        return QString(R"(
+            QToolTip {
+                background-color: %1;
+                color: %2;
+                border: 1px solid %3;
+                border-radius: 4px;
+                padding: 6px 10px;
+            }
+        )")
+        .arg(colorCss(ColorRole::Surface))
+        .arg(colorCss(ColorRole::TextPrimary))
+        .arg(colorCss(ColorRole::Border));
+    });
 }
 
 QString StyleManager::dialogStyleSheet() const
 {
-    return QString(R"(
-        QDialog {
-            background-color: %1;
-        }
-        QDialogButtonBox QPushButton {
-            min-width: 80px;
-        }
-    )")
-    .arg(colorCss(ColorRole::Background));
+    return cachedSheet(sheetKey(Sheet::Dialog), [this]() {
+        return QString(R"(
+            QDialog {
+                background-color: %1;
+            }
+            QDialogButtonBox QPushButton {
+                min-width: 80px;
+            }
+        )")
+        .arg(colorCss(ColorRole::Background));
+    });
 }
 
 QString StyleManager::menuStyleSheet() const
 {
-    return QString(R"(
-        QMenu {
-            background-color: %1;
-            border: 1px solid %2;
-            border-radius: %5px;
-            padding: 4px;
-        }
-        QMenu::item {
-            color: %3;
-            padding: 8px 24px 8px 12px;
-            border-radius: 4px;
-            margin: 2px 4px;
-        }
-        QMenu::item:selected {
-            background-color: %4;
-        }
-        QMenu::separator {
-            height: 1px;
-            background-color: %2;
-            margin: 4px 8px;
-        }
-        QMenu::icon {
-            margin-left: 8px;
-        }
-        QMenuBar {
-            background-color: %1;
-            color: %3;
-            border-bottom: 1px solid %2;
-        }
-        QMenuBar::item {
-            padding: 8px 12px;
-            background: transparent;
-        }
-        QMenuBar::item:selected {
-            background-color: %4;
-        }
-    )")
-    .arg(colorCss(ColorRole::Surface))
-    .arg(colorCss(ColorRole::Border))
-    .arg(colorCss(ColorRole::TextPrimary))
-    .arg(colorCss(ColorRole::SurfaceHover))
-    .arg(m_borderRadius);
+    return cachedSheet(sheetKey(Sheet::Menu), [this]() {
+        return QString(R"(
+            QMenu {
+                background-color: %1;
+                border: 1px solid %2;
+                border-radius: %5px;
+                padding: 4px;
+            }
+            QMenu::item {
+                color: %3;
+                padding: 8px 24px 8px 12px;
+                border-radius: 4px;
+                margin: 2px 4px;
+            }
+            QMenu::item:selected {
+                background-color: %4;
+            }
+            QMenu::separator {
+                height: 1px;
+                background-color: %2;
+                margin: 4px 8px;
+            }
+            QMenu::icon {
+                margin-left: 8px;
+            }
+            QMenuBar {
+                background-color: %1;
+                color: %3;
+                border-bottom: 1px solid %2;
+            }
+            QMenuBar::item {
+                padding: 8px 12px;
+                background: transparent;
+            }
+            QMenuBar::item:selected {
+                background-color: %4;
+            }
+        )")
+        .arg(colorCss(ColorRole::Surface))
+        .arg(colorCss(ColorRole::Border))
+        .arg(colorCss(ColorRole::TextPrimary))
+        .arg(colorCss(ColorRole::SurfaceHover))
+        .arg(m_borderRadius);
+    });
 }
 
 QString StyleManager::tabWidgetStyleSheet() const
 {
-    return QString(R"(
-        QTabWidget::pane {
-            background-color: %1;
-            border: 1px solid %2;
-            border-radius: %6px;
-            top: -1px;
-        }
-        QTabBar::tab {
-            background-color: %3;
-            color: %4;
-            border: 1px solid %2;
-            border-bottom: none;
-            border-top-left-radius: %6px;
-            border-top-right-radius: %6px;
-            padding: 10px 20px;
-            margin-right: 2px;
-        }
-        QTabBar::tab:selected {
-            background-color: %1;
-            color: %5;
-            border-bottom: 2px solid %5;
-        }
-        QTabBar::tab:hover:!selected {
-            background-color: %7;
-        }
-    )")
-    .arg(colorCss(ColorRole::Surface))
-    .arg(colorCss(ColorRole::Border))
-    .arg(colorCss(ColorRole::BackgroundAlt))
-    .arg(colorCss(ColorRole::TextSecondary))
-    .arg(colorCss(ColorRole::AccentPrimary))
-    .arg(m_borderRadius)
-    .arg(colorCss(ColorRole::SurfaceHover));
-}
-
-QString StyleManager::tabBarStyleSheet() const
-{
-    return QString(R"(
-        QTabBar {
-            background: transparent;
-        }
-        QTabBar::tab {
-            background-color: transparent;
-            color: %3;
-            border: none;
-            border-bottom: 2px solid transparent;
-            padding: 8px 16px;
-            margin-right: 4px;
-            font-weight: 600;
-        }
-        QTabBar::tab:selected {
-            color: %4;
-            border-bottom: 2px solid %4;
-        }
-        QTabBar::tab:hover:!selected {
-            color: %5;
-            border-bottom: 2px solid %6;
-        }
-    )")
+    return cachedSheet(sheetKey(Sheet::TabWidget), [this]() {
+        return QString(R"(
+            QTabWidget::pane {
+                background-color: %1;
+                border: 1px solid %2;
+                border-radius: %6px;
+                top: -1px;
+            }
+            QTabBar::tab {
+                background-color: %3;
+                color: %4;
+                border: 1px solid %2;
+                border-bottom: none;
+                border-top-left-radius: %6px;
+                border-top-right-radius: %6px;
+                padding: 10px 20px;
+                margin-right: 2px;
+            }
+            QTabBar::tab:selected {
+                background-color: %1;
+                color: %5;
+                border-bottom: 2px solid %5;
+            }
+            QTabBar::tab:hover:!selected {
+                background-color: %7;
+            }
+        )")
         .arg(colorCss(ColorRole::Surface))
         .arg(colorCss(ColorRole::Border))
+        .arg(colorCss(ColorRole::BackgroundAlt))
         .arg(colorCss(ColorRole::TextSecondary))
         .arg(colorCss(ColorRole::AccentPrimary))
-        .arg(colorCss(ColorRole::TextPrimary))
-        .arg(colorCss(ColorRole::BorderActive));
+        .arg(m_borderRadius)
+        .arg(colorCss(ColorRole::SurfaceHover));
+    });
+}
+
+QString StyleManager::tabBarStyleSheet() const
+{
+    return cachedSheet(sheetKey(Sheet::TabBar), [this]() {
+        return QString(R"(
+            QTabBar {
+                background: transparent;
+            }
+            QTabBar::tab {
+                background-color: transparent;
+                color: %3;
+                border: none;
+                border-bottom: 2px solid transparent;
+                padding: 8px 16px;
+                margin-right: 4px;
+                font-weight: 600;
+            }
+            QTabBar::tab:selected {
+                color: %4;
+                border-bottom: 2px solid %4;
+            }
+            QTabBar::tab:hover:!selected {
+                color: %5;
+                border-bottom: 2px solid %6;
+            }
+        )")
+            .arg(colorCss(ColorRole::Surface))
+            .arg(colorCss(ColorRole::Border))
+            .arg(colorCss(ColorRole::TextSecondary))
+            .arg(colorCss(ColorRole::AccentPrimary))
+            .arg(colorCss(ColorRole::TextPrimary))
+            .arg(colorCss(ColorRole::BorderActive));
+    });
 }
 
 QString StyleManager::messageBoxStyleSheet() const
 {
-    return QString(R"(
-        QMessageBox {
-            background-color: %1;
-            color: %2;
-        }
-        QMessageBox QLabel {
-            color: %2;
-            min-width: 320px;
-        }
-        QMessageBox QPushButton {
-            %3
-            min-width: 88px;
-            padding: 8px 16px;
-        }
-    )")
-        .arg(colorCss(ColorRole::Surface))
-        .arg(colorCss(ColorRole::TextPrimary))
-        .arg(buttonStyleSheet());
+    return cachedSheet(sheetKey(Sheet::MessageBox), [this]() {
+        return QString(R"(
+            QMessageBox {
+                background-color: %1;
+                color: %2;
+            }
+            QMessageBox QLabel {
+                color: %2;
+                min-width: 320px;
+            }
+            QMessageBox QPushButton {
+                %3
+                min-width: 88px;
+                padding: 8px 16px;
+            }
+        )")
+            .arg(colorCss(ColorRole::Surface))
+            .arg(colorCss(ColorRole::TextPrimary))
+            .arg(buttonStyleSheet());
+    });
 }
 
 QString StyleManager::statusIndicatorStyleSheet(ColorRole statusColor) const
 {
-    return QString(R"(
-        QLabel#StatusIndicator {
-            background-color: %1;
-            border-radius: 6px;
-            min-width: 12px;
-            min-height: 12px;
-            max-width: 12px;
-            max-height: 12px;
-        }
-    )")
-    .arg(colorCss(statusColor));
+    return cachedSheet(sheetKey(Sheet::StatusIndicator, statusColor), [this, statusColor]() {
+        return QString(R"(
+            QLabel#StatusIndicator {
+                background-color: %1;
+                border-radius: 6px;
+                min-width: 12px;
+                min-height: 12px;
+                max-width: 12px;
+                max-height: 12px;
+            }
+        )")
+        .arg(colorCss(statusColor));
+    });
 }
 
 QString StyleManager::statusBadgeStyleSheet(ColorRole background, ColorRole foreground) const
 {
-    return QStringLiteral(
-               "QLabel#StatusBadge { background-color: %1; color: %2; padding: 4px 12px; "
-               "border-radius: 10px; font-weight: 600; letter-spacing: 0.5px; }")
-        .arg(colorCss(background), colorCss(foreground));
+    return cachedSheet(sheetKey(Sheet::StatusBadge, background, foreground), [this, background, foreground]() {
+        return QStringLiteral(
+                   "QLabel#StatusBadge { background-color: %1; color: %2; padding: 4px 12px; "
+                   "border-radius: 10px; font-weight: 600; letter-spacing: 0.5px; }")
+            .arg(colorCss(background), colorCss(foreground));
+    });
 }
 
 std::unique_ptr<QPropertyAnimation> StyleManager::createGlowAnimation(
@@ -934,39 +1043,62 @@ void StyleManager::loadTheme(Theme theme)
 
 void StyleManager::generateStyleSheet()
 {
-    m_cachedStyleSheet = QString(R"(
-        * {
-            font-family: "Segoe UI", "SF Pro Display", -apple-system, sans-serif;
-            font-size: %1px;
-        }
+    m_cachedStyleSheet = cachedSheet(sheetKey(Sheet::Application), [this]() {
+        QString sheet = QString(R"(
+                * {
+                    font-family: "Segoe UI", "SF Pro Display", -apple-system, sans-serif;
+                    font-size: %1px;
+                }
         
-        QWidget {
-            background-color: %2;
-            color: %3;
-        }
+                QWidget {
+                    background-color: %2;
+                    color: %3;
+                }
         
-        %4
-        %5
-        %6
-        %7
-        %8
-        %9
-        %10
-        %11
-        %12
-    )")
-    .arg(m_baseFontSize)
-    .arg(colorCss(ColorRole::Background))
-    .arg(colorCss(ColorRole::TextPrimary))
-    .arg(buttonStyleSheet())
-    .arg(listWidgetStyleSheet())
-    .arg(progressBarStyleSheet())
-    .arg(inputFieldStyleSheet())
-    .arg(scrollAreaStyleSheet())
-    .arg(tooltipStyleSheet())
-    .arg(menuStyleSheet())
-    .arg(tabWidgetStyleSheet())
-    .arg(labelStyleSheet());
+                %4
+                %5
+                %6
+                %7
+                %8
+                %9
+                %10
+                %11
+                %12
+            )")
+            .arg(m_baseFontSize)
+            .arg(colorCss(ColorRole::Background))
+            .arg(colorCss(ColorRole::TextPrimary))
+            .arg(buttonStyleSheet())
+            .arg(listWidgetStyleSheet())
+            .arg(progressBarStyleSheet())
+            .arg(inputFieldStyleSheet())
+            .arg(scrollAreaStyleSheet())
+            .arg(tooltipStyleSheet())
+            .arg(menuStyleSheet())
+            .arg(tabWidgetStyleSheet())
+            .arg(labelStyleSheet());
+
+        // Rules for widgets that rely on the application stylesheet instead of their own.
+        sheet += deviceCardStyleSheet();
+        sheet += scopedSheet(primaryButtonStyleSheet(), QStringLiteral("QPushButton"),
+                             QStringLiteral("QPushButton[fsVariant=\"primary\"]"));
+        sheet += scopedSheet(dangerButtonStyleSheet(), QStringLiteral("QPushButton"),
+                             QStringLiteral("QPushButton[fsVariant=\"danger\"]"));
+        for (ColorRole role : {ColorRole::TextPrimary, ColorRole::TextSecondary, ColorRole::TextMuted,
+                               ColorRole::AccentPrimary}) {
+            sheet += QStringLiteral(" QLabel[fsText=\"%1\"] { color: %2; }").arg(colorRoleKey(role), colorCss(role));
+        }
+        sheet += scopedSheet(statusBadgeStyleSheet(ColorRole::Surface, ColorRole::TextSecondary),
+                             QStringLiteral("QLabel#StatusBadge"),
+                             QStringLiteral("QLabel#StatusBadge[fsStatus=\"Surface\"]"));
+        for (ColorRole role : {ColorRole::Verified, ColorRole::Modified, ColorRole::Unknown, ColorRole::Hashing,
+                               ColorRole::Error}) {
+            sheet += scopedSheet(statusBadgeStyleSheet(role, ColorRole::BackgroundDark),
+                                 QStringLiteral("QLabel#StatusBadge"),
+                                 QStringLiteral("QLabel#StatusBadge[fsStatus=\"%1\"]").arg(colorRoleKey(role)));
+        }
+        return sheet;
+    });
 }
 
 } // namespace FlashSpartan
\ No newline at end of file
@@ -19,6 +19,8 @@ TrayIcon::TrayIcon(QObject* parent)
     m_animationTimer = new QTimer(this);
     m_animationTimer->setInterval(ANIMATION_INTERVAL_MS);
     connect(m_animationTimer, &QTimer::timeout, this, &TrayIcon::updateHashingAnimation);
+
+    connect(&m_notifications, &NotificationCoalescer::deliver, this, &TrayIcon::deliverNotice);
 }
 
 TrayIcon::~TrayIcon()
@@ -92,10 +94,48 @@ void TrayIcon::showNotification(const QString& title,
                                  const QString& message,
                                  QSystemTrayIcon::MessageIcon icon,
                                  int duration)
+{
+    post(TrayNotice::Category::General, title, message, icon, duration);
+}
+
+void TrayIcon::setNotificationsEnabled(bool enabled)
+{
+    m_notificationsEnabled = enabled;
+    if (!enabled) {
+        m_notifications.clear();
+    }
+}
+
+void TrayIcon::post(TrayNotice::Category category, const QString& title, const QString& message,
+                    QSystemTrayIcon::MessageIcon icon, int duration, bool failed)
 {
     if (!m_notificationsEnabled || !m_trayIcon) return;
-    
-    m_trayIcon->showMessage(title, message, icon, duration);
+
+    TrayNotice notice;
+    notice.category = category;
+    notice.title = title;
+    notice.message = message;
+    if (icon == QSystemTrayIcon::Critical) {
+        notice.level = TrayNotice::Level::Critical;
+    } else if (icon == QSystemTrayIcon::Warning) {
+        notice.level = TrayNotice::Level::Warning;
+    }
+    notice.durationMs = duration;
+    notice.failed = failed;
+    m_notifications.post(notice);
+}
+
+void TrayIcon::deliverNotice(const TrayNotice& notice)
+{
+    if (!m_notificationsEnabled || !m_trayIcon) return;
+
+    QSystemTrayIcon::MessageIcon icon = QSystemTrayIcon::Information;
+    if (notice.level == TrayNotice::Level::Critical) {
+        icon = QSystemTrayIcon::Critical;
+    } else if (notice.level == TrayNotice::Level::Warning) {
+        icon = QSystemTrayIcon::Warning;
+    }
+    m_trayIcon->showMessage(notice.title, notice.message, icon, notice.durationMs);
 }
 
 void TrayIcon::notifyDeviceConnected(const DeviceInfo& device, bool isKnown)
@@ -110,7 +150,7 @@ void TrayIcon::notifyDeviceConnected(const DeviceInfo& device, bool isKnown)
     QSystemTrayIcon::MessageIcon icon = isKnown ? 
         QSystemTrayIcon::Information : QSystemTrayIcon::Warning;
     
-    showNotification(title, message, icon);
+    post(TrayNotice::Category::DeviceConnected, title, message, icon, 3000, !isKnown);
     
     if (!isKnown) {
         setIconState(IconState::Warning);
@@ -121,9 +161,9 @@ void TrayIcon::notifyDeviceDisconnected(const QString& deviceName)
 {
     if (!m_notificationsEnabled) return;
     
-    showNotification("Device Disconnected", 
-                     deviceName + " was safely removed.",
-                     QSystemTrayIcon::Information);
+    post(TrayNotice::Category::DeviceRemoved, "Device Disconnected",
+         deviceName + " was safely removed.",
+         QSystemTrayIcon::Information);
 }
 
 void TrayIcon::notifyVerificationResult(const QString& deviceName, 
@@ -134,12 +174,15 @@ void TrayIcon::notifyVerificationResult(const QString& deviceName,
     QString title;
     QString message;
     QSystemTrayIcon::MessageIcon icon;
+    TrayNotice::Category category = TrayNotice::Category::Verification;
+    bool failed = true;
     
     switch (status) {
         case VerificationStatus::Verified:
             title = "Device Verified ✓";
             message = deviceName + " matches stored hash.";
             icon = QSystemTrayIcon::Information;
+            failed = false;
             setIconState(IconState::Normal);
             break;
             
@@ -147,6 +190,7 @@ void TrayIcon::notifyVerificationResult(const QString& deviceName,
             title = "⚠️ SECURITY ALERT";
             message = deviceName + " may be tampered. Use Approve fingerprint or Mount anyway in the alert.";
             icon = QSystemTrayIcon::Critical;
+            category = TrayNotice::Category::Security;
             setIconState(IconState::Warning);
             break;
             
@@ -168,7 +212,7 @@ void TrayIcon::notifyVerificationResult(const QString& deviceName,
             return;
     }
     
-    showNotification(title, message, icon);
+    post(category, title, message, icon, 3000, failed);
 }
 
 void TrayIcon::notifyHashCompleted(const QString& deviceName, 
@@ -192,7 +236,7 @@ void TrayIcon::notifyHashCompleted(const QString& deviceName,
         .arg(duration)
         .arg(speedMBps, 0, 'f', 1);
     
-    showNotification("Hash Complete", message, QSystemTrayIcon::Information);
+    post(TrayNotice::Category::HashCompleted, "Hash Complete", message, QSystemTrayIcon::Information);
 }
 
 void TrayIcon::notifyIsoVerifySummary(const QString& deviceName, int passed, int total,
@@ -212,7 +256,8 @@ void TrayIcon::notifyIsoVerifySummary(const QString& deviceName, int passed, int
         icon = needsSidecar > 0 ? QSystemTrayIcon::Warning : QSystemTrayIcon::Critical;
     }
 
-    showNotification(QStringLiteral("ISO verification"), message, icon);
+    post(TrayNotice::Category::IsoVerify, QStringLiteral("ISO verification"), message, icon, 3000,
+         passed < total);
 }
 
 void TrayIcon::notifyBadUsbAnomaly(const BadUsbAnomalyResult& anomaly)
@@ -222,11 +267,30 @@ void TrayIcon::notifyBadUsbAnomaly(const BadUsbAnomalyResult& anomaly)
     }
     const bool critical = anomaly.severity == BadUsbSeverity::Critical;
     setIconState(critical ? IconState::Error : IconState::Warning);
-    showNotification(critical ? QStringLiteral("BadUSB critical alert")
-                              : QStringLiteral("BadUSB behavior alert"),
-                     QStringLiteral("%1\n%2").arg(anomaly.summary, anomaly.device.displayName()),
-                     critical ? QSystemTrayIcon::Critical : QSystemTrayIcon::Warning,
-                     8000);
+    post(TrayNotice::Category::Security,
+         critical ? QStringLiteral("BadUSB critical alert") : QStringLiteral("BadUSB behavior alert"),
+         QStringLiteral("%1\n%2").arg(anomaly.summary, anomaly.device.displayName()),
+         critical ? QSystemTrayIcon::Critical : QSystemTrayIcon::Warning, 8000, true);
+}
+
+void TrayIcon::notifyReadAnomaly(const QString& deviceName, const QString& detail)
+{
+    if (!m_notificationsEnabled) {
+        return;
+    }
+    post(TrayNotice::Category::ReadAnomaly, QStringLiteral("Read speed anomaly"),
+         QStringLiteral("%1\n%2\nCounterfeit or failing flash often reads like this.").arg(deviceName, detail),
+         QSystemTrayIcon::Warning, 8000, true);
+}
+
+void TrayIcon::notifyCounterfeitCapacity(const QString& deviceName, const QString& detail)
+{
+    if (!m_notificationsEnabled) {
+        return;
+    }
+    post(TrayNotice::Category::Security, QStringLiteral("Counterfeit capacity"),
+         QStringLiteral("%1\n%2\nData written past the real size will be lost.").arg(deviceName, detail),
+         QSystemTrayIcon::Critical, 10000, true);
 }
 
 void TrayIcon::updateDeviceList(const QList<DeviceInfo>& devices)
@@ -265,6 +329,18 @@ void TrayIcon::updateDeviceList(const QList<DeviceInfo>& devices)
         });
     }
     
+    if (devices.size() > 1) {
+        m_devicesMenu->addSeparator();
+        QAction* ejectAllAction = m_devicesMenu->addAction("⏏ Eject all");
+        connect(ejectAllAction, &QAction::triggered, this, [this]() {
+            QStringList deviceNodes;
+            for (const auto& device : m_currentDevices) {
+                deviceNodes.append(device.deviceNode);
+            }
+            emit ejectAllRequested(deviceNodes);
+        });
+    }
+    
     setDeviceCount(devices.size(), m_whitelistedDevices);
 }
 
@@ -0,0 +1,228 @@
+#include "UDisksObjectCache.h"
+
+#ifndef Q_OS_WIN
+
+#include <QByteArrayList>
+#include <QMutexLocker>
+
+namespace FlashSpartan {
+
+namespace {
+
+const QString kManagerPath = QStringLiteral("/org/freedesktop/UDisks2/Manager");
+
+} // namespace
+
+void UDisksObjectCache::reset(const QHash<QString, Interfaces>& objects)
+{
+    QMutexLocker locker(&m_mutex);
+    m_objects = objects;
+    m_blockByDevice.clear();
+    m_devicesByBlock.clear();
+    for (auto it = m_objects.cbegin(); it != m_objects.cend(); ++it) {
+        indexLocked(it.key());
+    }
+    m_loaded = true;
+}
+
+void UDisksObjectCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_objects.clear();
+    m_blockByDevice.clear();
+    m_devicesByBlock.clear();
+    m_loaded = false;
+}
+
+bool UDisksObjectCache::isLoaded() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_loaded;
+}
+
+void UDisksObjectCache::addInterfaces(const QString& objectPath, const Interfaces& interfaces)
+{
+    QMutexLocker locker(&m_mutex);
+    Interfaces& object = m_objects[objectPath];
+    for (auto it = interfaces.cbegin(); it != interfaces.cend(); ++it) {
+        object.insert(it.key(), it.value());
+    }
+    indexLocked(objectPath);
+}
+
+void UDisksObjectCache::removeInterfaces(const QString& objectPath, const QStringList& interfaces)
+{
+    QMutexLocker locker(&m_mutex);
+    auto object = m_objects.find(objectPath);
+    if (object == m_objects.end()) {
+        return;
+    }
+    for (const QString& interface : interfaces) {
+        object->remove(interface);
+    }
+    if (object->isEmpty()) {
+        m_objects.erase(object);
+    }
+    indexLocked(objectPath);
+}
+
+void UDisksObjectCache::changeProperties(const QString& objectPath, const QString& interface,
+                                         const QVariantMap& changed, const QStringList& invalidated)
+{
+    QMutexLocker locker(&m_mutex);
+    auto object = m_objects.find(objectPath);
+    if (object == m_objects.end()) {
+        return;
+    }
+    auto properties = object->find(interface);
+    if (properties == object->end()) {
+        return;
+    }
+    for (auto it = changed.cbegin(); it != changed.cend(); ++it) {
+        properties->insert(it.key(), it.value());
+    }
+    for (const QString& name : invalidated) {
+        properties->remove(name);
+    }
+    if (interface == QLatin1String(kBlockInterface)) {
+        indexLocked(objectPath);
+    }
+}
+
+QString UDisksObjectCache::blockObjectPath(const QString& deviceNode) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_blockByDevice.value(deviceNode);
+}
+
+bool UDisksObjectCache::hasInterface(const QString& objectPath, const QString& interface) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto object = m_objects.constFind(objectPath);
+    return object != m_objects.cend() && object->contains(interface);
+}
+
+QVariant UDisksObjectCache::property(const QString& objectPath, const QString& interface,
+                                     const QString& name) const
+{
+    QMutexLocker locker(&m_mutex);
+    return propertyLocked(objectPath, interface, name);
+}
+
+QString UDisksObjectCache::filesystemType(const QString& deviceNode) const
+{
+    QMutexLocker locker(&m_mutex);
+    return propertyLocked(m_blockByDevice.value(deviceNode), QLatin1String(kBlockInterface),
+                          QStringLiteral("IdType"))
+        .toString();
+}
+
+QString UDisksObjectCache::driveObjectPath(const QString& deviceNode) const
+{
+    QMutexLocker locker(&m_mutex);
+    return objectPath(propertyLocked(m_blockByDevice.value(deviceNode), QLatin1String(kBlockInterface),
+                                     QStringLiteral("Drive")));
+}
+
+QStringList UDisksObjectCache::mountPoints(const QString& deviceNode) const
+{
+    QMutexLocker locker(&m_mutex);
+    return byteStringList(propertyLocked(m_blockByDevice.value(deviceNode), QLatin1String(kFilesystemInterface),
+                                         QStringLiteral("MountPoints")));
+}
+
+bool UDisksObjectCache::hasFilesystem(const QString& deviceNode) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto object = m_objects.constFind(m_blockByDevice.value(deviceNode));
+    return object != m_objects.cend() && object->contains(QLatin1String(kFilesystemInterface));
+}
+
+bool UDisksObjectCache::isLoop(const QString& deviceNode) const
+{
+    QMutexLocker locker(&m_mutex);
+    auto object = m_objects.constFind(m_blockByDevice.value(deviceNode));
+    return object != m_objects.cend() && object->contains(QLatin1String(kLoopInterface));
+}
+
+QString UDisksObjectCache::version() const
+{
+    QMutexLocker locker(&m_mutex);
+    return propertyLocked(kManagerPath, QLatin1String(kManagerInterface), QStringLiteral("Version")).toString();
+}
+
+QString UDisksObjectCache::byteString(const QVariant& value)
+{
+    QByteArray bytes = value.toByteArray();
+    const qsizetype nul = bytes.indexOf('\0');
+    if (nul >= 0) {
+        bytes.truncate(nul);
+    }
+    return QString::fromLocal8Bit(bytes);
+}
+
+QStringList UDisksObjectCache::byteStringList(const QVariant& value)
+{
+    QStringList out;
+    for (const QByteArray& bytes : value.value<QByteArrayList>()) {
+        const QString s = byteString(bytes);
+        if (!s.isEmpty()) {
+            out.append(s);
+        }
+    }
+    return out;
+}
+
+QString UDisksObjectCache::objectPath(const QVariant& value)
+{
+    const QString path = value.toString();
+    return path == QLatin1String("/") ? QString() : path;
+}
+
+QVariant UDisksObjectCache::propertyLocked(const QString& objectPath, const QString& interface,
+                                           const QString& name) const
+{
+    auto object = m_objects.constFind(objectPath);
+    if (object == m_objects.cend()) {
+        return {};
+    }
+    auto properties = object->constFind(interface);
+    return properties == object->cend() ? QVariant() : properties->value(name);
+}
+
+void UDisksObjectCache::indexLocked(const QString& objectPath)
+{
+    unindexLocked(objectPath);
+    auto object = m_objects.constFind(objectPath);
+    if (object == m_objects.cend()) {
+        return;
+    }
+    auto block = object->constFind(QLatin1String(kBlockInterface));
+    if (block == object->cend()) {
+        return;
+    }
+    QStringList keys = byteStringList(block->value(QStringLiteral("Symlinks")));
+    // Device last, so the kernel name wins over a symlink another block claims too.
+    keys.append(byteString(block->value(QStringLiteral("PreferredDevice"))));
+    keys.append(byteString(block->value(QStringLiteral("Device"))));
+    keys.removeAll(QString());
+    keys.removeDuplicates();
+    for (const QString& key : std::as_const(keys)) {
+        m_blockByDevice.insert(key, objectPath);
+    }
+    m_devicesByBlock.insert(objectPath, keys);
+}
+
+void UDisksObjectCache::unindexLocked(const QString& objectPath)
+{
+    const QStringList keys = m_devicesByBlock.take(objectPath);
+    for (const QString& key : keys) {
+        if (m_blockByDevice.value(key) == objectPath) {
+            m_blockByDevice.remove(key);
+        }
+    }
+}
+
+} // namespace FlashSpartan
+
+#endif
@@ -0,0 +1,371 @@
+#include "UdevEventTrace.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <QTimer>
+
+#include <algorithm>
+#include <cstring>
+
+#ifndef Q_OS_WIN
+#include "HidDescriptorFingerprint.h"
+
+#include <libudev.h>
+#endif
+
+namespace FlashSpartan {
+
+const char* const UdevRecord::kRecordedSysAttrs[] = {
+    // block partition
+    "size",
+    // usb_device
+    "busnum", "devnum", "idVendor", "idProduct", "serial", "manufacturer", "product", "bDeviceClass",
+    // usb_interface
+    "bInterfaceNumber", "bInterfaceClass", "bInterfaceSubClass", "bInterfaceProtocol",
+    nullptr,
+};
+
+namespace {
+
+void fail(QString* error, const QString& message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+QJsonObject mapToJson(const QHash<QByteArray, QByteArray>& map)
+{
+    QJsonObject out;
+    for (auto it = map.constBegin(); it != map.constEnd(); ++it) {
+        out.insert(QString::fromUtf8(it.key()), QString::fromUtf8(it.value()));
+    }
+    return out;
+}
+
+QHash<QByteArray, QByteArray> mapFromJson(const QJsonObject& object)
+{
+    QHash<QByteArray, QByteArray> out;
+    for (auto it = object.constBegin(); it != object.constEnd(); ++it) {
+        out.insert(it.key().toUtf8(), it.value().toString().toUtf8());
+    }
+    return out;
+}
+
+void insertText(QJsonObject& object, const char* key, const QByteArray& value)
+{
+    if (!value.isEmpty()) {
+        object.insert(QLatin1String(key), QString::fromUtf8(value));
+    }
+}
+
+QByteArray text(const QJsonObject& object, const char* key)
+{
+    return object.value(QLatin1String(key)).toString().toUtf8();
+}
+
+QByteArray headerLine()
+{
+    QJsonObject header;
+    header.insert(QStringLiteral("format"), QLatin1String(UdevEventTrace::kFormat));
+    header.insert(QStringLiteral("host"), QSysInfo::machineHostName());
+    header.insert(QStringLiteral("kernel"), QSysInfo::kernelVersion());
+    header.insert(QStringLiteral("started"), QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs));
+    return QJsonDocument(header).toJson(QJsonDocument::Compact) + '\n';
+}
+
+QByteArray eventLine(const UdevEventTrace::Event& event)
+{
+    QJsonObject line;
+    line.insert(QStringLiteral("t_us"), double(event.offsetUs));
+    line.insert(QStringLiteral("source"), QString::fromUtf8(event.source));
+    line.insert(QStringLiteral("device"), event.device.toJson());
+    return QJsonDocument(line).toJson(QJsonDocument::Compact) + '\n';
+}
+
+struct Recorder {
+    QMutex mutex;
+    QFile file;
+    QElapsedTimer clock;
+};
+
+Recorder& recorder()
+{
+    static Recorder r;
+    return r;
+}
+
+#ifndef Q_OS_WIN
+UdevRecord capture(struct udev_device* dev, bool withRelatives)
+{
+    const auto bytes = [](const char* value) { return value ? QByteArray(value) : QByteArray(); };
+    UdevRecord r;
+    r.action = bytes(udev_device_get_action(dev));
+    r.sysPath = bytes(udev_device_get_syspath(dev));
+    r.sysName = bytes(udev_device_get_sysname(dev));
+    r.devNode = bytes(udev_device_get_devnode(dev));
+    r.subsystem = bytes(udev_device_get_subsystem(dev));
+    r.devType = bytes(udev_device_get_devtype(dev));
+    r.driver = bytes(udev_device_get_driver(dev));
+    r.devnum = udev_device_get_devnum(dev);
+    for (const char* const* key = UdevRecord::kRecordedSysAttrs; *key; ++key) {
+        if (const char* value = udev_device_get_sysattr_value(dev, *key)) {
+            r.sysAttrs.insert(*key, value);
+        }
+    }
+    if (r.subsystem == "usb" && r.devType == "usb_device") {
+        r.descriptorFingerprint = HidDescriptorFingerprint::fromSysfs(QString::fromUtf8(r.sysPath));
+    }
+    if (!withRelatives) {
+        return r;
+    }
+    struct udev_list_entry* entry = nullptr;
+    udev_list_entry_foreach(entry, udev_device_get_properties_list_entry(dev)) {
+        r.properties.insert(udev_list_entry_get_name(entry), bytes(udev_list_entry_get_value(entry)));
+    }
+    const std::pair<const char*, const char*> wanted[] = {
+        {"usb", "usb_interface"}, {"usb", "usb_device"}, {"block", "disk"}};
+    for (const auto& [subsystem, devtype] : wanted) {
+        if (struct udev_device* parent = udev_device_get_parent_with_subsystem_devtype(dev, subsystem, devtype)) {
+            r.parents.push_back(capture(parent, false));
+        }
+    }
+    // Nearest first, as the lookup expects: a longer sysfs path is further down the tree.
+    std::stable_sort(r.parents.begin(), r.parents.end(), [](const UdevRecord& a, const UdevRecord& b) {
+        return a.sysPath.size() > b.sysPath.size();
+    });
+    return r;
+}
+#endif
+
+} // namespace
+
+const UdevRecord* UdevRecord::parent(const char* subsystem, const char* devtype) const
+{
+    for (const UdevRecord& p : parents) {
+        if (p.subsystem == subsystem && (!devtype || p.devType == devtype)) {
+            return &p;
+        }
+    }
+    return nullptr;
+}
+
+QJsonObject UdevRecord::toJson() const
+{
+    QJsonObject o;
+    insertText(o, "action", action);
+    insertText(o, "syspath", sysPath);
+    insertText(o, "sysname", sysName);
+    insertText(o, "devnode", devNode);
+    insertText(o, "subsystem", subsystem);
+    insertText(o, "devtype", devType);
+    insertText(o, "driver", driver);
+    if (devnum != 0) {
+        o.insert(QStringLiteral("devnum"), double(devnum));
+    }
+    if (!properties.isEmpty()) {
+        o.insert(QStringLiteral("properties"), mapToJson(properties));
+    }
+    if (!sysAttrs.isEmpty()) {
+        o.insert(QStringLiteral("sysattrs"), mapToJson(sysAttrs));
+    }
+    if (!descriptorFingerprint.isEmpty()) {
+        o.insert(QStringLiteral("descriptor_fingerprint"), QString::fromLatin1(descriptorFingerprint.toHex()));
+    }
+    if (!parents.empty()) {
+        QJsonArray list;
+        for (const UdevRecord& p : parents) {
+            list.append(p.toJson());
+        }
+        o.insert(QStringLiteral("parents"), list);
+    }
+    return o;
+}
+
+UdevRecord UdevRecord::fromJson(const QJsonObject& o)
+{
+    UdevRecord r;
+    r.action = text(o, "action");
+    r.sysPath = text(o, "syspath");
+    r.sysName = text(o, "sysname");
+    r.devNode = text(o, "devnode");
+    r.subsystem = text(o, "subsystem");
+    r.devType = text(o, "devtype");
+    r.driver = text(o, "driver");
+    r.devnum = quint64(o.value(QStringLiteral("devnum")).toDouble());
+    r.properties = mapFromJson(o.value(QStringLiteral("properties")).toObject());
+    r.sysAttrs = mapFromJson(o.value(QStringLiteral("sysattrs")).toObject());
+    r.descriptorFingerprint = QByteArray::fromHex(text(o, "descriptor_fingerprint"));
+    for (const QJsonValue& p : o.value(QStringLiteral("parents")).toArray()) {
+        r.parents.push_back(fromJson(p.toObject()));
+    }
+    return r;
+}
+
+bool UdevEventTrace::startRecording(const QString& path, QString* error)
+{
+    Recorder& r = recorder();
+    QMutexLocker locker(&r.mutex);
+    if (r.file.isOpen()) {
+        r.file.close();
+    }
+    r.file.setFileName(path);
+    if (!r.file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        fail(error, r.file.errorString());
+        return false;
+    }
+    r.file.write(headerLine());
+    r.file.flush();
+    r.clock.invalidate();
+    s_recording.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+void UdevEventTrace::stopRecording()
+{
+    Recorder& r = recorder();
+    QMutexLocker locker(&r.mutex);
+    s_recording.store(false, std::memory_order_relaxed);
+    r.file.close();
+}
+
+#ifndef Q_OS_WIN
+void UdevEventTrace::record(const char* source, struct udev_device* dev)
+{
+    if (!recording() || !dev) {
+        return;
+    }
+    Event event;
+    event.source = source;
+    event.device = capture(dev, true);
+
+    Recorder& r = recorder();
+    QMutexLocker locker(&r.mutex);
+    if (!r.file.isOpen()) {
+        return;
+    }
+    if (!r.clock.isValid()) {
+        r.clock.start();
+    }
+    event.offsetUs = r.clock.nsecsElapsed() / 1000;
+    // Flushed per event: the storm being recorded may well end in a crash.
+    r.file.write(eventLine(event));
+    r.file.flush();
+}
+#endif
+
+bool UdevEventTrace::save(const QString& path, const QList<Event>& events, QString* error)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        fail(error, file.errorString());
+        return false;
+    }
+    file.write(headerLine());
+    for (const Event& event : events) {
+        file.write(eventLine(event));
+    }
+    if (!file.commit()) {
+        fail(error, file.errorString());
+        return false;
+    }
+    return true;
+}
+
+QList<UdevEventTrace::Event> UdevEventTrace::load(const QString& path, QString* error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        fail(error, file.errorString());
+        return {};
+    }
+    QList<Event> events;
+    bool sawHeader = false;
+    int lineNumber = 0;
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        ++lineNumber;
+        if (line.isEmpty()) {
+            continue;
+        }
+        QJsonParseError parseError;
+        const QJsonObject object = QJsonDocument::fromJson(line, &parseError).object();
+        if (parseError.error != QJsonParseError::NoError) {
+            // A recording cut off by a crash ends in a partial line; keep what came before it.
+            if (file.atEnd() && sawHeader) {
+                break;
+            }
+            fail(error, QStringLiteral("%1:%2: %3").arg(path).arg(lineNumber).arg(parseError.errorString()));
+            return {};
+        }
+        if (!sawHeader) {
+            if (object.value(QStringLiteral("format")).toString() != QLatin1String(kFormat)) {
+                fail(error, QStringLiteral("%1 is not a %2 trace").arg(path, QLatin1String(kFormat)));
+                return {};
+            }
+            sawHeader = true;
+            continue;
+        }
+        Event event;
+        event.offsetUs = qint64(object.value(QStringLiteral("t_us")).toDouble());
+        event.source = object.value(QStringLiteral("source")).toString().toUtf8();
+        event.device = UdevRecord::fromJson(object.value(QStringLiteral("device")).toObject());
+        events.append(std::move(event));
+    }
+    if (!sawHeader) {
+        fail(error, QStringLiteral("%1 is empty").arg(path));
+    }
+    return events;
+}
+
+UdevEventTrace::ReplayStats UdevEventTrace::replay(const QList<Event>& events, double speed,
+                                                   const std::function<void(const Event&)>& deliver)
+{
+    ReplayStats stats;
+    speed = std::min(speed, kMaxSpeed);
+    QElapsedTimer clock;
+    clock.start();
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    qsizetype next = 0;
+    const auto dueUs = [&](qsizetype i) {
+        return speed > 0 ? qint64(double(events.at(i).offsetUs - events.first().offsetUs) / speed) : 0;
+    };
+    const auto pump = [&]() {
+        while (next < events.size()) {
+            const qint64 nowUs = clock.nsecsElapsed() / 1000;
+            const qint64 due = dueUs(next);
+            if (due > nowUs) {
+                timer.start(int(std::max<qint64>(1, (due - nowUs) / 1000)));
+                return;
+            }
+            stats.maxLagUs = std::max(stats.maxLagUs, nowUs - due);
+            deliver(events.at(next++));
+            ++stats.delivered;
+            if (speed <= 0 && next % 64 == 0) {
+                // Back to back, but timers (the debounce) still get to run now and then.
+                timer.start(0);
+                return;
+            }
+        }
+        loop.quit();
+    };
+    QObject::connect(&timer, &QTimer::timeout, &loop, pump);
+    if (!events.isEmpty()) {
+        timer.start(0);
+        loop.exec();
+    }
+    stats.wallNs = clock.nsecsElapsed();
+    return stats;
+}
+
+} // namespace FlashSpartan
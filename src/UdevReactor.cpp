@@ -0,0 +1,316 @@
+#include "UdevReactor.h"
+#include "PerfTrace.h"
+
+#ifndef Q_OS_WIN
+
+#include <QDebug>
+#include <QFileInfo>
+
+#include <libudev.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+namespace FlashSpartan {
+
+UdevReactor& UdevReactor::instance()
+{
+    static UdevReactor reactor;
+    return reactor;
+}
+
+UdevReactor::~UdevReactor()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_thread.joinable()) {
+        stop(lock);
+    }
+}
+
+bool UdevReactor::rulesInstalled()
+{
+    for (const char* dir : {"/etc/udev/rules.d", "/run/udev/rules.d", "/usr/lib/udev/rules.d",
+                            "/lib/udev/rules.d", "/usr/local/lib/udev/rules.d"}) {
+        if (QFileInfo::exists(QString::fromLatin1(dir) + QStringLiteral("/99-flashspartan.rules"))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int UdevReactor::subscribe(const char* subsystem, const char* devtype, EventHandler handler,
+                           const char* tag)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this] { return !m_stop; });  // a stop in progress finishes first
+    if (!m_thread.joinable() && !startLocked()) {
+        return -1;
+    }
+    const int id = m_nextId++;
+    Subscription sub;
+    sub.id = id;
+    sub.subsystem = subsystem;
+    sub.devtype = devtype ? QByteArray(devtype) : QByteArray();
+    sub.tag = tag ? QByteArray(tag) : QByteArray();
+    sub.handler = std::move(handler);
+    m_subscriptions.append(sub);
+    // The monitor is only touched on the reactor thread, so the filter is updated there,
+    // ahead of anything the new subscriber posts (such as its first enumeration).
+    m_tasks.append({0, [this] { updateFilter(); }, std::chrono::steady_clock::now()});
+    wake();
+    return id;
+}
+
+void UdevReactor::unsubscribe(int id)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_subscriptions.removeIf([id](const Subscription& s) { return s.id == id; });
+    m_tasks.removeIf([id](const Task& t) { return t.id == id; });
+    const bool onReactor = std::this_thread::get_id() == m_thread.get_id();
+    if (!onReactor) {
+        m_idle.wait(lock, [this, id] { return m_dispatching != id; });
+    }
+    if (!m_thread.joinable()) {
+        return;
+    }
+    if (m_subscriptions.isEmpty() && !onReactor) {
+        stop(lock);
+        return;
+    }
+    m_tasks.append({0, [this] { updateFilter(); }, std::chrono::steady_clock::now()});
+    wake();
+}
+
+void UdevReactor::post(int id, std::function<void()> task, int delayMs)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_thread.joinable()) {
+        return;
+    }
+    m_tasks.append({id, std::move(task),
+                    std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMs)});
+    wake();
+}
+
+void UdevReactor::updateFilter()
+{
+    struct Filter {
+        QByteArray subsystem;
+        QByteArray devtype;
+        QByteArray tag;
+    };
+    QList<Filter> filters;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (const Subscription& s : m_subscriptions) {
+            filters.append({s.subsystem, s.devtype, s.tag});
+        }
+    }
+    udev_monitor_filter_remove(m_monitor);
+    bool everyTagged = !filters.isEmpty();
+    for (const Filter& f : std::as_const(filters)) {
+        udev_monitor_filter_add_match_subsystem_devtype(
+            m_monitor, f.subsystem.constData(), f.devtype.isEmpty() ? nullptr : f.devtype.constData());
+        everyTagged = everyTagged && !f.tag.isEmpty();
+    }
+    // Tag matches apply to the whole socket, so they only go to the kernel when no
+    // subscriber wants untagged events; dispatch() checks each subscriber's tag either way.
+    if (everyTagged) {
+        for (const Filter& f : std::as_const(filters)) {
+            udev_monitor_filter_add_match_tag(m_monitor, f.tag.constData());
+        }
+    }
+    udev_monitor_filter_update(m_monitor);
+}
+
+int UdevReactor::nextTimeoutLocked() const
+{
+    if (m_tasks.isEmpty()) {
+        return -1;
+    }
+    auto due = m_tasks.constFirst().due;
+    for (const Task& t : m_tasks) {
+        due = std::min(due, t.due);
+    }
+    const auto wait = std::chrono::ceil<std::chrono::milliseconds>(due - std::chrono::steady_clock::now());
+    return static_cast<int>(std::max<std::chrono::milliseconds::rep>(0, wait.count()));
+}
+
+bool UdevReactor::startLocked()
+{
+    const auto fail = [this](const char* what) {
+        qCritical() << "UdevReactor:" << what;
+        if (m_epollFd >= 0) close(m_epollFd);
+        if (m_wakeFd >= 0) close(m_wakeFd);
+        if (m_monitor) udev_monitor_unref(m_monitor);
+        if (m_udev) udev_unref(m_udev);
+        m_epollFd = m_wakeFd = -1;
+        m_monitor = nullptr;
+        m_udev = nullptr;
+        return false;
+    };
+
+    m_udev = udev_new();
+    if (!m_udev) {
+        return fail("Failed to create udev context");
+    }
+    m_monitor = udev_monitor_new_from_netlink(m_udev, "udev");
+    if (!m_monitor) {
+        return fail("Failed to create udev monitor");
+    }
+    if (udev_monitor_enable_receiving(m_monitor) < 0) {
+        return fail("Failed to enable monitor receiving");
+    }
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_wakeFd < 0 || m_epollFd < 0) {
+        return fail("Failed to create eventfd/epoll descriptors");
+    }
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = udev_monitor_get_fd(m_monitor);
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, ev.data.fd, &ev) != 0) {
+        return fail("Failed to watch the udev socket");
+    }
+    ev.data.fd = m_wakeFd;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &ev) != 0) {
+        return fail("Failed to watch the wake-up eventfd");
+    }
+    m_thread = std::thread([this] { run(); });
+    return true;
+}
+
+void UdevReactor::stop(std::unique_lock<std::mutex>& lock)
+{
+    m_stop = true;
+    wake();
+    lock.unlock();
+    m_thread.join();
+    lock.lock();
+    close(m_epollFd);
+    close(m_wakeFd);
+    udev_monitor_unref(m_monitor);
+    udev_unref(m_udev);
+    m_epollFd = m_wakeFd = -1;
+    m_monitor = nullptr;
+    m_udev = nullptr;
+    m_tasks.clear();
+    m_stop = false;
+    m_idle.notify_all();
+}
+
+void UdevReactor::wake()
+{
+    const uint64_t one = 1;
+    [[maybe_unused]] const auto ret = write(m_wakeFd, &one, sizeof(one));
+}
+
+void UdevReactor::run()
+{
+    const int udevFd = udev_monitor_get_fd(m_monitor);
+    for (;;) {
+        int timeoutMs = -1;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            timeoutMs = nextTimeoutLocked();
+        }
+        epoll_event events[2];
+        const int n = epoll_wait(m_epollFd, events, 2, timeoutMs);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qWarning() << "UdevReactor: epoll_wait failed:" << strerror(errno);
+            return;
+        }
+        bool udevReady = false;
+        for (int i = 0; i < n; ++i) {
+            if (events[i].data.fd == m_wakeFd) {
+                uint64_t count = 0;
+                [[maybe_unused]] const auto ret = read(m_wakeFd, &count, sizeof(count));
+            } else if (events[i].data.fd == udevFd) {
+                udevReady = true;
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            const auto now = std::chrono::steady_clock::now();
+            const auto due = std::find_if(m_tasks.cbegin(), m_tasks.cend(),
+                                          [now](const Task& t) { return t.due <= now; });
+            if (m_stop || due == m_tasks.cend()) {
+                break;
+            }
+            Task task = m_tasks.takeAt(due - m_tasks.cbegin());
+            m_dispatching = task.id;
+            lock.unlock();
+            {
+                FLASHSPARTAN_TRACE_SPAN("udev", "task");
+                task.run();
+            }
+            lock.lock();
+            m_dispatching = 0;
+            m_idle.notify_all();
+        }
+        if (m_stop) {
+            return;
+        }
+        lock.unlock();
+
+        // The socket is non-blocking: take everything queued, so a hub or a stick with
+        // several partitions is handled in one wake-up. Capped so posted tasks still run
+        // promptly; epoll is level-triggered and reports whatever is left.
+        for (int i = 0; udevReady && i < kMaxEventsPerWake; ++i) {
+            struct udev_device* dev = udev_monitor_receive_device(m_monitor);
+            if (!dev) {
+                break;
+            }
+            dispatch(dev);
+            udev_device_unref(dev);
+        }
+    }
+}
+
+void UdevReactor::dispatch(struct udev_device* dev)
+{
+    FLASHSPARTAN_TRACE_SPAN("udev", "dispatch");
+    const char* subsystem = udev_device_get_subsystem(dev);
+    const char* devtype = udev_device_get_devtype(dev);
+    if (!subsystem) {
+        return;
+    }
+    QList<int> matching;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (const Subscription& s : m_subscriptions) {
+        if (s.subsystem == subsystem && (s.devtype.isEmpty() || (devtype && s.devtype == devtype))
+            && (s.tag.isEmpty() || udev_device_has_tag(dev, s.tag.constData()) > 0)) {
+            matching.append(s.id);
+        }
+    }
+    for (const int id : matching) {
+        // Looked up again: a subscriber may have left while an earlier handler ran.
+        const auto it = std::find_if(m_subscriptions.cbegin(), m_subscriptions.cend(),
+                                     [id](const Subscription& s) { return s.id == id; });
+        if (it == m_subscriptions.cend()) {
+            continue;
+        }
+        const EventHandler handler = it->handler;
+        m_dispatching = id;
+        lock.unlock();
+        {
+            FLASHSPARTAN_TRACE_SPAN("udev", "handler");
+            handler(dev);
+        }
+        lock.lock();
+        m_dispatching = 0;
+        m_idle.notify_all();
+    }
+}
+
+} // namespace FlashSpartan
+
+#endif
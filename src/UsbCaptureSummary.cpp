@@ -0,0 +1,622 @@
+#include "UsbCaptureSummary.h"
+
+#include "HidKeystrokeAnalyzer.h"
+#include "UsbmonRing.h"
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QJsonArray>
+#include <QStringList>
+#include <QtEndian>
+
+#include <algorithm>
+#include <array>
+#include <map>
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr quint32 kPcapMagicUs = 0xA1B2C3D4;
+constexpr quint32 kPcapMagicNs = 0xA1B23C4D;
+constexpr quint32 kPcapngSectionHeader = 0x0A0D0D0A;
+constexpr quint32 kPcapngByteOrderMagic = 0x1A2B3C4D;
+constexpr quint32 kPcapngInterface = 1;
+constexpr quint32 kPcapngObsoletePacket = 2;
+constexpr quint32 kPcapngSimplePacket = 3;
+constexpr quint32 kPcapngEnhancedPacket = 6;
+constexpr quint16 kPcapngOptionTsResolution = 9;
+
+constexpr quint16 kLinkUsbLinux = 189;
+constexpr quint16 kLinkUsbLinuxMmapped = 220;
+constexpr quint16 kLinkUsbPcap = 249;
+constexpr size_t kUsbLinuxHeaderBytes = 48;
+constexpr size_t kUsbPcapMinHeaderBytes = 27;
+
+constexpr quint8 kInterruptTransfer = 1;
+constexpr quint8 kEndpointIn = 0x80;
+constexpr quint8 kFirstKeyUsage = 0x04;
+constexpr size_t kBootReportBytes = 8;
+
+quint16 read16(const char* p, bool bigEndian)
+{
+    return bigEndian ? qFromBigEndian<quint16>(p) : qFromLittleEndian<quint16>(p);
+}
+
+quint32 read32(const char* p, bool bigEndian)
+{
+    return bigEndian ? qFromBigEndian<quint32>(p) : qFromLittleEndian<quint32>(p);
+}
+
+/** One USB event, whatever link type it came in. */
+struct UsbEvent {
+    quint16 bus = 0;
+    quint8 device = 0;
+    quint8 endpoint = 0;
+    quint8 transferType = 0;
+    bool completion = false;
+    bool ok = false;  // completed without error
+    QByteArrayView data;
+};
+
+bool decodeUsbEvent(quint16 linkType, bool bigEndian, QByteArrayView frame, UsbEvent* out)
+{
+    const char* p = frame.constData();
+    const size_t size = size_t(frame.size());
+    switch (linkType) {
+        case kLinkUsbLinux:
+        case kLinkUsbLinuxMmapped: {
+            const size_t header = linkType == kLinkUsbLinux ? kUsbLinuxHeaderBytes : UsbmonRing::kHeaderBytes;
+            if (size < header) {
+                return false;
+            }
+            out->completion = p[8] == 'C';
+            out->transferType = quint8(p[9]);
+            out->endpoint = quint8(p[10]);
+            out->device = quint8(p[11]);
+            out->bus = read16(p + 12, bigEndian);
+            out->ok = qint32(read32(p + 28, bigEndian)) == 0;
+            size_t offset = header;
+            if (linkType == kLinkUsbLinuxMmapped && out->transferType == UsbmonFilter::kTransferIso) {
+                offset += size_t(read32(p + 60, bigEndian)) * UsbmonRing::kIsoDescriptorBytes;
+            }
+            const size_t captured = read32(p + 36, bigEndian);
+            offset = std::min(offset, size);
+            out->data = QByteArrayView(p + offset, qsizetype(std::min(captured, size - offset)));
+            return true;
+        }
+        case kLinkUsbPcap: {
+            // USBPCAP_BUFFER_PACKET_HEADER, always little-endian.
+            if (size < kUsbPcapMinHeaderBytes) {
+                return false;
+            }
+            const size_t header = qFromLittleEndian<quint16>(p);
+            if (header < kUsbPcapMinHeaderBytes || header > size) {
+                return false;
+            }
+            out->ok = qFromLittleEndian<quint32>(p + 10) == 0;
+            out->completion = (quint8(p[16]) & 0x01) != 0;  // PDO -> FDO
+            out->bus = qFromLittleEndian<quint16>(p + 17);
+            out->device = quint8(qFromLittleEndian<quint16>(p + 19));
+            out->endpoint = quint8(p[21]);
+            out->transferType = quint8(p[22]) & 0x03;
+            const size_t length = qFromLittleEndian<quint32>(p + 23);
+            out->data = QByteArrayView(p + header, qsizetype(std::min(length, size - header)));
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+struct KeyboardState {
+    UsbCaptureSummary::Keyboard summary;
+    std::array<quint8, 6> keys{};
+};
+
+class Summarizer {
+public:
+    explicit Summarizer(UsbCaptureSummary& summary)
+        : m_summary(summary)
+        , m_digest(QCryptographicHash::Sha256)
+    {
+    }
+
+    void add(quint16 linkType, bool bigEndian, qint64 timestampUs, QByteArrayView frame)
+    {
+        UsbEvent event;
+        if (!decodeUsbEvent(linkType, bigEndian, frame, &event)) {
+            ++m_summary.skippedPackets;
+            return;
+        }
+        ++m_summary.packets;
+        const char shape[] = {char(event.endpoint), char(event.transferType), char(event.completion),
+                              char(event.ok)};
+        const quint32 length = qToLittleEndian(quint32(event.data.size()));
+        m_digest.addData(QByteArrayView(shape, sizeof(shape)));
+        m_digest.addData(QByteArrayView(reinterpret_cast<const char*>(&length), sizeof(length)));
+        m_digest.addData(event.data);
+        if (m_summary.firstUs == 0 || timestampUs < m_summary.firstUs) {
+            m_summary.firstUs = timestampUs;
+        }
+        m_summary.lastUs = std::max(m_summary.lastUs, timestampUs);
+
+        const quint64 key = (quint64(event.bus) << 16) | (quint64(event.device) << 8) | event.endpoint;
+        UsbCaptureSummary::Endpoint& endpoint = m_endpoints[key];
+        if (endpoint.packets == 0) {
+            endpoint.bus = event.bus;
+            endpoint.device = event.device;
+            endpoint.endpoint = event.endpoint;
+            endpoint.transferType = event.transferType;
+            endpoint.firstUs = timestampUs;
+        }
+        ++endpoint.packets;
+        endpoint.bytes += quint64(event.data.size());
+        endpoint.lastUs = std::max(endpoint.lastUs, timestampUs);
+
+        if (event.completion && event.ok && event.transferType == kInterruptTransfer
+            && (event.endpoint & kEndpointIn) && size_t(event.data.size()) == kBootReportBytes
+            && HidKeystrokeAnalyzer::isBootKeyboardReport(event.data.constData(), kBootReportBytes)) {
+            addReport(event, timestampUs);
+        }
+    }
+
+    void finish()
+    {
+        if (m_summary.packets > 0) {
+            m_summary.contentDigest = m_digest.result();
+        }
+        for (const auto& [key, endpoint] : m_endpoints) {
+            m_summary.endpoints.append(endpoint);
+        }
+        for (const auto& [key, state] : m_keyboards) {
+            if (state.summary.keyDowns > 0) {
+                m_summary.keyboards.append(state.summary);
+            }
+        }
+    }
+
+private:
+    void addReport(const UsbEvent& event, qint64 timestampUs)
+    {
+        KeyboardState& state = m_keyboards[(quint32(event.bus) << 8) | event.device];
+        UsbCaptureSummary::Keyboard& keyboard = state.summary;
+        keyboard.bus = event.bus;
+        keyboard.device = event.device;
+        const char* report = event.data.constData();
+        const quint8 modifiers = quint8(report[0]);
+
+        std::array<quint8, 6> keys{};
+        for (size_t i = 0; i < keys.size(); ++i) {
+            keys[i] = quint8(report[i + 2]);
+            const bool down = keys[i] >= kFirstKeyUsage
+                              && std::find(state.keys.cbegin(), state.keys.cend(), keys[i]) == state.keys.cend();
+            if (!down) {
+                continue;
+            }
+            if (keyboard.keyDowns > 0) {
+                const qint64 interval = timestampUs - keyboard.lastUs;
+                if (interval >= 0 && (keyboard.fastestIntervalUs == 0 || interval < keyboard.fastestIntervalUs)) {
+                    keyboard.fastestIntervalUs = interval;
+                }
+            } else {
+                keyboard.firstUs = timestampUs;
+            }
+            keyboard.lastUs = timestampUs;
+            ++keyboard.keyDowns;
+            const QString text = UsbCaptureSummary::keyText(keys[i], modifiers);
+            if (keyboard.typed.size() + text.size() > UsbCaptureSummary::kMaxTypedChars) {
+                keyboard.truncated = true;
+            } else if (!keyboard.truncated) {
+                keyboard.typed += text;
+            }
+        }
+        state.keys = keys;
+
+        // The rate check wants the usbmon view of the same report.
+        UsbmonPacket packet;
+        packet.timestampUs = timestampUs;
+        packet.bus = event.bus;
+        packet.device = event.device;
+        packet.eventType = 'C';
+        packet.transferType = kInterruptTransfer;
+        packet.endpoint = event.endpoint;
+        packet.frame = QByteArray(qsizetype(UsbmonRing::kHeaderBytes), '\0');
+        packet.frame.append(event.data.constData(), qsizetype(kBootReportBytes));
+        if (m_rate.feed(packet)) {
+            keyboard.superhuman = true;
+        }
+    }
+
+    UsbCaptureSummary& m_summary;
+    std::map<quint64, UsbCaptureSummary::Endpoint> m_endpoints;
+    std::map<quint32, KeyboardState> m_keyboards;
+    HidKeystrokeAnalyzer m_rate;
+    QCryptographicHash m_digest;
+};
+
+/** Reads exactly @p size bytes into @p buffer, reusing its allocation. */
+bool readExactly(QIODevice* in, QByteArray& buffer, qint64 size)
+{
+    buffer.resize(qsizetype(size));
+    return size == 0 || in->read(buffer.data(), size) == size;
+}
+
+void readPcap(QIODevice* in, const QByteArray& magicBytes, UsbCaptureSummary& summary, Summarizer& out)
+{
+    summary.format = QStringLiteral("pcap");
+    const quint32 le = qFromLittleEndian<quint32>(magicBytes.constData());
+    const bool bigEndian = le != kPcapMagicUs && le != kPcapMagicNs;
+    const bool nanoseconds = read32(magicBytes.constData(), bigEndian) == kPcapMagicNs;
+    QByteArray rest;
+    if (!readExactly(in, rest, 20)) {
+        summary.error = QStringLiteral("truncated pcap header");
+        return;
+    }
+    summary.linkType = quint16(read32(rest.constData() + 16, bigEndian) & 0xFFFF);
+
+    QByteArray header;
+    QByteArray frame;
+    while (readExactly(in, header, 16)) {
+        const qint64 seconds = read32(header.constData(), bigEndian);
+        const qint64 fraction = read32(header.constData() + 4, bigEndian);
+        const qint64 captured = read32(header.constData() + 8, bigEndian);
+        if (captured > UsbCaptureSummary::kMaxFrameBytes) {
+            ++summary.skippedPackets;
+            if (in->skip(captured) != captured) {
+                summary.error = QStringLiteral("truncated pcap record");
+                return;
+            }
+            continue;
+        }
+        if (!readExactly(in, frame, captured)) {
+            summary.error = QStringLiteral("truncated pcap record");
+            return;
+        }
+        const qint64 timestampUs = seconds * 1000000 + (nanoseconds ? fraction / 1000 : fraction);
+        out.add(summary.linkType, bigEndian, timestampUs, frame);
+    }
+}
+
+struct PcapngInterface {
+    quint16 linkType = 0;
+    bool decimal = true;  // if_tsresol: 10^-exponent, otherwise 2^-exponent
+    int exponent = 6;
+};
+
+qint64 toMicroseconds(quint64 timestamp, const PcapngInterface& iface)
+{
+    if (!iface.decimal) {
+        return qint64(double(timestamp) * 1e6 / double(quint64(1) << std::min(iface.exponent, 63)));
+    }
+    qint64 value = qint64(timestamp);
+    for (int e = iface.exponent; e > 6; --e) {
+        value /= 10;
+    }
+    for (int e = iface.exponent; e < 6; ++e) {
+        value *= 10;
+    }
+    return value;
+}
+
+PcapngInterface parseInterface(const QByteArray& body, bool bigEndian)
+{
+    PcapngInterface iface;
+    if (body.size() < 8) {
+        return iface;
+    }
+    iface.linkType = read16(body.constData(), bigEndian);
+    qsizetype pos = 8;
+    while (pos + 4 <= body.size()) {
+        const quint16 code = read16(body.constData() + pos, bigEndian);
+        const quint16 length = read16(body.constData() + pos + 2, bigEndian);
+        pos += 4;
+        if (code == 0 || pos + length > body.size()) {
+            break;
+        }
+        if (code == kPcapngOptionTsResolution && length >= 1) {
+            const quint8 resolution = quint8(body.at(pos));
+            iface.decimal = (resolution & 0x80) == 0;
+            iface.exponent = resolution & 0x7F;
+        }
+        pos += (length + 3) & ~3;
+    }
+    return iface;
+}
+
+void readPcapng(QIODevice* in, const QByteArray& firstType, UsbCaptureSummary& summary, Summarizer& out)
+{
+    summary.format = QStringLiteral("pcapng");
+    QList<PcapngInterface> interfaces;
+    bool bigEndian = false;
+    QByteArray header = firstType;
+    QByteArray body;
+    for (;;) {
+        // Type and total length; a section header's byte-order magic decides how to read both.
+        QByteArray more;
+        if (!readExactly(in, more, 8 - header.size())) {
+            if (!header.isEmpty() || !in->atEnd()) {
+                summary.error = QStringLiteral("truncated pcapng block");
+            }
+            return;
+        }
+        header += more;
+        const quint32 rawType = qFromLittleEndian<quint32>(header.constData());
+        QByteArray bom;
+        if (rawType == kPcapngSectionHeader) {
+            if (!readExactly(in, bom, 4)) {
+                summary.error = QStringLiteral("truncated pcapng section header");
+                return;
+            }
+            bigEndian = qFromLittleEndian<quint32>(bom.constData()) != kPcapngByteOrderMagic;
+            if (read32(bom.constData(), bigEndian) != kPcapngByteOrderMagic) {
+                summary.error = QStringLiteral("bad pcapng byte-order magic");
+                return;
+            }
+            interfaces.clear();
+        }
+        const quint32 type = read32(header.constData(), bigEndian);
+        const qint64 total = read32(header.constData() + 4, bigEndian);
+        header.clear();
+        const qint64 bodySize = total - 12 - bom.size();
+        if (total < 12 || total % 4 != 0 || bodySize < 0) {
+            summary.error = QStringLiteral("bad pcapng block length");
+            return;
+        }
+        if (type == kPcapngEnhancedPacket && bodySize > UsbCaptureSummary::kMaxFrameBytes + 20) {
+            ++summary.skippedPackets;
+            if (in->skip(bodySize + 4) != bodySize + 4) {
+                summary.error = QStringLiteral("truncated pcapng block");
+                return;
+            }
+            continue;
+        }
+        QByteArray trailer;
+        if (!readExactly(in, body, bodySize) || !readExactly(in, trailer, 4)) {
+            summary.error = QStringLiteral("truncated pcapng block");
+            return;
+        }
+
+        if (type == kPcapngInterface) {
+            interfaces.append(parseInterface(body, bigEndian));
+            if (interfaces.size() == 1) {
+                summary.linkType = interfaces.first().linkType;
+            }
+        } else if (type == kPcapngEnhancedPacket && body.size() >= 20) {
+            const char* p = body.constData();
+            const quint32 interfaceId = read32(p, bigEndian);
+            const quint64 timestamp = (quint64(read32(p + 4, bigEndian)) << 32) | read32(p + 8, bigEndian);
+            const qint64 captured = std::min<qint64>(read32(p + 12, bigEndian), body.size() - 20);
+            if (interfaceId >= quint32(interfaces.size())) {
+                ++summary.skippedPackets;
+                continue;
+            }
+            const PcapngInterface& iface = interfaces.at(qsizetype(interfaceId));
+            out.add(iface.linkType, bigEndian, toMicroseconds(timestamp, iface),
+                    QByteArrayView(p + 20, qsizetype(captured)));
+        } else if (type == kPcapngSimplePacket || type == kPcapngObsoletePacket) {
+            ++summary.skippedPackets;  // no interface to decode them with
+        }
+    }
+}
+
+QString transferName(quint8 type)
+{
+    switch (type & 3) {
+        case UsbmonFilter::kTransferIso: return QStringLiteral("isochronous");
+        case UsbmonFilter::kTransferInterrupt: return QStringLiteral("interrupt");
+        case UsbmonFilter::kTransferControl: return QStringLiteral("control");
+        default: return QStringLiteral("bulk");
+    }
+}
+
+QString seconds(qint64 us)
+{
+    return QStringLiteral("%1 s").arg(double(us) / 1e6, 0, 'f', 1);
+}
+
+} // namespace
+
+double UsbCaptureSummary::Keyboard::keysPerSecond() const
+{
+    const qint64 span = lastUs - firstUs;
+    return keyDowns > 1 && span > 0 ? double(keyDowns - 1) * 1e6 / double(span) : 0.0;
+}
+
+QString UsbCaptureSummary::keyText(quint8 usage, quint8 modifiers)
+{
+    static constexpr char kLower[] = "abcdefghijklmnopqrstuvwxyz1234567890";
+    static constexpr char kUpper[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ!@#$%^&*()";
+    static constexpr char kPunctLower[] = " -=[]\\#;'`,./";  // 0x2C..0x38
+    static constexpr char kPunctUpper[] = " _+{}|~:\"~<>?";
+    const bool shift = (modifiers & 0x22) != 0;
+    const bool ctrl = (modifiers & 0x11) != 0;
+    const bool alt = (modifiers & 0x44) != 0;
+    const bool gui = (modifiers & 0x88) != 0;
+
+    QString base;
+    bool printable = false;
+    if (usage >= 0x04 && usage <= 0x27) {
+        base = QChar::fromLatin1((shift && !ctrl && !alt && !gui ? kUpper : kLower)[usage - 0x04]);
+        printable = true;
+    } else if (usage >= 0x2C && usage <= 0x38) {
+        base = QChar::fromLatin1((shift && !ctrl && !alt && !gui ? kPunctUpper : kPunctLower)[usage - 0x2C]);
+        printable = usage != 0x2C || (!ctrl && !alt && !gui);
+        if (usage == 0x2C && !printable) {
+            base = QStringLiteral("Space");
+        }
+    } else {
+        switch (usage) {
+            case 0x28: base = QStringLiteral("Enter"); break;
+            case 0x29: base = QStringLiteral("Esc"); break;
+            case 0x2A: base = QStringLiteral("Backspace"); break;
+            case 0x2B: base = QStringLiteral("Tab"); break;
+            case 0x39: base = QStringLiteral("CapsLock"); break;
+            case 0x4C: base = QStringLiteral("Delete"); break;
+            case 0x4F: base = QStringLiteral("Right"); break;
+            case 0x50: base = QStringLiteral("Left"); break;
+            case 0x51: base = QStringLiteral("Down"); break;
+            case 0x52: base = QStringLiteral("Up"); break;
+            default:
+                if (usage >= 0x3A && usage <= 0x45) {
+                    base = QStringLiteral("F%1").arg(usage - 0x3A + 1);
+                } else if (usage >= kFirstKeyUsage) {
+                    base = QStringLiteral("0x%1").arg(usage, 2, 16, QLatin1Char('0'));
+                } else {
+                    return {};
+                }
+        }
+    }
+    if (printable && !ctrl && !alt && !gui) {
+        return base;
+    }
+    QStringList chord;
+    if (ctrl) chord << QStringLiteral("Ctrl");
+    if (alt) chord << QStringLiteral("Alt");
+    if (gui) chord << QStringLiteral("GUI");
+    if (shift) chord << QStringLiteral("Shift");
+    chord << base;
+    return QLatin1Char('[') + chord.join(QLatin1Char('+')) + QLatin1Char(']');
+}
+
+UsbCaptureSummary UsbCaptureSummary::summarize(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        UsbCaptureSummary summary;
+        summary.path = path;
+        summary.error = file.errorString();
+        return summary;
+    }
+    UsbCaptureSummary summary = summarize(&file);
+    summary.path = path;
+    return summary;
+}
+
+UsbCaptureSummary UsbCaptureSummary::summarize(QIODevice* in)
+{
+    UsbCaptureSummary summary;
+    QByteArray magic;
+    if (!readExactly(in, magic, 4)) {
+        summary.error = QStringLiteral("empty capture");
+        return summary;
+    }
+    Summarizer out(summary);
+    const quint32 le = qFromLittleEndian<quint32>(magic.constData());
+    const quint32 be = qFromBigEndian<quint32>(magic.constData());
+    if (le == kPcapngSectionHeader) {
+        readPcapng(in, magic, summary, out);
+    } else if (le == kPcapMagicUs || le == kPcapMagicNs || be == kPcapMagicUs || be == kPcapMagicNs) {
+        readPcap(in, magic, summary, out);
+    } else {
+        summary.error = QStringLiteral("not a pcap or pcapng file");
+    }
+    out.finish();
+    return summary;
+}
+
+QString UsbCaptureSummary::headline() const
+{
+    QList<quint32> devices;
+    for (const Endpoint& endpoint : endpoints) {
+        const quint32 key = (quint32(endpoint.bus) << 8) | endpoint.device;
+        if (!devices.contains(key)) {
+            devices.append(key);
+        }
+    }
+    int keys = 0;
+    for (const Keyboard& keyboard : keyboards) {
+        keys += keyboard.keyDowns;
+    }
+    QString line = QStringLiteral("%1 packets over %2 on %3 device(s), %4 endpoint(s)")
+                       .arg(packets)
+                       .arg(seconds(lastUs - firstUs))
+                       .arg(devices.size())
+                       .arg(endpoints.size());
+    if (keys > 0) {
+        line += QStringLiteral("; %1 keys typed").arg(keys);
+    }
+    if (!error.isEmpty()) {
+        line += QStringLiteral(" (%1)").arg(error);
+    }
+    return line;
+}
+
+QString UsbCaptureSummary::text() const
+{
+    QStringList lines{headline()};
+    for (const Endpoint& endpoint : endpoints) {
+        lines << QStringLiteral("  %1.%2 ep 0x%3 %4: %5 packets, %6 bytes, %7")
+                     .arg(endpoint.bus)
+                     .arg(endpoint.device)
+                     .arg(endpoint.endpoint, 2, 16, QLatin1Char('0'))
+                     .arg(transferName(endpoint.transferType))
+                     .arg(endpoint.packets)
+                     .arg(endpoint.bytes)
+                     .arg(seconds(endpoint.lastUs - endpoint.firstUs));
+    }
+    for (const Keyboard& keyboard : keyboards) {
+        lines << QStringLiteral("  Keyboard %1.%2: %3 keys in %4 (%5 keys/s, fastest gap %6 ms)%7")
+                     .arg(keyboard.bus)
+                     .arg(keyboard.device)
+                     .arg(keyboard.keyDowns)
+                     .arg(seconds(keyboard.lastUs - keyboard.firstUs))
+                     .arg(keyboard.keysPerSecond(), 0, 'f', 0)
+                     .arg(double(keyboard.fastestIntervalUs) / 1000.0, 0, 'f', 1)
+                     .arg(keyboard.superhuman ? QStringLiteral(", faster than a person types") : QString());
+        lines << QStringLiteral("    typed: %1%2")
+                     .arg(keyboard.typed, keyboard.truncated ? QStringLiteral("...") : QString());
+    }
+    return lines.join(QLatin1Char('\n'));
+}
+
+QJsonObject UsbCaptureSummary::toJson() const
+{
+    QJsonObject obj;
+    obj["path"] = path;
+    obj["format"] = format;
+    obj["link_type"] = int(linkType);
+    if (!error.isEmpty()) {
+        obj["error"] = error;
+    }
+    obj["packets"] = qint64(packets);
+    obj["skipped_packets"] = qint64(skippedPackets);
+    obj["first_us"] = firstUs;
+    obj["last_us"] = lastUs;
+    if (!contentDigest.isEmpty()) {
+        obj["content_digest"] = QString::fromLatin1(contentDigest.toHex());
+    }
+    QJsonArray eps;
+    for (const Endpoint& endpoint : endpoints) {
+        QJsonObject e;
+        e["bus"] = int(endpoint.bus);
+        e["device"] = int(endpoint.device);
+        e["endpoint"] = int(endpoint.endpoint);
+        e["transfer"] = transferName(endpoint.transferType);
+        e["packets"] = qint64(endpoint.packets);
+        e["bytes"] = qint64(endpoint.bytes);
+        e["first_us"] = endpoint.firstUs;
+        e["last_us"] = endpoint.lastUs;
+        eps.append(e);
+    }
+    obj["endpoints"] = eps;
+    QJsonArray kbs;
+    for (const Keyboard& keyboard : keyboards) {
+        QJsonObject k;
+        k["bus"] = int(keyboard.bus);
+        k["device"] = int(keyboard.device);
+        k["key_downs"] = keyboard.keyDowns;
+        k["typed"] = keyboard.typed;
+        k["truncated"] = keyboard.truncated;
+        k["first_us"] = keyboard.firstUs;
+        k["last_us"] = keyboard.lastUs;
+        k["fastest_interval_us"] = keyboard.fastestIntervalUs;
+        k["keys_per_second"] = keyboard.keysPerSecond();
+        k["superhuman"] = keyboard.superhuman;
+        kbs.append(k);
+    }
+    obj["keyboards"] = kbs;
+    return obj;
+}
+
+} // namespace FlashSpartan
@@ -2,21 +2,29 @@
 
 #ifdef Q_OS_WIN
 
+#include "WinDeviceNotifier.h"
 #include "WinUsbEnumerator.h"
 
 #include <QDebug>
 #include <QMutexLocker>
+#include <QSet>
+
+#include <qt_windows.h>
 
 namespace FlashSpartan {
 
 UsbHostMonitor::UsbHostMonitor(QObject* parent)
     : QThread(parent)
+    , m_wakeEvent(CreateEventW(nullptr, FALSE, FALSE, nullptr))
 {
 }
 
 UsbHostMonitor::~UsbHostMonitor()
 {
     stopMonitoring();
+    if (m_wakeEvent) {
+        CloseHandle(m_wakeEvent);
+    }
 }
 
 void UsbHostMonitor::startMonitoring()
@@ -34,6 +42,7 @@ void UsbHostMonitor::stopMonitoring()
         return;
     }
     m_running.store(false);
+    SetEvent(m_wakeEvent);
     if (!wait(5000)) {
         qWarning() << "UsbHostMonitor: thread did not stop within timeout";
     }
@@ -42,6 +51,7 @@ void UsbHostMonitor::stopMonitoring()
 void UsbHostMonitor::rescan()
 {
     m_rescanRequested.store(true);
+    SetEvent(m_wakeEvent);
 }
 
 QList<UsbHostDeviceInfo> UsbHostMonitor::connectedDevices() const
@@ -62,26 +72,91 @@ std::optional<UsbHostDeviceInfo> UsbHostMonitor::getDevice(const QString& instan
 
 void UsbHostMonitor::run()
 {
+    // Registered before the first scan, so a device plugged in during it is still reported.
+    WinDeviceNotifier notifier(WinUsbEnumerator::kUsbDeviceInterfaceClass, m_wakeEvent);
     scanExistingDevices();
     {
         QMutexLocker locker(&m_devicesMutex);
         emit initialScanComplete(m_devices.size());
     }
 
-    int idleTicks = 0;
     while (m_running.load()) {
+        const DWORD timeout = notifier.isActive() ? INFINITE : DWORD(IDLE_SCAN_INTERVAL_MS);
+        const DWORD waited = WaitForSingleObject(m_wakeEvent, timeout);
+        if (!m_running.load()) {
+            break;
+        }
         const bool rescanNow = m_rescanRequested.exchange(false);
-        if (rescanNow) {
+        if (rescanNow || waited != WAIT_OBJECT_0 || !notifier.isActive()) {
+            if (rescanNow) {
+                WinUsbEnumerator::invalidateDescriptions();  // an explicit rescan re-reads everything
+            }
+            notifier.take();  // the scan covers anything queued so far
             scanExistingDevices();
-            idleTicks = 0;
-        } else {
-            ++idleTicks;
-            if (idleTicks * POLL_TIMEOUT_MS >= IDLE_SCAN_INTERVAL_MS) {
-                scanExistingDevices();
-                idleTicks = 0;
+            continue;
+        }
+
+        QList<UsbHostDeviceInfo> present;
+        QSet<QString> described;
+        bool removal = false;
+        for (const WinDeviceNotifier::Event& event : notifier.take()) {
+            if (event.action == WinDeviceNotifier::Action::Removal) {
+                removal = true;
+                continue;
+            }
+            const QString instanceId = WinUsbEnumerator::instanceIdFromInterfacePath(event.interfacePath);
+            if (described.contains(instanceId)) {
+                continue;
             }
+            described.insert(instanceId);
+            present += WinUsbEnumerator::describeDeviceTree(instanceId);
         }
-        msleep(POLL_TIMEOUT_MS);
+
+        QStringList gone;
+        if (removal) {
+            // Composite children have no interface of their own: check every known node.
+            const QList<UsbHostDeviceInfo> known = connectedDevices();
+            for (const UsbHostDeviceInfo& info : known) {
+                if (!WinUsbEnumerator::isPresent(info.instanceId)) {
+                    gone.append(info.instanceId);
+                }
+            }
+        }
+        applyChanges(present, gone);
+    }
+}
+
+void UsbHostMonitor::applyChanges(const QList<UsbHostDeviceInfo>& present, const QStringList& gone)
+{
+    QList<UsbHostDeviceInfo> connected;
+    QList<UsbHostDeviceInfo> changed;
+    QStringList disconnected;
+    {
+        QMutexLocker locker(&m_devicesMutex);
+        for (const UsbHostDeviceInfo& info : present) {
+            const auto it = m_devices.constFind(info.instanceId);
+            if (it == m_devices.constEnd()) {
+                connected.append(info);
+            } else if (it->category != info.category || it->displayName != info.displayName) {
+                changed.append(info);
+            }
+            m_devices.insert(info.instanceId, info);
+        }
+        for (const QString& id : gone) {
+            if (m_devices.remove(id) > 0) {
+                disconnected.append(id);
+            }
+        }
+    }
+
+    for (const UsbHostDeviceInfo& info : connected) {
+        emit usbHostConnected(info);
+    }
+    for (const UsbHostDeviceInfo& info : changed) {
+        emit usbHostChanged(info);
+    }
+    for (const QString& id : disconnected) {
+        emit usbHostDisconnected(id);
     }
 }
 
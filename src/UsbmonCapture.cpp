@@ -1,72 +1,614 @@
 #include "UsbmonCapture.h"
+#include "AppDiagnostics.h"
+#include "MemoryBudget.h"
 #include "UsbPcapLocator.h"
+#include "UsbmonRing.h"
 
 #include <QDateTime>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
+#include <QMutexLocker>
 #include <QProcess>
 #include <QRegularExpression>
 #include <QStandardPaths>
+#include <QTimer>
+
+#include <algorithm>
+
+#ifndef Q_OS_WIN
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 namespace FlashSpartan {
 
+namespace {
+
+constexpr qint64 kRingBytesPerBus = 64 * 1024 * 1024;
+
+QString safeRuleId(const BadUsbAnomalyResult& anomaly)
+{
+    return anomaly.ruleId.isEmpty()
+        ? QStringLiteral("manual")
+        : QString(anomaly.ruleId).replace(QRegularExpression(QStringLiteral("[^A-Za-z0-9_.-]")),
+                                          QStringLiteral("_"));
+}
+
+} // namespace
+
+#ifdef Q_OS_WIN
+
+struct UsbmonCapture::NativeReader {};
+
+#else
+
+/** The /dev/usbmon0 descriptor, its mmap ring and the thread draining it into a UsbmonRing. */
+struct UsbmonCapture::NativeReader {
+    // drivers/usb/mon/mon_bin.c
+    struct MonBinMfetch {
+        quint32* offvec;
+        quint32 nfetch;
+        quint32 nflush;
+    };
+    static constexpr unsigned long kMonIocMagic = 0x92;
+    static constexpr unsigned long kMonIoctRingSize = _IO(kMonIocMagic, 4);
+    static constexpr unsigned long kMonIocqRingSize = _IO(kMonIocMagic, 5);
+    static constexpr unsigned long kMonIocxMfetch = _IOWR(kMonIocMagic, 7, MonBinMfetch);
+    static constexpr unsigned long kMonIochMflush = _IO(kMonIocMagic, 8);
+    // The kernel caps the binary ring a little above 1 MiB.
+    static constexpr int kKernelRingBytes = 1024 * 1024;
+    static constexpr quint32 kFetchBatch = 256;
+
+    int fd = -1;
+    int wakeFd = -1;
+    char* map = nullptr;
+    size_t mapSize = 0;
+    std::thread thread;
+    std::atomic<bool> stopping{false};
+    std::unique_ptr<HidKeystrokeAnalyzer> keystrokes;  // used on the reader thread only
+    std::function<void(const HidKeystrokeAnalyzer::Finding&)> onFinding;
+    QMutex filterMutex;
+    std::shared_ptr<const UsbmonFilter> filter = std::make_shared<UsbmonFilter>();
+
+    void setFilter(const UsbmonFilter& next)
+    {
+        auto shared = std::make_shared<const UsbmonFilter>(next);
+        QMutexLocker locker(&filterMutex);
+        filter = std::move(shared);
+    }
+
+    std::shared_ptr<const UsbmonFilter> currentFilter()
+    {
+        QMutexLocker locker(&filterMutex);
+        return filter;
+    }
+
+    ~NativeReader() { shutdown(); }
+
+    bool open(QString* error)
+    {
+        fd = ::open("/dev/usbmon0", O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            *error = QStringLiteral("Cannot open /dev/usbmon0: %1").arg(QString::fromLocal8Bit(std::strerror(errno)));
+            return false;
+        }
+        ::ioctl(fd, kMonIoctRingSize, kKernelRingBytes);  // best effort; the default ring works too
+        const int size = ::ioctl(fd, kMonIocqRingSize);
+        if (size <= 0) {
+            *error = QStringLiteral("usbmon ring size query failed: %1").arg(QString::fromLocal8Bit(std::strerror(errno)));
+            return false;
+        }
+        void* mapped = ::mmap(nullptr, size_t(size), PROT_READ, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            *error = QStringLiteral("Cannot map the usbmon ring: %1").arg(QString::fromLocal8Bit(std::strerror(errno)));
+            return false;
+        }
+        map = static_cast<char*>(mapped);
+        mapSize = size_t(size);
+        wakeFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (wakeFd < 0) {
+            *error = QStringLiteral("eventfd failed: %1").arg(QString::fromLocal8Bit(std::strerror(errno)));
+            return false;
+        }
+        return true;
+    }
+
+    void run(UsbmonRing* ring)
+    {
+        std::vector<quint32> offsets(kFetchBatch);
+        quint32 consumed = 0;
+        while (!stopping.load()) {
+            pollfd fds[2] = {{fd, POLLIN, 0}, {wakeFd, POLLIN, 0}};
+            if (::poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            if (fds[1].revents || stopping.load()) {
+                break;
+            }
+            // Releases the previous batch's slots and fetches the next one in the same call.
+            MonBinMfetch fetch{offsets.data(), kFetchBatch, consumed};
+            if (::ioctl(fd, kMonIocxMfetch, &fetch) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            const std::shared_ptr<const UsbmonFilter> batchFilter = currentFilter();
+            const bool filtering = !batchFilter->acceptsEverything();
+            for (quint32 i = 0; i < fetch.nfetch; ++i) {
+                const quint32 offset = offsets[i];
+                if (offset >= mapSize) {
+                    continue;
+                }
+                // Decided on the header so that filtered-out payloads are never copied.
+                const bool toRing = ring && (!filtering || batchFilter->matchesEvent(map + offset, mapSize - offset));
+                UsbmonPacket packet;
+                if ((!toRing && !keystrokes) || !UsbmonRing::parseEvent(map + offset, mapSize - offset, &packet)) {
+                    continue;
+                }
+                if (keystrokes) {
+                    if (const auto finding = keystrokes->feed(packet)) {
+                        onFinding(*finding);
+                    }
+                }
+                if (toRing) {
+                    ring->append(std::move(packet));
+                }
+            }
+            consumed = fetch.nfetch;
+        }
+        if (consumed > 0) {
+            ::ioctl(fd, kMonIochMflush, consumed);
+        }
+    }
+
+    void shutdown()
+    {
+        stopping.store(true);
+        if (wakeFd >= 0) {
+            const quint64 one = 1;
+            const ssize_t written = ::write(wakeFd, &one, sizeof(one));
+            Q_UNUSED(written)
+        }
+        if (thread.joinable()) {
+            thread.join();
+        }
+        if (map) {
+            ::munmap(map, mapSize);
+            map = nullptr;
+        }
+        if (wakeFd >= 0) {
+            ::close(wakeFd);
+            wakeFd = -1;
+        }
+        if (fd >= 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+};
+
+#endif
+
+/** One running capture: a command process, or a pcapng file fed from the ring. */
+struct UsbmonCapture::Session {
+    quint16 bus = 0;  // 0: every bus
+    quint8 address = 0;  // 0: unknown, the whole bus is dumped
+    QString outputPath;
+    BadUsbAnomalyResult anomaly;
+
+    QProcess* process = nullptr;
+
+    std::unique_ptr<QFile> dumpFile;
+    std::unique_ptr<PcapngWriter> dumpWriter;
+    UsbmonFilter dumpFilter;
+    qint64 dumpFromUs = 0;
+    quint64 dumpSequence = 0;
+    qint64 dumpEndUs = 0;
+};
+
 UsbmonCapture::UsbmonCapture(QObject* parent)
     : QObject(parent)
 {
+    qRegisterMetaType<HidKeystrokeAnalyzer::Finding>("HidKeystrokeAnalyzer::Finding");
+    m_dumpTimer = new QTimer(this);
+    m_dumpTimer->setInterval(1000);
+    connect(m_dumpTimer, &QTimer::timeout, this, &UsbmonCapture::onDumpTick);
+}
+
+UsbmonCapture::~UsbmonCapture()
+{
+    finishRingDumps(false);
+    for (const auto& session : m_sessions) {
+        if (session->process) {
+            // Killed with this object; nothing is left to report to.
+            session->process->disconnect(this);
+        }
+    }
+    m_sessions.clear();
+    stopNativeFeed();
 }
 
 QString UsbmonCapture::outputDirectory() const
 {
-    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
-           + QStringLiteral("/badusb-captures");
+    return AppDiagnostics::badUsbCapturesDir();
 }
 
 bool UsbmonCapture::isRunning() const
 {
-    return m_process && m_process->state() != QProcess::NotRunning;
+    return !m_sessions.empty();
 }
 
-bool UsbmonCapture::startCapture(const HidDeviceInfo& device,
-                                 const BadUsbAnomalyResult& anomaly,
-                                 const QString& commandTemplate)
+int UsbmonCapture::runningCaptures() const
+{
+    return int(m_sessions.size());
+}
+
+bool UsbmonCapture::isCapturing(quint16 bus) const
+{
+    for (const auto& session : m_sessions) {
+        if (bus == 0 || session->bus == 0 || session->bus == bus) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UsbmonCapture::admitCapture(quint16 bus)
+{
+    if (runningCaptures() >= kMaxConcurrentCaptures) {
+        emit captureFailed(QStringLiteral("%1 USB captures are already running").arg(runningCaptures()));
+        return false;
+    }
+    if (isCapturing(bus)) {
+        emit captureFailed(bus != 0 ? QStringLiteral("USB bus %1 is already being captured").arg(bus)
+                                    : QStringLiteral("A USB capture is already running"));
+        return false;
+    }
+    return true;
+}
+
+QString UsbmonCapture::nextOutputPath(quint16 bus, const BadUsbAnomalyResult& anomaly,
+                                      const QString& extension) const
+{
+    QDir().mkpath(outputDirectory());
+    // The bus keeps captures of two buses started in the same second apart.
+    return outputDirectory() + QLatin1Char('/')
+           + QDateTime::currentDateTimeUtc().toString(QStringLiteral("yyyyMMdd-hhmmss"))
+           + QLatin1Char('-') + safeRuleId(anomaly)
+           + (bus != 0 ? QStringLiteral("-bus%1").arg(bus) : QString()) + extension;
+}
+
+bool UsbmonCapture::isNativeFeedRunning() const
+{
+    return m_reader != nullptr;
+}
+
+bool UsbmonCapture::startNativeFeed(int preTriggerSeconds, bool keystrokeAnalysis, QString* error)
 {
 #ifdef Q_OS_WIN
-    if (isRunning()) {
-        emit captureFailed(QStringLiteral("A USB capture is already running"));
+    Q_UNUSED(preTriggerSeconds)
+    Q_UNUSED(keystrokeAnalysis)
+    if (error) {
+        *error = QStringLiteral("The native usbmon feed is only available on Linux");
+    }
+    return false;
+#else
+    preTriggerSeconds = qMax(0, preTriggerSeconds);
+    if (preTriggerSeconds == 0 && !keystrokeAnalysis) {
+        stopNativeFeed();
+        return false;
+    }
+    if (m_reader && preTriggerSeconds == m_preTriggerSeconds && keystrokeAnalysis == m_keystrokeAnalysis) {
+        return true;
+    }
+    finishRingDumps();
+    stopNativeFeed();
+
+    auto reader = std::make_unique<NativeReader>();
+    QString openError;
+    if (!reader->open(&openError)) {
+        if (error) {
+            *error = openError;
+        }
+        return false;
+    }
+    if (preTriggerSeconds > 0) {
+        // Long enough for a trigger's pre-trigger window plus everything written after it.
+        const qint64 maxAgeUs = qint64(preTriggerSeconds + kPostTriggerSeconds + 5) * 1000000;
+        m_ring = std::make_unique<UsbmonRing>(maxAgeUs, kRingBytesPerBus);
+        // Pre-trigger history is what makes a BadUSB dump useful; it goes after the caches.
+        m_budgetId = MemoryBudget::instance().add(
+            {QStringLiteral("usbmon history"), MemoryBudget::Keep::High,
+             [ring = m_ring.get()]() { return ring->totalBytes(); },
+             [ring = m_ring.get()](qint64 target) { ring->shrinkTo(target); }});
+    }
+    if (keystrokeAnalysis) {
+        reader->keystrokes = std::make_unique<HidKeystrokeAnalyzer>();
+        reader->onFinding = [this](const HidKeystrokeAnalyzer::Finding& finding) {
+            QMetaObject::invokeMethod(this, [this, finding]() { emit keystrokeRateExceeded(finding); },
+                                      Qt::QueuedConnection);
+        };
+    }
+    m_preTriggerSeconds = preTriggerSeconds;
+    m_keystrokeAnalysis = keystrokeAnalysis;
+    reader->setFilter(ringFilter());
+    reader->thread = std::thread([r = reader.get(), ring = m_ring.get()] { r->run(ring); });
+    m_reader = std::move(reader);
+    return true;
+#endif
+}
+
+void UsbmonCapture::setDeviceFiltering(bool enabled)
+{
+    if (m_deviceFiltering == enabled) {
+        return;
+    }
+    m_deviceFiltering = enabled;
+    applyRingFilter();
+}
+
+bool UsbmonCapture::deviceFiltering() const
+{
+    return m_deviceFiltering;
+}
+
+UsbmonFilter UsbmonCapture::ringFilter() const
+{
+    if (!m_deviceFiltering) {
+        return {};
+    }
+    QList<UsbmonFilter::Device> watched;
+    for (const auto& session : m_sessions) {
+        if (session->dumpFile && session->address != 0) {
+            watched.append(UsbmonFilter::Device{session->bus, session->address, UsbmonFilter::kAllEndpoints});
+        }
+    }
+    return UsbmonFilter::enumerationAndHid(watched);
+}
+
+void UsbmonCapture::applyRingFilter()
+{
+#ifndef Q_OS_WIN
+    if (m_reader) {
+        m_reader->setFilter(ringFilter());
+    }
+#endif
+}
+
+void UsbmonCapture::stopNativeFeed()
+{
+    finishRingDumps();
+    m_reader.reset();
+    if (m_budgetId) {
+        MemoryBudget::instance().remove(m_budgetId);
+        m_budgetId = 0;
+    }
+    m_ring.reset();
+    m_preTriggerSeconds = 0;
+    m_keystrokeAnalysis = false;
+}
+
+bool UsbmonCapture::startRingDump(const HidDeviceInfo& device, const BadUsbAnomalyResult& anomaly)
+{
+    auto session = std::make_unique<Session>();
+    session->bus = device.usbBus.toUShort();  // "003" -> 3; 0 (unknown) dumps every bus
+    session->address = session->bus != 0 ? quint8(device.usbDevNum.toUShort()) : 0;
+    session->anomaly = anomaly;
+    session->outputPath = nextOutputPath(session->bus, anomaly, QStringLiteral(".pcapng"));
+
+    session->dumpFile = std::make_unique<QFile>(session->outputPath);
+    QFile* file = session->dumpFile.get();
+    if (!file->open(QIODevice::WriteOnly)) {
+        emit captureFailed(QStringLiteral("Cannot write %1: %2").arg(session->outputPath, file->errorString()));
+        return false;
+    }
+    session->dumpWriter = std::make_unique<PcapngWriter>(file);
+    session->dumpFilter = m_deviceFiltering && session->address != 0
+        ? UsbmonFilter::singleDevice(session->bus, session->address)
+        : UsbmonFilter();
+    const QString comment = QStringLiteral("%1: %2 (%3)")
+                                .arg(anomaly.ruleId, anomaly.summary, device.stableId());
+    if (!session->dumpWriter->writeSectionHeader(comment)
+        || !session->dumpWriter->writeInterface(UsbmonRing::kLinkType,
+                                                QStringLiteral("usbmon%1").arg(session->bus))) {
+        emit captureFailed(QStringLiteral("Cannot write %1: %2").arg(session->outputPath, file->errorString()));
+        return false;
+    }
+
+    const qint64 nowUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+    session->dumpFromUs = nowUs - qint64(m_preTriggerSeconds) * 1000000;
+    session->dumpEndUs = nowUs + qint64(kPostTriggerSeconds) * 1000000;
+    if (!flushRingDump(*session)) {
+        emit captureFailed(QStringLiteral("Cannot write %1: %2").arg(session->outputPath, file->errorString()));
+        return false;
+    }
+
+    const QString path = session->outputPath;
+    m_sessions.push_back(std::move(session));
+    applyRingFilter();  // from now on the suspect's bulk and isochronous traffic too
+    if (!m_dumpTimer->isActive()) {
+        m_dumpTimer->start();
+    }
+    emit captureStarted(path);
+    return true;
+}
+
+bool UsbmonCapture::flushRingDump(Session& session)
+{
+    if (!session.dumpFile || !m_ring) {
+        return false;
+    }
+    const QList<UsbmonPacket> packets = m_ring->packets(session.bus, session.dumpFromUs, session.dumpSequence);
+    for (const UsbmonPacket& packet : packets) {
+        session.dumpSequence = packet.sequence;
+        if (!session.dumpFilter.matches(packet)) {
+            continue;
+        }
+        if (!session.dumpWriter->writePacket(0, packet.timestampUs, packet.frame, packet.originalLength)) {
+            return false;
+        }
+    }
+    return session.dumpFile->flush();
+}
+
+void UsbmonCapture::onDumpTick()
+{
+    const qint64 nowUs = QDateTime::currentMSecsSinceEpoch() * 1000;
+    std::vector<Session*> done;
+    qint64 dumpedBytes = 0;
+    Session* largest = nullptr;
+    for (const auto& session : m_sessions) {
+        if (!session->dumpFile) {
+            continue;
+        }
+        if (!flushRingDump(*session) || nowUs >= session->dumpEndUs) {
+            done.push_back(session.get());
+            continue;
+        }
+        dumpedBytes += session->dumpFile->size();
+        if (!largest || session->dumpFile->size() > largest->dumpFile->size()) {
+            largest = session.get();
+        }
+    }
+    if (largest && dumpedBytes > kMaxConcurrentDumpBytes) {
+        emit captureFailed(QStringLiteral("Running captures reached %1 MiB; %2 was stopped early")
+                               .arg(kMaxConcurrentDumpBytes / (1024 * 1024))
+                               .arg(largest->outputPath));
+        done.push_back(largest);
+    }
+    for (Session* session : done) {
+        finishRingDump(session);
+    }
+}
+
+void UsbmonCapture::finishRingDump(Session* session, bool notify)
+{
+    const auto it = std::find_if(m_sessions.begin(), m_sessions.end(),
+                                 [session](const auto& s) { return s.get() == session; });
+    if (it == m_sessions.end() || !session->dumpFile) {
+        return;
+    }
+    std::unique_ptr<Session> finished = std::move(*it);
+    m_sessions.erase(it);
+    flushRingDump(*finished);
+    const bool ok = finished->dumpFile->error() == QFileDevice::NoError;
+    finished->dumpFile->close();
+    applyRingFilter();
+    if (std::none_of(m_sessions.begin(), m_sessions.end(), [](const auto& s) { return s->dumpFile != nullptr; })) {
+        m_dumpTimer->stop();
+    }
+    if (notify) {
+        emit captureFinished(finished->outputPath, ok ? 0 : 1, finished->anomaly);
+    }
+}
+
+void UsbmonCapture::finishRingDumps(bool notify)
+{
+    std::vector<Session*> dumps;
+    for (const auto& session : m_sessions) {
+        if (session->dumpFile) {
+            dumps.push_back(session.get());
+        }
+    }
+    for (Session* session : dumps) {
+        finishRingDump(session, notify);
+    }
+}
+
+bool UsbmonCapture::startCommandCapture(std::unique_ptr<Session> session, const QString& program,
+                                        const QStringList& arguments, int startTimeoutMs)
+{
+    auto* process = new QProcess(this);
+    process->setProgram(program);
+    process->setArguments(arguments);
+    process->setProcessChannelMode(QProcess::MergedChannels);
+    session->process = process;
+    connect(process, &QProcess::errorOccurred, this, [this, process](QProcess::ProcessError) {
+        emit captureFailed(process->errorString());
+    });
+    connect(process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
+            this, [this, process](int exitCode, QProcess::ExitStatus) {
+                process->deleteLater();
+                const auto it = std::find_if(m_sessions.begin(), m_sessions.end(),
+                                             [process](const auto& s) { return s->process == process; });
+                if (it == m_sessions.end()) {
+                    return;
+                }
+                std::unique_ptr<Session> finished = std::move(*it);
+                m_sessions.erase(it);
+                emit captureFinished(finished->outputPath, exitCode, finished->anomaly);
+            });
+
+    process->start();
+    if (!process->waitForStarted(startTimeoutMs)) {
+        const QString error = process->errorString();
+        process->disconnect(this);
+        process->deleteLater();
+        emit captureFailed(error);
         return false;
     }
 
+    const QString path = session->outputPath;
+    m_sessions.push_back(std::move(session));
+    emit captureStarted(path);
+    return true;
+}
+
+bool UsbmonCapture::startCapture(const HidDeviceInfo& device,
+                                 const BadUsbAnomalyResult& anomaly,
+                                 const QString& commandTemplate)
+{
+#ifdef Q_OS_WIN
     QString bus = device.usbBus;
     bus.remove(QRegularExpression(QStringLiteral("^0+")));
     if (bus.isEmpty()) {
         bus = QStringLiteral("1");
     }
-
-    QDir().mkpath(outputDirectory());
-    const QString safeRule = anomaly.ruleId.isEmpty()
-        ? QStringLiteral("manual")
-        : QString(anomaly.ruleId).replace(QRegularExpression(QStringLiteral("[^A-Za-z0-9_.-]")),
-                                          QStringLiteral("_"));
-    m_outputPath = outputDirectory() + QLatin1Char('/')
-                   + QDateTime::currentDateTimeUtc().toString(QStringLiteral("yyyyMMdd-hhmmss"))
-                   + QLatin1Char('-') + safeRule + QStringLiteral(".pcap");
+    auto session = std::make_unique<Session>();
+    session->bus = bus.toUShort();
+    if (!admitCapture(session->bus)) {
+        return false;
+    }
+    session->anomaly = anomaly;
+    session->outputPath = nextOutputPath(session->bus, anomaly, QStringLiteral(".pcap"));
 
     QString templ = commandTemplate.trimmed();
     if (templ.isEmpty()) {
-        templ = QStringLiteral("USBPcapCMD.exe -d \\\\.\\USBPcap{bus} -o \"{out}\" -A");
+        templ = QStringLiteral("USBPcapCMD.exe -d \\\\.\\USBPcap{bus} -o \"{out}\" {devices}");
     }
+    // USBPcap filters by device address in the driver, so only the suspect reaches the file.
+    const QString address = device.usbDevNum.trimmed();
+    templ.replace(QStringLiteral("{devices}"), m_deviceFiltering && !address.isEmpty()
+                                                   ? QStringLiteral("--devices %1").arg(address)
+                                                   : QStringLiteral("-A"));
+    templ.replace(QStringLiteral("{device}"), address);
     templ.replace(QStringLiteral("{bus}"), bus);
-    templ.replace(QStringLiteral("{out}"), m_outputPath);
+    templ.replace(QStringLiteral("{out}"), session->outputPath);
     templ.replace(QStringLiteral("{stable_id}"), device.stableId());
-    templ.replace(QStringLiteral("{rule_id}"), safeRule);
+    templ.replace(QStringLiteral("{rule_id}"), safeRuleId(anomaly));
 
-    QString program = templ.section(QLatin1Char(' '), 0, 0);
     QStringList args = QProcess::splitCommand(templ);
     if (args.isEmpty()) {
         emit captureFailed(QStringLiteral("USB capture command is empty"));
         return false;
     }
-    program = args.takeFirst();
+    QString program = args.takeFirst();
     const QString baseName = QFileInfo(program).fileName();
     if (baseName.compare(QStringLiteral("USBPcapCMD.exe"), Qt::CaseInsensitive) == 0
         || baseName.compare(QStringLiteral("USBPcapCMD"), Qt::CaseInsensitive) == 0) {
@@ -88,112 +630,59 @@ bool UsbmonCapture::startCapture(const HidDeviceInfo& device,
             "(standard path: C:\\Program Files\\USBPcap\\USBPcapCMD.exe)."));
         return false;
     }
-
-    m_process = new QProcess(this);
-    m_process->setProgram(program);
-    m_process->setArguments(args);
-    m_process->setProcessChannelMode(QProcess::MergedChannels);
-    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError) {
-        emit captureFailed(m_process ? m_process->errorString() : QStringLiteral("USBPcap failed"));
-    });
-    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            this, [this](int exitCode, QProcess::ExitStatus) {
-                const QString path = m_outputPath;
-                QProcess* finished = m_process;
-                m_process = nullptr;
-                if (finished) {
-                    finished->deleteLater();
-                }
-                emit captureFinished(path, exitCode);
-            });
-
-    m_process->start();
-    if (!m_process->waitForStarted(5000)) {
-        const QString error = m_process->errorString();
-        m_process->deleteLater();
-        m_process = nullptr;
-        emit captureFailed(error);
-        return false;
-    }
-
-    emit captureStarted(m_outputPath);
-    return true;
+    return startCommandCapture(std::move(session), program, args, 5000);
 #else
-    if (isRunning()) {
-        emit captureFailed(QStringLiteral("A usbmon capture is already running"));
+    if (!admitCapture(device.usbBus.toUShort())) {
         return false;
     }
+    if (m_ring) {
+        return startRingDump(device, anomaly);
+    }
 
     QString bus = device.usbBus;
     bus.remove(QRegularExpression(QStringLiteral("^0+")));
     if (bus.isEmpty()) {
         bus = QStringLiteral("0");
     }
-
-    QDir().mkpath(outputDirectory());
-    const QString safeRule = anomaly.ruleId.isEmpty()
-        ? QStringLiteral("manual")
-        : QString(anomaly.ruleId).replace(QRegularExpression(QStringLiteral("[^A-Za-z0-9_.-]")),
-                                          QStringLiteral("_"));
-    m_outputPath = outputDirectory() + QLatin1Char('/')
-                   + QDateTime::currentDateTimeUtc().toString(QStringLiteral("yyyyMMdd-hhmmss"))
-                   + QLatin1Char('-') + safeRule + QStringLiteral(".pcap");
+    auto session = std::make_unique<Session>();
+    session->bus = bus.toUShort();
+    session->anomaly = anomaly;
+    session->outputPath = nextOutputPath(session->bus, anomaly, QStringLiteral(".pcap"));
 
     QString templ = commandTemplate.trimmed();
     if (templ.isEmpty()) {
         templ = QStringLiteral("tcpdump -i usbmon{bus} -w {out} -G 30 -W 1");
     }
+    templ.replace(QStringLiteral("{device}"), device.usbDevNum.trimmed());
     templ.replace(QStringLiteral("{bus}"), bus);
-    templ.replace(QStringLiteral("{out}"), m_outputPath);
+    templ.replace(QStringLiteral("{out}"), session->outputPath);
     templ.replace(QStringLiteral("{stable_id}"), device.stableId());
-    templ.replace(QStringLiteral("{rule_id}"), safeRule);
+    templ.replace(QStringLiteral("{rule_id}"), safeRuleId(anomaly));
 
-    const QStringList parts = QProcess::splitCommand(templ);
+    QStringList parts = QProcess::splitCommand(templ);
     if (parts.isEmpty()) {
         emit captureFailed(QStringLiteral("usbmon capture command is empty"));
         return false;
     }
-
-    m_process = new QProcess(this);
-    m_process->setProgram(parts.first());
-    m_process->setArguments(parts.mid(1));
-    m_process->setProcessChannelMode(QProcess::MergedChannels);
-    connect(m_process, &QProcess::errorOccurred, this, [this](QProcess::ProcessError) {
-        emit captureFailed(m_process ? m_process->errorString() : QStringLiteral("usbmon failed"));
-    });
-    connect(m_process, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished),
-            this, [this](int exitCode, QProcess::ExitStatus) {
-                const QString path = m_outputPath;
-                QProcess* finished = m_process;
-                m_process = nullptr;
-                if (finished) {
-                    finished->deleteLater();
-                }
-                emit captureFinished(path, exitCode);
-            });
-
-    m_process->start();
-    if (!m_process->waitForStarted(3000)) {
-        const QString error = m_process->errorString();
-        m_process->deleteLater();
-        m_process = nullptr;
-        emit captureFailed(error);
-        return false;
-    }
-
-    emit captureStarted(m_outputPath);
-    return true;
+    const QString program = parts.takeFirst();
+    return startCommandCapture(std::move(session), program, parts, 3000);
 #endif
 }
 
 void UsbmonCapture::stopCapture()
 {
-    if (!isRunning()) {
-        return;
+    finishRingDumps();
+    std::vector<QProcess*> processes;
+    for (const auto& session : m_sessions) {
+        if (session->process) {
+            processes.push_back(session->process);
+        }
     }
-    m_process->terminate();
-    if (!m_process->waitForFinished(3000)) {
-        m_process->kill();
+    for (QProcess* process : processes) {
+        process->terminate();
+        if (!process->waitForFinished(3000)) {
+            process->kill();
+        }
     }
 }
 
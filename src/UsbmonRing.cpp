@@ -0,0 +1,288 @@
+#include "UsbmonRing.h"
+
+#include <QCoreApplication>
+#include <QIODevice>
+#include <QMutexLocker>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+namespace FlashSpartan {
+
+namespace {
+
+// struct mon_bin_hdr (drivers/usb/mon/mon_bin.c), native byte order.
+constexpr size_t kTypeOffset = 8;
+constexpr size_t kXferTypeOffset = 9;
+constexpr size_t kEpnumOffset = 10;
+constexpr size_t kDevnumOffset = 11;
+constexpr size_t kBusnumOffset = 12;
+constexpr size_t kTsSecOffset = 16;
+constexpr size_t kTsUsecOffset = 24;
+constexpr size_t kStatusOffset = 28;
+constexpr size_t kLenUrbOffset = 32;
+constexpr size_t kLenCapOffset = 36;
+constexpr size_t kNdescOffset = 60;
+constexpr char kFillerType = '@';
+
+template <typename T>
+T field(const char* entry, size_t offset)
+{
+    T value;
+    std::memcpy(&value, entry + offset, sizeof(T));
+    return value;
+}
+
+void appendLe32(QByteArray* out, quint32 value)
+{
+    const quint32 le = qToLittleEndian(value);
+    out->append(reinterpret_cast<const char*>(&le), 4);
+}
+
+void appendLe16(QByteArray* out, quint16 value)
+{
+    const quint16 le = qToLittleEndian(value);
+    out->append(reinterpret_cast<const char*>(&le), 2);
+}
+
+void appendPadded(QByteArray* out, const QByteArray& data)
+{
+    out->append(data);
+    out->append(QByteArray((4 - data.size() % 4) % 4, '\0'));
+}
+
+void appendOption(QByteArray* out, quint16 code, const QByteArray& value)
+{
+    appendLe16(out, code);
+    appendLe16(out, quint16(value.size()));
+    appendPadded(out, value);
+}
+
+void appendEndOfOptions(QByteArray* out)
+{
+    appendLe32(out, 0);
+}
+
+} // namespace
+
+UsbmonFilter UsbmonFilter::enumerationAndHid(const QList<Device>& devices)
+{
+    UsbmonFilter filter;
+    filter.devices = devices;
+    filter.otherTransfers = transferBit(kTransferControl) | transferBit(kTransferInterrupt);
+    return filter;
+}
+
+UsbmonFilter UsbmonFilter::singleDevice(quint16 bus, quint8 address)
+{
+    UsbmonFilter filter;
+    filter.devices = {Device{bus, address, kAllEndpoints}, Device{bus, 0, kAllEndpoints}};
+    filter.otherTransfers = 0;
+    return filter;
+}
+
+bool UsbmonFilter::matches(quint16 bus, quint8 address, quint8 endpoint, quint8 transferType) const
+{
+    if (otherTransfers & transferBit(transferType)) {
+        return true;
+    }
+    for (const Device& device : devices) {
+        if ((device.bus == 0 || device.bus == bus) && device.address == address
+            && (device.endpoints & endpointBit(endpoint))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool UsbmonFilter::matches(const UsbmonPacket& packet) const
+{
+    return matches(packet.bus, packet.device, packet.endpoint, packet.transferType);
+}
+
+bool UsbmonFilter::matchesEvent(const char* entry, size_t available) const
+{
+    if (available < UsbmonRing::kHeaderBytes) {
+        return false;
+    }
+    return matches(field<quint16>(entry, kBusnumOffset), quint8(entry[kDevnumOffset]),
+                   quint8(entry[kEpnumOffset]), quint8(entry[kXferTypeOffset]));
+}
+
+UsbmonRing::UsbmonRing(qint64 maxAgeUs, qint64 maxBytesPerBus)
+    : m_maxAgeUs(maxAgeUs)
+    , m_maxBytesPerBus(maxBytesPerBus)
+{
+}
+
+void UsbmonRing::append(UsbmonPacket packet)
+{
+    QMutexLocker locker(&m_mutex);
+    packet.sequence = m_nextSequence++;
+    Window& window = m_windows[packet.bus];
+    const qint64 oldest = packet.timestampUs - m_maxAgeUs;
+    window.bytes += packet.frame.size();
+    window.packets.push_back(std::move(packet));
+    while (window.packets.size() > 1
+           && (window.packets.front().timestampUs < oldest || window.bytes > m_maxBytesPerBus)) {
+        window.bytes -= window.packets.front().frame.size();
+        window.packets.pop_front();
+    }
+}
+
+QList<UsbmonPacket> UsbmonRing::packets(quint16 bus, qint64 fromUs, quint64 afterSequence) const
+{
+    QMutexLocker locker(&m_mutex);
+    QList<UsbmonPacket> out;
+    for (auto window = m_windows.cbegin(); window != m_windows.cend(); ++window) {
+        if (bus != 0 && window.key() != bus) {
+            continue;
+        }
+        for (const UsbmonPacket& packet : window->packets) {
+            if (packet.timestampUs >= fromUs && packet.sequence > afterSequence) {
+                out.append(packet);
+            }
+        }
+    }
+    if (bus == 0) {
+        std::sort(out.begin(), out.end(),
+                  [](const UsbmonPacket& a, const UsbmonPacket& b) { return a.sequence < b.sequence; });
+    }
+    return out;
+}
+
+qint64 UsbmonRing::bytes(quint16 bus) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_windows.value(bus).bytes;
+}
+
+qint64 UsbmonRing::totalBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 total = 0;
+    for (const Window& window : m_windows) {
+        total += window.bytes;
+    }
+    return total;
+}
+
+void UsbmonRing::shrinkTo(qint64 maxBytes)
+{
+    QMutexLocker locker(&m_mutex);
+    qint64 total = 0;
+    for (const Window& window : std::as_const(m_windows)) {
+        total += window.bytes;
+    }
+    while (total > maxBytes) {
+        Window* oldest = nullptr;
+        for (Window& window : m_windows) {
+            if (!window.packets.empty()
+                && (!oldest || window.packets.front().sequence < oldest->packets.front().sequence)) {
+                oldest = &window;
+            }
+        }
+        if (!oldest) {
+            break;
+        }
+        const qint64 size = oldest->packets.front().frame.size();
+        oldest->bytes -= size;
+        total -= size;
+        oldest->packets.pop_front();
+    }
+}
+
+void UsbmonRing::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_windows.clear();
+}
+
+bool UsbmonRing::parseEvent(const char* entry, size_t available, UsbmonPacket* out)
+{
+    if (available < kHeaderBytes || entry[kTypeOffset] == kFillerType) {
+        return false;
+    }
+    const quint32 ndesc = field<quint32>(entry, kNdescOffset);
+    const quint32 lenCap = field<quint32>(entry, kLenCapOffset);
+    const quint64 descriptorBytes = quint64(ndesc) * kIsoDescriptorBytes;
+    const quint64 length = kHeaderBytes + descriptorBytes + lenCap;
+    if (length > available) {
+        return false;
+    }
+    out->bus = field<quint16>(entry, kBusnumOffset);
+    out->device = quint8(entry[kDevnumOffset]);
+    out->eventType = entry[kTypeOffset];
+    out->transferType = quint8(entry[kXferTypeOffset]);
+    out->endpoint = quint8(entry[kEpnumOffset]);
+    out->status = field<qint32>(entry, kStatusOffset);
+    out->timestampUs = field<qint64>(entry, kTsSecOffset) * 1000000 + field<qint32>(entry, kTsUsecOffset);
+    out->originalLength = quint32(kHeaderBytes + descriptorBytes + field<quint32>(entry, kLenUrbOffset));
+    out->frame = QByteArray(entry, qsizetype(length));
+    return true;
+}
+
+PcapngWriter::PcapngWriter(QIODevice* out)
+    : m_out(out)
+{
+}
+
+bool PcapngWriter::writeSectionHeader(const QString& comment)
+{
+    QByteArray body;
+    appendLe32(&body, 0x1A2B3C4D);  // byte-order magic
+    appendLe16(&body, 1);
+    appendLe16(&body, 0);
+    appendLe32(&body, 0xFFFFFFFF);  // section length unknown (-1)
+    appendLe32(&body, 0xFFFFFFFF);
+    if (!comment.isEmpty()) {
+        appendOption(&body, 1, comment.toUtf8());  // opt_comment
+    }
+    appendOption(&body, 4, QCoreApplication::applicationName().toUtf8());  // shb_userappl
+    appendEndOfOptions(&body);
+    return writeBlock(0x0A0D0D0A, body);
+}
+
+bool PcapngWriter::writeInterface(quint16 linkType, const QString& name, quint32 snapLength)
+{
+    QByteArray body;
+    appendLe16(&body, linkType);
+    appendLe16(&body, 0);
+    appendLe32(&body, snapLength);
+    if (!name.isEmpty()) {
+        appendOption(&body, 2, name.toUtf8());  // if_name
+    }
+    appendEndOfOptions(&body);
+    return writeBlock(1, body);
+}
+
+bool PcapngWriter::writePacket(quint32 interfaceId, qint64 timestampUs, const QByteArray& data,
+                               quint32 originalLength)
+{
+    // Microsecond timestamps, the pcapng default resolution.
+    const quint64 ts = quint64(timestampUs);
+    QByteArray body;
+    body.reserve(20 + data.size() + 3);
+    appendLe32(&body, interfaceId);
+    appendLe32(&body, quint32(ts >> 32));
+    appendLe32(&body, quint32(ts));
+    appendLe32(&body, quint32(data.size()));
+    appendLe32(&body, qMax(originalLength, quint32(data.size())));
+    appendPadded(&body, data);
+    return writeBlock(6, body);
+}
+
+bool PcapngWriter::writeBlock(quint32 type, const QByteArray& body)
+{
+    const quint32 total = quint32(body.size()) + 12;
+    QByteArray block;
+    block.reserve(qsizetype(total));
+    appendLe32(&block, type);
+    appendLe32(&block, total);
+    block.append(body);
+    appendLe32(&block, total);
+    return m_out && m_out->write(block) == block.size();
+}
+
+} // namespace FlashSpartan
@@ -1,23 +1,50 @@
 #include "VerifyCli.h"
 
+#include "CloneVerify.h"
+#include "HashCheckpoint.h"
+#include "HashScheduler.h"
+#include "ImageFlasher.h"
 #include "IsoCatalog.h"
 #include "IsoCatalogManifest.h"
+#include "IsoHttpClient.h"
+#include "IsoMirrorServer.h"
 #include "IsoVerifier.h"
 #include "IsoVerifyReport.h"
 #include "IsoVerifySettingsLoader.h"
+#include "ManifestService.h"
+#include "RawDeviceHash.h"
+#include "WatchManifestFile.h"
 
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QMutex>
+#include <QtConcurrent>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <optional>
+#include <vector>
 
 namespace FlashSpartan {
 
 static QString s_configFilePath;
 static bool s_jsonOutput = false;
 static bool s_quietOutput = false;
+static int s_progressIntervalMs = 0;
 
 void VerifyCli::setConfigFilePath(const QString& path)
 {
@@ -29,6 +56,11 @@ void VerifyCli::setJsonOutput(bool enabled)
     s_jsonOutput = enabled;
 }
 
+void VerifyCli::setProgressInterval(int ms)
+{
+    s_progressIntervalMs = qMax(0, ms);
+}
+
 void VerifyCli::setQuietOutput(bool enabled)
 {
     s_quietOutput = enabled;
@@ -189,6 +221,1015 @@ int VerifyCli::runListPublishers()
     return ExitOk;
 }
 
+static void printJsonLine(const QJsonObject& obj)
+{
+    // Results come from worker threads while the main thread prints progress.
+    static QMutex mutex;
+    QMutexLocker lock(&mutex);
+    std::cout << QJsonDocument(obj).toJson(QJsonDocument::Compact).constData() << '\n' << std::flush;
+}
+
+static double mebibytesPerSecond(uint64_t bytes, double seconds)
+{
+    return seconds > 0.0 ? static_cast<double>(bytes) / (1024.0 * 1024.0) / seconds : 0.0;
+}
+
+/** Rate over the last tick of one target's byte counter. */
+struct ProgressRate {
+    uint64_t lastBytes = 0;
+
+    double update(uint64_t bytesDone, double seconds)
+    {
+        const uint64_t delta = bytesDone > lastBytes ? bytesDone - lastBytes : 0;
+        lastBytes = bytesDone;
+        return mebibytesPerSecond(delta, seconds);
+    }
+};
+
+static QJsonObject progressLine(const QString& target, uint64_t bytesDone, uint64_t bytesTotal, double mbps)
+{
+    QJsonObject obj;
+    obj.insert(QStringLiteral("type"), QStringLiteral("progress"));
+    obj.insert(QStringLiteral("target"), target);
+    obj.insert(QStringLiteral("bytes_done"), static_cast<double>(bytesDone));
+    obj.insert(QStringLiteral("bytes_total"), static_cast<double>(bytesTotal));
+    if (bytesTotal > 0) {
+        obj.insert(QStringLiteral("fraction"),
+                   qMin(1.0, static_cast<double>(bytesDone) / static_cast<double>(bytesTotal)));
+    }
+    obj.insert(QStringLiteral("mbps"), mbps);
+    if (mbps > 0.0 && bytesTotal > bytesDone) {
+        obj.insert(QStringLiteral("eta_s"),
+                   static_cast<double>(bytesTotal - bytesDone) / (1024.0 * 1024.0) / mbps);
+    }
+    return obj;
+}
+
+/** Waits for @p pool, calling @p tick with the seconds since the last one while progress is on. */
+static void waitWithProgress(QThreadPool& pool, const std::function<void(double)>& tick)
+{
+    if (s_progressIntervalMs <= 0 || !s_jsonOutput) {
+        pool.waitForDone();
+        return;
+    }
+    QElapsedTimer sinceTick;
+    sinceTick.start();
+    while (!pool.waitForDone(s_progressIntervalMs)) {
+        tick(static_cast<double>(sinceTick.restart()) / 1000.0);
+    }
+}
+
+static std::optional<WatchManifest> loadWatchManifest(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+    const QByteArray data = file.readAll();
+    if (auto binary = WatchManifestFile::decode(data)) {
+        return binary;
+    }
+    const QJsonDocument doc = QJsonDocument::fromJson(data);
+    if (!doc.isObject()) {
+        return std::nullopt;
+    }
+    return WatchManifest::fromJson(doc.object());
+}
+
+int VerifyCli::runVerifyWatch(const QString& manifestPath, const QStringList& mountPoints)
+{
+    const std::optional<WatchManifest> manifest = loadWatchManifest(manifestPath);
+    if (!manifest || manifest->groups.isEmpty()) {
+        if (!jsonOutput()) {
+            std::cerr << "Cannot read a watch manifest with groups from " << manifestPath.toStdString() << '\n';
+        }
+        return ExitError;
+    }
+    if (mountPoints.isEmpty()) {
+        if (!jsonOutput()) {
+            std::cerr << "verify-watch needs at least one --watch-mount path.\n";
+        }
+        return ExitError;
+    }
+
+    ManifestService::Progress progress;
+    ManifestService::BatchVerifyResult batch;
+    QThreadPool pool;
+    pool.setMaxThreadCount(1);
+    QtConcurrent::run(&pool, [&] {
+        batch = ManifestService::verifyManifestBatch(mountPoints, *manifest, {}, &progress);
+    });
+    ProgressRate rate;
+    waitWithProgress(pool, [&](double seconds) {
+        const uint64_t done = progress.bytesDone.load();
+        QJsonObject line = progressLine(QStringLiteral("verify-watch"), done, progress.bytesTotal.load(),
+                                        rate.update(done, seconds));
+        line.insert(QStringLiteral("files_done"), static_cast<double>(progress.filesDone.load()));
+        line.insert(QStringLiteral("files_total"), static_cast<double>(progress.filesTotal.load()));
+        printJsonLine(line);
+    });
+
+    if (jsonOutput()) {
+        QJsonObject root;
+        root.insert(QStringLiteral("type"), QStringLiteral("summary"));
+        QJsonArray mounts;
+        for (const ManifestService::MountResult& m : batch.mounts) {
+            QJsonObject o;
+            o.insert(QStringLiteral("mount_point"), m.mountPoint);
+            o.insert(QStringLiteral("status"), !m.result.success ? QStringLiteral("error")
+                                               : m.result.matches ? QStringLiteral("pass")
+                                                                  : QStringLiteral("mismatch"));
+            if (!m.result.errorMessage.isEmpty()) {
+                o.insert(QStringLiteral("error"), m.result.errorMessage);
+            }
+            o.insert(QStringLiteral("changed"), QJsonArray::fromStringList(m.result.changedPaths));
+            o.insert(QStringLiteral("missing"), QJsonArray::fromStringList(m.result.missingPaths));
+            o.insert(QStringLiteral("added"), QJsonArray::fromStringList(m.result.addedPaths));
+            o.insert(QStringLiteral("files_checked"), static_cast<double>(m.result.filesChecked));
+            mounts.append(o);
+        }
+        root.insert(QStringLiteral("mounts"), mounts);
+        root.insert(QStringLiteral("matched"), batch.matched);
+        root.insert(QStringLiteral("mismatched"), batch.mismatched);
+        root.insert(QStringLiteral("failed"), batch.failed);
+        root.insert(QStringLiteral("shared_differences"), QJsonArray::fromStringList(batch.sharedDifferences));
+        root.insert(QStringLiteral("duration_ms"), static_cast<double>(batch.durationMs));
+        std::cout << QJsonDocument(root).toJson(QJsonDocument::Compact).toStdString() << '\n';
+    } else {
+        if (!quietOutput()) {
+            for (const ManifestService::MountResult& m : batch.mounts) {
+                if (!m.result.success) {
+                    std::cout << "ERROR     " << m.mountPoint.toStdString() << ": "
+                              << m.result.errorMessage.toStdString() << '\n';
+                    continue;
+                }
+                std::cout << (m.result.matches ? "PASS      " : "MISMATCH  ") << m.mountPoint.toStdString() << '\n';
+                for (const QString& p : m.result.changedPaths) {
+                    std::cout << "  changed " << p.toStdString() << '\n';
+                }
+                for (const QString& p : m.result.missingPaths) {
+                    std::cout << "  missing " << p.toStdString() << '\n';
+                }
+                for (const QString& p : m.result.addedPaths) {
+                    std::cout << "  added   " << p.toStdString() << '\n';
+                }
+            }
+            if (!batch.sharedDifferences.isEmpty()) {
+                std::cout << "Differences on every mismatched mount (baseline may be stale):\n";
+                for (const QString& p : batch.sharedDifferences) {
+                    std::cout << "  " << p.toStdString() << '\n';
+                }
+            }
+        }
+        std::cout << batch.matched << " of " << batch.mounts.size() << " mount(s) match, "
+                  << batch.mismatched << " mismatched, " << batch.failed << " failed ("
+                  << batch.durationMs << " ms)\n";
+    }
+
+    if (batch.failed > 0) {
+        return ExitError;
+    }
+    return batch.mismatched > 0 ? ExitVerifyFailed : ExitOk;
+}
+
+namespace {
+
+/** One device of runHashDevices; the counters are shared with the hashing thread. */
+struct DeviceHashJob {
+    QString deviceNode;
+    std::atomic<bool> cancelled{false};
+    std::atomic<uint64_t> bytesProcessed{0};
+    std::atomic<uint64_t> totalBytes{0};
+    std::atomic<bool> running{false};
+    ProgressRate rate;
+    HashResult result;
+};
+
+uint64_t unreadableBytes(const HashResult& result)
+{
+    uint64_t bytes = 0;
+    for (const UnreadableRange& range : result.unreadableRanges) {
+        bytes += range.length;
+    }
+    return bytes;
+}
+
+std::optional<HashScanMode> cliScanMode(const QString& name)
+{
+    if (name == QLatin1String("full")) return HashScanMode::Full;
+    if (name == QLatin1String("quick")) return HashScanMode::QuickSample;
+    if (name == QLatin1String("chunked")) return HashScanMode::ParallelFull;
+    return std::nullopt;
+}
+
+HashResult hashOneDevice(DeviceHashJob& job, RawDeviceHash::Algorithm algorithm, HashScanMode mode,
+                         bool resume, bool tolerateBadSectors, int readTimeoutMs)
+{
+    RawDeviceHash::Options options;
+    options.deviceNode = job.deviceNode;
+    options.algorithm = algorithm;
+    options.cancelled = &job.cancelled;
+    options.bytesProcessed = &job.bytesProcessed;
+    options.totalBytes = &job.totalBytes;
+    options.scanMode = mode == HashScanMode::QuickSample ? RawDeviceHash::ScanMode::QuickSample
+                     : mode == HashScanMode::ParallelFull ? RawDeviceHash::ScanMode::ParallelChunked
+                                                          : RawDeviceHash::ScanMode::Full;
+    if (tolerateBadSectors) {
+        // One sequential pass with no checkpoint: a resumed read would lose the skipped ranges.
+        options.tolerateReadErrors = true;
+        if (readTimeoutMs > 0) {
+            options.readTimeoutMs = readTimeoutMs;
+        }
+    } else if (algorithm == RawDeviceHash::Algorithm::BLAKE3 && options.scanMode == RawDeviceHash::ScanMode::Full) {
+        // Same block tree as HashWorker builds, so the digest matches the GUI's.
+        options.scanMode = RawDeviceHash::ScanMode::ParallelChunked;
+    }
+
+    // Full and chunked reads share the GUI's "full" checkpoint, so either can resume the other.
+    HashCheckpoint checkpoint;
+    const bool checkpointed = hashScanModeReadsAll(mode) && !tolerateBadSectors;
+    if (checkpointed) {
+        const RawDeviceHash::StorageIdentity identity = RawDeviceHash::storageIdentity(job.deviceNode);
+        checkpoint.storageId = identity.storageId;
+        checkpoint.layoutFingerprint = identity.layoutFingerprint;
+        if (resume) {
+            if (auto existing = HashCheckpointStore::instance().checkpointFor(
+                    job.deviceNode, RawDeviceHash::algorithmName(algorithm), QStringLiteral("full"),
+                    identity.storageId, identity.layoutFingerprint)) {
+                checkpoint = *existing;
+                checkpoint.storageId = identity.storageId;
+                checkpoint.layoutFingerprint = identity.layoutFingerprint;
+            }
+        }
+        options.checkpointOut = &checkpoint;
+        if (checkpoint.isValid()) {
+            options.resumeFromBytes = checkpoint.bytesCompleted;
+        }
+        options.checkpointed = [](const HashCheckpoint& cp) {
+            HashCheckpointStore::instance().record(cp);
+        };
+    }
+
+    const int fd = RawDeviceHash::openDevice(job.deviceNode);
+    if (fd >= 0) {
+        job.totalBytes.store(RawDeviceHash::deviceSize(fd, job.deviceNode));
+        RawDeviceHash::closeDevice(fd);
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    HashResult result = RawDeviceHash::hashDevice(options);
+    result.durationMs = static_cast<uint64_t>(timer.elapsed());
+    result.resumedFromCheckpoint = options.resumeFromBytes > 0 && !result.checkpointRejected;
+
+    if (checkpointed && checkpoint.isValid()) {
+        if (result.success) {
+            HashCheckpointStore::instance().remove(checkpoint);
+        } else {
+            HashCheckpointStore::instance().upsert(checkpoint);
+        }
+    }
+    return result;
+}
+
+QJsonObject hashResultJson(const HashResult& result, const QString& scanMode)
+{
+    QJsonObject obj;
+    obj.insert(QStringLiteral("type"), QStringLiteral("result"));
+    obj.insert(QStringLiteral("device"), result.deviceNode);
+    obj.insert(QStringLiteral("success"), result.success);
+    obj.insert(QStringLiteral("algorithm"), result.algorithm);
+    obj.insert(QStringLiteral("scan_mode"), scanMode);
+    if (result.success) {
+        obj.insert(QStringLiteral("hash"), result.hash);
+    } else {
+        obj.insert(QStringLiteral("error"), result.errorMessage);
+    }
+    obj.insert(QStringLiteral("bytes"), static_cast<double>(result.bytesProcessed));
+    obj.insert(QStringLiteral("duration_ms"), static_cast<double>(result.durationMs));
+    obj.insert(QStringLiteral("mbps"), result.speedMBps());
+    obj.insert(QStringLiteral("resumed"), result.resumedFromCheckpoint);
+    if (result.checkpointRejected) {
+        obj.insert(QStringLiteral("checkpoint_rejected"), true);
+    }
+    if (result.blockSize > 0) {
+        obj.insert(QStringLiteral("block_size"), static_cast<double>(result.blockSize));
+        obj.insert(QStringLiteral("blocks"), result.blockHashes.size());
+    }
+    if (!result.unreadableRanges.isEmpty()) {
+        QJsonArray ranges;
+        for (const UnreadableRange& range : result.unreadableRanges) {
+            QJsonObject r;
+            r.insert(QStringLiteral("offset"), static_cast<double>(range.offset));
+            r.insert(QStringLiteral("length"), static_cast<double>(range.length));
+            r.insert(QStringLiteral("timed_out"), range.timedOut);
+            ranges.append(r);
+        }
+        obj.insert(QStringLiteral("unreadable"), ranges);
+        obj.insert(QStringLiteral("unreadable_bytes"), static_cast<double>(unreadableBytes(result)));
+    }
+    return obj;
+}
+
+/** Scheduler tick of runVerifyClones, HashWorker's throughput sample interval. */
+constexpr unsigned long kCloneTickMs = 100;
+
+/** One clone of runVerifyClones; the counters are shared with the hashing thread. */
+struct CloneJob {
+    QString deviceNode;
+    CloneVerify::UsbPlacement placement;
+    std::atomic<bool> cancelled{false};
+    std::atomic<uint64_t> bytesProcessed{0};
+    std::atomic<bool> finished{false};
+    bool started = false;
+    uint64_t sampledBytes = 0;
+    bool sampled = false;
+    QElapsedTimer queued;
+    ProgressRate rate;
+    HashResult result;
+    CloneVerify::CloneVerdict verdict;
+};
+
+QJsonObject cloneResultJson(const CloneJob& job)
+{
+    const HashResult& r = job.result;
+    QJsonObject obj;
+    obj.insert(QStringLiteral("type"), QStringLiteral("result"));
+    obj.insert(QStringLiteral("device"), job.deviceNode);
+    obj.insert(QStringLiteral("verdict"), CloneVerify::verdictName(job.verdict.verdict));
+    if (job.verdict.verdict == CloneVerify::Verdict::Error) {
+        obj.insert(QStringLiteral("error"), r.errorMessage);
+    } else if (job.verdict.verdict == CloneVerify::Verdict::Mismatch) {
+        obj.insert(QStringLiteral("first_bad_block"), static_cast<double>(job.verdict.firstBadBlock));
+        obj.insert(QStringLiteral("first_bad_offset"),
+                   static_cast<double>(job.verdict.firstBadBlock)
+                       * static_cast<double>(RawDeviceHash::kDefaultChunkBytes));
+    }
+    if (!job.placement.controller.isEmpty()) {
+        obj.insert(QStringLiteral("controller"), job.placement.controller);
+    }
+    obj.insert(QStringLiteral("bytes"), static_cast<double>(r.bytesProcessed));
+    obj.insert(QStringLiteral("duration_ms"), static_cast<double>(r.durationMs));
+    obj.insert(QStringLiteral("mbps"), r.speedMBps());
+    return obj;
+}
+
+/** File name for @p mountPoint's manifest in a directory of several; unique within @p used. */
+QString manifestFileName(const QString& mountPoint, QSet<QString>& used)
+{
+    QString base = QFileInfo(QDir::cleanPath(mountPoint)).fileName();
+    if (base.isEmpty()) {
+        base = QStringLiteral("root");
+    }
+    QString name = base;
+    for (int n = 2; used.contains(name); ++n) {
+        name = QStringLiteral("%1-%2").arg(base).arg(n);
+    }
+    used.insert(name);
+    return name + QStringLiteral(".json");
+}
+
+bool writeManifestJson(const QString& path, const WatchManifest& manifest, QString* error)
+{
+    const QByteArray json = QJsonDocument(manifest.toJson()).toJson();
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit()) {
+        *error = file.errorString();
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int VerifyCli::runHashDevices(const QStringList& deviceNodes, const QString& scanMode,
+                              const QString& algorithm, bool resume, int jobs,
+                              bool tolerateBadSectors, int readTimeoutMs)
+{
+    const std::optional<HashScanMode> mode = cliScanMode(scanMode);
+    const RawDeviceHash::Algorithm algo = RawDeviceHash::algorithmFromName(algorithm);
+    QString usage;
+    if (deviceNodes.isEmpty()) {
+        usage = QStringLiteral("hash-device needs at least one device node.");
+    } else if (!mode) {
+        usage = QStringLiteral("Unknown scan mode %1 (full, quick or chunked).").arg(scanMode);
+    } else if (RawDeviceHash::algorithmName(algo).compare(algorithm, Qt::CaseInsensitive) != 0) {
+        usage = QStringLiteral("Unknown hash algorithm %1.").arg(algorithm);
+    } else if (!RawDeviceHash::algorithmAvailable(algo)) {
+        usage = QStringLiteral("%1 is not available in this build.").arg(RawDeviceHash::algorithmName(algo));
+    } else if (tolerateBadSectors && *mode != HashScanMode::Full) {
+        usage = QStringLiteral("--tolerate-bad-sectors reads with --scan-mode full only.");
+    } else if (tolerateBadSectors && resume) {
+        usage = QStringLiteral("--tolerate-bad-sectors reads keep no checkpoint to --resume from.");
+    } else if (readTimeoutMs < 0 || (readTimeoutMs > 0 && readTimeoutMs < RawDeviceHash::kMinReadTimeoutMs)) {
+        usage = QStringLiteral("--read-timeout needs at least %1 ms.").arg(RawDeviceHash::kMinReadTimeoutMs);
+    }
+    if (!usage.isEmpty()) {
+        if (jsonOutput()) {
+            QJsonObject obj;
+            obj.insert(QStringLiteral("type"), QStringLiteral("error"));
+            obj.insert(QStringLiteral("error"), usage);
+            printJsonLine(obj);
+        } else {
+            std::cerr << usage.toStdString() << '\n';
+        }
+        return ExitError;
+    }
+
+    HashCheckpointStore::instance().load();
+
+    std::vector<std::unique_ptr<DeviceHashJob>> deviceJobs;
+    for (const QString& node : deviceNodes) {
+        auto job = std::make_unique<DeviceHashJob>();
+        job->deviceNode = node;
+        deviceJobs.push_back(std::move(job));
+    }
+
+    QElapsedTimer wall;
+    wall.start();
+    QThreadPool pool;
+    pool.setMaxThreadCount(jobs > 0 ? jobs : static_cast<int>(deviceJobs.size()));
+    for (const std::unique_ptr<DeviceHashJob>& job : deviceJobs) {
+        DeviceHashJob* j = job.get();
+        QtConcurrent::run(&pool, [j, algo, mode, resume, scanMode, tolerateBadSectors, readTimeoutMs] {
+            j->running.store(true);
+            j->result = hashOneDevice(*j, algo, *mode, resume, tolerateBadSectors, readTimeoutMs);
+            j->running.store(false);
+            if (jsonOutput()) {
+                printJsonLine(hashResultJson(j->result, scanMode));
+            }
+        });
+    }
+    waitWithProgress(pool, [&](double seconds) {
+        for (const std::unique_ptr<DeviceHashJob>& job : deviceJobs) {
+            if (job->running.load()) {
+                const uint64_t done = job->bytesProcessed.load();
+                printJsonLine(progressLine(job->deviceNode, done, job->totalBytes.load(),
+                                           job->rate.update(done, seconds)));
+            }
+        }
+    });
+    const qint64 wallMs = wall.elapsed();
+
+    int failed = 0;
+    uint64_t bytes = 0;
+    for (const std::unique_ptr<DeviceHashJob>& job : deviceJobs) {
+        const HashResult& r = job->result;
+        bytes += r.bytesProcessed;
+        if (!r.success) {
+            ++failed;
+        }
+        if (!jsonOutput() && !quietOutput()) {
+            if (r.success) {
+                std::cout << "OK        " << r.deviceNode.toStdString() << "  " << r.algorithm.toStdString()
+                          << ' ' << r.hash.toStdString() << "  (" << static_cast<int>(r.speedMBps())
+                          << " MB/s" << (r.resumedFromCheckpoint ? ", resumed" : "")
+                          << (r.checkpointRejected ? ", checkpoint no longer matched" : "") << ")\n";
+                if (!r.unreadableRanges.isEmpty()) {
+                    std::cout << "          " << unreadableBytes(r) << " unreadable byte(s) in "
+                              << r.unreadableRanges.size() << " range(s), hashed as zeros\n";
+                }
+            } else {
+                std::cout << "ERROR     " << r.deviceNode.toStdString() << ": "
+                          << r.errorMessage.toStdString() << '\n';
+            }
+        }
+    }
+
+    const double mbps = mebibytesPerSecond(bytes, static_cast<double>(wallMs) / 1000.0);
+    if (jsonOutput()) {
+        QJsonObject summary;
+        summary.insert(QStringLiteral("type"), QStringLiteral("summary"));
+        summary.insert(QStringLiteral("total"), static_cast<int>(deviceJobs.size()));
+        summary.insert(QStringLiteral("failed"), failed);
+        summary.insert(QStringLiteral("bytes"), static_cast<double>(bytes));
+        summary.insert(QStringLiteral("duration_ms"), static_cast<double>(wallMs));
+        summary.insert(QStringLiteral("mbps"), mbps);
+        printJsonLine(summary);
+    } else {
+        std::cout << deviceJobs.size() - failed << " of " << deviceJobs.size() << " device(s) hashed, "
+                  << static_cast<int>(mbps) << " MB/s combined (" << wallMs << " ms)\n";
+    }
+    return failed > 0 ? ExitError : ExitOk;
+}
+
+int VerifyCli::runVerifyClones(const QString& masterPath, const QStringList& cloneNodes,
+                               const QString& algorithm, int jobs)
+{
+    const RawDeviceHash::Algorithm algo = RawDeviceHash::algorithmFromName(algorithm);
+    QString usage;
+    if (masterPath.isEmpty() || cloneNodes.isEmpty()) {
+        usage = QStringLiteral("verify-clones needs a master and at least one --clone device node.");
+    } else if (cloneNodes.contains(masterPath)) {
+        usage = QStringLiteral("The master %1 is also listed as a clone.").arg(masterPath);
+    } else if (RawDeviceHash::algorithmName(algo).compare(algorithm, Qt::CaseInsensitive) != 0) {
+        usage = QStringLiteral("Unknown hash algorithm %1.").arg(algorithm);
+    } else if (!RawDeviceHash::algorithmAvailable(algo)) {
+        usage = QStringLiteral("%1 is not available in this build.").arg(RawDeviceHash::algorithmName(algo));
+    }
+    if (!usage.isEmpty()) {
+        if (jsonOutput()) {
+            QJsonObject obj;
+            obj.insert(QStringLiteral("type"), QStringLiteral("error"));
+            obj.insert(QStringLiteral("error"), usage);
+            printJsonLine(obj);
+        } else {
+            std::cerr << usage.toStdString() << '\n';
+        }
+        return ExitError;
+    }
+
+    QElapsedTimer wall;
+    wall.start();
+
+    // The master is read once; every clone is compared with its block digests.
+    uint64_t masterTotal = 0;
+    if (QFileInfo(masterPath).isFile()) {
+        masterTotal = static_cast<uint64_t>(QFileInfo(masterPath).size());
+    } else if (const int fd = RawDeviceHash::openDevice(masterPath); fd >= 0) {
+        masterTotal = RawDeviceHash::deviceSize(fd, masterPath);
+        RawDeviceHash::closeDevice(fd);
+    }
+    std::atomic<uint64_t> masterBytes{0};
+    uint64_t masterLength = 0;
+    HashResult master;
+    QThreadPool pool;
+    QtConcurrent::run(&pool, [&] {
+        master = CloneVerify::hashMaster(masterPath, algo, nullptr, &masterBytes, &masterLength);
+    });
+    ProgressRate masterRate;
+    waitWithProgress(pool, [&](double seconds) {
+        const uint64_t done = masterBytes.load();
+        printJsonLine(progressLine(masterPath, done, masterTotal, masterRate.update(done, seconds)));
+    });
+    master.durationMs = static_cast<uint64_t>(wall.elapsed());
+    if (!master.success) {
+        const QString error = QStringLiteral("Cannot read the master %1: %2").arg(masterPath, master.errorMessage);
+        if (jsonOutput()) {
+            QJsonObject obj;
+            obj.insert(QStringLiteral("type"), QStringLiteral("error"));
+            obj.insert(QStringLiteral("error"), error);
+            printJsonLine(obj);
+        } else {
+            std::cerr << error.toStdString() << '\n';
+        }
+        return ExitError;
+    }
+    if (jsonOutput()) {
+        QJsonObject obj;
+        obj.insert(QStringLiteral("type"), QStringLiteral("master"));
+        obj.insert(QStringLiteral("path"), masterPath);
+        obj.insert(QStringLiteral("algorithm"), master.algorithm);
+        obj.insert(QStringLiteral("hash"), master.hash);
+        obj.insert(QStringLiteral("bytes"), static_cast<double>(masterLength));
+        obj.insert(QStringLiteral("blocks"), master.blockHashes.size());
+        obj.insert(QStringLiteral("block_size"), static_cast<double>(RawDeviceHash::kDefaultChunkBytes));
+        obj.insert(QStringLiteral("duration_ms"), static_cast<double>(master.durationMs));
+        obj.insert(QStringLiteral("mbps"), master.speedMBps());
+        printJsonLine(obj);
+    } else if (!quietOutput()) {
+        std::cout << "MASTER    " << masterPath.toStdString() << "  " << master.algorithm.toStdString() << ' '
+                  << master.hash.toStdString() << "  (" << static_cast<int>(master.speedMBps()) << " MB/s)\n";
+    }
+
+    std::vector<std::unique_ptr<CloneJob>> cloneJobs;
+    for (const QString& node : cloneNodes) {
+        auto job = std::make_unique<CloneJob>();
+        job->deviceNode = node;
+        job->placement = CloneVerify::usbPlacement(node);
+        job->queued.start();
+        cloneJobs.push_back(std::move(job));
+    }
+
+    // Clones start as HashWorker starts hashes: per USB controller, each controller's
+    // concurrency learned from the throughput it delivers, --jobs as the overall ceiling.
+    HashScheduler scheduler;
+    scheduler.setGlobalLimit(jobs > 0 ? jobs : static_cast<int>(cloneJobs.size()));
+    pool.setMaxThreadCount(static_cast<int>(cloneJobs.size()));
+    QElapsedTimer clonesStarted;
+    QElapsedTimer sinceTick;
+    QElapsedTimer sinceProgress;
+    clonesStarted.start();
+    sinceTick.start();
+    sinceProgress.start();
+    QHash<QString, int> lastTickJobs;
+    for (;;) {
+        for (;;) {
+            QList<HashScheduler::Pending> pending;
+            QList<CloneJob*> pendingJobs;
+            QList<HashScheduler::Running> running;
+            for (const std::unique_ptr<CloneJob>& job : cloneJobs) {
+                if (!job->started) {
+                    pending.append({job->placement.controller, job->placement.rootPort, masterLength,
+                                    job->queued.elapsed()});
+                    pendingJobs.append(job.get());
+                } else if (!job->finished.load()) {
+                    running.append({job->placement.controller, job->placement.rootPort});
+                }
+            }
+            const int next = scheduler.pickNext(pending, running);
+            if (next < 0) {
+                break;
+            }
+            CloneJob* j = pendingJobs.at(next);
+            j->started = true;
+            QtConcurrent::run(&pool, [j, &master, masterLength, algo] {
+                QElapsedTimer timer;
+                timer.start();
+                j->result = CloneVerify::hashClone(j->deviceNode, master, masterLength, algo, &j->cancelled,
+                                                   &j->bytesProcessed);
+                j->result.durationMs = static_cast<uint64_t>(timer.elapsed());
+                j->verdict = CloneVerify::judgeClone(master, j->result);
+                // Printed as each clone ends, so a bad stick is reported while the rest still read.
+                if (jsonOutput()) {
+                    printJsonLine(cloneResultJson(*j));
+                }
+                j->finished.store(true);
+            });
+        }
+        if (std::all_of(cloneJobs.cbegin(), cloneJobs.cend(),
+                        [](const std::unique_ptr<CloneJob>& job) { return job->finished.load(); })) {
+            break;
+        }
+        QThread::msleep(kCloneTickMs);
+
+        // A controller's sample counts only if the same clones read from it for the whole tick.
+        const qint64 tickMs = sinceTick.restart();
+        struct Tick {
+            int jobs = 0;
+            uint64_t bytes = 0;
+            bool complete = true;
+        };
+        QHash<QString, Tick> ticks;
+        for (const std::unique_ptr<CloneJob>& job : cloneJobs) {
+            if (!job->started || job->finished.load() || job->placement.controller.isEmpty()) {
+                continue;
+            }
+            const uint64_t processed = job->bytesProcessed.load();
+            Tick& tick = ticks[job->placement.controller];
+            ++tick.jobs;
+            if (!job->sampled || processed < job->sampledBytes) {
+                tick.complete = false;
+            } else {
+                tick.bytes += processed - job->sampledBytes;
+            }
+            job->sampled = true;
+            job->sampledBytes = processed;
+        }
+        QHash<QString, int> jobsNow;
+        for (auto it = ticks.cbegin(); it != ticks.cend(); ++it) {
+            jobsNow.insert(it.key(), it->jobs);
+            if (tickMs > 0 && it->complete && lastTickJobs.value(it.key()) == it->jobs) {
+                scheduler.recordThroughput(it.key(), it->jobs,
+                                           mebibytesPerSecond(it->bytes, static_cast<double>(tickMs) / 1000.0));
+            }
+        }
+        lastTickJobs = jobsNow;
+
+        if (jsonOutput() && s_progressIntervalMs > 0 && sinceProgress.elapsed() >= s_progressIntervalMs) {
+            const double seconds = static_cast<double>(sinceProgress.restart()) / 1000.0;
+            for (const std::unique_ptr<CloneJob>& job : cloneJobs) {
+                if (job->started && !job->finished.load()) {
+                    const uint64_t done = job->bytesProcessed.load();
+                    printJsonLine(progressLine(job->deviceNode, done, masterLength, job->rate.update(done, seconds)));
+                }
+            }
+        }
+    }
+    pool.waitForDone();
+    const qint64 clonesMs = clonesStarted.elapsed();
+    const qint64 wallMs = wall.elapsed();
+
+    int matched = 0;
+    int mismatched = 0;
+    int failed = 0;
+    uint64_t bytes = 0;
+    const CloneJob* slowest = nullptr;
+    for (const std::unique_ptr<CloneJob>& job : cloneJobs) {
+        const HashResult& r = job->result;
+        bytes += r.bytesProcessed;
+        if (!slowest || r.durationMs > slowest->result.durationMs) {
+            slowest = job.get();
+        }
+        switch (job->verdict.verdict) {
+            case CloneVerify::Verdict::Match: ++matched; break;
+            case CloneVerify::Verdict::Mismatch: ++mismatched; break;
+            case CloneVerify::Verdict::Error: ++failed; break;
+        }
+        if (jsonOutput() || quietOutput()) {
+            continue;
+        }
+        if (job->verdict.verdict == CloneVerify::Verdict::Match) {
+            std::cout << "MATCH     " << job->deviceNode.toStdString() << "  (" << static_cast<int>(r.speedMBps())
+                      << " MB/s)\n";
+        } else if (job->verdict.verdict == CloneVerify::Verdict::Mismatch) {
+            const uint64_t offset = static_cast<uint64_t>(job->verdict.firstBadBlock) * RawDeviceHash::kDefaultChunkBytes;
+            std::cout << "MISMATCH  " << job->deviceNode.toStdString() << ": first differing block "
+                      << job->verdict.firstBadBlock << " (at " << offset / (1024 * 1024) << " MiB)\n";
+        } else {
+            std::cout << "ERROR     " << job->deviceNode.toStdString() << ": " << r.errorMessage.toStdString() << '\n';
+        }
+    }
+
+    // All clones read at once, so the batch takes about as long as its slowest stick.
+    const double mbps = mebibytesPerSecond(bytes, static_cast<double>(clonesMs) / 1000.0);
+    if (jsonOutput()) {
+        QJsonObject summary;
+        summary.insert(QStringLiteral("type"), QStringLiteral("summary"));
+        summary.insert(QStringLiteral("total"), static_cast<int>(cloneJobs.size()));
+        summary.insert(QStringLiteral("matched"), matched);
+        summary.insert(QStringLiteral("mismatched"), mismatched);
+        summary.insert(QStringLiteral("failed"), failed);
+        summary.insert(QStringLiteral("master_ms"), static_cast<double>(master.durationMs));
+        summary.insert(QStringLiteral("clones_ms"), static_cast<double>(clonesMs));
+        summary.insert(QStringLiteral("slowest_device"), slowest->deviceNode);
+        summary.insert(QStringLiteral("slowest_ms"), static_cast<double>(slowest->result.durationMs));
+        summary.insert(QStringLiteral("duration_ms"), static_cast<double>(wallMs));
+        summary.insert(QStringLiteral("mbps"), mbps);
+        printJsonLine(summary);
+    } else {
+        std::cout << matched << " of " << cloneJobs.size() << " clone(s) match the master, "
+                  << static_cast<int>(mbps) << " MB/s combined; slowest " << slowest->deviceNode.toStdString()
+                  << " (" << slowest->result.durationMs << " ms, " << wallMs << " ms in all)\n";
+    }
+    if (failed > 0) {
+        return ExitError;
+    }
+    return mismatched > 0 ? ExitVerifyFailed : ExitOk;
+}
+
+int VerifyCli::runFlashImage(const QString& imagePath, const QString& deviceNode, const QString& algorithm,
+                             bool allowUnverified, bool allowFixedDisk)
+{
+    const RawDeviceHash::Algorithm algo = RawDeviceHash::algorithmFromName(algorithm);
+    QString usage;
+    if (imagePath.isEmpty() || deviceNode.isEmpty()) {
+        usage = QStringLiteral("flash needs an image and a --to device node.");
+    } else if (RawDeviceHash::algorithmName(algo).compare(algorithm, Qt::CaseInsensitive) != 0) {
+        usage = QStringLiteral("Unknown hash algorithm %1.").arg(algorithm);
+    } else if (!RawDeviceHash::algorithmAvailable(algo)) {
+        usage = QStringLiteral("%1 is not available in this build.").arg(RawDeviceHash::algorithmName(algo));
+    }
+    if (!usage.isEmpty()) {
+        if (jsonOutput()) {
+            QJsonObject obj;
+            obj.insert(QStringLiteral("type"), QStringLiteral("error"));
+            obj.insert(QStringLiteral("error"), usage);
+            printJsonLine(obj);
+        } else {
+            std::cerr << usage.toStdString() << '\n';
+        }
+        return ExitError;
+    }
+
+    applyUserSettings();
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> verified{0};
+    ImageFlasher::Options options;
+    options.imagePath = imagePath;
+    options.deviceNode = deviceNode;
+    options.algorithm = algo;
+    options.allowUnverifiedImage = allowUnverified;
+    options.allowFixedDisk = allowFixedDisk;
+    options.bytesWritten = &written;
+    options.bytesVerified = &verified;
+
+    // Progress covers both directions: the write, then the read back.
+    const uint64_t total = 2 * static_cast<uint64_t>(qMax<qint64>(0, QFileInfo(imagePath).size()));
+    ImageFlasher::Result r;
+    QThreadPool pool;
+    QtConcurrent::run(&pool, [&] { r = ImageFlasher::flash(options); });
+    ProgressRate rate;
+    waitWithProgress(pool, [&](double seconds) {
+        const uint64_t done = written.load() + verified.load();
+        printJsonLine(progressLine(deviceNode, done, total, rate.update(done, seconds)));
+    });
+
+    // Written and read back without error: anything else wrong is a verification failure.
+    const bool checked = !r.blockHashes.isEmpty() && r.readBack.success;
+    if (jsonOutput()) {
+        QJsonObject obj;
+        obj.insert(QStringLiteral("type"), QStringLiteral("result"));
+        obj.insert(QStringLiteral("image"), imagePath);
+        obj.insert(QStringLiteral("device"), deviceNode);
+        obj.insert(QStringLiteral("success"), r.success);
+        obj.insert(QStringLiteral("image_verified"), r.imageVerified());
+        if (!r.image.computedSha256.isEmpty()) {
+            obj.insert(QStringLiteral("sha256"), r.image.computedSha256);
+        }
+        if (!r.blockHash.isEmpty()) {
+            obj.insert(QStringLiteral("algorithm"), RawDeviceHash::algorithmName(algo));
+            obj.insert(QStringLiteral("block_hash"), r.blockHash);
+        }
+        if (r.firstBadBlock >= 0) {
+            obj.insert(QStringLiteral("first_bad_block"), static_cast<double>(r.firstBadBlock));
+        }
+        if (!r.errorMessage.isEmpty()) {
+            obj.insert(QStringLiteral("error"), r.errorMessage);
+        }
+        obj.insert(QStringLiteral("bytes"), static_cast<double>(r.imageBytes));
+        obj.insert(QStringLiteral("write_ms"), static_cast<double>(r.writeMs));
+        obj.insert(QStringLiteral("verify_ms"), static_cast<double>(r.verifyMs));
+        printJsonLine(obj);
+    } else if (r.success) {
+        std::cout << "OK        " << imagePath.toStdString() << " -> " << deviceNode.toStdString() << "  written in "
+                  << r.writeMs << " ms, read back in " << r.verifyMs << " ms"
+                  << (r.imageVerified() ? "" : " (image not verified)") << '\n';
+    } else {
+        std::cout << (checked ? "FAILED    " : "ERROR     ") << imagePath.toStdString() << " -> "
+                  << deviceNode.toStdString() << ": " << r.errorMessage.toStdString() << '\n';
+    }
+    if (r.success) {
+        return ExitOk;
+    }
+    return checked ? ExitVerifyFailed : ExitError;
+}
+
+int VerifyCli::runBuildManifest(const QString& specPath, const QStringList& mountPoints,
+                                const QString& outputPath)
+{
+    const std::optional<WatchManifest> spec = loadWatchManifest(specPath);
+    QString usage;
+    if (!spec || spec->groups.isEmpty()) {
+        usage = QStringLiteral("Cannot read watch groups from %1").arg(specPath);
+    } else if (mountPoints.isEmpty()) {
+        usage = QStringLiteral("build-manifest needs at least one --watch-mount path.");
+    } else if (outputPath.isEmpty()) {
+        usage = QStringLiteral("build-manifest needs --manifest-out.");
+    } else if (mountPoints.size() > 1 && !QDir().mkpath(outputPath)) {
+        usage = QStringLiteral("Cannot create the output directory %1").arg(outputPath);
+    }
+    if (!usage.isEmpty()) {
+        if (jsonOutput()) {
+            QJsonObject obj;
+            obj.insert(QStringLiteral("type"), QStringLiteral("error"));
+            obj.insert(QStringLiteral("error"), usage);
+            printJsonLine(obj);
+        } else {
+            std::cerr << usage.toStdString() << '\n';
+        }
+        return ExitError;
+    }
+
+    struct MountBuild {
+        QString mountPoint;
+        QString outputFile;
+        ManifestService::Progress progress;
+        ProgressRate rate;
+        WatchManifest manifest;
+        QString error;
+        qint64 durationMs = 0;
+    };
+    std::vector<std::unique_ptr<MountBuild>> builds;
+    QSet<QString> usedNames;
+    for (const QString& mount : mountPoints) {
+        auto build = std::make_unique<MountBuild>();
+        build->mountPoint = mount;
+        build->outputFile = mountPoints.size() == 1
+            ? outputPath
+            : QDir(outputPath).filePath(manifestFileName(mount, usedNames));
+        builds.push_back(std::move(build));
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(static_cast<int>(builds.size()));
+    for (const std::unique_ptr<MountBuild>& build : builds) {
+        MountBuild* b = build.get();
+        QtConcurrent::run(&pool, [b, &spec] {
+            QElapsedTimer timer;
+            timer.start();
+            b->manifest = ManifestService::rebuildManifestRoots(b->mountPoint, *spec, &b->progress);
+            if (b->manifest.groups.size() != spec->groups.size()) {
+                b->error = QStringLiteral("%1 of %2 watch group(s) could not be built")
+                               .arg(spec->groups.size() - b->manifest.groups.size())
+                               .arg(spec->groups.size());
+            } else {
+                writeManifestJson(b->outputFile, b->manifest, &b->error);
+            }
+            b->durationMs = timer.elapsed();
+        });
+    }
+    waitWithProgress(pool, [&](double seconds) {
+        for (const std::unique_ptr<MountBuild>& build : builds) {
+            const uint64_t done = build->progress.bytesDone.load();
+            QJsonObject line = progressLine(build->mountPoint, done, build->progress.bytesTotal.load(),
+                                            build->rate.update(done, seconds));
+            line.insert(QStringLiteral("files_done"), static_cast<double>(build->progress.filesDone.load()));
+            line.insert(QStringLiteral("files_total"), static_cast<double>(build->progress.filesTotal.load()));
+            printJsonLine(line);
+        }
+    });
+
+    int failed = 0;
+    for (const std::unique_ptr<MountBuild>& build : builds) {
+        const bool ok = build->error.isEmpty();
+        if (!ok) {
+            ++failed;
+        }
+        if (jsonOutput()) {
+            QJsonObject obj;
+            obj.insert(QStringLiteral("type"), QStringLiteral("result"));
+            obj.insert(QStringLiteral("mount_point"), build->mountPoint);
+            obj.insert(QStringLiteral("success"), ok);
+            if (ok) {
+                obj.insert(QStringLiteral("manifest"), build->outputFile);
+                obj.insert(QStringLiteral("manifest_root"), build->manifest.manifestRoot);
+            } else {
+                obj.insert(QStringLiteral("error"), build->error);
+            }
+            obj.insert(QStringLiteral("files"), static_cast<double>(build->progress.filesDone.load()));
+            obj.insert(QStringLiteral("bytes"), static_cast<double>(build->progress.bytesDone.load()));
+            obj.insert(QStringLiteral("duration_ms"), static_cast<double>(build->durationMs));
+            obj.insert(QStringLiteral("mbps"), mebibytesPerSecond(build->progress.bytesDone.load(),
+                                                                  build->durationMs / 1000.0));
+            printJsonLine(obj);
+        } else if (ok) {
+            std::cout << "BUILT     " << build->mountPoint.toStdString() << " -> "
+                      << build->outputFile.toStdString() << "  root " << build->manifest.manifestRoot.toStdString()
+                      << '\n';
+        } else {
+            std::cout << "ERROR     " << build->mountPoint.toStdString() << ": " << build->error.toStdString() << '\n';
+        }
+    }
+    return failed > 0 ? ExitError : ExitOk;
+}
+
+QStringList VerifyCli::readPathList(const QString& listPath, bool* ok)
+{
+    QFile file(listPath);
+    const bool opened = listPath == QStringLiteral("-") ? file.open(stdin, QIODevice::ReadOnly)
+                                                        : file.open(QIODevice::ReadOnly);
+    if (ok) {
+        *ok = opened;
+    }
+    QStringList paths;
+    if (!opened) {
+        return paths;
+    }
+    QTextStream in(&file);
+    QString line;
+    while (in.readLineInto(&line)) {
+        const QString path = line.trimmed();
+        if (!path.isEmpty() && !path.startsWith(QLatin1Char('#'))) {
+            paths.append(path);
+        }
+    }
+    return paths;
+}
+
+int VerifyCli::runVerifyBatch(const QStringList& inputs, int jobs)
+{
+    applyUserSettings();
+    IsoCatalogManifest::ensureLoaded();
+
+    QStringList images;
+    int missing = 0;
+    for (const QString& input : inputs) {
+        const QFileInfo info(input);
+        if (info.isDir()) {
+            images += IsoVerifier::findIsoFiles(info.absoluteFilePath());
+        } else if (info.isFile()) {
+            images.append(info.absoluteFilePath());
+        } else {
+            ++missing;
+            QJsonObject obj;
+            obj.insert(QStringLiteral("type"), QStringLiteral("error"));
+            obj.insert(QStringLiteral("path"), input);
+            obj.insert(QStringLiteral("error"), QStringLiteral("No such file or directory"));
+            printJsonLine(obj);
+        }
+    }
+    images.removeDuplicates();
+
+    IsoVerifyOptions options = IsoVerifier::verifyOptions();
+    options.parallelLimit = qMax(0, jobs);
+    options.resultReady = [](const IsoVerifyResult& result) {
+        QJsonObject obj = IsoVerifyReport::resultToJson(result);
+        obj.insert(QStringLiteral("type"), QStringLiteral("result"));
+        printJsonLine(obj);
+    };
+    QList<IsoVerifyResult> results;
+    {
+        const IsoVerifier::OptionsScope scope(options);
+        results = IsoVerifier::verifyFiles(images);
+    }
+
+    const IsoVerifyReport::SummaryCounts counts = IsoVerifyReport::countSummary(results);
+    QJsonObject summary;
+    summary.insert(QStringLiteral("type"), QStringLiteral("summary"));
+    summary.insert(QStringLiteral("passed"), counts.passed);
+    summary.insert(QStringLiteral("total"), counts.total);
+    summary.insert(QStringLiteral("needs_sidecar"), counts.needsSidecar);
+    summary.insert(QStringLiteral("missing"), missing);
+    summary.insert(QStringLiteral("summary_line"), IsoVerifyReport::summaryLine(results));
+    printJsonLine(summary);
+
+    if (missing > 0) {
+        return ExitError;
+    }
+    return resultsToExitCode(results);
+}
+
 int VerifyCli::runTrustHash(const QString& fileName, const QString& sha256Hex)
 {
     IsoCatalogManifest::ensureLoaded();
@@ -213,4 +1254,40 @@ int VerifyCli::runTrustHash(const QString& fileName, const QString& sha256Hex)
     return ok ? ExitOk : ExitError;
 }
 
+int VerifyCli::runServeMirror(quint16 port)
+{
+    applyUserSettings();
+    IsoHttpClient::setMirror({});  // the mirror fetches from the origins, never from itself
+    IsoCatalogManifest::ensureLoaded();
+    IsoCatalogManifest::refreshRemoteIfStale();
+
+    // Only what a client verifies itself: signed checksums and signatures, the signed catalog.
+    IsoMirrorServer server([](const QString& url, const QString& imageFileName) {
+        if (IsoCatalogManifest::isCatalogUrl(url)) {
+            return true;
+        }
+        if (imageFileName.isEmpty()) {
+            return false;
+        }
+        const auto match = IsoCatalog::matchIso(imageFileName);
+        return match && !match->signatureUrl.isEmpty()
+               && (url == match->checksumUrl || url == match->signatureUrl);
+    });
+    QString err;
+    if (!server.listen(QHostAddress::Any, port, &err)) {
+        std::cerr << "Cannot listen on port " << port << ": " << err.toStdString() << '\n';
+        return ExitError;
+    }
+    if (jsonOutput()) {
+        QJsonObject obj;
+        obj.insert(QStringLiteral("type"), QStringLiteral("mirror"));
+        obj.insert(QStringLiteral("port"), int(server.serverPort()));
+        obj.insert(QStringLiteral("catalog_entries"), IsoCatalogManifest::entryCount());
+        std::cout << QJsonDocument(obj).toJson(QJsonDocument::Compact).toStdString() << std::endl;
+    } else if (!quietOutput()) {
+        std::cout << "Serving the ISO catalog and publisher artifacts on port " << server.serverPort() << std::endl;
+    }
+    return QCoreApplication::exec() == 0 ? ExitOk : ExitError;
+}
+
 } // namespace FlashSpartan
@@ -2,22 +2,34 @@
 
 #include "AppPaths.h"
 
+#include <QtEndian>
 #include <QtGlobal>
 #include <QDir>
-#include <QFile>
+#include <QFileInfo>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
-#include <QStandardPaths>
 
 namespace FlashSpartan {
 
 namespace {
 
+constexpr quint32 kMagic = 0x48565346;  // "FSVH"
+constexpr quint16 kVersion = 1;
+/** Two header copies at the start of the file; the valid one with the higher seq wins. */
+constexpr qint64 kHeaderSlotBytes = 64;
+constexpr qint64 kDataOffset = 2 * kHeaderSlotBytes;
+constexpr qint64 kHeaderFieldBytes = 48;
+/** Each record: u32 payload length, u16 CRC-16 of the payload, u16 reserved. */
+constexpr quint32 kRecordHeaderBytes = 8;
+/** Written where a record did not fit before the end of the data area. */
+constexpr quint32 kWrapMarker = 0xFFFFFFFF;
+constexpr quint64 kMinCapacityBytes = 4096;
+
 QString historyFilePath()
 {
     const QString dir = AppPaths::configDir();
-    return dir + QStringLiteral("/verify-history.json");
+    return dir + QStringLiteral("/verify-history.ring");
 }
 
 QString kindToString(VerifyHistoryKind kind)
@@ -56,6 +68,9 @@ QJsonObject entryToJson(const VerifyHistoryEntry& e)
     o[QStringLiteral("summary")] = e.summary;
     o[QStringLiteral("detail")] = e.detail;
     o[QStringLiteral("duration_ms")] = static_cast<double>(e.durationMs);
+    if (!e.performance.isEmpty()) {
+        o[QStringLiteral("perf")] = e.performance.toJson();
+    }
     return o;
 }
 
@@ -74,9 +89,57 @@ VerifyHistoryEntry entryFromJson(const QJsonObject& o)
     e.summary = o[QStringLiteral("summary")].toString();
     e.detail = o[QStringLiteral("detail")].toString();
     e.durationMs = static_cast<uint64_t>(o[QStringLiteral("duration_ms")].toDouble());
+    e.performance = HashPerformance::fromJson(o[QStringLiteral("perf")].toObject());
     return e;
 }
 
+QByteArray encodeRecord(const VerifyHistoryEntry& e)
+{
+    const QByteArray payload = QJsonDocument(entryToJson(e)).toJson(QJsonDocument::Compact);
+    QByteArray out(kRecordHeaderBytes, '\0');
+    qToLittleEndian<quint32>(static_cast<quint32>(payload.size()), out.data());
+    qToLittleEndian<quint16>(qChecksum(payload), out.data() + 4);
+    return out + payload;
+}
+
+/**
+ * Reads the record at data offset @p pos, following a wrap to offset 0; on success @p pos
+ * is where the record starts and @p bytes its size.
+ */
+bool readRecord(QFile& file, quint64 capacity, quint64* pos, VerifyHistoryEntry* entry, quint32* bytes)
+{
+    for (;;) {
+        if (capacity - *pos >= kRecordHeaderBytes && file.seek(kDataOffset + static_cast<qint64>(*pos))) {
+            const QByteArray head = file.read(kRecordHeaderBytes);
+            if (head.size() != kRecordHeaderBytes) {
+                return false;
+            }
+            const quint32 length = qFromLittleEndian<quint32>(head.constData());
+            if (length != kWrapMarker) {
+                if (*pos + kRecordHeaderBytes + length > capacity) {
+                    return false;
+                }
+                const QByteArray payload = file.read(length);
+                if (payload.size() != static_cast<qsizetype>(length)
+                    || qChecksum(payload) != qFromLittleEndian<quint16>(head.constData() + 4)) {
+                    return false;
+                }
+                const QJsonDocument doc = QJsonDocument::fromJson(payload);
+                if (!doc.isObject()) {
+                    return false;
+                }
+                *entry = entryFromJson(doc.object());
+                *bytes = kRecordHeaderBytes + length;
+                return true;
+            }
+        }
+        if (*pos == 0) {
+            return false;
+        }
+        *pos = 0;
+    }
+}
+
 } // namespace
 
 VerifyHistory& VerifyHistory::instance()
@@ -85,42 +148,187 @@ VerifyHistory& VerifyHistory::instance()
     return inst;
 }
 
-void VerifyHistory::load()
+void VerifyHistory::load(const QString& path, quint64 capacityBytes)
 {
+    m_file.close();
     m_entries.clear();
-    QFile f(historyFilePath());
-    if (!f.open(QIODevice::ReadOnly)) {
+    m_recordBytes.clear();
+    m_byDevice.clear();
+    m_firstSeq = 0;
+    m_header = {};
+    m_rollup.clear();
+    m_rollupPath.clear();
+
+    const QString ringPath = path.isEmpty() ? historyFilePath() : path;
+    const bool fresh = !QFile::exists(ringPath);
+    if (!openRing(ringPath, qMax(capacityBytes, kMinCapacityBytes))) {
         return;
     }
-    const QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
-    if (!doc.isObject()) {
-        return;
+    const QString legacy = QFileInfo(ringPath).absolutePath() + QStringLiteral("/verify-history.json");
+    if (fresh && QFile::exists(legacy)) {
+        migrateLegacy(legacy);
     }
-    const QJsonArray arr = doc.object()[QStringLiteral("entries")].toArray();
-    for (const QJsonValue& v : arr) {
-        if (v.isObject()) {
-            m_entries.append(entryFromJson(v.toObject()));
+
+    // A rollup saved after the ring's last header write matches it; anything else (no file,
+    // a crash between the two writes) is rebuilt from the entries the ring still holds.
+    const QFileInfo ring(ringPath);
+    const QString rollupPath = ring.absolutePath() + QLatin1Char('/') + ring.completeBaseName()
+                               + QStringLiteral(".rollup");
+    std::optional<VerifyRollup> stored = VerifyRollup::load(rollupPath);
+    if (stored && stored->ringSeq() == m_header.seq) {
+        m_rollup = std::move(*stored);
+    } else {
+        m_rollup.clear();
+        for (const VerifyHistoryEntry& e : std::as_const(m_entries)) {
+            m_rollup.add(e);
         }
+        m_rollup.setRingSeq(m_header.seq);
+        m_rollup.save(rollupPath);
     }
+    m_rollupPath = rollupPath;
 }
 
-void VerifyHistory::save()
+bool VerifyHistory::readHeader(QFile& file, Header* header)
+{
+    bool found = false;
+    for (qint64 slot = 0; slot < 2; ++slot) {
+        if (!file.seek(slot * kHeaderSlotBytes)) {
+            break;
+        }
+        const QByteArray raw = file.read(kHeaderSlotBytes);
+        if (raw.size() != kHeaderSlotBytes || qFromLittleEndian<quint32>(raw.constData()) != kMagic
+            || qFromLittleEndian<quint16>(raw.constData() + 4) != kVersion
+            || qChecksum(QByteArrayView(raw).first(kHeaderFieldBytes))
+                   != qFromLittleEndian<quint16>(raw.constData() + kHeaderFieldBytes)) {
+            continue;
+        }
+        Header h;
+        h.seq = qFromLittleEndian<quint64>(raw.constData() + 8);
+        h.capacity = qFromLittleEndian<quint64>(raw.constData() + 16);
+        h.tail = qFromLittleEndian<quint64>(raw.constData() + 24);
+        h.head = qFromLittleEndian<quint64>(raw.constData() + 32);
+        h.count = qFromLittleEndian<quint64>(raw.constData() + 40);
+        if (h.capacity < kMinCapacityBytes || h.tail >= h.capacity || h.head >= h.capacity) {
+            continue;
+        }
+        if (!found || h.seq > header->seq) {
+            *header = h;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool VerifyHistory::openRing(const QString& path, quint64 capacityBytes)
+{
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        return false;
+    }
+    m_file.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+
+    if (!readHeader(m_file, &m_header)) {
+        // New file, or one whose headers are both unreadable: start an empty ring.
+        m_file.resize(0);
+        m_header = {};
+        m_header.capacity = capacityBytes;
+        return writeHeader();
+    }
+
+    quint64 pos = m_header.tail;
+    quint64 read = 0;
+    for (; read < m_header.count; ++read) {
+        VerifyHistoryEntry entry;
+        quint32 bytes = 0;
+        if (!readRecord(m_file, m_header.capacity, &pos, &entry, &bytes)) {
+            break;
+        }
+        if (read == 0) {
+            m_header.tail = pos;
+        }
+        index(std::move(entry), bytes);
+        pos += bytes;
+    }
+    if (read == 0) {
+        m_header.tail = pos;
+    }
+    if (read != m_header.count || m_header.head != pos) {
+        m_header.count = read;
+        m_header.head = pos;
+        writeHeader();
+    }
+    return true;
+}
+
+bool VerifyHistory::writeHeader()
 {
-    QJsonArray arr;
-    for (const VerifyHistoryEntry& e : m_entries) {
-        arr.append(entryToJson(e));
+    ++m_header.seq;
+    QByteArray raw(kHeaderSlotBytes, '\0');
+    char* p = raw.data();
+    qToLittleEndian<quint32>(kMagic, p);
+    qToLittleEndian<quint16>(kVersion, p + 4);
+    qToLittleEndian<quint64>(m_header.seq, p + 8);
+    qToLittleEndian<quint64>(m_header.capacity, p + 16);
+    qToLittleEndian<quint64>(m_header.tail, p + 24);
+    qToLittleEndian<quint64>(m_header.head, p + 32);
+    qToLittleEndian<quint64>(m_header.count, p + 40);
+    qToLittleEndian<quint16>(qChecksum(QByteArrayView(raw).first(kHeaderFieldBytes)), p + kHeaderFieldBytes);
+    const qint64 slot = static_cast<qint64>(m_header.seq % 2);
+    return m_file.seek(slot * kHeaderSlotBytes) && m_file.write(raw) == raw.size() && m_file.flush();
+}
+
+void VerifyHistory::index(VerifyHistoryEntry entry, quint32 recordBytes)
+{
+    const qint64 seq = m_firstSeq + m_entries.size();
+    if (!entry.deviceNode.isEmpty()) {
+        m_byDevice[entry.deviceNode].append(seq);
     }
-    QJsonObject root;
-    root[QStringLiteral("version")] = 1;
-    root[QStringLiteral("entries")] = arr;
+    m_entries.append(std::move(entry));
+    m_recordBytes.append(recordBytes);
+}
 
-    const QString path = historyFilePath();
-    QFile f(path);
-    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+void VerifyHistory::evictOldest()
+{
+    const QString node = m_entries.constFirst().deviceNode;
+    const auto it = m_byDevice.find(node);
+    if (it != m_byDevice.end()) {
+        it.value().removeFirst();
+        if (it.value().isEmpty()) {
+            m_byDevice.erase(it);
+        }
+    }
+    m_entries.removeFirst();
+    m_header.tail += m_recordBytes.takeFirst();
+    --m_header.count;
+    ++m_firstSeq;
+    // The writer moves to offset 0 whenever a record does not fit, so the next oldest may be there.
+    if (!m_recordBytes.isEmpty() && m_header.tail + m_recordBytes.constFirst() > m_header.capacity) {
+        m_header.tail = 0;
+    }
+}
+
+void VerifyHistory::migrateLegacy(const QString& legacyPath)
+{
+    QFile f(legacyPath);
+    if (!f.open(QIODevice::ReadOnly)) {
         return;
     }
-    f.write(QJsonDocument(root).toJson(QJsonDocument::Indented));
-    f.setPermissions(QFile::ReadOwner | QFile::WriteOwner);
+    const QJsonArray arr =
+        QJsonDocument::fromJson(f.readAll()).object()[QStringLiteral("entries")].toArray();
+    f.close();
+    for (auto it = arr.crbegin(); it != arr.crend(); ++it) {  // stored newest first
+        if (it->isObject()) {
+            append(entryFromJson(it->toObject()));
+        }
+    }
+    QFile::rename(legacyPath, legacyPath + QStringLiteral(".migrated"));
+}
+
+void VerifyHistory::save()
+{
+    if (m_file.isOpen()) {
+        m_file.flush();
+    }
 }
 
 void VerifyHistory::append(const VerifyHistoryEntry& entry)
@@ -129,19 +337,72 @@ void VerifyHistory::append(const VerifyHistoryEntry& entry)
     if (!e.timestamp.isValid()) {
         e.timestamp = QDateTime::currentDateTimeUtc();
     }
-    m_entries.prepend(e);
-    while (m_entries.size() > kMaxEntries) {
-        m_entries.removeLast();
+    if (!m_file.isOpen()) {
+        return;
+    }
+    Header& h = m_header;
+    QByteArray record = encodeRecord(e);
+    if (static_cast<quint64>(record.size()) > h.capacity / 4) {
+        e.detail.clear();  // a pathological report must not flush the whole ring
+        e.summary.truncate(256);
+        record = encodeRecord(e);
+        if (static_cast<quint64>(record.size()) > h.capacity / 4) {
+            return;
+        }
+    }
+    const quint32 bytes = static_cast<quint32>(record.size());
+
+    const quint64 oldHead = h.head;
+    quint64 head = h.head;
+    bool wrapped = false;
+    bool evicted = false;
+    if (head + bytes > h.capacity) {
+        while (h.count > 0 && h.tail >= head) {  // records between head and the end
+            evictOldest();
+            evicted = true;
+        }
+        head = 0;
+        wrapped = true;
+    }
+    while (h.count > 0 && h.tail >= head && h.tail < head + bytes) {
+        evictOldest();
+        evicted = true;
+    }
+    if (h.count == 0) {
+        h.tail = head;
+    }
+    // Record the evictions before their bytes are overwritten.
+    if (evicted && !writeHeader()) {
+        return;
+    }
+    if (wrapped && h.capacity - oldHead >= sizeof(quint32)) {
+        char marker[sizeof(quint32)];
+        qToLittleEndian<quint32>(kWrapMarker, marker);
+        m_file.seek(kDataOffset + static_cast<qint64>(oldHead));
+        m_file.write(marker, sizeof(marker));
+    }
+    if (!m_file.seek(kDataOffset + static_cast<qint64>(head)) || m_file.write(record) != record.size()) {
+        return;
+    }
+    h.head = head + bytes;
+    ++h.count;
+    if (writeHeader()) {
+        m_rollup.add(e);
+        m_rollup.setRingSeq(h.seq);
+        if (!m_rollupPath.isEmpty()) {
+            m_rollup.save(m_rollupPath);
+        }
+        index(std::move(e), bytes);
     }
-    save();
 }
 
 QList<VerifyHistoryEntry> VerifyHistory::recentEntries(int limit) const
 {
     QList<VerifyHistoryEntry> out;
-    const int n = qMin(limit, m_entries.size());
-    for (int i = 0; i < n; ++i) {
-        out.append(m_entries.at(i));
+    const qsizetype n = qMin<qsizetype>(limit, m_entries.size());
+    out.reserve(n);
+    for (qsizetype i = 0; i < n; ++i) {
+        out.append(m_entries.at(m_entries.size() - 1 - i));
     }
     return out;
 }
@@ -150,17 +411,41 @@ QList<VerifyHistoryEntry> VerifyHistory::entriesForDevice(const QString& deviceN
                                                           int limit) const
 {
     QList<VerifyHistoryEntry> out;
-    for (const VerifyHistoryEntry& e : m_entries) {
-        if (e.deviceNode == deviceNode) {
-            out.append(e);
-            if (out.size() >= limit) {
-                break;
-            }
-        }
+    const QList<qint64> seqs = m_byDevice.value(deviceNode);
+    for (auto it = seqs.crbegin(); it != seqs.crend() && out.size() < limit; ++it) {
+        out.append(m_entries.at(*it - m_firstSeq));
     }
     return out;
 }
 
+QJsonObject VerifyHistory::toJson(const VerifyHistoryEntry& entry)
+{
+    return entryToJson(entry);
+}
+
+bool VerifyHistory::scan(const QString& path,
+                         const std::function<bool(const VerifyHistoryEntry& entry, double done)>& visit)
+{
+    QFile file(path.isEmpty() ? historyFilePath() : path);
+    Header header;
+    if (!file.open(QIODevice::ReadOnly) || !readHeader(file, &header)) {
+        return false;
+    }
+    quint64 pos = header.tail;
+    for (quint64 read = 0; read < header.count; ++read) {
+        VerifyHistoryEntry entry;
+        quint32 bytes = 0;
+        if (!readRecord(file, header.capacity, &pos, &entry, &bytes)) {
+            break;
+        }
+        if (!visit(entry, double(read + 1) / double(header.count))) {
+            return false;
+        }
+        pos += bytes;
+    }
+    return true;
+}
+
 QString VerifyHistory::formatEntryLine(const VerifyHistoryEntry& entry) const
 {
     QString kindLabel;
@@ -0,0 +1,167 @@
+#include "VerifyRollup.h"
+#include "VerifyHistory.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr int kFormatVersion = 1;
+
+QJsonArray countsToJson(const VerifyRollup::Counts& c)
+{
+    return {static_cast<qint64>(c.total), static_cast<qint64>(c.passed), static_cast<qint64>(c.failed)};
+}
+
+VerifyRollup::Counts countsFromJson(const QJsonArray& a)
+{
+    VerifyRollup::Counts c;
+    c.total = static_cast<quint32>(a.at(0).toInteger());
+    c.passed = static_cast<quint32>(a.at(1).toInteger());
+    c.failed = static_cast<quint32>(a.at(2).toInteger());
+    return c;
+}
+
+} // namespace
+
+void VerifyRollup::Counts::add(const Counts& other)
+{
+    total += other.total;
+    passed += other.passed;
+    failed += other.failed;
+}
+
+int VerifyRollup::Counts::passPercent() const
+{
+    return total > 0 ? static_cast<int>(100ULL * passed / total) : 0;
+}
+
+void VerifyRollup::add(const VerifyHistoryEntry& entry)
+{
+    Counts one;
+    one.total = 1;
+    if (entry.status.compare(QLatin1String("pass"), Qt::CaseInsensitive) == 0) {
+        one.passed = 1;
+    } else if (!entry.status.isEmpty()) {
+        one.failed = 1;
+    }
+    m_totals.add(one);
+
+    const QDate date = entry.timestamp.toLocalTime().date();
+    if (date.isValid()) {
+        m_days[date].add(one);
+        const QDate cutoff = m_days.lastKey().addDays(-kRetainDays);
+        while (!m_days.isEmpty() && m_days.firstKey() < cutoff) {
+            m_days.erase(m_days.begin());
+        }
+    }
+
+    if (!entry.deviceNode.isEmpty()) {
+        DeviceSummary& d = m_devices[entry.deviceNode];
+        d.counts.add(one);
+        if (!entry.deviceLabel.isEmpty()) {
+            d.label = entry.deviceLabel;
+        }
+        if (!d.lastAt.isValid() || entry.timestamp >= d.lastAt) {
+            d.lastAt = entry.timestamp;
+            d.lastStatus = entry.status;
+        }
+    }
+}
+
+void VerifyRollup::clear()
+{
+    *this = VerifyRollup();
+}
+
+VerifyRollup::Counts VerifyRollup::day(const QDate& day) const
+{
+    return m_days.value(day);
+}
+
+VerifyRollup::Counts VerifyRollup::since(const QDate& first) const
+{
+    Counts out;
+    for (auto it = m_days.lowerBound(first); it != m_days.cend(); ++it) {
+        out.add(it.value());
+    }
+    return out;
+}
+
+QJsonObject VerifyRollup::toJson() const
+{
+    QJsonObject days;
+    for (auto it = m_days.cbegin(); it != m_days.cend(); ++it) {
+        days.insert(it.key().toString(Qt::ISODate), countsToJson(it.value()));
+    }
+    QJsonObject devices;
+    for (auto it = m_devices.cbegin(); it != m_devices.cend(); ++it) {
+        QJsonObject d;
+        d[QStringLiteral("counts")] = countsToJson(it->counts);
+        d[QStringLiteral("label")] = it->label;
+        d[QStringLiteral("last_status")] = it->lastStatus;
+        d[QStringLiteral("last_at")] = it->lastAt.toString(Qt::ISODate);
+        devices.insert(it.key(), d);
+    }
+    QJsonObject o;
+    o[QStringLiteral("version")] = kFormatVersion;
+    o[QStringLiteral("ring_seq")] = QString::number(m_ringSeq);
+    o[QStringLiteral("totals")] = countsToJson(m_totals);
+    o[QStringLiteral("days")] = days;
+    o[QStringLiteral("devices")] = devices;
+    return o;
+}
+
+VerifyRollup VerifyRollup::fromJson(const QJsonObject& obj)
+{
+    VerifyRollup r;
+    r.m_ringSeq = obj[QStringLiteral("ring_seq")].toString().toULongLong();
+    r.m_totals = countsFromJson(obj[QStringLiteral("totals")].toArray());
+    const QJsonObject days = obj[QStringLiteral("days")].toObject();
+    for (auto it = days.constBegin(); it != days.constEnd(); ++it) {
+        const QDate date = QDate::fromString(it.key(), Qt::ISODate);
+        if (date.isValid()) {
+            r.m_days.insert(date, countsFromJson(it.value().toArray()));
+        }
+    }
+    const QJsonObject devices = obj[QStringLiteral("devices")].toObject();
+    for (auto it = devices.constBegin(); it != devices.constEnd(); ++it) {
+        const QJsonObject d = it.value().toObject();
+        DeviceSummary s;
+        s.counts = countsFromJson(d[QStringLiteral("counts")].toArray());
+        s.label = d[QStringLiteral("label")].toString();
+        s.lastStatus = d[QStringLiteral("last_status")].toString();
+        s.lastAt = QDateTime::fromString(d[QStringLiteral("last_at")].toString(), Qt::ISODate);
+        r.m_devices.insert(it.key(), s);
+    }
+    return r;
+}
+
+bool VerifyRollup::save(const QString& path) const
+{
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    f.write(QJsonDocument(toJson()).toJson(QJsonDocument::Compact));
+    return f.commit();
+}
+
+std::optional<VerifyRollup> VerifyRollup::load(const QString& path)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return std::nullopt;
+    }
+    const QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
+    if (!doc.isObject() || doc.object()[QStringLiteral("version")].toInt() != kFormatVersion) {
+        return std::nullopt;
+    }
+    return fromJson(doc.object());
+}
+
+} // namespace FlashSpartan
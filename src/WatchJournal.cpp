@@ -0,0 +1,288 @@
+#include "WatchJournal.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSocketNotifier>
+
+#include <utility>
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+namespace FlashSpartan {
+
+namespace {
+
+QString mountKey(const QString& mountPoint)
+{
+    QString m = QDir::cleanPath(QDir::fromNativeSeparators(mountPoint));
+    while (m.endsWith(QLatin1Char('/')) && m.size() > 1) {
+        m.chop(1);
+    }
+    return m;
+}
+
+QString joinRelative(const QString& dir, const QString& name)
+{
+    return dir.isEmpty() ? name : dir + QLatin1Char('/') + name;
+}
+
+#ifdef Q_OS_LINUX
+constexpr uint32_t kWatchMask = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE
+                                | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF
+                                | IN_ONLYDIR;
+#endif
+
+} // namespace
+
+WatchJournal::WatchJournal(QObject* parent)
+    : QObject(parent)
+{
+}
+
+WatchJournal::~WatchJournal()
+{
+#ifdef Q_OS_LINUX
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+#endif
+}
+
+bool WatchJournal::isSupported()
+{
+#ifdef Q_OS_LINUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+void WatchJournal::watch(const QString& mountPoint, const QStringList& watchPaths)
+{
+    unwatch(mountPoint);
+#ifdef Q_OS_LINUX
+    if (m_fd < 0) {
+        m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_fd < 0) {
+            return;
+        }
+        m_notifier = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+        connect(m_notifier, &QSocketNotifier::activated, this, &WatchJournal::onReadable);
+    }
+
+    const QString key = mountKey(mountPoint);
+    Mount& mount = m_mounts[key];
+    mount.root = QFileInfo(key).canonicalFilePath();
+    if (mount.root.isEmpty()) {
+        mount.incomplete = true;
+        return;
+    }
+
+    const QDir root(mount.root);
+    for (const QString& path : watchPaths) {
+        const QString trimmed = path.trimmed();
+        if (trimmed.isEmpty()) {
+            continue;
+        }
+        const QFileInfo info(QDir::isAbsolutePath(trimmed) ? trimmed : root.absoluteFilePath(trimmed));
+        const QString canonical = info.canonicalFilePath();
+        const QString relative = canonical == mount.root ? QString() : root.relativeFilePath(canonical);
+        if (canonical.isEmpty() || relative.startsWith(QLatin1String(".."))) {
+            // Missing (or escaping) watch paths: a creation would go unnoticed.
+            mount.incomplete = true;
+            continue;
+        }
+        if (info.isDir()) {
+            addTree(key, mount, relative);
+        } else {
+            // Watch the directory so replace-by-rename saves are seen too.
+            const int slash = relative.lastIndexOf(QLatin1Char('/'));
+            addWatch(key, mount, slash < 0 ? QString() : relative.left(slash), false);
+        }
+    }
+#else
+    Q_UNUSED(watchPaths)
+    m_mounts[mountKey(mountPoint)].incomplete = true;
+#endif
+}
+
+void WatchJournal::unwatch(const QString& mountPoint)
+{
+    const QString key = mountKey(mountPoint);
+    auto it = m_mounts.find(key);
+    if (it == m_mounts.end()) {
+        return;
+    }
+#ifdef Q_OS_LINUX
+    for (auto wd = it->dirs.constBegin(); wd != it->dirs.constEnd(); ++wd) {
+        inotify_rm_watch(m_fd, wd.key());
+        m_watchOwners.remove(wd.key());
+    }
+#endif
+    m_mounts.erase(it);
+}
+
+bool WatchJournal::isWatching(const QString& mountPoint) const
+{
+    return m_mounts.contains(mountKey(mountPoint));
+}
+
+WatchJournal::Snapshot WatchJournal::begin(const QString& mountPoint)
+{
+    Snapshot snapshot;
+    auto it = m_mounts.find(mountKey(mountPoint));
+    if (it == m_mounts.end()) {
+        return snapshot;
+    }
+    // Pick up events already queued so they land in this snapshot, not the next one.
+    onReadable();
+    snapshot.usable = it->anchored && !it->overflowed && !it->incomplete;
+    snapshot.touchedPaths = std::exchange(it->touched, {});
+    it->overflowed = false;
+    return snapshot;
+}
+
+void WatchJournal::finish(const QString& mountPoint, bool clean)
+{
+    auto it = m_mounts.find(mountKey(mountPoint));
+    if (it != m_mounts.end()) {
+        it->anchored = clean;
+    }
+}
+
+void WatchJournal::onReadable()
+{
+#ifdef Q_OS_LINUX
+    if (m_fd < 0) {
+        return;
+    }
+    alignas(inotify_event) char buffer[16 * 1024];
+    for (;;) {
+        const ssize_t len = ::read(m_fd, buffer, sizeof(buffer));
+        if (len <= 0) {
+            if (len < 0 && errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        for (ssize_t offset = 0; offset < len;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                for (Mount& mount : m_mounts) {
+                    mount.overflowed = true;
+                }
+                continue;
+            }
+            const QString key = m_watchOwners.value(event->wd);
+            auto it = m_mounts.find(key);
+            if (key.isEmpty() || it == m_mounts.end()) {
+                continue;
+            }
+            Mount& mount = *it;
+            const QString dir = mount.dirs.value(event->wd);
+
+            if (event->mask & IN_IGNORED) {
+                mount.dirs.remove(event->wd);
+                mount.shallow.remove(event->wd);
+                m_watchOwners.remove(event->wd);
+                continue;
+            }
+            if (event->mask & IN_MOVE_SELF) {
+                // The watch follows the inode, so later paths under it would be wrong.
+                mount.incomplete = true;
+                continue;
+            }
+
+            if ((event->mask & IN_DELETE_SELF) && !coveredByParent(mount, dir)) {
+                // A watch root went away; nothing would see it come back.
+                mount.incomplete = true;
+            }
+
+            const QString name = event->len > 0 ? QFile::decodeName(event->name) : QString();
+            const QString path = name.isEmpty() ? dir : joinRelative(dir, name);
+            mount.touched.insert(path);
+
+            if ((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))
+                && !mount.shallow.contains(event->wd)) {
+                // Files written before the new watch lands are covered by the directory entry.
+                addTree(key, mount, path);
+            }
+        }
+    }
+#endif
+}
+
+bool WatchJournal::coveredByParent(const Mount& mount, const QString& relativeDir)
+{
+    if (relativeDir.isEmpty()) {
+        return false;
+    }
+    const int slash = relativeDir.lastIndexOf(QLatin1Char('/'));
+    const QString parent = slash < 0 ? QString() : relativeDir.left(slash);
+    for (auto it = mount.dirs.constBegin(); it != mount.dirs.constEnd(); ++it) {
+        if (it.value() == parent && !mount.shallow.contains(it.key())) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool WatchJournal::addWatch(const QString& key, Mount& mount, const QString& relativeDir, bool recursive)
+{
+#ifdef Q_OS_LINUX
+    if (mount.dirs.size() >= kMaxWatchesPerMount) {
+        mount.incomplete = true;
+        return false;
+    }
+    const QString absolute = relativeDir.isEmpty() ? mount.root
+                                                   : mount.root + QLatin1Char('/') + relativeDir;
+    const int wd = inotify_add_watch(m_fd, QFile::encodeName(absolute).constData(), kWatchMask);
+    if (wd < 0) {
+        // ENOSPC is the per-user watch limit; any failure leaves a blind spot.
+        mount.incomplete = true;
+        return false;
+    }
+    // Overlapping watch paths get the same descriptor back; recursive wins.
+    const bool known = mount.dirs.contains(wd);
+    mount.dirs.insert(wd, relativeDir);
+    if (recursive) {
+        mount.shallow.remove(wd);
+    } else if (!known) {
+        mount.shallow.insert(wd);
+    }
+    m_watchOwners.insert(wd, key);
+    return true;
+#else
+    Q_UNUSED(key)
+    Q_UNUSED(relativeDir)
+    Q_UNUSED(recursive)
+    mount.incomplete = true;
+    return false;
+#endif
+}
+
+void WatchJournal::addTree(const QString& key, Mount& mount, const QString& relativeDir)
+{
+    QStringList pending{relativeDir};
+    while (!pending.isEmpty()) {
+        const QString dir = pending.takeLast();
+        if (!addWatch(key, mount, dir, true)) {
+            return;
+        }
+        const QDir qdir(dir.isEmpty() ? mount.root : mount.root + QLatin1Char('/') + dir);
+        const QStringList children =
+            qdir.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden | QDir::NoSymLinks);
+        for (const QString& child : children) {
+            pending.append(joinRelative(dir, child));
+        }
+    }
+}
+
+} // namespace FlashSpartan
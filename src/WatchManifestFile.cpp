@@ -0,0 +1,640 @@
+#include "WatchManifestFile.h"
+
+#include "HexEncoding.h"
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QTimeZone>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace FlashSpartan {
+
+namespace {
+
+constexpr int kDigestBytes = 32;
+constexpr quint32 kNoPrefix = 0xFFFFFFFF;
+constexpr qint64 kNoTime = std::numeric_limits<qint64>::min();
+
+// Fixed record sizes; see the layout in WatchManifestFile.h.
+constexpr qsizetype kHeaderBytes = 80;
+constexpr qsizetype kGroupBytesV1 = 80;
+constexpr qsizetype kGroupBytes = 88;  // v2: + chunk threshold
+constexpr qsizetype kStringRefBytes = 8;
+constexpr qsizetype kEntryBytesV1 = 80;
+constexpr qsizetype kEntryBytes = 88;  // v2: + first chunk, chunk count
+constexpr qsizetype kChunkBytes = 48;
+
+constexpr quint16 kManifestHasRoot = 0x1;
+constexpr quint32 kGroupHasRoot = 0x1;
+constexpr quint32 kEntryHasMetadata = 0x1;
+constexpr quint32 kEntryHasChangeTime = 0x2;
+
+class Writer {
+public:
+    explicit Writer(QByteArray& out) : m_out(out) {}
+
+    void u16(quint16 v) { raw(qToLittleEndian(v)); }
+    void u32(quint32 v) { raw(qToLittleEndian(v)); }
+    void u64(quint64 v) { raw(qToLittleEndian(v)); }
+    void i64(qint64 v) { raw(qToLittleEndian(v)); }
+    void bytes(const QByteArray& b) { m_out.append(b); }
+
+private:
+    template <typename T>
+    void raw(T v) { m_out.append(reinterpret_cast<const char*>(&v), sizeof(T)); }
+
+    QByteArray& m_out;
+};
+
+class StringPool {
+public:
+    struct Ref {
+        quint32 offset = 0;
+        quint32 length = 0;
+    };
+
+    Ref add(const QByteArray& utf8)
+    {
+        const Ref ref{static_cast<quint32>(m_data.size()), static_cast<quint32>(utf8.size())};
+        m_data.append(utf8);
+        return ref;
+    }
+    Ref add(const QString& s) { return add(s.toUtf8()); }
+
+    const QByteArray& data() const { return m_data; }
+
+private:
+    QByteArray m_data;
+};
+
+void putRef(Writer& w, StringPool::Ref ref)
+{
+    w.u32(ref.offset);
+    w.u32(ref.length);
+}
+
+qint64 timeToMs(const QDateTime& t)
+{
+    return t.isValid() ? t.toMSecsSinceEpoch() : kNoTime;
+}
+
+QDateTime msToTime(qint64 ms)
+{
+    return ms == kNoTime ? QDateTime() : QDateTime::fromMSecsSinceEpoch(ms, QTimeZone::utc());
+}
+
+/** 32 raw bytes of a lowercase hex SHA-256, or empty when @p hex is anything else. */
+QByteArray rawDigest(const QString& hex)
+{
+    if (hex.size() != 2 * kDigestBytes) {
+        return {};
+    }
+    const QByteArray raw = QByteArray::fromHex(hex.toLatin1());
+    if (raw.size() != kDigestBytes || HexEncoding::toString(raw) != hex) {
+        return {};
+    }
+    return raw;
+}
+
+/**
+ * Bounds-checked view of an encoded manifest. Every accessor stays inside the buffer once
+ * valid() is true; offsets come from a file whose digest was checked, but a truncated or
+ * hand-made file must still not read out of bounds.
+ */
+class View {
+public:
+    View(const uchar* data, qsizetype size) : m_data(data), m_size(size)
+    {
+        if (size < kHeaderBytes || u32(0) != WatchManifestFile::kMagic) {
+            return;
+        }
+        m_version = u16(4);
+        if (m_version == 1) {
+            m_groupBytes = kGroupBytesV1;
+            m_entryBytes = kEntryBytesV1;
+        } else if (m_version != WatchManifestFile::kVersion) {
+            return;
+        }
+        m_groups = u32(8);
+        m_watchPaths = u32(12);
+        m_prefixes = u32(16);
+        m_entries = u32(20);
+        m_stringBytes = u32(24);
+        m_chunks = m_version >= 2 ? u32(28) : 0;
+
+        const quint64 groupsAt = kHeaderBytes;
+        const quint64 watchPathsAt = groupsAt + quint64(m_groups) * m_groupBytes;
+        const quint64 prefixesAt = watchPathsAt + quint64(m_watchPaths) * kStringRefBytes;
+        const quint64 entriesAt = prefixesAt + quint64(m_prefixes) * kStringRefBytes;
+        const quint64 chunksAt = entriesAt + quint64(m_entries) * m_entryBytes;
+        const quint64 stringsAt = chunksAt + quint64(m_chunks) * kChunkBytes;
+        if (stringsAt + m_stringBytes != quint64(size)) {
+            return;
+        }
+        m_watchPathsAt = static_cast<qsizetype>(watchPathsAt);
+        m_prefixesAt = static_cast<qsizetype>(prefixesAt);
+        m_entriesAt = static_cast<qsizetype>(entriesAt);
+        m_chunksAt = static_cast<qsizetype>(chunksAt);
+        m_stringsAt = static_cast<qsizetype>(stringsAt);
+
+        if (!stringOk(32)) {
+            return;
+        }
+        for (quint32 g = 0; g < m_groups; ++g) {
+            const qsizetype at = groupAt(g);
+            if (!stringOk(at) || !stringOk(at + 8)
+                || quint64(u32(at + 16)) + u32(at + 20) > m_watchPaths
+                || quint64(u32(at + 24)) + u32(at + 28) > m_entries) {
+                return;
+            }
+        }
+        for (quint32 i = 0; i < m_watchPaths; ++i) {
+            if (!stringOk(m_watchPathsAt + qsizetype(i) * kStringRefBytes)) {
+                return;
+            }
+        }
+        for (quint32 i = 0; i < m_prefixes; ++i) {
+            if (!stringOk(m_prefixesAt + qsizetype(i) * kStringRefBytes)) {
+                return;
+            }
+        }
+        for (quint32 i = 0; i < m_entries; ++i) {
+            const qsizetype at = entryAt(i);
+            const quint32 prefix = u32(at);
+            if ((prefix != kNoPrefix && prefix >= m_prefixes) || !stringOk(at + 4)) {
+                return;
+            }
+            if (m_version >= 2 && quint64(u32(at + 80)) + u32(at + 84) > m_chunks) {
+                return;
+            }
+        }
+        m_valid = true;
+    }
+
+    bool valid() const { return m_valid; }
+    quint32 groupCount() const { return m_groups; }
+    quint32 groupEntryCount(quint32 g) const { return u32(groupAt(g) + 28); }
+
+    WatchManifest manifest() const
+    {
+        WatchManifest m;
+        m.version = QString::fromUtf8(string(32));
+        m.updatedAt = msToTime(i64(40));
+        if (u16(6) & kManifestHasRoot) {
+            m.manifestRoot = HexEncoding::toString(m_data + 48, kDigestBytes);
+        }
+        m.groups.reserve(m_groups);
+        for (quint32 g = 0; g < m_groups; ++g) {
+            m.groups.append(group(g));
+        }
+        return m;
+    }
+
+    WatchGroup group(quint32 g) const
+    {
+        const qsizetype at = groupAt(g);
+        WatchGroup group;
+        group.id = QString::fromUtf8(string(at));
+        group.name = QString::fromUtf8(string(at + 8));
+        const quint32 firstPath = u32(at + 16);
+        for (quint32 i = 0; i < u32(at + 20); ++i) {
+            group.watchPaths.append(
+                QString::fromUtf8(string(m_watchPathsAt + qsizetype(firstPath + i) * kStringRefBytes)));
+        }
+        group.builtAt = msToTime(i64(at + 32));
+        if (m_version >= 2) {
+            group.chunkThresholdBytes = u64(at + 80);
+        }
+        if (u32(at + 72) & kGroupHasRoot) {
+            group.merkleRoot = HexEncoding::toString(m_data + at + 40, kDigestBytes);
+        }
+        // Reserved (zero) in files written before Merkle v2.
+        if (const quint16 format = u16(at + 76); format != 0) {
+            group.merkleFormat = format;
+            group.merkleFanOut = u16(at + 78);
+        }
+        const quint32 first = u32(at + 24);
+        const quint32 count = u32(at + 28);
+        group.files.reserve(count);
+        for (quint32 i = first; i < first + count; ++i) {
+            group.files.append(entry(i));
+        }
+        return group;
+    }
+
+    std::optional<WatchFileEntry> find(quint32 g, const QByteArray& path) const
+    {
+        const qsizetype at = groupAt(g);
+        quint32 lo = u32(at + 24);
+        quint32 hi = lo + u32(at + 28);
+        while (lo < hi) {
+            const quint32 mid = lo + (hi - lo) / 2;
+            const int c = compareEntryPath(mid, path);
+            if (c == 0) {
+                return entry(mid);
+            }
+            if (c < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return std::nullopt;
+    }
+
+private:
+    quint16 u16(qsizetype at) const { return qFromLittleEndian<quint16>(m_data + at); }
+    quint32 u32(qsizetype at) const { return qFromLittleEndian<quint32>(m_data + at); }
+    quint64 u64(qsizetype at) const { return qFromLittleEndian<quint64>(m_data + at); }
+    qint64 i64(qsizetype at) const { return qFromLittleEndian<qint64>(m_data + at); }
+
+    qsizetype groupAt(quint32 g) const { return kHeaderBytes + qsizetype(g) * m_groupBytes; }
+    qsizetype entryAt(quint32 i) const { return m_entriesAt + qsizetype(i) * m_entryBytes; }
+    qsizetype chunkAt(quint32 c) const { return m_chunksAt + qsizetype(c) * kChunkBytes; }
+
+    bool stringOk(qsizetype refAt) const
+    {
+        return quint64(u32(refAt)) + u32(refAt + 4) <= m_stringBytes;
+    }
+    QByteArrayView string(qsizetype refAt) const
+    {
+        return QByteArrayView(m_data + m_stringsAt + u32(refAt), u32(refAt + 4));
+    }
+    QByteArrayView prefix(quint32 entry) const
+    {
+        const quint32 p = u32(entryAt(entry));
+        return p == kNoPrefix ? QByteArrayView()
+                              : string(m_prefixesAt + qsizetype(p) * kStringRefBytes);
+    }
+
+    /** Byte order of "<prefix>/<name>" against @p path, without building the string. */
+    int compareEntryPath(quint32 entry, const QByteArray& path) const
+    {
+        const QByteArrayView pre = prefix(entry);
+        const QByteArrayView name = string(entryAt(entry) + 4);
+        const qsizetype total = pre.isNull() ? name.size() : pre.size() + 1 + name.size();
+        const qsizetype n = std::min(total, path.size());
+        auto byteAt = [&](qsizetype i) -> uchar {
+            if (pre.isNull()) {
+                return uchar(name[i]);
+            }
+            if (i < pre.size()) {
+                return uchar(pre[i]);
+            }
+            return i == pre.size() ? uchar('/') : uchar(name[i - pre.size() - 1]);
+        };
+        for (qsizetype i = 0; i < n; ++i) {
+            const uchar a = byteAt(i);
+            const uchar b = uchar(path[i]);
+            if (a != b) {
+                return a < b ? -1 : 1;
+            }
+        }
+        return total == path.size() ? 0 : (total < path.size() ? -1 : 1);
+    }
+
+    WatchFileEntry entry(quint32 i) const
+    {
+        const qsizetype at = entryAt(i);
+        const QByteArrayView pre = prefix(i);
+        const QString name = QString::fromUtf8(string(at + 4));
+        WatchFileEntry e;
+        e.relativePath = pre.isNull() ? name : QString::fromUtf8(pre) + QLatin1Char('/') + name;
+        e.contentHash = HexEncoding::toString(m_data + at + 16, kDigestBytes);
+        const quint32 flags = u32(at + 12);
+        if (flags & kEntryHasMetadata) {
+            e.sizeBytes = u64(at + 48);
+            e.modifiedUtc = msToTime(i64(at + 56));
+            if (flags & kEntryHasChangeTime) {
+                e.changedUtc = msToTime(i64(at + 64));
+            }
+            e.inode = u64(at + 72);
+        }
+        if (m_version >= 2) {
+            const quint32 first = u32(at + 80);
+            const quint32 count = u32(at + 84);
+            e.chunks.reserve(count);
+            for (quint32 c = first; c < first + count; ++c) {
+                const qsizetype ca = chunkAt(c);
+                e.chunks.append(WatchChunk{u64(ca), u32(ca + 8),
+                                           HexEncoding::toString(m_data + ca + 16, kDigestBytes)});
+            }
+        }
+        return e;
+    }
+
+    const uchar* m_data = nullptr;
+    qsizetype m_size = 0;
+    bool m_valid = false;
+    quint16 m_version = 0;
+    qsizetype m_groupBytes = kGroupBytes;
+    qsizetype m_entryBytes = kEntryBytes;
+    quint32 m_chunks = 0;
+    qsizetype m_chunksAt = 0;
+    quint32 m_groups = 0;
+    quint32 m_watchPaths = 0;
+    quint32 m_prefixes = 0;
+    quint32 m_entries = 0;
+    quint32 m_stringBytes = 0;
+    qsizetype m_watchPathsAt = 0;
+    qsizetype m_prefixesAt = 0;
+    qsizetype m_entriesAt = 0;
+    qsizetype m_stringsAt = 0;
+};
+
+} // namespace
+
+QByteArray WatchManifestFile::encode(const WatchManifest& manifest)
+{
+    struct PendingEntry {
+        QByteArray path;
+        quint32 prefix = kNoPrefix;
+        StringPool::Ref name;
+        WatchFileEntry source;
+        QByteArray digest;
+    };
+
+    StringPool strings;
+    QHash<QByteArray, quint32> prefixIds;
+    std::vector<StringPool::Ref> prefixRefs;
+    std::vector<StringPool::Ref> watchPathRefs;
+    std::vector<std::vector<PendingEntry>> groupEntries;
+
+    const QByteArray manifestRoot = manifest.manifestRoot.isEmpty() ? QByteArray(kDigestBytes, '\0')
+                                                                     : rawDigest(manifest.manifestRoot);
+    if (manifestRoot.isEmpty()) {
+        return {};
+    }
+    for (const WatchGroup& g : manifest.groups) {
+        std::vector<PendingEntry> entries;
+        entries.reserve(static_cast<size_t>(g.files.size()));
+        for (const WatchFileEntry& f : g.files) {
+            PendingEntry e;
+            e.path = f.relativePath.toUtf8();
+            e.source = f;
+            e.digest = rawDigest(f.contentHash);
+            if (e.digest.isEmpty()) {
+                return {};
+            }
+            for (const WatchChunk& c : f.chunks) {
+                if (rawDigest(c.hash).isEmpty()) {
+                    return {};
+                }
+            }
+            entries.push_back(std::move(e));
+        }
+        std::sort(entries.begin(), entries.end(),
+                  [](const PendingEntry& a, const PendingEntry& b) { return a.path < b.path; });
+        groupEntries.push_back(std::move(entries));
+    }
+
+    // Strings: manifest version, group id/name, watch paths, prefixes, then file names.
+    const StringPool::Ref versionRef = strings.add(manifest.version);
+    std::vector<std::pair<StringPool::Ref, StringPool::Ref>> groupNames;
+    for (const WatchGroup& g : manifest.groups) {
+        groupNames.emplace_back(strings.add(g.id), strings.add(g.name));
+        for (const QString& p : g.watchPaths) {
+            watchPathRefs.push_back(strings.add(p));
+        }
+    }
+    for (std::vector<PendingEntry>& entries : groupEntries) {
+        for (PendingEntry& e : entries) {
+            const qsizetype slash = e.path.lastIndexOf('/');
+            if (slash >= 0) {
+                const QByteArray dir = e.path.left(slash);
+                auto it = prefixIds.constFind(dir);
+                if (it == prefixIds.cend()) {
+                    it = prefixIds.insert(dir, static_cast<quint32>(prefixRefs.size()));
+                    prefixRefs.push_back(strings.add(dir));
+                }
+                e.prefix = it.value();
+            }
+            e.name = strings.add(slash >= 0 ? e.path.mid(slash + 1) : e.path);
+        }
+    }
+
+    size_t entryCount = 0;
+    size_t chunkCount = 0;
+    for (const std::vector<PendingEntry>& entries : groupEntries) {
+        entryCount += entries.size();
+        for (const PendingEntry& e : entries) {
+            chunkCount += static_cast<size_t>(e.source.chunks.size());
+        }
+    }
+
+    QByteArray out;
+    out.reserve(kHeaderBytes + manifest.groups.size() * kGroupBytes
+                + qsizetype(watchPathRefs.size() + prefixRefs.size()) * kStringRefBytes
+                + qsizetype(entryCount) * kEntryBytes + qsizetype(chunkCount) * kChunkBytes
+                + strings.data().size());
+    Writer w(out);
+    w.u32(kMagic);
+    w.u16(kVersion);
+    w.u16(manifest.manifestRoot.isEmpty() ? 0 : kManifestHasRoot);
+    w.u32(static_cast<quint32>(manifest.groups.size()));
+    w.u32(static_cast<quint32>(watchPathRefs.size()));
+    w.u32(static_cast<quint32>(prefixRefs.size()));
+    w.u32(static_cast<quint32>(entryCount));
+    w.u32(static_cast<quint32>(strings.data().size()));
+    w.u32(static_cast<quint32>(chunkCount));
+    putRef(w, versionRef);
+    w.i64(timeToMs(manifest.updatedAt));
+    w.bytes(manifestRoot);
+
+    quint32 nextPath = 0;
+    quint32 nextEntry = 0;
+    for (qsizetype g = 0; g < manifest.groups.size(); ++g) {
+        const WatchGroup& group = manifest.groups.at(g);
+        const QByteArray root = group.merkleRoot.isEmpty() ? QByteArray(kDigestBytes, '\0')
+                                                           : rawDigest(group.merkleRoot);
+        if (root.isEmpty()) {
+            return {};
+        }
+        putRef(w, groupNames[size_t(g)].first);
+        putRef(w, groupNames[size_t(g)].second);
+        w.u32(nextPath);
+        w.u32(static_cast<quint32>(group.watchPaths.size()));
+        w.u32(nextEntry);
+        w.u32(static_cast<quint32>(groupEntries[size_t(g)].size()));
+        w.i64(timeToMs(group.builtAt));
+        w.bytes(root);
+        w.u32(group.merkleRoot.isEmpty() ? 0 : kGroupHasRoot);
+        w.u16(group.merkleFormat == 1 ? 0 : static_cast<quint16>(group.merkleFormat));
+        w.u16(group.merkleFormat == 1 ? 0 : static_cast<quint16>(group.merkleFanOut));
+        w.u64(group.chunkThresholdBytes);
+        nextPath += static_cast<quint32>(group.watchPaths.size());
+        nextEntry += static_cast<quint32>(groupEntries[size_t(g)].size());
+    }
+    for (const StringPool::Ref& ref : watchPathRefs) {
+        putRef(w, ref);
+    }
+    for (const StringPool::Ref& ref : prefixRefs) {
+        putRef(w, ref);
+    }
+    quint32 nextChunk = 0;
+    for (const std::vector<PendingEntry>& entries : groupEntries) {
+        for (const PendingEntry& e : entries) {
+            const WatchFileEntry& f = e.source;
+            quint32 flags = 0;
+            if (f.hasMetadata()) {
+                flags |= kEntryHasMetadata;
+                if (f.changedUtc.isValid()) {
+                    flags |= kEntryHasChangeTime;
+                }
+            }
+            w.u32(e.prefix);
+            putRef(w, e.name);
+            w.u32(flags);
+            w.bytes(e.digest);
+            w.u64(f.hasMetadata() ? f.sizeBytes : 0);
+            w.i64(f.hasMetadata() ? timeToMs(f.modifiedUtc) : kNoTime);
+            w.i64(f.hasMetadata() ? timeToMs(f.changedUtc) : kNoTime);
+            w.u64(f.hasMetadata() ? f.inode : 0);
+            w.u32(nextChunk);
+            w.u32(static_cast<quint32>(f.chunks.size()));
+            nextChunk += static_cast<quint32>(f.chunks.size());
+        }
+    }
+    for (const std::vector<PendingEntry>& entries : groupEntries) {
+        for (const PendingEntry& e : entries) {
+            for (const WatchChunk& c : e.source.chunks) {
+                w.u64(c.offset);
+                w.u32(c.length);
+                w.u32(0);
+                w.bytes(rawDigest(c.hash));
+            }
+        }
+    }
+    w.bytes(strings.data());
+    return out;
+}
+
+std::optional<WatchManifest> WatchManifestFile::decode(const QByteArray& data)
+{
+    const View view(reinterpret_cast<const uchar*>(data.constData()), data.size());
+    if (!view.valid()) {
+        return std::nullopt;
+    }
+    return view.manifest();
+}
+
+QString WatchManifestFile::pathFor(const QString& directory, const QString& sha256Hex)
+{
+    return directory + QLatin1Char('/') + sha256Hex + QStringLiteral(".fsmf");
+}
+
+QString WatchManifestFile::save(const QString& directory, const WatchManifest& manifest,
+                                QString* error)
+{
+    const QByteArray data = encode(manifest);
+    if (data.isEmpty()) {
+        if (error) {
+            *error = QStringLiteral("Manifest has digests that are not SHA-256");
+        }
+        return {};
+    }
+    const QString digest = HexEncoding::toString(QCryptographicHash::hash(data, QCryptographicHash::Sha256));
+    const QString path = pathFor(directory, digest);
+    if (QFileInfo::exists(path)) {
+        return digest;  // content-addressed: same bytes already there
+    }
+    QDir().mkpath(directory);
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        if (error) {
+            *error = QStringLiteral("Cannot write %1: %2").arg(path, file.errorString());
+        }
+        return {};
+    }
+    QFile::setPermissions(path, QFile::ReadOwner | QFile::WriteOwner);
+    return digest;
+}
+
+bool WatchManifestFile::saveEncoded(const QString& directory, const QByteArray& data,
+                                    const QString& sha256Hex, QString* error)
+{
+    const QString digest = HexEncoding::toString(QCryptographicHash::hash(data, QCryptographicHash::Sha256));
+    if (digest != sha256Hex || !View(reinterpret_cast<const uchar*>(data.constData()), data.size()).valid()) {
+        if (error) {
+            *error = QStringLiteral("Manifest %1 is altered or malformed").arg(sha256Hex);
+        }
+        return false;
+    }
+    const QString path = pathFor(directory, digest);
+    if (QFileInfo::exists(path)) {
+        return true;
+    }
+    QDir().mkpath(directory);
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        if (error) {
+            *error = QStringLiteral("Cannot write %1: %2").arg(path, file.errorString());
+        }
+        return false;
+    }
+    QFile::setPermissions(path, QFile::ReadOwner | QFile::WriteOwner);
+    return true;
+}
+
+std::unique_ptr<WatchManifestFile> WatchManifestFile::open(const QString& directory,
+                                                           const QString& sha256Hex)
+{
+    auto file = std::make_unique<QFile>(pathFor(directory, sha256Hex));
+    if (!file->open(QIODevice::ReadOnly) || file->size() < kHeaderBytes) {
+        return nullptr;
+    }
+    const qsizetype size = static_cast<qsizetype>(file->size());
+    const uchar* data = file->map(0, size);
+    if (!data) {
+        return nullptr;
+    }
+    const QByteArray digest = QCryptographicHash::hash(
+        QByteArray::fromRawData(reinterpret_cast<const char*>(data), size), QCryptographicHash::Sha256);
+    if (HexEncoding::toString(digest) != sha256Hex || !View(data, size).valid()) {
+        return nullptr;
+    }
+
+    std::unique_ptr<WatchManifestFile> mapped(new WatchManifestFile);
+    mapped->m_file = std::move(file);
+    mapped->m_data = data;
+    mapped->m_size = size;
+    return mapped;
+}
+
+int WatchManifestFile::groupCount() const
+{
+    return static_cast<int>(View(m_data, m_size).groupCount());
+}
+
+qsizetype WatchManifestFile::fileCount(int group) const
+{
+    const View view(m_data, m_size);
+    if (group < 0 || quint32(group) >= view.groupCount()) {
+        return 0;
+    }
+    return view.groupEntryCount(quint32(group));
+}
+
+std::optional<WatchFileEntry> WatchManifestFile::find(int group, const QString& relativePath) const
+{
+    const View view(m_data, m_size);
+    if (group < 0 || quint32(group) >= view.groupCount()) {
+        return std::nullopt;
+    }
+    return view.find(quint32(group), relativePath.toUtf8());
+}
+
+WatchManifest WatchManifestFile::manifest() const
+{
+    return View(m_data, m_size).manifest();
+}
+
+} // namespace FlashSpartan
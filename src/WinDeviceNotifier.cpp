@@ -0,0 +1,61 @@
+#include "WinDeviceNotifier.h"
+
+#ifdef Q_OS_WIN
+
+#include <QDebug>
+#include <QMutexLocker>
+
+#include <utility>
+
+namespace FlashSpartan {
+
+WinDeviceNotifier::WinDeviceNotifier(const GUID& interfaceClass, HANDLE wakeEvent)
+    : m_wakeEvent(wakeEvent)
+{
+    CM_NOTIFY_FILTER filter{};
+    filter.cbSize = sizeof(filter);
+    filter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+    filter.u.DeviceInterface.ClassGuid = interfaceClass;
+    if (CM_Register_Notification(&filter, this, &WinDeviceNotifier::onNotification, &m_handle)
+        != CR_SUCCESS) {
+        qWarning() << "WinDeviceNotifier: CM_Register_Notification failed; falling back to polling";
+        m_handle = nullptr;
+    }
+}
+
+WinDeviceNotifier::~WinDeviceNotifier()
+{
+    if (m_handle) {
+        CM_Unregister_Notification(m_handle);  // waits for a running callback
+    }
+}
+
+QList<WinDeviceNotifier::Event> WinDeviceNotifier::take()
+{
+    QMutexLocker locker(&m_mutex);
+    return std::exchange(m_events, {});
+}
+
+DWORD CALLBACK WinDeviceNotifier::onNotification(HCMNOTIFICATION /*handle*/, PVOID context,
+                                                 CM_NOTIFY_ACTION action, PCM_NOTIFY_EVENT_DATA data,
+                                                 DWORD /*size*/)
+{
+    if (action != CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL
+        && action != CM_NOTIFY_ACTION_DEVICEINTERFACEREMOVAL) {
+        return ERROR_SUCCESS;
+    }
+    auto* self = static_cast<WinDeviceNotifier*>(context);
+    Event event;
+    event.action = action == CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL ? Action::Arrival : Action::Removal;
+    event.interfacePath = QString::fromWCharArray(data->u.DeviceInterface.SymbolicLink);
+    {
+        QMutexLocker locker(&self->m_mutex);
+        self->m_events.append(event);
+    }
+    SetEvent(self->m_wakeEvent);
+    return ERROR_SUCCESS;
+}
+
+} // namespace FlashSpartan
+
+#endif
@@ -0,0 +1,170 @@
+#include "WinOverlappedReader.h"
+
+#ifdef Q_OS_WIN
+
+#include <QtGlobal>
+
+namespace FlashSpartan {
+
+namespace {
+
+size_t alignedUp(size_t value)
+{
+    return (value + WinOverlappedReader::kAlignment - 1) / WinOverlappedReader::kAlignment
+           * WinOverlappedReader::kAlignment;
+}
+
+} // namespace
+
+WinOverlappedReader::WinOverlappedReader(HANDLE source, int depth, size_t bufferSize)
+    : m_source(source)
+    , m_bufferSize(alignedUp(qMax<size_t>(bufferSize, kAlignment)))
+    , m_slots(static_cast<size_t>(qMax(1, depth)))
+{
+}
+
+WinOverlappedReader::~WinOverlappedReader()
+{
+    cancelAll();
+    for (Slot& slot : m_slots) {
+        if (slot.buffer) {
+            VirtualFree(slot.buffer, 0, MEM_RELEASE);
+        }
+        if (slot.overlapped.hEvent) {
+            CloseHandle(slot.overlapped.hEvent);
+        }
+    }
+    if (m_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_handle);
+    }
+}
+
+bool WinOverlappedReader::open(QString* error)
+{
+    m_handle = ReOpenFile(m_source, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                          FILE_FLAG_OVERLAPPED | FILE_FLAG_NO_BUFFERING | FILE_FLAG_SEQUENTIAL_SCAN);
+    if (m_handle == INVALID_HANDLE_VALUE) {
+        *error = QStringLiteral("Cannot reopen device for overlapped reads: Win32 error %1")
+                     .arg(GetLastError());
+        return false;
+    }
+    for (Slot& slot : m_slots) {
+        slot.buffer = static_cast<char*>(
+            VirtualAlloc(nullptr, m_bufferSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+        slot.overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (!slot.buffer || !slot.overlapped.hEvent) {
+            *error = QStringLiteral("Failed to allocate buffer");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool WinOverlappedReader::submit(Slot& slot, QString* error)
+{
+    const uint64_t position = slot.offset + slot.filled;
+    ResetEvent(slot.overlapped.hEvent);
+    slot.overlapped.Offset = static_cast<DWORD>(position & 0xFFFFFFFFu);
+    slot.overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+    if (!ReadFile(m_handle, slot.buffer + slot.filled, static_cast<DWORD>(slot.request - slot.filled),
+                  nullptr, &slot.overlapped)
+        && GetLastError() != ERROR_IO_PENDING) {
+        *error = QStringLiteral("Read error: Win32 error %1").arg(GetLastError());
+        return false;
+    }
+    slot.inFlight = true;
+    return true;
+}
+
+void WinOverlappedReader::cancelAll()
+{
+    if (m_handle == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    CancelIoEx(m_handle, nullptr);
+    for (Slot& slot : m_slots) {
+        if (slot.inFlight) {
+            DWORD ignored = 0;
+            GetOverlappedResult(m_handle, &slot.overlapped, &ignored, TRUE);
+            slot.inFlight = false;
+        }
+    }
+}
+
+bool WinOverlappedReader::read(uint64_t offset, uint64_t length,
+                               const std::function<bool(const char*, size_t)>& consume, QString* error)
+{
+    if (offset % kAlignment != 0) {
+        *error = QStringLiteral("Unaligned offset for unbuffered reads");
+        return false;
+    }
+    const uint64_t end = offset + length;
+    uint64_t nextOffset = offset;
+    auto assign = [&](Slot& slot) {
+        slot.offset = nextOffset;
+        slot.length = static_cast<size_t>(qMin<uint64_t>(m_bufferSize, end - nextOffset));
+        slot.request = alignedUp(slot.length);
+        slot.filled = 0;
+        nextOffset += slot.length;
+    };
+
+    const size_t depth = m_slots.size();
+    for (size_t i = 0; i < depth && nextOffset < end; ++i) {
+        assign(m_slots[i]);
+        if (!submit(m_slots[i], error)) {
+            cancelAll();
+            return false;
+        }
+    }
+
+    size_t head = 0;
+    uint64_t consumed = offset;
+    while (consumed < end) {
+        Slot& ready = m_slots[head];
+        while (ready.inFlight) {
+            DWORD got = 0;
+            const BOOL ok = GetOverlappedResult(m_handle, &ready.overlapped, &got, TRUE);
+            ready.inFlight = false;
+            const DWORD lastError = ok ? ERROR_SUCCESS : GetLastError();
+            if (!ok && lastError != ERROR_HANDLE_EOF) {
+                cancelAll();
+                *error = QStringLiteral("Read error: Win32 error %1").arg(lastError);
+                return false;
+            }
+            ready.filled += got;
+            if (ready.filled >= ready.length) {
+                break;
+            }
+            // Short read: continue where it stopped, which must still be sector aligned.
+            if (got == 0 || ready.filled % kAlignment != 0) {
+                cancelAll();
+                *error = QStringLiteral("Unexpected EOF");
+                return false;
+            }
+            if (!submit(ready, error)) {
+                cancelAll();
+                return false;
+            }
+        }
+
+        if (!consume(ready.buffer, ready.length)) {
+            cancelAll();
+            return false;
+        }
+        consumed += ready.length;
+
+        if (nextOffset < end) {
+            assign(ready);
+            if (!submit(ready, error)) {
+                cancelAll();
+                return false;
+            }
+        }
+        head = (head + 1) % depth;
+    }
+    return true;
+}
+
+} // namespace FlashSpartan
+
+#endif
@@ -1,10 +1,14 @@
 #include "WinStorage.h"
+#include "PerfMetrics.h"
 
 #ifdef Q_OS_WIN
 
 #include <qt_windows.h>
 
 #include <QDir>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QRegularExpression>
 
 #include <winioctl.h>
@@ -64,6 +68,99 @@ bool physicalDriveBusType(const QString& physicalPath, STORAGE_BUS_TYPE* busOut)
     return true;
 }
 
+/** The device number query behind physicalDrivePathForVolume(), uncached. */
+QString queryPhysicalDrive(const QString& volumeRoot)
+{
+    const QString volPath = volumeDevicePath(volumeRoot);
+    if (volPath.isEmpty()) {
+        return {};
+    }
+
+    HANDLE hVol = CreateFileW(reinterpret_cast<LPCWSTR>(volPath.utf16()), 0,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0,
+                              nullptr);
+    if (hVol == INVALID_HANDLE_VALUE) {
+        return {};
+    }
+
+    STORAGE_DEVICE_NUMBER deviceNumber{};
+    DWORD bytesReturned = 0;
+    QString physicalPath;
+    if (DeviceIoControl(hVol, IOCTL_STORAGE_GET_DEVICE_NUMBER, nullptr, 0, &deviceNumber,
+                        sizeof(deviceNumber), &bytesReturned, nullptr)) {
+        physicalPath =
+            QStringLiteral("\\\\.\\PhysicalDrive%1").arg(deviceNumber.DeviceNumber);
+    }
+    CloseHandle(hVol);
+    return physicalPath;
+}
+
+/** Where one lettered volume leads. */
+struct VolumeMapping {
+    UINT driveType = DRIVE_UNKNOWN;
+    QString physicalDrive;
+    /** Only looked up for fixed, CD and unknown volumes; removable ones are USB by type. */
+    bool busKnown = false;
+    STORAGE_BUS_TYPE bus = BusTypeUnknown;
+};
+
+/**
+ * Volume root ("E:\") to physical drive and bus type. Resolving one costs a handle open per
+ * volume and disk and up to three IOCTLs, and device scans, hashing, ISO scans and card
+ * refreshes all ask, several times per refresh. Entries live until invalidateVolumeCache(),
+ * which DeviceMonitor calls when a volume arrives or is removed; the generation keeps a
+ * lookup that raced an invalidation from storing what it resolved before it.
+ */
+struct VolumeMap {
+    QMutex mutex;
+    QHash<QString, VolumeMapping> byRoot;
+    quint64 generation = 0;
+};
+
+VolumeMap& volumeMap()
+{
+    static VolumeMap map;
+    return map;
+}
+
+VolumeMapping resolveVolume(const QString& root)
+{
+    VolumeMapping mapping;
+    mapping.driveType = GetDriveTypeW(reinterpret_cast<LPCWSTR>(root.utf16()));
+    mapping.physicalDrive = queryPhysicalDrive(root);
+    if (mapping.driveType == DRIVE_CDROM || mapping.driveType == DRIVE_FIXED
+        || mapping.driveType == DRIVE_UNKNOWN) {
+        mapping.busKnown = physicalDriveBusType(mapping.physicalDrive, &mapping.bus);
+    }
+    return mapping;
+}
+
+/** @p root as normalizeVolumeRoot() returns it for a drive letter. */
+VolumeMapping volumeMapping(const QString& root)
+{
+    VolumeMap& map = volumeMap();
+    quint64 generation = 0;
+    {
+        QMutexLocker locker(&map.mutex);
+        const auto it = map.byRoot.constFind(root);
+        if (it != map.byRoot.constEnd()) {
+            PerfMetrics::cacheLookup(PerfMetrics::Cache::VolumeMap, true).add();
+            return *it;
+        }
+        generation = map.generation;
+    }
+    PerfMetrics::cacheLookup(PerfMetrics::Cache::VolumeMap, false).add();
+    const VolumeMapping mapping = resolveVolume(root);
+    // No device number yet (media not ready, or being removed): ask again next time.
+    if (!mapping.physicalDrive.isEmpty()) {
+        QMutexLocker locker(&map.mutex);
+        if (map.generation == generation) {
+            map.byRoot.insert(root, mapping);
+        }
+    }
+    return mapping;
+}
+
 QString winErrorMessage(DWORD code)
 {
     wchar_t* buffer = nullptr;
@@ -104,28 +201,11 @@ QString volumeDevicePath(const QString& volumeRoot)
 
 QString physicalDrivePathForVolume(const QString& volumeRoot)
 {
-    const QString volPath = volumeDevicePath(volumeRoot);
-    if (volPath.isEmpty()) {
-        return {};
-    }
-
-    HANDLE hVol = CreateFileW(reinterpret_cast<LPCWSTR>(volPath.utf16()), 0,
-                              FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0,
-                              nullptr);
-    if (hVol == INVALID_HANDLE_VALUE) {
+    const QString letter = driveLetterFromRoot(volumeRoot);
+    if (letter.isEmpty()) {
         return {};
     }
-
-    STORAGE_DEVICE_NUMBER deviceNumber{};
-    DWORD bytesReturned = 0;
-    QString physicalPath;
-    if (DeviceIoControl(hVol, IOCTL_STORAGE_GET_DEVICE_NUMBER, nullptr, 0, &deviceNumber,
-                        sizeof(deviceNumber), &bytesReturned, nullptr)) {
-        physicalPath =
-            QStringLiteral("\\\\.\\PhysicalDrive%1").arg(deviceNumber.DeviceNumber);
-    }
-    CloseHandle(hVol);
-    return physicalPath;
+    return volumeMapping(letter + QLatin1Char('\\')).physicalDrive;
 }
 
 QString physicalDrivePathForDeviceNode(const QString& deviceNode)
@@ -241,29 +321,26 @@ bool isUsbFlashVolumeRoot(const QString& volumeRoot)
         return false;
     }
 
-    const UINT driveType =
-        GetDriveTypeW(reinterpret_cast<LPCWSTR>(root.utf16()));
-    if (driveType == DRIVE_REMOVABLE) {
-        return true;
-    }
-    if (driveType == DRIVE_CDROM) {
-        STORAGE_BUS_TYPE busType = BusTypeUnknown;
-        const QString physical = physicalDrivePathForVolume(root);
-        if (physicalDriveBusType(physical, &busType)) {
-            return busType == BusTypeUsb;
-        }
-        return false;
-    }
-    if (driveType != DRIVE_FIXED && driveType != DRIVE_UNKNOWN) {
-        return false;
+    if (driveLetterFromRoot(root).isEmpty()) {
+        const UINT driveType = GetDriveTypeW(reinterpret_cast<LPCWSTR>(root.utf16()));
+        return driveType == DRIVE_REMOVABLE;
     }
 
-    STORAGE_BUS_TYPE busType = BusTypeUnknown;
-    const QString physical = physicalDrivePathForVolume(root);
-    if (!physicalDriveBusType(physical, &busType)) {
-        return false;
+    const VolumeMapping mapping = volumeMapping(root);
+    if (mapping.driveType == DRIVE_REMOVABLE) {
+        return true;
     }
-    return busType == BusTypeUsb;
+    return mapping.busKnown && mapping.bus == BusTypeUsb;
+}
+
+const GUID kVolumeInterfaceClass = {0x53F5630D, 0xB6BF, 0x11D0, {0x94, 0xF2, 0x00, 0xA0, 0xC9, 0x1E, 0xFB, 0x8B}};
+
+void invalidateVolumeCache()
+{
+    VolumeMap& map = volumeMap();
+    QMutexLocker locker(&map.mutex);
+    map.byRoot.clear();
+    ++map.generation;
 }
 
 bool dismountVolumeRootInPlace(const QString& volumeRoot, QString* error)
@@ -290,6 +367,9 @@ bool dismountVolumeRootInPlace(const QString& volumeRoot, QString* error)
     lockVolume(hVol, nullptr);
     const bool dismounted = dismountVolumeHandle(hVol, error);
     CloseHandle(hVol);
+    if (dismounted) {
+        invalidateVolumeCache();
+    }
     return dismounted;
 }
 
@@ -331,6 +411,7 @@ bool ejectVolumeRoot(const QString& volumeRoot, bool force, QString* error)
         }
         return false;
     }
+    invalidateVolumeCache();
     return true;
 }
 
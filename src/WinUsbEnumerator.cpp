@@ -4,6 +4,9 @@
 
 #include <qt_windows.h>
 
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QRegularExpression>
 #include <QSet>
 
@@ -153,20 +156,17 @@ UsbHostTier classifyHostTier(DEVINST devInst, const QString& instanceId, const Q
     return UsbHostTier::InternalHost;
 }
 
-std::optional<UsbHostDeviceInfo> deviceFromInstanceId(const QString& instanceId)
+bool locateDevNode(const QString& instanceId, DEVINST* devInst)
 {
-    if (instanceId.isEmpty()) {
-        return std::nullopt;
-    }
-
-    DEVINST devInst = 0;
-    if (CM_Locate_DevNodeW(&devInst, reinterpret_cast<DEVINSTID_W>(const_cast<wchar_t*>(
-                                                    reinterpret_cast<const wchar_t*>(instanceId.utf16()))),
-                           CM_LOCATE_DEVNODE_NORMAL)
-        != CR_SUCCESS) {
-        return std::nullopt;
-    }
+    return !instanceId.isEmpty()
+           && CM_Locate_DevNodeW(devInst, reinterpret_cast<DEVINSTID_W>(const_cast<wchar_t*>(
+                                              reinterpret_cast<const wchar_t*>(instanceId.utf16()))),
+                                 CM_LOCATE_DEVNODE_NORMAL)
+                  == CR_SUCCESS;
+}
 
+UsbHostDeviceInfo deviceFromDevNode(DEVINST devInst, const QString& instanceId)
+{
     UsbHostDeviceInfo info;
     info.instanceId = instanceId;
     info.manufacturer = devPropString(devInst, &DEVPKEY_Device_Manufacturer);
@@ -188,6 +188,52 @@ std::optional<UsbHostDeviceInfo> deviceFromInstanceId(const QString& instanceId)
     return info;
 }
 
+/**
+ * Descriptions of present nodes by instance ID. The property reads behind an entry are
+ * repeated only when the node's status/problem pair changes (driver bound, started,
+ * failed), when describeDeviceTree() sees it arrive, or after invalidateDescriptions().
+ */
+struct DescriptionCache {
+    struct Entry {
+        UsbHostDeviceInfo info;
+        ULONG status = 0;
+        ULONG problem = 0;
+    };
+
+    QMutex mutex;
+    QHash<QString, Entry> entries;
+};
+
+DescriptionCache& descriptionCache()
+{
+    static DescriptionCache cache;
+    return cache;
+}
+
+std::optional<UsbHostDeviceInfo> deviceFromInstanceId(const QString& instanceId, bool refresh)
+{
+    DEVINST devInst = 0;
+    if (!locateDevNode(instanceId, &devInst)) {
+        return std::nullopt;
+    }
+    ULONG status = 0;
+    ULONG problem = 0;
+    CM_Get_DevNode_Status(&status, &problem, devInst, 0);
+
+    DescriptionCache& cache = descriptionCache();
+    if (!refresh) {
+        QMutexLocker locker(&cache.mutex);
+        const auto it = cache.entries.constFind(instanceId);
+        if (it != cache.entries.constEnd() && it->status == status && it->problem == problem) {
+            return it->info;
+        }
+    }
+    const UsbHostDeviceInfo info = deviceFromDevNode(devInst, instanceId);
+    QMutexLocker locker(&cache.mutex);
+    cache.entries.insert(instanceId, {info, status, problem});
+    return info;
+}
+
 bool isUsbInstanceId(const QString& instanceId)
 {
     const QString upper = instanceId.toUpper();
@@ -225,7 +271,7 @@ QList<UsbHostDeviceInfo> enumeratePresentUsbDevices()
             continue;
         }
 
-        const std::optional<UsbHostDeviceInfo> info = deviceFromInstanceId(instanceId);
+        const std::optional<UsbHostDeviceInfo> info = deviceFromInstanceId(instanceId, false);
         if (!info) {
             continue;
         }
@@ -234,9 +280,84 @@ QList<UsbHostDeviceInfo> enumeratePresentUsbDevices()
         devices.append(*info);
     }
 
+    DescriptionCache& cache = descriptionCache();
+    QMutexLocker locker(&cache.mutex);
+    for (auto it = cache.entries.begin(); it != cache.entries.end();) {
+        if (seen.contains(it.key())) {
+            ++it;
+        } else {
+            it = cache.entries.erase(it);
+        }
+    }
     return devices;
 }
 
+void invalidateDescriptions()
+{
+    DescriptionCache& cache = descriptionCache();
+    QMutexLocker locker(&cache.mutex);
+    cache.entries.clear();
+}
+
+const GUID kUsbDeviceInterfaceClass = {0xA5DCBF10, 0x6530, 0x11D2, {0x90, 0x1F, 0x00, 0xC0, 0x4F, 0xB9, 0x51, 0xED}};
+
+QString instanceIdFromInterfacePath(const QString& interfacePath)
+{
+    QString id = interfacePath;
+    if (id.startsWith(QStringLiteral("\\\\?\\")) || id.startsWith(QStringLiteral("\\\\.\\"))) {
+        id = id.mid(4);
+    }
+    const int guidStart = id.lastIndexOf(QStringLiteral("#{"));
+    if (guidStart >= 0) {
+        id.truncate(guidStart);
+    }
+    id.replace(QLatin1Char('#'), QLatin1Char('\\'));
+    return id.toUpper();
+}
+
+QList<UsbHostDeviceInfo> describeDeviceTree(const QString& instanceId)
+{
+    QList<UsbHostDeviceInfo> devices;
+    DEVINST root = 0;
+    if (!locateDevNode(instanceId, &root)) {
+        return devices;
+    }
+
+    QList<DEVINST> pending{root};
+    while (!pending.isEmpty()) {
+        const DEVINST devInst = pending.takeLast();
+        wchar_t id[MAX_DEVICE_ID_LEN] = {};
+        if (CM_Get_Device_IDW(devInst, id, MAX_DEVICE_ID_LEN, 0) != CR_SUCCESS) {
+            continue;
+        }
+        const QString childId = QString::fromWCharArray(id);
+        if (!isUsbInstanceId(childId)) {
+            continue;  // USBSTOR\, HID\ ... below a USB node are not host nodes
+        }
+        devices.append(deviceFromDevNode(devInst, childId));
+        {
+            DescriptionCache& cache = descriptionCache();
+            ULONG status = 0;
+            ULONG problem = 0;
+            CM_Get_DevNode_Status(&status, &problem, devInst, 0);
+            QMutexLocker locker(&cache.mutex);
+            cache.entries.insert(childId, {devices.constLast(), status, problem});
+        }
+        DEVINST child = 0;
+        for (CONFIGRET cr = CM_Get_Child(&child, devInst, 0); cr == CR_SUCCESS;
+             cr = CM_Get_Sibling(&child, child, 0)) {
+            pending.append(child);
+        }
+    }
+    return devices;
+}
+
+bool isPresent(const QString& instanceId)
+{
+    DEVINST devInst = 0;
+    return locateDevNode(instanceId, &devInst);
+}
+
 } // namespace FlashSpartan::WinUsbEnumerator
 
 #endif
@@ -0,0 +1,126 @@
+// EVP_MD_meth_* is the only way to plug a non-provider digest into EVP_DigestInit_ex;
+// it is deprecated in OpenSSL 3 but still supported for exactly this use.
+#define OPENSSL_SUPPRESS_DEPRECATED
+
+#include "Xxh3Digest.h"
+
+#ifdef HAS_XXHASH
+
+#include <xxhash.h>
+
+namespace FlashSpartan::RawDeviceHash {
+
+namespace {
+
+// md_data only holds a pointer: XXH3_state_t needs 64-byte alignment, which
+// OPENSSL_zalloc does not guarantee, so the state itself comes from XXH3_createState().
+XXH3_state_t*& stateOf(EVP_MD_CTX* ctx)
+{
+    return *static_cast<XXH3_state_t**>(EVP_MD_CTX_md_data(ctx));
+}
+
+int xxh3Init(EVP_MD_CTX* ctx)
+{
+    XXH3_state_t*& state = stateOf(ctx);
+    if (!state) {
+        state = XXH3_createState();
+        if (!state) {
+            return 0;
+        }
+    }
+    return XXH3_128bits_reset(state) == XXH_OK ? 1 : 0;
+}
+
+int xxh3Update(EVP_MD_CTX* ctx, const void* data, size_t count)
+{
+    XXH3_state_t* state = stateOf(ctx);
+    return state && XXH3_128bits_update(state, data, count) == XXH_OK ? 1 : 0;
+}
+
+int xxh3Final(EVP_MD_CTX* ctx, unsigned char* md)
+{
+    XXH3_state_t* state = stateOf(ctx);
+    if (!state) {
+        return 0;
+    }
+    XXH128_canonical_t canonical;
+    XXH128_canonicalFromHash(&canonical, XXH3_128bits_digest(state));
+    static_assert(sizeof(canonical.digest) == 16, "XXH128 canonical form is 16 bytes");
+    for (size_t i = 0; i < sizeof(canonical.digest); ++i) {
+        md[i] = canonical.digest[i];
+    }
+    return 1;
+}
+
+int xxh3Copy(EVP_MD_CTX* to, const EVP_MD_CTX* from)
+{
+    // EVP_MD_CTX_copy_ex has already memcpy'd md_data, so `to` points at `from`'s state.
+    XXH3_state_t* src = *static_cast<XXH3_state_t* const*>(
+        EVP_MD_CTX_md_data(const_cast<EVP_MD_CTX*>(from)));
+    XXH3_state_t*& dst = stateOf(to);
+    dst = nullptr;
+    if (!src) {
+        return 1;
+    }
+    dst = XXH3_createState();
+    if (!dst) {
+        return 0;
+    }
+    XXH3_copyState(dst, src);
+    return 1;
+}
+
+int xxh3Cleanup(EVP_MD_CTX* ctx)
+{
+    if (!EVP_MD_CTX_md_data(ctx)) {
+        return 1;
+    }
+    XXH3_state_t*& state = stateOf(ctx);
+    XXH3_freeState(state);
+    state = nullptr;
+    return 1;
+}
+
+EVP_MD* createXxh3Md()
+{
+    EVP_MD* md = EVP_MD_meth_new(NID_undef, NID_undef);
+    if (!md) {
+        return nullptr;
+    }
+    if (EVP_MD_meth_set_result_size(md, 16) != 1
+        || EVP_MD_meth_set_input_blocksize(md, 64) != 1
+        || EVP_MD_meth_set_app_datasize(md, sizeof(XXH3_state_t*)) != 1
+        || EVP_MD_meth_set_init(md, xxh3Init) != 1
+        || EVP_MD_meth_set_update(md, xxh3Update) != 1
+        || EVP_MD_meth_set_final(md, xxh3Final) != 1
+        || EVP_MD_meth_set_copy(md, xxh3Copy) != 1
+        || EVP_MD_meth_set_cleanup(md, xxh3Cleanup) != 1) {
+        EVP_MD_meth_free(md);
+        return nullptr;
+    }
+    return md;
+}
+
+} // namespace
+
+const EVP_MD* xxh3_128Digest()
+{
+    // Built once and kept for the process lifetime; EVP_MD_CTX only borrows it.
+    static const EVP_MD* md = createXxh3Md();
+    return md;
+}
+
+} // namespace FlashSpartan::RawDeviceHash
+
+#else
+
+namespace FlashSpartan::RawDeviceHash {
+
+const EVP_MD* xxh3_128Digest()
+{
+    return nullptr;
+}
+
+} // namespace FlashSpartan::RawDeviceHash
+
+#endif
@@ -1,20 +1,37 @@
 /**
  * flashspartan-policyd — isolated process owning the signed policy store.
- * All trust/block mutations go through this daemon; the GUI uses PolicyDaemonClient.
+ * All trust/block mutations go through this daemon; the GUI uses PolicyDaemonClient over
+ * the framed PolicyProtocol.
  */
 
+#include "policy/PolicyJsonStream.h"
 #include "policy/PolicyPaths.h"
+#include "policy/PolicyProtocol.h"
+#include "policy/PolicyReplicator.h"
 #include "policy/PolicyStoreEngine.h"
 #include "policy/PolicyAudit.h"
+#include "AuditWriter.h"
+#include "PerfMetrics.h"
+#include "PerfTrace.h"
 
 #include <QCoreApplication>
-#include <QFile>
-#include <QJsonArray>
-#include <QJsonDocument>
-#include <QJsonObject>
+#include <QHash>
 #include <QLocalServer>
 #include <QLocalSocket>
 #include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <cstdlib>
+#include <unistd.h>
+#endif
 
 using namespace FlashSpartan;
 using namespace FlashSpartan::Policy;
@@ -26,17 +43,27 @@ public:
     explicit PolicyDaemonServer(QObject* parent = nullptr)
         : QObject(parent)
     {
-        QString err;
-        if (!m_engine.load(&err)) {
-            qWarning() << "policyd: load failed:" << err;
-        }
         connect(&m_server, &QLocalServer::newConnection, this, &PolicyDaemonServer::onNewConnection);
+        m_groupTimer.setSingleShot(true);
+        m_groupTimer.setInterval(kGroupWindowMs);
+        connect(&m_groupTimer, &QTimer::timeout, this, &PolicyDaemonServer::commitGroup);
     }
 
+    /**
+     * Takes the socket systemd passed in (flashspartan-policyd.socket), or creates it. Called
+     * before load(): clients can connect at once, and their requests wait in the socket
+     * until the event loop starts.
+     */
     bool listen(QString* error)
     {
-        QLocalServer::removeServer(PolicyPaths::socketPath());
-        if (!m_server.listen(PolicyPaths::socketPath())) {
+        bool listening = false;
+        if (const int activated = activatedSocket(); activated >= 0) {
+            listening = m_server.listen(activated);
+        } else {
+            QLocalServer::removeServer(PolicyPaths::socketPath());
+            listening = m_server.listen(PolicyPaths::socketPath());
+        }
+        if (!listening) {
             if (error) {
                 *error = m_server.errorString();
             }
@@ -45,158 +72,424 @@ public:
         return true;
     }
 
+    void load()
+    {
+        QString err;
+        if (!m_engine.load(&err)) {
+            qWarning() << "policyd: load failed:" << err;
+        }
+    }
+
+    /** Starts fleet replication when replication.json configures it; after load(). */
+    void startReplication()
+    {
+        PolicyReplication::Config config;
+        QString err;
+        if (!PolicyReplication::loadConfig(&config, &err)) {
+            qWarning() << "policyd: replication disabled:" << err;
+            return;
+        }
+        if (!config.isEnabled()) {
+            return;
+        }
+        m_replicator = std::make_unique<PolicyReplicator>(m_engine, std::move(config));
+        m_replicator->setAppliedHandler([this]() { notifySubscribers(); });
+        if (!m_replicator->start(&err)) {
+            qWarning() << "policyd: replication listen failed:" << err;
+        }
+    }
+
 private slots:
     void onNewConnection()
     {
         while (QLocalSocket* socket = m_server.nextPendingConnection()) {
-            connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
-                const QByteArray line = socket->readAll().trimmed();
-                QJsonObject resp;
-                if (line.isEmpty()) {
-                    resp = {{QStringLiteral("ok"), false},
-                            {QStringLiteral("error"), QStringLiteral("empty request")}};
-                } else {
-                    const QJsonDocument doc = QJsonDocument::fromJson(line);
-                    resp = doc.isObject() ? dispatch(doc.object())
-                                          : QJsonObject{{QStringLiteral("ok"), false},
-                                                        {QStringLiteral("error"),
-                                                         QStringLiteral("invalid json")}};
-                }
-                socket->write(QJsonDocument(resp).toJson(QJsonDocument::Compact));
-                socket->write("\n");
-                socket->flush();
-                socket->disconnectFromServer();
-                socket->deleteLater();
-            });
+            auto buffer = std::make_shared<QByteArray>();
+            connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+            connect(socket, &QLocalSocket::disconnected, this,
+                    [this, socket]() { m_busy.remove(socket); });
+            connect(socket, &QLocalSocket::readyRead, this,
+                    [this, socket, buffer]() { readRequests(socket, buffer); });
         }
     }
 
 private:
-    QJsonObject dispatch(const QJsonObject& req)
-    {
-        const QString op = req[QStringLiteral("op")].toString();
-        const QString actor = req.value(QStringLiteral("actor")).toString(QStringLiteral("policyd"));
+    /**
+     * Group commit: mutations arriving within kGroupWindowMs of the first, from any client,
+     * share one fdatasync (up to kMaxGroupMutations). Replies are held until then, so a
+     * client's ok still means its edit is on disk.
+     */
+    static constexpr int kGroupWindowMs = 2;
+    static constexpr int kMaxGroupMutations = 64;
+
+    struct HeldReply {
+        QPointer<QLocalSocket> socket;
+        PolicyProtocol::Reply reply;
+        bool mutation = false;
+    };
+
+    /** Where a subscriber's last Event left it. */
+    struct Cursor {
+        quint64 epoch = 0;
+        quint64 generation = 0;
+    };
 
-        if (op == QLatin1String("ping")) {
-            return {{QStringLiteral("ok"), true}};
+    /** The listening socket from systemd socket activation (sd_listen_fds()), or -1. */
+    static int activatedSocket()
+    {
+#ifdef Q_OS_LINUX
+        constexpr int kListenFdsStart = 3;  // SD_LISTEN_FDS_START
+        const QByteArray pid = qgetenv("LISTEN_PID");
+        const int count = qEnvironmentVariableIntValue("LISTEN_FDS");
+        if (pid.isEmpty() || pid.toLongLong() != static_cast<qint64>(getpid()) || count < 1) {
+            return -1;
         }
+        // Not inherited by anything this process starts
+        unsetenv("LISTEN_PID");
+        unsetenv("LISTEN_FDS");
+        unsetenv("LISTEN_FDNAMES");
+        return kListenFdsStart;
+#else
+        return -1;
+#endif
+    }
 
-        if (op == QLatin1String("load") || op == QLatin1String("reload")) {
-            QString err;
-            const bool ok = m_engine.load(&err);
-            QJsonObject r{{QStringLiteral("ok"), ok}};
-            if (!ok) {
-                r[QStringLiteral("error")] = err;
+    static bool isMutation(PolicyProtocol::FrameType type)
+    {
+        using PolicyProtocol::FrameType;
+        return type != FrameType::Ping && type != FrameType::Changes && type != FrameType::ExportJson;
+    }
+
+    /** Export and import can take seconds on a large store; they run off the event loop. */
+    static bool isBulk(PolicyProtocol::FrameType type)
+    {
+        using PolicyProtocol::FrameType;
+        return type == FrameType::ExportJson || type == FrameType::ImportJson;
+    }
+
+    /**
+     * A base from another epoch (a client that just connected, or one that missed a reload)
+     * is answered with every record. Building and encoding that runs off the event loop too,
+     * from the published snapshot, so clients connecting together don't queue behind it.
+     */
+    bool isFullResync(const PolicyProtocol::Request& req) const
+    {
+        const std::shared_ptr<const PolicySnapshot> snapshot = m_engine.sharedSnapshot();
+        return req.epoch != snapshot->epoch || req.generation > snapshot->generation;
+    }
+
+    /** Whether @p socket has a reply waiting for the open group's sync. */
+    bool holdsReplyFor(const QLocalSocket* socket) const
+    {
+        return std::any_of(m_held.cbegin(), m_held.cend(),
+                           [socket](const HeldReply& h) { return h.socket.data() == socket; });
+    }
+
+    /**
+     * Answers every complete request in @p pending, in order; clients may pipeline. A socket
+     * with a bulk job running is parked: its later frames wait in the buffer until the job's
+     * reply has gone out.
+     */
+    void readRequests(QLocalSocket* socket, const std::shared_ptr<QByteArray>& pending)
+    {
+        if (m_subscribers.contains(socket)) {
+            socket->readAll();  // a subscription only listens
+            return;
+        }
+        QByteArray& buffer = *pending;
+        buffer += socket->readAll();
+        if (m_busy.contains(socket)) {
+            return;
+        }
+        PolicyProtocol::Frame frame;
+        QString err;
+        while (PolicyProtocol::takeFrame(buffer, &frame, &err)) {
+            PolicyProtocol::Request req;
+            PolicyProtocol::Reply reply;
+            if (!PolicyProtocol::decodeRequest(frame.payload, &req)) {
+                reply.error = QStringLiteral("invalid request");
+            } else if (frame.type == PolicyProtocol::FrameType::Subscribe) {
+                buffer.clear();
+                subscribe(socket, req);
+                break;
+            } else if (isBulk(frame.type)) {
+                commitGroup();  // earlier replies go out first
+                startJob(socket, pending, frame.type, req);
+                break;
+            } else if (frame.type == PolicyProtocol::FrameType::Changes && isFullResync(req)) {
+                if (holdsReplyFor(socket)) {
+                    commitGroup();
+                }
+                startJob(socket, pending, frame.type, req);
+                break;
+            } else if (isMutation(frame.type)) {
+                if (m_held.empty()) {
+                    m_engine.beginGroupCommit();
+                    m_groupTimer.start();
+                }
+                reply = dispatch(frame.type, req);
+                reply.id = req.id;
+                m_held.push_back({socket, reply, true});
+                if (++m_groupMutations >= kMaxGroupMutations) {
+                    commitGroup();
+                }
+                continue;
+            } else {
+                reply = dispatch(frame.type, req);
             }
-            return r;
+            reply.id = req.id;
+            if (holdsReplyFor(socket)) {
+                m_held.push_back({socket, reply, false});  // keeps this client's replies in order
+                continue;
+            }
+            socket->write(PolicyProtocol::encodeFrame(PolicyProtocol::FrameType::Reply,
+                                                      PolicyProtocol::encodeReply(reply)));
+        }
+        if (!err.isEmpty()) {
+            // The stream cannot be resynchronised after a bad header.
+            commitGroup();
+            PolicyProtocol::Reply reply;
+            reply.error = err;
+            socket->write(PolicyProtocol::encodeFrame(PolicyProtocol::FrameType::Reply,
+                                                      PolicyProtocol::encodeReply(reply)));
+        }
+        socket->flush();
+        if (!err.isEmpty()) {
+            socket->disconnectFromServer();
         }
+    }
 
-        if (op == QLatin1String("snapshot")) {
-            const PolicySnapshot snap = m_engine.snapshot();
-            QJsonArray devices;
-            for (const DeviceRecord& rec : snap.devices) {
-                devices.append(rec.toJson());
+    /** Syncs the open group, then sends its held replies and the subscriber events. */
+    void commitGroup()
+    {
+        m_groupTimer.stop();
+        if (m_held.empty()) {
+            return;
+        }
+        const bool durable = m_engine.commitGroup();
+        bool mutated = false;
+        std::vector<HeldReply> held;
+        held.swap(m_held);
+        m_groupMutations = 0;
+        for (HeldReply& h : held) {
+            if (h.mutation && h.reply.ok) {
+                mutated = true;
+                if (!durable) {
+                    h.reply.ok = false;
+                    h.reply.error = QStringLiteral("policy store not persisted");
+                }
             }
-            QJsonArray blocks;
-            for (const BlockedDriveEntry& e : snap.blocks) {
-                QJsonObject o;
-                o[QStringLiteral("drive_key")] = e.driveKey;
-                o[QStringLiteral("unique_id")] = e.uniqueId;
-                o[QStringLiteral("label")] = e.label;
-                o[QStringLiteral("blocked_at")] = e.blockedAt.toString(Qt::ISODate);
-                blocks.append(o);
+            if (h.socket) {
+                h.socket->write(PolicyProtocol::encodeFrame(PolicyProtocol::FrameType::Reply,
+                                                            PolicyProtocol::encodeReply(h.reply)));
+                h.socket->flush();
             }
-            return {{QStringLiteral("ok"), true},
-                    {QStringLiteral("devices"), devices},
-                    {QStringLiteral("blocks"), blocks}};
         }
+        if (mutated) {
+            notifySubscribers();
+        }
+    }
 
-        if (op == QLatin1String("upsert_device")) {
-            DeviceRecord rec = DeviceRecord::fromJson(req[QStringLiteral("record")].toObject());
-            return {{QStringLiteral("ok"),
-                     m_engine.upsertDevice(rec, actor, req[QStringLiteral("reason")].toString())}};
+    void startJob(QLocalSocket* socket, const std::shared_ptr<QByteArray>& pending,
+                  PolicyProtocol::FrameType type, const PolicyProtocol::Request& req)
+    {
+        m_busy.insert(socket);
+        QPointer<QLocalSocket> guard(socket);
+        m_jobs.start([this, guard, socket, pending, type, req]() {
+            PolicyProtocol::Reply reply = dispatch(type, req);
+            reply.id = req.id;
+            const QByteArray frame = PolicyProtocol::encodeFrame(PolicyProtocol::FrameType::Reply,
+                                                                 PolicyProtocol::encodeReply(reply));
+            QMetaObject::invokeMethod(
+                this, [this, guard, socket, pending, type, frame]() {
+                    m_busy.remove(socket);
+                    if (type == PolicyProtocol::FrameType::ImportJson) {
+                        notifySubscribers();
+                    }
+                    if (!guard) {
+                        return;
+                    }
+                    guard->write(frame);
+                    readRequests(guard, pending);  // frames that arrived meanwhile
+                },
+                Qt::QueuedConnection);
+        });
+    }
+
+    void subscribe(QLocalSocket* socket, const PolicyProtocol::Request& req)
+    {
+        connect(socket, &QLocalSocket::disconnected, this,
+                [this, socket]() { m_subscribers.remove(socket); });
+        if (!isFullResync(req)) {
+            m_subscribers.insert(socket, {req.epoch, req.generation});
+            pushChanges(socket, m_subscribers[socket], true);  // tells the client its base
+            return;
         }
+        // The full first event is built on the pool; the subscription starts when it has
+        // been sent, and a catch-up push covers commits made in between.
+        m_busy.insert(socket);
+        QPointer<QLocalSocket> guard(socket);
+        m_jobs.start([this, guard, socket, req]() {
+            PolicyProtocol::Reply event = okReply(true);
+            event.hasDelta = true;
+            event.delta = m_engine.changesSince(req.epoch, req.generation);
+            const Cursor cursor{event.delta.epoch, event.delta.generation};
+            const QByteArray frame = PolicyProtocol::encodeFrame(PolicyProtocol::FrameType::Event,
+                                                                 PolicyProtocol::encodeReply(event));
+            QMetaObject::invokeMethod(
+                this, [this, guard, socket, cursor, frame]() {
+                    m_busy.remove(socket);
+                    if (!guard) {
+                        return;
+                    }
+                    guard->write(frame);
+                    guard->flush();
+                    Cursor& subscribed = m_subscribers[socket];
+                    subscribed = cursor;
+                    pushChanges(socket, subscribed, false);
+                },
+                Qt::QueuedConnection);
+        });
+    }
 
-        if (op == QLatin1String("remove_device")) {
-            return {{QStringLiteral("ok"),
-                     m_engine.removeDevice(req[QStringLiteral("unique_id")].toString(), actor,
-                                           req[QStringLiteral("reason")].toString())}};
+    /** Local subscribers and replication followers; the latter pass changes down the fleet. */
+    void notifySubscribers()
+    {
+        for (auto it = m_subscribers.begin(); it != m_subscribers.end(); ++it) {
+            pushChanges(it.key(), it.value(), false);
+        }
+        if (m_replicator) {
+            m_replicator->notify();
         }
+    }
 
-        if (op == QLatin1String("clear_devices")) {
-            return {{QStringLiteral("ok"),
-                     m_engine.clearDevices(actor, req[QStringLiteral("reason")].toString())}};
+    void pushChanges(QLocalSocket* socket, Cursor& cursor, bool evenIfEmpty)
+    {
+        PolicyProtocol::Reply event = okReply(true);
+        event.hasDelta = true;
+        event.delta = m_engine.changesSince(cursor.epoch, cursor.generation);
+        if (!evenIfEmpty && event.delta.isEmpty()) {
+            return;
         }
+        cursor = {event.delta.epoch, event.delta.generation};
+        socket->write(PolicyProtocol::encodeFrame(PolicyProtocol::FrameType::Event,
+                                                  PolicyProtocol::encodeReply(event)));
+        socket->flush();
+    }
+
+    static PolicyProtocol::Reply okReply(bool ok)
+    {
+        PolicyProtocol::Reply r;
+        r.ok = ok;
+        return r;
+    }
 
-        if (op == QLatin1String("block_drive")) {
-            return {{QStringLiteral("ok"),
-                     m_engine.blockDrive(req[QStringLiteral("drive_key")].toString(),
-                                         req[QStringLiteral("unique_id")].toString(),
-                                         req[QStringLiteral("label")].toString(), actor)}};
+    PolicyProtocol::Reply dispatch(PolicyProtocol::FrameType type, const PolicyProtocol::Request& req)
+    {
+        using PolicyProtocol::FrameType;
+        const QString actor = req.actor.isEmpty() ? QStringLiteral("policyd") : req.actor;
+
+        switch (type) {
+        case FrameType::Ping:
+            return okReply(true);
+
+        case FrameType::Load:
+        case FrameType::Reload: {
+            PolicyProtocol::Reply r;
+            r.ok = m_engine.load(&r.error);
+            return r;
         }
 
-        if (op == QLatin1String("unblock_drive")) {
-            return {{QStringLiteral("ok"),
-                     m_engine.unblockDrive(req[QStringLiteral("drive_key")].toString(),
-                                           req[QStringLiteral("unique_id")].toString(), actor)}};
+        case FrameType::Changes: {
+            PolicyProtocol::Reply r = okReply(true);
+            r.hasDelta = true;
+            r.delta = m_engine.changesSince(req.epoch, req.generation);
+            return r;
         }
 
-        if (op == QLatin1String("export_json")) {
-            const PolicySnapshot snap = m_engine.snapshot();
-            QJsonArray arr;
-            for (const DeviceRecord& rec : snap.devices) {
-                arr.append(rec.toJson());
-            }
-            QJsonObject root;
-            root[QStringLiteral("version")] = QStringLiteral("1.0");
-            root[QStringLiteral("devices")] = arr;
-            QFile f(req[QStringLiteral("path")].toString());
-            const bool ok = f.open(QIODevice::WriteOnly | QIODevice::Truncate)
-                && f.write(QJsonDocument(root).toJson(
-                       req[QStringLiteral("pretty")].toBool() ? QJsonDocument::Indented
-                                                              : QJsonDocument::Compact))
-                       >= 0;
-            return {{QStringLiteral("ok"), ok}};
-        }
-
-        if (op == QLatin1String("import_json")) {
-            QFile f(req[QStringLiteral("path")].toString());
-            QJsonObject r{{QStringLiteral("ok"), false}};
-            if (!f.open(QIODevice::ReadOnly)) {
-                r[QStringLiteral("error")] = QStringLiteral("cannot open import");
-                return r;
-            }
-            const QJsonArray arr =
-                QJsonDocument::fromJson(f.readAll()).object()[QStringLiteral("devices")].toArray();
-            if (!req[QStringLiteral("merge")].toBool()) {
-                m_engine.clearDevices(actor, QStringLiteral("import replace"));
-            }
-            int count = 0;
-            for (const QJsonValue& v : arr) {
-                if (!v.isObject()) {
-                    continue;
-                }
-                DeviceRecord rec = DeviceRecord::fromJson(v.toObject());
-                if (!rec.uniqueId.isEmpty()
-                    && m_engine.upsertDevice(rec, actor, QStringLiteral("import"))) {
-                    ++count;
-                }
-            }
-            return {{QStringLiteral("ok"), true}, {QStringLiteral("count"), count}};
+        case FrameType::UpsertDevice:
+            return okReply(req.hasRecord && m_engine.upsertDevice(req.record, actor, req.reason));
+
+        case FrameType::RemoveDevice:
+            return okReply(m_engine.removeDevice(req.uniqueId, actor, req.reason));
+
+        case FrameType::UpsertMany:
+            return okReply(m_engine.upsertDevices(req.records, actor, req.reason));
+
+        case FrameType::RemoveMany: {
+            PolicyProtocol::Reply r;
+            r.count = m_engine.removeDevices(req.uniqueIds, actor, req.reason);
+            r.ok = r.count >= 0;
+            return r;
         }
 
-        return {{QStringLiteral("ok"), false},
-                {QStringLiteral("error"), QStringLiteral("unknown op: %1").arg(op)}};
+        case FrameType::ClearDevices:
+            return okReply(m_engine.clearDevices(actor, req.reason));
+
+        case FrameType::BlockDrive:
+            return okReply(m_engine.blockDrive(req.driveKey, req.uniqueId, req.label, actor));
+
+        case FrameType::UnblockDrive:
+            return okReply(m_engine.unblockDrive(req.driveKey, req.uniqueId, actor));
+
+        case FrameType::ExportJson: {
+            PolicyProtocol::Reply r;
+            r.ok = PolicyJsonStream::write(req.path, m_engine.sharedSnapshot()->devices, req.flag,
+                                           &r.error);
+            return r;
+        }
+
+        case FrameType::ImportJson: {
+            PolicyProtocol::Reply r;
+            r.count = PolicyJsonStream::importInto(m_engine, req.path, req.flag, actor, &r.error);
+            r.ok = r.count >= 0;
+            return r;
+        }
+
+        case FrameType::Reply:
+        case FrameType::Subscribe:
+        case FrameType::Event:
+        case FrameType::FetchManifests:
+        case FrameType::Manifest:
+            break;
+        }
+
+        PolicyProtocol::Reply r;
+        r.error = QStringLiteral("unknown op: %1").arg(int(type));
+        return r;
     }
 
     QLocalServer m_server;
     PolicyStoreEngine m_engine;
+    QHash<QLocalSocket*, Cursor> m_subscribers;
+    QTimer m_groupTimer;
+    std::vector<HeldReply> m_held;
+    int m_groupMutations = 0;
+    QSet<QLocalSocket*> m_busy;
+    std::unique_ptr<PolicyReplicator> m_replicator;
+    QThreadPool m_jobs;  // last: waits for running jobs before the engine goes
 };
 
 int main(int argc, char* argv[])
 {
     QCoreApplication app(argc, argv);
     app.setApplicationName(QStringLiteral("flashspartan-policyd"));
+    // The daemon has no command line of its own; the GUI's environment reaches it. It is
+    // usually stopped by a signal, so the trace and metrics are rewritten every few seconds.
+    const QString tracePath = qEnvironmentVariable("FLASHSPARTAN_POLICYD_TRACE");
+    const QString metricsPath = qEnvironmentVariable("FLASHSPARTAN_POLICYD_METRICS");
+    PerfTrace::setEnabled(!tracePath.isEmpty());
+    QTimer traceTimer;
+    if (!tracePath.isEmpty() || !metricsPath.isEmpty()) {
+        QObject::connect(&traceTimer, &QTimer::timeout, [&tracePath, &metricsPath] {
+            if (!tracePath.isEmpty()) {
+                PerfTrace::writeTo(tracePath);
+            }
+            if (!metricsPath.isEmpty()) {
+                PerfMetrics::writeTo(metricsPath);
+            }
+        });
+        traceTimer.start(5000);
+    }
 
     PolicyDaemonServer server;
     QString err;
@@ -204,10 +497,20 @@ int main(int argc, char* argv[])
         qCritical() << "policyd: listen failed:" << err;
         return 1;
     }
+    server.load();
+    server.startReplication();
 
     PolicyAudit::append(QStringLiteral("policyd"), QStringLiteral("start"), QStringLiteral("*"),
                         PolicyPaths::socketPath());
-    return app.exec();
+    const int result = app.exec();
+    AuditWriter::flushAll();
+    if (!tracePath.isEmpty() && !PerfTrace::writeTo(tracePath)) {
+        qWarning() << "policyd: could not write the trace to" << tracePath;
+    }
+    if (!metricsPath.isEmpty() && !PerfMetrics::writeTo(metricsPath)) {
+        qWarning() << "policyd: could not write metrics to" << metricsPath;
+    }
+    return result;
 }
 
 #include "flashspartan-policyd.moc"
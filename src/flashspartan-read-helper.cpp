@@ -1,9 +1,24 @@
 /**
  * Polkit-privileged helper for raw USB block device reads.
  * Invoked via: pkexec /usr/lib/flashspartan/flashspartan-read-helper hash <dev> <algo> <buffer_kb> <mmap>
+ *             (<algo>: SHA256, SHA512, BLAKE2b, BLAKE3 or XXH3-128)
+ *             [--io-engine default|io_uring] [--queue-depth N]
  * Prints one JSON line to stdout.
+ *
+ *         or: pkexec .../flashspartan-read-helper hash --stream   (Linux)
+ *                 [--session <max_devices> <max_seconds>]
+ * Reads one HelperProtocol Job frame from stdin and streams Progress/Block frames and a
+ * Result frame to stdout. A Cancel frame or EOF on stdin cancels the job. An OpenDevice
+ * frame instead gets the validated read-only device fd back over SCM_RIGHTS. With --session
+ * the helper keeps taking jobs for up to max_devices devices and max_seconds (capped at 32
+ * and 30 min), and exits after 120 s without a job or on EOF.
+ *
+ * Either way only removable or USB-attached disks and their partitions are opened, never
+ * the disk the root filesystem is on, judged on the opened descriptor
+ * (RawDeviceHash::openHelperDevice).
  */
 
+#include "HelperProtocol.h"
 #include "RawDeviceHash.h"
 
 #include <QCoreApplication>
@@ -12,10 +27,23 @@
 #include <QJsonObject>
 #include <QTextStream>
 #include <QElapsedTimer>
+#include <QSet>
 
 #include <cerrno>
 #include <cstring>
 
+#ifndef Q_OS_WIN
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
+
 using namespace FlashSpartan;
 
 static void printResult(const HashResult& result, qint64 durationMs)
@@ -26,7 +54,10 @@ static void printResult(const HashResult& result, qint64 durationMs)
         obj[QStringLiteral("hash")] = result.hash;
         obj[QStringLiteral("algorithm")] = result.algorithm;
         obj[QStringLiteral("bytes")] = static_cast<double>(result.bytesProcessed);
+        obj[QStringLiteral("read_stall_ms")] = static_cast<double>(result.readStallMs);
+        obj[QStringLiteral("hash_stall_ms")] = static_cast<double>(result.hashStallMs);
         obj[QStringLiteral("duration_ms")] = durationMs;
+        obj[QStringLiteral("perf")] = result.performance.toJson();
     } else {
         obj[QStringLiteral("success")] = false;
         obj[QStringLiteral("error")] = result.errorMessage;
@@ -37,6 +68,322 @@ static void printResult(const HashResult& result, qint64 durationMs)
     out.flush();
 }
 
+#ifndef Q_OS_WIN
+namespace {
+
+std::mutex g_writeMutex;
+std::atomic<bool> g_cancelled{false};
+
+bool writeAll(int fd, const QByteArray& data)
+{
+    qsizetype written = 0;
+    while (written < data.size()) {
+        const ssize_t n = write(fd, data.constData() + written,
+                                static_cast<size_t>(data.size() - written));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        written += n;
+    }
+    return true;
+}
+
+void sendFrame(HelperProtocol::FrameType type, const QByteArray& payload = {})
+{
+    std::lock_guard<std::mutex> lock(g_writeMutex);
+    writeAll(STDOUT_FILENO, HelperProtocol::encodeFrame(type, payload));
+}
+
+/** A DeviceFd frame with @p fd as SCM_RIGHTS on its first byte; needs a socket on stdout. */
+bool sendDeviceFd(int fd)
+{
+    const QByteArray frame = HelperProtocol::encodeFrame(HelperProtocol::FrameType::DeviceFd,
+                                                         HelperProtocol::encodeDeviceFd(QString()));
+    std::lock_guard<std::mutex> lock(g_writeMutex);
+
+    iovec iov{const_cast<char*>(frame.constData()), 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+    ssize_t n = -1;
+    do {
+        n = sendmsg(STDOUT_FILENO, &msg, MSG_NOSIGNAL);
+    } while (n < 0 && errno == EINTR);
+    return n == 1 && writeAll(STDOUT_FILENO, frame.mid(1));
+}
+
+/** Blocks until a whole frame is buffered; false on EOF or a malformed stream. */
+bool readFrame(QByteArray& inbox, HelperProtocol::Frame* out)
+{
+    for (;;) {
+        QString error;
+        if (HelperProtocol::takeFrame(inbox, out, &error)) {
+            return true;
+        }
+        if (!error.isEmpty()) {
+            return false;
+        }
+        char chunk[4096];
+        const ssize_t n = read(STDIN_FILENO, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        inbox.append(chunk, n);
+    }
+}
+
+void sendResult(const HelperProtocol::JobResult& result)
+{
+    sendFrame(HelperProtocol::FrameType::Result, HelperProtocol::encodeResult(result));
+}
+
+/** Hashes the device open on @p fd (from openHelperDevice()) and closes it. */
+HelperProtocol::JobResult runJob(HelperProtocol::JobRequest job, int fd)
+{
+    std::atomic<uint64_t> processed{0};
+    std::atomic<uint64_t> total{0};
+
+    RawDeviceHash::Options options = job.options;
+    options.bufferSizeKB = RawDeviceHash::normalizedBufferSizeKB(options.bufferSizeKB);
+    options.ioQueueDepth = RawDeviceHash::normalizedIoQueueDepth(options.ioQueueDepth);
+    options.cancelled = &g_cancelled;
+    options.bytesProcessed = &processed;
+    options.totalBytes = &total;
+    if (!job.expectedBlockHashes.isEmpty()) {
+        options.expectedBlockHashes = &job.expectedBlockHashes;
+    } else {
+        options.stopAtFirstMismatch = false;
+    }
+    HashCheckpoint checkpoint = job.checkpoint;
+    if (job.useCheckpoint) {
+        checkpoint.deviceNode = options.deviceNode;
+        options.checkpointOut = &checkpoint;
+    }
+    options.blockHashed = [](uint64_t block, const QString& hex) {
+        sendFrame(HelperProtocol::FrameType::Block, HelperProtocol::encodeBlock({block, hex}));
+    };
+
+    HelperProtocol::JobResult out;
+    QElapsedTimer timer;
+    timer.start();
+
+    std::mutex doneMutex;
+    std::condition_variable doneCv;
+    bool done = false;
+    std::thread hasher([&]() {
+        HashResult r = RawDeviceHash::hashOpenFd(fd, options);
+        std::lock_guard<std::mutex> lock(doneMutex);
+        out.result = r;
+        done = true;
+        doneCv.notify_one();
+    });
+
+    {
+        std::unique_lock<std::mutex> lock(doneMutex);
+        while (!doneCv.wait_for(lock, std::chrono::milliseconds(200), [&]() { return done; })) {
+            sendFrame(HelperProtocol::FrameType::Progress,
+                      HelperProtocol::encodeProgress({processed.load(), total.load()}));
+        }
+    }
+    hasher.join();
+    RawDeviceHash::closeDevice(fd);
+
+    sendFrame(HelperProtocol::FrameType::Progress,
+              HelperProtocol::encodeProgress({processed.load(), total.load()}));
+    out.result.durationMs = static_cast<uint64_t>(timer.elapsed());
+    out.hasCheckpoint = job.useCheckpoint && checkpoint.isValid();
+    out.checkpoint = checkpoint;
+    return out;
+}
+
+struct SessionLimits {
+    int maxDevices = 1;
+    int maxSeconds = 0;  // 0 = one job, then exit
+};
+
+// Ceilings for `--session`, whatever the caller asks for: the helper runs as root.
+constexpr int kSessionMaxDevices = 32;
+constexpr int kSessionMaxSeconds = 30 * 60;
+constexpr int kSessionIdleSeconds = 120;
+
+struct PendingJob {
+    HelperProtocol::FrameType type = HelperProtocol::FrameType::Job;
+    QByteArray payload;
+    bool cancelled = false;
+};
+
+std::mutex g_queueMutex;
+std::condition_variable g_queueCv;
+std::deque<PendingJob> g_queue;
+bool g_inputClosed = false;
+
+/** Reads stdin for the whole process: queues Job/OpenDevice, routes Cancel, EOF ends it. */
+void readInput()
+{
+    QByteArray inbox;
+    HelperProtocol::Frame frame;
+    while (readFrame(inbox, &frame)) {
+        std::lock_guard<std::mutex> lock(g_queueMutex);
+        if (frame.type == HelperProtocol::FrameType::Job
+            || frame.type == HelperProtocol::FrameType::OpenDevice) {
+            g_queue.push_back({frame.type, frame.payload});
+            g_queueCv.notify_one();
+        } else if (frame.type == HelperProtocol::FrameType::Cancel) {
+            // The host sends Cancel after its Job frame, which may still be queued.
+            if (!g_queue.empty()) {
+                g_queue.back().cancelled = true;
+            } else {
+                g_cancelled.store(true);
+            }
+        }
+    }
+    std::lock_guard<std::mutex> lock(g_queueMutex);
+    g_inputClosed = true;
+    g_cancelled.store(true);
+    g_queueCv.notify_one();
+}
+
+HelperProtocol::JobResult failedJob(const QString& message)
+{
+    HelperProtocol::JobResult fail;
+    fail.result.errorMessage = message;
+    return fail;
+}
+
+int runStream(const SessionLimits& limits)
+{
+    sendFrame(HelperProtocol::FrameType::Hello, HelperProtocol::encodeHello());
+
+    // Detached: it is parked in read() when the last job finishes and goes away with the process.
+    std::thread(readInput).detach();
+
+    QElapsedTimer lifetime;
+    lifetime.start();
+    QSet<QString> devices;
+    int exitCode = 2;
+    for (;;) {
+        PendingJob next;
+        {
+            std::unique_lock<std::mutex> lock(g_queueMutex);
+            auto ready = [&]() { return !g_queue.empty() || g_inputClosed; };
+            if (limits.maxSeconds <= 0 || devices.isEmpty()) {
+                g_queueCv.wait(lock, ready);
+            } else if (!g_queueCv.wait_for(lock, std::chrono::seconds(kSessionIdleSeconds), ready)) {
+                return exitCode;
+            }
+            if (g_queue.empty()) {
+                return exitCode;
+            }
+            next = g_queue.front();
+            g_queue.pop_front();
+            g_cancelled.store(next.cancelled);
+        }
+
+        auto refusal = [&](const QString& deviceNode) -> QString {
+            if (!devices.contains(deviceNode) && devices.size() >= limits.maxDevices) {
+                return QStringLiteral("Helper session device limit reached");
+            }
+            if (limits.maxSeconds > 0 && lifetime.elapsed() >= qint64(limits.maxSeconds) * 1000) {
+                return QStringLiteral("Helper session expired");
+            }
+            return QString();
+        };
+
+        if (next.type == HelperProtocol::FrameType::OpenDevice) {
+            QString deviceNode;
+            if (!HelperProtocol::decodeOpenDevice(next.payload, &deviceNode)) {
+                sendFrame(HelperProtocol::FrameType::DeviceFd,
+                          HelperProtocol::encodeDeviceFd(QStringLiteral("Invalid open request")));
+                return 2;
+            }
+            const QString refused = refusal(deviceNode);
+            if (!refused.isEmpty()) {
+                sendFrame(HelperProtocol::FrameType::DeviceFd, HelperProtocol::encodeDeviceFd(refused));
+                return 1;
+            }
+            QString notOpened;
+            const int fd = RawDeviceHash::openHelperDevice(deviceNode, &notOpened);
+            if (fd < 0) {
+                sendFrame(HelperProtocol::FrameType::DeviceFd, HelperProtocol::encodeDeviceFd(notOpened));
+                continue;
+            }
+            if (next.cancelled) {
+                RawDeviceHash::closeDevice(fd);
+                sendFrame(HelperProtocol::FrameType::DeviceFd,
+                          HelperProtocol::encodeDeviceFd(QStringLiteral("Cancelled")));
+                continue;
+            }
+            devices.insert(deviceNode);
+            const bool passed = sendDeviceFd(fd);
+            const int savedErrno = errno;
+            RawDeviceHash::closeDevice(fd);
+            if (!passed) {
+                // Falls back to a hash job on this session.
+                sendFrame(HelperProtocol::FrameType::DeviceFd,
+                          HelperProtocol::encodeDeviceFd(
+                              QStringLiteral("Could not pass the device descriptor: %1")
+                                  .arg(QString::fromLocal8Bit(strerror(savedErrno)))));
+                continue;
+            }
+            exitCode = 0;
+            if (limits.maxSeconds <= 0) {
+                return exitCode;
+            }
+            continue;
+        }
+
+        HelperProtocol::JobRequest job;
+        if (!HelperProtocol::decodeJob(next.payload, &job)) {
+            sendResult(failedJob(QStringLiteral("Invalid job request")));
+            return 2;
+        }
+        const QString refused = refusal(job.options.deviceNode);
+        if (!refused.isEmpty()) {
+            sendResult(failedJob(refused));
+            return 1;
+        }
+        // A lengthLimit prefix or a quick sample is still a read of the device: same gate.
+        QString notOpened;
+        const int fd = RawDeviceHash::openHelperDevice(job.options.deviceNode, &notOpened);
+        if (fd < 0) {
+            HelperProtocol::JobResult fail = failedJob(notOpened);
+            fail.result.deviceNode = job.options.deviceNode;
+            sendResult(fail);
+            exitCode = 1;
+            if (limits.maxSeconds <= 0) {
+                return exitCode;
+            }
+            continue;
+        }
+        devices.insert(job.options.deviceNode);
+
+        const HelperProtocol::JobResult result = runJob(job, fd);
+        sendResult(result);
+        exitCode = result.result.success ? 0 : 1;
+        if (limits.maxSeconds <= 0) {
+            return exitCode;
+        }
+    }
+}
+
+} // namespace
+#endif
+
 int main(int argc, char* argv[])
 {
     QCoreApplication app(argc, argv);
@@ -44,6 +391,8 @@ int main(int argc, char* argv[])
 
     const QStringList args = app.arguments();
     QString outputPath;
+    QString ioEngine;
+    int queueDepth = 0;
     QStringList positional;
     for (int i = 1; i < args.size(); ++i) {
         if (args.at(i) == QStringLiteral("--output") && i + 1 < args.size()) {
@@ -51,13 +400,45 @@ int main(int argc, char* argv[])
             ++i;
             continue;
         }
+        if (args.at(i) == QStringLiteral("--io-engine") && i + 1 < args.size()) {
+            ioEngine = args.at(i + 1);
+            ++i;
+            continue;
+        }
+        if (args.at(i) == QStringLiteral("--queue-depth") && i + 1 < args.size()) {
+            queueDepth = args.at(i + 1).toInt();
+            ++i;
+            continue;
+        }
         positional.append(args.at(i));
     }
 
+    if (positional.size() >= 2 && positional.at(0) == QStringLiteral("hash")
+        && positional.at(1) == QStringLiteral("--stream")) {
+#ifndef Q_OS_WIN
+        SessionLimits limits;
+        if (positional.size() == 5 && positional.at(2) == QStringLiteral("--session")) {
+            limits.maxDevices = std::clamp(positional.at(3).toInt(), 1, kSessionMaxDevices);
+            limits.maxSeconds = std::clamp(positional.at(4).toInt(), 1, kSessionMaxSeconds);
+        } else if (positional.size() != 2) {
+            QTextStream err(stderr);
+            err << "Usage: flashspartan-read-helper hash --stream [--session <max_devices> <max_seconds>]\n";
+            return 2;
+        }
+        return runStream(limits);
+#else
+        QTextStream err(stderr);
+        err << "--stream is not supported on Windows\n";
+        return 2;
+#endif
+    }
+
     if (positional.size() != 5 || positional.at(0) != QStringLiteral("hash")) {
         QTextStream err(stderr);
         err << "Usage: flashspartan-read-helper hash <device> <algorithm> <buffer_kb> "
-               "<use_mmap 0|1> [--output path]\n";
+               "<use_mmap 0|1> [--io-engine default|io_uring] [--queue-depth N] "
+               "[--output path]\n"
+               "       flashspartan-read-helper hash --stream [--session <max_devices> <max_seconds>]\n";
         return 2;
     }
 
@@ -86,13 +467,15 @@ int main(int argc, char* argv[])
     options.algorithm = RawDeviceHash::algorithmFromName(positional.at(2));
     options.bufferSizeKB = RawDeviceHash::normalizedBufferSizeKB(requestedBufferSizeKB);
     options.useMemoryMapping = positional.at(4) != QStringLiteral("0");
+    options.ioEngine = RawDeviceHash::ioEngineFromName(ioEngine);
+    options.ioQueueDepth = RawDeviceHash::normalizedIoQueueDepth(queueDepth);
 
-    const int fd = RawDeviceHash::openDevice(options.deviceNode);
+    QString refused;
+    const int fd = RawDeviceHash::openHelperDevice(options.deviceNode, &refused);
     if (fd < 0) {
         HashResult fail;
         fail.deviceNode = options.deviceNode;
-        fail.errorMessage = QStringLiteral("Failed to open device: %1")
-                                .arg(QString::fromLocal8Bit(strerror(errno)));
+        fail.errorMessage = refused;
         printResult(fail, timer.elapsed());
         return 1;
     }
@@ -114,7 +497,10 @@ int main(int argc, char* argv[])
             obj[QStringLiteral("hash")] = result.hash;
             obj[QStringLiteral("algorithm")] = result.algorithm;
             obj[QStringLiteral("bytes")] = static_cast<double>(result.bytesProcessed);
+            obj[QStringLiteral("read_stall_ms")] = static_cast<double>(result.readStallMs);
+            obj[QStringLiteral("hash_stall_ms")] = static_cast<double>(result.hashStallMs);
             obj[QStringLiteral("duration_ms")] = static_cast<double>(timer.elapsed());
+            obj[QStringLiteral("perf")] = result.performance.toJson();
         } else {
             obj[QStringLiteral("success")] = false;
             obj[QStringLiteral("error")] = result.errorMessage;
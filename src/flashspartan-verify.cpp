@@ -0,0 +1,206 @@
+/**
+ * flashspartan-verify — image verification for scripts and CI, without the desktop app.
+ * Links only the verification core (no Widgets, udev or policy store) and streams one
+ * NDJSON line per image as it finishes; exit codes match flashspartan --verify-*.
+ * --hash-device, --build-manifest and --verify-watch cover raw partitions and watch
+ * manifests for intake scripts, with "progress" lines while they run; --verify-clones
+ * checks a duplicator's sticks against their master, and --flash writes a verified image
+ * and reads it back. --serve-mirror makes this host the site's catalog and artifact mirror.
+ */
+
+#include "IsoMirrorServer.h"
+#include "PerfMetrics.h"
+#include "PerfTrace.h"
+#include "VerifyCli.h"
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QScopeGuard>
+
+#include <iostream>
+
+using namespace FlashSpartan;
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("FlashSpartan"));
+    QCoreApplication::setOrganizationName(QStringLiteral("FlashSpartan"));
+    QCoreApplication::setOrganizationDomain(QStringLiteral("flashspartan.io"));
+#ifdef FLASHSPARTAN_VERSION
+    QCoreApplication::setApplicationVersion(QLatin1String(FLASHSPARTAN_VERSION));
+#endif
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Verify ISO and disk images; one NDJSON result per line"));
+    parser.addHelpOption();
+    parser.addVersionOption();
+    parser.addPositionalArgument(QStringLiteral("paths"), QStringLiteral("Images or directories of images"),
+                                 QStringLiteral("[paths...]"));
+
+    QCommandLineOption jobsOption({QStringLiteral("j"), QStringLiteral("jobs")},
+                                  QStringLiteral("Images verified at once (default: learned from drive throughput); "
+                                                 "devices hashed at once (default: all)"),
+                                  QStringLiteral("n"), QStringLiteral("0"));
+    QCommandLineOption filesFromOption(QStringLiteral("files-from"),
+                                       QStringLiteral("Read paths, one per line, from a file (- for stdin)"),
+                                       QStringLiteral("list"));
+    QCommandLineOption configOption({QStringLiteral("c"), QStringLiteral("config")},
+                                    QStringLiteral("FlashSpartan.conf with iso/* verify settings"),
+                                    QStringLiteral("path"));
+    QCommandLineOption hashDeviceOption(QStringLiteral("hash-device"),
+                                        QStringLiteral("Hash a raw partition instead of verifying images (repeatable)"),
+                                        QStringLiteral("node"));
+    QCommandLineOption scanModeOption(QStringLiteral("scan-mode"),
+                                      QStringLiteral("Scan mode for --hash-device: full, quick, or chunked"),
+                                      QStringLiteral("mode"), QStringLiteral("full"));
+    QCommandLineOption algorithmOption(QStringLiteral("algorithm"),
+                                       QStringLiteral("Algorithm for --hash-device, --verify-clones and --flash "
+                                                      "(SHA256, SHA512, BLAKE2b, BLAKE3, XXH3-128)"),
+                                       QStringLiteral("name"), QStringLiteral("SHA256"));
+    QCommandLineOption resumeOption(QStringLiteral("resume"),
+                                    QStringLiteral("Continue full and chunked reads from their checkpoints"));
+    QCommandLineOption tolerateOption(QStringLiteral("tolerate-bad-sectors"),
+                                      QStringLiteral("Hash unreadable or stuck sectors as zeros and list them"));
+    QCommandLineOption readTimeoutOption(QStringLiteral("read-timeout"),
+                                         QStringLiteral("Milliseconds before a --tolerate-bad-sectors read is skipped"),
+                                         QStringLiteral("ms"), QStringLiteral("0"));
+    QCommandLineOption verifyClonesOption(QStringLiteral("verify-clones"),
+                                          QStringLiteral("Compare each --clone with a master image file or device"),
+                                          QStringLiteral("master"));
+    QCommandLineOption cloneOption(QStringLiteral("clone"),
+                                   QStringLiteral("Device written from the --verify-clones master (repeatable)"),
+                                   QStringLiteral("node"));
+    QCommandLineOption flashOption(QStringLiteral("flash"),
+                                   QStringLiteral("Verify an image while writing it to the --to disk, then read it back"),
+                                   QStringLiteral("image"));
+    QCommandLineOption flashTargetOption(QStringLiteral("to"), QStringLiteral("Whole disk for --flash"),
+                                         QStringLiteral("node"));
+    QCommandLineOption allowUnverifiedOption(QStringLiteral("allow-unverified"),
+                                             QStringLiteral("--flash an image with no published or trusted hash"));
+    QCommandLineOption allowFixedDiskOption(QStringLiteral("allow-fixed-disk"),
+                                            QStringLiteral("--flash to a disk that is neither removable nor USB"));
+    QCommandLineOption buildManifestOption(QStringLiteral("build-manifest"),
+                                           QStringLiteral("Build a watch manifest of each --watch-mount from a spec"),
+                                           QStringLiteral("spec"));
+    QCommandLineOption verifyWatchOption(QStringLiteral("verify-watch"),
+                                         QStringLiteral("Verify each --watch-mount against a watch manifest"),
+                                         QStringLiteral("manifest"));
+    QCommandLineOption watchMountOption(QStringLiteral("watch-mount"),
+                                        QStringLiteral("Mount point for --build-manifest or --verify-watch (repeatable)"),
+                                        QStringLiteral("path"));
+    QCommandLineOption manifestOutOption(QStringLiteral("manifest-out"),
+                                         QStringLiteral("Output file (one mount) or directory for --build-manifest"),
+                                         QStringLiteral("path"));
+    QCommandLineOption serveMirrorOption(QStringLiteral("serve-mirror"),
+                                         QStringLiteral("Serve the catalog and publisher artifacts to this site's hosts"));
+    QCommandLineOption mirrorPortOption(QStringLiteral("mirror-port"), QStringLiteral("Port for --serve-mirror"),
+                                        QStringLiteral("port"), QString::number(IsoMirrorServer::kDefaultPort));
+    QCommandLineOption progressIntervalOption(QStringLiteral("progress-interval"),
+                                              QStringLiteral("Milliseconds between progress lines (0: none)"),
+                                              QStringLiteral("ms"), QStringLiteral("1000"));
+    QCommandLineOption traceOption(QStringLiteral("trace"),
+                                   QStringLiteral("Write hash, manifest and ISO spans as a Chrome trace on exit"),
+                                   QStringLiteral("path"));
+    QCommandLineOption metricsOption(QStringLiteral("metrics"),
+                                     QStringLiteral("Write performance counters in Prometheus text format on exit"),
+                                     QStringLiteral("path"));
+    parser.addOption(jobsOption);
+    parser.addOption(filesFromOption);
+    parser.addOption(configOption);
+    parser.addOption(hashDeviceOption);
+    parser.addOption(scanModeOption);
+    parser.addOption(algorithmOption);
+    parser.addOption(resumeOption);
+    parser.addOption(tolerateOption);
+    parser.addOption(readTimeoutOption);
+    parser.addOption(verifyClonesOption);
+    parser.addOption(cloneOption);
+    parser.addOption(flashOption);
+    parser.addOption(flashTargetOption);
+    parser.addOption(allowUnverifiedOption);
+    parser.addOption(allowFixedDiskOption);
+    parser.addOption(buildManifestOption);
+    parser.addOption(verifyWatchOption);
+    parser.addOption(watchMountOption);
+    parser.addOption(manifestOutOption);
+    parser.addOption(serveMirrorOption);
+    parser.addOption(mirrorPortOption);
+    parser.addOption(progressIntervalOption);
+    parser.addOption(traceOption);
+    parser.addOption(metricsOption);
+    parser.process(app);
+
+    const QString tracePath = parser.value(traceOption);
+    PerfTrace::setEnabled(!tracePath.isEmpty());
+    const auto traceWriter = qScopeGuard([&tracePath] {
+        if (!tracePath.isEmpty() && !PerfTrace::writeTo(tracePath)) {
+            std::cerr << "Cannot write the trace to " << tracePath.toStdString() << '\n';
+        }
+    });
+    const QString metricsPath = parser.value(metricsOption);
+    const auto metricsWriter = qScopeGuard([&metricsPath] {
+        if (!metricsPath.isEmpty() && !PerfMetrics::writeTo(metricsPath)) {
+            std::cerr << "Cannot write the metrics to " << metricsPath.toStdString() << '\n';
+        }
+    });
+
+    if (parser.isSet(configOption)) {
+        VerifyCli::setConfigFilePath(parser.value(configOption));
+    }
+    VerifyCli::setJsonOutput(true);
+
+    bool jobsOk = false;
+    const int jobs = parser.value(jobsOption).toInt(&jobsOk);
+    if (!jobsOk || jobs < 0) {
+        std::cerr << "--jobs needs a non-negative number\n";
+        return VerifyCli::ExitError;
+    }
+    VerifyCli::setProgressInterval(parser.value(progressIntervalOption).toInt());
+
+    if (parser.isSet(serveMirrorOption)) {
+        bool portOk = false;
+        const uint port = parser.value(mirrorPortOption).toUInt(&portOk);
+        if (!portOk || port == 0 || port > 65535) {
+            std::cerr << "--mirror-port needs a port number\n";
+            return VerifyCli::ExitError;
+        }
+        return VerifyCli::runServeMirror(static_cast<quint16>(port));
+    }
+    if (parser.isSet(hashDeviceOption)) {
+        return VerifyCli::runHashDevices(parser.values(hashDeviceOption), parser.value(scanModeOption),
+                                         parser.value(algorithmOption), parser.isSet(resumeOption), jobs,
+                                         parser.isSet(tolerateOption), parser.value(readTimeoutOption).toInt());
+    }
+    if (parser.isSet(verifyClonesOption)) {
+        return VerifyCli::runVerifyClones(parser.value(verifyClonesOption), parser.values(cloneOption),
+                                          parser.value(algorithmOption), jobs);
+    }
+    if (parser.isSet(flashOption)) {
+        return VerifyCli::runFlashImage(parser.value(flashOption), parser.value(flashTargetOption),
+                                        parser.value(algorithmOption), parser.isSet(allowUnverifiedOption),
+                                        parser.isSet(allowFixedDiskOption));
+    }
+    if (parser.isSet(buildManifestOption)) {
+        return VerifyCli::runBuildManifest(parser.value(buildManifestOption), parser.values(watchMountOption),
+                                           parser.value(manifestOutOption));
+    }
+    if (parser.isSet(verifyWatchOption)) {
+        return VerifyCli::runVerifyWatch(parser.value(verifyWatchOption), parser.values(watchMountOption));
+    }
+
+    QStringList inputs = parser.positionalArguments();
+    if (parser.isSet(filesFromOption)) {
+        bool ok = false;
+        inputs += VerifyCli::readPathList(parser.value(filesFromOption), &ok);
+        if (!ok) {
+            std::cerr << "Cannot read " << parser.value(filesFromOption).toStdString() << '\n';
+            return VerifyCli::ExitError;
+        }
+    }
+    if (inputs.isEmpty()) {
+        parser.showHelp(VerifyCli::ExitError);
+    }
+    return VerifyCli::runVerifyBatch(inputs, jobs);
+}
@@ -0,0 +1,146 @@
+#include "ImageStreamDecoder.h"
+
+#ifdef HAS_ZLIB
+
+#include <QByteArray>
+#include <QFile>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <climits>
+
+namespace FlashSpartan {
+namespace ImageDecoders {
+
+namespace {
+
+constexpr qint64 kInputBufferBytes = 1024 * 1024;
+constexpr int kGzipWindowBits = 15 + 16;  // gzip header and trailer, no zlib/raw autodetect
+
+class GzipDecoder final : public StreamDecoder {
+public:
+    explicit GzipDecoder(const QString& path) : m_file(path), m_input(kInputBufferBytes, Qt::Uninitialized) {}
+    ~GzipDecoder() override
+    {
+        if (m_initialized) {
+            inflateEnd(&m_stream);
+        }
+    }
+
+    bool open(QString* error)
+    {
+        if (!m_file.open(QIODevice::ReadOnly)) {
+            *error = QStringLiteral("Cannot open file: %1").arg(m_file.errorString());
+            return false;
+        }
+        if (inflateInit2(&m_stream, kGzipWindowBits) != Z_OK) {
+            *error = QStringLiteral("gzip decoder initialization failed");
+            return false;
+        }
+        m_initialized = true;
+        return true;
+    }
+
+    int64_t read(char* buffer, size_t capacity, QString* error) override
+    {
+        m_stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        m_stream.avail_out = static_cast<uInt>(std::min<size_t>(capacity, UINT_MAX));
+        const uInt requested = m_stream.avail_out;
+        while (m_stream.avail_out > 0) {
+            if (m_stream.avail_in == 0) {
+                if (m_eof) {
+                    break;
+                }
+                const qint64 n = m_file.read(m_input.data(), m_input.size());
+                if (n < 0) {
+                    *error = QStringLiteral("Read error: %1").arg(m_file.errorString());
+                    return -1;
+                }
+                m_stream.next_in = reinterpret_cast<Bytef*>(m_input.data());
+                m_stream.avail_in = static_cast<uInt>(n);
+                if (n == 0) {
+                    m_eof = true;
+                    break;
+                }
+            }
+            if (m_memberEnded) {
+                // More bytes after a complete member: `cat a.gz b.gz` is one gzip file.
+                inflateReset(&m_stream);
+                m_memberEnded = false;
+            }
+            const int ret = inflate(&m_stream, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) {
+                m_memberEnded = true;
+                continue;
+            }
+            if (ret != Z_OK) {
+                *error = ret == Z_MEM_ERROR
+                             ? QStringLiteral("gzip decompress failed: out of memory")
+                             : QStringLiteral("gzip decompress failed: %1")
+                                   .arg(QString::fromUtf8(m_stream.msg ? m_stream.msg : "corrupt data"));
+                return -1;
+            }
+        }
+        const int64_t produced = static_cast<int64_t>(requested - m_stream.avail_out);
+        if (produced == 0 && m_eof && !m_memberEnded) {
+            *error = QStringLiteral("gzip decompress failed: file is truncated");
+            return -1;
+        }
+        return produced;
+    }
+
+private:
+    QFile m_file;
+    QByteArray m_input;
+    z_stream m_stream{};
+    bool m_initialized = false;
+    bool m_eof = false;
+    bool m_memberEnded = false;
+};
+
+} // namespace
+
+bool gzipAvailable()
+{
+    return true;
+}
+
+std::unique_ptr<StreamDecoder> openGzip(const QString& path, QString* error)
+{
+    auto decoder = std::make_unique<GzipDecoder>(path);
+    QString err;
+    if (!decoder->open(&err)) {
+        if (error) {
+            *error = err;
+        }
+        return nullptr;
+    }
+    return decoder;
+}
+
+} // namespace ImageDecoders
+} // namespace FlashSpartan
+
+#else
+
+namespace FlashSpartan {
+namespace ImageDecoders {
+
+bool gzipAvailable()
+{
+    return false;
+}
+
+std::unique_ptr<StreamDecoder> openGzip(const QString& /*path*/, QString* error)
+{
+    if (error) {
+        *error = QStringLiteral("Built without zlib");
+    }
+    return nullptr;
+}
+
+} // namespace ImageDecoders
+} // namespace FlashSpartan
+
+#endif
@@ -0,0 +1,160 @@
+#include "ImageStreamDecoder.h"
+
+#ifdef HAS_LIBLZMA
+
+#include <QByteArray>
+#include <QFile>
+#include <QThread>
+
+#include <lzma.h>
+
+#include <algorithm>
+
+namespace FlashSpartan {
+namespace ImageDecoders {
+
+namespace {
+
+constexpr qint64 kInputBufferBytes = 1024 * 1024;
+constexpr uint32_t kMaxDecoderThreads = 8;
+
+lzma_ret initDecoder(lzma_stream* stream)
+{
+#if LZMA_VERSION >= 50040002
+    // Falls back to single-threaded decoding by itself when block sizes are not recorded.
+    lzma_mt mt{};
+    mt.flags = LZMA_CONCATENATED;
+    mt.threads = std::clamp<uint32_t>(static_cast<uint32_t>(QThread::idealThreadCount()), 1,
+                                      kMaxDecoderThreads);
+    const uint64_t physmem = lzma_physmem();
+    mt.memlimit_threading = physmem > 0 ? physmem / 4 : 1024ULL * 1024 * 1024;
+    mt.memlimit_stop = UINT64_MAX;
+    return lzma_stream_decoder_mt(stream, &mt);
+#else
+    return lzma_stream_decoder(stream, UINT64_MAX, LZMA_CONCATENATED);
+#endif
+}
+
+QString lzmaErrorText(lzma_ret ret)
+{
+    switch (ret) {
+    case LZMA_MEM_ERROR:
+        return QStringLiteral("xz decompress failed: out of memory");
+    case LZMA_FORMAT_ERROR:
+        return QStringLiteral("xz decompress failed: not an xz file");
+    case LZMA_OPTIONS_ERROR:
+        return QStringLiteral("xz decompress failed: unsupported options");
+    case LZMA_DATA_ERROR:
+        return QStringLiteral("xz decompress failed: corrupt data");
+    case LZMA_BUF_ERROR:
+        return QStringLiteral("xz decompress failed: file is truncated");
+    default:
+        return QStringLiteral("xz decompress failed (liblzma error %1)").arg(static_cast<int>(ret));
+    }
+}
+
+class XzDecoder final : public StreamDecoder {
+public:
+    explicit XzDecoder(const QString& path) : m_file(path), m_input(kInputBufferBytes, Qt::Uninitialized) {}
+    ~XzDecoder() override { lzma_end(&m_stream); }
+
+    bool open(QString* error)
+    {
+        if (!m_file.open(QIODevice::ReadOnly)) {
+            *error = QStringLiteral("Cannot open file: %1").arg(m_file.errorString());
+            return false;
+        }
+        const lzma_ret ret = initDecoder(&m_stream);
+        if (ret != LZMA_OK) {
+            *error = lzmaErrorText(ret);
+            return false;
+        }
+        return true;
+    }
+
+    int64_t read(char* buffer, size_t capacity, QString* error) override
+    {
+        if (m_ended) {
+            return 0;
+        }
+        m_stream.next_out = reinterpret_cast<uint8_t*>(buffer);
+        m_stream.avail_out = capacity;
+        while (m_stream.avail_out > 0) {
+            if (m_stream.avail_in == 0 && m_action == LZMA_RUN) {
+                const qint64 n = m_file.read(m_input.data(), m_input.size());
+                if (n < 0) {
+                    *error = QStringLiteral("Read error: %1").arg(m_file.errorString());
+                    return -1;
+                }
+                m_stream.next_in = reinterpret_cast<const uint8_t*>(m_input.constData());
+                m_stream.avail_in = static_cast<size_t>(n);
+                if (n == 0) {
+                    m_action = LZMA_FINISH;
+                }
+            }
+            const lzma_ret ret = lzma_code(&m_stream, m_action);
+            if (ret == LZMA_STREAM_END) {
+                m_ended = true;
+                break;
+            }
+            if (ret != LZMA_OK) {
+                *error = lzmaErrorText(ret);
+                return -1;
+            }
+        }
+        return static_cast<int64_t>(capacity - m_stream.avail_out);
+    }
+
+private:
+    QFile m_file;
+    QByteArray m_input;
+    lzma_stream m_stream = LZMA_STREAM_INIT;
+    lzma_action m_action = LZMA_RUN;
+    bool m_ended = false;
+};
+
+} // namespace
+
+bool xzAvailable()
+{
+    return true;
+}
+
+std::unique_ptr<StreamDecoder> openXz(const QString& path, QString* error)
+{
+    auto decoder = std::make_unique<XzDecoder>(path);
+    QString err;
+    if (!decoder->open(&err)) {
+        if (error) {
+            *error = err;
+        }
+        return nullptr;
+    }
+    return decoder;
+}
+
+} // namespace ImageDecoders
+} // namespace FlashSpartan
+
+#else
+
+namespace FlashSpartan {
+namespace ImageDecoders {
+
+bool xzAvailable()
+{
+    return false;
+}
+
+std::unique_ptr<StreamDecoder> openXz(const QString& /*path*/, QString* error)
+{
+    if (error) {
+        *error = QStringLiteral("Built without liblzma");
+    }
+    return nullptr;
+}
+
+} // namespace ImageDecoders
+} // namespace FlashSpartan
+
+#endif
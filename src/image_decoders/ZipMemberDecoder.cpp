@@ -0,0 +1,380 @@
+#include "ImageStreamDecoder.h"
+
+#ifdef HAS_ZLIB
+
+#include <QByteArray>
+#include <QFile>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <climits>
+
+namespace FlashSpartan {
+namespace ImageDecoders {
+
+namespace {
+
+constexpr qint64 kInputBufferBytes = 1024 * 1024;
+constexpr qint64 kEocdSize = 22;
+constexpr qint64 kMaxCommentSize = 0xFFFF;
+constexpr qint64 kMaxCentralDirectoryBytes = 16 * 1024 * 1024;
+constexpr quint32 kEocdSignature = 0x06054b50;
+constexpr quint32 kZip64LocatorSignature = 0x07064b50;
+constexpr quint32 kZip64EocdSignature = 0x06064b50;
+constexpr quint32 kCentralSignature = 0x02014b50;
+constexpr quint32 kLocalSignature = 0x04034b50;
+constexpr quint16 kZip64ExtraId = 0x0001;
+constexpr quint16 kMethodStored = 0;
+constexpr quint16 kMethodDeflate = 8;
+
+quint16 le16(const QByteArray& b, qint64 at)
+{
+    const auto* p = reinterpret_cast<const uchar*>(b.constData()) + at;
+    return static_cast<quint16>(p[0] | (p[1] << 8));
+}
+
+quint32 le32(const QByteArray& b, qint64 at)
+{
+    return le16(b, at) | (static_cast<quint32>(le16(b, at + 2)) << 16);
+}
+
+quint64 le64(const QByteArray& b, qint64 at)
+{
+    return le32(b, at) | (static_cast<quint64>(le32(b, at + 4)) << 32);
+}
+
+struct Member {
+    QString name;
+    quint16 method = 0;
+    quint16 flags = 0;
+    quint32 crc = 0;
+    quint64 compressedSize = 0;
+    quint64 size = 0;
+    quint64 localHeaderOffset = 0;
+};
+
+bool isImageName(const QString& name)
+{
+    return !name.endsWith(QLatin1Char('/'))
+           && (name.endsWith(QStringLiteral(".img"), Qt::CaseInsensitive)
+               || name.endsWith(QStringLiteral(".iso"), Qt::CaseInsensitive));
+}
+
+QByteArray readAt(QFile& file, qint64 offset, qint64 length)
+{
+    if (offset < 0 || length < 0 || !file.seek(offset)) {
+        return {};
+    }
+    const QByteArray data = file.read(length);
+    return data.size() == length ? data : QByteArray();
+}
+
+/** Central directory location from the (zip64) end record; false if this is not a zip. */
+bool findCentralDirectory(QFile& file, quint64* offset, quint64* size, QString* error)
+{
+    const qint64 fileSize = file.size();
+    const qint64 tailSize = std::min(fileSize, kEocdSize + kMaxCommentSize);
+    const QByteArray tail = readAt(file, fileSize - tailSize, tailSize);
+    qint64 eocd = -1;
+    for (qint64 i = tail.size() - kEocdSize; i >= 0; --i) {
+        if (le32(tail, i) == kEocdSignature) {
+            eocd = i;
+            break;
+        }
+    }
+    if (eocd < 0) {
+        *error = QStringLiteral("zip: end of central directory not found");
+        return false;
+    }
+    *size = le32(tail, eocd + 12);
+    *offset = le32(tail, eocd + 16);
+    if (*size != 0xFFFFFFFFu && *offset != 0xFFFFFFFFu) {
+        return true;
+    }
+    const qint64 locator = eocd - 20;
+    if (locator < 0 || le32(tail, locator) != kZip64LocatorSignature) {
+        *error = QStringLiteral("zip: zip64 locator missing");
+        return false;
+    }
+    const QByteArray record = readAt(file, static_cast<qint64>(le64(tail, locator + 8)), 56);
+    if (record.isEmpty() || le32(record, 0) != kZip64EocdSignature) {
+        *error = QStringLiteral("zip: zip64 end record missing");
+        return false;
+    }
+    *size = le64(record, 40);
+    *offset = le64(record, 48);
+    return true;
+}
+
+/** Reads 64-bit sizes from the zip64 extra field for the fields saturated at 0xFFFFFFFF. */
+void applyZip64Extra(const QByteArray& extra, Member* m, bool sizeSaturated, bool compressedSaturated,
+                     bool offsetSaturated)
+{
+    qint64 at = 0;
+    while (at + 4 <= extra.size()) {
+        const quint16 id = le16(extra, at);
+        const quint16 len = le16(extra, at + 2);
+        qint64 field = at + 4;
+        const qint64 end = field + len;
+        if (end > extra.size()) {
+            return;
+        }
+        if (id == kZip64ExtraId) {
+            if (sizeSaturated && field + 8 <= end) {
+                m->size = le64(extra, field);
+                field += 8;
+            }
+            if (compressedSaturated && field + 8 <= end) {
+                m->compressedSize = le64(extra, field);
+                field += 8;
+            }
+            if (offsetSaturated && field + 8 <= end) {
+                m->localHeaderOffset = le64(extra, field);
+            }
+            return;
+        }
+        at = end;
+    }
+}
+
+/** The largest image member; the rest of an archive (README, licences) is ignored. */
+bool pickImageMember(QFile& file, Member* out, QString* error)
+{
+    quint64 cdOffset = 0;
+    quint64 cdSize = 0;
+    if (!findCentralDirectory(file, &cdOffset, &cdSize, error)) {
+        return false;
+    }
+    if (cdSize > static_cast<quint64>(kMaxCentralDirectoryBytes)) {
+        *error = QStringLiteral("zip: central directory too large");
+        return false;
+    }
+    const QByteArray cd = readAt(file, static_cast<qint64>(cdOffset), static_cast<qint64>(cdSize));
+    if (cd.isEmpty()) {
+        *error = QStringLiteral("zip: cannot read central directory");
+        return false;
+    }
+
+    bool found = false;
+    qint64 at = 0;
+    while (at + 46 <= cd.size() && le32(cd, at) == kCentralSignature) {
+        const quint16 nameLen = le16(cd, at + 28);
+        const quint16 extraLen = le16(cd, at + 30);
+        const quint16 commentLen = le16(cd, at + 32);
+        if (at + 46 + nameLen + extraLen > cd.size()) {
+            break;
+        }
+        Member m;
+        m.flags = le16(cd, at + 8);
+        m.method = le16(cd, at + 10);
+        m.crc = le32(cd, at + 16);
+        m.compressedSize = le32(cd, at + 20);
+        m.size = le32(cd, at + 24);
+        m.localHeaderOffset = le32(cd, at + 42);
+        m.name = QString::fromUtf8(cd.constData() + at + 46, nameLen);
+        applyZip64Extra(cd.mid(at + 46 + nameLen, extraLen), &m, m.size == 0xFFFFFFFFu,
+                        m.compressedSize == 0xFFFFFFFFu, m.localHeaderOffset == 0xFFFFFFFFu);
+        if (isImageName(m.name) && (!found || m.size > out->size)) {
+            *out = m;
+            found = true;
+        }
+        at += 46 + nameLen + extraLen + commentLen;
+    }
+    if (!found) {
+        *error = QStringLiteral("zip: no .img or .iso member");
+        return false;
+    }
+    if (out->flags & 0x1) {
+        *error = QStringLiteral("zip: %1 is encrypted").arg(out->name);
+        return false;
+    }
+    if (out->method != kMethodStored && out->method != kMethodDeflate) {
+        *error = QStringLiteral("zip: %1 uses unsupported compression method %2").arg(out->name).arg(out->method);
+        return false;
+    }
+    return true;
+}
+
+class ZipMemberDecoder final : public StreamDecoder {
+public:
+    explicit ZipMemberDecoder(const QString& path) : m_file(path), m_input(kInputBufferBytes, Qt::Uninitialized) {}
+    ~ZipMemberDecoder() override
+    {
+        if (m_initialized) {
+            inflateEnd(&m_stream);
+        }
+    }
+
+    bool open(QString* error)
+    {
+        if (!m_file.open(QIODevice::ReadOnly)) {
+            *error = QStringLiteral("Cannot open file: %1").arg(m_file.errorString());
+            return false;
+        }
+        if (!pickImageMember(m_file, &m_member, error)) {
+            return false;
+        }
+        const QByteArray local = readAt(m_file, static_cast<qint64>(m_member.localHeaderOffset), 30);
+        if (local.isEmpty() || le32(local, 0) != kLocalSignature) {
+            *error = QStringLiteral("zip: bad local header for %1").arg(m_member.name);
+            return false;
+        }
+        const qint64 dataOffset =
+            static_cast<qint64>(m_member.localHeaderOffset) + 30 + le16(local, 26) + le16(local, 28);
+        if (!m_file.seek(dataOffset)) {
+            *error = QStringLiteral("zip: cannot seek to %1").arg(m_member.name);
+            return false;
+        }
+        m_remainingInput = m_member.compressedSize;
+        if (m_member.method == kMethodDeflate) {
+            if (inflateInit2(&m_stream, -MAX_WBITS) != Z_OK) {
+                *error = QStringLiteral("zip: inflate initialization failed");
+                return false;
+            }
+            m_initialized = true;
+        }
+        return true;
+    }
+
+    int64_t read(char* buffer, size_t capacity, QString* error) override
+    {
+        const int64_t produced = m_member.method == kMethodStored ? readStored(buffer, capacity, error)
+                                                                  : readDeflated(buffer, capacity, error);
+        if (produced < 0) {
+            return produced;
+        }
+        m_crc = crc32(m_crc, reinterpret_cast<const Bytef*>(buffer), static_cast<uInt>(produced));
+        m_produced += static_cast<quint64>(produced);
+        if (produced == 0) {
+            if (m_produced != m_member.size || m_crc != m_member.crc) {
+                *error = QStringLiteral("zip: %1 does not match its recorded size and CRC").arg(m_member.name);
+                return -1;
+            }
+        }
+        return produced;
+    }
+
+private:
+    qint64 fillInput(QString* error)
+    {
+        const qint64 want = static_cast<qint64>(std::min<quint64>(m_remainingInput, m_input.size()));
+        if (want == 0) {
+            return 0;
+        }
+        const qint64 n = m_file.read(m_input.data(), want);
+        if (n <= 0) {
+            *error = n < 0 ? QStringLiteral("Read error: %1").arg(m_file.errorString())
+                           : QStringLiteral("zip: %1 is truncated").arg(m_member.name);
+            return -1;
+        }
+        m_remainingInput -= static_cast<quint64>(n);
+        return n;
+    }
+
+    int64_t readStored(char* buffer, size_t capacity, QString* error)
+    {
+        const qint64 want = static_cast<qint64>(std::min<quint64>(m_remainingInput, capacity));
+        if (want == 0) {
+            return 0;
+        }
+        const qint64 n = m_file.read(buffer, want);
+        if (n <= 0) {
+            *error = n < 0 ? QStringLiteral("Read error: %1").arg(m_file.errorString())
+                           : QStringLiteral("zip: %1 is truncated").arg(m_member.name);
+            return -1;
+        }
+        m_remainingInput -= static_cast<quint64>(n);
+        return n;
+    }
+
+    int64_t readDeflated(char* buffer, size_t capacity, QString* error)
+    {
+        if (m_ended) {
+            return 0;
+        }
+        m_stream.next_out = reinterpret_cast<Bytef*>(buffer);
+        m_stream.avail_out = static_cast<uInt>(std::min<size_t>(capacity, UINT_MAX));
+        const uInt requested = m_stream.avail_out;
+        while (m_stream.avail_out > 0) {
+            if (m_stream.avail_in == 0) {
+                const qint64 n = fillInput(error);
+                if (n < 0) {
+                    return -1;
+                }
+                if (n == 0) {
+                    *error = QStringLiteral("zip: %1 is truncated").arg(m_member.name);
+                    return -1;
+                }
+                m_stream.next_in = reinterpret_cast<Bytef*>(m_input.data());
+                m_stream.avail_in = static_cast<uInt>(n);
+            }
+            const int ret = inflate(&m_stream, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) {
+                m_ended = true;
+                break;
+            }
+            if (ret != Z_OK) {
+                *error = QStringLiteral("zip: cannot inflate %1").arg(m_member.name);
+                return -1;
+            }
+        }
+        return static_cast<int64_t>(requested - m_stream.avail_out);
+    }
+
+    QFile m_file;
+    QByteArray m_input;
+    Member m_member;
+    quint64 m_remainingInput = 0;
+    quint64 m_produced = 0;
+    uLong m_crc = crc32(0L, Z_NULL, 0);
+    z_stream m_stream{};
+    bool m_initialized = false;
+    bool m_ended = false;
+};
+
+} // namespace
+
+bool zipAvailable()
+{
+    return true;
+}
+
+std::unique_ptr<StreamDecoder> openZipMember(const QString& path, QString* error)
+{
+    auto decoder = std::make_unique<ZipMemberDecoder>(path);
+    QString err;
+    if (!decoder->open(&err)) {
+        if (error) {
+            *error = err;
+        }
+        return nullptr;
+    }
+    return decoder;
+}
+
+} // namespace ImageDecoders
+} // namespace FlashSpartan
+
+#else
+
+namespace FlashSpartan {
+namespace ImageDecoders {
+
+bool zipAvailable()
+{
+    return false;
+}
+
+std::unique_ptr<StreamDecoder> openZipMember(const QString& /*path*/, QString* error)
+{
+    if (error) {
+        *error = QStringLiteral("Built without zlib");
+    }
+    return nullptr;
+}
+
+} // namespace ImageDecoders
+} // namespace FlashSpartan
+
+#endif
@@ -0,0 +1,273 @@
+#include "ImageStreamDecoder.h"
+
+#ifdef HAS_ZSTD
+
+#include <QByteArray>
+#include <QFile>
+#include <QFuture>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <zstd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+
+namespace FlashSpartan {
+namespace ImageDecoders {
+
+namespace {
+
+/** Frames up to this size (from the frame header) are decoded whole on the pool. */
+constexpr unsigned long long kMaxParallelFrameBytes = 64ULL * 1024 * 1024;
+/** Decoded-but-unhashed bytes in flight, whatever the thread count. */
+constexpr unsigned long long kMaxPendingBytes = 256ULL * 1024 * 1024;
+
+QThreadPool& decodePool()
+{
+    static QThreadPool* pool = [] {
+        auto* p = new QThreadPool;
+        p->setMaxThreadCount(std::max(1, QThread::idealThreadCount()));
+        return p;
+    }();
+    return *pool;
+}
+
+bool isSkippableFrame(const uchar* src, size_t size)
+{
+    if (size < 4) {
+        return false;
+    }
+    const quint32 magic = src[0] | (src[1] << 8) | (src[2] << 16) | (static_cast<quint32>(src[3]) << 24);
+    return (magic & ZSTD_MAGIC_SKIPPABLE_MASK) == ZSTD_MAGIC_SKIPPABLE_START;
+}
+
+struct DecodedFrame {
+    QByteArray data;
+    QString error;
+};
+
+DecodedFrame decodeFrame(const uchar* src, size_t srcSize, size_t contentSize)
+{
+    DecodedFrame out;
+    out.data = QByteArray(static_cast<qsizetype>(contentSize), Qt::Uninitialized);
+    const size_t n = ZSTD_decompress(out.data.data(), contentSize, src, srcSize);
+    if (ZSTD_isError(n)) {
+        out.error = QStringLiteral("zstd decompress failed: %1").arg(QString::fromUtf8(ZSTD_getErrorName(n)));
+    } else if (n != contentSize) {
+        out.error = QStringLiteral("zstd decompress failed: frame size mismatch");
+    }
+    return out;
+}
+
+/**
+ * Zstandard has no multi-threaded decoder, but frames are independent: zstd -T / pzstd /
+ * seekable writers emit many frames with their sizes in the header. Those are decoded ahead
+ * on a pool and handed out in order; frames without a recorded size (or huge ones) are
+ * streamed on the reader thread once everything before them has been handed out.
+ */
+class ZstdDecoder final : public StreamDecoder {
+public:
+    explicit ZstdDecoder(const QString& path) : m_file(path) {}
+    ~ZstdDecoder() override
+    {
+        for (QFuture<DecodedFrame>& f : m_pending) {
+            f.waitForFinished();  // tasks read from m_map
+        }
+        ZSTD_freeDStream(m_dstream);
+    }
+
+    bool open(QString* error)
+    {
+        if (!m_file.open(QIODevice::ReadOnly)) {
+            *error = QStringLiteral("Cannot open file: %1").arg(m_file.errorString());
+            return false;
+        }
+        m_size = static_cast<size_t>(m_file.size());
+        m_map = m_size > 0 ? m_file.map(0, m_file.size()) : nullptr;
+        if (!m_map) {
+            *error = m_size == 0 ? QStringLiteral("zstd decompress failed: empty file")
+                                 : QStringLiteral("Cannot map file: %1").arg(m_file.errorString());
+            return false;
+        }
+        m_dstream = ZSTD_createDStream();
+        if (!m_dstream) {
+            *error = QStringLiteral("zstd decompress failed: out of memory");
+            return false;
+        }
+        return true;
+    }
+
+    int64_t read(char* buffer, size_t capacity, QString* error) override
+    {
+        for (;;) {
+            if (m_currentPos < m_current.size()) {
+                const size_t n = std::min(capacity, static_cast<size_t>(m_current.size() - m_currentPos));
+                std::memcpy(buffer, m_current.constData() + m_currentPos, n);
+                m_currentPos += static_cast<qsizetype>(n);
+                return static_cast<int64_t>(n);
+            }
+            if (m_streaming) {
+                return readStreamed(buffer, capacity, error);
+            }
+            if (!schedule(error)) {
+                return -1;
+            }
+            if (!m_pending.empty()) {
+                const DecodedFrame frame = m_pending.front().result();
+                m_pending.pop_front();
+                m_pendingBytes -= static_cast<unsigned long long>(frame.data.size());
+                if (!frame.error.isEmpty()) {
+                    *error = frame.error;
+                    return -1;
+                }
+                m_current = frame.data;
+                m_currentPos = 0;
+                continue;
+            }
+            if (m_blockedEnd > m_blockedBegin) {
+                ZSTD_DCtx_reset(m_dstream, ZSTD_reset_session_only);
+                m_in = {m_map + m_blockedBegin, m_blockedEnd - m_blockedBegin, 0};
+                m_blockedBegin = m_blockedEnd = 0;
+                m_streaming = true;
+                continue;
+            }
+            return 0;
+        }
+    }
+
+private:
+    /** Queues frames from m_scan until the byte budget is used or a frame must be streamed. */
+    bool schedule(QString* error)
+    {
+        while (m_blockedEnd == 0 && m_scan < m_size) {
+            const uchar* src = m_map + m_scan;
+            const size_t remaining = m_size - m_scan;
+            const size_t frameSize = ZSTD_findFrameCompressedSize(src, remaining);
+            if (ZSTD_isError(frameSize)) {
+                *error = QStringLiteral("zstd decompress failed: %1")
+                             .arg(QString::fromUtf8(ZSTD_getErrorName(frameSize)));
+                return false;
+            }
+            const unsigned long long content = ZSTD_getFrameContentSize(src, remaining);
+            if (isSkippableFrame(src, remaining)) {
+                m_scan += frameSize;
+                continue;
+            }
+            if (content == ZSTD_CONTENTSIZE_UNKNOWN || content == ZSTD_CONTENTSIZE_ERROR
+                || content > kMaxParallelFrameBytes) {
+                if (!m_pending.empty()) {
+                    return true;  // hand out what is queued first, then stream this frame
+                }
+                m_blockedBegin = m_scan;
+                m_blockedEnd = m_scan + frameSize;
+                m_scan = m_blockedEnd;
+                return true;
+            }
+            if (!m_pending.empty() && m_pendingBytes + content > kMaxPendingBytes) {
+                return true;
+            }
+            m_pending.push_back(QtConcurrent::run(&decodePool(), decodeFrame, src, frameSize,
+                                                  static_cast<size_t>(content)));
+            m_pendingBytes += content;
+            m_scan += frameSize;
+        }
+        return true;
+    }
+
+    int64_t readStreamed(char* buffer, size_t capacity, QString* error)
+    {
+        ZSTD_outBuffer out = {buffer, capacity, 0};
+        while (out.pos < out.size && m_in.pos < m_in.size) {
+            const size_t ret = ZSTD_decompressStream(m_dstream, &out, &m_in);
+            if (ZSTD_isError(ret)) {
+                *error = QStringLiteral("zstd decompress failed: %1").arg(QString::fromUtf8(ZSTD_getErrorName(ret)));
+                return -1;
+            }
+            if (ret == 0) {
+                m_streaming = false;  // frame complete
+                break;
+            }
+        }
+        if (m_streaming && m_in.pos == m_in.size && out.pos < out.size) {
+            // Input used up, but the decoder may still hold buffered output for this frame.
+            const size_t ret = ZSTD_decompressStream(m_dstream, &out, &m_in);
+            if (ZSTD_isError(ret)) {
+                *error = QStringLiteral("zstd decompress failed: %1").arg(QString::fromUtf8(ZSTD_getErrorName(ret)));
+                return -1;
+            }
+            if (ret == 0) {
+                m_streaming = false;
+            } else if (out.pos == 0) {
+                *error = QStringLiteral("zstd decompress failed: file is truncated");
+                return -1;
+            }
+        }
+        if (out.pos == 0 && !m_streaming) {
+            return read(buffer, capacity, error);
+        }
+        return static_cast<int64_t>(out.pos);
+    }
+
+    QFile m_file;
+    uchar* m_map = nullptr;
+    size_t m_size = 0;
+    size_t m_scan = 0;
+    std::deque<QFuture<DecodedFrame>> m_pending;
+    unsigned long long m_pendingBytes = 0;
+    QByteArray m_current;
+    qsizetype m_currentPos = 0;
+    size_t m_blockedBegin = 0;
+    size_t m_blockedEnd = 0;
+    bool m_streaming = false;
+    ZSTD_DStream* m_dstream = nullptr;
+    ZSTD_inBuffer m_in{};
+};
+
+} // namespace
+
+bool zstdAvailable()
+{
+    return true;
+}
+
+std::unique_ptr<StreamDecoder> openZstd(const QString& path, QString* error)
+{
+    auto decoder = std::make_unique<ZstdDecoder>(path);
+    QString err;
+    if (!decoder->open(&err)) {
+        if (error) {
+            *error = err;
+        }
+        return nullptr;
+    }
+    return decoder;
+}
+
+} // namespace ImageDecoders
+} // namespace FlashSpartan
+
+#else
+
+namespace FlashSpartan {
+namespace ImageDecoders {
+
+bool zstdAvailable()
+{
+    return false;
+}
+
+std::unique_ptr<StreamDecoder> openZstd(const QString& /*path*/, QString* error)
+{
+    if (error) {
+        *error = QStringLiteral("Built without libzstd");
+    }
+    return nullptr;
+}
+
+} // namespace ImageDecoders
+} // namespace FlashSpartan
+
+#endif
@@ -26,6 +26,7 @@ IsoPublisherMatch makeArch(const QString& fileName, const QString& versionTag)
         normalizeFingerprint(QStringLiteral("4AA4 767B BC26 9466 99BE 394B 31DB D89E 5A2A 8E65")),
         normalizeFingerprint(QStringLiteral("6841 48ED 3E97 4B8F 27B2 9DF7 00F4 9D16 0A86 2172")),
     };
+    m.rollingRelease = true;
     return m;
 }
 
@@ -114,6 +115,7 @@ IsoPublisherMatch makeOpenSuseTumbleweed(const QString& fileName)
     m.trustedFingerprints = {
         normalizeFingerprint(QStringLiteral("29D9 7BA4 7C21 8193 7701 6271 7370 352E 1C51 80BC")),
     };
+    m.rollingRelease = true;
     return m;
 }
 
@@ -446,6 +448,7 @@ IsoPublisherMatch makeVoidLinux(const QString& fileName)
     m.signatureUrl = QStringLiteral("https://repo-default.voidlinux.org/live/current/sha256sum.sig");
     m.signingKeyIds = {};
     m.trustedFingerprints = {};
+    m.rollingRelease = true;
     return m;
 }
 
@@ -476,6 +479,7 @@ IsoPublisherMatch makeNixos(const QString& fileName, const QString& channel, con
     m.signatureUrl = QString();
     m.signingKeyIds = {};
     m.trustedFingerprints = {};
+    m.rollingRelease = true;
     return m;
 }
 
@@ -0,0 +1,119 @@
+#include "IsoCatalogInternal.h"
+
+#include <algorithm>
+
+namespace FlashSpartan {
+namespace IsoCatalogInternal {
+
+namespace {
+
+bool hasTopLevelAlternation(const QString& pattern)
+{
+    int depth = 0;
+    bool inClass = false;
+    for (int i = 0; i < pattern.size(); ++i) {
+        const QChar c = pattern.at(i);
+        if (c == QLatin1Char('\\')) {
+            ++i;
+        } else if (inClass) {
+            inClass = c != QLatin1Char(']');
+        } else if (c == QLatin1Char('[')) {
+            inClass = true;
+        } else if (c == QLatin1Char('(')) {
+            ++depth;
+        } else if (c == QLatin1Char(')')) {
+            --depth;
+        } else if (c == QLatin1Char('|') && depth == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isQuantifier(QChar c)
+{
+    return c == QLatin1Char('?') || c == QLatin1Char('*') || c == QLatin1Char('+') || c == QLatin1Char('{');
+}
+
+} // namespace
+
+QString FileNamePatternIndex::literalPrefix(const QString& pattern, bool* exact)
+{
+    *exact = false;
+    if (!pattern.startsWith(QLatin1Char('^')) || hasTopLevelAlternation(pattern)) {
+        return {};
+    }
+    static const QString kSpecial = QStringLiteral("^$.[]()*+?{}|");
+    QString prefix;
+    int i = 1;
+    while (i < pattern.size()) {
+        QChar literal = pattern.at(i);
+        int width = 1;
+        if (literal == QLatin1Char('\\')) {
+            // "\." is a literal; "\d", "\w", "\b" and back-references are not.
+            if (i + 1 >= pattern.size()) {
+                return {};
+            }
+            literal = pattern.at(i + 1);
+            if (literal.unicode() < 0x80 && literal.isLetterOrNumber()) {
+                break;
+            }
+            width = 2;
+        } else if (kSpecial.contains(literal)) {
+            break;
+        }
+        if (i + width < pattern.size() && isQuantifier(pattern.at(i + width))) {
+            break;  // "ab?" only promises "a"
+        }
+        prefix += literal;
+        i += width;
+    }
+    *exact = i == pattern.size() - 1 && pattern.at(i) == QLatin1Char('$');
+    return prefix;
+}
+
+void FileNamePatternIndex::clear()
+{
+    m_exact.clear();
+    m_byPrefix.clear();
+    m_prefixLengths.clear();
+    m_unindexed.clear();
+}
+
+void FileNamePatternIndex::add(int id, const QString& pattern)
+{
+    bool exact = false;
+    const QString prefix = literalPrefix(pattern, &exact).toLower();
+    if (prefix.isEmpty()) {
+        m_unindexed.append(id);
+    } else if (exact) {
+        m_exact[prefix].append(id);
+    } else {
+        m_byPrefix[prefix].append(id);
+        const auto at = std::lower_bound(m_prefixLengths.begin(), m_prefixLengths.end(), prefix.size());
+        if (at == m_prefixLengths.end() || *at != prefix.size()) {
+            m_prefixLengths.insert(at, prefix.size());
+        }
+    }
+}
+
+QList<int> FileNamePatternIndex::candidates(const QString& fileName) const
+{
+    const QString key = fileName.toLower();
+    QList<int> ids = m_unindexed;
+    ids += m_exact.value(key);
+    for (int length : m_prefixLengths) {
+        if (length > key.size()) {
+            break;
+        }
+        const auto it = m_byPrefix.constFind(key.left(length));
+        if (it != m_byPrefix.constEnd()) {
+            ids += *it;
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+} // namespace IsoCatalogInternal
+} // namespace FlashSpartan
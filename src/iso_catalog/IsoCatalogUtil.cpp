@@ -5,7 +5,7 @@ namespace FlashSpartan {
 bool IsoCatalog::isVerifiableImageFileName(const QString& fileName)
 {
     static const QRegularExpression re(
-        QStringLiteral("\\.(iso|img\\.xz|img|zip)$"), QRegularExpression::CaseInsensitiveOption);
+        QStringLiteral("\\.(iso|img\\.xz|img\\.zst|img\\.gz|img|zip)$"), QRegularExpression::CaseInsensitiveOption);
     return re.match(fileName).hasMatch();
 }
 
@@ -1,4 +1,5 @@
 #include <QApplication>
+#include <QByteArray>
 #include <QCoreApplication>
 #include <QLoggingCategory>
 #include <QFileInfo>
@@ -11,17 +12,34 @@
 #include <QStandardPaths>
 #include <QDebug>
 #include <QSettings>
+#include <QProcessEnvironment>
+#include <QtConcurrent>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QScopeGuard>
 
 #include <iostream>
 #include <csignal>
+#include <cstring>
+#include <memory>
+#include <optional>
 
 #include "AppPaths.h"
 #include "AppDiagnostics.h"
+#include "AuditWriter.h"
 #include "CrashReporter.h"
+#include "IsoCatalogManifest.h"
 #include "MainWindow.h"
+#include "MonitorService.h"
+#include "PerfTrace.h"
+#include "StartupTrace.h"
 #include "StyleManager.h"
 #include "Types.h"
+#include "UdevEventTrace.h"
 #include "VerifyCli.h"
+#include "policy/PolicyDaemonLauncher.h"
+#include "policy/PolicyGateway.h"
+#include "policy/PolicyServiceLocator.h"
 
 using namespace FlashSpartan;
 
@@ -63,6 +81,41 @@ bool isAlreadyRunning()
     return !sharedMemory.create(1);
 }
 
+/** Prints the running headless service's snapshot (devices and their last verdicts). */
+int printMonitorStatus()
+{
+    QLocalSocket socket;
+    socket.connectToServer(MonitorService::socketPath());
+    if (!socket.waitForConnected(2000)) {
+        std::cerr << "No headless FlashSpartan service is listening on "
+                  << MonitorService::socketPath().toStdString() << "\n";
+        return 1;
+    }
+    QByteArray line;
+    while (!line.contains('\n') && socket.waitForReadyRead(5000)) {
+        line += socket.readAll();
+    }
+    const QJsonDocument doc = QJsonDocument::fromJson(line.left(line.indexOf('\n')));
+    if (!doc.isObject()) {
+        std::cerr << "The headless service sent no snapshot\n";
+        return 1;
+    }
+    std::cout << doc.toJson(QJsonDocument::Indented).constData();
+    return 0;
+}
+
+/** Headless runs and status queries need no display, so they get a QCoreApplication. */
+bool wantsCoreApplication(int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--headless") == 0 || std::strcmp(argv[i], "--monitor-status") == 0
+            || std::strcmp(argv[i], "--dump-flight-recorder") == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void printVersion()
 {
 #ifdef FLASHSPARTAN_VERSION
@@ -76,6 +129,7 @@ void printVersion()
 
 int main(int argc, char* argv[])
 {
+    StartupTrace::start();
     QCoreApplication::setApplicationName("FlashSpartan");
 #ifdef FLASHSPARTAN_VERSION
     QApplication::setApplicationVersion(QLatin1String(FLASHSPARTAN_VERSION));
@@ -127,6 +181,53 @@ int main(int argc, char* argv[])
     );
     parser.addOption(settingsOption);
 
+    QCommandLineOption headlessOption(
+        "headless",
+        "Monitor devices without a window; status on the monitor socket"
+    );
+    parser.addOption(headlessOption);
+
+    QCommandLineOption monitorStatusOption(
+        "monitor-status",
+        "Print the running headless service's device status and exit"
+    );
+    parser.addOption(monitorStatusOption);
+
+    QCommandLineOption startupTraceOption(
+        "startup-trace",
+        "Write start-up phase timings as a Chrome trace (chrome://tracing, Perfetto)",
+        "path"
+    );
+    parser.addOption(startupTraceOption);
+
+    QCommandLineOption traceOption(
+        "trace",
+        "Record hash, manifest, ISO, policy and udev spans and write them as a Chrome trace on exit",
+        "path"
+    );
+    parser.addOption(traceOption);
+
+    QCommandLineOption metricsOption(
+        "metrics",
+        "Write live performance counters to path in Prometheus text format every 15 s and on exit",
+        "path"
+    );
+    parser.addOption(metricsOption);
+
+    QCommandLineOption dumpFlightRecorderOption(
+        "dump-flight-recorder",
+        "Write the flight recorder's recent spans, counters and events as a Chrome trace and exit",
+        "path"
+    );
+    parser.addOption(dumpFlightRecorderOption);
+
+    QCommandLineOption recordUdevOption(
+        "record-udev",
+        "Record the raw block and input udev events the monitors receive to path, for replay (Linux)",
+        "path"
+    );
+    parser.addOption(recordUdevOption);
+
     QCommandLineOption verifyIsoOption(QStringLiteral("verify-iso"), QStringLiteral("Verify one image file and exit"), QStringLiteral("path"));
     QCommandLineOption verifyMountOption(QStringLiteral("verify-mount"), QStringLiteral("Verify images on mount point and exit"), QStringLiteral("path"));
     QCommandLineOption verifyDirOption(QStringLiteral("verify-dir"), QStringLiteral("Verify images in directory and exit"), QStringLiteral("path"));
@@ -135,6 +236,24 @@ int main(int argc, char* argv[])
     QCommandLineOption reportFormatOption(QStringLiteral("report-format"), QStringLiteral("Report format: text, csv, html, or json"), QStringLiteral("format"), QStringLiteral("text"));
     QCommandLineOption listPublishersOption(QStringLiteral("list-publishers"), QStringLiteral("List built-in ISO publisher IDs and exit"));
     QCommandLineOption trustHashOption(QStringLiteral("trust-hash"), QStringLiteral("Save user-trusted SHA-256 for a filename (TOFU)"), QStringLiteral("file:hash"));
+    QCommandLineOption verifyWatchOption(QStringLiteral("verify-watch"), QStringLiteral("Verify --watch-mount paths against a watch manifest and exit"), QStringLiteral("manifest"));
+    QCommandLineOption watchMountOption(QStringLiteral("watch-mount"), QStringLiteral("Mount point for --verify-watch or --build-manifest (repeatable)"), QStringLiteral("path"));
+    QCommandLineOption buildManifestOption(QStringLiteral("build-manifest"), QStringLiteral("Build a watch manifest of --watch-mount paths from a spec and exit"), QStringLiteral("spec"));
+    QCommandLineOption manifestOutOption(QStringLiteral("manifest-out"), QStringLiteral("Output file (one mount) or directory for --build-manifest"), QStringLiteral("path"));
+    QCommandLineOption hashDeviceOption(QStringLiteral("hash-device"), QStringLiteral("Hash a raw partition and exit (repeatable; hashed concurrently)"), QStringLiteral("node"));
+    QCommandLineOption scanModeOption(QStringLiteral("scan-mode"), QStringLiteral("Scan mode for --hash-device: full, quick, or chunked"), QStringLiteral("mode"), QStringLiteral("full"));
+    QCommandLineOption hashAlgorithmOption(QStringLiteral("hash-algorithm"), QStringLiteral("Algorithm for --hash-device (SHA256, SHA512, BLAKE2b, BLAKE3, XXH3-128)"), QStringLiteral("name"), QStringLiteral("SHA256"));
+    QCommandLineOption resumeOption(QStringLiteral("resume"), QStringLiteral("Continue --hash-device full/chunked reads from their checkpoints"));
+    QCommandLineOption tolerateOption(QStringLiteral("tolerate-bad-sectors"), QStringLiteral("--hash-device: hash unreadable or stuck sectors as zeros and list them"));
+    QCommandLineOption readTimeoutOption(QStringLiteral("read-timeout"), QStringLiteral("Milliseconds before a --tolerate-bad-sectors read is skipped"), QStringLiteral("ms"), QStringLiteral("0"));
+    QCommandLineOption verifyClonesOption(QStringLiteral("verify-clones"), QStringLiteral("Compare each --clone with a master image file or device and exit"), QStringLiteral("master"));
+    QCommandLineOption cloneOption(QStringLiteral("clone"), QStringLiteral("Device written from the --verify-clones master (repeatable)"), QStringLiteral("node"));
+    QCommandLineOption flashOption(QStringLiteral("flash"), QStringLiteral("Verify an image while writing it to the --to disk, read it back and exit"), QStringLiteral("image"));
+    QCommandLineOption flashTargetOption(QStringLiteral("to"), QStringLiteral("Whole disk for --flash"), QStringLiteral("node"));
+    QCommandLineOption allowUnverifiedOption(QStringLiteral("allow-unverified"), QStringLiteral("--flash an image with no published or trusted hash"));
+    QCommandLineOption allowFixedDiskOption(QStringLiteral("allow-fixed-disk"), QStringLiteral("--flash to a disk that is neither removable nor USB"));
+    QCommandLineOption jobsOption(QStringLiteral("jobs"), QStringLiteral("Devices hashed at once for --hash-device and --verify-clones (0: all)"), QStringLiteral("n"), QStringLiteral("0"));
+    QCommandLineOption progressIntervalOption(QStringLiteral("progress-interval"), QStringLiteral("With --json, a progress line every ms while hashing or building (0: none)"), QStringLiteral("ms"), QStringLiteral("0"));
     QCommandLineOption jsonOption(QStringLiteral("json"), QStringLiteral("Machine-readable JSON on stdout (verify/export commands)"));
     QCommandLineOption quietOption(QStringLiteral("quiet"), QStringLiteral("Print summary only (no per-file report body)"));
     parser.addOption(verifyIsoOption);
@@ -145,17 +264,76 @@ int main(int argc, char* argv[])
     parser.addOption(reportFormatOption);
     parser.addOption(listPublishersOption);
     parser.addOption(trustHashOption);
+    parser.addOption(verifyWatchOption);
+    parser.addOption(watchMountOption);
+    parser.addOption(buildManifestOption);
+    parser.addOption(manifestOutOption);
+    parser.addOption(hashDeviceOption);
+    parser.addOption(scanModeOption);
+    parser.addOption(hashAlgorithmOption);
+    parser.addOption(verifyClonesOption);
+    parser.addOption(cloneOption);
+    parser.addOption(flashOption);
+    parser.addOption(flashTargetOption);
+    parser.addOption(allowUnverifiedOption);
+    parser.addOption(allowFixedDiskOption);
+    parser.addOption(resumeOption);
+    parser.addOption(tolerateOption);
+    parser.addOption(readTimeoutOption);
+    parser.addOption(jobsOption);
+    parser.addOption(progressIntervalOption);
     parser.addOption(jsonOption);
     parser.addOption(quietOption);
 
     QApplication::setHighDpiScaleFactorRoundingPolicy(
         Qt::HighDpiScaleFactorRoundingPolicy::PassThrough);
 
-    QApplication app(argc, argv);
-    AppPaths::migrateFromLegacyConfigIfNeeded();
-    app.setWindowIcon(QIcon(QStringLiteral(":/icons/flashspartan.svg")));
-    AppDiagnostics::installQtMessageHandler();
-    parser.process(app);
+    const bool coreOnly = wantsCoreApplication(argc, argv);
+    std::unique_ptr<QCoreApplication> app;
+    {
+        StartupTrace::Phase phase(QStringLiteral("application object"));
+        if (coreOnly) {
+            app = std::make_unique<QCoreApplication>(argc, argv);
+        } else {
+            app = std::make_unique<QApplication>(argc, argv);
+            QApplication::setWindowIcon(QIcon(QStringLiteral(":/icons/flashspartan.svg")));
+        }
+    }
+    {
+        StartupTrace::Phase phase(QStringLiteral("config migration and log handler"));
+        AppPaths::migrateFromLegacyConfigIfNeeded();
+        AppDiagnostics::installQtMessageHandler();
+    }
+    parser.process(*app);
+    if (parser.isSet(dumpFlightRecorderOption)) {
+        QString error;
+        if (!AppDiagnostics::dumpFlightRecorder(parser.value(dumpFlightRecorderOption), &error)) {
+            std::cerr << "Could not dump the flight recorder: " << error.toStdString() << '\n';
+            return 1;
+        }
+        return 0;
+    }
+    AppDiagnostics::startFlightRecorder();
+    if (parser.isSet(startupTraceOption)) {
+        StartupTrace::setOutputPath(parser.value(startupTraceOption));
+    }
+    const QString tracePath = parser.value(traceOption);
+    PerfTrace::setEnabled(!tracePath.isEmpty());
+    const auto traceWriter = qScopeGuard([&tracePath] {
+        if (!tracePath.isEmpty() && !PerfTrace::writeTo(tracePath)) {
+            qWarning() << "Could not write the trace to" << tracePath;
+        }
+    });
+    if (parser.isSet(metricsOption)) {
+        AppDiagnostics::startMetricsExport(parser.value(metricsOption));
+    }
+    if (parser.isSet(recordUdevOption)) {
+        QString error;
+        if (!UdevEventTrace::startRecording(parser.value(recordUdevOption), &error)) {
+            qWarning() << "Could not record udev events:" << error;
+        }
+    }
+    const auto udevRecorder = qScopeGuard([] { UdevEventTrace::stopRecording(); });
 
     if (parser.isSet(configOption)) {
         VerifyCli::setConfigFilePath(parser.value(configOption));
@@ -166,6 +344,7 @@ int main(int argc, char* argv[])
     if (parser.isSet(quietOption)) {
         VerifyCli::setQuietOutput(true);
     }
+    VerifyCli::setProgressInterval(parser.value(progressIntervalOption).toInt());
 
     if (parser.isSet(listPublishersOption)) {
         return VerifyCli::runListPublishers();
@@ -191,6 +370,32 @@ int main(int argc, char* argv[])
     if (parser.isSet(verifyDirOption)) {
         return VerifyCli::runVerifyDir(parser.value(verifyDirOption));
     }
+    if (parser.isSet(verifyWatchOption)) {
+        return VerifyCli::runVerifyWatch(parser.value(verifyWatchOption), parser.values(watchMountOption));
+    }
+    if (parser.isSet(buildManifestOption)) {
+        return VerifyCli::runBuildManifest(parser.value(buildManifestOption), parser.values(watchMountOption),
+                                           parser.value(manifestOutOption));
+    }
+    if (parser.isSet(hashDeviceOption)) {
+        return VerifyCli::runHashDevices(parser.values(hashDeviceOption), parser.value(scanModeOption),
+                                         parser.value(hashAlgorithmOption), parser.isSet(resumeOption),
+                                         qMax(0, parser.value(jobsOption).toInt()), parser.isSet(tolerateOption),
+                                         parser.value(readTimeoutOption).toInt());
+    }
+    if (parser.isSet(verifyClonesOption)) {
+        return VerifyCli::runVerifyClones(parser.value(verifyClonesOption), parser.values(cloneOption),
+                                          parser.value(hashAlgorithmOption),
+                                          qMax(0, parser.value(jobsOption).toInt()));
+    }
+    if (parser.isSet(flashOption)) {
+        return VerifyCli::runFlashImage(parser.value(flashOption), parser.value(flashTargetOption),
+                                        parser.value(hashAlgorithmOption), parser.isSet(allowUnverifiedOption),
+                                        parser.isSet(allowFixedDiskOption));
+    }
+    if (parser.isSet(monitorStatusOption)) {
+        return printMonitorStatus();
+    }
     if (parser.isSet(exportReportOption)) {
         const QString path = parser.value(exportReportOption);
         const QString fmt = parser.value(reportFormatOption);
@@ -210,6 +415,9 @@ int main(int argc, char* argv[])
     if (!parser.isSet(forceOption) && isAlreadyRunning()) {
         qWarning() << "Another instance of FlashSpartan is already running.";
         qWarning() << "Use --force to start anyway.";
+        if (parser.isSet(headlessOption)) {
+            return 1;
+        }
         
         QMessageBox::warning(
             nullptr,
@@ -222,7 +430,7 @@ int main(int argc, char* argv[])
     }
     
     // Check for system tray availability
-    if (!parser.isSet(noTrayOption) && !QSystemTrayIcon::isSystemTrayAvailable()) {
+    if (!coreOnly && !parser.isSet(noTrayOption) && !QSystemTrayIcon::isSystemTrayAvailable()) {
         qWarning() << "System tray is not available on this system.";
         qWarning() << "FlashSpartan will run without tray icon.";
     }
@@ -235,24 +443,69 @@ int main(int argc, char* argv[])
     
     // Register custom types
     qRegisterMetaType<DeviceInfo>("DeviceInfo");
+    qRegisterMetaType<DeviceHandle>("DeviceHandle");
     qRegisterMetaType<DeviceRecord>("DeviceRecord");
     qRegisterMetaType<HashResult>("HashResult");
     qRegisterMetaType<VerificationStatus>("VerificationStatus");
     qRegisterMetaType<LogLevel>("LogLevel");
+
+    if (parser.isSet(headlessOption)) {
+        MonitorService service;
+        QString error;
+        if (!service.start(&error)) {
+            qCritical() << "Headless monitoring could not start:" << error;
+            return 1;
+        }
+        qInfo() << "FlashSpartan monitoring headless; status on" << MonitorService::socketPath();
+        const int result = app->exec();
+        service.stop();
+        AuditWriter::flushAll();
+        return result;
+    }
     
+    // Independent start-up work overlaps the style and window set-up below: the ISO
+    // catalog (embedded manifest checks) and a cold policy daemon launch.
+    QFuture<void> catalogLoad = QtConcurrent::run([]() {
+        StartupTrace::Phase phase(QStringLiteral("ISO catalog load"));
+        IsoCatalogManifest::ensureLoaded();
+    });
+    const bool policyInProcess =
+        QProcessEnvironment::systemEnvironment().value(QStringLiteral("FLASHSPARTAN_POLICY_IN_PROCESS"))
+        == QStringLiteral("1");
+    QFuture<void> policyLaunch;
+    if (!policyInProcess) {
+        policyLaunch = QtConcurrent::run([]() {
+            StartupTrace::Phase phase(QStringLiteral("policy daemon launch"));
+            Policy::PolicyDaemonLauncher::ensureRunning();
+        });
+    }
+
     // Initialize style manager
-    StyleManager::instance().initialize();
-    StyleManager::instance().applyToApplication();
+    {
+        StartupTrace::Phase phase(QStringLiteral("style manager"));
+        StyleManager::instance().initialize();
+        StyleManager::instance().applyToApplication();
+    }
     
     AppSettings startupSettings;
     {
+        StartupTrace::Phase phase(QStringLiteral("crash reporter"));
         QSettings settings(QStringLiteral("flashspartan"), QStringLiteral("FlashSpartan"));
         startupSettings.crashReportsEnabled =
             settings.value(QStringLiteral("diagnostics/crashReportsEnabled"), false).toBool();
+        CrashReporter::tryInstall(startupSettings);
+    }
+
+    // The gateway is installed here, on the GUI thread, so its change feed lives there;
+    // the daemon it connects to is up by the time the launch finishes.
+    {
+        StartupTrace::Phase phase(QStringLiteral("policy gateway"));
+        policyLaunch.waitForFinished();
+        Policy::PolicyServiceLocator::install(Policy::PolicyGateway::createDefault());
     }
-    CrashReporter::tryInstall(startupSettings);
 
     // Create main window
+    std::optional<StartupTrace::Phase> windowPhase(std::in_place, QStringLiteral("main window"));
     MainWindow mainWindow;
     g_mainWindow = &mainWindow;
 
@@ -272,16 +525,20 @@ int main(int argc, char* argv[])
     } else {
         mainWindow.show();
     }
+    windowPhase.reset();
+    QTimer::singleShot(0, app.get(), []() { StartupTrace::finish(); });
     
     qInfo() << "FlashSpartan started successfully";
     qInfo() << "Qt version:" << qVersion();
     qInfo() << "System:" << QSysInfo::prettyProductName();
     
     // Run the application event loop
-    int result = app.exec();
+    int result = app->exec();
+    catalogLoad.waitForFinished();
     
     // Cleanup
     g_mainWindow = nullptr;
+    AuditWriter::flushAll();
     
     qInfo() << "FlashSpartan exiting with code" << result;
     
@@ -1,6 +1,8 @@
 #include "policy/PolicyBlobCodec.h"
 
+#include "policy/PolicyBlobView.h"
 #include "policy/PolicyPaths.h"
+#include "StoreCompression.h"
 
 #include <QDataStream>
 #include <QDir>
@@ -9,11 +11,14 @@
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QMutex>
 #include <QRandomGenerator>
 
 #include <openssl/evp.h>
 #include <openssl/hmac.h>
 
+#include <algorithm>
+
 namespace FlashSpartan::Policy {
 
 namespace {
@@ -81,33 +86,28 @@ BlockedDriveEntry deserializeBlock(const QByteArray& blob)
     return e;
 }
 
-} // namespace
-
-QByteArray PolicyBlobCodec::encode(const PolicySnapshot& snapshot)
+/**
+ * The dictionary for @p records. Training takes tens of milliseconds on a big store and
+ * runs on every save otherwise, so one is kept until the store grows or shrinks by a
+ * quarter; what the records share changes far more slowly than the records do.
+ */
+QByteArray recordDictionary(const QList<QByteArray>& records)
 {
-    QByteArray payload;
-    QDataStream out(&payload, QIODevice::WriteOnly);
-    out.setVersion(QDataStream::Qt_6_4);
-    out.setByteOrder(QDataStream::LittleEndian);
-
-    out << quint32(snapshot.devices.size());
-    for (const DeviceRecord& rec : snapshot.devices) {
-        const QByteArray blob = serializeDevice(rec);
-        out << quint32(blob.size());
-        out.writeRawData(blob.constData(), blob.size());
-    }
-
-    out << quint32(snapshot.blocks.size());
-    for (const BlockedDriveEntry& e : snapshot.blocks) {
-        const QByteArray blob = serializeBlock(e);
-        out << quint32(blob.size());
-        out.writeRawData(blob.constData(), blob.size());
+    static QMutex mutex;
+    static QByteArray dictionary;
+    static qsizetype trainedOn = 0;
+    QMutexLocker lock(&mutex);
+    const qsizetype n = records.size();
+    if (trainedOn == 0 || n * 4 < trainedOn * 3 || n * 4 > trainedOn * 5) {
+        dictionary = StoreCompression::trainDictionary(records);
+        trainedOn = n;
     }
-
-    return payload;
+    return dictionary;
 }
 
-bool PolicyBlobCodec::decode(const QByteArray& fileBytes, PolicySnapshot& out, QString* error)
+/** Version 1: header, one length-prefixed stream of JSON records, HMAC over the stream. */
+bool decodeLegacy(const QByteArray& fileBytes, const QByteArray& key, PolicySnapshot& out,
+                  QString* error)
 {
     if (fileBytes.size() < 10 + 32) {
         if (error) {
@@ -123,24 +123,23 @@ bool PolicyBlobCodec::decode(const QByteArray& fileBytes, PolicySnapshot& out, Q
     quint16 version = 0;
     quint32 payloadLen = 0;
     header >> magicRead >> version >> payloadLen;
-    if (magicRead != kMagic || version != kVersion) {
+    if (magicRead != PolicyBlobCodec::kMagic || version != PolicyBlobCodec::kLegacyVersion) {
         if (error) {
             *error = QStringLiteral("Invalid policy store header");
         }
         return false;
     }
-    if (fileBytes.size() < 10 + static_cast<int>(payloadLen) + 32) {
+    if (fileBytes.size() < 10 + qint64(payloadLen) + 32) {
         if (error) {
             *error = QStringLiteral("Truncated policy store");
         }
         return false;
     }
 
-    const QByteArray payload = fileBytes.mid(10, static_cast<int>(payloadLen));
-    const QByteArray sig = fileBytes.mid(10 + static_cast<int>(payloadLen), 32);
+    const QByteArray payload = fileBytes.mid(10, qsizetype(payloadLen));
+    const QByteArray sig = fileBytes.mid(10 + qsizetype(payloadLen), 32);
 
-    const QByteArray key = loadOrCreateKey();
-    if (!verify(payload, sig, key)) {
+    if (!PolicyBlobCodec::verify(payload, sig, key)) {
         if (error) {
             *error = QStringLiteral("Policy store integrity check failed (HMAC)");
         }
@@ -183,6 +182,12 @@ bool PolicyBlobCodec::decode(const QByteArray& fileBytes, PolicySnapshot& out, Q
     for (quint32 i = 0; i < blockCount; ++i) {
         quint32 blobLen = 0;
         in >> blobLen;
+        if (blobLen > 8 * 1024 * 1024) {
+            if (error) {
+                *error = QStringLiteral("Corrupt block entry");
+            }
+            return false;
+        }
         QByteArray blob;
         blob.resize(static_cast<int>(blobLen));
         if (in.readRawData(blob.data(), static_cast<int>(blobLen)) != static_cast<int>(blobLen)) {
@@ -200,6 +205,157 @@ bool PolicyBlobCodec::decode(const QByteArray& fileBytes, PolicySnapshot& out, Q
     return true;
 }
 
+} // namespace
+
+QByteArray PolicyBlobCodec::encode(const PolicySnapshot& snapshot, const QByteArray& key,
+                                   QByteArray* signature)
+{
+    // Index entries sorted by id bytes, so PolicyBlobView can binary-search them.
+    QList<QPair<QByteArray, const DeviceRecord*>> ordered;
+    ordered.reserve(snapshot.devices.size());
+    for (const DeviceRecord& rec : snapshot.devices) {
+        ordered.append({rec.uniqueId.toUtf8(), &rec});
+    }
+    std::sort(ordered.begin(), ordered.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    QList<QByteArray> blobs;
+    blobs.reserve(ordered.size());
+    for (const auto& [id, rec] : ordered) {
+        blobs.append(serializeDevice(*rec));
+    }
+    const QByteArray dictionary =
+        StoreCompression::available() ? recordDictionary(blobs) : QByteArray();
+
+    QByteArray index;
+    QByteArray strings;
+    QByteArray records;
+    {
+        StoreCompression::Encoder encoder(dictionary);
+        QDataStream out(&index, QIODevice::WriteOnly);
+        out.setByteOrder(QDataStream::LittleEndian);
+        for (qsizetype i = 0; i < ordered.size(); ++i) {
+            const QByteArray& id = ordered.at(i).first;
+            const QByteArray& blob = blobs.at(i);
+            const QByteArray packed = encoder.compress(blob);
+            const QByteArray& stored = packed.isEmpty() ? blob : packed;
+            out << quint32(strings.size()) << quint32(id.size()) << quint64(records.size())
+                << quint32(stored.size()) << quint32(packed.isEmpty() ? 0 : blob.size());
+            strings += id;
+            records += stored;
+        }
+    }
+    QByteArray blocks;
+    {
+        QDataStream out(&blocks, QIODevice::WriteOnly);
+        out.setByteOrder(QDataStream::LittleEndian);
+        for (const BlockedDriveEntry& e : snapshot.blocks) {
+            const QByteArray blob = serializeBlock(e);
+            out << quint32(blob.size());
+            out.writeRawData(blob.constData(), blob.size());
+        }
+    }
+
+    struct Section {
+        SectionKind kind;
+        quint32 count;
+        const QByteArray* bytes;
+    };
+    QList<Section> sections = {
+        {DeviceIndex, quint32(ordered.size()), &index},
+        {IdStrings, 0, &strings},
+        {DeviceRecords, quint32(ordered.size()), &records},
+        {Blocks, quint32(snapshot.blocks.size()), &blocks},
+    };
+    if (!dictionary.isEmpty()) {
+        sections.append({RecordDictionary, 0, &dictionary});
+    }
+    const int sectionCount = int(sections.size());
+
+    QByteArray file;
+    QDataStream out(&file, QIODevice::WriteOnly);
+    out.setByteOrder(QDataStream::LittleEndian);
+    out << kMagic << kVersion << quint16(sectionCount);
+    quint64 offset = kHeaderBytes + sectionCount * kSectionEntryBytes + kSignatureBytes;
+    for (const auto& section : sections) {
+        const QByteArray hmac = sign(*section.bytes, key);
+        out << quint32(section.kind) << section.count << offset << quint64(section.bytes->size());
+        out.writeRawData(hmac.constData(), hmac.size());
+        offset += quint64(section.bytes->size());
+    }
+    const QByteArray headerSig = sign(file, key);
+    out.writeRawData(headerSig.constData(), headerSig.size());
+    for (const auto& section : sections) {
+        out.writeRawData(section.bytes->constData(), section.bytes->size());
+    }
+    if (signature) {
+        *signature = headerSig;
+    }
+    return file;
+}
+
+bool PolicyBlobCodec::decode(const QByteArray& fileBytes, PolicySnapshot& out, QString* error,
+                             const QByteArray& key)
+{
+    const QByteArray signingKey = key.isEmpty() ? loadOrCreateKey() : key;
+    switch (versionOf(fileBytes)) {
+    case kLegacyVersion:
+        return decodeLegacy(fileBytes, signingKey, out, error);
+    case kRawRecordsVersion:
+    case kVersion: {
+        const std::unique_ptr<PolicyBlobView> view =
+            PolicyBlobView::fromBytes(fileBytes, signingKey, error);
+        return view && view->read(out, error);
+    }
+    default:
+        if (error) {
+            *error = QStringLiteral("Invalid policy store header");
+        }
+        return false;
+    }
+}
+
+QByteArray PolicyBlobCodec::signatureOf(const QByteArray& fileBytes)
+{
+    QDataStream in(fileBytes);
+    in.setByteOrder(QDataStream::LittleEndian);
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    if (version == kLegacyVersion) {
+        quint32 payloadLen = 0;
+        in >> payloadLen;
+        return in.status() == QDataStream::Ok ? fileBytes.mid(10 + qsizetype(payloadLen), kSignatureBytes)
+                                              : QByteArray();
+    }
+    if (isViewVersion(version)) {
+        quint16 sections = 0;
+        in >> sections;
+        return fileBytes.mid(kHeaderBytes + qsizetype(sections) * kSectionEntryBytes, kSignatureBytes);
+    }
+    return {};
+}
+
+quint16 PolicyBlobCodec::versionOf(const QByteArray& header)
+{
+    QDataStream in(header);
+    in.setByteOrder(QDataStream::LittleEndian);
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    return in.status() == QDataStream::Ok && magic == kMagic ? version : 0;
+}
+
+DeviceRecord PolicyBlobCodec::decodeDevice(const QByteArray& blob)
+{
+    return deserializeDevice(blob);
+}
+
+BlockedDriveEntry PolicyBlobCodec::decodeBlock(const QByteArray& blob)
+{
+    return deserializeBlock(blob);
+}
+
 QByteArray PolicyBlobCodec::sign(const QByteArray& payload, const QByteArray& key)
 {
     unsigned int len = EVP_MAX_MD_SIZE;
@@ -0,0 +1,271 @@
+#include "policy/PolicyBlobView.h"
+
+#include "policy/PolicyBlobCodec.h"
+
+#include <QtEndian>
+
+#include <algorithm>
+
+namespace FlashSpartan::Policy {
+
+namespace {
+
+constexpr quint32 kMaxRecordBytes = 8 * 1024 * 1024;
+
+void fail(QString* error, const QString& message)
+{
+    if (error) {
+        *error = message;
+    }
+}
+
+} // namespace
+
+std::unique_ptr<PolicyBlobView> PolicyBlobView::open(const QString& path, const QByteArray& key,
+                                                     QString* error)
+{
+    std::unique_ptr<PolicyBlobView> view(new PolicyBlobView);
+    view->m_file.setFileName(path);
+    if (!view->m_file.open(QIODevice::ReadOnly)) {
+        fail(error, QStringLiteral("Policy store not found"));
+        return nullptr;
+    }
+    view->m_size = view->m_file.size();
+    view->m_data = view->m_size > 0 ? view->m_file.map(0, view->m_size) : nullptr;
+    if (!view->m_data) {
+        // Mapping can fail on odd filesystems; the bytes read the same from memory.
+        view->m_bytes = view->m_file.readAll();
+        view->m_data = reinterpret_cast<const uchar*>(view->m_bytes.constData());
+        view->m_size = view->m_bytes.size();
+    }
+    view->m_key = key;
+    if (!view->parse(error)) {
+        return nullptr;
+    }
+    return view;
+}
+
+std::unique_ptr<PolicyBlobView> PolicyBlobView::fromBytes(const QByteArray& fileBytes,
+                                                          const QByteArray& key, QString* error)
+{
+    std::unique_ptr<PolicyBlobView> view(new PolicyBlobView);
+    view->m_bytes = fileBytes;
+    view->m_data = reinterpret_cast<const uchar*>(view->m_bytes.constData());
+    view->m_size = view->m_bytes.size();
+    view->m_key = key;
+    if (!view->parse(error)) {
+        return nullptr;
+    }
+    return view;
+}
+
+bool PolicyBlobView::parse(QString* error)
+{
+    if (m_size < PolicyBlobCodec::kHeaderBytes
+        || qFromLittleEndian<quint32>(m_data) != PolicyBlobCodec::kMagic
+        || !PolicyBlobCodec::isViewVersion(qFromLittleEndian<quint16>(m_data + 4))) {
+        fail(error, QStringLiteral("Invalid policy store header"));
+        return false;
+    }
+    const quint16 sections = qFromLittleEndian<quint16>(m_data + 6);
+    const qint64 tableEnd = PolicyBlobCodec::kHeaderBytes
+                            + qint64(sections) * PolicyBlobCodec::kSectionEntryBytes;
+    if (m_size < tableEnd + PolicyBlobCodec::kSignatureBytes) {
+        fail(error, QStringLiteral("Truncated policy store"));
+        return false;
+    }
+    m_signature = QByteArray(reinterpret_cast<const char*>(m_data + tableEnd),
+                             PolicyBlobCodec::kSignatureBytes);
+    if (!PolicyBlobCodec::verify(
+            QByteArray::fromRawData(reinterpret_cast<const char*>(m_data), tableEnd), m_signature,
+            m_key)) {
+        fail(error, QStringLiteral("Policy store integrity check failed (HMAC)"));
+        return false;
+    }
+
+    for (quint16 i = 0; i < sections; ++i) {
+        const uchar* entry = m_data + PolicyBlobCodec::kHeaderBytes
+                             + qint64(i) * PolicyBlobCodec::kSectionEntryBytes;
+        Section section;
+        section.kind = qFromLittleEndian<quint32>(entry);
+        section.count = qFromLittleEndian<quint32>(entry + 4);
+        section.offset = qFromLittleEndian<quint64>(entry + 8);
+        section.length = qFromLittleEndian<quint64>(entry + 16);
+        section.hmac = QByteArray(reinterpret_cast<const char*>(entry + 24),
+                                  PolicyBlobCodec::kSignatureBytes);
+        if (section.offset > quint64(m_size) || section.length > quint64(m_size) - section.offset) {
+            fail(error, QStringLiteral("Truncated policy store"));
+            return false;
+        }
+        switch (section.kind) {
+        case PolicyBlobCodec::DeviceIndex:
+            m_index = section;
+            break;
+        case PolicyBlobCodec::IdStrings:
+            m_strings = section;
+            break;
+        case PolicyBlobCodec::DeviceRecords:
+            m_records = section;
+            break;
+        case PolicyBlobCodec::Blocks:
+            m_blocks = section;
+            break;
+        case PolicyBlobCodec::RecordDictionary:
+            m_dictionary = section;
+            break;
+        default:
+            break;  // newer sections this build does not read
+        }
+    }
+
+    m_deviceCount = m_index.count;
+    if (m_index.kind == 0 || m_strings.kind == 0 || m_records.kind == 0 || m_blocks.kind == 0
+        || m_index.length != quint64(m_deviceCount) * PolicyBlobCodec::kIndexEntryBytes) {
+        fail(error, QStringLiteral("Corrupt policy store layout"));
+        return false;
+    }
+    if (!sectionValid(m_index) || !sectionValid(m_strings)) {
+        fail(error, QStringLiteral("Policy store integrity check failed (HMAC)"));
+        return false;
+    }
+    for (quint32 i = 0; i < m_deviceCount; ++i) {
+        const uchar* entry = m_data + m_index.offset + quint64(i) * PolicyBlobCodec::kIndexEntryBytes;
+        const quint64 idEnd = quint64(qFromLittleEndian<quint32>(entry))
+                              + qFromLittleEndian<quint32>(entry + 4);
+        // Offset and length checked apart: their sum can wrap past 2^64.
+        const quint64 recordOffset = qFromLittleEndian<quint64>(entry + 8);
+        const quint32 recordLength = qFromLittleEndian<quint32>(entry + 16);
+        const quint32 rawLength = qFromLittleEndian<quint32>(entry + 20);
+        if (idEnd > m_strings.length || recordOffset > m_records.length
+            || recordLength > m_records.length - recordOffset || recordLength > kMaxRecordBytes
+            || rawLength > kMaxRecordBytes) {
+            fail(error, QStringLiteral("Corrupt device record"));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PolicyBlobView::sectionValid(const Section& section) const
+{
+    return PolicyBlobCodec::verify(
+        QByteArray::fromRawData(reinterpret_cast<const char*>(m_data + section.offset),
+                                qsizetype(section.length)),
+        section.hmac, m_key);
+}
+
+bool PolicyBlobView::recordsValid(QString* error) const
+{
+    std::call_once(m_recordsChecked, [this] {
+        m_recordsOk = sectionValid(m_records) && (m_dictionary.kind == 0 || sectionValid(m_dictionary));
+        if (m_recordsOk) {
+            m_decoder = std::make_unique<StoreCompression::Decoder>(
+                m_dictionary.kind == 0
+                    ? QByteArray()
+                    : QByteArray(reinterpret_cast<const char*>(m_data + m_dictionary.offset),
+                                 qsizetype(m_dictionary.length)));
+        }
+    });
+    if (!m_recordsOk) {
+        fail(error, QStringLiteral("Policy store integrity check failed (HMAC)"));
+    }
+    return m_recordsOk;
+}
+
+QByteArray PolicyBlobView::signature() const
+{
+    return m_signature;
+}
+
+QByteArray PolicyBlobView::indexedId(quint32 i) const
+{
+    const uchar* entry = m_data + m_index.offset + quint64(i) * PolicyBlobCodec::kIndexEntryBytes;
+    return QByteArray::fromRawData(
+        reinterpret_cast<const char*>(m_data + m_strings.offset + qFromLittleEndian<quint32>(entry)),
+        qFromLittleEndian<quint32>(entry + 4));
+}
+
+std::optional<DeviceRecord> PolicyBlobView::recordAt(quint32 i, StoreCompression::Decoder& decoder,
+                                                     QString* error) const
+{
+    const uchar* entry = m_data + m_index.offset + quint64(i) * PolicyBlobCodec::kIndexEntryBytes;
+    QByteArray blob = QByteArray::fromRawData(
+        reinterpret_cast<const char*>(m_data + m_records.offset + qFromLittleEndian<quint64>(entry + 8)),
+        qFromLittleEndian<quint32>(entry + 16));
+    const quint32 rawLength = qFromLittleEndian<quint32>(entry + 20);
+    if (rawLength > 0) {
+        // Checked against its HMAC before it is inflated, like everything else here.
+        std::optional<QByteArray> raw = decoder.decompress(blob, rawLength, error);
+        if (!raw) {
+            return std::nullopt;
+        }
+        blob = std::move(*raw);
+    }
+    DeviceRecord rec = PolicyBlobCodec::decodeDevice(blob);
+    if (rec.uniqueId.isEmpty()) {
+        fail(error, QStringLiteral("Corrupt device record"));
+        return std::nullopt;
+    }
+    return rec;
+}
+
+std::optional<DeviceRecord> PolicyBlobView::device(const QString& uniqueId, QString* error) const
+{
+    const QByteArray wanted = uniqueId.toUtf8();
+    quint32 lo = 0;
+    quint32 hi = m_deviceCount;
+    while (lo < hi) {
+        const quint32 mid = lo + (hi - lo) / 2;
+        if (indexedId(mid) < wanted) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo == m_deviceCount || indexedId(lo) != wanted || !recordsValid(error)) {
+        return std::nullopt;
+    }
+    StoreCompression::Decoder decoder(*m_decoder);
+    return recordAt(lo, decoder, error);
+}
+
+bool PolicyBlobView::read(PolicySnapshot& out, QString* error) const
+{
+    if (!recordsValid(error)) {
+        return false;
+    }
+    if (!sectionValid(m_blocks)) {
+        fail(error, QStringLiteral("Policy store integrity check failed (HMAC)"));
+        return false;
+    }
+    out.devices.clear();
+    out.devices.reserve(m_deviceCount);
+    StoreCompression::Decoder decoder(*m_decoder);
+    for (quint32 i = 0; i < m_deviceCount; ++i) {
+        std::optional<DeviceRecord> rec = recordAt(i, decoder, error);
+        if (!rec) {
+            return false;
+        }
+        out.devices.append(std::move(*rec));
+    }
+
+    out.blocks.clear();
+    const uchar* pos = m_data + m_blocks.offset;
+    const uchar* end = pos + m_blocks.length;
+    for (quint32 i = 0; i < m_blocks.count; ++i) {
+        if (end - pos < 4 || qFromLittleEndian<quint32>(pos) > quint64(end - pos - 4)) {
+            fail(error, QStringLiteral("Unexpected end of block data"));
+            return false;
+        }
+        const quint32 len = qFromLittleEndian<quint32>(pos);
+        BlockedDriveEntry e = PolicyBlobCodec::decodeBlock(
+            QByteArray::fromRawData(reinterpret_cast<const char*>(pos + 4), len));
+        pos += 4 + len;
+        if (!e.driveKey.isEmpty() || !e.uniqueId.isEmpty()) {
+            out.blocks.append(e);
+        }
+    }
+    return true;
+}
+
+} // namespace FlashSpartan::Policy
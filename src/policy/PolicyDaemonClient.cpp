@@ -1,198 +1,330 @@
 #include "policy/PolicyDaemonClient.h"
 #include "policy/PolicyPaths.h"
 
+#include <QElapsedTimer>
 #include <QLocalSocket>
-#include <QJsonArray>
-#include <QJsonDocument>
-#include <QJsonObject>
+#include <QThread>
+#include <QTimer>
 
 namespace FlashSpartan::Policy {
 
-PolicyDaemonClient::PolicyDaemonClient(QString socketPath)
-    : m_socketPath(socketPath.isEmpty() ? PolicyPaths::socketPath() : std::move(socketPath))
+using PolicyProtocol::FrameType;
+
+namespace {
+
+constexpr int kFeedRetryMs = 5000;
+constexpr int kConnectTimeoutMs = 3000;
+constexpr int kReplyTimeoutMs = 10000;
+/** Export and import stream the whole store; policyd answers them from a worker. */
+constexpr int kBulkReplyTimeoutMs = 300000;
+
+bool connectSocket(QLocalSocket& socket, const QString& path, QString* error)
 {
+    socket.connectToServer(path);
+    if (socket.waitForConnected(kConnectTimeoutMs)) {
+        return true;
+    }
+    if (error) {
+        *error = QStringLiteral("Cannot connect to flashspartan-policyd");
+    }
+    return false;
 }
 
-QJsonObject PolicyDaemonClient::request(const QJsonObject& req, QString* error) const
+/** Writes @p frames, then reads one Reply per id in @p ids, in order. */
+bool roundTrip(QLocalSocket& socket, const QByteArray& frames, const QList<quint32>& ids,
+               QList<PolicyProtocol::Reply>& replies, int timeoutMs, QString* error)
 {
-    QLocalSocket socket;
-    socket.connectToServer(m_socketPath);
-    if (!socket.waitForConnected(3000)) {
+    const auto fail = [&](const QString& message) {
         if (error) {
-            *error = QStringLiteral("Cannot connect to flashspartan-policyd");
+            *error = message;
         }
-        return {};
+        return false;
+    };
+
+    socket.readAll();  // nothing is owed on an idle connection
+    socket.write(frames);
+    if (!socket.waitForBytesWritten(kConnectTimeoutMs)) {
+        return fail(QStringLiteral("Policy daemon write timeout"));
     }
 
-    const QByteArray line = QJsonDocument(req).toJson(QJsonDocument::Compact) + '\n';
-    socket.write(line);
-    socket.flush();
-    if (!socket.waitForBytesWritten(3000)) {
-        if (error) {
-            *error = QStringLiteral("Policy daemon write timeout");
+    QByteArray buffer;
+    QElapsedTimer timer;
+    timer.start();
+    while (replies.size() < ids.size()) {
+        PolicyProtocol::Frame frame;
+        QString frameError;
+        if (PolicyProtocol::takeFrame(buffer, &frame, &frameError)) {
+            PolicyProtocol::Reply reply;
+            if (frame.type != FrameType::Reply || !PolicyProtocol::decodeReply(frame.payload, &reply)
+                || reply.id != ids.at(replies.size())) {
+                return fail(QStringLiteral("Invalid policy daemon response"));
+            }
+            replies.append(reply);
+            continue;
         }
-        return {};
+        if (!frameError.isEmpty()) {
+            return fail(frameError);
+        }
+        const qint64 left = timeoutMs - timer.elapsed();
+        if (left <= 0 || !socket.waitForReadyRead(static_cast<int>(left))) {
+            return fail(QStringLiteral("Policy daemon read timeout"));
+        }
+        buffer += socket.readAll();
     }
+    return true;
+}
 
-    if (!socket.waitForReadyRead(10000)) {
-        if (error) {
-            *error = QStringLiteral("Policy daemon read timeout");
+} // namespace
+
+PolicyDaemonClient::PolicyDaemonClient(QString socketPath)
+    : m_socketPath(socketPath.isEmpty() ? PolicyPaths::socketPath() : std::move(socketPath))
+{
+}
+
+PolicyProtocol::Reply PolicyDaemonClient::request(FrameType type,
+                                                  const PolicyProtocol::Request& req,
+                                                  QString* error) const
+{
+    const PolicyProtocol::Reply reply = exchange({{type, req}}, error).constFirst();
+    if (!reply.ok && error && !reply.error.isEmpty()) {
+        *error = reply.error;
+    }
+    return reply;
+}
+
+QList<PolicyProtocol::Reply> PolicyDaemonClient::exchange(QList<Call> calls, QString* error) const
+{
+    QMutexLocker lock(&m_connectionMutex);
+    QByteArray frames;
+    QList<quint32> ids;
+    int timeoutMs = kReplyTimeoutMs;
+    for (Call& call : calls) {
+        if (call.first == FrameType::ExportJson || call.first == FrameType::ImportJson) {
+            timeoutMs = kBulkReplyTimeoutMs;
         }
-        return {};
+        call.second.id = ++m_nextRequestId;
+        ids.append(call.second.id);
+        frames += PolicyProtocol::encodeFrame(call.first, PolicyProtocol::encodeRequest(call.second));
     }
 
-    const QByteArray resp = socket.readAll();
-    socket.disconnectFromServer();
+    QList<PolicyProtocol::Reply> replies;
+    const auto failed = [&]() {
+        replies.clear();
+        replies.resize(calls.size());
+        return replies;
+    };
 
-    const QJsonDocument doc = QJsonDocument::fromJson(resp.trimmed());
-    if (!doc.isObject()) {
-        if (error) {
-            *error = QStringLiteral("Invalid policy daemon response");
+    if (m_connection && m_connection->thread() != QThread::currentThread()) {
+        QLocalSocket socket;
+        if (connectSocket(socket, m_socketPath, error)
+            && roundTrip(socket, frames, ids, replies, timeoutMs, error)) {
+            return replies;
         }
-        return {};
+        return failed();
     }
-    return doc.object();
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        const bool reused = m_connection && m_connection->state() == QLocalSocket::ConnectedState;
+        if (!reused) {
+            m_connection = std::make_unique<QLocalSocket>();
+            if (!connectSocket(*m_connection, m_socketPath, error)) {
+                m_connection.reset();
+                break;
+            }
+        }
+        replies.clear();
+        if (roundTrip(*m_connection, frames, ids, replies, timeoutMs, error)) {
+            return replies;
+        }
+        m_connection.reset();
+        if (!reused || !replies.isEmpty()) {
+            break;  // only an idle connection policyd has dropped is worth one retry
+        }
+    }
+    return failed();
 }
 
 bool PolicyDaemonClient::ping(QString* error) const
 {
-    QJsonObject req;
-    req[QStringLiteral("op")] = QStringLiteral("ping");
-    const QJsonObject resp = request(req, error);
-    return resp.value(QStringLiteral("ok")).toBool();
+    return request(FrameType::Ping, {}, error).ok;
 }
 
 bool PolicyDaemonClient::load(QString* error)
 {
-    QJsonObject req;
-    req[QStringLiteral("op")] = QStringLiteral("load");
-    const QJsonObject resp = request(req, error);
-    return resp.value(QStringLiteral("ok")).toBool();
+    return request(FrameType::Load, {}, error).ok;
 }
 
 bool PolicyDaemonClient::reload(QString* error)
 {
-    QJsonObject req;
-    req[QStringLiteral("op")] = QStringLiteral("reload");
-    const QJsonObject resp = request(req, error);
-    return resp.value(QStringLiteral("ok")).toBool();
+    return request(FrameType::Reload, {}, error).ok;
 }
 
 PolicySnapshot PolicyDaemonClient::snapshot() const
 {
+    const PolicyDelta delta = changesSince(0, 0);
     PolicySnapshot snap;
-    QString err;
-    QJsonObject req;
-    req[QStringLiteral("op")] = QStringLiteral("snapshot");
-    const QJsonObject resp = request(req, &err);
-    if (!resp.value(QStringLiteral("ok")).toBool()) {
-        return snap;
-    }
+    snap.devices = delta.devices;
+    snap.blocks = delta.blocks;
+    snap.epoch = delta.epoch;
+    snap.generation = delta.generation;
+    return snap;
+}
 
-    const QJsonArray devices = resp[QStringLiteral("devices")].toArray();
-    for (const QJsonValue& v : devices) {
-        if (v.isObject()) {
-            snap.devices.append(DeviceRecord::fromJson(v.toObject()));
-        }
-    }
-    const QJsonArray blocks = resp[QStringLiteral("blocks")].toArray();
-    for (const QJsonValue& v : blocks) {
-        if (!v.isObject()) {
-            continue;
-        }
-        const QJsonObject o = v.toObject();
-        BlockedDriveEntry e;
-        e.driveKey = o[QStringLiteral("drive_key")].toString();
-        e.uniqueId = o[QStringLiteral("unique_id")].toString();
-        e.label = o[QStringLiteral("label")].toString();
-        e.blockedAt = QDateTime::fromString(o[QStringLiteral("blocked_at")].toString(),
-                                            Qt::ISODate);
-        snap.blocks.append(e);
+PolicyDelta PolicyDaemonClient::changesSince(quint64 epoch, quint64 generation) const
+{
+    PolicyProtocol::Request req;
+    req.epoch = epoch;
+    req.generation = generation;
+    const PolicyProtocol::Reply reply = request(FrameType::Changes, req);
+    if (!reply.ok || !reply.hasDelta) {
+        // Unreachable daemon: an empty epoch makes the next call a full resync.
+        return {};
     }
-    return snap;
+    return reply.delta;
 }
 
 bool PolicyDaemonClient::upsertDevice(const DeviceRecord& record, const QString& actor,
                                       const QString& reason)
 {
-    QString err;
-    QJsonObject req;
-    req[QStringLiteral("op")] = QStringLiteral("upsert_device");
-    req[QStringLiteral("actor")] = actor;
-    req[QStringLiteral("reason")] = reason;
-    req[QStringLiteral("record")] = record.toJson();
-    return request(req, &err).value(QStringLiteral("ok")).toBool();
+    PolicyProtocol::Request req;
+    req.actor = actor;
+    req.reason = reason;
+    req.hasRecord = true;
+    req.record = record;
+    return request(FrameType::UpsertDevice, req).ok;
 }
 
 bool PolicyDaemonClient::removeDevice(const QString& uniqueId, const QString& actor,
                                       const QString& reason)
 {
-    QString err;
-    QJsonObject req;
-    req[QStringLiteral("op")] = QStringLiteral("remove_device");
-    req[QStringLiteral("actor")] = actor;
-    req[QStringLiteral("reason")] = reason;
-    req[QStringLiteral("unique_id")] = uniqueId;
-    return request(req, &err).value(QStringLiteral("ok")).toBool();
+    PolicyProtocol::Request req;
+    req.actor = actor;
+    req.reason = reason;
+    req.uniqueId = uniqueId;
+    return request(FrameType::RemoveDevice, req).ok;
+}
+
+bool PolicyDaemonClient::upsertDevices(const QList<DeviceRecord>& records, const QString& actor,
+                                       const QString& reason)
+{
+    PolicyProtocol::Request req;
+    req.actor = actor;
+    req.reason = reason;
+    req.records = records;
+    return request(FrameType::UpsertMany, req).ok;
+}
+
+int PolicyDaemonClient::removeDevices(const QStringList& uniqueIds, const QString& actor,
+                                      const QString& reason)
+{
+    PolicyProtocol::Request req;
+    req.actor = actor;
+    req.reason = reason;
+    req.uniqueIds = uniqueIds;
+    const PolicyProtocol::Reply reply = request(FrameType::RemoveMany, req);
+    return reply.ok ? reply.count : -1;
 }
 
 bool PolicyDaemonClient::clearDevices(const QString& actor, const QString& reason)
 {
-    QString err;
-    QJsonObject req;
-    req[QStringLiteral("op")] = QStringLiteral("clear_devices");
-    req[QStringLiteral("actor")] = actor;
-    req[QStringLiteral("reason")] = reason;
-    return request(req, &err).value(QStringLiteral("ok")).toBool();
+    PolicyProtocol::Request req;
+    req.actor = actor;
+    req.reason = reason;
+    return request(FrameType::ClearDevices, req).ok;
 }
 
 bool PolicyDaemonClient::blockDrive(const QString& driveKey, const QString& uniqueId,
                                     const QString& label, const QString& actor)
 {
-    QString err;
-    QJsonObject req;
-    req[QStringLiteral("op")] = QStringLiteral("block_drive");
-    req[QStringLiteral("actor")] = actor;
-    req[QStringLiteral("drive_key")] = driveKey;
-    req[QStringLiteral("unique_id")] = uniqueId;
-    req[QStringLiteral("label")] = label;
-    return request(req, &err).value(QStringLiteral("ok")).toBool();
+    PolicyProtocol::Request req;
+    req.actor = actor;
+    req.driveKey = driveKey;
+    req.uniqueId = uniqueId;
+    req.label = label;
+    return request(FrameType::BlockDrive, req).ok;
 }
 
 bool PolicyDaemonClient::unblockDrive(const QString& driveKey, const QString& uniqueId,
                                       const QString& actor)
 {
-    QString err;
-    QJsonObject req;
-    req[QStringLiteral("op")] = QStringLiteral("unblock_drive");
-    req[QStringLiteral("actor")] = actor;
-    req[QStringLiteral("drive_key")] = driveKey;
-    req[QStringLiteral("unique_id")] = uniqueId;
-    return request(req, &err).value(QStringLiteral("ok")).toBool();
+    PolicyProtocol::Request req;
+    req.actor = actor;
+    req.driveKey = driveKey;
+    req.uniqueId = uniqueId;
+    return request(FrameType::UnblockDrive, req).ok;
 }
 
 bool PolicyDaemonClient::exportJson(const QString& path, bool prettyPrint, QString* error) const
 {
-    QJsonObject req;
-    req[QStringLiteral("op")] = QStringLiteral("export_json");
-    req[QStringLiteral("path")] = path;
-    req[QStringLiteral("pretty")] = prettyPrint;
-    return request(req, error).value(QStringLiteral("ok")).toBool();
+    PolicyProtocol::Request req;
+    req.path = path;
+    req.flag = prettyPrint;
+    return request(FrameType::ExportJson, req, error).ok;
 }
 
 int PolicyDaemonClient::importJson(const QString& path, bool merge, const QString& actor,
                                    QString* error)
 {
-    QJsonObject req;
-    req[QStringLiteral("op")] = QStringLiteral("import_json");
-    req[QStringLiteral("path")] = path;
-    req[QStringLiteral("merge")] = merge;
-    req[QStringLiteral("actor")] = actor;
-    const QJsonObject resp = request(req, error);
-    if (!resp.value(QStringLiteral("ok")).toBool()) {
-        return -1;
+    PolicyProtocol::Request req;
+    req.path = path;
+    req.flag = merge;
+    req.actor = actor;
+    const PolicyProtocol::Reply reply = request(FrameType::ImportJson, req, error);
+    return reply.ok ? reply.count : -1;
+}
+
+void PolicyDaemonClient::startChangeFeed()
+{
+    m_feed = std::make_unique<QLocalSocket>();
+    QLocalSocket* socket = m_feed.get();
+    QObject::connect(socket, &QLocalSocket::connected, socket, [this, socket]() {
+        PolicyProtocol::Request req;
+        req.epoch = m_feedEpoch;
+        req.generation = m_feedGeneration;
+        socket->write(PolicyProtocol::encodeFrame(FrameType::Subscribe, PolicyProtocol::encodeRequest(req)));
+    });
+    QObject::connect(socket, &QLocalSocket::readyRead, socket, [this]() { readFeed(); });
+    QObject::connect(socket, &QLocalSocket::disconnected, socket, [this]() { scheduleFeedReconnect(); });
+    QObject::connect(socket, &QLocalSocket::errorOccurred, socket, [this, socket]() {
+        if (socket->state() == QLocalSocket::UnconnectedState) {
+            scheduleFeedReconnect();
+        }
+    });
+    socket->connectToServer(m_socketPath);
+}
+
+void PolicyDaemonClient::readFeed()
+{
+    m_feedBuffer += m_feed->readAll();
+    PolicyProtocol::Frame frame;
+    QString err;
+    while (PolicyProtocol::takeFrame(m_feedBuffer, &frame, &err)) {
+        PolicyProtocol::Reply event;
+        if (frame.type != FrameType::Event || !PolicyProtocol::decodeReply(frame.payload, &event)
+            || !event.hasDelta) {
+            continue;
+        }
+        m_feedEpoch = event.delta.epoch;
+        m_feedGeneration = event.delta.generation;
+        publishChange(event.delta);
+    }
+    if (!err.isEmpty()) {
+        m_feed->abort();  // resubscribes from the last generation seen
+    }
+}
+
+void PolicyDaemonClient::scheduleFeedReconnect()
+{
+    if (m_feedRetryPending) {
+        return;
     }
-    return resp.value(QStringLiteral("count")).toInt(-1);
+    m_feedRetryPending = true;
+    QLocalSocket* socket = m_feed.get();
+    QTimer::singleShot(kFeedRetryMs, socket, [this, socket]() {
+        m_feedRetryPending = false;
+        m_feedBuffer.clear();
+        socket->connectToServer(m_socketPath);
+    });
 }
 
 } // namespace FlashSpartan::Policy
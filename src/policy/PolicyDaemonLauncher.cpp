@@ -4,8 +4,10 @@
 
 #include <QCoreApplication>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
+#include <QLocalSocket>
 #include <QProcess>
 #include <QStandardPaths>
 #include <QThread>
@@ -16,6 +18,21 @@
 
 namespace FlashSpartan::Policy {
 
+namespace {
+
+constexpr int kStartTimeoutMs = 3000;
+constexpr int kStartPollMs = 10;
+
+/** Whether something listens on the policy socket; it may still be loading the store. */
+bool socketAccepts()
+{
+    QLocalSocket socket;
+    socket.connectToServer(PolicyPaths::socketPath());
+    return socket.waitForConnected(kStartPollMs);
+}
+
+} // namespace
+
 QString PolicyDaemonLauncher::daemonExecutablePath()
 {
     const QByteArray compiled = QByteArray(FLASHSPARTAN_POLICYD_PATH);
@@ -44,10 +61,19 @@ QString PolicyDaemonLauncher::daemonExecutablePath()
 
 bool PolicyDaemonLauncher::ensureRunning(QString* error)
 {
+    // With flashspartan-policyd.socket the socket is always there: the connection starts
+    // the daemon and the ping is answered once it has loaded the store.
     PolicyDaemonClient client;
     if (client.ping()) {
         return true;
     }
+    if (socketAccepts()) {
+        // Someone owns the socket (a slow load, or systemd); a second daemon would unlink it
+        if (error) {
+            *error = QStringLiteral("flashspartan-policyd did not answer");
+        }
+        return false;
+    }
 
     const QString daemon = daemonExecutablePath();
     if (daemon.isEmpty() || !QFile::exists(daemon)) {
@@ -67,11 +93,18 @@ bool PolicyDaemonLauncher::ensureRunning(QString* error)
         return false;
     }
 
-    for (int i = 0; i < 30; ++i) {
-        if (client.ping()) {
-            return true;
+    // policyd listens before it loads, so wait only for the socket; the ping then returns
+    // as soon as the load is done instead of at the next poll.
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < kStartTimeoutMs) {
+        if (socketAccepts()) {
+            if (client.ping()) {
+                return true;
+            }
+            break;
         }
-        QThread::msleep(100);
+        QThread::msleep(kStartPollMs);
     }
 
     if (error) {
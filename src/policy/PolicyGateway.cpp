@@ -7,6 +7,21 @@
 
 namespace FlashSpartan::Policy {
 
+void PolicyGateway::addChangeListener(ChangeListener listener)
+{
+    m_listeners.push_back(std::move(listener));
+    if (m_listeners.size() == 1) {
+        startChangeFeed();
+    }
+}
+
+void PolicyGateway::publishChange(const PolicyDelta& delta) const
+{
+    for (const ChangeListener& listener : m_listeners) {
+        listener(delta);
+    }
+}
+
 std::unique_ptr<PolicyGateway> PolicyGateway::createInProcess(const QString& storePath)
 {
     return std::make_unique<PolicyInProcessGateway>(storePath);
@@ -1,9 +1,6 @@
 #include "policy/PolicyInProcessGateway.h"
 
-#include <QFile>
-#include <QJsonArray>
-#include <QJsonDocument>
-#include <QJsonObject>
+#include "policy/PolicyJsonStream.h"
 
 namespace FlashSpartan::Policy {
 
@@ -14,12 +11,16 @@ PolicyInProcessGateway::PolicyInProcessGateway(QString storePath)
 
 bool PolicyInProcessGateway::load(QString* error)
 {
-    return m_engine.load(error);
+    const bool ok = m_engine.load(error);
+    queueChange();
+    return ok;
 }
 
 bool PolicyInProcessGateway::reload(QString* error)
 {
-    return m_engine.load(error);
+    const bool ok = m_engine.load(error);
+    queueChange();
+    return ok;
 }
 
 PolicySnapshot PolicyInProcessGateway::snapshot() const
@@ -27,96 +28,107 @@ PolicySnapshot PolicyInProcessGateway::snapshot() const
     return m_engine.snapshot();
 }
 
+PolicyDelta PolicyInProcessGateway::changesSince(quint64 epoch, quint64 generation) const
+{
+    return m_engine.changesSince(epoch, generation);
+}
+
 bool PolicyInProcessGateway::upsertDevice(const DeviceRecord& record, const QString& actor,
                                           const QString& reason)
 {
-    return m_engine.upsertDevice(record, actor, reason);
+    const bool ok = m_engine.upsertDevice(record, actor, reason);
+    queueChange();
+    return ok;
 }
 
 bool PolicyInProcessGateway::removeDevice(const QString& uniqueId, const QString& actor,
                                           const QString& reason)
 {
-    return m_engine.removeDevice(uniqueId, actor, reason);
+    const bool ok = m_engine.removeDevice(uniqueId, actor, reason);
+    queueChange();
+    return ok;
+}
+
+bool PolicyInProcessGateway::upsertDevices(const QList<DeviceRecord>& records,
+                                           const QString& actor, const QString& reason)
+{
+    const bool ok = m_engine.upsertDevices(records, actor, reason);
+    queueChange();
+    return ok;
+}
+
+int PolicyInProcessGateway::removeDevices(const QStringList& uniqueIds, const QString& actor,
+                                          const QString& reason)
+{
+    const int removed = m_engine.removeDevices(uniqueIds, actor, reason);
+    queueChange();
+    return removed;
 }
 
 bool PolicyInProcessGateway::clearDevices(const QString& actor, const QString& reason)
 {
-    return m_engine.clearDevices(actor, reason);
+    const bool ok = m_engine.clearDevices(actor, reason);
+    queueChange();
+    return ok;
 }
 
 bool PolicyInProcessGateway::blockDrive(const QString& driveKey, const QString& uniqueId,
                                         const QString& label, const QString& actor)
 {
-    return m_engine.blockDrive(driveKey, uniqueId, label, actor);
+    const bool ok = m_engine.blockDrive(driveKey, uniqueId, label, actor);
+    queueChange();
+    return ok;
 }
 
 bool PolicyInProcessGateway::unblockDrive(const QString& driveKey, const QString& uniqueId,
                                           const QString& actor)
 {
-    return m_engine.unblockDrive(driveKey, uniqueId, actor);
+    const bool ok = m_engine.unblockDrive(driveKey, uniqueId, actor);
+    queueChange();
+    return ok;
 }
 
 bool PolicyInProcessGateway::exportJson(const QString& path, bool prettyPrint,
                                         QString* error) const
 {
-    const PolicySnapshot snap = m_engine.snapshot();
-    QJsonArray arr;
-    for (const DeviceRecord& rec : snap.devices) {
-        arr.append(rec.toJson());
-    }
-    QJsonObject root;
-    root[QStringLiteral("version")] = QStringLiteral("1.0");
-    root[QStringLiteral("devices")] = arr;
-    QFile f(path);
-    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-        if (error) {
-            *error = QStringLiteral("Cannot write export file");
-        }
-        return false;
-    }
-    f.write(QJsonDocument(root).toJson(prettyPrint ? QJsonDocument::Indented
-                                                     : QJsonDocument::Compact));
-    return true;
+    return PolicyJsonStream::write(path, m_engine.sharedSnapshot()->devices, prettyPrint, error);
 }
 
 int PolicyInProcessGateway::importJson(const QString& path, bool merge, const QString& actor,
                                        QString* error)
 {
-    QFile f(path);
-    if (!f.open(QIODevice::ReadOnly)) {
-        if (error) {
-            *error = QStringLiteral("Cannot open import file");
-        }
-        return -1;
-    }
-    const QJsonDocument doc = QJsonDocument::fromJson(f.readAll());
-    if (!doc.isObject()) {
-        if (error) {
-            *error = QStringLiteral("Invalid import JSON");
-        }
-        return -1;
-    }
+    const int count = PolicyJsonStream::importInto(m_engine, path, merge, actor, error);
+    queueChange();
+    return count;
+}
 
-    PolicySnapshot snap = merge ? m_engine.snapshot() : PolicySnapshot{};
-    if (!merge) {
-        m_engine.clearDevices(actor, QStringLiteral("import replace"));
-    }
+void PolicyInProcessGateway::startChangeFeed()
+{
+    m_feedContext = std::make_unique<QObject>();
+    QMutexLocker lock(&m_feedMutex);
+    const PolicySnapshot snap = m_engine.snapshot();
+    m_feedEpoch = snap.epoch;
+    m_feedGeneration = snap.generation;
+}
 
-    int count = 0;
-    const QJsonArray arr = doc.object()[QStringLiteral("devices")].toArray();
-    for (const QJsonValue& v : arr) {
-        if (!v.isObject()) {
-            continue;
-        }
-        DeviceRecord rec = DeviceRecord::fromJson(v.toObject());
-        if (rec.uniqueId.isEmpty()) {
-            continue;
-        }
-        if (m_engine.upsertDevice(rec, actor, QStringLiteral("import"))) {
-            ++count;
-        }
+void PolicyInProcessGateway::queueChange()
+{
+    if (!m_feedContext) {
+        return;
     }
-    return count;
+    PolicyDelta delta;
+    {
+        QMutexLocker lock(&m_feedMutex);
+        delta = m_engine.changesSince(m_feedEpoch, m_feedGeneration);
+        m_feedEpoch = delta.epoch;
+        m_feedGeneration = delta.generation;
+    }
+    if (delta.isEmpty()) {
+        return;
+    }
+    // Queued, so a caller's own listener sees the change after its write has returned.
+    QMetaObject::invokeMethod(
+        m_feedContext.get(), [this, delta]() { publishChange(delta); }, Qt::QueuedConnection);
 }
 
 } // namespace FlashSpartan::Policy
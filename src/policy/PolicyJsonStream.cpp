@@ -0,0 +1,272 @@
+#include "policy/PolicyJsonStream.h"
+
+#include "policy/PolicyStoreEngine.h"
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+namespace FlashSpartan::Policy {
+
+namespace {
+
+const QByteArray kLinesPrefix = QByteArrayLiteral("{\"format\":\"flashspartan-devices\"");
+const QByteArray kLinesHeader = kLinesPrefix + QByteArrayLiteral(",\"version\":\"1.0\"}");
+
+bool fail(QString* error, const QString& message)
+{
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
+
+bool isJsonLines(const QString& path)
+{
+    return path.endsWith(QStringLiteral(".jsonl"), Qt::CaseInsensitive);
+}
+
+/** Indents every line of @p json by @p spaces. */
+QByteArray indented(const QByteArray& json, int spaces)
+{
+    const QByteArray pad(spaces, ' ');
+    QByteArrayList lines;
+    for (const QByteArray& line : json.split('\n')) {
+        if (!line.isEmpty()) {
+            lines.append(pad + line);
+        }
+    }
+    return lines.join('\n');
+}
+
+/**
+ * Cuts the elements of the top-level "devices" array out of a JSON document fed in
+ * chunks, tracking only strings and nesting depth.
+ */
+class DevicesArraySplitter {
+public:
+    /** Feeds @p chunk; each complete element is passed to @p element. False on malformed input. */
+    bool feed(const QByteArray& chunk, const std::function<bool(const QByteArray&)>& element)
+    {
+        for (const char c : chunk) {
+            if (m_capturing) {
+                m_element += c;
+                if (m_element.size() > PolicyJsonStream::kMaxRecordBytes) {
+                    return false;
+                }
+            } else if (m_depth == 1 && m_inString) {
+                m_key += c;
+            }
+            if (m_inString) {
+                if (m_escape) {
+                    m_escape = false;
+                } else if (c == '\\') {
+                    m_escape = true;
+                } else if (c == '"') {
+                    m_inString = false;
+                    if (m_depth == 1 && !m_capturing) {
+                        m_key.chop(1);  // the closing quote
+                    }
+                }
+                continue;
+            }
+            switch (c) {
+            case '"':
+                m_inString = true;
+                if (m_depth == 1) {
+                    m_key.clear();
+                }
+                break;
+            case '{':
+            case '[':
+                if (m_inDevices && m_depth == 2 && c == '{') {
+                    m_capturing = true;
+                    m_element = QByteArray(1, c);
+                }
+                if (m_depth == 1 && c == '[' && m_key == "devices") {
+                    m_inDevices = true;
+                }
+                ++m_depth;
+                break;
+            case '}':
+            case ']':
+                if (--m_depth < 0) {
+                    return false;
+                }
+                if (m_capturing && m_depth == 2) {
+                    m_capturing = false;
+                    if (!element(m_element)) {
+                        return false;
+                    }
+                    m_element.clear();
+                }
+                if (m_depth == 1) {
+                    m_inDevices = false;
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool finished() const { return m_depth == 0 && !m_inString; }
+
+private:
+    int m_depth = 0;
+    bool m_inString = false;
+    bool m_escape = false;
+    bool m_inDevices = false;
+    bool m_capturing = false;
+    QByteArray m_key;
+    QByteArray m_element;
+};
+
+} // namespace
+
+bool PolicyJsonStream::write(const QString& path, const QList<DeviceRecord>& devices,
+                             bool prettyPrint, QString* error)
+{
+    QSaveFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) {
+        return fail(error, QStringLiteral("Cannot write export file"));
+    }
+    const bool lines = isJsonLines(path);
+    QByteArray buffer;
+    const auto flush = [&](bool force) {
+        if ((force || buffer.size() >= kWriteChunkBytes) && !buffer.isEmpty()) {
+            if (f.write(buffer) != buffer.size()) {
+                return false;
+            }
+            buffer.clear();
+        }
+        return true;
+    };
+
+    if (lines) {
+        buffer += kLinesHeader + '\n';
+    } else {
+        buffer += prettyPrint ? QByteArrayLiteral("{\n    \"version\": \"1.0\",\n    \"devices\": [")
+                              : QByteArrayLiteral("{\"version\":\"1.0\",\"devices\":[");
+    }
+    bool first = true;
+    for (const DeviceRecord& rec : devices) {
+        const QJsonDocument doc(rec.toJson());
+        if (lines) {
+            buffer += doc.toJson(QJsonDocument::Compact) + '\n';
+        } else if (prettyPrint) {
+            buffer += first ? "\n" : ",\n";
+            buffer += indented(doc.toJson(QJsonDocument::Indented), 8);
+        } else {
+            if (!first) {
+                buffer += ',';
+            }
+            buffer += doc.toJson(QJsonDocument::Compact);
+        }
+        first = false;
+        if (!flush(false)) {
+            return fail(error, QStringLiteral("Cannot write export file"));
+        }
+    }
+    if (!lines) {
+        buffer += prettyPrint ? (first ? QByteArrayLiteral("]\n}\n") : QByteArrayLiteral("\n    ]\n}\n"))
+                              : QByteArrayLiteral("]}");
+    }
+    if (!flush(true) || !f.commit()) {
+        return fail(error, QStringLiteral("Cannot write export file"));
+    }
+    return true;
+}
+
+int PolicyJsonStream::read(const QString& path,
+                           const std::function<bool(const QList<DeviceRecord>&)>& batch,
+                           QString* error)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        fail(error, QStringLiteral("Cannot open import file"));
+        return -1;
+    }
+
+    int count = 0;
+    bool stopped = false;
+    QList<DeviceRecord> pending;
+    const auto deliver = [&]() {
+        if (pending.isEmpty() || stopped) {
+            return !stopped;
+        }
+        if (!batch(pending)) {
+            stopped = true;
+            return false;
+        }
+        count += static_cast<int>(pending.size());
+        pending.clear();
+        return true;
+    };
+    const auto take = [&](const QByteArray& json) {
+        const QJsonDocument doc = QJsonDocument::fromJson(json);
+        if (!doc.isObject()) {
+            return false;
+        }
+        DeviceRecord rec = DeviceRecord::fromJson(doc.object());
+        if (!rec.uniqueId.isEmpty()) {
+            pending.append(std::move(rec));
+        }
+        return pending.size() < kImportBatch || deliver();
+    };
+
+    if (f.peek(kLinesPrefix.size()) == kLinesPrefix) {
+        f.readLine(kMaxRecordBytes);  // header
+        while (!f.atEnd() && !stopped) {
+            const QByteArray line = f.readLine(kMaxRecordBytes).trimmed();
+            if (line.isEmpty()) {
+                continue;
+            }
+            if (!take(line) && !stopped) {
+                fail(error, QStringLiteral("Invalid import JSON"));
+                return -1;
+            }
+        }
+    } else {
+        DevicesArraySplitter splitter;
+        while (!f.atEnd() && !stopped) {
+            if (!splitter.feed(f.read(kWriteChunkBytes), take) && !stopped) {
+                fail(error, QStringLiteral("Invalid import JSON"));
+                return -1;
+            }
+        }
+        if (!stopped && !splitter.finished()) {
+            fail(error, QStringLiteral("Invalid import JSON"));
+            return -1;
+        }
+    }
+    deliver();
+    return count;
+}
+
+int PolicyJsonStream::importInto(PolicyStoreEngine& engine, const QString& path, bool merge,
+                                 const QString& actor, QString* error)
+{
+    bool cleared = merge;
+    const auto clear = [&]() {
+        if (!cleared) {
+            cleared = true;
+            engine.clearDevices(actor, QStringLiteral("import replace"));
+        }
+    };
+    const int count = read(
+        path,
+        [&](const QList<DeviceRecord>& batch) {
+            clear();
+            return engine.upsertDevices(batch, actor, QStringLiteral("import"));
+        },
+        error);
+    if (count == 0) {
+        clear();
+    }
+    return count;
+}
+
+} // namespace FlashSpartan::Policy
@@ -3,16 +3,15 @@
 #include "AppPaths.h"
 
 #include <QDir>
-#include <QProcessEnvironment>
 #include <QStandardPaths>
 
 namespace FlashSpartan::Policy {
 
 QString PolicyPaths::configDir()
 {
-    const QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
-    if (env.contains(QStringLiteral("FLASHSPARTAN_POLICY_CONFIG"))) {
-        return env.value(QStringLiteral("FLASHSPARTAN_POLICY_CONFIG"));
+    // Looked up on every audit append: read the one variable, not the whole environment.
+    if (qEnvironmentVariableIsSet("FLASHSPARTAN_POLICY_CONFIG")) {
+        return qEnvironmentVariable("FLASHSPARTAN_POLICY_CONFIG");
     }
     return AppPaths::configDir();
 }
@@ -32,6 +31,16 @@ QString PolicyPaths::auditLogPath()
     return configDir() + QStringLiteral("/policy-audit.log");
 }
 
+QString PolicyPaths::replicationConfigPath()
+{
+    return configDir() + QStringLiteral("/replication.json");
+}
+
+QString PolicyPaths::watchManifestDirectory()
+{
+    return configDir() + QStringLiteral("/manifests");
+}
+
 QString PolicyPaths::legacyDevicesJsonPath()
 {
     const QString base = QStandardPaths::writableLocation(QStandardPaths::ConfigLocation);
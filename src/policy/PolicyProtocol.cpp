@@ -0,0 +1,208 @@
+#include "policy/PolicyProtocol.h"
+
+#include <QCborMap>
+#include <QCborValue>
+#include <QDataStream>
+#include <QIODevice>
+#include <QJsonObject>
+
+namespace FlashSpartan::Policy::PolicyProtocol {
+
+namespace {
+
+void prepare(QDataStream& stream)
+{
+    stream.setVersion(QDataStream::Qt_6_4);
+    stream.setByteOrder(QDataStream::LittleEndian);
+}
+
+void writeDevice(QDataStream& out, const DeviceRecord& rec)
+{
+    out << QCborValue::fromJsonValue(rec.toJson()).toCbor();
+}
+
+bool readDevice(QDataStream& in, DeviceRecord& rec)
+{
+    QByteArray cbor;
+    in >> cbor;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    rec = DeviceRecord::fromJson(QCborValue::fromCbor(cbor).toMap().toJsonObject());
+    return !rec.uniqueId.isEmpty();
+}
+
+void writeBlock(QDataStream& out, const BlockedDriveEntry& e)
+{
+    out << e.driveKey << e.uniqueId << e.label << e.blockedAt;
+}
+
+void readBlock(QDataStream& in, BlockedDriveEntry& e)
+{
+    in >> e.driveKey >> e.uniqueId >> e.label >> e.blockedAt;
+}
+
+} // namespace
+
+QByteArray encodeFrame(FrameType type, const QByteArray& payload)
+{
+    QByteArray frame;
+    frame.reserve(kHeaderBytes + payload.size());
+    QDataStream out(&frame, QIODevice::WriteOnly);
+    prepare(out);
+    out << quint8(type) << quint32(payload.size());
+    if (!payload.isEmpty()) {
+        out.writeRawData(payload.constData(), static_cast<int>(payload.size()));
+    }
+    return frame;
+}
+
+bool takeFrame(QByteArray& buffer, Frame* out, QString* error)
+{
+    if (buffer.size() < kHeaderBytes) {
+        return false;
+    }
+    QDataStream header(buffer);
+    prepare(header);
+    quint8 type = 0;
+    quint32 length = 0;
+    header >> type >> length;
+    if (type < quint8(FrameType::Ping) || type > quint8(FrameType::Manifest)
+        || length > kMaxPayloadBytes) {
+        if (error) {
+            *error = QStringLiteral("Malformed policy frame");
+        }
+        return false;
+    }
+    if (buffer.size() < kHeaderBytes + static_cast<qsizetype>(length)) {
+        return false;
+    }
+    if (out) {
+        out->type = static_cast<FrameType>(type);
+        out->payload = buffer.mid(kHeaderBytes, static_cast<qsizetype>(length));
+    }
+    buffer.remove(0, kHeaderBytes + static_cast<qsizetype>(length));
+    return true;
+}
+
+QByteArray encodeRequest(const Request& request)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    prepare(out);
+    out << kVersion << request.id << request.actor << request.reason << request.uniqueId << request.driveKey
+        << request.label << request.path << request.flag << request.epoch << request.generation
+        << request.hasRecord;
+    if (request.hasRecord) {
+        writeDevice(out, request.record);
+    }
+    out << quint32(request.records.size());
+    for (const DeviceRecord& rec : request.records) {
+        writeDevice(out, rec);
+    }
+    out << request.uniqueIds;
+    return payload;
+}
+
+bool decodeRequest(const QByteArray& payload, Request* out)
+{
+    QDataStream in(payload);
+    prepare(in);
+    quint16 version = 0;
+    in >> version;
+    if (version != kVersion) {
+        return false;
+    }
+    Request r;
+    in >> r.id >> r.actor >> r.reason >> r.uniqueId >> r.driveKey >> r.label >> r.path >> r.flag
+       >> r.epoch >> r.generation >> r.hasRecord;
+    if (r.hasRecord && !readDevice(in, r.record)) {
+        return false;
+    }
+    quint32 recordCount = 0;
+    in >> recordCount;
+    for (quint32 i = 0; i < recordCount && in.status() == QDataStream::Ok; ++i) {
+        DeviceRecord rec;
+        if (!readDevice(in, rec)) {
+            return false;
+        }
+        r.records.append(rec);
+    }
+    in >> r.uniqueIds;
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    *out = r;
+    return true;
+}
+
+QByteArray encodeReply(const Reply& reply)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    prepare(out);
+    out << reply.id << reply.ok << reply.error << reply.count << reply.hasDelta;
+    if (!reply.hasDelta) {
+        return payload;
+    }
+    const PolicyDelta& d = reply.delta;
+    out << d.epoch << d.generation << d.full << quint32(d.devices.size());
+    for (const DeviceRecord& rec : d.devices) {
+        writeDevice(out, rec);
+    }
+    out << d.removedIds << d.blocksChanged << quint32(d.blocks.size());
+    for (const BlockedDriveEntry& e : d.blocks) {
+        writeBlock(out, e);
+    }
+    return payload;
+}
+
+bool decodeReply(const QByteArray& payload, Reply* out)
+{
+    QDataStream in(payload);
+    prepare(in);
+    Reply r;
+    in >> r.id >> r.ok >> r.error >> r.count >> r.hasDelta;
+    if (r.hasDelta) {
+        PolicyDelta& d = r.delta;
+        quint32 deviceCount = 0;
+        in >> d.epoch >> d.generation >> d.full >> deviceCount;
+        for (quint32 i = 0; i < deviceCount && in.status() == QDataStream::Ok; ++i) {
+            DeviceRecord rec;
+            if (readDevice(in, rec)) {
+                d.devices.append(rec);
+            }
+        }
+        quint32 blockCount = 0;
+        in >> d.removedIds >> d.blocksChanged >> blockCount;
+        for (quint32 i = 0; i < blockCount && in.status() == QDataStream::Ok; ++i) {
+            BlockedDriveEntry e;
+            readBlock(in, e);
+            d.blocks.append(e);
+        }
+    }
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+    *out = r;
+    return true;
+}
+
+QByteArray encodeManifest(const QString& digest, const QByteArray& data)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    prepare(out);
+    out << digest << data;
+    return payload;
+}
+
+bool decodeManifest(const QByteArray& payload, QString* digest, QByteArray* data)
+{
+    QDataStream in(payload);
+    prepare(in);
+    in >> *digest >> *data;
+    return in.status() == QDataStream::Ok;
+}
+
+} // namespace FlashSpartan::Policy::PolicyProtocol
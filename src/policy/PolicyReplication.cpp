@@ -0,0 +1,362 @@
+#include "policy/PolicyReplication.h"
+
+#include "policy/PolicyPaths.h"
+#include "policy/PolicyProtocol.h"
+#include "policy/PolicyStoreEngine.h"
+
+#include "BlockHashFile.h"
+#include "WatchManifestFile.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMessageAuthenticationCode>
+#include <QSet>
+#include <QtEndian>
+
+#include <algorithm>
+#include <memory>
+#include <tuple>
+
+namespace FlashSpartan::Policy::PolicyReplication {
+
+namespace {
+
+constexpr qsizetype kLengthBytes = 4;
+constexpr quint32 kMaxSealedBytes =
+    PolicyProtocol::kHeaderBytes + PolicyProtocol::kMaxPayloadBytes + kTagBytes;
+
+QByteArray tagFor(const QByteArray& key, const QByteArray& nonce, quint64 seq, Direction direction,
+                  const char* frame, qsizetype frameBytes)
+{
+    char header[9];
+    qToLittleEndian(seq, header);
+    header[8] = static_cast<char>(direction);
+    QMessageAuthenticationCode mac(QCryptographicHash::Sha256, key);
+    mac.addData(nonce);
+    mac.addData(header, sizeof header);
+    mac.addData(frame, frameBytes);
+    return mac.result();
+}
+
+/** Compares every byte, so a forged tag takes as long to reject wherever it differs. */
+bool sameTag(const char* a, const char* b)
+{
+    unsigned char diff = 0;
+    for (int i = 0; i < kTagBytes; ++i) {
+        diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+    }
+    return diff == 0;
+}
+
+/** Whether @p a's policy wins a tie with @p b: the stricter one, then a fixed order. */
+bool winsPolicyTie(const DeviceRecord& a, const DeviceRecord& b)
+{
+    const auto key = [](const DeviceRecord& r) {
+        return std::make_tuple(r.trustLevel, r.autoMount, static_cast<int>(r.verificationProfile),
+                               r.notes);
+    };
+    return key(a) < key(b);
+}
+
+void takePolicy(DeviceRecord& into, const DeviceRecord& from)
+{
+    into.trustLevel = from.trustLevel;
+    into.autoMount = from.autoMount;
+    into.notes = from.notes;
+    into.verificationProfile = from.verificationProfile;
+    into.policyChangedAt = from.policyChangedAt;
+}
+
+void takeBaseline(DeviceRecord& into, const DeviceRecord& from)
+{
+    into.hash = from.hash;
+    into.hashAlgorithm = from.hashAlgorithm;
+    into.hashScope = from.hashScope;
+    into.hashScanMode = from.hashScanMode;
+    into.lastHashed = from.lastHashed;
+    into.hashDurationMs = from.hashDurationMs;
+    into.prescreenHash = from.prescreenHash;
+    into.prescreenAlgorithm = from.prescreenAlgorithm;
+    into.blockHashes = from.blockHashes;
+    into.blockHashesSha256 = from.blockHashesSha256;
+    into.blockSize = from.blockSize;
+    into.watchManifest = from.watchManifest;
+    into.lastManifestRoot = from.lastManifestRoot;
+}
+
+QString blockKey(const BlockedDriveEntry& e)
+{
+    return e.driveKey + QLatin1Char('\n') + e.uniqueId;
+}
+
+/** Matched as the store matches blocks: by drive key or unique id. */
+bool isBlocked(const QList<BlockedDriveEntry>& blocks, const BlockedDriveEntry& e)
+{
+    return std::any_of(blocks.cbegin(), blocks.cend(), [&e](const BlockedDriveEntry& b) {
+        return (!e.driveKey.isEmpty() && b.driveKey == e.driveKey)
+               || (!e.uniqueId.isEmpty() && b.uniqueId == e.uniqueId);
+    });
+}
+
+} // namespace
+
+bool loadConfig(Config* out, QString* error, const QString& path)
+{
+    const QString file = path.isEmpty() ? PolicyPaths::replicationConfigPath() : path;
+    *out = Config();
+    QFile f(file);
+    if (!f.exists()) {
+        return true;
+    }
+    const auto fail = [error, &file](const QString& why) {
+        if (error) {
+            *error = QStringLiteral("%1: %2").arg(file, why);
+        }
+        return false;
+    };
+    if (!f.open(QIODevice::ReadOnly)) {
+        return fail(f.errorString());
+    }
+    QJsonParseError parseError;
+    const QJsonDocument doc = QJsonDocument::fromJson(f.readAll(), &parseError);
+    if (!doc.isObject()) {
+        return fail(parseError.errorString());
+    }
+    const QJsonObject obj = doc.object();
+    const int port = obj["listen_port"].toInt();
+    if (port < 0 || port > 65535) {
+        return fail(QStringLiteral("listen_port out of range"));
+    }
+    Config config;
+    config.listenPort = static_cast<quint16>(port);
+    for (const QJsonValue& peer : obj["peers"].toArray()) {
+        if (!peer.toString().isEmpty()) {
+            config.peers.append(peer.toString());
+        }
+    }
+    for (const QJsonValue& server : obj["baseline_servers"].toArray()) {
+        if (!server.toString().isEmpty()) {
+            config.baselineServers.append(server.toString());
+        }
+    }
+    const QByteArray hex = obj["key"].toString().toLatin1();
+    config.key = QByteArray::fromHex(hex);
+    if (config.key.size() < kMinKeyBytes || config.key.size() * 2 != hex.size()) {
+        return fail(QStringLiteral("key must be at least %1 bytes of hex").arg(kMinKeyBytes));
+    }
+    *out = config;
+    return true;
+}
+
+QByteArray seal(const QByteArray& key, const QByteArray& nonce, quint64 seq, Direction direction,
+                const QByteArray& frame)
+{
+    QByteArray sealed(kLengthBytes, Qt::Uninitialized);
+    qToLittleEndian(static_cast<quint32>(kTagBytes + frame.size()), sealed.data());
+    sealed.reserve(kLengthBytes + kTagBytes + frame.size());
+    sealed += tagFor(key, nonce, seq, direction, frame.constData(), frame.size());
+    sealed += frame;
+    return sealed;
+}
+
+bool unseal(QByteArray& buffer, const QByteArray& key, const QByteArray& nonce, quint64 seq,
+            Direction direction, QByteArray* frame, QString* error)
+{
+    if (buffer.size() < kLengthBytes) {
+        return false;
+    }
+    const quint32 length = qFromLittleEndian<quint32>(buffer.constData());
+    if (length < static_cast<quint32>(kTagBytes) || length > kMaxSealedBytes) {
+        if (error) {
+            *error = QStringLiteral("Malformed replication message");
+        }
+        return false;
+    }
+    if (buffer.size() < kLengthBytes + static_cast<qsizetype>(length)) {
+        return false;
+    }
+    const char* tag = buffer.constData() + kLengthBytes;
+    const char* body = tag + kTagBytes;
+    const qsizetype bodyBytes = static_cast<qsizetype>(length) - kTagBytes;
+    if (!sameTag(tag, tagFor(key, nonce, seq, direction, body, bodyBytes).constData())) {
+        if (error) {
+            *error = QStringLiteral("Replication message failed authentication");
+        }
+        return false;
+    }
+    if (frame) {
+        *frame = QByteArray(body, bodyBytes);
+    }
+    buffer.remove(0, kLengthBytes + length);
+    return true;
+}
+
+DeviceRecord mergeRecord(const DeviceRecord& local, const DeviceRecord& incoming)
+{
+    DeviceRecord merged = local;
+
+    if (incoming.policyChangedAt > local.policyChangedAt
+        || (incoming.policyChangedAt == local.policyChangedAt && !local.samePolicyAs(incoming)
+            && winsPolicyTie(incoming, local))) {
+        takePolicy(merged, incoming);
+    }
+
+    merged = mergeBaseline(merged, incoming);
+
+    if (incoming.firstSeen.isValid()
+        && (!local.firstSeen.isValid() || incoming.firstSeen < local.firstSeen)) {
+        merged.firstSeen = incoming.firstSeen;
+    }
+    if (incoming.lastSeen > local.lastSeen) {
+        merged.lastSeen = incoming.lastSeen;
+        merged.lastKnownInfo = incoming.lastKnownInfo;
+    }
+
+    if (merged.tunedBufferSizeKB == 0) {
+        merged.tunedBufferSizeKB = incoming.tunedBufferSizeKB;
+    }
+    if (merged.readProfile.isEmpty()) {
+        merged.readProfile = incoming.readProfile;
+    }
+    if (merged.capacityCheck.isEmpty()) {
+        merged.capacityCheck = incoming.capacityCheck;
+    }
+    return merged;
+}
+
+DeviceRecord mergeBaseline(const DeviceRecord& local, const DeviceRecord& incoming)
+{
+    DeviceRecord merged = local;
+    if (incoming.lastHashed > local.lastHashed
+        || (incoming.lastHashed == local.lastHashed && incoming.hash < local.hash)) {
+        takeBaseline(merged, incoming);
+    }
+    return merged;
+}
+
+QStringList missingManifests(const PolicyDelta& delta, const QString& directory)
+{
+    QStringList missing;
+    for (const DeviceRecord& rec : delta.devices) {
+        const QString& digest = rec.watchManifest.filesSha256;
+        if (!digest.isEmpty() && !missing.contains(digest)
+            && !QFileInfo::exists(WatchManifestFile::pathFor(directory, digest))) {
+            missing.append(digest);
+        }
+        const QString& blocks = rec.blockHashesSha256;
+        if (!blocks.isEmpty() && !missing.contains(blocks)
+            && !QFileInfo::exists(BlockHashFile::pathFor(directory, blocks))) {
+            missing.append(blocks);
+        }
+    }
+    return missing;
+}
+
+BlockChanges diffBlocks(const QList<BlockedDriveEntry>& before, const QList<BlockedDriveEntry>& after)
+{
+    QSet<QString> beforeKeys;
+    for (const BlockedDriveEntry& e : before) {
+        beforeKeys.insert(blockKey(e));
+    }
+    QSet<QString> afterKeys;
+    BlockChanges changes;
+    for (const BlockedDriveEntry& e : after) {
+        afterKeys.insert(blockKey(e));
+        if (!beforeKeys.contains(blockKey(e))) {
+            changes.blocked.append(e);
+        }
+    }
+    for (const BlockedDriveEntry& e : before) {
+        if (!afterKeys.contains(blockKey(e))) {
+            changes.unblocked.append(e);
+        }
+    }
+    return changes;
+}
+
+int applyDelta(PolicyStoreEngine& engine, const PolicyDelta& delta, PeerCursor& cursor,
+               const QString& peer, PeerMode mode)
+{
+    const bool full = mode == PeerMode::Full;
+    const QString actor = (full ? QStringLiteral("replication:") : QStringLiteral("baseline:")) + peer;
+    const std::shared_ptr<const PolicySnapshot> local = engine.sharedSnapshot();
+    QHash<QString, qsizetype> index;
+    index.reserve(local->devices.size());
+    for (qsizetype i = 0; i < local->devices.size(); ++i) {
+        index.insert(local->devices.at(i).uniqueId, i);
+    }
+
+    int applied = 0;
+    QList<DeviceRecord> upserts;
+    for (const DeviceRecord& incoming : delta.devices) {
+        const auto it = index.constFind(incoming.uniqueId);
+        if (it == index.constEnd()) {
+            upserts.append(incoming);
+            continue;
+        }
+        const DeviceRecord& current = local->devices.at(*it);
+        DeviceRecord merged = full ? mergeRecord(current, incoming) : mergeBaseline(current, incoming);
+        if (merged.toJson() != current.toJson()) {
+            upserts.append(std::move(merged));
+        }
+    }
+    if (!upserts.isEmpty()) {
+        if (!engine.upsertDevices(upserts, actor, QStringLiteral("replicated"))) {
+            return -1;
+        }
+        applied += static_cast<int>(upserts.size());
+    }
+
+    // A full delta can't tell the peer's removals from records it never had.
+    if (full && !delta.full) {
+        QStringList removals;
+        for (const QString& id : delta.removedIds) {
+            if (index.contains(id)) {
+                removals.append(id);
+            }
+        }
+        if (!removals.isEmpty()) {
+            const int removed = engine.removeDevices(removals, actor, QStringLiteral("replicated"));
+            if (removed < 0) {
+                return -1;
+            }
+            applied += removed;
+        }
+    }
+
+    if (full && delta.blocksChanged) {
+        // On first contact the peer's list is only added to: what it lacks may be new here.
+        const BlockChanges changes = cursor.hasBlocks
+                                         ? diffBlocks(cursor.blocks, delta.blocks)
+                                         : BlockChanges{delta.blocks, {}};
+        for (const BlockedDriveEntry& e : changes.blocked) {
+            if (isBlocked(local->blocks, e)) {
+                continue;
+            }
+            if (!engine.blockDrive(e.driveKey, e.uniqueId, e.label, actor)) {
+                return -1;
+            }
+            ++applied;
+        }
+        for (const BlockedDriveEntry& e : changes.unblocked) {
+            if (!isBlocked(local->blocks, e)) {
+                continue;
+            }
+            if (!engine.unblockDrive(e.driveKey, e.uniqueId, actor)) {
+                return -1;
+            }
+            ++applied;
+        }
+        cursor.blocks = delta.blocks;
+        cursor.hasBlocks = true;
+    }
+
+    cursor.epoch = delta.epoch;
+    cursor.generation = delta.generation;
+    return applied;
+}
+
+} // namespace FlashSpartan::Policy::PolicyReplication
@@ -0,0 +1,324 @@
+#include "policy/PolicyReplicator.h"
+
+#include "policy/PolicyPaths.h"
+#include "policy/PolicyProtocol.h"
+#include "policy/PolicyStoreEngine.h"
+
+#include "BlockHashFile.h"
+#include "WatchManifestFile.h"
+
+#include <QDebug>
+#include <QFile>
+#include <QRandomGenerator>
+
+#include <algorithm>
+
+namespace FlashSpartan::Policy {
+
+using PolicyReplication::Direction;
+
+namespace {
+
+/** Stores a watch manifest or block digest file a peer sent for @p digest. */
+bool saveFetchedFile(const QByteArray& data, const QString& digest, QString* error)
+{
+    const QString directory = PolicyPaths::watchManifestDirectory();
+    return BlockHashFile::isEncoded(data) ? BlockHashFile::saveEncoded(directory, data, digest, error)
+                                          : WatchManifestFile::saveEncoded(directory, data, digest, error);
+}
+
+/** Digests name files, so only lowercase hex SHA-256 is looked up. */
+bool isSha256Hex(const QString& digest)
+{
+    return digest.size() == 64 && std::all_of(digest.cbegin(), digest.cend(), [](QChar c) {
+               return (c >= QLatin1Char('0') && c <= QLatin1Char('9'))
+                      || (c >= QLatin1Char('a') && c <= QLatin1Char('f'));
+           });
+}
+
+} // namespace
+
+PolicyReplicator::PolicyReplicator(PolicyStoreEngine& engine, PolicyReplication::Config config)
+    : m_engine(engine)
+    , m_config(std::move(config))
+{
+    QObject::connect(&m_server, &QTcpServer::newConnection, &m_server, [this]() { onNewConnection(); });
+}
+
+PolicyReplicator::~PolicyReplicator()
+{
+    // Sockets still connected must not call back into a half-destroyed replicator.
+    for (QTcpSocket* socket : m_followers.keys()) {
+        QObject::disconnect(socket, nullptr, &m_server, nullptr);
+    }
+    for (const std::unique_ptr<Leader>& leader : m_leaders) {
+        QObject::disconnect(&leader->socket, nullptr, nullptr, nullptr);
+    }
+}
+
+bool PolicyReplicator::start(QString* error)
+{
+    if (m_config.listenPort != 0 && !m_server.listen(QHostAddress::Any, m_config.listenPort)) {
+        if (error) {
+            *error = m_server.errorString();
+        }
+        return false;
+    }
+    for (const QString& peer : m_config.peers) {
+        addLeader(peer, PolicyReplication::PeerMode::Full);
+    }
+    for (const QString& server : m_config.baselineServers) {
+        addLeader(server, PolicyReplication::PeerMode::Baselines);
+    }
+    return true;
+}
+
+void PolicyReplicator::notify()
+{
+    for (auto it = m_followers.begin(); it != m_followers.end(); ++it) {
+        if (it->subscribed) {
+            pushTo(it.key(), it.value(), false);
+        }
+    }
+}
+
+void PolicyReplicator::onNewConnection()
+{
+    while (QTcpSocket* socket = m_server.nextPendingConnection()) {
+        m_followers.insert(socket, Follower());
+        QObject::connect(socket, &QTcpSocket::disconnected, &m_server, [this, socket]() {
+            m_followers.remove(socket);
+            socket->deleteLater();
+        });
+        QObject::connect(socket, &QTcpSocket::readyRead, &m_server, [this, socket]() { readFollower(socket); });
+        QTimer::singleShot(kHandshakeTimeoutMs, socket, [this, socket]() {
+            const auto it = m_followers.constFind(socket);
+            if (it != m_followers.constEnd() && !it->subscribed) {
+                socket->abort();
+            }
+        });
+    }
+}
+
+void PolicyReplicator::readFollower(QTcpSocket* socket)
+{
+    const auto it = m_followers.find(socket);
+    if (it == m_followers.end()) {
+        return;
+    }
+    Follower& follower = it.value();
+    follower.buffer += socket->readAll();
+    if (follower.nonce.isEmpty()) {
+        if (follower.buffer.size() < PolicyReplication::kNonceBytes) {
+            return;
+        }
+        follower.nonce = follower.buffer.left(PolicyReplication::kNonceBytes);
+        follower.buffer.remove(0, PolicyReplication::kNonceBytes);
+    }
+    QByteArray sealed;
+    QString err;
+    while (PolicyReplication::unseal(follower.buffer, m_config.key, follower.nonce, follower.recvSeq,
+                                     Direction::ToLeader, &sealed, &err)) {
+        ++follower.recvSeq;
+        PolicyProtocol::Frame frame;
+        PolicyProtocol::Request req;
+        if (!PolicyProtocol::takeFrame(sealed, &frame) || !PolicyProtocol::decodeRequest(frame.payload, &req)) {
+            err = QStringLiteral("malformed request");
+            break;
+        }
+        if (!follower.subscribed && frame.type == PolicyProtocol::FrameType::Subscribe) {
+            follower.subscribed = true;
+            follower.epoch = req.epoch;
+            follower.generation = req.generation;
+            pushTo(socket, follower, true);
+        } else if (follower.subscribed && frame.type == PolicyProtocol::FrameType::FetchManifests) {
+            sendManifests(socket, follower, req.uniqueIds);
+        } else {
+            err = QStringLiteral("unexpected frame");
+            break;
+        }
+    }
+    if (!err.isEmpty()) {
+        qWarning() << "policyd: replication peer" << socket->peerAddress().toString() << err;
+        socket->abort();  // removes the follower
+    }
+}
+
+void PolicyReplicator::pushTo(QTcpSocket* socket, Follower& follower, bool evenIfEmpty)
+{
+    PolicyProtocol::Reply event;
+    event.ok = true;
+    event.hasDelta = true;
+    event.delta = m_engine.changesSince(follower.epoch, follower.generation);
+    if (!evenIfEmpty && event.delta.isEmpty()) {
+        return;
+    }
+    follower.epoch = event.delta.epoch;
+    follower.generation = event.delta.generation;
+    socket->write(PolicyReplication::seal(
+        m_config.key, follower.nonce, follower.sendSeq++, Direction::ToFollower,
+        PolicyProtocol::encodeFrame(PolicyProtocol::FrameType::Event,
+                                    PolicyProtocol::encodeReply(event))));
+}
+
+void PolicyReplicator::sendManifests(QTcpSocket* socket, Follower& follower, const QStringList& digests)
+{
+    const QString directory = PolicyPaths::watchManifestDirectory();
+    for (const QString& digest : digests) {
+        QByteArray data;
+        if (isSha256Hex(digest)) {
+            QFile file(WatchManifestFile::pathFor(directory, digest));
+            if (!file.exists()) {
+                file.setFileName(BlockHashFile::pathFor(directory, digest));
+            }
+            if (file.open(QIODevice::ReadOnly)) {
+                data = file.readAll();
+            }
+        }
+        socket->write(PolicyReplication::seal(
+            m_config.key, follower.nonce, follower.sendSeq++, Direction::ToFollower,
+            PolicyProtocol::encodeFrame(PolicyProtocol::FrameType::Manifest,
+                                        PolicyProtocol::encodeManifest(digest, data))));
+    }
+}
+
+void PolicyReplicator::addLeader(const QString& peer, PolicyReplication::PeerMode mode)
+{
+    const qsizetype colon = peer.lastIndexOf(QLatin1Char(':'));
+    bool ok = false;
+    const uint port = colon > 0 ? QStringView(peer).mid(colon + 1).toUInt(&ok) : 0;
+    if (!ok || port == 0 || port > 65535) {
+        qWarning() << "policyd: ignoring replication peer without a port:" << peer;
+        return;
+    }
+    auto leader = std::make_unique<Leader>();
+    leader->name = peer;
+    leader->host = peer.left(colon);
+    leader->port = static_cast<quint16>(port);
+    leader->mode = mode;
+    leader->reconnect.setSingleShot(true);
+    leader->reconnect.setInterval(kReconnectMs);
+    Leader* l = leader.get();
+    QObject::connect(&l->reconnect, &QTimer::timeout, &l->socket, [this, l]() { connectLeader(*l); });
+    QObject::connect(&l->socket, &QTcpSocket::connected, &l->socket, [this, l]() {
+        l->nonce.resize(PolicyReplication::kNonceBytes);
+        QRandomGenerator::system()->fillRange(reinterpret_cast<quint32*>(l->nonce.data()),
+                                              PolicyReplication::kNonceBytes / 4);
+        l->buffer.clear();
+        l->recvSeq = 0;
+        l->sendSeq = 0;
+        l->pending.clear();  // resent: the cursor only moves when an event is applied
+        l->awaiting.clear();
+        l->fetched = false;
+        PolicyProtocol::Request req;
+        req.actor = QStringLiteral("replication");
+        req.epoch = l->cursor.epoch;
+        req.generation = l->cursor.generation;
+        l->socket.write(l->nonce);
+        l->socket.write(PolicyReplication::seal(
+            m_config.key, l->nonce, l->sendSeq++, Direction::ToLeader,
+            PolicyProtocol::encodeFrame(PolicyProtocol::FrameType::Subscribe,
+                                        PolicyProtocol::encodeRequest(req))));
+    });
+    QObject::connect(&l->socket, &QTcpSocket::readyRead, &l->socket, [this, l]() { readLeader(*l); });
+    QObject::connect(&l->socket, &QTcpSocket::disconnected, &l->socket, [l]() { l->reconnect.start(); });
+    QObject::connect(&l->socket, &QTcpSocket::errorOccurred, &l->socket, [l]() {
+        if (l->socket.state() != QAbstractSocket::ConnectedState) {
+            l->reconnect.start();  // refused or unreachable: no disconnected() follows
+        }
+    });
+    m_leaders.push_back(std::move(leader));
+    connectLeader(*l);
+}
+
+void PolicyReplicator::connectLeader(Leader& leader)
+{
+    leader.socket.abort();
+    leader.reconnect.stop();  // abort() may have armed it
+    leader.socket.connectToHost(leader.host, leader.port);
+}
+
+void PolicyReplicator::readLeader(Leader& leader)
+{
+    leader.buffer += leader.socket.readAll();
+    bool applied = false;
+    QByteArray sealed;
+    QString err;
+    while (PolicyReplication::unseal(leader.buffer, m_config.key, leader.nonce, leader.recvSeq,
+                                     Direction::ToFollower, &sealed, &err)) {
+        ++leader.recvSeq;
+        PolicyProtocol::Frame frame;
+        if (!PolicyProtocol::takeFrame(sealed, &frame)) {
+            err = QStringLiteral("malformed frame");
+            break;
+        }
+        if (frame.type == PolicyProtocol::FrameType::Event) {
+            PolicyProtocol::Reply event;
+            if (!PolicyProtocol::decodeReply(frame.payload, &event) || !event.hasDelta) {
+                err = QStringLiteral("malformed event");
+                break;
+            }
+            leader.pending.append(event.delta);
+        } else if (frame.type == PolicyProtocol::FrameType::Manifest) {
+            QString digest;
+            QByteArray data;
+            if (!PolicyProtocol::decodeManifest(frame.payload, &digest, &data) || !leader.awaiting.remove(digest)) {
+                err = QStringLiteral("unexpected manifest");
+                break;
+            }
+            QString saveError;
+            if (data.isEmpty()) {
+                qWarning() << "policyd: replication peer" << leader.name << "lacks baseline file" << digest;
+            } else if (!saveFetchedFile(data, digest, &saveError)) {
+                qWarning() << "policyd: replication from" << leader.name << saveError;
+            }
+        } else {
+            err = QStringLiteral("unexpected frame");
+            break;
+        }
+        if (!applyPending(leader, &applied)) {
+            // The cursor stayed put: the reconnect asks for the same changes again.
+            err = QStringLiteral("policy store not persisted");
+            break;
+        }
+    }
+    if (applied && m_applied) {
+        m_applied();
+    }
+    if (!err.isEmpty()) {
+        qWarning() << "policyd: replication from" << leader.name << err;
+        leader.socket.abort();
+        leader.reconnect.start();
+    }
+}
+
+bool PolicyReplicator::applyPending(Leader& leader, bool* applied)
+{
+    while (!leader.pending.isEmpty() && leader.awaiting.isEmpty()) {
+        if (!leader.fetched) {
+            const QStringList missing = PolicyReplication::missingManifests(
+                leader.pending.first(), PolicyPaths::watchManifestDirectory());
+            if (!missing.isEmpty()) {
+                leader.awaiting = QSet<QString>(missing.cbegin(), missing.cend());
+                leader.fetched = true;
+                PolicyProtocol::Request req;
+                req.uniqueIds = missing;
+                leader.socket.write(PolicyReplication::seal(
+                    m_config.key, leader.nonce, leader.sendSeq++, Direction::ToLeader,
+                    PolicyProtocol::encodeFrame(PolicyProtocol::FrameType::FetchManifests,
+                                                PolicyProtocol::encodeRequest(req))));
+                return true;
+            }
+        }
+        leader.fetched = false;
+        const int count = PolicyReplication::applyDelta(m_engine, leader.pending.takeFirst(), leader.cursor,
+                                                        leader.name, leader.mode);
+        if (count < 0) {
+            return false;
+        }
+        *applied = *applied || count > 0;
+    }
+    return true;
+}
+
+} // namespace FlashSpartan::Policy
@@ -2,31 +2,42 @@
 
 #include "policy/PolicyAudit.h"
 #include "policy/PolicyBlobCodec.h"
+#include "policy/PolicyBlobView.h"
 #include "policy/PolicyPaths.h"
 
+#include "PerfMetrics.h"
+#include "PerfTrace.h"
+
 #include <QDir>
 #include <QFile>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QRandomGenerator>
 #include <QSaveFile>
+#include <QSet>
+
+#include <algorithm>
 
 namespace FlashSpartan::Policy {
 
 namespace {
 
-bool writeStoreFile(const QString& path, const PolicySnapshot& snapshot, QString* error)
+/** Removals remembered for deltas; past this a new epoch sends everyone a full copy. */
+constexpr int kMaxTombstones = 4096;
+
+bool sameBlock(const BlockedDriveEntry& e, const QString& driveKey, const QString& uniqueId)
 {
-    const QByteArray payload = PolicyBlobCodec::encode(snapshot);
-    const QByteArray key = PolicyBlobCodec::loadOrCreateKey();
-    const QByteArray sig = PolicyBlobCodec::sign(payload, key);
+    return (!driveKey.isEmpty() && e.driveKey == driveKey)
+           || (!uniqueId.isEmpty() && e.uniqueId == uniqueId);
+}
 
-    QByteArray file;
-    QDataStream out(&file, QIODevice::WriteOnly);
-    out.setByteOrder(QDataStream::LittleEndian);
-    out << PolicyBlobCodec::kMagic << PolicyBlobCodec::kVersion << quint32(payload.size());
-    out.writeRawData(payload.constData(), payload.size());
-    out.writeRawData(sig.constData(), sig.size());
+/** @p signature receives the blob's HMAC, which names it in the write-ahead log header. */
+bool writeStoreFile(const QString& path, const PolicySnapshot& snapshot, const QByteArray& key,
+                    QByteArray* signature, QString* error)
+{
+    QByteArray sig;
+    const QByteArray file = PolicyBlobCodec::encode(snapshot, key, &sig);
 
     QSaveFile sf(path);
     if (!sf.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
@@ -43,10 +54,12 @@ bool writeStoreFile(const QString& path, const PolicySnapshot& snapshot, QString
         return false;
     }
     QFile::setPermissions(path, QFile::ReadOwner | QFile::WriteOwner);
+    *signature = sig;
     return true;
 }
 
-bool readStoreFile(const QString& path, PolicySnapshot& snapshot, QString* error)
+bool readStoreFile(const QString& path, const QByteArray& key, PolicySnapshot& snapshot,
+                   QByteArray* signature, QString* error)
 {
     QFile f(path);
     if (!f.open(QIODevice::ReadOnly)) {
@@ -55,7 +68,23 @@ bool readStoreFile(const QString& path, PolicySnapshot& snapshot, QString* error
         }
         return false;
     }
-    return PolicyBlobCodec::decode(f.readAll(), snapshot, error);
+    const quint16 version = PolicyBlobCodec::versionOf(f.peek(PolicyBlobCodec::kHeaderBytes));
+    if (PolicyBlobCodec::isViewVersion(version)) {
+        f.close();
+        // Mapped, not read: only the sections' HMACs and the records touch the pages.
+        const std::unique_ptr<PolicyBlobView> view = PolicyBlobView::open(path, key, error);
+        if (!view || !view->read(snapshot, error)) {
+            return false;
+        }
+        *signature = view->signature();
+        return true;
+    }
+    const QByteArray bytes = f.readAll();
+    if (!PolicyBlobCodec::decode(bytes, snapshot, error, key)) {
+        return false;
+    }
+    *signature = PolicyBlobCodec::signatureOf(bytes);
+    return true;
 }
 
 } // namespace
@@ -63,40 +92,146 @@ bool readStoreFile(const QString& path, PolicySnapshot& snapshot, QString* error
 PolicyStoreEngine::PolicyStoreEngine(QString storePath)
     : m_storePath(storePath.isEmpty() ? PolicyPaths::storeFilePath() : std::move(storePath))
 {
+    resetGenerations();
 }
 
 bool PolicyStoreEngine::load(QString* error)
 {
+    FLASHSPARTAN_TRACE_SPAN("policy", "load");
     QWriteLocker locker(&m_lock);
     QDir().mkpath(QFileInfo(m_storePath).absolutePath());
+    unpublishLocked();
 
     if (!QFile::exists(m_storePath)) {
         migrateLegacyJsonIfNeeded(error);
         if (!QFile::exists(m_storePath)) {
-            m_snapshot = {};
-            return writeStoreFile(m_storePath, m_snapshot, error);
+            m_snapshot.devices.clear();
+            m_snapshot.blocks.clear();
+            m_deviceIndex.clear();
+            resetGenerations();
+            return checkpointLocked(error);
         }
     }
 
-    return readStoreFile(m_storePath, m_snapshot, error);
+    m_wal.close();
+    QByteArray signature;
+    const bool read = readStoreFile(m_storePath, keyLocked(), m_snapshot, &signature, error);
+    rebuildIndexLocked();
+    if (!read) {
+        resetGenerations();
+        return false;
+    }
+    // Mutations logged since the last checkpoint; a torn tail from a crash is dropped.
+    const QList<PolicyMutation> logged = PolicyWal::read(walPath(), signature, keyLocked());
+    for (const PolicyMutation& m : logged) {
+        applyLocked(m);
+    }
+    resetGenerations();
+    if (!logged.isEmpty()) {
+        return checkpointLocked(error);
+    }
+    m_wal.reset(walPath(), signature, m_key);
+    return true;
 }
 
 bool PolicyStoreEngine::save(QString* error)
 {
-    QReadLocker locker(&m_lock);
-    return writeStoreFile(m_storePath, m_snapshot, error);
+    QWriteLocker locker(&m_lock);
+    return checkpointLocked(error);
 }
 
 PolicySnapshot PolicyStoreEngine::snapshot() const
 {
+    return *sharedSnapshot();
+}
+
+std::shared_ptr<const PolicySnapshot> PolicyStoreEngine::sharedSnapshot() const
+{
+    if (std::shared_ptr<const PolicySnapshot> published = std::atomic_load(&m_published)) {
+        return published;
+    }
     QReadLocker locker(&m_lock);
-    return m_snapshot;
+    // Stored under the read lock, so a writer cannot unpublish between the copy and the store.
+    auto published = std::make_shared<const PolicySnapshot>(m_snapshot);
+    std::atomic_store(&m_published, published);
+    return published;
 }
 
 void PolicyStoreEngine::setSnapshot(const PolicySnapshot& snap)
 {
     QWriteLocker locker(&m_lock);
-    m_snapshot = snap;
+    m_snapshot.devices = snap.devices;
+    m_snapshot.blocks = snap.blocks;
+    rebuildIndexLocked();
+    unpublishLocked();
+    resetGenerations();
+    m_wal.close();  // the log extends the blob on disk; the next mutation checkpoints
+}
+
+PolicyDelta PolicyStoreEngine::changesSince(quint64 epoch, quint64 generation) const
+{
+    QReadLocker locker(&m_lock);
+    PolicyDelta delta;
+    delta.epoch = m_snapshot.epoch;
+    delta.generation = m_snapshot.generation;
+    if (epoch != m_snapshot.epoch || generation > m_snapshot.generation) {
+        delta.full = true;
+        delta.devices = m_snapshot.devices;
+        delta.blocksChanged = true;
+        delta.blocks = m_snapshot.blocks;
+        return delta;
+    }
+    if (generation == m_snapshot.generation) {
+        return delta;
+    }
+    for (const DeviceRecord& rec : m_snapshot.devices) {
+        if (m_deviceChangedAt.value(rec.uniqueId) > generation) {
+            delta.devices.append(rec);
+        }
+    }
+    for (auto it = m_removedAt.cbegin(); it != m_removedAt.cend(); ++it) {
+        if (it.value() > generation) {
+            delta.removedIds.append(it.key());
+        }
+    }
+    if (m_blocksChangedAt > generation) {
+        delta.blocksChanged = true;
+        delta.blocks = m_snapshot.blocks;
+    }
+    return delta;
+}
+
+void PolicyStoreEngine::resetGenerations()
+{
+    quint64 epoch = 0;
+    while (epoch == 0 || epoch == m_snapshot.epoch) {
+        epoch = QRandomGenerator::global()->generate64();
+    }
+    m_snapshot.epoch = epoch;
+    m_snapshot.generation = 0;
+    m_deviceChangedAt.clear();
+    m_removedAt.clear();
+    m_blocksChangedAt = 0;
+}
+
+void PolicyStoreEngine::markDeviceChanged(const QString& uniqueId)
+{
+    m_deviceChangedAt.insert(uniqueId, ++m_snapshot.generation);
+    m_removedAt.remove(uniqueId);
+}
+
+void PolicyStoreEngine::markDeviceRemoved(const QString& uniqueId)
+{
+    m_deviceChangedAt.remove(uniqueId);
+    m_removedAt.insert(uniqueId, ++m_snapshot.generation);
+    if (m_removedAt.size() > kMaxTombstones) {
+        resetGenerations();
+    }
+}
+
+void PolicyStoreEngine::markBlocksChanged()
+{
+    m_blocksChangedAt = ++m_snapshot.generation;
 }
 
 bool PolicyStoreEngine::migrateLegacyJsonIfNeeded(QString* error)
@@ -153,108 +288,285 @@ bool PolicyStoreEngine::migrateLegacyJsonIfNeeded(QString* error)
         return true;
     }
 
-    m_snapshot = snap;
+    m_snapshot.devices = snap.devices;
+    m_snapshot.blocks = snap.blocks;
+    rebuildIndexLocked();
+    resetGenerations();
     PolicyAudit::append(QStringLiteral("engine"), QStringLiteral("migrate"),
                         QStringLiteral("*"), QStringLiteral("Imported legacy JSON stores"));
-    return writeStoreFile(m_storePath, m_snapshot, error);
+    return checkpointLocked(error);
+}
+
+bool PolicyStoreEngine::logLocked(const QList<PolicyMutation>& mutations)
+{
+    FLASHSPARTAN_TRACE_SPAN_VALUE("policy", "wal_append", mutations.size());
+    const bool deferSync = m_groupThread && m_groupThread == QThread::currentThread();
+    if (m_wal.entries() + mutations.size() <= PolicyWal::kCheckpointEntries
+        && m_wal.bytes() < PolicyWal::kCheckpointBytes && m_wal.append(mutations, !deferSync)) {
+        m_groupUnsynced = m_groupUnsynced || deferSync;
+        return true;
+    }
+    QString err;
+    return checkpointLocked(&err);
+}
+
+void PolicyStoreEngine::beginGroupCommit()
+{
+    QWriteLocker locker(&m_lock);
+    m_groupThread = QThread::currentThread();
 }
 
-bool PolicyStoreEngine::commitMutation(const QString& actor, const QString& action,
-                                       const QString& target, const QString& detail)
+bool PolicyStoreEngine::commitGroup()
 {
-    PolicyAudit::append(actor, action, target, detail);
+    FLASHSPARTAN_TRACE_SPAN("policy", "group_sync");
+    QWriteLocker locker(&m_lock);
+    m_groupThread = nullptr;
+    if (!m_groupUnsynced) {
+        return true;
+    }
+    m_groupUnsynced = false;
+    if (m_wal.sync()) {
+        return true;
+    }
     QString err;
-    if (!save(&err)) {
+    return checkpointLocked(&err);  // the blob holds the whole group too
+}
+
+bool PolicyStoreEngine::checkpointLocked(QString* error)
+{
+    FLASHSPARTAN_TRACE_SPAN("policy", "checkpoint");
+    QByteArray signature;
+    if (!writeStoreFile(m_storePath, m_snapshot, keyLocked(), &signature, error)) {
         return false;
     }
+    // Without a log every mutation checkpoints, which is slower but just as safe.
+    m_wal.reset(walPath(), signature, m_key);
+    m_groupUnsynced = false;
     return true;
 }
 
-bool PolicyStoreEngine::upsertDevice(const DeviceRecord& record, const QString& actor,
-                                    const QString& reason)
+const QByteArray& PolicyStoreEngine::keyLocked()
 {
-    if (record.uniqueId.isEmpty()) {
-        return false;
+    if (m_key.isEmpty()) {
+        m_key = PolicyBlobCodec::loadOrCreateKey();
     }
-    {
-        QWriteLocker locker(&m_lock);
-        bool found = false;
-        for (DeviceRecord& rec : m_snapshot.devices) {
-            if (rec.uniqueId == record.uniqueId) {
-                rec = record;
-                found = true;
-                break;
+    return m_key;
+}
+
+bool PolicyStoreEngine::applyLocked(const PolicyMutation& m)
+{
+    QList<DeviceRecord>& devices = m_snapshot.devices;
+    switch (m.kind) {
+    case PolicyMutation::Kind::UpsertDevice: {
+        const auto it = m_deviceIndex.constFind(m.record.uniqueId);
+        if (it != m_deviceIndex.constEnd()) {
+            devices[*it] = m.record;
+        } else {
+            m_deviceIndex.insert(m.record.uniqueId, devices.size());
+            devices.append(m.record);
+        }
+        markDeviceChanged(m.record.uniqueId);
+        return true;
+    }
+    case PolicyMutation::Kind::RemoveDevice: {
+        const auto it = m_deviceIndex.constFind(m.uniqueId);
+        if (it == m_deviceIndex.constEnd()) {
+            return false;
+        }
+        // Swap with the last record: store order carries no meaning.
+        const qsizetype pos = *it;
+        m_deviceIndex.erase(it);
+        if (pos != devices.size() - 1) {
+            devices[pos] = std::move(devices.last());
+            m_deviceIndex.insert(devices.at(pos).uniqueId, pos);
+        }
+        devices.removeLast();
+        markDeviceRemoved(m.uniqueId);
+        return true;
+    }
+    case PolicyMutation::Kind::ClearDevices:
+        devices.clear();
+        m_deviceIndex.clear();
+        resetGenerations();
+        return true;
+    case PolicyMutation::Kind::BlockDrive:
+        // Matched by drive key or unique id, as in BlockedDriveStore. Block changes are rare
+        // next to connects, so the list stays a list here; clients index it.
+        for (const BlockedDriveEntry& e : m_snapshot.blocks) {
+            if (sameBlock(e, m.block.driveKey, m.block.uniqueId)) {
+                return false;
             }
         }
-        if (!found) {
-            m_snapshot.devices.append(record);
+        m_snapshot.blocks.append(m.block);
+        markBlocksChanged();
+        return true;
+    case PolicyMutation::Kind::UnblockDrive:
+        if (m_snapshot.blocks.removeIf([&](const BlockedDriveEntry& e) {
+                return sameBlock(e, m.block.driveKey, m.block.uniqueId);
+            })
+            == 0) {
+            return false;
+        }
+        markBlocksChanged();
+        return true;
+    }
+    return false;
+}
+
+void PolicyStoreEngine::stampPolicyChangeLocked(DeviceRecord& record) const
+{
+    const auto it = m_deviceIndex.constFind(record.uniqueId);
+    if (it == m_deviceIndex.constEnd()) {
+        if (!record.policyChangedAt.isValid()) {
+            record.policyChangedAt = QDateTime::currentDateTimeUtc();
         }
+        return;
+    }
+    const DeviceRecord& stored = m_snapshot.devices.at(*it);
+    if (stored.samePolicyAs(record)) {
+        // Writers that predate the field send none; keep the stored time
+        record.policyChangedAt = std::max(record.policyChangedAt, stored.policyChangedAt);
+    } else if (!(record.policyChangedAt > stored.policyChangedAt)) {
+        // A replicated decision brings its own, later time
+        record.policyChangedAt = QDateTime::currentDateTimeUtc();
+    }
+}
+
+void PolicyStoreEngine::rebuildIndexLocked()
+{
+    m_deviceIndex.clear();
+    m_deviceIndex.reserve(m_snapshot.devices.size());
+    for (qsizetype i = 0; i < m_snapshot.devices.size(); ++i) {
+        m_deviceIndex.insert(m_snapshot.devices.at(i).uniqueId, i);
+    }
+}
+
+void PolicyStoreEngine::unpublishLocked()
+{
+    std::atomic_store(&m_published, std::shared_ptr<const PolicySnapshot>());
+}
+
+bool PolicyStoreEngine::upsertDevice(const DeviceRecord& record, const QString& actor,
+                                    const QString& reason)
+{
+    if (record.uniqueId.isEmpty()) {
+        return false;
     }
-    return commitMutation(actor, QStringLiteral("upsert_device"), record.uniqueId, reason);
+    PolicyMutation m;
+    m.kind = PolicyMutation::Kind::UpsertDevice;
+    m.record = record;
+    return commit({m}, actor, QStringLiteral("upsert_device"), {record.uniqueId}, reason) >= 0;
 }
 
 bool PolicyStoreEngine::removeDevice(const QString& uniqueId, const QString& actor,
                                      const QString& reason)
 {
-    {
-        QWriteLocker locker(&m_lock);
-        QList<DeviceRecord> kept;
-        for (const DeviceRecord& rec : m_snapshot.devices) {
-            if (rec.uniqueId != uniqueId) {
-                kept.append(rec);
-            }
+    PolicyMutation m;
+    m.kind = PolicyMutation::Kind::RemoveDevice;
+    m.uniqueId = uniqueId;
+    return commit({m}, actor, QStringLiteral("remove_device"), {uniqueId}, reason) >= 0;
+}
+
+bool PolicyStoreEngine::upsertDevices(const QList<DeviceRecord>& records, const QString& actor,
+                                      const QString& reason)
+{
+    QList<PolicyMutation> mutations;
+    QStringList ids;
+    for (const DeviceRecord& record : records) {
+        if (record.uniqueId.isEmpty()) {
+            continue;
         }
-        m_snapshot.devices = kept;
+        PolicyMutation m;
+        m.kind = PolicyMutation::Kind::UpsertDevice;
+        m.record = record;
+        mutations.append(m);
+        ids.append(record.uniqueId);
     }
-    return commitMutation(actor, QStringLiteral("remove_device"), uniqueId, reason);
+    if (mutations.isEmpty()) {
+        return records.isEmpty();
+    }
+    return commit(mutations, actor, QStringLiteral("upsert_device"), ids, reason) >= 0;
 }
 
-bool PolicyStoreEngine::clearDevices(const QString& actor, const QString& reason)
+int PolicyStoreEngine::removeDevices(const QStringList& uniqueIds, const QString& actor,
+                                     const QString& reason)
 {
-    {
-        QWriteLocker locker(&m_lock);
-        m_snapshot.devices.clear();
+    QList<PolicyMutation> mutations;
+    for (const QString& id : uniqueIds) {
+        PolicyMutation m;
+        m.kind = PolicyMutation::Kind::RemoveDevice;
+        m.uniqueId = id;
+        mutations.append(m);
     }
-    return commitMutation(actor, QStringLiteral("clear_devices"), QStringLiteral("*"), reason);
+    return commit(mutations, actor, QStringLiteral("remove_device"), {}, reason);
+}
+
+bool PolicyStoreEngine::clearDevices(const QString& actor, const QString& reason)
+{
+    PolicyMutation m;
+    m.kind = PolicyMutation::Kind::ClearDevices;
+    return commit({m}, actor, QStringLiteral("clear_devices"), {QStringLiteral("*")}, reason) >= 0;
 }
 
 bool PolicyStoreEngine::blockDrive(const QString& driveKey, const QString& uniqueId,
                                   const QString& label, const QString& actor)
 {
-    {
-        QWriteLocker locker(&m_lock);
-        for (const BlockedDriveEntry& e : m_snapshot.blocks) {
-            if ((!driveKey.isEmpty() && e.driveKey == driveKey)
-                || (!uniqueId.isEmpty() && e.uniqueId == uniqueId)) {
-                return commitMutation(actor, QStringLiteral("block_drive"), uniqueId, label);
-            }
-        }
-        BlockedDriveEntry e;
-        e.driveKey = driveKey;
-        e.uniqueId = uniqueId;
-        e.label = label;
-        e.blockedAt = QDateTime::currentDateTime();
-        m_snapshot.blocks.append(e);
-    }
-    return commitMutation(actor, QStringLiteral("block_drive"), uniqueId, label);
+    PolicyMutation m;
+    m.kind = PolicyMutation::Kind::BlockDrive;
+    m.block.driveKey = driveKey;
+    m.block.uniqueId = uniqueId;
+    m.block.label = label;
+    m.block.blockedAt = QDateTime::currentDateTime();
+    return commit({m}, actor, QStringLiteral("block_drive"), {uniqueId}, label) >= 0;
 }
 
 bool PolicyStoreEngine::unblockDrive(const QString& driveKey, const QString& uniqueId,
                                      const QString& actor)
 {
+    PolicyMutation m;
+    m.kind = PolicyMutation::Kind::UnblockDrive;
+    m.block.driveKey = driveKey;
+    m.block.uniqueId = uniqueId;
+    return commit({m}, actor, QStringLiteral("unblock_drive"), {uniqueId}, {}) >= 0;
+}
+
+int PolicyStoreEngine::commit(const QList<PolicyMutation>& mutations, const QString& actor,
+                              const QString& action, QStringList targets, const QString& detail)
+{
+    FLASHSPARTAN_TRACE_SPAN_VALUE("policy", "commit", mutations.size());
+    const PerfMetrics::ScopedTimer commitTimer(PerfMetrics::policyCommitLatency());
+    const bool auditApplied = targets.isEmpty();
+    QList<PolicyMutation> applied;
+    bool persisted = true;
     {
+        const qint64 lockBeginNs = PerfTrace::active() ? PerfTrace::nowNs() : 0;
         QWriteLocker locker(&m_lock);
-        QList<BlockedDriveEntry> kept;
-        for (const BlockedDriveEntry& e : m_snapshot.blocks) {
-            const bool match = (!driveKey.isEmpty() && e.driveKey == driveKey)
-                               || (!uniqueId.isEmpty() && e.uniqueId == uniqueId);
-            if (!match) {
-                kept.append(e);
+        if (lockBeginNs > 0) {
+            FLASHSPARTAN_TRACE_RECORD("policy", "lock_wait", lockBeginNs, PerfTrace::nowNs());
+        }
+        for (PolicyMutation m : mutations) {
+            if (m.kind == PolicyMutation::Kind::UpsertDevice) {
+                stampPolicyChangeLocked(m.record);  // before logging, so replay keeps the time
+            }
+            if (applyLocked(m)) {
+                applied.append(m);
             }
         }
-        m_snapshot.blocks = kept;
+        if (!applied.isEmpty()) {
+            unpublishLocked();
+            persisted = logLocked(applied);
+        }
+    }
+    if (auditApplied) {
+        for (const PolicyMutation& m : applied) {
+            targets.append(m.uniqueId);
+        }
+    }
+    FLASHSPARTAN_TRACE_SPAN_VALUE("policy", "audit", targets.size());
+    for (const QString& target : targets) {
+        PolicyAudit::append(actor, action, target, detail);
     }
-    return commitMutation(actor, QStringLiteral("unblock_drive"), uniqueId, {});
+    return persisted ? static_cast<int>(applied.size()) : -1;
 }
 
 } // namespace FlashSpartan::Policy
@@ -0,0 +1,221 @@
+#include "policy/PolicyWal.h"
+
+#include "policy/PolicyBlobCodec.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace FlashSpartan::Policy {
+
+namespace {
+
+constexpr int kSignatureBytes = 32;
+constexpr quint32 kMaxEntryBytes = 16 * 1024 * 1024;
+
+void prepare(QDataStream& stream)
+{
+    stream.setVersion(QDataStream::Qt_6_4);
+    stream.setByteOrder(QDataStream::LittleEndian);
+}
+
+/** What an entry's HMAC covers: the blob it extends, its place in the log, its payload. */
+QByteArray signedBytes(const QByteArray& base, quint64 sequence, const QByteArray& payload)
+{
+    QByteArray bytes = base;
+    QDataStream out(&bytes, QIODevice::WriteOnly | QIODevice::Append);
+    prepare(out);
+    out << sequence;
+    bytes += payload;
+    return bytes;
+}
+
+QByteArray encodeMutation(const PolicyMutation& m)
+{
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    prepare(out);
+    out << quint8(m.kind);
+    switch (m.kind) {
+    case PolicyMutation::Kind::UpsertDevice:
+        out << QJsonDocument(m.record.toJson()).toJson(QJsonDocument::Compact);
+        break;
+    case PolicyMutation::Kind::RemoveDevice:
+        out << m.uniqueId;
+        break;
+    case PolicyMutation::Kind::ClearDevices:
+        break;
+    case PolicyMutation::Kind::BlockDrive:
+    case PolicyMutation::Kind::UnblockDrive:
+        out << m.block.driveKey << m.block.uniqueId << m.block.label << m.block.blockedAt;
+        break;
+    }
+    return payload;
+}
+
+bool decodeMutation(const QByteArray& payload, PolicyMutation& m)
+{
+    QDataStream in(payload);
+    prepare(in);
+    quint8 kind = 0;
+    in >> kind;
+    m.kind = static_cast<PolicyMutation::Kind>(kind);
+    switch (m.kind) {
+    case PolicyMutation::Kind::UpsertDevice: {
+        QByteArray json;
+        in >> json;
+        m.record = DeviceRecord::fromJson(QJsonDocument::fromJson(json).object());
+        if (m.record.uniqueId.isEmpty()) {
+            return false;
+        }
+        break;
+    }
+    case PolicyMutation::Kind::RemoveDevice:
+        in >> m.uniqueId;
+        break;
+    case PolicyMutation::Kind::ClearDevices:
+        break;
+    case PolicyMutation::Kind::BlockDrive:
+    case PolicyMutation::Kind::UnblockDrive:
+        in >> m.block.driveKey >> m.block.uniqueId >> m.block.label >> m.block.blockedAt;
+        break;
+    default:
+        return false;
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+bool syncFile(QFile& file)
+{
+    if (!file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return fdatasync(file.handle()) == 0;
+#endif
+}
+
+} // namespace
+
+QList<PolicyMutation> PolicyWal::read(const QString& path, const QByteArray& baseSignature,
+                                      const QByteArray& key)
+{
+    QList<PolicyMutation> out;
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return out;
+    }
+    const QByteArray data = file.readAll();
+    QDataStream in(data);
+    prepare(in);
+    quint32 magic = 0;
+    quint16 version = 0;
+    in >> magic >> version;
+    QByteArray base(kSignatureBytes, Qt::Uninitialized);
+    if (in.status() != QDataStream::Ok || magic != kMagic || version != kVersion
+        || in.readRawData(base.data(), kSignatureBytes) != kSignatureBytes || base != baseSignature) {
+        return out;  // missing, or written against an older checkpoint
+    }
+
+    for (quint64 sequence = 0;; ++sequence) {
+        quint32 length = 0;
+        in >> length;
+        if (in.status() != QDataStream::Ok || length > kMaxEntryBytes) {
+            break;
+        }
+        QByteArray payload(static_cast<qsizetype>(length), Qt::Uninitialized);
+        QByteArray sig(kSignatureBytes, Qt::Uninitialized);
+        PolicyMutation m;
+        if (in.readRawData(payload.data(), static_cast<int>(length)) != static_cast<int>(length)
+            || in.readRawData(sig.data(), kSignatureBytes) != kSignatureBytes
+            || !PolicyBlobCodec::verify(signedBytes(base, sequence, payload), sig, key)
+            || !decodeMutation(payload, m)) {
+            break;  // torn tail, or tampered
+        }
+        out.append(m);
+    }
+    return out;
+}
+
+bool PolicyWal::reset(const QString& path, const QByteArray& baseSignature, const QByteArray& key)
+{
+    close();
+    QByteArray header;
+    QDataStream out(&header, QIODevice::WriteOnly);
+    prepare(out);
+    out << kMagic << kVersion;
+    out.writeRawData(baseSignature.constData(), static_cast<int>(baseSignature.size()));
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile sf(path);
+    if (!sf.open(QIODevice::WriteOnly) || sf.write(header) != header.size() || !sf.commit()) {
+        return false;
+    }
+    QFile::setPermissions(path, QFile::ReadOwner | QFile::WriteOwner);
+
+    auto file = std::make_unique<QFile>(path);
+    if (!file->open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return false;
+    }
+    m_file = std::move(file);
+    m_base = baseSignature;
+    m_key = key;
+    m_entries = 0;
+    return true;
+}
+
+bool PolicyWal::append(const QList<PolicyMutation>& mutations, bool sync)
+{
+    if (!m_file) {
+        return false;
+    }
+    QByteArray bytes;
+    QDataStream out(&bytes, QIODevice::WriteOnly);
+    prepare(out);
+    for (const PolicyMutation& m : mutations) {
+        const QByteArray payload = encodeMutation(m);
+        const QByteArray sig =
+            PolicyBlobCodec::sign(signedBytes(m_base, quint64(m_entries), payload), m_key);
+        out << quint32(payload.size());
+        out.writeRawData(payload.constData(), static_cast<int>(payload.size()));
+        out.writeRawData(sig.constData(), static_cast<int>(sig.size()));
+        ++m_entries;
+    }
+    if (m_file->write(bytes) != bytes.size() || (sync && !syncFile(*m_file))) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool PolicyWal::sync()
+{
+    if (!m_file || !syncFile(*m_file)) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void PolicyWal::close()
+{
+    if (m_file) {
+        m_file->close();
+        m_file.reset();
+    }
+    m_entries = 0;
+}
+
+} // namespace FlashSpartan::Policy
@@ -0,0 +1,555 @@
+/**
+ * bench_connect_latency — connect-to-verdict latency with many sticks plugged at once.
+ *
+ * Creates N USB mass-storage gadgets in configfs, each backed by a sparse FAT image and
+ * bound to its own dummy_hcd UDC, starts `flashspartan --headless` in a private runtime,
+ * config and policy directory, and binds every gadget at the same moment. The service's
+ * events carry "latency_ms" for each connect milestone (card, mount, manifest, hash and
+ * ISO verdict) measured from the partition's first udev event; the bench mounts each
+ * partition as its card appears, as an automounter would. Needs root, configfs and the
+ * dummy_hcd module. Prints one versioned JSON document with per-stage percentiles; see
+ * docs/BENCHMARKS.md. Not a ctest.
+ */
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QProcess>
+#include <QSaveFile>
+#include <QSet>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <sys/mount.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr auto kSchema = "flashspartan.bench.connect_latency/1";
+const QString kGadgetRoot = QStringLiteral("/sys/kernel/config/usb_gadget");
+const QString kUdcRoot = QStringLiteral("/sys/class/udc");
+const QStringList kStages = {QStringLiteral("card"), QStringLiteral("mount"), QStringLiteral("manifest_verdict"),
+                             QStringLiteral("hash_verdict"), QStringLiteral("iso_verdict")};
+constexpr int kMaxUdcs = 32;  // dummy_hcd's limit on num=
+
+bool writeAttr(const QString& path, const QByteArray& value)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(value) == value.size();
+}
+
+/** Runs a helper tool to completion; false (with its output on stderr) when it fails. */
+bool run(const QString& program, const QStringList& args, const QByteArray& input = {})
+{
+    QProcess p;
+    p.setProcessChannelMode(QProcess::MergedChannels);
+    p.start(program, args);
+    if (!p.waitForStarted(10000)) {
+        std::cerr << "Cannot run " << program.toStdString() << '\n';
+        return false;
+    }
+    if (!input.isEmpty()) {
+        p.write(input);
+    }
+    p.closeWriteChannel();
+    p.waitForFinished(120000);
+    if (p.exitStatus() != QProcess::NormalExit || p.exitCode() != 0) {
+        std::cerr << program.toStdString() << ' ' << args.join(u' ').toStdString() << " failed:\n"
+                  << p.readAll().constData();
+        return false;
+    }
+    return true;
+}
+
+QStringList dummyUdcs()
+{
+    QStringList udcs = QDir(kUdcRoot).entryList({QStringLiteral("dummy_udc.*")}, QDir::Dirs | QDir::System);
+    std::sort(udcs.begin(), udcs.end(), [](const QString& a, const QString& b) {
+        return a.section(u'.', -1).toInt() < b.section(u'.', -1).toInt();
+    });
+    return udcs;
+}
+
+/**
+ * A sparse image with one FAT partition at 1 MiB, optionally carrying @p iso (and its
+ * .sha256 sidecar, when there is one) so the service has something to verify.
+ */
+bool makeBackingImage(const QString& path, int sizeMb, const QString& iso, const QString& mountDir)
+{
+    QFile image(path);
+    if (!image.open(QIODevice::WriteOnly) || !image.resize(qint64(sizeMb) * 1024 * 1024)) {
+        std::cerr << "Cannot create " << path.toStdString() << '\n';
+        return false;
+    }
+    image.close();
+    if (!run(QStringLiteral("sfdisk"), {QStringLiteral("--quiet"), path}, "label: dos\nstart=2048, type=c\n")
+        || !run(QStringLiteral("mkfs.vfat"), {QStringLiteral("--offset"), QStringLiteral("2048"),
+                                              QStringLiteral("-n"), QStringLiteral("FSBENCH"), path})) {
+        return false;
+    }
+    if (iso.isEmpty()) {
+        return true;
+    }
+    QDir().mkpath(mountDir);
+    if (!run(QStringLiteral("mount"), {QStringLiteral("-o"), QStringLiteral("loop,offset=1048576"), path, mountDir})) {
+        return false;
+    }
+    const QString name = QFileInfo(iso).fileName();
+    bool ok = QFile::copy(iso, QDir(mountDir).filePath(name));
+    if (ok && QFileInfo::exists(iso + QStringLiteral(".sha256"))) {
+        ok = QFile::copy(iso + QStringLiteral(".sha256"), QDir(mountDir).filePath(name + QStringLiteral(".sha256")));
+    }
+    ok = run(QStringLiteral("umount"), {mountDir}) && ok;
+    if (!ok) {
+        std::cerr << "Cannot copy " << iso.toStdString() << " onto " << path.toStdString() << '\n';
+    }
+    return ok;
+}
+
+QString gadgetDir(int i)
+{
+    return QDir(kGadgetRoot).filePath(QStringLiteral("fsbench%1").arg(i));
+}
+
+QString serialFor(int i)
+{
+    return QStringLiteral("FSBENCH%1").arg(i, 4, 10, QLatin1Char('0'));
+}
+
+bool createGadget(int i, const QString& backingFile)
+{
+    const QDir g(gadgetDir(i));
+    const QString function = g.filePath(QStringLiteral("functions/mass_storage.0"));
+    const QString config = g.filePath(QStringLiteral("configs/c.1"));
+    return QDir().mkpath(g.filePath(QStringLiteral("strings/0x409")))
+           && writeAttr(g.filePath(QStringLiteral("idVendor")), "0x1d6b")
+           && writeAttr(g.filePath(QStringLiteral("idProduct")), "0x0104")
+           && writeAttr(g.filePath(QStringLiteral("strings/0x409/serialnumber")), serialFor(i).toLatin1())
+           && writeAttr(g.filePath(QStringLiteral("strings/0x409/manufacturer")), "FlashSpartan")
+           && writeAttr(g.filePath(QStringLiteral("strings/0x409/product")), "Bench Stick")
+           && QDir().mkpath(config + QStringLiteral("/strings/0x409"))
+           && writeAttr(config + QStringLiteral("/strings/0x409/configuration"), "bench")
+           && QDir().mkpath(function)
+           && writeAttr(function + QStringLiteral("/lun.0/removable"), "1")
+           && writeAttr(function + QStringLiteral("/lun.0/file"), QFile::encodeName(backingFile))
+           && QFile::link(function, config + QStringLiteral("/mass_storage.0"));
+}
+
+/** configfs only lets a gadget go in the reverse order of its creation. */
+void removeGadget(int i)
+{
+    const QDir g(gadgetDir(i));
+    if (!g.exists()) {
+        return;
+    }
+    writeAttr(g.filePath(QStringLiteral("UDC")), "\n");
+    QFile::remove(g.filePath(QStringLiteral("configs/c.1/mass_storage.0")));
+    for (const char* dir : {"configs/c.1/strings/0x409", "configs/c.1", "functions/mass_storage.0", "strings/0x409"}) {
+        g.rmdir(QLatin1String(dir));
+    }
+    QDir(kGadgetRoot).rmdir(g.dirName());
+}
+
+double percentile(const std::vector<double>& sorted, int p)
+{
+    return sorted[qMin(sorted.size() - 1, sorted.size() * p / 100)];
+}
+
+QJsonObject stageJson(std::vector<double> ms, int expected)
+{
+    QJsonObject obj;
+    obj.insert(QStringLiteral("count"), static_cast<int>(ms.size()));
+    obj.insert(QStringLiteral("expected"), expected);
+    if (ms.empty()) {
+        return obj;
+    }
+    std::sort(ms.begin(), ms.end());
+    double sum = 0;
+    for (const double v : ms) {
+        sum += v;
+    }
+    obj.insert(QStringLiteral("p50_ms"), percentile(ms, 50));
+    obj.insert(QStringLiteral("p90_ms"), percentile(ms, 90));
+    obj.insert(QStringLiteral("p99_ms"), percentile(ms, 99));
+    obj.insert(QStringLiteral("max_ms"), ms.back());
+    obj.insert(QStringLiteral("mean_ms"), sum / static_cast<double>(ms.size()));
+    return obj;
+}
+
+/** The service's status socket, read line by line. */
+class StatusStream {
+public:
+    bool connectTo(const QString& path, int timeoutMs)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        while (timer.elapsed() < timeoutMs) {
+            m_socket.connectToServer(path, QIODevice::ReadOnly);
+            if (m_socket.waitForConnected(200)) {
+                return true;
+            }
+            QThread::msleep(50);
+        }
+        return false;
+    }
+
+    /** The next JSON line, or an empty object when none arrived within @p timeoutMs. */
+    QJsonObject next(int timeoutMs)
+    {
+        if (!m_socket.canReadLine()) {
+            m_socket.waitForReadyRead(timeoutMs);
+        }
+        if (!m_socket.canReadLine()) {
+            return {};
+        }
+        return QJsonDocument::fromJson(m_socket.readLine()).object();
+    }
+
+    bool connected() const { return m_socket.state() == QLocalSocket::ConnectedState; }
+
+private:
+    QLocalSocket m_socket;
+};
+
+struct Stick {
+    QString serial;
+    QString deviceNode;
+    QString mountPoint;
+    QSet<QString> reached;
+    bool disconnected = false;
+};
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("bench_connect_latency"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Plug N virtual sticks at once and time udev add to card, mount and verdicts"));
+    parser.addHelpOption();
+    QCommandLineOption sticksOption(QStringLiteral("sticks"), QStringLiteral("Virtual sticks plugged at once (1-32)"),
+                                    QStringLiteral("n"), QStringLiteral("8"));
+    QCommandLineOption roundsOption(QStringLiteral("rounds"), QStringLiteral("Plug and unplug cycles"),
+                                    QStringLiteral("n"), QStringLiteral("3"));
+    QCommandLineOption sizeOption(QStringLiteral("size-mb"), QStringLiteral("Size of each stick"), QStringLiteral("mb"),
+                                  QStringLiteral("64"));
+    QCommandLineOption isoOption(QStringLiteral("iso"),
+                                 QStringLiteral("Image copied onto every stick, with its .sha256 if present; turns on "
+                                                "the ISO scan on mount"),
+                                 QStringLiteral("path"));
+    QCommandLineOption stagesOption(QStringLiteral("stages"),
+                                    QStringLiteral("Stages each stick must reach before a round ends (default: card, "
+                                                   "mount, and iso_verdict with --iso)"),
+                                    QStringLiteral("list"));
+    QCommandLineOption noMountOption(QStringLiteral("no-mount"),
+                                     QStringLiteral("Leave mounting to the desktop's automounter"));
+    QCommandLineOption timeoutOption(QStringLiteral("timeout-s"), QStringLiteral("Longest wait for a round"),
+                                     QStringLiteral("s"), QStringLiteral("120"));
+    QCommandLineOption binaryOption(QStringLiteral("flashspartan"), QStringLiteral("flashspartan to run headless"),
+                                    QStringLiteral("path"));
+    QCommandLineOption policyOption(QStringLiteral("policy-config"),
+                                    QStringLiteral("Policy store directory to reuse, so enrolled sticks get manifest "
+                                                   "and hash verdicts (default: a fresh one)"),
+                                    QStringLiteral("dir"));
+    QCommandLineOption rootOption(QStringLiteral("root"),
+                                  QStringLiteral("Directory for the images (default: a temporary directory)"),
+                                  QStringLiteral("dir"));
+    QCommandLineOption outputOption({QStringLiteral("o"), QStringLiteral("output")},
+                                    QStringLiteral("Write the JSON here instead of stdout"), QStringLiteral("path"));
+    for (const QCommandLineOption* o : {&sticksOption, &roundsOption, &sizeOption, &isoOption, &stagesOption,
+                                        &noMountOption, &timeoutOption, &binaryOption, &policyOption, &rootOption,
+                                        &outputOption}) {
+        parser.addOption(*o);
+    }
+    parser.process(app);
+
+    const int sticks = parser.value(sticksOption).toInt();
+    const int rounds = parser.value(roundsOption).toInt();
+    const int sizeMb = parser.value(sizeOption).toInt();
+    const int timeoutMs = parser.value(timeoutOption).toInt() * 1000;
+    const QString iso = parser.value(isoOption);
+    const bool mountSticks = !parser.isSet(noMountOption);
+    QStringList expected = {QStringLiteral("card"), QStringLiteral("mount")};
+    if (!iso.isEmpty()) {
+        expected.append(QStringLiteral("iso_verdict"));
+    }
+    if (parser.isSet(stagesOption)) {
+        expected = parser.value(stagesOption).split(u',', Qt::SkipEmptyParts);
+    }
+    if (sticks <= 0 || sticks > kMaxUdcs || rounds <= 0 || sizeMb < 8 || timeoutMs <= 0
+        || std::any_of(expected.cbegin(), expected.cend(), [](const QString& s) { return !kStages.contains(s); })) {
+        std::cerr << "--sticks needs 1 to 32, --rounds and --timeout-s positive numbers, --size-mb at least 8, and "
+                     "--stages names from: "
+                  << kStages.join(u',').toStdString() << '\n';
+        return 2;
+    }
+    if (!iso.isEmpty() && !QFileInfo(iso).isFile()) {
+        std::cerr << "No image at " << iso.toStdString() << '\n';
+        return 2;
+    }
+    const QString binary = parser.isSet(binaryOption)
+                               ? parser.value(binaryOption)
+#ifdef FLASHSPARTAN_BINARY_PATH
+                               : QStringLiteral(FLASHSPARTAN_BINARY_PATH);
+#else
+                               : QString();
+#endif
+    if (binary.isEmpty() || !QFileInfo(binary).isExecutable()) {
+        std::cerr << "flashspartan not found; pass --flashspartan\n";
+        return 2;
+    }
+    if (::geteuid() != 0) {
+        std::cerr << "Needs root: it creates USB gadgets and mounts the sticks\n";
+        return 2;
+    }
+
+    // One UDC per stick; a dummy_hcd already loaded with fewer is reloaded.
+    if (dummyUdcs().size() < sticks) {
+        QProcess::execute(QStringLiteral("modprobe"), {QStringLiteral("-r"), QStringLiteral("dummy_hcd")});
+        if (!run(QStringLiteral("modprobe"), {QStringLiteral("libcomposite")})
+            || !run(QStringLiteral("modprobe"), {QStringLiteral("dummy_hcd"), QStringLiteral("num=%1").arg(sticks)})) {
+            return 2;
+        }
+    }
+    const QStringList udcs = dummyUdcs();
+    if (udcs.size() < sticks || !QFileInfo(kGadgetRoot).isDir()) {
+        std::cerr << "Need " << sticks << " dummy_udc controllers and configfs at " << kGadgetRoot.toStdString()
+                  << "; found " << udcs.size() << '\n';
+        return 2;
+    }
+
+    QTemporaryDir scratch(parser.isSet(rootOption)
+                              ? QDir(parser.value(rootOption)).filePath(QStringLiteral("bench_connect_latency-XXXXXX"))
+                              : QDir::temp().filePath(QStringLiteral("bench_connect_latency-XXXXXX")));
+    if (!scratch.isValid()) {
+        std::cerr << "Cannot create a scratch directory\n";
+        return 2;
+    }
+    const QDir dir(scratch.path());
+    const QString runtimeDir = dir.filePath(QStringLiteral("run"));
+    QDir().mkpath(runtimeDir);
+    QFile::setPermissions(runtimeDir, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+    const QString configHome = dir.filePath(QStringLiteral("config"));
+    QDir().mkpath(configHome + QStringLiteral("/flashspartan"));
+    const QByteArray settings = QByteArrayLiteral("[iso]\nautoVerifyOnUsbMount=")
+                                + (iso.isEmpty() ? "false" : "true") + QByteArrayLiteral("\n");
+    if (!writeAttr(configHome + QStringLiteral("/flashspartan/FlashSpartan.conf"), settings)) {
+        std::cerr << "Cannot write the headless settings\n";
+        return 2;
+    }
+    const QString policyDir =
+        parser.isSet(policyOption) ? parser.value(policyOption) : dir.filePath(QStringLiteral("policy"));
+    QDir().mkpath(policyDir);
+
+    QElapsedTimer setupTimer;
+    setupTimer.start();
+    bool ready = true;
+    for (int i = 0; i < sticks && ready; ++i) {
+        const QString image = dir.filePath(QStringLiteral("stick%1.img").arg(i));
+        removeGadget(i);  // left over from an interrupted run
+        ready = makeBackingImage(image, sizeMb, iso, dir.filePath(QStringLiteral("fill"))) && createGadget(i, image);
+        if (!ready) {
+            std::cerr << "Cannot set up stick " << i << '\n';
+        }
+    }
+    const double setupSeconds = setupTimer.elapsed() / 1000.0;
+
+    QProcess service;
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    env.insert(QStringLiteral("XDG_RUNTIME_DIR"), runtimeDir);
+    env.insert(QStringLiteral("XDG_CONFIG_HOME"), configHome);
+    env.insert(QStringLiteral("XDG_DATA_HOME"), dir.filePath(QStringLiteral("data")));
+    env.insert(QStringLiteral("FLASHSPARTAN_POLICY_IN_PROCESS"), QStringLiteral("1"));
+    env.insert(QStringLiteral("FLASHSPARTAN_POLICY_CONFIG"), policyDir);
+    service.setProcessEnvironment(env);
+    service.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    service.setStandardOutputFile(QProcess::nullDevice());
+    StatusStream status;
+    if (ready) {
+        service.start(binary, {QStringLiteral("--headless")});
+        ready = service.waitForStarted(10000)
+                && status.connectTo(runtimeDir + QStringLiteral("/flashspartan-monitor.sock"), 30000);
+        while (ready) {  // the snapshot comes first; events after it are ours
+            const QJsonObject line = status.next(30000);
+            ready = !line.isEmpty();
+            if (line.value(QStringLiteral("type")).toString() == QLatin1String("snapshot")) {
+                break;
+            }
+        }
+        if (!ready) {
+            std::cerr << "flashspartan --headless did not come up\n";
+        }
+    }
+
+    QHash<QString, std::vector<double>> latencies;  // by stage
+    std::vector<double> plugToCard;
+    QJsonArray roundResults;
+    int timedOut = 0;
+    for (int round = 0; round < rounds && ready; ++round) {
+        QHash<QString, Stick> bySerial;
+        QHash<QString, QString> serialByNode;
+        for (int i = 0; i < sticks; ++i) {
+            bySerial.insert(serialFor(i), Stick{serialFor(i)});
+        }
+        auto done = [&](const Stick& s) {
+            return std::all_of(expected.cbegin(), expected.cend(), [&](const QString& st) { return s.reached.contains(st); });
+        };
+
+        QElapsedTimer plug;
+        plug.start();
+        for (int i = 0; i < sticks; ++i) {
+            if (!writeAttr(gadgetDir(i) + QStringLiteral("/UDC"), udcs.at(i).toLatin1())) {
+                std::cerr << "Cannot bind gadget " << i << " to " << udcs.at(i).toStdString() << '\n';
+            }
+        }
+        int finished = 0;
+        while (finished < sticks && plug.elapsed() < timeoutMs && status.connected()) {
+            const QJsonObject event = status.next(200);
+            if (event.isEmpty()) {
+                continue;
+            }
+            const QString node = event.value(QStringLiteral("device_node")).toString();
+            QString serial = event.value(QStringLiteral("serial")).toString();
+            if (serial.isEmpty()) {
+                serial = serialByNode.value(node);
+            }
+            const auto it = bySerial.find(serial);
+            if (it == bySerial.end()) {
+                continue;  // some other device
+            }
+            Stick& stick = *it;
+            const bool wasDone = done(stick);
+            const QString kind = event.value(QStringLiteral("event")).toString();
+            if (kind == QLatin1String("connected") && stick.deviceNode.isEmpty()) {
+                stick.deviceNode = node;
+                serialByNode.insert(node, serial);
+                plugToCard.push_back(static_cast<double>(plug.nsecsElapsed()) / 1e6);
+                if (mountSticks) {
+                    stick.mountPoint = dir.filePath(QStringLiteral("mnt/%1").arg(serial));
+                    QDir().mkpath(stick.mountPoint);
+                    if (::mount(QFile::encodeName(node).constData(), QFile::encodeName(stick.mountPoint).constData(),
+                                "vfat", MS_RDONLY | MS_NOSUID | MS_NODEV, nullptr) != 0) {
+                        std::cerr << "Cannot mount " << node.toStdString() << '\n';
+                        stick.mountPoint.clear();
+                    }
+                }
+            }
+            const QJsonObject latency = event.value(QStringLiteral("latency_ms")).toObject();
+            for (auto l = latency.begin(); l != latency.end(); ++l) {
+                if (!stick.reached.contains(l.key())) {
+                    stick.reached.insert(l.key());
+                    latencies[l.key()].push_back(l.value().toDouble());
+                }
+            }
+            if (!wasDone && done(stick)) {
+                ++finished;
+            }
+        }
+        const double roundSeconds = static_cast<double>(plug.nsecsElapsed()) / 1e9;
+        timedOut += sticks - finished;
+
+        // Unplug: lazy unmounts first, so a scan still reading a stick does not hold it.
+        for (const Stick& stick : std::as_const(bySerial)) {
+            if (!stick.mountPoint.isEmpty()) {
+                ::umount2(QFile::encodeName(stick.mountPoint).constData(), MNT_DETACH);
+            }
+        }
+        for (int i = 0; i < sticks; ++i) {
+            writeAttr(gadgetDir(i) + QStringLiteral("/UDC"), "\n");
+        }
+        QElapsedTimer unplug;
+        unplug.start();
+        int gone = 0;
+        const int seen = static_cast<int>(serialByNode.size());
+        while (gone < seen && unplug.elapsed() < 30000 && status.connected()) {
+            const QJsonObject event = status.next(200);
+            if (event.value(QStringLiteral("event")).toString() == QLatin1String("disconnected")) {
+                const auto it = bySerial.find(serialByNode.value(event.value(QStringLiteral("device_node")).toString()));
+                if (it != bySerial.end() && !it->disconnected) {
+                    it->disconnected = true;
+                    ++gone;
+                }
+            }
+        }
+
+        QJsonObject result;
+        result.insert(QStringLiteral("round"), round);
+        result.insert(QStringLiteral("seconds"), roundSeconds);
+        result.insert(QStringLiteral("sticks_seen"), seen);
+        result.insert(QStringLiteral("sticks_finished"), finished);
+        result.insert(QStringLiteral("sticks_disconnected"), gone);
+        std::cerr << QJsonDocument(result).toJson(QJsonDocument::Compact).constData() << '\n';
+        roundResults.append(result);
+    }
+
+    if (service.state() == QProcess::Running) {
+        service.terminate();
+        if (!service.waitForFinished(10000)) {
+            service.kill();
+            service.waitForFinished();
+        }
+    }
+    for (int i = sticks - 1; i >= 0; --i) {
+        removeGadget(i);
+    }
+    if (!ready) {
+        return 2;
+    }
+
+    QJsonObject stages;
+    for (const QString& stage : kStages) {
+        stages.insert(stage, stageJson(latencies.value(stage), expected.contains(stage) ? sticks * rounds : 0));
+    }
+    stages.insert(QStringLiteral("plug_to_card"), stageJson(plugToCard, sticks * rounds));
+
+    QJsonObject host;
+    host.insert(QStringLiteral("kernel"), QSysInfo::kernelVersion());
+    host.insert(QStringLiteral("cpu_arch"), QSysInfo::currentCpuArchitecture());
+    host.insert(QStringLiteral("threads"), QThread::idealThreadCount());
+
+    QJsonObject root;
+    root.insert(QStringLiteral("schema"), QLatin1String(kSchema));
+#ifdef FLASHSPARTAN_VERSION
+    root.insert(QStringLiteral("flashspartan_version"), QLatin1String(FLASHSPARTAN_VERSION));
+#endif
+    root.insert(QStringLiteral("host"), host);
+    root.insert(QStringLiteral("sticks"), sticks);
+    root.insert(QStringLiteral("rounds"), rounds);
+    root.insert(QStringLiteral("size_mb"), sizeMb);
+    root.insert(QStringLiteral("iso"), iso.isEmpty() ? QString() : QFileInfo(iso).fileName());
+    root.insert(QStringLiteral("mounted_by_bench"), mountSticks);
+    root.insert(QStringLiteral("expected_stages"), QJsonArray::fromStringList(expected));
+    root.insert(QStringLiteral("setup_seconds"), setupSeconds);
+    root.insert(QStringLiteral("timed_out"), timedOut);
+    root.insert(QStringLiteral("stages"), stages);
+    root.insert(QStringLiteral("rounds_detail"), roundResults);
+    const QByteArray json = QJsonDocument(root).toJson();
+
+    if (!parser.isSet(outputOption)) {
+        std::cout << json.constData();
+        return 0;
+    }
+    QSaveFile out(parser.value(outputOption));
+    if (!out.open(QIODevice::WriteOnly) || out.write(json) != json.size() || !out.commit()) {
+        std::cerr << "Cannot write " << parser.value(outputOption).toStdString() << '\n';
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,464 @@
+/**
+ * bench_iso_verify — end-to-end timings of the ISO verification pipeline.
+ *
+ * Lays out a Ventoy-style stick of synthetic images with a catalog drop-in for them, serves
+ * the publisher checksums and signatures through an IsoHttpClient handler that sleeps for a
+ * configured latency and bandwidth, and points FLASHSPARTAN_GPG_PROGRAM at a stub gpg that
+ * sleeps for a configured signature check. Each pass reports its wall time, the time spent
+ * in every stage (IsoVerifyOptions::stageTimed) and the concurrency reached. Prints one
+ * versioned JSON document; see docs/BENCHMARKS.md. Not a ctest.
+ */
+
+#include "IsoCatalogManifest.h"
+#include "IsoHttpClient.h"
+#include "IsoVerifier.h"
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace FlashSpartan;
+
+namespace {
+
+constexpr auto kSchema = "flashspartan.bench.iso_verify/1";
+constexpr auto kHost = "https://mirror.bench.invalid/releases";
+// The embedded catalog signing key: the in-process key ring holds it, so no key is imported.
+constexpr auto kKeyFingerprint = "541DFAEB302C380671E666C7BBD811EF6FBA0EBC";
+
+const char* const kStages[] = {"image", "hash", "hash_wait", "checksums", "signature_download",
+                               "key_import", "signature_verify"};
+
+struct Interval {
+    qint64 beginNs = 0;
+    qint64 endNs = 0;
+};
+
+/** Every stage interval of one pass, appended from the verifier's worker threads. */
+struct StageLog {
+    QMutex mutex;
+    std::map<QString, std::vector<Interval>> stages;
+
+    void add(const char* stage, qint64 beginNs, qint64 endNs)
+    {
+        QMutexLocker lock(&mutex);
+        stages[QString::fromLatin1(stage)].push_back({beginNs, endNs});
+    }
+};
+
+/** Highest number of @p intervals open at one instant, and the mean over their span. */
+std::pair<int, double> concurrency(std::vector<Interval> intervals)
+{
+    if (intervals.empty()) {
+        return {0, 0.0};
+    }
+    std::vector<std::pair<qint64, int>> edges;
+    edges.reserve(intervals.size() * 2);
+    qint64 first = intervals.front().beginNs;
+    qint64 last = intervals.front().endNs;
+    qint64 busyNs = 0;
+    for (const Interval& i : intervals) {
+        edges.emplace_back(i.beginNs, 1);
+        edges.emplace_back(i.endNs, -1);
+        first = qMin(first, i.beginNs);
+        last = qMax(last, i.endNs);
+        busyNs += i.endNs - i.beginNs;
+    }
+    // Ends sort before begins at the same instant, so back-to-back stages do not overlap.
+    std::sort(edges.begin(), edges.end());
+    int open = 0;
+    int peak = 0;
+    for (const auto& edge : edges) {
+        open += edge.second;
+        peak = qMax(peak, open);
+    }
+    return {peak, last > first ? static_cast<double>(busyNs) / static_cast<double>(last - first) : 1.0};
+}
+
+QJsonObject stageJson(const std::vector<Interval>& intervals)
+{
+    qint64 totalNs = 0;
+    qint64 maxNs = 0;
+    for (const Interval& i : intervals) {
+        totalNs += i.endNs - i.beginNs;
+        maxNs = qMax(maxNs, i.endNs - i.beginNs);
+    }
+    const auto [peak, mean] = concurrency(intervals);
+    QJsonObject obj;
+    obj.insert(QStringLiteral("count"), static_cast<int>(intervals.size()));
+    obj.insert(QStringLiteral("seconds_total"), totalNs / 1e9);
+    obj.insert(QStringLiteral("seconds_mean"), intervals.empty() ? 0.0 : totalNs / 1e9 / intervals.size());
+    obj.insert(QStringLiteral("seconds_max"), maxNs / 1e9);
+    obj.insert(QStringLiteral("peak_in_flight"), peak);
+    obj.insert(QStringLiteral("mean_in_flight"), mean);
+    return obj;
+}
+
+/** Writes @p bytes of pseudo-random data; returns the SHA-256 hex, empty on a write error. */
+QString writeImage(const QString& path, qint64 bytes, uint64_t seed)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return {};
+    }
+    QCryptographicHash sha(QCryptographicHash::Sha256);
+    QByteArray chunk(static_cast<qsizetype>(qMin<qint64>(bytes, 1024 * 1024)), Qt::Uninitialized);
+    uint64_t state = seed | 1;
+    for (qint64 written = 0; written < bytes;) {
+        const qsizetype n = static_cast<qsizetype>(qMin<qint64>(bytes - written, chunk.size()));
+        auto* data = reinterpret_cast<uchar*>(chunk.data());
+        for (qsizetype i = 0; i + 8 <= n; i += 8) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            memcpy(data + i, &state, 8);
+        }
+        if (file.write(chunk.constData(), n) != n) {
+            return {};
+        }
+        sha.addData(QByteArrayView(chunk.constData(), n));
+        written += n;
+    }
+    return QString::fromLatin1(sha.result().toHex());
+}
+
+void dropCache(const QStringList& paths)
+{
+    for (const QString& path : paths) {
+        const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
+        }
+    }
+}
+
+/** A gpg whose --verify sleeps @p gpgMs and reports a good signature by the catalog key. */
+bool writeStubGpg(const QString& path, int gpgMs)
+{
+    const QByteArray script =
+        QStringLiteral("#!/bin/sh\n"
+                       "for arg in \"$@\"; do\n"
+                       "  if [ \"$arg\" = \"--verify\" ]; then\n"
+                       "    sleep %1\n"
+                       "    echo 'gpg: Signature made by bench publisher'\n"
+                       "    echo 'gpg: Good signature from \"Bench Publisher <bench@invalid>\"'\n"
+                       "    echo 'Primary key fingerprint: %2'\n"
+                       "    exit 0\n"
+                       "  fi\n"
+                       "done\n"
+                       "exit 0\n")
+            .arg(gpgMs / 1000.0, 0, 'f', 3)
+            .arg(QLatin1String(kKeyFingerprint))
+            .toUtf8();
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(script) != script.size() || !file.commit()) {
+        return false;
+    }
+    return QFile::setPermissions(path, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+}
+
+bool writeCatalogDropIn(bool perImageSums)
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)
+                        + QStringLiteral("/iso-catalog.d");
+    if (!QDir().mkpath(dir)) {
+        return false;
+    }
+    const QString base = QLatin1String(kHost);
+    QJsonObject entry;
+    entry.insert(QStringLiteral("publisher_id"), QStringLiteral("bench-publisher"));
+    entry.insert(QStringLiteral("publisher_name"), QStringLiteral("FlashSpartan Bench Publisher"));
+    entry.insert(QStringLiteral("file_pattern"), QStringLiteral("^bench-distro-.*\\.iso$"));
+    entry.insert(QStringLiteral("release_label"), QStringLiteral("Benchmark image"));
+    entry.insert(QStringLiteral("sha256"), QString());
+    entry.insert(QStringLiteral("hint_only"), false);
+    entry.insert(QStringLiteral("checksum_url_template"),
+                 perImageSums ? base + QStringLiteral("/{filename}.sha256") : base + QStringLiteral("/SHA256SUMS"));
+    entry.insert(QStringLiteral("signature_url_template"),
+                 perImageSums ? base + QStringLiteral("/{filename}.sha256.gpg")
+                              : base + QStringLiteral("/SHA256SUMS.gpg"));
+    entry.insert(QStringLiteral("signing_key_ids"), QJsonArray{QLatin1String(kKeyFingerprint)});
+    entry.insert(QStringLiteral("trusted_fingerprints"), QJsonArray{QLatin1String(kKeyFingerprint)});
+    const QByteArray json = QJsonDocument(QJsonObject{{QStringLiteral("manifest_version"), 2},
+                                                      {QStringLiteral("entries"), QJsonArray{entry}}})
+                                .toJson();
+    QSaveFile file(dir + QStringLiteral("/bench-publisher.json"));
+    return file.open(QIODevice::WriteOnly) && file.write(json) == json.size() && file.commit();
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setOrganizationName(QStringLiteral("FlashSpartan"));
+    QCoreApplication::setApplicationName(QStringLiteral("bench_iso_verify"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(
+        QStringLiteral("Time ISO verification of a synthetic stick with simulated network and gpg cost"));
+    parser.addHelpOption();
+    QCommandLineOption imagesOption(QStringLiteral("images"), QStringLiteral("Images on the stick"),
+                                    QStringLiteral("n"), QStringLiteral("20"));
+    QCommandLineOption imageSizeOption(QStringLiteral("image-mb"), QStringLiteral("Size of each image"),
+                                       QStringLiteral("mb"), QStringLiteral("64"));
+    QCommandLineOption latencyOption(QStringLiteral("latency-ms"), QStringLiteral("Round trip of each download"),
+                                     QStringLiteral("ms"), QStringLiteral("80"));
+    QCommandLineOption bandwidthOption(QStringLiteral("bandwidth-mbps"),
+                                       QStringLiteral("Download bandwidth in megabits per second"),
+                                       QStringLiteral("mbps"), QStringLiteral("20"));
+    QCommandLineOption gpgOption(QStringLiteral("gpg-ms"), QStringLiteral("Cost of one gpg --verify"),
+                                 QStringLiteral("ms"), QStringLiteral("40"));
+    QCommandLineOption sumsOption(QStringLiteral("sums"),
+                                  QStringLiteral("shared: one signed SHA256SUMS; per-image: one per image"),
+                                  QStringLiteral("layout"), QStringLiteral("shared"));
+    QCommandLineOption jobsOption(QStringLiteral("jobs"), QStringLiteral("Images verified at once (0: scheduler)"),
+                                  QStringLiteral("n"), QStringLiteral("0"));
+    QCommandLineOption dropOption(QStringLiteral("no-drop-cache"),
+                                  QStringLiteral("Leave the images in the page cache for the cold pass"));
+    QCommandLineOption rootOption(QStringLiteral("root"),
+                                  QStringLiteral("Directory to generate the stick in (default: a temporary directory)"),
+                                  QStringLiteral("dir"));
+    QCommandLineOption outputOption({QStringLiteral("o"), QStringLiteral("output")},
+                                    QStringLiteral("Write the JSON here instead of stdout"), QStringLiteral("path"));
+    for (const QCommandLineOption* o : {&imagesOption, &imageSizeOption, &latencyOption, &bandwidthOption, &gpgOption,
+                                        &sumsOption, &jobsOption, &dropOption, &rootOption, &outputOption}) {
+        parser.addOption(*o);
+    }
+    parser.process(app);
+
+    const int images = parser.value(imagesOption).toInt();
+    const int imageMB = parser.value(imageSizeOption).toInt();
+    const int latencyMs = parser.value(latencyOption).toInt();
+    const double bandwidthMbps = parser.value(bandwidthOption).toDouble();
+    const int gpgMs = parser.value(gpgOption).toInt();
+    const int jobs = parser.value(jobsOption).toInt();
+    const QString sums = parser.value(sumsOption);
+    if (images <= 0 || imageMB <= 0 || bandwidthMbps <= 0.0 || latencyMs < 0 || gpgMs < 0 || jobs < 0) {
+        std::cerr << "--images, --image-mb and --bandwidth-mbps need positive numbers, "
+                     "--latency-ms, --gpg-ms and --jobs non-negative ones\n";
+        return 2;
+    }
+    if (sums != QLatin1String("shared") && sums != QLatin1String("per-image")) {
+        std::cerr << "Unknown --sums layout " << sums.toStdString() << '\n';
+        return 2;
+    }
+    const bool perImageSums = sums == QLatin1String("per-image");
+
+    QTemporaryDir scratch(parser.isSet(rootOption)
+                              ? QDir(parser.value(rootOption)).filePath(QStringLiteral("bench_iso_verify-XXXXXX"))
+                              : QDir::temp().filePath(QStringLiteral("bench_iso_verify-XXXXXX")));
+    if (!scratch.isValid()) {
+        std::cerr << "Cannot create a scratch directory\n";
+        return 2;
+    }
+    const QDir scratchDir(scratch.path());
+
+    // Catalog, artifact store, hash cache and gpg homedir all live under the scratch directory.
+    qputenv("FLASHSPARTAN_SKIP_REMOTE_CATALOG", "1");
+    qputenv("FLASHSPARTAN_SKIP_KEYSERVER_IMPORT", "1");
+    qputenv("XDG_CONFIG_HOME", QFile::encodeName(scratchDir.filePath(QStringLiteral("config"))));
+    qputenv("XDG_CACHE_HOME", QFile::encodeName(scratchDir.filePath(QStringLiteral("cache"))));
+    qunsetenv("GNUPGHOME");
+    QStandardPaths::setTestModeEnabled(true);
+
+    const QString gpgPath = scratchDir.filePath(QStringLiteral("gpg"));
+    if (!writeStubGpg(gpgPath, gpgMs)) {
+        std::cerr << "Cannot write the stub gpg\n";
+        return 2;
+    }
+    qputenv("FLASHSPARTAN_GPG_PROGRAM", QFile::encodeName(gpgPath));
+    if (!writeCatalogDropIn(perImageSums)) {
+        std::cerr << "Cannot write the catalog drop-in\n";
+        return 2;
+    }
+    IsoCatalogManifest::reload();
+
+    const QString stick = scratchDir.filePath(QStringLiteral("ventoy"));
+    if (!QDir().mkpath(stick)) {
+        std::cerr << "Cannot create the stick directory\n";
+        return 2;
+    }
+    QStringList paths;
+    QByteArray sharedSums;
+    QHash<QString, QByteArray> served;
+    QElapsedTimer genTimer;
+    genTimer.start();
+    for (int i = 0; i < images; ++i) {
+        const QString name = QStringLiteral("bench-distro-%1-x86_64.iso").arg(i + 1, 2, 10, QLatin1Char('0'));
+        const QString path = QDir(stick).filePath(name);
+        const QString sha = writeImage(path, qint64(imageMB) * 1024 * 1024, 0x9e3779b97f4a7c15ULL * (i + 1));
+        if (sha.isEmpty()) {
+            std::cerr << "Cannot write " << path.toStdString() << '\n';
+            return 2;
+        }
+        paths.append(path);
+        const QByteArray line = QStringLiteral("%1  %2\n").arg(sha, name).toUtf8();
+        sharedSums += line;
+        if (perImageSums) {
+            served.insert(QStringLiteral("%1/%2.sha256").arg(QLatin1String(kHost), name), line);
+            served.insert(QStringLiteral("%1/%2.sha256.gpg").arg(QLatin1String(kHost), name),
+                          QByteArray(566, '\x89'));
+        }
+    }
+    const double generateSeconds = genTimer.elapsed() / 1000.0;
+    if (!perImageSums) {
+        served.insert(QStringLiteral("%1/SHA256SUMS").arg(QLatin1String(kHost)), sharedSums);
+        // Not OpenPGP: the in-process verifier reports it malformed and hands it to the stub gpg.
+        served.insert(QStringLiteral("%1/SHA256SUMS.gpg").arg(QLatin1String(kHost)), QByteArray(566, '\x89'));
+    }
+
+    QMutex requestsMutex;
+    int requests = 0;
+    qint64 requestBytes = 0;
+    IsoHttpClient::setHandler([&](const QString& url, QString* errorOut, int) {
+        const auto it = served.constFind(url);
+        const QByteArray body = it == served.constEnd() ? QByteArray() : it.value();
+        const double transferMs = body.size() * 8.0 / (bandwidthMbps * 1e6) * 1000.0;
+        QThread::usleep(static_cast<unsigned long>((latencyMs + transferMs) * 1000.0));
+        {
+            QMutexLocker lock(&requestsMutex);
+            ++requests;
+            requestBytes += body.size();
+        }
+        if (body.isEmpty() && errorOut) {
+            *errorOut = QStringLiteral("HTTP 404");
+        }
+        return body;
+    });
+
+    QJsonArray passes;
+    for (const QString& pass : {QStringLiteral("cold"), QStringLiteral("warm")}) {
+        if (pass == QLatin1String("cold") && !parser.isSet(dropOption)) {
+            dropCache(paths);
+        }
+        StageLog log;
+        IsoVerifyOptions opt;
+        opt.useHashCache = true;  // empty for the cold pass, filled by it for the warm one
+        opt.parallelLimit = jobs;
+        opt.stageTimed = [&log](const QString&, const char* stage, qint64 beginNs, qint64 endNs) {
+            log.add(stage, beginNs, endNs);
+        };
+        IsoVerifier::setVerifyOptions(opt);
+        {
+            QMutexLocker lock(&requestsMutex);
+            requests = 0;
+            requestBytes = 0;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        const QList<IsoVerifyResult> results = IsoVerifier::verifyFiles(paths);
+        const double wallSeconds = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+
+        int passed = 0;
+        int signatureChecked = 0;
+        int fromStore = 0;
+        QJsonArray failures;
+        for (const IsoVerifyResult& r : results) {
+            passed += r.passed() ? 1 : 0;
+            signatureChecked += r.pgpChecked ? 1 : 0;
+            fromStore += r.artifactsFromStore ? 1 : 0;
+            if (!r.passed()) {
+                failures.append(QJsonObject{{QStringLiteral("image"), QFileInfo(r.isoPath).fileName()},
+                                            {QStringLiteral("error"), r.errorMessage.isEmpty() ? r.pgpSummary
+                                                                                                : r.errorMessage}});
+            }
+        }
+
+        QJsonObject stages;
+        for (const char* stage : kStages) {
+            stages.insert(QLatin1String(stage), stageJson(log.stages[QString::fromLatin1(stage)]));
+        }
+        std::vector<Interval> downloads = log.stages[QStringLiteral("checksums")];
+        const std::vector<Interval>& signatures = log.stages[QStringLiteral("signature_download")];
+        downloads.insert(downloads.end(), signatures.begin(), signatures.end());
+
+        QJsonObject line;
+        line.insert(QStringLiteral("pass"), pass);
+        line.insert(QStringLiteral("images"), static_cast<int>(results.size()));
+        line.insert(QStringLiteral("passed"), passed);
+        line.insert(QStringLiteral("signature_checked"), signatureChecked);
+        line.insert(QStringLiteral("artifacts_from_store"), fromStore);
+        line.insert(QStringLiteral("http_requests"), requests);
+        line.insert(QStringLiteral("http_bytes"), static_cast<double>(requestBytes));
+        line.insert(QStringLiteral("seconds"), wallSeconds);
+        if (wallSeconds > 0.0) {
+            line.insert(QStringLiteral("images_per_s"), results.size() / wallSeconds);
+            line.insert(QStringLiteral("mbps"), double(images) * imageMB / wallSeconds);
+        }
+        line.insert(QStringLiteral("peak_images_in_flight"), stages.value(QStringLiteral("image"))
+                                                                 .toObject()
+                                                                 .value(QStringLiteral("peak_in_flight")));
+        line.insert(QStringLiteral("peak_downloads_in_flight"), concurrency(downloads).first);
+        line.insert(QStringLiteral("stages"), stages);
+        if (!failures.isEmpty()) {
+            line.insert(QStringLiteral("failures"), failures);
+        }
+        std::cerr << QJsonDocument(line).toJson(QJsonDocument::Compact).constData() << '\n';
+        passes.append(line);
+    }
+    IsoHttpClient::reset();
+
+    QJsonObject host;
+    host.insert(QStringLiteral("kernel"), QSysInfo::kernelVersion());
+    host.insert(QStringLiteral("cpu_arch"), QSysInfo::currentCpuArchitecture());
+    host.insert(QStringLiteral("threads"), QThread::idealThreadCount());
+
+    QJsonObject simulated;
+    simulated.insert(QStringLiteral("latency_ms"), latencyMs);
+    simulated.insert(QStringLiteral("bandwidth_mbps"), bandwidthMbps);
+    simulated.insert(QStringLiteral("gpg_ms"), gpgMs);
+    simulated.insert(QStringLiteral("sums"), sums);
+
+    QJsonObject root;
+    root.insert(QStringLiteral("schema"), QLatin1String(kSchema));
+#ifdef FLASHSPARTAN_VERSION
+    root.insert(QStringLiteral("flashspartan_version"), QLatin1String(FLASHSPARTAN_VERSION));
+#endif
+    root.insert(QStringLiteral("host"), host);
+    root.insert(QStringLiteral("images"), images);
+    root.insert(QStringLiteral("image_bytes"), static_cast<double>(qint64(imageMB) * 1024 * 1024));
+    root.insert(QStringLiteral("jobs"), jobs);
+    root.insert(QStringLiteral("generate_seconds"), generateSeconds);
+    root.insert(QStringLiteral("simulated"), simulated);
+    root.insert(QStringLiteral("passes"), passes);
+    const QByteArray json = QJsonDocument(root).toJson();
+
+    if (!parser.isSet(outputOption)) {
+        std::cout << json.constData();
+        return 0;
+    }
+    QSaveFile out(parser.value(outputOption));
+    if (!out.open(QIODevice::WriteOnly) || out.write(json) != json.size() || !out.commit()) {
+        std::cerr << "Cannot write " << parser.value(outputOption).toStdString() << '\n';
+        return 2;
+    }
+    return 0;
+}
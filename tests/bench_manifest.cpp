@@ -0,0 +1,419 @@
+/**
+ * bench_manifest — timings of the watch-manifest build and verify paths.
+ *
+ * Generates synthetic mount trees (many tiny files, a few huge ones, deep nesting, a mixed
+ * size spread) and times ManifestService::buildGroup, verifyGroup (full, metadata-first and
+ * journal-touched), verifyManifest and MerkleTree::build separately, each with a cold and a
+ * warm page cache. Prints one versioned JSON document; see docs/BENCHMARKS.md. Not a ctest.
+ */
+
+#include "ManifestService.h"
+#include "MerkleTree.h"
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSet>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace FlashSpartan;
+
+namespace {
+
+constexpr auto kSchema = "flashspartan.bench.manifest/1";
+
+/** A synthetic tree: @p files files spread over directories @p depth levels deep. */
+struct Profile {
+    QString name;
+    int files = 0;
+    int filesPerDir = 0;
+    int depth = 1;
+    uint64_t minBytes = 0;
+    uint64_t maxBytes = 0;  // sizes are log-uniform between min and max
+};
+
+QList<Profile> builtinProfiles(double scale, int hugeMB)
+{
+    auto scaled = [scale](int n) { return qMax(1, static_cast<int>(n * scale)); };
+    return {
+        {QStringLiteral("tiny"), scaled(20000), 200, 2, 256, 4 * 1024},
+        {QStringLiteral("huge"), scaled(4), 4, 1, uint64_t(hugeMB) * 1024 * 1024, uint64_t(hugeMB) * 1024 * 1024},
+        {QStringLiteral("deep"), scaled(2000), 4, 12, 8 * 1024, 64 * 1024},
+        {QStringLiteral("mixed"), scaled(5000), 100, 4, 1024, 16 * 1024 * 1024},
+    };
+}
+
+/** xorshift64; the tree is the same for the same profile on every run. */
+struct Random {
+    uint64_t state;
+
+    uint64_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+uint64_t sizeFor(const Profile& p, Random& rng)
+{
+    if (p.maxBytes <= p.minBytes) {
+        return p.minBytes;
+    }
+    const double lo = std::log(static_cast<double>(qMax<uint64_t>(1, p.minBytes)));
+    const double hi = std::log(static_cast<double>(p.maxBytes));
+    const double t = static_cast<double>(rng.next() % 1000000) / 1000000.0;
+    return static_cast<uint64_t>(std::exp(lo + (hi - lo) * t));
+}
+
+bool writeFile(const QString& path, uint64_t size, Random& rng)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QByteArray chunk(static_cast<qsizetype>(qMin<uint64_t>(size, 1024 * 1024)), Qt::Uninitialized);
+    for (uint64_t written = 0; written < size;) {
+        const qsizetype n = static_cast<qsizetype>(qMin<uint64_t>(size - written, chunk.size()));
+        auto* bytes = reinterpret_cast<uchar*>(chunk.data());
+        for (qsizetype i = 0; i + 8 <= n; i += 8) {
+            const uint64_t word = rng.next();
+            memcpy(bytes + i, &word, 8);
+        }
+        if (file.write(chunk.constData(), n) != n) {
+            return false;
+        }
+        written += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+/** Writes @p p under @p dataDir; returns the total bytes, or -1 on a write error. */
+qint64 generate(const Profile& p, const QString& dataDir)
+{
+    Random rng{0x2545f4914f6cdd1dULL ^ qHash(p.name)};
+    qint64 total = 0;
+    for (int i = 0; i < p.files; ++i) {
+        const int dirIndex = i / qMax(1, p.filesPerDir);
+        QString dir = dataDir;
+        for (int level = 0; level < p.depth; ++level) {
+            dir += QStringLiteral("/d%1").arg(level == p.depth - 1 ? dirIndex : dirIndex % 7);
+        }
+        if (!QDir().mkpath(dir)) {
+            return -1;
+        }
+        const uint64_t size = sizeFor(p, rng);
+        if (!writeFile(QStringLiteral("%1/f%2.bin").arg(dir).arg(i), size, rng)) {
+            return -1;
+        }
+        total += static_cast<qint64>(size);
+    }
+    return total;
+}
+
+/** Evicts the data pages of every file under @p dir; dentries and inodes stay cached. */
+void dropCache(const QString& dir)
+{
+    QDirIterator it(dir, QDir::Files | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QByteArray path = QFile::encodeName(it.next());
+        const int fd = ::open(path.constData(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            fdatasync(fd);
+            posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
+        }
+    }
+}
+
+struct Timing {
+    std::vector<double> seconds;
+    bool ok = true;
+    QString error;
+};
+
+QJsonObject timingJson(const QString& profile, const QString& operation, const QString& cache,
+                       int files, qint64 bytes, Timing t)
+{
+    QJsonObject obj;
+    obj.insert(QStringLiteral("profile"), profile);
+    obj.insert(QStringLiteral("operation"), operation);
+    obj.insert(QStringLiteral("cache"), cache);
+    obj.insert(QStringLiteral("files"), files);
+    obj.insert(QStringLiteral("bytes"), static_cast<double>(bytes));
+    obj.insert(QStringLiteral("runs"), static_cast<int>(t.seconds.size()));
+    obj.insert(QStringLiteral("success"), t.ok);
+    if (!t.ok) {
+        obj.insert(QStringLiteral("error"), t.error);
+        return obj;
+    }
+    std::sort(t.seconds.begin(), t.seconds.end());
+    const double median = t.seconds[t.seconds.size() / 2];
+    obj.insert(QStringLiteral("seconds"), median);
+    obj.insert(QStringLiteral("seconds_min"), t.seconds.front());
+    obj.insert(QStringLiteral("seconds_max"), t.seconds.back());
+    if (median > 0.0) {
+        obj.insert(QStringLiteral("files_per_s"), files / median);
+        obj.insert(QStringLiteral("mbps"), static_cast<double>(bytes) / (1024.0 * 1024.0) / median);
+    }
+    return obj;
+}
+
+/** Runs @p op @p repeat times; @p before (cache eviction) is not timed. */
+Timing measure(int repeat, const std::function<void()>& before, const std::function<QString()>& op)
+{
+    Timing t;
+    for (int i = 0; i < repeat; ++i) {
+        if (before) {
+            before();
+        }
+        QElapsedTimer timer;
+        timer.start();
+        const QString error = op();
+        t.seconds.push_back(static_cast<double>(timer.nsecsElapsed()) / 1e9);
+        if (!error.isEmpty()) {
+            t.ok = false;
+            t.error = error;
+            break;
+        }
+    }
+    return t;
+}
+
+QString verifyError(const ManifestService::VerifyResult& r)
+{
+    if (!r.success) {
+        return r.errorMessage;
+    }
+    return r.matches ? QString() : QStringLiteral("The unchanged tree did not match its baseline");
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("bench_manifest"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Time watch-manifest build and verify on synthetic trees"));
+    parser.addHelpOption();
+    QCommandLineOption profilesOption(QStringLiteral("profiles"), QStringLiteral("Comma-separated: tiny, huge, deep, mixed"),
+                                      QStringLiteral("list"), QStringLiteral("tiny,huge,deep,mixed"));
+    QCommandLineOption scaleOption(QStringLiteral("scale"), QStringLiteral("Multiplier for every profile's file count"),
+                                   QStringLiteral("factor"), QStringLiteral("1"));
+    QCommandLineOption hugeOption(QStringLiteral("huge-mb"), QStringLiteral("Size of each file of the huge profile"),
+                                  QStringLiteral("mb"), QStringLiteral("256"));
+    QCommandLineOption chunkOption(QStringLiteral("chunk-threshold-mb"),
+                                   QStringLiteral("Give files this large chunk lists (0: none)"),
+                                   QStringLiteral("mb"), QStringLiteral("0"));
+    QCommandLineOption touchedOption(QStringLiteral("touched-percent"),
+                                     QStringLiteral("Files in the journal-touched verify"), QStringLiteral("percent"),
+                                     QStringLiteral("1"));
+    QCommandLineOption repeatOption(QStringLiteral("repeat"), QStringLiteral("Runs per measurement; the median is reported"),
+                                    QStringLiteral("n"), QStringLiteral("3"));
+    QCommandLineOption cacheOption(QStringLiteral("cache"), QStringLiteral("Comma-separated: cold, warm"),
+                                   QStringLiteral("list"), QStringLiteral("cold,warm"));
+    QCommandLineOption rootOption(QStringLiteral("root"),
+                                  QStringLiteral("Directory to generate the trees in (default: a temporary directory)"),
+                                  QStringLiteral("dir"));
+    QCommandLineOption outputOption({QStringLiteral("o"), QStringLiteral("output")},
+                                    QStringLiteral("Write the JSON here instead of stdout"), QStringLiteral("path"));
+    for (const QCommandLineOption* o : {&profilesOption, &scaleOption, &hugeOption, &chunkOption, &touchedOption,
+                                        &repeatOption, &cacheOption, &rootOption, &outputOption}) {
+        parser.addOption(*o);
+    }
+    parser.process(app);
+
+    const double scale = parser.value(scaleOption).toDouble();
+    const int hugeMB = parser.value(hugeOption).toInt();
+    const int repeat = parser.value(repeatOption).toInt();
+    const int touchedPercent = parser.value(touchedOption).toInt();
+    const uint64_t chunkThreshold = parser.value(chunkOption).toULongLong() * 1024 * 1024;
+    if (scale <= 0.0 || hugeMB <= 0 || repeat <= 0 || touchedPercent < 0 || touchedPercent > 100) {
+        std::cerr << "--scale, --huge-mb and --repeat need positive numbers, --touched-percent 0 to 100\n";
+        return 2;
+    }
+    const QStringList caches = parser.value(cacheOption).split(u',', Qt::SkipEmptyParts);
+    for (const QString& cache : caches) {
+        if (cache != QLatin1String("cold") && cache != QLatin1String("warm")) {
+            std::cerr << "Unknown cache state " << cache.toStdString() << '\n';
+            return 2;
+        }
+    }
+    QList<Profile> profiles;
+    const QList<Profile> builtins = builtinProfiles(scale, hugeMB);
+    for (const QString& name : parser.value(profilesOption).split(u',', Qt::SkipEmptyParts)) {
+        const auto it = std::find_if(builtins.cbegin(), builtins.cend(),
+                                     [&name](const Profile& p) { return p.name == name; });
+        if (it == builtins.cend()) {
+            std::cerr << "Unknown profile " << name.toStdString() << '\n';
+            return 2;
+        }
+        profiles.append(*it);
+    }
+
+    QTemporaryDir scratch(parser.isSet(rootOption)
+                              ? QDir(parser.value(rootOption)).filePath(QStringLiteral("bench_manifest-XXXXXX"))
+                              : QDir::temp().filePath(QStringLiteral("bench_manifest-XXXXXX")));
+    if (!scratch.isValid()) {
+        std::cerr << "Cannot create a scratch directory\n";
+        return 2;
+    }
+
+    QJsonArray results;
+    QJsonArray trees;
+    for (const Profile& profile : profiles) {
+        const QString mount = QDir(scratch.path()).filePath(profile.name);
+        const QString dataDir = mount + QStringLiteral("/data");
+        QElapsedTimer genTimer;
+        genTimer.start();
+        const qint64 bytes = generate(profile, dataDir);
+        if (bytes < 0) {
+            std::cerr << "Cannot write the " << profile.name.toStdString() << " tree\n";
+            return 2;
+        }
+        const QString canonicalMount = QDir(mount).canonicalPath();
+        trees.append(QJsonObject{{QStringLiteral("profile"), profile.name},
+                                 {QStringLiteral("files"), profile.files},
+                                 {QStringLiteral("bytes"), static_cast<double>(bytes)},
+                                 {QStringLiteral("depth"), profile.depth},
+                                 {QStringLiteral("generate_seconds"), genTimer.elapsed() / 1000.0}});
+
+        WatchGroup spec;
+        spec.id = profile.name;
+        spec.name = profile.name;
+        spec.watchPaths = {QStringLiteral("data")};
+        spec.chunkThresholdBytes = chunkThreshold;
+
+        // The baseline every verify compares against, built once outside the timings.
+        const ManifestService::BuildResult baseline = ManifestService::buildGroup(canonicalMount, spec);
+        if (!baseline.success) {
+            std::cerr << "Cannot build the " << profile.name.toStdString()
+                      << " baseline: " << baseline.errorMessage.toStdString() << '\n';
+            return 2;
+        }
+        WatchManifest manifest;
+        manifest.groups = {baseline.group};
+        manifest.manifestRoot = ManifestService::manifestRootHex(manifest);
+
+        QSet<QString> touched;
+        const int touchEvery = touchedPercent > 0 ? qMax(1, 100 / touchedPercent) : 0;
+        for (qsizetype i = 0; touchEvery > 0 && i < baseline.group.files.size(); i += touchEvery) {
+            touched.insert(baseline.group.files.at(i).relativePath);
+        }
+        qint64 touchedBytes = 0;
+        for (const WatchFileEntry& f : baseline.group.files) {
+            if (touched.contains(f.relativePath)) {
+                touchedBytes += static_cast<qint64>(f.sizeBytes);
+            }
+        }
+
+        ManifestVerifyPolicy metadataFirst;
+        metadataFirst.metadataFirst = true;
+
+        for (const QString& cache : caches) {
+            const bool cold = cache == QLatin1String("cold");
+            const std::function<void()> before = cold ? std::function<void()>([&] { dropCache(dataDir); })
+                                                      : std::function<void()>();
+            if (!cold) {
+                ManifestService::buildGroup(canonicalMount, spec);  // warm the page cache
+            }
+            auto record = [&](const QString& op, int files, qint64 opBytes, const Timing& t) {
+                const QJsonObject line = timingJson(profile.name, op, cache, files, opBytes, t);
+                std::cerr << QJsonDocument(line).toJson(QJsonDocument::Compact).constData() << '\n';
+                results.append(line);
+            };
+
+            record(QStringLiteral("build_group"), profile.files, bytes, measure(repeat, before, [&] {
+                const ManifestService::BuildResult r = ManifestService::buildGroup(canonicalMount, spec);
+                return r.success ? QString() : r.errorMessage;
+            }));
+            record(QStringLiteral("verify_group"), profile.files, bytes, measure(repeat, before, [&] {
+                return verifyError(ManifestService::verifyGroup(canonicalMount, baseline.group));
+            }));
+            record(QStringLiteral("verify_group_metadata_first"), profile.files, bytes, measure(repeat, before, [&] {
+                return verifyError(ManifestService::verifyGroup(canonicalMount, baseline.group, metadataFirst));
+            }));
+            if (touchEvery > 0) {
+                record(QStringLiteral("verify_group_touched"), static_cast<int>(touched.size()), touchedBytes,
+                       measure(repeat, before, [&] {
+                           return verifyError(ManifestService::verifyGroup(canonicalMount, baseline.group, {},
+                                                                           &touched));
+                       }));
+            }
+            record(QStringLiteral("verify_manifest"), profile.files, bytes, measure(repeat, before, [&] {
+                return verifyError(ManifestService::verifyManifest(canonicalMount, manifest));
+            }));
+        }
+
+        // In memory only, so one measurement regardless of the cache state.
+        const MerkleTree::Shape shape{static_cast<MerkleTree::Format>(baseline.group.merkleFormat),
+                                      baseline.group.merkleFanOut};
+        QVector<MerkleTree::Leaf> leaves;
+        leaves.reserve(baseline.group.files.size());
+        for (const WatchFileEntry& f : baseline.group.files) {
+            leaves.append({f.relativePath, f.contentHash,
+                           MerkleTree::leafDigest(f.relativePath, f.contentHash, shape.format)});
+        }
+        const QJsonObject merkle = timingJson(profile.name, QStringLiteral("merkle_build"), QStringLiteral("memory"),
+                                              profile.files, 0, measure(repeat, {}, [&] {
+                                                  return MerkleTree::build(leaves, shape).rootHex() == baseline.group.merkleRoot
+                                                             ? QString()
+                                                             : QStringLiteral("Merkle root differs from the build");
+                                              }));
+        std::cerr << QJsonDocument(merkle).toJson(QJsonDocument::Compact).constData() << '\n';
+        results.append(merkle);
+
+        QDir(mount).removeRecursively();
+    }
+
+    QJsonObject host;
+    host.insert(QStringLiteral("kernel"), QSysInfo::kernelVersion());
+    host.insert(QStringLiteral("cpu_arch"), QSysInfo::currentCpuArchitecture());
+    host.insert(QStringLiteral("threads"), QThread::idealThreadCount());
+
+    QJsonObject root;
+    root.insert(QStringLiteral("schema"), QLatin1String(kSchema));
+#ifdef FLASHSPARTAN_VERSION
+    root.insert(QStringLiteral("flashspartan_version"), QLatin1String(FLASHSPARTAN_VERSION));
+#endif
+    root.insert(QStringLiteral("host"), host);
+    root.insert(QStringLiteral("repeat"), repeat);
+    root.insert(QStringLiteral("chunk_threshold_bytes"), static_cast<double>(chunkThreshold));
+    root.insert(QStringLiteral("trees"), trees);
+    root.insert(QStringLiteral("results"), results);
+    const QByteArray json = QJsonDocument(root).toJson();
+
+    if (!parser.isSet(outputOption)) {
+        std::cout << json.constData();
+        return 0;
+    }
+    QSaveFile out(parser.value(outputOption));
+    if (!out.open(QIODevice::WriteOnly) || out.write(json) != json.size() || !out.commit()) {
+        std::cerr << "Cannot write " << parser.value(outputOption).toStdString() << '\n';
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,451 @@
+/**
+ * bench_policy_store — how the policy store scales with the number of device records.
+ *
+ * Fills a PolicyStoreEngine with synthetic DeviceRecords (a share of them carrying large
+ * watch manifests) for each requested size and times load(), snapshot(), one upsert, a bulk
+ * remove and the bulk re-insert in-process, then the same reads and writes through a
+ * flashspartan-policyd started on that store via PolicyDaemonClient. Reports the blob size
+ * and the resident memory of both processes. Prints one versioned JSON document; see
+ * docs/BENCHMARKS.md. Not a ctest.
+ */
+
+#include "policy/PolicyDaemonClient.h"
+#include "policy/PolicyDaemonLauncher.h"
+#include "policy/PolicyStoreEngine.h"
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using namespace FlashSpartan;
+using namespace FlashSpartan::Policy;
+
+namespace {
+
+constexpr auto kSchema = "flashspartan.bench.policy_store/1";
+const QString kActor = QStringLiteral("bench");
+
+QString hexDigest(quint64 seed, int words)
+{
+    QString out;
+    out.reserve(words * 16);
+    for (int i = 0; i < words; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        out += QStringLiteral("%1").arg(seed, 16, 16, QLatin1Char('0'));
+    }
+    return out;
+}
+
+/** Record @p i; every @p manifestEvery-th one has a watch manifest of @p manifestFiles files. */
+DeviceRecord makeRecord(int i, int manifestEvery, int manifestFiles)
+{
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    DeviceRecord r;
+    r.uniqueId = QStringLiteral("bench_%1_%2/sd%3").arg(i % 97).arg(i).arg(QChar(char16_t(u'a' + i % 26)));
+    r.hash = hexDigest(0x9e3779b97f4a7c15ULL + i, 4);
+    r.hashScope = QStringLiteral("partition");
+    r.hashScanMode = QStringLiteral("full");
+    r.firstSeen = now.addDays(-(i % 365));
+    r.lastSeen = now;
+    r.lastHashed = now;
+    r.hashDurationMs = 1000 + i % 5000;
+    r.trustLevel = i % 3;
+    r.notes = QStringLiteral("fleet stick %1").arg(i);
+    r.lastKnownInfo.deviceNode = QStringLiteral("/dev/sd%1").arg(QChar(char16_t(u'a' + i % 26)));
+    r.lastKnownInfo.serial = QStringLiteral("SN%1").arg(i, 10, 10, QLatin1Char('0'));
+    r.lastKnownInfo.vendor = QStringLiteral("Vendor%1").arg(i % 20);
+    r.lastKnownInfo.model = QStringLiteral("Model %1").arg(i % 50);
+    r.lastKnownInfo.label = QStringLiteral("STICK%1").arg(i);
+    r.lastKnownInfo.fsType = QStringLiteral("vfat");
+    r.lastKnownInfo.sizeBytes = 32ULL * 1024 * 1024 * 1024;
+    if (manifestEvery > 0 && i % manifestEvery == 0) {
+        WatchGroup group;
+        group.id = QStringLiteral("g0");
+        group.name = QStringLiteral("data");
+        group.watchPaths = {QStringLiteral("data")};
+        group.merkleRoot = hexDigest(i * 31ULL + 7, 4);
+        group.builtAt = now;
+        group.files.reserve(manifestFiles);
+        for (int f = 0; f < manifestFiles; ++f) {
+            WatchFileEntry e;
+            e.relativePath = QStringLiteral("data/d%1/file%2.bin").arg(f / 100).arg(f);
+            e.contentHash = hexDigest(quint64(i) * 1000003ULL + f + 1, 4);
+            e.sizeBytes = 4096 + f;
+            e.modifiedUtc = now;
+            group.files.append(e);
+        }
+        r.watchManifest.groups = {group};
+        r.watchManifest.manifestRoot = group.merkleRoot;
+        r.watchManifest.updatedAt = now;
+        r.lastManifestRoot = group.merkleRoot;
+    }
+    return r;
+}
+
+/** VmRSS of @p pid (0: this process) in bytes, or -1. */
+qint64 residentBytes(qint64 pid = 0)
+{
+    QFile status(pid > 0 ? QStringLiteral("/proc/%1/status").arg(pid) : QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    for (const QByteArray& line : status.readAll().split('\n')) {
+        if (line.startsWith("VmRSS:")) {
+            return line.mid(6).trimmed().split(' ').value(0).toLongLong() * 1024;
+        }
+    }
+    return -1;
+}
+
+struct Timing {
+    std::vector<double> seconds;
+    bool ok = true;
+    QString error;
+};
+
+QJsonObject timingJson(int records, const QString& via, const QString& operation, int items, Timing t)
+{
+    QJsonObject obj;
+    obj.insert(QStringLiteral("records"), records);
+    obj.insert(QStringLiteral("via"), via);
+    obj.insert(QStringLiteral("operation"), operation);
+    obj.insert(QStringLiteral("items"), items);
+    obj.insert(QStringLiteral("runs"), static_cast<int>(t.seconds.size()));
+    obj.insert(QStringLiteral("success"), t.ok);
+    if (!t.ok) {
+        obj.insert(QStringLiteral("error"), t.error);
+        return obj;
+    }
+    std::sort(t.seconds.begin(), t.seconds.end());
+    obj.insert(QStringLiteral("seconds"), t.seconds[t.seconds.size() / 2]);
+    obj.insert(QStringLiteral("seconds_min"), t.seconds.front());
+    obj.insert(QStringLiteral("seconds_max"), t.seconds.back());
+    obj.insert(QStringLiteral("seconds_p99"), t.seconds[qMin(t.seconds.size() - 1, t.seconds.size() * 99 / 100)]);
+    return obj;
+}
+
+/** Runs @p op @p repeat times; @p before (setting up the next run) is not timed. */
+Timing measure(int repeat, const std::function<void()>& before, const std::function<QString()>& op)
+{
+    Timing t;
+    for (int i = 0; i < repeat; ++i) {
+        if (before) {
+            before();
+        }
+        QElapsedTimer timer;
+        timer.start();
+        const QString error = op();
+        t.seconds.push_back(static_cast<double>(timer.nsecsElapsed()) / 1e9);
+        if (!error.isEmpty()) {
+            t.ok = false;
+            t.error = error;
+            break;
+        }
+    }
+    return t;
+}
+
+QString expectCount(qsizetype got, qsizetype want)
+{
+    return got == want ? QString() : QStringLiteral("Expected %1 records, got %2").arg(want).arg(got);
+}
+
+/** The gateway operations timed for both paths; @p gateway is the engine or the client. */
+template <typename Gateway>
+void measureGateway(Gateway& gateway, int records, const QList<DeviceRecord>& all,
+                    int repeat, int mutations, int removeCount,
+                    const std::function<void(const QString&, int, const Timing&)>& record)
+{
+    record(QStringLiteral("snapshot"), records, measure(repeat, {}, [&] {
+        return expectCount(gateway.snapshot().devices.size(), records);
+    }));
+
+    int next = 0;
+    DeviceRecord touched;
+    record(QStringLiteral("upsert_one"), 1, measure(mutations, [&] {
+        touched = all.at(next++ % all.size());
+        touched.lastSeen = QDateTime::currentDateTimeUtc().addSecs(next);
+    }, [&] {
+        return gateway.upsertDevice(touched, kActor, QStringLiteral("seen")) ? QString()
+                                                                            : QStringLiteral("upsertDevice failed");
+    }));
+
+    PolicySnapshot base;
+    record(QStringLiteral("changes_after_one"), 1, measure(repeat, [&] {
+        base = gateway.snapshot();
+        touched = all.at(next++ % all.size());
+        touched.lastSeen = QDateTime::currentDateTimeUtc().addSecs(next);
+        gateway.upsertDevice(touched, kActor, QStringLiteral("seen"));
+    }, [&] {
+        const PolicyDelta delta = gateway.changesSince(base.epoch, base.generation);
+        return !delta.full && delta.devices.size() == 1 ? QString()
+                                                        : QStringLiteral("changesSince did not return one record");
+    }));
+
+    QStringList removeIds;
+    QList<DeviceRecord> removed;
+    for (int i = 0; i < removeCount; ++i) {
+        const DeviceRecord& r = all.at(static_cast<qsizetype>(i) * all.size() / removeCount);
+        removeIds.append(r.uniqueId);
+        removed.append(r);
+    }
+    if (removeIds.isEmpty()) {
+        return;
+    }
+    Timing removes;
+    Timing upserts;
+    for (int i = 0; i < repeat && removes.ok && upserts.ok; ++i) {
+        const Timing r = measure(1, {}, [&] {
+            return gateway.removeDevices(removeIds, kActor, QStringLiteral("retired")) == removeCount
+                       ? QString()
+                       : QStringLiteral("removeDevices did not remove every record");
+        });
+        removes.seconds.insert(removes.seconds.end(), r.seconds.begin(), r.seconds.end());
+        removes.ok = r.ok;
+        removes.error = r.error;
+        const Timing u = measure(1, {}, [&] {
+            return gateway.upsertDevices(removed, kActor, QStringLiteral("re-enrolled"))
+                       ? QString()
+                       : QStringLiteral("upsertDevices failed");
+        });
+        upserts.seconds.insert(upserts.seconds.end(), u.seconds.begin(), u.seconds.end());
+        upserts.ok = u.ok;
+        upserts.error = u.error;
+    }
+    record(QStringLiteral("remove_bulk"), static_cast<int>(removeIds.size()), removes);
+    record(QStringLiteral("upsert_bulk"), static_cast<int>(removed.size()), upserts);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("bench_policy_store"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Time the policy store in-process and through policyd"));
+    parser.addHelpOption();
+    QCommandLineOption sizesOption(QStringLiteral("sizes"), QStringLiteral("Comma-separated record counts"),
+                                   QStringLiteral("list"), QStringLiteral("1000,10000,100000"));
+    QCommandLineOption manifestPercentOption(QStringLiteral("manifest-percent"),
+                                             QStringLiteral("Records with a watch manifest"), QStringLiteral("percent"),
+                                             QStringLiteral("1"));
+    QCommandLineOption manifestFilesOption(QStringLiteral("manifest-files"),
+                                           QStringLiteral("Files in each watch manifest"), QStringLiteral("n"),
+                                           QStringLiteral("1000"));
+    QCommandLineOption mutationsOption(QStringLiteral("mutations"), QStringLiteral("Single upserts timed per size"),
+                                       QStringLiteral("n"), QStringLiteral("100"));
+    QCommandLineOption removeOption(QStringLiteral("remove-percent"), QStringLiteral("Records in the bulk remove"),
+                                    QStringLiteral("percent"), QStringLiteral("10"));
+    QCommandLineOption repeatOption(QStringLiteral("repeat"), QStringLiteral("Runs per measurement; the median is reported"),
+                                    QStringLiteral("n"), QStringLiteral("3"));
+    QCommandLineOption noDaemonOption(QStringLiteral("no-daemon"), QStringLiteral("Skip the policyd measurements"));
+    QCommandLineOption daemonOption(QStringLiteral("policyd"), QStringLiteral("flashspartan-policyd to start"),
+                                    QStringLiteral("path"));
+    QCommandLineOption rootOption(QStringLiteral("root"),
+                                  QStringLiteral("Directory for the stores (default: a temporary directory)"),
+                                  QStringLiteral("dir"));
+    QCommandLineOption outputOption({QStringLiteral("o"), QStringLiteral("output")},
+                                    QStringLiteral("Write the JSON here instead of stdout"), QStringLiteral("path"));
+    for (const QCommandLineOption* o : {&sizesOption, &manifestPercentOption, &manifestFilesOption, &mutationsOption,
+                                        &removeOption, &repeatOption, &noDaemonOption, &daemonOption, &rootOption,
+                                        &outputOption}) {
+        parser.addOption(*o);
+    }
+    parser.process(app);
+
+    const int manifestPercent = parser.value(manifestPercentOption).toInt();
+    const int manifestFiles = parser.value(manifestFilesOption).toInt();
+    const int mutations = parser.value(mutationsOption).toInt();
+    const int removePercent = parser.value(removeOption).toInt();
+    const int repeat = parser.value(repeatOption).toInt();
+    QList<int> sizes;
+    for (const QString& s : parser.value(sizesOption).split(u',', Qt::SkipEmptyParts)) {
+        sizes.append(s.toInt());
+    }
+    if (sizes.isEmpty() || std::any_of(sizes.cbegin(), sizes.cend(), [](int n) { return n <= 0; }) || repeat <= 0
+        || mutations <= 0 || manifestFiles < 0 || manifestPercent < 0 || manifestPercent > 100 || removePercent < 0
+        || removePercent > 100) {
+        std::cerr << "--sizes, --repeat and --mutations need positive numbers, --manifest-percent and "
+                     "--remove-percent 0 to 100\n";
+        return 2;
+    }
+    const int manifestEvery = manifestPercent > 0 && manifestFiles > 0 ? qMax(1, 100 / manifestPercent) : 0;
+    const bool withDaemon = !parser.isSet(noDaemonOption);
+    const QString daemonPath =
+        parser.isSet(daemonOption) ? parser.value(daemonOption) : PolicyDaemonLauncher::daemonExecutablePath();
+    if (withDaemon && (daemonPath.isEmpty() || !QFileInfo(daemonPath).isExecutable())) {
+        std::cerr << "flashspartan-policyd not found; pass --policyd or --no-daemon\n";
+        return 2;
+    }
+
+    QTemporaryDir scratch(parser.isSet(rootOption)
+                              ? QDir(parser.value(rootOption)).filePath(QStringLiteral("bench_policy_store-XXXXXX"))
+                              : QDir::temp().filePath(QStringLiteral("bench_policy_store-XXXXXX")));
+    if (!scratch.isValid()) {
+        std::cerr << "Cannot create a scratch directory\n";
+        return 2;
+    }
+    // policyd listens under the runtime directory; keep its socket away from a real one.
+    const QString runtimeDir = QDir(scratch.path()).filePath(QStringLiteral("run"));
+    QDir().mkpath(runtimeDir);
+    QFile::setPermissions(runtimeDir, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+    qputenv("XDG_RUNTIME_DIR", QFile::encodeName(runtimeDir));
+    qputenv("FLASHSPARTAN_POLICY_IN_PROCESS", "1");
+
+    QJsonArray results;
+    QJsonArray stores;
+    for (const int size : sizes) {
+        const QString configDir = QDir(scratch.path()).filePath(QString::number(size));
+        QDir().mkpath(configDir);
+        qputenv("FLASHSPARTAN_POLICY_CONFIG", QFile::encodeName(configDir));
+        const QString storePath = configDir + QStringLiteral("/policy.store");
+
+        auto record = [&](const QString& via, const QString& op, int items, const Timing& t) {
+            const QJsonObject line = timingJson(size, via, op, items, t);
+            std::cerr << QJsonDocument(line).toJson(QJsonDocument::Compact).constData() << '\n';
+            results.append(line);
+        };
+
+        QList<DeviceRecord> all;
+        all.reserve(size);
+        for (int i = 0; i < size; ++i) {
+            all.append(makeRecord(i, manifestEvery, manifestFiles));
+        }
+        QElapsedTimer fillTimer;
+        fillTimer.start();
+        {
+            PolicyStoreEngine filler(storePath);
+            QString error;
+            if (!filler.load(&error) || !filler.upsertDevices(all, kActor, QStringLiteral("enrol"))
+                || !filler.save(&error)) {
+                std::cerr << "Cannot fill the " << size << "-record store: " << error.toStdString() << '\n';
+                return 2;
+            }
+        }
+        const double fillSeconds = fillTimer.elapsed() / 1000.0;
+
+        // Resident growth across the first load: the engine's copy of the store, roughly.
+        const qint64 rssBefore = residentBytes();
+        auto engine = std::make_unique<PolicyStoreEngine>(storePath);
+        QString loadError;
+        Timing firstLoad = measure(1, {}, [&] { return engine->load(&loadError) ? QString() : loadError; });
+        const qint64 engineRss = residentBytes() - rssBefore;
+        Timing loads = measure(repeat - 1, {}, [&] {
+            PolicyStoreEngine again(storePath);
+            return again.load(&loadError) ? expectCount(again.snapshot().devices.size(), size) : loadError;
+        });
+        firstLoad.seconds.insert(firstLoad.seconds.end(), loads.seconds.begin(), loads.seconds.end());
+        firstLoad.ok = firstLoad.ok && loads.ok;
+        firstLoad.error = firstLoad.error.isEmpty() ? loads.error : firstLoad.error;
+        record(QStringLiteral("engine"), QStringLiteral("load"), size, firstLoad);
+        record(QStringLiteral("engine"), QStringLiteral("shared_snapshot"), size, measure(repeat, {}, [&] {
+            return expectCount(engine->sharedSnapshot()->devices.size(), size);
+        }));
+
+        const int removeCount = static_cast<int>(qint64(size) * removePercent / 100);
+        measureGateway(*engine, size, all, repeat, mutations, removeCount,
+                       [&](const QString& op, int items, const Timing& t) {
+                           record(QStringLiteral("engine"), op, items, t);
+                       });
+        engine.reset();
+
+        QJsonObject store;
+        store.insert(QStringLiteral("records"), size);
+        store.insert(QStringLiteral("records_with_manifest"),
+                     manifestEvery > 0 ? (size + manifestEvery - 1) / manifestEvery : 0);
+        store.insert(QStringLiteral("blob_bytes"), static_cast<double>(QFileInfo(storePath).size()));
+        store.insert(QStringLiteral("fill_seconds"), fillSeconds);
+        store.insert(QStringLiteral("engine_rss_bytes"), static_cast<double>(engineRss));
+
+        if (withDaemon) {
+            QProcess daemon;
+            daemon.setProgram(daemonPath);
+            daemon.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+            QElapsedTimer readyTimer;
+            readyTimer.start();
+            daemon.start();
+            PolicyDaemonClient client;
+            bool ready = daemon.waitForStarted(10000);
+            while (ready && !client.ping()) {
+                if (daemon.state() != QProcess::Running || readyTimer.elapsed() > 120000) {
+                    ready = false;
+                    break;
+                }
+                QThread::msleep(5);
+            }
+            Timing startup;
+            startup.seconds.push_back(static_cast<double>(readyTimer.nsecsElapsed()) / 1e9);
+            startup.ok = ready;
+            if (!ready) {
+                startup.error = QStringLiteral("flashspartan-policyd did not become ready");
+            }
+            record(QStringLiteral("policyd"), QStringLiteral("start_and_load"), size, startup);
+            if (ready) {
+                store.insert(QStringLiteral("policyd_rss_bytes"),
+                             static_cast<double>(residentBytes(daemon.processId())));
+                measureGateway(client, size, all, repeat, mutations, removeCount,
+                               [&](const QString& op, int items, const Timing& t) {
+                                   record(QStringLiteral("policyd"), op, items, t);
+                               });
+            }
+            daemon.terminate();
+            if (!daemon.waitForFinished(10000)) {
+                daemon.kill();
+                daemon.waitForFinished();
+            }
+        }
+        stores.append(store);
+        QDir(configDir).removeRecursively();
+    }
+
+    QJsonObject host;
+    host.insert(QStringLiteral("kernel"), QSysInfo::kernelVersion());
+    host.insert(QStringLiteral("cpu_arch"), QSysInfo::currentCpuArchitecture());
+    host.insert(QStringLiteral("threads"), QThread::idealThreadCount());
+
+    QJsonObject root;
+    root.insert(QStringLiteral("schema"), QLatin1String(kSchema));
+#ifdef FLASHSPARTAN_VERSION
+    root.insert(QStringLiteral("flashspartan_version"), QLatin1String(FLASHSPARTAN_VERSION));
+#endif
+    root.insert(QStringLiteral("host"), host);
+    root.insert(QStringLiteral("repeat"), repeat);
+    root.insert(QStringLiteral("manifest_percent"), manifestPercent);
+    root.insert(QStringLiteral("manifest_files"), manifestFiles);
+    root.insert(QStringLiteral("stores"), stores);
+    root.insert(QStringLiteral("results"), results);
+    const QByteArray json = QJsonDocument(root).toJson();
+
+    if (!parser.isSet(outputOption)) {
+        std::cout << json.constData();
+        return 0;
+    }
+    QSaveFile out(parser.value(outputOption));
+    if (!out.open(QIODevice::WriteOnly) || out.write(json) != json.size() || !out.commit()) {
+        std::cerr << "Cannot write " << parser.value(outputOption).toStdString() << '\n';
+        return 2;
+    }
+    return 0;
+}
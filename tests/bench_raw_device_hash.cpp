@@ -0,0 +1,427 @@
+/**
+ * bench_raw_device_hash — throughput of the RawDeviceHash read paths.
+ *
+ * Runs every mode (read loop, mmap loop, io_uring, quick sample, chunked, parallel chunked
+ * and chunked resume) for each algorithm and buffer size against each target: block devices
+ * such as /dev/loop0, regular files, and by default a ramdisk file in /dev/shm. Prints one
+ * JSON document whose schema id only changes when a field changes meaning, so results of two
+ * releases can be diffed directly. Not registered with ctest; see docs/BENCHMARKS.md.
+ */
+
+#include "HashCheckpoint.h"
+#include "RawDeviceHash.h"
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <QTemporaryFile>
+#include <QThread>
+
+#include <algorithm>
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace FlashSpartan;
+
+namespace {
+
+constexpr auto kSchema = "flashspartan.bench.raw_device_hash/1";
+constexpr double kGiB = 1024.0 * 1024.0 * 1024.0;
+
+const QStringList kAllModes = {
+    QStringLiteral("read"), QStringLiteral("mmap"), QStringLiteral("uring"), QStringLiteral("quick"),
+    QStringLiteral("chunked"), QStringLiteral("parallel"), QStringLiteral("resume"),
+};
+
+struct Target {
+    QString path;
+    QString kind;  // block, file or ramdisk
+};
+
+/** Process-wide counters; RUSAGE_SELF covers the ParallelChunked worker threads too. */
+struct Counters {
+    double cpuSeconds = 0.0;
+    uint64_t readSyscalls = 0;  // syscr from /proc/self/io; io_uring submissions do not count
+    uint64_t pageFaults = 0;
+};
+
+Counters sampleCounters()
+{
+    Counters c;
+    rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        c.cpuSeconds = static_cast<double>(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec)
+                       + static_cast<double>(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+        c.pageFaults = static_cast<uint64_t>(usage.ru_minflt + usage.ru_majflt);
+    }
+    QFile io(QStringLiteral("/proc/self/io"));
+    if (io.open(QIODevice::ReadOnly)) {
+        for (const QByteArray& line : io.readAll().split('\n')) {
+            if (line.startsWith("syscr:")) {
+                c.readSyscalls = line.mid(6).trimmed().toULongLong();
+            }
+        }
+    }
+    return c;
+}
+
+struct Run {
+    bool success = false;
+    QString error;
+    QString hash;
+    uint64_t bytes = 0;  // bytes this run read; a resume skips the checkpointed prefix
+    double seconds = 0.0;
+    Counters used;
+};
+
+int openTarget(const Target& target)
+{
+    if (target.kind == QLatin1String("block")) {
+        return RawDeviceHash::openDevice(target.path);
+    }
+    return ::open(QFile::encodeName(target.path).constData(), O_RDONLY | O_CLOEXEC);
+}
+
+void dropCache(int fd)
+{
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+RawDeviceHash::Options optionsFor(const Target& target, const QString& mode,
+                                  RawDeviceHash::Algorithm algorithm, int bufferKB)
+{
+    RawDeviceHash::Options options;
+    options.deviceNode = target.path;
+    options.algorithm = algorithm;
+    options.bufferSizeKB = bufferKB;
+    options.useMemoryMapping = mode == QLatin1String("mmap");
+    if (mode == QLatin1String("uring")) {
+        options.ioEngine = RawDeviceHash::IoEngine::IoUring;
+    } else if (mode == QLatin1String("quick")) {
+        options.scanMode = RawDeviceHash::ScanMode::QuickSample;
+    } else if (mode == QLatin1String("parallel")) {
+        options.scanMode = RawDeviceHash::ScanMode::ParallelChunked;
+    }
+    return options;
+}
+
+Run runOnce(const Target& target, const QString& mode, RawDeviceHash::Algorithm algorithm,
+            int bufferKB, bool drop)
+{
+    Run run;
+    const int fd = openTarget(target);
+    if (fd < 0) {
+        run.error = QStringLiteral("Cannot open %1").arg(target.path);
+        return run;
+    }
+
+    RawDeviceHash::Options options = optionsFor(target, mode, algorithm, bufferKB);
+    HashCheckpoint checkpoint;
+    if (mode == QLatin1String("chunked") || mode == QLatin1String("resume")) {
+        options.checkpointOut = &checkpoint;
+    }
+    if (mode == QLatin1String("resume")) {
+        // Untimed first pass for the block digests, then resume from the middle block.
+        const HashResult first = RawDeviceHash::hashOpenFd(fd, options);
+        const qsizetype keep = checkpoint.blockHashes.size() / 2;
+        if (!first.success || keep == 0) {
+            RawDeviceHash::closeDevice(fd);
+            run.error = first.success ? QStringLiteral("Target holds fewer than two 64 MiB blocks")
+                                      : first.errorMessage;
+            return run;
+        }
+        checkpoint.blockHashes.resize(keep);
+        checkpoint.bytesCompleted = static_cast<uint64_t>(keep) * checkpoint.blockSize;
+        options.resumeFromBytes = checkpoint.bytesCompleted;
+    }
+    if (drop) {
+        dropCache(fd);
+    }
+
+    const Counters before = sampleCounters();
+    QElapsedTimer timer;
+    timer.start();
+    const HashResult result = RawDeviceHash::hashOpenFd(fd, options);
+    run.seconds = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+    const Counters after = sampleCounters();
+    RawDeviceHash::closeDevice(fd);
+
+    run.success = result.success;
+    run.error = result.errorMessage;
+    run.hash = result.hash;
+    run.bytes = result.bytesProcessed > options.resumeFromBytes ? result.bytesProcessed - options.resumeFromBytes
+                                                                : 0;
+    run.used.cpuSeconds = after.cpuSeconds - before.cpuSeconds;
+    run.used.readSyscalls = after.readSyscalls - before.readSyscalls;
+    run.used.pageFaults = after.pageFaults - before.pageFaults;
+    return run;
+}
+
+QJsonObject summarize(const Target& target, const QString& mode, RawDeviceHash::Algorithm algorithm,
+                      int bufferKB, const std::vector<Run>& runs)
+{
+    QJsonObject obj;
+    obj.insert(QStringLiteral("target"), target.path);
+    obj.insert(QStringLiteral("target_kind"), target.kind);
+    obj.insert(QStringLiteral("mode"), mode);
+    obj.insert(QStringLiteral("algorithm"), RawDeviceHash::algorithmName(algorithm));
+    obj.insert(QStringLiteral("buffer_kb"), bufferKB);
+    obj.insert(QStringLiteral("runs"), static_cast<int>(runs.size()));
+
+    for (const Run& run : runs) {
+        if (!run.success) {
+            obj.insert(QStringLiteral("success"), false);
+            obj.insert(QStringLiteral("error"), run.error);
+            return obj;
+        }
+    }
+
+    std::vector<double> mbps;
+    double seconds = 0.0;
+    double cpuSeconds = 0.0;
+    double bytes = 0.0;
+    double syscalls = 0.0;
+    double faults = 0.0;
+    for (const Run& run : runs) {
+        mbps.push_back(run.seconds > 0.0 ? static_cast<double>(run.bytes) / (1024.0 * 1024.0) / run.seconds
+                                         : 0.0);
+        seconds += run.seconds;
+        cpuSeconds += run.used.cpuSeconds;
+        bytes += static_cast<double>(run.bytes);
+        syscalls += static_cast<double>(run.used.readSyscalls);
+        faults += static_cast<double>(run.used.pageFaults);
+    }
+    std::sort(mbps.begin(), mbps.end());
+
+    obj.insert(QStringLiteral("success"), true);
+    obj.insert(QStringLiteral("hash"), runs.front().hash);
+    obj.insert(QStringLiteral("bytes"), static_cast<double>(runs.front().bytes));
+    obj.insert(QStringLiteral("mbps"), mbps[mbps.size() / 2]);
+    obj.insert(QStringLiteral("mbps_min"), mbps.front());
+    obj.insert(QStringLiteral("mbps_max"), mbps.back());
+    obj.insert(QStringLiteral("cpu_percent"), seconds > 0.0 ? 100.0 * cpuSeconds / seconds : 0.0);
+    if (bytes > 0.0) {
+        obj.insert(QStringLiteral("read_syscalls_per_gib"), syscalls * kGiB / bytes);
+        obj.insert(QStringLiteral("page_faults_per_gib"), faults * kGiB / bytes);
+    }
+    return obj;
+}
+
+std::optional<Target> classify(const QString& path)
+{
+    struct stat st {};
+    if (::stat(QFile::encodeName(path).constData(), &st) != 0) {
+        return std::nullopt;
+    }
+    if (S_ISBLK(st.st_mode)) {
+        return Target{path, QStringLiteral("block")};
+    }
+    if (S_ISREG(st.st_mode)) {
+        return Target{path, QStringLiteral("file")};
+    }
+    return std::nullopt;
+}
+
+/** Fills @p file with @p megabytes of incompressible bytes (xorshift64). */
+bool fillRamdisk(QFile& file, int megabytes)
+{
+    QByteArray chunk(1024 * 1024, Qt::Uninitialized);
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    for (int mb = 0; mb < megabytes; ++mb) {
+        auto* words = reinterpret_cast<uint64_t*>(chunk.data());
+        for (qsizetype i = 0; i < chunk.size() / static_cast<qsizetype>(sizeof(uint64_t)); ++i) {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            words[i] = state;
+        }
+        if (file.write(chunk) != chunk.size()) {
+            return false;
+        }
+    }
+    return file.flush();
+}
+
+QList<int> parseIntList(const QString& value, bool* ok)
+{
+    QList<int> out;
+    *ok = true;
+    for (const QString& part : value.split(QLatin1Char(','), Qt::SkipEmptyParts)) {
+        bool partOk = false;
+        const int n = part.trimmed().toInt(&partOk);
+        if (!partOk || n <= 0) {
+            *ok = false;
+            return {};
+        }
+        out.append(n);
+    }
+    *ok = *ok && !out.isEmpty();
+    return out;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName(QStringLiteral("bench_raw_device_hash"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Measure RawDeviceHash throughput; JSON on stdout"));
+    parser.addHelpOption();
+    parser.addPositionalArgument(QStringLiteral("targets"),
+                                 QStringLiteral("Block devices (e.g. /dev/loop0) or files; default: a ramdisk file"),
+                                 QStringLiteral("[targets...]"));
+    QCommandLineOption modesOption(QStringLiteral("modes"), QStringLiteral("Comma-separated: %1").arg(kAllModes.join(u',')),
+                                   QStringLiteral("list"), kAllModes.join(u','));
+    QCommandLineOption algorithmsOption(QStringLiteral("algorithms"), QStringLiteral("Comma-separated algorithms"),
+                                        QStringLiteral("list"), QStringLiteral("SHA256,BLAKE3,XXH3-128"));
+    QCommandLineOption buffersOption(QStringLiteral("buffer-kb"), QStringLiteral("Comma-separated buffer sizes in KiB"),
+                                     QStringLiteral("list"), QStringLiteral("256,1024,4096"));
+    QCommandLineOption repeatOption(QStringLiteral("repeat"), QStringLiteral("Runs per combination; the median is reported"),
+                                    QStringLiteral("n"), QStringLiteral("3"));
+    QCommandLineOption ramdiskOption(QStringLiteral("ramdisk-mb"),
+                                     QStringLiteral("Size of the ramdisk file used when no target is given (0: none)"),
+                                     QStringLiteral("mb"), QStringLiteral("256"));
+    QCommandLineOption dropCacheOption(QStringLiteral("drop-cache"),
+                                       QStringLiteral("Evict the target from the page cache before each run"));
+    QCommandLineOption outputOption({QStringLiteral("o"), QStringLiteral("output")},
+                                    QStringLiteral("Write the JSON here instead of stdout"), QStringLiteral("path"));
+    parser.addOption(modesOption);
+    parser.addOption(algorithmsOption);
+    parser.addOption(buffersOption);
+    parser.addOption(repeatOption);
+    parser.addOption(ramdiskOption);
+    parser.addOption(dropCacheOption);
+    parser.addOption(outputOption);
+    parser.process(app);
+
+    bool buffersOk = false;
+    const QList<int> buffers = parseIntList(parser.value(buffersOption), &buffersOk);
+    const int repeat = parser.value(repeatOption).toInt();
+    const int ramdiskMB = parser.value(ramdiskOption).toInt();
+    if (!buffersOk || repeat <= 0 || ramdiskMB < 0) {
+        std::cerr << "--buffer-kb, --repeat and --ramdisk-mb need positive numbers\n";
+        return 2;
+    }
+
+    const QStringList modes = parser.value(modesOption).split(u',', Qt::SkipEmptyParts);
+    for (const QString& mode : modes) {
+        if (!kAllModes.contains(mode)) {
+            std::cerr << "Unknown mode " << mode.toStdString() << '\n';
+            return 2;
+        }
+    }
+    QList<RawDeviceHash::Algorithm> algorithms;
+    QJsonArray skipped;
+    for (const QString& name : parser.value(algorithmsOption).split(u',', Qt::SkipEmptyParts)) {
+        const RawDeviceHash::Algorithm algo = RawDeviceHash::algorithmFromName(name);
+        if (RawDeviceHash::algorithmName(algo).compare(name, Qt::CaseInsensitive) != 0) {
+            std::cerr << "Unknown algorithm " << name.toStdString() << '\n';
+            return 2;
+        }
+        if (!RawDeviceHash::algorithmAvailable(algo)) {
+            skipped.append(QJsonObject{{QStringLiteral("algorithm"), name},
+                                       {QStringLiteral("reason"), QStringLiteral("not in this build")}});
+            continue;
+        }
+        algorithms.append(algo);
+    }
+
+    QList<Target> targets;
+    for (const QString& path : parser.positionalArguments()) {
+        const std::optional<Target> target = classify(path);
+        if (!target) {
+            std::cerr << path.toStdString() << " is neither a block device nor a regular file\n";
+            return 2;
+        }
+        targets.append(*target);
+    }
+    const QString shm = QStringLiteral("/dev/shm");
+    QTemporaryFile ramdisk(QDir(QFileInfo(shm).isWritable() ? shm : QDir::tempPath())
+                               .filePath(QStringLiteral("bench_raw_device_hash-XXXXXX")));
+    if (targets.isEmpty() && ramdiskMB > 0) {
+        if (!ramdisk.open() || !fillRamdisk(ramdisk, ramdiskMB)) {
+            std::cerr << "Cannot create the ramdisk file\n";
+            return 2;
+        }
+        targets.append(Target{ramdisk.fileName(), QStringLiteral("ramdisk")});
+    }
+    if (targets.isEmpty()) {
+        parser.showHelp(2);
+    }
+
+    const bool uring = RawDeviceHash::ioUringAvailable();
+    QJsonArray results;
+    for (const Target& target : targets) {
+        for (const QString& mode : modes) {
+            if (mode == QLatin1String("uring") && !uring) {
+                continue;
+            }
+            // Quick samples have a fixed read size; one buffer size is enough.
+            const QList<int> modeBuffers = mode == QLatin1String("quick") ? QList<int>{buffers.front()} : buffers;
+            for (RawDeviceHash::Algorithm algo : algorithms) {
+                for (int bufferKB : modeBuffers) {
+                    std::vector<Run> runs;
+                    for (int i = 0; i < repeat; ++i) {
+                        runs.push_back(runOnce(target, mode, algo, bufferKB, parser.isSet(dropCacheOption)));
+                        if (!runs.back().success) {
+                            break;
+                        }
+                    }
+                    const QJsonObject line = summarize(target, mode, algo, bufferKB, runs);
+                    std::cerr << QJsonDocument(line).toJson(QJsonDocument::Compact).constData() << '\n';
+                    results.append(line);
+                }
+            }
+        }
+    }
+    if (modes.contains(QStringLiteral("uring")) && !uring) {
+        skipped.append(QJsonObject{{QStringLiteral("mode"), QStringLiteral("uring")},
+                                   {QStringLiteral("reason"), QStringLiteral("io_uring unavailable")}});
+    }
+
+    QJsonObject host;
+    host.insert(QStringLiteral("kernel"), QSysInfo::kernelVersion());
+    host.insert(QStringLiteral("cpu_arch"), QSysInfo::currentCpuArchitecture());
+    host.insert(QStringLiteral("threads"), QThread::idealThreadCount());
+    host.insert(QStringLiteral("io_uring"), uring);
+
+    QJsonObject root;
+    root.insert(QStringLiteral("schema"), QLatin1String(kSchema));
+#ifdef FLASHSPARTAN_VERSION
+    root.insert(QStringLiteral("flashspartan_version"), QLatin1String(FLASHSPARTAN_VERSION));
+#endif
+    root.insert(QStringLiteral("host"), host);
+    root.insert(QStringLiteral("repeat"), repeat);
+    root.insert(QStringLiteral("drop_cache"), parser.isSet(dropCacheOption));
+    root.insert(QStringLiteral("results"), results);
+    root.insert(QStringLiteral("skipped"), skipped);
+    const QByteArray json = QJsonDocument(root).toJson();
+
+    if (!parser.isSet(outputOption)) {
+        std::cout << json.constData();
+        return 0;
+    }
+    QSaveFile out(parser.value(outputOption));
+    if (!out.open(QIODevice::WriteOnly) || out.write(json) != json.size() || !out.commit()) {
+        std::cerr << "Cannot write " << parser.value(outputOption).toStdString() << '\n';
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,347 @@
+/**
+ * bench_udev_replay — DeviceMonitor, HidDeviceMonitor and BadUsbAnalyzer under a udev storm.
+ *
+ * Replays a trace recorded with --record-udev (--trace) or a synthetic connect storm (USB
+ * sticks announcing their partition with add/change/change, HID devices reconnecting) into
+ * the monitors and the BadUSB connect analysis, at each of --speeds times the recorded pace
+ * (1 to 1000; 0 for back to back). Reports the wall time, how far delivery fell behind the
+ * trace, what the monitors emitted and the analysis cost. No hardware or udev needed. Prints
+ * one versioned JSON document; see docs/BENCHMARKS.md. Not a ctest.
+ */
+
+#include "BadUsbAnalyzer.h"
+#include "BadUsbRuleSet.h"
+#include "DeviceMonitor.h"
+#include "HidConnectCounter.h"
+#include "HidDeviceMonitor.h"
+#include "UdevEventTrace.h"
+
+#include <QCommandLineOption>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSysInfo>
+#include <QThread>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <sys/sysmacros.h>
+
+using namespace FlashSpartan;
+
+namespace {
+
+constexpr auto kSchema = "flashspartan.bench.udev-replay/1";
+constexpr int kDebounceMs = 150;  // DeviceMonitor::DEBOUNCE_MS
+
+UdevEventTrace::Event event(qint64 offsetUs, const char* source, const UdevRecord& device, const char* action)
+{
+    UdevEventTrace::Event e;
+    e.offsetUs = offsetUs;
+    e.source = source;
+    e.device = device;
+    e.device.action = action;
+    return e;
+}
+
+UdevRecord usbDevice(int index)
+{
+    UdevRecord usb;
+    usb.sysName = QByteArray("1-") + QByteArray::number(index + 1);
+    usb.sysPath = "/sys/devices/pci0000:00/0000:00:14.0/usb1/" + usb.sysName;
+    usb.subsystem = "usb";
+    usb.devType = "usb_device";
+    usb.sysAttrs = {{"busnum", "1\n"}, {"devnum", QByteArray::number(index + 2) + '\n'},
+                    {"serial", "BENCH" + QByteArray::number(index) + '\n'}, {"bDeviceClass", "00\n"}};
+    return usb;
+}
+
+/** The partition of stick @p index: sda1, sdb1, ... */
+UdevRecord stickPartition(int index)
+{
+    QByteArray disk = "sd";
+    for (int n = index; ; n = n / 26 - 1) {
+        disk.insert(2, char('a' + n % 26));
+        if (n < 26) {
+            break;
+        }
+    }
+    UdevRecord usb = usbDevice(index);
+    usb.sysAttrs.insert("manufacturer", "Bench\n");
+    usb.sysAttrs.insert("product", "Replay Stick\n");
+
+    UdevRecord parent;
+    parent.sysPath = usb.sysPath + "/" + usb.sysName + ":1.0/host0/target0:0:0/0:0:0:0/block/" + disk;
+    parent.sysName = disk;
+    parent.devNode = "/dev/" + disk;
+    parent.subsystem = "block";
+    parent.devType = "disk";
+
+    UdevRecord r;
+    r.sysPath = parent.sysPath + "/" + disk + "1";
+    r.sysName = disk + "1";
+    r.devNode = parent.devNode + "1";
+    r.subsystem = "block";
+    r.devType = "partition";
+    r.devnum = makedev(8, unsigned(index * 16 + 1));
+    r.properties = {{"ID_BUS", "usb"}, {"ID_USB_DRIVER", "usb-storage"}, {"ID_FS_TYPE", "vfat"}};
+    r.sysAttrs = {{"size", "15728640\n"}};
+    r.parents = {parent, usb};
+    return r;
+}
+
+/** Keyboard (even @p index) or mouse event node of HID device @p index. */
+UdevRecord hidInput(int index, int usbIndex)
+{
+    const bool keyboard = index % 2 == 0;
+    UdevRecord usb = usbDevice(usbIndex);
+    usb.sysAttrs.insert("idVendor", "046d\n");
+    usb.sysAttrs.insert("idProduct", keyboard ? "c31c\n" : "c077\n");
+    usb.descriptorFingerprint = QByteArray(32, char(index));
+
+    UdevRecord iface;
+    iface.sysPath = usb.sysPath + "/" + usb.sysName + ":1.0";
+    iface.sysName = usb.sysName + ":1.0";
+    iface.subsystem = "usb";
+    iface.devType = "usb_interface";
+    iface.driver = "usbhid";
+    iface.sysAttrs = {{"bInterfaceNumber", "00\n"}, {"bInterfaceClass", "03\n"}, {"bInterfaceSubClass", "01\n"},
+                      {"bInterfaceProtocol", keyboard ? "01\n" : "02\n"}};
+
+    UdevRecord r;
+    r.sysName = "event" + QByteArray::number(index + 10);
+    r.sysPath = iface.sysPath + "/input/input" + QByteArray::number(index + 10) + "/" + r.sysName;
+    r.devNode = "/dev/input/" + r.sysName;
+    r.subsystem = "input";
+    r.properties = {{"ID_INPUT", "1"}, {keyboard ? "ID_INPUT_KEYBOARD" : "ID_INPUT_MOUSE", "1"}};
+    r.parents = {iface, usb};
+    return r;
+}
+
+/**
+ * @p sticks sticks @p spacingMs apart, each add/change/change within 10 ms and removed 1.5 s
+ * later; every fourth one brings a HID device that reconnects three times, 400 ms apart.
+ */
+QList<UdevEventTrace::Event> syntheticStorm(int sticks, int spacingMs)
+{
+    QList<UdevEventTrace::Event> events;
+    int hid = 0;
+    for (int i = 0; i < sticks; ++i) {
+        const qint64 t = qint64(i) * spacingMs * 1000;
+        const UdevRecord part = stickPartition(i);
+        events.append(event(t, "block", part, "add"));
+        events.append(event(t + 5000, "block", part, "change"));
+        events.append(event(t + 10000, "block", part, "change"));
+        events.append(event(t + 1500000, "block", part, "remove"));
+        if (i % 4 == 0) {
+            const UdevRecord input = hidInput(hid++, sticks + i);
+            for (int cycle = 0; cycle < 3; ++cycle) {
+                events.append(event(t + 2000 + cycle * 400000, "input", input, "add"));
+                events.append(event(t + 2000 + cycle * 400000 + 200000, "input", input, "remove"));
+            }
+        }
+    }
+    std::stable_sort(events.begin(), events.end(), [](const UdevEventTrace::Event& a, const UdevEventTrace::Event& b) {
+        return a.offsetUs < b.offsetUs;
+    });
+    return events;
+}
+
+struct Run {
+    UdevEventTrace::ReplayStats stats;
+    qint64 settleNs = 0;  // after the last event, until the last debounced flush
+    int connected = 0;
+    int changed = 0;
+    int disconnected = 0;
+    int hidConnected = 0;
+    int hidDisconnected = 0;
+    int anomalies = 0;
+    qint64 analyzeNs = 0;
+};
+
+Run replayOnce(const QList<UdevEventTrace::Event>& events, double speed, const BadUsbRuleSet& rules)
+{
+    Run run;
+    DeviceMonitor devices;
+    HidDeviceMonitor hid;
+    HidConnectCounter connects;
+    qint64 nowSecs = 0;
+    QObject::connect(&devices, &DeviceMonitor::deviceConnected, [&](const DeviceHandle&) { ++run.connected; });
+    QObject::connect(&devices, &DeviceMonitor::deviceChanged, [&](const DeviceHandle&) { ++run.changed; });
+    QObject::connect(&devices, &DeviceMonitor::deviceDisconnected, [&](const QString&) { ++run.disconnected; });
+    QObject::connect(&hid, &HidDeviceMonitor::hidDisconnected, [&](const QString&) { ++run.hidDisconnected; });
+    QObject::connect(&hid, &HidDeviceMonitor::hidConnected, [&](const HidDeviceInfo& device) {
+        ++run.hidConnected;
+        QElapsedTimer timer;
+        timer.start();
+        // As MainWindow does, on the trace's clock
+        connects.record(device.stableId(), nowSecs);
+        const BadUsbAnomalyResult result =
+            BadUsbAnalyzer::analyzeConnect(device, std::nullopt, {}, connects, nowSecs, rules);
+        run.analyzeNs += timer.nsecsElapsed();
+        run.anomalies += result.anomalous ? 1 : 0;
+    });
+
+    const qint64 firstUs = events.isEmpty() ? 0 : events.first().offsetUs;
+    run.stats = UdevEventTrace::replay(events, speed, [&](const UdevEventTrace::Event& e) {
+        nowSecs = (e.offsetUs - firstUs) / 1000000;
+        if (e.source == "block") {
+            devices.replayEvent(e.device, speed);
+        } else if (e.source == "input") {
+            hid.replayEvent(e.device);
+        }
+    });
+
+    // Let the last debounce window (shrunk by the speed, as the monitor does) close
+    const int windowMs = speed > 0 ? qRound(kDebounceMs / speed) + 5 : 5;
+    QElapsedTimer settle;
+    settle.start();
+    while (settle.elapsed() < windowMs) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, windowMs);
+    }
+    run.settleNs = settle.nsecsElapsed();
+    return run;
+}
+
+QJsonObject runJson(double speed, std::vector<Run> runs)
+{
+    std::sort(runs.begin(), runs.end(), [](const Run& a, const Run& b) { return a.stats.wallNs < b.stats.wallNs; });
+    const Run& median = runs[runs.size() / 2];
+    const double seconds = double(median.stats.wallNs) / 1e9;
+    QJsonObject obj;
+    obj.insert(QStringLiteral("speed"), speed);
+    obj.insert(QStringLiteral("runs"), int(runs.size()));
+    obj.insert(QStringLiteral("events"), median.stats.delivered);
+    obj.insert(QStringLiteral("seconds"), seconds);
+    obj.insert(QStringLiteral("seconds_min"), double(runs.front().stats.wallNs) / 1e9);
+    obj.insert(QStringLiteral("seconds_max"), double(runs.back().stats.wallNs) / 1e9);
+    if (seconds > 0.0) {
+        obj.insert(QStringLiteral("events_per_s"), median.stats.delivered / seconds);
+    }
+    obj.insert(QStringLiteral("max_lag_ms"), double(median.stats.maxLagUs) / 1000.0);
+    obj.insert(QStringLiteral("settle_ms"), double(median.settleNs) / 1e6);
+    obj.insert(QStringLiteral("device_connected"), median.connected);
+    obj.insert(QStringLiteral("device_changed"), median.changed);
+    obj.insert(QStringLiteral("device_disconnected"), median.disconnected);
+    obj.insert(QStringLiteral("hid_connected"), median.hidConnected);
+    obj.insert(QStringLiteral("hid_disconnected"), median.hidDisconnected);
+    obj.insert(QStringLiteral("badusb_anomalies"), median.anomalies);
+    obj.insert(QStringLiteral("badusb_analyze_us"), double(median.analyzeNs) / 1000.0);
+    return obj;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Replay udev event storms into the device monitors"));
+    parser.addHelpOption();
+    QCommandLineOption traceOption(QStringLiteral("trace"),
+                                   QStringLiteral("Trace recorded with --record-udev (default: a synthetic storm)"),
+                                   QStringLiteral("path"));
+    QCommandLineOption sticksOption(QStringLiteral("sticks"), QStringLiteral("Sticks in the synthetic storm"),
+                                    QStringLiteral("n"), QStringLiteral("64"));
+    QCommandLineOption spacingOption(QStringLiteral("spacing-ms"),
+                                     QStringLiteral("Time between sticks in the synthetic storm"),
+                                     QStringLiteral("ms"), QStringLiteral("20"));
+    QCommandLineOption speedsOption(QStringLiteral("speeds"),
+                                    QStringLiteral("Comma-separated replay speeds, 1 to 1000; 0 is back to back"),
+                                    QStringLiteral("list"), QStringLiteral("10,100,1000,0"));
+    QCommandLineOption repeatOption(QStringLiteral("repeat"), QStringLiteral("Runs per speed; the median is reported"),
+                                    QStringLiteral("n"), QStringLiteral("3"));
+    QCommandLineOption outputOption({QStringLiteral("o"), QStringLiteral("output")},
+                                    QStringLiteral("Write the JSON here instead of stdout"), QStringLiteral("path"));
+    for (const QCommandLineOption* o :
+         {&traceOption, &sticksOption, &spacingOption, &speedsOption, &repeatOption, &outputOption}) {
+        parser.addOption(*o);
+    }
+    parser.process(app);
+
+    const int sticks = parser.value(sticksOption).toInt();
+    const int spacingMs = parser.value(spacingOption).toInt();
+    const int repeat = parser.value(repeatOption).toInt();
+    if (sticks <= 0 || spacingMs < 0 || repeat <= 0) {
+        std::cerr << "--sticks and --repeat need positive numbers, --spacing-ms zero or more\n";
+        return 2;
+    }
+    QList<double> speeds;
+    for (const QString& value : parser.value(speedsOption).split(u',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        const double speed = value.toDouble(&ok);
+        if (!ok || speed < 0 || speed > UdevEventTrace::kMaxSpeed || (speed > 0 && speed < 1)) {
+            std::cerr << "Replay speeds are 1 to " << UdevEventTrace::kMaxSpeed << ", or 0\n";
+            return 2;
+        }
+        speeds.append(speed);
+    }
+
+    QList<UdevEventTrace::Event> events;
+    if (parser.isSet(traceOption)) {
+        QString error;
+        events = UdevEventTrace::load(parser.value(traceOption), &error);
+        if (!error.isEmpty()) {
+            std::cerr << "Cannot load the trace: " << error.toStdString() << '\n';
+            return 2;
+        }
+    } else {
+        events = syntheticStorm(sticks, spacingMs);
+    }
+
+    const BadUsbRuleSet rules = BadUsbRuleSet::compile(BadUsbRuleSet::builtinRules(AppSettings()));
+    QJsonArray results;
+    for (const double speed : speeds) {
+        std::vector<Run> runs;
+        for (int i = 0; i < repeat; ++i) {
+            runs.push_back(replayOnce(events, speed, rules));
+        }
+        const QJsonObject line = runJson(speed, std::move(runs));
+        std::cerr << QJsonDocument(line).toJson(QJsonDocument::Compact).constData() << '\n';
+        results.append(line);
+    }
+
+    QJsonObject host;
+    host.insert(QStringLiteral("kernel"), QSysInfo::kernelVersion());
+    host.insert(QStringLiteral("cpu_arch"), QSysInfo::currentCpuArchitecture());
+    host.insert(QStringLiteral("threads"), QThread::idealThreadCount());
+
+    QJsonObject source;
+    if (parser.isSet(traceOption)) {
+        source.insert(QStringLiteral("trace"), parser.value(traceOption));
+    } else {
+        source.insert(QStringLiteral("synthetic_sticks"), sticks);
+        source.insert(QStringLiteral("spacing_ms"), spacingMs);
+    }
+    source.insert(QStringLiteral("events"), int(events.size()));
+    source.insert(QStringLiteral("span_s"),
+                  events.isEmpty() ? 0.0 : double(events.last().offsetUs - events.first().offsetUs) / 1e6);
+
+    QJsonObject root;
+    root.insert(QStringLiteral("schema"), QLatin1String(kSchema));
+#ifdef FLASHSPARTAN_VERSION
+    root.insert(QStringLiteral("flashspartan_version"), QLatin1String(FLASHSPARTAN_VERSION));
+#endif
+    root.insert(QStringLiteral("host"), host);
+    root.insert(QStringLiteral("repeat"), repeat);
+    root.insert(QStringLiteral("source"), source);
+    root.insert(QStringLiteral("results"), results);
+    const QByteArray json = QJsonDocument(root).toJson();
+
+    if (!parser.isSet(outputOption)) {
+        std::cout << json.constData();
+        return 0;
+    }
+    QSaveFile out(parser.value(outputOption));
+    if (!out.open(QIODevice::WriteOnly) || out.write(json) != json.size() || !out.commit()) {
+        std::cerr << "Cannot write " << parser.value(outputOption).toStdString() << '\n';
+        return 2;
+    }
+    return 0;
+}
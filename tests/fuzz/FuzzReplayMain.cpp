@@ -0,0 +1,69 @@
+// Runs a libFuzzer target without libFuzzer: every file named on the command line, or found
+// under a directory named there, goes through LLVMFuzzerTestOneInput once. That makes the
+// seed corpus (and any crash or slow input saved from a fuzzing run) a ctest regression in
+// every build. --scale N also feeds each input repeated 2, 4, ... N times back to back,
+// which is where a parse that is superlinear in its input shows against the time budget.
+
+#include <QByteArray>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+
+#include <cstdint>
+#include <cstdio>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace {
+
+void runOne(const QByteArray& bytes)
+{
+    LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(bytes.constData()), static_cast<size_t>(bytes.size()));
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int scale = 1;
+    QStringList files;
+    for (int i = 1; i < argc; ++i) {
+        const QString arg = QString::fromLocal8Bit(argv[i]);
+        if (arg == QLatin1String("--scale") && i + 1 < argc) {
+            scale = qMax(1, QString::fromLocal8Bit(argv[++i]).toInt());
+            continue;
+        }
+        if (QFileInfo(arg).isDir()) {
+            QStringList found;
+            QDirIterator it(arg, QDir::Files, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                found.append(it.next());
+            }
+            found.sort();
+            files += found;
+        } else {
+            files.append(arg);
+        }
+    }
+
+    for (const QString& path : files) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            std::fprintf(stderr, "cannot read %s\n", qPrintable(path));
+            return 1;
+        }
+        const QByteArray bytes = file.readAll();
+        runOne(bytes);
+        for (int times = 2; times <= scale; times *= 2) {
+            runOne(bytes.repeated(times));
+        }
+    }
+    if (files.isEmpty()) {
+        std::fprintf(stderr, "no inputs\n");
+        return 1;
+    }
+    std::fprintf(stderr, "replayed %lld inputs\n", static_cast<long long>(files.size()));
+    return 0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+namespace FlashSpartan::Fuzz {
+
+/**
+ * Worst parse time per input size, in power-of-two size buckets, printed when the target
+ * exits. With FLASHSPARTAN_FUZZ_BUDGET_US_PER_KIB set, an input slower than that many
+ * microseconds per KiB (one KiB at least) aborts, so libFuzzer keeps it as a crash artifact
+ * and the corpus replay fails: a parser that turns quadratic on a crafted SUMS file or
+ * catalog shows up here instead of as an auto-verify that never finishes.
+ *
+ * One instance per target, used from one thread (libFuzzer runs inputs serially).
+ */
+class WorstCaseTimer {
+public:
+    static constexpr int kBuckets = 40;  // up to 512 GiB inputs
+
+    explicit WorstCaseTimer(const char* name)
+        : m_name(name)
+        , m_budgetUsPerKiB(qEnvironmentVariableIntValue("FLASHSPARTAN_FUZZ_BUDGET_US_PER_KIB"))
+    {
+    }
+
+    ~WorstCaseTimer()
+    {
+        std::fprintf(stderr, "%s: worst parse time by input size\n", m_name);
+        for (int b = 0; b < kBuckets; ++b) {
+            if (m_worst[b].inputs == 0) {
+                continue;
+            }
+            std::fprintf(stderr, "  <= %10llu bytes  %10lld us  (%zu bytes, %llu inputs)\n",
+                         static_cast<unsigned long long>(uint64_t(1) << b),
+                         static_cast<long long>(m_worst[b].ns / 1000), m_worst[b].size,
+                         static_cast<unsigned long long>(m_worst[b].inputs));
+        }
+    }
+
+    /** Runs @p parse over an input of @p size bytes and records how long it took. */
+    template <typename Parse>
+    void run(size_t size, Parse&& parse)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        parse();
+        record(size, timer.nsecsElapsed());
+    }
+
+private:
+    struct Worst {
+        qint64 ns = 0;
+        size_t size = 0;
+        uint64_t inputs = 0;
+    };
+
+    void record(size_t size, qint64 ns)
+    {
+        const int bucket = qMin(kBuckets - 1, static_cast<int>(std::bit_width(size > 0 ? size - 1 : 0)));
+        Worst& worst = m_worst[bucket];
+        ++worst.inputs;
+        if (ns > worst.ns) {
+            worst.ns = ns;
+            worst.size = size;
+        }
+        if (m_budgetUsPerKiB <= 0) {
+            return;
+        }
+        const qint64 allowedUs = qint64(m_budgetUsPerKiB) * qMax<qint64>(1, qint64((size + 1023) / 1024));
+        if (ns / 1000 > allowedUs) {
+            std::fprintf(stderr, "%s: %zu-byte input took %lld us, over the %lld us budget\n", m_name, size,
+                         static_cast<long long>(ns / 1000), static_cast<long long>(allowedUs));
+            std::abort();
+        }
+    }
+
+    const char* m_name;
+    int m_budgetUsPerKiB;
+    std::array<Worst, kBuckets> m_worst{};
+};
+
+} // namespace FlashSpartan::Fuzz
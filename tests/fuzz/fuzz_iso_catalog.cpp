@@ -0,0 +1,20 @@
+// Catalog manifests arrive from the remote_url refresh, drop-in folders and the TOFU file.
+// Entries carry regular expressions, so a hostile catalog can cost time at lookup as well as
+// at parse; the lookup of a typical file name is timed with the merge.
+
+#include "FuzzTiming.h"
+#include "IsoCatalogInternal.h"
+
+using namespace FlashSpartan;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    static Fuzz::WorstCaseTimer timer("fuzz_iso_catalog");
+    const QByteArray bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(data), qsizetype(size));
+    timer.run(size, [&bytes]() {
+        const QString iso = QStringLiteral("ubuntu-24.04.2-desktop-amd64.iso");
+        IsoCatalogInternal::lookupInManifest(bytes, iso);
+        IsoCatalogInternal::lookupInManifest(bytes, iso, true);
+    });
+    return 0;
+}
@@ -0,0 +1,25 @@
+// SHA256SUMS / SHA512SUMS / b2sums files come from publisher mirrors and from the stick
+// being verified, so every byte of them is attacker-controlled.
+
+#include "FuzzTiming.h"
+#include "IsoChecksum.h"
+
+using namespace FlashSpartan;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    static Fuzz::WorstCaseTimer timer("fuzz_iso_checksum");
+    const QByteArray bytes = QByteArray::fromRawData(reinterpret_cast<const char*>(data), qsizetype(size));
+    timer.run(size, [&bytes]() {
+        const QString content = QString::fromUtf8(bytes);
+        const QString iso = QStringLiteral("archlinux-2024.11.01-x86_64.iso");
+        IsoChecksum::parseSha256Content(content, iso);
+        IsoChecksum::parseDigestContent(content, iso, QStringLiteral("SHA512SUMS"));
+        IsoChecksum::parseDigestContent(content, QString(), QStringLiteral("b2sums.txt"));
+
+        const ChecksumList list = ChecksumList::parse(bytes, QStringLiteral("SHA256SUMS"));
+        list.find(iso);
+        list.find(QString(), DigestAlgorithm::Sha256);
+    });
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <QtTest>
+
+#include "ActivityLogModel.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+LogEntry makeEntry(const QString& message, LogLevel level = LogLevel::Info, const QString& device = QString())
+{
+    LogEntry entry;
+    entry.timestamp = QDateTime::currentDateTime();
+    entry.level = level;
+    entry.category = QStringLiteral("System");
+    entry.message = message;
+    entry.deviceId = device;
+    return entry;
+}
+
+QString messageAt(const ActivityLogModel& model, int row)
+{
+    return model.entry(row).message;
+}
+
+} // namespace
+
+class TestActivityLogModel : public QObject {
+    Q_OBJECT
+
+private slots:
+    void coalescesAppendsIntoOneInsert();
+    void wrapsAtCapacity();
+    void filtersAcrossTheRing();
+    void resizeKeepsNewest();
+};
+
+void TestActivityLogModel::coalescesAppendsIntoOneInsert()
+{
+    ActivityLogModel model;
+    QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+    QSignalSpy flushed(&model, &ActivityLogModel::flushed);
+    for (int i = 0; i < 50; ++i) {
+        model.append(makeEntry(QStringLiteral("line %1").arg(i)));
+    }
+    QCOMPARE(model.rowCount(), 0);
+    QCOMPARE(model.pendingCount(), 50);
+
+    QTRY_COMPARE(flushed.count(), 1);
+    QCOMPARE(inserted.count(), 1);
+    QCOMPARE(flushed.first().at(0).toInt(), 50);
+    QCOMPARE(model.rowCount(), 50);
+    QCOMPARE(messageAt(model, 0), QStringLiteral("line 0"));
+    QVERIFY(model.data(model.index(49)).toString().endsWith(QStringLiteral("] line 49")));
+}
+
+void TestActivityLogModel::wrapsAtCapacity()
+{
+    ActivityLogModel model(ActivityLogModel::kMinCapacity);
+    for (int i = 0; i < 80; ++i) {
+        model.append(makeEntry(QString::number(i)));
+    }
+    model.flush();
+
+    QSignalSpy removed(&model, &QAbstractItemModel::rowsRemoved);
+    for (int i = 80; i < 150; ++i) {
+        model.append(makeEntry(QString::number(i)));
+    }
+    model.flush();
+    QCOMPARE(removed.count(), 1);
+    QCOMPARE(removed.first().at(2).toInt(), 49);  // rows 0..49 dropped in one go
+    QCOMPARE(model.heldCount(), 100);
+    QCOMPARE(messageAt(model, 0), QStringLiteral("50"));
+    QCOMPARE(messageAt(model, 99), QStringLiteral("149"));
+
+    // A burst bigger than the ring keeps only its newest lines.
+    for (int i = 150; i < 500; ++i) {
+        model.append(makeEntry(QString::number(i)));
+    }
+    QCOMPARE(model.pendingCount(), 100);
+    model.flush();
+    QCOMPARE(model.rowCount(), 100);
+    QCOMPARE(messageAt(model, 0), QStringLiteral("400"));
+    QCOMPARE(messageAt(model, 99), QStringLiteral("499"));
+}
+
+void TestActivityLogModel::filtersAcrossTheRing()
+{
+    ActivityLogModel model(ActivityLogModel::kMinCapacity);
+    for (int i = 0; i < 100; ++i) {
+        model.append(makeEntry(QStringLiteral("line %1").arg(i), i % 10 == 0 ? LogLevel::Warning : LogLevel::Info,
+                               i == 7 ? QStringLiteral("/dev/sdb") : QString()));
+    }
+    model.flush();
+
+    model.setFilterText(QStringLiteral(" warn "));
+    QCOMPARE(model.rowCount(), 10);
+    QCOMPARE(messageAt(model, 1), QStringLiteral("line 10"));
+    model.setFilterText(QStringLiteral("SDB"));
+    QCOMPARE(model.rowCount(), 1);
+    QCOMPARE(messageAt(model, 0), QStringLiteral("line 7"));
+
+    // Matches that fall off the ring leave the filtered rows; new matches are appended.
+    model.setFilterText(QStringLiteral("warn"));
+    QSignalSpy removed(&model, &QAbstractItemModel::rowsRemoved);
+    QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+    for (int i = 100; i < 125; ++i) {
+        model.append(makeEntry(QStringLiteral("line %1").arg(i), i % 10 == 0 ? LogLevel::Warning : LogLevel::Info));
+    }
+    model.flush();
+    QCOMPARE(removed.count(), 1);
+    QCOMPARE(removed.first().at(2).toInt(), 2);  // lines 0, 10 and 20
+    QCOMPARE(inserted.count(), 1);
+    QCOMPARE(model.rowCount(), 10);
+    QCOMPARE(messageAt(model, 0), QStringLiteral("line 30"));
+    QCOMPARE(messageAt(model, 9), QStringLiteral("line 120"));
+
+    model.setFilterText(QString());
+    QCOMPARE(model.rowCount(), 100);
+    QCOMPARE(messageAt(model, 0), QStringLiteral("line 25"));
+}
+
+void TestActivityLogModel::resizeKeepsNewest()
+{
+    ActivityLogModel model(300);
+    for (int i = 0; i < 250; ++i) {
+        model.append(makeEntry(QString::number(i)));
+    }
+    model.flush();
+
+    model.setCapacity(120);
+    QCOMPARE(model.capacity(), 120);
+    QCOMPARE(model.rowCount(), 120);
+    QCOMPARE(messageAt(model, 0), QStringLiteral("130"));
+
+    for (int i = 250; i < 260; ++i) {
+        model.append(makeEntry(QString::number(i)));
+    }
+    model.flush();
+    QCOMPARE(model.rowCount(), 120);
+    QCOMPARE(messageAt(model, 0), QStringLiteral("140"));
+    QCOMPARE(messageAt(model, 119), QStringLiteral("259"));
+
+    model.setCapacity(1);
+    QCOMPARE(model.capacity(), ActivityLogModel::kMinCapacity);
+    QCOMPARE(messageAt(model, 99), QStringLiteral("259"));
+}
+
+QTEST_GUILESS_MAIN(TestActivityLogModel)
+#include "test_activity_log_model.moc"
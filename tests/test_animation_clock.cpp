@@ -0,0 +1,88 @@
+#include <QtTest>
+
+#include "AnimationClock.h"
+
+using namespace FlashSpartan;
+
+class TestAnimationClock : public QObject {
+    Q_OBJECT
+
+private slots:
+    void runsOnlyWhileSubscribed();
+    void ticksEveryClientWithOneTime();
+    void suspendStopsTicking();
+    void capsFrameRate();
+};
+
+void TestAnimationClock::runsOnlyWhileSubscribed()
+{
+    AnimationClock clock;
+    QVERIFY(!clock.isRunning());
+    int frames = 0;
+    {
+        QObject card;
+        clock.subscribe(&card, [&frames](qint64) { ++frames; });
+        QVERIFY(clock.isSubscribed(&card));
+        QVERIFY(clock.isRunning());
+        QTRY_VERIFY(frames >= 2);
+    }
+    // A destroyed client is dropped and the timer stops with it.
+    QVERIFY(!clock.isRunning());
+    const int stopped = frames;
+    clock.tick();
+    QCOMPARE(frames, stopped);
+
+    QObject card;
+    clock.subscribe(&card, [](qint64) {});
+    clock.unsubscribe(&card);
+    QVERIFY(!clock.isSubscribed(&card));
+    QVERIFY(!clock.isRunning());
+}
+
+void TestAnimationClock::ticksEveryClientWithOneTime()
+{
+    AnimationClock clock;
+    QObject first;
+    QObject second;
+    QList<qint64> times;
+    clock.subscribe(&first, [&times](qint64 ms) { times.append(ms); });
+    clock.subscribe(&second, [&times, &clock, &first](qint64 ms) {
+        times.append(ms);
+        clock.unsubscribe(&first);  // removing another client mid-frame is safe
+    });
+
+    clock.tick();
+    QVERIFY(times.size() >= 1 && times.size() <= 2);
+    QCOMPARE(times.first(), times.last());
+
+    times.clear();
+    clock.tick();
+    QCOMPARE(times.size(), 1);
+}
+
+void TestAnimationClock::suspendStopsTicking()
+{
+    AnimationClock clock;
+    QObject card;
+    clock.subscribe(&card, [](qint64) {});
+    clock.setSuspended(true);
+    QVERIFY(!clock.isRunning());
+    QVERIFY(clock.isSubscribed(&card));
+    clock.setSuspended(false);
+    QVERIFY(clock.isRunning());
+}
+
+void TestAnimationClock::capsFrameRate()
+{
+    AnimationClock clock;
+    QCOMPARE(clock.interval(), qRound(1000.0 / AnimationClock::kMaxFrameRate));
+    clock.setFrameRate(144.0);
+    QCOMPARE(clock.interval(), qRound(1000.0 / AnimationClock::kMaxFrameRate));
+    clock.setFrameRate(20.0);
+    QCOMPARE(clock.interval(), 50);
+    clock.setFrameRate(0.0);  // unknown refresh rate keeps the last one
+    QCOMPARE(clock.interval(), 50);
+}
+
+QTEST_GUILESS_MAIN(TestAnimationClock)
+#include "test_animation_clock.moc"
@@ -0,0 +1,136 @@
+#include <QtTest>
+#include "AsyncTask.h"
+#include "IoScheduler.h"
+
+#include <QException>
+#include <QThread>
+
+using namespace FlashSpartan;
+
+namespace {
+
+const IoScheduler::Task kCpuTask{QString(), IoScheduler::Priority::Normal, IoScheduler::Pool::Cpu};
+
+AsyncTask<int> addOnScheduler(QObject* context, IoScheduler& scheduler, int a, int b, QThread** resumedOn)
+{
+    const std::optional<int> sum = co_await resumeOn(context, scheduler.run(kCpuTask, [a, b]() {
+        QThread::msleep(20);
+        return a + b;
+    }));
+    *resumedOn = QThread::currentThread();
+    co_return sum.value_or(-1);
+}
+
+AsyncTask<int> twoStages(QObject* context, IoScheduler& scheduler, QThread** resumedOn)
+{
+    const std::optional<int> first = co_await resumeOn(context, addOnScheduler(context, scheduler, 1, 2, resumedOn).future());
+    const std::optional<int> second
+        = co_await resumeOn(context, addOnScheduler(context, scheduler, *first, 10, resumedOn).future());
+    co_return *second;
+}
+
+AsyncTask<> failingStage(QObject* context, IoScheduler& scheduler)
+{
+    co_await resumeOn(context, scheduler.run(kCpuTask, []() -> int { throw QException(); }));
+}
+
+AsyncTask<bool> hasValue(QObject* context, QFuture<int> future)
+{
+    const std::optional<int> value = co_await resumeOn(context, future);
+    co_return value.has_value();
+}
+
+struct SetOnDestroy {
+    bool* flag;
+    ~SetOnDestroy() { *flag = true; }
+};
+
+AsyncTask<int> waitWithGuard(QObject* context, QFuture<int> future, bool* frameDestroyed)
+{
+    const SetOnDestroy guard{frameDestroyed};
+    const std::optional<int> value = co_await resumeOn(context, future);
+    co_return value.value_or(-1);
+}
+
+} // namespace
+
+class TestAsyncTask : public QObject {
+    Q_OBJECT
+private slots:
+    void resumesOnTheContextThread();
+    void stagesChain();
+    void exceptionsReachTheFuture();
+    void cancelledFutureGivesNothing();
+    void destroyedContextDropsTheFlow();
+};
+
+void TestAsyncTask::resumesOnTheContextThread()
+{
+    IoScheduler scheduler;
+    QObject context;
+    QThread* resumedOn = nullptr;
+    const AsyncTask<int> task = addOnScheduler(&context, scheduler, 2, 3, &resumedOn);
+    QVERIFY(!task.future().isFinished());
+    QTRY_VERIFY(task.future().isFinished());
+    QCOMPARE(task.future().result(), 5);
+    QCOMPARE(resumedOn, QThread::currentThread());
+}
+
+void TestAsyncTask::stagesChain()
+{
+    IoScheduler scheduler;
+    QObject context;
+    QThread* resumedOn = nullptr;
+    const AsyncTask<int> task = twoStages(&context, scheduler, &resumedOn);
+    QTRY_VERIFY(task.future().isFinished());
+    QCOMPARE(task.future().result(), 13);
+    QCOMPARE(resumedOn, QThread::currentThread());
+}
+
+void TestAsyncTask::exceptionsReachTheFuture()
+{
+    IoScheduler scheduler;
+    QObject context;
+    QFuture<void> future = failingStage(&context, scheduler).future();
+    QTRY_VERIFY(future.isFinished());
+    QVERIFY_THROWS_EXCEPTION(QException, future.waitForFinished());
+}
+
+void TestAsyncTask::cancelledFutureGivesNothing()
+{
+    QObject context;
+    QPromise<int> promise;
+    promise.start();
+    QFuture<int> pending = promise.future();
+    const AsyncTask<bool> task = hasValue(&context, pending);
+    QVERIFY(!task.future().isFinished());
+
+    pending.cancel();
+    promise.finish();
+    QTRY_VERIFY(task.future().isFinished());
+    QCOMPARE(task.future().result(), false);
+
+    // Already finished: no event loop round trip.
+    QCOMPARE(hasValue(&context, QtFuture::makeReadyFuture(7)).future().result(), true);
+}
+
+void TestAsyncTask::destroyedContextDropsTheFlow()
+{
+    auto* context = new QObject;
+    QPromise<int> promise;
+    promise.start();
+    bool frameDestroyed = false;
+    const AsyncTask<int> task = waitWithGuard(context, promise.future(), &frameDestroyed);
+    QVERIFY(!frameDestroyed);
+
+    delete context;
+    QVERIFY(frameDestroyed);
+    QVERIFY(task.future().isCanceled());
+    QVERIFY(task.future().isFinished());
+
+    promise.addResult(1);
+    promise.finish();
+}
+
+QTEST_MAIN(TestAsyncTask)
+#include "test_async_task.moc"
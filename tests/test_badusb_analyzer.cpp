@@ -1,6 +1,12 @@
 #include <QtTest>
 
+#include <QJsonDocument>
+
 #include "BadUsbAnalyzer.h"
+#include "BadUsbRuleSet.h"
+#include "HidDescriptorFingerprint.h"
+#include "HidKeystrokeAnalyzer.h"
+#include "UsbmonRing.h"
 
 using namespace FlashSpartan;
 
@@ -12,8 +18,57 @@ private slots:
     void compositeKeyboardStorageIsCritical();
     void trustedKeyboardPasses();
     void interfaceDriftAnomaly();
+    void descriptorFingerprintIsCanonical();
+    void fingerprintDriftAndAllowlist();
+    void fleetRulesMatchSignatures();
+    void mostSevereRuleWins();
+    void reconnectWindowCounts();
+    void connectCounterWindows();
+    void connectCounterSurvivesFloods();
+    void invalidRulesAreSkipped();
+    void injectedTypingIsFlagged();
+    void humanTypingPasses();
+    void nonKeyboardReportsAreIgnored();
+    void keystrokeRateAnomaly();
 };
 
+/** An interrupt-IN completion carrying one boot-keyboard report, as usbmon delivers it. */
+static UsbmonPacket report(qint64 timestampUs, quint8 key, quint8 modifiers = 0, quint8 device = 5)
+{
+    UsbmonPacket p;
+    p.bus = 2;
+    p.device = device;
+    p.eventType = 'C';
+    p.transferType = 1;
+    p.endpoint = 0x81;
+    p.timestampUs = timestampUs;
+    p.frame = QByteArray(int(UsbmonRing::kHeaderBytes), '\0');
+    const char r[8] = {char(modifiers), 0, char(key), 0, 0, 0, 0, 0};
+    p.frame.append(r, 8);
+    return p;
+}
+
+/** Types @p keys key presses (press + release reports) @p intervalUs apart; the first finding. */
+static std::optional<HidKeystrokeAnalyzer::Finding> type(HidKeystrokeAnalyzer& analyzer, int keys,
+                                                          qint64 startUs, qint64 intervalUs)
+{
+    std::optional<HidKeystrokeAnalyzer::Finding> first;
+    for (int i = 0; i < keys; ++i) {
+        const qint64 t = startUs + i * intervalUs;
+        auto finding = analyzer.feed(report(t, quint8(0x04 + i % 26)));
+        analyzer.feed(report(t + intervalUs / 2, 0));
+        if (finding && !first) {
+            first = finding;
+        }
+    }
+    return first;
+}
+
+static QList<BadUsbRuleDefinition> rules(const char* json, QStringList* errors = nullptr)
+{
+    return BadUsbRuleSet::parse(QJsonDocument::fromJson(json), QStringLiteral("test.json"), errors);
+}
+
 static HidDeviceInfo keyboard()
 {
     HidDeviceInfo info;
@@ -76,5 +131,323 @@ void TestBadUsbAnalyzer::interfaceDriftAnomaly()
     QCOMPARE(result.ruleId, QStringLiteral("interface-drift"));
 }
 
+void TestBadUsbAnalyzer::descriptorFingerprintIsCanonical()
+{
+    // Device descriptor, then a configuration descriptor.
+    const QByteArray descriptors = QByteArray::fromHex("12010002000000086d041cc3000101020001"
+                                                       "09022200010100a032");
+    const QByteArray report = QByteArray::fromHex("05010906a101");
+    const QByteArray fp = HidDescriptorFingerprint::compute(descriptors, {{QStringLiteral("1.0"), report}});
+    QCOMPARE(fp.size(), HidDescriptorFingerprint::kSize);
+
+    // Interface order and a torn trailing descriptor do not change it; any real byte does.
+    QCOMPARE(HidDescriptorFingerprint::compute(descriptors + QByteArray::fromHex("0904"),
+                                               {{QStringLiteral("1.0"), report}}),
+             fp);
+    const QByteArray two = HidDescriptorFingerprint::compute(
+        descriptors, {{QStringLiteral("1.1"), report}, {QStringLiteral("1.0"), report}});
+    QCOMPARE(HidDescriptorFingerprint::compute(descriptors, {{QStringLiteral("1.0"), report},
+                                                             {QStringLiteral("1.1"), report}}),
+             two);
+    QVERIFY(two != fp);
+    QByteArray changed = report;
+    changed[3] = '\x02';
+    QVERIFY(HidDescriptorFingerprint::compute(descriptors, {{QStringLiteral("1.0"), changed}}) != fp);
+    QVERIFY(HidDescriptorFingerprint::compute(QByteArray::fromHex("0001"), {}).isEmpty());
+
+    QCOMPARE(HidDescriptorFingerprint::fromHex(HidDescriptorFingerprint::toHex(fp)), fp);
+    QVERIFY(HidDescriptorFingerprint::fromHex(QStringLiteral("abcd")).isEmpty());
+
+    HidDeviceInfo device = keyboard();
+    device.descriptorFingerprint = fp;
+    QCOMPARE(HidDeviceInfo::fromJson(device.toJson()).descriptorFingerprint, fp);
+}
+
+void TestBadUsbAnalyzer::fingerprintDriftAndAllowlist()
+{
+    AppSettings settings;
+    const QByteArray good = QByteArray(HidDescriptorFingerprint::kSize, '\x11');
+    const QByteArray other = QByteArray(HidDescriptorFingerprint::kSize, '\x22');
+    BadUsbBaselineEntry baseline;
+    baseline.stableId = keyboard().stableId();
+    baseline.device = keyboard();
+    baseline.device.descriptorFingerprint = good;
+    baseline.trusted = true;
+
+    // Fingerprints decide drift when both sides have one, even if the interface list agrees.
+    HidDeviceInfo device = keyboard();
+    device.descriptorFingerprint = other;
+    QCOMPARE(BadUsbAnalyzer::analyzeConnect(device, baseline, {}, 1, settings).ruleId,
+             QStringLiteral("interface-drift"));
+    device.descriptorFingerprint = good;
+    device.interfaces[0].driver = QStringLiteral("hid-generic");
+    QVERIFY(!BadUsbAnalyzer::analyzeConnect(device, baseline, {}, 1, settings).anomalous);
+
+    // A fleet allowlist clears an unknown keyboard before any other rule is reported.
+    QList<BadUsbRuleDefinition> list = BadUsbRuleSet::builtinRules(settings);
+    list += rules(QStringLiteral(R"({"rules": [
+        {"id": "fleet-keyboards", "allow": true, "match": {"fingerprint": ["%1"]}},
+        {"id": "fleet-bad", "severity": "critical", "match": {"fingerprint": "%2"}}
+    ]})").arg(HidDescriptorFingerprint::toHex(good), HidDescriptorFingerprint::toHex(other)).toUtf8().constData());
+    const BadUsbRuleSet set = BadUsbRuleSet::compile(list);
+    QVERIFY(!set.match(device, std::nullopt, {}, {}));
+    device.descriptorFingerprint = other;
+    QCOMPARE(set.match(device, std::nullopt, {}, {})->id, QStringLiteral("fleet-bad"));
+    device.descriptorFingerprint.clear();
+    QCOMPARE(set.match(device, std::nullopt, {}, {})->id, QStringLiteral("new-keyboard"));
+
+    QStringList errors;
+    BadUsbRuleSet::compile(rules(R"({"rules": [{"id": "short", "match": {"fingerprint": ["abcd"]}}]})"), &errors);
+    QCOMPARE(errors.size(), 1);
+}
+
+void TestBadUsbAnalyzer::fleetRulesMatchSignatures()
+{
+    const BadUsbRuleSet set = BadUsbRuleSet::compile(rules(R"({"rules": [
+        {"id": "ducky", "severity": "critical", "match": {"vid_pid": ["03eb:2401", "046d:c31c"]}},
+        {"id": "vendor", "match": {"vid_pid": ["1b4f:*"], "capabilities": ["keyboard"]}},
+        {"id": "named", "match": {"product": "digispark", "interface": "^00:03:01:01:"}},
+        {"id": "same-ids", "severity": "info", "match": {"vid_pid": ["046d:c31c", "03eb:2401"]}}
+    ]})"));
+    QCOMPARE(set.ruleCount(), 4);
+    // The two identical VID/PID sets and the shared keyboard condition are one predicate each.
+    QCOMPARE(set.predicateCount(), 5);
+
+    const BadUsbRuleDefinition* rule = set.match(keyboard(), std::nullopt, {}, {});
+    QVERIFY(rule);
+    QCOMPARE(rule->id, QStringLiteral("ducky"));
+    QCOMPARE(rule->severity, BadUsbSeverity::Critical);
+    QCOMPARE(rule->source, QStringLiteral("test.json"));
+
+    HidDeviceInfo sparkfun = keyboard();
+    sparkfun.vendorId = QStringLiteral("1B4F");
+    sparkfun.productId = QStringLiteral("9208");
+    rule = set.match(sparkfun, std::nullopt, {}, {});
+    QVERIFY(rule);
+    QCOMPARE(rule->id, QStringLiteral("vendor"));
+    sparkfun.capabilities = {QStringLiteral("mouse")};
+    QVERIFY(!set.match(sparkfun, std::nullopt, {}, {}));
+
+    HidDeviceInfo digispark = keyboard();
+    digispark.vendorId = QStringLiteral("16d0");
+    digispark.productId = QStringLiteral("0753");
+    digispark.product = QStringLiteral("DigiSpark Keyboard");
+    rule = set.match(digispark, std::nullopt, {}, {});
+    QVERIFY(rule);
+    QCOMPARE(rule->id, QStringLiteral("named"));
+    digispark.interfaces[0].interfaceProtocol = QStringLiteral("02");
+    QVERIFY(!set.match(digispark, std::nullopt, {}, {}));
+
+    // Through the analyzer, with the built-in rules first.
+    AppSettings settings;
+    settings.badUsbAlertNewKeyboard = false;
+    const BadUsbRuleSet all = BadUsbRuleSet::compile(BadUsbRuleSet::builtinRules(settings)
+                                                     + rules(R"({"rules": [{"id": "ducky", "severity": "critical",
+                                                                 "match": {"vid_pid": ["046d:c31c"]}}]})"));
+    const auto result = BadUsbAnalyzer::analyzeConnect(keyboard(), std::nullopt, {}, {}, all);
+    QVERIFY(result.anomalous);
+    QCOMPARE(result.ruleId, QStringLiteral("ducky"));
+}
+
+void TestBadUsbAnalyzer::mostSevereRuleWins()
+{
+    AppSettings settings;
+    const QList<BadUsbRuleDefinition> fleet = rules(R"({"rules": [
+        {"id": "any-keyboard", "severity": "info", "match": {"capabilities": ["keyboard"]}},
+        {"id": "untrusted-logitech", "severity": "critical",
+         "match": {"vid_pid": ["046d:*"], "baseline": "untrusted"}}
+    ]})");
+    const BadUsbRuleSet set = BadUsbRuleSet::compile(BadUsbRuleSet::builtinRules(settings) + fleet);
+
+    // new-keyboard (warning) comes first, the fleet's critical rule still wins.
+    const BadUsbRuleDefinition* rule = set.match(keyboard(), std::nullopt, {}, {});
+    QVERIFY(rule);
+    QCOMPARE(rule->id, QStringLiteral("untrusted-logitech"));
+
+    // Trusted: only the info rule is left.
+    BadUsbBaselineEntry baseline;
+    baseline.device = keyboard();
+    baseline.trusted = true;
+    rule = set.match(keyboard(), baseline, {}, {});
+    QVERIFY(rule);
+    QCOMPARE(rule->id, QStringLiteral("any-keyboard"));
+
+    // Equal severity: the earlier built-in rule.
+    const BadUsbRuleSet ladder = BadUsbRuleSet::compile(BadUsbRuleSet::builtinRules(settings));
+    rule = ladder.match(keyboard(), std::nullopt, {QStringLiteral("/dev/sdb1")}, {});
+    QVERIFY(rule);
+    QCOMPARE(rule->id, QStringLiteral("composite-storage-keyboard"));
+}
+
+void TestBadUsbAnalyzer::reconnectWindowCounts()
+{
+    AppSettings settings;
+    const BadUsbRuleSet set = BadUsbRuleSet::compile(BadUsbRuleSet::builtinRules(settings)
+                                                     + rules(R"({"rules": [{"id": "slow-probe",
+                                                         "match": {"connects": {"at_least": 5, "within_seconds": 300}}}]})"));
+    QCOMPARE(set.maxWindowSeconds(), 300);
+
+    BadUsbBaselineEntry baseline;
+    baseline.device = keyboard();
+    baseline.trusted = true;
+    const QString id = keyboard().stableId();
+    const qint64 now = 1700000000;
+    HidConnectCounter connects(set.maxWindowSeconds());
+    for (qint64 at : {now - 310, now - 200, now - 100, now - 20, now - 5}) {
+        connects.record(id, at);
+    }
+    // Four in five minutes, one in ten seconds.
+    auto result = BadUsbAnalyzer::analyzeConnect(keyboard(), baseline, {}, connects, now - 5, set);
+    QVERIFY(!result.anomalous);
+
+    connects.record(id, now);
+    result = BadUsbAnalyzer::analyzeConnect(keyboard(), baseline, {}, connects, now, set);
+    QVERIFY(result.anomalous);
+    QCOMPARE(result.ruleId, QStringLiteral("slow-probe"));
+
+    connects.record(id, now);  // three in ten seconds as well: the earlier rule wins the tie
+    result = BadUsbAnalyzer::analyzeConnect(keyboard(), baseline, {}, connects, now, set);
+    QCOMPARE(result.ruleId, QStringLiteral("rapid-reconnect"));
+}
+
+void TestBadUsbAnalyzer::connectCounterWindows()
+{
+    HidConnectCounter counter(10);
+    const QString a = QStringLiteral("a");
+    QCOMPARE(counter.count(a, 10, 100), 0);
+    counter.record(a, 100);
+    counter.record(a, 100);
+    counter.record(a, 105);
+    QCOMPARE(counter.count(a, 10, 105), 3);
+    QCOMPARE(counter.count(a, 4, 105), 1);
+    QCOMPARE(counter.count(a, 0, 105), 1);
+    QCOMPARE(counter.count(a, 10, 110), 3);  // [100, 110]
+    QCOMPARE(counter.count(a, 10, 111), 1);
+    QCOMPARE(counter.count(a, 10, 116), 0);
+    QCOMPARE(counter.count(a, 600, 105), 3);  // clamped to the ten-second window
+    QCOMPARE(counter.count(QStringLiteral("b"), 10, 105), 0);
+
+    // After a long silence only the new connect counts, wherever the ring has wrapped to.
+    counter.record(a, 10000);
+    QCOMPARE(counter.count(a, 10, 10000), 1);
+    counter.record(a, 10003);
+    QCOMPARE(counter.count(a, 10, 10005), 2);
+    QCOMPARE(counter.count(a, 2, 10005), 1);
+
+    counter.setMaxWindowSeconds(60);
+    QCOMPARE(counter.maxWindowSeconds(), 60);
+    QCOMPARE(counter.count(a, 10, 10005), 0);  // forgotten with the old window
+}
+
+void TestBadUsbAnalyzer::connectCounterSurvivesFloods()
+{
+    HidConnectCounter counter(10);
+    const QString flood = QStringLiteral("flood");
+    for (int i = 0; i < 100000; ++i) {
+        counter.record(flood, 1000 + i / 1000);  // 1000 connects a second for 100 s
+    }
+    QCOMPARE(counter.count(flood, 10, 1099), 11000);
+    QCOMPARE(counter.count(flood, 0, 1099), 1000);
+
+    // Rotating identities: idle ones are dropped once many are tracked.
+    for (int i = 0; i < HidConnectCounter::kPruneAboveDevices * 4; ++i) {
+        counter.record(QStringLiteral("serial-%1").arg(i), 2000 + i / 10);
+    }
+    QVERIFY(counter.deviceCount() <= HidConnectCounter::kPruneAboveDevices + 1);
+    QCOMPARE(counter.count(flood, 10, 2000), 0);
+}
+
+void TestBadUsbAnalyzer::invalidRulesAreSkipped()
+{
+    QStringList errors;
+    const QList<BadUsbRuleDefinition> parsed = rules(R"({"rules": [
+        {"id": "no-conditions"},
+        {"id": "bad-regex", "match": {"product": "("}},
+        {"id": "bad-id", "match": {"vid_pid": ["xyz:1"]}},
+        {"id": "bad-severity", "severity": "loud", "match": {"capabilities": ["keyboard"]}},
+        {"id": "fine", "match": {"serial": "^abc$"}}
+    ]})", &errors);
+    QCOMPARE(parsed.size(), 4);
+    const BadUsbRuleSet set = BadUsbRuleSet::compile(parsed, &errors);
+    QCOMPARE(set.ruleCount(), 1);
+    QCOMPARE(errors.size(), 4);
+    QVERIFY(set.match(keyboard(), std::nullopt, {}, {}));
+
+    errors.clear();
+    QVERIFY(rules("{}", &errors).isEmpty());
+    QCOMPARE(errors.size(), 1);
+    QVERIFY(!BadUsbRuleSet().match(keyboard(), std::nullopt, {}, {}));
+}
+
+void TestBadUsbAnalyzer::injectedTypingIsFlagged()
+{
+    HidKeystrokeAnalyzer analyzer;
+    // A scripted payload: a key every 8 ms.
+    const auto finding = type(analyzer, 40, 1000000, 8000);
+    QVERIFY(finding.has_value());
+    QCOMPARE(finding->bus, quint16(2));
+    QCOMPARE(finding->device, quint8(5));
+    QCOMPARE(finding->keys, HidKeystrokeAnalyzer::kWindowKeys);
+    QCOMPARE(finding->spanUs, qint64(HidKeystrokeAnalyzer::kWindowKeys - 1) * 8000);
+    QVERIFY(finding->keysPerSecond > 100.0);
+    QVERIFY(finding->histogramText().contains(QStringLiteral("<16 ms: 15")));
+
+    // Once per burst; a new burst after an idle gap alerts again.
+    QVERIFY(!type(analyzer, 40, 2000000, 8000).has_value());
+    QVERIFY(type(analyzer, 40, 20000000, 8000).has_value());
+}
+
+void TestBadUsbAnalyzer::humanTypingPasses()
+{
+    HidKeystrokeAnalyzer analyzer;
+    QVERIFY(!type(analyzer, 200, 1000000, 90000).has_value());  // ~11 keys/s, a fast typist
+
+    // Held keys, modifier changes and rollover repeat no key-down.
+    HidKeystrokeAnalyzer held;
+    for (int i = 0; i < 100; ++i) {
+        QVERIFY(!held.feed(report(1000000 + i * 1000, 0x04, i % 2 ? 0x02 : 0)).has_value());
+    }
+}
+
+void TestBadUsbAnalyzer::nonKeyboardReportsAreIgnored()
+{
+    const char mouse[8] = {1, 5, char(0xFE), 0, 0, 0, 0, 0};
+    QVERIFY(!HidKeystrokeAnalyzer::isBootKeyboardReport(mouse, 8));
+    const char gap[8] = {0, 0, 0x04, 0, 0x05, 0, 0, 0};
+    QVERIFY(!HidKeystrokeAnalyzer::isBootKeyboardReport(gap, 8));
+    const char rollover[8] = {0, 0, 1, 1, 1, 1, 1, 1};
+    QVERIFY(HidKeystrokeAnalyzer::isBootKeyboardReport(rollover, 8));
+
+    HidKeystrokeAnalyzer analyzer;
+    for (int i = 0; i < 64; ++i) {
+        UsbmonPacket p = report(1000000 + i * 1000, quint8(0x04 + i % 26));
+        p.eventType = 'S';  // submissions carry no report yet
+        QVERIFY(!analyzer.feed(p).has_value());
+        p = report(1000000 + i * 1000, quint8(0x04 + i % 26));
+        p.endpoint = 0x01;  // OUT: LED reports
+        QVERIFY(!analyzer.feed(p).has_value());
+    }
+}
+
+void TestBadUsbAnalyzer::keystrokeRateAnomaly()
+{
+    HidKeystrokeAnalyzer::Finding finding;
+    finding.keys = 16;
+    finding.spanUs = 120000;
+    finding.keysPerSecond = 125;
+    finding.histogram[3] = 15;
+    auto result = BadUsbAnalyzer::analyzeKeystrokeRate(keyboard(), finding, std::nullopt);
+    QVERIFY(result.anomalous);
+    QCOMPARE(result.ruleId, QStringLiteral("keystroke-rate"));
+    QCOMPARE(result.severity, BadUsbSeverity::Critical);
+    QVERIFY(result.detail.contains(QStringLiteral("125 keys/s")));
+
+    BadUsbBaselineEntry baseline;
+    baseline.device = keyboard();
+    baseline.trusted = true;
+    result = BadUsbAnalyzer::analyzeKeystrokeRate(keyboard(), finding, baseline);
+    QCOMPARE(result.severity, BadUsbSeverity::Warning);
+}
+
 QTEST_MAIN(TestBadUsbAnalyzer)
 #include "test_badusb_analyzer.moc"
@@ -10,8 +10,28 @@ class TestBadUsbBaselineStore : public QObject {
 
 private slots:
     void roundTripTrustedDevice();
+    void editsAppendToJournal();
+    void journalCheckpointsWhenFull();
+    void tornJournalTailIsDropped();
 };
 
+static HidDeviceInfo hid(const QString& serial)
+{
+    HidDeviceInfo info;
+    info.vendorId = QStringLiteral("046d");
+    info.productId = QStringLiteral("c31c");
+    info.serial = serial;
+    info.product = QStringLiteral("Keyboard");
+    info.capabilities = {QStringLiteral("keyboard")};
+    return info;
+}
+
+static QByteArray readAll(const QString& path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
 void TestBadUsbBaselineStore::roundTripTrustedDevice()
 {
     QTemporaryDir dir;
@@ -39,5 +59,101 @@ void TestBadUsbBaselineStore::roundTripTrustedDevice()
     QVERIFY(entry->device.capabilities.contains(QStringLiteral("keyboard")));
 }
 
+void TestBadUsbBaselineStore::editsAppendToJournal()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("badusb-baseline.json"));
+
+    BadUsbBaselineStore store;
+    QVERIFY(store.initialize(path));
+    for (int i = 0; i < 20; ++i) {
+        QVERIFY(store.upsertBaseline(hid(QStringLiteral("K%1").arg(i)), false));
+    }
+    QVERIFY(store.save());
+    const QByteArray checkpoint = readAll(path);
+    QVERIFY(!checkpoint.isEmpty());
+
+    // Trust clicks and removals leave the checkpoint alone.
+    QVERIFY(store.setTrusted(hid(QStringLiteral("K3")).stableId(), true));
+    QVERIFY(store.removeDevice(hid(QStringLiteral("K4")).stableId()));
+    QVERIFY(store.upsertBaseline(hid(QStringLiteral("K20")), true, QStringLiteral("new")));
+    QCOMPARE(store.journalEntries(), 3);
+    QCOMPARE(readAll(path), checkpoint);
+    QVERIFY(QFileInfo(store.journalPath()).size() > 0);
+    QVERIFY(!store.setTrusted(QStringLiteral("missing"), true));
+    QCOMPARE(store.journalEntries(), 3);
+
+    // Readers see every edit at once.
+    QVERIFY(store.getDevice(hid(QStringLiteral("K3")).stableId())->trusted);
+    QVERIFY(!store.hasDevice(hid(QStringLiteral("K4")).stableId()));
+    QCOMPARE(store.allDevices().size(), 20);
+
+    // A restart replays the journal and folds it into a new checkpoint.
+    BadUsbBaselineStore loaded;
+    QVERIFY(loaded.initialize(path));
+    QCOMPARE(loaded.allDevices().size(), 20);
+    QVERIFY(loaded.getDevice(hid(QStringLiteral("K3")).stableId())->trusted);
+    QVERIFY(!loaded.hasDevice(hid(QStringLiteral("K4")).stableId()));
+    QCOMPARE(loaded.getDevice(hid(QStringLiteral("K20")).stableId())->notes, QStringLiteral("new"));
+    QCOMPARE(loaded.journalEntries(), 0);
+    QVERIFY(readAll(path) != checkpoint);
+
+    BadUsbBaselineStore again;
+    QVERIFY(again.initialize(path));
+    QCOMPARE(again.allDevices().size(), 20);
+}
+
+void TestBadUsbBaselineStore::journalCheckpointsWhenFull()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("badusb-baseline.json"));
+
+    BadUsbBaselineStore store;
+    QVERIFY(store.initialize(path));
+    const QString id = hid(QStringLiteral("K")).stableId();
+    QVERIFY(store.upsertBaseline(hid(QStringLiteral("K")), false));
+    for (int i = 0; i < BadUsbBaselineStore::kCheckpointEntries + 10; ++i) {
+        QVERIFY(store.setTrusted(id, i % 2 == 0));
+        QVERIFY(store.journalEntries() <= BadUsbBaselineStore::kCheckpointEntries);
+    }
+    QVERIFY(QFileInfo::exists(path));
+    QVERIFY(store.journalEntries() < BadUsbBaselineStore::kCheckpointEntries);
+
+    BadUsbBaselineStore loaded;
+    QVERIFY(loaded.initialize(path));
+    QCOMPARE(loaded.getDevice(id)->trusted, store.getDevice(id)->trusted);
+}
+
+void TestBadUsbBaselineStore::tornJournalTailIsDropped()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("badusb-baseline.json"));
+    {
+        BadUsbBaselineStore store;
+        QVERIFY(store.initialize(path));
+        QVERIFY(store.upsertBaseline(hid(QStringLiteral("A")), true));
+        QVERIFY(store.upsertBaseline(hid(QStringLiteral("B")), true));
+    }
+    // A crash in the middle of the second record.
+    QFile journal(path + QStringLiteral(".wal"));
+    QVERIFY(journal.open(QIODevice::ReadWrite));
+    QVERIFY(journal.resize(journal.size() - 5));
+    journal.close();
+
+    BadUsbBaselineStore loaded;
+    QVERIFY(loaded.initialize(path));
+    QVERIFY(loaded.hasDevice(hid(QStringLiteral("A")).stableId()));
+    QVERIFY(!loaded.hasDevice(hid(QStringLiteral("B")).stableId()));
+
+    // Later edits are not lost behind the torn record.
+    QVERIFY(loaded.upsertBaseline(hid(QStringLiteral("C")), true));
+    BadUsbBaselineStore reloaded;
+    QVERIFY(reloaded.initialize(path));
+    QCOMPARE(reloaded.allDevices().size(), 2);
+}
+
 QTEST_MAIN(TestBadUsbBaselineStore)
 #include "test_badusb_baseline.moc"
@@ -0,0 +1,151 @@
+#include <QtTest>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "CapacityProbe.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+constexpr uint64_t kMiB = 1024ULL * 1024;
+constexpr uint64_t kGiB = 1024 * kMiB;
+
+/** Sector @p index of a formatted stick: distinct, never blank. */
+void fillSector(char* out, uint64_t index)
+{
+    std::memset(out, 0xA5, CapacityProbe::kSectorBytes);
+    std::memcpy(out, &index, sizeof(index));
+}
+
+/** A stick with @p realBytes of flash that drops the high address bits past it. */
+CapacityProbe::ReadAt wrappingDevice(uint64_t realBytes)
+{
+    return [realBytes](uint64_t offset, char* buffer, size_t length) {
+        for (size_t at = 0; at < length; at += CapacityProbe::kSectorBytes) {
+            fillSector(buffer + at, ((offset + at) % realBytes) / CapacityProbe::kSectorBytes);
+        }
+        return true;
+    };
+}
+
+} // namespace
+
+class TestCapacityProbe : public QObject {
+    Q_OBJECT
+
+private slots:
+    void offsetsCoverTheClaim();
+    void genuineDevicePasses();
+    void wrapAroundIsFound();
+    void unreadableTailIsNarrowedToASector();
+    void isolatedReadErrorIsNotACapacity();
+    void blankStartIsInconclusive();
+    void checkRoundTrips();
+};
+
+void TestCapacityProbe::offsetsCoverTheClaim()
+{
+    const std::vector<uint64_t> periods = CapacityProbe::periodOffsets(256 * kGiB);
+    QCOMPARE(periods.size(), size_t(14));  // 16 MiB .. 128 GiB
+    QCOMPARE(periods.front(), CapacityProbe::kMinPeriodBytes);
+    QCOMPARE(periods.back(), 128 * kGiB);
+
+    const std::vector<uint64_t> grid = CapacityProbe::gridOffsets(256 * kGiB);
+    QCOMPARE(grid.size(), size_t(CapacityProbe::kGridReads));
+    QCOMPARE(grid.back(), 256 * kGiB - CapacityProbe::kSectorBytes);
+    QVERIFY(std::is_sorted(grid.cbegin(), grid.cend()));
+
+    QVERIFY(CapacityProbe::periodOffsets(8 * kMiB).empty());
+}
+
+void TestCapacityProbe::genuineDevicePasses()
+{
+    std::atomic<uint64_t> bytes{0};
+    const CapacityProbe::ReadAt inner = wrappingDevice(64 * kGiB);
+    const CapacityCheck check = CapacityProbe::run(64 * kGiB, [&](uint64_t offset, char* buffer, size_t length) {
+        bytes += length;
+        return inner(offset, buffer, length);
+    });
+    QVERIFY(check.verdict == CapacityCheck::Verdict::NoAliasing);
+    QCOMPARE(check.realBytes, 64 * kGiB);
+    QCOMPARE(check.bytesRead, bytes.load());
+    QVERIFY(check.bytesRead < 64 * kMiB);
+    QVERIFY(!check.isCounterfeit());
+    QVERIFY(!check.isEmpty());
+}
+
+void TestCapacityProbe::wrapAroundIsFound()
+{
+    const CapacityCheck check = CapacityProbe::run(256 * kGiB, wrappingDevice(8 * kGiB));
+    QVERIFY(check.verdict == CapacityCheck::Verdict::Aliased);
+    QCOMPARE(check.realBytes, 8 * kGiB);
+    QVERIFY(check.isCounterfeit());
+    QCOMPARE(CapacityProbe::describe(check),
+             QStringLiteral("Counterfeit capacity: real size at most 8.00 GiB. "
+                            "The start of the device reappears at 8.00 GiB (reports 256.00 GiB)"));
+}
+
+void TestCapacityProbe::unreadableTailIsNarrowedToASector()
+{
+    const uint64_t edge = 300 * kMiB + 5 * CapacityProbe::kSectorBytes;
+    const CapacityProbe::ReadAt inner = wrappingDevice(2 * kGiB);
+    const CapacityCheck check = CapacityProbe::run(2 * kGiB, [&](uint64_t offset, char* buffer, size_t length) {
+        return offset + length <= edge && inner(offset, buffer, length);
+    });
+    QVERIFY(check.verdict == CapacityCheck::Verdict::UnreadableBeyond);
+    QCOMPARE(check.realBytes, edge);
+}
+
+void TestCapacityProbe::isolatedReadErrorIsNotACapacity()
+{
+    const uint64_t badSector = CapacityProbe::gridOffsets(2 * kGiB).at(10);
+    const CapacityProbe::ReadAt inner = wrappingDevice(2 * kGiB);
+    const CapacityCheck check = CapacityProbe::run(2 * kGiB, [&](uint64_t offset, char* buffer, size_t length) {
+        return offset != badSector && inner(offset, buffer, length);
+    });
+    QVERIFY(check.verdict == CapacityCheck::Verdict::Inconclusive);
+    QCOMPARE(check.realBytes, uint64_t(0));
+}
+
+void TestCapacityProbe::blankStartIsInconclusive()
+{
+    const CapacityCheck check = CapacityProbe::run(32 * kGiB, [](uint64_t, char* buffer, size_t length) {
+        std::memset(buffer, 0, length);
+        return true;
+    });
+    QVERIFY(check.verdict == CapacityCheck::Verdict::Inconclusive);
+    QVERIFY(check.detail.contains(QStringLiteral("blank")));
+}
+
+void TestCapacityProbe::checkRoundTrips()
+{
+    CapacityCheck c;
+    c.verdict = CapacityCheck::Verdict::Aliased;
+    c.claimedBytes = 256 * kGiB;
+    c.realBytes = 8 * kGiB;
+    c.bytesRead = 60 * kMiB;
+    c.durationMs = 2400;
+    c.detail = QStringLiteral("The start of the device reappears at 8.00 GiB");
+    c.probedAt = QDateTime(QDate(2026, 5, 1), QTime(12, 0), QTimeZone::utc());
+
+    DeviceRecord record;
+    record.uniqueId = QStringLiteral("usb-1");
+    record.capacityCheck = c;
+    const DeviceRecord back = DeviceRecord::fromJson(record.toJson());
+    QVERIFY(back.capacityCheck.verdict == CapacityCheck::Verdict::Aliased);
+    QCOMPARE(back.capacityCheck.claimedBytes, c.claimedBytes);
+    QCOMPARE(back.capacityCheck.realBytes, c.realBytes);
+    QCOMPARE(back.capacityCheck.bytesRead, c.bytesRead);
+    QCOMPARE(back.capacityCheck.durationMs, c.durationMs);
+    QCOMPARE(back.capacityCheck.detail, c.detail);
+    QCOMPARE(back.capacityCheck.probedAt, c.probedAt);
+
+    QVERIFY(!DeviceRecord().toJson().contains(QStringLiteral("capacity_check")));
+    QVERIFY(DeviceRecord::fromJson(DeviceRecord().toJson()).capacityCheck.isEmpty());
+}
+
+QTEST_MAIN(TestCapacityProbe)
+#include "test_capacity_probe.moc"
@@ -0,0 +1,141 @@
+#include <QtTest>
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "CaptureRetention.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+QString writeCapture(const QString& dir, const QString& name, const QByteArray& data,
+                     const QDateTime& modifiedUtc)
+{
+    const QString path = QDir(dir).filePath(name);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        return {};
+    }
+    file.setFileTime(modifiedUtc, QFileDevice::FileModificationTime);
+    return path;
+}
+
+} // namespace
+
+class TestCaptureRetention : public QObject {
+    Q_OBJECT
+
+private slots:
+    void foldsRepeatedCaptures();
+    void compressesInPlace();
+    void enforcesAgeAndQuota();
+};
+
+void TestCaptureRetention::foldsRepeatedCaptures()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    CaptureRetention::Policy policy;
+    policy.compress = false;
+    const QByteArray digest(32, '\x5a');
+
+    const QString first = writeCapture(dir.path(), QStringLiteral("first.pcapng"), QByteArray(4096, 'a'), now);
+    const CaptureRetention::ArchiveResult kept = CaptureRetention::archive(dir.path(), first, digest, policy, now);
+    QVERIFY2(kept.error.isEmpty(), qPrintable(kept.error));
+    QCOMPARE(kept.path, first);
+    QVERIFY(kept.duplicateOf.isEmpty());
+
+    for (const QString& name : {QStringLiteral("second.pcapng"), QStringLiteral("third.pcapng")}) {
+        const QString path = writeCapture(dir.path(), name, QByteArray(4096, 'a'), now);
+        const CaptureRetention::ArchiveResult repeat = CaptureRetention::archive(dir.path(), path, digest, policy, now);
+        QVERIFY(repeat.path.isEmpty());
+        QCOMPARE(repeat.duplicateOf, first);
+        QVERIFY(!QFile::exists(path));
+    }
+
+    // Different content is kept, and so is everything without a digest.
+    const QString other = writeCapture(dir.path(), QStringLiteral("other.pcapng"), QByteArray(10, 'b'), now);
+    QCOMPARE(CaptureRetention::archive(dir.path(), other, QByteArray(32, '\x01'), policy, now).path, other);
+    const QString empty = writeCapture(dir.path(), QStringLiteral("empty.pcapng"), QByteArray(), now);
+    QCOMPARE(CaptureRetention::archive(dir.path(), empty, QByteArray(), policy, now).path, empty);
+
+    const CaptureRetention::Usage usage = CaptureRetention::usage(dir.path());
+    QCOMPARE(usage.captures, 3);
+    QCOMPARE(usage.bytes, qint64(4106));
+    QCOMPARE(usage.recurrences, 2);
+    QVERIFY(usage.text().contains(QStringLiteral("2 repeats folded")));
+}
+
+void TestCaptureRetention::compressesInPlace()
+{
+    if (CaptureRetention::compressedSuffix().isEmpty()) {
+        QSKIP("Built without zstd or zlib");
+    }
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    const QDateTime modified = now.addSecs(-60);
+    QByteArray data;
+    for (int i = 0; i < 20000; ++i) {
+        data.append(QByteArray::number(i % 97));
+    }
+    const QString path = writeCapture(dir.path(), QStringLiteral("capture.pcap"), data, modified);
+
+    const CaptureRetention::ArchiveResult result =
+        CaptureRetention::archive(dir.path(), path, QByteArray(32, '\x07'), CaptureRetention::Policy(), now);
+    QVERIFY2(result.error.isEmpty(), qPrintable(result.error));
+    QVERIFY(result.compressed);
+    QCOMPARE(result.path, path + CaptureRetention::compressedSuffix());
+    QVERIFY(!QFile::exists(path));
+
+    QFile compressed(result.path);
+    QVERIFY(compressed.open(QIODevice::ReadOnly));
+    const QByteArray head = compressed.read(4);
+    if (CaptureRetention::compressedSuffix() == QLatin1String(".zst")) {
+        QCOMPARE(head, QByteArray("\x28\xb5\x2f\xfd", 4));
+    } else {
+        QCOMPARE(head.left(2), QByteArray("\x1f\x8b", 2));
+    }
+    QVERIFY(compressed.size() < data.size());
+    QCOMPARE(QFileInfo(result.path).lastModified().toUTC().toSecsSinceEpoch(), modified.toSecsSinceEpoch());
+    QCOMPARE(CaptureRetention::usage(dir.path()).compressed, 1);
+}
+
+void TestCaptureRetention::enforcesAgeAndQuota()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    const QByteArray kib(1024, 'x');
+    const QString expired = writeCapture(dir.path(), QStringLiteral("a.pcapng"), kib, now.addDays(-40));
+    const QString oldest = writeCapture(dir.path(), QStringLiteral("b.pcapng.zst"), kib, now.addDays(-3));
+    const QString older = writeCapture(dir.path(), QStringLiteral("c.pcap"), kib, now.addDays(-2));
+    const QString newer = writeCapture(dir.path(), QStringLiteral("d.pcapng"), kib, now.addDays(-1));
+    const QString active = writeCapture(dir.path(), QStringLiteral("e.pcapng"), kib, now.addSecs(-10));
+    const QString unrelated = writeCapture(dir.path(), QStringLiteral("notes.txt"), kib, now.addDays(-90));
+
+    CaptureRetention::Policy policy;
+    policy.quotaBytes = 0;
+    QCOMPARE(CaptureRetention::enforce(dir.path(), policy, now), 1);
+    QVERIFY(!QFile::exists(expired));
+
+    // Over the quota the oldest go first, but never the capture still being written.
+    policy.quotaBytes = 2048;
+    QCOMPARE(CaptureRetention::enforce(dir.path(), policy, now), 2);
+    QVERIFY(!QFile::exists(oldest));
+    QVERIFY(!QFile::exists(older));
+    QVERIFY(QFile::exists(newer));
+    QVERIFY(QFile::exists(active));
+    QVERIFY(QFile::exists(unrelated));
+
+    policy.quotaBytes = 1;
+    QCOMPARE(CaptureRetention::enforce(dir.path(), policy, now), 1);
+    QVERIFY(QFile::exists(active));
+    QCOMPARE(CaptureRetention::usage(dir.path()).captures, 1);
+}
+
+QTEST_MAIN(TestCaptureRetention)
+#include "test_capture_retention.moc"
@@ -0,0 +1,109 @@
+#include <QtTest>
+#include "CloneVerify.h"
+#include "RawDeviceHashAdvanced.h"
+
+#include <QTemporaryFile>
+
+using namespace FlashSpartan;
+
+class TestCloneVerify : public QObject {
+    Q_OBJECT
+private slots:
+    void masterFileGivesBlockDigests();
+    void judgesMatchMismatchAndError();
+    void streamedBlocksMatchChunkedRead();
+    void placementFromSysPath();
+};
+
+void TestCloneVerify::masterFileGivesBlockDigests()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    const qint64 size = 2 * static_cast<qint64>(RawDeviceHash::kDefaultChunkBytes) + 4096;
+    QVERIFY(file.resize(size));
+    QVERIFY(file.seek(100));
+    QVERIFY(file.write("master") == 6);
+    QVERIFY(file.flush());
+
+    std::atomic<uint64_t> bytes{0};
+    uint64_t length = 0;
+    const HashResult master =
+        CloneVerify::hashMaster(file.fileName(), RawDeviceHash::Algorithm::SHA256, nullptr, &bytes, &length);
+    QVERIFY2(master.success, qPrintable(master.errorMessage));
+    QCOMPARE(length, static_cast<uint64_t>(size));
+    QCOMPARE(master.blockHashes.size(), 3);
+    QCOMPARE(master.hash, RawDeviceHash::combineBlockHashes(master.blockHashes, RawDeviceHash::Algorithm::SHA256));
+    QCOMPARE(master.bytesProcessed, static_cast<uint64_t>(size));
+}
+
+void TestCloneVerify::judgesMatchMismatchAndError()
+{
+    HashResult master;
+    master.success = true;
+    master.blockHashes = {QStringLiteral("aa"), QStringLiteral("bb"), QStringLiteral("cc")};
+    master.hash = QStringLiteral("root");
+
+    HashResult same = master;
+    QCOMPARE(CloneVerify::judgeClone(master, same).verdict, CloneVerify::Verdict::Match);
+
+    HashResult stopped;
+    stopped.success = true;
+    stopped.stoppedAtBlock = 1;
+    stopped.blockHashes = {QStringLiteral("aa"), QStringLiteral("bx")};
+    const CloneVerify::CloneVerdict early = CloneVerify::judgeClone(master, stopped);
+    QCOMPARE(early.verdict, CloneVerify::Verdict::Mismatch);
+    QCOMPARE(early.firstBadBlock, qint64(1));
+
+    HashResult differs = master;
+    differs.hash = QStringLiteral("other");
+    differs.blockHashes[2] = QStringLiteral("cx");
+    QCOMPARE(CloneVerify::judgeClone(master, differs).firstBadBlock, qint64(2));
+
+    HashResult failed;
+    failed.errorMessage = QStringLiteral("gone");
+    QCOMPARE(CloneVerify::judgeClone(master, failed).verdict, CloneVerify::Verdict::Error);
+}
+
+void TestCloneVerify::streamedBlocksMatchChunkedRead()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    const qint64 size = static_cast<qint64>(RawDeviceHash::kDefaultChunkBytes) + 12345;
+    QVERIFY(file.resize(size));
+    QVERIFY(file.seek(size - 10));
+    QVERIFY(file.write("tail") == 4);
+    QVERIFY(file.flush());
+
+    RawDeviceHash::Options options;
+    options.deviceNode = file.fileName();
+    const HashResult read = RawDeviceHash::hashAdvanced(file.handle(), options, static_cast<uint64_t>(size));
+    QVERIFY(read.success);
+
+    // Odd buffer sizes, so block boundaries fall inside a buffer.
+    RawDeviceHash::BlockStreamHasher streamed(options.algorithm);
+    QVERIFY(file.seek(0));
+    while (!file.atEnd()) {
+        const QByteArray chunk = file.read(3 * 1024 * 1024 + 7);
+        QVERIFY(streamed.update(chunk.constData(), static_cast<size_t>(chunk.size())));
+    }
+    QVERIFY(streamed.finish());
+    QCOMPARE(streamed.bytes(), static_cast<uint64_t>(size));
+    QCOMPARE(streamed.blockHashes(), read.blockHashes);
+    QCOMPARE(streamed.hash(), read.hash);
+}
+
+void TestCloneVerify::placementFromSysPath()
+{
+    const CloneVerify::UsbPlacement hub = CloneVerify::usbPlacementFromSysPath(QStringLiteral(
+        "/sys/devices/pci0000:00/0000:00:14.0/usb3/3-1/3-1.4/3-1.4:1.0/host6/target6:0:0/6:0:0:0/block/sdc"));
+    QCOMPARE(hub.controller, QStringLiteral("usb3"));
+    QCOMPARE(hub.rootPort, QStringLiteral("3-1"));
+
+    const CloneVerify::UsbPlacement sata = CloneVerify::usbPlacementFromSysPath(
+        QStringLiteral("/sys/devices/pci0000:00/0000:00:17.0/ata1/host0/target0:0:0/0:0:0:0/block/sda"));
+    QVERIFY(sata.controller.isEmpty());
+    QVERIFY(sata.rootPort.isEmpty());
+}
+
+QTEST_MAIN(TestCloneVerify)
+#include "test_clone_verify.moc"
@@ -0,0 +1,102 @@
+#include <QtTest>
+#include <QRandomGenerator>
+
+#include <vector>
+
+#include "ContentChunker.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+QByteArray randomBytes(qsizetype size, quint32 seed)
+{
+    QRandomGenerator rng(seed);
+    QByteArray data(size, Qt::Uninitialized);
+    rng.fillRange(reinterpret_cast<quint32*>(data.data()), size / 4);
+    return data;
+}
+
+/** End offsets of every chunk, feeding @p data in @p step-byte pieces. */
+std::vector<qsizetype> boundaries(const QByteArray& data, qsizetype step)
+{
+    ContentChunker chunker;
+    std::vector<qsizetype> out;
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data.constData());
+    qsizetype offset = 0;
+    while (offset < data.size()) {
+        const qsizetype piece = std::min(step, data.size() - offset);
+        qsizetype used = 0;
+        while (used < piece) {
+            bool boundary = false;
+            used += static_cast<qsizetype>(
+                chunker.scan(bytes + offset + used, static_cast<size_t>(piece - used), &boundary));
+            if (boundary) {
+                out.push_back(offset + used);
+            }
+        }
+        offset += piece;
+    }
+    return out;
+}
+
+} // namespace
+
+class TestContentChunker : public QObject {
+    Q_OBJECT
+
+private slots:
+    void boundariesIndependentOfBufferSize();
+    void chunkSizesWithinBounds();
+    void insertionOnlyMovesNearbyBoundaries();
+};
+
+void TestContentChunker::boundariesIndependentOfBufferSize()
+{
+    const QByteArray data = randomBytes(24 * 1024 * 1024, 1);
+    const std::vector<qsizetype> whole = boundaries(data, data.size());
+    QVERIFY(whole.size() > 4);
+    QCOMPARE(boundaries(data, 1024 * 1024), whole);
+    QCOMPARE(boundaries(data, 12345), whole);
+}
+
+void TestContentChunker::chunkSizesWithinBounds()
+{
+    const ContentChunker::Params params;
+    const QByteArray data = randomBytes(32 * 1024 * 1024, 2);
+    qsizetype previous = 0;
+    for (const qsizetype end : boundaries(data, 4 * 1024 * 1024)) {
+        QVERIFY(end - previous >= qsizetype(params.minSize));
+        QVERIFY(end - previous <= qsizetype(params.maxSize));
+        previous = end;
+    }
+
+    // Data without entropy still cuts at the maximum size.
+    const QByteArray zeros(10 * 1024 * 1024, '\0');
+    const std::vector<qsizetype> cuts = boundaries(zeros, zeros.size());
+    QVERIFY(!cuts.empty());
+    QVERIFY(cuts.front() <= qsizetype(params.maxSize));
+}
+
+void TestContentChunker::insertionOnlyMovesNearbyBoundaries()
+{
+    const QByteArray data = randomBytes(24 * 1024 * 1024, 3);
+    QByteArray edited = data;
+    const qsizetype at = 10 * 1024 * 1024;
+    edited.insert(at, QByteArray(100, 'x'));
+
+    const std::vector<qsizetype> before = boundaries(data, data.size());
+    const std::vector<qsizetype> after = boundaries(edited, edited.size());
+    qsizetype kept = 0;
+    for (const qsizetype b : before) {
+        const qsizetype expected = b < at ? b : b + 100;
+        if (std::find(after.begin(), after.end(), expected) != after.end()) {
+            ++kept;
+        }
+    }
+    // At most the chunk holding the insertion (and the one after it) may change.
+    QVERIFY(kept >= qsizetype(before.size()) - 2);
+}
+
+QTEST_MAIN(TestContentChunker)
+#include "test_content_chunker.moc"
@@ -1,11 +1,33 @@
 #include <QtTest>
 #include <QTemporaryDir>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QProcessEnvironment>
+#include <QTimeZone>
 
+#include <thread>
+#include <vector>
+
+#include "AuditLogIndex.h"
+#include "AuditWriter.h"
+#include "BlockHashFile.h"
 #include "DatabaseManager.h"
+#include "policy/PolicyBlobCodec.h"
+#include "policy/PolicyBlobView.h"
+#include "policy/PolicyAudit.h"
 #include "policy/PolicyGateway.h"
+#include "policy/PolicyJsonStream.h"
+#include "policy/PolicyPaths.h"
+#include "policy/PolicyProtocol.h"
 #include "policy/PolicyServiceLocator.h"
+#include "policy/PolicyStoreEngine.h"
+#include "StoreCompression.h"
 
 using namespace FlashSpartan;
 
@@ -28,7 +50,26 @@ private slots:
     void verifyHashUsesLegacyId();
     void getDeviceReturnsLegacyRecord();
     void updateLastSeenOnLegacyId();
+    void lastSeenFlushedInOneCommit();
+    void recordGenerationIgnoresLastSeen();
+    void prescreenHashClearedWhenBaselineChanges();
+    void tunedBufferSizeSharedByModel();
+    void blockHashesFollowBaseline();
+    void identicalBlockListsShareOneFile();
     void importMergeAndReplace();
+    void watchManifestStoredOutOfLine();
+    void policyChangesSinceGeneration();
+    void pushedChangesReachOtherManagers();
+    void bulkPolicyEdits();
+    void policyLogReplayedOnLoad();
+    void groupCommitPersistsBurst();
+    void indexedStoreSharesSnapshots();
+    void policyBlobReadInPlace();
+    void policyBlobCompressesRecords();
+    void integrityChecksRunInBackground();
+    void policyJsonStreamed();
+    void auditAppendsBatched();
+    void auditLogIndexedAndChained();
 };
 
 void TestDatabaseManager::partitionAwareLookupAndMigration()
@@ -148,6 +189,225 @@ void TestDatabaseManager::updateLastSeenOnLegacyId()
     QVERIFY(record->lastSeen >= before);
 }
 
+void TestDatabaseManager::lastSeenFlushedInOneCommit()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+    DatabaseManager db;
+    QVERIFY(db.initialize());
+    Policy::PolicyGateway* gate = Policy::PolicyServiceLocator::gateway();
+
+    const QDateTime old = QDateTime::currentDateTimeUtc().addDays(-1);
+    for (const char* id : {"device_a/sda1", "device_b/sdb1"}) {
+        DeviceRecord rec;
+        rec.uniqueId = QString::fromLatin1(id);
+        rec.hash = "hash";
+        rec.firstSeen = old;
+        rec.lastSeen = old;
+        QVERIFY(db.addDevice(rec));
+    }
+    const Policy::PolicyDelta base = gate->changesSince(0, 0);
+
+    // Visible at once, but nothing is committed yet
+    QVERIFY(db.updateLastSeen("device_a/sda1"));
+    QVERIFY(db.updateLastSeen("device_b/sdb1"));
+    QCOMPARE(db.pendingVolatileCount(), 2);
+    QVERIFY(db.getDevice("device_a/sda1")->lastSeen > old);
+    QVERIFY(gate->changesSince(base.epoch, base.generation).devices.isEmpty());
+
+    // A full resync from the store keeps the pending times
+    QVERIFY(db.reload());
+    QVERIFY(db.getDevice("device_b/sdb1")->lastSeen > old);
+
+    const Policy::PolicyDelta beforeFlush = gate->changesSince(0, 0);
+    QVERIFY(db.flushVolatileFields());
+    QCOMPARE(db.pendingVolatileCount(), 0);
+    const Policy::PolicyDelta flushed = gate->changesSince(beforeFlush.epoch, beforeFlush.generation);
+    QCOMPARE(flushed.devices.size(), 2);
+    for (const DeviceRecord& rec : flushed.devices) {
+        QVERIFY(rec.lastSeen > old);
+    }
+}
+
+void TestDatabaseManager::recordGenerationIgnoresLastSeen()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+    DatabaseManager db;
+    QVERIFY(db.initialize());
+
+    DeviceRecord rec;
+    rec.uniqueId = QStringLiteral("device_g/sdg1");
+    rec.firstSeen = QDateTime::currentDateTimeUtc();
+    rec.lastSeen = rec.firstSeen;
+    quint64 generation = db.recordGeneration();
+    QVERIFY(db.addDevice(rec));
+    QVERIFY(db.recordGeneration() > generation);
+
+    generation = db.recordGeneration();
+    QVERIFY(db.updateLastSeen(rec.uniqueId));
+    QCOMPARE(db.recordGeneration(), generation);
+
+    QVERIFY(db.setTrustLevel(rec.uniqueId, 2));
+    QVERIFY(db.recordGeneration() > generation);
+    generation = db.recordGeneration();
+    QVERIFY(db.removeDevice(rec.uniqueId));
+    QVERIFY(db.recordGeneration() > generation);
+}
+
+void TestDatabaseManager::prescreenHashClearedWhenBaselineChanges()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+
+    DatabaseManager db;
+    QVERIFY(db.initialize());
+
+    DeviceInfo info;
+    info.serial = "SER005";
+    info.vendor = "Vendor";
+    info.model = "Model";
+    info.deviceNode = "/dev/sdg1";
+
+    DeviceRecord record;
+    record.uniqueId = info.partitionUniqueId();
+    record.hash = "aaaa";
+    record.hashAlgorithm = "SHA256";
+    record.firstSeen = QDateTime::currentDateTimeUtc();
+    record.lastSeen = record.firstSeen;
+    QVERIFY(db.addDevice(record));
+
+    QVERIFY(db.updatePrescreenHash(record.uniqueId, "0011", "XXH3-128"));
+    QCOMPARE(db.getDevice(record.uniqueId)->prescreenHash, QString("0011"));
+
+    // Same baseline re-stored: pre-screen still describes it.
+    QVERIFY(db.updateHash(record.uniqueId, "aaaa", "SHA256"));
+    QCOMPARE(db.getDevice(record.uniqueId)->prescreenHash, QString("0011"));
+
+    QVERIFY(db.updateHash(record.uniqueId, "bbbb", "SHA256"));
+    const auto updated = db.getDevice(record.uniqueId);
+    QVERIFY(updated.has_value());
+    QVERIFY(updated->prescreenHash.isEmpty());
+    QVERIFY(updated->prescreenAlgorithm.isEmpty());
+}
+
+void TestDatabaseManager::blockHashesFollowBaseline()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+
+    DatabaseManager db;
+    QVERIFY(db.initialize());
+
+    DeviceInfo info;
+    info.serial = "SER007";
+    info.vendor = "Vendor";
+    info.model = "Model";
+    info.deviceNode = "/dev/sdh1";
+
+    DeviceRecord record;
+    record.uniqueId = info.partitionUniqueId();
+    record.hash = "aaaa";
+    record.hashAlgorithm = "SHA256";
+    record.firstSeen = QDateTime::currentDateTimeUtc();
+    record.lastSeen = record.firstSeen;
+    QVERIFY(db.addDevice(record));
+
+    const QStringList blocks{"01", "02", "03"};
+    QVERIFY(db.updateBlockHashes(record.uniqueId, blocks, 64ULL * 1024 * 1024));
+    auto stored = db.getDevice(record.uniqueId);
+    QVERIFY(stored.has_value());
+    QVERIFY(stored->blockHashes.isEmpty());
+    QVERIFY(!stored->blockHashesSha256.isEmpty());
+    uint64_t blockSize = 0;
+    QCOMPARE(DatabaseManager::blockHashesFor(*stored, &blockSize), blocks);
+    QCOMPARE(blockSize, 64ULL * 1024 * 1024);
+
+    QVERIFY(db.updateHash(record.uniqueId, "bbbb", "SHA256"));
+    stored = db.getDevice(record.uniqueId);
+    QVERIFY(stored.has_value());
+    QVERIFY(stored->blockHashesSha256.isEmpty());
+    QVERIFY(DatabaseManager::blockHashesFor(*stored).isEmpty());
+    QCOMPARE(stored->blockSize, uint64_t(0));
+}
+
+void TestDatabaseManager::identicalBlockListsShareOneFile()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+    BlockHashFile::clearCache();
+
+    DatabaseManager db;
+    QVERIFY(db.initialize());
+
+    QStringList blocks;
+    for (int i = 0; i < 64; ++i) {
+        blocks.append(QString::fromLatin1(
+            QCryptographicHash::hash(QByteArray::number(i), QCryptographicHash::Sha256).toHex()));
+    }
+    QStringList ids;
+    for (int i = 0; i < 3; ++i) {
+        DeviceRecord record;
+        record.uniqueId = QStringLiteral("golden-%1").arg(i);
+        record.hash = "aaaa";
+        record.hashAlgorithm = "SHA256";
+        record.firstSeen = QDateTime::currentDateTimeUtc();
+        record.lastSeen = record.firstSeen;
+        QVERIFY(db.addDevice(record));
+        QVERIFY(db.updateBlockHashes(record.uniqueId, blocks, 64ULL * 1024 * 1024));
+        ids.append(record.uniqueId);
+    }
+
+    const QString digest = db.getDevice(ids.first())->blockHashesSha256;
+    QCOMPARE(db.getDevice(ids.last())->blockHashesSha256, digest);
+    const QDir dir(DatabaseManager::watchManifestDirectory());
+    QCOMPARE(dir.entryList({QStringLiteral("*.fsbh")}, QDir::Files),
+             QStringList{digest + QStringLiteral(".fsbh")});
+    for (const QString& id : ids) {
+        QCOMPARE(DatabaseManager::blockHashesFor(*db.getDevice(id)), blocks);
+    }
+
+    // The file stays until the last record referring to it changes baseline.
+    QVERIFY(db.updateHash(ids.at(0), "bbbb", "SHA256"));
+    QVERIFY(db.updateHash(ids.at(1), "bbbb", "SHA256"));
+    QVERIFY(QFileInfo::exists(BlockHashFile::pathFor(dir.path(), digest)));
+    QVERIFY(db.updateHash(ids.at(2), "bbbb", "SHA256"));
+    QVERIFY(!QFileInfo::exists(BlockHashFile::pathFor(dir.path(), digest)));
+}
+
+void TestDatabaseManager::tunedBufferSizeSharedByModel()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+
+    DatabaseManager db;
+    QVERIFY(db.initialize());
+
+    DeviceInfo info;
+    info.serial = "SER006";
+    info.vendor = "Kingston";
+    info.model = "DataTraveler";
+    info.deviceNode = "/dev/sdh1";
+
+    DeviceRecord record;
+    record.uniqueId = info.partitionUniqueId();
+    record.firstSeen = QDateTime::currentDateTimeUtc();
+    record.lastSeen = record.firstSeen;
+    record.lastKnownInfo = info;
+    QVERIFY(db.addDevice(record));
+
+    QCOMPARE(db.tunedBufferSizeForModel("Kingston", "DataTraveler"), 0);
+    QVERIFY(db.updateTunedBufferSize(record.uniqueId, 4096));
+    QCOMPARE(db.tunedBufferSizeForModel("Kingston", "DataTraveler"), 4096);
+    QCOMPARE(db.tunedBufferSizeForModel("Kingston", "Other"), 0);
+}
+
 void TestDatabaseManager::importMergeAndReplace()
 {
     QTemporaryDir tempDir;
@@ -189,5 +449,577 @@ void TestDatabaseManager::importMergeAndReplace()
     QVERIFY(db.hasDevice("device_b/sdb1"));
 }
 
+void TestDatabaseManager::watchManifestStoredOutOfLine()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+
+    DatabaseManager db;
+    QVERIFY(db.initialize());
+
+    DeviceRecord record;
+    record.uniqueId = "SER010_Vendor_Model_sdk1";
+    record.hash = "aaaa";
+    record.hashAlgorithm = "SHA256";
+    record.firstSeen = QDateTime::currentDateTimeUtc();
+    record.lastSeen = record.firstSeen;
+    QVERIFY(db.addDevice(record));
+
+    WatchFileEntry file;
+    file.relativePath = "docs/a.txt";
+    file.contentHash = QString(64, QLatin1Char('a'));
+    WatchGroup group;
+    group.id = "g1";
+    group.name = "Docs";
+    group.watchPaths = {"docs"};
+    group.merkleRoot = QString(64, QLatin1Char('b'));
+    group.files = {file};
+    WatchManifest manifest;
+    manifest.groups = {group};
+    manifest.manifestRoot = QString(64, QLatin1Char('c'));
+    QVERIFY(db.updateWatchManifest(record.uniqueId, manifest));
+
+    auto stored = db.getDevice(record.uniqueId);
+    QVERIFY(stored.has_value());
+    QVERIFY(stored->watchManifest.hasBaseline());
+    QVERIFY(!stored->watchManifest.filesSha256.isEmpty());
+    QVERIFY(stored->watchManifest.groups.first().files.isEmpty());
+
+    const std::optional<WatchManifest> loaded = db.watchManifestFor(*stored);
+    QVERIFY(loaded.has_value());
+    QCOMPARE(loaded->groups.first().files.size(), 1);
+    QCOMPARE(loaded->groups.first().files.first().relativePath, file.relativePath);
+    const std::optional<WatchManifest> byId = db.watchManifest(record.uniqueId);
+    QVERIFY(byId.has_value());
+    QCOMPARE(byId->groups.first().files.size(), 1);
+    QVERIFY(!db.watchManifest("missing").has_value());
+
+    const QList<DatabaseManager::DeviceSummary> summaries = db.getDeviceSummaries();
+    QCOMPARE(summaries.size(), 1);
+    QCOMPARE(summaries.first().uniqueId, record.uniqueId);
+    QVERIFY(summaries.first().hasHash);
+
+    // The record pins the file by digest; an edited file no longer loads.
+    const QString path = DatabaseManager::watchManifestDirectory() + "/"
+                         + stored->watchManifest.filesSha256 + ".fsmf";
+    QFile blob(path);
+    QVERIFY(blob.setPermissions(QFile::ReadOwner | QFile::WriteOwner));
+    QVERIFY(blob.open(QIODevice::ReadWrite));
+    blob.seek(blob.size() - 1);
+    QVERIFY(blob.putChar('x'));
+    blob.close();
+    QVERIFY(!db.watchManifestFor(*stored).has_value());
+
+    QVERIFY(db.removeDevice(record.uniqueId));
+    QVERIFY(!QFile::exists(path));
+}
+
+void TestDatabaseManager::policyChangesSinceGeneration()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+    Policy::PolicyGateway* gate = Policy::PolicyServiceLocator::gateway();
+    QVERIFY(gate->load());
+
+    const Policy::PolicyDelta base = gate->changesSince(0, 0);
+    QVERIFY(base.full);
+    QVERIFY(base.epoch != 0);
+
+    DeviceRecord a;
+    a.uniqueId = "device_a/sda1";
+    a.hash = "hash_a";
+    DeviceRecord b = a;
+    b.uniqueId = "device_b/sdb1";
+    QVERIFY(gate->upsertDevice(a, "test", "add"));
+    QVERIFY(gate->upsertDevice(b, "test", "add"));
+
+    const Policy::PolicyDelta added = gate->changesSince(base.epoch, base.generation);
+    QVERIFY(!added.full);
+    QCOMPARE(added.epoch, base.epoch);
+    QCOMPARE(added.generation, base.generation + 2);
+    QCOMPARE(added.devices.size(), 2);
+    QVERIFY(!added.blocksChanged);
+
+    QVERIFY(gate->removeDevice(a.uniqueId, "test", "remove"));
+    QVERIFY(gate->blockDrive("key", b.uniqueId, "label", "test"));
+    const Policy::PolicyDelta later = gate->changesSince(added.epoch, added.generation);
+    QVERIFY(!later.full);
+    QVERIFY(later.devices.isEmpty());
+    QCOMPARE(later.removedIds, QStringList{a.uniqueId});
+    QVERIFY(later.blocksChanged);
+    QCOMPARE(later.blocks.size(), 1);
+
+    const Policy::PolicyDelta idle = gate->changesSince(later.epoch, later.generation);
+    QVERIFY(!idle.full);
+    QVERIFY(idle.devices.isEmpty() && idle.removedIds.isEmpty() && !idle.blocksChanged);
+
+    QVERIFY(gate->reload());
+    QVERIFY(gate->changesSince(later.epoch, later.generation).full);
+
+    Policy::PolicyProtocol::Reply reply;
+    reply.ok = true;
+    reply.hasDelta = true;
+    reply.delta = added;
+    QByteArray wire = Policy::PolicyProtocol::encodeFrame(Policy::PolicyProtocol::FrameType::Reply,
+                                                          Policy::PolicyProtocol::encodeReply(reply));
+    QByteArray partial = wire.left(wire.size() - 1);
+    Policy::PolicyProtocol::Frame frame;
+    QVERIFY(!Policy::PolicyProtocol::takeFrame(partial, &frame));
+    QVERIFY(Policy::PolicyProtocol::takeFrame(wire, &frame));
+    QVERIFY(wire.isEmpty());
+    Policy::PolicyProtocol::Reply decoded;
+    QVERIFY(Policy::PolicyProtocol::decodeReply(frame.payload, &decoded));
+    QCOMPARE(decoded.delta.generation, added.generation);
+    QCOMPARE(decoded.delta.devices.size(), 2);
+    QCOMPARE(decoded.delta.devices.at(0).hash, QStringLiteral("hash_a"));
+}
+
+void TestDatabaseManager::pushedChangesReachOtherManagers()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+
+    DatabaseManager writer;
+    QVERIFY(writer.initialize());
+    DatabaseManager reader;
+    QVERIFY(reader.initialize());
+    QSignalSpy writerAdded(&writer, &DatabaseManager::deviceAdded);
+    QSignalSpy readerAdded(&reader, &DatabaseManager::deviceAdded);
+    QSignalSpy readerRemoved(&reader, &DatabaseManager::deviceRemoved);
+
+    DeviceRecord rec;
+    rec.uniqueId = "device_a/sda1";
+    rec.hash = "hash_a";
+    QVERIFY(writer.addDevice(rec));
+    QTRY_COMPARE(readerAdded.count(), 1);
+    QVERIFY(reader.hasDevice(rec.uniqueId));
+    QCOMPARE(writerAdded.count(), 1);  // its own write, not echoed by the push
+
+    QVERIFY(writer.removeDevice(rec.uniqueId));
+    QTRY_COMPARE(readerRemoved.count(), 1);
+    QVERIFY(!reader.hasDevice(rec.uniqueId));
+}
+
+void TestDatabaseManager::bulkPolicyEdits()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+    DatabaseManager db;
+    QVERIFY(db.initialize());
+    Policy::PolicyGateway* gate = Policy::PolicyServiceLocator::gateway();
+
+    QList<DeviceRecord> records;
+    for (const char* id : {"device_a/sda1", "device_b/sdb1", "device_c/sdc1"}) {
+        DeviceRecord rec;
+        rec.uniqueId = QString::fromLatin1(id);
+        rec.hash = "hash";
+        records.append(rec);
+    }
+    const Policy::PolicyDelta before = gate->changesSince(0, 0);
+    QVERIFY(gate->upsertDevices(records, "test", "bulk"));
+    QCOMPARE(gate->changesSince(before.epoch, before.generation).devices.size(), 3);
+
+    QCOMPARE(db.removeDevices({"device_a/sda1", "device_c/sdc1", "missing"}), 2);
+    QCOMPARE(db.deviceCount(), 1);
+    QVERIFY(db.hasDevice("device_b/sdb1"));
+    QCOMPARE(gate->removeDevices({"missing"}, "test", "bulk"), 0);
+
+    Policy::PolicyProtocol::Request req;
+    req.id = 7;
+    req.records = records;
+    req.uniqueIds = {"device_a/sda1"};
+    Policy::PolicyProtocol::Request decoded;
+    QVERIFY(Policy::PolicyProtocol::decodeRequest(Policy::PolicyProtocol::encodeRequest(req), &decoded));
+    QCOMPARE(decoded.id, quint32(7));
+    QCOMPARE(decoded.records.size(), 3);
+    QCOMPARE(decoded.uniqueIds, req.uniqueIds);
+}
+
+void TestDatabaseManager::policyLogReplayedOnLoad()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+    const QString store = tempDir.filePath("policy.store");
+    const QString wal = store + ".wal";
+
+    Policy::PolicyStoreEngine writer(store);
+    QVERIFY(writer.load());
+    const qint64 blobSize = QFileInfo(store).size();
+    const qint64 walHeader = QFileInfo(wal).size();
+    DeviceRecord rec;
+    rec.uniqueId = "device_a/sda1";
+    rec.hash = "hash_a";
+    QVERIFY(writer.upsertDevice(rec, "test", "add"));
+    QVERIFY(writer.blockDrive("key", rec.uniqueId, "label", "test"));
+    QCOMPARE(QFileInfo(store).size(), blobSize);  // logged, not re-encoded
+    QVERIFY(QFileInfo(wal).size() > walHeader);
+
+    // A crash mid-append leaves a torn entry; everything before it still counts.
+    QFile tail(wal);
+    QVERIFY(tail.open(QIODevice::WriteOnly | QIODevice::Append));
+    tail.write(QByteArray("\x40\x00\x00\x00torn", 8));
+    tail.close();
+
+    Policy::PolicyStoreEngine reader(store);
+    QVERIFY(reader.load());
+    const Policy::PolicySnapshot snap = reader.snapshot();
+    QCOMPARE(snap.devices.size(), 1);
+    QCOMPARE(snap.devices.at(0).hash, QStringLiteral("hash_a"));
+    QCOMPARE(snap.blocks.size(), 1);
+    QCOMPARE(QFileInfo(wal).size(), walHeader);  // replayed entries were checkpointed
+
+    QVERIFY(reader.removeDevice(rec.uniqueId, "test", "remove"));
+    Policy::PolicyStoreEngine again(store);
+    QVERIFY(again.load());
+    QVERIFY(again.snapshot().devices.isEmpty());
+}
+
+void TestDatabaseManager::groupCommitPersistsBurst()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+    const QString store = tempDir.filePath("policy.store");
+
+    Policy::PolicyStoreEngine engine(store);
+    QVERIFY(engine.load());
+    engine.beginGroupCommit();
+    for (int i = 0; i < 10; ++i) {
+        DeviceRecord rec;
+        rec.uniqueId = QStringLiteral("hub_stick_%1/sd%1").arg(i);
+        rec.hash = "hash";
+        QVERIFY(engine.upsertDevice(rec, "test", "connect burst"));
+    }
+    QCOMPARE(engine.snapshot().devices.size(), 10);
+    QVERIFY(engine.commitGroup());
+    QVERIFY(engine.commitGroup());  // nothing left to sync
+
+    Policy::PolicyStoreEngine reader(store);
+    QVERIFY(reader.load());
+    QCOMPARE(reader.snapshot().devices.size(), 10);
+}
+
+void TestDatabaseManager::indexedStoreSharesSnapshots()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+
+    Policy::PolicyStoreEngine engine(tempDir.filePath("policy.store"));
+    QVERIFY(engine.load());
+    QList<DeviceRecord> records;
+    for (const char* id : {"device_a/sda1", "device_b/sdb1", "device_c/sdc1"}) {
+        DeviceRecord rec;
+        rec.uniqueId = QString::fromLatin1(id);
+        rec.hash = "old";
+        records.append(rec);
+    }
+    QVERIFY(engine.upsertDevices(records, "test", "add"));
+
+    const std::shared_ptr<const Policy::PolicySnapshot> before = engine.sharedSnapshot();
+    QCOMPARE(engine.sharedSnapshot().get(), before.get());  // no mutation, same copy
+
+    QVERIFY(engine.removeDevice("device_a/sda1", "test", "remove"));
+    records[2].hash = "new";
+    QVERIFY(engine.upsertDevice(records[2], "test", "update"));
+    const std::shared_ptr<const Policy::PolicySnapshot> after = engine.sharedSnapshot();
+    QVERIFY(after.get() != before.get());
+    QCOMPARE(before->devices.size(), 3);  // readers keep the copy they were given
+    QCOMPARE(after->devices.size(), 2);
+    for (const DeviceRecord& rec : after->devices) {
+        QCOMPARE(rec.hash, rec.uniqueId == "device_c/sdc1" ? QStringLiteral("new")
+                                                           : QStringLiteral("old"));
+    }
+    QCOMPARE(engine.removeDevices({"device_a/sda1", "device_b/sdb1"}, "test", "remove"), 1);
+}
+
+void TestDatabaseManager::policyBlobReadInPlace()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+    const QByteArray key(32, 'k');
+
+    Policy::PolicySnapshot snap;
+    for (const char* id : {"device_c/sdc1", "device_a/sda1", "device_b/sdb1"}) {
+        DeviceRecord rec;
+        rec.uniqueId = QString::fromLatin1(id);
+        rec.hash = "hash_" + rec.uniqueId.left(8);
+        snap.devices.append(rec);
+    }
+    BlockedDriveEntry block;
+    block.driveKey = "key";
+    block.label = "label";
+    snap.blocks.append(block);
+
+    QByteArray signature;
+    const QByteArray file = Policy::PolicyBlobCodec::encode(snap, key, &signature);
+    QCOMPARE(Policy::PolicyBlobCodec::versionOf(file), Policy::PolicyBlobCodec::kVersion);
+    QCOMPARE(Policy::PolicyBlobCodec::signatureOf(file), signature);
+    const QString path = tempDir.filePath("v2.store");
+    QFile out(path);
+    QVERIFY(out.open(QIODevice::WriteOnly));
+    out.write(file);
+    out.close();
+
+    QString err;
+    const std::unique_ptr<Policy::PolicyBlobView> view = Policy::PolicyBlobView::open(path, key, &err);
+    QVERIFY2(view, qPrintable(err));
+    QCOMPARE(view->deviceCount(), 3);
+    QCOMPARE(view->signature(), signature);
+    const std::optional<DeviceRecord> b = view->device("device_b/sdb1");
+    QVERIFY(b.has_value());
+    QCOMPARE(b->hash, QStringLiteral("hash_device_b"));
+    QVERIFY(!view->device("device_d/sdd1").has_value());
+    Policy::PolicySnapshot decoded;
+    QVERIFY(Policy::PolicyBlobCodec::decode(file, decoded, &err, key));
+    QCOMPARE(decoded.devices.size(), 3);
+    QCOMPARE(decoded.blocks.size(), 1);
+    QVERIFY(!Policy::PolicyBlobView::fromBytes(file, QByteArray(32, 'x')));
+
+    // A flipped byte in the block section passes open(), which checks only the index.
+    QByteArray tampered = file;
+    tampered[tampered.size() - 40] = char(tampered.at(tampered.size() - 40) ^ 0x20);
+    const std::unique_ptr<Policy::PolicyBlobView> bad = Policy::PolicyBlobView::fromBytes(tampered, key);
+    QVERIFY(!bad || !bad->read(decoded));
+
+    // Version 1 stores still load.
+    QByteArray payload;
+    QDataStream v1(&payload, QIODevice::WriteOnly);
+    v1.setByteOrder(QDataStream::LittleEndian);
+    const QByteArray json = QJsonDocument(snap.devices.first().toJson()).toJson(QJsonDocument::Compact);
+    v1 << quint32(1) << quint32(json.size());
+    v1.writeRawData(json.constData(), json.size());
+    v1 << quint32(0);
+    QByteArray legacy;
+    QDataStream header(&legacy, QIODevice::WriteOnly);
+    header.setByteOrder(QDataStream::LittleEndian);
+    header << Policy::PolicyBlobCodec::kMagic << Policy::PolicyBlobCodec::kLegacyVersion
+           << quint32(payload.size());
+    legacy += payload + Policy::PolicyBlobCodec::sign(payload, key);
+    QVERIFY(Policy::PolicyBlobCodec::decode(legacy, decoded, &err, key));
+    QCOMPARE(decoded.devices.size(), 1);
+    QCOMPARE(Policy::PolicyBlobCodec::signatureOf(legacy), Policy::PolicyBlobCodec::sign(payload, key));
+}
+
+void TestDatabaseManager::policyBlobCompressesRecords()
+{
+    if (!StoreCompression::available()) {
+        QSKIP("Built without zstd");
+    }
+    const QByteArray key(32, 'k');
+    Policy::PolicySnapshot snap;
+    qsizetype jsonBytes = 0;
+    for (int i = 0; i < 500; ++i) {
+        DeviceRecord rec;
+        rec.uniqueId = QStringLiteral("usb-Kingston_DataTraveler_3.0_%1-0:0/sd%2")
+                           .arg(i, 8, 10, QLatin1Char('0'))
+                           .arg(QChar(char16_t(u'b' + i % 20)));
+        rec.hash = QString::fromLatin1(
+            QCryptographicHash::hash(rec.uniqueId.toUtf8(), QCryptographicHash::Sha256).toHex());
+        rec.notes = QStringLiteral("Issued to lab bench %1").arg(i % 7);
+        rec.firstSeen = QDateTime(QDate(2026, 1, 1), QTime(0, 0), QTimeZone::UTC).addSecs(i * 60);
+        jsonBytes += QJsonDocument(rec.toJson()).toJson(QJsonDocument::Compact).size();
+        snap.devices.append(rec);
+    }
+
+    const QByteArray file = Policy::PolicyBlobCodec::encode(snap, key);
+    QVERIFY2(file.size() * 2 < jsonBytes, qPrintable(QStringLiteral("%1 of %2 bytes").arg(file.size()).arg(jsonBytes)));
+
+    QString err;
+    const std::unique_ptr<Policy::PolicyBlobView> view = Policy::PolicyBlobView::fromBytes(file, key, &err);
+    QVERIFY2(view, qPrintable(err));
+    const std::optional<DeviceRecord> one = view->device(snap.devices.at(123).uniqueId, &err);
+    QVERIFY2(one.has_value(), qPrintable(err));
+    QCOMPARE(one->hash, snap.devices.at(123).hash);
+    QCOMPARE(one->notes, snap.devices.at(123).notes);
+    Policy::PolicySnapshot decoded;
+    QVERIFY2(view->read(decoded, &err), qPrintable(err));
+    QCOMPARE(decoded.devices.size(), snap.devices.size());
+
+    // The dictionary is signed like any section: changed, no record inflates.
+    QByteArray tampered = file;
+    const qsizetype dictionary = tampered.size() - 100;
+    tampered[dictionary] = char(tampered.at(dictionary) ^ 0x01);
+    const std::unique_ptr<Policy::PolicyBlobView> bad = Policy::PolicyBlobView::fromBytes(tampered, key);
+    QVERIFY(bad);
+    QVERIFY(!bad->device(snap.devices.at(123).uniqueId).has_value());
+}
+
+void TestDatabaseManager::integrityChecksRunInBackground()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+    DatabaseManager db;
+    QVERIFY(db.initialize());
+
+    DeviceRecord good;
+    good.uniqueId = "device_a/sda1";
+    good.hash = QString(64, QLatin1Char('a'));
+    good.firstSeen = QDateTime::currentDateTimeUtc();
+    QVERIFY(db.addDevice(good));
+    DeviceRecord bad = good;
+    bad.uniqueId = "device_b/sdb1";
+    bad.hash = "not-a-digest";
+    QVERIFY(db.addDevice(bad));
+
+    QFuture<QStringList> issues = db.validateIntegrityAsync();
+    issues.waitForFinished();
+    QCOMPARE(issues.result().size(), 1);
+    QVERIFY(issues.result().first().contains(bad.uniqueId));
+    QCOMPARE(db.validateIntegrity(), issues.result());
+
+    QFuture<int> compacted = db.compactAsync();
+    compacted.waitForFinished();
+    QCOMPARE(compacted.result(), 0);
+    QCOMPARE(db.deviceCount(), 2);
+}
+
+void TestDatabaseManager::policyJsonStreamed()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+    Policy::PolicyGateway* gate = Policy::PolicyServiceLocator::gateway();
+    QVERIFY(gate->load());
+
+    QList<DeviceRecord> records;
+    for (int i = 0; i < Policy::PolicyJsonStream::kImportBatch + 44; ++i) {
+        DeviceRecord rec;
+        rec.uniqueId = QStringLiteral("device_%1/sda1").arg(i);
+        rec.notes = QStringLiteral("brace } and \"quote\" [%1]").arg(i);
+        records.append(rec);
+    }
+    QVERIFY(gate->upsertDevices(records, "test", "seed"));
+    const auto notesOf = [](const PolicySnapshot& snap, const QString& id) {
+        for (const DeviceRecord& rec : snap.devices) {
+            if (rec.uniqueId == id) {
+                return rec.notes;
+            }
+        }
+        return QString();
+    };
+
+    const QString lines = tempDir.filePath("devices.jsonl");
+    const QString pretty = tempDir.filePath("devices.json");
+    QVERIFY(gate->exportJson(lines, false));
+    QVERIFY(gate->exportJson(pretty, true));
+    QFile doc(pretty);
+    QVERIFY(doc.open(QIODevice::ReadOnly));
+    QCOMPARE(QJsonDocument::fromJson(doc.readAll())["devices"].toArray().size(), records.size());
+
+    // Replace keeps the store when the file cannot be read.
+    QCOMPARE(gate->importJson(tempDir.filePath("missing.json"), false, "test"), -1);
+    QCOMPARE(gate->snapshot().devices.size(), records.size());
+
+    QCOMPARE(gate->importJson(lines, false, "test"), records.size());
+    const PolicySnapshot replaced = gate->snapshot();
+    QCOMPARE(replaced.devices.size(), records.size());
+    QCOMPARE(notesOf(replaced, records.last().uniqueId), records.last().notes);
+
+    QVERIFY(gate->removeDevice(records.first().uniqueId, "test", "drop"));
+    QCOMPARE(gate->importJson(pretty, true, "test"), records.size());
+    const PolicySnapshot merged = gate->snapshot();
+    QCOMPARE(merged.devices.size(), records.size());
+    QCOMPARE(notesOf(merged, records.first().uniqueId), records.first().notes);
+}
+
+void TestDatabaseManager::auditAppendsBatched()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    installIsolatedPolicy(tempDir.path());
+
+    constexpr int kThreads = 4;
+    constexpr int kPerThread = 250;
+    std::vector<std::thread> writers;
+    for (int t = 0; t < kThreads; ++t) {
+        writers.emplace_back([t]() {
+            for (int i = 0; i < kPerThread; ++i) {
+                Policy::PolicyAudit::append(QStringLiteral("writer%1").arg(t), "test",
+                                            QString::number(i), "line \"quoted\"\n");
+            }
+        });
+    }
+    for (std::thread& w : writers) {
+        w.join();
+    }
+    AuditWriter::flushAll();
+
+    QFile log(Policy::PolicyPaths::auditLogPath());
+    QVERIFY(log.open(QIODevice::ReadOnly));
+    QHash<QString, int> next;
+    int lines = 0;
+    while (!log.atEnd()) {
+        const QJsonObject obj = QJsonDocument::fromJson(log.readLine()).object();
+        QCOMPARE(obj["action"].toString(), QStringLiteral("test"));
+        QCOMPARE(obj["detail"].toString(), QStringLiteral("line \"quoted\"\n"));
+        const QString actor = obj["actor"].toString();
+        QCOMPARE(obj["target"].toString().toInt(), next[actor]++);  // per-thread order kept
+        ++lines;
+    }
+    QCOMPARE(lines, kThreads * kPerThread);
+}
+
+void TestDatabaseManager::auditLogIndexedAndChained()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString path = tempDir.filePath("audit.log");
+    {
+        QFile legacy(path);  // written before the chain and the index
+        QVERIFY(legacy.open(QIODevice::WriteOnly));
+        legacy.write("{\"ts\":\"2020-01-01T00:00:00Z\",\"event\":\"old\"}\n");
+    }
+
+    AuditWriter& writer = AuditWriter::forPath(path);
+    const QString padding(4000, QLatin1Char('x'));
+    const int lines = int(AuditLogIndex::kSegmentBytes / padding.size()) + 100;
+    for (int i = 0; i < lines; ++i) {
+        AuditLine line;
+        line.addTimestamp().add("event", QStringLiteral("test")).add("n", i).add("detail", padding);
+        writer.append(line.take(), i % 2 ? QStringLiteral("dev_b") : QStringLiteral("dev_a"));
+    }
+    writer.flush();
+    QCOMPARE(AuditLogIndex::segments(path).size(), 2);
+
+    AuditLogIndex::Query query;
+    query.device = "dev_b";
+    query.limit = 3;
+    const QList<QByteArray> newest = AuditLogIndex::query(path, query);
+    QCOMPARE(newest.size(), 3);
+    QCOMPARE(QJsonDocument::fromJson(newest.first())["n"].toInt(), lines - 1);
+    QCOMPARE(QJsonDocument::fromJson(newest.last())["n"].toInt(), lines - 5);
+
+    AuditLogIndex::Query old;
+    old.to = QDateTime(QDate(2021, 1, 1), QTime(0, 0), QTimeZone::utc());
+    const QList<QByteArray> legacyLines = AuditLogIndex::query(path, old);
+    QCOMPARE(legacyLines.size(), 1);
+    QCOMPARE(QJsonDocument::fromJson(legacyLines.first())["event"].toString(), QStringLiteral("old"));
+    AuditLogIndex::Query future;
+    future.from = QDateTime::currentDateTimeUtc().addDays(1);
+    QVERIFY(AuditLogIndex::query(path, future).isEmpty());
+
+    QString err;
+    QVERIFY2(AuditLogIndex::verifyChain(path, &err), qPrintable(err));
+    QFile first(AuditLogIndex::segments(path).first());
+    QVERIFY(first.open(QIODevice::ReadWrite));
+    QByteArray bytes = first.readAll();
+    const qsizetype at = bytes.indexOf("\"n\":7,");
+    QVERIFY(at > 0);
+    bytes[at + 4] = '8';
+    QVERIFY(first.seek(0));
+    first.write(bytes);
+    first.close();
+    QVERIFY(!AuditLogIndex::verifyChain(path, &err));
+    QVERIFY(err.contains(QStringLiteral("line 10")));  // the line after the edited one
+}
+
 QTEST_MAIN(TestDatabaseManager)
 #include "test_database_manager.moc"
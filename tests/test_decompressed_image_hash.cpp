@@ -0,0 +1,177 @@
+#include <QtTest>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "DecompressedImageHash.h"
+#include "ImageStreamDecoder.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+// sha256 of the 703.1 KiB image every fixture decompresses to.
+const QString kImageSha256 =
+    QStringLiteral("f1efc2c15826c4501ae3a373b915d8bdd6ce203490e005acba89aab58b3ccfd3");
+
+QString fixture(const QString& name)
+{
+    return QStringLiteral(FLASHSPARTAN_TEST_FIXTURES_DIR "/compressed/") + name;
+}
+
+bool decoderBuiltFor(const QString& name)
+{
+    if (name.endsWith(QStringLiteral(".xz"))) {
+        return ImageDecoders::xzAvailable();
+    }
+    if (name.endsWith(QStringLiteral(".zst"))) {
+        return ImageDecoders::zstdAvailable();
+    }
+    if (name.endsWith(QStringLiteral(".gz"))) {
+        return ImageDecoders::gzipAvailable();
+    }
+    return ImageDecoders::zipAvailable();
+}
+
+} // namespace
+
+class TestDecompressedImageHash : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void decompressedDigest_data();
+    void decompressedDigest();
+    void everyDigestInOneDecode();
+    void truncatedFileFails_data();
+    void truncatedFileFails();
+    void zipMemberCrcIsChecked();
+    void plainFileFails();
+    void unknownSuffixIsNotDecoded();
+
+private:
+    QTemporaryDir m_dir;
+};
+
+void TestDecompressedImageHash::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+}
+
+void TestDecompressedImageHash::decompressedDigest_data()
+{
+    QTest::addColumn<QString>("file");
+    QTest::newRow("xz-single-block") << QStringLiteral("single-block.img.xz");
+    QTest::newRow("xz-multi-block") << QStringLiteral("multi-block.img.xz");
+    QTest::newRow("zstd-multi-frame") << QStringLiteral("multi-frame.img.zst");
+    QTest::newRow("zstd-streamed") << QStringLiteral("streamed.img.zst");
+    QTest::newRow("gzip") << QStringLiteral("image.img.gz");
+    QTest::newRow("zip-member") << QStringLiteral("image.zip");
+}
+
+void TestDecompressedImageHash::decompressedDigest()
+{
+    QFETCH(QString, file);
+    if (!decoderBuiltFor(file)) {
+        QSKIP("decoder not built in");
+    }
+    QVERIFY(DecompressedImageHash::canDecode(file));
+    QString err;
+    QCOMPARE(DecompressedImageHash::sha256(fixture(file), &err), kImageSha256);
+    QVERIFY2(err.isEmpty(), qPrintable(err));
+}
+
+void TestDecompressedImageHash::everyDigestInOneDecode()
+{
+    if (!ImageDecoders::gzipAvailable()) {
+        QSKIP("built without zlib");
+    }
+    DigestValues values;
+    QString err;
+    QVERIFY2(DecompressedImageHash::digests(fixture(QStringLiteral("image.img.gz")),
+                                            DigestAlgorithm::Sha256 | DigestAlgorithm::Sha512
+                                                | DigestAlgorithm::Blake2b512,
+                                            &values, &err),
+             qPrintable(err));
+    QCOMPARE(values.sha256, kImageSha256);
+    QCOMPARE(values.sha512, QStringLiteral("b8964d32876d7478a2e78b7a95ebd76f6c9581d675a3e4f5dc8d988db803a89b"
+                                           "ed3803ff44189ab589e6dbec7fbf0164a157689fa37d42ecc867b936defbdb48"));
+    QCOMPARE(values.blake2b512, QStringLiteral("c94294880b719eaf66b476f78ccba7a6b0ed4c66dfb27e8de9edcf38ed5d379f"
+                                               "c886b07a9b4d04227c5a80db5a933fbd943b087f03e1484c06ee2ce3d17ff837"));
+}
+
+void TestDecompressedImageHash::truncatedFileFails_data()
+{
+    QTest::addColumn<QString>("file");
+    QTest::newRow("xz") << QStringLiteral("multi-block.img.xz");
+    QTest::newRow("zstd") << QStringLiteral("multi-frame.img.zst");
+    QTest::newRow("gzip") << QStringLiteral("image.img.gz");
+}
+
+void TestDecompressedImageHash::truncatedFileFails()
+{
+    QFETCH(QString, file);
+    if (!decoderBuiltFor(file)) {
+        QSKIP("decoder not built in");
+    }
+    QFile in(fixture(file));
+    QVERIFY(in.open(QIODevice::ReadOnly));
+    const QByteArray data = in.readAll();
+    const QString path = m_dir.filePath(QStringLiteral("truncated-") + file);
+    QFile out(path);
+    QVERIFY(out.open(QIODevice::WriteOnly));
+    out.write(data.left(data.size() / 2));
+    out.close();
+
+    QString err;
+    QVERIFY(DecompressedImageHash::sha256(path, &err).isEmpty());
+    QVERIFY(!err.isEmpty());
+}
+
+void TestDecompressedImageHash::zipMemberCrcIsChecked()
+{
+    if (!ImageDecoders::zipAvailable()) {
+        QSKIP("built without zlib");
+    }
+    QFile in(fixture(QStringLiteral("image.zip")));
+    QVERIFY(in.open(QIODevice::ReadOnly));
+    QByteArray data = in.readAll();
+    // Flip a byte inside the deflated member, after its local header.
+    data[data.size() / 2] = static_cast<char>(data.at(data.size() / 2) ^ 0x01);
+    const QString path = m_dir.filePath(QStringLiteral("altered.zip"));
+    QFile out(path);
+    QVERIFY(out.open(QIODevice::WriteOnly));
+    out.write(data);
+    out.close();
+
+    QString err;
+    QVERIFY(DecompressedImageHash::sha256(path, &err).isEmpty());
+    QVERIFY(!err.isEmpty());
+}
+
+void TestDecompressedImageHash::plainFileFails()
+{
+    if (!ImageDecoders::xzAvailable()) {
+        QSKIP("built without liblzma");
+    }
+    const QString path = m_dir.filePath(QStringLiteral("plain.img.xz"));
+    QFile out(path);
+    QVERIFY(out.open(QIODevice::WriteOnly));
+    out.write(QByteArray(4096, 'x'));
+    out.close();
+
+    QString err;
+    QVERIFY(DecompressedImageHash::sha256(path, &err).isEmpty());
+    QVERIFY(err.contains(QStringLiteral("not an xz file")));
+}
+
+void TestDecompressedImageHash::unknownSuffixIsNotDecoded()
+{
+    QVERIFY(!DecompressedImageHash::canDecode(QStringLiteral("debian.iso")));
+    QVERIFY(!DecompressedImageHash::canDecode(QStringLiteral("disk.img")));
+    QString err;
+    QVERIFY(DecompressedImageHash::sha256(fixture(QStringLiteral("image.img.gz.txt")), &err).isEmpty());
+    QVERIFY(!err.isEmpty());
+}
+
+QTEST_MAIN(TestDecompressedImageHash)
+#include "test_decompressed_image_hash.moc"
@@ -0,0 +1,192 @@
+#include <QtTest>
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "DeviceGeometry.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+void writeFile(const QString& path, const QByteArray& text)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile f(path);
+    QVERIFY(f.open(QIODevice::WriteOnly));
+    f.write(text + '\n');
+}
+
+/** One fake device: counts opens and closes, answers a fixed size. */
+struct FakeDevices {
+    int opens = 0;
+    int closes = 0;
+    int probes = 0;
+    quint64 identity = 8 << 8 | 16;
+    uint64_t sizeBytes = 16ULL * 1024 * 1024 * 1024;
+
+    DeviceGeometryCache::Backend backend()
+    {
+        DeviceGeometryCache::Backend b;
+        b.open = [this](const QString&) { return identity == 0 ? -1 : 100 + opens++; };
+        b.close = [this](int) { ++closes; };
+        b.probe = [this](int, const QString&) {
+            ++probes;
+            DeviceGeometry g;
+            g.sizeBytes = sizeBytes;
+            g.logicalSectorBytes = 512;
+            return g;
+        };
+        b.identity = [this](const QString&) { return identity; };
+        return b;
+    }
+};
+
+const QString kNode = QStringLiteral("/dev/sdb");
+
+} // namespace
+
+class TestDeviceGeometry : public QObject {
+    Q_OBJECT
+
+private slots:
+    void partitionReadsItsDiskQueue();
+    void nonUsbDiskHasNoLinkSpeed();
+    void probesOnceAndCaches();
+    void handlesShareOneDescriptor();
+    void replacedDeviceIsProbedAgain();
+    void forgetDropsGeometryButNotHandles();
+    void unopenableDeviceIsNotCached();
+};
+
+void TestDeviceGeometry::partitionReadsItsDiskQueue()
+{
+    QTemporaryDir root;
+    QVERIFY(root.isValid());
+    const QString usb = root.path() + QStringLiteral("/devices/pci0000:00/usb2/2-1");
+    const QString disk = usb + QStringLiteral("/2-1:1.0/host6/target6:0:0/6:0:0:0/block/sdb");
+    writeFile(usb + QStringLiteral("/idVendor"), "0781");
+    writeFile(usb + QStringLiteral("/speed"), "5000");
+    writeFile(disk + QStringLiteral("/queue/logical_block_size"), "512");
+    writeFile(disk + QStringLiteral("/queue/physical_block_size"), "4096");
+    writeFile(disk + QStringLiteral("/queue/optimal_io_size"), "0");
+    writeFile(disk + QStringLiteral("/queue/max_sectors_kb"), "240");
+    writeFile(disk + QStringLiteral("/queue/rotational"), "0");
+    writeFile(disk + QStringLiteral("/sdb1/partition"), "1");
+
+    DeviceGeometry geometry;
+    DeviceGeometryCache::readSysfs(disk + QStringLiteral("/sdb1"), &geometry);
+    QCOMPARE(geometry.logicalSectorBytes, 512);
+    QCOMPARE(geometry.physicalSectorBytes, 4096);
+    QCOMPARE(geometry.optimalIoKB, 0);
+    QCOMPARE(geometry.maxSectorsKB, 240);
+    QVERIFY(!geometry.rotational);
+    QCOMPARE(geometry.usbSpeedMbps, 5000);
+}
+
+void TestDeviceGeometry::nonUsbDiskHasNoLinkSpeed()
+{
+    QTemporaryDir root;
+    QVERIFY(root.isValid());
+    const QString disk = root.path() + QStringLiteral("/devices/pci0000:00/ata1/host0/block/sda");
+    writeFile(disk + QStringLiteral("/queue/optimal_io_size"), "1048576");
+    writeFile(disk + QStringLiteral("/queue/rotational"), "1");
+
+    DeviceGeometry geometry;
+    DeviceGeometryCache::readSysfs(disk, &geometry);
+    QCOMPARE(geometry.optimalIoKB, 1024);
+    QVERIFY(geometry.rotational);
+    QCOMPARE(geometry.usbSpeedMbps, 0);
+}
+
+void TestDeviceGeometry::probesOnceAndCaches()
+{
+    FakeDevices devices;
+    DeviceGeometryCache cache(devices.backend());
+    QVERIFY(!cache.contains(kNode));
+
+    QCOMPARE(cache.geometry(kNode).sizeBytes, devices.sizeBytes);
+    QCOMPARE(cache.geometry(kNode).sizeBytes, devices.sizeBytes);
+    QVERIFY(cache.contains(kNode));
+    QCOMPARE(devices.probes, 1);
+    // The probe's descriptor is not kept once nobody holds it.
+    QCOMPARE(devices.opens, 1);
+    QCOMPARE(devices.closes, 1);
+}
+
+void TestDeviceGeometry::handlesShareOneDescriptor()
+{
+    FakeDevices devices;
+    DeviceGeometryCache cache(devices.backend());
+    {
+        const DeviceGeometryCache::Handle first = cache.acquire(kNode);
+        const DeviceGeometryCache::Handle second = cache.acquire(kNode);
+        QVERIFY(first.isOpen());
+        QCOMPARE(second.fd(), first.fd());
+        QCOMPARE(cache.geometry(kNode).sizeBytes, devices.sizeBytes);
+        QCOMPARE(devices.opens, 1);
+        QCOMPARE(devices.closes, 0);
+    }
+    QCOMPARE(devices.closes, 1);
+
+    // Released: the next acquire opens afresh.
+    QVERIFY(cache.acquire(kNode).isOpen());
+    QCOMPARE(devices.opens, 2);
+    QCOMPARE(devices.probes, 1);
+}
+
+void TestDeviceGeometry::replacedDeviceIsProbedAgain()
+{
+    FakeDevices devices;
+    DeviceGeometryCache cache(devices.backend());
+    const DeviceGeometryCache::Handle old = cache.acquire(kNode);
+    QCOMPARE(cache.geometry(kNode).sizeBytes, devices.sizeBytes);
+
+    // Another stick under the same node.
+    devices.identity = 8 << 8 | 32;
+    devices.sizeBytes = 8ULL * 1024 * 1024 * 1024;
+    const DeviceGeometryCache::Handle fresh = cache.acquire(kNode);
+    QVERIFY(fresh.isOpen());
+    QVERIFY(fresh.fd() != old.fd());
+    QCOMPARE(cache.geometry(kNode).sizeBytes, devices.sizeBytes);
+    QCOMPARE(devices.probes, 2);
+    QCOMPARE(devices.closes, 0);
+
+    // Gone: nothing is answered from the old entry.
+    devices.identity = 0;
+    QVERIFY(cache.geometry(kNode).isEmpty());
+    QVERIFY(!cache.contains(kNode));
+}
+
+void TestDeviceGeometry::forgetDropsGeometryButNotHandles()
+{
+    FakeDevices devices;
+    DeviceGeometryCache cache(devices.backend());
+    const DeviceGeometryCache::Handle handle = cache.acquire(kNode);
+    QVERIFY(cache.contains(kNode));
+
+    cache.forget(kNode);
+    QVERIFY(!cache.contains(kNode));
+    QVERIFY(handle.isOpen());
+    QCOMPARE(devices.closes, 0);
+
+    QVERIFY(!cache.geometry(kNode).isEmpty());
+    QCOMPARE(devices.probes, 2);
+}
+
+void TestDeviceGeometry::unopenableDeviceIsNotCached()
+{
+    FakeDevices devices;
+    DeviceGeometryCache::Backend backend = devices.backend();
+    backend.open = [](const QString&) { return -1; };
+    DeviceGeometryCache cache(backend);
+
+    QVERIFY(cache.geometry(kNode).isEmpty());
+    QVERIFY(!cache.acquire(kNode).isOpen());
+    QVERIFY(!cache.contains(kNode));
+    QCOMPARE(devices.probes, 0);
+}
+
+QTEST_MAIN(TestDeviceGeometry)
+#include "test_device_geometry.moc"
@@ -0,0 +1,146 @@
+#include <QtTest>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+#include "DeviceTimelineLog.h"
+#include "StoreCompression.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+UiEventEntry event(const QString& node, int n)
+{
+    UiEventEntry e;
+    e.time = QDateTime::currentDateTime();
+    e.event = QStringLiteral("connect %1").arg(n);
+    e.deviceNode = node;
+    return e;
+}
+
+QStringList segmentFiles(const QString& dir)
+{
+    return QDir(dir).entryList({QStringLiteral("*.jsonl"), QStringLiteral("*.jsonl.zst")}, QDir::Files,
+                               QDir::Name);
+}
+
+} // namespace
+
+class TestDeviceTimeline : public QObject {
+    Q_OBJECT
+
+private slots:
+    void appendsAndIndexesByDevice();
+    void retentionDropsWholeSegments();
+    void closedSegmentsCompressed();
+    void legacyFileMigrated();
+};
+
+void TestDeviceTimeline::appendsAndIndexesByDevice()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString dir = tempDir.filePath("device-timeline");
+    DeviceTimelineLog& log = DeviceTimelineLog::instance();
+    log.load(dir);
+    for (int i = 0; i < 30; ++i) {
+        log.append(event(i % 3 ? QStringLiteral("/dev/sdb") : QStringLiteral("/dev/sdc"), i));
+    }
+
+    QList<UiEventEntry> sdc = log.entriesForDevice(QStringLiteral("/dev/sdc"), 0, 4);
+    QCOMPARE(sdc.size(), 4);
+    QCOMPARE(sdc.first().event, QStringLiteral("connect 27"));
+    QCOMPARE(sdc.last().event, QStringLiteral("connect 18"));
+    QCOMPARE(log.knownDeviceNodes(), QStringList({QStringLiteral("/dev/sdb"), QStringLiteral("/dev/sdc")}));
+
+    log.load(dir);  // read back from the open segment
+    QCOMPARE(log.entriesForDevice(QStringLiteral("/dev/sdb"), 30, 0).size(), 20);
+    QCOMPARE(log.entriesForDevice({}, 0, 0).first().event, QStringLiteral("connect 29"));
+    QCOMPARE(segmentFiles(dir).size(), 1);
+}
+
+void TestDeviceTimeline::retentionDropsWholeSegments()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString dir = tempDir.filePath("device-timeline");
+    DeviceTimelineLog& log = DeviceTimelineLog::instance();
+    log.load(dir);
+    const int total = DeviceTimelineLog::kMaxTotalEntries + 2 * DeviceTimelineLog::kSegmentEntries;
+    for (int i = 0; i < total; ++i) {
+        log.append(event(QStringLiteral("/dev/sdb"), i));
+    }
+    log.waitForCompaction();
+
+    const QList<UiEventEntry> kept = log.entriesForDevice(QStringLiteral("/dev/sdb"), 0, 0);
+    QVERIFY(kept.size() >= DeviceTimelineLog::kMaxTotalEntries);
+    QVERIFY(kept.size() < DeviceTimelineLog::kMaxTotalEntries + DeviceTimelineLog::kSegmentEntries);
+    QCOMPARE(kept.first().event, QStringLiteral("connect %1").arg(total - 1));
+
+    log.load(dir);
+    QCOMPARE(log.entriesForDevice(QStringLiteral("/dev/sdb"), 0, 0).size(), kept.size());
+    QCOMPARE(log.entriesForDevice(QStringLiteral("/dev/sdb"), 0, 0).last().event, kept.last().event);
+}
+
+void TestDeviceTimeline::closedSegmentsCompressed()
+{
+    if (!StoreCompression::available()) {
+        QSKIP("Built without zstd");
+    }
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString dir = tempDir.filePath("device-timeline");
+    DeviceTimelineLog& log = DeviceTimelineLog::instance();
+    log.load(dir);
+    const int total = 2 * DeviceTimelineLog::kSegmentEntries + 5;
+    for (int i = 0; i < total; ++i) {
+        log.append(event(QStringLiteral("/dev/sdb"), i));
+    }
+    log.load(dir);  // a roll while the last merge job ran is picked up here
+    log.waitForCompaction();
+
+    const QStringList files = segmentFiles(dir);
+    QCOMPARE(files.size(), 3);
+    QVERIFY(files.at(0).endsWith(".jsonl.zst"));
+    QVERIFY(files.at(1).endsWith(".jsonl.zst"));
+    QVERIFY(files.at(2).endsWith(".jsonl"));  // still appended to
+
+    const QList<UiEventEntry> all = log.entriesForDevice(QStringLiteral("/dev/sdb"), 0, 0);
+    QCOMPARE(all.size(), total);
+    QCOMPARE(all.first().event, QStringLiteral("connect %1").arg(total - 1));
+    QCOMPARE(all.last().event, QStringLiteral("connect 0"));
+}
+
+void TestDeviceTimeline::legacyFileMigrated()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    QJsonArray entries;
+    for (int i = 2; i >= 0; --i) {  // newest first, as the old format stored them
+        QJsonObject o;
+        o["id"] = QString::number(i);
+        o["at"] = QDateTime::currentDateTime().addSecs(i).toString(Qt::ISODate);
+        o["event"] = QStringLiteral("legacy %1").arg(i);
+        o["device_node"] = QStringLiteral("/dev/sdd");
+        entries.append(o);
+    }
+    QFile legacy(tempDir.filePath("device-timeline.json"));
+    QVERIFY(legacy.open(QIODevice::WriteOnly));
+    legacy.write(QJsonDocument(QJsonObject{{"entries", entries}}).toJson());
+    legacy.close();
+
+    DeviceTimelineLog& log = DeviceTimelineLog::instance();
+    log.load(tempDir.filePath("device-timeline"));
+    const QList<UiEventEntry> out = log.entriesForDevice(QStringLiteral("/dev/sdd"), 0, 0);
+    QCOMPARE(out.size(), 3);
+    QCOMPARE(out.first().event, QStringLiteral("legacy 2"));
+    QVERIFY(!QFile::exists(tempDir.filePath("device-timeline.json")));
+    QVERIFY(QFile::exists(tempDir.filePath("device-timeline.json.migrated")));
+}
+
+QTEST_MAIN(TestDeviceTimeline)
+#include "test_device_timeline.moc"
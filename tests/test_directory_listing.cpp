@@ -0,0 +1,101 @@
+#include <QtTest>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+#include "DirectoryListing.h"
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#endif
+
+using namespace FlashSpartan;
+
+namespace {
+
+const DirectoryListing::Entry* find(const QVector<DirectoryListing::Entry>& entries, const QString& name)
+{
+    for (const DirectoryListing::Entry& e : entries) {
+        if (e.name == name) {
+            return &e;
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+class TestDirectoryListing : public QObject {
+    Q_OBJECT
+
+private slots:
+    void listsFilesAndDirectories();
+    void hiddenEntriesAreMarked();
+    void missingDirectoryFails();
+};
+
+void TestDirectoryListing::listsFilesAndDirectories()
+{
+#ifndef Q_OS_WIN
+    QSKIP("Windows only; POSIX walkers use readdir()");
+#else
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(QDir(dir.path()).mkdir(QStringLiteral("sub")));
+    const QString path = dir.filePath(QStringLiteral("data.bin"));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(QByteArray(12345, 'x')), qint64(12345));
+    file.close();
+
+    QVector<DirectoryListing::Entry> entries;
+    QVERIFY(DirectoryListing::list(dir.path(), &entries));
+    QCOMPARE(entries.size(), qsizetype(2));  // no "." or ".."
+
+    const DirectoryListing::Entry* data = find(entries, QStringLiteral("data.bin"));
+    QVERIFY(data);
+    QCOMPARE(data->kind, DirectoryListing::Entry::Kind::File);
+    QCOMPARE(data->size, uint64_t(12345));
+    QCOMPARE(data->modifiedMs, QFileInfo(path).lastModified().toMSecsSinceEpoch());
+    QVERIFY(!data->hidden);
+
+    const DirectoryListing::Entry* sub = find(entries, QStringLiteral("sub"));
+    QVERIFY(sub);
+    QCOMPARE(sub->kind, DirectoryListing::Entry::Kind::Directory);
+#endif
+}
+
+void TestDirectoryListing::hiddenEntriesAreMarked()
+{
+#ifndef Q_OS_WIN
+    QSKIP("Windows only; POSIX walkers use readdir()");
+#else
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("hidden.txt"));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.close();
+    QVERIFY(SetFileAttributesW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(path).utf16()),
+                               FILE_ATTRIBUTE_HIDDEN));
+
+    QVector<DirectoryListing::Entry> entries;
+    QVERIFY(DirectoryListing::list(dir.path(), &entries));
+    const DirectoryListing::Entry* hidden = find(entries, QStringLiteral("hidden.txt"));
+    QVERIFY(hidden);
+    QVERIFY(hidden->hidden);
+#endif
+}
+
+void TestDirectoryListing::missingDirectoryFails()
+{
+    QVector<DirectoryListing::Entry> entries;
+    QVERIFY(!DirectoryListing::list(QDir::tempPath() + QStringLiteral("/flashspartan-missing-dir"), &entries));
+    QVERIFY(entries.isEmpty());
+}
+
+QTEST_MAIN(TestDirectoryListing)
+#include "test_directory_listing.moc"
@@ -0,0 +1,146 @@
+#include <QtTest>
+
+#include <algorithm>
+#include <cstring>
+
+#include "EjectSealProbe.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+constexpr uint64_t kMiB = 1024ULL * 1024;
+
+EjectSealProbe::ReadAt readerOf(const QByteArray& image)
+{
+    return [&image](uint64_t offset, char* buffer, size_t length) {
+        if (offset + length > static_cast<uint64_t>(image.size())) {
+            return false;
+        }
+        std::memcpy(buffer, image.constData() + offset, length);
+        return true;
+    };
+}
+
+template <typename T>
+void putLe(QByteArray& image, int offset, T value)
+{
+    qToLittleEndian(value, image.data() + offset);
+}
+
+/** A volume of @p bytes whose content is distinct per sector, under a FAT32 boot sector. */
+QByteArray fat32Volume(uint64_t bytes)
+{
+    QByteArray image(static_cast<qsizetype>(bytes), '\0');
+    for (qsizetype at = 0; at < image.size(); at += EjectSealProbe::kSectorBytes) {
+        putLe<quint64>(image, static_cast<int>(at), static_cast<quint64>(at) | 0xA5A5000000000000ULL);
+    }
+    std::memset(image.data(), 0, 512);
+    putLe<quint16>(image, 11, 512);  // bytes per sector
+    putLe<quint16>(image, 22, 0);    // FAT32: no 16-bit FAT size
+    image[0x42] = char(0x29);        // extended boot signature
+    putLe<quint32>(image, 0x43, 0x1234ABCD);
+    putLe<quint16>(image, 510, 0xAA55);
+    return image;
+}
+
+QByteArray extVolume(uint64_t bytes)
+{
+    QByteArray image(static_cast<qsizetype>(bytes), '\x11');
+    constexpr int sb = 1024;
+    putLe<quint16>(image, sb + 0x38, 0xEF53);
+    putLe<quint16>(image, sb + 0x3A, 1);  // cleanly unmounted
+    putLe<quint16>(image, sb + 0x34, 7);
+    putLe<quint32>(image, sb + 0x30, 1700000000);
+    putLe<quint64>(image, sb + 0x178, 4096);
+    return image;
+}
+
+} // namespace
+
+class TestEjectSealProbe : public QObject {
+    Q_OBJECT
+
+private slots:
+    void offsetsSpanTheVolume();
+    void untouchedVolumeMatches();
+    void changesBreakTheSeal();
+    void readErrorGivesNoSeal();
+};
+
+void TestEjectSealProbe::offsetsSpanTheVolume()
+{
+    const uint64_t size = 64 * kMiB + 12345;
+    const std::vector<uint64_t> offsets = EjectSealProbe::sampleOffsets(size);
+    QCOMPARE(static_cast<int>(offsets.size()), EjectSealProbe::kSamples);
+    QCOMPARE(offsets.front(), uint64_t(0));
+    QVERIFY(offsets.back() + EjectSealProbe::kSampleBytes <= size);
+    QVERIFY(offsets.back() + EjectSealProbe::kSampleBytes + EjectSealProbe::kSectorBytes > size);
+    for (uint64_t at : offsets) {
+        QCOMPARE(at % EjectSealProbe::kSectorBytes, uint64_t(0));
+    }
+    QVERIFY(std::is_sorted(offsets.begin(), offsets.end()));
+    QVERIFY(EjectSealProbe::sampleOffsets(EjectSealProbe::kSampleBytes - 1).empty());
+}
+
+void TestEjectSealProbe::untouchedVolumeMatches()
+{
+    const QByteArray disk = fat32Volume(8 * kMiB);
+    const QByteArray volume = fat32Volume(4 * kMiB);
+    const EjectSeal sealed = EjectSealProbe::capture(readerOf(volume), volume.size(), readerOf(disk));
+    QVERIFY(!sealed.isEmpty());
+    QCOMPARE(sealed.volumeBytes, 4 * kMiB);
+    QCOMPARE(sealed.sampleSha256.size(), qsizetype(64));
+
+    const EjectSeal again = EjectSealProbe::capture(readerOf(volume), volume.size(), readerOf(disk));
+    QVERIFY(EjectSealProbe::mismatch(sealed, again).isEmpty());
+    QVERIFY(!EjectSealProbe::mismatch(EjectSeal(), again).isEmpty());
+}
+
+void TestEjectSealProbe::changesBreakTheSeal()
+{
+    const QByteArray disk = fat32Volume(8 * kMiB);
+    const QByteArray volume = extVolume(4 * kMiB);
+    const EjectSeal sealed = EjectSealProbe::capture(readerOf(volume), volume.size(), readerOf(disk));
+    QVERIFY(!sealed.isEmpty());
+
+    const auto reseal = [&](const QByteArray& v, const QByteArray& d) {
+        return EjectSealProbe::mismatch(sealed, EjectSealProbe::capture(readerOf(v), v.size(), readerOf(d)));
+    };
+
+    QByteArray table = disk;
+    table[446] = char(0x80);
+    QCOMPARE(reseal(volume, table), QStringLiteral("partition table changed"));
+
+    QByteArray mounted = volume;
+    putLe<quint16>(mounted, 1024 + 0x34, 8);
+    QCOMPARE(reseal(mounted, disk), QStringLiteral("file system was mounted or written elsewhere"));
+
+    QByteArray written = volume;
+    putLe<quint64>(written, 1024 + 0x178, 8192);
+    QCOMPARE(reseal(written, disk), QStringLiteral("file system was mounted or written elsewhere"));
+
+    QByteArray dirty = volume;
+    putLe<quint16>(dirty, 1024 + 0x3A, 0);
+    QCOMPARE(reseal(dirty, disk), QStringLiteral("volume is marked dirty"));
+
+    // Inside a sampled window, with every marker left alone.
+    QByteArray content = volume;
+    const uint64_t window = EjectSealProbe::sampleOffsets(volume.size()).at(5);
+    content[static_cast<qsizetype>(window + 100)] = '\x22';
+    QCOMPARE(reseal(content, disk), QStringLiteral("sampled content changed"));
+}
+
+void TestEjectSealProbe::readErrorGivesNoSeal()
+{
+    const QByteArray disk = fat32Volume(8 * kMiB);
+    const QByteArray volume = fat32Volume(4 * kMiB);
+    const EjectSealProbe::ReadAt failing = [](uint64_t, char*, size_t) { return false; };
+    QVERIFY(EjectSealProbe::capture(failing, volume.size(), readerOf(disk)).isEmpty());
+    QVERIFY(EjectSealProbe::capture(readerOf(volume), volume.size(), failing).isEmpty());
+    // Claiming more than is there fails the last window's read.
+    QVERIFY(EjectSealProbe::capture(readerOf(volume), volume.size() * 2, readerOf(disk)).isEmpty());
+}
+
+QTEST_MAIN(TestEjectSealProbe)
+#include "test_eject_seal_probe.moc"
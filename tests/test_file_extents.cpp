@@ -0,0 +1,61 @@
+#include <QtTest>
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "FileExtents.h"
+
+using namespace FlashSpartan;
+
+class TestFileExtents : public QObject {
+    Q_OBJECT
+
+private slots:
+    void missingFileHasNoPlace();
+    void emptyFileHasNoPlace();
+    void writtenFileHasAStablePlace();
+    void missingMountIsNotSeekSensitive();
+};
+
+void TestFileExtents::missingFileHasNoPlace()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QCOMPARE(FileExtents::physicalOffset(dir.filePath(QStringLiteral("missing.bin"))), FileExtents::kUnknownOffset);
+}
+
+void TestFileExtents::emptyFileHasNoPlace()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("empty.bin"));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.close();
+    QCOMPARE(FileExtents::physicalOffset(path), FileExtents::kUnknownOffset);
+}
+
+void TestFileExtents::writtenFileHasAStablePlace()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("data.bin"));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(QByteArray(256 * 1024, 'x')), qint64(256 * 1024));
+    QVERIFY(file.flush());
+    file.close();
+
+    // Whether the file system can say depends on where the temp dir lives (tmpfs cannot);
+    // an answer, once given, must not change while the file is untouched.
+    const uint64_t first = FileExtents::physicalOffset(path);
+    QCOMPARE(FileExtents::physicalOffset(path), first);
+}
+
+void TestFileExtents::missingMountIsNotSeekSensitive()
+{
+    QVERIFY(!FileExtents::seekSensitive(QStringLiteral("/nonexistent/flashspartan-mount")));
+}
+
+QTEST_MAIN(TestFileExtents)
+#include "test_file_extents.moc"
@@ -0,0 +1,67 @@
+#include <QtTest>
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "FileReadAhead.h"
+
+using namespace FlashSpartan;
+
+class TestFileReadAhead : public QObject {
+    Q_OBJECT
+
+private slots:
+    void missingFileIsNotPrefetched();
+    void prefetchedFileReadsTheSame();
+    void sequentialHintKeepsTheContent();
+};
+
+void TestFileReadAhead::missingFileIsNotPrefetched()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QVERIFY(!FileReadAhead::prefetch(dir.filePath(QStringLiteral("missing.bin"))));
+}
+
+void TestFileReadAhead::prefetchedFileReadsTheSame()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("next.bin"));
+    const QByteArray data(300 * 1024, 'n');
+    QFile out(path);
+    QVERIFY(out.open(QIODevice::WriteOnly));
+    QCOMPARE(out.write(data), data.size());
+    out.close();
+
+#ifdef Q_OS_LINUX
+    QVERIFY(FileReadAhead::prefetch(path, data.size()));
+#else
+    QVERIFY(!FileReadAhead::prefetch(path, data.size()));
+#endif
+    QVERIFY(!FileReadAhead::prefetch(path, 0));
+
+    QFile in(path);
+    QVERIFY(in.open(QIODevice::ReadOnly));
+    QCOMPARE(in.readAll(), data);
+}
+
+void TestFileReadAhead::sequentialHintKeepsTheContent()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("seq.bin"));
+    QFile out(path);
+    QVERIFY(out.open(QIODevice::WriteOnly));
+    QCOMPARE(out.write("abcdef"), qint64(6));
+    out.close();
+
+    QFile in(path);
+    QVERIFY(in.open(QIODevice::ReadOnly));
+    FileReadAhead::sequential(in.handle());
+    FileReadAhead::sequential(-1);  // an invalid handle is ignored
+    QCOMPARE(in.readAll(), QByteArray("abcdef"));
+}
+
+QTEST_MAIN(TestFileReadAhead)
+#include "test_file_read_ahead.moc"
@@ -0,0 +1,177 @@
+#include <QtTest>
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+#include "FlightRecorder.h"
+#include "PerfMetrics.h"
+#include "PerfTrace.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+QList<FlightRecorder::Entry> ofKind(const QList<FlightRecorder::Entry>& entries, FlightRecorder::Kind kind)
+{
+    QList<FlightRecorder::Entry> out;
+    for (const FlightRecorder::Entry& e : entries) {
+        if (e.kind == kind) {
+            out.append(e);
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+class TestFlightRecorder : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init()
+    {
+        QVERIFY(m_dir.isValid());
+        QFile::remove(path());
+    }
+    void cleanup() { FlightRecorder::stop(); }
+    void keepsSlowSpansWithoutTracing();
+    void survivesAndContinuesAcrossRuns();
+    void wrapsKeepingTheNewest();
+    void samplesChangedCounters();
+    void exportsChromeTrace();
+    void rejectsOtherFiles();
+
+private:
+    QString path() const { return m_dir.filePath(QStringLiteral("flight-recorder.ring")); }
+
+    QTemporaryDir m_dir;
+};
+
+void TestFlightRecorder::keepsSlowSpansWithoutTracing()
+{
+    QVERIFY(FlightRecorder::start(path()));
+    QVERIFY(!PerfTrace::enabled());
+    QVERIFY(PerfTrace::active());
+
+    const qint64 begin = PerfTrace::nowNs();
+    PerfTrace::record("hash", "fast", begin, begin + 1000000);
+    PerfTrace::record("hash", "slow", begin, begin + FlightRecorder::kMinSpanNs, 4096);
+    FlightRecorder::event("log", QStringLiteral("disk went away"));
+
+    const QList<FlightRecorder::Entry> entries = FlightRecorder::snapshot();
+    const QList<FlightRecorder::Entry> spans = ofKind(entries, FlightRecorder::Kind::Span);
+    QCOMPARE(spans.size(), 1);
+    QCOMPARE(spans.first().label, QStringLiteral("hash/slow"));
+    QCOMPARE(spans.first().durationNs, FlightRecorder::kMinSpanNs);
+    QCOMPARE(spans.first().value, qint64(4096));
+    QVERIFY(qAbs(spans.first().wallUs / 1000 - QDateTime::currentMSecsSinceEpoch()) < 60000);
+    QCOMPARE(ofKind(entries, FlightRecorder::Kind::Event).first().label, QStringLiteral("log: disk went away"));
+    QCOMPARE(entries.first().kind, FlightRecorder::Kind::SessionStart);
+
+    FlightRecorder::stop();
+    QVERIFY(!PerfTrace::active());
+}
+
+void TestFlightRecorder::survivesAndContinuesAcrossRuns()
+{
+    QVERIFY(FlightRecorder::start(path()));
+    FlightRecorder::event("test", QStringLiteral("first run"));
+    FlightRecorder::stop();
+
+    // What a crashed run leaves is read from the file.
+    QString error;
+    QList<FlightRecorder::Entry> entries = FlightRecorder::read(path(), &error);
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+    QCOMPARE(entries.size(), 2);
+
+    QVERIFY(FlightRecorder::start(path()));
+    FlightRecorder::event("test", QStringLiteral("second run"));
+    entries = FlightRecorder::snapshot();
+    QCOMPARE(entries.size(), 4);
+    QCOMPARE(entries.at(1).label, QStringLiteral("test: first run"));
+    QCOMPARE(entries.at(3).label, QStringLiteral("test: second run"));
+    QVERIFY(entries.at(3).sequence > entries.at(1).sequence);
+}
+
+void TestFlightRecorder::wrapsKeepingTheNewest()
+{
+    QVERIFY(FlightRecorder::start(path()));
+    const int extra = 10;
+    for (int i = 0; i < FlightRecorder::kSlots + extra; ++i) {
+        FlightRecorder::event("test", QString::number(i), i);
+    }
+    const QList<FlightRecorder::Entry> entries = FlightRecorder::snapshot();
+    QCOMPARE(entries.size(), FlightRecorder::kSlots);
+    QCOMPARE(entries.first().value, qint64(extra));
+    QCOMPARE(entries.last().value, qint64(FlightRecorder::kSlots + extra - 1));
+
+    // Labels longer than a slot are cut without splitting a character.
+    FlightRecorder::event("tests", QString(FlightRecorder::kLabelBytes, QChar(0x00E9)));
+    const QString label = FlightRecorder::snapshot().last().label;
+    QVERIFY(label.toUtf8().size() <= FlightRecorder::kLabelBytes);
+    QVERIFY(!label.contains(QChar::ReplacementCharacter));
+}
+
+void TestFlightRecorder::samplesChangedCounters()
+{
+    QVERIFY(FlightRecorder::start(path()));
+    PerfMetrics::Counter& bytes = PerfMetrics::counter("flight_test_bytes_total", "Test bytes");
+    bytes.add(100);
+    FlightRecorder::sampleCounters();
+    FlightRecorder::sampleCounters();  // unchanged: not recorded again
+    bytes.add(50);
+    FlightRecorder::sampleCounters();
+
+    QList<double> samples;
+    for (const FlightRecorder::Entry& e : ofKind(FlightRecorder::snapshot(), FlightRecorder::Kind::Counter)) {
+        if (e.label == QLatin1String("flight_test_bytes_total")) {
+            samples.append(e.sample);
+        }
+    }
+    QCOMPARE(samples, (QList<double>{100.0, 150.0}));
+}
+
+void TestFlightRecorder::exportsChromeTrace()
+{
+    QVERIFY(FlightRecorder::start(path()));
+    const qint64 begin = PerfTrace::nowNs();
+    PerfTrace::record("iso", "read", begin, begin + 2 * FlightRecorder::kMinSpanNs);
+    FlightRecorder::event("log", QStringLiteral("slow device"));
+
+    const QJsonArray events = QJsonDocument::fromJson(FlightRecorder::toTraceJson(FlightRecorder::snapshot()))
+                                  .object()
+                                  .value(QStringLiteral("traceEvents"))
+                                  .toArray();
+    QStringList phases;
+    for (const QJsonValue& v : events) {
+        const QJsonObject obj = v.toObject();
+        phases.append(obj.value(QStringLiteral("ph")).toString());
+        if (obj.value(QStringLiteral("ph")).toString() == QLatin1String("X")) {
+            QCOMPARE(obj.value(QStringLiteral("cat")).toString(), QStringLiteral("iso"));
+            QCOMPARE(obj.value(QStringLiteral("name")).toString(), QStringLiteral("read"));
+            QCOMPARE(obj.value(QStringLiteral("dur")).toDouble(), 2.0 * FlightRecorder::kMinSpanNs / 1000.0);
+        }
+    }
+    QCOMPARE(phases, (QStringList{QStringLiteral("M"), QStringLiteral("i"), QStringLiteral("X"), QStringLiteral("i")}));
+}
+
+void TestFlightRecorder::rejectsOtherFiles()
+{
+    QFile other(path());
+    QVERIFY(other.open(QIODevice::WriteOnly));
+    other.write("not a ring");
+    other.close();
+
+    QString error;
+    QVERIFY(FlightRecorder::read(path(), &error).isEmpty());
+    QVERIFY(!error.isEmpty());
+
+    // Starting on it replaces it with an empty ring.
+    QVERIFY(FlightRecorder::start(path()));
+    QCOMPARE(FlightRecorder::snapshot().size(), 1);
+}
+
+QTEST_MAIN(TestFlightRecorder)
+#include "test_flight_recorder.moc"
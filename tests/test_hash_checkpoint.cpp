@@ -0,0 +1,153 @@
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "HashCheckpoint.h"
+
+using namespace FlashSpartan;
+
+class TestHashCheckpoint : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void appendsAndReadsBack();
+    void ignoresTornLastRecord();
+    void rewritesWhenProgressRewinds();
+    void keepsStorageIdentity();
+    void followsDeviceToNewNode();
+};
+
+namespace {
+
+HashCheckpoint makeCheckpoint(int blocks)
+{
+    HashCheckpoint cp;
+    cp.deviceNode = QStringLiteral("/dev/sdz1");
+    cp.algorithm = QStringLiteral("SHA256");
+    cp.scanMode = QStringLiteral("full");
+    cp.blockSize = 64ULL * 1024 * 1024;
+    cp.deviceSize = 10 * cp.blockSize + 4096;
+    for (int i = 0; i < blocks; ++i) {
+        cp.blockHashes.append(QString::fromLatin1(
+            QCryptographicHash::hash(QByteArray::number(i), QCryptographicHash::Sha256).toHex()));
+    }
+    cp.bytesCompleted = qMin(cp.deviceSize, static_cast<uint64_t>(blocks) * cp.blockSize);
+    return cp;
+}
+
+} // namespace
+
+void TestHashCheckpoint::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    HashCheckpointStore::instance().clearAll();
+}
+
+void TestHashCheckpoint::appendsAndReadsBack()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("cp.log"));
+
+    HashCheckpointLog log;
+    QVERIFY(log.update(path, makeCheckpoint(2)));
+    const qint64 afterTwo = QFileInfo(path).size();
+    QVERIFY(log.update(path, makeCheckpoint(6)));
+    QCOMPARE(QFileInfo(path).size(), afterTwo + 4 * 32);  // raw SHA-256 bytes only
+    log.close();
+
+    const auto read = HashCheckpointLog::read(path);
+    QVERIFY(read.has_value());
+    const HashCheckpoint expected = makeCheckpoint(6);
+    QCOMPARE(read->blockHashes, expected.blockHashes);
+    QCOMPARE(read->bytesCompleted, expected.bytesCompleted);
+    QCOMPARE(read->deviceSize, expected.deviceSize);
+    QCOMPARE(read->deviceNode, expected.deviceNode);
+}
+
+void TestHashCheckpoint::ignoresTornLastRecord()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("cp.log"));
+    QVERIFY(HashCheckpointLog::write(path, makeCheckpoint(10)));
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::Append));
+    QCOMPARE(file.write("\x01\x02\x03", 3), qint64(3));
+    file.close();
+
+    const auto read = HashCheckpointLog::read(path);
+    QVERIFY(read.has_value());
+    QCOMPARE(read->blockHashes.size(), 10);
+    QCOMPARE(read->bytesCompleted, read->deviceSize);
+}
+
+void TestHashCheckpoint::rewritesWhenProgressRewinds()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("cp.log"));
+
+    HashCheckpointLog log;
+    QVERIFY(log.update(path, makeCheckpoint(8)));
+    QVERIFY(log.update(path, makeCheckpoint(3)));
+    log.close();
+    const auto read = HashCheckpointLog::read(path);
+    QVERIFY(read.has_value());
+    QCOMPARE(read->blockHashes, makeCheckpoint(3).blockHashes);
+}
+
+void TestHashCheckpoint::keepsStorageIdentity()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("cp.log"));
+    HashCheckpoint cp = makeCheckpoint(4);
+    cp.storageId = QStringLiteral("usb-SanDisk_Ultra_4C530001-0:0#part1");
+    cp.layoutFingerprint = QStringLiteral("0123456789abcdef");
+
+    HashCheckpointLog log;
+    QVERIFY(log.update(path, cp));
+    log.close();
+    const auto read = HashCheckpointLog::read(path);
+    QVERIFY(read.has_value());
+    QCOMPARE(read->storageId, cp.storageId);
+    QCOMPARE(read->layoutFingerprint, cp.layoutFingerprint);
+    QCOMPARE(read->blockHashes, cp.blockHashes);
+}
+
+void TestHashCheckpoint::followsDeviceToNewNode()
+{
+    HashCheckpointStore& store = HashCheckpointStore::instance();
+    HashCheckpoint cp = makeCheckpoint(8);
+    cp.storageId = QStringLiteral("usb-SanDisk_Ultra_4C530001-0:0#part1");
+    cp.layoutFingerprint = QStringLiteral("0123456789abcdef");
+    store.upsert(cp);
+    store.load();
+
+    // Replugged as sdy: found by identity, under the new node.
+    const auto moved = store.checkpointFor(QStringLiteral("/dev/sdy1"), cp.algorithm, cp.scanMode,
+                                           cp.storageId, cp.layoutFingerprint);
+    QVERIFY(moved.has_value());
+    QCOMPARE(moved->deviceNode, QStringLiteral("/dev/sdy1"));
+    QCOMPARE(moved->blockHashes, cp.blockHashes);
+
+    // Repartitioned, or another stick that now sits at the old node.
+    QVERIFY(!store.checkpointFor(QStringLiteral("/dev/sdy1"), cp.algorithm, cp.scanMode, cp.storageId,
+                                 QStringLiteral("fedcba9876543210"))
+                 .has_value());
+    QVERIFY(!store.checkpointFor(cp.deviceNode, cp.algorithm, cp.scanMode,
+                                 QStringLiteral("usb-Kingston_DT_0019E000-0:0#part1"), cp.layoutFingerprint)
+                 .has_value());
+    // Callers without an identity still find it by node.
+    QVERIFY(store.checkpointFor(cp.deviceNode, cp.algorithm, cp.scanMode).has_value());
+
+    store.remove(*moved);
+    QVERIFY(!store.checkpointFor(QStringLiteral("/dev/sdy1"), cp.algorithm, cp.scanMode, cp.storageId,
+                                 cp.layoutFingerprint)
+                 .has_value());
+}
+
+QTEST_MAIN(TestHashCheckpoint)
+#include "test_hash_checkpoint.moc"
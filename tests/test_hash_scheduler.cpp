@@ -0,0 +1,122 @@
+#include <QtTest>
+#include "HashScheduler.h"
+
+using namespace FlashSpartan;
+
+class TestHashScheduler : public QObject {
+    Q_OBJECT
+private slots:
+    void idleControllerGoesFirst();
+    void shortestJobFirst();
+    void longestJobFirstWhenAsked();
+    void starvedJobJumpsTheQueue();
+    void limitGrowsOnlyWhileThroughputScales();
+    void pinnedLimitNeverProbes();
+};
+
+void TestHashScheduler::idleControllerGoesFirst()
+{
+    HashScheduler scheduler;
+    scheduler.setGlobalLimit(4);
+
+    // usb1 already runs one job and starts with a limit of one.
+    const QList<HashScheduler::Running> running = {{QStringLiteral("usb1"), QStringLiteral("1-1")}};
+    const QList<HashScheduler::Pending> pending = {
+        {QStringLiteral("usb1"), QStringLiteral("1-1"), 1000, 0},
+        {QStringLiteral("usb2"), QStringLiteral("2-1"), 8000, 0},
+    };
+    QCOMPARE(scheduler.pickNext(pending, running), 1);
+
+    const QList<HashScheduler::Running> both = {
+        {QStringLiteral("usb1"), QStringLiteral("1-1")},
+        {QStringLiteral("usb2"), QStringLiteral("2-1")},
+    };
+    QCOMPARE(scheduler.pickNext({pending.at(0)}, both), -1);
+}
+
+void TestHashScheduler::shortestJobFirst()
+{
+    HashScheduler scheduler;
+    scheduler.setGlobalLimit(2);
+
+    // Unknown topology: only the global limit applies.
+    const QList<HashScheduler::Pending> pending = {
+        {QString(), QString(), 64ULL << 30, 0},
+        {QString(), QString(), 16ULL << 20, 0},
+        {QString(), QString(), 8ULL << 30, 0},
+    };
+    QCOMPARE(scheduler.pickNext(pending, {}), 1);
+    QCOMPARE(scheduler.pickNext(pending, {{QString(), QString()}, {QString(), QString()}}), -1);
+}
+
+void TestHashScheduler::longestJobFirstWhenAsked()
+{
+    HashScheduler scheduler;
+    scheduler.setGlobalLimit(4);
+    scheduler.setOrder(HashScheduler::Order::LongestFirst);
+
+    const QList<HashScheduler::Pending> pending = {
+        {QStringLiteral("block:sdb"), QString(), 16ULL << 20, 0},
+        {QStringLiteral("block:sdb"), QString(), 6ULL << 30, 0},
+        {QStringLiteral("block:nvme0n1"), QString(), 2ULL << 30, 0},
+    };
+    QCOMPARE(scheduler.pickNext(pending, {}), 1);
+    // sdb is at its limit of one; the other drive still starts.
+    QCOMPARE(scheduler.pickNext(pending, {{QStringLiteral("block:sdb"), QString()}}), 2);
+}
+
+void TestHashScheduler::starvedJobJumpsTheQueue()
+{
+    HashScheduler scheduler;
+    const QList<HashScheduler::Pending> pending = {
+        {QString(), QString(), 16ULL << 20, 0},
+        {QString(), QString(), 64ULL << 30, HashScheduler::kStarvationMs},
+    };
+    QCOMPARE(scheduler.pickNext(pending, {}), 1);
+}
+
+void TestHashScheduler::limitGrowsOnlyWhileThroughputScales()
+{
+    HashScheduler scheduler;
+    scheduler.setGlobalLimit(4);
+    const QString usb = QStringLiteral("usb3");
+    QCOMPARE(scheduler.controllerLimit(usb), 1);
+
+    bool changed = false;
+    for (int i = 0; i < HashScheduler::kMinSamples; ++i) {
+        changed = scheduler.recordThroughput(usb, 1, 40.0);
+    }
+    QVERIFY(changed);
+    QCOMPARE(scheduler.controllerLimit(usb), 2);
+
+    // Two jobs nearly double throughput: probe a third.
+    for (int i = 0; i < HashScheduler::kMinSamples; ++i) {
+        scheduler.recordThroughput(usb, 2, 75.0);
+    }
+    QCOMPARE(scheduler.controllerLimit(usb), 3);
+
+    // A third job only splits the same bandwidth: back off and stay there.
+    for (int i = 0; i < HashScheduler::kMinSamples; ++i) {
+        scheduler.recordThroughput(usb, 3, 76.0);
+    }
+    QCOMPARE(scheduler.controllerLimit(usb), 2);
+    for (int i = 0; i < HashScheduler::kMinSamples; ++i) {
+        scheduler.recordThroughput(usb, 2, 75.0);
+    }
+    QCOMPARE(scheduler.controllerLimit(usb), 2);
+}
+
+void TestHashScheduler::pinnedLimitNeverProbes()
+{
+    HashScheduler scheduler;
+    scheduler.setGlobalLimit(4);
+    const QString stick = QStringLiteral("volume:/dev/sdc1");
+    scheduler.pinLimit(stick, 1);
+    for (int i = 0; i < 2 * HashScheduler::kMinSamples; ++i) {
+        QVERIFY(!scheduler.recordThroughput(stick, 1, 30.0));
+    }
+    QCOMPARE(scheduler.controllerLimit(stick), 1);
+}
+
+QTEST_MAIN(TestHashScheduler)
+#include "test_hash_scheduler.moc"
@@ -0,0 +1,93 @@
+#include <QtTest>
+#include <QSignalSpy>
+#include <QStandardPaths>
+
+#include "HashWorker.h"
+
+using namespace FlashSpartan;
+
+class TestHashWorker : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void preemptedFullReadIsRequeued();
+    void cancelDuringPreemptIsNotRequeued();
+};
+
+namespace {
+
+// /dev/null is refused as a disk, so each read fails at once; the finish is only
+// handled once the event loop runs, which leaves the job in its slot until then.
+HashWorker::HashJob jobFor(HashScanMode mode)
+{
+    HashWorker::HashJob job;
+    job.deviceNode = QStringLiteral("/dev/null");
+    job.scanMode = mode;
+    return job;
+}
+
+QStringList startedIds(const QSignalSpy& spy)
+{
+    QStringList ids;
+    for (const QList<QVariant>& args : spy) {
+        ids.append(args.at(0).toString());
+    }
+    return ids;
+}
+
+} // namespace
+
+void TestHashWorker::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void TestHashWorker::preemptedFullReadIsRequeued()
+{
+    HashWorker worker;
+    worker.setMaxConcurrent(1);
+    QSignalSpy started(&worker, &HashWorker::hashStarted);
+    QSignalSpy preempted(&worker, &HashWorker::hashPreempted);
+    QSignalSpy cancelled(&worker, &HashWorker::hashCancelled);
+    QSignalSpy failed(&worker, &HashWorker::hashFailed);
+
+    const QString fullId = worker.startHash(jobFor(HashScanMode::Full));
+    QVERIFY(worker.isRunning(fullId));
+    const QString quickId = worker.startHash(jobFor(HashScanMode::QuickSample));
+    QVERIFY(!worker.isRunning(quickId));
+
+    QTRY_COMPARE(failed.count(), 2);
+    QCOMPARE(preempted.count(), 1);
+    QCOMPARE(preempted.at(0).at(0).toString(), fullId);
+    QCOMPARE(cancelled.count(), 0);
+    // The quick check takes the slot, then the full read runs again under its old id.
+    QCOMPARE(startedIds(started), QStringList({fullId, quickId, fullId}));
+    QVERIFY(!worker.hasActiveJobs());
+}
+
+void TestHashWorker::cancelDuringPreemptIsNotRequeued()
+{
+    HashWorker worker;
+    worker.setMaxConcurrent(1);
+    QSignalSpy started(&worker, &HashWorker::hashStarted);
+    QSignalSpy preempted(&worker, &HashWorker::hashPreempted);
+    QSignalSpy cancelled(&worker, &HashWorker::hashCancelled);
+    QSignalSpy failed(&worker, &HashWorker::hashFailed);
+
+    const QString fullId = worker.startHash(jobFor(HashScanMode::Full));
+    const QString quickId = worker.startHash(jobFor(HashScanMode::QuickSample));
+    // The full read is already stopping for the quick check when the user cancels it.
+    QVERIFY(worker.cancelHash(fullId));
+
+    QTRY_COMPARE(cancelled.count(), 1);
+    QCOMPARE(cancelled.at(0).at(0).toString(), fullId);
+    QTRY_COMPARE(failed.count(), 1);
+    QCOMPARE(failed.at(0).at(0).toString(), quickId);
+    QCOMPARE(preempted.count(), 0);
+    QCOMPARE(startedIds(started), QStringList({fullId, quickId}));
+    QVERIFY(!worker.hasActiveJobs());
+}
+
+QTEST_MAIN(TestHashWorker)
+#include "test_hash_worker.moc"
@@ -0,0 +1,112 @@
+#include <QtTest>
+
+#include "HeadlessPlan.h"
+
+using namespace FlashSpartan;
+
+class TestHeadlessPlan : public QObject {
+    Q_OBJECT
+
+private slots:
+    void blockedDrivesAreNeitherVerifiedNorScanned();
+    void newDrivesOnlyGetTheIsoScan();
+    void knownDrivesFollowTheirProfile();
+    void mountedFullPartitionDrivesAreSkipped();
+    void autoHashOffLeavesKnownDrivesAlone();
+    void isoScanOnChangeOnlyForNewMounts();
+};
+
+namespace {
+
+DeviceInfo stick(bool mounted)
+{
+    DeviceInfo device;
+    device.deviceNode = QStringLiteral("/dev/sdb1");
+    device.parentDevice = QStringLiteral("sdb");
+    device.isMounted = mounted;
+    if (mounted) {
+        device.mountPoint = QStringLiteral("/media/user/STICK");
+    }
+    return device;
+}
+
+DeviceRecord recordWith(VerificationProfile profile, const QString& hash)
+{
+    DeviceRecord record;
+    record.verificationProfile = profile;
+    record.hash = hash;
+    return record;
+}
+
+} // namespace
+
+void TestHeadlessPlan::blockedDrivesAreNeitherVerifiedNorScanned()
+{
+    const DeviceRecord record = recordWith(VerificationProfile::FullPartition, QStringLiteral("abc"));
+    const HeadlessPlan::ConnectPlan plan = HeadlessPlan::onConnect(stick(true), true, &record, true);
+    QCOMPARE(plan.verdict, QStringLiteral("blocked"));
+    QCOMPARE(plan.verify, HeadlessPlan::Verify::None);
+    QVERIFY(!plan.scanIsos);
+}
+
+void TestHeadlessPlan::newDrivesOnlyGetTheIsoScan()
+{
+    const HeadlessPlan::ConnectPlan plan = HeadlessPlan::onConnect(stick(true), false, nullptr, true);
+    QCOMPARE(plan.verdict, QStringLiteral("new"));
+    QCOMPARE(plan.verify, HeadlessPlan::Verify::None);
+    QVERIFY(plan.scanIsos);
+}
+
+void TestHeadlessPlan::knownDrivesFollowTheirProfile()
+{
+    // Watch-manifest and hybrid records verify their manifest, mounted or not.
+    for (const VerificationProfile profile : {VerificationProfile::WatchManifest, VerificationProfile::Hybrid}) {
+        const DeviceRecord record = recordWith(profile, {});
+        for (const bool mounted : {true, false}) {
+            const HeadlessPlan::ConnectPlan plan = HeadlessPlan::onConnect(stick(mounted), false, &record, true);
+            QCOMPARE(plan.verdict, QStringLiteral("known"));
+            QCOMPARE(plan.verify, HeadlessPlan::Verify::WatchManifest);
+            QVERIFY(plan.scanIsos);
+        }
+    }
+
+    const DeviceRecord full = recordWith(VerificationProfile::FullPartition, QStringLiteral("abc"));
+    QCOMPARE(HeadlessPlan::onConnect(stick(false), false, &full, true).verify, HeadlessPlan::Verify::FullHash);
+
+    const DeviceRecord noBaseline = recordWith(VerificationProfile::FullPartition, {});
+    const HeadlessPlan::ConnectPlan skipped = HeadlessPlan::onConnect(stick(false), false, &noBaseline, true);
+    QCOMPARE(skipped.verify, HeadlessPlan::Verify::Skip);
+    QCOMPARE(skipped.skipReason, QStringLiteral("No baseline hash"));
+}
+
+void TestHeadlessPlan::mountedFullPartitionDrivesAreSkipped()
+{
+    // Unattended runs never unmount for a raw read.
+    const DeviceRecord record = recordWith(VerificationProfile::FullPartition, QStringLiteral("abc"));
+    const HeadlessPlan::ConnectPlan plan = HeadlessPlan::onConnect(stick(true), false, &record, true);
+    QCOMPARE(plan.verdict, QStringLiteral("known"));
+    QCOMPARE(plan.verify, HeadlessPlan::Verify::Skip);
+    QVERIFY(plan.skipReason.startsWith(QStringLiteral("Mounted")));
+    QVERIFY(plan.scanIsos);
+}
+
+void TestHeadlessPlan::autoHashOffLeavesKnownDrivesAlone()
+{
+    const DeviceRecord record = recordWith(VerificationProfile::FullPartition, QStringLiteral("abc"));
+    const HeadlessPlan::ConnectPlan plan = HeadlessPlan::onConnect(stick(false), false, &record, false);
+    QCOMPARE(plan.verdict, QStringLiteral("known"));
+    QCOMPARE(plan.verify, HeadlessPlan::Verify::None);
+    QVERIFY(plan.scanIsos);
+}
+
+void TestHeadlessPlan::isoScanOnChangeOnlyForNewMounts()
+{
+    QVERIFY(HeadlessPlan::scanIsosOnChange(stick(false), stick(true), QStringLiteral("known")));
+    QVERIFY(HeadlessPlan::scanIsosOnChange(stick(false), stick(true), QStringLiteral("new")));
+    QVERIFY(!HeadlessPlan::scanIsosOnChange(stick(false), stick(true), QStringLiteral("blocked")));
+    QVERIFY(!HeadlessPlan::scanIsosOnChange(stick(true), stick(true), QStringLiteral("known")));
+    QVERIFY(!HeadlessPlan::scanIsosOnChange(stick(true), stick(false), QStringLiteral("known")));
+}
+
+QTEST_MAIN(TestHeadlessPlan)
+#include "test_headless_plan.moc"
@@ -0,0 +1,148 @@
+#include <QtTest>
+#include "HelperProtocol.h"
+
+using namespace FlashSpartan;
+namespace Proto = FlashSpartan::HelperProtocol;
+
+class TestHelperProtocol : public QObject {
+    Q_OBJECT
+private slots:
+    void framesSurvivePartialReads();
+    void malformedHeaderIsRejected();
+    void jobRoundTrip();
+    void resultRoundTrip();
+    void deviceFdRoundTrip();
+};
+
+void TestHelperProtocol::framesSurvivePartialReads()
+{
+    const QByteArray stream = Proto::encodeFrame(Proto::FrameType::Hello, Proto::encodeHello())
+                              + Proto::encodeFrame(Proto::FrameType::Cancel);
+
+    QByteArray buffer;
+    Proto::Frame frame;
+    QString error;
+    QVector<Proto::FrameType> seen;
+    for (char byte : stream) {
+        buffer.append(byte);
+        while (Proto::takeFrame(buffer, &frame, &error)) {
+            seen.push_back(frame.type);
+        }
+        QVERIFY(error.isEmpty());
+    }
+    QCOMPARE(seen.size(), 2);
+    QCOMPARE(seen[0], Proto::FrameType::Hello);
+    QCOMPARE(seen[1], Proto::FrameType::Cancel);
+    QVERIFY(buffer.isEmpty());
+}
+
+void TestHelperProtocol::malformedHeaderIsRejected()
+{
+    QByteArray buffer("\x7f\x00\x00\x00\x00", 5);
+    Proto::Frame frame;
+    QString error;
+    QVERIFY(!Proto::takeFrame(buffer, &frame, &error));
+    QVERIFY(!error.isEmpty());
+}
+
+void TestHelperProtocol::jobRoundTrip()
+{
+    Proto::JobRequest job;
+    job.options.deviceNode = QStringLiteral("/dev/sdz");
+    job.options.algorithm = RawDeviceHash::Algorithm::SHA512;
+    job.options.bufferSizeKB = 2048;
+    job.options.scanMode = RawDeviceHash::ScanMode::QuickSample;
+    job.options.skipZeroRegions = true;
+    job.options.stopAtFirstMismatch = true;
+    job.options.quickSample.samples = 32;
+    job.options.quickSample.sampleKB = 256;
+    job.options.quickSample.metadataHotSpots = true;
+    job.options.lengthLimit = 4700000256ull;
+    job.expectedBlockHashes = {QStringLiteral("aa"), QStringLiteral("bb")};
+    job.useCheckpoint = true;
+    job.checkpoint.deviceNode = job.options.deviceNode;
+    job.checkpoint.blockHashes = {QStringLiteral("aa")};
+    job.checkpoint.bytesCompleted = 64ull * 1024 * 1024;
+
+    Proto::JobRequest decoded;
+    QVERIFY(Proto::decodeJob(Proto::encodeJob(job), &decoded));
+    QCOMPARE(decoded.options.deviceNode, job.options.deviceNode);
+    QCOMPARE(decoded.options.algorithm, RawDeviceHash::Algorithm::SHA512);
+    QCOMPARE(decoded.options.bufferSizeKB, 2048);
+    QCOMPARE(decoded.options.scanMode, RawDeviceHash::ScanMode::QuickSample);
+    QVERIFY(decoded.options.skipZeroRegions);
+    QVERIFY(decoded.options.stopAtFirstMismatch);
+    QCOMPARE(decoded.options.quickSample.samples, 32);
+    QCOMPARE(decoded.options.quickSample.sampleKB, 256);
+    QVERIFY(decoded.options.quickSample.metadataHotSpots);
+    QCOMPARE(decoded.options.lengthLimit, job.options.lengthLimit);
+    QCOMPARE(decoded.expectedBlockHashes, job.expectedBlockHashes);
+    QVERIFY(decoded.useCheckpoint);
+    QCOMPARE(decoded.checkpoint.blockHashes, job.checkpoint.blockHashes);
+    QCOMPARE(decoded.checkpoint.bytesCompleted, job.checkpoint.bytesCompleted);
+
+    QVERIFY(!Proto::decodeJob(QByteArray("\x01", 1), &decoded));
+}
+
+void TestHelperProtocol::resultRoundTrip()
+{
+    Proto::JobResult reply;
+    reply.result.success = true;
+    reply.result.hash = QStringLiteral("deadbeef");
+    reply.result.algorithm = QStringLiteral("SHA-256");
+    reply.result.bytesProcessed = 128ull * 1024 * 1024;
+    reply.result.blockHashes = {QStringLiteral("0011"), QStringLiteral("2233")};
+    reply.result.blockSize = 64ull * 1024 * 1024;
+    reply.result.stoppedAtBlock = 1;
+    reply.result.performance.engine = QStringLiteral("io_uring");
+    reply.result.performance.bufferSizeKB = 1024;
+    reply.result.performance.queueDepth = 8;
+    reply.result.performance.ioWaitMs = 900;
+    reply.result.performance.cpuMs = 300;
+    reply.result.performance.readRetries = 2;
+    reply.result.performance.blockMsMax = 4100;
+    reply.result.performance.slowestBlock = 1;
+
+    Proto::JobResult decoded;
+    QVERIFY(Proto::decodeResult(Proto::encodeResult(reply), &decoded));
+    QVERIFY(decoded.result.success);
+    QCOMPARE(decoded.result.hash, reply.result.hash);
+    QCOMPARE(decoded.result.bytesProcessed, reply.result.bytesProcessed);
+    QCOMPARE(decoded.result.blockHashes, reply.result.blockHashes);
+    QCOMPARE(decoded.result.blockSize, reply.result.blockSize);
+    QCOMPARE(decoded.result.stoppedAtBlock, qint64(1));
+    QVERIFY(!decoded.hasCheckpoint);
+    QCOMPARE(decoded.result.performance.engine, QStringLiteral("io_uring"));
+    QCOMPARE(decoded.result.performance.queueDepth, 8);
+    QCOMPARE(decoded.result.performance.ioWaitMs, uint64_t(900));
+    QCOMPARE(decoded.result.performance.cpuMs, uint64_t(300));
+    QCOMPARE(decoded.result.performance.readRetries, 2);
+    QCOMPARE(decoded.result.performance.blockMsMax, uint64_t(4100));
+    QCOMPARE(decoded.result.performance.slowestBlock, qint64(1));
+
+    Proto::BlockDigest block;
+    QVERIFY(Proto::decodeBlock(Proto::encodeBlock({7, QStringLiteral("a1b2")}), &block));
+    QCOMPARE(block.index, uint64_t(7));
+    QCOMPARE(block.hex, QStringLiteral("a1b2"));
+}
+
+void TestHelperProtocol::deviceFdRoundTrip()
+{
+    QByteArray buffer = Proto::encodeFrame(Proto::FrameType::OpenDevice,
+                                           Proto::encodeOpenDevice(QStringLiteral("/dev/sdz1")));
+    Proto::Frame frame;
+    QVERIFY(Proto::takeFrame(buffer, &frame));
+    QCOMPARE(frame.type, Proto::FrameType::OpenDevice);
+    QString node;
+    QVERIFY(Proto::decodeOpenDevice(frame.payload, &node));
+    QCOMPARE(node, QStringLiteral("/dev/sdz1"));
+
+    QString message = QStringLiteral("unset");
+    QVERIFY(Proto::decodeDeviceFd(Proto::encodeDeviceFd(QString()), &message));
+    QVERIFY(message.isEmpty());
+    QVERIFY(Proto::decodeDeviceFd(Proto::encodeDeviceFd(QStringLiteral("Permission denied")), &message));
+    QCOMPARE(message, QStringLiteral("Permission denied"));
+}
+
+QTEST_MAIN(TestHelperProtocol)
+#include "test_helper_protocol.moc"
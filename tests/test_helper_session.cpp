@@ -0,0 +1,263 @@
+#include <QtTest>
+#include <QTemporaryFile>
+
+#include "HelperSession.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+using namespace FlashSpartan;
+
+class TestHelperSession : public QObject {
+    Q_OBJECT
+
+private slots:
+    void openDevicePassesTheDescriptor();
+    void openDeviceReportsTheRefusal();
+    void runForwardsProgressBlocksAndResult();
+    void helperExitEndsTheSession();
+};
+
+namespace {
+
+const HelperSession::Limits kReusable{HelperSession::kReusableMaxDevices, HelperSession::kReusableMaxSeconds};
+
+bool sendAll(int fd, const QByteArray& data)
+{
+    qsizetype sent = 0;
+    while (sent < data.size()) {
+        const ssize_t n = send(fd, data.constData() + sent, size_t(data.size() - sent), MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += n;
+    }
+    return true;
+}
+
+bool sendFrame(int fd, HelperProtocol::FrameType type, const QByteArray& payload = {})
+{
+    return sendAll(fd, HelperProtocol::encodeFrame(type, payload));
+}
+
+/** Like the helper: the fd rides on the DeviceFd frame's first byte. */
+bool sendDeviceFd(int socket, int fd)
+{
+    const QByteArray frame = HelperProtocol::encodeFrame(HelperProtocol::FrameType::DeviceFd,
+                                                         HelperProtocol::encodeDeviceFd(QString()));
+    iovec iov{const_cast<char*>(frame.constData()), 1};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    std::memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    return sendmsg(socket, &msg, MSG_NOSIGNAL) == 1 && sendAll(socket, frame.mid(1));
+}
+
+bool readFrame(int fd, QByteArray& inbox, HelperProtocol::Frame* out)
+{
+    for (;;) {
+        QString error;
+        if (HelperProtocol::takeFrame(inbox, out, &error)) {
+            return true;
+        }
+        if (!error.isEmpty()) {
+            return false;
+        }
+        char chunk[4096];
+        const ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        inbox.append(chunk, n);
+    }
+}
+
+/**
+ * Plays the helper's end of a socketpair on its own thread: sends Hello, then hands each
+ * frame from the session to @p answer until it returns false. Closes its end when done.
+ */
+class FakeHelper {
+public:
+    using Answer = std::function<bool(int socket, const HelperProtocol::Frame& frame)>;
+
+    explicit FakeHelper(Answer answer)
+    {
+        int sv[2] = {-1, -1};
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+            return;
+        }
+        hostSocket = sv[0];
+        m_thread = std::thread([socket = sv[1], answer = std::move(answer)]() {
+            QByteArray inbox;
+            HelperProtocol::Frame frame;
+            if (sendFrame(socket, HelperProtocol::FrameType::Hello, HelperProtocol::encodeHello())) {
+                while (readFrame(socket, inbox, &frame) && answer(socket, frame)) {
+                }
+            }
+            close(socket);
+        });
+    }
+
+    ~FakeHelper()
+    {
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    int hostSocket = -1;
+
+private:
+    std::thread m_thread;
+};
+
+} // namespace
+
+void TestHelperSession::openDevicePassesTheDescriptor()
+{
+    QTemporaryFile device;
+    QVERIFY(device.open());
+    QVERIFY(device.write("raw sectors") == 11);
+    QVERIFY(device.flush());
+    const int deviceFd = device.handle();
+
+    QString requested;
+    FakeHelper helper([&](int socket, const HelperProtocol::Frame& frame) {
+        if (frame.type != HelperProtocol::FrameType::OpenDevice
+            || !HelperProtocol::decodeOpenDevice(frame.payload, &requested)) {
+            return false;
+        }
+        return sendDeviceFd(socket, deviceFd);
+    });
+    QVERIFY(helper.hostSocket >= 0);
+
+    std::unique_ptr<HelperSession> session = HelperSession::adopt(helper.hostSocket, kReusable);
+    QString error;
+    const int fd = session->openDevice(QStringLiteral("/dev/sdz"), nullptr, &error);
+    QVERIFY2(fd >= 0, qPrintable(error));
+    QCOMPARE(requested, QStringLiteral("/dev/sdz"));
+    QVERIFY(session->answered());
+
+    // A separate descriptor for the same open file.
+    QVERIFY(fd != deviceFd);
+    char buf[16] = {};
+    QCOMPARE(pread(fd, buf, sizeof(buf), 0), ssize_t(11));
+    QCOMPARE(QByteArray(buf, 11), QByteArrayLiteral("raw sectors"));
+    close(fd);
+
+    // No process of its own, so nothing to reap; the session stays reusable.
+    QVERIFY(!session->reapIfExited());
+    QVERIFY(session->accepts(QStringLiteral("/dev/sdz")));
+}
+
+void TestHelperSession::openDeviceReportsTheRefusal()
+{
+    FakeHelper helper([](int socket, const HelperProtocol::Frame& frame) {
+        if (frame.type != HelperProtocol::FrameType::OpenDevice) {
+            return false;
+        }
+        sendFrame(socket, HelperProtocol::FrameType::DeviceFd,
+                  HelperProtocol::encodeDeviceFd(QStringLiteral("/dev/sda holds the root filesystem")));
+        return true;
+    });
+    QVERIFY(helper.hostSocket >= 0);
+
+    std::unique_ptr<HelperSession> session = HelperSession::adopt(helper.hostSocket, kReusable);
+    QString error;
+    QCOMPARE(session->openDevice(QStringLiteral("/dev/sda"), nullptr, &error), -1);
+    QCOMPARE(error, QStringLiteral("/dev/sda holds the root filesystem"));
+    // A refusal leaves the helper waiting for the next job.
+    QVERIFY(session->connected());
+    QVERIFY(session->accepts(QStringLiteral("/dev/sdb")));
+}
+
+void TestHelperSession::runForwardsProgressBlocksAndResult()
+{
+    QString jobDevice;
+    FakeHelper helper([&](int socket, const HelperProtocol::Frame& frame) {
+        HelperProtocol::JobRequest job;
+        if (frame.type != HelperProtocol::FrameType::Job || !HelperProtocol::decodeJob(frame.payload, &job)) {
+            return false;
+        }
+        jobDevice = job.options.deviceNode;
+        HelperProtocol::ProgressUpdate progress;
+        progress.bytesProcessed = 4096;
+        progress.totalBytes = 8192;
+        HelperProtocol::BlockDigest block;
+        block.index = 3;
+        block.hex = QStringLiteral("00ff");
+        HelperProtocol::JobResult reply;
+        reply.result.deviceNode = job.options.deviceNode;
+        reply.result.hash = QStringLiteral("c0ffee");
+        reply.result.bytesProcessed = 8192;
+        reply.result.success = true;
+        return sendFrame(socket, HelperProtocol::FrameType::Progress, HelperProtocol::encodeProgress(progress))
+               && sendFrame(socket, HelperProtocol::FrameType::Block, HelperProtocol::encodeBlock(block))
+               && sendFrame(socket, HelperProtocol::FrameType::Result, HelperProtocol::encodeResult(reply));
+    });
+    QVERIFY(helper.hostSocket >= 0);
+
+    std::unique_ptr<HelperSession> session = HelperSession::adopt(helper.hostSocket, kReusable);
+    std::atomic<uint64_t> processed{0};
+    std::atomic<uint64_t> total{0};
+    QList<QPair<uint64_t, QString>> blocks;
+    RawDeviceHash::Options options;
+    options.deviceNode = QStringLiteral("/dev/sdz");
+    options.bytesProcessed = &processed;
+    options.totalBytes = &total;
+    options.blockHashed = [&](uint64_t index, const QString& hex) { blocks.append({index, hex}); };
+
+    QString error;
+    const std::optional<HelperProtocol::JobResult> reply = session->run(options, &error);
+    QVERIFY2(reply.has_value(), qPrintable(error));
+    QVERIFY(reply->result.success);
+    QCOMPARE(reply->result.hash, QStringLiteral("c0ffee"));
+    QCOMPARE(reply->result.deviceNode, QStringLiteral("/dev/sdz"));
+    QCOMPARE(jobDevice, QStringLiteral("/dev/sdz"));
+    QCOMPARE(processed.load(), uint64_t(4096));
+    QCOMPARE(total.load(), uint64_t(8192));
+    QCOMPARE(blocks.size(), 1);
+    QCOMPARE(blocks.at(0).first, uint64_t(3));
+    QCOMPARE(blocks.at(0).second, QStringLiteral("00ff"));
+    // Reusable: still connected and counting the device against its limit.
+    QVERIFY(session->connected());
+    QVERIFY(session->accepts(QStringLiteral("/dev/sdz")));
+}
+
+void TestHelperSession::helperExitEndsTheSession()
+{
+    // The helper goes away without answering the job.
+    FakeHelper helper([](int, const HelperProtocol::Frame&) { return false; });
+    QVERIFY(helper.hostSocket >= 0);
+
+    std::unique_ptr<HelperSession> session = HelperSession::adopt(helper.hostSocket, kReusable);
+    RawDeviceHash::Options options;
+    options.deviceNode = QStringLiteral("/dev/sdz");
+    QString error;
+    QVERIFY(!session->run(options, &error).has_value());
+    QVERIFY(error.startsWith(QStringLiteral("Privileged hash failed")));
+    QVERIFY(!session->answered());
+    QVERIFY(!session->connected());
+    QVERIFY(!session->accepts(QStringLiteral("/dev/sdz")));
+}
+
+QTEST_MAIN(TestHelperSession)
+#include "test_helper_session.moc"
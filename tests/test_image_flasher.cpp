@@ -0,0 +1,127 @@
+#include <QtTest>
+#include "ImageFlasher.h"
+
+#include <QTemporaryDir>
+#include <QTemporaryFile>
+
+using namespace FlashSpartan;
+
+class TestImageFlasher : public QObject {
+    Q_OBJECT
+private slots:
+    void refusesCompressedImages();
+    void refusesNodesOutsideDev();
+    void refusesPartitions();
+    void refusesTargetsSmallerThanTheImage();
+    void refusesSystemAndFixedDisks();
+};
+
+namespace {
+
+RawDeviceHash::DeviceAttachment usbStick(uint64_t sizeBytes)
+{
+    RawDeviceHash::DeviceAttachment stick;
+    stick.known = true;
+    stick.disk = QStringLiteral("sdb");
+    stick.usb = true;
+    stick.sizeBytes = sizeBytes;
+    return stick;
+}
+
+ImageFlasher::Options optionsFor(const QString& imagePath, const QString& deviceNode = QStringLiteral("/dev/sdb"))
+{
+    ImageFlasher::Options options;
+    options.imagePath = imagePath;
+    options.deviceNode = deviceNode;
+    return options;
+}
+
+} // namespace
+
+void TestImageFlasher::refusesCompressedImages()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString image = dir.filePath(QStringLiteral("debian.iso.xz"));
+    QFile file(image);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QVERIFY(file.write(QByteArray(4096, 'x')) == 4096);
+    file.close();
+
+    QVERIFY(ImageFlasher::isCompressedImage(image));
+    QVERIFY(ImageFlasher::isCompressedImage(QStringLiteral("ubuntu.img.ZST")));
+    QVERIFY(!ImageFlasher::isCompressedImage(QStringLiteral("ubuntu.img")));
+
+    // Refused before the target is even looked at.
+    const ImageFlasher::Result r = ImageFlasher::flash(optionsFor(image, QStringLiteral("/dev/null")));
+    QVERIFY(!r.success);
+    QVERIFY2(r.errorMessage.contains(QStringLiteral("compressed")), qPrintable(r.errorMessage));
+    QVERIFY(r.blockHashes.isEmpty());
+    QVERIFY(ImageFlasher::targetRefusal(optionsFor(image), 4096, usbStick(1 << 20))
+                .contains(QStringLiteral("compressed")));
+}
+
+void TestImageFlasher::refusesNodesOutsideDev()
+{
+    QTemporaryFile image;
+    QVERIFY(image.open());
+    QVERIFY(image.write(QByteArray(4096, 'i')) == 4096);
+    QVERIFY(image.flush());
+    QTemporaryFile target;
+    QVERIFY(target.open());
+
+    const ImageFlasher::Result r = ImageFlasher::flash(optionsFor(image.fileName(), target.fileName()));
+    QVERIFY(!r.success);
+    QVERIFY2(r.errorMessage.contains(QStringLiteral("not a device node")), qPrintable(r.errorMessage));
+    QCOMPARE(target.size(), qint64(0));
+
+    // Under /dev but not a disk in /sys/class/block: refused before the open.
+    const ImageFlasher::Result null = ImageFlasher::flash(optionsFor(image.fileName(), QStringLiteral("/dev/null")));
+    QVERIFY(!null.success);
+    QVERIFY2(null.errorMessage.startsWith(QStringLiteral("Refusing to write")), qPrintable(null.errorMessage));
+}
+
+void TestImageFlasher::refusesPartitions()
+{
+    RawDeviceHash::DeviceAttachment partition = usbStick(1ULL << 30);
+    partition.isPartition = true;
+    const QString refused =
+        ImageFlasher::targetRefusal(optionsFor(QStringLiteral("debian.iso"), QStringLiteral("/dev/sdb1")), 4096,
+                                    partition);
+    QVERIFY2(refused.contains(QStringLiteral("partition")), qPrintable(refused));
+}
+
+void TestImageFlasher::refusesTargetsSmallerThanTheImage()
+{
+    const ImageFlasher::Options options = optionsFor(QStringLiteral("debian.iso"));
+    const QString refused = ImageFlasher::targetRefusal(options, 2ULL << 30, usbStick(1ULL << 30));
+    QVERIFY2(refused.contains(QStringLiteral("does not fit")), qPrintable(refused));
+    QVERIFY(ImageFlasher::targetRefusal(options, 1ULL << 30, usbStick(1ULL << 30)).isEmpty());
+    QVERIFY(!ImageFlasher::targetRefusal(options, 0, usbStick(1ULL << 30)).isEmpty());
+}
+
+void TestImageFlasher::refusesSystemAndFixedDisks()
+{
+    ImageFlasher::Options options = optionsFor(QStringLiteral("debian.iso"), QStringLiteral("/dev/sda"));
+    RawDeviceHash::DeviceAttachment fixed;
+    fixed.known = true;
+    fixed.disk = QStringLiteral("sda");
+    fixed.sizeBytes = 1ULL << 40;
+    QVERIFY(ImageFlasher::targetRefusal(options, 4096, fixed).contains(QStringLiteral("neither removable nor")));
+
+    options.allowFixedDisk = true;
+    QVERIFY(ImageFlasher::targetRefusal(options, 4096, fixed).isEmpty());
+
+    // The override never reaches the disk under "/", even when it is a USB stick.
+    RawDeviceHash::DeviceAttachment system = usbStick(1ULL << 40);
+    system.backsRoot = true;
+    QVERIFY(ImageFlasher::targetRefusal(options, 4096, system).contains(QStringLiteral("root filesystem")));
+
+    RawDeviceHash::DeviceAttachment card = fixed;
+    card.removable = true;
+    options.allowFixedDisk = false;
+    QVERIFY(ImageFlasher::targetRefusal(options, 4096, card).isEmpty());
+}
+
+QTEST_MAIN(TestImageFlasher)
+#include "test_image_flasher.moc"
@@ -0,0 +1,97 @@
+#include <QtTest>
+#include "IoBufferPool.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+using namespace FlashSpartan;
+
+class TestIoBufferPool : public QObject {
+    Q_OBJECT
+private slots:
+    void cleanup();
+    void buffersAreAlignedAndSized();
+    void returnedBuffersAreReused();
+    void idleBytesAreCapped();
+    void hugePageNamesRoundTrip();
+    void hugePageBuffersStayUsable();
+};
+
+void TestIoBufferPool::cleanup()
+{
+    IoBufferPool::setHugePages(IoBufferPool::HugePages::Off);
+    IoBufferPool::trim();
+}
+
+void TestIoBufferPool::buffersAreAlignedAndSized()
+{
+    const IoBufferPool::Buffer buffer(100 * 1000);
+    QVERIFY(buffer);
+    QCOMPARE(buffer.size(), size_t(100 * 1000));
+    QCOMPARE(reinterpret_cast<uintptr_t>(buffer.data()) % IoBufferPool::kAlignment, uintptr_t(0));
+    std::memset(buffer.data(), 0xA5, buffer.size());
+
+    const IoBufferPool::Buffer empty;
+    QVERIFY(!empty);
+}
+
+void TestIoBufferPool::returnedBuffersAreReused()
+{
+    char* first = nullptr;
+    {
+        const IoBufferPool::Buffer buffer(1024 * 1024);
+        first = buffer.data();
+    }
+    const IoBufferPool::Stats before = IoBufferPool::stats();
+    QCOMPARE(before.idleBytes, uint64_t(1024 * 1024));
+
+    // A nearby size rounds up to the same power of two and gets the idle buffer back.
+    IoBufferPool::Buffer again(1000 * 1000);
+    QCOMPARE(again.data(), first);
+    QCOMPARE(IoBufferPool::stats().reuses, before.reuses + 1);
+    QCOMPARE(IoBufferPool::stats().idleBytes, uint64_t(0));
+
+    IoBufferPool::Buffer moved = std::move(again);
+    QCOMPARE(moved.data(), first);
+    QVERIFY(!again);
+}
+
+void TestIoBufferPool::idleBytesAreCapped()
+{
+    const size_t bytes = 64 * 1024 * 1024;
+    const size_t count = IoBufferPool::kMaxIdleBytes / bytes + 2;
+    {
+        std::vector<IoBufferPool::Buffer> buffers;
+        for (size_t i = 0; i < count; ++i) {
+            buffers.emplace_back(bytes);
+            QVERIFY(buffers.back());
+        }
+    }
+    QCOMPARE(IoBufferPool::stats().idleBytes, uint64_t(IoBufferPool::kMaxIdleBytes));
+    IoBufferPool::trim();
+    QCOMPARE(IoBufferPool::stats().idleBytes, uint64_t(0));
+}
+
+void TestIoBufferPool::hugePageNamesRoundTrip()
+{
+    for (IoBufferPool::HugePages mode : {IoBufferPool::HugePages::Off, IoBufferPool::HugePages::Transparent,
+                                         IoBufferPool::HugePages::Explicit}) {
+        QCOMPARE(IoBufferPool::hugePagesFromName(IoBufferPool::hugePagesName(mode)), mode);
+    }
+    QCOMPARE(IoBufferPool::hugePagesFromName(QStringLiteral("bogus")), IoBufferPool::HugePages::Off);
+}
+
+void TestIoBufferPool::hugePageBuffersStayUsable()
+{
+    // Explicit falls back when no huge pages are reserved, so this passes on any machine.
+    IoBufferPool::setHugePages(IoBufferPool::HugePages::Explicit);
+    const IoBufferPool::Buffer buffer(4 * 1024 * 1024);
+    QVERIFY(buffer);
+    QCOMPARE(reinterpret_cast<uintptr_t>(buffer.data()) % IoBufferPool::kAlignment, uintptr_t(0));
+    std::memset(buffer.data(), 0x5A, buffer.size());
+    QCOMPARE(buffer.data()[buffer.size() - 1], char(0x5A));
+}
+
+QTEST_MAIN(TestIoBufferPool)
+#include "test_io_buffer_pool.moc"
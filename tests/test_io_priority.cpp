@@ -0,0 +1,89 @@
+#include <QtTest>
+#include "IoPriority.h"
+
+#include <QElapsedTimer>
+
+#include <atomic>
+
+using namespace FlashSpartan;
+
+class TestIoPriority : public QObject {
+    Q_OBJECT
+private slots:
+    void cleanup();
+    void uncappedReadsNeverWait();
+    void capSpacesReadsAfterTheBurst();
+    void idleTimeIsNotBanked();
+    void scopeNestsAndRestores();
+    void heldReadersLeaveOnCancel();
+};
+
+void TestIoPriority::cleanup()
+{
+    IoPriority::setHeld(false);
+    IoPriority::setBandwidthLimit(0);
+}
+
+void TestIoPriority::uncappedReadsNeverWait()
+{
+    qint64 nextFree = 0;
+    QCOMPARE(IoPriority::reserveNs(nextFree, 1'000'000'000, 64 * 1024 * 1024, 0), 0);
+    QCOMPARE(nextFree, 0);
+}
+
+void TestIoPriority::capSpacesReadsAfterTheBurst()
+{
+    constexpr qint64 mib = 1024 * 1024;
+    const qint64 now = 10'000'000'000;
+    qint64 nextFree = 0;
+    // 10 MiB/s: the first 2.5 MiB ride the burst, everything after waits its turn.
+    QCOMPARE(IoPriority::reserveNs(nextFree, now, 2 * mib, 10 * mib), 0);
+    const qint64 wait = IoPriority::reserveNs(nextFree, now, 10 * mib, 10 * mib);
+    QCOMPARE(wait, 1'000'000'000 - IoPriority::kBurstNs + 200'000'000);
+}
+
+void TestIoPriority::idleTimeIsNotBanked()
+{
+    constexpr qint64 mib = 1024 * 1024;
+    qint64 nextFree = 0;
+    // An hour idle still buys only kBurstNs of reads.
+    const qint64 now = 3600LL * 1'000'000'000;
+    QCOMPARE(IoPriority::reserveNs(nextFree, now, 10 * mib, 10 * mib), 1'000'000'000 - IoPriority::kBurstNs);
+}
+
+void TestIoPriority::scopeNestsAndRestores()
+{
+    QCOMPARE(IoPriority::current(), IoPriority::Class::Normal);
+    {
+        const IoPriority::Scope background(IoPriority::Class::Background);
+        QCOMPARE(IoPriority::current(), IoPriority::Class::Background);
+        {
+            const IoPriority::Scope again(IoPriority::Class::Background);
+            QCOMPARE(IoPriority::current(), IoPriority::Class::Background);
+        }
+        QCOMPARE(IoPriority::current(), IoPriority::Class::Background);
+        {
+            const IoPriority::Scope normal(IoPriority::Class::Normal);
+            QCOMPARE(IoPriority::current(), IoPriority::Class::Normal);
+        }
+        QCOMPARE(IoPriority::current(), IoPriority::Class::Background);
+    }
+    QCOMPARE(IoPriority::current(), IoPriority::Class::Normal);
+}
+
+void TestIoPriority::heldReadersLeaveOnCancel()
+{
+    IoPriority::setHeld(true);
+    std::atomic<bool> cancelled{false};
+    QTimer::singleShot(100, this, [&cancelled]() { cancelled.store(true); });
+    QElapsedTimer timer;
+    timer.start();
+    QThread* reader = QThread::create([&cancelled]() { IoPriority::pace(4096, &cancelled); });
+    reader->start();
+    QTRY_VERIFY_WITH_TIMEOUT(reader->isFinished(), 5000);
+    QVERIFY(timer.elapsed() >= 90);
+    delete reader;
+}
+
+QTEST_MAIN(TestIoPriority)
+#include "test_io_priority.moc"
@@ -0,0 +1,134 @@
+#include <QtTest>
+#include "IoScheduler.h"
+
+#include <QException>
+#include <QSemaphore>
+
+#include <atomic>
+
+using namespace FlashSpartan;
+
+class TestIoScheduler : public QObject {
+    Q_OBJECT
+private slots:
+    void oneTaskPerLane();
+    void priorityThenArrival();
+    void interactiveJoinsBackgroundLane();
+    void starvedTaskJumpsPriority();
+    void ioLimitHoldsTasksBack();
+    void sameLaneTasksTakeTurns();
+    void resultsAndExceptionsReachTheFuture();
+};
+
+void TestIoScheduler::oneTaskPerLane()
+{
+    IoScheduler::Load load;
+    load.lanes.insert(QStringLiteral("/dev/sdb"), {1, 0});
+    load.ioRunning = 1;
+
+    const QList<IoScheduler::Waiting> waiting = {
+        {{QStringLiteral("/dev/sdb"), IoScheduler::Priority::Normal, IoScheduler::Pool::Io}, 0},
+        {{QStringLiteral("/dev/sdc"), IoScheduler::Priority::Background, IoScheduler::Pool::Io}, 0},
+    };
+    QCOMPARE(IoScheduler::pickNext(waiting, load, 4, 4), 1);
+    QCOMPARE(IoScheduler::pickNext({waiting.at(0)}, load, 4, 4), -1);
+}
+
+void TestIoScheduler::priorityThenArrival()
+{
+    const QList<IoScheduler::Waiting> waiting = {
+        {{QStringLiteral("/dev/sdb"), IoScheduler::Priority::Background, IoScheduler::Pool::Io}, 0},
+        {{QStringLiteral("/dev/sdc"), IoScheduler::Priority::Normal, IoScheduler::Pool::Io}, 0},
+        {{QStringLiteral("/dev/sdd"), IoScheduler::Priority::Interactive, IoScheduler::Pool::Io}, 0},
+        {{QStringLiteral("/dev/sde"), IoScheduler::Priority::Interactive, IoScheduler::Pool::Io}, 0},
+    };
+    QCOMPARE(IoScheduler::pickNext(waiting, {}, 4, 4), 2);
+    QCOMPARE(IoScheduler::pickNext(waiting.mid(0, 2), {}, 4, 4), 1);
+}
+
+void TestIoScheduler::interactiveJoinsBackgroundLane()
+{
+    IoScheduler::Load background;
+    background.lanes.insert(QStringLiteral("/dev/sdb"), {1, 1});
+    background.ioRunning = 1;
+
+    const IoScheduler::Waiting interactive{
+        {QStringLiteral("/dev/sdb"), IoScheduler::Priority::Interactive, IoScheduler::Pool::Io}, 0};
+    const IoScheduler::Waiting normal{
+        {QStringLiteral("/dev/sdb"), IoScheduler::Priority::Normal, IoScheduler::Pool::Io}, 0};
+    QCOMPARE(IoScheduler::pickNext({normal, interactive}, background, 4, 4), 1);
+
+    // Not beside another interactive read, and not as a third reader.
+    IoScheduler::Load busy;
+    busy.lanes.insert(QStringLiteral("/dev/sdb"), {1, 0});
+    busy.ioRunning = 1;
+    QCOMPARE(IoScheduler::pickNext({interactive}, busy, 4, 4), -1);
+    IoScheduler::Load joined;
+    joined.lanes.insert(QStringLiteral("/dev/sdb"), {2, 2});
+    joined.ioRunning = 2;
+    QCOMPARE(IoScheduler::pickNext({interactive}, joined, 4, 4), -1);
+}
+
+void TestIoScheduler::starvedTaskJumpsPriority()
+{
+    const QList<IoScheduler::Waiting> waiting = {
+        {{QString(), IoScheduler::Priority::Interactive, IoScheduler::Pool::Io}, 0},
+        {{QString(), IoScheduler::Priority::Background, IoScheduler::Pool::Io}, IoScheduler::kStarvationMs},
+    };
+    QCOMPARE(IoScheduler::pickNext(waiting, {}, 4, 4), 1);
+}
+
+void TestIoScheduler::ioLimitHoldsTasksBack()
+{
+    IoScheduler::Load load;
+    load.ioRunning = 2;
+    const QList<IoScheduler::Waiting> waiting = {
+        {{QStringLiteral("/dev/sdb"), IoScheduler::Priority::Interactive, IoScheduler::Pool::Io}, 0},
+        {{QString(), IoScheduler::Priority::Background, IoScheduler::Pool::Cpu}, 0},
+    };
+    // The I/O pool is full; CPU work still starts.
+    QCOMPARE(IoScheduler::pickNext(waiting, load, 2, 4), 1);
+    QCOMPARE(IoScheduler::pickNext({waiting.at(0)}, load, 2, 4), -1);
+}
+
+void TestIoScheduler::sameLaneTasksTakeTurns()
+{
+    IoScheduler scheduler;
+    const IoScheduler::Task task{QStringLiteral("/dev/fake0"), IoScheduler::Priority::Normal,
+                                 IoScheduler::Pool::Io};
+    QSemaphore release;
+    std::atomic<int> inLane{0};
+    std::atomic<int> maxInLane{0};
+    const auto body = [&]() {
+        const int now = ++inLane;
+        int seen = maxInLane.load();
+        while (now > seen && !maxInLane.compare_exchange_weak(seen, now)) {
+        }
+        release.acquire();
+        --inLane;
+    };
+    QFuture<void> first = scheduler.run(task, body);
+    QFuture<void> second = scheduler.run(task, body);
+    QTRY_COMPARE(inLane.load(), 1);
+    QCOMPARE(scheduler.queuedCount(), 1);
+
+    release.release(2);
+    QVERIFY(scheduler.waitForIdle(5000));
+    QVERIFY(first.isFinished());
+    QVERIFY(second.isFinished());
+    QCOMPARE(maxInLane.load(), 1);
+}
+
+void TestIoScheduler::resultsAndExceptionsReachTheFuture()
+{
+    IoScheduler scheduler;
+    const IoScheduler::Task task{QString(), IoScheduler::Priority::Normal, IoScheduler::Pool::Cpu};
+    QFuture<int> value = scheduler.run(task, []() { return 42; });
+    QCOMPARE(value.result(), 42);
+
+    QFuture<int> failing = scheduler.run(task, []() -> int { throw QException(); });
+    QVERIFY_THROWS_EXCEPTION(QException, failing.result());
+}
+
+QTEST_MAIN(TestIoScheduler)
+#include "test_io_scheduler.moc"
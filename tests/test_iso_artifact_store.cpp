@@ -0,0 +1,104 @@
+#include <QtTest>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "IsoArtifactStore.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+const QString kSumsUrl = QStringLiteral("https://example.org/release/1.0/SHA256SUMS");
+const QString kSigUrl = QStringLiteral("https://example.org/release/1.0/SHA256SUMS.gpg");
+
+} // namespace
+
+class TestIsoArtifactStore : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void putThenLookup();
+    void sameContentSharesBlob();
+    void alteredBlobIsRejected();
+    void expiryFollowsRelease();
+
+private:
+    QTemporaryDir m_dir;
+};
+
+void TestIsoArtifactStore::init()
+{
+    QVERIFY(m_dir.isValid());
+    IsoArtifactStore::setStorageDir(m_dir.filePath(QStringLiteral("artifacts")));
+}
+
+void TestIsoArtifactStore::cleanup()
+{
+    IsoArtifactStore::clear();
+}
+
+void TestIsoArtifactStore::putThenLookup()
+{
+    QVERIFY(!IsoArtifactStore::lookup(kSumsUrl).has_value());
+    const QByteArray sums = "abc123  image.iso\n";
+    const QDateTime expires = QDateTime::currentDateTimeUtc().addSecs(3600);
+    const auto stored = IsoArtifactStore::put(kSumsUrl, sums, expires);
+    QVERIFY(stored.has_value());
+    QVERIFY(QFile::exists(stored->path));
+
+    const auto found = IsoArtifactStore::lookup(kSumsUrl);
+    QVERIFY(found.has_value());
+    QCOMPARE(found->data, sums);
+    QCOMPARE(found->path, stored->path);
+    QVERIFY(found->isFresh());
+    QVERIFY(!found->isFresh(expires.addSecs(1)));
+}
+
+void TestIsoArtifactStore::sameContentSharesBlob()
+{
+    const auto a = IsoArtifactStore::put(kSumsUrl, "same bytes", {});
+    const auto b = IsoArtifactStore::put(kSigUrl, "same bytes", {});
+    QVERIFY(a.has_value() && b.has_value());
+    QCOMPARE(a->path, b->path);
+
+    // Replacing one URL's content keeps the blob the other still uses.
+    QVERIFY(IsoArtifactStore::put(kSumsUrl, "new bytes", {}).has_value());
+    const auto sig = IsoArtifactStore::lookup(kSigUrl);
+    QVERIFY(sig.has_value());
+    QCOMPARE(sig->data, QByteArray("same bytes"));
+    QVERIFY(!sig->isFresh());
+}
+
+void TestIsoArtifactStore::alteredBlobIsRejected()
+{
+    const auto stored = IsoArtifactStore::put(kSumsUrl, "original", {});
+    QVERIFY(stored.has_value());
+    QFile blob(stored->path);
+    QVERIFY(blob.open(QIODevice::WriteOnly));
+    blob.write("tampered");
+    blob.close();
+    QVERIFY(!IsoArtifactStore::lookup(kSumsUrl).has_value());
+
+    QVERIFY(IsoArtifactStore::put(kSumsUrl, "original", {}).has_value());
+    const auto found = IsoArtifactStore::lookup(kSumsUrl);
+    QVERIFY(found.has_value());
+    QCOMPARE(found->data, QByteArray("original"));
+}
+
+void TestIsoArtifactStore::expiryFollowsRelease()
+{
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    const QDateTime server = now.addSecs(600);
+    QCOMPARE(IsoArtifactStore::expiryFor(false, server, now),
+             now.addSecs(IsoArtifactStore::kPinnedReleaseMaxAgeSecs));
+    QCOMPARE(IsoArtifactStore::expiryFor(true, server, now), server);
+    QCOMPARE(IsoArtifactStore::expiryFor(true, now.addYears(1), now),
+             now.addSecs(IsoArtifactStore::kRollingReleaseMaxAgeSecs));
+    QCOMPARE(IsoArtifactStore::expiryFor(true, {}, now),
+             now.addSecs(IsoArtifactStore::kRollingReleaseMaxAgeSecs));
+}
+
+QTEST_MAIN(TestIsoArtifactStore)
+#include "test_iso_artifact_store.moc"
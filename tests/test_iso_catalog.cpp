@@ -1,10 +1,15 @@
 #include <QtTest>
 #include <QCoreApplication>
+#include <QSignalSpy>
 #include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 #include <QStandardPaths>
 #include "GpgTestUtil.h"
 #include "WindowsCiTestUtil.h"
 #include "IsoCatalog.h"
+#include "IsoCatalogInternal.h"
 #include "IsoCatalogManifest.h"
 
 using namespace FlashSpartan;
@@ -39,8 +44,13 @@ private slots:
     void armbianMatches();
     void verifiableImageExtensions();
     void embeddedManifestIntegrity();
+    void snapshotReloadMatchesParsedCatalog();
+    void backgroundRefreshSignalsCompletion();
+    void ddImageLookupByVolumeLabel();
     void publisherFilenameTable_data();
     void publisherFilenameTable();
+    void patternIndexNarrowsCandidates();
+    void catalogDeltaPatchesManifest();
 };
 
 void TestIsoCatalog::initTestCase()
@@ -288,6 +298,8 @@ void TestIsoCatalog::verifiableImageExtensions()
 {
     QVERIFY(IsoCatalog::isVerifiableImageFileName(QStringLiteral("debian.iso")));
     QVERIFY(IsoCatalog::isVerifiableImageFileName(QStringLiteral("pi.img.xz")));
+    QVERIFY(IsoCatalog::isVerifiableImageFileName(QStringLiteral("board.img.zst")));
+    QVERIFY(IsoCatalog::isVerifiableImageFileName(QStringLiteral("board.img.gz")));
     QVERIFY(IsoCatalog::isVerifiableImageFileName(QStringLiteral("disk.img")));
     QVERIFY(IsoCatalog::isVerifiableImageFileName(QStringLiteral("legacy.zip")));
     QVERIFY(!IsoCatalog::isVerifiableImageFileName(QStringLiteral("notes.txt")));
@@ -324,6 +336,41 @@ void TestIsoCatalog::embeddedManifestIntegrity()
     }
 }
 
+void TestIsoCatalog::snapshotReloadMatchesParsedCatalog()
+{
+    IsoCatalogManifest::reload();
+    if (!IsoCatalogManifest::lastEmbeddedIntegrityOk()) {
+        QSKIP("embedded catalog not verified here; no snapshot is written");
+    }
+    const int parsedCount = IsoCatalogManifest::entryCount();
+    const auto parsed = IsoCatalogManifest::lookup(QStringLiteral("Win11_24H2_English_x64.iso"));
+
+    IsoCatalogManifest::reload();
+    QVERIFY(IsoCatalogManifest::lastLoadFromSnapshot());
+    QVERIFY(IsoCatalogManifest::lastEmbeddedIntegrityOk());
+    QCOMPARE(IsoCatalogManifest::entryCount(), parsedCount);
+    const auto cached = IsoCatalogManifest::lookup(QStringLiteral("Win11_24H2_English_x64.iso"));
+    QVERIFY(parsed.has_value() && cached.has_value());
+    QCOMPARE(cached->embeddedSha256, parsed->embeddedSha256);
+    QCOMPARE(cached->hintOnly, parsed->hintOnly);
+}
+
+void TestIsoCatalog::backgroundRefreshSignalsCompletion()
+{
+    qputenv("FLASHSPARTAN_SKIP_REMOTE_CATALOG", "1");
+    const QFuture<bool> idle = IsoCatalogManifest::refreshInBackground();
+    QVERIFY(idle.isFinished());
+    QVERIFY(idle.result());
+
+    QSignalSpy spy(&IsoCatalogNotifier::instance(), &IsoCatalogNotifier::refreshFinished);
+    const QFuture<bool> forced = IsoCatalogManifest::refreshInBackground(0, true);
+    QVERIFY(IsoCatalog::matchIso(QStringLiteral("/usb/Win11_24H2_English_x64.iso")).has_value());
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(spy.at(0).at(0).toBool(), true);
+    QVERIFY(forced.result());
+    qunsetenv("FLASHSPARTAN_SKIP_REMOTE_CATALOG");
+}
+
 void TestIsoCatalog::publisherFilenameTable_data()
 {
     QTest::addColumn<QString>("path");
@@ -333,6 +380,13 @@ void TestIsoCatalog::publisherFilenameTable_data()
                           << QStringLiteral("archlinux");
     QTest::newRow("ubuntu") << QStringLiteral("/tmp/ubuntu-24.04.2-desktop-amd64.iso")
                             << QStringLiteral("ubuntu");
+    QTest::newRow("ubuntu-mate") << QStringLiteral("/tmp/ubuntu-mate-24.04-desktop-amd64.iso")
+                                 << QStringLiteral("ubuntu-mate");
+    QTest::newRow("ubuntu-rpi")
+        << QStringLiteral("/pi/ubuntu-24.04.1-preinstalled-server-arm64+raspi.img.xz")
+        << QStringLiteral("ubuntu-rpi");
+    QTest::newRow("arch-upper-case") << QStringLiteral("/mnt/ARCHLINUX-2024.11.01-X86_64.ISO")
+                                     << QStringLiteral("archlinux");
     QTest::newRow("debian") << QStringLiteral("/iso/debian-12.5.0-amd64-netinst.iso")
                             << QStringLiteral("debian");
     QTest::newRow("fedora") << QStringLiteral("/iso/Fedora-Workstation-Live-41-1.4.x86_64.iso")
@@ -364,5 +418,99 @@ void TestIsoCatalog::publisherFilenameTable()
     QCOMPARE(match->publisherId, publisherId);
 }
 
+void TestIsoCatalog::patternIndexNarrowsCandidates()
+{
+    IsoCatalogInternal::FileNamePatternIndex index;
+    index.add(0, QStringLiteral("^Win11_.*\\.iso$"));
+    index.add(1, QStringLiteral("^Win11_24H2_English_x64\\.iso$"));
+    index.add(2, QStringLiteral("^ubuntu-(\\d+)\\.iso$"));
+    index.add(3, QStringLiteral("^(\\d{4})-raspios-.+\\.zip$"));
+    index.add(4, QStringLiteral("^deb?ian-.+\\.iso$"));
+    QCOMPARE(index.candidates(QStringLiteral("win11_24h2_english_x64.iso")), (QList<int>{0, 1, 3}));
+    QCOMPARE(index.candidates(QStringLiteral("ubuntu-24.iso")), (QList<int>{2, 3}));
+    QCOMPARE(index.candidates(QStringLiteral("deian-12.iso")), (QList<int>{3, 4}));
+
+    bool exact = false;
+    QCOMPARE(IsoCatalogInternal::FileNamePatternIndex::literalPrefix(QStringLiteral("^Win11_24H2\\.iso$"), &exact),
+             QStringLiteral("Win11_24H2.iso"));
+    QVERIFY(exact);
+    QVERIFY(IsoCatalogInternal::FileNamePatternIndex::literalPrefix(QStringLiteral("^a\\.iso|b\\.iso"), &exact)
+                .isEmpty());
+    QVERIFY(!exact);
+}
+
+void TestIsoCatalog::ddImageLookupByVolumeLabel()
+{
+    const QString dropInDir = QStandardPaths::writableLocation(QStandardPaths::AppConfigLocation)
+                              + QStringLiteral("/iso-catalog.d");
+    QVERIFY(QDir().mkpath(dropInDir));
+    const QString dropIn = dropInDir + QStringLiteral("/dd-test.json");
+    QFile file(dropIn);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write(R"({"entries": [
+        {"publisher_id": "arch", "publisher_name": "Arch Linux",
+         "file_pattern": "^archlinux-2024\\.10\\.01-x86_64\\.iso$",
+         "release_label": "Arch Linux 2024.10.01",
+         "sha256": "0000000000000000000000000000000000000000000000000000000000000abc",
+         "volume_label": "^ARCH_202410$", "image_size": 1205731328}
+    ]})");
+    file.close();
+
+    for (int pass = 0; pass < 2; ++pass) {  // the second load may come from the snapshot
+        IsoCatalogManifest::reload();
+        const auto match = IsoCatalogManifest::lookupDdImage(QStringLiteral("arch_202410"));
+        QVERIFY(match.has_value());
+        QCOMPARE(match->publisherId, QStringLiteral("arch"));
+        QCOMPARE(match->imageSizeBytes, quint64(1205731328));
+        QCOMPARE(match->embeddedSha256.right(3), QStringLiteral("abc"));
+        QVERIFY(!IsoCatalogManifest::lookupDdImage(QStringLiteral("ARCH_202409")).has_value());
+        QVERIFY(!IsoCatalogManifest::lookupDdImage(QString()).has_value());
+    }
+
+    QVERIFY(QFile::remove(dropIn));
+    IsoCatalogManifest::reload();
+    QVERIFY(!IsoCatalogManifest::lookupDdImage(QStringLiteral("ARCH_202410")).has_value());
+}
+
+void TestIsoCatalog::catalogDeltaPatchesManifest()
+{
+    const QByteArray manifest = R"({"manifest_version": 2, "catalog_version": 7,
+        "delta_url_template": "https://example.org/catalog/delta-{version}.json",
+        "entries": [
+        {"publisher_id": "alpha", "file_pattern": "^alpha-1\\.iso$", "sha256": "aa"},
+        {"publisher_id": "beta", "file_pattern": "^beta-1\\.iso$", "sha256": "bb"},
+        {"publisher_id": "gamma", "file_pattern": "^gamma-1\\.iso$", "sha256": "cc"}
+    ]})";
+    const QByteArray delta = R"({"delta_format": 1, "from_version": 7, "to_version": 9,
+        "upserts": [
+            {"publisher_id": "beta", "file_pattern": "^beta-1\\.iso$", "sha256": "b2"},
+            {"publisher_id": "delta", "file_pattern": "^delta-1\\.iso$", "sha256": "dd"}
+        ],
+        "removals": [{"publisher_id": "alpha", "file_pattern": "^alpha-1\\.iso$"}]})";
+
+    QByteArray patched;
+    QString error;
+    QVERIFY2(IsoCatalogInternal::applyCatalogDelta(manifest, delta, &patched, &error), qPrintable(error));
+    const QJsonObject root = QJsonDocument::fromJson(patched).object();
+    QCOMPARE(root.value(QStringLiteral("catalog_version")).toInteger(), qint64(9));
+    QVERIFY(root.value(QStringLiteral("delta_url_template")).toString().contains(QStringLiteral("{version}")));
+    const QJsonArray entries = root.value(QStringLiteral("entries")).toArray();
+    QCOMPARE(entries.size(), 3);
+    QCOMPARE(entries.at(0).toObject().value(QStringLiteral("sha256")).toString(), QStringLiteral("b2"));
+    QCOMPARE(entries.at(2).toObject().value(QStringLiteral("publisher_id")).toString(), QStringLiteral("delta"));
+    QVERIFY(IsoCatalogInternal::lookupInManifest(patched, QStringLiteral("alpha-1.iso")).isEmpty());
+    QCOMPARE(IsoCatalogInternal::lookupInManifest(patched, QStringLiteral("gamma-1.iso")), QStringLiteral("gamma"));
+    QCOMPARE(IsoCatalogInternal::lookupInManifest(patched, QStringLiteral("delta-1.iso")), QStringLiteral("delta"));
+
+    // A delta from another version, or one carrying an entry that doesn't parse, changes nothing.
+    QVERIFY(!IsoCatalogInternal::applyCatalogDelta(patched, delta, &patched, &error));
+    QVERIFY(error.contains(QStringLiteral("version 9")));
+    const QByteArray bad = R"({"delta_format": 1, "from_version": 9, "to_version": 10,
+        "upserts": [{"publisher_id": "beta", "file_pattern": "^beta-(\\.iso$"}]})";
+    QVERIFY(!IsoCatalogInternal::applyCatalogDelta(patched, bad, &patched, &error));
+    QCOMPARE(QJsonDocument::fromJson(patched).object().value(QStringLiteral("catalog_version")).toInteger(),
+             qint64(9));
+}
+
 QTEST_MAIN(TestIsoCatalog)
 #include "test_iso_catalog.moc"
@@ -12,6 +12,13 @@ private slots:
     void missingIsoNameFails();
     void rockyChecksumFormat();
     void nobaraSha256sumRelativePath();
+    void taggedSha512Line();
+    void untaggedLongDigestFollowsSourceName();
+    void digestLengthMustMatchTag();
+    void algorithmsForSourceName();
+    void checksumListReadsMixedFormats();
+    void checksumListFindsEntryInLargeList();
+    void cachedListIsSharedPerSourceAndBytes();
 };
 
 void TestIsoChecksum::sumsFileWithAsteriskPrefix()
@@ -59,5 +66,113 @@ void TestIsoChecksum::nobaraSha256sumRelativePath()
     QCOMPARE(hash, QStringLiteral("806fc42e5247f828ad07571507564f476f375e4dcc75c7d69c7cead816b24f25"));
 }
 
+void TestIsoChecksum::taggedSha512Line()
+{
+    const QString sha512 = QString(QLatin1Char('a')).repeated(128);
+    const QString content = QStringLiteral("SHA512 (debian-12.iso) = %1\n"
+                                           "SHA256 (other.iso) = %2\n")
+                                .arg(sha512, QString(QLatin1Char('b')).repeated(64));
+    const IsoChecksum::Digest d =
+        IsoChecksum::parseDigestContent(content, QStringLiteral("debian-12.iso"), QStringLiteral("CHECKSUM"));
+    QCOMPARE(d.algorithm, DigestAlgorithm::Sha512);
+    QCOMPARE(d.hex, sha512);
+}
+
+void TestIsoChecksum::untaggedLongDigestFollowsSourceName()
+{
+    const QString hex = QString(QLatin1Char('C')).repeated(128);
+    const QString content = hex + QStringLiteral("  archlinux-x86_64.iso\n");
+    const IsoChecksum::Digest b2 = IsoChecksum::parseDigestContent(
+        content, QStringLiteral("archlinux-x86_64.iso"), QStringLiteral("https://example.org/iso/b2sums.txt"));
+    QCOMPARE(b2.algorithm, DigestAlgorithm::Blake2b512);
+    QCOMPARE(b2.hex, hex.toLower());
+
+    const IsoChecksum::Digest sha512 = IsoChecksum::parseDigestContent(
+        content, QStringLiteral("archlinux-x86_64.iso"), QStringLiteral("/media/usb/SHA512SUMS"));
+    QCOMPARE(sha512.algorithm, DigestAlgorithm::Sha512);
+
+    const IsoChecksum::Digest sha256 = IsoChecksum::parseDigestContent(
+        QStringLiteral("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855  *ubuntu.iso\n"),
+        QStringLiteral("ubuntu.iso"), QStringLiteral("SHA256SUMS"));
+    QCOMPARE(sha256.algorithm, DigestAlgorithm::Sha256);
+}
+
+void TestIsoChecksum::digestLengthMustMatchTag()
+{
+    QString err;
+    const IsoChecksum::Digest d = IsoChecksum::parseDigestContent(
+        QStringLiteral("SHA512 (a.iso) = %1\n").arg(QString(QLatin1Char('a')).repeated(64)),
+        QStringLiteral("a.iso"), QString(), &err);
+    QVERIFY(d.isEmpty());
+    QVERIFY(!err.isEmpty());
+}
+
+void TestIsoChecksum::algorithmsForSourceName()
+{
+    QCOMPARE(IsoChecksum::algorithmsForSource(QStringLiteral("https://cdimage.debian.org/SHA512SUMS")),
+             DigestAlgorithms(DigestAlgorithm::Sha512));
+    QCOMPARE(IsoChecksum::algorithmsForSource(QStringLiteral("/mnt/b2sums.txt")),
+             DigestAlgorithms(DigestAlgorithm::Blake2b512));
+    QCOMPARE(IsoChecksum::algorithmsForSource(QStringLiteral("/mnt/image.iso.b2")),
+             DigestAlgorithms(DigestAlgorithm::Blake2b512));
+    QCOMPARE(IsoChecksum::algorithmsForSource(QStringLiteral("/mnt/CHECKSUM")),
+             DigestAlgorithms(DigestAlgorithm::Sha256));
+}
+
+void TestIsoChecksum::checksumListReadsMixedFormats()
+{
+    const QString sha256 = QString(QLatin1Char('1')).repeated(64);
+    const QString sha512 = QString(QLatin1Char('2')).repeated(128);
+    const QByteArray content = QStringLiteral("# comment\r\n"
+                                              "%1  ./images/debian-12.iso\r\n"
+                                              "SHA512 (debian-12.iso) = %2\n"
+                                              "\n"
+                                              "SHA256 (other.iso) = %1\n")
+                                   .arg(sha256, sha512)
+                                   .toUtf8();
+    const ChecksumList list = ChecksumList::parse(content, QStringLiteral("CHECKSUM"));
+    QCOMPARE(list.size(), 3);
+
+    // A tagged entry for the exact name wins over an earlier untagged one.
+    const IsoChecksum::Digest any = list.find(QStringLiteral("debian-12.iso"));
+    QCOMPARE(any.algorithm, DigestAlgorithm::Sha512);
+    QCOMPARE(any.hex, sha512);
+
+    const IsoChecksum::Digest only256 = list.find(QStringLiteral("debian-12.iso"), DigestAlgorithm::Sha256);
+    QCOMPARE(only256.algorithm, DigestAlgorithm::Sha256);
+    QCOMPARE(only256.hex, sha256);
+
+    QString err;
+    QVERIFY(list.find(QStringLiteral("missing.iso"), ChecksumList::kAllAlgorithms, &err).isEmpty());
+    QVERIFY(!err.isEmpty());
+}
+
+void TestIsoChecksum::checksumListFindsEntryInLargeList()
+{
+    QByteArray content;
+    for (int i = 0; i < 20000; ++i) {
+        content += QByteArray::number(i, 16).rightJustified(64, '0') + "  debian-cd/image-" + QByteArray::number(i)
+                   + ".iso\n";
+    }
+    const ChecksumList list = ChecksumList::parse(content, QStringLiteral("SHA256SUMS"));
+    QCOMPARE(list.size(), 20000);
+    QCOMPARE(list.find(QStringLiteral("image-19999.iso")).hex,
+             QString::fromLatin1(QByteArray::number(19999, 16).rightJustified(64, '0')));
+    QVERIFY(list.find(QStringLiteral("image-20000.iso")).isEmpty());
+}
+
+void TestIsoChecksum::cachedListIsSharedPerSourceAndBytes()
+{
+    const QByteArray content = QByteArrayLiteral(
+        "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855  ubuntu.iso\n");
+    const auto first = ChecksumList::cached(content, QStringLiteral("https://example.org/SHA256SUMS"));
+    const auto again = ChecksumList::cached(QByteArray(content.constData(), content.size()),
+                                            QStringLiteral("https://example.org/SHA256SUMS"));
+    QCOMPARE(first.get(), again.get());
+    const auto otherSource = ChecksumList::cached(content, QStringLiteral("/mnt/SHA256SUMS"));
+    QVERIFY(otherSource.get() != first.get());
+    QCOMPARE(otherSource->find(QStringLiteral("ubuntu.iso")).hex, first->find(QStringLiteral("ubuntu.iso")).hex);
+}
+
 QTEST_MAIN(TestIsoChecksum)
 #include "test_iso_checksum.moc"
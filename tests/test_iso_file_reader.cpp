@@ -0,0 +1,127 @@
+#include <QtTest>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "IsoFileReader.h"
+
+using namespace FlashSpartan;
+
+class TestIsoFileReader : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void everyModeReadsTheWholeFile_data();
+    void everyModeReadsTheWholeFile();
+    void everyModeStartsAtTheOffset_data();
+    void everyModeStartsAtTheOffset();
+    void consumerCanStop();
+    void missingFileFails();
+
+private:
+    QTemporaryDir m_dir;
+    QString m_path;
+    QByteArray m_data;
+    QByteArray m_sha256;
+    qint64 m_size = 0;
+};
+
+void TestIsoFileReader::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    // Two full 8 MiB streamed buffers plus a tail that is not a multiple of 4 KiB.
+    QByteArray data(2 * 8 * 1024 * 1024 + 12345, Qt::Uninitialized);
+    for (qsizetype i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>((i * 7919) >> 3);
+    }
+    m_path = m_dir.filePath(QStringLiteral("image.iso"));
+    QFile out(m_path);
+    QVERIFY(out.open(QIODevice::WriteOnly));
+    QCOMPARE(out.write(data), data.size());
+    out.close();
+    m_sha256 = QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+    m_size = data.size();
+    m_data = data;
+}
+
+void TestIsoFileReader::everyModeReadsTheWholeFile_data()
+{
+    QTest::addColumn<int>("mode");
+    QTest::newRow("page-cache") << static_cast<int>(IsoReadCache::PageCache);
+    QTest::newRow("drop-behind") << static_cast<int>(IsoReadCache::DropBehind);
+    QTest::newRow("direct") << static_cast<int>(IsoReadCache::Direct);
+}
+
+void TestIsoFileReader::everyModeReadsTheWholeFile()
+{
+    QFETCH(int, mode);
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    qint64 total = 0;
+    QString err;
+    const bool ok = IsoFileReader::readAll(
+        m_path, static_cast<IsoReadCache>(mode),
+        [&](const char* data, std::size_t length) {
+            hash.addData(QByteArrayView(data, static_cast<qsizetype>(length)));
+            total += static_cast<qint64>(length);
+            return true;
+        },
+        &err);
+    QVERIFY2(ok, qPrintable(err));
+    QCOMPARE(total, m_size);
+    QCOMPARE(hash.result(), m_sha256);
+}
+
+void TestIsoFileReader::everyModeStartsAtTheOffset_data()
+{
+    QTest::addColumn<int>("mode");
+    QTest::addColumn<qint64>("offset");
+    for (const qint64 offset : {qint64(8 * 1024 * 1024), qint64(1000)}) {
+        const QByteArray tag = QByteArray::number(offset);
+        QTest::newRow("page-cache " + tag) << static_cast<int>(IsoReadCache::PageCache) << offset;
+        QTest::newRow("drop-behind " + tag) << static_cast<int>(IsoReadCache::DropBehind) << offset;
+        QTest::newRow("direct " + tag) << static_cast<int>(IsoReadCache::Direct) << offset;
+    }
+}
+
+void TestIsoFileReader::everyModeStartsAtTheOffset()
+{
+    QFETCH(int, mode);
+    QFETCH(qint64, offset);
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+    QString err;
+    const bool ok = IsoFileReader::readAll(
+        m_path, static_cast<IsoReadCache>(mode),
+        [&](const char* data, std::size_t length) {
+            hash.addData(QByteArrayView(data, static_cast<qsizetype>(length)));
+            return true;
+        },
+        &err, offset);
+    QVERIFY2(ok, qPrintable(err));
+    QCOMPARE(hash.result(), QCryptographicHash::hash(m_data.mid(offset), QCryptographicHash::Sha256));
+}
+
+void TestIsoFileReader::consumerCanStop()
+{
+    int calls = 0;
+    const bool ok = IsoFileReader::readAll(
+        m_path, IsoReadCache::DropBehind,
+        [&](const char*, std::size_t) {
+            ++calls;
+            return false;
+        },
+        nullptr);
+    QVERIFY(!ok);
+    QCOMPARE(calls, 1);
+}
+
+void TestIsoFileReader::missingFileFails()
+{
+    QString err;
+    QVERIFY(!IsoFileReader::readAll(m_dir.filePath(QStringLiteral("missing.iso")), IsoReadCache::Direct,
+                                    [](const char*, std::size_t) { return true; }, &err));
+    QVERIFY(!err.isEmpty());
+}
+
+QTEST_MAIN(TestIsoFileReader)
+#include "test_iso_file_reader.moc"
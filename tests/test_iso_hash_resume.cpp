@@ -0,0 +1,135 @@
+#include <QtTest>
+
+#include <QCryptographicHash>
+#include <QTemporaryDir>
+
+#include "IsoHashResume.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+IsoVerifyCache::FileKey keyOf(qint64 size)
+{
+    IsoVerifyCache::FileKey key;
+    key.volumeId = QStringLiteral("uuid:1234-ABCD");
+    key.relativePath = QStringLiteral("isos/win11.iso");
+    key.size = size;
+    key.mtimeMs = 1700000000000;
+    key.ctimeMs = 1700000000000;
+    key.inode = 42;
+    return key;
+}
+
+QByteArray patterned(qsizetype bytes)
+{
+    QByteArray data(bytes, Qt::Uninitialized);
+    for (qsizetype i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>((i * 2654435761u) >> 13);
+    }
+    return data;
+}
+
+} // namespace
+
+class TestIsoHashResume : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void restoredStateFinishesTheSameDigest();
+    void foreignStateIsRefused();
+    void checkpointRoundTrips();
+    void changedFileHasNoCheckpoint();
+    void remountKeepsTheCheckpoint();
+    void removeDropsIt();
+
+private:
+    QTemporaryDir m_dir;
+};
+
+void TestIsoHashResume::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    IsoHashResume::setStorageDirectory(m_dir.path());
+}
+
+void TestIsoHashResume::restoredStateFinishesTheSameDigest()
+{
+    const QByteArray data = patterned(3 * 1024 * 1024 + 77);
+    const qsizetype split = 1024 * 1024 + 13;
+
+    IsoHashResume::Sha256 first;
+    QVERIFY(first.update(data.constData(), static_cast<std::size_t>(split)));
+    const QByteArray state = first.saveState();
+
+    IsoHashResume::Sha256 resumed;
+    QVERIFY(resumed.restoreState(state));
+    QVERIFY(resumed.update(data.constData() + split, static_cast<std::size_t>(data.size() - split)));
+    QCOMPARE(resumed.finish(),
+             QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex()));
+}
+
+void TestIsoHashResume::foreignStateIsRefused()
+{
+    IsoHashResume::Sha256 digest;
+    QVERIFY(digest.update("abc", 3));
+    QVERIFY(!digest.restoreState(QByteArray("not a digest state")));
+    QVERIFY(!digest.restoreState({}));
+    // A refused restore leaves the running state alone.
+    QCOMPARE(digest.finish(),
+             QString::fromLatin1(QCryptographicHash::hash("abc", QCryptographicHash::Sha256).toHex()));
+}
+
+void TestIsoHashResume::checkpointRoundTrips()
+{
+    const IsoVerifyCache::FileKey key = keyOf(12LL * 1024 * 1024 * 1024);
+    IsoHashResume::Sha256 digest;
+    QVERIFY(digest.update("partial", 7));
+    QVERIFY(IsoHashResume::save(key, {IsoHashResume::kCheckpointBytes, digest.saveState()}));
+
+    const auto loaded = IsoHashResume::load(key);
+    QVERIFY(loaded.has_value());
+    QCOMPARE(loaded->offset, IsoHashResume::kCheckpointBytes);
+    QCOMPARE(loaded->state, digest.saveState());
+}
+
+void TestIsoHashResume::changedFileHasNoCheckpoint()
+{
+    const IsoVerifyCache::FileKey key = keyOf(12LL * 1024 * 1024 * 1024);
+    QVERIFY(IsoHashResume::save(key, {4096, IsoHashResume::Sha256().saveState()}));
+
+    IsoVerifyCache::FileKey rewritten = key;
+    rewritten.mtimeMs += 1000;
+    QVERIFY(!IsoHashResume::load(rewritten).has_value());
+
+    IsoVerifyCache::FileKey resized = key;
+    resized.size -= 4096;
+    QVERIFY(!IsoHashResume::load(resized).has_value());
+
+    // An offset past the end cannot come from this file.
+    QVERIFY(IsoHashResume::save(key, {key.size + 1, IsoHashResume::Sha256().saveState()}));
+    QVERIFY(!IsoHashResume::load(key).has_value());
+}
+
+void TestIsoHashResume::remountKeepsTheCheckpoint()
+{
+    const IsoVerifyCache::FileKey key = keyOf(8LL * 1024 * 1024 * 1024);
+    QVERIFY(IsoHashResume::save(key, {8192, IsoHashResume::Sha256().saveState()}));
+
+    IsoVerifyCache::FileKey remounted = key;
+    remounted.inode = 7;  // vfat and exFAT number inodes per mount
+    QVERIFY(IsoHashResume::load(remounted).has_value());
+}
+
+void TestIsoHashResume::removeDropsIt()
+{
+    const IsoVerifyCache::FileKey key = keyOf(6LL * 1024 * 1024 * 1024);
+    QVERIFY(IsoHashResume::save(key, {8192, IsoHashResume::Sha256().saveState()}));
+    IsoHashResume::remove(key);
+    QVERIFY(!IsoHashResume::load(key).has_value());
+    QVERIFY(!IsoHashResume::save(IsoVerifyCache::FileKey(), {8192, {}}));
+}
+
+QTEST_MAIN(TestIsoHashResume)
+#include "test_iso_hash_resume.moc"
@@ -0,0 +1,145 @@
+#include <QtTest>
+#include <QEventLoop>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QTemporaryDir>
+#include <QUrlQuery>
+
+#include <memory>
+
+#include "IsoArtifactStore.h"
+#include "IsoHttpClient.h"
+#include "IsoMirrorServer.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+const QString kSumsUrl = QStringLiteral("https://example.org/release/1.0/SHA256SUMS?mirror=a&b=c");
+const QString kImage = QStringLiteral("example-1.0 amd64.iso");
+
+struct Reply {
+    int status = 0;
+    QByteArray body;
+};
+
+/** A plain GET through Qt's own HTTP stack, so the mirror's responses are parsed for real. */
+Reply httpGet(const QString& url)
+{
+    QNetworkAccessManager nam;
+    QNetworkReply* reply = nam.get(QNetworkRequest(QUrl(url)));
+    QEventLoop loop;
+    QObject::connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    QTimer::singleShot(5000, &loop, &QEventLoop::quit);
+    loop.exec();
+    Reply r;
+    r.status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    r.body = reply->readAll();
+    delete reply;
+    return r;
+}
+
+} // namespace
+
+class TestIsoMirrorServer : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void mirrorUrlCarriesOrigin();
+    void servesArtifactOnceFromStore();
+    void refusesUrlsNotAllowed();
+    void servesExpiredCopyWhenOriginFails();
+
+private:
+    QString base() const { return QStringLiteral("http://127.0.0.1:%1").arg(m_server->serverPort()); }
+
+    QTemporaryDir m_dir;
+    std::unique_ptr<IsoMirrorServer> m_server;
+    int m_originFetches = 0;
+    bool m_originUp = true;
+};
+
+void TestIsoMirrorServer::init()
+{
+    QVERIFY(m_dir.isValid());
+    IsoArtifactStore::setStorageDir(m_dir.filePath(QStringLiteral("artifacts")));
+    m_originFetches = 0;
+    m_originUp = true;
+    IsoHttpClient::setHandler([this](const QString& url, QString* errorOut, int) -> QByteArray {
+        ++m_originFetches;
+        if (m_originUp && url == kSumsUrl) {
+            return "abc123  example-1.0 amd64.iso\n";
+        }
+        if (errorOut) {
+            *errorOut = QStringLiteral("origin unreachable");
+        }
+        return {};
+    });
+    m_server = std::make_unique<IsoMirrorServer>([](const QString& url, const QString& image) {
+        return url == kSumsUrl && image == kImage;
+    });
+    QVERIFY(m_server->listen(QHostAddress::LocalHost, 0));
+    IsoHttpClient::setMirror(base() + QStringLiteral("/"));
+}
+
+void TestIsoMirrorServer::cleanup()
+{
+    m_server.reset();
+    IsoHttpClient::setMirror({});
+    IsoHttpClient::reset();
+    IsoArtifactStore::clear();
+}
+
+void TestIsoMirrorServer::mirrorUrlCarriesOrigin()
+{
+    const QUrl mirrored(IsoHttpClient::mirrorUrlFor(kSumsUrl, kImage));
+    QCOMPARE(mirrored.path(), QStringLiteral("/fetch"));
+    const QUrlQuery query(mirrored);
+    QCOMPARE(query.queryItemValue(QStringLiteral("url"), QUrl::FullyDecoded), kSumsUrl);
+    QCOMPARE(query.queryItemValue(QStringLiteral("image"), QUrl::FullyDecoded), kImage);
+
+    IsoHttpClient::setMirror({});
+    QVERIFY(IsoHttpClient::mirrorUrlFor(kSumsUrl, kImage).isEmpty());
+}
+
+void TestIsoMirrorServer::servesArtifactOnceFromStore()
+{
+    const Reply first = httpGet(IsoHttpClient::mirrorUrlFor(kSumsUrl, kImage));
+    QCOMPARE(first.status, 200);
+    QCOMPARE(first.body, QByteArray("abc123  example-1.0 amd64.iso\n"));
+    QCOMPARE(m_originFetches, 1);
+
+    const Reply second = httpGet(IsoHttpClient::mirrorUrlFor(kSumsUrl, kImage));
+    QCOMPARE(second.status, 200);
+    QCOMPARE(second.body, first.body);
+    QCOMPARE(m_originFetches, 1);
+}
+
+void TestIsoMirrorServer::refusesUrlsNotAllowed()
+{
+    QCOMPARE(httpGet(IsoHttpClient::mirrorUrlFor(kSumsUrl)).status, 403);
+    QCOMPARE(httpGet(IsoHttpClient::mirrorUrlFor(QStringLiteral("https://example.org/other"), kImage)).status,
+             403);
+    QCOMPARE(httpGet(base() + QStringLiteral("/elsewhere")).status, 404);
+    QCOMPARE(m_originFetches, 0);
+}
+
+void TestIsoMirrorServer::servesExpiredCopyWhenOriginFails()
+{
+    const QByteArray old = "old  example-1.0 amd64.iso\n";
+    QVERIFY(IsoArtifactStore::put(kSumsUrl, old, QDateTime::currentDateTimeUtc().addSecs(-60)).has_value());
+    m_originUp = false;
+
+    const Reply reply = httpGet(IsoHttpClient::mirrorUrlFor(kSumsUrl, kImage));
+    QCOMPARE(reply.status, 200);
+    QCOMPARE(reply.body, old);
+    QCOMPARE(m_originFetches, 1);
+
+    IsoArtifactStore::clear();
+    QCOMPARE(httpGet(IsoHttpClient::mirrorUrlFor(kSumsUrl, kImage)).status, 502);
+}
+
+QTEST_MAIN(TestIsoMirrorServer)
+#include "test_iso_mirror_server.moc"
@@ -0,0 +1,157 @@
+#include <QtTest>
+
+#include <QCryptographicHash>
+#include <QTemporaryDir>
+
+#include "IsoPrescreen.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+QString sha256Hex(const QByteArray& data)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+}
+
+QByteArray patterned(qint64 bytes, char seed)
+{
+    QByteArray data(static_cast<qsizetype>(bytes), Qt::Uninitialized);
+    for (qsizetype i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(seed + i * 31);
+    }
+    return data;
+}
+
+QString writeFile(const QTemporaryDir& dir, const QString& name, const QByteArray& data)
+{
+    const QString path = dir.filePath(name);
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly) || f.write(data) != data.size()) {
+        return {};
+    }
+    return path;
+}
+
+IsoPublisherMatch listing(const QByteArray& image)
+{
+    IsoPublisherMatch match;
+    match.imageSizeBytes = static_cast<quint64>(image.size());
+    match.headSha256 = sha256Hex(image.left(IsoPrescreen::kEdgeBytes));
+    match.tailSha256 = sha256Hex(image.right(IsoPrescreen::kEdgeBytes));
+    return match;
+}
+
+} // namespace
+
+class TestIsoPrescreen : public QObject {
+    Q_OBJECT
+
+private slots:
+    void edgeDigestsMatchHeadAndTail();
+    void smallFileCoversItselfTwice();
+    void listedImagePasses();
+    void truncatedAndLongerFilesFail();
+    void changedEdgesFail();
+    void emptyListingChecksNothing();
+    void compressedImagesAreSkipped();
+};
+
+void TestIsoPrescreen::edgeDigestsMatchHeadAndTail()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QByteArray image = patterned(3 * IsoPrescreen::kEdgeBytes + 123, 'a');
+    const QString path = writeFile(dir, QStringLiteral("image.iso"), image);
+    QVERIFY(!path.isEmpty());
+
+    const IsoPrescreen::EdgeDigests edges = IsoPrescreen::edgeDigests(path);
+    QCOMPARE(edges.headSha256, sha256Hex(image.left(IsoPrescreen::kEdgeBytes)));
+    QCOMPARE(edges.tailSha256, sha256Hex(image.right(IsoPrescreen::kEdgeBytes)));
+    QVERIFY(IsoPrescreen::edgeDigests(dir.filePath(QStringLiteral("missing.iso"))).isEmpty());
+}
+
+void TestIsoPrescreen::smallFileCoversItselfTwice()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QByteArray image = patterned(4096, 'b');
+    const QString path = writeFile(dir, QStringLiteral("tiny.iso"), image);
+
+    const IsoPrescreen::EdgeDigests edges = IsoPrescreen::edgeDigests(path);
+    QCOMPARE(edges.headSha256, sha256Hex(image));
+    QCOMPARE(edges.tailSha256, sha256Hex(image));
+}
+
+void TestIsoPrescreen::listedImagePasses()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QByteArray image = patterned(2 * IsoPrescreen::kEdgeBytes + 7, 'c');
+    const QString path = writeFile(dir, QStringLiteral("distro.iso"), image);
+    QVERIFY(IsoPrescreen::mismatch(path, listing(image)).isEmpty());
+}
+
+void TestIsoPrescreen::truncatedAndLongerFilesFail()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QByteArray image = patterned(2 * IsoPrescreen::kEdgeBytes, 'd');
+    const IsoPublisherMatch listed = listing(image);
+
+    const QString cut = writeFile(dir, QStringLiteral("cut.iso"), image.left(image.size() - 512));
+    QVERIFY(IsoPrescreen::mismatch(cut, listed).contains(QStringLiteral("truncated")));
+
+    const QString longer = writeFile(dir, QStringLiteral("longer.iso"), image + QByteArray(512, '\0'));
+    QVERIFY(IsoPrescreen::mismatch(longer, listed).contains(QStringLiteral("different build")));
+}
+
+void TestIsoPrescreen::changedEdgesFail()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QByteArray image = patterned(3 * IsoPrescreen::kEdgeBytes, 'e');
+    const IsoPublisherMatch listed = listing(image);
+
+    QByteArray head = image;
+    head[100] = static_cast<char>(head[100] ^ 0x1);
+    QVERIFY(IsoPrescreen::mismatch(writeFile(dir, QStringLiteral("head.iso"), head), listed)
+                .startsWith(QStringLiteral("first")));
+
+    QByteArray tail = image;
+    tail[tail.size() - 1] = static_cast<char>(tail[tail.size() - 1] ^ 0x1);
+    QVERIFY(IsoPrescreen::mismatch(writeFile(dir, QStringLiteral("tail.iso"), tail), listed)
+                .startsWith(QStringLiteral("last")));
+
+    // The middle is not read: only the full hash catches a change there.
+    QByteArray middle = image;
+    middle[middle.size() / 2] = static_cast<char>(middle[middle.size() / 2] ^ 0x1);
+    QVERIFY(IsoPrescreen::mismatch(writeFile(dir, QStringLiteral("middle.iso"), middle), listed).isEmpty());
+}
+
+void TestIsoPrescreen::emptyListingChecksNothing()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = writeFile(dir, QStringLiteral("any.iso"), patterned(8192, 'f'));
+    QVERIFY(IsoPrescreen::mismatch(path, IsoPublisherMatch()).isEmpty());
+}
+
+void TestIsoPrescreen::compressedImagesAreSkipped()
+{
+    QVERIFY(IsoPrescreen::appliesTo(QStringLiteral("debian.iso")));
+    QVERIFY(IsoPrescreen::appliesTo(QStringLiteral("raspios.img")));
+    QVERIFY(!IsoPrescreen::appliesTo(QStringLiteral("raspios.IMG.XZ")));
+    QVERIFY(!IsoPrescreen::appliesTo(QStringLiteral("armbian.img.zst")));
+    QVERIFY(!IsoPrescreen::appliesTo(QStringLiteral("image.zip")));
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    IsoPublisherMatch listed;
+    listed.imageSizeBytes = 1 << 30;  // decoded size; the file is much smaller
+    const QString path = writeFile(dir, QStringLiteral("raspios.img.xz"), patterned(4096, 'g'));
+    QVERIFY(IsoPrescreen::mismatch(path, listed).isEmpty());
+}
+
+QTEST_MAIN(TestIsoPrescreen)
+#include "test_iso_prescreen.moc"
@@ -2,6 +2,7 @@
 #include <QTemporaryDir>
 #include <QDir>
 #include <QFile>
+#include "IsoImageScanner.h"
 #include "IsoScanRules.h"
 #include "IsoVerifier.h"
 #include "SettingsProfiles.h"
@@ -16,8 +17,20 @@ private slots:
     void multibootLayoutDetection();
     void skipSmallEfiPartition();
     void profileIdMigration();
+    void parallelScanPrunesAndBounds();
 };
 
+namespace {
+
+void touch(const QString& path)
+{
+    QFile f(path);
+    QVERIFY(f.open(QIODevice::WriteOnly));
+    f.write("x");
+}
+
+} // namespace
+
 void TestIsoScanRules::reservedDirectories()
 {
     QVERIFY(IsoScanRules::isReservedMultibootDirectory(QStringLiteral("ventoy")));
@@ -72,5 +85,44 @@ void TestIsoScanRules::skipSmallEfiPartition()
     QVERIFY(!IsoScanRules::shouldSkipAutoVerifyPartition(data.path(), 32 * 1024 * 1024, 1));
 }
 
+void TestIsoScanRules::parallelScanPrunesAndBounds()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QDir root(dir.path());
+    for (const char* sub : {"isos/linux/deep", "EFI/boot", "ventoy", ".hidden", "docs"}) {
+        QVERIFY(root.mkpath(QString::fromLatin1(sub)));
+    }
+    touch(root.filePath(QStringLiteral("top.iso")));
+    touch(root.filePath(QStringLiteral("isos/linux/debian.iso")));
+    touch(root.filePath(QStringLiteral("isos/linux/deep/arch.img.xz")));
+    touch(root.filePath(QStringLiteral("EFI/boot/efi.img")));
+    touch(root.filePath(QStringLiteral("ventoy/ventoy.iso")));
+    touch(root.filePath(QStringLiteral(".hidden/secret.iso")));
+    touch(root.filePath(QStringLiteral("docs/readme.txt")));
+#ifndef Q_OS_WIN
+    QVERIFY(QFile::link(dir.path(), root.filePath(QStringLiteral("isos/loop"))));
+#endif
+
+    std::atomic<int> streamed{0};
+    IsoImageScanner::Limits limits;
+    limits.threads = 4;
+    const IsoImageScanner::Result all =
+        IsoImageScanner::scan(dir.path(), limits, [&](const QString&) { ++streamed; });
+    QCOMPARE(all.paths.size(), 3);
+    QCOMPARE(streamed.load(), 3);
+    QVERIFY(!all.truncated);
+    QVERIFY(all.paths.at(0).endsWith(QStringLiteral("/isos/linux/debian.iso")));
+    QVERIFY(all.paths.at(1).endsWith(QStringLiteral("/isos/linux/deep/arch.img.xz")));
+    QVERIFY(all.paths.at(2).endsWith(QStringLiteral("/top.iso")));
+    QCOMPARE(IsoVerifier::findIsoFiles(dir.path()), all.paths);
+
+    limits.maxDepth = 1;
+    const IsoImageScanner::Result shallow = IsoImageScanner::scan(dir.path(), limits);
+    QVERIFY(shallow.truncated);
+    QCOMPARE(shallow.paths.size(), 1);
+    QVERIFY(IsoImageScanner::scan(root.filePath(QStringLiteral("missing"))).paths.isEmpty());
+}
+
 QTEST_MAIN(TestIsoScanRules)
 #include "test_iso_scan_rules.moc"
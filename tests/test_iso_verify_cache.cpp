@@ -0,0 +1,138 @@
+#include <QtTest>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QThread>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "IsoVerifyCache.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+const QString kHash = QStringLiteral("e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+void writeFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(data), data.size());
+}
+
+} // namespace
+
+class TestIsoVerifyCache : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void hitSurvivesReload();
+    void changedFileMisses();
+    void clearRemovesFile();
+    void concurrentLookupsCountHits();
+
+private:
+    QTemporaryDir m_dir;
+};
+
+void TestIsoVerifyCache::init()
+{
+    QVERIFY(m_dir.isValid());
+    IsoVerifyCache::setStoragePath(m_dir.filePath(QStringLiteral("hash-cache.json")));
+}
+
+void TestIsoVerifyCache::cleanup()
+{
+    IsoVerifyCache::clear();
+}
+
+void TestIsoVerifyCache::hitSurvivesReload()
+{
+    const QString iso = m_dir.filePath(QStringLiteral("image.iso"));
+    writeFile(iso, "image bytes");
+    const IsoVerifyCache::FileKey key = IsoVerifyCache::keyFor(iso);
+    QVERIFY(key.isValid());
+    QVERIFY(IsoVerifyCache::lookup(key).isEmpty());
+
+    IsoVerifyCache::store(key, kHash.toUpper());
+    QCOMPARE(IsoVerifyCache::lookup(key), kHash);
+    QVERIFY(QFile::exists(IsoVerifyCache::storagePath()));
+
+    // A new session reads the entry back from disk.
+    IsoVerifyCache::setStoragePath(IsoVerifyCache::storagePath());
+    QCOMPARE(IsoVerifyCache::lookup(IsoVerifyCache::keyFor(iso)), kHash);
+}
+
+void TestIsoVerifyCache::changedFileMisses()
+{
+    const QString iso = m_dir.filePath(QStringLiteral("changing.iso"));
+    writeFile(iso, "first");
+    const IsoVerifyCache::FileKey key = IsoVerifyCache::keyFor(iso);
+    IsoVerifyCache::store(key, kHash);
+
+    // Same size, so only the timestamps tell the rewrite apart.
+    QThread::msleep(20);
+    writeFile(iso, "other");
+    const IsoVerifyCache::FileKey now = IsoVerifyCache::keyFor(iso);
+    QCOMPARE(now.size, key.size);
+    QVERIFY(!(now == key));
+    QVERIFY(IsoVerifyCache::lookup(now).isEmpty());
+}
+
+void TestIsoVerifyCache::clearRemovesFile()
+{
+    const QString iso = m_dir.filePath(QStringLiteral("cleared.iso"));
+    writeFile(iso, "bytes");
+    const IsoVerifyCache::FileKey key = IsoVerifyCache::keyFor(iso);
+    IsoVerifyCache::store(key, kHash);
+    IsoVerifyCache::clear();
+    QVERIFY(!QFile::exists(IsoVerifyCache::storagePath()));
+    QVERIFY(IsoVerifyCache::lookup(key).isEmpty());
+}
+
+void TestIsoVerifyCache::concurrentLookupsCountHits()
+{
+    QList<IsoVerifyCache::FileKey> keys;
+    for (int i = 0; i < 8; ++i) {
+        const QString iso = m_dir.filePath(QStringLiteral("parallel%1.iso").arg(i));
+        writeFile(iso, QByteArray::number(i));
+        keys.append(IsoVerifyCache::keyFor(iso));
+        IsoVerifyCache::store(keys.last(), kHash);
+    }
+    IsoVerifyCache::FileKey unknown = keys.first();
+    unknown.relativePath += QStringLiteral(".missing");
+
+    constexpr int kThreads = 4;
+    constexpr int kRounds = 250;
+    std::vector<std::thread> workers;
+    std::atomic<int> wrong{0};
+    for (int t = 0; t < kThreads; ++t) {
+        workers.emplace_back([&]() {
+            for (int r = 0; r < kRounds; ++r) {
+                if (IsoVerifyCache::lookup(keys.at(r % keys.size())) != kHash) {
+                    ++wrong;
+                }
+                if (!IsoVerifyCache::lookup(unknown).isEmpty()) {
+                    ++wrong;
+                }
+            }
+        });
+    }
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    QCOMPARE(wrong.load(), 0);
+
+    const IsoVerifyCache::Stats stats = IsoVerifyCache::stats();
+    QCOMPARE(stats.hits, uint64_t(kThreads * kRounds));
+    QCOMPARE(stats.misses, uint64_t(kThreads * kRounds));
+    QCOMPARE(stats.stores, uint64_t(keys.size()));
+    QCOMPARE(stats.entries, int(keys.size()));
+}
+
+QTEST_MAIN(TestIsoVerifyCache)
+#include "test_iso_verify_cache.moc"
@@ -24,6 +24,7 @@ private slots:
     void offlineSidecarPass();
     void offlineSidecarMismatchFails();
     void userTofuHashPass();
+    void verifyFilesStreamsEachResult();
 };
 
 static QString fixturesRoot()
@@ -123,5 +124,26 @@ void TestIsoVerifyIntegration::userTofuHashPass()
     QCOMPARE(r.source, IsoVerifySource::EmbeddedCatalog);
 }
 
+void TestIsoVerifyIntegration::verifyFilesStreamsEachResult()
+{
+    const QStringList paths{fixturesRoot() + QStringLiteral("/offline-good/zz-offline-fixture.iso"),
+                            fixturesRoot() + QStringLiteral("/offline-bad/zz-offline-fixture.iso")};
+    QStringList streamed;
+    IsoVerifyOptions opt = IsoVerifier::verifyOptions();
+    opt.parallelLimit = 2;
+    opt.resultReady = [&streamed](const IsoVerifyResult& r) { streamed.append(r.isoPath); };
+    QList<IsoVerifyResult> results;
+    {
+        const IsoVerifier::OptionsScope scope(opt);
+        results = IsoVerifier::verifyFiles(paths);
+    }
+
+    QCOMPARE(results.size(), 2);  // in path order, offline-bad first
+    QVERIFY(!results.at(0).passed());
+    QVERIFY(results.at(1).passed());
+    streamed.sort();
+    QCOMPARE(streamed, QStringList({paths.at(1), paths.at(0)}));
+}
+
 QTEST_MAIN(TestIsoVerifyIntegration)
 #include "test_iso_verify_integration.moc"
@@ -0,0 +1,189 @@
+#include <QtTest>
+
+#include <cstring>
+
+#include "LayoutProbe.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+constexpr uint64_t kMiB = 1024ULL * 1024;
+
+struct CountingReader {
+    const QByteArray* image = nullptr;
+    int reads = 0;
+
+    LayoutProbe::ReadAt reader()
+    {
+        return [this](uint64_t offset, char* buffer, size_t length) {
+            ++reads;
+            if (offset + length > static_cast<uint64_t>(image->size())) {
+                return false;
+            }
+            std::memcpy(buffer, image->constData() + offset, length);
+            return true;
+        };
+    }
+};
+
+template <typename T>
+void putLe(QByteArray& image, int offset, T value)
+{
+    qToLittleEndian(value, image.data() + offset);
+}
+
+QByteArray fat32Volume(uint64_t bytes, quint32 serial)
+{
+    QByteArray image(static_cast<qsizetype>(bytes), '\x5A');
+    std::memset(image.data(), 0, 512);
+    putLe<quint16>(image, 11, 512);  // bytes per sector
+    putLe<quint16>(image, 22, 0);    // FAT32: no 16-bit FAT size
+    image[0x42] = char(0x29);        // extended boot signature
+    putLe<quint32>(image, 0x43, serial);
+    putLe<quint16>(image, 510, 0xAA55);
+    return image;
+}
+
+QByteArray extVolume(uint64_t bytes)
+{
+    QByteArray image(static_cast<qsizetype>(bytes), '\x11');
+    constexpr int sb = 1024;
+    putLe<quint16>(image, sb + 0x38, 0xEF53);
+    putLe<quint16>(image, sb + 0x3A, 1);  // cleanly unmounted
+    putLe<quint16>(image, sb + 0x34, 7);
+    putLe<quint32>(image, sb + 0x30, 1700000000);
+    putLe<quint64>(image, sb + 0x178, 4096);
+    return image;
+}
+
+} // namespace
+
+class TestLayoutProbe : public QObject {
+    Q_OBJECT
+
+private slots:
+    void parsesFat32();
+    void parsesExFat();
+    void parsesExt();
+    void unknownHeadIsBlank();
+    void wholeDiskVolumeTakesOneRead();
+    void mountingKeepsTheFingerprint();
+    void reformatAndRepartitionChangeIt();
+    void readErrorGivesNoFingerprint();
+};
+
+void TestLayoutProbe::parsesFat32()
+{
+    QByteArray head = fat32Volume(LayoutProbe::kHeadBytes, 0x1234ABCD);
+    const LayoutProbe::VolumeHead parsed = LayoutProbe::parseVolumeHead(head);
+    QCOMPARE(parsed.fsType, QStringLiteral("fat"));
+    QCOMPARE(parsed.volumeSerial, QStringLiteral("cdab3412"));
+    QVERIFY(!parsed.volumeDirty);
+
+    head[0x41] = char(0x01);
+    QVERIFY(LayoutProbe::parseVolumeHead(head).volumeDirty);
+}
+
+void TestLayoutProbe::parsesExFat()
+{
+    QByteArray head(static_cast<qsizetype>(LayoutProbe::kHeadBytes), '\0');
+    std::memcpy(head.data() + 3, "EXFAT   ", 8);
+    putLe<quint32>(head, 100, 0xCAFEF00D);
+    putLe<quint16>(head, 106, 0x2);
+    const LayoutProbe::VolumeHead parsed = LayoutProbe::parseVolumeHead(head);
+    QCOMPARE(parsed.fsType, QStringLiteral("exfat"));
+    QCOMPARE(parsed.volumeSerial, QStringLiteral("0df0feca"));
+    QVERIFY(parsed.volumeDirty);
+}
+
+void TestLayoutProbe::parsesExt()
+{
+    const LayoutProbe::VolumeHead parsed = LayoutProbe::parseVolumeHead(extVolume(LayoutProbe::kHeadBytes));
+    QCOMPARE(parsed.fsType, QStringLiteral("ext"));
+    QCOMPARE(parsed.volumeSerial.size(), qsizetype(32));
+    QCOMPARE(parsed.mountCount, uint32_t(7));
+    QCOMPARE(parsed.lastWriteTime, qint64(1700000000));
+    QCOMPARE(parsed.writeCounter, uint64_t(4096));
+    QVERIFY(!parsed.volumeDirty);
+}
+
+void TestLayoutProbe::unknownHeadIsBlank()
+{
+    const LayoutProbe::VolumeHead parsed =
+        LayoutProbe::parseVolumeHead(QByteArray(static_cast<qsizetype>(LayoutProbe::kHeadBytes), '\x33'));
+    QVERIFY(parsed.fsType.isEmpty());
+    QVERIFY(parsed.volumeSerial.isEmpty());
+}
+
+void TestLayoutProbe::wholeDiskVolumeTakesOneRead()
+{
+    const QByteArray stick = fat32Volume(4 * kMiB, 0x11111111);
+    CountingReader volume{&stick};
+    const LayoutFingerprint print = LayoutProbe::capture(volume.reader(), stick.size(), {});
+    QVERIFY(!print.isEmpty());
+    QCOMPARE(volume.reads, 1);
+    QCOMPARE(print.fsType, QStringLiteral("fat"));
+    QCOMPARE(print.volumeBytes, 4 * kMiB);
+
+    // The same device read as disk and volume separately fingerprints the same.
+    CountingReader disk{&stick};
+    CountingReader again{&stick};
+    QVERIFY(LayoutProbe::mismatch(print, LayoutProbe::capture(again.reader(), stick.size(), disk.reader()))
+                .isEmpty());
+    QCOMPARE(disk.reads, 1);
+}
+
+void TestLayoutProbe::mountingKeepsTheFingerprint()
+{
+    const QByteArray disk = fat32Volume(8 * kMiB, 0x22222222);
+    QByteArray volume = extVolume(4 * kMiB);
+    CountingReader d{&disk};
+    CountingReader v{&volume};
+    const LayoutFingerprint baseline = LayoutProbe::capture(v.reader(), volume.size(), d.reader());
+
+    putLe<quint16>(volume, 1024 + 0x34, 8);
+    putLe<quint32>(volume, 1024 + 0x30, 1700000100);
+    putLe<quint64>(volume, 1024 + 0x178, 8192);
+    volume[static_cast<qsizetype>(2 * kMiB)] = '\x22';
+    QVERIFY(LayoutProbe::mismatch(baseline, LayoutProbe::capture(v.reader(), volume.size(), d.reader())).isEmpty());
+}
+
+void TestLayoutProbe::reformatAndRepartitionChangeIt()
+{
+    QByteArray disk = fat32Volume(8 * kMiB, 0x22222222);
+    QByteArray volume = fat32Volume(4 * kMiB, 0x33333333);
+    CountingReader d{&disk};
+    CountingReader v{&volume};
+    const LayoutFingerprint baseline = LayoutProbe::capture(v.reader(), volume.size(), d.reader());
+
+    QByteArray reformatted = fat32Volume(4 * kMiB, 0x44444444);
+    CountingReader r{&reformatted};
+    QCOMPARE(LayoutProbe::mismatch(baseline, LayoutProbe::capture(r.reader(), reformatted.size(), d.reader())),
+             QStringLiteral("file system was replaced"));
+
+    QByteArray asExt = extVolume(4 * kMiB);
+    CountingReader e{&asExt};
+    QCOMPARE(LayoutProbe::mismatch(baseline, LayoutProbe::capture(e.reader(), asExt.size(), d.reader())),
+             QStringLiteral("file system was replaced"));
+
+    QCOMPARE(LayoutProbe::mismatch(baseline, LayoutProbe::capture(v.reader(), 2 * kMiB, d.reader())),
+             QStringLiteral("volume size changed"));
+
+    disk[446 + 4] = char(0x0C);  // first MBR entry's type
+    QCOMPARE(LayoutProbe::mismatch(baseline, LayoutProbe::capture(v.reader(), volume.size(), d.reader())),
+             QStringLiteral("partition table changed"));
+}
+
+void TestLayoutProbe::readErrorGivesNoFingerprint()
+{
+    const QByteArray stick = fat32Volume(4 * kMiB, 0x11111111);
+    CountingReader ok{&stick};
+    const LayoutProbe::ReadAt failing = [](uint64_t, char*, size_t) { return false; };
+    QVERIFY(LayoutProbe::capture(failing, stick.size(), ok.reader()).isEmpty());
+    QVERIFY(LayoutProbe::capture(ok.reader(), stick.size(), failing).isEmpty());
+    QVERIFY(LayoutProbe::capture(ok.reader(), LayoutProbe::kHeadBytes - 1, {}).isEmpty());
+}
+
+QTEST_MAIN(TestLayoutProbe)
+#include "test_layout_probe.moc"
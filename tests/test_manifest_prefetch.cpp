@@ -0,0 +1,108 @@
+#include <QtTest>
+
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "ManifestPrefetch.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+WatchFileEntry entry(const QString& path, uint64_t size)
+{
+    WatchFileEntry e;
+    e.relativePath = path;
+    e.sizeBytes = size;
+    return e;
+}
+
+WatchManifest manifestOf(const QList<WatchFileList>& groups)
+{
+    WatchManifest manifest;
+    for (const WatchFileList& files : groups) {
+        WatchGroup group;
+        group.files = files;
+        manifest.groups.append(group);
+    }
+    return manifest;
+}
+
+} // namespace
+
+class TestManifestPrefetch : public QObject {
+    Q_OBJECT
+
+private slots:
+    void smallestFilesGoFirst();
+    void budgetCutsTheList();
+    void sharedFilesAreListedOnce();
+    void runHintsThePlannedFiles();
+    void cancelledRunStopsAtOnce();
+};
+
+void TestManifestPrefetch::smallestFilesGoFirst()
+{
+    const WatchManifest manifest = manifestOf({{entry(QStringLiteral("big.bin"), 4096),
+                                                entry(QStringLiteral("empty.txt"), 0),
+                                                entry(QStringLiteral("small.cfg"), 10)}});
+    // Empty files have nothing to read.
+    QCOMPARE(ManifestPrefetch::plan(manifest), QStringList({QStringLiteral("small.cfg"), QStringLiteral("big.bin")}));
+}
+
+void TestManifestPrefetch::budgetCutsTheList()
+{
+    const WatchManifest manifest = manifestOf(
+        {{entry(QStringLiteral("a"), 100), entry(QStringLiteral("b"), 200), entry(QStringLiteral("c"), 300)}});
+    QCOMPARE(ManifestPrefetch::plan(manifest, 300), QStringList({QStringLiteral("a"), QStringLiteral("b")}));
+    QCOMPARE(ManifestPrefetch::plan(manifest, 99), QStringList());
+    QCOMPARE(ManifestPrefetch::plan(manifest, 0), QStringList());
+}
+
+void TestManifestPrefetch::sharedFilesAreListedOnce()
+{
+    const WatchManifest manifest = manifestOf({{entry(QStringLiteral("boot/grub.cfg"), 50)},
+                                               {entry(QStringLiteral("boot/grub.cfg"), 50),
+                                                entry(QStringLiteral("efi/bootx64.efi"), 70)}});
+    QCOMPARE(ManifestPrefetch::plan(manifest),
+             QStringList({QStringLiteral("boot/grub.cfg"), QStringLiteral("efi/bootx64.efi")}));
+}
+
+void TestManifestPrefetch::runHintsThePlannedFiles()
+{
+    QTemporaryDir mount;
+    QVERIFY(mount.isValid());
+    QVERIFY(QDir(mount.path()).mkpath(QStringLiteral("boot")));
+    QFile file(mount.filePath(QStringLiteral("boot/grub.cfg")));
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(QByteArray(64, 'g')), qint64(64));
+    file.close();
+
+    // The second file went missing since the baseline: it is not counted.
+    const WatchManifest manifest = manifestOf(
+        {{entry(QStringLiteral("boot/grub.cfg"), 64), entry(QStringLiteral("boot/gone.cfg"), 32)}});
+    const ManifestPrefetch::Result result = ManifestPrefetch::run(mount.path(), manifest);
+    QVERIFY(!result.cancelled);
+#ifdef Q_OS_LINUX
+    QCOMPARE(result.files, 1);
+    QCOMPARE(result.bytes, qint64(64));
+#else
+    QCOMPARE(result.files, 0);
+#endif
+}
+
+void TestManifestPrefetch::cancelledRunStopsAtOnce()
+{
+    QTemporaryDir mount;
+    QVERIFY(mount.isValid());
+    const WatchManifest manifest = manifestOf({{entry(QStringLiteral("a"), 10)}});
+    const std::atomic<bool> cancelled{true};
+    const ManifestPrefetch::Result result =
+        ManifestPrefetch::run(mount.path(), manifest, ManifestPrefetch::kBudgetBytes, &cancelled);
+    QVERIFY(result.cancelled);
+    QCOMPARE(result.files, 0);
+}
+
+QTEST_MAIN(TestManifestPrefetch)
+#include "test_manifest_prefetch.moc"
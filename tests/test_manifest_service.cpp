@@ -1,9 +1,15 @@
 #include <QtTest>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
 #include <QTemporaryDir>
 
 #include "ManifestService.h"
+#include "MerkleTree.h"
+#include "RawFsReader.h"
+
+#include <cstring>
 
 using namespace FlashSpartan;
 
@@ -16,6 +22,18 @@ void writeFile(const QString& path, const QByteArray& data)
     QCOMPARE(file.write(data), data.size());
 }
 
+RawFsReader::ReadAt memoryReader(const QByteArray& image)
+{
+    return [image](uint64_t offset, char* data, size_t length, QString* error) {
+        if (offset + length > static_cast<uint64_t>(image.size())) {
+            *error = QStringLiteral("out of range");
+            return false;
+        }
+        std::memcpy(data, image.constData() + offset, length);
+        return true;
+    };
+}
+
 } // namespace
 
 class TestManifestService : public QObject {
@@ -25,6 +43,19 @@ private slots:
     void buildsManifestFromRelativePaths();
     void rejectsRelativeTraversalOutsideMount();
     void rejectsAbsolutePathOutsideMount();
+    void parallelHashesKeepLeafOrder();
+    void diskOrderKeepsLeafOrder();
+    void metadataFirstVerifyHashesOnlyChangedFiles();
+    void journalVerifyHashesOnlyTouchedFiles();
+    void overlappingGroupsMatchSeparateBuilds();
+    void failFastStopsAtFirstDifference();
+    void riskyAndRecentFilesHashFirst();
+    void chunkedFilesReportChangedRanges();
+    void progressCountsAndCancelStops();
+    void batchVerifyReportsEachMount();
+    void unmountedVolumeVerifyMatchesMount();
+    void diffReportsPathsInOrderForUnsortedBaselines();
+    void v1BaselinesVerifyAndRebuildUpgrades();
 };
 
 void TestManifestService::buildsManifestFromRelativePaths()
@@ -86,5 +117,533 @@ void TestManifestService::rejectsAbsolutePathOutsideMount()
              qPrintable(result.errorMessage));
 }
 
+void TestManifestService::parallelHashesKeepLeafOrder()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString mountPoint = tempDir.path() + QStringLiteral("/mount");
+    QVERIFY(QDir().mkpath(mountPoint + QStringLiteral("/data")));
+    // Enough small files for several micro-batches, plus files hashed on their own.
+    for (int i = 0; i < 300; ++i) {
+        writeFile(mountPoint + QStringLiteral("/data/small-%1.txt").arg(i, 3, 10, QLatin1Char('0')),
+                  QByteArray::number(i));
+    }
+    writeFile(mountPoint + QStringLiteral("/data/medium.bin"), QByteArray(512 * 1024, 'm'));
+
+    WatchGroup group;
+    group.id = QStringLiteral("data");
+    group.name = QStringLiteral("Data");
+    group.watchPaths = {QStringLiteral("data")};
+
+    const auto result = ManifestService::buildGroup(mountPoint, group);
+    QVERIFY2(result.success, qPrintable(result.errorMessage));
+    QCOMPARE(result.group.files.size(), 301);
+    for (int i = 1; i < result.group.files.size(); ++i) {
+        QVERIFY(result.group.files.at(i - 1).relativePath < result.group.files.at(i).relativePath);
+    }
+    for (const WatchFileEntry& entry : result.group.files) {
+        QCOMPARE(entry.contentHash,
+                 ManifestService::hashFileContents(mountPoint + QLatin1Char('/') + entry.relativePath));
+    }
+    QCOMPARE(ManifestService::buildGroup(mountPoint, group).group.merkleRoot, result.group.merkleRoot);
+}
+
+void TestManifestService::diskOrderKeepsLeafOrder()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString mountPoint = tempDir.path() + QStringLiteral("/mount");
+    QVERIFY(QDir().mkpath(mountPoint + QStringLiteral("/data")));
+    // Written in reverse name order, so disk order and path order likely disagree.
+    for (int i = 199; i >= 0; --i) {
+        writeFile(mountPoint + QStringLiteral("/data/file-%1.bin").arg(i, 3, 10, QLatin1Char('0')),
+                  QByteArray(4096 + i, static_cast<char>(i)));
+    }
+    writeFile(mountPoint + QStringLiteral("/data/large.bin"), QByteArray(1024 * 1024, 'l'));
+
+    WatchGroup group;
+    group.id = QStringLiteral("data");
+    group.name = QStringLiteral("Data");
+    group.watchPaths = {QStringLiteral("data")};
+
+    qputenv("FLASHSPARTAN_EXTENT_ORDER", "0");
+    const auto pathOrdered = ManifestService::buildGroup(mountPoint, group);
+    qputenv("FLASHSPARTAN_EXTENT_ORDER", "1");
+    const auto diskOrdered = ManifestService::buildGroup(mountPoint, group);
+    qunsetenv("FLASHSPARTAN_EXTENT_ORDER");
+
+    QVERIFY2(diskOrdered.success, qPrintable(diskOrdered.errorMessage));
+    QCOMPARE(diskOrdered.group.files.size(), 201);
+    QCOMPARE(diskOrdered.group.merkleRoot, pathOrdered.group.merkleRoot);
+    for (int i = 0; i < diskOrdered.group.files.size(); ++i) {
+        QCOMPARE(diskOrdered.group.files.at(i).relativePath, pathOrdered.group.files.at(i).relativePath);
+        QCOMPARE(diskOrdered.group.files.at(i).contentHash, pathOrdered.group.files.at(i).contentHash);
+    }
+}
+
+void TestManifestService::metadataFirstVerifyHashesOnlyChangedFiles()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString mountPoint = tempDir.path() + QStringLiteral("/mount");
+    QVERIFY(QDir().mkpath(mountPoint + QStringLiteral("/docs")));
+    for (int i = 0; i < 10; ++i) {
+        writeFile(mountPoint + QStringLiteral("/docs/%1.txt").arg(i), QByteArray::number(i));
+    }
+
+    WatchGroup spec;
+    spec.id = QStringLiteral("docs");
+    spec.name = QStringLiteral("Documents");
+    spec.watchPaths = {QStringLiteral("docs")};
+    const auto built = ManifestService::buildGroup(mountPoint, spec);
+    QVERIFY2(built.success, qPrintable(built.errorMessage));
+    QVERIFY(built.group.files.first().hasMetadata());
+
+    const ManifestVerifyPolicy metadataOnly{true, 0};
+    auto unchanged = ManifestService::verifyGroup(mountPoint, built.group, metadataOnly);
+    QVERIFY(unchanged.matches);
+    QCOMPARE(unchanged.filesChecked, uint64_t(10));
+    QCOMPARE(unchanged.filesHashed, uint64_t(0));
+
+    // Same size, new contents, mtime moved explicitly so sub-millisecond writes still differ.
+    const QString edited = mountPoint + QStringLiteral("/docs/3.txt");
+    writeFile(edited, "X");
+    QFile file(edited);
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.setFileTime(QDateTime::currentDateTimeUtc().addSecs(60),
+                             QFileDevice::FileModificationTime));
+    file.close();
+
+    const auto changed = ManifestService::verifyGroup(mountPoint, built.group, metadataOnly);
+    QVERIFY(!changed.matches);
+    QCOMPARE(changed.filesHashed, uint64_t(1));
+    QCOMPARE(changed.changedPaths, QStringList{QStringLiteral("docs/3.txt")});
+
+    const auto full = ManifestService::verifyGroup(mountPoint, built.group);
+    QCOMPARE(full.filesHashed, uint64_t(10));
+    QCOMPARE(full.computedRootHex, changed.computedRootHex);
+}
+
+void TestManifestService::journalVerifyHashesOnlyTouchedFiles()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString mountPoint = QFileInfo(tempDir.path()).canonicalFilePath() + QStringLiteral("/mount");
+    QVERIFY(QDir().mkpath(mountPoint + QStringLiteral("/docs/sub")));
+    for (int i = 0; i < 6; ++i) {
+        writeFile(mountPoint + QStringLiteral("/docs/%1.txt").arg(i), QByteArray::number(i));
+    }
+    writeFile(mountPoint + QStringLiteral("/docs/sub/a.txt"), "a");
+
+    WatchGroup spec;
+    spec.id = QStringLiteral("docs");
+    spec.name = QStringLiteral("Documents");
+    spec.watchPaths = {QStringLiteral("docs")};
+    const auto built = ManifestService::buildGroup(mountPoint, spec);
+    QVERIFY2(built.success, qPrintable(built.errorMessage));
+
+    const QSet<QString> elsewhere{QStringLiteral("music/song.ogg")};
+    const auto skipped = ManifestService::verifyGroup(mountPoint, built.group, {}, &elsewhere);
+    QVERIFY(skipped.matches);
+    QCOMPARE(skipped.filesChecked, uint64_t(7));
+    QCOMPARE(skipped.filesHashed, uint64_t(0));
+
+    writeFile(mountPoint + QStringLiteral("/docs/2.txt"), "changed");
+    writeFile(mountPoint + QStringLiteral("/docs/new.txt"), "new");
+    const QSet<QString> touched{QStringLiteral("docs/2.txt"), QStringLiteral("docs/new.txt")};
+    const auto changed = ManifestService::verifyGroup(mountPoint, built.group, {}, &touched);
+    QVERIFY(!changed.matches);
+    QCOMPARE(changed.filesHashed, uint64_t(2));
+    QCOMPARE(changed.changedPaths, QStringList{QStringLiteral("docs/2.txt")});
+    QCOMPARE(changed.addedPaths, QStringList{QStringLiteral("docs/new.txt")});
+
+    // A touched directory covers everything below it.
+    const QSet<QString> touchedDir{QStringLiteral("docs/sub")};
+    const auto dir = ManifestService::verifyGroup(mountPoint, built.group, {}, &touchedDir);
+    QCOMPARE(dir.filesHashed, uint64_t(2));
+}
+
+void TestManifestService::overlappingGroupsMatchSeparateBuilds()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString mountPoint = QFileInfo(tempDir.path()).canonicalFilePath() + QStringLiteral("/mount");
+    QVERIFY(QDir().mkpath(mountPoint + QStringLiteral("/docs/sub")));
+    QVERIFY(QDir().mkpath(mountPoint + QStringLiteral("/docs/.cache")));
+    writeFile(mountPoint + QStringLiteral("/docs/a.txt"), "a");
+    writeFile(mountPoint + QStringLiteral("/docs/.hidden.txt"), "h");
+    writeFile(mountPoint + QStringLiteral("/docs/sub/b.txt"), "b");
+    writeFile(mountPoint + QStringLiteral("/docs/.cache/c.txt"), "c");
+
+    WatchManifest spec;
+    const QList<QPair<QString, QString>> groups{{QStringLiteral("all"), QStringLiteral("docs")},
+                                                {QStringLiteral("sub"), QStringLiteral("docs/sub")},
+                                                {QStringLiteral("cache"), QStringLiteral("docs/.cache")}};
+    for (const auto& [id, path] : groups) {
+        WatchGroup g;
+        g.id = id;
+        g.name = id;
+        g.watchPaths = {path};
+        spec.groups.append(g);
+    }
+
+    const WatchManifest shared = ManifestService::rebuildManifestRoots(mountPoint, spec);
+    QCOMPARE(shared.groups.size(), 3);
+    for (int i = 0; i < spec.groups.size(); ++i) {
+        const auto alone = ManifestService::buildGroup(mountPoint, spec.groups.at(i));
+        QVERIFY2(alone.success, qPrintable(alone.errorMessage));
+        QCOMPARE(shared.groups.at(i).merkleRoot, alone.group.merkleRoot);
+        QCOMPARE(shared.groups.at(i).files.size(), alone.group.files.size());
+    }
+    // Hidden entries are skipped while walking docs, but an explicit hidden watch path lists.
+    QCOMPARE(shared.groups.at(0).files.size(), 2);
+    QCOMPARE(shared.groups.at(2).files.size(), 1);
+
+    const auto verified = ManifestService::verifyManifest(mountPoint, shared);
+    QVERIFY(verified.matches);
+    QCOMPARE(verified.filesChecked, uint64_t(4));
+}
+
+void TestManifestService::failFastStopsAtFirstDifference()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString mountPoint = tempDir.path() + QStringLiteral("/mount");
+    QVERIFY(QDir().mkpath(mountPoint + QStringLiteral("/docs")));
+    for (int i = 0; i < 200; ++i) {
+        writeFile(mountPoint + QStringLiteral("/docs/%1.txt").arg(i), QByteArray::number(i));
+    }
+
+    WatchGroup spec;
+    spec.id = QStringLiteral("failfast");
+    spec.name = QStringLiteral("Documents");
+    spec.watchPaths = {QStringLiteral("docs")};
+    const auto built = ManifestService::buildGroup(mountPoint, spec);
+    QVERIFY2(built.success, qPrintable(built.errorMessage));
+
+    ManifestVerifyPolicy failFast;
+    failFast.failFast = true;
+    const auto clean = ManifestService::verifyGroup(mountPoint, built.group, failFast);
+    QVERIFY(clean.matches);
+    QVERIFY(clean.complete);
+    QCOMPARE(clean.computedRootHex, built.group.merkleRoot);
+
+    writeFile(mountPoint + QStringLiteral("/docs/7.txt"), "tampered");
+    const auto changed = ManifestService::verifyGroup(mountPoint, built.group, failFast);
+    QVERIFY(changed.success);
+    QVERIFY(!changed.matches);
+    QVERIFY(!changed.complete);
+    QCOMPARE(changed.changedPaths, QStringList{QStringLiteral("docs/7.txt")});
+    QVERIFY(changed.filesHashed <= changed.filesChecked);
+
+    // The full diff still works from the same baseline.
+    const auto full = ManifestService::verifyGroup(mountPoint, built.group);
+    QVERIFY(full.complete);
+    QCOMPARE(full.changedPaths, QStringList{QStringLiteral("docs/7.txt")});
+
+    writeFile(mountPoint + QStringLiteral("/docs/extra.txt"), "added");
+    const auto added = ManifestService::verifyGroup(mountPoint, built.group, failFast);
+    QVERIFY(!added.matches);
+    QVERIFY(!added.complete);
+    QCOMPARE(added.addedPaths, QStringList{QStringLiteral("docs/extra.txt")});
+    QCOMPARE(added.filesHashed, uint64_t(0));
+}
+
+void TestManifestService::riskyAndRecentFilesHashFirst()
+{
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    const QDateTime built = now.addDays(-30);
+    const QDateTime old = now.addDays(-60);
+    const QDateTime fresh = now.addSecs(-60);
+
+    QCOMPARE(ManifestService::hashPriority(QStringLiteral("AUTORUN.INF"), fresh, built, now), 0);
+    QCOMPARE(ManifestService::hashPriority(QStringLiteral("tools/setup.exe"), old, built, now), 1);
+    QCOMPARE(ManifestService::hashPriority(QStringLiteral("Start.lnk"), old, built, now), 1);
+    QCOMPARE(ManifestService::hashPriority(QStringLiteral("scripts/run.ps1"), old, built, now), 1);
+    QCOMPARE(ManifestService::hashPriority(QStringLiteral("docs/report.pdf"), fresh, built, now), 2);
+    // Changed after the baseline counts as recent however long ago that was.
+    QCOMPARE(ManifestService::hashPriority(QStringLiteral("docs/report.pdf"), now.addDays(-20), built, now), 2);
+    QCOMPARE(ManifestService::hashPriority(QStringLiteral("docs/report.pdf"), old, built, now), 3);
+    QCOMPARE(ManifestService::hashPriority(QStringLiteral("docs/exe"), old, built, now), 3);
+}
+
+void TestManifestService::chunkedFilesReportChangedRanges()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString mountPoint = tempDir.path() + QStringLiteral("/mount");
+    QVERIFY(QDir().mkpath(mountPoint + QStringLiteral("/images")));
+    QByteArray image(8 * 1024 * 1024, Qt::Uninitialized);
+    QRandomGenerator rng(7);
+    rng.fillRange(reinterpret_cast<quint32*>(image.data()), image.size() / 4);
+    writeFile(mountPoint + QStringLiteral("/images/disk.img"), image);
+    writeFile(mountPoint + QStringLiteral("/images/notes.txt"), "small");
+
+    WatchGroup spec;
+    spec.id = QStringLiteral("chunked");
+    spec.name = QStringLiteral("Images");
+    spec.watchPaths = {QStringLiteral("images")};
+    spec.chunkThresholdBytes = 1024 * 1024;
+    const auto built = ManifestService::buildGroup(mountPoint, spec);
+    QVERIFY2(built.success, qPrintable(built.errorMessage));
+    QCOMPARE(built.group.chunkThresholdBytes, spec.chunkThresholdBytes);
+    const WatchFileEntry& disk = built.group.files.first();
+    QCOMPARE(disk.relativePath, QStringLiteral("images/disk.img"));
+    QVERIFY(disk.chunks.size() > 1);
+    QVERIFY(built.group.files.last().chunks.isEmpty());
+
+    // Chunking does not change the leaf: same root as an unchunked build.
+    WatchGroup plain = spec;
+    plain.id = QStringLiteral("unchunked");
+    plain.chunkThresholdBytes = 0;
+    QCOMPARE(ManifestService::buildGroup(mountPoint, plain).group.merkleRoot, built.group.merkleRoot);
+
+    const qsizetype editAt = 5 * 1024 * 1024;
+    image[editAt] = static_cast<char>(image[editAt] ^ 0xFF);
+    writeFile(mountPoint + QStringLiteral("/images/disk.img"), image);
+    const auto verified = ManifestService::verifyGroup(mountPoint, built.group);
+    QVERIFY(!verified.matches);
+    QCOMPARE(verified.changedPaths, QStringList{QStringLiteral("images/disk.img")});
+    QCOMPARE(verified.changedRanges.size(), 1);
+
+    const QString range = verified.changedRanges.first().section(QStringLiteral(": "), 1);
+    const qint64 start = range.section(QLatin1Char('-'), 0, 0).toLongLong();
+    const qint64 end = range.section(QLatin1Char('-'), 1, 1).toLongLong();
+    QVERIFY(start <= editAt && editAt <= end);
+    QVERIFY(end - start < 8 * 1024 * 1024);
+}
+
+void TestManifestService::progressCountsAndCancelStops()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString mountPoint = tempDir.path() + QStringLiteral("/mount");
+    QVERIFY(QDir().mkpath(mountPoint + QStringLiteral("/data")));
+    writeFile(mountPoint + QStringLiteral("/data/a.bin"), QByteArray(300 * 1024, 'a'));
+    writeFile(mountPoint + QStringLiteral("/data/b.txt"), "bee");
+
+    WatchGroup spec;
+    spec.id = QStringLiteral("progress");
+    spec.name = QStringLiteral("Data");
+    spec.watchPaths = {QStringLiteral("data")};
+    ManifestService::Progress progress;
+    const auto built = ManifestService::buildGroup(mountPoint, spec, &progress);
+    QVERIFY2(built.success, qPrintable(built.errorMessage));
+    QCOMPARE(progress.filesTotal.load(), uint64_t(2));
+    QCOMPARE(progress.filesDone.load(), uint64_t(2));
+    QCOMPARE(progress.bytesTotal.load(), uint64_t(300 * 1024 + 3));
+    QCOMPARE(progress.bytesDone.load(), progress.bytesTotal.load());
+
+    ManifestService::Progress cancelled;
+    cancelled.cancelled.store(true);
+    const auto verified = ManifestService::verifyGroup(mountPoint, built.group, {}, nullptr, &cancelled);
+    QVERIFY(!verified.success);
+    QCOMPARE(verified.errorMessage, QStringLiteral("Cancelled"));
+    QCOMPARE(cancelled.bytesDone.load(), uint64_t(0));
+
+    WatchManifest manifest;
+    manifest.groups = {built.group};
+    const auto all = ManifestService::verifyManifest(mountPoint, manifest, {}, nullptr, &cancelled);
+    QVERIFY(!all.success);
+    QCOMPARE(all.errorMessage, QStringLiteral("Cancelled"));
+}
+
+void TestManifestService::batchVerifyReportsEachMount()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    QStringList mounts;
+    for (int i = 0; i < 3; ++i) {
+        const QString mount = tempDir.path() + QStringLiteral("/stick%1").arg(i);
+        QVERIFY(QDir().mkpath(mount + QStringLiteral("/tools")));
+        writeFile(mount + QStringLiteral("/tools/setup.exe"), "installer");
+        writeFile(mount + QStringLiteral("/tools/readme.txt"), "read me");
+        mounts.append(mount);
+    }
+
+    WatchGroup spec;
+    spec.id = QStringLiteral("batch");
+    spec.name = QStringLiteral("Tools");
+    spec.watchPaths = {QStringLiteral("tools")};
+    WatchManifest layout;
+    layout.groups = {spec};
+    const WatchManifest manifest = ManifestService::rebuildManifestRoots(mounts.first(), layout);
+    QCOMPARE(manifest.groups.size(), 1);
+
+    auto batch = ManifestService::verifyManifestBatch(mounts, manifest);
+    QCOMPARE(batch.mounts.size(), 3);
+    QCOMPARE(batch.matched, 3);
+    QCOMPARE(batch.mounts.at(2).mountPoint, mounts.at(2));
+
+    writeFile(mounts.at(1) + QStringLiteral("/tools/setup.exe"), "tampered");
+    batch = ManifestService::verifyManifestBatch(mounts, manifest);
+    QCOMPARE(batch.matched, 2);
+    QCOMPARE(batch.mismatched, 1);
+    QVERIFY(!batch.mounts.at(1).result.matches);
+    QCOMPARE(batch.mounts.at(1).result.changedPaths, QStringList{QStringLiteral("Tools: tools/setup.exe")});
+    QVERIFY(batch.sharedDifferences.isEmpty());
+
+    // The same difference on every mismatched stick points at the baseline instead.
+    writeFile(mounts.at(2) + QStringLiteral("/tools/setup.exe"), "tampered");
+    batch = ManifestService::verifyManifestBatch(mounts, manifest);
+    QCOMPARE(batch.mismatched, 2);
+    QCOMPARE(batch.sharedDifferences, QStringList{QStringLiteral("Tools: tools/setup.exe")});
+}
+
+void TestManifestService::unmountedVolumeVerifyMatchesMount()
+{
+    // The tree tests/fixtures/volumes/ext4.img.qz was made from, rebuilt as a "mount".
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString mountPoint = tempDir.path() + QStringLiteral("/mount");
+    for (const char* dir : {"docs", "app/.cache", "big"}) {
+        QVERIFY(QDir().mkpath(mountPoint + QLatin1Char('/') + QLatin1String(dir)));
+    }
+    QByteArray report;
+    for (int i = 0; i < 5000; ++i) {
+        report += "line " + QByteArray::number(i) + '\n';
+    }
+    writeFile(mountPoint + QStringLiteral("/docs/report.txt"), report);
+    writeFile(mountPoint + QStringLiteral("/docs/empty.txt"), QByteArray());
+    writeFile(mountPoint + QStringLiteral("/app/run.sh"), "#!/bin/sh\necho ok\n");
+    writeFile(mountPoint + QStringLiteral("/app/.cache/state"), "hidden\n");
+    writeFile(mountPoint + QStringLiteral("/big/sparse.bin"), QByteArray(300000, '\0') + "end");
+
+    WatchGroup spec;
+    spec.id = QStringLiteral("unmounted");
+    spec.name = QStringLiteral("Tree");
+    spec.watchPaths = {QStringLiteral("docs"), QStringLiteral("app"), QStringLiteral("./big/sparse.bin")};
+    const auto built = ManifestService::buildGroup(mountPoint, spec);
+    QVERIFY2(built.success, qPrintable(built.errorMessage));
+    QCOMPARE(built.group.files.size(), 4);
+    WatchManifest manifest;
+    manifest.groups = {built.group};
+    manifest.manifestRoot = ManifestService::manifestRootHex(manifest);
+
+    QFile fixture(QStringLiteral(FLASHSPARTAN_TEST_FIXTURES_DIR "/volumes/ext4.img.qz"));
+    QVERIFY(fixture.open(QIODevice::ReadOnly));
+    QByteArray image = qUncompress(fixture.readAll());
+    QString error;
+    auto volume = RawFsReader::open(memoryReader(image), static_cast<uint64_t>(image.size()), &error);
+    QVERIFY2(volume, qPrintable(error));
+    const auto clean = ManifestService::verifyManifestOnVolume(*volume, manifest);
+    QVERIFY2(clean.success, qPrintable(clean.errorMessage));
+    QVERIFY(clean.matches);
+    QCOMPARE(clean.filesChecked, uint64_t(4));
+    QCOMPARE(clean.filesHashed, uint64_t(4));
+
+    // One byte of the report, changed on the device.
+    const qsizetype at = image.indexOf("line 4242\n");
+    QVERIFY(at > 0);
+    image[at + 8] = '3';
+    volume = RawFsReader::open(memoryReader(image), static_cast<uint64_t>(image.size()), &error);
+    QVERIFY2(volume, qPrintable(error));
+    const auto changed = ManifestService::verifyManifestOnVolume(*volume, manifest);
+    QVERIFY(changed.success);
+    QVERIFY(!changed.matches);
+    QCOMPARE(changed.changedPaths, QStringList{QStringLiteral("Tree: docs/report.txt")});
+
+    // Symbolic links are left to a mount; so are absolute watch paths.
+    WatchManifest links = manifest;
+    links.groups[0].watchPaths = {QStringLiteral("links")};
+    const auto linked = ManifestService::verifyManifestOnVolume(*volume, links);
+    QVERIFY(!linked.success);
+    QVERIFY(linked.errorMessage.contains(QStringLiteral("Symbolic link")));
+    links.groups[0].watchPaths = {mountPoint + QStringLiteral("/docs")};
+    QVERIFY(!ManifestService::verifyManifestOnVolume(*volume, links).success);
+}
+
+void TestManifestService::diffReportsPathsInOrderForUnsortedBaselines()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString mountPoint = tempDir.path() + QStringLiteral("/mount");
+    QVERIFY(QDir().mkpath(mountPoint + QStringLiteral("/docs/sub")));
+    for (const char* name : {"a.txt", "b.txt", "c.txt", "d.txt", "sub/e.txt"}) {
+        writeFile(mountPoint + QStringLiteral("/docs/") + QLatin1String(name), name);
+    }
+
+    WatchGroup spec;
+    spec.id = QStringLiteral("docs");
+    spec.watchPaths = {QStringLiteral("docs")};
+    const auto built = ManifestService::buildGroup(mountPoint, spec);
+    QVERIFY2(built.success, qPrintable(built.errorMessage));
+    QVERIFY(built.group.files.isSortedByPath());
+
+    // A baseline stored in some other order, as hand-edited or older JSON manifests may be.
+    WatchGroup reversed = built.group;
+    reversed.files.clear();
+    for (qsizetype i = built.group.files.size(); i-- > 0;) {
+        reversed.files.append(built.group.files.at(i));
+    }
+    QVERIFY(!reversed.files.isSortedByPath());
+
+    writeFile(mountPoint + QStringLiteral("/docs/d.txt"), "changed");
+    writeFile(mountPoint + QStringLiteral("/docs/b.txt"), "changed too");
+    QVERIFY(QFile::remove(mountPoint + QStringLiteral("/docs/c.txt")));
+    QVERIFY(QFile::remove(mountPoint + QStringLiteral("/docs/a.txt")));
+    writeFile(mountPoint + QStringLiteral("/docs/sub/0.txt"), "new");
+    writeFile(mountPoint + QStringLiteral("/docs/0.txt"), "new");
+
+    for (const WatchGroup& baseline : {built.group, reversed}) {
+        const auto result = ManifestService::verifyGroup(mountPoint, baseline);
+        QVERIFY(result.success);
+        QVERIFY(!result.matches);
+        QCOMPARE(result.changedPaths, QStringList({QStringLiteral("docs/b.txt"), QStringLiteral("docs/d.txt")}));
+        QCOMPARE(result.missingPaths, QStringList({QStringLiteral("docs/a.txt"), QStringLiteral("docs/c.txt")}));
+        QCOMPARE(result.addedPaths, QStringList({QStringLiteral("docs/0.txt"), QStringLiteral("docs/sub/0.txt")}));
+    }
+}
+
+void TestManifestService::v1BaselinesVerifyAndRebuildUpgrades()
+{
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString mountPoint = tempDir.path() + QStringLiteral("/mount");
+    QVERIFY(QDir().mkpath(mountPoint + QStringLiteral("/docs")));
+    for (int i = 0; i < 7; ++i) {
+        writeFile(mountPoint + QStringLiteral("/docs/f%1.txt").arg(i), QByteArray::number(i));
+    }
+
+    WatchGroup spec;
+    spec.id = QStringLiteral("legacy");
+    spec.name = QStringLiteral("Legacy");
+    spec.watchPaths = {QStringLiteral("docs")};
+    const auto built = ManifestService::buildGroup(mountPoint, spec);
+    QVERIFY2(built.success, qPrintable(built.errorMessage));
+    QCOMPARE(built.group.merkleFormat, static_cast<int>(MerkleTree::latestShape().format));
+    QCOMPARE(built.group.merkleFanOut, MerkleTree::latestShape().fanOut);
+
+    // The same baseline as stored before v2: binary roots over hex pairs.
+    WatchGroup legacy = built.group;
+    legacy.merkleFormat = 1;
+    legacy.merkleFanOut = 2;
+    QVector<MerkleTree::Leaf> leaves;
+    for (const WatchFileEntry& f : legacy.files) {
+        leaves.append({f.relativePath, f.contentHash, {}});
+    }
+    legacy.merkleRoot = MerkleTree::rootHex(leaves);
+    QVERIFY(legacy.merkleRoot != built.group.merkleRoot);
+    WatchManifest manifest;
+    manifest.groups = {legacy};
+    manifest.manifestRoot = ManifestService::manifestRootHex(manifest);
+
+    const auto verified = ManifestService::verifyManifest(mountPoint, manifest);
+    QVERIFY2(verified.success, qPrintable(verified.errorMessage));
+    QVERIFY(verified.matches);
+
+    const WatchManifest rebuilt = ManifestService::rebuildManifestRoots(mountPoint, manifest);
+    QCOMPARE(rebuilt.version, QStringLiteral("2.0"));
+    QCOMPARE(rebuilt.groups.size(), 1);
+    QCOMPARE(rebuilt.groups.first().merkleFormat, static_cast<int>(MerkleTree::Format::V2));
+    QCOMPARE(rebuilt.groups.first().merkleRoot, built.group.merkleRoot);
+    QVERIFY(rebuilt.manifestRoot != manifest.manifestRoot);
+    QVERIFY(ManifestService::verifyManifest(mountPoint, rebuilt).matches);
+
+    writeFile(mountPoint + QStringLiteral("/docs/f3.txt"), "changed");
+    QVERIFY(!ManifestService::verifyManifest(mountPoint, manifest).matches);
+    QVERIFY(!ManifestService::verifyManifest(mountPoint, rebuilt).matches);
+}
+
 QTEST_MAIN(TestManifestService)
 #include "test_manifest_service.moc"
@@ -0,0 +1,123 @@
+#include <QtTest>
+#include "MemoryBudget.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+/** A cache that holds @c bytes and records what it was asked to shrink to. */
+struct FakeCache {
+    qint64 bytes = 0;
+    QList<qint64> targets;
+
+    MemoryBudget::Consumer consumer(const QString& name, MemoryBudget::Keep keep)
+    {
+        return {name, keep, [this]() { return bytes; }, [this](qint64 target) {
+                    targets.append(target);
+                    bytes = qMin(bytes, target);
+                }};
+    }
+};
+
+} // namespace
+
+class TestMemoryBudget : public QObject {
+    Q_OBJECT
+private slots:
+    void reportsUsage();
+    void reclaimsLowKeepFirst();
+    void pressureLevels();
+    void limitReclaimsTheExcess();
+};
+
+void TestMemoryBudget::reportsUsage()
+{
+    MemoryBudget budget;
+    FakeCache a{100};
+    FakeCache b{50};
+    const int ida = budget.add(a.consumer(QStringLiteral("a"), MemoryBudget::Keep::Normal));
+    budget.add(b.consumer(QStringLiteral("b"), MemoryBudget::Keep::Low));
+    QCOMPARE(budget.totalUsage(), qint64(150));
+    QCOMPARE(budget.usage().size(), 2);
+    QCOMPARE(budget.usage().first().name, QStringLiteral("a"));
+
+    budget.remove(ida);
+    QCOMPARE(budget.totalUsage(), qint64(50));
+}
+
+void TestMemoryBudget::reclaimsLowKeepFirst()
+{
+    MemoryBudget budget;
+    FakeCache high{1000};
+    FakeCache normal{1000};
+    FakeCache low{300};
+    budget.add(high.consumer(QStringLiteral("high"), MemoryBudget::Keep::High));
+    budget.add(normal.consumer(QStringLiteral("normal"), MemoryBudget::Keep::Normal));
+    budget.add(low.consumer(QStringLiteral("low"), MemoryBudget::Keep::Low));
+
+    QCOMPARE(budget.reclaim(500), qint64(500));
+    QCOMPARE(low.bytes, qint64(0));
+    QCOMPARE(normal.bytes, qint64(800));
+    QCOMPARE(normal.targets, QList<qint64>{800});
+    QVERIFY(high.targets.isEmpty());
+
+    // More than everything: all of it, and no more.
+    QCOMPARE(budget.reclaim(10000), qint64(1800));
+    QCOMPARE(high.bytes, qint64(0));
+}
+
+void TestMemoryBudget::pressureLevels()
+{
+    MemoryBudget budget;
+    FakeCache high{1000};
+    FakeCache normal{1000};
+    FakeCache low{300};
+    budget.add(high.consumer(QStringLiteral("high"), MemoryBudget::Keep::High));
+    budget.add(normal.consumer(QStringLiteral("normal"), MemoryBudget::Keep::Normal));
+    budget.add(low.consumer(QStringLiteral("low"), MemoryBudget::Keep::Low));
+    QSignalSpy changed(&budget, &MemoryBudget::pressureChanged);
+    QSignalSpy reclaimed(&budget, &MemoryBudget::reclaimed);
+
+    budget.relieve(MemoryBudget::Pressure::Moderate);
+    QCOMPARE(budget.pressure(), MemoryBudget::Pressure::Moderate);
+    QCOMPARE(low.bytes, qint64(0));
+    QCOMPARE(normal.bytes, qint64(500));
+    QCOMPARE(high.bytes, qint64(1000));
+    QCOMPARE(reclaimed.count(), 1);
+    QCOMPARE(reclaimed.first().at(0).toLongLong(), qint64(800));
+
+    budget.relieve(MemoryBudget::Pressure::Critical);
+    QCOMPARE(normal.bytes, qint64(0));
+    QCOMPARE(high.bytes, qint64(500));
+    QCOMPARE(changed.count(), 2);
+
+    budget.relieve(MemoryBudget::Pressure::None);
+    QCOMPARE(budget.pressure(), MemoryBudget::Pressure::None);
+    QCOMPARE(high.bytes, qint64(500));
+}
+
+void TestMemoryBudget::limitReclaimsTheExcess()
+{
+    MemoryBudget budget;
+    FakeCache cache{400 * 1024};
+    budget.add(cache.consumer(QStringLiteral("cache"), MemoryBudget::Keep::Normal));
+    qint64 resident = 900 * 1024;
+    budget.setResidentProbe([&resident]() { return resident; });
+    QSignalSpy reclaimed(&budget, &MemoryBudget::reclaimed);
+
+    budget.check();  // no limit
+    QCOMPARE(cache.bytes, qint64(400 * 1024));
+
+    budget.setLimit(1000 * 1024);
+    budget.check();  // under it
+    QCOMPARE(reclaimed.count(), 0);
+
+    resident = 1100 * 1024;
+    budget.check();  // 100 KiB over, back to 90 %: 200 KiB
+    QCOMPARE(cache.bytes, qint64(200 * 1024));
+    QCOMPARE(reclaimed.count(), 1);
+    QCOMPARE(reclaimed.first().at(1).toString(), QStringLiteral("limit"));
+}
+
+QTEST_MAIN(TestMemoryBudget)
+#include "test_memory_budget.moc"
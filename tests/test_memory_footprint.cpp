@@ -0,0 +1,588 @@
+#include <QtTest>
+
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+#include "BadUsbAnalyzer.h"
+#include "BadUsbRuleSet.h"
+#include "HidConnectCounter.h"
+#include "HidDeviceMonitor.h"
+#include "HidKeystrokeAnalyzer.h"
+#include "IsoCatalogManifest.h"
+#include "IsoVerifier.h"
+#include "ManifestService.h"
+#include "UdevEventTrace.h"
+#include "UsbmonRing.h"
+#include "WatchManifestFile.h"
+#include "policy/PolicyStoreEngine.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <functional>
+
+#include <malloc.h>
+
+using namespace FlashSpartan;
+using namespace FlashSpartan::Policy;
+
+/*
+ * Allocation counting: malloc and friends are replaced for the whole process and forward to
+ * glibc's own entry points, so Qt containers, operator new and the code under test are all
+ * seen. Live bytes are malloc_usable_size(), which is what the heap really hands out.
+ */
+#ifdef __GLIBC__
+namespace {
+
+struct HeapCounters {
+    std::atomic<qint64> allocations{0};
+    std::atomic<qint64> liveBytes{0};
+    std::atomic<qint64> peakBytes{0};
+};
+constinit HeapCounters g_heap;
+
+void noteAllocated(void* p)
+{
+    if (!p) {
+        return;
+    }
+    g_heap.allocations.fetch_add(1, std::memory_order_relaxed);
+    const qint64 bytes = qint64(malloc_usable_size(p));
+    const qint64 live = g_heap.liveBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    qint64 peak = g_heap.peakBytes.load(std::memory_order_relaxed);
+    while (live > peak && !g_heap.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+    }
+}
+
+} // namespace
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* p);
+
+void* malloc(size_t size) noexcept
+{
+    void* p = __libc_malloc(size);
+    noteAllocated(p);
+    return p;
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+    void* p = __libc_calloc(count, size);
+    noteAllocated(p);
+    return p;
+}
+
+void* realloc(void* old, size_t size) noexcept
+{
+    const qint64 oldBytes = old ? qint64(malloc_usable_size(old)) : 0;
+    void* p = __libc_realloc(old, size);
+    if (p || size == 0) {
+        g_heap.liveBytes.fetch_sub(oldBytes, std::memory_order_relaxed);
+    }
+    noteAllocated(p);
+    return p;
+}
+
+void* memalign(size_t alignment, size_t size) noexcept
+{
+    void* p = __libc_memalign(alignment, size);
+    noteAllocated(p);
+    return p;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void** out, size_t alignment, size_t size) noexcept
+{
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void* p = memalign(alignment, size);
+    if (!p) {
+        return ENOMEM;
+    }
+    *out = p;
+    return 0;
+}
+
+void free(void* p) noexcept
+{
+    if (p) {
+        g_heap.liveBytes.fetch_sub(qint64(malloc_usable_size(p)), std::memory_order_relaxed);
+    }
+    __libc_free(p);
+}
+} // extern "C"
+#endif
+
+namespace {
+
+constexpr qint64 kMiB = 1024 * 1024;
+
+struct Footprint {
+    qint64 allocations = 0;
+    qint64 peakHeapBytes = 0;  // above the live heap when the workload started
+    qint64 retainedBytes = 0;  // still live once the workload returned
+    qint64 peakRssGrowthBytes = -1;  // -1 when the kernel would not reset VmHWM
+};
+
+/**
+ * Limits for one workload. Each sits about twice above what the structures involved need
+ * for the workload's size; tighten it when a change makes the footprint smaller.
+ */
+struct Budget {
+    qint64 allocations;
+    qint64 peakHeapBytes;
+    qint64 retainedBytes;
+    qint64 peakRssGrowthBytes;
+};
+
+qint64 statusKiB(const QByteArray& field)
+{
+    QFile status(QStringLiteral("/proc/self/status"));
+    if (!status.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    for (const QByteArray& line : status.readAll().split('\n')) {
+        if (line.startsWith(field)) {
+            return line.mid(field.size()).trimmed().split(' ').value(0).toLongLong();
+        }
+    }
+    return -1;
+}
+
+/** "5" in clear_refs resets the peak resident size to the current one (Linux 4.0). */
+bool resetPeakRss()
+{
+    QFile clearRefs(QStringLiteral("/proc/self/clear_refs"));
+    return clearRefs.open(QIODevice::WriteOnly) && clearRefs.write("5") == 1;
+}
+
+Footprint measure(const std::function<void()>& workload)
+{
+    Footprint f;
+#ifdef __GLIBC__
+    const bool rssReset = resetPeakRss();
+    const qint64 rssBefore = statusKiB("VmRSS:");
+    const qint64 allocationsBefore = g_heap.allocations.load();
+    const qint64 liveBefore = g_heap.liveBytes.load();
+    g_heap.peakBytes.store(liveBefore);
+
+    workload();
+
+    f.allocations = g_heap.allocations.load() - allocationsBefore;
+    f.peakHeapBytes = g_heap.peakBytes.load() - liveBefore;
+    f.retainedBytes = g_heap.liveBytes.load() - liveBefore;
+    if (rssReset && rssBefore >= 0) {
+        f.peakRssGrowthBytes = (statusKiB("VmHWM:") - rssBefore) * 1024;
+    }
+#else
+    workload();
+#endif
+    return f;
+}
+
+/** The report line for @p name, and a failure naming every limit it went over. */
+QString checkBudget(const char* name, const Footprint& f, const Budget& b)
+{
+    QJsonObject report;
+    report.insert(QStringLiteral("workload"), QLatin1String(name));
+    report.insert(QStringLiteral("allocations"), double(f.allocations));
+    report.insert(QStringLiteral("peak_heap_bytes"), double(f.peakHeapBytes));
+    report.insert(QStringLiteral("retained_bytes"), double(f.retainedBytes));
+    report.insert(QStringLiteral("peak_rss_growth_bytes"), double(f.peakRssGrowthBytes));
+    qInfo().noquote() << "footprint:" << QJsonDocument(report).toJson(QJsonDocument::Compact);
+
+    QStringList over;
+    auto check = [&](const char* what, qint64 value, qint64 limit) {
+        if (value > limit) {
+            over.append(QStringLiteral("%1 %2 > %3").arg(QLatin1String(what)).arg(value).arg(limit));
+        }
+    };
+    check("allocations", f.allocations, b.allocations);
+    check("peak_heap_bytes", f.peakHeapBytes, b.peakHeapBytes);
+    check("retained_bytes", f.retainedBytes, b.retainedBytes);
+    if (f.peakRssGrowthBytes >= 0) {
+        check("peak_rss_growth_bytes", f.peakRssGrowthBytes, b.peakRssGrowthBytes);
+    }
+    return over.isEmpty() ? QString() : QStringLiteral("%1: %2").arg(QLatin1String(name), over.join(QStringLiteral("; ")));
+}
+
+QString hexDigest(quint64 seed)
+{
+    QString out;
+    for (int i = 0; i < 4; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        out += QStringLiteral("%1").arg(seed, 16, 16, QLatin1Char('0'));
+    }
+    return out;
+}
+
+/** An enrolled stick as the policy store holds it; every 100th has a 200-file manifest. */
+DeviceRecord makeRecord(int i)
+{
+    const QDateTime now = QDateTime::currentDateTimeUtc();
+    DeviceRecord r;
+    r.uniqueId = QStringLiteral("footprint_%1/sd%2").arg(i).arg(QChar(char16_t(u'a' + i % 26)));
+    r.hash = hexDigest(0x9e3779b97f4a7c15ULL + i);
+    r.hashScope = QStringLiteral("partition");
+    r.hashScanMode = QStringLiteral("full");
+    r.firstSeen = now.addDays(-(i % 365));
+    r.lastSeen = now;
+    r.lastHashed = now;
+    r.trustLevel = i % 3;
+    r.notes = QStringLiteral("fleet stick %1").arg(i);
+    r.lastKnownInfo.deviceNode = QStringLiteral("/dev/sd%1").arg(QChar(char16_t(u'a' + i % 26)));
+    r.lastKnownInfo.serial = QStringLiteral("SN%1").arg(i, 10, 10, QLatin1Char('0'));
+    r.lastKnownInfo.vendor = QStringLiteral("Vendor%1").arg(i % 20);
+    r.lastKnownInfo.model = QStringLiteral("Model %1").arg(i % 50);
+    r.lastKnownInfo.label = QStringLiteral("STICK%1").arg(i);
+    r.lastKnownInfo.fsType = QStringLiteral("vfat");
+    r.lastKnownInfo.sizeBytes = 32ULL * 1024 * 1024 * 1024;
+    if (i % 100 == 0) {
+        WatchGroup group;
+        group.id = QStringLiteral("g0");
+        group.name = QStringLiteral("data");
+        group.watchPaths = {QStringLiteral("data")};
+        group.merkleRoot = hexDigest(i * 31ULL + 7);
+        group.builtAt = now;
+        for (int f = 0; f < 200; ++f) {
+            WatchFileEntry e;
+            e.relativePath = QStringLiteral("data/d%1/file%2.bin").arg(f / 50).arg(f);
+            e.contentHash = hexDigest(quint64(i) * 1000003ULL + f + 1);
+            e.sizeBytes = 4096 + f;
+            e.modifiedUtc = now;
+            group.files.append(e);
+        }
+        r.watchManifest.groups = {group};
+        r.lastManifestRoot = group.merkleRoot;
+    }
+    return r;
+}
+
+bool writeFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+/** @p files small files, 1000 to a directory, under @p root/data. */
+bool makeTree(const QString& root, int files)
+{
+    for (int i = 0; i < files; ++i) {
+        const QString dir = QStringLiteral("%1/data/d%2").arg(root).arg(i / 1000);
+        if ((i % 1000 == 0 && !QDir().mkpath(dir))
+            || !writeFile(QStringLiteral("%1/f%2.txt").arg(dir).arg(i), QByteArray::number(i).repeated(4))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** A Ventoy stick: ventoy/ventoy.json and @p images 1 MiB images with .sha256 sidecars. */
+bool makeVentoyStick(const QString& root, int images)
+{
+    if (!QDir().mkpath(root + QStringLiteral("/ventoy"))
+        || !writeFile(root + QStringLiteral("/ventoy/ventoy.json"), "{\"control\": []}\n")) {
+        return false;
+    }
+    for (int i = 0; i < images; ++i) {
+        const QString dir = i % 3 == 0 ? root : QStringLiteral("%1/isos/set%2").arg(root).arg(i % 3);
+        const QString name = QStringLiteral("distro-%1-amd64.iso").arg(i, 2, 10, QLatin1Char('0'));
+        QByteArray image(int(kMiB), '\0');
+        quint64 x = 0x2545f4914f6cdd1dULL + quint64(i);
+        for (qsizetype j = 0; j + 8 <= image.size(); j += 8) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            std::memcpy(image.data() + j, &x, 8);
+        }
+        const QByteArray sha = QCryptographicHash::hash(image, QCryptographicHash::Sha256).toHex();
+        if (!QDir().mkpath(dir) || !writeFile(dir + u'/' + name, image)
+            || !writeFile(dir + u'/' + name + QStringLiteral(".sha256"), sha + "  " + name.toUtf8() + '\n')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+UdevRecord hidDevice(int index, const char* action)
+{
+    const QByteArray port = "1-" + QByteArray::number(index + 2);
+    const QByteArray usbPath = "/sys/devices/pci0000:00/0000:00:14.0/usb1/" + port;
+    const bool keyboard = index % 2 == 0;
+
+    UdevRecord iface;
+    iface.sysPath = usbPath + '/' + port + ":1.0";
+    iface.sysName = port + ":1.0";
+    iface.subsystem = "usb";
+    iface.devType = "usb_interface";
+    iface.driver = "usbhid";
+    iface.sysAttrs = {{"bInterfaceNumber", "00\n"}, {"bInterfaceClass", "03\n"},
+                      {"bInterfaceSubClass", "01\n"}, {"bInterfaceProtocol", keyboard ? "01\n" : "02\n"}};
+
+    UdevRecord usb;
+    usb.sysPath = usbPath;
+    usb.sysName = port;
+    usb.subsystem = "usb";
+    usb.devType = "usb_device";
+    usb.sysAttrs = {{"idVendor", "046D\n"}, {"idProduct", keyboard ? "C31C\n" : "C077\n"},
+                    {"serial", "F" + QByteArray::number(index) + '\n'}, {"busnum", "1\n"},
+                    {"devnum", QByteArray::number(index + 2) + '\n'},
+                    {"product", keyboard ? "USB Keyboard\n" : "USB Optical Mouse\n"}};
+
+    UdevRecord r;
+    r.action = action;
+    r.sysPath = iface.sysPath + "/input/input" + QByteArray::number(index) + "/event" + QByteArray::number(index);
+    r.sysName = "event" + QByteArray::number(index);
+    r.devNode = "/dev/input/event" + QByteArray::number(index);
+    r.subsystem = "input";
+    r.properties = {{"ID_INPUT", "1"}, {keyboard ? "ID_INPUT_KEYBOARD" : "ID_INPUT_MOUSE", "1"}};
+    r.parents = {iface, usb};
+    return r;
+}
+
+UsbmonPacket keyReport(quint8 device, qint64 timestampUs, quint8 key)
+{
+    UsbmonPacket p;
+    p.timestampUs = timestampUs;
+    p.bus = 1;
+    p.device = device;
+    p.eventType = 'C';
+    p.transferType = UsbmonFilter::kTransferInterrupt;
+    p.endpoint = 0x81;
+    p.frame = QByteArray(int(UsbmonRing::kHeaderBytes + 8), '\0');
+    p.frame[int(UsbmonRing::kHeaderBytes) + 2] = char(key);
+    p.originalLength = quint32(p.frame.size());
+    return p;
+}
+
+} // namespace
+
+class TestMemoryFootprint : public QObject {
+    Q_OBJECT
+
+    QTemporaryDir m_home;
+
+private slots:
+    void initTestCase();
+    void policyStoreLoad();
+    void manifestBuild();
+    void ventoyStickScan();
+    void hidEventFlood();
+
+private:
+    void policyStoreWorkload(const QString& storePath, int records);
+    void manifestWorkload(const QString& root, int files);
+    void ventoyWorkload(const QString& root);
+    void hidFloodWorkload(int minutes);
+};
+
+void TestMemoryFootprint::initTestCase()
+{
+#ifndef __GLIBC__
+    QSKIP("Allocation counting needs glibc");
+#endif
+    QVERIFY(m_home.isValid());
+    qputenv("XDG_CONFIG_HOME", QFile::encodeName(m_home.filePath(QStringLiteral("config"))));
+    qputenv("XDG_CACHE_HOME", QFile::encodeName(m_home.filePath(QStringLiteral("cache"))));
+    qputenv("XDG_DATA_HOME", QFile::encodeName(m_home.filePath(QStringLiteral("data"))));
+    qputenv("FLASHSPARTAN_SKIP_REMOTE_CATALOG", "1");
+
+    IsoVerifyOptions opt;
+    opt.useHashCache = false;
+    opt.preferOfflineSidecars = true;
+    opt.maxParallel = 1;
+    IsoVerifier::setVerifyOptions(opt);
+    IsoCatalogManifest::ensureLoaded();
+}
+
+void TestMemoryFootprint::policyStoreWorkload(const QString& storePath, int records)
+{
+    PolicyStoreEngine engine(storePath);
+    QString error;
+    QVERIFY2(engine.load(&error), qPrintable(error));
+    const PolicySnapshot snapshot = engine.snapshot();
+    QCOMPARE(snapshot.devices.size(), qsizetype(records));
+    qsizetype manifestFiles = 0;
+    for (const DeviceRecord& record : snapshot.devices) {
+        const DeviceRecord copy = record;  // what a model row or a verify job holds
+        for (const WatchGroup& group : copy.watchManifest.groups) {
+            manifestFiles += group.files.size();
+        }
+    }
+    QCOMPARE(manifestFiles, qsizetype((records + 99) / 100) * 200);
+}
+
+void TestMemoryFootprint::policyStoreLoad()
+{
+    constexpr int kRecords = 10000;
+    QTemporaryDir dir;
+    const QString storePath = dir.filePath(QStringLiteral("policy.store"));
+    const QString warmPath = dir.filePath(QStringLiteral("warm.store"));
+    for (const auto& [path, count] : {std::pair{warmPath, 100}, std::pair{storePath, kRecords}}) {
+        QList<DeviceRecord> records;
+        for (int i = 0; i < count; ++i) {
+            records.append(makeRecord(i));
+        }
+        PolicyStoreEngine filler(path);
+        QString error;
+        QVERIFY2(filler.load(&error) && filler.upsertDevices(records, QStringLiteral("test"), QStringLiteral("enrol"))
+                     && filler.save(&error),
+                 qPrintable(error));
+    }
+    policyStoreWorkload(warmPath, 100);
+
+    const Footprint f = measure([&] { policyStoreWorkload(storePath, kRecords); });
+    const QString failure = checkBudget("policy_store_10k", f, {2000000, 128 * kMiB, 2 * kMiB, 160 * kMiB});
+    QVERIFY2(failure.isEmpty(), qPrintable(failure));
+}
+
+void TestMemoryFootprint::manifestWorkload(const QString& root, int files)
+{
+    WatchGroup spec;
+    spec.id = QStringLiteral("data");
+    spec.name = QStringLiteral("Data");
+    spec.watchPaths = {QStringLiteral("data")};
+    const ManifestService::BuildResult built = ManifestService::buildGroup(root, spec);
+    QVERIFY2(built.success, qPrintable(built.errorMessage));
+    QCOMPARE(built.group.files.size(), qsizetype(files));
+
+    WatchManifest manifest;
+    manifest.groups = {built.group};
+    manifest.manifestRoot = ManifestService::manifestRootHex(manifest);
+    {
+        const std::optional<WatchManifest> decoded = WatchManifestFile::decode(WatchManifestFile::encode(manifest));
+        QVERIFY(decoded);
+        QCOMPARE(decoded->groups.value(0).files.size(), qsizetype(files));
+    }
+    const QByteArray json = QJsonDocument(manifest.toJson()).toJson(QJsonDocument::Compact);
+    const WatchManifest parsed = WatchManifest::fromJson(QJsonDocument::fromJson(json).object());
+    QCOMPARE(parsed.groups.value(0).files.size(), qsizetype(files));
+}
+
+void TestMemoryFootprint::manifestBuild()
+{
+    constexpr int kFiles = 100000;
+    QTemporaryDir warm;
+    QTemporaryDir tree;
+    QVERIFY(makeTree(warm.path(), 1000));
+    QVERIFY(makeTree(tree.path(), kFiles));
+    manifestWorkload(warm.path(), 1000);
+
+    const Footprint f = measure([&] { manifestWorkload(tree.path(), kFiles); });
+    const QString failure = checkBudget("manifest_100k", f, {15000000, 256 * kMiB, 16 * kMiB, 320 * kMiB});
+    QVERIFY2(failure.isEmpty(), qPrintable(failure));
+}
+
+void TestMemoryFootprint::ventoyWorkload(const QString& root)
+{
+    const IsoVerifier::MountScanResult scan = IsoVerifier::scanMountPoint(root);
+    QVERIFY(!scan.scanTruncated);
+    const QList<IsoVerifyResult> results = IsoVerifier::verifyMountPoint(root);
+    QCOMPARE(results.size(), scan.isoPaths.size());
+    for (const IsoVerifyResult& r : results) {
+        QVERIFY2(r.passed(), qPrintable(r.isoPath));
+    }
+}
+
+void TestMemoryFootprint::ventoyStickScan()
+{
+    constexpr int kImages = 30;
+    QTemporaryDir warm;
+    QTemporaryDir stick;
+    QVERIFY(makeVentoyStick(warm.path(), 2));
+    QVERIFY(makeVentoyStick(stick.path(), kImages));
+    ventoyWorkload(warm.path());
+
+    const Footprint f = measure([&] { ventoyWorkload(stick.path()); });
+    const QString failure = checkBudget("ventoy_30_iso", f, {600000, 64 * kMiB, 16 * kMiB, 96 * kMiB});
+    QVERIFY2(failure.isEmpty(), qPrintable(failure));
+}
+
+void TestMemoryFootprint::hidFloodWorkload(int minutes)
+{
+    // 16 keyboards and mice each plugged for 1 s every 5 s, on the trace's clock.
+    constexpr int kDevices = 16;
+    const qint64 spanMs = qint64(minutes) * 60 * 1000;
+    QList<UdevEventTrace::Event> events;
+    for (qint64 t = 0; t < spanMs; t += 5000) {
+        for (int d = 0; d < kDevices; ++d) {
+            for (const auto& [offsetMs, action] : {std::pair{0, "add"}, std::pair{1000, "remove"}}) {
+                UdevEventTrace::Event e;
+                e.offsetUs = (t + offsetMs + d * 10) * 1000;
+                e.source = "input";
+                e.device = hidDevice(d, action);
+                events.append(std::move(e));
+            }
+        }
+    }
+    std::sort(events.begin(), events.end(), [](const UdevEventTrace::Event& a, const UdevEventTrace::Event& b) {
+        return a.offsetUs < b.offsetUs;
+    });
+
+    HidDeviceMonitor monitor;
+    const BadUsbRuleSet rules = BadUsbRuleSet::compile(BadUsbRuleSet::builtinRules(AppSettings()));
+    HidConnectCounter connects;
+    const qint64 startSecs = 1700000000;
+    qint64 nowSecs = startSecs;
+    int connected = 0;
+    connect(&monitor, &HidDeviceMonitor::hidConnected, this, [&](const HidDeviceInfo& device) {
+        ++connected;
+        connects.record(device.stableId(), nowSecs);
+        BadUsbAnalyzer::analyzeConnect(device, std::nullopt, {}, connects, nowSecs, rules);
+    });
+    const UdevEventTrace::ReplayStats stats = UdevEventTrace::replay(events, 0, [&](const UdevEventTrace::Event& e) {
+        nowSecs = startSecs + e.offsetUs / 1000000;
+        monitor.replayEvent(e.device);
+    });
+    QCOMPARE(stats.delivered, int(events.size()));
+    QCOMPARE(connected, int(events.size() / 2));
+
+    // Meanwhile four keyboards type 20 keys a second, one of them with a 2 s injection
+    // burst every minute, into the pre-trigger ring and the keystroke-rate check.
+    UsbmonRing ring(10 * 1000000LL, kMiB);
+    HidKeystrokeAnalyzer keystrokes;
+    int findings = 0;
+    for (qint64 us = 0; us < spanMs * 1000; us += 25000) {
+        const bool burst = us % (60 * 1000000LL) < 2 * 1000000LL;
+        for (quint8 kb = 10; kb < 14; ++kb) {
+            const int reports = kb == 10 && burst ? 20 : 1;  // a key-down or key-up per report
+            for (int r = 0; r < reports; ++r) {
+                const qint64 at = us + r * 25000 / reports;
+                const quint8 key = (at / 25000 + r) % 2 ? quint8(4 + (at / 50000) % 26) : 0;
+                UsbmonPacket packet = keyReport(kb, at, key);
+                findings += keystrokes.feed(packet) ? 1 : 0;
+                ring.append(std::move(packet));
+            }
+        }
+    }
+    QVERIFY(findings > 0);
+    QVERIFY(ring.totalBytes() <= kMiB);
+}
+
+void TestMemoryFootprint::hidEventFlood()
+{
+    hidFloodWorkload(1);
+    const Footprint f = measure([&] { hidFloodWorkload(10); });
+    const QString failure = checkBudget("hid_flood_10min", f, {4000000, 24 * kMiB, 2 * kMiB, 48 * kMiB});
+    QVERIFY2(failure.isEmpty(), qPrintable(failure));
+}
+
+QTEST_MAIN(TestMemoryFootprint)
+#include "test_memory_footprint.moc"
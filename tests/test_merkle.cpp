@@ -1,6 +1,9 @@
 #include <QtTest>
+#include "HexEncoding.h"
 #include "MerkleTree.h"
 
+#include <QCryptographicHash>
+
 using namespace FlashSpartan;
 
 class TestMerkle : public QObject {
@@ -8,6 +11,15 @@ class TestMerkle : public QObject {
 private slots:
     void deterministicRoot();
     void orderIndependent();
+    void hexMatchesQt();
+    void combineHashesHexChildren();
+    void batchedBuildMatchesPairwise();
+    void updateLeavesMatchesRebuild();
+    void inclusionProofs();
+    void v2MatchesReference();
+    void v2SeparatesLeavesFromNodes();
+    void invalidShapeHasNoRoot();
+    void v2UpdatesAndProofs();
 };
 
 void TestMerkle::deterministicRoot()
@@ -41,5 +53,234 @@ void TestMerkle::orderIndependent()
     QCOMPARE(forward, reverse);
 }
 
+void TestMerkle::hexMatchesQt()
+{
+    QByteArray all;
+    for (int b = 0; b < 256; ++b) {
+        all.append(static_cast<char>(b));
+    }
+    QCOMPARE(HexEncoding::toString(all), QString::fromLatin1(all.toHex()));
+    QCOMPARE(MerkleTree::toHex(all), QString::fromLatin1(all.toHex()));
+    QCOMPARE(HexEncoding::toString(QByteArray()), QString());
+
+    char buf[512];
+    char* end = HexEncoding::encode(reinterpret_cast<const unsigned char*>(all.constData()),
+                                    static_cast<size_t>(all.size()), buf);
+    QCOMPARE(QByteArray(buf, static_cast<int>(end - buf)), all.toHex());
+}
+
+void TestMerkle::combineHashesHexChildren()
+{
+    const QByteArray left = QCryptographicHash::hash("left", QCryptographicHash::Sha256);
+    const QByteArray right = QCryptographicHash::hash("right", QCryptographicHash::Sha256);
+    const QByteArray expected =
+        QCryptographicHash::hash(left.toHex() + right.toHex(), QCryptographicHash::Sha256);
+    QCOMPARE(MerkleTree::combine(left, right), expected);
+}
+
+namespace {
+
+QString pairwiseRootHex(QVector<MerkleTree::Leaf> leaves)
+{
+    std::sort(leaves.begin(), leaves.end(), [](const MerkleTree::Leaf& a, const MerkleTree::Leaf& b) {
+        return a.relativePath < b.relativePath;
+    });
+    QVector<QByteArray> level;
+    for (const MerkleTree::Leaf& leaf : leaves) {
+        level.append(MerkleTree::leafDigest(leaf.relativePath, leaf.contentHashHex));
+    }
+    while (level.size() > 1) {
+        QVector<QByteArray> next;
+        for (int i = 0; i < level.size(); i += 2) {
+            next.append(MerkleTree::combine(level[i], level[qMin(i + 1, level.size() - 1)]));
+        }
+        level = next;
+    }
+    return MerkleTree::toHex(level.first());
+}
+
+} // namespace
+
+void TestMerkle::batchedBuildMatchesPairwise()
+{
+    // 5: odd levels; 9000: large enough to be split across threads.
+    for (int count : {1, 5, 9000}) {
+        QVector<MerkleTree::Leaf> leaves;
+        for (int i = 0; i < count; ++i) {
+            MerkleTree::Leaf leaf;
+            leaf.relativePath = QStringLiteral("dir/file-%1.bin").arg(i);
+            leaf.contentHashHex = QString::fromLatin1(
+                QCryptographicHash::hash(QByteArray::number(i), QCryptographicHash::Sha256).toHex());
+            leaves.append(leaf);
+        }
+        QCOMPARE(MerkleTree::rootHex(leaves), pairwiseRootHex(leaves));
+    }
+}
+
+namespace {
+
+QVector<MerkleTree::Leaf> numberedLeaves(int count)
+{
+    QVector<MerkleTree::Leaf> leaves;
+    for (int i = 0; i < count; ++i) {
+        MerkleTree::Leaf leaf;
+        leaf.relativePath = QStringLiteral("f%1").arg(i, 3, 10, QLatin1Char('0'));
+        leaf.contentHashHex = QString::number(i, 16);
+        leaves.append(leaf);
+    }
+    return leaves;
+}
+
+} // namespace
+
+void TestMerkle::updateLeavesMatchesRebuild()
+{
+    QVector<MerkleTree::Leaf> leaves = numberedLeaves(13);
+    MerkleTree tree = MerkleTree::build(leaves);
+    const QString before = tree.rootHex();
+
+    QVector<MerkleTree::Leaf> changed = {leaves.at(0), leaves.at(7), leaves.at(12)};
+    for (MerkleTree::Leaf& leaf : changed) {
+        leaf.contentHashHex = QStringLiteral("ff");
+    }
+    QVERIFY(tree.updateLeaves(changed));
+    leaves[0].contentHashHex = leaves[7].contentHashHex = leaves[12].contentHashHex = QStringLiteral("ff");
+    QCOMPARE(tree.rootHex(), MerkleTree::rootHex(leaves));
+    QVERIFY(tree.rootHex() != before);
+
+    const QString updated = tree.rootHex();
+    MerkleTree::Leaf unknown;
+    unknown.relativePath = QStringLiteral("missing");
+    QVERIFY(!tree.updateLeaves({unknown}));
+    QCOMPARE(tree.rootHex(), updated);
+}
+
+void TestMerkle::inclusionProofs()
+{
+    for (int count : {1, 2, 7}) {
+        const QVector<MerkleTree::Leaf> leaves = numberedLeaves(count);
+        const MerkleTree tree = MerkleTree::build(leaves);
+        for (const MerkleTree::Leaf& leaf : leaves) {
+            const auto proof = tree.inclusionProof(leaf.relativePath);
+            QVERIFY(MerkleTree::verifyInclusion(leaf.relativePath, leaf.contentHashHex, proof,
+                                                tree.rootHex()));
+            QVERIFY(!MerkleTree::verifyInclusion(leaf.relativePath, QStringLiteral("00"), proof,
+                                                 tree.rootHex()));
+        }
+    }
+}
+
+namespace {
+
+/** V2 by its definition: prefixed leaves and nodes, a lone last child moves up. */
+QString kAryRootHex(QVector<MerkleTree::Leaf> leaves, int fanOut)
+{
+    std::sort(leaves.begin(), leaves.end(), [](const MerkleTree::Leaf& a, const MerkleTree::Leaf& b) {
+        return a.relativePath < b.relativePath;
+    });
+    QVector<QByteArray> level;
+    for (const MerkleTree::Leaf& leaf : leaves) {
+        level.append(QCryptographicHash::hash(QByteArray(1, '\x00') + leaf.relativePath.toUtf8() + '\0'
+                                                  + leaf.contentHashHex.toLatin1(),
+                                              QCryptographicHash::Sha256));
+    }
+    while (level.size() > 1) {
+        QVector<QByteArray> next;
+        for (int i = 0; i < level.size(); i += fanOut) {
+            if (i + 1 == level.size()) {
+                next.append(level[i]);
+                break;
+            }
+            QByteArray node(1, '\x01');
+            for (int c = i; c < qMin(i + fanOut, level.size()); ++c) {
+                node += level[c];
+            }
+            next.append(QCryptographicHash::hash(node, QCryptographicHash::Sha256));
+        }
+        level = next;
+    }
+    return MerkleTree::toHex(level.first());
+}
+
+} // namespace
+
+void TestMerkle::v2MatchesReference()
+{
+    for (int fanOut : {2, 4, 16}) {
+        const MerkleTree::Shape shape{MerkleTree::Format::V2, fanOut};
+        // 9000: large enough to be split across threads.
+        for (int count : {1, 2, 5, 17, 64, 65, 9000}) {
+            const QVector<MerkleTree::Leaf> leaves = numberedLeaves(count);
+            const QString expected = kAryRootHex(leaves, fanOut);
+            QCOMPARE(MerkleTree::build(leaves, shape).rootHex(), expected);
+            QCOMPARE(MerkleTree::rootHex(leaves, shape), expected);
+        }
+    }
+    QVERIFY(MerkleTree::rootHex({}, MerkleTree::latestShape()).isEmpty());
+}
+
+void TestMerkle::v2SeparatesLeavesFromNodes()
+{
+    const QVector<MerkleTree::Leaf> leaves = numberedLeaves(1);
+    const MerkleTree::Leaf& only = leaves.first();
+    const QByteArray v2 = MerkleTree::leafDigest(only.relativePath, only.contentHashHex, MerkleTree::Format::V2);
+    QVERIFY(v2 != MerkleTree::leafDigest(only.relativePath, only.contentHashHex));
+    QCOMPARE(MerkleTree::rootHex(leaves, MerkleTree::latestShape()), MerkleTree::toHex(v2));
+
+    // Raw children, not their hex, and never a leaf's preimage.
+    const QByteArray left = QCryptographicHash::hash("left", QCryptographicHash::Sha256);
+    const QByteArray right = QCryptographicHash::hash("right", QCryptographicHash::Sha256);
+    QCOMPARE(MerkleTree::combineChildren(left + right),
+             QCryptographicHash::hash(QByteArray(1, '\x01') + left + right, QCryptographicHash::Sha256));
+
+    const QVector<MerkleTree::Leaf> many = numberedLeaves(9);
+    QVERIFY(MerkleTree::rootHex(many, MerkleTree::latestShape()) != MerkleTree::rootHex(many));
+    QVERIFY(MerkleTree::rootHex(many, {MerkleTree::Format::V2, 2})
+            != MerkleTree::rootHex(many, {MerkleTree::Format::V2, 4}));
+}
+
+void TestMerkle::invalidShapeHasNoRoot()
+{
+    const QVector<MerkleTree::Leaf> leaves = numberedLeaves(5);
+    for (const MerkleTree::Shape shape : {MerkleTree::Shape{MerkleTree::Format::V1, 4},
+                                          MerkleTree::Shape{MerkleTree::Format::V2, 1},
+                                          MerkleTree::Shape{MerkleTree::Format::V2, MerkleTree::kMaxFanOut + 1},
+                                          MerkleTree::Shape{static_cast<MerkleTree::Format>(3), 4}}) {
+        QVERIFY(!shape.isValid());
+        QVERIFY(MerkleTree::rootHex(leaves, shape).isEmpty());
+        MerkleTree tree = MerkleTree::build(leaves, shape);
+        QVERIFY(tree.rootHex().isEmpty());
+        QVERIFY(!tree.updateLeaves({leaves.first()}));
+    }
+}
+
+void TestMerkle::v2UpdatesAndProofs()
+{
+    for (int fanOut : {3, 4}) {
+        const MerkleTree::Shape shape{MerkleTree::Format::V2, fanOut};
+        for (int count : {1, 2, 7, 13}) {
+            QVector<MerkleTree::Leaf> leaves = numberedLeaves(count);
+            MerkleTree tree = MerkleTree::build(leaves, shape);
+            for (const MerkleTree::Leaf& leaf : leaves) {
+                const auto proof = tree.inclusionProof(leaf.relativePath);
+                QVERIFY(MerkleTree::verifyInclusion(leaf.relativePath, leaf.contentHashHex, proof,
+                                                    tree.rootHex(), shape));
+                QVERIFY(!MerkleTree::verifyInclusion(leaf.relativePath, QStringLiteral("00"), proof,
+                                                     tree.rootHex(), shape));
+                QVERIFY(!MerkleTree::verifyInclusion(leaf.relativePath, leaf.contentHashHex, proof,
+                                                     tree.rootHex()));
+            }
+
+            QVector<MerkleTree::Leaf> changed = {leaves.first(), leaves.last()};
+            for (MerkleTree::Leaf& leaf : changed) {
+                leaf.contentHashHex = QStringLiteral("ff");
+            }
+            QVERIFY(tree.updateLeaves(changed));
+            leaves.first().contentHashHex = leaves.last().contentHashHex = QStringLiteral("ff");
+            QCOMPARE(tree.rootHex(), MerkleTree::rootHex(leaves, shape));
+        }
+    }
+}
+
 QTEST_MAIN(TestMerkle)
 #include "test_merkle.moc"
@@ -0,0 +1,77 @@
+#include <QtTest>
+
+#include <unistd.h>
+
+#include "MountTable.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+const QByteArray kMountInfo =
+    "22 1 259:2 / / rw,relatime shared:1 - ext4 /dev/nvme0n1p2 rw\n"
+    "25 22 0:23 / /proc rw,nosuid - proc proc rw\n"
+    "61 22 8:17 / /media/user/MY\\040STICK rw,nosuid,nodev shared:40 - vfat /dev/sdb1 rw,fmask=0022\n"
+    "62 22 8:17 / /mnt/bind rw - vfat /dev/sdb1 rw\n"
+    "70 22 253:0 / /media/user/crypt rw master:3 - ext4 /dev/mapper/luks-1234 rw\n"
+    "71 22 0:45 / /media/user/tab\\011and\\134slash rw - btrfs /dev/sdc1 rw\n";
+
+} // namespace
+
+class TestMountTable : public QObject {
+    Q_OBJECT
+
+private slots:
+    void parsesMountInfo();
+    void findsByDeviceNumberOrName();
+    void currentTableIsCached();
+};
+
+void TestMountTable::parsesMountInfo()
+{
+    const auto table = MountTable::parse(kMountInfo);
+    QCOMPARE(table->entries.size(), 6);
+    const MountEntry& stick = table->entries.at(2);
+    QCOMPARE(stick.source, QStringLiteral("/dev/sdb1"));
+    QCOMPARE(stick.mountPoint, QStringLiteral("/media/user/MY STICK"));
+    QCOMPARE(stick.fsType, QStringLiteral("vfat"));
+    QCOMPARE(stick.major, 8u);
+    QCOMPARE(stick.minor, 17u);
+    QCOMPARE(table->entries.at(5).mountPoint, QStringLiteral("/media/user/tab\tand\\slash"));
+    QVERIFY(!table->bySource.contains(QStringLiteral("proc")));
+}
+
+void TestMountTable::findsByDeviceNumberOrName()
+{
+    const auto table = MountTable::parse(kMountInfo);
+    const MountEntry* stick = table->find(QStringLiteral("/dev/sdb1"));
+    QVERIFY(stick);
+    QCOMPARE(stick->mountPoint, QStringLiteral("/media/user/MY STICK"));  // first of two mounts
+
+    // udev names the mapper device /dev/dm-0; mountinfo lists it under /dev/mapper.
+    const MountEntry* crypt = table->find(QStringLiteral("/dev/dm-0"), 253, 0);
+    QVERIFY(crypt);
+    QCOMPARE(crypt->mountPoint, QStringLiteral("/media/user/crypt"));
+
+    // btrfs reports an anonymous device number, so the name is used instead.
+    const MountEntry* btrfs = table->find(QStringLiteral("/dev/sdc1"), 8, 33);
+    QVERIFY(btrfs);
+    QCOMPARE(btrfs->fsType, QStringLiteral("btrfs"));
+
+    QVERIFY(!table->find(QStringLiteral("/dev/sdd1"), 8, 49));
+}
+
+void TestMountTable::currentTableIsCached()
+{
+    const int fd = MountTable::openChangeFd();
+    if (fd < 0) {
+        QSKIP("/proc/self/mountinfo is not available");
+    }
+    ::close(fd);
+    const auto first = MountTable::current();
+    QVERIFY(!first->entries.isEmpty());
+    QCOMPARE(MountTable::current().get(), first.get());  // nothing was mounted in between
+}
+
+QTEST_MAIN(TestMountTable)
+#include "test_mount_table.moc"
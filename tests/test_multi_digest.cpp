@@ -0,0 +1,74 @@
+#include <QtTest>
+#include "MultiDigest.h"
+
+#include <QCryptographicHash>
+
+using namespace FlashSpartan;
+
+namespace {
+
+QByteArray sampleData()
+{
+    QByteArray data;
+    for (int i = 0; i < 3 * 1024 * 1024 + 17; ++i) {
+        data.append(static_cast<char>((i * 131) ^ (i >> 9)));
+    }
+    return data;
+}
+
+QString qtHex(const QByteArray& data, QCryptographicHash::Algorithm algorithm)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(data, algorithm).toHex());
+}
+
+} // namespace
+
+class TestMultiDigest : public QObject {
+    Q_OBJECT
+private slots:
+    void allDigestsInOnePass();
+    void onlyRequestedDigestsAreSet();
+    void finishTwiceFails();
+};
+
+void TestMultiDigest::allDigestsInOnePass()
+{
+    const QByteArray data = sampleData();
+    MultiDigest digest(DigestAlgorithm::Sha256 | DigestAlgorithm::Sha512 | DigestAlgorithm::Blake2b512);
+    QVERIFY(digest.isValid());
+    constexpr qsizetype kChunk = 1024 * 1024;
+    for (qsizetype off = 0; off < data.size(); off += kChunk) {
+        QVERIFY(digest.update(data.constData() + off,
+                              static_cast<size_t>(qMin(kChunk, data.size() - off))));
+    }
+    DigestValues values;
+    QVERIFY(digest.finish(&values));
+    QCOMPARE(values.sha256, qtHex(data, QCryptographicHash::Sha256));
+    QCOMPARE(values.sha512, qtHex(data, QCryptographicHash::Sha512));
+    QCOMPARE(values.blake2b512, qtHex(data, QCryptographicHash::Blake2b_512));
+}
+
+void TestMultiDigest::onlyRequestedDigestsAreSet()
+{
+    const QByteArray data("abc");
+    MultiDigest digest(DigestAlgorithm::Sha512);
+    QVERIFY(digest.update(data.constData(), static_cast<size_t>(data.size())));
+    DigestValues values;
+    QVERIFY(digest.finish(&values));
+    QVERIFY(values.sha256.isEmpty());
+    QVERIFY(values.blake2b512.isEmpty());
+    QCOMPARE(values.value(DigestAlgorithm::Sha512), qtHex(data, QCryptographicHash::Sha512));
+}
+
+void TestMultiDigest::finishTwiceFails()
+{
+    MultiDigest digest(DigestAlgorithm::Sha256);
+    DigestValues values;
+    QVERIFY(digest.finish(&values));
+    QCOMPARE(values.sha256, qtHex(QByteArray(), QCryptographicHash::Sha256));
+    QVERIFY(!digest.finish(&values));
+    QVERIFY(!MultiDigest(DigestAlgorithms()).isValid());
+}
+
+QTEST_MAIN(TestMultiDigest)
+#include "test_multi_digest.moc"
@@ -0,0 +1,141 @@
+#include <QtTest>
+
+#include "NotificationCoalescer.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+TrayNotice notice(TrayNotice::Category category, const QString& message, bool failed = false)
+{
+    TrayNotice n;
+    n.category = category;
+    n.title = QStringLiteral("Title");
+    n.message = message;
+    n.failed = failed;
+    if (failed) {
+        n.level = TrayNotice::Level::Critical;
+        n.durationMs = 8000;
+    }
+    return n;
+}
+
+TrayNotice delivered(const QSignalSpy& spy, int i)
+{
+    return spy.at(i).at(0).value<TrayNotice>();
+}
+
+} // namespace
+
+class TestNotificationCoalescer : public QObject {
+    Q_OBJECT
+
+private slots:
+    void burstBecomesOneSummary();
+    void singleNoticeIsRateLimited();
+    void securityBypassesTheQueue();
+    void mixedCategoriesGetALineEach();
+    void clearDropsHeldNotices();
+};
+
+void TestNotificationCoalescer::burstBecomesOneSummary()
+{
+    NotificationCoalescer coalescer;
+    coalescer.setIntervals(50, 300);
+    QSignalSpy spy(&coalescer, &NotificationCoalescer::deliver);
+
+    for (int i = 0; i < 7; ++i) {
+        coalescer.post(notice(TrayNotice::Category::Verification, QStringLiteral("sd%1 ok").arg(i)));
+    }
+    coalescer.post(notice(TrayNotice::Category::Verification, QStringLiteral("sdz failed"), true));
+    QCOMPARE(spy.count(), 0);
+    QCOMPARE(coalescer.pendingCount(), 8);
+
+    QTRY_COMPARE(spy.count(), 1);
+    const TrayNotice out = delivered(spy, 0);
+    QCOMPARE(out.title, QStringLiteral("Verification"));
+    QCOMPARE(out.message, QStringLiteral("7 devices verified, 1 failed"));
+    QCOMPARE(out.level, TrayNotice::Level::Critical);
+    QCOMPARE(out.durationMs, 8000);
+    QVERIFY(out.failed);
+    QCOMPARE(coalescer.pendingCount(), 0);
+}
+
+void TestNotificationCoalescer::singleNoticeIsRateLimited()
+{
+    NotificationCoalescer coalescer;
+    coalescer.setIntervals(20, 400);
+    QSignalSpy spy(&coalescer, &NotificationCoalescer::deliver);
+
+    coalescer.post(notice(TrayNotice::Category::HashCompleted, QStringLiteral("first")));
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(delivered(spy, 0).message, QStringLiteral("first"));
+    QCOMPARE(delivered(spy, 0).title, QStringLiteral("Title"));
+
+    coalescer.post(notice(TrayNotice::Category::HashCompleted, QStringLiteral("second")));
+    QTest::qWait(150);
+    QCOMPARE(spy.count(), 1);
+    QTRY_COMPARE(spy.count(), 2);
+    QCOMPARE(delivered(spy, 1).message, QStringLiteral("second"));
+}
+
+void TestNotificationCoalescer::securityBypassesTheQueue()
+{
+    NotificationCoalescer coalescer;
+    coalescer.setIntervals(50, 5000, 200);
+    QSignalSpy spy(&coalescer, &NotificationCoalescer::deliver);
+
+    coalescer.post(notice(TrayNotice::Category::DeviceConnected, QStringLiteral("held")));
+    coalescer.post(notice(TrayNotice::Category::Security, QStringLiteral("keystrokes from sdb"), true));
+    QCOMPARE(spy.count(), 1);
+    QCOMPARE(delivered(spy, 0).message, QStringLiteral("keystrokes from sdb"));
+
+    // A reconnect flood repeats the same alert; it is on screen already.
+    coalescer.post(notice(TrayNotice::Category::Security, QStringLiteral("keystrokes from sdb"), true));
+    QCOMPARE(spy.count(), 1);
+    coalescer.post(notice(TrayNotice::Category::Security, QStringLiteral("keystrokes from sdc"), true));
+    QCOMPARE(spy.count(), 2);
+    QCOMPARE(coalescer.pendingCount(), 1);
+
+    QTest::qWait(250);
+    coalescer.post(notice(TrayNotice::Category::Security, QStringLiteral("keystrokes from sdb"), true));
+    QCOMPARE(delivered(spy, spy.count() - 1).message, QStringLiteral("keystrokes from sdb"));
+}
+
+void TestNotificationCoalescer::mixedCategoriesGetALineEach()
+{
+    NotificationCoalescer coalescer;
+    coalescer.setIntervals(1000, 1000);
+    QSignalSpy spy(&coalescer, &NotificationCoalescer::deliver);
+
+    coalescer.post(notice(TrayNotice::Category::DeviceConnected, QStringLiteral("a")));
+    coalescer.post(notice(TrayNotice::Category::DeviceConnected, QStringLiteral("b"), true));
+    coalescer.post(notice(TrayNotice::Category::DeviceRemoved, QStringLiteral("c")));
+    coalescer.post(notice(TrayNotice::Category::IsoVerify, QStringLiteral("d")));
+    coalescer.flush();
+    QCOMPARE(spy.count(), 1);
+    const TrayNotice out = delivered(spy, 0);
+    QCOMPARE(out.title, QStringLiteral("FlashSpartan: 4 events"));
+    QCOMPARE(out.message, QStringLiteral("2 devices connected, 1 not whitelisted\n"
+                                         "1 device removed\n"
+                                         "ISO images checked on 1 device"));
+
+    QCOMPARE(NotificationCoalescer::summaryLine(TrayNotice::Category::Verification, 3, 3),
+             QStringLiteral("3 devices failed verification"));
+}
+
+void TestNotificationCoalescer::clearDropsHeldNotices()
+{
+    NotificationCoalescer coalescer;
+    coalescer.setIntervals(30, 30);
+    QSignalSpy spy(&coalescer, &NotificationCoalescer::deliver);
+
+    coalescer.post(notice(TrayNotice::Category::DeviceRemoved, QStringLiteral("gone")));
+    coalescer.clear();
+    QCOMPARE(coalescer.pendingCount(), 0);
+    QTest::qWait(100);
+    QCOMPARE(spy.count(), 0);
+}
+
+QTEST_MAIN(TestNotificationCoalescer)
+#include "test_notification_coalescer.moc"
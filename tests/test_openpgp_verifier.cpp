@@ -0,0 +1,116 @@
+#include <QtTest>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include "OpenPgpVerifier.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+const QString kCatalogFingerprint = QStringLiteral("541DFAEB302C380671E666C7BBD811EF6FBA0EBC");
+const QString kSubkeyPrimaryFingerprint = QStringLiteral("310087E709CD8B5B0C4E56FCB66B6BA1CB47B647");
+
+QString fixture(const QString& relative)
+{
+    return QStringLiteral(FLASHSPARTAN_TEST_FIXTURES_DIR) + QLatin1Char('/') + relative;
+}
+
+QByteArray readFixture(const QString& relative)
+{
+    QFile f(fixture(relative));
+    return f.open(QIODevice::ReadOnly) ? f.readAll() : QByteArray();
+}
+
+OpenPgpVerifier::KeyRing ringFrom(const QString& relative)
+{
+    OpenPgpVerifier::KeyRing ring;
+    ring.addKeys(readFixture(relative));
+    return ring;
+}
+
+} // namespace
+
+class TestOpenPgpVerifier : public QObject {
+    Q_OBJECT
+
+private slots:
+    void rsaBinaryAndArmored_data();
+    void rsaBinaryAndArmored();
+    void signingSubkey_data();
+    void signingSubkey();
+    void alteredDataIsBad();
+    void unknownKeyIsReported();
+    void garbageIsMalformed();
+};
+
+void TestOpenPgpVerifier::rsaBinaryAndArmored_data()
+{
+    QTest::addColumn<QString>("signature");
+    QTest::newRow("armored") << QStringLiteral("publisher-mock/SHA256SUMS.sig");
+    QTest::newRow("binary") << QStringLiteral("publisher-mock/SHA256SUMS.gpg");
+}
+
+void TestOpenPgpVerifier::rsaBinaryAndArmored()
+{
+    QFETCH(QString, signature);
+    const auto ring = ringFrom(QStringLiteral("catalog-signing/catalog-signing.pub"));
+    QVERIFY(!ring.isEmpty());
+    QVERIFY(ring.contains(kCatalogFingerprint));
+    QVERIFY(ring.contains(QStringLiteral("0xBBD811EF6FBA0EBC")));
+
+    const auto r = OpenPgpVerifier::verifyDetachedFile(ring, fixture(signature),
+                                                       fixture(QStringLiteral("publisher-mock/SHA256SUMS")));
+    QCOMPARE(r.status, OpenPgpVerifier::Status::Good);
+    QCOMPARE(r.fingerprint, kCatalogFingerprint);
+}
+
+void TestOpenPgpVerifier::signingSubkey_data()
+{
+    QTest::addColumn<QString>("signature");
+    QTest::newRow("binary-sha256") << QStringLiteral("openpgp/SHA256SUMS.sig");
+    QTest::newRow("text-sha512") << QStringLiteral("openpgp/SHA256SUMS.asc");
+}
+
+void TestOpenPgpVerifier::signingSubkey()
+{
+    QFETCH(QString, signature);
+    const auto ring = ringFrom(QStringLiteral("openpgp/subkey-signing.pub"));
+    const auto r = OpenPgpVerifier::verifyDetached(ring, readFixture(signature),
+                                                   readFixture(QStringLiteral("openpgp/SHA256SUMS")));
+    QCOMPARE(r.status, OpenPgpVerifier::Status::Good);
+    QCOMPARE(r.keyId, QStringLiteral("0C0171E9326A1206"));
+    QCOMPARE(r.fingerprint, kSubkeyPrimaryFingerprint);
+}
+
+void TestOpenPgpVerifier::alteredDataIsBad()
+{
+    const auto ring = ringFrom(QStringLiteral("catalog-signing/catalog-signing.pub"));
+    QByteArray data = readFixture(QStringLiteral("publisher-mock/SHA256SUMS"));
+    QVERIFY(!data.isEmpty());
+    data[0] = data[0] == '0' ? '1' : '0';
+    const auto r = OpenPgpVerifier::verifyDetached(
+        ring, readFixture(QStringLiteral("publisher-mock/SHA256SUMS.gpg")), data);
+    QCOMPARE(r.status, OpenPgpVerifier::Status::Bad);
+    QVERIFY(!r.good());
+}
+
+void TestOpenPgpVerifier::unknownKeyIsReported()
+{
+    const auto ring = ringFrom(QStringLiteral("openpgp/subkey-signing.pub"));
+    const auto r = OpenPgpVerifier::verifyDetachedFile(
+        ring, fixture(QStringLiteral("publisher-mock/SHA256SUMS.gpg")),
+        fixture(QStringLiteral("publisher-mock/SHA256SUMS")));
+    QCOMPARE(r.status, OpenPgpVerifier::Status::NoPublicKey);
+    QCOMPARE(r.keyId, QStringLiteral("BBD811EF6FBA0EBC"));
+}
+
+void TestOpenPgpVerifier::garbageIsMalformed()
+{
+    const auto ring = ringFrom(QStringLiteral("catalog-signing/catalog-signing.pub"));
+    const auto r = OpenPgpVerifier::verifyDetached(ring, QByteArray("not a signature"), QByteArray("data"));
+    QCOMPARE(r.status, OpenPgpVerifier::Status::Malformed);
+}
+
+QTEST_MAIN(TestOpenPgpVerifier)
+#include "test_openpgp_verifier.moc"
@@ -0,0 +1,194 @@
+#include <QtTest>
+
+#include <QTemporaryDir>
+#include <QtConcurrent>
+
+#include "PerfMetrics.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+QStringList linesStartingWith(const QByteArray& text, const QString& prefix)
+{
+    QStringList out;
+    for (const QString& line : QString::fromUtf8(text).split(QLatin1Char('\n'))) {
+        if (line.startsWith(prefix)) {
+            out.append(line);
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+class TestPerfMetrics : public QObject {
+    Q_OBJECT
+
+private slots:
+    void countersAreSharedByNameAndLabels();
+    void countersAddFromManyThreads();
+    void histogramBucketsArePowersOfTwo();
+    void quantilesComeFromBuckets();
+    void prometheusTextGroupsFamilies();
+    void histogramExportIsCumulative();
+    void applicationMetricsRegister();
+};
+
+void TestPerfMetrics::countersAreSharedByNameAndLabels()
+{
+    PerfMetrics::Counter& a = PerfMetrics::counter("test_shared_total", "help", QStringLiteral("k=\"a\""));
+    PerfMetrics::Counter& again = PerfMetrics::counter("test_shared_total", "other help", QStringLiteral("k=\"a\""));
+    PerfMetrics::Counter& b = PerfMetrics::counter("test_shared_total", "help", QStringLiteral("k=\"b\""));
+    QCOMPARE(&a, &again);
+    QVERIFY(&a != &b);
+    a.add(3);
+    again.add();
+    QCOMPARE(a.value(), uint64_t(4));
+    QCOMPARE(b.value(), uint64_t(0));
+
+    PerfMetrics::Gauge& g = PerfMetrics::gauge("test_gauge", "help");
+    g.set(5);
+    g.add(-2);
+    QCOMPARE(g.value(), int64_t(3));
+}
+
+void TestPerfMetrics::countersAddFromManyThreads()
+{
+    PerfMetrics::Counter& c = PerfMetrics::counter("test_threads_total", "help");
+    QThreadPool pool;
+    pool.setMaxThreadCount(4);
+    QList<QFuture<void>> futures;
+    for (int t = 0; t < 4; ++t) {
+        futures.append(QtConcurrent::run(&pool, [&c]() {
+            for (int i = 0; i < 10000; ++i) {
+                c.add();
+            }
+        }));
+    }
+    for (QFuture<void>& f : futures) {
+        f.waitForFinished();
+    }
+    QCOMPARE(c.value(), uint64_t(40000));
+}
+
+void TestPerfMetrics::histogramBucketsArePowersOfTwo()
+{
+    PerfMetrics::Histogram h;
+    h.observeNs(0);           // bucket 0 (≤ 1 µs)
+    h.observeNs(1000);        // bucket 0
+    h.observeNs(1001);        // 2 µs after rounding up: bucket 1
+    h.observeNs(3000);        // bucket 2 (≤ 4 µs)
+    h.observeNs(4000);        // bucket 2
+    h.observeNs(3600LL * 1000 * 1000 * 1000);  // an hour: overflow
+    const auto counts = h.buckets();
+    QCOMPARE(counts[0], uint64_t(2));
+    QCOMPARE(counts[1], uint64_t(1));
+    QCOMPARE(counts[2], uint64_t(2));
+    QCOMPARE(counts[PerfMetrics::Histogram::kBuckets], uint64_t(1));
+    QCOMPARE(h.count(), uint64_t(6));
+    QVERIFY(std::isinf(PerfMetrics::Histogram::upperBoundSeconds(PerfMetrics::Histogram::kBuckets)));
+    QCOMPARE(PerfMetrics::Histogram::upperBoundSeconds(10), 1024e-6);
+}
+
+void TestPerfMetrics::quantilesComeFromBuckets()
+{
+    PerfMetrics::Histogram h;
+    QCOMPARE(h.quantileSeconds(0.5), 0.0);
+    for (int i = 0; i < 90; ++i) {
+        h.observeNs(100 * 1000);  // 100 µs: bucket ≤ 128 µs
+    }
+    for (int i = 0; i < 10; ++i) {
+        h.observeNs(5 * 1000 * 1000);  // 5 ms: bucket ≤ 8.192 ms
+    }
+    QCOMPARE(h.quantileSeconds(0.5), 128e-6);
+    QCOMPARE(h.quantileSeconds(0.9), 128e-6);
+    QCOMPARE(h.quantileSeconds(0.99), 8192e-6);
+    QCOMPARE(h.sumSeconds(), 0.009 + 0.05);
+
+    {
+        PerfMetrics::ScopedTimer timer(h);
+    }
+    QCOMPARE(h.count(), uint64_t(101));
+}
+
+void TestPerfMetrics::prometheusTextGroupsFamilies()
+{
+    PerfMetrics::counter("test_family_total", "A family.", QStringLiteral("x=\"1\"")).add(2);
+    PerfMetrics::counter("test_family_a_total", "Another family.").add(1);
+    PerfMetrics::counter("test_family_total", "A family.", QStringLiteral("x=\"2\"")).add(5);
+
+    const QByteArray text = PerfMetrics::toPrometheusText();
+    QCOMPARE(linesStartingWith(text, QStringLiteral("# HELP test_family_total ")),
+             QStringList{QStringLiteral("# HELP test_family_total A family.")});
+    QCOMPARE(linesStartingWith(text, QStringLiteral("# TYPE test_family_total ")),
+             QStringList{QStringLiteral("# TYPE test_family_total counter")});
+    const QStringList series = linesStartingWith(text, QStringLiteral("test_family_total{"));
+    QCOMPARE(series, (QStringList{QStringLiteral("test_family_total{x=\"1\"} 2"),
+                                  QStringLiteral("test_family_total{x=\"2\"} 5")}));
+    QVERIFY(text.contains("\ntest_family_a_total 1\n"));
+
+    // The series of one family are contiguous, right after its TYPE line
+    const QStringList lines = QString::fromUtf8(text).split(QLatin1Char('\n'));
+    const qsizetype type = lines.indexOf(QStringLiteral("# TYPE test_family_total counter"));
+    QCOMPARE(lines.value(type + 1), series.at(0));
+    QCOMPARE(lines.value(type + 2), series.at(1));
+
+    QTemporaryDir dir;
+    const QString path = dir.filePath(QStringLiteral("metrics.prom"));
+    QVERIFY(PerfMetrics::writeTo(path));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    QVERIFY(file.readAll().contains("test_family_total{x=\"2\"} 5"));
+}
+
+void TestPerfMetrics::histogramExportIsCumulative()
+{
+    PerfMetrics::Histogram& h =
+        PerfMetrics::histogram("test_latency_seconds", "Latency.", QStringLiteral("op=\"read\""));
+    h.observeNs(500);
+    h.observeNs(3000);
+    h.observeNs(3000);
+
+    const QByteArray text = PerfMetrics::toPrometheusText();
+    QVERIFY(text.contains("# TYPE test_latency_seconds histogram\n"));
+    const QStringList buckets = linesStartingWith(text, QStringLiteral("test_latency_seconds_bucket{"));
+    QCOMPARE(buckets.size(), qsizetype(PerfMetrics::Histogram::kBuckets + 1));
+    QCOMPARE(buckets.at(0), QStringLiteral("test_latency_seconds_bucket{op=\"read\",le=\"1e-06\"} 1"));
+    QCOMPARE(buckets.at(1), QStringLiteral("test_latency_seconds_bucket{op=\"read\",le=\"2e-06\"} 1"));
+    QCOMPARE(buckets.at(2), QStringLiteral("test_latency_seconds_bucket{op=\"read\",le=\"4e-06\"} 3"));
+    QCOMPARE(buckets.last(), QStringLiteral("test_latency_seconds_bucket{op=\"read\",le=\"+Inf\"} 3"));
+    QVERIFY(text.contains("\ntest_latency_seconds_count{op=\"read\"} 3\n"));
+    QVERIFY(text.contains("\ntest_latency_seconds_sum{op=\"read\"} 6.5e-06\n"));
+}
+
+void TestPerfMetrics::applicationMetricsRegister()
+{
+    PerfMetrics::cacheLookup(PerfMetrics::Cache::Http, true).add();
+    PerfMetrics::cacheLookup(PerfMetrics::Cache::Http, false).add(2);
+    PerfMetrics::hashedBytes(QStringLiteral("SHA256")).add(4096);
+    PerfMetrics::hashQueueDepth(false).set(3);
+    PerfMetrics::readLatency().observeNs(20000);
+
+    QCOMPARE(&PerfMetrics::hashedBytes(QStringLiteral("SHA256")), &PerfMetrics::hashedBytes(QStringLiteral("SHA256")));
+    const QByteArray text = PerfMetrics::toPrometheusText();
+    QVERIFY(text.contains("flashspartan_cache_lookups_total{cache=\"http\",result=\"hit\"} 1\n"));
+    QVERIFY(text.contains("flashspartan_cache_lookups_total{cache=\"http\",result=\"miss\"} 2\n"));
+    QVERIFY(text.contains("flashspartan_hashed_bytes_total{algorithm=\"SHA256\"} 4096\n"));
+    QVERIFY(text.contains("flashspartan_hash_jobs{state=\"pending\"} 3\n"));
+    QVERIFY(text.contains("flashspartan_read_latency_seconds_count 1\n"));
+
+    bool found = false;
+    for (const PerfMetrics::Series& s : PerfMetrics::snapshot()) {
+        if (s.name == QLatin1String("flashspartan_read_latency_seconds")) {
+            found = true;
+            QVERIFY(s.kind == PerfMetrics::Kind::Histogram);
+            QCOMPARE(s.count, uint64_t(1));
+            QCOMPARE(s.p50, 32e-6);
+        }
+    }
+    QVERIFY(found);
+}
+
+QTEST_MAIN(TestPerfMetrics)
+#include "test_perf_metrics.moc"
@@ -0,0 +1,136 @@
+#include <QtTest>
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QTemporaryDir>
+#include <QtConcurrent>
+
+#include "PerfTrace.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+QList<QJsonObject> spans(const QByteArray& json)
+{
+    QList<QJsonObject> out;
+    for (const QJsonValue& v : QJsonDocument::fromJson(json).object().value(QStringLiteral("traceEvents")).toArray()) {
+        const QJsonObject obj = v.toObject();
+        if (obj.value(QStringLiteral("ph")).toString() == QLatin1String("X")) {
+            out.append(obj);
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+class TestPerfTrace : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init()
+    {
+        PerfTrace::clear();
+        PerfTrace::setEnabled(true);
+    }
+    void cleanup() { PerfTrace::setEnabled(false); }
+    void spansRecordWhenEnabled();
+    void nothingRecordedWhenDisabled();
+    void threadsGetTheirOwnRings();
+    void fullRingKeepsNewestEvents();
+    void macrosFollowTheBuildOption();
+};
+
+void TestPerfTrace::spansRecordWhenEnabled()
+{
+    {
+        PerfTrace::Span outer("test", "outer", 4096);
+        QTest::qSleep(2);
+    }
+    const qint64 begin = PerfTrace::nowNs();
+    PerfTrace::record("test", "measured", begin, begin + 1500000);
+
+    const QList<QJsonObject> events = spans(PerfTrace::toJson());
+    QCOMPARE(events.size(), 2);
+    QCOMPARE(events.at(0).value(QStringLiteral("name")).toString(), QStringLiteral("outer"));
+    QCOMPARE(events.at(0).value(QStringLiteral("cat")).toString(), QStringLiteral("test"));
+    QVERIFY(events.at(0).value(QStringLiteral("dur")).toDouble() >= 2000.0);
+    QCOMPARE(events.at(0).value(QStringLiteral("args")).toObject().value(QStringLiteral("value")).toInteger(), 4096);
+    QCOMPARE(events.at(1).value(QStringLiteral("dur")).toDouble(), 1500.0);
+    QVERIFY(!events.at(1).contains(QStringLiteral("args")));
+    QCOMPARE(events.at(0).value(QStringLiteral("ts")).toDouble(), 0.0);  // relative to the first event
+}
+
+void TestPerfTrace::nothingRecordedWhenDisabled()
+{
+    PerfTrace::setEnabled(false);
+    {
+        PerfTrace::Span span("test", "off");
+    }
+    PerfTrace::record("test", "off", 0, 10);
+    QVERIFY(spans(PerfTrace::toJson()).isEmpty());
+}
+
+void TestPerfTrace::threadsGetTheirOwnRings()
+{
+    QThreadPool pool;
+    pool.setMaxThreadCount(4);
+    QList<QFuture<void>> futures;
+    for (int i = 0; i < 4; ++i) {
+        futures.append(QtConcurrent::run(&pool, [] {
+            for (int n = 0; n < 100; ++n) {
+                PerfTrace::Span span("test", "worker");
+            }
+            QTest::qSleep(20);  // keep the thread so each task gets its own
+        }));
+    }
+    for (QFuture<void>& f : futures) {
+        f.waitForFinished();
+    }
+
+    const QList<QJsonObject> events = spans(PerfTrace::toJson());
+    QCOMPARE(events.size(), 400);
+    QSet<int> threads;
+    for (const QJsonObject& e : events) {
+        threads.insert(e.value(QStringLiteral("tid")).toInt());
+    }
+    QCOMPARE(threads.size(), 4);
+}
+
+void TestPerfTrace::fullRingKeepsNewestEvents()
+{
+    const qint64 base = PerfTrace::nowNs();
+    const qint64 total = static_cast<qint64>(PerfTrace::kRingEvents) + 10;
+    for (qint64 i = 0; i < total; ++i) {
+        PerfTrace::record("test", "wrap", base + i * 1000, base + i * 1000 + 1, i);
+    }
+    const QList<QJsonObject> events = spans(PerfTrace::toJson());
+    QCOMPARE(events.size(), static_cast<qsizetype>(PerfTrace::kRingEvents));
+    QCOMPARE(events.first().value(QStringLiteral("args")).toObject().value(QStringLiteral("value")).toInteger(), 10);
+    QCOMPARE(events.last().value(QStringLiteral("args")).toObject().value(QStringLiteral("value")).toInteger(),
+             total - 1);
+}
+
+void TestPerfTrace::macrosFollowTheBuildOption()
+{
+    {
+        FLASHSPARTAN_TRACE_SPAN("test", "macro");
+        FLASHSPARTAN_TRACE_SPAN_VALUE("test", "macro_value", 7);
+    }
+    QTemporaryDir dir;
+    const QString path = dir.filePath(QStringLiteral("trace.json"));
+    QVERIFY(PerfTrace::writeTo(path));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+#ifdef FLASHSPARTAN_TRACING
+    QCOMPARE(spans(file.readAll()).size(), 2);
+#else
+    QVERIFY(spans(file.readAll()).isEmpty());
+#endif
+}
+
+QTEST_MAIN(TestPerfTrace)
+#include "test_perf_trace.moc"
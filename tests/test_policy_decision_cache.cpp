@@ -0,0 +1,79 @@
+#include <QtTest>
+
+#include "PolicyDecisionCache.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+PolicyDecision decisionOn(const QString& drive, bool blocked)
+{
+    PolicyDecision decision;
+    decision.driveKey = drive;
+    decision.known = true;
+    decision.blocked = blocked;
+    decision.finalStage = VerifyStage::Metadata;
+    return decision;
+}
+
+} // namespace
+
+class TestPolicyDecisionCache : public QObject {
+    Q_OBJECT
+
+private slots:
+    void hitUntilASourceMoves();
+    void otherDriveMisses();
+    void clearDropsEverything();
+};
+
+void TestPolicyDecisionCache::hitUntilASourceMoves()
+{
+    PolicyDecisionCache cache;
+    const PolicyDecisionCache::Sources sources{3, 1, 2};
+    QVERIFY(!cache.find(QStringLiteral("id-a"), QStringLiteral("sdb"), sources));
+    cache.insert(QStringLiteral("id-a"), decisionOn(QStringLiteral("sdb"), true));
+
+    const auto hit = cache.find(QStringLiteral("id-a"), QStringLiteral("sdb"), sources);
+    QVERIFY(hit.has_value());
+    QVERIFY(hit->blocked);
+    QCOMPARE(hit->finalStage, VerifyStage::Metadata);
+
+    for (const PolicyDecisionCache::Sources moved : {PolicyDecisionCache::Sources{4, 1, 2},
+                                                     PolicyDecisionCache::Sources{3, 2, 2},
+                                                     PolicyDecisionCache::Sources{3, 1, 3}}) {
+        cache.insert(QStringLiteral("id-a"), decisionOn(QStringLiteral("sdb"), true));
+        QVERIFY(!cache.find(QStringLiteral("id-a"), QStringLiteral("sdb"), moved));
+        QCOMPARE(cache.size(), 0);
+        // Going back to older sources drops them again rather than reviving anything.
+        QVERIFY(!cache.find(QStringLiteral("id-a"), QStringLiteral("sdb"), sources));
+    }
+}
+
+void TestPolicyDecisionCache::otherDriveMisses()
+{
+    PolicyDecisionCache cache;
+    const PolicyDecisionCache::Sources sources{1, 1, 1};
+    QVERIFY(!cache.find(QStringLiteral("id-a"), QStringLiteral("sdb"), sources));
+    cache.insert(QStringLiteral("id-a"), decisionOn(QStringLiteral("sdb"), false));
+    // The same stick on another port: a block on the old drive key says nothing about it.
+    QVERIFY(!cache.find(QStringLiteral("id-a"), QStringLiteral("sdc"), sources));
+    QVERIFY(!cache.find(QStringLiteral("id-b"), QStringLiteral("sdb"), sources));
+    QVERIFY(cache.find(QStringLiteral("id-a"), QStringLiteral("sdb"), sources));
+}
+
+void TestPolicyDecisionCache::clearDropsEverything()
+{
+    PolicyDecisionCache cache;
+    const PolicyDecisionCache::Sources sources{1, 1, 1};
+    QVERIFY(!cache.find(QStringLiteral("id-a"), QStringLiteral("sdb"), sources));
+    cache.insert(QStringLiteral("id-a"), decisionOn(QStringLiteral("sdb"), false));
+    cache.insert(QStringLiteral("id-b"), decisionOn(QStringLiteral("sdb"), false));
+    QCOMPARE(cache.size(), 2);
+    cache.clear();
+    QCOMPARE(cache.size(), 0);
+    QVERIFY(!cache.find(QStringLiteral("id-a"), QStringLiteral("sdb"), sources));
+}
+
+QTEST_MAIN(TestPolicyDecisionCache)
+#include "test_policy_decision_cache.moc"
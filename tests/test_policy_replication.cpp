@@ -0,0 +1,305 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QTimeZone>
+
+#include "WatchManifestFile.h"
+#include "policy/PolicyPaths.h"
+#include "policy/PolicyProtocol.h"
+#include "policy/PolicyReplication.h"
+#include "policy/PolicyStoreEngine.h"
+
+using namespace FlashSpartan;
+using namespace FlashSpartan::Policy;
+namespace Repl = FlashSpartan::Policy::PolicyReplication;
+
+namespace {
+
+DeviceRecord makeRecord(const QString& id)
+{
+    DeviceRecord rec;
+    rec.uniqueId = id;
+    rec.hash = "aaaa";
+    rec.firstSeen = QDateTime::fromMSecsSinceEpoch(1'000'000, QTimeZone::utc());
+    rec.lastSeen = rec.firstSeen;
+    rec.lastHashed = rec.firstSeen;
+    rec.policyChangedAt = rec.firstSeen;
+    return rec;
+}
+
+BlockedDriveEntry makeBlock(const QString& driveKey)
+{
+    BlockedDriveEntry e;
+    e.driveKey = driveKey;
+    e.uniqueId = driveKey + QStringLiteral("/sda1");
+    return e;
+}
+
+} // namespace
+
+class TestPolicyReplication : public QObject {
+    Q_OBJECT
+private slots:
+    void initTestCase();
+    void mergeConvergesInEitherOrder();
+    void policyTieGoesToStricter();
+    void hostTuningStaysLocal();
+    void sealedMessagesAuthenticated();
+    void blockDiff();
+    void storeStampsPolicyChanges();
+    void deltasReplicateWithoutEcho();
+    void baselineServerKeepsLocalPolicy();
+    void missingManifestsFetched();
+
+private:
+    QTemporaryDir m_config;
+};
+
+void TestPolicyReplication::initTestCase()
+{
+    QVERIFY(m_config.isValid());
+    qputenv("FLASHSPARTAN_POLICY_CONFIG", m_config.path().toUtf8());
+}
+
+void TestPolicyReplication::mergeConvergesInEitherOrder()
+{
+    DeviceRecord a = makeRecord("stick/sdb1");
+    DeviceRecord b = a;
+    // a changed the trust decision later; b has the newer baseline and sighting
+    a.trustLevel = 2;
+    a.policyChangedAt = a.policyChangedAt.addSecs(60);
+    b.hash = "bbbb";
+    b.lastHashed = b.lastHashed.addSecs(30);
+    b.lastSeen = b.lastSeen.addSecs(90);
+    b.lastKnownInfo.vendor = "Seen on b";
+
+    const DeviceRecord ab = Repl::mergeRecord(a, b);
+    const DeviceRecord ba = Repl::mergeRecord(b, a);
+    QCOMPARE(ab.toJson(), ba.toJson());
+    QCOMPARE(ab.trustLevel, 2);
+    QCOMPARE(ab.hash, QStringLiteral("bbbb"));
+    QCOMPARE(ab.lastSeen, b.lastSeen);
+    QCOMPARE(ab.lastKnownInfo.vendor, QStringLiteral("Seen on b"));
+    QCOMPARE(ab.firstSeen, a.firstSeen);
+}
+
+void TestPolicyReplication::policyTieGoesToStricter()
+{
+    DeviceRecord a = makeRecord("stick/sdb1");
+    DeviceRecord b = a;
+    a.trustLevel = 2;
+    a.autoMount = true;
+    b.trustLevel = 1;
+
+    QCOMPARE(Repl::mergeRecord(a, b).trustLevel, 1);
+    QCOMPARE(Repl::mergeRecord(b, a).trustLevel, 1);
+    QVERIFY(!Repl::mergeRecord(a, b).autoMount);
+}
+
+void TestPolicyReplication::hostTuningStaysLocal()
+{
+    DeviceRecord local = makeRecord("stick/sdb1");
+    DeviceRecord remote = local;
+    local.tunedBufferSizeKB = 1024;
+    remote.tunedBufferSizeKB = 4096;
+    remote.lastSeen = remote.lastSeen.addSecs(10);
+    QCOMPARE(Repl::mergeRecord(local, remote).tunedBufferSizeKB, 1024);
+
+    local.tunedBufferSizeKB = 0;
+    QCOMPARE(Repl::mergeRecord(local, remote).tunedBufferSizeKB, 4096);
+}
+
+void TestPolicyReplication::sealedMessagesAuthenticated()
+{
+    const QByteArray key(32, 'k');
+    const QByteArray nonce(Repl::kNonceBytes, 'n');
+    const QByteArray frame = PolicyProtocol::encodeFrame(PolicyProtocol::FrameType::Ping, "payload");
+    const QByteArray sealed = Repl::seal(key, nonce, 7, Repl::Direction::ToFollower, frame);
+
+    QByteArray buffer = sealed.left(sealed.size() - 1);
+    QByteArray out;
+    QString error;
+    QVERIFY(!Repl::unseal(buffer, key, nonce, 7, Repl::Direction::ToFollower, &out, &error));
+    QVERIFY(error.isEmpty());  // just incomplete
+
+    buffer = sealed + sealed;
+    QVERIFY(Repl::unseal(buffer, key, nonce, 7, Repl::Direction::ToFollower, &out, &error));
+    QCOMPARE(out, frame);
+    QCOMPARE(buffer, sealed);
+
+    buffer = sealed;
+    QVERIFY(!Repl::unseal(buffer, key, nonce, 8, Repl::Direction::ToFollower, &out, &error));
+    QVERIFY(!error.isEmpty());
+
+    error.clear();
+    buffer = sealed;
+    QVERIFY(!Repl::unseal(buffer, key, nonce, 7, Repl::Direction::ToLeader, &out, &error));
+    QVERIFY(!error.isEmpty());
+
+    error.clear();
+    buffer = sealed;
+    buffer[buffer.size() - 1] = static_cast<char>(buffer.at(buffer.size() - 1) ^ 1);
+    QVERIFY(!Repl::unseal(buffer, key, nonce, 7, Repl::Direction::ToFollower, &out, &error));
+    QVERIFY(!error.isEmpty());
+
+    error.clear();
+    buffer = sealed;
+    QVERIFY(!Repl::unseal(buffer, QByteArray(32, 'x'), nonce, 7, Repl::Direction::ToFollower, &out,
+                          &error));
+    QVERIFY(!error.isEmpty());
+}
+
+void TestPolicyReplication::blockDiff()
+{
+    const Repl::BlockChanges changes =
+        Repl::diffBlocks({makeBlock("a"), makeBlock("b")}, {makeBlock("b"), makeBlock("c")});
+    QCOMPARE(changes.blocked.size(), 1);
+    QCOMPARE(changes.blocked.first().driveKey, QStringLiteral("c"));
+    QCOMPARE(changes.unblocked.size(), 1);
+    QCOMPARE(changes.unblocked.first().driveKey, QStringLiteral("a"));
+}
+
+void TestPolicyReplication::storeStampsPolicyChanges()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    PolicyStoreEngine engine(dir.filePath("policy.store"));
+    QVERIFY(engine.load());
+
+    DeviceRecord rec = makeRecord("stick/sdb1");
+    rec.policyChangedAt = QDateTime();
+    QVERIFY(engine.upsertDevice(rec, "test", "add"));
+    const QDateTime added = engine.snapshot().devices.first().policyChangedAt;
+    QVERIFY(added.isValid());
+
+    rec.lastSeen = rec.lastSeen.addSecs(5);  // not a policy change
+    QVERIFY(engine.upsertDevice(rec, "test", "seen"));
+    QCOMPARE(engine.snapshot().devices.first().policyChangedAt, added);
+
+    QTest::qWait(5);
+    rec.trustLevel = 3;
+    QVERIFY(engine.upsertDevice(rec, "test", "trust"));
+    QVERIFY(engine.snapshot().devices.first().policyChangedAt > added);
+}
+
+void TestPolicyReplication::deltasReplicateWithoutEcho()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    PolicyStoreEngine a(dir.filePath("a.store"));
+    PolicyStoreEngine b(dir.filePath("b.store"));
+    QVERIFY(a.load());
+    QVERIFY(b.load());
+
+    QVERIFY(a.upsertDevice(makeRecord("stick/sdb1"), "test", "add"));
+    QVERIFY(a.upsertDevice(makeRecord("stick/sdc1"), "test", "add"));
+    QVERIFY(a.blockDrive("bad", "bad/sdd1", "Bad", "test"));
+    QVERIFY(b.blockDrive("local", "local/sde1", "Local", "test"));
+
+    // First contact: a full delta, merged into what b already has
+    Repl::PeerCursor fromA;
+    QVERIFY(Repl::applyDelta(b, a.changesSince(fromA.epoch, fromA.generation), fromA, "a") > 0);
+    QCOMPARE(b.snapshot().devices.size(), 2);
+    QCOMPARE(b.snapshot().blocks.size(), 2);
+
+    // b's copies carry nothing new back to a
+    Repl::PeerCursor fromB;
+    QCOMPARE(Repl::applyDelta(a, b.changesSince(fromB.epoch, fromB.generation), fromB, "b"), 1);
+    QCOMPARE(a.snapshot().blocks.size(), 2);  // b's own block
+    const quint64 generation = a.snapshot().generation;
+    QCOMPARE(Repl::applyDelta(a, b.changesSince(fromB.epoch, fromB.generation), fromB, "b"), 0);
+    QCOMPARE(a.snapshot().generation, generation);
+
+    // Incremental: a removal, an unblock and a trust change travel from a to b
+    QVERIFY(a.removeDevice("stick/sdc1", "test", "forget"));
+    QVERIFY(a.unblockDrive("bad", "bad/sdd1", "test"));
+    DeviceRecord trusted = a.snapshot().devices.first();
+    trusted.trustLevel = 2;
+    QVERIFY(a.upsertDevice(trusted, "test", "trust"));
+    const PolicyDelta delta = a.changesSince(fromA.epoch, fromA.generation);
+    QVERIFY(!delta.full);
+    QVERIFY(Repl::applyDelta(b, delta, fromA, "a") > 0);
+    QCOMPARE(b.snapshot().devices.size(), 1);
+    QCOMPARE(b.snapshot().devices.first().trustLevel, 2);
+    QCOMPARE(b.snapshot().blocks.size(), 1);
+    QCOMPARE(b.snapshot().blocks.first().driveKey, QStringLiteral("local"));
+}
+
+void TestPolicyReplication::baselineServerKeepsLocalPolicy()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    PolicyStoreEngine server(dir.filePath("server.store"));
+    PolicyStoreEngine station(dir.filePath("station.store"));
+    QVERIFY(server.load());
+    QVERIFY(station.load());
+
+    DeviceRecord issued = makeRecord("issued/sdb1");
+    issued.trustLevel = 2;
+    issued.hash = "cccc";
+    issued.lastHashed = issued.lastHashed.addSecs(60);
+    issued.blockHashes = {"b1", "b2"};
+    issued.policyChangedAt = issued.policyChangedAt.addSecs(600);
+    DeviceRecord local = makeRecord("issued/sdb1");
+    QVERIFY(server.upsertDevices({issued, makeRecord("first-visit/sdc1")}, "test", "add"));
+    QVERIFY(station.upsertDevice(local, "test", "add"));
+    QVERIFY(server.blockDrive("bad", "bad/sdd1", "Bad", "test"));
+
+    Repl::PeerCursor cursor;
+    QVERIFY(Repl::applyDelta(station, server.changesSince(0, 0), cursor, "central",
+                             Repl::PeerMode::Baselines) > 0);
+    const PolicySnapshot snap = station.snapshot();
+    QCOMPARE(snap.devices.size(), 2);  // a stick never seen here gets the fleet's baseline
+    QVERIFY(snap.blocks.isEmpty());
+    for (const DeviceRecord& rec : snap.devices) {
+        if (rec.uniqueId == QStringLiteral("issued/sdb1")) {
+            QCOMPARE(rec.hash, QStringLiteral("cccc"));
+            QCOMPARE(rec.blockHashes, QStringList({"b1", "b2"}));
+            QCOMPARE(rec.trustLevel, 0);  // the station keeps its own, older decision
+        }
+    }
+
+    // Removals on the server don't reach stations
+    QVERIFY(server.removeDevice("first-visit/sdc1", "test", "forget"));
+    QCOMPARE(Repl::applyDelta(station, server.changesSince(cursor.epoch, cursor.generation), cursor,
+                              "central", Repl::PeerMode::Baselines),
+             0);
+    QCOMPARE(station.snapshot().devices.size(), 2);
+}
+
+void TestPolicyReplication::missingManifestsFetched()
+{
+    WatchManifest manifest;
+    WatchGroup group;
+    group.watchPaths = {QStringLiteral("docs")};
+    group.merkleRoot = QString(64, QLatin1Char('1'));
+    WatchFileEntry entry;
+    entry.relativePath = QStringLiteral("docs/readme.txt");
+    entry.contentHash = QString(64, QLatin1Char('a'));
+    entry.sizeBytes = 12;
+    group.files.append(entry);
+    manifest.groups.append(group);
+    manifest.manifestRoot = QString(64, QLatin1Char('f'));
+    const QByteArray encoded = WatchManifestFile::encode(manifest);
+    QVERIFY(!encoded.isEmpty());
+    const QString digest =
+        QString::fromLatin1(QCryptographicHash::hash(encoded, QCryptographicHash::Sha256).toHex());
+
+    PolicyDelta delta;
+    DeviceRecord rec = makeRecord("stick/sdb1");
+    rec.watchManifest.filesSha256 = digest;
+    delta.devices = {rec, rec, makeRecord("plain/sdc1")};
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QCOMPARE(Repl::missingManifests(delta, dir.path()), QStringList({digest}));
+
+    QByteArray altered = encoded;
+    altered[altered.size() - 1] = static_cast<char>(altered.at(altered.size() - 1) ^ 1);
+    QVERIFY(!WatchManifestFile::saveEncoded(dir.path(), altered, digest));
+    QVERIFY(WatchManifestFile::saveEncoded(dir.path(), encoded, digest));
+    QVERIFY(Repl::missingManifests(delta, dir.path()).isEmpty());
+    QVERIFY(WatchManifestFile::open(dir.path(), digest) != nullptr);
+}
+
+QTEST_MAIN(TestPolicyReplication)
+#include "test_policy_replication.moc"
@@ -0,0 +1,134 @@
+#include <QtTest>
+
+#include "ProgressHub.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+ProgressSample hashSample(const QString& jobId, double fraction, const QString& detail = QString())
+{
+    ProgressSample sample;
+    sample.kind = ProgressSample::Kind::Hash;
+    sample.jobId = jobId;
+    sample.fraction = fraction;
+    sample.bytesTotal = 1000;
+    sample.bytesDone = quint64(fraction * 1000);
+    sample.detail = detail;
+    return sample;
+}
+
+} // namespace
+
+class TestProgressHub : public QObject {
+    Q_OBJECT
+
+private slots:
+    void publishesOnlyVisibleChanges();
+    void republishesOnRequest();
+    void stopsWhenIdle();
+    void followsFrameRateAndBackground();
+};
+
+void TestProgressHub::publishesOnlyVisibleChanges()
+{
+    ProgressHub hub;
+    QObject owner;
+    QList<ProgressSample> jobs{hashSample(QStringLiteral("a"), 0.10), hashSample(QStringLiteral("b"), 0.50)};
+    hub.addSource(&owner, [&jobs]() { return jobs; });
+    QSignalSpy published(&hub, &ProgressHub::published);
+
+    hub.tick();
+    QCOMPARE(published.count(), 1);
+    QCOMPARE(published.takeFirst().at(0).value<QList<ProgressSample>>().size(), 2);
+
+    // Below one bar step, same file: nothing to repaint.
+    jobs[0].fraction = 0.1004;
+    hub.tick();
+    QCOMPARE(published.count(), 0);
+
+    jobs[0].fraction = 0.2;
+    jobs[1].detail = QStringLiteral("next.iso");
+    hub.tick();
+    QCOMPARE(published.count(), 1);
+    QCOMPARE(published.takeFirst().at(0).value<QList<ProgressSample>>().size(), 2);
+
+    // Speed and ETA labels still refresh on a stalled job.
+    QTest::qWait(ProgressHub::kLabelRefreshMs + 50);
+    hub.tick();
+    QCOMPARE(published.count(), 1);
+}
+
+void TestProgressHub::republishesOnRequest()
+{
+    ProgressHub hub;
+    QObject owner;
+    const QList<ProgressSample> jobs{hashSample(QStringLiteral("a"), 0.3), hashSample(QStringLiteral("b"), 0.6)};
+    hub.addSource(&owner, [&jobs]() { return jobs; });
+    QSignalSpy published(&hub, &ProgressHub::published);
+    hub.tick();
+    QCOMPARE(published.count(), 1);
+
+    hub.republish(jobs.at(1));
+    published.clear();
+    hub.tick();
+    QCOMPARE(published.count(), 1);
+    const QList<ProgressSample> again = published.first().at(0).value<QList<ProgressSample>>();
+    QCOMPARE(again.size(), 1);
+    QCOMPARE(again.first().jobId, QStringLiteral("b"));
+
+    // The same job id under another kind is a different entry.
+    ProgressSample manifest = jobs.at(0);
+    manifest.kind = ProgressSample::Kind::Manifest;
+    hub.republish(manifest);
+    published.clear();
+    hub.tick();
+    QCOMPARE(published.count(), 0);
+}
+
+void TestProgressHub::stopsWhenIdle()
+{
+    ProgressHub hub;
+    QList<ProgressSample> jobs{hashSample(QStringLiteral("a"), 0.0)};
+    int polls = 0;
+    {
+        QObject owner;
+        hub.addSource(&owner, [&jobs, &polls]() {
+            ++polls;
+            return jobs;
+        });
+        QSignalSpy published(&hub, &ProgressHub::published);
+        hub.wake();
+        jobs[0].fraction = 0.5;
+        QTRY_VERIFY(published.count() >= 1);
+
+        jobs.clear();
+        const int before = polls;
+        QTRY_VERIFY(polls > before);
+        const int stopped = polls;
+        QTest::qWait(hub.interval() * 5);
+        QCOMPARE(polls, stopped);
+    }
+
+    // A destroyed owner's source is no longer polled.
+    const int afterOwner = polls;
+    hub.tick();
+    QCOMPARE(polls, afterOwner);
+}
+
+void TestProgressHub::followsFrameRateAndBackground()
+{
+    ProgressHub hub;
+    QCOMPARE(hub.interval(), qRound(1000.0 / ProgressHub::kDefaultFrameRate));
+    hub.setFrameRate(144.0);
+    QCOMPARE(hub.interval(), 7);
+    hub.setFrameRate(0.0);  // unknown refresh rate keeps the last one
+    QCOMPARE(hub.interval(), 7);
+    hub.setBackground(true);
+    QCOMPARE(hub.interval(), ProgressHub::kBackgroundIntervalMs);
+    hub.setBackground(false);
+    QCOMPARE(hub.interval(), 7);
+}
+
+QTEST_GUILESS_MAIN(TestProgressHub)
+#include "test_progress_hub.moc"
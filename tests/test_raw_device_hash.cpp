@@ -1,9 +1,22 @@
 #include <QtTest>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QTemporaryDir>
 #include <QTemporaryFile>
 
+#include "HashEngine.h"
+#include "HashPipeline.h"
 #include "RawDeviceHash.h"
+#include "RawDeviceHashAdvanced.h"
+#include "Xxh3Digest.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
+#include <cstring>
+#include <thread>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
 #include <unistd.h>
 
 using namespace FlashSpartan;
@@ -15,6 +28,23 @@ private slots:
     void normalizesBufferSizes();
     void rejectsNonDevPaths();
     void rejectsCharacterDevices();
+    void xxh3IsAvailableNonCryptographicAlgorithm();
+    void blake3NameRoundTrips();
+    void bufferTuneCandidatesIncludeQueueLimits();
+    void zeroRegionFastPathMatchesFullRead();
+    void changedBlockRangesMergeAdjacentBlocks();
+    void verifyStopsAtFirstChangedBlock();
+    void quickSampleDefaultLayoutIsUnchanged();
+    void quickSampleLabelRoundTrips();
+    void quickSampleMatchesSequentialReads();
+    void lengthLimitHashesOnlyThePrefix();
+    void regionsMatchSeparateReads();
+    void engineSourcesAndDigestsAgree();
+    void pipelinedReadLoopMatchesSequential();
+    void runPipelinedStopsOnReadErrorOrConsumer();
+    void ioUringMatchesReadLoop();
+    void helperRefusesFixedAndRootDisks();
+    void helperJudgesTheOpenedDeviceNotThePath();
 };
 
 void TestRawDeviceHash::normalizesBufferSizes()
@@ -52,5 +82,665 @@ void TestRawDeviceHash::rejectsCharacterDevices()
     QCOMPARE(errno, ENOTBLK);
 }
 
+void TestRawDeviceHash::xxh3IsAvailableNonCryptographicAlgorithm()
+{
+    using RawDeviceHash::Algorithm;
+    QCOMPARE(RawDeviceHash::algorithmFromName(RawDeviceHash::algorithmName(Algorithm::XXH3_128)),
+             Algorithm::XXH3_128);
+    QVERIFY(!RawDeviceHash::algorithmIsCryptographic(Algorithm::XXH3_128));
+    QVERIFY(RawDeviceHash::algorithmIsCryptographic(Algorithm::SHA256));
+    QVERIFY(RawDeviceHash::algorithmAvailable(Algorithm::SHA256));
+
+    if (!RawDeviceHash::algorithmAvailable(Algorithm::XXH3_128)) {
+        QSKIP("built without libxxhash");
+    }
+    // XXH3-128 of the empty input, seed 0, in canonical (big-endian) form.
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestLen = 0;
+    QVERIFY(EVP_Digest("", 0, digest, &digestLen, RawDeviceHash::xxh3_128Digest(), nullptr) == 1);
+    QCOMPARE(QByteArray(reinterpret_cast<const char*>(digest), static_cast<int>(digestLen)).toHex(),
+             QByteArray("99aa06d3014798d86001c324468d497f"));
+}
+
+void TestRawDeviceHash::blake3NameRoundTrips()
+{
+    using RawDeviceHash::Algorithm;
+    QCOMPARE(RawDeviceHash::algorithmName(Algorithm::BLAKE3), QStringLiteral("BLAKE3"));
+    QCOMPARE(RawDeviceHash::algorithmFromName(QStringLiteral("blake3")), Algorithm::BLAKE3);
+    QVERIFY(RawDeviceHash::algorithmIsCryptographic(Algorithm::BLAKE3));
+}
+
+void TestRawDeviceHash::bufferTuneCandidatesIncludeQueueLimits()
+{
+    RawDeviceHash::QueueLimits limits;
+    limits.maxSectorsKB = 240;
+    const std::vector<int> candidates = RawDeviceHash::bufferTuneCandidatesKB(limits);
+    QVERIFY(std::is_sorted(candidates.begin(), candidates.end()));
+    QVERIFY(std::find(candidates.begin(), candidates.end(), 240) != candidates.end());
+    QVERIFY(std::find(candidates.begin(), candidates.end(), 960) != candidates.end());
+    QVERIFY(candidates.back() <= RawDeviceHash::kMaxBufferSizeKB);
+    QVERIFY(candidates.front() >= RawDeviceHash::kMinBufferSizeKB);
+}
+
+void TestRawDeviceHash::zeroRegionFastPathMatchesFullRead()
+{
+    // Data in block 0, a hole for block 1, data mid-way through block 2, zero tail block.
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    const qint64 block = static_cast<qint64>(RawDeviceHash::kDefaultChunkBytes);
+    const qint64 size = 3 * block + 1024 * 1024;
+    QVERIFY(file.write(QByteArray(4096, 'a')) == 4096);
+    QVERIFY(file.seek(2 * block + block / 2));
+    QVERIFY(file.write(QByteArray(4096, 'b')) == 4096);
+    QVERIFY(file.resize(size));
+    QVERIFY(file.flush());
+
+    RawDeviceHash::Options options;
+    options.deviceNode = file.fileName();
+    const QString plain =
+        RawDeviceHash::hashAdvanced(file.handle(), options, static_cast<uint64_t>(size)).hash;
+    QVERIFY(!plain.isEmpty());
+
+    options.skipZeroRegions = true;
+    QCOMPARE(RawDeviceHash::hashAdvanced(file.handle(), options, static_cast<uint64_t>(size)).hash,
+             plain);
+    options.scanMode = RawDeviceHash::ScanMode::ParallelChunked;
+    QCOMPARE(RawDeviceHash::hashAdvanced(file.handle(), options, static_cast<uint64_t>(size)).hash,
+             plain);
+}
+
+void TestRawDeviceHash::changedBlockRangesMergeAdjacentBlocks()
+{
+    const uint64_t mib = 1024ULL * 1024;
+    const QStringList baseline{"a", "b", "c", "d", "e"};
+    const QStringList current{"a", "X", "Y", "d", "Z"};
+    const auto ranges = RawDeviceHash::changedBlockRanges(baseline, current, 64 * mib, 4 * 64 * mib + mib);
+    QCOMPARE(ranges.size(), size_t(2));
+    QCOMPARE(ranges[0].offset, 64 * mib);
+    QCOMPARE(ranges[0].length, 128 * mib);
+    QCOMPARE(ranges[1].offset, 256 * mib);
+    QCOMPARE(ranges[1].length, mib);
+    QCOMPARE(RawDeviceHash::describeByteRanges(ranges), QStringLiteral("64–192 MiB, 256–257 MiB"));
+}
+
+void TestRawDeviceHash::verifyStopsAtFirstChangedBlock()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    const qint64 block = static_cast<qint64>(RawDeviceHash::kDefaultChunkBytes);
+    const qint64 size = 3 * block;
+    QVERIFY(file.resize(size));
+    QVERIFY(file.flush());
+
+    RawDeviceHash::Options options;
+    options.deviceNode = file.fileName();
+    const HashResult baseline =
+        RawDeviceHash::hashAdvanced(file.handle(), options, static_cast<uint64_t>(size));
+    QVERIFY(baseline.success);
+    QCOMPARE(baseline.blockHashes.size(), 3);
+
+    QVERIFY(file.seek(block + 10));
+    QVERIFY(file.write("changed") == 7);
+    QVERIFY(file.flush());
+
+    options.expectedBlockHashes = &baseline.blockHashes;
+    options.stopAtFirstMismatch = true;
+    for (RawDeviceHash::ScanMode mode :
+         {RawDeviceHash::ScanMode::Full, RawDeviceHash::ScanMode::ParallelChunked}) {
+        options.scanMode = mode;
+        const HashResult r =
+            RawDeviceHash::hashAdvanced(file.handle(), options, static_cast<uint64_t>(size));
+        QVERIFY(r.success);
+        QVERIFY(r.hash.isEmpty());
+        QCOMPARE(r.stoppedAtBlock, qint64(1));
+        QCOMPARE(r.blockHashes.size(), 2);
+        QCOMPARE(r.blockHashes.first(), baseline.blockHashes.first());
+    }
+}
+
+void TestRawDeviceHash::quickSampleDefaultLayoutIsUnchanged()
+{
+    // The original fixed layout: head, tail, then 13 samples at i/14 of the device.
+    const uint64_t mib = 1024ULL * 1024;
+    const uint64_t size = 1000 * mib + 512;
+    const auto offsets = RawDeviceHash::quickSampleOffsets({}, size);
+    QCOMPARE(offsets.size(), size_t(15));
+    QCOMPARE(offsets[0], uint64_t(0));
+    QCOMPARE(offsets[1], size - mib);
+    for (uint64_t i = 1; i < 14; ++i) {
+        QCOMPARE(offsets[static_cast<size_t>(i + 1)], size * i / 14);
+    }
+
+    RawDeviceHash::QuickSampleLayout meta;
+    meta.metadataHotSpots = true;
+    const auto withMeta = RawDeviceHash::quickSampleOffsets(meta, size);
+    QVERIFY(withMeta.size() > offsets.size());
+    QVERIFY(std::equal(offsets.begin(), offsets.end(), withMeta.begin()));
+    QVERIFY(std::find(withMeta.begin(), withMeta.end(), 128 * mib) != withMeta.end());
+}
+
+void TestRawDeviceHash::quickSampleLabelRoundTrips()
+{
+    QVERIFY(RawDeviceHash::quickSampleLabelSuffix({}).isEmpty());
+    QVERIFY(RawDeviceHash::quickSampleLayoutFromLabel(QStringLiteral("SHA256-QUICK")).isDefault());
+
+    RawDeviceHash::QuickSampleLayout layout;
+    layout.samples = 32;
+    layout.sampleKB = 256;
+    layout.metadataHotSpots = true;
+    const QString label = QStringLiteral("BLAKE3-QUICK") + RawDeviceHash::quickSampleLabelSuffix(layout);
+    QCOMPARE(label, QStringLiteral("BLAKE3-QUICK-32x256K-META"));
+    const auto parsed = RawDeviceHash::quickSampleLayoutFromLabel(label);
+    QCOMPARE(parsed.samples, 32);
+    QCOMPARE(parsed.sampleKB, 256);
+    QVERIFY(parsed.metadataHotSpots);
+}
+
+void TestRawDeviceHash::quickSampleMatchesSequentialReads()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    const qint64 size = 40 * 1024 * 1024 + 1536;
+    QByteArray data(static_cast<int>(size), Qt::Uninitialized);
+    for (qint64 i = 0; i < size; ++i) {
+        data[static_cast<int>(i)] = static_cast<char>((i * 131) ^ (i >> 12));
+    }
+    QCOMPARE(file.write(data), size);
+    QVERIFY(file.flush());
+
+    RawDeviceHash::QuickSampleLayout custom;
+    custom.samples = 40;
+    custom.sampleKB = 12;
+    for (const RawDeviceHash::QuickSampleLayout& layout : {RawDeviceHash::QuickSampleLayout{}, custom}) {
+        QCryptographicHash expected(QCryptographicHash::Sha256);
+        const uint64_t sampleSize = static_cast<uint64_t>(layout.sampleKB) * 1024;
+        for (uint64_t off : RawDeviceHash::quickSampleOffsets(layout, static_cast<uint64_t>(size))) {
+            expected.addData(QByteArrayView(data).sliced(
+                static_cast<qsizetype>(off),
+                static_cast<qsizetype>(qMin(sampleSize, static_cast<uint64_t>(size) - off))));
+        }
+
+        RawDeviceHash::Options options;
+        options.deviceNode = file.fileName();
+        options.scanMode = RawDeviceHash::ScanMode::QuickSample;
+        options.quickSample = layout;
+        const HashResult r =
+            RawDeviceHash::hashAdvanced(file.handle(), options, static_cast<uint64_t>(size));
+        QVERIFY2(r.success, qPrintable(r.errorMessage));
+        QCOMPARE(r.hash, QString::fromLatin1(expected.result().toHex()));
+        QCOMPARE(r.algorithm, QStringLiteral("SHA256-QUICK") + RawDeviceHash::quickSampleLabelSuffix(layout));
+    }
+}
+
+void TestRawDeviceHash::lengthLimitHashesOnlyThePrefix()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    const qint64 size = 3 * 1024 * 1024 + 512;
+    QByteArray data(static_cast<int>(size), Qt::Uninitialized);
+    for (qint64 i = 0; i < size; ++i) {
+        data[static_cast<int>(i)] = static_cast<char>((i * 7) ^ (i >> 9));
+    }
+    QCOMPARE(file.write(data), size);
+    QVERIFY(file.flush());
+
+    const qint64 prefix = 2 * 1024 * 1024 + 4096 + 17;
+    const QString expected = QString::fromLatin1(
+        QCryptographicHash::hash(data.left(static_cast<int>(prefix)), QCryptographicHash::Sha256).toHex());
+
+    RawDeviceHash::Options options;
+    options.deviceNode = file.fileName();
+    options.lengthLimit = static_cast<uint64_t>(prefix);
+    options.bufferSizeKB = 64;
+    for (const bool mmap : {true, false}) {
+        for (const int depth : {0, RawDeviceHash::kDefaultPipelineDepth}) {
+            options.useMemoryMapping = mmap;
+            options.pipelineDepth = depth;
+            const HashResult r = RawDeviceHash::hashOpenFd(file.handle(), options);
+            QVERIFY2(r.success, qPrintable(r.errorMessage));
+            QCOMPARE(r.hash.toLower(), expected);
+            QCOMPARE(r.bytesProcessed, static_cast<uint64_t>(prefix));
+        }
+    }
+
+    options.lengthLimit = static_cast<uint64_t>(size) + 1;
+    const HashResult tooLong = RawDeviceHash::hashOpenFd(file.handle(), options);
+    QVERIFY(!tooLong.success);
+    QVERIFY(!tooLong.errorMessage.isEmpty());
+}
+
+void TestRawDeviceHash::regionsMatchSeparateReads()
+{
+    // A "disk" with a 1 MiB table area and two partitions, the first spanning a block edge.
+    QTemporaryFile disk;
+    QVERIFY(disk.open());
+    const qint64 mib = 1024 * 1024;
+    const qint64 block = static_cast<qint64>(RawDeviceHash::kDefaultChunkBytes);
+    const qint64 size = 2 * block + 3 * mib;
+    QVERIFY(disk.write(QByteArray(512, 't')) == 512);
+    QVERIFY(disk.seek(mib + block - 10));
+    QVERIFY(disk.write(QByteArray(64, 'p')) == 64);
+    QVERIFY(disk.seek(size - 4096));
+    QVERIFY(disk.write(QByteArray(4096, 'q')) == 4096);
+    QVERIFY(disk.resize(size));
+    QVERIFY(disk.flush());
+
+    const std::vector<RawDeviceHash::Region> regions = {
+        {QStringLiteral("table"), 0, static_cast<uint64_t>(mib)},
+        {QStringLiteral("/dev/sdz1"), static_cast<uint64_t>(mib), static_cast<uint64_t>(block + mib)},
+        {QStringLiteral("/dev/sdz2"), static_cast<uint64_t>(block + 2 * mib), static_cast<uint64_t>(block + mib)},
+    };
+
+    RawDeviceHash::Options options;
+    options.deviceNode = disk.fileName();
+    const HashResult whole = RawDeviceHash::hashAdvanced(disk.handle(), options, static_cast<uint64_t>(size));
+    QVERIFY(whole.success);
+    QVERIFY(whole.regionHashes.isEmpty());
+
+    // Each region on its own, the way a partition-scope hash reads it.
+    QStringList expected;
+    for (const RawDeviceHash::Region& region : regions) {
+        QVERIFY(disk.seek(static_cast<qint64>(region.offset)));
+        const QByteArray bytes = disk.read(static_cast<qint64>(region.length));
+        QTemporaryFile part;
+        QVERIFY(part.open());
+        QVERIFY(part.write(bytes) == bytes.size());
+        QVERIFY(part.flush());
+        const HashResult r = RawDeviceHash::hashAdvanced(part.handle(), options, region.length);
+        QVERIFY(r.success);
+        expected.append(r.hash);
+    }
+
+    options.regions = regions;
+    for (bool skipZeros : {false, true}) {
+        for (RawDeviceHash::ScanMode mode :
+             {RawDeviceHash::ScanMode::Full, RawDeviceHash::ScanMode::ParallelChunked}) {
+            options.skipZeroRegions = skipZeros;
+            options.scanMode = mode;
+            const HashResult r = RawDeviceHash::hashAdvanced(disk.handle(), options, static_cast<uint64_t>(size));
+            QVERIFY(r.success);
+            QCOMPARE(r.hash, whole.hash);
+            QCOMPARE(r.regionHashes.size(), qsizetype(regions.size()));
+            for (qsizetype i = 0; i < r.regionHashes.size(); ++i) {
+                QCOMPARE(r.regionHashes.at(i).name, regions.at(static_cast<size_t>(i)).name);
+                QCOMPARE(r.regionHashes.at(i).hash, expected.at(i));
+            }
+        }
+    }
+}
+
+void TestRawDeviceHash::engineSourcesAndDigestsAgree()
+{
+    QByteArray data(3 * 1024 * 1024 + 777, Qt::Uninitialized);
+    for (qsizetype i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>((i * 131) >> 3);
+    }
+    // Returns at most 100 KiB per call, so every loop has to cope with short reads.
+    const auto readAt = [&data](char* out, size_t length, uint64_t offset, RawDeviceHash::JobMeter&,
+                                QString*) -> int64_t {
+        const uint64_t n = std::min<uint64_t>({length, 100 * 1024, static_cast<uint64_t>(data.size()) - offset});
+        std::memcpy(out, data.constData() + offset, n);
+        return static_cast<int64_t>(n);
+    };
+    using ReadAt = decltype(readAt);
+    const uint64_t size = static_cast<uint64_t>(data.size());
+
+    for (RawDeviceHash::Algorithm algo :
+         {RawDeviceHash::Algorithm::SHA256, RawDeviceHash::Algorithm::BLAKE3, RawDeviceHash::Algorithm::XXH3_128}) {
+        if (!RawDeviceHash::algorithmAvailable(algo)) {
+            continue;
+        }
+        RawDeviceHash::Options options;
+        options.algorithm = algo;
+        RawDeviceHash::Engine::ReadSource<ReadAt> evpSource(readAt, 256 * 1024);
+        const HashResult viaEvp =
+            RawDeviceHash::Engine::hashSequential<RawDeviceHash::Engine::EvpDigest>(evpSource, options, size);
+        QVERIFY2(viaEvp.success, qPrintable(viaEvp.errorMessage));
+        if (algo == RawDeviceHash::Algorithm::SHA256) {
+            QCOMPARE(viaEvp.hash,
+                     QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex()));
+        }
+
+        RawDeviceHash::Engine::ReadSource<ReadAt> plain(readAt, 256 * 1024);
+        const HashResult read = RawDeviceHash::Engine::hash(plain, options, size);
+        QVERIFY2(read.success, qPrintable(read.errorMessage));
+        QCOMPARE(read.hash, viaEvp.hash);
+        QCOMPARE(read.bytesProcessed, size);
+
+        RawDeviceHash::Engine::PipelinedSource<ReadAt> pipelined(readAt, 256 * 1024, 3);
+        const HashResult overlapped = RawDeviceHash::Engine::hash(pipelined, options, size);
+        QVERIFY2(overlapped.success, qPrintable(overlapped.errorMessage));
+        QCOMPARE(overlapped.hash, viaEvp.hash);
+    }
+
+    // A source that ends early is an error, not a hash of the shorter data.
+    RawDeviceHash::Options options;
+    RawDeviceHash::Engine::ReadSource<ReadAt> shortSource(readAt, 256 * 1024);
+    const HashResult truncated = RawDeviceHash::Engine::hash(shortSource, options, size + 4096);
+    QVERIFY(!truncated.success);
+    QVERIFY(truncated.errorMessage.startsWith(QStringLiteral("Unexpected EOF")));
+}
+
+void TestRawDeviceHash::pipelinedReadLoopMatchesSequential()
+{
+    // Not a multiple of the buffer, so the last buffer in the ring is a short one.
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QByteArray data(5 * 1024 * 1024 + 4097, Qt::Uninitialized);
+    for (qsizetype i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>((i * 29) ^ (i >> 11));
+    }
+    QCOMPARE(file.write(data), data.size());
+    QVERIFY(file.flush());
+    const QString expected =
+        QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+
+    // Plain read loop: no mmap, no checkpoint, so hashOpenFd() takes hashReadLoop().
+    RawDeviceHash::Options options;
+    options.deviceNode = file.fileName();
+    options.useMemoryMapping = false;
+    options.bufferSizeKB = 256;
+    options.pipelineDepth = 0;
+    const HashResult sequential = RawDeviceHash::hashOpenFd(file.handle(), options);
+    QVERIFY2(sequential.success, qPrintable(sequential.errorMessage));
+    QCOMPARE(sequential.hash.toLower(), expected);
+
+    for (const int depth : {2, RawDeviceHash::kDefaultPipelineDepth, RawDeviceHash::kMaxPipelineDepth + 4}) {
+        options.pipelineDepth = depth;
+        const HashResult pipelined = RawDeviceHash::hashOpenFd(file.handle(), options);
+        QVERIFY2(pipelined.success, qPrintable(pipelined.errorMessage));
+        QCOMPARE(pipelined.hash, sequential.hash);
+        QCOMPARE(pipelined.bytesProcessed, static_cast<uint64_t>(data.size()));
+        QCOMPARE(pipelined.performance.engine, QStringLiteral("pipelined"));
+    }
+}
+
+void TestRawDeviceHash::runPipelinedStopsOnReadErrorOrConsumer()
+{
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QByteArray data(1024 * 1024 + 300, Qt::Uninitialized);
+    for (qsizetype i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<char>(i * 13);
+    }
+    QCOMPARE(file.write(data), data.size());
+    QVERIFY(file.flush());
+    const int fd = file.handle();
+
+    uint64_t offset = 0;
+    const auto readFile = [&](char* buffer, size_t capacity, QString*) -> int64_t {
+        const ssize_t n = pread(fd, buffer, capacity, static_cast<off_t>(offset));
+        offset += n > 0 ? static_cast<uint64_t>(n) : 0;
+        return n;
+    };
+
+    // Buffers reach the consumer in read order.
+    QByteArray seen;
+    RawDeviceHash::PipelineStats stats;
+    QString error;
+    QVERIFY(RawDeviceHash::runPipelined(
+        4, 64 * 1024, readFile,
+        [&](const char* chunk, size_t length) {
+            seen.append(chunk, static_cast<qsizetype>(length));
+            return true;
+        },
+        &stats, &error));
+    QVERIFY(error.isEmpty());
+    QCOMPARE(seen, data);
+
+    // A consumer that stops ends the run without an error of its own.
+    offset = 0;
+    int consumed = 0;
+    QVERIFY(!RawDeviceHash::runPipelined(
+        4, 64 * 1024, readFile, [&](const char*, size_t) { return ++consumed < 3; }, nullptr, &error));
+    QCOMPARE(consumed, 3);
+
+    // A failed read is reported after the buffers read before it.
+    offset = 0;
+    seen.clear();
+    error.clear();
+    const auto failingRead = [&](char* buffer, size_t capacity, QString* readError) -> int64_t {
+        if (offset >= 256 * 1024) {
+            *readError = QStringLiteral("Read error: Input/output error");
+            return -1;
+        }
+        return readFile(buffer, capacity, readError);
+    };
+    QVERIFY(!RawDeviceHash::runPipelined(
+        3, 64 * 1024, failingRead,
+        [&](const char* chunk, size_t length) {
+            seen.append(chunk, static_cast<qsizetype>(length));
+            return true;
+        },
+        nullptr, &error));
+    QCOMPARE(error, QStringLiteral("Read error: Input/output error"));
+    QCOMPARE(seen, data.left(256 * 1024));
+}
+
+void TestRawDeviceHash::ioUringMatchesReadLoop()
+{
+    if (!RawDeviceHash::ioUringAvailable()) {
+        QSKIP("io_uring not compiled in or refused by this kernel");
+    }
+    // Several queue depths' worth of buffers plus a tail that is not page-aligned.
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    const qint64 size = 9 * 1024 * 1024 + 333;
+    QByteArray data(static_cast<int>(size), Qt::Uninitialized);
+    for (qint64 i = 0; i < size; ++i) {
+        data[static_cast<int>(i)] = static_cast<char>((i * 61) ^ (i >> 10));
+    }
+    QCOMPARE(file.write(data), size);
+    QVERIFY(file.flush());
+
+    RawDeviceHash::Options options;
+    options.deviceNode = file.fileName();
+    options.useMemoryMapping = false;
+    options.bufferSizeKB = 128;
+    const HashResult plain = RawDeviceHash::hashOpenFd(file.handle(), options);
+    QVERIFY2(plain.success, qPrintable(plain.errorMessage));
+    QCOMPARE(plain.hash, QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex()));
+
+    options.ioEngine = RawDeviceHash::IoEngine::IoUring;
+    for (const int depth : {RawDeviceHash::kMinIoQueueDepth, RawDeviceHash::kMaxIoQueueDepth}) {
+        options.ioQueueDepth = depth;
+        const HashResult uring = RawDeviceHash::hashOpenFd(file.handle(), options);
+        QVERIFY2(uring.success, qPrintable(uring.errorMessage));
+        QCOMPARE(uring.performance.engine, QStringLiteral("io_uring"));
+        QCOMPARE(uring.hash, plain.hash);
+        QCOMPARE(uring.bytesProcessed, static_cast<uint64_t>(size));
+    }
+
+    // Quick samples fetched through the ring read the same bytes as the threaded preads.
+    options.scanMode = RawDeviceHash::ScanMode::QuickSample;
+    const HashResult uringSample = RawDeviceHash::hashAdvanced(file.handle(), options, static_cast<uint64_t>(size));
+    options.ioEngine = RawDeviceHash::IoEngine::Default;
+    const HashResult preadSample = RawDeviceHash::hashAdvanced(file.handle(), options, static_cast<uint64_t>(size));
+    QVERIFY2(uringSample.success, qPrintable(uringSample.errorMessage));
+    QVERIFY2(preadSample.success, qPrintable(preadSample.errorMessage));
+    QCOMPARE(uringSample.hash, preadSample.hash);
+}
+
+void TestRawDeviceHash::helperRefusesFixedAndRootDisks()
+{
+    // A stand-in for /sys: class/block links into devices/, as the kernel lays it out.
+    QTemporaryDir sys;
+    QVERIFY(sys.isValid());
+    const QString root = sys.path();
+    auto addDisk = [&](const QString& parent, const QString& disk, const QByteArray& removable,
+                       const QStringList& partitions) {
+        const QString diskDir = root + QStringLiteral("/devices/") + parent + QStringLiteral("/block/") + disk;
+        QVERIFY(QDir().mkpath(diskDir));
+        QFile attr(diskDir + QStringLiteral("/removable"));
+        QVERIFY(attr.open(QIODevice::WriteOnly));
+        attr.write(removable + '\n');
+        attr.close();
+        QVERIFY(QDir().mkpath(root + QStringLiteral("/class/block")));
+        QVERIFY(QFile::link(diskDir, root + QStringLiteral("/class/block/") + disk));
+        for (const QString& part : partitions) {
+            QVERIFY(QDir().mkpath(diskDir + QLatin1Char('/') + part));
+            QFile number(diskDir + QLatin1Char('/') + part + QStringLiteral("/partition"));
+            QVERIFY(number.open(QIODevice::WriteOnly));
+            number.write("1\n");
+            number.close();
+            QVERIFY(QFile::link(diskDir + QLatin1Char('/') + part, root + QStringLiteral("/class/block/") + part));
+        }
+    };
+    addDisk(QStringLiteral("pci0000:00/0000:00:17.0/ata1/host0/target0:0:0/0:0:0:0"), QStringLiteral("sda"), "0",
+            {QStringLiteral("sda1"), QStringLiteral("sda2")});
+    addDisk(QStringLiteral("pci0000:00/0000:00:14.0/usb2/2-1/2-1:1.0/host6/target6:0:0/6:0:0:0"),
+            QStringLiteral("sdb"), "0", {QStringLiteral("sdb1")});
+    addDisk(QStringLiteral("pci0000:00/0000:00:1c.0/mmc_host/mmc0/mmc0:0001"), QStringLiteral("mmcblk0"), "1", {});
+    const QString block = root + QStringLiteral("/class/block/");
+    const QStringList rootOnSda{QStringLiteral("sda")};
+
+    const RawDeviceHash::DeviceAttachment fixed = RawDeviceHash::deviceAttachmentAt(block + "sda", {});
+    QVERIFY(fixed.known);
+    QVERIFY(!fixed.usb && !fixed.removable);
+    QVERIFY(!RawDeviceHash::externalDiskRefusal(fixed).isEmpty());
+    QVERIFY(RawDeviceHash::externalDiskRefusal(fixed, true).isEmpty());
+
+    // The system disk is refused whole or by partition, whatever the override says.
+    const RawDeviceHash::DeviceAttachment system = RawDeviceHash::deviceAttachmentAt(block + "sda2", rootOnSda);
+    QVERIFY(system.isPartition);
+    QCOMPARE(system.disk, QStringLiteral("sda"));
+    QVERIFY(system.backsRoot);
+    QVERIFY(RawDeviceHash::externalDiskRefusal(system, true).contains(QStringLiteral("root filesystem")));
+
+    const RawDeviceHash::DeviceAttachment stick = RawDeviceHash::deviceAttachmentAt(block + "sdb1", rootOnSda);
+    QVERIFY(stick.usb);
+    QVERIFY(stick.isPartition);
+    QVERIFY(RawDeviceHash::externalDiskRefusal(stick).isEmpty());
+    QVERIFY(RawDeviceHash::externalDiskRefusal(RawDeviceHash::deviceAttachmentAt(block + "sdb", rootOnSda)).isEmpty());
+    // A live system booted from the stick: now the stick is the system disk.
+    QVERIFY(!RawDeviceHash::externalDiskRefusal(
+                 RawDeviceHash::deviceAttachmentAt(block + "sdb", {QStringLiteral("sdb")}))
+                 .isEmpty());
+
+    const RawDeviceHash::DeviceAttachment card = RawDeviceHash::deviceAttachmentAt(block + "mmcblk0", rootOnSda);
+    QVERIFY(card.removable && !card.usb);
+    QVERIFY(RawDeviceHash::externalDiskRefusal(card).isEmpty());
+
+    QVERIFY(!RawDeviceHash::deviceAttachmentAt(block + "sdz", rootOnSda).known);
+    QVERIFY(!RawDeviceHash::externalDiskRefusal(RawDeviceHash::DeviceAttachment{}).isEmpty());
+
+    // The helper's gate itself: nothing outside /dev, nothing that is not a block device.
+    QTemporaryFile file;
+    QVERIFY(file.open());
+    QString refusal;
+    QCOMPARE(RawDeviceHash::openHelperDevice(file.fileName(), &refusal), -1);
+    QCOMPARE(refusal, QStringLiteral("Not a device node under /dev"));
+    QCOMPARE(RawDeviceHash::openHelperDevice(QStringLiteral("/dev/null"), &refusal), -1);
+    QCOMPARE(refusal, QStringLiteral("Not a block device"));
+    QCOMPARE(RawDeviceHash::openHelperDevice(QStringLiteral("/dev/../etc/shadow"), &refusal), -1);
+    QVERIFY(!refusal.isEmpty());
+    QCOMPARE(RawDeviceHash::openHelperDevice(QStringLiteral("/dev/flashspartan-no-such-disk"), &refusal), -1);
+    QCOMPARE(refusal, QStringLiteral("No such device"));
+}
+
+void TestRawDeviceHash::helperJudgesTheOpenedDeviceNotThePath()
+{
+    // Two block devices to point a link at; unattached loop devices open fine as root.
+    QStringList nodes;
+    QList<dev_t> rdevs;
+    for (const QString& name : QDir(QStringLiteral("/sys/class/block"))
+                                   .entryList({QStringLiteral("loop*")}, QDir::Dirs | QDir::System)) {
+        const QString node = QStringLiteral("/dev/") + name;
+        const int fd = RawDeviceHash::openDevice(node);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0) {
+            nodes.append(node);
+            rdevs.append(st.st_rdev);
+        }
+        RawDeviceHash::closeDevice(fd);
+        if (nodes.size() == 2) {
+            break;
+        }
+    }
+    if (nodes.size() < 2) {
+        QSKIP("needs two openable loop devices (run as root)");
+    }
+    // A user-writable directory that still passes the /dev check.
+    QTemporaryDir shm(QStringLiteral("/dev/shm/flashspartan-test-XXXXXX"));
+    if (!shm.isValid()) {
+        QSKIP("/dev/shm is not writable");
+    }
+
+    // Stand-in /sys/dev/block: the first device is a USB stick, the second the system disk.
+    QTemporaryDir sys;
+    QVERIFY(sys.isValid());
+    auto addDisk = [&](dev_t rdev, const QString& diskDir) {
+        QVERIFY(QDir().mkpath(diskDir));
+        QFile attr(diskDir + QStringLiteral("/removable"));
+        QVERIFY(attr.open(QIODevice::WriteOnly));
+        attr.write("0\n");
+        attr.close();
+        QVERIFY(QDir().mkpath(sys.filePath(QStringLiteral("dev/block"))));
+        QVERIFY(QFile::link(diskDir, sys.filePath(QStringLiteral("dev/block/%1:%2").arg(major(rdev)).arg(minor(rdev)))));
+    };
+    addDisk(rdevs.at(0), sys.filePath(QStringLiteral("devices/pci0000:00/0000:00:14.0/usb2/2-1/2-1:1.0/host6/"
+                                                     "target6:0:0/6:0:0:0/block/sdb")));
+    addDisk(rdevs.at(1), sys.filePath(QStringLiteral("devices/pci0000:00/0000:00:17.0/ata1/host0/"
+                                                     "target0:0:0/0:0:0:0/block/sda")));
+    const QString sysDevBlock = sys.filePath(QStringLiteral("dev/block"));
+    const QStringList rootOnSda{QStringLiteral("sda")};
+
+    const QString link = shm.filePath(QStringLiteral("stick"));
+    auto pointAt = [&](const QString& node) {
+        // Replaced in one rename(), as an attacker would, so the link always resolves.
+        const QByteArray next = QFile::encodeName(link + QStringLiteral(".next"));
+        ::unlink(next.constData());
+        return ::symlink(QFile::encodeName(node).constData(), next.constData()) == 0
+               && ::rename(next.constData(), QFile::encodeName(link).constData()) == 0;
+    };
+
+    QVERIFY(pointAt(nodes.at(0)));
+    QString refusal;
+    int fd = RawDeviceHash::openHelperDeviceAt(link, sysDevBlock, rootOnSda, &refusal);
+    QVERIFY2(fd >= 0, qPrintable(refusal));
+    RawDeviceHash::closeDevice(fd);
+
+    QVERIFY(pointAt(nodes.at(1)));
+    fd = RawDeviceHash::openHelperDeviceAt(link, sysDevBlock, rootOnSda, &refusal);
+    QCOMPARE(fd, -1);
+    QVERIFY2(refusal.contains(QStringLiteral("root filesystem")), qPrintable(refusal));
+
+    // Swap the link back and forth while the helper keeps opening it: whatever the path
+    // resolved to when it was validated, no descriptor for the system disk may come back.
+    std::atomic<bool> stop{false};
+    std::atomic<bool> swapFailed{false};
+    std::thread swapper([&]() {
+        for (int i = 0; !stop.load(); ++i) {
+            if (!pointAt(nodes.at(i % 2))) {
+                swapFailed.store(true);
+                return;
+            }
+        }
+    });
+    int opened = 0;
+    int refused = 0;
+    for (int i = 0; i < 2000; ++i) {
+        fd = RawDeviceHash::openHelperDeviceAt(link, sysDevBlock, rootOnSda, &refusal);
+        if (fd < 0) {
+            ++refused;
+            continue;
+        }
+        struct stat st;
+        const bool statted = fstat(fd, &st) == 0;
+        RawDeviceHash::closeDevice(fd);
+        QVERIFY(statted);
+        if (st.st_rdev != rdevs.at(0)) {
+            stop.store(true);
+            swapper.join();
+            QFAIL("the helper opened the system disk through a swapped link");
+        }
+        ++opened;
+    }
+    stop.store(true);
+    swapper.join();
+    QVERIFY(!swapFailed.load());
+    QCOMPARE(opened + refused, 2000);
+}
+
 QTEST_MAIN(TestRawDeviceHash)
 #include "test_raw_device_hash.moc"
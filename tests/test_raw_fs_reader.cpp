@@ -0,0 +1,501 @@
+#include <QtTest>
+#include <QFile>
+
+#include "RawFsReader.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace FlashSpartan;
+
+namespace {
+
+// ---- image builders (FAT12 and exFAT have no mkfs in CI, so the images are laid out here) ----
+
+void put16(QByteArray& image, qsizetype pos, uint16_t v)
+{
+    image[pos] = static_cast<char>(v & 0xFF);
+    image[pos + 1] = static_cast<char>(v >> 8);
+}
+
+void put32(QByteArray& image, qsizetype pos, uint32_t v)
+{
+    put16(image, pos, static_cast<uint16_t>(v & 0xFFFF));
+    put16(image, pos + 2, static_cast<uint16_t>(v >> 16));
+}
+
+void put64(QByteArray& image, qsizetype pos, uint64_t v)
+{
+    put32(image, pos, static_cast<uint32_t>(v & 0xFFFFFFFFu));
+    put32(image, pos + 4, static_cast<uint32_t>(v >> 32));
+}
+
+void putBytes(QByteArray& image, qsizetype pos, const QByteArray& bytes)
+{
+    std::memcpy(image.data() + pos, bytes.constData(), static_cast<size_t>(bytes.size()));
+}
+
+QByteArray pattern(qsizetype size, char seed)
+{
+    QByteArray data(size, '\0');
+    for (qsizetype i = 0; i < size; ++i) {
+        data[i] = static_cast<char>(seed + (i * 7) % 251);
+    }
+    return data;
+}
+
+// FAT12: 512-byte sectors, 4 per cluster, 1 reserved sector, two 2-sector FATs, 512 root entries.
+constexpr qsizetype kFatSector = 512;
+constexpr qsizetype kFatCluster = 4 * kFatSector;
+constexpr qsizetype kFatDataStart = (1 + 2 * 2 + 32) * kFatSector;
+
+void setFat12(QByteArray& image, uint32_t cluster, uint16_t value)
+{
+    for (int copy = 0; copy < 2; ++copy) {
+        const qsizetype pos = kFatSector * (1 + copy * 2) + cluster + cluster / 2;
+        auto* b = reinterpret_cast<unsigned char*>(image.data() + pos);
+        if (cluster & 1) {
+            b[0] = static_cast<unsigned char>((b[0] & 0x0F) | ((value & 0x0F) << 4));
+            b[1] = static_cast<unsigned char>(value >> 4);
+        } else {
+            b[0] = static_cast<unsigned char>(value & 0xFF);
+            b[1] = static_cast<unsigned char>((b[1] & 0xF0) | ((value >> 8) & 0x0F));
+        }
+    }
+}
+
+qsizetype fatClusterPos(uint32_t cluster)
+{
+    return kFatDataStart + (cluster - 2) * kFatCluster;
+}
+
+void fatShortEntry(QByteArray& image, qsizetype pos, const char* name11, uint8_t attributes, uint8_t caseFlags,
+                   uint32_t cluster, uint32_t size)
+{
+    putBytes(image, pos, QByteArray(name11, 11));
+    image[pos + 11] = static_cast<char>(attributes);
+    image[pos + 12] = static_cast<char>(caseFlags);
+    put16(image, pos + 22, (13 << 11) | (30 << 5) | (10 / 2));  // 13:30:10
+    put16(image, pos + 24, ((2024 - 1980) << 9) | (5 << 5) | 17);  // 2024-05-17
+    put16(image, pos + 26, static_cast<uint16_t>(cluster));
+    put32(image, pos + 28, size);
+}
+
+/** One long-name slot per 13 characters, last slot first, as Windows writes them. */
+qsizetype fatLongName(QByteArray& image, qsizetype pos, const QString& name, const char* shortName11)
+{
+    uint8_t sum = 0;
+    for (int i = 0; i < 11; ++i) {
+        sum = static_cast<uint8_t>(((sum & 1) << 7) + (sum >> 1) + static_cast<uint8_t>(shortName11[i]));
+    }
+    const int slots = static_cast<int>((name.size() + 12) / 13);
+    static constexpr int kOffsets[13] = {1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30};
+    for (int order = slots; order >= 1; --order) {
+        image[pos] = static_cast<char>(order | (order == slots ? 0x40 : 0));
+        image[pos + 11] = 0x0F;
+        image[pos + 13] = static_cast<char>(sum);
+        for (int k = 0; k < 13; ++k) {
+            const qsizetype at = (order - 1) * 13 + k;
+            const uint16_t c = at < name.size() ? name.at(at).unicode() : at == name.size() ? 0x0000 : 0xFFFF;
+            put16(image, pos + kOffsets[k], c);
+        }
+        pos += 32;
+    }
+    return pos;
+}
+
+QByteArray fatFileA()
+{
+    return pattern(5000, 'a');
+}
+
+QByteArray fat12Image()
+{
+    QByteArray image(2048 * kFatSector, '\0');
+    image[0] = static_cast<char>(0xEB);
+    image[1] = 0x3C;
+    image[2] = static_cast<char>(0x90);
+    putBytes(image, 3, "MSWIN4.1");
+    put16(image, 11, kFatSector);
+    image[13] = 4;                 // sectors per cluster
+    put16(image, 14, 1);           // reserved
+    image[16] = 2;                 // FATs
+    put16(image, 17, 512);         // root entries
+    put16(image, 19, 2048);        // total sectors
+    image[21] = static_cast<char>(0xF8);
+    put16(image, 22, 2);           // sectors per FAT
+    image[510] = 0x55;
+    image[511] = static_cast<char>(0xAA);
+
+    setFat12(image, 0, 0xFF8);
+    setFat12(image, 1, 0xFFF);
+    // "Long File Name.txt": 5000 bytes in clusters 2, 3 and 5 (4 is someone else's).
+    setFat12(image, 2, 3);
+    setFat12(image, 3, 5);
+    setFat12(image, 5, 0xFFF);
+    setFat12(image, 4, 0xFFF);
+    setFat12(image, 6, 0xFFF);  // readme.txt
+    setFat12(image, 7, 0xFFF);  // DCIM
+    setFat12(image, 8, 0xFFF);  // IMG_0001.JPG
+
+    const QByteArray a = fatFileA();
+    putBytes(image, fatClusterPos(2), a.left(kFatCluster));
+    putBytes(image, fatClusterPos(3), a.mid(kFatCluster, kFatCluster));
+    putBytes(image, fatClusterPos(5), a.mid(2 * kFatCluster));
+    putBytes(image, fatClusterPos(4), QByteArray(kFatCluster, 'X'));
+    putBytes(image, fatClusterPos(6), QByteArray("read me!\r\n"));
+    putBytes(image, fatClusterPos(8), pattern(100, 'j'));
+
+    qsizetype root = (1 + 2 * 2) * kFatSector;
+    fatShortEntry(image, root, "STICK      ", 0x08, 0, 0, 0);  // volume label
+    root += 32;
+    root = fatLongName(image, root, QStringLiteral("Long File Name.txt"), "LONGFI~1TXT");
+    fatShortEntry(image, root, "LONGFI~1TXT", 0x20, 0, 2, 5000);
+    root += 32;
+    fatShortEntry(image, root, "GONE    TXT", 0x20, 0, 9, 10);
+    image[root] = static_cast<char>(0xE5);  // deleted
+    root += 32;
+    fatShortEntry(image, root, "README  TXT", 0x20, 0x18, 6, 10);  // lowercase base and extension
+    root += 32;
+    // A stray long name whose checksum does not match: the short name stands.
+    root = fatLongName(image, root, QStringLiteral("Stray"), "OTHER   TXT");
+    fatShortEntry(image, root, "DCIM       ", 0x10, 0, 7, 0);
+
+    qsizetype dcim = fatClusterPos(7);
+    fatShortEntry(image, dcim, ".          ", 0x10, 0, 7, 0);
+    fatShortEntry(image, dcim + 32, "..         ", 0x10, 0, 0, 0);
+    fatShortEntry(image, dcim + 64, "IMG_0001JPG", 0x20, 0, 8, 100);
+    return image;
+}
+
+// exFAT: 512-byte sectors, 4 KiB clusters, FAT at sector 24, heap at sector 32, 256 clusters.
+constexpr qsizetype kExCluster = 4096;
+
+qsizetype exClusterPos(uint32_t cluster)
+{
+    return 32 * 512 + (cluster - 2) * kExCluster;
+}
+
+void setExFat(QByteArray& image, uint32_t cluster, uint32_t value)
+{
+    put32(image, 24 * 512 + cluster * 4, value);
+}
+
+/** File, Stream Extension and File Name entries; returns the position after the set. */
+qsizetype exFileSet(QByteArray& image, qsizetype pos, const QString& name, bool directory, uint32_t cluster,
+                    uint64_t size, uint64_t validLength, bool contiguous, uint8_t utcOffset)
+{
+    const int nameEntries = static_cast<int>((name.size() + 14) / 15);
+    image[pos] = static_cast<char>(0x85);
+    image[pos + 1] = static_cast<char>(1 + nameEntries);
+    put16(image, pos + 4, directory ? 0x10 : 0x20);
+    // 2024-05-17 13:30:10.250
+    put32(image, pos + 12, (static_cast<uint32_t>((2024 - 1980) << 9 | 5 << 5 | 17) << 16)
+                               | static_cast<uint32_t>(13 << 11 | 30 << 5 | 10 / 2));
+    image[pos + 21] = 25;  // 10 ms units
+    image[pos + 23] = static_cast<char>(utcOffset);
+
+    const qsizetype stream = pos + 32;
+    image[stream] = static_cast<char>(0xC0);
+    image[stream + 1] = static_cast<char>(0x01 | (contiguous ? 0x02 : 0));
+    image[stream + 3] = static_cast<char>(name.size());
+    put64(image, stream + 8, validLength);
+    put32(image, stream + 20, cluster);
+    put64(image, stream + 24, size);
+
+    for (int n = 0; n < nameEntries; ++n) {
+        const qsizetype e = stream + 32 + n * 32;
+        image[e] = static_cast<char>(0xC1);
+        for (int c = 0; c < 15 && n * 15 + c < name.size(); ++c) {
+            put16(image, e + 2 + c * 2, name.at(n * 15 + c).unicode());
+        }
+    }
+    return stream + 32 + nameEntries * 32;
+}
+
+QByteArray exFatImage()
+{
+    QByteArray image(32 * 512 + 256 * kExCluster, '\0');
+    image[0] = static_cast<char>(0xEB);
+    image[1] = 0x76;
+    image[2] = static_cast<char>(0x90);
+    putBytes(image, 3, "EXFAT   ");
+    put64(image, 72, static_cast<uint64_t>(image.size() / 512));
+    put32(image, 80, 24);    // FAT offset
+    put32(image, 84, 8);     // FAT length
+    put32(image, 88, 32);    // cluster heap offset
+    put32(image, 92, 256);   // cluster count
+    put32(image, 96, 2);     // root directory cluster
+    image[108] = 9;          // 512-byte sectors
+    image[109] = 3;          // 8 sectors per cluster
+    image[110] = 1;          // one FAT
+    image[510] = 0x55;
+    image[511] = static_cast<char>(0xAA);
+
+    setExFat(image, 0, 0xFFFFFFF8);
+    setExFat(image, 1, 0xFFFFFFFF);
+    setExFat(image, 2, 0xFFFFFFFF);  // root
+    // Video.bin through the FAT, out of order: 5 -> 7 -> 6.
+    setExFat(image, 5, 7);
+    setExFat(image, 7, 6);
+    setExFat(image, 6, 0xFFFFFFFF);
+
+    const QByteArray notes = pattern(6000, 'n');
+    putBytes(image, exClusterPos(3), notes);  // clusters 3 and 4, no FAT chain
+    const QByteArray video = pattern(3 * kExCluster, 'v');
+    putBytes(image, exClusterPos(5), video.left(kExCluster));
+    putBytes(image, exClusterPos(7), video.mid(kExCluster, kExCluster));
+    putBytes(image, exClusterPos(6), video.mid(2 * kExCluster));
+    putBytes(image, exClusterPos(9), QByteArray("jpg"));
+
+    qsizetype root = exClusterPos(2);
+    image[root] = static_cast<char>(0x83);  // volume label
+    root += 32;
+    image[root] = static_cast<char>(0x81);  // allocation bitmap
+    root += 32;
+    root = exFileSet(image, root, QStringLiteral("Notes.txt"), false, 3, 6000, 6000, true, 0);
+    // Only the first 4096 bytes were ever written: the rest reads as zeros.
+    root = exFileSet(image, root, QStringLiteral("Video.bin"), false, 5, 10000, 4096, false, 0);
+    root = exFileSet(image, root, QStringLiteral("A rather long folder name"), true, 8, kExCluster, kExCluster,
+                     true, 0x80 | 4);  // UTC+01:00
+    exFileSet(image, exClusterPos(8), QStringLiteral("a.jpg"), false, 9, 3, 3, true, 0);
+    return image;
+}
+
+RawFsReader::ReadAt memoryReader(const QByteArray& image)
+{
+    return [image](uint64_t offset, char* data, size_t length, QString* error) {
+        if (offset + length > static_cast<uint64_t>(image.size())) {
+            *error = QStringLiteral("out of range");
+            return false;
+        }
+        std::memcpy(data, image.constData() + offset, length);
+        return true;
+    };
+}
+
+std::unique_ptr<RawFsReader> openImage(const QByteArray& image, QString* error)
+{
+    return RawFsReader::open(memoryReader(image), static_cast<uint64_t>(image.size()), error);
+}
+
+/** qCompress()ed images made with mke2fs -d; the tree is described in extFixtureTree(). */
+QByteArray extFixture(const QString& name)
+{
+    QFile file(QStringLiteral(FLASHSPARTAN_TEST_FIXTURES_DIR "/volumes/") + name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    return qUncompress(file.readAll());
+}
+
+QStringList names(const QVector<RawFsReader::Entry>& entries)
+{
+    QStringList out;
+    for (const RawFsReader::Entry& e : entries) {
+        out.append(e.name);
+    }
+    out.sort();
+    return out;
+}
+
+QByteArray readAll(RawFsReader& fs, const RawFsReader::Entry& file)
+{
+    QByteArray data;
+    QString error;
+    const bool ok = fs.read(file, [&data](const char* bytes, size_t n) {
+        data.append(bytes, static_cast<qsizetype>(n));
+        return true;
+    }, &error);
+    return ok ? data : QByteArray("read failed: ") + error.toUtf8();
+}
+
+} // namespace
+
+class TestRawFsReader : public QObject {
+    Q_OBJECT
+
+private slots:
+    void fat12ListsLongAndShortNames();
+    void fat12FollowsClusterChains();
+    void exFatListsFileSets();
+    void exFatReadsChainsAndValidLength();
+    void extFixturesMatchSourceTree_data();
+    void extFixturesMatchSourceTree();
+    void extReportsExactMetadata();
+    void refusesUnknownAndCorruptVolumes();
+};
+
+void TestRawFsReader::fat12ListsLongAndShortNames()
+{
+    QString error;
+    auto fs = openImage(fat12Image(), &error);
+    QVERIFY2(fs, qPrintable(error));
+    QCOMPARE(fs->type(), RawFsReader::Type::Fat);
+
+    QVector<RawFsReader::Entry> entries;
+    QVERIFY2(fs->list(fs->root(), &entries, &error), qPrintable(error));
+    QCOMPARE(names(entries), QStringList({QStringLiteral("DCIM"), QStringLiteral("Long File Name.txt"),
+                                          QStringLiteral("readme.txt")}));
+    for (const RawFsReader::Entry& e : entries) {
+        QCOMPARE(e.isDirectory, e.name == QLatin1String("DCIM"));
+        QCOMPARE(e.inode, uint64_t(0));
+        QVERIFY(!e.changedUtc.isValid());
+    }
+    const auto readme = std::find_if(entries.cbegin(), entries.cend(),
+                                     [](const auto& e) { return e.name == QLatin1String("readme.txt"); });
+    QCOMPARE(readme->modifiedUtc, QDateTime(QDate(2024, 5, 17), QTime(13, 30, 10)).toUTC());
+
+    // Looked up case-insensitively, as the kernel does on FAT.
+    RawFsReader::Entry image;
+    QVERIFY2(fs->lookup(QStringLiteral("dcim/img_0001.jpg"), &image, &error), qPrintable(error));
+    QCOMPARE(image.name, QStringLiteral("IMG_0001.JPG"));
+    QCOMPARE(readAll(*fs, image), pattern(100, 'j'));
+    QVERIFY(!fs->lookup(QStringLiteral("DCIM/missing.jpg"), &image, &error));
+    QVERIFY(error.isEmpty());
+}
+
+void TestRawFsReader::fat12FollowsClusterChains()
+{
+    QString error;
+    auto fs = openImage(fat12Image(), &error);
+    QVERIFY2(fs, qPrintable(error));
+    RawFsReader::Entry file;
+    QVERIFY2(fs->lookup(QStringLiteral("Long File Name.txt"), &file, &error), qPrintable(error));
+    QCOMPARE(file.size, uint64_t(5000));
+    QCOMPARE(readAll(*fs, file), fatFileA());
+
+    // A chain that loops back on itself is corrupt, not endless.
+    QByteArray looped = fat12Image();
+    setFat12(looped, 5, 2);
+    fs = openImage(looped, &error);
+    QVERIFY(fs);
+    QVERIFY(fs->lookup(QStringLiteral("Long File Name.txt"), &file, &error));
+    file.size = 1024 * 1024;
+    QVERIFY(readAll(*fs, file).startsWith("read failed: Corrupt volume"));
+}
+
+void TestRawFsReader::exFatListsFileSets()
+{
+    QString error;
+    auto fs = openImage(exFatImage(), &error);
+    QVERIFY2(fs, qPrintable(error));
+    QCOMPARE(fs->type(), RawFsReader::Type::ExFat);
+
+    QVector<RawFsReader::Entry> entries;
+    QVERIFY2(fs->list(fs->root(), &entries, &error), qPrintable(error));
+    QCOMPARE(names(entries), QStringList({QStringLiteral("A rather long folder name"), QStringLiteral("Notes.txt"),
+                                          QStringLiteral("Video.bin")}));
+    const auto folder = std::find_if(entries.cbegin(), entries.cend(), [](const auto& e) { return e.isDirectory; });
+    QCOMPARE(folder->modifiedUtc,
+             QDateTime(QDate(2024, 5, 17), QTime(12, 30, 10, 250), QTimeZone::utc()));
+
+    RawFsReader::Entry jpg;
+    QVERIFY2(fs->lookup(QStringLiteral("a RATHER long folder name/A.JPG"), &jpg, &error), qPrintable(error));
+    QCOMPARE(jpg.name, QStringLiteral("a.jpg"));
+    QCOMPARE(readAll(*fs, jpg), QByteArray("jpg"));
+}
+
+void TestRawFsReader::exFatReadsChainsAndValidLength()
+{
+    QString error;
+    auto fs = openImage(exFatImage(), &error);
+    QVERIFY2(fs, qPrintable(error));
+    RawFsReader::Entry notes;
+    QVERIFY(fs->lookup(QStringLiteral("Notes.txt"), &notes, &error));
+    QVERIFY(notes.contiguous);
+    QCOMPARE(readAll(*fs, notes), pattern(6000, 'n'));
+
+    RawFsReader::Entry video;
+    QVERIFY(fs->lookup(QStringLiteral("Video.bin"), &video, &error));
+    const QByteArray expected = pattern(3 * kExCluster, 'v').left(4096) + QByteArray(10000 - 4096, '\0');
+    QCOMPARE(readAll(*fs, video), expected);
+}
+
+void TestRawFsReader::extFixturesMatchSourceTree_data()
+{
+    QTest::addColumn<QString>("fixture");
+    QTest::newRow("ext4 (extents, metadata_csum)") << QStringLiteral("ext4.img.qz");
+    QTest::newRow("ext2 (block map)") << QStringLiteral("ext2.img.qz");
+}
+
+void TestRawFsReader::extFixturesMatchSourceTree()
+{
+    QFETCH(QString, fixture);
+    const QByteArray image = extFixture(fixture);
+    QVERIFY(!image.isEmpty());
+    QString error;
+    auto fs = openImage(image, &error);
+    QVERIFY2(fs, qPrintable(error));
+    QCOMPARE(fs->type(), RawFsReader::Type::Ext);
+
+    QVector<RawFsReader::Entry> entries;
+    QVERIFY2(fs->list(fs->root(), &entries, &error), qPrintable(error));
+    QCOMPARE(names(entries), QStringList({QStringLiteral("app"), QStringLiteral("big"), QStringLiteral("docs"),
+                                          QStringLiteral("links"), QStringLiteral("lost+found")}));
+
+    QByteArray report;
+    for (int i = 0; i < 5000; ++i) {
+        report += "line " + QByteArray::number(i) + '\n';
+    }
+    RawFsReader::Entry file;
+    QVERIFY2(fs->lookup(QStringLiteral("docs/report.txt"), &file, &error), qPrintable(error));
+    QCOMPARE(readAll(*fs, file), report);
+    QVERIFY(fs->lookup(QStringLiteral("docs/empty.txt"), &file, &error));
+    QCOMPARE(readAll(*fs, file), QByteArray());
+    QVERIFY(fs->lookup(QStringLiteral("app/.cache/state"), &file, &error));
+    QCOMPARE(readAll(*fs, file), QByteArray("hidden\n"));
+    // A hole of 300000 bytes, then "end".
+    QVERIFY(fs->lookup(QStringLiteral("big/sparse.bin"), &file, &error));
+    QCOMPARE(readAll(*fs, file), QByteArray(300000, '\0') + "end");
+
+    // ext is case-sensitive, and symbolic links are left to a mount.
+    QVERIFY(!fs->lookup(QStringLiteral("DOCS/report.txt"), &file, &error));
+    QVERIFY(error.isEmpty());
+    QVERIFY(fs->lookup(QStringLiteral("links/to-run"), &file, &error));
+    QVERIFY(file.isSymlink);
+    QVERIFY(!fs->lookup(QStringLiteral("links/to-run/x"), &file, &error));
+    QVERIFY(error.contains(QStringLiteral("Symbolic link")));
+}
+
+void TestRawFsReader::extReportsExactMetadata()
+{
+    QString error;
+    auto fs = openImage(extFixture(QStringLiteral("ext4.img.qz")), &error);
+    QVERIFY2(fs, qPrintable(error));
+    RawFsReader::Entry run;
+    QVERIFY(fs->lookup(QStringLiteral("app/run.sh"), &run, &error));
+    QCOMPARE(run.size, uint64_t(18));
+    QVERIFY(run.inode > 2);
+    // touch -d '2026-01-02 03:04:05 UTC' before mke2fs.
+    const QDateTime stamp(QDate(2026, 1, 2), QTime(3, 4, 5), QTimeZone::utc());
+    QCOMPARE(run.modifiedUtc, stamp);
+    QVERIFY(run.changedUtc.isValid());
+}
+
+void TestRawFsReader::refusesUnknownAndCorruptVolumes()
+{
+    QString error;
+    QVERIFY(!openImage(QByteArray(64 * 1024, '\0'), &error));
+    QVERIFY(error.contains(QStringLiteral("No FAT")));
+
+    // A journal that needs recovery means the on-disk tree is not what a mount would show.
+    QByteArray journaled = extFixture(QStringLiteral("ext4.img.qz"));
+    QVERIFY(!journaled.isEmpty());
+    journaled[1024 + 96] = static_cast<char>(journaled[1024 + 96] | 0x04);
+    QVERIFY(!openImage(journaled, &error));
+    QVERIFY(error.contains(QStringLiteral("recovery")));
+
+    // A FAT that claims more sectors than the device has.
+    QByteArray truncated = fat12Image().left(64 * 1024);
+    QVERIFY(!openImage(truncated, &error));
+    QVERIFY(error.startsWith(QStringLiteral("Corrupt volume")));
+
+    // An exFAT root cluster outside the heap.
+    QByteArray badRoot = exFatImage();
+    put32(badRoot, 96, 999);
+    QVERIFY(!openImage(badRoot, &error));
+}
+
+QTEST_MAIN(TestRawFsReader)
+#include "test_raw_fs_reader.moc"
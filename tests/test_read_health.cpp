@@ -0,0 +1,162 @@
+#include <QtTest>
+
+#include "ReadHealth.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+HashResult fullRead(double avgMBps, double minMBps = 0.0)
+{
+    HashResult r;
+    r.success = true;
+    r.hash = QStringLiteral("ab");
+    r.durationMs = 60000;
+    r.blockSize = 64ull * 1024 * 1024;
+    r.performance.engine = QStringLiteral("parallel");
+    r.performance.avgMBps = avgMBps;
+    r.performance.minMBps = minMBps;
+    return r;
+}
+
+ReadProfile profileOf(std::initializer_list<double> speeds)
+{
+    ReadProfile p;
+    for (double mbps : speeds) {
+        p = ReadHealth::advance(p, fullRead(mbps), {});
+    }
+    return p;
+}
+
+} // namespace
+
+class TestReadHealth : public QObject {
+    Q_OBJECT
+
+private slots:
+    void shortAndPartialReadsAreIgnored();
+    void collapseNeedsAProfile();
+    void collapsedReadStaysOutOfTheWindow();
+    void newEngineRestartsTheWindow();
+    void slowdownWithinARead();
+    void blockLatencySpike();
+    void profileRoundTrips();
+};
+
+void TestReadHealth::shortAndPartialReadsAreIgnored()
+{
+    HashResult quick = fullRead(1.0);
+    quick.durationMs = 1000;
+    QVERIFY(!ReadHealth::isAssessable(quick));
+    HashResult sample = fullRead(1.0);
+    sample.performance.engine = QStringLiteral("quick_sample");
+    QVERIFY(!ReadHealth::isAssessable(sample));
+    HashResult stopped = fullRead(1.0);
+    stopped.stoppedAtBlock = 3;
+    QVERIFY(!ReadHealth::isAssessable(stopped));
+
+    const ReadProfile profile = profileOf({40, 40, 40});
+    QVERIFY(ReadHealth::assess(profile, quick).isEmpty());
+    QCOMPARE(ReadHealth::advance(profile, quick, {}).recentMBps.size(), qsizetype(3));
+}
+
+void TestReadHealth::collapseNeedsAProfile()
+{
+    QVERIFY(ReadHealth::assess(profileOf({40, 40}), fullRead(5)).isEmpty());
+
+    const ReadProfile profile = profileOf({38, 40, 42});
+    QCOMPARE(ReadHealth::baselineMBps(profile), 40.0);
+    QVERIFY(ReadHealth::assess(profile, fullRead(25)).isEmpty());  // slower, not collapsed
+    const QList<ReadFinding> findings = ReadHealth::assess(profile, fullRead(12));
+    QCOMPARE(findings.size(), qsizetype(1));
+    QVERIFY(findings.first().kind == ReadAnomaly::SpeedCollapse);
+    QCOMPARE(findings.first().detail,
+             QStringLiteral("Read at 12.0 MB/s, against a median of 40.0 MB/s over its last 3 reads"));
+}
+
+void TestReadHealth::collapsedReadStaysOutOfTheWindow()
+{
+    ReadProfile profile = profileOf({40, 40, 40});
+    const HashResult slow = fullRead(10);
+    const QList<ReadFinding> findings = ReadHealth::assess(profile, slow);
+    profile = ReadHealth::advance(profile, slow, findings);
+    QCOMPARE(profile.recentMBps, (QList<double>{40, 40, 40}));
+    QCOMPARE(profile.anomalies, 1);
+    QVERIFY(profile.lastAnomaly.isValid());
+    QCOMPARE(ReadHealth::assess(profile, slow).size(), qsizetype(1));  // still flagged next time
+
+    for (int i = 0; i < 10; ++i) {
+        profile = ReadHealth::advance(profile, fullRead(30 + i), {});
+    }
+    QCOMPARE(profile.recentMBps.size(), qsizetype(ReadProfile::kWindow));
+    QCOMPARE(profile.recentMBps.last(), 39.0);
+}
+
+void TestReadHealth::newEngineRestartsTheWindow()
+{
+    const ReadProfile profile = profileOf({40, 40, 40, 40});
+    HashResult elevated = fullRead(10);
+    elevated.performance.elevated = true;
+    QVERIFY(ReadHealth::assess(profile, elevated).isEmpty());
+    const ReadProfile next = ReadHealth::advance(profile, elevated, {});
+    QVERIFY(next.elevated);
+    QCOMPARE(next.recentMBps, QList<double>{10});
+}
+
+void TestReadHealth::slowdownWithinARead()
+{
+    QVERIFY(ReadHealth::assess({}, fullRead(40, 15)).isEmpty());
+    const QList<ReadFinding> findings = ReadHealth::assess({}, fullRead(40, 2.5));
+    QCOMPARE(findings.size(), qsizetype(1));
+    QVERIFY(findings.first().kind == ReadAnomaly::InJobSlowdown);
+}
+
+void TestReadHealth::blockLatencySpike()
+{
+    HashResult r = fullRead(40);
+    r.performance.timedBlocks = 32;
+    r.performance.blockMsMedian = 1600;
+    r.performance.blockMsMax = 9000;  // 5.6x: within range
+    r.performance.slowestBlock = 16;
+    QVERIFY(ReadHealth::assess({}, r).isEmpty());
+
+    r.performance.blockMsMax = 30000;
+    const QList<ReadFinding> findings = ReadHealth::assess({}, r);
+    QCOMPARE(findings.size(), qsizetype(1));
+    QVERIFY(findings.first().kind == ReadAnomaly::BlockLatencySpike);
+    QCOMPARE(findings.first().detail,
+             QStringLiteral("Block 16 (at 1.00 GiB) took 30000 ms, against a median of 1600 ms"));
+
+    // Fast sticks: a large ratio of tiny times is noise
+    r.performance.blockMsMedian = 20;
+    r.performance.blockMsMax = 400;
+    QVERIFY(ReadHealth::assess({}, r).isEmpty());
+
+    r.performance.blockMsMedian = 1600;
+    r.performance.blockMsMax = 30000;
+    const ReadProfile next = ReadHealth::advance({}, r, findings);
+    QCOMPARE(next.worstBlockRatio, 30000.0 / 1600.0);
+}
+
+void TestReadHealth::profileRoundTrips()
+{
+    ReadProfile p = profileOf({12.5, 14, 13});
+    p.worstBlockRatio = 3.5;
+    p.anomalies = 2;
+    p.lastAnomaly = QDateTime(QDate(2026, 5, 1), QTime(12, 0), QTimeZone::utc());
+
+    DeviceRecord record;
+    record.uniqueId = QStringLiteral("usb-1");
+    record.readProfile = p;
+    const DeviceRecord back = DeviceRecord::fromJson(record.toJson());
+    QCOMPARE(back.readProfile.engine, QStringLiteral("parallel"));
+    QCOMPARE(back.readProfile.recentMBps, (QList<double>{12.5, 14, 13}));
+    QCOMPARE(back.readProfile.worstBlockRatio, 3.5);
+    QCOMPARE(back.readProfile.anomalies, 2);
+    QCOMPARE(back.readProfile.lastAnomaly, p.lastAnomaly);
+
+    QVERIFY(!DeviceRecord().toJson().contains(QStringLiteral("read_profile")));
+}
+
+QTEST_MAIN(TestReadHealth)
+#include "test_read_health.moc"
@@ -0,0 +1,126 @@
+#include <QtTest>
+
+#include "RecordTableModel.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+using IntModel = RecordTableModel<int>;
+
+QVariant intCell(const int& value, int column, int role)
+{
+    return role == Qt::DisplayRole && column == 0 ? QVariant(value) : QVariant();
+}
+
+/** @p count values, newest (highest) first. */
+QList<int> newestFirst(int from, int count)
+{
+    QList<int> out;
+    for (int i = from + count - 1; i >= from; --i) {
+        out.append(i);
+    }
+    return out;
+}
+
+int valueAt(const IntModel& model, int row)
+{
+    return model.data(model.index(row, 0)).toInt();
+}
+
+} // namespace
+
+class TestRecordTableModel : public QObject {
+    Q_OBJECT
+
+private slots:
+    void fetchesInBatches();
+    void prependsNewRecordsUnderFilter();
+    void filtersLargeSetsOnThePool();
+    void pullsOlderRecordsFromTheStore();
+};
+
+void TestRecordTableModel::fetchesInBatches()
+{
+    IntModel model({QStringLiteral("Value")}, intCell);
+    model.setRecords(newestFirst(0, 600));
+    QCOMPARE(model.rowCount(), RecordTableModelBase::kFetchBatch);
+    QCOMPARE(model.matchCount(), 600);
+    QCOMPARE(valueAt(model, 0), 599);
+    QCOMPARE(model.headerData(0, Qt::Horizontal).toString(), QStringLiteral("Value"));
+
+    QVERIFY(model.canFetchMore(QModelIndex()));
+    model.fetchMore(QModelIndex());
+    model.fetchMore(QModelIndex());
+    QCOMPARE(model.rowCount(), 600);
+    QVERIFY(!model.canFetchMore(QModelIndex()));
+    QCOMPARE(valueAt(model, 599), 0);
+}
+
+void TestRecordTableModel::prependsNewRecordsUnderFilter()
+{
+    IntModel model({QStringLiteral("Value")}, intCell);
+    model.setRecords(newestFirst(0, 10));
+    model.setFilter([](const int& v) { return v % 2 == 0; });
+    QCOMPARE(model.rowCount(), 5);
+
+    QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+    model.prependRecords({13, 12, 11, 10});
+    QCOMPARE(inserted.count(), 1);
+    QCOMPARE(inserted.first().at(1).toInt(), 0);
+    QCOMPARE(model.rowCount(), 7);
+    QCOMPARE(valueAt(model, 0), 12);
+    QCOMPARE(valueAt(model, 1), 10);
+    QCOMPARE(valueAt(model, 2), 8);
+    QCOMPARE(model.record(6), 0);
+}
+
+void TestRecordTableModel::filtersLargeSetsOnThePool()
+{
+    IntModel model({QStringLiteral("Value")}, intCell);
+    const int count = RecordTableModelBase::kAsyncFilterRecords * 4;
+    model.setRecords(newestFirst(0, count));
+
+    QSignalSpy replaced(&model, &RecordTableModelBase::rowsReplaced);
+    model.setFilter([](const int& v) { return v % 2 == 0; });
+    model.setFilter([](const int& v) { return v % 3 == 0; });  // supersedes the first
+    QVERIFY(model.isFiltering());
+    model.prependRecords({count + 2, count + 1, count});  // arrives while it runs
+    QTRY_VERIFY(!model.isFiltering());
+
+    int expected = 0;
+    for (int v = 0; v < count + 3; ++v) {
+        expected += v % 3 == 0 ? 1 : 0;
+    }
+    QCOMPARE(model.matchCount(), expected);
+    QCOMPARE(valueAt(model, 0), (count + 2) / 3 * 3);
+    QCOMPARE(model.rowCount(), RecordTableModelBase::kFetchBatch);
+    QCOMPARE(replaced.count(), 3);  // cleared twice, then the second filter's result
+}
+
+void TestRecordTableModel::pullsOlderRecordsFromTheStore()
+{
+    const QList<int> store = newestFirst(0, 1000);
+    IntModel model({QStringLiteral("Value")}, intCell);
+    int pulls = 0;
+    model.setOlderSource([&store, &pulls](const QList<int>& held, int count) {
+        ++pulls;
+        return store.mid(held.size(), count);
+    });
+    model.setRecords(store.mid(0, 100));
+    model.setFilter([](const int& v) { return v < 50 || v >= 900; });
+    QCOMPARE(model.rowCount(), 100);
+    QVERIFY(model.canFetchMore(QModelIndex()));
+
+    // Pages from 899 down to 132 match nothing; one fetch keeps reading until the last page.
+    model.fetchMore(QModelIndex());
+    QCOMPARE(pulls, 4);
+    QCOMPARE(model.rowCount(), 150);
+    QCOMPARE(valueAt(model, 100), 49);
+    QCOMPARE(valueAt(model, 149), 0);
+    QCOMPARE(model.recordCount(), 1000);
+    QVERIFY(!model.canFetchMore(QModelIndex()));
+}
+
+QTEST_MAIN(TestRecordTableModel)
+#include "test_record_table_model.moc"
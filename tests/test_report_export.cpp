@@ -0,0 +1,236 @@
+#include <QtTest>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+#include "AuditLogIndex.h"
+#include "ReportExport.h"
+#include "VerifyHistory.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+const QDateTime kStart(QDate(2025, 1, 1), QTime(8, 0), QTimeZone::utc());
+
+VerifyHistoryEntry entry(int n)
+{
+    VerifyHistoryEntry e;
+    e.timestamp = kStart.addSecs(n * 60);
+    e.deviceNode = n % 2 ? QStringLiteral("/dev/sdb") : QStringLiteral("/dev/sdc");
+    e.deviceLabel = QStringLiteral("STICK");
+    e.status = n % 4 == 3 ? QStringLiteral("fail") : QStringLiteral("pass");
+    e.summary = QStringLiteral("check %1, \"quoted\"").arg(n);
+    e.durationMs = 1500;
+    return e;
+}
+
+/** One audit segment of @p count lines starting at @p first; the open one has no sidecar. */
+void writeSegment(const QString& segment, int first, int count, bool sidecar)
+{
+    QFile log(segment);
+    QVERIFY(log.open(QIODevice::WriteOnly));
+    QByteArray index = AuditLogIndex::encodeHeader();
+    for (int n = first; n < first + count; ++n) {
+        const QString device = n % 2 ? QStringLiteral("/dev/sdb") : QStringLiteral("/dev/sdc");
+        QJsonObject o;
+        o[QStringLiteral("ts")] = kStart.addSecs(n * 60).toString(Qt::ISODate);
+        o[QStringLiteral("event")] = QStringLiteral("iso_verify");
+        o[QStringLiteral("path")] = QStringLiteral("<iso %1>").arg(n);
+        o[QStringLiteral("n")] = n;
+        index += AuditLogIndex::encodeEntry({kStart.addSecs(n * 60).toMSecsSinceEpoch(),
+                                             static_cast<quint64>(log.pos()), AuditLogIndex::deviceHash(device)});
+        log.write(QJsonDocument(o).toJson(QJsonDocument::Compact) + '\n');
+    }
+    if (sidecar) {
+        QFile idx(AuditLogIndex::indexPath(segment));
+        QVERIFY(idx.open(QIODevice::WriteOnly));
+        idx.write(index);
+    }
+}
+
+QList<QByteArray> readLines(const QString& path)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    QList<QByteArray> lines = f.readAll().split('\n');
+    if (!lines.isEmpty() && lines.constLast().isEmpty()) {
+        lines.removeLast();
+    }
+    return lines;
+}
+
+} // namespace
+
+class TestReportExport : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void formatFollowsExtension();
+    void verificationCsvCoversTheWholeRing();
+    void verificationNdjsonKeepsStoredFields();
+    void auditForEachPushesDownRangeAndDevice();
+    void auditHtmlIsEscaped();
+    void cancelledExportWritesNothing();
+
+private:
+    QTemporaryDir m_dir;
+    QString m_ringPath;
+    QString m_logPath;
+};
+
+void TestReportExport::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+    m_ringPath = m_dir.filePath(QStringLiteral("verify-history.ring"));
+    VerifyHistory& history = VerifyHistory::instance();
+    history.load(m_ringPath);
+    for (int n = 0; n < 2000; ++n) {
+        history.append(entry(n));
+    }
+    history.save();
+
+    m_logPath = m_dir.filePath(QStringLiteral("audit.log"));
+    writeSegment(m_logPath + QStringLiteral(".1"), 0, 300, true);
+    writeSegment(m_logPath + QStringLiteral(".2"), 300, 300, true);
+    writeSegment(m_logPath, 600, 100, false);
+}
+
+void TestReportExport::formatFollowsExtension()
+{
+    QCOMPARE(ReportExport::formatForPath(QStringLiteral("a.NDJSON")), ReportExport::Format::Ndjson);
+    QCOMPARE(ReportExport::formatForPath(QStringLiteral("a.jsonl")), ReportExport::Format::Ndjson);
+    QCOMPARE(ReportExport::formatForPath(QStringLiteral("a.htm")), ReportExport::Format::Html);
+    QCOMPARE(ReportExport::formatForPath(QStringLiteral("a.csv")), ReportExport::Format::Csv);
+    QCOMPARE(ReportExport::formatForPath(QStringLiteral("a")), ReportExport::Format::Csv);
+}
+
+void TestReportExport::verificationCsvCoversTheWholeRing()
+{
+    ReportExport::Request request;
+    request.sourcePath = m_ringPath;
+    request.outputPath = m_dir.filePath(QStringLiteral("fails.csv"));
+    request.filter.status = QStringLiteral("FAIL");
+    request.filter.device = QStringLiteral("/dev/sdb");
+    request.filter.from = kStart.addSecs(100 * 60);
+
+    qint64 lastRows = -1;
+    double lastDone = 0.0;
+    const ReportExport::Result result = ReportExport::run(request, [&](qint64 rows, double done) {
+        QVERIFY(rows >= lastRows);
+        QVERIFY(done >= lastDone);
+        lastRows = rows;
+        lastDone = done;
+    });
+    QVERIFY2(result.success, qPrintable(result.errorMessage));
+    // n % 4 == 3 is always odd, so every failure is on sdb: 475 of them from n = 103 on.
+    QCOMPARE(result.rows, qint64(475));
+    QCOMPARE(lastRows, result.rows);
+    QCOMPARE(lastDone, 1.0);
+
+    const QList<QByteArray> lines = readLines(request.outputPath);
+    QCOMPARE(lines.size(), 476);
+    QVERIFY(lines.first().startsWith("Time,Device,Node,Type,Status"));
+    QVERIFY(lines.at(1).contains(",\"check 103, \"\"quoted\"\"\","));
+    QVERIFY(lines.last().contains("check 1999,"));
+}
+
+void TestReportExport::verificationNdjsonKeepsStoredFields()
+{
+    ReportExport::Request request;
+    request.sourcePath = m_ringPath;
+    request.outputPath = m_dir.filePath(QStringLiteral("range.ndjson"));
+    request.format = ReportExport::Format::Ndjson;
+    request.filter.from = kStart.addSecs(10 * 60);
+    request.filter.to = kStart.addSecs(19 * 60);
+    request.filter.text = QStringLiteral("CHECK 1");
+
+    const ReportExport::Result result = ReportExport::run(request);
+    QVERIFY2(result.success, qPrintable(result.errorMessage));
+    QCOMPARE(result.rows, qint64(10));
+    const QList<QByteArray> lines = readLines(request.outputPath);
+    QCOMPARE(lines.size(), 10);
+    const QJsonObject first = QJsonDocument::fromJson(lines.first()).object();
+    QCOMPARE(first[QStringLiteral("device_node")].toString(), QStringLiteral("/dev/sdc"));
+    QCOMPARE(first[QStringLiteral("summary")].toString(), QStringLiteral("check 10, \"quoted\""));
+    QCOMPARE(first[QStringLiteral("duration_ms")].toInt(), 1500);
+}
+
+void TestReportExport::auditForEachPushesDownRangeAndDevice()
+{
+    AuditLogIndex::Query query;
+    query.from = kStart.addSecs(250 * 60);
+    query.to = kStart.addSecs(650 * 60);
+    query.device = QStringLiteral("/dev/sdb");
+    QList<int> seen;
+    double lastDone = 0.0;
+    QVERIFY(AuditLogIndex::forEach(m_logPath, query, [&](const QByteArray& line, double done) {
+        seen.append(QJsonDocument::fromJson(line)[QStringLiteral("n")].toInt());
+        lastDone = done;
+        return true;
+    }));
+    // The open segment has no sidecar yet, so its lines carry no device and are skipped.
+    QCOMPARE(seen.first(), 251);
+    QCOMPARE(seen.last(), 599);
+    QCOMPARE(seen.size(), 175);
+    QVERIFY(lastDone > 0.8 && lastDone < 0.9);
+
+    query.from = kStart.addSecs(590 * 60);
+    query.to = kStart.addSecs(610 * 60);
+    query.device.clear();
+    seen.clear();
+    QVERIFY(AuditLogIndex::forEach(m_logPath, query, [&](const QByteArray& line, double) {
+        seen.append(QJsonDocument::fromJson(line)[QStringLiteral("n")].toInt());
+        return true;
+    }));
+    QCOMPARE(seen.size(), 21);
+    QCOMPARE(seen.first(), 590);
+    QCOMPARE(seen.last(), 610);
+
+    int visited = 0;
+    QVERIFY(!AuditLogIndex::forEach(m_logPath, {}, [&](const QByteArray&, double) { return ++visited < 5; }));
+    QCOMPARE(visited, 5);
+}
+
+void TestReportExport::auditHtmlIsEscaped()
+{
+    ReportExport::Request request;
+    request.source = ReportExport::Source::Audit;
+    request.sourcePath = m_logPath;
+    request.outputPath = m_dir.filePath(QStringLiteral("audit.html"));
+    request.format = ReportExport::Format::Html;
+    request.filter.text = QStringLiteral("<iso 42>");
+
+    const ReportExport::Result result = ReportExport::run(request);
+    QVERIFY2(result.success, qPrintable(result.errorMessage));
+    QCOMPARE(result.rows, qint64(1));
+    QFile f(request.outputPath);
+    QVERIFY(f.open(QIODevice::ReadOnly));
+    const QByteArray html = f.readAll();
+    QVERIFY(html.contains("<th>Category</th>"));
+    QVERIFY(html.contains("<td>&lt;iso 42&gt;</td>"));
+    QVERIFY(html.endsWith("</table></body></html>\n"));
+}
+
+void TestReportExport::cancelledExportWritesNothing()
+{
+    ReportExport::Request request;
+    request.sourcePath = m_ringPath;
+    request.outputPath = m_dir.filePath(QStringLiteral("cancelled.csv"));
+    std::atomic<bool> cancelled{true};
+    const ReportExport::Result result = ReportExport::run(request, {}, &cancelled);
+    QVERIFY(!result.success);
+    QVERIFY(result.cancelled);
+    QVERIFY(!QFile::exists(request.outputPath));
+
+    request.sourcePath = m_dir.filePath(QStringLiteral("missing.ring"));
+    QVERIFY(!ReportExport::run(request).success);
+    QVERIFY(!QFile::exists(request.outputPath));
+}
+
+QTEST_MAIN(TestReportExport)
+#include "test_report_export.moc"
@@ -0,0 +1,101 @@
+#include <QtTest>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "SettingsSnapshot.h"
+
+using namespace FlashSpartan;
+
+class TestSettingsSnapshot : public QObject {
+    Q_OBJECT
+
+private slots:
+    void publishReplacesTheSnapshot();
+    void heldSnapshotNeverChanges();
+    void listenersFollowPublishes();
+    void readersSeeWholeSnapshots();
+};
+
+void TestSettingsSnapshot::publishReplacesTheSnapshot()
+{
+    QVERIFY(SettingsSnapshot::current() != nullptr);
+    const quint64 before = SettingsSnapshot::version();
+
+    AppSettings settings;
+    settings.isoVerifyParallel = 5;
+    settings.isoMirrorUrl = QStringLiteral("http://kiosk-01:8470");
+    SettingsSnapshot::publish(settings);
+
+    QCOMPARE(SettingsSnapshot::version(), before + 1);
+    QCOMPARE(SettingsSnapshot::current()->isoVerifyParallel, 5);
+    QCOMPARE(SettingsSnapshot::current()->isoMirrorUrl, QStringLiteral("http://kiosk-01:8470"));
+}
+
+void TestSettingsSnapshot::heldSnapshotNeverChanges()
+{
+    AppSettings settings;
+    settings.maxConcurrentHashes = 3;
+    SettingsSnapshot::publish(settings);
+    const SettingsSnapshot::Ptr held = SettingsSnapshot::current();
+
+    settings.maxConcurrentHashes = 7;
+    SettingsSnapshot::publish(settings);
+    QCOMPARE(held->maxConcurrentHashes, 3);
+    QCOMPARE(SettingsSnapshot::current()->maxConcurrentHashes, 7);
+}
+
+void TestSettingsSnapshot::listenersFollowPublishes()
+{
+    QList<int> seen;
+    const int id = SettingsSnapshot::addListener(
+        [&seen](const SettingsSnapshot::Ptr& settings) { seen.append(settings->isoVerifyParallel); });
+
+    AppSettings settings;
+    settings.isoVerifyParallel = 1;
+    SettingsSnapshot::publish(settings);
+    settings.isoVerifyParallel = 4;
+    SettingsSnapshot::publish(settings);
+    SettingsSnapshot::removeListener(id);
+    settings.isoVerifyParallel = 9;
+    SettingsSnapshot::publish(settings);
+
+    QCOMPARE(seen, QList<int>({1, 4}));
+}
+
+void TestSettingsSnapshot::readersSeeWholeSnapshots()
+{
+    // Two fields always published equal: a reader must never see them differ.
+    AppSettings settings;
+    settings.isoVerifyParallel = -1;
+    settings.maxConcurrentHashes = -1;
+    SettingsSnapshot::publish(settings);
+
+    std::atomic<bool> stop{false};
+    std::atomic<int> torn{0};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&]() {
+            while (!stop.load()) {
+                const SettingsSnapshot::Ptr s = SettingsSnapshot::current();
+                if (s->isoVerifyParallel != s->maxConcurrentHashes) {
+                    ++torn;
+                }
+            }
+        });
+    }
+    for (int i = 0; i < 2000; ++i) {
+        settings.isoVerifyParallel = i;
+        settings.maxConcurrentHashes = i;
+        SettingsSnapshot::publish(settings);
+    }
+    stop = true;
+    for (std::thread& t : readers) {
+        t.join();
+    }
+    QCOMPARE(torn.load(), 0);
+}
+
+QTEST_MAIN(TestSettingsSnapshot)
+#include "test_settings_snapshot.moc"
@@ -0,0 +1,140 @@
+#include <QtTest>
+#include "SharedReadPass.h"
+
+#include <QThread>
+
+#include <atomic>
+#include <cstring>
+
+using namespace FlashSpartan;
+
+namespace {
+
+QByteArray pattern(char first, qsizetype length)
+{
+    QByteArray data(length, Qt::Uninitialized);
+    for (qsizetype i = 0; i < length; ++i) {
+        data[i] = static_cast<char>(first + i);
+    }
+    return data;
+}
+
+/** Fills with 'd' and counts the calls, standing in for the device. */
+SharedReadPass::DirectRead countingDirect(int* calls)
+{
+    return [calls](uint64_t, char* data, size_t length, QString*) {
+        ++*calls;
+        std::memset(data, 'd', length);
+        return true;
+    };
+}
+
+} // namespace
+
+class TestSharedReadPass : public QObject {
+    Q_OBJECT
+private slots:
+    void readSpansPublishedBuffers();
+    void readWaitsForThePublisher();
+    void finishedPassReadsDirect();
+    void evictedBytesReadDirect();
+    void cancelledReadStopsWaiting();
+};
+
+void TestSharedReadPass::readSpansPublishedBuffers()
+{
+    SharedReadPass pass;
+    const QByteArray first = pattern('a', 8);
+    const QByteArray second = pattern('k', 8);
+    pass.publish(0, first.constData(), 8);
+    pass.publish(8, second.constData(), 8);
+
+    int direct = 0;
+    QString error;
+    char out[6] = {};
+    QVERIFY(pass.read(5, out, sizeof(out), countingDirect(&direct), &error));
+    QCOMPARE(QByteArray(out, sizeof(out)), first.mid(5) + second.left(3));
+    QCOMPARE(direct, 0);
+    QCOMPARE(pass.sharedBytes(), uint64_t(6));
+    QCOMPARE(pass.directBytes(), uint64_t(0));
+}
+
+void TestSharedReadPass::readWaitsForThePublisher()
+{
+    SharedReadPass pass;
+    const QByteArray data = pattern('a', 16);
+    pass.publish(0, data.constData(), 8);
+
+    QThread* publisher = QThread::create([&pass, &data]() {
+        QThread::msleep(50);
+        pass.publish(8, data.constData() + 8, 8);
+    });
+    publisher->start();
+
+    int direct = 0;
+    QString error;
+    char out[4] = {};
+    QVERIFY(pass.read(10, out, sizeof(out), countingDirect(&direct), &error));
+    publisher->wait();
+    delete publisher;
+    QCOMPARE(QByteArray(out, sizeof(out)), data.mid(10, 4));
+    QCOMPARE(direct, 0);
+}
+
+void TestSharedReadPass::finishedPassReadsDirect()
+{
+    SharedReadPass pass;
+    const QByteArray data = pattern('a', 8);
+    pass.publish(0, data.constData(), 8);
+    pass.finish();
+
+    int direct = 0;
+    QString error;
+    char out[4] = {};
+    QVERIFY(pass.read(2, out, sizeof(out), countingDirect(&direct), &error));
+    QCOMPARE(QByteArray(out, sizeof(out)), data.mid(2, 4));
+    QVERIFY(pass.read(8, out, sizeof(out), countingDirect(&direct), &error));
+    QCOMPARE(QByteArray(out, sizeof(out)), QByteArray(4, 'd'));
+    QCOMPARE(direct, 1);
+    QCOMPARE(pass.directBytes(), uint64_t(4));
+}
+
+void TestSharedReadPass::evictedBytesReadDirect()
+{
+    SharedReadPass pass(8);
+    const QByteArray data = pattern('a', 16);
+    int direct = 0;
+    QString error;
+    char out[8] = {};
+
+    pass.publish(0, data.constData(), 8);
+    QVERIFY(pass.read(0, out, 8, countingDirect(&direct), &error));
+    // The reader is past the first buffer, so the second one replaces it at once.
+    pass.publish(8, data.constData() + 8, 8);
+
+    QVERIFY(pass.read(0, out, 4, countingDirect(&direct), &error));
+    QCOMPARE(QByteArray(out, 4), QByteArray(4, 'd'));
+    QVERIFY(pass.read(8, out, 8, countingDirect(&direct), &error));
+    QCOMPARE(QByteArray(out, 8), data.mid(8));
+    QCOMPARE(direct, 1);
+}
+
+void TestSharedReadPass::cancelledReadStopsWaiting()
+{
+    SharedReadPass pass;
+    const QByteArray data = pattern('a', 8);
+    pass.publish(0, data.constData(), 8);
+
+    const std::atomic<bool> cancelled{true};
+    int direct = 0;
+    QString error;
+    char out[4] = {};
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(pass.read(64, out, sizeof(out), countingDirect(&direct), &error, &cancelled));
+    QVERIFY(timer.elapsed() < SharedReadPass::kStallMs);
+    QCOMPARE(direct, 1);
+}
+
+QTEST_MAIN(TestSharedReadPass)
+#include "test_shared_read_pass.moc"
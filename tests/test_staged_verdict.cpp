@@ -0,0 +1,83 @@
+#include <QtTest>
+
+#include "StagedVerdict.h"
+
+using namespace FlashSpartan;
+
+class TestStagedVerdict : public QObject {
+    Q_OBJECT
+
+private slots:
+    void identityBlockIsConclusive();
+    void earlyPassIsProvisional();
+    void finalStagePassIsConclusive();
+    void laterFailOverturnsAllow();
+    void blockIsNeverOverturned();
+    void inconclusiveKeepsVerdict();
+};
+
+void TestStagedVerdict::identityBlockIsConclusive()
+{
+    StagedVerdict verdict(VerifyStage::FullContent);
+    QVERIFY(verdict.record(VerifyStage::Identity, StageOutcome::Fail, QStringLiteral("drive is blocked")));
+    QCOMPARE(verdict.verdict(), ProvisionalVerdict::Block);
+    QVERIFY(verdict.isConclusive());
+    QCOMPARE(*verdict.decidedAt(), VerifyStage::Identity);
+    QCOMPARE(verdict.describe(), QStringLiteral("Block at identity"));
+}
+
+void TestStagedVerdict::earlyPassIsProvisional()
+{
+    StagedVerdict verdict(VerifyStage::FullContent);
+    QVERIFY(verdict.record(VerifyStage::Identity, StageOutcome::Pass));
+    QCOMPARE(verdict.verdict(), ProvisionalVerdict::Allow);
+    QVERIFY(!verdict.isConclusive());
+    // A second early pass changes nothing worth publishing.
+    QVERIFY(!verdict.record(VerifyStage::Metadata, StageOutcome::Pass));
+    QCOMPARE(verdict.describe(), QStringLiteral("Allow (provisional, after watch manifest)"));
+    QCOMPARE(verdict.stages().size(), 2);
+}
+
+void TestStagedVerdict::finalStagePassIsConclusive()
+{
+    StagedVerdict verdict(VerifyStage::Metadata);
+    verdict.record(VerifyStage::Identity, StageOutcome::Pass);
+    QVERIFY(verdict.record(VerifyStage::Metadata, StageOutcome::Pass));
+    QVERIFY(verdict.isConclusive());
+    QCOMPARE(*verdict.decidedAt(), VerifyStage::Metadata);
+    QCOMPARE(verdict.verdict(), ProvisionalVerdict::Allow);
+}
+
+void TestStagedVerdict::laterFailOverturnsAllow()
+{
+    StagedVerdict verdict(VerifyStage::QuickSample);
+    verdict.record(VerifyStage::QuickSample, StageOutcome::Pass);
+    QVERIFY(verdict.isConclusive());
+    QVERIFY(verdict.record(VerifyStage::FullContent, StageOutcome::Fail));
+    QCOMPARE(verdict.verdict(), ProvisionalVerdict::Block);
+    QCOMPARE(*verdict.decidedAt(), VerifyStage::FullContent);
+}
+
+void TestStagedVerdict::blockIsNeverOverturned()
+{
+    StagedVerdict verdict;
+    verdict.record(VerifyStage::QuickSample, StageOutcome::Fail);
+    QVERIFY(!verdict.record(VerifyStage::FullContent, StageOutcome::Pass));
+    QCOMPARE(verdict.verdict(), ProvisionalVerdict::Block);
+    QCOMPARE(*verdict.decidedAt(), VerifyStage::QuickSample);
+    QCOMPARE(verdict.stages().size(), 2);
+}
+
+void TestStagedVerdict::inconclusiveKeepsVerdict()
+{
+    StagedVerdict verdict;
+    QVERIFY(!verdict.record(VerifyStage::Identity, StageOutcome::Inconclusive));
+    QCOMPARE(verdict.verdict(), ProvisionalVerdict::Pending);
+    verdict.record(VerifyStage::Identity, StageOutcome::Pass);
+    QVERIFY(!verdict.record(VerifyStage::FullContent, StageOutcome::Inconclusive));
+    QCOMPARE(verdict.verdict(), ProvisionalVerdict::Allow);
+    QVERIFY(!verdict.isConclusive());
+}
+
+QTEST_MAIN(TestStagedVerdict)
+#include "test_staged_verdict.moc"
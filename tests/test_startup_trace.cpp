@@ -0,0 +1,86 @@
+#include <QtTest>
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QtConcurrent>
+
+#include "StartupTrace.h"
+
+using namespace FlashSpartan;
+
+class TestStartupTrace : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init() { StartupTrace::reset(); }
+    void phasesRecordDurations();
+    void writesChromeTraceOnFinish();
+    void laterPhasesRewriteTheFile();
+};
+
+void TestStartupTrace::phasesRecordDurations()
+{
+    StartupTrace::start();
+    {
+        StartupTrace::Phase phase(QStringLiteral("outer"));
+        QTest::qSleep(5);
+        StartupTrace::Phase early(QStringLiteral("ended early"));
+        early.end();
+        early.end();
+    }
+    QFuture<void> worker = QtConcurrent::run([]() { StartupTrace::Phase phase(QStringLiteral("worker")); });
+    worker.waitForFinished();
+
+    const QList<StartupTrace::Event> events = StartupTrace::events();
+    QCOMPARE(events.size(), 3);
+    QCOMPARE(events.at(0).name, QStringLiteral("ended early"));
+    QCOMPARE(events.at(1).name, QStringLiteral("outer"));
+    QVERIFY(events.at(1).durationUs >= 5000);
+    QVERIFY(events.at(1).beginUs <= events.at(0).beginUs);
+    QCOMPARE(events.at(1).thread, events.at(0).thread);
+    QVERIFY(events.at(2).thread != events.at(1).thread);
+}
+
+void TestStartupTrace::writesChromeTraceOnFinish()
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath(QStringLiteral("startup.json"));
+    StartupTrace::start();
+    StartupTrace::setOutputPath(path);
+    StartupTrace::record(QStringLiteral("policy daemon launch"), 100, 350);
+    QVERIFY(!QFile::exists(path));
+
+    StartupTrace::finish();
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    const QJsonArray events = root.value(QStringLiteral("traceEvents")).toArray();
+    QCOMPARE(events.size(), 2);
+    const QJsonObject first = events.at(0).toObject();
+    QCOMPARE(first.value(QStringLiteral("ph")).toString(), QStringLiteral("X"));
+    QCOMPARE(first.value(QStringLiteral("ts")).toInteger(), 100);
+    QCOMPARE(first.value(QStringLiteral("dur")).toInteger(), 250);
+    QCOMPARE(first.value(QStringLiteral("pid")).toInteger(), QCoreApplication::applicationPid());
+    QCOMPARE(events.at(1).toObject().value(QStringLiteral("ts")).toInteger(), 0);
+}
+
+void TestStartupTrace::laterPhasesRewriteTheFile()
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath(QStringLiteral("startup.json"));
+    StartupTrace::setOutputPath(path);
+    StartupTrace::finish();
+    StartupTrace::record(QStringLiteral("udev initial scan"), 10, 20);
+
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::ReadOnly));
+    const QJsonArray events =
+        QJsonDocument::fromJson(file.readAll()).object().value(QStringLiteral("traceEvents")).toArray();
+    QCOMPARE(events.size(), 2);
+    QCOMPARE(events.at(1).toObject().value(QStringLiteral("name")).toString(), QStringLiteral("udev initial scan"));
+}
+
+QTEST_GUILESS_MAIN(TestStartupTrace)
+#include "test_startup_trace.moc"
@@ -0,0 +1,122 @@
+#include <QtTest>
+#include "RawDeviceHashAdvanced.h"
+
+#include <QCryptographicHash>
+
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+using namespace FlashSpartan;
+
+namespace {
+
+constexpr uint64_t kKiB = 1024;
+
+/** A 1 MiB "device" with a bad 4 KiB sector at 300 KiB and a read that hangs at 700 KiB. */
+RawDeviceHash::ReadAtFn flakyDevice(const QByteArray& data, int hangMs)
+{
+    // Captured by value: a timed-out read finishes after the hash returned.
+    return [data, hangMs](char* out, size_t length, uint64_t offset) -> int64_t {
+        const uint64_t end = offset + length;
+        if (offset < 304 * kKiB && end > 300 * kKiB) {
+            errno = EIO;
+            return -1;
+        }
+        if (offset <= 700 * kKiB && end > 700 * kKiB) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(hangMs));
+        }
+        const uint64_t n = qMin<uint64_t>(length, static_cast<uint64_t>(data.size()) - offset);
+        std::memcpy(out, data.constData() + offset, n);
+        return static_cast<int64_t>(n);
+    };
+}
+
+QByteArray pattern(qsizetype size)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    for (qsizetype i = 0; i < size; ++i) {
+        data[i] = static_cast<char>((i * 131) >> 3);
+    }
+    return data;
+}
+
+} // namespace
+
+class TestTolerantRead : public QObject {
+    Q_OBJECT
+private slots:
+    void cleanReadMatchesPlainDigest();
+    void skipsBadAndStuckRangesAsZeros();
+    void failsWhenDeviceStopsResponding();
+};
+
+void TestTolerantRead::cleanReadMatchesPlainDigest()
+{
+    const QByteArray data = pattern(1000 * 1000);
+    RawDeviceHash::Options options;
+    options.bufferSizeKB = 256;
+    const HashResult result = RawDeviceHash::hashTolerant(
+        [data](char* out, size_t length, uint64_t offset) -> int64_t {
+            const uint64_t n = qMin<uint64_t>(length, static_cast<uint64_t>(data.size()) - offset);
+            std::memcpy(out, data.constData() + offset, n);
+            return static_cast<int64_t>(n);
+        },
+        options, static_cast<uint64_t>(data.size()));
+    QVERIFY2(result.success, qPrintable(result.errorMessage));
+    QVERIFY(result.unreadableRanges.isEmpty());
+    QCOMPARE(result.hash, QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex()));
+    QCOMPARE(result.bytesProcessed, static_cast<uint64_t>(data.size()));
+}
+
+void TestTolerantRead::skipsBadAndStuckRangesAsZeros()
+{
+    const QByteArray data = pattern(1024 * 1024);
+    RawDeviceHash::Options options;
+    options.bufferSizeKB = 256;
+    options.readTimeoutMs = RawDeviceHash::kMinReadTimeoutMs;
+    const HashResult result = RawDeviceHash::hashTolerant(flakyDevice(data, 1000), options,
+                                                          static_cast<uint64_t>(data.size()));
+    QVERIFY2(result.success, qPrintable(result.errorMessage));
+
+    // The failed 256 KiB read is narrowed to one 4 KiB sector; the stuck one is skipped whole.
+    QCOMPARE(result.unreadableRanges.size(), 2);
+    QCOMPARE(result.unreadableRanges[0].offset, 300 * kKiB);
+    QCOMPARE(result.unreadableRanges[0].length, 4 * kKiB);
+    QVERIFY(!result.unreadableRanges[0].timedOut);
+    QCOMPARE(result.unreadableRanges[1].offset, 512 * kKiB);
+    QCOMPARE(result.unreadableRanges[1].length, 256 * kKiB);
+    QVERIFY(result.unreadableRanges[1].timedOut);
+    QVERIFY(result.performance.readRetries > 0);
+
+    QByteArray expected = data;
+    for (const UnreadableRange& range : result.unreadableRanges) {
+        expected.replace(static_cast<qsizetype>(range.offset), static_cast<qsizetype>(range.length),
+                         QByteArray(static_cast<qsizetype>(range.length), '\0'));
+    }
+    QCOMPARE(result.hash,
+             QString::fromLatin1(QCryptographicHash::hash(expected, QCryptographicHash::Sha256).toHex()));
+}
+
+void TestTolerantRead::failsWhenDeviceStopsResponding()
+{
+    RawDeviceHash::Options options;
+    options.bufferSizeKB = 64;
+    options.readTimeoutMs = RawDeviceHash::kMinReadTimeoutMs;
+    const HashResult result = RawDeviceHash::hashTolerant(
+        [](char*, size_t, uint64_t) -> int64_t {
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            errno = EIO;
+            return -1;
+        },
+        options, 16 * 64 * kKiB);
+    QVERIFY(!result.success);
+    QVERIFY(result.errorMessage.contains(QStringLiteral("stopped responding")));
+    // Contiguous timed-out reads merge into one range.
+    QCOMPARE(result.unreadableRanges.size(), 1);
+    QCOMPARE(result.unreadableRanges[0].length,
+             static_cast<uint64_t>(RawDeviceHash::kMaxAbandonedReads) * 64 * kKiB);
+}
+
+QTEST_MAIN(TestTolerantRead)
+#include "test_tolerant_read.moc"
@@ -1,4 +1,5 @@
 #include <QtTest>
+#include <QTimeZone>
 #include "Types.h"
 
 using namespace FlashSpartan;
@@ -10,6 +11,9 @@ private slots:
     void partitionUniqueIdIncludesPartition();
     void legacyUniqueIdOmitsPartition();
     void deviceRecordJsonRoundTrip();
+    void parallelScanModeSharesFullCheckpoints();
+    void watchManifestKeepsFileMetadata();
+    void watchFileListRoundTripsAndSharesStorage();
 };
 
 void TestTypes::partitionUniqueIdIncludesPartition()
@@ -51,5 +55,91 @@ void TestTypes::deviceRecordJsonRoundTrip()
     QCOMPARE(restored.trustLevel, record.trustLevel);
 }
 
+void TestTypes::parallelScanModeSharesFullCheckpoints()
+{
+    QCOMPARE(hashScanModeFromString(hashScanModeToString(HashScanMode::ParallelFull)),
+             HashScanMode::ParallelFull);
+    QVERIFY(hashScanModeReadsAll(HashScanMode::Full));
+    QVERIFY(hashScanModeReadsAll(HashScanMode::ParallelFull));
+    QVERIFY(!hashScanModeReadsAll(HashScanMode::QuickSample));
+}
+
+void TestTypes::watchManifestKeepsFileMetadata()
+{
+    WatchFileEntry entry;
+    entry.relativePath = "docs/a.txt";
+    entry.contentHash = "aa";
+    entry.sizeBytes = 5000000000ULL;
+    entry.modifiedUtc = QDateTime::fromMSecsSinceEpoch(1700000000123LL, QTimeZone::utc());
+    entry.changedUtc = QDateTime::fromMSecsSinceEpoch(1700000000456LL, QTimeZone::utc());
+    entry.inode = 0xFFFFFFFFFFFFULL;
+    WatchFileEntry legacy;
+    legacy.relativePath = "docs/b.txt";
+    legacy.contentHash = "bb";
+
+    WatchGroup group;
+    group.id = "g";
+    group.files = {entry, legacy};
+    WatchManifest manifest;
+    manifest.groups = {group};
+
+    const WatchManifest restored = WatchManifest::fromJson(manifest.toJson());
+    const WatchFileEntry& a = restored.groups.first().files.at(0);
+    QCOMPARE(a.sizeBytes, entry.sizeBytes);
+    QCOMPARE(a.modifiedUtc, entry.modifiedUtc);
+    QCOMPARE(a.changedUtc, entry.changedUtc);
+    QCOMPARE(a.inode, entry.inode);
+    QVERIFY(!restored.groups.first().files.at(1).hasMetadata());
+}
+
+void TestTypes::watchFileListRoundTripsAndSharesStorage()
+{
+    WatchFileEntry hashed;
+    hashed.relativePath = "docs/sub/a.txt";
+    hashed.contentHash = QString(64, QLatin1Char('0')).replace(0, 4, "beef");
+    hashed.sizeBytes = 42;
+    hashed.modifiedUtc = QDateTime::fromMSecsSinceEpoch(1700000000123LL, QTimeZone::utc());
+    hashed.inode = 7;
+    hashed.chunks = {WatchChunk{0, 42, QString(64, QLatin1Char('c'))}};
+    WatchFileEntry sibling;
+    sibling.relativePath = "docs/sub/b.txt";
+    sibling.contentHash = "not-a-sha256";
+    WatchFileEntry topLevel;
+    topLevel.relativePath = "README";
+
+    WatchFileList list{hashed, sibling, topLevel};
+    QCOMPARE(list.size(), 3);
+    const WatchFileEntry a = list.at(0);
+    QCOMPARE(a.relativePath, hashed.relativePath);
+    QCOMPARE(a.contentHash, hashed.contentHash);
+    QCOMPARE(a.sizeBytes, hashed.sizeBytes);
+    QCOMPARE(a.modifiedUtc, hashed.modifiedUtc);
+    QVERIFY(!a.changedUtc.isValid());
+    QCOMPARE(a.inode, hashed.inode);
+    QCOMPARE(a.chunks.size(), 1);
+    QCOMPARE(a.chunks.first().hash, hashed.chunks.first().hash);
+    QCOMPARE(list.at(1).relativePath, sibling.relativePath);
+    QCOMPARE(list.at(1).contentHash, sibling.contentHash);
+    QCOMPARE(list.last().relativePath, topLevel.relativePath);
+    QVERIFY(list.last().contentHash.isEmpty());
+    QVERIFY(!list.last().hasMetadata());
+
+    // Copies share the storage until one of them changes.
+    WatchGroup group;
+    group.files = list;
+    const WatchGroup copy = group;
+    QVERIFY(copy.files.sharesStorageWith(list));
+    group.files.append(topLevel);
+    QVERIFY(!group.files.sharesStorageWith(list));
+    QCOMPARE(list.size(), 3);
+    QCOMPARE(group.files.size(), 4);
+
+    QStringList paths;
+    for (const WatchFileEntry& e : copy.files) {
+        paths.append(e.relativePath);
+    }
+    QCOMPARE(paths, QStringList({"docs/sub/a.txt", "docs/sub/b.txt", "README"}));
+}
+
 QTEST_MAIN(TestTypes)
 #include "test_types.moc"
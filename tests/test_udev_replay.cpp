@@ -0,0 +1,250 @@
+#include <QtTest>
+
+#include <QTemporaryDir>
+
+#include "BadUsbAnalyzer.h"
+#include "BadUsbRuleSet.h"
+#include "DeviceMonitor.h"
+#include "HidConnectCounter.h"
+#include "HidDeviceMonitor.h"
+#include "UdevEventTrace.h"
+
+#include <sys/sysmacros.h>
+
+using namespace FlashSpartan;
+
+namespace {
+
+constexpr const char* kUsbPath = "/sys/devices/pci0000:00/0000:00:14.0/usb1/1-2";
+constexpr const char* kHidUsbPath = "/sys/devices/pci0000:00/0000:00:14.0/usb1/1-3";
+
+UdevEventTrace::Event event(qint64 offsetMs, const char* source, UdevRecord device)
+{
+    UdevEventTrace::Event e;
+    e.offsetUs = offsetMs * 1000;
+    e.source = source;
+    e.device = std::move(device);
+    return e;
+}
+
+UdevRecord partition(const char* action)
+{
+    UdevRecord usb;
+    usb.sysPath = kUsbPath;
+    usb.sysName = "1-2";
+    usb.subsystem = "usb";
+    usb.devType = "usb_device";
+    usb.sysAttrs = {{"manufacturer", "SanDisk\n"}, {"product", "Cruzer Blade\n"},
+                    {"serial", "4C530001\n"}, {"busnum", "1\n"}, {"bDeviceClass", "00\n"}};
+
+    UdevRecord disk;
+    disk.sysPath = QByteArray(kUsbPath) + "/1-2:1.0/host6/target6:0:0/6:0:0:0/block/sdb";
+    disk.sysName = "sdb";
+    disk.devNode = "/dev/sdb";
+    disk.subsystem = "block";
+    disk.devType = "disk";
+
+    UdevRecord r;
+    r.action = action;
+    r.sysPath = disk.sysPath + "/sdb1";
+    r.sysName = "sdb1";
+    r.devNode = "/dev/sdb1";
+    r.subsystem = "block";
+    r.devType = "partition";
+    r.devnum = makedev(8, 17);
+    r.properties = {{"ID_BUS", "usb"}, {"ID_USB_DRIVER", "usb-storage"},
+                    {"ID_FS_TYPE", "vfat"}, {"ID_FS_LABEL", "STICK"}};
+    r.sysAttrs = {{"size", "15728640\n"}};
+    r.parents = {disk, usb};
+    return r;
+}
+
+UdevRecord mouse(const char* action)
+{
+    UdevRecord iface;
+    iface.sysPath = QByteArray(kHidUsbPath) + "/1-3:1.0";
+    iface.sysName = "1-3:1.0";
+    iface.subsystem = "usb";
+    iface.devType = "usb_interface";
+    iface.driver = "usbhid";
+    iface.sysAttrs = {{"bInterfaceNumber", "00\n"}, {"bInterfaceClass", "03\n"},
+                      {"bInterfaceSubClass", "01\n"}, {"bInterfaceProtocol", "02\n"}};
+
+    UdevRecord usb;
+    usb.sysPath = kHidUsbPath;
+    usb.sysName = "1-3";
+    usb.subsystem = "usb";
+    usb.devType = "usb_device";
+    usb.sysAttrs = {{"idVendor", "046D\n"}, {"idProduct", "C077\n"}, {"serial", "M1\n"},
+                    {"busnum", "1\n"}, {"devnum", "5\n"}, {"product", "USB Optical Mouse\n"}};
+    usb.descriptorFingerprint = QByteArray::fromHex("00112233445566778899aabbccddeeff");
+
+    UdevRecord r;
+    r.action = action;
+    r.sysPath = iface.sysPath + "/0003:046D:C077.0001/input/input9/event7";
+    r.sysName = "event7";
+    r.devNode = "/dev/input/event7";
+    r.subsystem = "input";
+    r.properties = {{"ID_INPUT", "1"}, {"ID_INPUT_MOUSE", "1"}};
+    r.parents = {iface, usb};
+    return r;
+}
+
+} // namespace
+
+class TestUdevReplay : public QObject {
+    Q_OBJECT
+
+private slots:
+    void roundTripsThroughFile();
+    void rejectsOtherFiles();
+    void replaysHidConnectAndRemove();
+    void debouncesPartitionBurst();
+    void flagsRapidReconnect();
+};
+
+void TestUdevReplay::roundTripsThroughFile()
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath(QStringLiteral("storm.jsonl"));
+    const QList<UdevEventTrace::Event> events = {event(0, "block", partition("add")),
+                                                 event(25, "input", mouse("add"))};
+    QString error;
+    QVERIFY2(UdevEventTrace::save(path, events, &error), qPrintable(error));
+
+    const QList<UdevEventTrace::Event> loaded = UdevEventTrace::load(path, &error);
+    QVERIFY2(error.isEmpty(), qPrintable(error));
+    QCOMPARE(loaded.size(), 2);
+    QCOMPARE(loaded.at(1).offsetUs, qint64(25000));
+    QCOMPARE(loaded.at(1).source, QByteArray("input"));
+    const UdevRecord& part = loaded.at(0).device;
+    QCOMPARE(part.devnum, quint64(makedev(8, 17)));
+    QCOMPARE(part.properties.value("ID_FS_LABEL"), QByteArray("STICK"));
+    QCOMPARE(part.sysAttrs.value("size"), QByteArray("15728640\n"));
+    QCOMPARE(part.parent("block", "disk")->devNode, QByteArray("/dev/sdb"));
+    QCOMPARE(UdevText::sysAttr(part.parent("usb", "usb_device"), "serial"), std::string_view("4C530001"));
+    QCOMPARE(loaded.at(1).device.parent("usb", "usb_device")->descriptorFingerprint,
+             events.at(1).device.parent("usb", "usb_device")->descriptorFingerprint);
+    QCOMPARE(loaded.at(1).device.parent("usb", "usb_interface")->driver, QByteArray("usbhid"));
+
+    // A recording cut off mid-line keeps the events before it.
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::Append));
+    file.write("{\"t_us\": 9");
+    file.close();
+    QCOMPARE(UdevEventTrace::load(path, &error).size(), 2);
+}
+
+void TestUdevReplay::rejectsOtherFiles()
+{
+    QTemporaryDir dir;
+    const QString path = dir.filePath(QStringLiteral("other.jsonl"));
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("{\"format\": \"something-else/1\"}\n");
+    file.close();
+
+    QString error;
+    QVERIFY(UdevEventTrace::load(path, &error).isEmpty());
+    QVERIFY(!error.isEmpty());
+}
+
+void TestUdevReplay::replaysHidConnectAndRemove()
+{
+    HidDeviceMonitor monitor;
+    QList<HidDeviceInfo> connected;
+    QStringList disconnected;
+    connect(&monitor, &HidDeviceMonitor::hidConnected, this, [&](const HidDeviceInfo& d) { connected.append(d); });
+    connect(&monitor, &HidDeviceMonitor::hidDisconnected, this, [&](const QString& id) { disconnected.append(id); });
+
+    UdevRecord unrelated = mouse("add");
+    unrelated.devNode = "/dev/input/mouse0";  // not an event node: filtered like a live one
+
+    const QList<UdevEventTrace::Event> events = {event(0, "input", unrelated),
+                                                 event(0, "input", mouse("add")),
+                                                 event(40, "input", mouse("remove"))};
+    const UdevEventTrace::ReplayStats stats =
+        UdevEventTrace::replay(events, 0, [&](const UdevEventTrace::Event& e) { monitor.replayEvent(e.device); });
+    QCOMPARE(stats.delivered, 3);
+
+    QCOMPARE(connected.size(), 1);
+    const HidDeviceInfo& info = connected.first();
+    QCOMPARE(info.vendorId, QStringLiteral("046d"));
+    QCOMPARE(info.productId, QStringLiteral("c077"));
+    QCOMPARE(info.usbPort, QStringLiteral("1-3"));
+    QCOMPARE(info.capabilities, QStringList{QStringLiteral("mouse")});
+    QCOMPARE(info.driver, QStringLiteral("usbhid"));
+    QCOMPARE(info.interfaces.first().interfaceProtocol, QStringLiteral("02"));
+    QCOMPARE(info.descriptorFingerprint, QByteArray::fromHex("00112233445566778899aabbccddeeff"));
+    QCOMPARE(disconnected, QStringList{info.stableId()});
+    QVERIFY(monitor.connectedDevices().isEmpty());
+}
+
+void TestUdevReplay::debouncesPartitionBurst()
+{
+    DeviceMonitor monitor;
+    QList<DeviceHandle> connected;
+    int changed = 0;
+    QStringList disconnected;
+    connect(&monitor, &DeviceMonitor::deviceConnected, this, [&](const DeviceHandle& d) { connected.append(d); });
+    connect(&monitor, &DeviceMonitor::deviceChanged, this, [&](const DeviceHandle&) { ++changed; });
+    connect(&monitor, &DeviceMonitor::deviceDisconnected, this, [&](const QString& node) { disconnected.append(node); });
+
+    // add/change/change within 20 ms, as a stick being partitioned and probed; remove 2 s later
+    const double speed = 10;
+    const QList<UdevEventTrace::Event> events = {event(0, "block", partition("add")),
+                                                 event(10, "block", partition("change")),
+                                                 event(20, "block", partition("change")),
+                                                 event(2000, "block", partition("remove"))};
+    const UdevEventTrace::ReplayStats stats = UdevEventTrace::replay(
+        events, speed, [&](const UdevEventTrace::Event& e) { monitor.replayEvent(e.device, speed); });
+    QCOMPARE(stats.delivered, 4);
+    QVERIFY(stats.wallNs >= 2000 * 1000000LL / qint64(speed));
+
+    QCOMPARE(connected.size(), 1);
+    QCOMPARE(changed, 0);
+    const DeviceHandle& device = connected.first();
+    QCOMPARE(device->deviceNode, QStringLiteral("/dev/sdb1"));
+    QCOMPARE(device->parentDevice, QStringLiteral("/dev/sdb"));
+    QCOMPARE(device->vendor, QStringLiteral("SanDisk"));
+    QCOMPARE(device->serial, QStringLiteral("4C530001"));
+    QCOMPARE(device->usbPortPath, QStringLiteral("1-2"));
+    QCOMPARE(device->label, QStringLiteral("STICK"));
+    QCOMPARE(device->sizeBytes, uint64_t(15728640) * 512);
+    QVERIFY(device->udevEventNs > 0);
+
+    QTRY_COMPARE(disconnected, QStringList{QStringLiteral("/dev/sdb1")});
+    QVERIFY(monitor.devices()->isEmpty());
+}
+
+void TestUdevReplay::flagsRapidReconnect()
+{
+    HidDeviceMonitor monitor;
+    const BadUsbRuleSet rules = BadUsbRuleSet::compile(BadUsbRuleSet::builtinRules(AppSettings()));
+    HidConnectCounter connects;
+    // Analyzed on the trace's clock, so the storm's pace holds at any replay speed
+    const qint64 startSecs = 1700000000;
+    qint64 nowSecs = startSecs;
+    QStringList verdicts;
+    connect(&monitor, &HidDeviceMonitor::hidConnected, this, [&](const HidDeviceInfo& device) {
+        connects.record(device.stableId(), nowSecs);
+        const BadUsbAnomalyResult result =
+            BadUsbAnalyzer::analyzeConnect(device, std::nullopt, {}, connects, nowSecs, rules);
+        verdicts.append(result.anomalous ? result.ruleId : QStringLiteral("-"));
+    });
+
+    QList<UdevEventTrace::Event> events;
+    for (int i = 0; i < 3; ++i) {
+        events.append(event(i * 3000, "input", mouse("add")));
+        events.append(event(i * 3000 + 500, "input", mouse("remove")));
+    }
+    UdevEventTrace::replay(events, UdevEventTrace::kMaxSpeed, [&](const UdevEventTrace::Event& e) {
+        nowSecs = startSecs + e.offsetUs / 1000000;
+        monitor.replayEvent(e.device);
+    });
+
+    QCOMPARE(verdicts, (QStringList{QStringLiteral("-"), QStringLiteral("-"), QStringLiteral("rapid-reconnect")}));
+}
+
+QTEST_MAIN(TestUdevReplay)
+#include "test_udev_replay.moc"
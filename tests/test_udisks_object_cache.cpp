@@ -0,0 +1,144 @@
+#include <QtTest>
+
+#include <QByteArrayList>
+
+#include "UDisksObjectCache.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+const QString kBlock = QStringLiteral("/org/freedesktop/UDisks2/block_devices/sdb1");
+const QString kDrive = QStringLiteral("/org/freedesktop/UDisks2/drives/SanDisk_Cruzer_1234");
+const QString kLoop = QStringLiteral("/org/freedesktop/UDisks2/block_devices/loop0");
+const QString kManager = QStringLiteral("/org/freedesktop/UDisks2/Manager");
+
+QByteArray bytes(const char* s)
+{
+    return QByteArray(s, int(qstrlen(s)) + 1);  // UDisks2 sends them NUL-terminated
+}
+
+UDisksObjectCache::Interfaces stick()
+{
+    UDisksObjectCache::Interfaces interfaces;
+    interfaces.insert(UDisksObjectCache::kBlockInterface,
+                      {{"Device", bytes("/dev/sdb1")},
+                       {"PreferredDevice", bytes("/dev/sdb1")},
+                       {"Symlinks", QVariant::fromValue(QByteArrayList{bytes("/dev/disk/by-id/usb-SanDisk-part1"),
+                                                                      bytes("/dev/disk/by-label/STICK")})},
+                       {"IdType", QStringLiteral("vfat")},
+                       {"Drive", kDrive}});
+    interfaces.insert(UDisksObjectCache::kFilesystemInterface,
+                      {{"MountPoints", QVariant::fromValue(QByteArrayList{bytes("/media/user/STICK")})}});
+    return interfaces;
+}
+
+QHash<QString, UDisksObjectCache::Interfaces> tree()
+{
+    QHash<QString, UDisksObjectCache::Interfaces> objects;
+    objects.insert(kBlock, stick());
+    objects.insert(kDrive, {{UDisksObjectCache::kDriveInterface, {{"Vendor", QStringLiteral("SanDisk")}}}});
+    objects.insert(kLoop, {{UDisksObjectCache::kBlockInterface, {{"Device", bytes("/dev/loop0")}, {"Drive", "/"}}},
+                           {UDisksObjectCache::kLoopInterface, {}}});
+    objects.insert(kManager, {{UDisksObjectCache::kManagerInterface, {{"Version", QStringLiteral("2.10.1")}}}});
+    return objects;
+}
+
+} // namespace
+
+class TestUDisksObjectCache : public QObject {
+    Q_OBJECT
+
+private slots:
+    void resolvesDevicesAndSymlinks();
+    void servesPropertiesLocally();
+    void followsPropertyChanges();
+    void followsInterfaceChanges();
+    void clearForgetsEverything();
+};
+
+void TestUDisksObjectCache::resolvesDevicesAndSymlinks()
+{
+    UDisksObjectCache cache;
+    QVERIFY(!cache.isLoaded());
+    cache.reset(tree());
+    QVERIFY(cache.isLoaded());
+    QCOMPARE(cache.blockObjectPath(QStringLiteral("/dev/sdb1")), kBlock);
+    QCOMPARE(cache.blockObjectPath(QStringLiteral("/dev/disk/by-id/usb-SanDisk-part1")), kBlock);
+    QCOMPARE(cache.blockObjectPath(QStringLiteral("/dev/disk/by-label/STICK")), kBlock);
+    QVERIFY(cache.blockObjectPath(QStringLiteral("/dev/sdc1")).isEmpty());
+}
+
+void TestUDisksObjectCache::servesPropertiesLocally()
+{
+    UDisksObjectCache cache;
+    cache.reset(tree());
+    QCOMPARE(cache.filesystemType(QStringLiteral("/dev/sdb1")), QStringLiteral("vfat"));
+    QCOMPARE(cache.driveObjectPath(QStringLiteral("/dev/sdb1")), kDrive);
+    QVERIFY(cache.driveObjectPath(QStringLiteral("/dev/loop0")).isEmpty());  // "/" is no drive
+    QCOMPARE(cache.mountPoints(QStringLiteral("/dev/sdb1")), QStringList{QStringLiteral("/media/user/STICK")});
+    QVERIFY(cache.hasFilesystem(QStringLiteral("/dev/sdb1")));
+    QVERIFY(!cache.hasFilesystem(QStringLiteral("/dev/loop0")));
+    QVERIFY(cache.isLoop(QStringLiteral("/dev/loop0")));
+    QVERIFY(!cache.isLoop(QStringLiteral("/dev/sdb1")));
+    QVERIFY(cache.hasInterface(kDrive, UDisksObjectCache::kDriveInterface));
+    QCOMPARE(cache.version(), QStringLiteral("2.10.1"));
+}
+
+void TestUDisksObjectCache::followsPropertyChanges()
+{
+    UDisksObjectCache cache;
+    cache.reset(tree());
+
+    cache.changeProperties(kBlock, UDisksObjectCache::kFilesystemInterface,
+                           {{"MountPoints", QVariant::fromValue(QByteArrayList{})}}, {});
+    QVERIFY(cache.mountPoints(QStringLiteral("/dev/sdb1")).isEmpty());
+
+    // A changed Device or symlink set moves the index with it.
+    cache.changeProperties(kBlock, UDisksObjectCache::kBlockInterface,
+                           {{"Device", bytes("/dev/sdc1")}, {"PreferredDevice", bytes("/dev/sdc1")}},
+                           {QStringLiteral("Symlinks")});
+    QCOMPARE(cache.blockObjectPath(QStringLiteral("/dev/sdc1")), kBlock);
+    QVERIFY(cache.blockObjectPath(QStringLiteral("/dev/sdb1")).isEmpty());
+    QVERIFY(cache.blockObjectPath(QStringLiteral("/dev/disk/by-label/STICK")).isEmpty());
+
+    // Changes to an interface the object does not have yet are dropped.
+    cache.changeProperties(kLoop, UDisksObjectCache::kFilesystemInterface, {{"MountPoints", {}}}, {});
+    QVERIFY(!cache.hasFilesystem(QStringLiteral("/dev/loop0")));
+}
+
+void TestUDisksObjectCache::followsInterfaceChanges()
+{
+    UDisksObjectCache cache;
+    cache.reset(tree());
+
+    cache.removeInterfaces(kBlock, {UDisksObjectCache::kFilesystemInterface});
+    QVERIFY(!cache.hasFilesystem(QStringLiteral("/dev/sdb1")));
+    QCOMPARE(cache.blockObjectPath(QStringLiteral("/dev/sdb1")), kBlock);
+
+    cache.addInterfaces(kBlock, {{UDisksObjectCache::kFilesystemInterface, {}}});
+    QVERIFY(cache.hasFilesystem(QStringLiteral("/dev/sdb1")));
+    QCOMPARE(cache.filesystemType(QStringLiteral("/dev/sdb1")), QStringLiteral("vfat"));
+
+    // The whole object leaves when its last interface does.
+    cache.removeInterfaces(kBlock, {UDisksObjectCache::kBlockInterface, UDisksObjectCache::kFilesystemInterface});
+    QVERIFY(cache.blockObjectPath(QStringLiteral("/dev/sdb1")).isEmpty());
+    QVERIFY(cache.blockObjectPath(QStringLiteral("/dev/disk/by-id/usb-SanDisk-part1")).isEmpty());
+
+    const QString added = QStringLiteral("/org/freedesktop/UDisks2/block_devices/sdd");
+    cache.addInterfaces(added, {{UDisksObjectCache::kBlockInterface, {{"Device", bytes("/dev/sdd")}}}});
+    QCOMPARE(cache.blockObjectPath(QStringLiteral("/dev/sdd")), added);
+}
+
+void TestUDisksObjectCache::clearForgetsEverything()
+{
+    UDisksObjectCache cache;
+    cache.reset(tree());
+    cache.clear();
+    QVERIFY(!cache.isLoaded());
+    QVERIFY(cache.blockObjectPath(QStringLiteral("/dev/sdb1")).isEmpty());
+    QVERIFY(cache.version().isEmpty());
+}
+
+QTEST_MAIN(TestUDisksObjectCache)
+#include "test_udisks_object_cache.moc"
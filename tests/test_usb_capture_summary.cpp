@@ -0,0 +1,215 @@
+#include <QtTest>
+
+#include <QBuffer>
+#include <QtEndian>
+
+#include <cstring>
+
+#include "UsbCaptureSummary.h"
+#include "UsbmonRing.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+/** A LINKTYPE_USB_LINUX_MMAPPED frame. */
+QByteArray usbmonFrame(char type, quint16 bus, quint8 dev, quint8 xferType, quint8 endpoint, const QByteArray& data)
+{
+    QByteArray e(int(UsbmonRing::kHeaderBytes), '\0');
+    char* h = e.data();
+    h[8] = type;
+    h[9] = char(xferType);
+    h[10] = char(endpoint);
+    h[11] = char(dev);
+    std::memcpy(h + 12, &bus, 2);
+    const quint32 cap = quint32(data.size());
+    std::memcpy(h + 32, &cap, 4);
+    std::memcpy(h + 36, &cap, 4);
+    e.append(data);
+    return e;
+}
+
+/** A LINKTYPE_USBPCAP interrupt completion. */
+QByteArray usbPcapFrame(quint16 bus, quint16 dev, quint8 endpoint, const QByteArray& data)
+{
+    QByteArray e(27, '\0');
+    char* h = e.data();
+    qToLittleEndian<quint16>(27, h);
+    h[16] = 1;  // PDO -> FDO: completion
+    qToLittleEndian<quint16>(bus, h + 17);
+    qToLittleEndian<quint16>(dev, h + 19);
+    h[21] = char(endpoint);
+    h[22] = 1;  // interrupt
+    qToLittleEndian<quint32>(quint32(data.size()), h + 23);
+    e.append(data);
+    return e;
+}
+
+QByteArray keyReport(quint8 modifiers, quint8 usage)
+{
+    const char r[8] = {char(modifiers), 0, char(usage), 0, 0, 0, 0, 0};
+    return QByteArray(r, 8);
+}
+
+void appendLe32(QByteArray* out, quint32 value)
+{
+    char b[4];
+    qToLittleEndian(value, b);
+    out->append(b, 4);
+}
+
+} // namespace
+
+class TestUsbCaptureSummary : public QObject {
+    Q_OBJECT
+
+private slots:
+    void summarizesNativePcapng();
+    void flagsInjectedTypingInUsbPcap();
+    void reportsForeignAndTruncatedFiles();
+    void namesKeys();
+};
+
+void TestUsbCaptureSummary::summarizesNativePcapng()
+{
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::ReadWrite));
+    PcapngWriter writer(&buffer);
+    QVERIFY(writer.writeSectionHeader(QStringLiteral("test")));
+    QVERIFY(writer.writeInterface(UsbmonRing::kLinkType, QStringLiteral("usbmon3")));
+
+    qint64 t = 1700000000LL * 1000000;
+    auto write = [&](const QByteArray& frame) {
+        QVERIFY(writer.writePacket(0, t, frame, quint32(frame.size())));
+        t += 150000;
+    };
+    write(usbmonFrame('S', 3, 5, 2, 0x80, QByteArray(8, '\0')));  // GET_DESCRIPTOR
+    const QList<QPair<quint8, quint8>> keys = {{0x08, 0x15}, {0x02, 0x0B}, {0, 0x0C}, {0x02, 0x1E}, {0, 0x28}};
+    for (const auto& [modifiers, usage] : keys) {
+        write(usbmonFrame('C', 3, 5, 1, 0x81, keyReport(modifiers, usage)));
+        write(usbmonFrame('C', 3, 5, 1, 0x81, keyReport(0, 0)));
+    }
+    write(usbmonFrame('S', 3, 9, 3, 0x02, QByteArray(512, 'x')));
+
+    buffer.seek(0);
+    const UsbCaptureSummary summary = UsbCaptureSummary::summarize(&buffer);
+    QVERIFY2(summary.isValid(), qPrintable(summary.error));
+    QCOMPARE(summary.format, QStringLiteral("pcapng"));
+    QCOMPARE(summary.linkType, UsbmonRing::kLinkType);
+    QCOMPARE(summary.packets, quint64(12));
+    QCOMPARE(summary.lastUs - summary.firstUs, qint64(11) * 150000);
+
+    QCOMPARE(summary.endpoints.size(), 3);
+    QCOMPARE(summary.endpoints.at(1).endpoint, quint8(0x81));
+    QCOMPARE(summary.endpoints.at(1).packets, quint64(10));
+    QCOMPARE(summary.endpoints.at(2).device, quint8(9));
+    QCOMPARE(summary.endpoints.at(2).bytes, quint64(512));
+
+    QCOMPARE(summary.keyboards.size(), 1);
+    const UsbCaptureSummary::Keyboard& keyboard = summary.keyboards.first();
+    QCOMPARE(keyboard.device, quint8(5));
+    QCOMPARE(keyboard.keyDowns, 5);
+    QCOMPARE(keyboard.typed, QStringLiteral("[GUI+r]Hi![Enter]"));
+    QCOMPARE(keyboard.fastestIntervalUs, qint64(300000));
+    QVERIFY(!keyboard.superhuman);
+
+    QVERIFY(summary.headline().contains(QStringLiteral("5 keys typed")));
+    QVERIFY(summary.text().contains(QStringLiteral("typed: [GUI+r]Hi![Enter]")));
+    QCOMPARE(summary.toJson().value(QStringLiteral("keyboards")).toArray().size(), 1);
+    QCOMPARE(summary.contentDigest.size(), 32);
+}
+
+void TestUsbCaptureSummary::flagsInjectedTypingInUsbPcap()
+{
+    // Classic pcap, the way USBPcapCMD writes it.
+    auto capture = [](quint16 device, qint64 start) {
+        QByteArray file;
+        appendLe32(&file, 0xA1B2C3D4);
+        file.append("\x02\x00\x04\x00", 4);
+        appendLe32(&file, 0);
+        appendLe32(&file, 0);
+        appendLe32(&file, 65535);
+        appendLe32(&file, 249);
+        for (int i = 0; i < 40; ++i) {
+            for (const QByteArray& report : {keyReport(0, quint8(0x04 + i % 26)), keyReport(0, 0)}) {
+                const qint64 ts = start + i * 8000 + (report.at(2) ? 0 : 4000);
+                const QByteArray frame = usbPcapFrame(1, device, 0x81, report);
+                appendLe32(&file, quint32(ts / 1000000));
+                appendLe32(&file, quint32(ts % 1000000));
+                appendLe32(&file, quint32(frame.size()));
+                appendLe32(&file, quint32(frame.size()));
+                file.append(frame);
+            }
+        }
+        return file;
+    };
+    QByteArray file = capture(4, 1700000000LL * 1000000);
+
+    QBuffer buffer(&file);
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    const UsbCaptureSummary summary = UsbCaptureSummary::summarize(&buffer);
+    QVERIFY2(summary.isValid(), qPrintable(summary.error));
+    QCOMPARE(summary.format, QStringLiteral("pcap"));
+    QCOMPARE(summary.packets, quint64(80));
+    QCOMPARE(summary.keyboards.size(), 1);
+    const UsbCaptureSummary::Keyboard& keyboard = summary.keyboards.first();
+    QCOMPARE(keyboard.bus, quint16(1));
+    QCOMPARE(keyboard.device, quint8(4));
+    QCOMPARE(keyboard.keyDowns, 40);
+    QVERIFY(keyboard.typed.startsWith(QStringLiteral("abcdefghijklmnopqrstuvwxyzabc")));
+    QCOMPARE(keyboard.fastestIntervalUs, qint64(8000));
+    QVERIFY(keyboard.superhuman);
+    QVERIFY(keyboard.keysPerSecond() > 100.0);
+
+    // The same traffic later, at another address, is the same content.
+    QByteArray again = capture(9, 1700003600LL * 1000000);
+    QBuffer other(&again);
+    QVERIFY(other.open(QIODevice::ReadOnly));
+    const UsbCaptureSummary later = UsbCaptureSummary::summarize(&other);
+    QCOMPARE(later.keyboards.first().device, quint8(9));
+    QCOMPARE(later.contentDigest, summary.contentDigest);
+}
+
+void TestUsbCaptureSummary::reportsForeignAndTruncatedFiles()
+{
+    QByteArray garbage("not a capture at all");
+    QBuffer foreign(&garbage);
+    QVERIFY(foreign.open(QIODevice::ReadOnly));
+    QVERIFY(!UsbCaptureSummary::summarize(&foreign).isValid());
+
+    QVERIFY(!UsbCaptureSummary::summarize(QStringLiteral("/nonexistent/capture.pcap")).isValid());
+
+    // A capture cut off mid-record keeps what came before.
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::ReadWrite));
+    PcapngWriter writer(&buffer);
+    QVERIFY(writer.writeSectionHeader());
+    QVERIFY(writer.writeInterface(UsbmonRing::kLinkType, QStringLiteral("usbmon1")));
+    const QByteArray frame = usbmonFrame('C', 1, 2, 1, 0x81, keyReport(0, 0x04));
+    QVERIFY(writer.writePacket(0, 1000, frame, quint32(frame.size())));
+    QVERIFY(writer.writePacket(0, 2000, frame, quint32(frame.size())));
+    QByteArray data = buffer.data();
+    data.chop(10);
+    QBuffer cut(&data);
+    QVERIFY(cut.open(QIODevice::ReadOnly));
+    const UsbCaptureSummary summary = UsbCaptureSummary::summarize(&cut);
+    QVERIFY(!summary.isValid());
+    QCOMPARE(summary.packets, quint64(1));
+    QCOMPARE(summary.keyboards.size(), 1);
+}
+
+void TestUsbCaptureSummary::namesKeys()
+{
+    QCOMPARE(UsbCaptureSummary::keyText(0x04, 0), QStringLiteral("a"));
+    QCOMPARE(UsbCaptureSummary::keyText(0x04, 0x20), QStringLiteral("A"));
+    QCOMPARE(UsbCaptureSummary::keyText(0x27, 0), QStringLiteral("0"));
+    QCOMPARE(UsbCaptureSummary::keyText(0x38, 0x02), QStringLiteral("?"));
+    QCOMPARE(UsbCaptureSummary::keyText(0x2C, 0), QStringLiteral(" "));
+    QCOMPARE(UsbCaptureSummary::keyText(0x06, 0x01), QStringLiteral("[Ctrl+c]"));
+    QCOMPARE(UsbCaptureSummary::keyText(0x29, 0x05), QStringLiteral("[Ctrl+Alt+Esc]"));
+    QCOMPARE(UsbCaptureSummary::keyText(0x3A, 0), QStringLiteral("[F1]"));
+    QCOMPARE(UsbCaptureSummary::keyText(0x00, 0x02), QString());
+}
+
+QTEST_MAIN(TestUsbCaptureSummary)
+#include "test_usb_capture_summary.moc"
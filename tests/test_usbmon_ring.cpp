@@ -0,0 +1,248 @@
+#include <QtTest>
+
+#include <QBuffer>
+#include <QtEndian>
+
+#include <cstring>
+
+#include "UsbmonRing.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+/** A mon_bin event as the kernel lays it out in the mmap ring. */
+QByteArray event(char type, quint16 bus, quint8 dev, qint64 sec, qint32 usec, const QByteArray& data,
+                 quint32 lenUrb = 0, quint32 ndesc = 0, quint8 xferType = 1, quint8 endpoint = 0x81)
+{
+    QByteArray e(int(UsbmonRing::kHeaderBytes), '\0');
+    char* h = e.data();
+    h[8] = type;
+    h[9] = char(xferType);
+    h[10] = char(endpoint);
+    h[11] = char(dev);
+    std::memcpy(h + 12, &bus, 2);
+    std::memcpy(h + 16, &sec, 8);
+    std::memcpy(h + 24, &usec, 4);
+    const quint32 urb = lenUrb ? lenUrb : quint32(data.size());
+    const quint32 cap = quint32(data.size());
+    std::memcpy(h + 32, &urb, 4);
+    std::memcpy(h + 36, &cap, 4);
+    std::memcpy(h + 60, &ndesc, 4);
+    e.append(QByteArray(int(ndesc * UsbmonRing::kIsoDescriptorBytes), '\0'));
+    e.append(data);
+    return e;
+}
+
+UsbmonPacket packet(quint16 bus, qint64 timestampUs, int bytes = 8)
+{
+    UsbmonPacket p;
+    p.bus = bus;
+    p.timestampUs = timestampUs;
+    p.frame = QByteArray(bytes, 'x');
+    return p;
+}
+
+quint32 le32(const QByteArray& data, int offset)
+{
+    return qFromLittleEndian<quint32>(data.constData() + offset);
+}
+
+} // namespace
+
+class TestUsbmonRing : public QObject {
+    Q_OBJECT
+
+private slots:
+    void parsesEvents();
+    void rejectsFillerAndTruncatedEvents();
+    void evictsByAgeAndBytes();
+    void shrinksOldestFirstAcrossBuses();
+    void selectsByBusAndSequence();
+    void filtersByDeviceAndTransfer();
+    void writesPcapngBlocks();
+};
+
+void TestUsbmonRing::parsesEvents()
+{
+    const QByteArray keystroke("\x02\x00\x04\x00\x00\x00\x00\x00", 8);
+    const QByteArray raw = event('C', 3, 7, 1700000000, 250000, keystroke) + QByteArray(64, '?');
+    UsbmonPacket p;
+    QVERIFY(UsbmonRing::parseEvent(raw.constData(), size_t(raw.size()), &p));
+    QCOMPARE(p.bus, quint16(3));
+    QCOMPARE(p.device, quint8(7));
+    QCOMPARE(p.eventType, 'C');
+    QCOMPARE(p.transferType, quint8(1));
+    QCOMPARE(p.endpoint, quint8(0x81));
+    QCOMPARE(p.status, 0);
+    QCOMPARE(p.timestampUs, qint64(1700000000) * 1000000 + 250000);
+    QCOMPARE(p.frame.size(), 64 + 8);  // stops at the event, not at the end of the ring
+    QCOMPARE(p.frame.mid(64), keystroke);
+    QCOMPARE(p.originalLength, 64u + 8u);
+
+    // Truncated capture and isochronous descriptors.
+    const QByteArray iso = event('C', 1, 2, 1, 0, QByteArray(4, 'd'), 512, 2);
+    QVERIFY(UsbmonRing::parseEvent(iso.constData(), size_t(iso.size()), &p));
+    QCOMPARE(p.frame.size(), 64 + 32 + 4);
+    QCOMPARE(p.originalLength, 64u + 32u + 512u);
+}
+
+void TestUsbmonRing::rejectsFillerAndTruncatedEvents()
+{
+    UsbmonPacket p;
+    const QByteArray filler = event('@', 1, 0, 0, 0, QByteArray(16, '\0'));
+    QVERIFY(!UsbmonRing::parseEvent(filler.constData(), size_t(filler.size()), &p));
+
+    const QByteArray full = event('S', 1, 2, 0, 0, QByteArray(32, 'a'));
+    QVERIFY(!UsbmonRing::parseEvent(full.constData(), size_t(full.size() - 1), &p));
+    QVERIFY(!UsbmonRing::parseEvent(full.constData(), 10, &p));
+}
+
+void TestUsbmonRing::evictsByAgeAndBytes()
+{
+    UsbmonRing ring(1000000, 995);
+    ring.append(packet(1, 0));
+    ring.append(packet(1, 500000));
+    ring.append(packet(1, 1400000));  // the first is now older than a second
+    QList<UsbmonPacket> kept = ring.packets(1, 0);
+    QCOMPARE(kept.size(), 2);
+    QCOMPARE(kept.first().timestampUs, qint64(500000));
+    QCOMPARE(ring.bytes(1), qint64(16));
+
+    ring.append(packet(1, 1700000, 990));
+    kept = ring.packets(1, 0);
+    QCOMPARE(kept.size(), 1);  // byte limit: only the newest fits
+    QCOMPARE(ring.bytes(1), qint64(990));
+}
+
+void TestUsbmonRing::shrinksOldestFirstAcrossBuses()
+{
+    UsbmonRing ring(10000000, 1 << 20);
+    ring.append(packet(1, 0, 100));
+    ring.append(packet(2, 1000, 100));
+    ring.append(packet(1, 2000, 100));
+    ring.append(packet(2, 3000, 100));
+    QCOMPARE(ring.totalBytes(), qint64(400));
+
+    ring.shrinkTo(250);
+    QCOMPARE(ring.totalBytes(), qint64(200));
+    QCOMPARE(ring.packets(1, 0).first().timestampUs, qint64(2000));
+    QCOMPARE(ring.packets(2, 0).first().timestampUs, qint64(3000));
+
+    ring.shrinkTo(0);
+    QCOMPARE(ring.totalBytes(), qint64(0));
+    QVERIFY(ring.packets(0, 0).isEmpty());
+}
+
+void TestUsbmonRing::selectsByBusAndSequence()
+{
+    UsbmonRing ring(60000000, 1 << 20);
+    ring.append(packet(1, 100));
+    ring.append(packet(2, 200));
+    ring.append(packet(1, 300));
+    ring.append(packet(2, 400));
+
+    const QList<UsbmonPacket> bus1 = ring.packets(1, 0);
+    QCOMPARE(bus1.size(), 2);
+    QCOMPARE(bus1.at(1).timestampUs, qint64(300));
+    QCOMPARE(ring.packets(1, 200).size(), 1);
+
+    const QList<UsbmonPacket> all = ring.packets(0, 0);
+    QCOMPARE(all.size(), 4);
+    for (int i = 1; i < all.size(); ++i) {
+        QVERIFY(all.at(i - 1).sequence < all.at(i).sequence);
+    }
+
+    const quint64 seen = all.at(1).sequence;
+    ring.append(packet(2, 500));
+    const QList<UsbmonPacket> fresh = ring.packets(2, 0, seen);
+    QCOMPARE(fresh.size(), 2);
+    QCOMPARE(fresh.last().timestampUs, qint64(500));
+
+    ring.clear();
+    QVERIFY(ring.packets(0, 0).isEmpty());
+}
+
+void TestUsbmonRing::filtersByDeviceAndTransfer()
+{
+    const UsbmonFilter all;
+    QVERIFY(all.acceptsEverything());
+    QVERIFY(all.matches(4, 9, 0x02, UsbmonFilter::kTransferBulk));
+
+    // A dock: disk bulk traffic on address 5, a keyboard (interrupt) on 6, the suspect on 7.
+    const UsbmonFilter ring = UsbmonFilter::enumerationAndHid({{2, 7, UsbmonFilter::kAllEndpoints}});
+    QVERIFY(!ring.acceptsEverything());
+    QVERIFY(!ring.matches(2, 5, 0x81, UsbmonFilter::kTransferBulk));
+    QVERIFY(!ring.matches(2, 5, 0x82, UsbmonFilter::kTransferIso));
+    QVERIFY(ring.matches(2, 6, 0x81, UsbmonFilter::kTransferInterrupt));
+    QVERIFY(ring.matches(2, 0, 0x80, UsbmonFilter::kTransferControl));  // enumeration
+    QVERIFY(ring.matches(2, 7, 0x02, UsbmonFilter::kTransferBulk));
+    QVERIFY(!ring.matches(3, 7, 0x02, UsbmonFilter::kTransferBulk));  // same address, other bus
+
+    UsbmonFilter endpoints;
+    endpoints.otherTransfers = 0;
+    endpoints.devices = {{0, 7, UsbmonFilter::endpointBit(0x81) | UsbmonFilter::endpointBit(0x00)}};
+    QVERIFY(endpoints.matches(1, 7, 0x81, UsbmonFilter::kTransferInterrupt));
+    QVERIFY(endpoints.matches(1, 7, 0x00, UsbmonFilter::kTransferControl));
+    QVERIFY(!endpoints.matches(1, 7, 0x01, UsbmonFilter::kTransferInterrupt));  // OUT, not IN
+    QVERIFY(!endpoints.matches(1, 7, 0x82, UsbmonFilter::kTransferBulk));
+
+    const UsbmonFilter dump = UsbmonFilter::singleDevice(2, 7);
+    QVERIFY(dump.matches(2, 7, 0x83, UsbmonFilter::kTransferBulk));
+    QVERIFY(dump.matches(2, 0, 0x80, UsbmonFilter::kTransferControl));
+    QVERIFY(!dump.matches(2, 6, 0x81, UsbmonFilter::kTransferInterrupt));
+    QVERIFY(!dump.matches(1, 7, 0x81, UsbmonFilter::kTransferInterrupt));
+
+    // The raw header and the parsed packet give the same answer.
+    const QByteArray bulk = event('C', 2, 5, 0, 0, QByteArray(512, 'b'), 0, 0, UsbmonFilter::kTransferBulk, 0x81);
+    const QByteArray hid = event('C', 2, 6, 0, 0, QByteArray(8, '\0'));
+    QVERIFY(!ring.matchesEvent(bulk.constData(), size_t(bulk.size())));
+    QVERIFY(ring.matchesEvent(hid.constData(), size_t(hid.size())));
+    QVERIFY(!ring.matchesEvent(hid.constData(), 10));
+    UsbmonPacket p;
+    QVERIFY(UsbmonRing::parseEvent(bulk.constData(), size_t(bulk.size()), &p));
+    QVERIFY(!ring.matches(p));
+    QVERIFY(UsbmonRing::parseEvent(hid.constData(), size_t(hid.size()), &p));
+    QVERIFY(ring.matches(p));
+}
+
+void TestUsbmonRing::writesPcapngBlocks()
+{
+    QBuffer buffer;
+    buffer.open(QIODevice::WriteOnly);
+    PcapngWriter writer(&buffer);
+    QVERIFY(writer.writeSectionHeader(QStringLiteral("new-keyboard: test")));
+    QVERIFY(writer.writeInterface(UsbmonRing::kLinkType, QStringLiteral("usbmon3")));
+    const QByteArray frame(71, 'f');
+    const qint64 ts = qint64(1700000000) * 1000000 + 5;
+    QVERIFY(writer.writePacket(0, ts, frame, 200));
+    const QByteArray out = buffer.data();
+
+    int offset = 0;
+    QList<quint32> types;
+    while (offset < out.size()) {
+        const quint32 type = le32(out, offset);
+        const quint32 length = le32(out, offset + 4);
+        QCOMPARE(length % 4, 0u);
+        QVERIFY(offset + int(length) <= out.size());
+        QCOMPARE(le32(out, offset + int(length) - 4), length);  // trailing length repeats
+        if (type == 6) {
+            QCOMPARE(le32(out, offset + 8), 0u);
+            const quint64 stamp = (quint64(le32(out, offset + 12)) << 32) | le32(out, offset + 16);
+            QCOMPARE(qint64(stamp), ts);
+            QCOMPARE(le32(out, offset + 20), 71u);
+            QCOMPARE(le32(out, offset + 24), 200u);
+            QCOMPARE(out.mid(offset + 28, 71), frame);
+        } else if (type == 1) {
+            QCOMPARE(qFromLittleEndian<quint16>(out.constData() + offset + 8), quint16(220));
+        }
+        types.append(type);
+        offset += int(length);
+    }
+    QCOMPARE(types, (QList<quint32>{0x0A0D0D0A, 1, 6}));
+    QCOMPARE(le32(out, 8), 0x1A2B3C4Du);
+    QVERIFY(out.contains("new-keyboard: test"));
+}
+
+QTEST_MAIN(TestUsbmonRing)
+#include "test_usbmon_ring.moc"
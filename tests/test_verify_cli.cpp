@@ -0,0 +1,286 @@
+#include <QtTest>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QProcess>
+#include <QTemporaryDir>
+
+#include "VerifyCli.h"
+
+using namespace FlashSpartan;
+
+class TestVerifyCli : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void rejectsBadJobsAndPorts();
+    void hashDeviceRejectsBadArguments_data();
+    void hashDeviceRejectsBadArguments();
+    void hashDeviceReportsEachFailedDevice();
+    void buildManifestRejectsBadArguments();
+    void buildThenVerifyWatch();
+    void verifyWatchRejectsBadArguments();
+    void missingInputsAreAnError();
+
+private:
+    struct Run {
+        int exitCode = -1;
+        QList<QJsonObject> lines;
+        QByteArray stderrText;
+    };
+    Run run(const QStringList& args);
+
+    QTemporaryDir m_home;
+};
+
+namespace {
+
+QString verifyBinary()
+{
+#ifdef FLASHSPARTAN_VERIFY_PATH
+    return QStringLiteral(FLASHSPARTAN_VERIFY_PATH);
+#else
+    return QString();
+#endif
+}
+
+QList<QJsonObject> linesOfType(const QList<QJsonObject>& lines, const QString& type)
+{
+    QList<QJsonObject> out;
+    for (const QJsonObject& line : lines) {
+        if (line.value(QStringLiteral("type")).toString() == type) {
+            out.append(line);
+        }
+    }
+    return out;
+}
+
+bool writeFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+/** A build spec with one group watching @p watchPath. */
+QByteArray specWatching(const QString& watchPath)
+{
+    QJsonObject group;
+    group.insert(QStringLiteral("id"), QStringLiteral("docs"));
+    group.insert(QStringLiteral("name"), QStringLiteral("Docs"));
+    group.insert(QStringLiteral("watch_paths"), QJsonArray{watchPath});
+    QJsonObject spec;
+    spec.insert(QStringLiteral("version"), QStringLiteral("1.0"));
+    spec.insert(QStringLiteral("groups"), QJsonArray{group});
+    return QJsonDocument(spec).toJson(QJsonDocument::Compact);
+}
+
+} // namespace
+
+void TestVerifyCli::initTestCase()
+{
+    if (!QFileInfo(verifyBinary()).isExecutable()) {
+        QSKIP("flashspartan-verify was not built alongside this test");
+    }
+    QVERIFY(m_home.isValid());
+}
+
+TestVerifyCli::Run TestVerifyCli::run(const QStringList& args)
+{
+    // Checkpoints, catalog and settings land in a scratch home, never the user's.
+    QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+    env.insert(QStringLiteral("HOME"), m_home.path());
+    env.insert(QStringLiteral("XDG_CONFIG_HOME"), m_home.filePath(QStringLiteral("config")));
+    env.insert(QStringLiteral("XDG_DATA_HOME"), m_home.filePath(QStringLiteral("data")));
+    env.insert(QStringLiteral("XDG_CACHE_HOME"), m_home.filePath(QStringLiteral("cache")));
+
+    QProcess p;
+    p.setProcessEnvironment(env);
+    p.start(verifyBinary(), QStringList{QStringLiteral("--progress-interval"), QStringLiteral("0")} + args);
+    Run r;
+    if (!p.waitForFinished(60000) || p.exitStatus() != QProcess::NormalExit) {
+        p.kill();
+        p.waitForFinished();
+        return r;
+    }
+    r.exitCode = p.exitCode();
+    r.stderrText = p.readAllStandardError();
+    for (const QByteArray& line : p.readAllStandardOutput().split('\n')) {
+        const QJsonDocument doc = QJsonDocument::fromJson(line);
+        if (doc.isObject()) {
+            r.lines.append(doc.object());
+        }
+    }
+    return r;
+}
+
+void TestVerifyCli::rejectsBadJobsAndPorts()
+{
+    Run r = run({QStringLiteral("--jobs"), QStringLiteral("-1"), QStringLiteral("--hash-device"),
+                 QStringLiteral("/dev/sdz")});
+    QCOMPARE(r.exitCode, VerifyCli::ExitError);
+    QVERIFY2(r.stderrText.contains("--jobs needs"), r.stderrText.constData());
+    QVERIFY(r.lines.isEmpty());
+
+    r = run({QStringLiteral("--jobs"), QStringLiteral("many"), QStringLiteral("image.iso")});
+    QCOMPARE(r.exitCode, VerifyCli::ExitError);
+
+    r = run({QStringLiteral("--serve-mirror"), QStringLiteral("--mirror-port"), QStringLiteral("0")});
+    QCOMPARE(r.exitCode, VerifyCli::ExitError);
+    QVERIFY2(r.stderrText.contains("--mirror-port"), r.stderrText.constData());
+
+    r = run({QStringLiteral("--serve-mirror"), QStringLiteral("--mirror-port"), QStringLiteral("70000")});
+    QCOMPARE(r.exitCode, VerifyCli::ExitError);
+}
+
+void TestVerifyCli::hashDeviceRejectsBadArguments_data()
+{
+    QTest::addColumn<QStringList>("args");
+    QTest::addColumn<QString>("error");
+
+    const QStringList device{QStringLiteral("--hash-device"), QStringLiteral("/dev/sdz")};
+    QTest::newRow("scan mode") << device + QStringList{QStringLiteral("--scan-mode"), QStringLiteral("sideways")}
+                               << QStringLiteral("Unknown scan mode sideways");
+    QTest::newRow("algorithm") << device + QStringList{QStringLiteral("--algorithm"), QStringLiteral("MD4")}
+                               << QStringLiteral("Unknown hash algorithm MD4");
+    QTest::newRow("tolerate quick")
+        << device + QStringList{QStringLiteral("--tolerate-bad-sectors"), QStringLiteral("--scan-mode"),
+                                QStringLiteral("quick")}
+        << QStringLiteral("--scan-mode full only");
+    QTest::newRow("tolerate resume")
+        << device + QStringList{QStringLiteral("--tolerate-bad-sectors"), QStringLiteral("--resume")}
+        << QStringLiteral("no checkpoint to --resume from");
+    QTest::newRow("read timeout")
+        << device + QStringList{QStringLiteral("--tolerate-bad-sectors"), QStringLiteral("--read-timeout"),
+                                QStringLiteral("1")}
+        << QStringLiteral("--read-timeout needs at least");
+    QTest::newRow("negative read timeout")
+        << device + QStringList{QStringLiteral("--read-timeout"), QStringLiteral("-5")}
+        << QStringLiteral("--read-timeout needs at least");
+}
+
+void TestVerifyCli::hashDeviceRejectsBadArguments()
+{
+    QFETCH(QStringList, args);
+    QFETCH(QString, error);
+
+    const Run r = run(args);
+    QCOMPARE(r.exitCode, VerifyCli::ExitError);
+    // One error line and nothing hashed.
+    QCOMPARE(r.lines.size(), 1);
+    QCOMPARE(r.lines.at(0).value(QStringLiteral("type")).toString(), QStringLiteral("error"));
+    const QString message = r.lines.at(0).value(QStringLiteral("error")).toString();
+    QVERIFY2(message.contains(error), qPrintable(message));
+}
+
+void TestVerifyCli::hashDeviceReportsEachFailedDevice()
+{
+    const QString missing = m_home.filePath(QStringLiteral("no-such-disk"));
+    const Run r = run({QStringLiteral("--hash-device"), missing, QStringLiteral("--hash-device"),
+                       QStringLiteral("/dev/null"), QStringLiteral("--scan-mode"), QStringLiteral("quick")});
+    QCOMPARE(r.exitCode, VerifyCli::ExitError);
+
+    const QList<QJsonObject> results = linesOfType(r.lines, QStringLiteral("result"));
+    QCOMPARE(results.size(), 2);
+    for (const QJsonObject& result : results) {
+        QVERIFY(!result.value(QStringLiteral("success")).toBool());
+        QVERIFY(!result.value(QStringLiteral("error")).toString().isEmpty());
+    }
+    const QList<QJsonObject> summaries = linesOfType(r.lines, QStringLiteral("summary"));
+    QCOMPARE(summaries.size(), 1);
+    QCOMPARE(summaries.at(0).value(QStringLiteral("total")).toInt(), 2);
+    QCOMPARE(summaries.at(0).value(QStringLiteral("failed")).toInt(), 2);
+}
+
+void TestVerifyCli::buildManifestRejectsBadArguments()
+{
+    const QString spec = m_home.filePath(QStringLiteral("spec.json"));
+    QVERIFY(writeFile(spec, specWatching(QStringLiteral("docs"))));
+    const QString out = m_home.filePath(QStringLiteral("out.json"));
+
+    Run r = run({QStringLiteral("--build-manifest"), m_home.filePath(QStringLiteral("missing.json")),
+                 QStringLiteral("--watch-mount"), m_home.path(), QStringLiteral("--manifest-out"), out});
+    QCOMPARE(r.exitCode, VerifyCli::ExitError);
+    QCOMPARE(r.lines.size(), 1);
+    QVERIFY(r.lines.at(0).value(QStringLiteral("error")).toString().startsWith(
+        QStringLiteral("Cannot read watch groups")));
+
+    r = run({QStringLiteral("--build-manifest"), spec, QStringLiteral("--manifest-out"), out});
+    QCOMPARE(r.exitCode, VerifyCli::ExitError);
+    QCOMPARE(r.lines.size(), 1);
+    QVERIFY(r.lines.at(0).value(QStringLiteral("error")).toString().contains(QStringLiteral("--watch-mount")));
+
+    r = run({QStringLiteral("--build-manifest"), spec, QStringLiteral("--watch-mount"), m_home.path()});
+    QCOMPARE(r.exitCode, VerifyCli::ExitError);
+    QCOMPARE(r.lines.size(), 1);
+    QVERIFY(r.lines.at(0).value(QStringLiteral("error")).toString().contains(QStringLiteral("--manifest-out")));
+    QVERIFY(!QFile::exists(out));
+}
+
+void TestVerifyCli::buildThenVerifyWatch()
+{
+    QTemporaryDir mount;
+    QVERIFY(mount.isValid());
+    QVERIFY(QDir(mount.path()).mkpath(QStringLiteral("docs")));
+    QVERIFY(writeFile(mount.filePath(QStringLiteral("docs/readme.txt")), "baseline"));
+    const QString spec = m_home.filePath(QStringLiteral("build-spec.json"));
+    QVERIFY(writeFile(spec, specWatching(QStringLiteral("docs"))));
+    const QString manifest = m_home.filePath(QStringLiteral("golden.json"));
+
+    Run r = run({QStringLiteral("--build-manifest"), spec, QStringLiteral("--watch-mount"), mount.path(),
+                 QStringLiteral("--manifest-out"), manifest});
+    QCOMPARE(r.exitCode, VerifyCli::ExitOk);
+    const QList<QJsonObject> built = linesOfType(r.lines, QStringLiteral("result"));
+    QCOMPARE(built.size(), 1);
+    QVERIFY(built.at(0).value(QStringLiteral("success")).toBool());
+    QCOMPARE(built.at(0).value(QStringLiteral("manifest")).toString(), manifest);
+    QVERIFY(!built.at(0).value(QStringLiteral("manifest_root")).toString().isEmpty());
+    QVERIFY(QFile::exists(manifest));
+
+    r = run({QStringLiteral("--verify-watch"), manifest, QStringLiteral("--watch-mount"), mount.path()});
+    QCOMPARE(r.exitCode, VerifyCli::ExitOk);
+    QList<QJsonObject> summaries = linesOfType(r.lines, QStringLiteral("summary"));
+    QCOMPARE(summaries.size(), 1);
+    QCOMPARE(summaries.at(0).value(QStringLiteral("matched")).toInt(), 1);
+
+    QVERIFY(writeFile(mount.filePath(QStringLiteral("docs/readme.txt")), "tampered with"));
+    r = run({QStringLiteral("--verify-watch"), manifest, QStringLiteral("--watch-mount"), mount.path()});
+    QCOMPARE(r.exitCode, VerifyCli::ExitVerifyFailed);
+    summaries = linesOfType(r.lines, QStringLiteral("summary"));
+    QCOMPARE(summaries.size(), 1);
+    QCOMPARE(summaries.at(0).value(QStringLiteral("mismatched")).toInt(), 1);
+    const QJsonObject mountResult = summaries.at(0).value(QStringLiteral("mounts")).toArray().at(0).toObject();
+    QCOMPARE(mountResult.value(QStringLiteral("status")).toString(), QStringLiteral("mismatch"));
+    QVERIFY(mountResult.value(QStringLiteral("changed")).toArray().contains(QStringLiteral("docs/readme.txt")));
+}
+
+void TestVerifyCli::verifyWatchRejectsBadArguments()
+{
+    Run r = run({QStringLiteral("--verify-watch"), m_home.filePath(QStringLiteral("missing.json")),
+                 QStringLiteral("--watch-mount"), m_home.path()});
+    QCOMPARE(r.exitCode, VerifyCli::ExitError);
+
+    const QString spec = m_home.filePath(QStringLiteral("watch-spec.json"));
+    QVERIFY(writeFile(spec, specWatching(QStringLiteral("docs"))));
+    r = run({QStringLiteral("--verify-watch"), spec});
+    QCOMPARE(r.exitCode, VerifyCli::ExitError);
+}
+
+void TestVerifyCli::missingInputsAreAnError()
+{
+    Run r = run({});
+    QCOMPARE(r.exitCode, VerifyCli::ExitError);
+
+    r = run({QStringLiteral("--files-from"), m_home.filePath(QStringLiteral("no-list.txt"))});
+    QCOMPARE(r.exitCode, VerifyCli::ExitError);
+    QVERIFY2(r.stderrText.contains("Cannot read"), r.stderrText.constData());
+
+    // A list with only comments leaves nothing to verify.
+    const QString list = m_home.filePath(QStringLiteral("empty-list.txt"));
+    QVERIFY(writeFile(list, "# nothing yet\n\n"));
+    r = run({QStringLiteral("--files-from"), list});
+    QCOMPARE(r.exitCode, VerifyCli::ExitError);
+}
+
+QTEST_MAIN(TestVerifyCli)
+#include "test_verify_cli.moc"
@@ -0,0 +1,245 @@
+#include <QtTest>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+#include "VerifyHistory.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+VerifyHistoryEntry result(const QString& node, int n)
+{
+    VerifyHistoryEntry e;
+    e.timestamp = QDateTime::currentDateTimeUtc();
+    e.deviceNode = node;
+    e.deviceLabel = QStringLiteral("STICK");
+    e.status = QStringLiteral("pass");
+    e.summary = QStringLiteral("check %1").arg(n);
+    e.durationMs = static_cast<uint64_t>(n);
+    return e;
+}
+
+} // namespace
+
+class TestVerifyHistory : public QObject {
+    Q_OBJECT
+
+private slots:
+    void appendsAndIndexesByDevice();
+    void ringOverwritesOldest();
+    void tornHeaderFallsBackToPreviousCopy();
+    void legacyFileMigrated();
+    void performanceReportPersists();
+    void rollupOutlivesTheRing();
+};
+
+void TestVerifyHistory::appendsAndIndexesByDevice()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("verify-history.ring"));
+    VerifyHistory& history = VerifyHistory::instance();
+    history.load(path);
+    for (int i = 0; i < 600; ++i) {
+        history.append(result(i % 3 ? QStringLiteral("/dev/sdb") : QStringLiteral("/dev/sdc"), i));
+    }
+    QCOMPARE(history.entryCount(), 600);  // no fixed entry cap
+
+    history.load(path);
+    QCOMPARE(history.entryCount(), 600);
+    QCOMPARE(history.recentEntries(1).first().summary, QStringLiteral("check 599"));
+    const QList<VerifyHistoryEntry> sdc = history.entriesForDevice(QStringLiteral("/dev/sdc"), 3);
+    QCOMPARE(sdc.size(), 3);
+    QCOMPARE(sdc.at(0).summary, QStringLiteral("check 597"));
+    QCOMPARE(sdc.at(2).summary, QStringLiteral("check 591"));
+    QCOMPARE(sdc.at(2).durationMs, uint64_t(591));
+}
+
+void TestVerifyHistory::ringOverwritesOldest()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("verify-history.ring"));
+    constexpr quint64 kCapacity = 4096;
+    VerifyHistory& history = VerifyHistory::instance();
+    history.load(path, kCapacity);
+    for (int i = 0; i < 300; ++i) {
+        history.append(result(i % 2 ? QStringLiteral("/dev/sdb") : QStringLiteral("/dev/sdc"), i));
+    }
+    const int kept = history.entryCount();
+    QVERIFY(kept > 4 && kept < 300);
+    QVERIFY(QFileInfo(path).size() <= qint64(kCapacity) + 128);
+
+    history.load(path, 1024 * 1024);  // an existing ring keeps its capacity
+    QCOMPARE(history.entryCount(), kept);
+    const QList<VerifyHistoryEntry> recent = history.recentEntries(kept);
+    for (int i = 0; i < kept; ++i) {
+        QCOMPARE(recent.at(i).summary, QStringLiteral("check %1").arg(299 - i));
+    }
+    const QList<VerifyHistoryEntry> sdc = history.entriesForDevice(QStringLiteral("/dev/sdc"), 1000);
+    QCOMPARE(sdc.size(), kept / 2);
+    QCOMPARE(sdc.first().summary, QStringLiteral("check 298"));
+}
+
+void TestVerifyHistory::tornHeaderFallsBackToPreviousCopy()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("verify-history.ring"));
+    VerifyHistory& history = VerifyHistory::instance();
+    history.load(path);
+    for (int i = 0; i < 5; ++i) {
+        history.append(result(QStringLiteral("/dev/sdb"), i));
+    }
+
+    // The new ring wrote header 1 (second slot) and each append one more, so the
+    // latest header is in the first slot. Damage it.
+    {
+        QFile f(path);
+        QVERIFY(f.open(QIODevice::ReadWrite));
+        QVERIFY(f.seek(20));
+        f.write("\xff", 1);
+    }
+    history.load(path);
+    QCOMPARE(history.entryCount(), 4);
+    QCOMPARE(history.recentEntries(1).first().summary, QStringLiteral("check 3"));
+
+    history.append(result(QStringLiteral("/dev/sdb"), 9));
+    history.load(path);
+    QCOMPARE(history.entryCount(), 5);
+    QCOMPARE(history.recentEntries(1).first().summary, QStringLiteral("check 9"));
+}
+
+void TestVerifyHistory::legacyFileMigrated()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QJsonArray entries;
+    for (int i = 2; i >= 0; --i) {  // the JSON file was newest first
+        QJsonObject o;
+        o[QStringLiteral("at")] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+        o[QStringLiteral("device_node")] = QStringLiteral("/dev/sdd");
+        o[QStringLiteral("kind")] = QStringLiteral("iso");
+        o[QStringLiteral("status")] = QStringLiteral("fail");
+        o[QStringLiteral("summary")] = QStringLiteral("legacy %1").arg(i);
+        entries.append(o);
+    }
+    QJsonObject root;
+    root[QStringLiteral("version")] = 1;
+    root[QStringLiteral("entries")] = entries;
+    const QString legacy = dir.filePath(QStringLiteral("verify-history.json"));
+    {
+        QFile f(legacy);
+        QVERIFY(f.open(QIODevice::WriteOnly));
+        f.write(QJsonDocument(root).toJson());
+    }
+
+    VerifyHistory& history = VerifyHistory::instance();
+    history.load(dir.filePath(QStringLiteral("verify-history.ring")));
+    QCOMPARE(history.entryCount(), 3);
+    const QList<VerifyHistoryEntry> recent = history.recentEntries(3);
+    QCOMPARE(recent.first().summary, QStringLiteral("legacy 2"));
+    QCOMPARE(recent.last().summary, QStringLiteral("legacy 0"));
+    QCOMPARE(recent.first().kind, VerifyHistoryKind::IsoScan);
+    QVERIFY(!QFile::exists(legacy));
+    QVERIFY(QFile::exists(legacy + QStringLiteral(".migrated")));
+}
+
+void TestVerifyHistory::performanceReportPersists()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("verify-history.ring"));
+    VerifyHistory& history = VerifyHistory::instance();
+    history.load(path);
+
+    VerifyHistoryEntry hashed = result(QStringLiteral("/dev/sdb"), 1);
+    hashed.performance.engine = QStringLiteral("pipelined");
+    hashed.performance.elevated = true;
+    hashed.performance.bufferSizeKB = 4096;
+    hashed.performance.queueDepth = 3;
+    hashed.performance.avgMBps = 41.5;
+    hashed.performance.minMBps = 12.5;
+    hashed.performance.ioWaitMs = 7000;
+    hashed.performance.cpuMs = 3000;
+    hashed.performance.readRetries = 1;
+    history.append(hashed);
+    history.append(result(QStringLiteral("/dev/sdb"), 2));  // a scan: no report
+
+    history.load(path);
+    const QList<VerifyHistoryEntry> recent = history.recentEntries(2);
+    QCOMPARE(recent.size(), 2);
+    QVERIFY(recent.first().performance.isEmpty());
+    const HashPerformance& p = recent.last().performance;
+    QCOMPARE(p.engine, QStringLiteral("pipelined"));
+    QVERIFY(p.elevated);
+    QCOMPARE(p.bufferSizeKB, 4096);
+    QCOMPARE(p.queueDepth, 3);
+    QCOMPARE(p.avgMBps, 41.5);
+    QCOMPARE(p.minMBps, 12.5);
+    QCOMPARE(p.ioWaitMs, uint64_t(7000));
+    QCOMPARE(p.cpuMs, uint64_t(3000));
+    QCOMPARE(p.readRetries, 1);
+    QCOMPARE(p.summary(), QStringLiteral("pipelined (elevated), 4096 KB ×3 · 41.5 MB/s avg, 12.5 min · I/O 70 % · 1 read retry"));
+}
+
+void TestVerifyHistory::rollupOutlivesTheRing()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString path = dir.filePath(QStringLiteral("verify-history.ring"));
+    const QString rollupPath = dir.filePath(QStringLiteral("verify-history.rollup"));
+    VerifyHistory& history = VerifyHistory::instance();
+    history.load(path, 4096);
+    for (int i = 0; i < 300; ++i) {
+        VerifyHistoryEntry e = result(i % 2 ? QStringLiteral("/dev/sdb") : QStringLiteral("/dev/sdc"), i);
+        if (i % 3 == 0) {
+            e.status = QStringLiteral("mismatch");
+        }
+        history.append(e);
+    }
+    const int kept = history.entryCount();
+    QVERIFY(kept < 300);
+
+    const VerifyRollup::Counts expected{300, 200, 100};
+    QCOMPARE(history.rollup().totals(), expected);
+    QCOMPARE(history.rollup().since(QDate::currentDate().addDays(-29)), expected);
+    const VerifyRollup::DeviceSummary sdb = history.rollup().device(QStringLiteral("/dev/sdb"));
+    QCOMPARE(sdb.counts.total, quint32(150));
+    QCOMPARE(sdb.counts.failed, quint32(50));  // odd multiples of 3
+    QCOMPARE(sdb.lastStatus, QStringLiteral("pass"));  // 299
+    QCOMPARE(history.rollup().device(QStringLiteral("/dev/sdc")).lastStatus, QStringLiteral("pass"));  // 298
+    QCOMPARE(history.rollup().device(QStringLiteral("/dev/sdz")).counts.total, quint32(0));
+
+    // Reopened: the saved counters still cover what the ring has overwritten.
+    history.load(path);
+    QCOMPARE(history.rollup().totals(), expected);
+    QCOMPARE(history.rollup().deviceCount(), 2);
+
+    // Without them, only what the ring holds can be counted.
+    QVERIFY(QFile::remove(rollupPath));
+    history.load(path);
+    QCOMPARE(history.rollup().totals().total, quint32(kept));
+    QVERIFY(QFile::exists(rollupPath));
+
+    // A rollup older than the ring is rebuilt too.
+    const QByteArray saved = [&] {
+        QFile f(rollupPath);
+        return f.open(QIODevice::ReadOnly) ? f.readAll() : QByteArray();
+    }();
+    history.append(result(QStringLiteral("/dev/sdb"), 300));
+    {
+        QFile f(rollupPath);
+        QVERIFY(f.open(QIODevice::WriteOnly));
+        f.write(saved);
+    }
+    history.load(path);
+    QCOMPARE(history.rollup().totals().total, quint32(history.entryCount()));
+}
+
+QTEST_MAIN(TestVerifyHistory)
+#include "test_verify_history.moc"
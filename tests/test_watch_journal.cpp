@@ -0,0 +1,121 @@
+#include <QtTest>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+#include <memory>
+
+#include "WatchJournal.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+void writeFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    QCOMPARE(file.write(data), data.size());
+}
+
+} // namespace
+
+class TestWatchJournal : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void usableOnlyAfterCleanPoint();
+    void recordsTouchedPaths();
+    void newDirectoriesAreFollowed();
+    void mismatchNeedsFullVerify();
+
+private:
+    std::unique_ptr<QTemporaryDir> m_dir;
+    QString m_mount;
+};
+
+void TestWatchJournal::init()
+{
+    if (!WatchJournal::isSupported()) {
+        QSKIP("No change journal on this platform");
+    }
+    m_dir = std::make_unique<QTemporaryDir>();
+    QVERIFY(m_dir->isValid());
+    m_mount = QFileInfo(m_dir->path()).canonicalFilePath();
+    QVERIFY(QDir().mkpath(m_mount + QStringLiteral("/docs")));
+    writeFile(m_mount + QStringLiteral("/docs/a.txt"), "a");
+    writeFile(m_mount + QStringLiteral("/notes.txt"), "n");
+}
+
+void TestWatchJournal::usableOnlyAfterCleanPoint()
+{
+    WatchJournal journal;
+    QVERIFY(!journal.begin(m_mount).usable);
+
+    journal.watch(m_mount, {QStringLiteral("docs")});
+    QVERIFY(journal.isWatching(m_mount));
+    QVERIFY(!journal.begin(m_mount).usable);
+    journal.finish(m_mount, true);
+
+    const WatchJournal::Snapshot snapshot = journal.begin(m_mount);
+    QVERIFY(snapshot.usable);
+    QVERIFY(snapshot.touchedPaths.isEmpty());
+
+    journal.unwatch(m_mount);
+    QVERIFY(!journal.isWatching(m_mount));
+}
+
+void TestWatchJournal::recordsTouchedPaths()
+{
+    WatchJournal journal;
+    journal.watch(m_mount, {QStringLiteral("docs"), QStringLiteral("notes.txt")});
+    journal.begin(m_mount);
+    journal.finish(m_mount, true);
+
+    writeFile(m_mount + QStringLiteral("/docs/a.txt"), "changed");
+    writeFile(m_mount + QStringLiteral("/notes.txt"), "changed");
+    QVERIFY(QFile::remove(m_mount + QStringLiteral("/docs/a.txt")));
+
+    const WatchJournal::Snapshot snapshot = journal.begin(m_mount);
+    QVERIFY(snapshot.usable);
+    QVERIFY(snapshot.touchedPaths.contains(QStringLiteral("docs/a.txt")));
+    QVERIFY(snapshot.touchedPaths.contains(QStringLiteral("notes.txt")));
+
+    // Collection restarts at begin().
+    journal.finish(m_mount, true);
+    QVERIFY(journal.begin(m_mount).touchedPaths.isEmpty());
+}
+
+void TestWatchJournal::newDirectoriesAreFollowed()
+{
+    WatchJournal journal;
+    journal.watch(m_mount, {QStringLiteral("docs")});
+    journal.begin(m_mount);
+    journal.finish(m_mount, true);
+
+    QVERIFY(QDir().mkpath(m_mount + QStringLiteral("/docs/sub")));
+    QVERIFY(journal.begin(m_mount).touchedPaths.contains(QStringLiteral("docs/sub")));
+    journal.finish(m_mount, true);
+
+    writeFile(m_mount + QStringLiteral("/docs/sub/b.txt"), "b");
+    const WatchJournal::Snapshot snapshot = journal.begin(m_mount);
+    QVERIFY(snapshot.usable);
+    QVERIFY(snapshot.touchedPaths.contains(QStringLiteral("docs/sub/b.txt")));
+}
+
+void TestWatchJournal::mismatchNeedsFullVerify()
+{
+    WatchJournal journal;
+    journal.watch(m_mount, {QStringLiteral("docs")});
+    journal.begin(m_mount);
+    journal.finish(m_mount, true);
+
+    journal.begin(m_mount);
+    journal.finish(m_mount, false);
+    QVERIFY(!journal.begin(m_mount).usable);
+}
+
+QTEST_MAIN(TestWatchJournal)
+#include "test_watch_journal.moc"
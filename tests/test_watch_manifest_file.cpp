@@ -0,0 +1,169 @@
+#include <QtTest>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTimeZone>
+
+#include "WatchManifestFile.h"
+
+using namespace FlashSpartan;
+
+namespace {
+
+QString hexOf(char c)
+{
+    return QString(64, QLatin1Char(c));
+}
+
+WatchFileEntry fileEntry(const QString& path, char hash)
+{
+    WatchFileEntry e;
+    e.relativePath = path;
+    e.contentHash = hexOf(hash);
+    return e;
+}
+
+WatchManifest sampleManifest()
+{
+    WatchGroup docs;
+    docs.id = "g1";
+    docs.name = "Docs";
+    docs.watchPaths = {"docs", "notes.txt"};
+    docs.merkleRoot = hexOf('1');
+    docs.merkleFormat = 2;
+    docs.merkleFanOut = 4;
+    docs.builtAt = QDateTime::fromMSecsSinceEpoch(1700000000123, QTimeZone::utc());
+    docs.files = {fileEntry("notes.txt", 'a'), fileEntry("docs/b.txt", 'b'),
+                  fileEntry("docs/sub/c.txt", 'c'), fileEntry("docs/a.txt", 'd')};
+    WatchFileEntry withMeta = fileEntry("docs/meta.bin", 'e');
+    withMeta.sizeBytes = 4096;
+    withMeta.modifiedUtc = QDateTime::fromMSecsSinceEpoch(1700000001000, QTimeZone::utc());
+    withMeta.changedUtc = QDateTime::fromMSecsSinceEpoch(1700000002000, QTimeZone::utc());
+    withMeta.inode = 77;
+    withMeta.chunks = {{0, 2048, hexOf('5')}, {2048, 2048, hexOf('6')}};
+    docs.files.append(withMeta);
+    docs.chunkThresholdBytes = 2048;
+
+    WatchGroup empty;
+    empty.id = "g2";
+    empty.name = "Empty";
+
+    WatchManifest m;
+    m.groups = {docs, empty};
+    m.manifestRoot = hexOf('f');
+    m.updatedAt = QDateTime::fromMSecsSinceEpoch(1700000003000, QTimeZone::utc());
+    return m;
+}
+
+} // namespace
+
+class TestWatchManifestFile : public QObject {
+    Q_OBJECT
+
+private slots:
+    void roundTrip();
+    void findUsesSortedEntries();
+    void rejectsNonSha256Digests();
+    void openRejectsTamperedFile();
+};
+
+void TestWatchManifestFile::roundTrip()
+{
+    const WatchManifest m = sampleManifest();
+    const QByteArray data = WatchManifestFile::encode(m);
+    QVERIFY(!data.isEmpty());
+
+    const std::optional<WatchManifest> decoded = WatchManifestFile::decode(data);
+    QVERIFY(decoded.has_value());
+    QCOMPARE(decoded->manifestRoot, m.manifestRoot);
+    QCOMPARE(decoded->updatedAt, m.updatedAt);
+    QCOMPARE(decoded->groups.size(), 2);
+    const WatchGroup& g = decoded->groups.first();
+    QCOMPARE(g.id, QStringLiteral("g1"));
+    QCOMPARE(g.watchPaths, m.groups.first().watchPaths);
+    QCOMPARE(g.merkleRoot, m.groups.first().merkleRoot);
+    QCOMPARE(g.merkleFormat, 2);
+    QCOMPARE(g.merkleFanOut, 4);
+    QCOMPARE(g.builtAt, m.groups.first().builtAt);
+    QCOMPARE(g.files.size(), m.groups.first().files.size());
+    QVERIFY(decoded->groups.at(1).merkleRoot.isEmpty());
+    QCOMPARE(decoded->groups.at(1).merkleFormat, 1);
+    QCOMPARE(decoded->groups.at(1).merkleFanOut, 2);
+
+    QStringList paths;
+    for (const WatchFileEntry& f : g.files) {
+        paths.append(f.relativePath);
+    }
+    QStringList sorted = paths;
+    std::sort(sorted.begin(), sorted.end(),
+              [](const QString& a, const QString& b) { return a.toUtf8() < b.toUtf8(); });
+    QCOMPARE(paths, sorted);
+
+    QVERIFY(!WatchManifestFile::decode(data.left(data.size() - 1)).has_value());
+}
+
+void TestWatchManifestFile::findUsesSortedEntries()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString digest = WatchManifestFile::save(dir.path(), sampleManifest());
+    QCOMPARE(digest.size(), 64);
+
+    const std::unique_ptr<WatchManifestFile> file = WatchManifestFile::open(dir.path(), digest);
+    QVERIFY(file);
+    QCOMPARE(file->groupCount(), 2);
+    QCOMPARE(file->fileCount(0), qsizetype(5));
+    QCOMPARE(file->fileCount(1), qsizetype(0));
+
+    const std::optional<WatchFileEntry> c = file->find(0, "docs/sub/c.txt");
+    QVERIFY(c.has_value());
+    QCOMPARE(c->contentHash, hexOf('c'));
+    QVERIFY(file->find(0, "notes.txt").has_value());
+    QVERIFY(!file->find(0, "docs").has_value());
+    QVERIFY(!file->find(0, "docs/sub").has_value());
+    QVERIFY(!file->find(1, "notes.txt").has_value());
+
+    const std::optional<WatchFileEntry> meta = file->find(0, "docs/meta.bin");
+    QVERIFY(meta.has_value());
+    QVERIFY(meta->hasMetadata());
+    QCOMPARE(meta->sizeBytes, uint64_t(4096));
+    QCOMPARE(meta->inode, uint64_t(77));
+    QCOMPARE(meta->changedUtc, sampleManifest().groups.first().files.last().changedUtc);
+    QCOMPARE(meta->chunks.size(), 2);
+    QCOMPARE(meta->chunks.at(1).offset, uint64_t(2048));
+    QCOMPARE(meta->chunks.at(1).length, uint32_t(2048));
+    QCOMPARE(meta->chunks.at(1).hash, hexOf('6'));
+    QVERIFY(file->find(0, "docs/a.txt")->chunks.isEmpty());
+    QCOMPARE(file->manifest().groups.first().chunkThresholdBytes, uint64_t(2048));
+}
+
+void TestWatchManifestFile::rejectsNonSha256Digests()
+{
+    WatchManifest m = sampleManifest();
+    m.groups.first().files.first().contentHash = hexOf('A');
+    QVERIFY(WatchManifestFile::encode(m).isEmpty());
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString error;
+    QVERIFY(WatchManifestFile::save(dir.path(), m, &error).isEmpty());
+    QVERIFY(!error.isEmpty());
+}
+
+void TestWatchManifestFile::openRejectsTamperedFile()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString digest = WatchManifestFile::save(dir.path(), sampleManifest());
+    QVERIFY(!digest.isEmpty());
+    QVERIFY(!WatchManifestFile::open(dir.path(), QString(64, QLatin1Char('0'))));
+
+    QFile file(WatchManifestFile::pathFor(dir.path(), digest));
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    file.seek(100);
+    QVERIFY(file.putChar('\x01'));
+    file.close();
+    QVERIFY(!WatchManifestFile::open(dir.path(), digest));
+}
+
+QTEST_MAIN(TestWatchManifestFile)
+#include "test_watch_manifest_file.moc"
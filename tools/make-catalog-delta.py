@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+"""Write the ISO catalog delta between two versions of the remote manifest.
+
+Usage: make-catalog-delta.py OLD.json NEW.json OUT.json
+
+Entries are matched by (publisher_id, file_pattern). OLD and NEW must carry
+catalog_version; sign OUT with the catalog key (gpg --detach-sign --armor) and
+publish it, with its .asc, where NEW's delta_url_template names version OLD.
+"""
+
+from __future__ import annotations
+
+import json
+import sys
+from pathlib import Path
+
+DELTA_FORMAT = 1
+
+
+def entry_key(entry: dict) -> tuple[str, str]:
+    return entry.get("publisher_id", ""), entry.get("file_pattern", "")
+
+
+def main() -> int:
+    if len(sys.argv) != 4:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+    old = json.loads(Path(sys.argv[1]).read_text(encoding="utf-8"))
+    new = json.loads(Path(sys.argv[2]).read_text(encoding="utf-8"))
+    from_version = old.get("catalog_version", 0)
+    to_version = new.get("catalog_version", 0)
+    if from_version <= 0 or to_version < from_version:
+        print(f"catalog_version must grow (got {from_version} -> {to_version})", file=sys.stderr)
+        return 1
+
+    old_entries = {entry_key(e): e for e in old.get("entries", [])}
+    new_keys = set()
+    upserts = []
+    for entry in new.get("entries", []):
+        key = entry_key(entry)
+        new_keys.add(key)
+        if old_entries.get(key) != entry:
+            upserts.append(entry)
+    removals = [
+        {"publisher_id": key[0], "file_pattern": key[1]} for key in old_entries if key not in new_keys
+    ]
+
+    delta = {
+        "delta_format": DELTA_FORMAT,
+        "from_version": from_version,
+        "to_version": to_version,
+        "upserts": upserts,
+        "removals": removals,
+    }
+    if "delta_url_template" in new:
+        delta["delta_url_template"] = new["delta_url_template"]
+    Path(sys.argv[3]).write_text(json.dumps(delta, indent=2) + "\n", encoding="utf-8")
+    print(f"{sys.argv[3]}: {len(upserts)} upserts, {len(removals)} removals")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())